@@ -963,6 +963,27 @@ myDomainEventBlockThresholdCallback(virConnectPtr conn G_GNUC_UNUSED,
 }
 
 
+static int
+myDomainEventBlockJobProgressCallback(virConnectPtr conn G_GNUC_UNUSED,
+                                      virDomainPtr dom,
+                                      const char *disk,
+                                      int type,
+                                      unsigned long long cur,
+                                      unsigned long long end,
+                                      unsigned long long bandwidth,
+                                      void *opaque G_GNUC_UNUSED)
+{
+    /* Casts to uint64_t to work around mingw not knowing %lld */
+    printf("%s EVENT: Domain %s(%d) block job progress callback disk '%s', "
+           "type '%s' progress: '%" PRIu64 "/%" PRIu64 "', "
+           "bandwidth: '%" PRIu64 "'",
+           __func__, virDomainGetName(dom), virDomainGetID(dom),
+           disk, blockJobTypeToStr(type), (uint64_t)cur, (uint64_t)end,
+           (uint64_t)bandwidth);
+    return 0;
+}
+
+
 static int
 myDomainEventMigrationIterationCallback(virConnectPtr conn G_GNUC_UNUSED,
                                         virDomainPtr dom,
@@ -1093,6 +1114,7 @@ struct domainEventData domainEvents[] = {
     DOMAIN_EVENT(VIR_DOMAIN_EVENT_ID_DEVICE_REMOVAL_FAILED, myDomainEventDeviceRemovalFailedCallback),
     DOMAIN_EVENT(VIR_DOMAIN_EVENT_ID_METADATA_CHANGE, myDomainEventMetadataChangeCallback),
     DOMAIN_EVENT(VIR_DOMAIN_EVENT_ID_BLOCK_THRESHOLD, myDomainEventBlockThresholdCallback),
+    DOMAIN_EVENT(VIR_DOMAIN_EVENT_ID_BLOCK_JOB_PROGRESS, myDomainEventBlockJobProgressCallback),
 };
 
 struct storagePoolEventData {
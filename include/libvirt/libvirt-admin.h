@@ -392,6 +392,66 @@ int virAdmClientClose(virAdmClientPtr client, unsigned int flags);
 
 # define VIR_SERVER_CLIENTS_UNAUTH_CURRENT "nclients_unauth"
 
+/**
+ * VIR_SERVER_CLIENTS_JOBS_MAX:
+ * Macro for per-server nclient_jobs_max limit: represents the upper limit
+ * to number of calls of a single client processed by the server's workers
+ * at the same time, as VIR_TYPED_PARAM_UINT. Calls over the limit wait for
+ * the client's previous calls to finish while calls of other clients are
+ * processed. Zero means no limit.
+ */
+
+# define VIR_SERVER_CLIENTS_JOBS_MAX "nclient_jobs_max"
+
+/**
+ * VIR_SERVER_CLIENTS_MESSAGE_ALLOCS:
+ * Macro for per-server message_allocs counter: represents the number of
+ * RPC message structures and buffers the server and its current clients
+ * had to allocate, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_SERVER_CLIENTS_MESSAGE_ALLOCS "message_allocs"
+
+/**
+ * VIR_SERVER_CLIENTS_MESSAGE_REUSES:
+ * Macro for per-server message_reuses counter: represents the number of
+ * RPC message structures and buffers the server and its current clients
+ * reused from their free lists instead of allocating them, as
+ * VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_SERVER_CLIENTS_MESSAGE_REUSES "message_reuses"
+
+/**
+ * VIR_SERVER_CLIENTS_MESSAGE_CACHED:
+ * Macro for per-server message_cached attribute: represents the current
+ * number of RPC message structures and buffers kept on the free lists of
+ * the server and its clients, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_SERVER_CLIENTS_MESSAGE_CACHED "message_cached"
+
+/**
+ * VIR_SERVER_CLIENTS_MESSAGE_CACHED_BYTES:
+ * Macro for per-server message_cached_bytes attribute: represents the
+ * current amount of memory in bytes held by the free lists of RPC messages
+ * of the server and its clients, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_SERVER_CLIENTS_MESSAGE_CACHED_BYTES "message_cached_bytes"
+
 int virAdmServerGetClientLimits(virAdmServerPtr srv,
                                 virTypedParameterPtr *params,
                                 int *nparams,
@@ -421,6 +481,308 @@ int virAdmConnectSetLoggingFilters(virAdmConnectPtr conn,
                                    const char *filters,
                                    unsigned int flags);
 
+/**
+ * VIR_ADMIN_RECONNECT_DOMAINS:
+ * Macro for the number of running domains the daemon's drivers had to
+ * reconnect to after the daemon was started, as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_ADMIN_RECONNECT_DOMAINS "domains"
+
+/**
+ * VIR_ADMIN_RECONNECT_DONE:
+ * Macro for the number of domains the daemon's drivers are done
+ * reconnecting to, including failed attempts, as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_ADMIN_RECONNECT_DONE "done"
+
+/**
+ * VIR_ADMIN_RECONNECT_FAILED:
+ * Macro for the number of domains the daemon's drivers failed to
+ * reconnect to, as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_ADMIN_RECONNECT_FAILED "failed"
+
+int virAdmConnectGetReconnectInfo(virAdmConnectPtr conn,
+                                  virTypedParameterPtr *params,
+                                  int *nparams,
+                                  unsigned int flags);
+
+/**
+ * VIR_ADMIN_OBJECT_STATS_CLASS_COUNT:
+ * Macro for the number of object classes reported by
+ * virAdmConnectGetObjectStats, as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_ADMIN_OBJECT_STATS_CLASS_COUNT "class.count"
+
+/**
+ * VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX:
+ * The parameter name prefix to access the statistics of an object class.
+ * Concatenate the prefix, the zero based index of the class and one of
+ * the VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_* macros to form a parameter
+ * name.
+ */
+
+# define VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX "class."
+
+/**
+ * VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_NAME:
+ * Macro for the name of the object class, as VIR_TYPED_PARAM_STRING.
+ */
+
+# define VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_NAME ".name"
+
+/**
+ * VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_INSTANCES:
+ * Macro for the number of live instances of the object class, as
+ * VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_INSTANCES ".instances"
+
+/**
+ * VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_BYTES:
+ * Macro for the memory taken by the live instances of the object class,
+ * not including any memory the instances point to, as
+ * VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_BYTES ".bytes"
+
+int virAdmConnectGetObjectStats(virAdmConnectPtr conn,
+                                virTypedParameterPtr *params,
+                                int *nparams,
+                                unsigned int flags);
+
+/**
+ * VIR_ADMIN_LOCK_STATS_CLASS_COUNT:
+ * Macro for the number of lock classes reported by
+ * virAdmConnectGetLockStats, as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_ADMIN_LOCK_STATS_CLASS_COUNT "class.count"
+
+/**
+ * VIR_ADMIN_LOCK_STATS_CLASS_PREFIX:
+ * The parameter name prefix to access the statistics of a lock class.
+ * Concatenate the prefix, the zero based index of the class and one of
+ * the VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_* macros to form a parameter
+ * name.
+ */
+
+# define VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "class."
+
+/**
+ * VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_NAME:
+ * Macro for the name of the lock class, which is the name of the object
+ * class for object locks, as VIR_TYPED_PARAM_STRING.
+ */
+
+# define VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_NAME ".name"
+
+/**
+ * VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_ACQUISITIONS:
+ * Macro for the number of times the locks of the class were acquired, as
+ * VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_ACQUISITIONS ".acquisitions"
+
+/**
+ * VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_CONTENTIONS:
+ * Macro for the number of times a thread had to wait for a lock of the
+ * class, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_CONTENTIONS ".contentions"
+
+/**
+ * VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_WAIT_TIME:
+ * Macro for the total time in microseconds threads waited for the locks
+ * of the class, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_WAIT_TIME ".wait_time"
+
+/**
+ * VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_HOLD_TIME:
+ * Macro for the total time in microseconds the locks of the class were
+ * held, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_HOLD_TIME ".hold_time"
+
+int virAdmConnectGetLockStats(virAdmConnectPtr conn,
+                              virTypedParameterPtr *params,
+                              int *nparams,
+                              unsigned int flags);
+
+/**
+ * VIR_SERVER_PROC_STATS_COUNT:
+ * Macro for the number of procedures reported by
+ * virAdmServerGetProcedureStats, as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_SERVER_PROC_STATS_COUNT "proc.count"
+
+/**
+ * VIR_SERVER_PROC_STATS_HIST_COUNT:
+ * Macro for the number of buckets of the latency histograms reported by
+ * virAdmServerGetProcedureStats, as VIR_TYPED_PARAM_UINT. Bucket N counts
+ * the calls which took less than 10^(N+1) microseconds and were not
+ * counted by a lower bucket; the last bucket counts all the slower calls.
+ */
+
+# define VIR_SERVER_PROC_STATS_HIST_COUNT "hist.count"
+
+/**
+ * VIR_SERVER_PROC_STATS_PREFIX:
+ * The parameter name prefix to access the statistics of a procedure.
+ * Concatenate the prefix, the zero based index of the procedure and one
+ * of the VIR_SERVER_PROC_STATS_SUFFIX_* macros to form a parameter name.
+ */
+
+# define VIR_SERVER_PROC_STATS_PREFIX "proc."
+
+/**
+ * VIR_SERVER_PROC_STATS_SUFFIX_PROGRAM:
+ * Macro for the number of the RPC program of the procedure, as
+ * VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_SERVER_PROC_STATS_SUFFIX_PROGRAM ".program"
+
+/**
+ * VIR_SERVER_PROC_STATS_SUFFIX_PROCEDURE:
+ * Macro for the number of the procedure within its RPC program, as
+ * VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_SERVER_PROC_STATS_SUFFIX_PROCEDURE ".procedure"
+
+/**
+ * VIR_SERVER_PROC_STATS_SUFFIX_CALLS:
+ * Macro for the number of calls of the procedure, as
+ * VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_PROC_STATS_SUFFIX_CALLS ".calls"
+
+/**
+ * VIR_SERVER_PROC_STATS_SUFFIX_ERRORS:
+ * Macro for the number of calls of the procedure which failed, as
+ * VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_PROC_STATS_SUFFIX_ERRORS ".errors"
+
+/**
+ * VIR_SERVER_PROC_STATS_SUFFIX_QUEUE_TIME:
+ * Macro for the total time in microseconds the calls of the procedure
+ * waited for a worker thread, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_PROC_STATS_SUFFIX_QUEUE_TIME ".queue_time"
+
+/**
+ * VIR_SERVER_PROC_STATS_SUFFIX_EXEC_TIME:
+ * Macro for the total time in microseconds the calls of the procedure
+ * were executed for, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_PROC_STATS_SUFFIX_EXEC_TIME ".exec_time"
+
+/**
+ * VIR_SERVER_PROC_STATS_SUFFIX_QUEUE_HIST:
+ * Concatenate this suffix and the zero based index of a bucket to get the
+ * number of calls of the procedure whose wait for a worker thread falls
+ * into the bucket, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_PROC_STATS_SUFFIX_QUEUE_HIST ".queue_hist."
+
+/**
+ * VIR_SERVER_PROC_STATS_SUFFIX_EXEC_HIST:
+ * Concatenate this suffix and the zero based index of a bucket to get the
+ * number of calls of the procedure whose execution time falls into the
+ * bucket, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_PROC_STATS_SUFFIX_EXEC_HIST ".exec_hist."
+
+int virAdmServerGetProcedureStats(virAdmServerPtr srv,
+                                  virTypedParameterPtr *params,
+                                  int *nparams,
+                                  unsigned int flags);
+
+/* Capture RPC messages of a server */
+
+/**
+ * VIR_SERVER_CAPTURE_ENABLED:
+ * Macro for starting (1) or stopping (0) the capture of the RPC messages
+ * of a server, as VIR_TYPED_PARAM_UINT. Starting a capture drops the
+ * messages kept by a previous one.
+ */
+
+# define VIR_SERVER_CAPTURE_ENABLED "enabled"
+
+/**
+ * VIR_SERVER_CAPTURE_SIZE:
+ * Macro for the maximum number of bytes of messages kept in memory by a
+ * capture being started, as VIR_TYPED_PARAM_ULLONG. The oldest messages
+ * are dropped once it is reached.
+ */
+
+# define VIR_SERVER_CAPTURE_SIZE "size"
+
+/**
+ * VIR_SERVER_CAPTURE_SNAPLEN:
+ * Macro for the maximum number of bytes kept of each message by a capture
+ * being started, as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_SERVER_CAPTURE_SNAPLEN "snaplen"
+
+/**
+ * VIR_SERVER_CAPTURE_SAMPLE:
+ * Macro for keeping only 1 in N calls, along with their replies, by a
+ * capture being started, as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_SERVER_CAPTURE_SAMPLE "sample"
+
+/**
+ * VIR_SERVER_CAPTURE_FILE:
+ * Macro for the absolute path of the file the daemon writes the captured
+ * messages to in the pcapng format, as VIR_TYPED_PARAM_STRING.
+ */
+
+# define VIR_SERVER_CAPTURE_FILE "file"
+
+int virAdmServerSetCapture(virAdmServerPtr srv,
+                           virTypedParameterPtr params,
+                           int nparams,
+                           unsigned int flags);
+
+/* Tunables of the pools and caches internal to the daemon. Each tunable
+ * has a name like "qemu.stats-workers" and a set of parameters; thread
+ * pools have the same parameters as the thread pools of servers, file
+ * caches report the number of "entries", their "hits" and "misses". */
+
+int virAdmConnectGetTunables(virAdmConnectPtr conn,
+                             virTypedParameterPtr *params,
+                             int *nparams,
+                             unsigned int flags);
+
+int virAdmConnectSetTunables(virAdmConnectPtr conn,
+                             const char *name,
+                             virTypedParameterPtr params,
+                             int nparams,
+                             unsigned int flags);
+
 # ifdef __cplusplus
 }
 # endif
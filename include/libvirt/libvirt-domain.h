@@ -1065,6 +1065,29 @@ typedef enum {
  */
 # define VIR_MIGRATE_PARAM_TLS_DESTINATION          "tls.destination"
 
+/**
+ * VIR_MIGRATE_PARAM_TUNNEL_STREAMS:
+ *
+ * virDomainMigrate* params field: number of streams used for sending
+ * migration data during peer-to-peer tunnelled migration. Each stream
+ * uses its own connection to the destination libvirt daemon so that
+ * encrypting the data is spread over several threads. Defaults to 1.
+ * As VIR_TYPED_PARAM_INT.
+ */
+# define VIR_MIGRATE_PARAM_TUNNEL_STREAMS           "tunnel.streams"
+
+/**
+ * VIR_MIGRATE_PARAM_POSTCOPY_AUTO_DOWNTIME:
+ *
+ * virDomainMigrate* params field: downtime in milliseconds pre-copy
+ * migration is expected to reach. Once the transfer rate and the rate at
+ * which the domain dirties its memory predict that the remaining memory
+ * will not shrink below what can be sent within this time, the migration
+ * is switched to post-copy automatically. Requires VIR_MIGRATE_POSTCOPY.
+ * As VIR_TYPED_PARAM_ULLONG.
+ */
+# define VIR_MIGRATE_PARAM_POSTCOPY_AUTO_DOWNTIME   "postcopy.auto_downtime"
+
 /* Domain migration. */
 virDomainPtr virDomainMigrate (virDomainPtr domain, virConnectPtr dconn,
                                unsigned long flags, const char *dname,
@@ -1302,6 +1325,11 @@ int                 virDomainCoreDumpWithFormat (virDomainPtr domain,
 /*
  * Screenshot of current domain console
  */
+typedef enum {
+    VIR_DOMAIN_SCREENSHOT_IF_CHANGED = (1 << 0), /* send no image data if the
+                                                    screen has not changed */
+} virDomainScreenshotFlags;
+
 char *                  virDomainScreenshot     (virDomainPtr domain,
                                                  virStreamPtr stream,
                                                  unsigned int screen,
@@ -1718,6 +1746,13 @@ int                     virDomainBlockPeek (virDomainPtr dom,
                                             void *buffer,
                                             unsigned int flags);
 
+int                     virDomainBlockPeekStream(virDomainPtr dom,
+                                                 virStreamPtr stream,
+                                                 const char *disk,
+                                                 unsigned long long offset,
+                                                 unsigned long long length,
+                                                 unsigned int flags);
+
 /**
  * virDomainBlockResizeFlags:
  *
@@ -1796,6 +1831,12 @@ int                     virDomainMemoryPeek (virDomainPtr dom,
                                              void *buffer,
                                              unsigned int flags);
 
+int                     virDomainMemoryPeekStream(virDomainPtr dom,
+                                                  virStreamPtr stream,
+                                                  unsigned long long start,
+                                                  unsigned long long length,
+                                                  unsigned int flags);
+
 typedef enum {
     VIR_DOMAIN_DEFINE_VALIDATE = (1 << 0), /* Validate the XML document against schema */
 } virDomainDefineFlags;
@@ -2149,6 +2190,15 @@ int virDomainUpdateDeviceFlags(virDomainPtr domain,
 int virDomainDetachDeviceAlias(virDomainPtr domain,
                                const char *alias, unsigned int flags);
 
+int virDomainAttachDeviceList(virDomainPtr domain,
+                              const char **xmls,
+                              unsigned int nxmls,
+                              unsigned int flags);
+int virDomainDetachDeviceList(virDomainPtr domain,
+                              const char **xmls,
+                              unsigned int nxmls,
+                              unsigned int flags);
+
 typedef struct _virDomainStatsRecord virDomainStatsRecord;
 typedef virDomainStatsRecord *virDomainStatsRecordPtr;
 struct _virDomainStatsRecord {
@@ -2181,6 +2231,11 @@ typedef enum {
     VIR_CONNECT_GET_ALL_DOMAINS_STATS_SHUTOFF = VIR_CONNECT_LIST_DOMAINS_SHUTOFF,
     VIR_CONNECT_GET_ALL_DOMAINS_STATS_OTHER = VIR_CONNECT_LIST_DOMAINS_OTHER,
 
+    VIR_CONNECT_GET_ALL_DOMAINS_STATS_CACHED = 1 << 27, /* statistics may be
+                                                           served from cache */
+    VIR_CONNECT_GET_ALL_DOMAINS_STATS_PARALLEL = 1 << 28, /* collect statistics of
+                                                             multiple domains in
+                                                             parallel */
     VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT = 1 << 29, /* report statistics that can be obtained
                                                            immediately without any blocking */
     VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING = 1 << 30, /* include backing chain for block stats */
@@ -2199,6 +2254,27 @@ int virDomainListGetStats(virDomainPtr *doms,
 
 void virDomainStatsRecordListFree(virDomainStatsRecordPtr *stats);
 
+typedef struct _virDomainXMLRecord virDomainXMLRecord;
+typedef virDomainXMLRecord *virDomainXMLRecordPtr;
+struct _virDomainXMLRecord {
+    virDomainPtr dom;
+    int state;  /* virDomainState */
+    int reason; /* one of the virDomain*Reason enums for @state */
+    char *xml;
+};
+
+int virConnectGetAllDomainXML(virConnectPtr conn,
+                              unsigned int xmlflags,
+                              virDomainXMLRecordPtr **records,
+                              unsigned int flags);
+
+int virDomainListGetXML(virDomainPtr *doms,
+                        unsigned int xmlflags,
+                        virDomainXMLRecordPtr **records,
+                        unsigned int flags);
+
+void virDomainXMLRecordListFree(virDomainXMLRecordPtr *records);
+
 /*
  * Perf Event API
  */
@@ -3626,6 +3702,27 @@ typedef enum {
  */
 # define VIR_DOMAIN_JOB_DISK_TEMP_TOTAL "disk_temp_total"
 
+/**
+ * VIR_DOMAIN_JOB_TIME_PHASE_PREFIX:
+ *
+ * virDomainGetJobStats field prefix: the field name is this prefix followed
+ * by the name of a phase of the job, e.g., "time_phase_exec". The value is
+ * the time spent in that phase in microseconds as VIR_TYPED_PARAM_ULLONG.
+ * Which phases are reported depends on the hypervisor and the kind of job,
+ * phases which were not reached are omitted.
+ */
+# define VIR_DOMAIN_JOB_TIME_PHASE_PREFIX "time_phase_"
+
+/**
+ * VIR_DOMAIN_JOB_BANDWIDTH_SHARE:
+ *
+ * virDomainGetJobStats field: bandwidth in MiB/s an outgoing migration is
+ * currently limited to by the bandwidth set for all migrations of the host
+ * (see VIR_NODE_MIGRATION_BANDWIDTH), as VIR_TYPED_PARAM_ULLONG. Omitted
+ * when that does not limit the migration further than it asked for.
+ */
+# define VIR_DOMAIN_JOB_BANDWIDTH_SHARE "bandwidth_share"
+
 /**
  * virConnectDomainEventGenericCallback:
  * @conn: the connection pointer
@@ -4542,6 +4639,37 @@ typedef void (*virConnectDomainEventBlockThresholdCallback)(virConnectPtr conn,
                                                             unsigned long long excess,
                                                             void *opaque);
 
+/**
+ * virConnectDomainEventBlockJobProgressCallback:
+ * @conn: connection object
+ * @dom: domain on which the event occurred
+ * @disk: target name of the disk the job runs on, as in
+ *        VIR_DOMAIN_EVENT_ID_BLOCK_JOB_2
+ * @type: type of block job (virDomainBlockJobType)
+ * @cur: progress of the job, in the same units as in virDomainBlockJobInfo
+ * @end: value @cur is expected to reach for the job to be complete
+ * @bandwidth: bandwidth limit of the job in bytes/s, 0 if unlimited
+ * @opaque: application specified data
+ *
+ * The callback occurs periodically while a block job is running, so that
+ * the progress of the job can be tracked without calling
+ * virDomainGetBlockJobInfo repeatedly. The period depends on the
+ * hypervisor. The completion of the job is still reported by the
+ * VIR_DOMAIN_EVENT_ID_BLOCK_JOB_2 event.
+ *
+ * The callback signature to use when registering for an event of type
+ * VIR_DOMAIN_EVENT_ID_BLOCK_JOB_PROGRESS with
+ * virConnectDomainEventRegisterAny()
+ */
+typedef void (*virConnectDomainEventBlockJobProgressCallback)(virConnectPtr conn,
+                                                              virDomainPtr dom,
+                                                              const char *disk,
+                                                              int type,
+                                                              unsigned long long cur,
+                                                              unsigned long long end,
+                                                              unsigned long long bandwidth,
+                                                              void *opaque);
+
 /**
  * VIR_DOMAIN_EVENT_CALLBACK:
  *
@@ -4584,6 +4712,7 @@ typedef enum {
     VIR_DOMAIN_EVENT_ID_DEVICE_REMOVAL_FAILED = 22, /* virConnectDomainEventDeviceRemovalFailedCallback */
     VIR_DOMAIN_EVENT_ID_METADATA_CHANGE = 23, /* virConnectDomainEventMetadataChangeCallback */
     VIR_DOMAIN_EVENT_ID_BLOCK_THRESHOLD = 24, /* virConnectDomainEventBlockThresholdCallback */
+    VIR_DOMAIN_EVENT_ID_BLOCK_JOB_PROGRESS = 25, /* virConnectDomainEventBlockJobProgressCallback */
 
 # ifdef VIR_ENUM_SENTINELS
     VIR_DOMAIN_EVENT_ID_LAST
@@ -4967,6 +5096,16 @@ int virDomainGetGuestInfo(virDomainPtr domain,
                           int *nparams,
                           unsigned int flags);
 
+int virConnectGetAllDomainGuestInfo(virConnectPtr conn,
+                                    unsigned int types,
+                                    virDomainStatsRecordPtr **retInfo,
+                                    unsigned int flags);
+
+int virDomainListGetGuestInfo(virDomainPtr *doms,
+                              unsigned int types,
+                              virDomainStatsRecordPtr **retInfo,
+                              unsigned int flags);
+
 typedef enum {
     VIR_DOMAIN_AGENT_RESPONSE_TIMEOUT_BLOCK = -2,
     VIR_DOMAIN_AGENT_RESPONSE_TIMEOUT_DEFAULT = -1,
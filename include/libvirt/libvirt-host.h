@@ -391,6 +391,56 @@ int virNodeSetMemoryParameters(virConnectPtr conn,
                                int nparams,
                                unsigned int flags);
 
+/* node migration parameters */
+
+/**
+ * VIR_NODE_MIGRATION_MAX_JOBS:
+ *
+ * Macro for typed parameter that represents the maximum number of
+ * outgoing migrations running at the same time, further migrations
+ * wait until one of them finishes. The parameter has type unsigned
+ * int, 0 means no limit.
+ */
+# define VIR_NODE_MIGRATION_MAX_JOBS "max_jobs"
+
+/**
+ * VIR_NODE_MIGRATION_BANDWIDTH:
+ *
+ * Macro for typed parameter that represents the bandwidth in MiB/s
+ * all outgoing migrations use together. It is split evenly among the
+ * running migrations, except that none gets more than it asked for.
+ * The parameter has type unsigned long long, 0 means no limit.
+ */
+# define VIR_NODE_MIGRATION_BANDWIDTH "bandwidth"
+
+/**
+ * VIR_NODE_MIGRATION_ACTIVE:
+ *
+ * Macro for read-only typed parameter that represents the number of
+ * outgoing migrations currently running. The parameter has type
+ * unsigned int.
+ */
+# define VIR_NODE_MIGRATION_ACTIVE "active"
+
+/**
+ * VIR_NODE_MIGRATION_QUEUED:
+ *
+ * Macro for read-only typed parameter that represents the number of
+ * outgoing migrations waiting for one of the running ones to finish.
+ * The parameter has type unsigned int.
+ */
+# define VIR_NODE_MIGRATION_QUEUED "queued"
+
+int virNodeGetMigrationParameters(virConnectPtr conn,
+                                  virTypedParameterPtr *params,
+                                  int *nparams,
+                                  unsigned int flags);
+
+int virNodeSetMigrationParameters(virConnectPtr conn,
+                                  virTypedParameterPtr params,
+                                  int nparams,
+                                  unsigned int flags);
+
 /*
  *  node CPU map
  */
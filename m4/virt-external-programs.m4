@@ -98,6 +98,15 @@ AC_DEFUN([LIBVIRT_CHECK_EXTERNAL_PROGRAMS], [
   AC_PATH_PROG([IP6TABLES_PATH], [ip6tables], [/sbin/ip6tables], [$LIBVIRT_SBIN_PATH])
   AC_DEFINE_UNQUOTED([IP6TABLES_PATH], ["$IP6TABLES_PATH"], [path to ip6tables binary])
 
+  AC_PATH_PROG([IPTABLES_RESTORE_PATH], [iptables-restore], [/sbin/iptables-restore], [$LIBVIRT_SBIN_PATH])
+  AC_DEFINE_UNQUOTED([IPTABLES_RESTORE_PATH], ["$IPTABLES_RESTORE_PATH"], [path to iptables-restore binary])
+
+  AC_PATH_PROG([IP6TABLES_RESTORE_PATH], [ip6tables-restore], [/sbin/ip6tables-restore], [$LIBVIRT_SBIN_PATH])
+  AC_DEFINE_UNQUOTED([IP6TABLES_RESTORE_PATH], ["$IP6TABLES_RESTORE_PATH"], [path to ip6tables-restore binary])
+
   AC_PATH_PROG([EBTABLES_PATH], [ebtables], [/sbin/ebtables], [$LIBVIRT_SBIN_PATH])
   AC_DEFINE_UNQUOTED([EBTABLES_PATH], ["$EBTABLES_PATH"], [path to ebtables binary])
+
+  AC_PATH_PROG([NFT_PATH], [nft], [/usr/sbin/nft], [$LIBVIRT_SBIN_PATH])
+  AC_DEFINE_UNQUOTED([NFT_PATH], ["$NFT_PATH"], [path to nft binary])
 ])
@@ -0,0 +1,30 @@
+dnl The lock statistics check
+dnl
+dnl This library is free software; you can redistribute it and/or
+dnl modify it under the terms of the GNU Lesser General Public
+dnl License as published by the Free Software Foundation; either
+dnl version 2.1 of the License, or (at your option) any later version.
+dnl
+dnl This library is distributed in the hope that it will be useful,
+dnl but WITHOUT ANY WARRANTY; without even the implied warranty of
+dnl MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+dnl Lesser General Public License for more details.
+dnl
+dnl You should have received a copy of the GNU Lesser General Public
+dnl License along with this library.  If not, see
+dnl <http://www.gnu.org/licenses/>.
+dnl
+
+AC_DEFUN([LIBVIRT_ARG_LOCK_STATS], [
+  LIBVIRT_ARG_ENABLE([LOCK_STATS], [collect mutex contention statistics], [no])
+])
+
+AC_DEFUN([LIBVIRT_CHECK_LOCK_STATS], [
+  if test x"$enable_lock_stats" = x"yes"; then
+    AC_DEFINE([WITH_LOCK_STATS], [1], [whether mutex contention statistics are collected])
+  fi
+])
+
+AC_DEFUN([LIBVIRT_RESULT_LOCK_STATS], [
+  LIBVIRT_RESULT([Lock statistics], [$enable_lock_stats])
+])
@@ -60,6 +60,7 @@ for drvfile in drvfiles:
                     "virDrvDomainMigratePrepareTunnelParams",
                     "virDrvDomainMigratePrepareTunnel3",
                     "virDrvDomainMigratePrepareTunnel3Params",
+                    "virDrvDomainMigratePrepareTunnelStripe",
                     "virDrvDomainMigratePerform",
                     "virDrvDomainMigratePerform3",
                     "virDrvDomainMigratePerform3Params",
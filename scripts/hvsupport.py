@@ -216,6 +216,10 @@ apis["virDomainMigrateConfirm3Params"] = {
     "vers": "1.1.0"
 }
 
+apis["virDomainMigratePrepareTunnelStripe"] = {
+    "vers": "6.2.0"
+}
+
 
 # Now we want to get the mapping between public APIs
 # and driver struct fields. This lets us later match
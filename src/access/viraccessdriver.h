@@ -30,6 +30,12 @@ typedef int (*virAccessDriverCheckDomainDrv)(virAccessManagerPtr manager,
                                              const char *driverName,
                                              virDomainDefPtr domain,
                                              virAccessPermDomain av);
+typedef int (*virAccessDriverCheckDomainsDrv)(virAccessManagerPtr manager,
+                                              const char *driverName,
+                                              virDomainDefPtr *domains,
+                                              size_t ndomains,
+                                              virAccessPermDomain av,
+                                              virBitmapPtr allowed);
 typedef int (*virAccessDriverCheckInterfaceDrv)(virAccessManagerPtr manager,
                                                 const char *driverName,
                                                 virInterfaceDefPtr iface,
@@ -84,6 +90,8 @@ struct _virAccessDriver {
 
     virAccessDriverCheckConnectDrv checkConnect;
     virAccessDriverCheckDomainDrv checkDomain;
+    /* Optional, checkDomain is used for each domain otherwise */
+    virAccessDriverCheckDomainsDrv checkDomains;
     virAccessDriverCheckInterfaceDrv checkInterface;
     virAccessDriverCheckNetworkDrv checkNetwork;
     virAccessDriverCheckNetworkPortDrv checkNetworkPort;
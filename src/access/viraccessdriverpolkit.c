@@ -20,14 +20,19 @@
 
 #include <config.h>
 
+#include <sys/stat.h>
+
 #include "viraccessdriverpolkit.h"
 #include "viralloc.h"
+#include "virbuffer.h"
 #include "vircommand.h"
+#include "virhash.h"
 #include "virlog.h"
 #include "virprocess.h"
 #include "virerror.h"
 #include "virpolkit.h"
 #include "virstring.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_ACCESS
 
@@ -39,16 +44,159 @@ VIR_LOG_INIT("access.accessdriverpolkit");
 
 #define VIR_ACCESS_DRIVER_POLKIT_ACTION_PREFIX "org.libvirt.api"
 
+/* How long decisions of polkit are reused, in microseconds */
+#define VIR_ACCESS_DRIVER_POLKIT_CACHE_TTL (5 * 1000 * 1000)
+/* Bound on the cached decisions, the cache is flushed when reached */
+#define VIR_ACCESS_DRIVER_POLKIT_CACHE_MAX 10000
+
+/* Changes to any of these may change the decisions of polkit */
+static const char *virAccessDriverPolkitRulesDirs[] = {
+    "/etc/polkit-1/rules.d",
+    "/usr/share/polkit-1/rules.d",
+};
+
 typedef struct _virAccessDriverPolkitPrivate virAccessDriverPolkitPrivate;
 typedef virAccessDriverPolkitPrivate *virAccessDriverPolkitPrivatePtr;
 
 struct _virAccessDriverPolkitPrivate {
     bool ignore;
+
+    virMutex lock;
+    /* Decisions keyed by caller, action and attributes, see
+     * virAccessDriverPolkitCacheKey */
+    virHashTablePtr cache;
+    /* Latest change of the rules the cached decisions are based on */
+    long long rulesStamp;
 };
 
+typedef struct _virAccessDriverPolkitDecision virAccessDriverPolkitDecision;
+typedef virAccessDriverPolkitDecision *virAccessDriverPolkitDecisionPtr;
+
+struct _virAccessDriverPolkitDecision {
+    bool allowed;
+    long long expires;
+};
+
+
+static int virAccessDriverPolkitSetup(virAccessManagerPtr manager)
+{
+    virAccessDriverPolkitPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+
+    if (virMutexInit(&priv->lock) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init mutex"));
+        return -1;
+    }
+
+    if (!(priv->cache = virHashCreate(100, virHashValueFree))) {
+        virMutexDestroy(&priv->lock);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static void virAccessDriverPolkitCleanup(virAccessManagerPtr manager)
+{
+    virAccessDriverPolkitPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+
+    virHashFree(priv->cache);
+    virMutexDestroy(&priv->lock);
+}
+
+
+static char *
+virAccessDriverPolkitCacheKey(const char *actionid,
+                              pid_t pid,
+                              unsigned long long startTime,
+                              uid_t uid,
+                              const char **attrs)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    size_t i;
+
+    virBufferAsprintf(&buf, "%lld:%llu:%d:%s",
+                      (long long)pid, startTime, (int)uid, actionid);
+
+    for (i = 0; attrs && attrs[i]; i++)
+        virBufferAsprintf(&buf, "%c%s", i % 2 ? '=' : '\n', attrs[i]);
+
+    return virBufferContentAndReset(&buf);
+}
+
 
-static void virAccessDriverPolkitCleanup(virAccessManagerPtr manager G_GNUC_UNUSED)
+/* Returns the time of the latest change of the polkit rules */
+static long long
+virAccessDriverPolkitRulesStamp(void)
 {
+    long long stamp = 0;
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS(virAccessDriverPolkitRulesDirs); i++) {
+        struct stat sb;
+
+        if (stat(virAccessDriverPolkitRulesDirs[i], &sb) < 0)
+            continue;
+
+        stamp = MAX(stamp, (long long)sb.st_mtime * 1000 * 1000 * 1000 +
+                    sb.st_mtim.tv_nsec);
+    }
+
+    return stamp;
+}
+
+
+/*
+ * Looks up a decision of polkit made recently, dropping all of them
+ * if the rules changed since. Returns 1 if allowed, 0 if denied and
+ * -1 if there's no such decision.
+ */
+static int
+virAccessDriverPolkitCacheLookup(virAccessDriverPolkitPrivatePtr priv,
+                                 const char *key)
+{
+    virAccessDriverPolkitDecisionPtr decision;
+    long long stamp = virAccessDriverPolkitRulesStamp();
+    int ret = -1;
+
+    virMutexLock(&priv->lock);
+
+    if (stamp != priv->rulesStamp) {
+        virHashRemoveAll(priv->cache);
+        priv->rulesStamp = stamp;
+    }
+
+    if ((decision = virHashLookup(priv->cache, key))) {
+        if (decision->expires > g_get_monotonic_time())
+            ret = decision->allowed ? 1 : 0;
+        else
+            virHashRemoveEntry(priv->cache, key);
+    }
+
+    virMutexUnlock(&priv->lock);
+    return ret;
+}
+
+
+static void
+virAccessDriverPolkitCacheAdd(virAccessDriverPolkitPrivatePtr priv,
+                              const char *key,
+                              bool allowed)
+{
+    virAccessDriverPolkitDecisionPtr decision = g_new0(virAccessDriverPolkitDecision, 1);
+
+    decision->allowed = allowed;
+    decision->expires = g_get_monotonic_time() + VIR_ACCESS_DRIVER_POLKIT_CACHE_TTL;
+
+    virMutexLock(&priv->lock);
+
+    if (virHashSize(priv->cache) >= VIR_ACCESS_DRIVER_POLKIT_CACHE_MAX)
+        virHashRemoveAll(priv->cache);
+
+    if (virHashUpdateEntry(priv->cache, key, decision) < 0)
+        VIR_FREE(decision);
+
+    virMutexUnlock(&priv->lock);
 }
 
 
@@ -118,29 +266,27 @@ virAccessDriverPolkitGetCaller(const char *actionid,
 
 
 static int
-virAccessDriverPolkitCheck(virAccessManagerPtr manager G_GNUC_UNUSED,
-                           const char *typename,
-                           const char *permname,
-                           const char **attrs)
+virAccessDriverPolkitCheckCaller(virAccessDriverPolkitPrivatePtr priv,
+                                 const char *actionid,
+                                 pid_t pid,
+                                 unsigned long long startTime,
+                                 uid_t uid,
+                                 const char **attrs)
 {
-    g_autofree char *actionid = NULL;
-    pid_t pid;
-    uid_t uid;
-    unsigned long long startTime;
+    g_autofree char *key = NULL;
     int rv;
 
-    if (!(actionid = virAccessDriverPolkitFormatAction(typename, permname)))
-        return -1;
-
-    if (virAccessDriverPolkitGetCaller(actionid,
-                                       &pid,
-                                       &startTime,
-                                       &uid) < 0)
-        return -1;
-
     VIR_DEBUG("Check action '%s' for process '%lld' time %lld uid %d",
               actionid, (long long)pid, startTime, uid);
 
+    /* Listing objects with ACL filtering checks each one of them, so
+     * ask polkitd only once in a while for the same question */
+    key = virAccessDriverPolkitCacheKey(actionid, pid, startTime, uid, attrs);
+    if ((rv = virAccessDriverPolkitCacheLookup(priv, key)) >= 0) {
+        VIR_DEBUG("Reusing decision %d for action '%s'", rv, actionid);
+        return rv;
+    }
+
     rv = virPolkitCheckAuth(actionid,
                             pid,
                             startTime,
@@ -149,9 +295,11 @@ virAccessDriverPolkitCheck(virAccessManagerPtr manager G_GNUC_UNUSED,
                             false);
 
     if (rv == 0) {
+        virAccessDriverPolkitCacheAdd(priv, key, true);
         return 1; /* Allowed */
     } else {
         if (rv == -2) {
+            virAccessDriverPolkitCacheAdd(priv, key, false);
             return 0; /* Denied */
         } else {
             return -1; /* Error */
@@ -160,6 +308,32 @@ virAccessDriverPolkitCheck(virAccessManagerPtr manager G_GNUC_UNUSED,
 }
 
 
+static int
+virAccessDriverPolkitCheck(virAccessManagerPtr manager,
+                           const char *typename,
+                           const char *permname,
+                           const char **attrs)
+{
+    virAccessDriverPolkitPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+    g_autofree char *actionid = NULL;
+    pid_t pid;
+    uid_t uid;
+    unsigned long long startTime;
+
+    if (!(actionid = virAccessDriverPolkitFormatAction(typename, permname)))
+        return -1;
+
+    if (virAccessDriverPolkitGetCaller(actionid,
+                                       &pid,
+                                       &startTime,
+                                       &uid) < 0)
+        return -1;
+
+    return virAccessDriverPolkitCheckCaller(priv, actionid,
+                                            pid, startTime, uid, attrs);
+}
+
+
 static int
 virAccessDriverPolkitCheckConnect(virAccessManagerPtr manager,
                                   const char *driverName,
@@ -197,6 +371,62 @@ virAccessDriverPolkitCheckDomain(virAccessManagerPtr manager,
                                       attrs);
 }
 
+/* Same as virAccessDriverPolkitCheckDomain for many domains, looking
+ * up the caller and the action only once */
+static int
+virAccessDriverPolkitCheckDomains(virAccessManagerPtr manager,
+                                  const char *driverName,
+                                  virDomainDefPtr *domains,
+                                  size_t ndomains,
+                                  virAccessPermDomain perm,
+                                  virBitmapPtr allowed)
+{
+    virAccessDriverPolkitPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+    g_autofree char *actionid = NULL;
+    pid_t pid;
+    uid_t uid;
+    unsigned long long startTime;
+    size_t i;
+
+    actionid = virAccessDriverPolkitFormatAction("domain",
+                                                 virAccessPermDomainTypeToString(perm));
+
+    if (virAccessDriverPolkitGetCaller(actionid,
+                                       &pid,
+                                       &startTime,
+                                       &uid) < 0)
+        return -1;
+
+    for (i = 0; i < ndomains; i++) {
+        char uuidstr[VIR_UUID_STRING_BUFLEN];
+        const char *attrs[] = {
+            "connect_driver", driverName,
+            "domain_name", domains[i]->name,
+            "domain_uuid", uuidstr,
+            NULL,
+        };
+        int rv;
+
+        if (!virBitmapIsBitSet(allowed, i))
+            continue;
+
+        virUUIDFormat(domains[i]->uuid, uuidstr);
+
+        if ((rv = virAccessDriverPolkitCheckCaller(priv, actionid,
+                                                   pid, startTime, uid,
+                                                   attrs)) < 0)
+            return -1;
+
+        /* Denials report an error which doesn't matter to the batch */
+        if (rv == 0) {
+            virResetLastError();
+            ignore_value(virBitmapClearBit(allowed, i));
+        }
+    }
+
+    return 0;
+}
+
 static int
 virAccessDriverPolkitCheckInterface(virAccessManagerPtr manager,
                                     const char *driverName,
@@ -447,9 +677,11 @@ virAccessDriverPolkitCheckStorageVol(virAccessManagerPtr manager,
 virAccessDriver accessDriverPolkit = {
     .privateDataLen = sizeof(virAccessDriverPolkitPrivate),
     .name = "polkit",
+    .setup = virAccessDriverPolkitSetup,
     .cleanup = virAccessDriverPolkitCleanup,
     .checkConnect = virAccessDriverPolkitCheckConnect,
     .checkDomain = virAccessDriverPolkitCheckDomain,
+    .checkDomains = virAccessDriverPolkitCheckDomains,
     .checkInterface = virAccessDriverPolkitCheckInterface,
     .checkNetwork = virAccessDriverPolkitCheckNetwork,
     .checkNetworkPort = virAccessDriverPolkitCheckNetworkPort,
@@ -105,6 +105,27 @@ virAccessDriverStackCheckDomain(virAccessManagerPtr manager,
     return ret;
 }
 
+static int
+virAccessDriverStackCheckDomains(virAccessManagerPtr manager,
+                                 const char *driverName,
+                                 virDomainDefPtr *domains,
+                                 size_t ndomains,
+                                 virAccessPermDomain perm,
+                                 virBitmapPtr allowed)
+{
+    virAccessDriverStackPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+    size_t i;
+
+    /* Each driver only clears the bits of the domains it denies */
+    for (i = 0; i < priv->managersLen; i++) {
+        if (virAccessManagerCheckDomains(priv->managers[i], driverName,
+                                         domains, ndomains, perm, allowed) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
 static int
 virAccessDriverStackCheckInterface(virAccessManagerPtr manager,
                                    const char *driverName,
@@ -320,6 +341,7 @@ virAccessDriver accessDriverStack = {
     .cleanup = virAccessDriverStackCleanup,
     .checkConnect = virAccessDriverStackCheckConnect,
     .checkDomain = virAccessDriverStackCheckDomain,
+    .checkDomains = virAccessDriverStackCheckDomains,
     .checkInterface = virAccessDriverStackCheckInterface,
     .checkNetwork = virAccessDriverStackCheckNetwork,
     .checkNetworkPort = virAccessDriverStackCheckNetworkPort,
@@ -244,6 +244,59 @@ int virAccessManagerCheckDomain(virAccessManagerPtr manager,
     return virAccessManagerSanitizeError(ret, driverName);
 }
 
+/**
+ * virAccessManagerCheckDomains:
+ * @manager: the access manager
+ * @driverName: name of the hypervisor driver
+ * @domains: the domains to check
+ * @ndomains: number of @domains
+ * @perm: the permission to check
+ * @allowed: bitmap of @ndomains bits
+ *
+ * Checks @perm for all @domains whose bit is set in @allowed at once,
+ * clearing the bits of those denied it. This is much cheaper than
+ * checking each of them separately with drivers which have to ask
+ * someone else for the answer.
+ *
+ * Returns 0 on success, -1 on error, in which case the state of the
+ * bits in @allowed is undefined.
+ */
+int virAccessManagerCheckDomains(virAccessManagerPtr manager,
+                                 const char *driverName,
+                                 virDomainDefPtr *domains,
+                                 size_t ndomains,
+                                 virAccessPermDomain perm,
+                                 virBitmapPtr allowed)
+{
+    int ret = 0;
+    size_t i;
+
+    VIR_DEBUG("manager=%p(name=%s) driver=%s ndomains=%zu perm=%d",
+              manager, manager->drv->name, driverName, ndomains, perm);
+
+    if (manager->drv->checkDomains) {
+        ret = manager->drv->checkDomains(manager, driverName,
+                                         domains, ndomains, perm, allowed);
+        return virAccessManagerSanitizeError(ret, driverName);
+    }
+
+    if (!manager->drv->checkDomain)
+        return 0;
+
+    for (i = 0; i < ndomains; i++) {
+        if (!virBitmapIsBitSet(allowed, i))
+            continue;
+
+        ret = manager->drv->checkDomain(manager, driverName, domains[i], perm);
+        if (ret < 0)
+            return virAccessManagerSanitizeError(ret, driverName);
+        if (ret == 0)
+            ignore_value(virBitmapClearBit(allowed, i));
+    }
+
+    return 0;
+}
+
 int virAccessManagerCheckInterface(virAccessManagerPtr manager,
                                    const char *driverName,
                                    virInterfaceDefPtr iface,
@@ -21,6 +21,7 @@
 #pragma once
 
 #include "viridentity.h"
+#include "virbitmap.h"
 #include "conf/domain_conf.h"
 #include "conf/network_conf.h"
 #include "conf/nwfilter_conf.h"
@@ -58,6 +59,12 @@ int virAccessManagerCheckDomain(virAccessManagerPtr manager,
                                 const char *driverName,
                                 virDomainDefPtr domain,
                                 virAccessPermDomain perm);
+int virAccessManagerCheckDomains(virAccessManagerPtr manager,
+                                 const char *driverName,
+                                 virDomainDefPtr *domains,
+                                 size_t ndomains,
+                                 virAccessPermDomain perm,
+                                 virBitmapPtr allowed);
 int virAccessManagerCheckInterface(virAccessManagerPtr manager,
                                    const char *driverName,
                                    virInterfaceDefPtr iface,
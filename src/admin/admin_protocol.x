@@ -43,6 +43,24 @@ const ADMIN_CLIENT_LIST_MAX = 16384;
 /* Upper limit on number of client info parameters */
 const ADMIN_CLIENT_INFO_PARAMETERS_MAX = 64;
 
+/* Upper limit on number of reconnect info parameters */
+const ADMIN_CONNECT_RECONNECT_INFO_PARAMETERS_MAX = 16;
+
+/* Upper limit on number of object stats parameters */
+const ADMIN_CONNECT_OBJECT_STATS_PARAMETERS_MAX = 4096;
+
+/* Upper limit on number of lock stats parameters */
+const ADMIN_CONNECT_LOCK_STATS_PARAMETERS_MAX = 4096;
+
+/* Upper limit on number of procedure stats parameters */
+const ADMIN_SERVER_PROCEDURE_STATS_PARAMETERS_MAX = 32768;
+
+/* Upper limit on number of capture parameters */
+const ADMIN_SERVER_CAPTURE_PARAMETERS_MAX = 16;
+
+/* Upper limit on number of tunables parameters */
+const ADMIN_CONNECT_TUNABLES_PARAMETERS_MAX = 1024;
+
 /* Upper limit on number of client processing controls */
 const ADMIN_SERVER_CLIENT_LIMITS_MAX = 32;
 
@@ -214,6 +232,59 @@ struct admin_connect_set_logging_filters_args {
     unsigned int flags;
 };
 
+struct admin_connect_get_reconnect_info_args {
+    unsigned int flags;
+};
+
+struct admin_connect_get_reconnect_info_ret {
+    admin_typed_param params<ADMIN_CONNECT_RECONNECT_INFO_PARAMETERS_MAX>;
+};
+
+struct admin_connect_get_object_stats_args {
+    unsigned int flags;
+};
+
+struct admin_connect_get_object_stats_ret {
+    admin_typed_param params<ADMIN_CONNECT_OBJECT_STATS_PARAMETERS_MAX>;
+};
+
+struct admin_connect_get_lock_stats_args {
+    unsigned int flags;
+};
+
+struct admin_connect_get_lock_stats_ret {
+    admin_typed_param params<ADMIN_CONNECT_LOCK_STATS_PARAMETERS_MAX>;
+};
+
+struct admin_server_get_procedure_stats_args {
+    admin_nonnull_server srv;
+    unsigned int flags;
+};
+
+struct admin_server_get_procedure_stats_ret {
+    admin_typed_param params<ADMIN_SERVER_PROCEDURE_STATS_PARAMETERS_MAX>;
+};
+
+struct admin_server_set_capture_args {
+    admin_nonnull_server srv;
+    admin_typed_param params<ADMIN_SERVER_CAPTURE_PARAMETERS_MAX>;
+    unsigned int flags;
+};
+
+struct admin_connect_get_tunables_args {
+    unsigned int flags;
+};
+
+struct admin_connect_get_tunables_ret {
+    admin_typed_param params<ADMIN_CONNECT_TUNABLES_PARAMETERS_MAX>;
+};
+
+struct admin_connect_set_tunables_args {
+    admin_nonnull_string name;
+    admin_typed_param params<ADMIN_CONNECT_TUNABLES_PARAMETERS_MAX>;
+    unsigned int flags;
+};
+
 /* Define the program number, protocol version and procedure numbers here. */
 const ADMIN_PROGRAM = 0x06900690;
 const ADMIN_PROTOCOL_VERSION = 1;
@@ -324,5 +395,40 @@ enum admin_procedure {
     /**
      * @generate: both
      */
-    ADMIN_PROC_SERVER_UPDATE_TLS_FILES = 18
+    ADMIN_PROC_SERVER_UPDATE_TLS_FILES = 18,
+
+    /**
+     * @generate: none
+     */
+    ADMIN_PROC_CONNECT_GET_RECONNECT_INFO = 19,
+
+    /**
+     * @generate: none
+     */
+    ADMIN_PROC_CONNECT_GET_OBJECT_STATS = 20,
+
+    /**
+     * @generate: none
+     */
+    ADMIN_PROC_CONNECT_GET_LOCK_STATS = 21,
+
+    /**
+     * @generate: none
+     */
+    ADMIN_PROC_SERVER_GET_PROCEDURE_STATS = 22,
+
+    /**
+     * @generate: none
+     */
+    ADMIN_PROC_SERVER_SET_CAPTURE = 23,
+
+    /**
+     * @generate: none
+     */
+    ADMIN_PROC_CONNECT_GET_TUNABLES = 24,
+
+    /**
+     * @generate: none
+     */
+    ADMIN_PROC_CONNECT_SET_TUNABLES = 25
 };
@@ -495,3 +495,259 @@ remoteAdminConnectGetLoggingFilters(virAdmConnectPtr conn,
     virObjectUnlock(priv);
     return rv;
 }
+
+static int
+remoteAdminConnectGetReconnectInfo(virAdmConnectPtr conn,
+                                   virTypedParameterPtr *params,
+                                   int *nparams,
+                                   unsigned int flags)
+{
+    int rv = -1;
+    remoteAdminPrivPtr priv = conn->privateData;
+    admin_connect_get_reconnect_info_args args;
+    admin_connect_get_reconnect_info_ret ret;
+
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+    virObjectLock(priv);
+
+    if (call(conn, 0, ADMIN_PROC_CONNECT_GET_RECONNECT_INFO,
+             (xdrproc_t)xdr_admin_connect_get_reconnect_info_args, (char *) &args,
+             (xdrproc_t)xdr_admin_connect_get_reconnect_info_ret, (char *) &ret) == -1)
+        goto cleanup;
+
+    if (virTypedParamsDeserialize((virTypedParameterRemotePtr) ret.params.params_val,
+                                  ret.params.params_len,
+                                  ADMIN_CONNECT_RECONNECT_INFO_PARAMETERS_MAX,
+                                  params,
+                                  nparams) < 0)
+        goto cleanup;
+
+    rv = 0;
+    xdr_free((xdrproc_t)xdr_admin_connect_get_reconnect_info_ret, (char *) &ret);
+
+ cleanup:
+    virObjectUnlock(priv);
+    return rv;
+}
+
+static int
+remoteAdminConnectGetObjectStats(virAdmConnectPtr conn,
+                                 virTypedParameterPtr *params,
+                                 int *nparams,
+                                 unsigned int flags)
+{
+    int rv = -1;
+    remoteAdminPrivPtr priv = conn->privateData;
+    admin_connect_get_object_stats_args args;
+    admin_connect_get_object_stats_ret ret;
+
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+    virObjectLock(priv);
+
+    if (call(conn, 0, ADMIN_PROC_CONNECT_GET_OBJECT_STATS,
+             (xdrproc_t)xdr_admin_connect_get_object_stats_args, (char *) &args,
+             (xdrproc_t)xdr_admin_connect_get_object_stats_ret, (char *) &ret) == -1)
+        goto cleanup;
+
+    if (virTypedParamsDeserialize((virTypedParameterRemotePtr) ret.params.params_val,
+                                  ret.params.params_len,
+                                  ADMIN_CONNECT_OBJECT_STATS_PARAMETERS_MAX,
+                                  params,
+                                  nparams) < 0)
+        goto cleanup;
+
+    rv = 0;
+    xdr_free((xdrproc_t)xdr_admin_connect_get_object_stats_ret, (char *) &ret);
+
+ cleanup:
+    virObjectUnlock(priv);
+    return rv;
+}
+
+static int
+remoteAdminConnectGetLockStats(virAdmConnectPtr conn,
+                               virTypedParameterPtr *params,
+                               int *nparams,
+                               unsigned int flags)
+{
+    int rv = -1;
+    remoteAdminPrivPtr priv = conn->privateData;
+    admin_connect_get_lock_stats_args args;
+    admin_connect_get_lock_stats_ret ret;
+
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+    virObjectLock(priv);
+
+    if (call(conn, 0, ADMIN_PROC_CONNECT_GET_LOCK_STATS,
+             (xdrproc_t)xdr_admin_connect_get_lock_stats_args, (char *) &args,
+             (xdrproc_t)xdr_admin_connect_get_lock_stats_ret, (char *) &ret) == -1)
+        goto cleanup;
+
+    if (virTypedParamsDeserialize((virTypedParameterRemotePtr) ret.params.params_val,
+                                  ret.params.params_len,
+                                  ADMIN_CONNECT_LOCK_STATS_PARAMETERS_MAX,
+                                  params,
+                                  nparams) < 0)
+        goto cleanup;
+
+    rv = 0;
+    xdr_free((xdrproc_t)xdr_admin_connect_get_lock_stats_ret, (char *) &ret);
+
+ cleanup:
+    virObjectUnlock(priv);
+    return rv;
+}
+
+static int
+remoteAdminServerGetProcedureStats(virAdmServerPtr srv,
+                                   virTypedParameterPtr *params,
+                                   int *nparams,
+                                   unsigned int flags)
+{
+    int rv = -1;
+    admin_server_get_procedure_stats_args args;
+    admin_server_get_procedure_stats_ret ret;
+    remoteAdminPrivPtr priv = srv->conn->privateData;
+    args.flags = flags;
+    make_nonnull_server(&args.srv, srv);
+
+    memset(&ret, 0, sizeof(ret));
+    virObjectLock(priv);
+
+    if (call(srv->conn, 0, ADMIN_PROC_SERVER_GET_PROCEDURE_STATS,
+             (xdrproc_t) xdr_admin_server_get_procedure_stats_args,
+             (char *) &args,
+             (xdrproc_t) xdr_admin_server_get_procedure_stats_ret,
+             (char *) &ret) == -1)
+        goto cleanup;
+
+    if (virTypedParamsDeserialize((virTypedParameterRemotePtr) ret.params.params_val,
+                                  ret.params.params_len,
+                                  ADMIN_SERVER_PROCEDURE_STATS_PARAMETERS_MAX,
+                                  params,
+                                  nparams) < 0)
+        goto cleanup;
+
+    rv = 0;
+    xdr_free((xdrproc_t) xdr_admin_server_get_procedure_stats_ret,
+             (char *) &ret);
+
+ cleanup:
+    virObjectUnlock(priv);
+    return rv;
+}
+
+static int
+remoteAdminServerSetCapture(virAdmServerPtr srv,
+                            virTypedParameterPtr params,
+                            int nparams,
+                            unsigned int flags)
+{
+    int rv = -1;
+    admin_server_set_capture_args args;
+    remoteAdminPrivPtr priv = srv->conn->privateData;
+
+    args.flags = flags;
+    make_nonnull_server(&args.srv, srv);
+
+    virObjectLock(priv);
+
+    if (virTypedParamsSerialize(params, nparams,
+                                ADMIN_SERVER_CAPTURE_PARAMETERS_MAX,
+                                (virTypedParameterRemotePtr *) &args.params.params_val,
+                                &args.params.params_len,
+                                0) < 0)
+        goto cleanup;
+
+    if (call(srv->conn, 0, ADMIN_PROC_SERVER_SET_CAPTURE,
+             (xdrproc_t) xdr_admin_server_set_capture_args,
+             (char *) &args,
+             (xdrproc_t) xdr_void, (char *) NULL) == -1)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    virTypedParamsRemoteFree((virTypedParameterRemotePtr) args.params.params_val,
+                             args.params.params_len);
+    virObjectUnlock(priv);
+    return rv;
+}
+
+static int
+remoteAdminConnectGetTunables(virAdmConnectPtr conn,
+                              virTypedParameterPtr *params,
+                              int *nparams,
+                              unsigned int flags)
+{
+    int rv = -1;
+    remoteAdminPrivPtr priv = conn->privateData;
+    admin_connect_get_tunables_args args;
+    admin_connect_get_tunables_ret ret;
+
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+    virObjectLock(priv);
+
+    if (call(conn, 0, ADMIN_PROC_CONNECT_GET_TUNABLES,
+             (xdrproc_t)xdr_admin_connect_get_tunables_args, (char *) &args,
+             (xdrproc_t)xdr_admin_connect_get_tunables_ret, (char *) &ret) == -1)
+        goto cleanup;
+
+    if (virTypedParamsDeserialize((virTypedParameterRemotePtr) ret.params.params_val,
+                                  ret.params.params_len,
+                                  ADMIN_CONNECT_TUNABLES_PARAMETERS_MAX,
+                                  params,
+                                  nparams) < 0)
+        goto cleanup;
+
+    rv = 0;
+    xdr_free((xdrproc_t)xdr_admin_connect_get_tunables_ret, (char *) &ret);
+
+ cleanup:
+    virObjectUnlock(priv);
+    return rv;
+}
+
+static int
+remoteAdminConnectSetTunables(virAdmConnectPtr conn,
+                              const char *name,
+                              virTypedParameterPtr params,
+                              int nparams,
+                              unsigned int flags)
+{
+    int rv = -1;
+    admin_connect_set_tunables_args args;
+    remoteAdminPrivPtr priv = conn->privateData;
+
+    args.name = (char *) name;
+    args.flags = flags;
+
+    virObjectLock(priv);
+
+    if (virTypedParamsSerialize(params, nparams,
+                                ADMIN_CONNECT_TUNABLES_PARAMETERS_MAX,
+                                (virTypedParameterRemotePtr *) &args.params.params_val,
+                                &args.params.params_len,
+                                0) < 0)
+        goto cleanup;
+
+    if (call(conn, 0, ADMIN_PROC_CONNECT_SET_TUNABLES,
+             (xdrproc_t) xdr_admin_connect_set_tunables_args,
+             (char *) &args,
+             (xdrproc_t) xdr_void, (char *) NULL) == -1)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    virTypedParamsRemoteFree((virTypedParameterRemotePtr) args.params.params_val,
+                             args.params.params_len);
+    virObjectUnlock(priv);
+    return rv;
+}
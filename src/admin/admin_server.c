@@ -305,6 +305,7 @@ adminServerGetClientLimits(virNetServerPtr srv,
                            unsigned int flags)
 {
     g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
+    virNetMessagePoolStats stats;
 
     virCheckFlags(0, -1);
 
@@ -328,6 +329,29 @@ adminServerGetClientLimits(virNetServerPtr srv,
                                  "%s", VIR_SERVER_CLIENTS_UNAUTH_CURRENT) < 0)
         return -1;
 
+    if (virTypedParamListAddUInt(paramlist,
+                                 virNetServerGetMaxClientJobs(srv),
+                                 "%s", VIR_SERVER_CLIENTS_JOBS_MAX) < 0)
+        return -1;
+
+    virNetServerGetMessagePoolStats(srv, &stats);
+
+    if (virTypedParamListAddULLong(paramlist, stats.allocs,
+                                   "%s", VIR_SERVER_CLIENTS_MESSAGE_ALLOCS) < 0)
+        return -1;
+
+    if (virTypedParamListAddULLong(paramlist, stats.reuses,
+                                   "%s", VIR_SERVER_CLIENTS_MESSAGE_REUSES) < 0)
+        return -1;
+
+    if (virTypedParamListAddULLong(paramlist, stats.cached,
+                                   "%s", VIR_SERVER_CLIENTS_MESSAGE_CACHED) < 0)
+        return -1;
+
+    if (virTypedParamListAddULLong(paramlist, stats.cachedBytes,
+                                   "%s", VIR_SERVER_CLIENTS_MESSAGE_CACHED_BYTES) < 0)
+        return -1;
+
     *nparams = virTypedParamListStealParams(paramlist, params);
 
     return 0;
@@ -341,6 +365,7 @@ adminServerSetClientLimits(virNetServerPtr srv,
 {
     long long int maxClients = -1;
     long long int maxClientsUnauth = -1;
+    long long int maxClientJobs = -1;
     virTypedParameterPtr param = NULL;
 
     virCheckFlags(0, -1);
@@ -350,6 +375,8 @@ adminServerSetClientLimits(virNetServerPtr srv,
                                VIR_TYPED_PARAM_UINT,
                                VIR_SERVER_CLIENTS_UNAUTH_MAX,
                                VIR_TYPED_PARAM_UINT,
+                               VIR_SERVER_CLIENTS_JOBS_MAX,
+                               VIR_TYPED_PARAM_UINT,
                                NULL) < 0)
         return -1;
 
@@ -361,8 +388,12 @@ adminServerSetClientLimits(virNetServerPtr srv,
                                    VIR_SERVER_CLIENTS_UNAUTH_MAX)))
         maxClientsUnauth = param->value.ui;
 
+    if ((param = virTypedParamsGet(params, nparams,
+                                   VIR_SERVER_CLIENTS_JOBS_MAX)))
+        maxClientJobs = param->value.ui;
+
     if (virNetServerSetClientLimits(srv, maxClients,
-                                    maxClientsUnauth) < 0)
+                                    maxClientsUnauth, maxClientJobs) < 0)
         return -1;
 
     return 0;
@@ -376,3 +407,161 @@ adminServerUpdateTlsFiles(virNetServerPtr srv,
 
     return virNetServerUpdateTlsFiles(srv);
 }
+
+int
+adminServerGetProcedureStats(virNetServerPtr srv,
+                             virTypedParameterPtr *params,
+                             int *nparams,
+                             unsigned int flags)
+{
+    g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
+    g_autofree virNetServerProgramPtr *progs = NULL;
+    size_t nprogs;
+    size_t count = 0;
+    size_t i;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    nprogs = virNetServerGetPrograms(srv, &progs);
+
+    for (i = 0; i < nprogs; i++) {
+        g_autofree virNetServerProgramProcStatsPtr stats = NULL;
+        unsigned int program = virNetServerProgramGetID(progs[i]);
+        size_t nstats = virNetServerProgramGetProcStats(progs[i], &stats);
+        size_t j;
+
+        for (j = 0; j < nstats; j++, count++) {
+            size_t k;
+
+            if (virTypedParamListAddUInt(paramlist, program,
+                                         VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                                         VIR_SERVER_PROC_STATS_SUFFIX_PROGRAM,
+                                         count) < 0 ||
+                virTypedParamListAddUInt(paramlist, stats[j].procedure,
+                                         VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                                         VIR_SERVER_PROC_STATS_SUFFIX_PROCEDURE,
+                                         count) < 0 ||
+                virTypedParamListAddULLong(paramlist, stats[j].calls,
+                                           VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                                           VIR_SERVER_PROC_STATS_SUFFIX_CALLS,
+                                           count) < 0 ||
+                virTypedParamListAddULLong(paramlist, stats[j].errors,
+                                           VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                                           VIR_SERVER_PROC_STATS_SUFFIX_ERRORS,
+                                           count) < 0 ||
+                virTypedParamListAddULLong(paramlist, stats[j].queueTime,
+                                           VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                                           VIR_SERVER_PROC_STATS_SUFFIX_QUEUE_TIME,
+                                           count) < 0 ||
+                virTypedParamListAddULLong(paramlist, stats[j].execTime,
+                                           VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                                           VIR_SERVER_PROC_STATS_SUFFIX_EXEC_TIME,
+                                           count) < 0)
+                goto cleanup;
+
+            for (k = 0; k < VIR_NET_SERVER_PROGRAM_HIST_BUCKETS; k++) {
+                if (virTypedParamListAddULLong(paramlist, stats[j].queueHist[k],
+                                               VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                                               VIR_SERVER_PROC_STATS_SUFFIX_QUEUE_HIST "%zu",
+                                               count, k) < 0 ||
+                    virTypedParamListAddULLong(paramlist, stats[j].execHist[k],
+                                               VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                                               VIR_SERVER_PROC_STATS_SUFFIX_EXEC_HIST "%zu",
+                                               count, k) < 0)
+                    goto cleanup;
+            }
+        }
+    }
+
+    if (virTypedParamListAddUInt(paramlist, count,
+                                 "%s", VIR_SERVER_PROC_STATS_COUNT) < 0 ||
+        virTypedParamListAddUInt(paramlist, VIR_NET_SERVER_PROGRAM_HIST_BUCKETS,
+                                 "%s", VIR_SERVER_PROC_STATS_HIST_COUNT) < 0)
+        goto cleanup;
+
+    *nparams = virTypedParamListStealParams(paramlist, params);
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < nprogs; i++)
+        virObjectUnref(progs[i]);
+    return ret;
+}
+
+int
+adminServerSetCapture(virNetServerPtr srv,
+                      virTypedParameterPtr params,
+                      int nparams,
+                      unsigned int flags)
+{
+    virNetServerCapturePtr capture = virNetServerGetCapture(srv);
+    unsigned long long size = VIR_NET_SERVER_CAPTURE_SIZE_DEFAULT;
+    unsigned int snaplen = VIR_NET_SERVER_CAPTURE_SNAPLEN_DEFAULT;
+    unsigned int sample = 1;
+    unsigned int enabled = 0;
+    const char *file = NULL;
+    int rc;
+
+    virCheckFlags(0, -1);
+
+    if (virTypedParamsValidate(params, nparams,
+                               VIR_SERVER_CAPTURE_ENABLED,
+                               VIR_TYPED_PARAM_UINT,
+                               VIR_SERVER_CAPTURE_SIZE,
+                               VIR_TYPED_PARAM_ULLONG,
+                               VIR_SERVER_CAPTURE_SNAPLEN,
+                               VIR_TYPED_PARAM_UINT,
+                               VIR_SERVER_CAPTURE_SAMPLE,
+                               VIR_TYPED_PARAM_UINT,
+                               VIR_SERVER_CAPTURE_FILE,
+                               VIR_TYPED_PARAM_STRING,
+                               NULL) < 0)
+        return -1;
+
+    if ((rc = virTypedParamsGetUInt(params, nparams,
+                                    VIR_SERVER_CAPTURE_ENABLED,
+                                    &enabled)) < 0 ||
+        virTypedParamsGetULLong(params, nparams,
+                                VIR_SERVER_CAPTURE_SIZE, &size) < 0 ||
+        virTypedParamsGetUInt(params, nparams,
+                              VIR_SERVER_CAPTURE_SNAPLEN, &snaplen) < 0 ||
+        virTypedParamsGetUInt(params, nparams,
+                              VIR_SERVER_CAPTURE_SAMPLE, &sample) < 0 ||
+        virTypedParamsGetString(params, nparams,
+                                VIR_SERVER_CAPTURE_FILE, &file) < 0)
+        return -1;
+
+    if (rc == 1 && enabled > 1) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("invalid value '%u' of parameter '%s'"),
+                       enabled, VIR_SERVER_CAPTURE_ENABLED);
+        return -1;
+    }
+
+    if ((rc == 0 || enabled == 0) &&
+        (virTypedParamsGet(params, nparams, VIR_SERVER_CAPTURE_SIZE) ||
+         virTypedParamsGet(params, nparams, VIR_SERVER_CAPTURE_SNAPLEN) ||
+         virTypedParamsGet(params, nparams, VIR_SERVER_CAPTURE_SAMPLE))) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("capture limits only apply when starting a capture"));
+        return -1;
+    }
+
+    if (file && !g_path_is_absolute(file)) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("capture file '%s' must be an absolute path"), file);
+        return -1;
+    }
+
+    if (rc == 1 && enabled == 0)
+        virNetServerCaptureStop(capture);
+
+    if (file && virNetServerCaptureSave(capture, file) < 0)
+        return -1;
+
+    if (rc == 1 && enabled == 1)
+        virNetServerCaptureStart(capture, size, snaplen, sample);
+
+    return 0;
+}
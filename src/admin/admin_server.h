@@ -70,3 +70,12 @@ int adminServerSetClientLimits(virNetServerPtr srv,
 
 int adminServerUpdateTlsFiles(virNetServerPtr srv,
                               unsigned int flags);
+
+int adminServerGetProcedureStats(virNetServerPtr srv,
+                                 virTypedParameterPtr *params,
+                                 int *nparams,
+                                 unsigned int flags);
+int adminServerSetCapture(virNetServerPtr srv,
+                          virTypedParameterPtr params,
+                          int nparams,
+                          unsigned int flags);
@@ -33,6 +33,7 @@
 #include "rpc/virnetserver.h"
 #include "virstring.h"
 #include "virthreadjob.h"
+#include "virtunable.h"
 #include "virtypedparam.h"
 #include "virutil.h"
 
@@ -521,4 +522,377 @@ adminDispatchConnectGetLoggingFilters(virNetServerPtr server G_GNUC_UNUSED,
 
     return 0;
 }
+
+static int
+adminConnectGetReconnectInfo(virTypedParameterPtr *params,
+                             int *nparams,
+                             unsigned int flags)
+{
+    unsigned int total;
+    unsigned int done;
+    unsigned int failed;
+    g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
+
+    virCheckFlags(0, -1);
+
+    if (virStateGetReconnectInfo(&total, &done, &failed) < 0)
+        return -1;
+
+    if (virTypedParamListAddUInt(paramlist, total,
+                                 "%s", VIR_ADMIN_RECONNECT_DOMAINS) < 0 ||
+        virTypedParamListAddUInt(paramlist, done,
+                                 "%s", VIR_ADMIN_RECONNECT_DONE) < 0 ||
+        virTypedParamListAddUInt(paramlist, failed,
+                                 "%s", VIR_ADMIN_RECONNECT_FAILED) < 0)
+        return -1;
+
+    *nparams = virTypedParamListStealParams(paramlist, params);
+
+    return 0;
+}
+
+static int
+adminDispatchConnectGetReconnectInfo(virNetServerPtr server G_GNUC_UNUSED,
+                                     virNetServerClientPtr client G_GNUC_UNUSED,
+                                     virNetMessagePtr msg G_GNUC_UNUSED,
+                                     virNetMessageErrorPtr rerr,
+                                     admin_connect_get_reconnect_info_args *args,
+                                     admin_connect_get_reconnect_info_ret *ret)
+{
+    int rv = -1;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+
+    if (adminConnectGetReconnectInfo(&params, &nparams, args->flags) < 0)
+        goto cleanup;
+
+    if (virTypedParamsSerialize(params, nparams,
+                                ADMIN_CONNECT_RECONNECT_INFO_PARAMETERS_MAX,
+                                (virTypedParameterRemotePtr *) &ret->params.params_val,
+                                &ret->params.params_len, 0) < 0)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+
+    virTypedParamsFree(params, nparams);
+    return rv;
+}
+
+static int
+adminConnectGetObjectStats(virTypedParameterPtr *params,
+                           int *nparams,
+                           unsigned int flags)
+{
+    g_autofree virClassStatsPtr stats = NULL;
+    g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
+    size_t nstats;
+    size_t count = 0;
+    size_t i;
+
+    virCheckFlags(0, -1);
+
+    nstats = virClassGetStats(&stats);
+
+    for (i = 0; i < nstats; i++) {
+        if (stats[i].instances == 0)
+            continue;
+
+        if (virTypedParamListAddString(paramlist, stats[i].name,
+                                       VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX "%zu"
+                                       VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_NAME,
+                                       count) < 0 ||
+            virTypedParamListAddULLong(paramlist, stats[i].instances,
+                                       VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX "%zu"
+                                       VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_INSTANCES,
+                                       count) < 0 ||
+            virTypedParamListAddULLong(paramlist, stats[i].bytes,
+                                       VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX "%zu"
+                                       VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_BYTES,
+                                       count) < 0)
+            return -1;
+
+        count++;
+    }
+
+    if (virTypedParamListAddUInt(paramlist, count,
+                                 "%s", VIR_ADMIN_OBJECT_STATS_CLASS_COUNT) < 0)
+        return -1;
+
+    *nparams = virTypedParamListStealParams(paramlist, params);
+
+    return 0;
+}
+
+static int
+adminDispatchConnectGetObjectStats(virNetServerPtr server G_GNUC_UNUSED,
+                                   virNetServerClientPtr client G_GNUC_UNUSED,
+                                   virNetMessagePtr msg G_GNUC_UNUSED,
+                                   virNetMessageErrorPtr rerr,
+                                   admin_connect_get_object_stats_args *args,
+                                   admin_connect_get_object_stats_ret *ret)
+{
+    int rv = -1;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+
+    if (adminConnectGetObjectStats(&params, &nparams, args->flags) < 0)
+        goto cleanup;
+
+    if (virTypedParamsSerialize(params, nparams,
+                                ADMIN_CONNECT_OBJECT_STATS_PARAMETERS_MAX,
+                                (virTypedParameterRemotePtr *) &ret->params.params_val,
+                                &ret->params.params_len, 0) < 0)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+
+    virTypedParamsFree(params, nparams);
+    return rv;
+}
+
+static int
+adminConnectGetLockStats(virTypedParameterPtr *params,
+                         int *nparams,
+                         unsigned int flags)
+{
+    g_autofree virMutexStatsPtr stats = NULL;
+    g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
+    int nstats;
+    size_t i;
+
+    virCheckFlags(0, -1);
+
+    if ((nstats = virClassGetLockStats(&stats)) < 0)
+        return -1;
+
+    for (i = 0; i < nstats; i++) {
+        if (virTypedParamListAddString(paramlist, stats[i].name,
+                                       VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "%zu"
+                                       VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_NAME,
+                                       i) < 0 ||
+            virTypedParamListAddULLong(paramlist, stats[i].acquisitions,
+                                       VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "%zu"
+                                       VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_ACQUISITIONS,
+                                       i) < 0 ||
+            virTypedParamListAddULLong(paramlist, stats[i].contentions,
+                                       VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "%zu"
+                                       VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_CONTENTIONS,
+                                       i) < 0 ||
+            virTypedParamListAddULLong(paramlist, stats[i].waitTime,
+                                       VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "%zu"
+                                       VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_WAIT_TIME,
+                                       i) < 0 ||
+            virTypedParamListAddULLong(paramlist, stats[i].holdTime,
+                                       VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "%zu"
+                                       VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_HOLD_TIME,
+                                       i) < 0)
+            return -1;
+    }
+
+    if (virTypedParamListAddUInt(paramlist, nstats,
+                                 "%s", VIR_ADMIN_LOCK_STATS_CLASS_COUNT) < 0)
+        return -1;
+
+    *nparams = virTypedParamListStealParams(paramlist, params);
+
+    return 0;
+}
+
+static int
+adminDispatchConnectGetLockStats(virNetServerPtr server G_GNUC_UNUSED,
+                                 virNetServerClientPtr client G_GNUC_UNUSED,
+                                 virNetMessagePtr msg G_GNUC_UNUSED,
+                                 virNetMessageErrorPtr rerr,
+                                 admin_connect_get_lock_stats_args *args,
+                                 admin_connect_get_lock_stats_ret *ret)
+{
+    int rv = -1;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+
+    if (adminConnectGetLockStats(&params, &nparams, args->flags) < 0)
+        goto cleanup;
+
+    if (virTypedParamsSerialize(params, nparams,
+                                ADMIN_CONNECT_LOCK_STATS_PARAMETERS_MAX,
+                                (virTypedParameterRemotePtr *) &ret->params.params_val,
+                                &ret->params.params_len, 0) < 0)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+
+    virTypedParamsFree(params, nparams);
+    return rv;
+}
+
+static int
+adminDispatchServerGetProcedureStats(virNetServerPtr server G_GNUC_UNUSED,
+                                     virNetServerClientPtr client,
+                                     virNetMessagePtr msg G_GNUC_UNUSED,
+                                     virNetMessageErrorPtr rerr G_GNUC_UNUSED,
+                                     admin_server_get_procedure_stats_args *args,
+                                     admin_server_get_procedure_stats_ret *ret)
+{
+    int rv = -1;
+    virNetServerPtr srv = NULL;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    struct daemonAdmClientPrivate *priv =
+        virNetServerClientGetPrivateData(client);
+
+    if (!(srv = virNetDaemonGetServer(priv->dmn, args->srv.name)))
+        goto cleanup;
+
+    if (adminServerGetProcedureStats(srv, &params, &nparams, args->flags) < 0)
+        goto cleanup;
+
+    if (virTypedParamsSerialize(params, nparams,
+                                ADMIN_SERVER_PROCEDURE_STATS_PARAMETERS_MAX,
+                                (virTypedParameterRemotePtr *) &ret->params.params_val,
+                                &ret->params.params_len, 0) < 0)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+
+    virTypedParamsFree(params, nparams);
+    virObjectUnref(srv);
+    return rv;
+}
+
+static int
+adminDispatchServerSetCapture(virNetServerPtr server G_GNUC_UNUSED,
+                              virNetServerClientPtr client,
+                              virNetMessagePtr msg G_GNUC_UNUSED,
+                              virNetMessageErrorPtr rerr G_GNUC_UNUSED,
+                              admin_server_set_capture_args *args)
+{
+    int rv = -1;
+    virNetServerPtr srv = NULL;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    struct daemonAdmClientPrivate *priv =
+        virNetServerClientGetPrivateData(client);
+
+    if (!(srv = virNetDaemonGetServer(priv->dmn, args->srv.name))) {
+        virReportError(VIR_ERR_NO_SERVER,
+                       _("no server with matching name '%s' found"),
+                       args->srv.name);
+        goto cleanup;
+    }
+
+    if (virTypedParamsDeserialize((virTypedParameterRemotePtr) args->params.params_val,
+        args->params.params_len,
+        ADMIN_SERVER_CAPTURE_PARAMETERS_MAX, &params, &nparams) < 0)
+        goto cleanup;
+
+    if (adminServerSetCapture(srv, params, nparams, args->flags) < 0)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    virTypedParamsFree(params, nparams);
+    virObjectUnref(srv);
+    return rv;
+}
+static int
+adminConnectGetTunables(virTypedParameterPtr *params,
+                        int *nparams,
+                        unsigned int flags)
+{
+    g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
+
+    virCheckFlags(0, -1);
+
+    if (virTunableGetAll(paramlist) < 0)
+        return -1;
+
+    *nparams = virTypedParamListStealParams(paramlist, params);
+
+    return 0;
+}
+
+static int
+adminDispatchConnectGetTunables(virNetServerPtr server G_GNUC_UNUSED,
+                                virNetServerClientPtr client G_GNUC_UNUSED,
+                                virNetMessagePtr msg G_GNUC_UNUSED,
+                                virNetMessageErrorPtr rerr,
+                                admin_connect_get_tunables_args *args,
+                                admin_connect_get_tunables_ret *ret)
+{
+    int rv = -1;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+
+    if (adminConnectGetTunables(&params, &nparams, args->flags) < 0)
+        goto cleanup;
+
+    if (virTypedParamsSerialize(params, nparams,
+                                ADMIN_CONNECT_TUNABLES_PARAMETERS_MAX,
+                                (virTypedParameterRemotePtr *) &ret->params.params_val,
+                                &ret->params.params_len, 0) < 0)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+
+    virTypedParamsFree(params, nparams);
+    return rv;
+}
+
+static int
+adminConnectSetTunables(const char *name,
+                        virTypedParameterPtr params,
+                        int nparams,
+                        unsigned int flags)
+{
+    virCheckFlags(0, -1);
+
+    return virTunableSet(name, params, nparams);
+}
+
+static int
+adminDispatchConnectSetTunables(virNetServerPtr server G_GNUC_UNUSED,
+                                virNetServerClientPtr client G_GNUC_UNUSED,
+                                virNetMessagePtr msg G_GNUC_UNUSED,
+                                virNetMessageErrorPtr rerr,
+                                admin_connect_set_tunables_args *args)
+{
+    int rv = -1;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+
+    if (virTypedParamsDeserialize((virTypedParameterRemotePtr) args->params.params_val,
+                                  args->params.params_len,
+                                  ADMIN_CONNECT_TUNABLES_PARAMETERS_MAX,
+                                  &params,
+                                  &nparams) < 0)
+        goto cleanup;
+
+    if (adminConnectSetTunables(args->name, params, nparams, args->flags) < 0)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+
+    virTypedParamsFree(params, nparams);
+    return rv;
+}
 #include "admin_server_dispatch_stubs.h"
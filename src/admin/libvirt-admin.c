@@ -1265,3 +1265,347 @@ virAdmConnectSetLoggingFilters(virAdmConnectPtr conn,
     virDispatchError(NULL);
     return -1;
 }
+
+/**
+ * virAdmConnectGetReconnectInfo:
+ * @conn: pointer to an active admin connection
+ * @params: pointer to a list of typed parameters which will be allocated
+ *          to store all returned parameters
+ * @nparams: pointer which will hold the number of params returned in @params
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Retrieves how far the daemon's drivers got with reconnecting to the
+ * domains which were running when the daemon was started. Upon successful
+ * completion, @params will be allocated automatically to hold all returned
+ * data, setting @nparams accordingly.
+ * When extracting parameters from @params, following search keys are
+ * supported:
+ *      VIR_ADMIN_RECONNECT_DOMAINS
+ *      VIR_ADMIN_RECONNECT_DONE
+ *      VIR_ADMIN_RECONNECT_FAILED
+ *
+ * Returns 0 on success, -1 in case of an error.
+ */
+int
+virAdmConnectGetReconnectInfo(virAdmConnectPtr conn,
+                              virTypedParameterPtr *params,
+                              int *nparams,
+                              unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("conn=%p, params=%p, nparams=%p, flags=0x%x",
+              conn, params, nparams, flags);
+
+    virResetLastError();
+
+    virCheckAdmConnectReturn(conn, -1);
+    virCheckNonNullArgGoto(params, error);
+
+    if ((ret = remoteAdminConnectGetReconnectInfo(conn, params, nparams,
+                                                  flags)) < 0)
+        goto error;
+
+    return ret;
+ error:
+    virDispatchError(NULL);
+    return -1;
+}
+
+/**
+ * virAdmConnectGetObjectStats:
+ * @conn: pointer to an active admin connection
+ * @params: pointer to a list of typed parameters which will be allocated
+ *          to store all returned parameters
+ * @nparams: pointer which will hold the number of params returned in @params
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Retrieves how many instances of each internal object class live in the
+ * daemon and how much memory they take, which helps attributing the memory
+ * used by the daemon. Only classes with live instances are reported. Upon
+ * successful completion, @params will be allocated automatically to hold
+ * all returned data, setting @nparams accordingly.
+ * When extracting parameters from @params, following search keys are
+ * supported:
+ *      VIR_ADMIN_OBJECT_STATS_CLASS_COUNT
+ *      VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX<num>VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_NAME
+ *      VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX<num>VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_INSTANCES
+ *      VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX<num>VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_BYTES
+ *
+ * Returns 0 on success, -1 in case of an error.
+ */
+int
+virAdmConnectGetObjectStats(virAdmConnectPtr conn,
+                            virTypedParameterPtr *params,
+                            int *nparams,
+                            unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("conn=%p, params=%p, nparams=%p, flags=0x%x",
+              conn, params, nparams, flags);
+
+    virResetLastError();
+
+    virCheckAdmConnectReturn(conn, -1);
+    virCheckNonNullArgGoto(params, error);
+
+    if ((ret = remoteAdminConnectGetObjectStats(conn, params, nparams,
+                                                flags)) < 0)
+        goto error;
+
+    return ret;
+ error:
+    virDispatchError(NULL);
+    return -1;
+}
+
+/**
+ * virAdmConnectGetLockStats:
+ * @conn: pointer to an active admin connection
+ * @params: pointer to a list of typed parameters which will be allocated
+ *          to store all returned parameters
+ * @nparams: pointer which will hold the number of params returned in @params
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Retrieves how often the locks of the daemon were contended and for how
+ * long they were waited for and held, which helps finding the locks that
+ * limit its scalability. The locks of objects are reported per object
+ * class, all the other mutexes are reported together as "virMutex". The
+ * statistics are only collected by daemons built with lock statistics
+ * enabled; other daemons fail with VIR_ERR_OPERATION_UNSUPPORTED. Upon
+ * successful completion, @params will be allocated automatically to hold
+ * all returned data, setting @nparams accordingly.
+ * When extracting parameters from @params, following search keys are
+ * supported:
+ *      VIR_ADMIN_LOCK_STATS_CLASS_COUNT
+ *      VIR_ADMIN_LOCK_STATS_CLASS_PREFIX<num>VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_NAME
+ *      VIR_ADMIN_LOCK_STATS_CLASS_PREFIX<num>VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_ACQUISITIONS
+ *      VIR_ADMIN_LOCK_STATS_CLASS_PREFIX<num>VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_CONTENTIONS
+ *      VIR_ADMIN_LOCK_STATS_CLASS_PREFIX<num>VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_WAIT_TIME
+ *      VIR_ADMIN_LOCK_STATS_CLASS_PREFIX<num>VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_HOLD_TIME
+ *
+ * Returns 0 on success, -1 in case of an error.
+ */
+int
+virAdmConnectGetLockStats(virAdmConnectPtr conn,
+                          virTypedParameterPtr *params,
+                          int *nparams,
+                          unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("conn=%p, params=%p, nparams=%p, flags=0x%x",
+              conn, params, nparams, flags);
+
+    virResetLastError();
+
+    virCheckAdmConnectReturn(conn, -1);
+    virCheckNonNullArgGoto(params, error);
+
+    if ((ret = remoteAdminConnectGetLockStats(conn, params, nparams,
+                                              flags)) < 0)
+        goto error;
+
+    return ret;
+ error:
+    virDispatchError(NULL);
+    return -1;
+}
+
+/**
+ * virAdmServerGetProcedureStats:
+ * @srv: a valid server object reference
+ * @params: pointer to a list of typed parameters which will be allocated
+ *          to store all returned parameters
+ * @nparams: pointer which will hold the number of params returned in @params
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Retrieves, for every RPC procedure which server @srv executed since it
+ * started, the number of calls and failed calls together with how long
+ * the calls waited for a worker thread and how long they were executed
+ * for, both as totals and as histograms. Upon successful completion,
+ * @params will be allocated automatically to hold all returned data,
+ * setting @nparams accordingly.
+ * When extracting parameters from @params, following search keys are
+ * supported:
+ *      VIR_SERVER_PROC_STATS_COUNT
+ *      VIR_SERVER_PROC_STATS_HIST_COUNT
+ *      VIR_SERVER_PROC_STATS_PREFIX<num>VIR_SERVER_PROC_STATS_SUFFIX_PROGRAM
+ *      VIR_SERVER_PROC_STATS_PREFIX<num>VIR_SERVER_PROC_STATS_SUFFIX_PROCEDURE
+ *      VIR_SERVER_PROC_STATS_PREFIX<num>VIR_SERVER_PROC_STATS_SUFFIX_CALLS
+ *      VIR_SERVER_PROC_STATS_PREFIX<num>VIR_SERVER_PROC_STATS_SUFFIX_ERRORS
+ *      VIR_SERVER_PROC_STATS_PREFIX<num>VIR_SERVER_PROC_STATS_SUFFIX_QUEUE_TIME
+ *      VIR_SERVER_PROC_STATS_PREFIX<num>VIR_SERVER_PROC_STATS_SUFFIX_EXEC_TIME
+ *      VIR_SERVER_PROC_STATS_PREFIX<num>VIR_SERVER_PROC_STATS_SUFFIX_QUEUE_HIST<bucket>
+ *      VIR_SERVER_PROC_STATS_PREFIX<num>VIR_SERVER_PROC_STATS_SUFFIX_EXEC_HIST<bucket>
+ *
+ * Returns 0 on success, -1 in case of an error.
+ */
+int
+virAdmServerGetProcedureStats(virAdmServerPtr srv,
+                              virTypedParameterPtr *params,
+                              int *nparams,
+                              unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("srv=%p, params=%p, nparams=%p, flags=0x%x",
+              srv, params, nparams, flags);
+    virResetLastError();
+
+    virCheckAdmServerGoto(srv, error);
+    virCheckNonNullArgGoto(params, error);
+
+    if ((ret = remoteAdminServerGetProcedureStats(srv, params, nparams,
+                                                  flags)) < 0)
+        goto error;
+
+    return ret;
+ error:
+    virDispatchError(NULL);
+    return -1;
+}
+
+/**
+ * virAdmServerSetCapture:
+ * @srv: a valid server object reference
+ * @params: pointer to capture parameters object
+ * @nparams: number of parameters in @params
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Control the capture of the RPC messages exchanged by server @srv with
+ * its clients. While a capture is running, the daemon keeps the start of
+ * the messages in memory, within the limits given when it was started;
+ * the kept messages can be written to a file in the pcapng format at any
+ * time, even after the capture was stopped, and decoded with the libvirt
+ * dissector of wireshark.
+ *
+ * Parameters of @params are applied in this order: stopping the capture
+ * (VIR_SERVER_CAPTURE_ENABLED set to 0), writing the messages kept so far
+ * to VIR_SERVER_CAPTURE_FILE and starting a new capture
+ * (VIR_SERVER_CAPTURE_ENABLED set to 1), which is the only one
+ * VIR_SERVER_CAPTURE_SIZE, VIR_SERVER_CAPTURE_SNAPLEN and
+ * VIR_SERVER_CAPTURE_SAMPLE apply to. See 'Capture RPC messages of a
+ * server' in libvirt-admin.h for the supported parameters.
+ *
+ * Returns 0 on success, -1 in case of an error.
+ */
+int
+virAdmServerSetCapture(virAdmServerPtr srv,
+                       virTypedParameterPtr params,
+                       int nparams,
+                       unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("srv=%p, params=%p, nparams=%d, flags=0x%x", srv, params, nparams,
+              flags);
+    VIR_TYPED_PARAMS_DEBUG(params, nparams);
+
+    virResetLastError();
+
+    virCheckAdmServerGoto(srv, error);
+    virCheckNonNullArgGoto(params, error);
+    virCheckNonNegativeArgGoto(nparams, error);
+
+    if ((ret = remoteAdminServerSetCapture(srv, params, nparams, flags)) < 0)
+        goto error;
+
+    return ret;
+ error:
+    virDispatchError(NULL);
+    return ret;
+}
+
+/**
+ * virAdmConnectGetTunables:
+ * @conn: pointer to an active admin connection
+ * @params: pointer to a list of typed parameters which will be allocated
+ *          to store all returned parameters
+ * @nparams: pointer which will hold the number of params returned in @params
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Retrieves the current values and counters of the thread pools, caches
+ * and other internals the drivers of the daemon registered as tunables.
+ * Each parameter is named by the name of the tunable, a dot and the name
+ * of the value, e.g. "qemu.stats-workers.maxWorkers". Which tunables
+ * exist depends on the drivers loaded into the daemon and their state;
+ * some pools only exist while they have work to do. Upon successful
+ * completion, @params will be allocated automatically to hold all
+ * returned data, setting @nparams accordingly.
+ *
+ * Returns 0 on success, -1 in case of an error.
+ */
+int
+virAdmConnectGetTunables(virAdmConnectPtr conn,
+                         virTypedParameterPtr *params,
+                         int *nparams,
+                         unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("conn=%p, params=%p, nparams=%p, flags=0x%x",
+              conn, params, nparams, flags);
+
+    virResetLastError();
+
+    virCheckAdmConnectReturn(conn, -1);
+    virCheckNonNullArgGoto(params, error);
+    virCheckNonNullArgGoto(nparams, error);
+
+    if ((ret = remoteAdminConnectGetTunables(conn, params, nparams,
+                                             flags)) < 0)
+        goto error;
+
+    return ret;
+ error:
+    virDispatchError(NULL);
+    return -1;
+}
+
+/**
+ * virAdmConnectSetTunables:
+ * @conn: pointer to an active admin connection
+ * @name: name of the tunable, e.g. "qemu.stats-workers"
+ * @params: pointer to new values of the tunable
+ * @nparams: number of parameters in @params
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Changes the values of the tunable @name of the daemon, effective
+ * immediately. The names of @params are relative to the tunable, e.g.
+ * "maxWorkers"; values not given stay unchanged. The change doesn't
+ * survive a restart of the daemon. Tunables which only report counters
+ * can't be changed.
+ *
+ * Returns 0 on success, -1 in case of an error.
+ */
+int
+virAdmConnectSetTunables(virAdmConnectPtr conn,
+                         const char *name,
+                         virTypedParameterPtr params,
+                         int nparams,
+                         unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("conn=%p, name=%s, params=%p, nparams=%d, flags=0x%x",
+              conn, NULLSTR(name), params, nparams, flags);
+    VIR_TYPED_PARAMS_DEBUG(params, nparams);
+
+    virResetLastError();
+
+    virCheckAdmConnectReturn(conn, -1);
+    virCheckNonNullArgGoto(name, error);
+    virCheckNonNullArgGoto(params, error);
+    virCheckNonNegativeArgGoto(nparams, error);
+
+    if ((ret = remoteAdminConnectSetTunables(conn, name, params, nparams,
+                                             flags)) < 0)
+        goto error;
+
+    return ret;
+ error:
+    virDispatchError(NULL);
+    return -1;
+}
@@ -603,31 +603,37 @@ virDomainPCIAddressBusSetModel(virDomainPCIAddressBusPtr bus,
 }
 
 
+G_STATIC_ASSERT(VIR_PCI_ADDRESS_SLOT_LAST < 32);
+
+/* Returns the bits of usedSlots corresponding to the slots of @bus
+ * starting at @fromSlot */
+static uint32_t ATTRIBUTE_NONNULL(1)
+virDomainPCIAddressBusSlotMask(virDomainPCIAddressBusPtr bus,
+                               size_t fromSlot)
+{
+    fromSlot = MAX(fromSlot, bus->minSlot);
+
+    if (fromSlot > bus->maxSlot)
+        return 0;
+
+    return (uint32_t) (((1ULL << (bus->maxSlot + 1)) - 1) &
+                       ~((1ULL << fromSlot) - 1));
+}
+
+
 bool
 virDomainPCIAddressBusIsFullyReserved(virDomainPCIAddressBusPtr bus)
 {
-    size_t i;
-
-    for (i = bus->minSlot; i <= bus->maxSlot; i++) {
-        if (!bus->slot[i].functions)
-            return false;
-    }
+    uint32_t mask = virDomainPCIAddressBusSlotMask(bus, 0);
 
-    return true;
+    return (bus->usedSlots & mask) == mask;
 }
 
 
 static bool ATTRIBUTE_NONNULL(1)
 virDomainPCIAddressBusIsEmpty(virDomainPCIAddressBusPtr bus)
 {
-    size_t i;
-
-    for (i = bus->minSlot; i <= bus->maxSlot; i++) {
-        if (bus->slot[i].functions)
-            return false;
-    }
-
-    return true;
+    return !(bus->usedSlots & virDomainPCIAddressBusSlotMask(bus, 0));
 }
 
 
@@ -885,6 +891,7 @@ virDomainPCIAddressReserveAddrInternal(virDomainPCIAddressSetPtr addrs,
 
     /* mark the requested function as reserved */
     bus->slot[addr->slot].functions |= (1 << addr->function);
+    bus->usedSlots |= 1U << addr->slot;
     VIR_DEBUG("Reserving PCI address %s (aggregate='%s')", addrStr,
               bus->slot[addr->slot].aggregate ? "true" : "false");
 
@@ -964,7 +971,11 @@ void
 virDomainPCIAddressReleaseAddr(virDomainPCIAddressSetPtr addrs,
                                virPCIDeviceAddressPtr addr)
 {
-    addrs->buses[addr->bus].slot[addr->slot].functions &= ~(1 << addr->function);
+    virDomainPCIAddressBusPtr bus = &addrs->buses[addr->bus];
+
+    bus->slot[addr->slot].functions &= ~(1 << addr->function);
+    if (!bus->slot[addr->slot].functions)
+        bus->usedSlots &= ~(1U << addr->slot);
 }
 
 
@@ -1095,17 +1106,25 @@ virDomainPCIAddressFindUnusedFunctionOnBus(virDomainPCIAddressBusPtr bus,
                                            virDomainPCIConnectFlags flags,
                                            bool *found)
 {
-    g_autofree char *addrStr = NULL;
-
     *found = false;
 
-    if (!(addrStr = virPCIDeviceAddressAsString(searchAddr)))
-        return -1;
-
-    if (!virDomainPCIAddressFlagsCompatible(searchAddr, addrStr, bus->flags,
+    /* the address string is only needed for reporting errors */
+    if (!virDomainPCIAddressFlagsCompatible(searchAddr, NULL, bus->flags,
                                             flags, false, false)) {
         VIR_DEBUG("PCI bus %04x:%02x is not compatible with the device",
                   searchAddr->domain, searchAddr->bus);
+    } else if (!(flags & VIR_PCI_CONNECT_AGGREGATE_SLOT)) {
+        /* only a completely unused slot will do */
+        uint32_t unused = ~bus->usedSlots &
+            virDomainPCIAddressBusSlotMask(bus, searchAddr->slot);
+
+        if (unused) {
+            searchAddr->slot = __builtin_ffs(unused) - 1;
+            *found = true;
+        } else {
+            VIR_DEBUG("PCI bus %04x:%02x has no free slot",
+                      searchAddr->domain, searchAddr->bus);
+        }
     } else {
         while (searchAddr->slot <= bus->maxSlot) {
             if (bus->slot[searchAddr->slot].functions == 0) {
@@ -104,6 +104,10 @@ typedef struct {
      * bit is set, that function is in use by a device.
      */
     virDomainPCIAddressSlot slot[VIR_PCI_ADDRESS_SLOT_LAST + 1];
+    /* Bit N is set if any function of slot N is in use, so that free
+     * slots can be found without looking at every slot.
+     */
+    uint32_t usedSlots;
 
     /* See virDomainDeviceInfo::isolationGroup */
     unsigned int isolationGroup;
@@ -2125,7 +2125,7 @@ virDomainDiskDefFree(virDomainDiskDefPtr def)
     VIR_FREE(def->dst);
     virObjectUnref(def->mirror);
     VIR_FREE(def->wwn);
-    VIR_FREE(def->driverName);
+    virStringInternRelease(def->driverName);
     VIR_FREE(def->vendor);
     VIR_FREE(def->product);
     VIR_FREE(def->domain_name);
@@ -2192,8 +2192,8 @@ virDomainDiskGetDriver(const virDomainDiskDef *def)
 int
 virDomainDiskSetDriver(virDomainDiskDefPtr def, const char *name)
 {
-    char *tmp = g_strdup(name);
-    g_free(def->driverName);
+    const char *tmp = virStringIntern(name);
+    virStringInternRelease(def->driverName);
     def->driverName = tmp;
     return 0;
 }
@@ -2407,7 +2407,8 @@ virDomainNetDefClear(virDomainNetDefPtr def)
     if (!def)
         return;
 
-    VIR_FREE(def->modelstr);
+    virStringInternRelease(def->modelstr);
+    def->modelstr = NULL;
     def->model = VIR_DOMAIN_NET_MODEL_UNKNOWN;
 
     switch (def->type) {
@@ -3526,6 +3527,7 @@ static void virDomainObjDispose(void *obj)
 
     virDomainSnapshotObjListFree(dom->snapshots);
     virDomainCheckpointObjListFree(dom->checkpoints);
+    g_free(dom->statusChecksum);
 }
 
 virDomainObjPtr
@@ -3539,6 +3541,8 @@ virDomainObjNew(virDomainXMLOptionPtr xmlopt)
     if (!(domain = virObjectLockableNew(virDomainObjClass)))
         return NULL;
 
+    domain->listID = -1;
+
     if (virCondInit(&domain->cond) < 0) {
         virReportSystemError(errno, "%s",
                              _("failed to initialize domain condition"));
@@ -10173,7 +10177,11 @@ virDomainDiskDefDriverParseXML(virDomainDiskDefPtr def,
 {
     g_autofree char *tmp = NULL;
 
-    def->driverName = virXMLPropString(cur, "name");
+    if ((tmp = virXMLPropString(cur, "name"))) {
+        virStringInternRelease(def->driverName);
+        def->driverName = virStringIntern(tmp);
+        VIR_FREE(tmp);
+    }
 
     if ((tmp = virXMLPropString(cur, "cache")) &&
         (def->cachemode = virDomainDiskCacheTypeFromString(tmp)) < 0) {
@@ -29720,11 +29728,25 @@ virDomainObjSave(virDomainObjPtr obj,
                           VIR_DOMAIN_DEF_FORMAT_CLOCK_ADJUST);
 
     g_autofree char *xml = NULL;
+    g_autofree char *checksum = NULL;
 
     if (!(xml = virDomainObjFormat(obj, xmlopt, flags)))
         return -1;
 
-    return virDomainDefSaveXML(obj->def, statusDir, xml);
+    /* Skip rewriting (and syncing) the file if nothing changed */
+    checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA256, xml, -1);
+    if (STREQ_NULLABLE(checksum, obj->statusChecksum)) {
+        VIR_DEBUG("status of domain '%s' is unchanged", obj->def->name);
+        return 0;
+    }
+
+    g_clear_pointer(&obj->statusChecksum, g_free);
+
+    if (virDomainDefSaveXML(obj->def, statusDir, xml) < 0)
+        return -1;
+
+    obj->statusChecksum = g_steal_pointer(&checksum);
+    return 0;
 }
 
 
@@ -30324,7 +30346,8 @@ virDomainNetSetModelString(virDomainNetDefPtr net,
 {
     size_t i;
 
-    VIR_FREE(net->modelstr);
+    virStringInternRelease(net->modelstr);
+    net->modelstr = NULL;
     net->model = VIR_DOMAIN_NET_MODEL_UNKNOWN;
     if (!model)
         return 0;
@@ -30342,7 +30365,7 @@ virDomainNetSetModelString(virDomainNetDefPtr net,
         return -1;
     }
 
-    net->modelstr = g_strdup(model);
+    net->modelstr = virStringIntern(model);
     return 0;
 }
 
@@ -552,7 +552,7 @@ struct _virDomainDiskDef {
 
     virDomainBlockIoTuneInfo blkdeviotune;
 
-    char *driverName;
+    const char *driverName; /* interned, see virStringIntern */
 
     char *serial;
     char *wwn;
@@ -954,7 +954,7 @@ struct _virDomainNetDef {
     virMacAddr mac;
     bool mac_generated; /* true if mac was *just now* auto-generated by libvirt */
     int model; /* virDomainNetModelType */
-    char *modelstr;
+    const char *modelstr; /* interned, see virStringIntern */
     union {
         struct {
             virDomainNetBackendType name; /* which driver backend to use */
@@ -2638,6 +2638,11 @@ struct _virDomainObj {
 
     unsigned long long original_memlock; /* Original RLIMIT_MEMLOCK, zero if no
                                           * restore will be required later */
+
+    char *statusChecksum; /* checksum of the status XML saved last */
+
+    int listID; /* ID the domain list indexes it by, -1 if none. Protected
+                 * by the write lock of the list rather than by @parent */
 };
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virDomainObj, virObjectUnref);
@@ -2645,6 +2650,11 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC(virDomainObj, virObjectUnref);
 
 typedef bool (*virDomainObjListACLFilter)(virConnectPtr conn,
                                           virDomainDefPtr def);
+/* Clears the bits of @allowed of the @defs the connection can't see */
+typedef void (*virDomainObjListACLBatchFilter)(virConnectPtr conn,
+                                               virDomainDefPtr *defs,
+                                               size_t ndefs,
+                                               virBitmapPtr allowed);
 
 
 /* NB: Any new flag to this list be considered to be set in
@@ -57,6 +57,7 @@ static virClassPtr virDomainEventJobCompletedClass;
 static virClassPtr virDomainEventDeviceRemovalFailedClass;
 static virClassPtr virDomainEventMetadataChangeClass;
 static virClassPtr virDomainEventBlockThresholdClass;
+static virClassPtr virDomainEventBlockJobProgressClass;
 
 static void virDomainEventDispose(void *obj);
 static void virDomainEventLifecycleDispose(void *obj);
@@ -79,6 +80,7 @@ static void virDomainEventJobCompletedDispose(void *obj);
 static void virDomainEventDeviceRemovalFailedDispose(void *obj);
 static void virDomainEventMetadataChangeDispose(void *obj);
 static void virDomainEventBlockThresholdDispose(void *obj);
+static void virDomainEventBlockJobProgressDispose(void *obj);
 
 static void
 virDomainEventDispatchDefaultFunc(virConnectPtr conn,
@@ -287,6 +289,19 @@ struct _virDomainEventBlockThreshold {
 typedef struct _virDomainEventBlockThreshold virDomainEventBlockThreshold;
 typedef virDomainEventBlockThreshold *virDomainEventBlockThresholdPtr;
 
+struct _virDomainEventBlockJobProgress {
+    virDomainEvent parent;
+
+    char *disk;
+    int type;
+
+    unsigned long long cur;
+    unsigned long long end;
+    unsigned long long bandwidth;
+};
+typedef struct _virDomainEventBlockJobProgress virDomainEventBlockJobProgress;
+typedef virDomainEventBlockJobProgress *virDomainEventBlockJobProgressPtr;
+
 
 static int
 virDomainEventsOnceInit(void)
@@ -333,6 +348,8 @@ virDomainEventsOnceInit(void)
         return -1;
     if (!VIR_CLASS_NEW(virDomainEventBlockThreshold, virDomainEventClass))
         return -1;
+    if (!VIR_CLASS_NEW(virDomainEventBlockJobProgress, virDomainEventClass))
+        return -1;
     return 0;
 }
 
@@ -542,6 +559,16 @@ virDomainEventBlockThresholdDispose(void *obj)
 }
 
 
+static void
+virDomainEventBlockJobProgressDispose(void *obj)
+{
+    virDomainEventBlockJobProgressPtr event = obj;
+    VIR_DEBUG("obj=%p", event);
+
+    VIR_FREE(event->disk);
+}
+
+
 static void *
 virDomainEventNew(virClassPtr klass,
                   int eventID,
@@ -1619,6 +1646,61 @@ virDomainEventBlockThresholdNewFromDom(virDomainPtr dom,
 }
 
 
+static virObjectEventPtr
+virDomainEventBlockJobProgressNew(int id,
+                                  const char *name,
+                                  unsigned char *uuid,
+                                  const char *disk,
+                                  int type,
+                                  unsigned long long cur,
+                                  unsigned long long end,
+                                  unsigned long long bandwidth)
+{
+    virDomainEventBlockJobProgressPtr ev;
+
+    if (virDomainEventsInitialize() < 0)
+        return NULL;
+
+    if (!(ev = virDomainEventNew(virDomainEventBlockJobProgressClass,
+                                 VIR_DOMAIN_EVENT_ID_BLOCK_JOB_PROGRESS,
+                                 id, name, uuid)))
+        return NULL;
+
+    ev->disk = g_strdup(disk);
+    ev->type = type;
+    ev->cur = cur;
+    ev->end = end;
+    ev->bandwidth = bandwidth;
+
+    return (virObjectEventPtr)ev;
+}
+
+virObjectEventPtr
+virDomainEventBlockJobProgressNewFromObj(virDomainObjPtr obj,
+                                         const char *disk,
+                                         int type,
+                                         unsigned long long cur,
+                                         unsigned long long end,
+                                         unsigned long long bandwidth)
+{
+    return virDomainEventBlockJobProgressNew(obj->def->id, obj->def->name,
+                                             obj->def->uuid, disk, type,
+                                             cur, end, bandwidth);
+}
+
+virObjectEventPtr
+virDomainEventBlockJobProgressNewFromDom(virDomainPtr dom,
+                                         const char *disk,
+                                         int type,
+                                         unsigned long long cur,
+                                         unsigned long long end,
+                                         unsigned long long bandwidth)
+{
+    return virDomainEventBlockJobProgressNew(dom->id, dom->name, dom->uuid,
+                                             disk, type, cur, end, bandwidth);
+}
+
+
 static void
 virDomainEventDispatchDefaultFunc(virConnectPtr conn,
                                   virObjectEventPtr event,
@@ -1902,6 +1984,21 @@ virDomainEventDispatchDefaultFunc(virConnectPtr conn,
                                                               cbopaque);
             goto cleanup;
         }
+
+    case VIR_DOMAIN_EVENT_ID_BLOCK_JOB_PROGRESS:
+        {
+            virDomainEventBlockJobProgressPtr progressEvent;
+
+            progressEvent = (virDomainEventBlockJobProgressPtr)event;
+            ((virConnectDomainEventBlockJobProgressCallback)cb)(conn, dom,
+                                                                progressEvent->disk,
+                                                                progressEvent->type,
+                                                                progressEvent->cur,
+                                                                progressEvent->end,
+                                                                progressEvent->bandwidth,
+                                                                cbopaque);
+            goto cleanup;
+        }
     case VIR_DOMAIN_EVENT_ID_LAST:
         break;
     }
@@ -255,6 +255,22 @@ virDomainEventBlockThresholdNewFromDom(virDomainPtr dom,
                                        unsigned long long threshold,
                                        unsigned long long excess);
 
+virObjectEventPtr
+virDomainEventBlockJobProgressNewFromObj(virDomainObjPtr obj,
+                                         const char *disk,
+                                         int type,
+                                         unsigned long long cur,
+                                         unsigned long long end,
+                                         unsigned long long bandwidth);
+
+virObjectEventPtr
+virDomainEventBlockJobProgressNewFromDom(virDomainPtr dom,
+                                         const char *disk,
+                                         int type,
+                                         unsigned long long cur,
+                                         unsigned long long end,
+                                         unsigned long long bandwidth);
+
 int
 virDomainEventStateRegister(virConnectPtr conn,
                             virObjectEventStatePtr state,
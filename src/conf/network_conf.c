@@ -1409,6 +1409,7 @@ virNetworkForwardDefParseXML(const char *networkName,
     char *forwardDev = NULL;
     char *forwardManaged = NULL;
     char *forwardDriverName = NULL;
+    char *forwardDriverPrebind = NULL;
     char *type = NULL;
     xmlNodePtr save = ctxt->node;
 
@@ -1446,6 +1447,30 @@ virNetworkForwardDefParseXML(const char *networkName,
         def->driverName = driverName;
     }
 
+    forwardDriverPrebind = virXPathString("string(./driver/@prebind)", ctxt);
+    if (forwardDriverPrebind) {
+        int prebind = virTristateBoolTypeFromString(forwardDriverPrebind);
+
+        if (prebind <= 0) {
+            virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                           _("Invalid forward <driver prebind='%s'/> "
+                             "in network %s"),
+                           forwardDriverPrebind, networkName);
+            goto cleanup;
+        }
+        def->prebind = prebind == VIR_TRISTATE_BOOL_YES;
+    }
+
+    if (def->prebind &&
+        (def->type != VIR_NETWORK_FORWARD_HOSTDEV || !def->managed ||
+         def->driverName != VIR_NETWORK_FORWARD_DRIVER_NAME_VFIO)) {
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                       _("<driver prebind='yes'/> in network %s requires "
+                         "a managed hostdev network using the vfio driver"),
+                       networkName);
+        goto cleanup;
+    }
+
     /* bridge and hostdev modes can use a pool of physical interfaces */
     nForwardIfs = virXPathNodeSet("./interface", ctxt, &forwardIfNodes);
     if (nForwardIfs < 0) {
@@ -1633,6 +1658,7 @@ virNetworkForwardDefParseXML(const char *networkName,
     VIR_FREE(forwardDev);
     VIR_FREE(forwardManaged);
     VIR_FREE(forwardDriverName);
+    VIR_FREE(forwardDriverPrebind);
     VIR_FREE(forwardPfNodes);
     VIR_FREE(forwardIfNodes);
     VIR_FREE(forwardAddrNodes);
@@ -2531,7 +2557,10 @@ virNetworkDefFormatBuf(virBufferPtr buf,
                                def->forward.driverName);
                 return -1;
             }
-            virBufferAsprintf(buf, "<driver name='%s'/>\n", driverName);
+            virBufferAsprintf(buf, "<driver name='%s'", driverName);
+            if (def->forward.prebind)
+                virBufferAddLit(buf, " prebind='yes'");
+            virBufferAddLit(buf, "/>\n");
         }
         if (def->forward.type == VIR_NETWORK_FORWARD_NAT) {
             if (virNetworkForwardNatDefFormat(buf, &def->forward) < 0)
@@ -565,6 +565,10 @@ virNWFilterDefParseNode(xmlDocPtr xml,
 char *
 virNWFilterDefFormat(const virNWFilterDef *def);
 
+int
+virNWFilterRuleDefFormat(virBufferPtr buf,
+                         virNWFilterRuleDefPtr def);
+
 int
 virNWFilterSaveConfig(const char *configDir,
                       virNWFilterDefPtr def);
@@ -30,6 +30,7 @@
 #include "datatypes.h"
 #include "viralloc.h"
 #include "virerror.h"
+#include "virhash.h"
 #include "virobject.h"
 #include "virstring.h"
 
@@ -56,10 +57,22 @@ struct _virObjectEventCallback {
 typedef struct _virObjectEventCallback virObjectEventCallback;
 typedef virObjectEventCallback *virObjectEventCallbackPtr;
 
+/* The callbacks registered for one event ID and either one object or,
+ * without a key, all of them, ordered by callback ID */
+struct _virObjectEventCallbackBucket {
+    size_t count;
+    virObjectEventCallbackPtr *callbacks;
+};
+typedef struct _virObjectEventCallbackBucket virObjectEventCallbackBucket;
+typedef virObjectEventCallbackBucket *virObjectEventCallbackBucketPtr;
+
 struct _virObjectEventCallbackList {
     unsigned int nextID;
     size_t count;
     virObjectEventCallbackPtr *callbacks;
+    /* The same callbacks indexed by event ID and key, so that an event
+     * is only matched against the callbacks which might want it */
+    virHashTablePtr buckets;
 };
 
 struct _virObjectEventQueue {
@@ -164,10 +177,90 @@ virObjectEventCallbackListFree(virObjectEventCallbackListPtr list)
         VIR_FREE(list->callbacks[i]);
     }
     VIR_FREE(list->callbacks);
+    virHashFree(list->buckets);
     VIR_FREE(list);
 }
 
 
+static void
+virObjectEventCallbackBucketFree(void *opaque)
+{
+    virObjectEventCallbackBucketPtr bucket = opaque;
+
+    VIR_FREE(bucket->callbacks);
+    VIR_FREE(bucket);
+}
+
+
+static char *
+virObjectEventCallbackBucketName(int eventID,
+                                 const char *key)
+{
+    if (key)
+        return g_strdup_printf("%d:%s", eventID, key);
+    return g_strdup_printf("%d", eventID);
+}
+
+
+static virObjectEventCallbackBucketPtr
+virObjectEventCallbackBucketLookup(virObjectEventCallbackListPtr cbList,
+                                   int eventID,
+                                   const char *key)
+{
+    g_autofree char *name = virObjectEventCallbackBucketName(eventID, key);
+
+    return virHashLookup(cbList->buckets, name);
+}
+
+
+static int
+virObjectEventCallbackBucketAdd(virObjectEventCallbackListPtr cbList,
+                                virObjectEventCallbackPtr cb)
+{
+    g_autofree char *name = NULL;
+    virObjectEventCallbackBucketPtr bucket;
+
+    name = virObjectEventCallbackBucketName(cb->eventID,
+                                            cb->key_filter ? cb->key : NULL);
+
+    if (!(bucket = virHashLookup(cbList->buckets, name))) {
+        bucket = g_new0(virObjectEventCallbackBucket, 1);
+        if (virHashAddEntry(cbList->buckets, name, bucket) < 0) {
+            virObjectEventCallbackBucketFree(bucket);
+            return -1;
+        }
+    }
+
+    return VIR_APPEND_ELEMENT_COPY(bucket->callbacks, bucket->count, cb);
+}
+
+
+static void
+virObjectEventCallbackBucketRemove(virObjectEventCallbackListPtr cbList,
+                                   virObjectEventCallbackPtr cb)
+{
+    g_autofree char *name = NULL;
+    virObjectEventCallbackBucketPtr bucket;
+    size_t i;
+
+    name = virObjectEventCallbackBucketName(cb->eventID,
+                                            cb->key_filter ? cb->key : NULL);
+
+    if (!(bucket = virHashLookup(cbList->buckets, name)))
+        return;
+
+    for (i = 0; i < bucket->count; i++) {
+        if (bucket->callbacks[i] == cb) {
+            VIR_DELETE_ELEMENT(bucket->callbacks, i, bucket->count);
+            break;
+        }
+    }
+
+    if (bucket->count == 0)
+        virHashRemoveEntry(cbList->buckets, name);
+}
+
+
 /**
  * virObjectEventCallbackListCount:
  * @conn: pointer to the connection
@@ -253,6 +346,7 @@ virObjectEventCallbackListRemoveID(virConnectPtr conn,
              * function won't end up with a double free error */
             if (doFreeCb && cb->freecb)
                 (*cb->freecb)(cb->opaque);
+            virObjectEventCallbackBucketRemove(cbList, cb);
             virObjectEventCallbackFree(cb);
             VIR_DELETE_ELEMENT(cbList->callbacks, i, cbList->count);
             return ret;
@@ -302,6 +396,7 @@ virObjectEventCallbackListPurgeMarked(virObjectEventCallbackListPtr cbList)
             virFreeCallback freecb = cbList->callbacks[n]->freecb;
             if (freecb)
                 (*freecb)(cbList->callbacks[n]->opaque);
+            virObjectEventCallbackBucketRemove(cbList, cbList->callbacks[n]);
             virObjectEventCallbackFree(cbList->callbacks[n]);
 
             VIR_DELETE_ELEMENT(cbList->callbacks, n, cbList->count);
@@ -443,8 +538,14 @@ virObjectEventCallbackListAddID(virConnectPtr conn,
     cb->filter_opaque = filter_opaque;
     cb->legacy = legacy;
 
-    if (VIR_APPEND_ELEMENT(cbList->callbacks, cbList->count, cb) < 0)
+    if (virObjectEventCallbackBucketAdd(cbList, cb) < 0)
+        goto cleanup;
+
+    if (VIR_APPEND_ELEMENT_COPY(cbList->callbacks, cbList->count, cb) < 0) {
+        virObjectEventCallbackBucketRemove(cbList, cb);
         goto cleanup;
+    }
+    cb = NULL;
 
     /* When additional filtering is being done, every client callback
      * is matched to exactly one server callback.  */
@@ -569,6 +670,10 @@ virObjectEventStateNew(void)
     if (VIR_ALLOC(state->callbacks) < 0)
         goto error;
 
+    if (!(state->callbacks->buckets = virHashCreate(10,
+                                                    virObjectEventCallbackBucketFree)))
+        goto error;
+
     if (!(state->queue = virObjectEventQueueNew()))
         goto error;
 
@@ -684,14 +789,36 @@ virObjectEventStateDispatchCallbacks(virObjectEventStatePtr state,
                                      virObjectEventPtr event,
                                      virObjectEventCallbackListPtr callbacks)
 {
-    size_t i;
-    /* Cache this now, since we may be dropping the lock,
+    virObjectEventCallbackBucketPtr global;
+    virObjectEventCallbackBucketPtr object = NULL;
+    size_t i = 0;
+    size_t j = 0;
+    /* Cache the counts now, since we may be dropping the lock,
        and have more callbacks added. We're guaranteed not
        to have any removed */
-    size_t cbCount = callbacks->count;
-
-    for (i = 0; i < cbCount; i++) {
-        virObjectEventCallbackPtr cb = callbacks->callbacks[i];
+    size_t nglobal = 0;
+    size_t nobject = 0;
+
+    if ((global = virObjectEventCallbackBucketLookup(callbacks,
+                                                     event->eventID, NULL)))
+        nglobal = global->count;
+
+    if (event->meta.key &&
+        (object = virObjectEventCallbackBucketLookup(callbacks,
+                                                     event->eventID,
+                                                     event->meta.key)))
+        nobject = object->count;
+
+    /* Merge both buckets to keep dispatching in registration order */
+    while (i < nglobal || j < nobject) {
+        virObjectEventCallbackPtr cb;
+
+        if (j == nobject ||
+            (i < nglobal &&
+             global->callbacks[i]->callbackID < object->callbacks[j]->callbackID))
+            cb = global->callbacks[i++];
+        else
+            cb = object->callbacks[j++];
 
         if (!virObjectEventDispatchMatchCallback(event, cb))
             continue;
@@ -83,6 +83,15 @@ virDomainCheckpointObjListFree(virDomainCheckpointObjListPtr checkpoints)
 }
 
 
+void
+virDomainCheckpointObjListSetLoader(virDomainCheckpointObjListPtr checkpoints,
+                                    virDomainMomentObjListLoader loader,
+                                    void *opaque)
+{
+    virDomainMomentObjListSetLoader(checkpoints->base, loader, opaque);
+}
+
+
 static int
 virDomainCheckpointObjListGetNames(virDomainCheckpointObjListPtr checkpoints,
                                    virDomainMomentObjPtr from,
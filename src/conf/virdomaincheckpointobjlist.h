@@ -32,6 +32,11 @@ virDomainCheckpointObjListNew(void);
 void
 virDomainCheckpointObjListFree(virDomainCheckpointObjListPtr checkpoints);
 
+void
+virDomainCheckpointObjListSetLoader(virDomainCheckpointObjListPtr checkpoints,
+                                    virDomainMomentObjListLoader loader,
+                                    void *opaque);
+
 virDomainMomentObjPtr
 virDomainCheckpointAssignDef(virDomainCheckpointObjListPtr checkpoints,
                              virDomainCheckpointDefPtr def);
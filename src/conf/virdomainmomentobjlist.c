@@ -46,9 +46,34 @@ struct _virDomainMomentObjList {
 
     virDomainMomentObj metaroot; /* Special parent of all root moments */
     virDomainMomentObjPtr current; /* The current moment, if any */
+
+    /* Populates the list on first use, NULL once that happened */
+    virDomainMomentObjListLoader loader;
+    void *loaderOpaque;
 };
 
 
+/* Run the loader registered via virDomainMomentObjListSetLoader, if it
+ * did not run yet. The loader is cleared first so that it can use the
+ * list accessors itself. Errors it reports do not leak out into the
+ * caller which merely happened to touch the list first. */
+static void
+virDomainMomentObjListEnsureLoaded(virDomainMomentObjListPtr moments)
+{
+    virDomainMomentObjListLoader loader = moments->loader;
+    virErrorPtr orig_err;
+
+    if (!loader)
+        return;
+
+    moments->loader = NULL;
+
+    virErrorPreserveLast(&orig_err);
+    loader(moments->loaderOpaque);
+    virErrorRestore(&orig_err);
+}
+
+
 /* Run iter(data) on all direct children of moment, while ignoring all
  * other entries in moments.  Return the number of children
  * visited.  No particular ordering is guaranteed.  */
@@ -68,29 +93,45 @@ virDomainMomentForEachChild(virDomainMomentObjPtr moment,
     return moment->nchildren;
 }
 
-struct moment_act_on_descendant {
-    int number;
-    virHashIterator iter;
-    void *data;
-};
+/* Return the moment following @moment in a pre-order walk of the
+ * subtree below the moment the walk started at, or NULL once the whole
+ * subtree was visited.  @depth tracks how far below the starting point
+ * @moment is, which keeps the walk iterative no matter how deep the
+ * tree gets.  */
+static virDomainMomentObjPtr
+virDomainMomentNextDescendant(virDomainMomentObjPtr moment,
+                              size_t *depth)
+{
+    if (moment->first_child) {
+        (*depth)++;
+        return moment->first_child;
+    }
 
-static int
-virDomainMomentActOnDescendant(void *payload,
-                               const void *name,
-                               void *data)
+    while (*depth > 0 && !moment->sibling) {
+        moment = moment->parent;
+        (*depth)--;
+    }
+
+    if (*depth == 0)
+        return NULL;
+    return moment->sibling;
+}
+
+
+/* Return the number of descendants of moment */
+static size_t
+virDomainMomentCountDescendants(virDomainMomentObjPtr moment)
 {
-    virDomainMomentObjPtr obj = payload;
-    struct moment_act_on_descendant *curr = data;
-    virDomainMomentObj tmp = *obj;
-
-    /* Careful: curr->iter can delete obj, hence the need for tmp */
-    (curr->iter)(payload, name, curr->data);
-    curr->number += 1 + virDomainMomentForEachDescendant(&tmp,
-                                                         curr->iter,
-                                                         curr->data);
-    return 0;
+    size_t depth = 0;
+    size_t count = 0;
+
+    while ((moment = virDomainMomentNextDescendant(moment, &depth)))
+        count++;
+
+    return count;
 }
 
+
 /* Run iter(data) on all descendants of moment, while ignoring all
  * other entries in moments.  Return the number of descendants
  * visited.  The visit is guaranteed to be topological, but no
@@ -100,15 +141,23 @@ virDomainMomentForEachDescendant(virDomainMomentObjPtr moment,
                                  virHashIterator iter,
                                  void *data)
 {
-    struct moment_act_on_descendant act;
+    g_autofree virDomainMomentObjPtr *list = NULL;
+    virDomainMomentObjPtr next = moment;
+    size_t nlist = 0;
+    size_t depth = 0;
+    size_t i;
+
+    /* Careful: iter can delete the moment it is given, so the whole
+     * subtree is collected before any of it is visited */
+    list = g_new0(virDomainMomentObjPtr,
+                  virDomainMomentCountDescendants(moment));
+    while ((next = virDomainMomentNextDescendant(next, &depth)))
+        list[nlist++] = next;
 
-    act.number = 0;
-    act.iter = iter;
-    act.data = data;
-    virDomainMomentForEachChild(moment,
-                                virDomainMomentActOnDescendant, &act);
+    for (i = 0; i < nlist; i++)
+        (iter)(list[i], list[i]->def->name, data);
 
-    return act.number;
+    return nlist;
 }
 
 
@@ -172,6 +221,8 @@ virDomainMomentLinkParent(virDomainMomentObjListPtr moments,
 {
     virDomainMomentObjPtr parent;
 
+    virDomainMomentObjListEnsureLoaded(moments);
+
     parent = virDomainMomentFindByName(moments, moment->def->parent_name);
     if (!parent) {
         parent = &moments->metaroot;
@@ -241,6 +292,8 @@ virDomainMomentAssignDef(virDomainMomentObjListPtr moments,
 {
     virDomainMomentObjPtr moment;
 
+    virDomainMomentObjListEnsureLoaded(moments);
+
     if (virHashLookup(moments->objs, def->name) != NULL) {
         virReportError(VIR_ERR_OPERATION_FAILED,
                        _("domain moment %s already exists"),
@@ -295,6 +348,20 @@ virDomainMomentObjListFree(virDomainMomentObjListPtr moments)
 }
 
 
+/* Register @loader to be called with @opaque the first time the list
+ * is accessed, instead of populating it upfront. The caller must make
+ * sure @opaque outlives the list or the call of @loader, whichever
+ * comes first. */
+void
+virDomainMomentObjListSetLoader(virDomainMomentObjListPtr moments,
+                                virDomainMomentObjListLoader loader,
+                                void *opaque)
+{
+    moments->loader = loader;
+    moments->loaderOpaque = opaque;
+}
+
+
 /* Struct and callback for collecting a list of names of moments that
  * meet a particular filter. */
 struct virDomainMomentNameData {
@@ -348,6 +415,7 @@ virDomainMomentObjListGetNames(virDomainMomentObjListPtr moments,
     size_t i;
 
     virCheckFlags(VIR_DOMAIN_MOMENT_FILTERS_ALL, -1);
+    virDomainMomentObjListEnsureLoaded(moments);
     if (!from) {
         /* LIST_ROOTS and LIST_DESCENDANTS have the same bit value,
          * but opposite semantics.  Toggle here to get the correct
@@ -407,6 +475,7 @@ virDomainMomentObjPtr
 virDomainMomentFindByName(virDomainMomentObjListPtr moments,
                           const char *name)
 {
+    virDomainMomentObjListEnsureLoaded(moments);
     if (name)
         return virHashLookup(moments->objs, name);
     return NULL;
@@ -417,6 +486,7 @@ virDomainMomentFindByName(virDomainMomentObjListPtr moments,
 virDomainMomentObjPtr
 virDomainMomentGetCurrent(virDomainMomentObjListPtr moments)
 {
+    virDomainMomentObjListEnsureLoaded(moments);
     return moments->current;
 }
 
@@ -425,6 +495,7 @@ virDomainMomentGetCurrent(virDomainMomentObjListPtr moments)
 const char *
 virDomainMomentGetCurrentName(virDomainMomentObjListPtr moments)
 {
+    virDomainMomentObjListEnsureLoaded(moments);
     if (moments->current)
         return moments->current->def->name;
     return NULL;
@@ -436,6 +507,7 @@ void
 virDomainMomentSetCurrent(virDomainMomentObjListPtr moments,
                           virDomainMomentObjPtr moment)
 {
+    virDomainMomentObjListEnsureLoaded(moments);
     moments->current = moment;
 }
 
@@ -444,6 +516,7 @@ virDomainMomentSetCurrent(virDomainMomentObjListPtr moments,
 int
 virDomainMomentObjListSize(virDomainMomentObjListPtr moments)
 {
+    virDomainMomentObjListEnsureLoaded(moments);
     return virHashSize(moments->objs);
 }
 
@@ -453,7 +526,10 @@ bool
 virDomainMomentObjListRemove(virDomainMomentObjListPtr moments,
                              virDomainMomentObjPtr moment)
 {
-    bool ret = moments->current == moment;
+    bool ret;
+
+    virDomainMomentObjListEnsureLoaded(moments);
+    ret = moments->current == moment;
 
     virHashRemoveEntry(moments->objs, moment->def->name);
     if (ret)
@@ -466,6 +542,8 @@ virDomainMomentObjListRemove(virDomainMomentObjListPtr moments,
 void
 virDomainMomentObjListRemoveAll(virDomainMomentObjListPtr moments)
 {
+    /* Whatever was not loaded yet is discarded along with the rest */
+    moments->loader = NULL;
     virHashRemoveAll(moments->objs);
     virDomainMomentDropChildren(&moments->metaroot);
 }
@@ -477,6 +555,7 @@ virDomainMomentForEach(virDomainMomentObjListPtr moments,
                        virHashIterator iter,
                        void *data)
 {
+    virDomainMomentObjListEnsureLoaded(moments);
     return virHashForEach(moments->objs, iter, data);
 }
 
@@ -491,6 +570,44 @@ struct moment_set_relation {
     virDomainMomentObjListPtr moments;
     int err;
 };
+
+/* Like virDomainMomentSetRelations, but without looking for cycles,
+ * which needs to walk all ancestors of every single moment. */
+static int
+virDomainMomentLinkRelations(void *payload,
+                             const void *name G_GNUC_UNUSED,
+                             void *data)
+{
+    virDomainMomentObjPtr obj = payload;
+    struct moment_set_relation *curr = data;
+    virDomainMomentObjPtr parent;
+
+    parent = virDomainMomentFindByName(curr->moments, obj->def->parent_name);
+    if (!parent) {
+        parent = &curr->moments->metaroot;
+        if (obj->def->parent_name) {
+            curr->err = -1;
+            VIR_WARN("moment %s lacks parent %s", obj->def->name,
+                     obj->def->parent_name);
+        }
+    }
+    virDomainMomentSetParent(obj, parent);
+    return 0;
+}
+
+static int
+virDomainMomentResetRelations(void *payload,
+                              const void *name G_GNUC_UNUSED,
+                              void *data G_GNUC_UNUSED)
+{
+    virDomainMomentObjPtr obj = payload;
+
+    obj->parent = NULL;
+    obj->sibling = NULL;
+    virDomainMomentDropChildren(obj);
+    return 0;
+}
+
 static int
 virDomainMomentSetRelations(void *payload,
                             const void *name G_GNUC_UNUSED,
@@ -535,8 +652,21 @@ virDomainMomentUpdateRelations(virDomainMomentObjListPtr moments)
 {
     struct moment_set_relation act = { moments, 0 };
 
+    virDomainMomentObjListEnsureLoaded(moments);
     virDomainMomentDropChildren(&moments->metaroot);
-    virHashForEach(moments->objs, virDomainMomentSetRelations, &act);
+    virHashForEach(moments->objs, virDomainMomentLinkRelations, &act);
+
+    /* Moments which are part of a cycle can't be reached from the
+     * metaroot. Only in that rare case redo the linking the slow way,
+     * which breaks up the cycles. */
+    if (virDomainMomentCountDescendants(&moments->metaroot) !=
+        (size_t) virHashSize(moments->objs)) {
+        virHashForEach(moments->objs, virDomainMomentResetRelations, NULL);
+        virDomainMomentDropChildren(&moments->metaroot);
+        act.err = 0;
+        virHashForEach(moments->objs, virDomainMomentSetRelations, &act);
+    }
+
     if (act.err)
         moments->current = NULL;
     return act.err;
@@ -590,7 +720,10 @@ virDomainMomentCheckCycles(virDomainMomentObjListPtr list,
 virDomainMomentObjPtr
 virDomainMomentFindLeaf(virDomainMomentObjListPtr list)
 {
-    virDomainMomentObjPtr moment = &list->metaroot;
+    virDomainMomentObjPtr moment;
+
+    virDomainMomentObjListEnsureLoaded(list);
+    moment = &list->metaroot;
 
     if (moment->nchildren != 1)
         return NULL;
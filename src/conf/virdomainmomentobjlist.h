@@ -30,6 +30,9 @@
 typedef bool (*virDomainMomentObjListFilter)(virDomainMomentObjPtr obj,
                                              unsigned int flags);
 
+/* Callback populating a list on its first use */
+typedef void (*virDomainMomentObjListLoader)(void *opaque);
+
 /* Struct that allows tracing hierarchical relationships between
  * multiple virDomainMoment objects. The opaque type
  * virDomainMomentObjList then maintains both a hash of these structs
@@ -65,6 +68,9 @@ void virDomainMomentLinkParent(virDomainMomentObjListPtr moments,
 
 virDomainMomentObjListPtr virDomainMomentObjListNew(void);
 void virDomainMomentObjListFree(virDomainMomentObjListPtr moments);
+void virDomainMomentObjListSetLoader(virDomainMomentObjListPtr moments,
+                                     virDomainMomentObjListLoader loader,
+                                     void *opaque);
 
 virDomainMomentObjPtr virDomainMomentAssignDef(virDomainMomentObjListPtr moments,
                                                virDomainMomentDefPtr def);
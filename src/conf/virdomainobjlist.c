@@ -28,9 +28,11 @@
 #include "checkpoint_conf.h"
 #include "snapshot_conf.h"
 #include "viralloc.h"
+#include "virbitmap.h"
 #include "virfile.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "virthread.h"
 #include "virdomainsnapshotobjlist.h"
 #include "virdomaincheckpointobjlist.h"
 
@@ -39,7 +41,26 @@
 VIR_LOG_INIT("conf.virdomainobjlist");
 
 static virClassPtr virDomainObjListClass;
+static virClassPtr virDomainObjListSnapshotClass;
 static void virDomainObjListDispose(void *obj);
+static void virDomainObjListSnapshotDispose(void *obj);
+
+
+/*
+ * An immutable array of all the domains on the list. Every change of
+ * the set of domains publishes a new copy, so readers which only need
+ * to walk the list can grab a reference to the current one and work
+ * without holding the list lock at all.
+ */
+typedef struct _virDomainObjListSnapshot virDomainObjListSnapshot;
+typedef virDomainObjListSnapshot *virDomainObjListSnapshotPtr;
+struct _virDomainObjListSnapshot {
+    virObject parent;
+
+    size_t nvms;
+    size_t nalloc; /* only used while building @pending */
+    virDomainObjPtr *vms;
+};
 
 
 struct _virDomainObjList {
@@ -52,6 +73,21 @@ struct _virDomainObjList {
     /* name -> virDomainObj mapping for O(1),
      * lockless lookup-by-name */
     virHashTable *objsName;
+
+    /* id -> virDomainObj mapping for O(1) lookup-by-id. Drivers assign
+     * IDs while holding just the domain lock, so entries may be stale and
+     * have to be validated against def->id. Entries don't hold a
+     * reference, they're all dropped when the domain is removed. */
+    virHashTable *objsID;
+
+    /* replaced with the write lock held, but @snapshotLock alone is
+     * enough to get a reference to it */
+    virMutex snapshotLock;
+    virDomainObjListSnapshotPtr snapshot;
+
+    /* while loading all the configs, changes go to this copy with the
+     * write lock held, to be published once at the end */
+    virDomainObjListSnapshotPtr pending;
 };
 
 
@@ -60,6 +96,9 @@ static int virDomainObjListOnceInit(void)
     if (!VIR_CLASS_NEW(virDomainObjList, virClassForObjectRWLockable()))
         return -1;
 
+    if (!VIR_CLASS_NEW(virDomainObjListSnapshot, virClassForObject()))
+        return -1;
+
     return 0;
 }
 
@@ -76,7 +115,20 @@ virDomainObjListPtr virDomainObjListNew(void)
         return NULL;
 
     if (!(doms->objs = virHashCreate(50, virObjectFreeHashData)) ||
-        !(doms->objsName = virHashCreate(50, virObjectFreeHashData))) {
+        !(doms->objsName = virHashCreate(50, virObjectFreeHashData)) ||
+        !(doms->objsID = virHashCreate(50, NULL))) {
+        virObjectUnref(doms);
+        return NULL;
+    }
+
+    if (virMutexInit(&doms->snapshotLock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to initialize mutex"));
+        virObjectUnref(doms);
+        return NULL;
+    }
+
+    if (!(doms->snapshot = virObjectNew(virDomainObjListSnapshotClass))) {
         virObjectUnref(doms);
         return NULL;
     }
@@ -91,6 +143,161 @@ static void virDomainObjListDispose(void *obj)
 
     virHashFree(doms->objs);
     virHashFree(doms->objsName);
+    virHashFree(doms->objsID);
+    virObjectUnref(doms->snapshot);
+    virObjectUnref(doms->pending);
+    virMutexDestroy(&doms->snapshotLock);
+}
+
+
+static void virDomainObjListSnapshotDispose(void *obj)
+{
+    virDomainObjListSnapshotPtr snap = obj;
+
+    virObjectListFreeCount(snap->vms, snap->nvms);
+}
+
+
+/* Returns a copy of @old with @add appended and @del left out (both
+ * optional) */
+static virDomainObjListSnapshotPtr
+virDomainObjListSnapshotCopy(virDomainObjListSnapshotPtr old,
+                             virDomainObjPtr add,
+                             virDomainObjPtr del)
+{
+    virDomainObjListSnapshotPtr snap;
+    size_t i;
+
+    if (!(snap = virObjectNew(virDomainObjListSnapshotClass)))
+        return NULL;
+
+    snap->nalloc = old->nvms + 1;
+    snap->vms = g_new0(virDomainObjPtr, snap->nalloc);
+
+    for (i = 0; i < old->nvms; i++) {
+        if (old->vms[i] != del)
+            snap->vms[snap->nvms++] = virObjectRef(old->vms[i]);
+    }
+
+    if (add)
+        snap->vms[snap->nvms++] = virObjectRef(add);
+
+    return snap;
+}
+
+
+/* The caller must hold the write lock on @doms. Makes @snap, which it
+ * passes the reference of, the current snapshot. */
+static void
+virDomainObjListPublishSnapshotLocked(virDomainObjListPtr doms,
+                                      virDomainObjListSnapshotPtr snap)
+{
+    virDomainObjListSnapshotPtr old = doms->snapshot;
+
+    virMutexLock(&doms->snapshotLock);
+    doms->snapshot = snap;
+    virMutexUnlock(&doms->snapshotLock);
+
+    virObjectUnref(old);
+}
+
+
+/*
+ * The caller must hold the write lock on @doms. Publishes a copy of the
+ * current snapshot with @add appended and @del left out (both optional).
+ */
+static void
+virDomainObjListUpdateSnapshotLocked(virDomainObjListPtr doms,
+                                     virDomainObjPtr add,
+                                     virDomainObjPtr del)
+{
+    virDomainObjListSnapshotPtr snap;
+    size_t i;
+
+    /* Nobody else sees the pending copy, change it in place */
+    if ((snap = doms->pending)) {
+        for (i = 0; del && i < snap->nvms; i++) {
+            if (snap->vms[i] == del) {
+                virObjectUnref(del);
+                VIR_DELETE_ELEMENT_INPLACE(snap->vms, i, snap->nvms);
+                break;
+            }
+        }
+
+        if (add) {
+            ignore_value(VIR_RESIZE_N(snap->vms, snap->nalloc, snap->nvms, 1));
+            snap->vms[snap->nvms++] = virObjectRef(add);
+        }
+        return;
+    }
+
+    /* Nothing sensible can be done on failure, the object
+     * allocation aborts on OOM anyway */
+    if (!(snap = virDomainObjListSnapshotCopy(doms->snapshot, add, del)))
+        return;
+
+    virDomainObjListPublishSnapshotLocked(doms, snap);
+}
+
+
+/*
+ * The caller must hold the write lock on @doms. Publishing a snapshot
+ * copies the whole list, so adding lots of domains one by one would
+ * take quadratic time. Between these two calls the changes are
+ * collected in a private copy, published once at the end instead.
+ */
+static void
+virDomainObjListSuspendSnapshotLocked(virDomainObjListPtr doms)
+{
+    if (!doms->pending)
+        doms->pending = virDomainObjListSnapshotCopy(doms->snapshot,
+                                                     NULL, NULL);
+}
+
+
+static void
+virDomainObjListResumeSnapshotLocked(virDomainObjListPtr doms)
+{
+    virDomainObjListSnapshotPtr pending = g_steal_pointer(&doms->pending);
+
+    if (pending)
+        virDomainObjListPublishSnapshotLocked(doms, pending);
+}
+
+
+/*
+ * Returns a reference to the current snapshot of @doms, which the caller
+ * must release by virObjectUnref. No list lock needs to be held.
+ */
+static virDomainObjListSnapshotPtr
+virDomainObjListGetSnapshot(virDomainObjListPtr doms)
+{
+    virDomainObjListSnapshotPtr snap;
+
+    virMutexLock(&doms->snapshotLock);
+    snap = virObjectRef(doms->snapshot);
+    virMutexUnlock(&doms->snapshotLock);
+
+    return snap;
+}
+
+
+/*
+ * Runs @iter on every domain in the current snapshot of @doms without
+ * holding the list lock. The name argument of @iter is always NULL.
+ */
+static void
+virDomainObjListSnapshotForEach(virDomainObjListPtr doms,
+                                virHashIterator iter,
+                                void *opaque)
+{
+    virDomainObjListSnapshotPtr snap = virDomainObjListGetSnapshot(doms);
+    size_t i;
+
+    for (i = 0; i < snap->nvms; i++)
+        iter(snap->vms[i], NULL, opaque);
+
+    virObjectUnref(snap);
 }
 
 
@@ -111,24 +318,97 @@ static int virDomainObjListSearchID(const void *payload,
 }
 
 
+static void
+virDomainObjListFormatID(int id,
+                         char *idstr)
+{
+    g_snprintf(idstr, VIR_INT64_STR_BUFLEN, "%d", id);
+}
+
+
+/* The caller must hold the write lock on @doms */
+static void
+virDomainObjListUnindexIDLocked(virDomainObjListPtr doms,
+                                virDomainObjPtr obj)
+{
+    char idstr[VIR_INT64_STR_BUFLEN];
+
+    if (obj->listID < 0)
+        return;
+
+    virDomainObjListFormatID(obj->listID, idstr);
+    if (virHashLookup(doms->objsID, idstr) == obj)
+        ignore_value(virHashRemoveEntry(doms->objsID, idstr));
+    obj->listID = -1;
+}
+
+
+/*
+ * The caller must hold the write lock on @doms and the lock on @obj.
+ * Any entry previously indexing @obj is dropped so that there's at most
+ * one entry for every domain.
+ */
+static void
+virDomainObjListIndexIDLocked(virDomainObjListPtr doms,
+                              virDomainObjPtr obj)
+{
+    char idstr[VIR_INT64_STR_BUFLEN];
+
+    virDomainObjListUnindexIDLocked(doms, obj);
+
+    if (!virDomainObjIsActive(obj) || obj->def->id < 0)
+        return;
+
+    virDomainObjListFormatID(obj->def->id, idstr);
+    if (virHashUpdateEntry(doms->objsID, idstr, obj) == 0)
+        obj->listID = obj->def->id;
+}
+
+
 virDomainObjPtr
 virDomainObjListFindByID(virDomainObjListPtr doms,
                          int id)
 {
+    char idstr[VIR_INT64_STR_BUFLEN];
     virDomainObjPtr obj;
 
+    virDomainObjListFormatID(id, idstr);
+
     virObjectRWLockRead(doms);
-    obj = virHashSearch(doms->objs, virDomainObjListSearchID, &id, NULL);
+    obj = virHashLookup(doms->objsID, idstr);
     virObjectRef(obj);
     virObjectRWUnlock(doms);
+
     if (obj) {
         virObjectLock(obj);
-        if (obj->removing) {
-            virObjectUnlock(obj);
-            virObjectUnref(obj);
-            obj = NULL;
-        }
+        if (!obj->removing &&
+            virDomainObjIsActive(obj) &&
+            obj->def->id == id)
+            return obj;
+
+        virObjectUnlock(obj);
+        virObjectUnref(obj);
+    }
+
+    /* Stale or missing entry, fall back to a full scan */
+    virObjectRWLockRead(doms);
+    obj = virHashSearch(doms->objs, virDomainObjListSearchID, &id, NULL);
+    virObjectRef(obj);
+    virObjectRWUnlock(doms);
+
+    if (!obj)
+        return NULL;
+
+    virObjectRWLockWrite(doms);
+    virObjectLock(obj);
+    if (obj->removing) {
+        virObjectRWUnlock(doms);
+        virObjectUnlock(obj);
+        virObjectUnref(obj);
+        return NULL;
     }
+    virDomainObjListIndexIDLocked(doms, obj);
+    virObjectRWUnlock(doms);
 
     return obj;
 }
@@ -255,6 +535,9 @@ virDomainObjListAddObjLocked(virDomainObjListPtr doms,
     }
     virObjectRef(vm);
 
+    virDomainObjListIndexIDLocked(doms, vm);
+    virDomainObjListUpdateSnapshotLocked(doms, vm, NULL);
+
     return 0;
 }
 
@@ -380,8 +663,10 @@ virDomainObjListRemoveLocked(virDomainObjListPtr doms,
 
     virUUIDFormat(dom->def->uuid, uuidstr);
 
+    virDomainObjListUnindexIDLocked(doms, dom);
     virHashRemoveEntry(doms->objs, uuidstr);
     virHashRemoveEntry(doms->objsName, dom->def->name);
+    virDomainObjListUpdateSnapshotLocked(doms, NULL, dom);
 }
 
 
@@ -487,22 +772,17 @@ virDomainObjListLoadConfig(virDomainObjListPtr doms,
                            const char *configDir,
                            const char *autostartDir,
                            const char *name,
+                           virDomainDefPtr def,
                            virDomainLoadConfigNotify notify,
                            void *opaque)
 {
     char *configFile = NULL, *autostartLink = NULL;
-    virDomainDefPtr def = NULL;
     virDomainObjPtr dom;
     int autostart;
     virDomainDefPtr oldDef = NULL;
 
     if ((configFile = virDomainConfigFile(configDir, name)) == NULL)
         goto error;
-    if (!(def = virDomainDefParseFile(configFile, xmlopt, NULL,
-                                      VIR_DOMAIN_DEF_PARSE_INACTIVE |
-                                      VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
-                                      VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL)))
-        goto error;
 
     if ((autostartLink = virDomainConfigFile(autostartDir, name)) == NULL)
         goto error;
@@ -533,27 +813,12 @@ virDomainObjListLoadConfig(virDomainObjListPtr doms,
 
 static virDomainObjPtr
 virDomainObjListLoadStatus(virDomainObjListPtr doms,
-                           const char *statusDir,
-                           const char *name,
-                           virDomainXMLOptionPtr xmlopt,
+                           virDomainObjPtr obj,
                            virDomainLoadConfigNotify notify,
                            void *opaque)
 {
-    char *statusFile = NULL;
-    virDomainObjPtr obj = NULL;
     char uuidstr[VIR_UUID_STRING_BUFLEN];
 
-    if ((statusFile = virDomainConfigFile(statusDir, name)) == NULL)
-        goto error;
-
-    if (!(obj = virDomainObjParseFile(statusFile, xmlopt,
-                                      VIR_DOMAIN_DEF_PARSE_STATUS |
-                                      VIR_DOMAIN_DEF_PARSE_ACTUAL_NET |
-                                      VIR_DOMAIN_DEF_PARSE_PCI_ORIG_STATES |
-                                      VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
-                                      VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL)))
-        goto error;
-
     virUUIDFormat(obj->def->uuid, uuidstr);
 
     if (virHashLookup(doms->objs, uuidstr) != NULL) {
@@ -569,16 +834,69 @@ virDomainObjListLoadStatus(virDomainObjListPtr doms,
     if (notify)
         (*notify)(obj, 1, opaque);
 
-    VIR_FREE(statusFile);
     return obj;
 
  error:
     virDomainObjEndAPI(&obj);
-    VIR_FREE(statusFile);
     return NULL;
 }
 
 
+/* Upper bound of threads parsing domain XML files concurrently */
+#define VIR_DOMAIN_OBJ_LIST_LOAD_WORKERS_MAX 16
+
+typedef struct _virDomainObjListLoadEntry virDomainObjListLoadEntry;
+typedef virDomainObjListLoadEntry *virDomainObjListLoadEntryPtr;
+struct _virDomainObjListLoadEntry {
+    char *name;
+    virDomainDefPtr def;    /* parsed config, if !liveStatus */
+    virDomainObjPtr obj;    /* parsed status, if liveStatus */
+};
+
+typedef struct _virDomainObjListLoadData virDomainObjListLoadData;
+typedef virDomainObjListLoadData *virDomainObjListLoadDataPtr;
+struct _virDomainObjListLoadData {
+    const char *configDir;
+    bool liveStatus;
+    virDomainXMLOptionPtr xmlopt;
+
+    virDomainObjListLoadEntryPtr entries;
+    size_t nentries;
+};
+
+
+/* Parses a single file listed in @opaque. Runs in several threads at
+ * once, each picking the next file to parse. */
+static void
+virDomainObjListLoadOne(size_t idx,
+                        void *opaque)
+{
+    virDomainObjListLoadDataPtr data = opaque;
+    virDomainObjListLoadEntryPtr entry = &data->entries[idx];
+    g_autofree char *file = NULL;
+
+    /* NB: ignoring errors, so one malformed config doesn't
+       kill the whole process */
+    VIR_INFO("Loading config file '%s.xml'", entry->name);
+
+    if (!(file = virDomainConfigFile(data->configDir, entry->name)))
+        return;
+
+    if (data->liveStatus)
+        entry->obj = virDomainObjParseFile(file, data->xmlopt,
+                                           VIR_DOMAIN_DEF_PARSE_STATUS |
+                                           VIR_DOMAIN_DEF_PARSE_ACTUAL_NET |
+                                           VIR_DOMAIN_DEF_PARSE_PCI_ORIG_STATES |
+                                           VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
+                                           VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL);
+    else
+        entry->def = virDomainDefParseFile(file, data->xmlopt, NULL,
+                                           VIR_DOMAIN_DEF_PARSE_INACTIVE |
+                                           VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
+                                           VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL);
+}
+
+
 int
 virDomainObjListLoadAllConfigs(virDomainObjListPtr doms,
                                const char *configDir,
@@ -588,53 +906,80 @@ virDomainObjListLoadAllConfigs(virDomainObjListPtr doms,
                                virDomainLoadConfigNotify notify,
                                void *opaque)
 {
+    virDomainObjListLoadData data = { configDir, liveStatus, xmlopt,
+                                      NULL, 0 };
     DIR *dir;
     struct dirent *entry;
     int ret = -1;
     int rc;
+    size_t i;
 
     VIR_INFO("Scanning for configs in %s", configDir);
 
     if ((rc = virDirOpenIfExists(&dir, configDir)) <= 0)
         return rc;
 
-    virObjectRWLockWrite(doms);
-
     while ((ret = virDirRead(dir, &entry, configDir)) > 0) {
-        virDomainObjPtr dom;
+        virDomainObjListLoadEntry ent = { NULL, NULL, NULL };
 
         if (!virStringStripSuffix(entry->d_name, ".xml"))
             continue;
 
-        /* NB: ignoring errors, so one malformed config doesn't
-           kill the whole process */
-        VIR_INFO("Loading config file '%s.xml'", entry->d_name);
-        if (liveStatus)
+        ent.name = g_strdup(entry->d_name);
+        if (VIR_APPEND_ELEMENT(data.entries, data.nentries, ent) < 0) {
+            VIR_FREE(ent.name);
+            ret = -1;
+            break;
+        }
+    }
+
+    VIR_DIR_CLOSE(dir);
+
+    /* Parsing the XML is what takes time, so it is done in parallel
+     * and without holding the lock. The domains are added afterwards
+     * in the order their files were found. */
+    virThreadForEachParallel(data.nentries,
+                             MIN(g_get_num_processors(),
+                                 VIR_DOMAIN_OBJ_LIST_LOAD_WORKERS_MAX),
+                             "dom-load", virDomainObjListLoadOne, &data);
+
+    virObjectRWLockWrite(doms);
+    virDomainObjListSuspendSnapshotLocked(doms);
+
+    for (i = 0; i < data.nentries; i++) {
+        virDomainObjListLoadEntryPtr ent = &data.entries[i];
+        virDomainObjPtr dom = NULL;
+
+        if (liveStatus && ent->obj) {
             dom = virDomainObjListLoadStatus(doms,
-                                             configDir,
-                                             entry->d_name,
-                                             xmlopt,
+                                             ent->obj,
                                              notify,
                                              opaque);
-        else
+        } else if (!liveStatus && ent->def) {
             dom = virDomainObjListLoadConfig(doms,
                                              xmlopt,
                                              configDir,
                                              autostartDir,
-                                             entry->d_name,
+                                             ent->name,
+                                             ent->def,
                                              notify,
                                              opaque);
+        }
+
         if (dom) {
             if (!liveStatus)
                 dom->persistent = 1;
             virDomainObjEndAPI(&dom);
         } else {
-            VIR_ERROR(_("Failed to load config for domain '%s'"), entry->d_name);
+            VIR_ERROR(_("Failed to load config for domain '%s'"), ent->name);
         }
+
+        VIR_FREE(ent->name);
     }
 
-    VIR_DIR_CLOSE(dir);
+    virDomainObjListResumeSnapshotLocked(doms);
     virObjectRWUnlock(doms);
+    VIR_FREE(data.entries);
     return ret;
 }
 
@@ -678,9 +1023,7 @@ virDomainObjListNumOfDomains(virDomainObjListPtr doms,
                              virConnectPtr conn)
 {
     struct virDomainObjListData data = { filter, conn, active, 0 };
-    virObjectRWLockRead(doms);
-    virHashForEach(doms->objs, virDomainObjListCount, &data);
-    virObjectRWUnlock(doms);
+    virDomainObjListSnapshotForEach(doms, virDomainObjListCount, &data);
     return data.count;
 }
 
@@ -722,9 +1065,7 @@ virDomainObjListGetActiveIDs(virDomainObjListPtr doms,
 {
     struct virDomainIDData data = { filter, conn,
                                     0, maxids, ids };
-    virObjectRWLockRead(doms);
-    virHashForEach(doms->objs, virDomainObjListCopyActiveIDs, &data);
-    virObjectRWUnlock(doms);
+    virDomainObjListSnapshotForEach(doms, virDomainObjListCopyActiveIDs, &data);
     return data.numids;
 }
 
@@ -775,9 +1116,8 @@ virDomainObjListGetInactiveNames(virDomainObjListPtr doms,
     struct virDomainNameData data = { filter, conn,
                                       0, 0, maxnames, names };
     size_t i;
-    virObjectRWLockRead(doms);
-    virHashForEach(doms->objs, virDomainObjListCopyInactiveNames, &data);
-    virObjectRWUnlock(doms);
+    virDomainObjListSnapshotForEach(doms, virDomainObjListCopyInactiveNames,
+                                    &data);
     if (data.oom) {
         for (i = 0; i < data.numnames; i++)
             VIR_FREE(data.names[i]);
@@ -917,24 +1257,6 @@ virDomainObjMatchFilter(virDomainObjPtr vm,
 #undef MATCH
 
 
-struct virDomainListData {
-    virDomainObjPtr *vms;
-    size_t nvms;
-};
-
-
-static int
-virDomainObjListCollectIterator(void *payload,
-                                const void *name G_GNUC_UNUSED,
-                                void *opaque)
-{
-    struct virDomainListData *data = opaque;
-
-    data->vms[data->nvms++] = virObjectRef(payload);
-    return 0;
-}
-
-
 static void
 virDomainObjListFilter(virDomainObjPtr **list,
                        size_t *nvms,
@@ -969,35 +1291,112 @@ virDomainObjListFilter(virDomainObjPtr **list,
 }
 
 
-int
-virDomainObjListCollect(virDomainObjListPtr domlist,
-                        virConnectPtr conn,
-                        virDomainObjPtr **vms,
-                        size_t *nvms,
-                        virDomainObjListACLFilter filter,
-                        unsigned int flags)
+/*
+ * Same as virDomainObjListFilter, except that the ACLs of all the
+ * domains are checked at once by @filter. The definitions passed to
+ * @filter only have the name and UUID of the domains filled in, so
+ * that the domains don't have to stay locked during the checks.
+ */
+static void
+virDomainObjListFilterBatch(virDomainObjPtr **list,
+                            size_t *nvms,
+                            virConnectPtr conn,
+                            virDomainObjListACLBatchFilter filter,
+                            unsigned int flags)
 {
-    struct virDomainListData data = { NULL, 0 };
+    g_autoptr(virBitmap) allowed = NULL;
+    virDomainDefPtr *defs = NULL;
+    size_t ndefs;
+    size_t i;
+    size_t j;
 
-    virObjectRWLockRead(domlist);
-    sa_assert(domlist->objs);
-    if (VIR_ALLOC_N(data.vms, virHashSize(domlist->objs)) < 0) {
-        virObjectRWUnlock(domlist);
+    virDomainObjListFilter(list, nvms, conn, NULL, flags);
+
+    if (*nvms == 0)
+        return;
+
+    ndefs = *nvms;
+    defs = g_new0(virDomainDefPtr, ndefs);
+
+    for (i = 0; i < ndefs; i++) {
+        virDomainObjPtr vm = (*list)[i];
+
+        defs[i] = g_new0(virDomainDef, 1);
+
+        virObjectLock(vm);
+        defs[i]->name = g_strdup(vm->def->name);
+        memcpy(defs[i]->uuid, vm->def->uuid, VIR_UUID_BUFLEN);
+        virObjectUnlock(vm);
+    }
+
+    allowed = virBitmapNew(ndefs);
+    virBitmapSetAll(allowed);
+
+    filter(conn, defs, ndefs, allowed);
+
+    for (i = 0, j = 0; i < ndefs; i++) {
+        if (virBitmapIsBitSet(allowed, i))
+            (*list)[j++] = (*list)[i];
+        else
+            virObjectUnref((*list)[i]);
+
+        VIR_FREE(defs[i]->name);
+        VIR_FREE(defs[i]);
+    }
+    VIR_FREE(defs);
+
+    *nvms = j;
+}
+
+
+static int
+virDomainObjListCollectInternal(virDomainObjListPtr domlist,
+                                virConnectPtr conn,
+                                virDomainObjPtr **vms,
+                                size_t *nvms,
+                                virDomainObjListACLFilter filter,
+                                virDomainObjListACLBatchFilter batchFilter,
+                                unsigned int flags)
+{
+    virDomainObjListSnapshotPtr snap = virDomainObjListGetSnapshot(domlist);
+    virDomainObjPtr *list = NULL;
+    size_t nlist = 0;
+    size_t i;
+
+    if (VIR_ALLOC_N(list, snap->nvms) < 0) {
+        virObjectUnref(snap);
         return -1;
     }
 
-    virHashForEach(domlist->objs, virDomainObjListCollectIterator, &data);
-    virObjectRWUnlock(domlist);
+    for (i = 0; i < snap->nvms; i++)
+        list[nlist++] = virObjectRef(snap->vms[i]);
+    virObjectUnref(snap);
 
-    virDomainObjListFilter(&data.vms, &data.nvms, conn, filter, flags);
+    if (batchFilter)
+        virDomainObjListFilterBatch(&list, &nlist, conn, batchFilter, flags);
+    else
+        virDomainObjListFilter(&list, &nlist, conn, filter, flags);
 
-    *nvms = data.nvms;
-    *vms = data.vms;
+    *nvms = nlist;
+    *vms = list;
 
     return 0;
 }
 
 
+int
+virDomainObjListCollect(virDomainObjListPtr domlist,
+                        virConnectPtr conn,
+                        virDomainObjPtr **vms,
+                        size_t *nvms,
+                        virDomainObjListACLFilter filter,
+                        unsigned int flags)
+{
+    return virDomainObjListCollectInternal(domlist, conn, vms, nvms,
+                                           filter, NULL, flags);
+}
+
+
 int
 virDomainObjListConvert(virDomainObjListPtr domlist,
                         virConnectPtr conn,
@@ -1057,12 +1456,13 @@ virDomainObjListConvert(virDomainObjListPtr domlist,
 }
 
 
-int
-virDomainObjListExport(virDomainObjListPtr domlist,
-                       virConnectPtr conn,
-                       virDomainPtr **domains,
-                       virDomainObjListACLFilter filter,
-                       unsigned int flags)
+static int
+virDomainObjListExportInternal(virDomainObjListPtr domlist,
+                               virConnectPtr conn,
+                               virDomainPtr **domains,
+                               virDomainObjListACLFilter filter,
+                               virDomainObjListACLBatchFilter batchFilter,
+                               unsigned int flags)
 {
     virDomainObjPtr *vms = NULL;
     virDomainPtr *doms = NULL;
@@ -1070,7 +1470,8 @@ virDomainObjListExport(virDomainObjListPtr domlist,
     size_t i;
     int ret = -1;
 
-    if (virDomainObjListCollect(domlist, conn, &vms, &nvms, filter, flags) < 0)
+    if (virDomainObjListCollectInternal(domlist, conn, &vms, &nvms,
+                                        filter, batchFilter, flags) < 0)
         return -1;
 
     if (domains) {
@@ -1099,3 +1500,34 @@ virDomainObjListExport(virDomainObjListPtr domlist,
     virObjectListFreeCount(vms, nvms);
     return ret;
 }
+
+
+int
+virDomainObjListExport(virDomainObjListPtr domlist,
+                       virConnectPtr conn,
+                       virDomainPtr **domains,
+                       virDomainObjListACLFilter filter,
+                       unsigned int flags)
+{
+    return virDomainObjListExportInternal(domlist, conn, domains,
+                                          filter, NULL, flags);
+}
+
+
+/**
+ * virDomainObjListExportBatch:
+ *
+ * Same as virDomainObjListExport, except that the ACLs of all domains
+ * are checked at once by @filter, which is much cheaper with access
+ * drivers that have to ask someone else for each decision.
+ */
+int
+virDomainObjListExportBatch(virDomainObjListPtr domlist,
+                            virConnectPtr conn,
+                            virDomainPtr **domains,
+                            virDomainObjListACLBatchFilter filter,
+                            unsigned int flags)
+{
+    return virDomainObjListExportInternal(domlist, conn, domains,
+                                          NULL, filter, flags);
+}
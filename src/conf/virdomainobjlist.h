@@ -144,6 +144,11 @@ int virDomainObjListExport(virDomainObjListPtr doms,
                            virDomainPtr **domains,
                            virDomainObjListACLFilter filter,
                            unsigned int flags);
+int virDomainObjListExportBatch(virDomainObjListPtr doms,
+                                virConnectPtr conn,
+                                virDomainPtr **domains,
+                                virDomainObjListACLBatchFilter filter,
+                                unsigned int flags);
 int virDomainObjListConvert(virDomainObjListPtr domlist,
                             virConnectPtr conn,
                             virDomainPtr *doms,
@@ -106,6 +106,15 @@ virDomainSnapshotObjListFree(virDomainSnapshotObjListPtr snapshots)
 }
 
 
+void
+virDomainSnapshotObjListSetLoader(virDomainSnapshotObjListPtr snapshots,
+                                  virDomainMomentObjListLoader loader,
+                                  void *opaque)
+{
+    virDomainMomentObjListSetLoader(snapshots->base, loader, opaque);
+}
+
+
 int
 virDomainSnapshotObjListGetNames(virDomainSnapshotObjListPtr snapshots,
                                  virDomainMomentObjPtr from,
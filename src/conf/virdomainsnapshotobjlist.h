@@ -28,6 +28,9 @@
 
 virDomainSnapshotObjListPtr virDomainSnapshotObjListNew(void);
 void virDomainSnapshotObjListFree(virDomainSnapshotObjListPtr snapshots);
+void virDomainSnapshotObjListSetLoader(virDomainSnapshotObjListPtr snapshots,
+                                       virDomainMomentObjListLoader loader,
+                                       void *opaque);
 
 virDomainMomentObjPtr virDomainSnapshotAssignDef(virDomainSnapshotObjListPtr snapshots,
                                                  virDomainSnapshotDefPtr def);
@@ -279,65 +279,63 @@ virNetworkObjUnrefMacMap(virNetworkObjPtr obj)
 }
 
 
+/*
+ * virNetworkObjMacMgrAdd:
+ * @obj: network object
+ * @domain: name of the domain owning @mac
+ * @mac: MAC address
+ *
+ * Records @mac in the MAC map of @obj. The file read by the NSS module
+ * is only updated by virNetworkObjMacMgrSave, so that several changes
+ * can share one write of the whole map.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
 int
 virNetworkObjMacMgrAdd(virNetworkObjPtr obj,
-                       const char *dnsmasqStateDir,
                        const char *domain,
                        const virMacAddr *mac)
 {
     char macStr[VIR_MAC_STRING_BUFLEN];
-    char *file = NULL;
-    int ret = -1;
 
     if (!obj->macmap)
         return 0;
 
     virMacAddrFormat(mac, macStr);
 
-    if (!(file = virMacMapFileName(dnsmasqStateDir, obj->def->bridge)))
-        goto cleanup;
-
-    if (virMacMapAdd(obj->macmap, domain, macStr) < 0)
-        goto cleanup;
-
-    if (virMacMapWriteFile(obj->macmap, file) < 0)
-        goto cleanup;
-
-    ret = 0;
- cleanup:
-    VIR_FREE(file);
-    return ret;
+    return virMacMapAdd(obj->macmap, domain, macStr);
 }
 
 
 int
 virNetworkObjMacMgrDel(virNetworkObjPtr obj,
-                       const char *dnsmasqStateDir,
                        const char *domain,
                        const virMacAddr *mac)
 {
     char macStr[VIR_MAC_STRING_BUFLEN];
-    char *file = NULL;
-    int ret = -1;
 
     if (!obj->macmap)
         return 0;
 
     virMacAddrFormat(mac, macStr);
 
-    if (!(file = virMacMapFileName(dnsmasqStateDir, obj->def->bridge)))
-        goto cleanup;
+    return virMacMapRemove(obj->macmap, domain, macStr);
+}
 
-    if (virMacMapRemove(obj->macmap, domain, macStr) < 0)
-        goto cleanup;
 
-    if (virMacMapWriteFile(obj->macmap, file) < 0)
-        goto cleanup;
+int
+virNetworkObjMacMgrSave(virNetworkObjPtr obj,
+                        const char *dnsmasqStateDir)
+{
+    g_autofree char *file = NULL;
 
-    ret = 0;
- cleanup:
-    VIR_FREE(file);
-    return ret;
+    if (!obj->macmap)
+        return 0;
+
+    if (!(file = virMacMapFileName(dnsmasqStateDir, obj->def->bridge)))
+        return -1;
+
+    return virMacMapWriteFile(obj->macmap, file);
 }
 
 
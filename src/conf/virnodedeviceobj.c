@@ -48,6 +48,10 @@ struct _virNodeDeviceObjList {
      * for O(1), lockless lookup-by-name */
     virHashTable *objs;
 
+    /* sysfs path string -> virNodeDeviceObj mapping
+     * for O(1), lockless lookup-by-sysfs-path. Holds no references,
+     * entries are kept in sync with @objs */
+    virHashTable *sysfsPaths;
 };
 
 
@@ -197,21 +201,63 @@ virNodeDeviceObjListSearch(virNodeDeviceObjListPtr devs,
 }
 
 
+struct virNodeDeviceObjListFindBySysfsPathData {
+    const char *sysfs_path;
+    virNodeDeviceObjPtr skip;
+};
+
+/* Definitions are only replaced with @devs locked for writing, so
+ * unlike the other callbacks this doesn't need to lock the object */
 static int
 virNodeDeviceObjListFindBySysfsPathCallback(const void *payload,
                                             const void *name G_GNUC_UNUSED,
                                             const void *opaque)
 {
     virNodeDeviceObjPtr obj = (virNodeDeviceObjPtr) payload;
-    const char *sysfs_path = opaque;
-    int want = 0;
+    const struct virNodeDeviceObjListFindBySysfsPathData *data = opaque;
 
-    virObjectLock(obj);
-    if (obj->def->sysfs_path &&
-        STREQ_NULLABLE(obj->def->sysfs_path, sysfs_path))
-        want = 1;
-    virObjectUnlock(obj);
-    return want;
+    return obj != data->skip &&
+        STREQ_NULLABLE(obj->def->sysfs_path, data->sysfs_path);
+}
+
+
+/* Must be called with @devs locked for writing */
+static void
+virNodeDeviceObjListAddSysfsPath(virNodeDeviceObjListPtr devs,
+                                 virNodeDeviceObjPtr obj)
+{
+    const char *sysfs_path = obj->def->sysfs_path;
+
+    /* Should several devices share a path, the first one wins */
+    if (!sysfs_path || virHashLookup(devs->sysfsPaths, sysfs_path))
+        return;
+
+    if (virHashAddEntry(devs->sysfsPaths, sysfs_path, obj) < 0)
+        virResetLastError();
+}
+
+
+/* Must be called with @devs locked for writing */
+static void
+virNodeDeviceObjListRemoveSysfsPath(virNodeDeviceObjListPtr devs,
+                                    virNodeDeviceObjPtr obj)
+{
+    const char *sysfs_path = obj->def->sysfs_path;
+    struct virNodeDeviceObjListFindBySysfsPathData data = {
+        .sysfs_path = sysfs_path, .skip = obj };
+    virNodeDeviceObjPtr other;
+
+    if (!sysfs_path || virHashLookup(devs->sysfsPaths, sysfs_path) != obj)
+        return;
+
+    virHashRemoveEntry(devs->sysfsPaths, sysfs_path);
+
+    /* Rare, but if another device has the same path, index that */
+    if ((other = virHashSearch(devs->objs,
+                               virNodeDeviceObjListFindBySysfsPathCallback,
+                               &data, NULL)) &&
+        virHashAddEntry(devs->sysfsPaths, sysfs_path, other) < 0)
+        virResetLastError();
 }
 
 
@@ -219,9 +265,16 @@ virNodeDeviceObjPtr
 virNodeDeviceObjListFindBySysfsPath(virNodeDeviceObjListPtr devs,
                                     const char *sysfs_path)
 {
-    return virNodeDeviceObjListSearch(devs,
-                                      virNodeDeviceObjListFindBySysfsPathCallback,
-                                      sysfs_path);
+    virNodeDeviceObjPtr obj;
+
+    virObjectRWLockRead(devs);
+    obj = virObjectRef(virHashLookup(devs->sysfsPaths, sysfs_path));
+    virObjectRWUnlock(devs);
+
+    if (obj)
+        virObjectLock(obj);
+
+    return obj;
 }
 
 
@@ -405,6 +458,7 @@ virNodeDeviceObjListDispose(void *obj)
 {
     virNodeDeviceObjListPtr devs = obj;
 
+    virHashFree(devs->sysfsPaths);
     virHashFree(devs->objs);
 }
 
@@ -420,7 +474,8 @@ virNodeDeviceObjListNew(void)
     if (!(devs = virObjectRWLockableNew(virNodeDeviceObjListClass)))
         return NULL;
 
-    if (!(devs->objs = virHashCreate(50, virObjectFreeHashData))) {
+    if (!(devs->objs = virHashCreate(50, virObjectFreeHashData)) ||
+        !(devs->sysfsPaths = virHashCreate(50, NULL))) {
         virObjectUnref(devs);
         return NULL;
     }
@@ -446,8 +501,10 @@ virNodeDeviceObjListAssignDef(virNodeDeviceObjListPtr devs,
 
     if ((obj = virNodeDeviceObjListFindByNameLocked(devs, def->name))) {
         virObjectLock(obj);
+        virNodeDeviceObjListRemoveSysfsPath(devs, obj);
         virNodeDeviceDefFree(obj->def);
         obj->def = def;
+        virNodeDeviceObjListAddSysfsPath(devs, obj);
     } else {
         if (!(obj = virNodeDeviceObjNew()))
             goto cleanup;
@@ -459,6 +516,7 @@ virNodeDeviceObjListAssignDef(virNodeDeviceObjListPtr devs,
 
         obj->def = def;
         virObjectRef(obj);
+        virNodeDeviceObjListAddSysfsPath(devs, obj);
     }
 
  cleanup:
@@ -481,6 +539,7 @@ virNodeDeviceObjListRemove(virNodeDeviceObjListPtr devs,
     virObjectUnlock(obj);
     virObjectRWLockWrite(devs);
     virObjectLock(obj);
+    virNodeDeviceObjListRemoveSysfsPath(devs, obj);
     virHashRemoveEntry(devs->objs, def->name);
     virObjectUnlock(obj);
     virObjectUnref(obj);
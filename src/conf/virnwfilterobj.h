@@ -46,6 +46,11 @@ struct _virNWFilterDriverState {
     char *stateDir;
     char *configDir;
     char *bindingDir;
+
+    /* technology driver from nwfilter.conf, NULL for the default */
+    char *techDriverName;
+    /* whether the ebiptables driver shares chains between interfaces */
+    bool sharedChains;
 };
 
 virNWFilterDefPtr
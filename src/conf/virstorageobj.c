@@ -42,6 +42,7 @@ static virClassPtr virStoragePoolObjClass;
 static virClassPtr virStoragePoolObjListClass;
 static virClassPtr virStorageVolObjClass;
 static virClassPtr virStorageVolObjListClass;
+static virClassPtr virStorageVolObjIndexClass;
 
 static void
 virStoragePoolObjDispose(void *opaque);
@@ -51,6 +52,8 @@ static void
 virStorageVolObjDispose(void *opaque);
 static void
 virStorageVolObjListDispose(void *opaque);
+static void
+virStorageVolObjIndexDispose(void *opaque);
 
 
 
@@ -80,6 +83,20 @@ struct _virStorageVolObjList {
     virHashTable *objsPath;
 };
 
+/* Volumes of all pools in a virStoragePoolObjList, so that looking up a
+ * volume by key or path doesn't have to go through every pool */
+typedef struct _virStorageVolObjIndex virStorageVolObjIndex;
+typedef virStorageVolObjIndex *virStorageVolObjIndexPtr;
+struct _virStorageVolObjIndex {
+    virObjectLockable parent;
+
+    /* key string -> name of the pool with the volume */
+    virHashTable *objsKey;
+
+    /* path string -> name of the pool with the volume */
+    virHashTable *objsPath;
+};
+
 struct _virStoragePoolObj {
     virObjectLockable parent;
 
@@ -94,6 +111,7 @@ struct _virStoragePoolObj {
     virStoragePoolDefPtr newDef;
 
     virStorageVolObjListPtr volumes;
+    virStorageVolObjIndexPtr volIndex; /* of the list the pool is in */
 };
 
 struct _virStoragePoolObjList {
@@ -106,6 +124,9 @@ struct _virStoragePoolObjList {
     /* name string -> virStoragePoolObj mapping
      * for (1), lockless lookup-by-name */
     virHashTable *objsName;
+
+    /* volumes of all the pools in the list */
+    virStorageVolObjIndexPtr volIndex;
 };
 
 
@@ -194,6 +215,84 @@ virStorageVolObjListDispose(void *opaque)
 }
 
 
+static virStorageVolObjIndexPtr
+virStorageVolObjIndexNew(void)
+{
+    virStorageVolObjIndexPtr index;
+
+    if (!(index = virObjectLockableNew(virStorageVolObjIndexClass)))
+        return NULL;
+
+    if (!(index->objsKey = virHashCreate(20, virHashValueFree)) ||
+        !(index->objsPath = virHashCreate(20, virHashValueFree))) {
+        virObjectUnref(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+
+static void
+virStorageVolObjIndexDispose(void *opaque)
+{
+    virStorageVolObjIndexPtr index = opaque;
+
+    virHashFree(index->objsKey);
+    virHashFree(index->objsPath);
+}
+
+
+static void
+virStorageVolObjIndexAdd(virStoragePoolObjPtr obj,
+                         virStorageVolDefPtr voldef)
+{
+    virStorageVolObjIndexPtr index = obj->volIndex;
+
+    if (!index)
+        return;
+
+    /* Volumes with the same key or path in several pools are possible,
+     * the index remembers the latest one only */
+    virObjectLock(index);
+    ignore_value(virHashUpdateEntry(index->objsKey, voldef->key,
+                                    g_strdup(obj->def->name)));
+    ignore_value(virHashUpdateEntry(index->objsPath, voldef->target.path,
+                                    g_strdup(obj->def->name)));
+    virObjectUnlock(index);
+}
+
+
+static void
+virStorageVolObjIndexRemoveEntry(virHashTablePtr table,
+                                 const char *name,
+                                 const char *poolname)
+{
+    const char *owner = virHashLookup(table, name);
+
+    if (owner && STREQ(owner, poolname))
+        virHashRemoveEntry(table, name);
+}
+
+
+static void
+virStorageVolObjIndexRemove(virStoragePoolObjPtr obj,
+                            virStorageVolDefPtr voldef)
+{
+    virStorageVolObjIndexPtr index = obj->volIndex;
+
+    if (!index)
+        return;
+
+    virObjectLock(index);
+    virStorageVolObjIndexRemoveEntry(index->objsKey, voldef->key,
+                                     obj->def->name);
+    virStorageVolObjIndexRemoveEntry(index->objsPath, voldef->target.path,
+                                     obj->def->name);
+    virObjectUnlock(index);
+}
+
+
 static int
 virStoragePoolObjOnceInit(void)
 {
@@ -203,6 +302,9 @@ virStoragePoolObjOnceInit(void)
     if (!VIR_CLASS_NEW(virStoragePoolObjList, virClassForObjectRWLockable()))
         return -1;
 
+    if (!VIR_CLASS_NEW(virStorageVolObjIndex, virClassForObjectLockable()))
+        return -1;
+
     return 0;
 }
 
@@ -374,6 +476,7 @@ virStoragePoolObjDispose(void *opaque)
 
     virStoragePoolObjClearVols(obj);
     virObjectUnref(obj->volumes);
+    virObjectUnref(obj->volIndex);
 
     virStoragePoolDefFree(obj->def);
     virStoragePoolDefFree(obj->newDef);
@@ -390,6 +493,7 @@ virStoragePoolObjListDispose(void *opaque)
 
     virHashFree(pools->objs);
     virHashFree(pools->objsName);
+    virObjectUnref(pools->volIndex);
 }
 
 
@@ -405,7 +509,8 @@ virStoragePoolObjListNew(void)
         return NULL;
 
     if (!(pools->objs = virHashCreate(20, virObjectFreeHashData)) ||
-        !(pools->objsName = virHashCreate(20, virObjectFreeHashData))) {
+        !(pools->objsName = virHashCreate(20, virObjectFreeHashData)) ||
+        !(pools->volIndex = virStorageVolObjIndexNew())) {
         virObjectUnref(pools);
         return NULL;
     }
@@ -521,6 +626,85 @@ virStoragePoolObjListSearch(virStoragePoolObjListPtr pools,
 }
 
 
+static virStoragePoolObjPtr
+virStoragePoolObjListFindVol(virStoragePoolObjListPtr pools,
+                             const char *str,
+                             bool byPath,
+                             virStorageVolDefPtr *voldef)
+{
+    virStorageVolObjIndexPtr index = pools->volIndex;
+    g_autofree char *poolname = NULL;
+    virStoragePoolObjPtr obj;
+
+    *voldef = NULL;
+
+    virObjectLock(index);
+    poolname = g_strdup(virHashLookup(byPath ? index->objsPath : index->objsKey,
+                                      str));
+    virObjectUnlock(index);
+
+    if (!poolname ||
+        !(obj = virStoragePoolObjFindByName(pools, poolname)))
+        return NULL;
+
+    if (virStoragePoolObjIsActive(obj)) {
+        if (byPath)
+            *voldef = virStorageVolDefFindByPath(obj, str);
+        else
+            *voldef = virStorageVolDefFindByKey(obj, str);
+    }
+
+    if (!*voldef)
+        virStoragePoolObjEndAPI(&obj);
+
+    return obj;
+}
+
+
+/**
+ * virStoragePoolObjListFindVolByKey
+ * @pools: Pointer to pools object
+ * @key: volume key
+ * @voldef: filled with the volume definition
+ *
+ * Looks up an active pool with a volume with @key without going through
+ * all the pools. No error is reported if there's none.
+ *
+ * Returns a locked and reffed pool object when found and NULL when not
+ * found
+ */
+virStoragePoolObjPtr
+virStoragePoolObjListFindVolByKey(virStoragePoolObjListPtr pools,
+                                  const char *key,
+                                  virStorageVolDefPtr *voldef)
+{
+    return virStoragePoolObjListFindVol(pools, key, false, voldef);
+}
+
+
+/**
+ * virStoragePoolObjListFindVolByPath
+ * @pools: Pointer to pools object
+ * @path: volume target path
+ * @voldef: filled with the volume definition
+ *
+ * Looks up an active pool with a volume with @path as its target path
+ * without going through all the pools. Unlike looking up volumes by path
+ * through each of the pools, @path is not translated to the stable path
+ * of the pool first. No error is reported if there's none.
+ *
+ * Returns a locked and reffed pool object when found and NULL when not
+ * found
+ */
+virStoragePoolObjPtr
+virStoragePoolObjListFindVolByPath(virStoragePoolObjListPtr pools,
+                                   const char *path,
+                                   virStorageVolDefPtr *voldef)
+{
+    return virStoragePoolObjListFindVol(pools, path, true, voldef);
+}
+
+
 void
 virStoragePoolObjRemove(virStoragePoolObjListPtr pools,
                         virStoragePoolObjPtr obj)
@@ -626,12 +810,31 @@ virStoragePoolSourceFindDuplicateDevices(virStoragePoolObjPtr obj,
 }
 
 
+static int
+virStoragePoolObjClearVolsIndexCb(void *payload,
+                                  const void *name G_GNUC_UNUSED,
+                                  void *opaque)
+{
+    virStorageVolObjPtr volobj = payload;
+    virStoragePoolObjPtr obj = opaque;
+
+    if (volobj->voldef)
+        virStorageVolObjIndexRemove(obj, volobj->voldef);
+
+    return 0;
+}
+
+
 void
 virStoragePoolObjClearVols(virStoragePoolObjPtr obj)
 {
     if (!obj->volumes)
         return;
 
+    if (obj->volIndex)
+        virHashForEach(obj->volumes->objsName,
+                       virStoragePoolObjClearVolsIndexCb, obj);
+
     virHashRemoveAll(obj->volumes->objsKey);
     virHashRemoveAll(obj->volumes->objsName);
     virHashRemoveAll(obj->volumes->objsPath);
@@ -668,6 +871,7 @@ virStoragePoolObjAddVol(virStoragePoolObjPtr obj,
     virObjectRef(volobj);
 
     volobj->voldef = voldef;
+    virStorageVolObjIndexAdd(obj, voldef);
     virObjectRWUnlock(volumes);
     virStorageVolObjEndAPI(&volobj);
     return 0;
@@ -699,6 +903,7 @@ virStoragePoolObjRemoveVol(virStoragePoolObjPtr obj,
 
     virObjectRef(volobj);
     virObjectLock(volobj);
+    virStorageVolObjIndexRemove(obj, voldef);
     virHashRemoveEntry(volumes->objsKey, voldef->key);
     virHashRemoveEntry(volumes->objsName, voldef->name);
     virHashRemoveEntry(volumes->objsPath, voldef->target.path);
@@ -1590,6 +1795,7 @@ virStoragePoolObjListAdd(virStoragePoolObjListPtr pools,
 
     if (!(obj = virStoragePoolObjNew()))
         goto error;
+    obj->volIndex = virObjectRef(pools->volIndex);
 
     virUUIDFormat(def->uuid, uuidstr);
     if (virHashAddEntry(pools->objs, uuidstr, obj) < 0)
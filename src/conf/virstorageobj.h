@@ -256,6 +256,16 @@ virStoragePoolObjListSearch(virStoragePoolObjListPtr pools,
                             virStoragePoolObjListSearcher searcher,
                             const void *opaque);
 
+virStoragePoolObjPtr
+virStoragePoolObjListFindVolByKey(virStoragePoolObjListPtr pools,
+                                  const char *key,
+                                  virStorageVolDefPtr *voldef);
+
+virStoragePoolObjPtr
+virStoragePoolObjListFindVolByPath(virStoragePoolObjListPtr pools,
+                                   const char *path,
+                                   virStorageVolDefPtr *voldef);
+
 virStoragePoolObjListPtr
 virStoragePoolObjListNew(void);
 
@@ -20,6 +20,8 @@
 
 #include <config.h>
 
+#include <sys/stat.h>
+
 #include "viralloc.h"
 #include "virfile.h"
 #include "cpu.h"
@@ -234,3 +236,79 @@ int cpuMapLoad(const char *arch,
 
     return ret;
 }
+
+
+/**
+ * cpuMapGetStamp:
+ * @prefix: file name prefix of CPU map files of an architecture
+ *
+ * Describes the installed index.xml and the CPU map files starting with
+ * @prefix so that data parsed from them can be stored and reused until any
+ * of the files changes. Returns NULL if the CPU map is used directly from
+ * the source tree or the installed files cannot be listed.
+ */
+char *
+cpuMapGetStamp(const char *prefix)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *index = NULL;
+    g_autofree char *dir = NULL;
+    char **files = NULL;
+    DIR *dh = NULL;
+    struct dirent *ent;
+    char *ret = NULL;
+    size_t nfiles;
+    size_t i;
+    int rc;
+
+    if (!(index = virFileFindResource("index.xml",
+                                      abs_top_srcdir "/src/cpu_map",
+                                      PKGDATADIR "/cpu_map")))
+        return NULL;
+
+    if (!STRPREFIX(index, PKGDATADIR "/"))
+        return NULL;
+
+    dir = g_path_get_dirname(index);
+
+    if (virDirOpenQuiet(&dh, dir) < 0)
+        goto cleanup;
+
+    while ((rc = virDirRead(dh, &ent, dir)) > 0) {
+        if (STRNEQ(ent->d_name, "index.xml") &&
+            !(STRPREFIX(ent->d_name, prefix) &&
+              virStringHasSuffix(ent->d_name, ".xml")))
+            continue;
+
+        if (virStringListAdd(&files, ent->d_name) < 0)
+            goto cleanup;
+    }
+
+    if (rc < 0 || !files)
+        goto cleanup;
+
+    nfiles = virStringListLength((const char **) files);
+    qsort(files, nfiles, sizeof(*files), virStringSortCompare);
+
+    for (i = 0; i < nfiles; i++) {
+        g_autofree char *path = g_build_filename(dir, files[i], NULL);
+        struct stat sb;
+
+        if (stat(path, &sb) < 0)
+            goto cleanup;
+
+        virBufferAsprintf(&buf, "%s:%llu:%lld:%lld;", files[i],
+                          (unsigned long long) sb.st_ino,
+                          (long long) sb.st_size,
+                          (long long) sb.st_mtime);
+    }
+
+    ret = virBufferContentAndReset(&buf);
+
+ cleanup:
+    if (!ret)
+        virResetLastError();
+    VIR_DIR_CLOSE(dh);
+    virStringListFree(files);
+    return ret;
+}
@@ -33,3 +33,6 @@ cpuMapLoad(const char *arch,
            cpuMapLoadCallback featureCB,
            cpuMapLoadCallback modelCB,
            void *data);
+
+char *
+cpuMapGetStamp(const char *prefix);
@@ -20,6 +20,8 @@
 
 #include <config.h>
 
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "virlog.h"
 #include "viralloc.h"
@@ -30,6 +32,11 @@
 #include "virendian.h"
 #include "virstring.h"
 #include "virhostcpu.h"
+#include "virhash.h"
+#include "virthread.h"
+#include "virfile.h"
+#include "virutil.h"
+#include "configmake.h"
 
 #define VIR_FROM_THIS VIR_FROM_CPU
 
@@ -146,6 +153,42 @@ struct _virCPUx86Map {
 
 static virCPUx86MapPtr cpuMap;
 
+/* Results of x86Decode, since decoding the same CPUID data against the same
+ * list of models is repeated for domain capabilities, host-model guests and
+ * migration checks. The map never changes once loaded, so only the number
+ * of entries needs to be limited. */
+#define X86_DECODE_CACHE_MAX 64
+
+typedef struct _virCPUx86DecodeResult virCPUx86DecodeResult;
+typedef virCPUx86DecodeResult *virCPUx86DecodeResultPtr;
+struct _virCPUx86DecodeResult {
+    char *vendor;
+    char *model;
+    size_t nfeatures;
+    virCPUFeatureDefPtr features;
+};
+
+static virHashTablePtr decodeCache;
+static virMutex decodeCacheLock = VIR_MUTEX_INITIALIZER;
+
+
+static void
+x86DecodeResultFree(void *opaque)
+{
+    virCPUx86DecodeResultPtr result = opaque;
+    size_t i;
+
+    if (!result)
+        return;
+
+    for (i = 0; i < result->nfeatures; i++)
+        g_free(result->features[i].name);
+    g_free(result->features);
+    g_free(result->vendor);
+    g_free(result->model);
+    g_free(result);
+}
+
 int virCPUx86DriverOnceInit(void);
 VIR_ONCE_GLOBAL_INIT(virCPUx86Driver);
 
@@ -1573,10 +1616,344 @@ x86MapFree(virCPUx86MapPtr map)
 }
 
 
+/* The parsed CPU map is stored in a GVariant which can be mapped directly
+ * from the cache file by the next process loading the map. The stamp
+ * describing the XML files the map was parsed from is stored too, editing
+ * any of them makes the cache stale.
+ */
+#define X86_MAP_CACHE_FILE "cpu_map_x86.bin"
+#define X86_MAP_CACHE_VERSION 1
+#define X86_MAP_CACHE_ITEM "(uuuuuuu)"
+#define X86_MAP_CACHE_VENDOR "(s" X86_MAP_CACHE_ITEM ")"
+#define X86_MAP_CACHE_FEATURE "(sba" X86_MAP_CACHE_ITEM ")"
+#define X86_MAP_CACHE_MODEL "(siaua" X86_MAP_CACHE_ITEM ")"
+#define X86_MAP_CACHE_TYPE \
+    "(sa" X86_MAP_CACHE_VENDOR "a" X86_MAP_CACHE_FEATURE \
+    "a" X86_MAP_CACHE_MODEL ")"
+
+static GVariant *
+x86MapCacheFormatItem(const virCPUx86DataItem *item)
+{
+    const virCPUx86CPUID *cpuid = &item->data.cpuid;
+    const virCPUx86MSR *msr = &item->data.msr;
+
+    switch (item->type) {
+    case VIR_CPU_X86_DATA_CPUID:
+        return g_variant_new(X86_MAP_CACHE_ITEM, item->type,
+                             cpuid->eax_in, cpuid->ecx_in,
+                             cpuid->eax, cpuid->ebx, cpuid->ecx, cpuid->edx);
+
+    case VIR_CPU_X86_DATA_MSR:
+        return g_variant_new(X86_MAP_CACHE_ITEM, item->type,
+                             msr->index, msr->eax, msr->edx, 0, 0, 0);
+
+    case VIR_CPU_X86_DATA_NONE:
+    default:
+        return g_variant_new(X86_MAP_CACHE_ITEM, item->type, 0, 0, 0, 0, 0, 0);
+    }
+}
+
+
+static void
+x86MapCacheParseItem(GVariant *value,
+                     virCPUx86DataItemPtr item)
+{
+    guint32 type;
+    guint32 word[6];
+
+    g_variant_get(value, X86_MAP_CACHE_ITEM, &type,
+                  &word[0], &word[1], &word[2], &word[3], &word[4], &word[5]);
+
+    memset(item, 0, sizeof(*item));
+    item->type = type;
+
+    switch (item->type) {
+    case VIR_CPU_X86_DATA_CPUID:
+        item->data.cpuid.eax_in = word[0];
+        item->data.cpuid.ecx_in = word[1];
+        item->data.cpuid.eax = word[2];
+        item->data.cpuid.ebx = word[3];
+        item->data.cpuid.ecx = word[4];
+        item->data.cpuid.edx = word[5];
+        break;
+
+    case VIR_CPU_X86_DATA_MSR:
+        item->data.msr.index = word[0];
+        item->data.msr.eax = word[1];
+        item->data.msr.edx = word[2];
+        break;
+
+    case VIR_CPU_X86_DATA_NONE:
+    default:
+        break;
+    }
+}
+
+
+static GVariant *
+x86MapCacheFormatData(const virCPUx86Data *data)
+{
+    GVariantBuilder items;
+    size_t i;
+
+    g_variant_builder_init(&items, G_VARIANT_TYPE("a" X86_MAP_CACHE_ITEM));
+    for (i = 0; i < data->len; i++)
+        g_variant_builder_add_value(&items, x86MapCacheFormatItem(&data->items[i]));
+
+    return g_variant_builder_end(&items);
+}
+
+
+static int
+x86MapCacheParseData(GVariant *value,
+                     virCPUx86Data *data)
+{
+    size_t n = g_variant_n_children(value);
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        g_autoptr(GVariant) child = g_variant_get_child_value(value, i);
+        virCPUx86DataItem item;
+
+        x86MapCacheParseItem(child, &item);
+        if (virCPUx86DataAddItem(data, &item) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+static void
+x86MapCacheSave(virCPUx86MapPtr map,
+                const char *stamp,
+                const char *filename)
+{
+    g_autoptr(GVariant) root = NULL;
+    g_autoptr(GError) err = NULL;
+    g_autofree char *dir = NULL;
+    GVariantBuilder vendors;
+    GVariantBuilder features;
+    GVariantBuilder models;
+    size_t i;
+    size_t j;
+
+    g_variant_builder_init(&vendors, G_VARIANT_TYPE("a" X86_MAP_CACHE_VENDOR));
+    for (i = 0; i < map->nvendors; i++) {
+        g_variant_builder_add(&vendors, "(s@" X86_MAP_CACHE_ITEM ")",
+                              map->vendors[i]->name,
+                              x86MapCacheFormatItem(&map->vendors[i]->data));
+    }
+
+    g_variant_builder_init(&features, G_VARIANT_TYPE("a" X86_MAP_CACHE_FEATURE));
+    for (i = 0; i < map->nfeatures; i++) {
+        g_variant_builder_add(&features, "(sb@a" X86_MAP_CACHE_ITEM ")",
+                              map->features[i]->name,
+                              map->features[i]->migratable,
+                              x86MapCacheFormatData(&map->features[i]->data));
+    }
+
+    g_variant_builder_init(&models, G_VARIANT_TYPE("a" X86_MAP_CACHE_MODEL));
+    for (i = 0; i < map->nmodels; i++) {
+        virCPUx86ModelPtr model = map->models[i];
+        int vendor = -1;
+
+        for (j = 0; j < map->nvendors; j++) {
+            if (model->vendor == map->vendors[j])
+                vendor = j;
+        }
+
+        g_variant_builder_add(&models, "(si@au@a" X86_MAP_CACHE_ITEM ")",
+                              model->name, vendor,
+                              g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32,
+                                                        model->signatures,
+                                                        model->nsignatures,
+                                                        sizeof(uint32_t)),
+                              x86MapCacheFormatData(&model->data));
+    }
+
+    root = g_variant_new("(uv)", X86_MAP_CACHE_VERSION,
+                         g_variant_new(X86_MAP_CACHE_TYPE, stamp,
+                                       &vendors, &features, &models));
+    g_variant_ref_sink(root);
+
+    dir = g_path_get_dirname(filename);
+    if (virFileMakePath(dir) < 0) {
+        VIR_DEBUG("Cannot create directory '%s' for CPU map cache", dir);
+        return;
+    }
+
+    if (!g_file_set_contents(filename, g_variant_get_data(root),
+                             g_variant_get_size(root), &err)) {
+        VIR_DEBUG("Cannot save CPU map cache '%s': %s", filename, err->message);
+        return;
+    }
+
+    /* Readable by session daemons */
+    ignore_value(chmod(filename, 0644));
+
+    VIR_DEBUG("Saved x86 CPU map to '%s'", filename);
+}
+
+
+static virCPUx86MapPtr
+x86MapCacheLoad(const char *stamp,
+                const char *filename)
+{
+    g_autoptr(GMappedFile) file = NULL;
+    g_autoptr(GBytes) bytes = NULL;
+    g_autoptr(GVariant) root = NULL;
+    g_autoptr(GVariant) data = NULL;
+    g_autoptr(GVariant) vendors = NULL;
+    g_autoptr(GVariant) features = NULL;
+    g_autoptr(GVariant) models = NULL;
+    virCPUx86MapPtr map = NULL;
+    const char *cachedStamp;
+    guint32 version;
+    size_t i;
+
+    if (!(file = g_mapped_file_new(filename, FALSE, NULL)))
+        return NULL;
+
+    bytes = g_mapped_file_get_bytes(file);
+    root = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE("(uv)"),
+                                                       bytes, FALSE));
+    g_variant_get(root, "(uv)", &version, &data);
+
+    if (version != X86_MAP_CACHE_VERSION ||
+        !g_variant_is_of_type(data, G_VARIANT_TYPE(X86_MAP_CACHE_TYPE))) {
+        VIR_DEBUG("Unsupported format of CPU map cache '%s'", filename);
+        return NULL;
+    }
+
+    g_variant_get(data, "(&s@a" X86_MAP_CACHE_VENDOR "@a" X86_MAP_CACHE_FEATURE
+                  "@a" X86_MAP_CACHE_MODEL ")",
+                  &cachedStamp, &vendors, &features, &models);
+
+    if (STRNEQ(cachedStamp, stamp)) {
+        VIR_DEBUG("CPU map cache '%s' is out of date", filename);
+        return NULL;
+    }
+
+    if (VIR_ALLOC(map) < 0)
+        return NULL;
+
+    for (i = 0; i < g_variant_n_children(vendors); i++) {
+        g_autoptr(GVariant) child = g_variant_get_child_value(vendors, i);
+        g_autoptr(GVariant) item = NULL;
+        virCPUx86VendorPtr vendor;
+        const char *name;
+
+        g_variant_get(child, "(&s@" X86_MAP_CACHE_ITEM ")", &name, &item);
+
+        vendor = g_new0(virCPUx86Vendor, 1);
+        vendor->name = g_strdup(name);
+        x86MapCacheParseItem(item, &vendor->data);
+
+        if (VIR_APPEND_ELEMENT(map->vendors, map->nvendors, vendor) < 0) {
+            x86VendorFree(vendor);
+            goto error;
+        }
+    }
+
+    for (i = 0; i < g_variant_n_children(features); i++) {
+        g_autoptr(GVariant) child = g_variant_get_child_value(features, i);
+        g_autoptr(GVariant) items = NULL;
+        virCPUx86FeaturePtr feature;
+        const char *name;
+        gboolean migratable;
+
+        g_variant_get(child, "(&sb@a" X86_MAP_CACHE_ITEM ")",
+                      &name, &migratable, &items);
+
+        if (!(feature = x86FeatureNew()))
+            goto error;
+        feature->name = g_strdup(name);
+        feature->migratable = migratable;
+
+        if (x86MapCacheParseData(items, &feature->data) < 0 ||
+            (!feature->migratable &&
+             VIR_APPEND_ELEMENT_COPY(map->migrate_blockers,
+                                     map->nblockers, feature) < 0) ||
+            VIR_APPEND_ELEMENT(map->features, map->nfeatures, feature) < 0) {
+            x86FeatureFree(feature);
+            goto error;
+        }
+    }
+
+    for (i = 0; i < g_variant_n_children(models); i++) {
+        g_autoptr(GVariant) child = g_variant_get_child_value(models, i);
+        g_autoptr(GVariant) signatures = NULL;
+        g_autoptr(GVariant) items = NULL;
+        virCPUx86ModelPtr model;
+        const guint32 *sigs;
+        const char *name;
+        gint32 vendor;
+        gsize nsigs;
+
+        g_variant_get(child, "(&si@au@a" X86_MAP_CACHE_ITEM ")",
+                      &name, &vendor, &signatures, &items);
+
+        if (vendor >= (gint32) map->nvendors) {
+            VIR_DEBUG("Invalid vendor of CPU model %s in CPU map cache", name);
+            goto error;
+        }
+
+        if (!(model = x86ModelNew()))
+            goto error;
+        model->name = g_strdup(name);
+        if (vendor >= 0)
+            model->vendor = map->vendors[vendor];
+
+        sigs = g_variant_get_fixed_array(signatures, &nsigs, sizeof(guint32));
+        if (nsigs > 0) {
+            model->signatures = g_new0(uint32_t, nsigs);
+            memcpy(model->signatures, sigs, nsigs * sizeof(uint32_t));
+            model->nsignatures = nsigs;
+        }
+
+        if (x86MapCacheParseData(items, &model->data) < 0 ||
+            VIR_APPEND_ELEMENT(map->models, map->nmodels, model) < 0) {
+            x86ModelFree(model);
+            goto error;
+        }
+    }
+
+    return map;
+
+ error:
+    x86MapFree(map);
+    return NULL;
+}
+
+
 static virCPUx86MapPtr
 virCPUx86LoadMap(void)
 {
     virCPUx86MapPtr map;
+    g_autofree char *stamp = cpuMapGetStamp("x86_");
+    g_autofree char *systemCache = NULL;
+    g_autofree char *cache = NULL;
+
+    if (stamp) {
+        systemCache = g_strdup(LOCALSTATEDIR "/cache/libvirt/" X86_MAP_CACHE_FILE);
+
+        if (geteuid() == 0) {
+            cache = g_strdup(systemCache);
+        } else {
+            g_autofree char *cachedir = virGetUserCacheDirectory();
+
+            cache = g_build_filename(cachedir, X86_MAP_CACHE_FILE, NULL);
+        }
+
+        /* session daemons can use the map cached by the system daemon */
+        if ((map = x86MapCacheLoad(stamp, systemCache)) ||
+            (STRNEQ(cache, systemCache) &&
+             (map = x86MapCacheLoad(stamp, cache)))) {
+            VIR_DEBUG("Loaded x86 CPU map from cache");
+            return map;
+        }
+    }
 
     if (VIR_ALLOC(map) < 0)
         return NULL;
@@ -1584,6 +1961,9 @@ virCPUx86LoadMap(void)
     if (cpuMapLoad("x86", x86VendorParse, x86FeatureParse, x86ModelParse, map) < 0)
         goto error;
 
+    if (stamp)
+        x86MapCacheSave(map, stamp, cache);
+
     return map;
 
  error:
@@ -1598,6 +1978,9 @@ virCPUx86DriverOnceInit(void)
     if (!(cpuMap = virCPUx86LoadMap()))
         return -1;
 
+    if (!(decodeCache = virHashNew(x86DecodeResultFree)))
+        return -1;
+
     return 0;
 }
 
@@ -2093,11 +2476,11 @@ x86DataFilterTSX(virCPUx86Data *data,
 
 
 static int
-x86Decode(virCPUDefPtr cpu,
-          const virCPUx86Data *cpuData,
-          virDomainCapsCPUModelsPtr models,
-          const char *preferred,
-          bool migratable)
+x86DecodeModel(virCPUDefPtr cpu,
+               const virCPUx86Data *cpuData,
+               virDomainCapsCPUModelsPtr models,
+               const char *preferred,
+               bool migratable)
 {
     int ret = -1;
     virCPUx86MapPtr map;
@@ -2225,6 +2608,123 @@ x86Decode(virCPUDefPtr cpu,
     return ret;
 }
 
+/* Every input of x86DecodeModel which affects its result */
+static char *
+x86DecodeCacheKey(const virCPUDef *cpu,
+                  const virCPUx86Data *cpuData,
+                  virDomainCapsCPUModelsPtr models,
+                  const char *preferred,
+                  bool migratable)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    size_t i;
+
+    virBufferAsprintf(&buf, "%d:%d:%d:%s;", cpu->type, cpu->fallback,
+                      migratable, NULLSTR(preferred));
+
+    for (i = 0; i < cpuData->len; i++) {
+        const virCPUx86DataItem *item = &cpuData->items[i];
+
+        switch (item->type) {
+        case VIR_CPU_X86_DATA_CPUID:
+            virBufferAsprintf(&buf, "c%x,%x,%x,%x,%x,%x;",
+                              item->data.cpuid.eax_in, item->data.cpuid.ecx_in,
+                              item->data.cpuid.eax, item->data.cpuid.ebx,
+                              item->data.cpuid.ecx, item->data.cpuid.edx);
+            break;
+
+        case VIR_CPU_X86_DATA_MSR:
+            virBufferAsprintf(&buf, "m%x,%x,%x;",
+                              item->data.msr.index,
+                              item->data.msr.eax, item->data.msr.edx);
+            break;
+
+        case VIR_CPU_X86_DATA_NONE:
+        default:
+            break;
+        }
+    }
+
+    if (models) {
+        virBufferAddLit(&buf, "models");
+        for (i = 0; i < models->nmodels; i++) {
+            virDomainCapsCPUModelPtr model = models->models + i;
+            char **blocker;
+
+            virBufferAsprintf(&buf, ";%s,%d", model->name, model->usable);
+            for (blocker = model->blockers; blocker && *blocker; blocker++)
+                virBufferAsprintf(&buf, ",%s", *blocker);
+        }
+    }
+
+    return virBufferContentAndReset(&buf);
+}
+
+
+static void
+x86DecodeCopyFeatures(virCPUFeatureDefPtr *dst,
+                      const virCPUFeatureDef *src,
+                      size_t nfeatures)
+{
+    size_t i;
+
+    *dst = g_new0(virCPUFeatureDef, nfeatures);
+    for (i = 0; i < nfeatures; i++) {
+        (*dst)[i].name = g_strdup(src[i].name);
+        (*dst)[i].policy = src[i].policy;
+    }
+}
+
+
+static int
+x86Decode(virCPUDefPtr cpu,
+          const virCPUx86Data *cpuData,
+          virDomainCapsCPUModelsPtr models,
+          const char *preferred,
+          bool migratable)
+{
+    g_autofree char *key = NULL;
+    virCPUx86DecodeResultPtr result;
+
+    if (!cpuData || virCPUx86DriverInitialize() < 0)
+        return x86DecodeModel(cpu, cpuData, models, preferred, migratable);
+
+    key = x86DecodeCacheKey(cpu, cpuData, models, preferred, migratable);
+
+    virMutexLock(&decodeCacheLock);
+    if ((result = virHashLookup(decodeCache, key))) {
+        VIR_DEBUG("Using cached CPU model %s", result->model);
+        cpu->vendor = g_strdup(result->vendor);
+        cpu->model = g_strdup(result->model);
+        x86DecodeCopyFeatures(&cpu->features, result->features,
+                              result->nfeatures);
+        cpu->nfeatures = result->nfeatures;
+        cpu->nfeatures_max = result->nfeatures;
+        virMutexUnlock(&decodeCacheLock);
+        return 0;
+    }
+    virMutexUnlock(&decodeCacheLock);
+
+    if (x86DecodeModel(cpu, cpuData, models, preferred, migratable) < 0)
+        return -1;
+
+    result = g_new0(virCPUx86DecodeResult, 1);
+    result->vendor = g_strdup(cpu->vendor);
+    result->model = g_strdup(cpu->model);
+    x86DecodeCopyFeatures(&result->features, cpu->features, cpu->nfeatures);
+    result->nfeatures = cpu->nfeatures;
+
+    virMutexLock(&decodeCacheLock);
+    if (virHashSize(decodeCache) >= X86_DECODE_CACHE_MAX)
+        virHashRemoveAll(decodeCache);
+    if (virHashUpdateEntry(decodeCache, key, result) < 0)
+        x86DecodeResultFree(result);
+    virMutexUnlock(&decodeCacheLock);
+
+    return 0;
+}
+
+
 static int
 x86DecodeCPUData(virCPUDefPtr cpu,
                  const virCPUData *data,
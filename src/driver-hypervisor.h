@@ -1135,6 +1135,33 @@ typedef int
                                  int nparams,
                                  unsigned int flags);
 
+typedef int
+(*virDrvNodeGetMigrationParameters)(virConnectPtr conn,
+                                    virTypedParameterPtr *params,
+                                    int *nparams,
+                                    unsigned int flags);
+
+typedef int
+(*virDrvNodeSetMigrationParameters)(virConnectPtr conn,
+                                    virTypedParameterPtr params,
+                                    int nparams,
+                                    unsigned int flags);
+
+typedef int
+(*virDrvDomainBlockPeekStream)(virDomainPtr domain,
+                               virStreamPtr stream,
+                               const char *disk,
+                               unsigned long long offset,
+                               unsigned long long length,
+                               unsigned int flags);
+
+typedef int
+(*virDrvDomainMemoryPeekStream)(virDomainPtr domain,
+                                virStreamPtr stream,
+                                unsigned long long start,
+                                unsigned long long length,
+                                unsigned int flags);
+
 typedef int
 (*virDrvNodeGetCPUMap)(virConnectPtr conn,
                        unsigned char **cpumap,
@@ -1194,6 +1221,12 @@ typedef int
                                            int *cookieoutlen,
                                            unsigned int flags);
 
+typedef int
+(*virDrvDomainMigratePrepareTunnelStripe)(virDomainPtr dom,
+                                          virStreamPtr st,
+                                          unsigned int stripe,
+                                          unsigned int flags);
+
 typedef int
 (*virDrvDomainMigratePerform3Params)(virDomainPtr dom,
                                      const char *dconnuri,
@@ -1260,6 +1293,26 @@ typedef int
                                   virDomainStatsRecordPtr **retStats,
                                   unsigned int flags);
 
+typedef int
+(*virDrvConnectGetAllDomainXML)(virConnectPtr conn,
+                                virDomainPtr *doms,
+                                unsigned int ndoms,
+                                unsigned int xmlflags,
+                                virDomainXMLRecordPtr **records,
+                                unsigned int flags);
+
+typedef int
+(*virDrvDomainAttachDeviceList)(virDomainPtr domain,
+                                const char **xmls,
+                                unsigned int nxmls,
+                                unsigned int flags);
+
+typedef int
+(*virDrvDomainDetachDeviceList)(virDomainPtr domain,
+                                const char **xmls,
+                                unsigned int nxmls,
+                                unsigned int flags);
+
 typedef int
 (*virDrvNodeAllocPages)(virConnectPtr conn,
                         unsigned int npages,
@@ -1372,6 +1425,14 @@ typedef int
                             int *nparams,
                             unsigned int flags);
 
+typedef int
+(*virDrvConnectGetAllDomainGuestInfo)(virConnectPtr conn,
+                                      virDomainPtr *doms,
+                                      unsigned int ndoms,
+                                      unsigned int types,
+                                      virDomainStatsRecordPtr **retInfo,
+                                      unsigned int flags);
+
 typedef int
 (*virDrvDomainAgentSetResponseTimeout)(virDomainPtr domain,
                                        int timeout,
@@ -1650,4 +1711,13 @@ struct _virHypervisorDriver {
     virDrvDomainAgentSetResponseTimeout domainAgentSetResponseTimeout;
     virDrvDomainBackupBegin domainBackupBegin;
     virDrvDomainBackupGetXMLDesc domainBackupGetXMLDesc;
+    virDrvDomainMigratePrepareTunnelStripe domainMigratePrepareTunnelStripe;
+    virDrvConnectGetAllDomainXML connectGetAllDomainXML;
+    virDrvDomainAttachDeviceList domainAttachDeviceList;
+    virDrvDomainDetachDeviceList domainDetachDeviceList;
+    virDrvConnectGetAllDomainGuestInfo connectGetAllDomainGuestInfo;
+    virDrvNodeGetMigrationParameters nodeGetMigrationParameters;
+    virDrvNodeSetMigrationParameters nodeSetMigrationParameters;
+    virDrvDomainBlockPeekStream domainBlockPeekStream;
+    virDrvDomainMemoryPeekStream domainMemoryPeekStream;
 };
@@ -45,6 +45,11 @@ typedef int
 typedef int
 (*virDrvStateStop)(void);
 
+typedef int
+(*virDrvStateGetReconnectInfo)(unsigned int *total,
+                               unsigned int *done,
+                               unsigned int *failed);
+
 typedef struct _virStateDriver virStateDriver;
 typedef virStateDriver *virStateDriverPtr;
 
@@ -55,4 +60,5 @@ struct _virStateDriver {
     virDrvStateCleanup stateCleanup;
     virDrvStateReload stateReload;
     virDrvStateStop stateStop;
+    virDrvStateGetReconnectInfo stateGetReconnectInfo;
 };
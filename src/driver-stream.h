@@ -75,6 +75,9 @@ typedef int
 typedef int
 (*virDrvStreamAbort)(virStreamPtr st);
 
+typedef size_t
+(*virDrvStreamGetChunkSize)(virStreamPtr st);
+
 typedef struct _virStreamDriver virStreamDriver;
 typedef virStreamDriver *virStreamDriverPtr;
 
@@ -90,4 +93,5 @@ struct _virStreamDriver {
     virDrvStreamEventRemoveCallback streamEventRemoveCallback;
     virDrvStreamFinish streamFinish;
     virDrvStreamAbort streamAbort;
+    virDrvStreamGetChunkSize streamGetChunkSize;
 };
@@ -115,6 +115,16 @@ virThreadLocal connectNodeDev;
 virThreadLocal connectSecret;
 virThreadLocal connectStorage;
 
+/* Secret connection opened while the thread holds it, see
+ * virHoldConnectSecret */
+typedef struct _virConnectHeld virConnectHeld;
+struct _virConnectHeld {
+    size_t refs;
+    virConnectPtr conn;
+};
+
+static virThreadLocal connectSecretHeld;
+
 static int
 virConnectCacheOnceInit(void)
 {
@@ -128,6 +138,8 @@ virConnectCacheOnceInit(void)
         return -1;
     if (virThreadLocalInit(&connectSecret, NULL) < 0)
         return -1;
+    if (virThreadLocalInit(&connectSecretHeld, NULL) < 0)
+        return -1;
     if (virThreadLocalInit(&connectStorage, NULL) < 0)
         return -1;
     return 0;
@@ -183,7 +195,23 @@ virConnectPtr virGetConnectNodeDev(void)
 
 virConnectPtr virGetConnectSecret(void)
 {
-    return virGetConnectGeneric(&connectSecret, "secret");
+    virConnectHeld *held;
+    virConnectPtr conn;
+
+    if (virConnectCacheInitialize() < 0)
+        return NULL;
+
+    if ((held = virThreadLocalGet(&connectSecretHeld)) && held->conn) {
+        VIR_DEBUG("Return held secret connection %p", held->conn);
+        return virObjectRef(held->conn);
+    }
+
+    conn = virGetConnectGeneric(&connectSecret, "secret");
+
+    if (held && conn)
+        held->conn = virObjectRef(conn);
+
+    return conn;
 }
 
 virConnectPtr virGetConnectStorage(void)
@@ -257,6 +285,62 @@ virSetConnectStorage(virConnectPtr conn)
     return virThreadLocalSet(&connectStorage, conn);
 }
 
+
+/**
+ * virHoldConnectSecret:
+ *
+ * Makes virGetConnectSecret keep the connection it opens next in the
+ * calling thread and return it every time it is called until the
+ * matching virReleaseConnectSecret. With split daemons, each secret
+ * connection is a new client of virtsecretd, so this saves opening one
+ * per secret when fetching all the secrets of a domain. No connection
+ * is opened if no secret is needed meanwhile. Calls may be nested.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+virHoldConnectSecret(void)
+{
+    virConnectHeld *held;
+
+    if (virConnectCacheInitialize() < 0)
+        return -1;
+
+    if (!(held = virThreadLocalGet(&connectSecretHeld))) {
+        held = g_new0(virConnectHeld, 1);
+
+        if (virThreadLocalSet(&connectSecretHeld, held) < 0) {
+            g_free(held);
+            return -1;
+        }
+    }
+
+    held->refs++;
+    return 0;
+}
+
+
+/**
+ * virReleaseConnectSecret:
+ *
+ * Undoes one virHoldConnectSecret, closing the held connection with the
+ * last one.
+ */
+void
+virReleaseConnectSecret(void)
+{
+    virConnectHeld *held;
+
+    if (virConnectCacheInitialize() < 0 ||
+        !(held = virThreadLocalGet(&connectSecretHeld)) ||
+        --held->refs > 0)
+        return;
+
+    ignore_value(virThreadLocalSet(&connectSecretHeld, NULL));
+    virObjectUnref(held->conn);
+    g_free(held);
+}
+
 bool
 virConnectValidateURIPath(const char *uriPath,
                           const char *entityName,
@@ -133,6 +133,9 @@ int virSetConnectNodeDev(virConnectPtr conn);
 int virSetConnectSecret(virConnectPtr conn);
 int virSetConnectStorage(virConnectPtr conn);
 
+int virHoldConnectSecret(void);
+void virReleaseConnectSecret(void);
+
 bool virConnectValidateURIPath(const char *uriPath,
                                const char *entityName,
                                bool privileged);
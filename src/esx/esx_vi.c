@@ -342,6 +342,10 @@ esxVI_CURL_Connect(esxVI_CURL *curl, esxUtil_ParsedUri *parsedUri)
     curl_easy_setopt(curl->handle, CURLOPT_WRITEFUNCTION,
                      esxVI_CURL_WriteBuffer);
     curl_easy_setopt(curl->handle, CURLOPT_ERRORBUFFER, curl->error);
+#if LIBCURL_VERSION_NUM >= 0x071900 /* 7.25.0 */
+    /* Keep the connection to the server open between calls */
+    curl_easy_setopt(curl->handle, CURLOPT_TCP_KEEPALIVE, 1L);
+#endif
 #if ESX_VI__CURL__ENABLE_DEBUG_OUTPUT
     curl_easy_setopt(curl->handle, CURLOPT_DEBUGFUNCTION, esxVI_CURL_Debug);
     curl_easy_setopt(curl->handle, CURLOPT_VERBOSE, 1);
@@ -1318,6 +1322,10 @@ esxVI_Context_Execute(esxVI_Context *ctx, const char *methodName,
                              "Fault: %s - %s"), (*response)->responseCode,
                            methodName, fault->faultcode, fault->faultstring);
 
+            /* The fault might be caused by an expired session, make
+             * the next esxVI_EnsureSession check it for sure */
+            g_atomic_int_set(&ctx->sessionValidUntil, 0);
+
             /* FIXME: Dump raw response until detail part gets deserialized */
             VIR_DEBUG("HTTP response code %d for call to '%s' [[[[%s]]]]",
                       (*response)->responseCode, methodName,
@@ -1888,6 +1896,19 @@ esxVI_BuildSelectSetCollection(esxVI_Context *ctx)
 
 
 
+/* Seconds after a successful check of the session during which it is
+ * assumed to be still valid. The server keeps idle sessions for
+ * several minutes, so this only saves a round trip for every call of
+ * bursts of API calls, like listing all domains and their info. */
+#define ESX_VI__SESSION__CHECK_INTERVAL 10
+
+static int
+esxVI_GetMonotonicSeconds(void)
+{
+    return g_get_monotonic_time() / G_USEC_PER_SEC;
+}
+
+
 /*
  * Cannot use the SessionIsActive() function here, because at least
  * ESX Server 3.5.0 build-64607 and ESX 4.0.0 build-171294 return an
@@ -1921,6 +1942,11 @@ esxVI_EnsureSession(esxVI_Context *ctx)
         goto cleanup;
     }
 
+    if (esxVI_GetMonotonicSeconds() < g_atomic_int_get(&ctx->sessionValidUntil)) {
+        result = 0;
+        goto cleanup;
+    }
+
     escapedPassword = esxUtil_EscapeForXml(ctx->password);
 
     if (!escapedPassword) {
@@ -1966,6 +1992,9 @@ esxVI_EnsureSession(esxVI_Context *ctx)
         goto cleanup;
     }
 
+    g_atomic_int_set(&ctx->sessionValidUntil,
+                     esxVI_GetMonotonicSeconds() + ESX_VI__SESSION__CHECK_INTERVAL);
+
     result = 0;
 
  cleanup:
@@ -53,6 +53,8 @@ hypervFreePrivate(hypervPrivate **priv)
     }
 
     hypervFreeParsedUri(&(*priv)->parsedUri);
+    VIR_FREE((*priv)->cache);
+    virMutexDestroy(&(*priv)->cacheLock);
     VIR_FREE(*priv);
 }
 
@@ -131,6 +133,13 @@ hypervConnectOpen(virConnectPtr conn, virConnectAuthPtr auth,
     if (VIR_ALLOC(priv) < 0)
         goto cleanup;
 
+    if (virMutexInit(&priv->cacheLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        VIR_FREE(priv);
+        goto cleanup;
+    }
+
     if (hypervParseUri(&priv->parsedUri, conn->uri) < 0)
         goto cleanup;
 
@@ -617,9 +626,16 @@ hypervDomainGetInfo(virDomainPtr domain, virDomainInfoPtr info)
     Msvm_VirtualSystemSettingData *virtualSystemSettingData = NULL;
     Msvm_ProcessorSettingData *processorSettingData = NULL;
     Msvm_MemorySettingData *memorySettingData = NULL;
+    int rc;
 
     memset(info, 0, sizeof(*info));
 
+    if ((rc = hypervGetDomainInfoCached(priv, domain->uuid, info)) < 0)
+        return -1;
+
+    if (rc > 0)
+        return 0;
+
     virUUIDFormat(domain->uuid, uuid_string);
 
     /* Get Msvm_ComputerSystem */
@@ -718,9 +734,21 @@ hypervDomainGetState(virDomainPtr domain, int *state, int *reason,
     int result = -1;
     hypervPrivate *priv = domain->conn->privateData;
     Msvm_ComputerSystem *computerSystem = NULL;
+    virDomainInfo info;
+    int rc;
 
     virCheckFlags(0, -1);
 
+    if ((rc = hypervGetDomainInfoCached(priv, domain->uuid, &info)) < 0)
+        return -1;
+
+    if (rc > 0) {
+        *state = info.state;
+        if (reason != NULL)
+            *reason = 0;
+        return 0;
+    }
+
     if (hypervMsvmComputerSystemFromDomain(domain, &computerSystem) < 0)
         goto cleanup;
 
@@ -24,6 +24,7 @@
 
 #include "internal.h"
 #include "virerror.h"
+#include "virthread.h"
 #include "hyperv_util.h"
 #include "openwsman.h"
 
@@ -33,9 +34,28 @@ enum _hypervWmiVersion {
     HYPERV_WMI_VERSION_V2,
 };
 
+typedef enum {
+    HYPERV_DOMAIN_INFO_CACHE_PROCESSOR = 1 << 0,
+    HYPERV_DOMAIN_INFO_CACHE_MEMORY = 1 << 1,
+} hypervDomainInfoCacheFlags;
+
+typedef struct _hypervDomainInfoCacheEntry hypervDomainInfoCacheEntry;
+typedef hypervDomainInfoCacheEntry *hypervDomainInfoCacheEntryPtr;
+struct _hypervDomainInfoCacheEntry {
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    virDomainInfo info;
+    unsigned int flags; /* hypervDomainInfoCacheFlags */
+};
+
 typedef struct _hypervPrivate hypervPrivate;
 struct _hypervPrivate {
     hypervParsedUri *parsedUri;
     WsManClient *client;
     hypervWmiVersion wmiVersion;
+
+    /* Info of all domains, see hypervGetDomainInfoCached */
+    virMutex cacheLock;
+    gint64 cacheExpiry; /* monotonic time in microseconds */
+    size_t ncache;
+    hypervDomainInfoCacheEntryPtr cache;
 };
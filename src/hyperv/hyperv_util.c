@@ -64,6 +64,15 @@ hypervParseUri(hypervParsedUri **parsedUri, virURIPtr uri)
                                (*parsedUri)->transport);
                 goto cleanup;
             }
+        } else if (STRCASEEQ(queryParam->name, "cache_ttl")) {
+            if (virStrToLong_ui(queryParam->value, NULL, 10,
+                                &(*parsedUri)->cacheTTL) < 0) {
+                virReportError(VIR_ERR_INVALID_ARG,
+                               _("Query parameter 'cache_ttl' has unexpected value "
+                                 "'%s' (should be a number of seconds)"),
+                               queryParam->value);
+                goto cleanup;
+            }
         } else {
             VIR_WARN("Ignoring unexpected query parameter '%s'",
                      queryParam->name);
@@ -28,6 +28,7 @@ typedef struct _hypervParsedUri hypervParsedUri;
 
 struct _hypervParsedUri {
     char *transport;
+    unsigned int cacheTTL; /* in seconds, 0 disables the cache */
 };
 
 int hypervParseUri(hypervParsedUri **parsedUri, virURIPtr uri);
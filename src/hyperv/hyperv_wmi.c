@@ -942,6 +942,7 @@ hypervInvokeMethod(hypervPrivate *priv, hypervInvokeParamsListPtr params,
     virBufferFreeAndReset(&query);
     hypervFreeObject(priv, (hypervObject *)job);
     hypervFreeInvokeParams(params);
+    hypervInvalidateDomainInfoCache(priv);
     return result;
 }
 
@@ -1439,6 +1440,7 @@ hypervInvokeMsvmComputerSystemRequestStateChange(virDomainPtr domain,
     VIR_FREE(returnValue);
     VIR_FREE(instanceID);
     hypervFreeObject(priv, (hypervObject *)concreteJob);
+    hypervInvalidateDomainInfoCache(priv);
 
     return result;
 }
@@ -1629,3 +1631,202 @@ hypervGetMsvmMemorySettingDataFromVSSD(hypervPrivate *priv,
 
     return 0;
 }
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Domain info cache
+ */
+
+static hypervDomainInfoCacheEntryPtr
+hypervDomainInfoCacheFind(hypervPrivate *priv, const char *uuid_string)
+{
+    size_t i;
+
+    for (i = 0; i < priv->ncache; i++) {
+        if (STRCASEEQ(priv->cache[i].uuid, uuid_string))
+            return &priv->cache[i];
+    }
+
+    return NULL;
+}
+
+
+/* Settings of a domain have instance IDs like Microsoft:<uuid>\<id>,
+ * the uuid being the one of the domain or of one of its snapshots */
+static hypervDomainInfoCacheEntryPtr
+hypervDomainInfoCacheFindByInstanceID(hypervPrivate *priv,
+                                      const char *instanceID)
+{
+    g_autofree char *uuid_string = NULL;
+    char *tmp;
+
+    if (!instanceID || !STRCASEPREFIX(instanceID, "Microsoft:"))
+        return NULL;
+
+    uuid_string = g_strdup(instanceID + strlen("Microsoft:"));
+    if (!(tmp = strchr(uuid_string, '\\')))
+        return NULL;
+    *tmp = '\0';
+
+    return hypervDomainInfoCacheFind(priv, uuid_string);
+}
+
+
+/* Fetches the info of all domains at once; must be called with
+ * priv->cacheLock held */
+static int
+hypervDomainInfoCacheRefresh(hypervPrivate *priv)
+{
+    int result = -1;
+    virBuffer query = VIR_BUFFER_INITIALIZER;
+    Msvm_ComputerSystem *computerSystemList = NULL;
+    Msvm_ComputerSystem *computerSystem;
+    Msvm_ProcessorSettingData *processorSettingDataList = NULL;
+    Msvm_ProcessorSettingData *processorSettingData;
+    Msvm_MemorySettingData *memorySettingDataList = NULL;
+    Msvm_MemorySettingData *memorySettingData;
+    hypervDomainInfoCacheEntryPtr entry;
+    size_t i;
+
+    VIR_FREE(priv->cache);
+    priv->ncache = 0;
+
+    virBufferAddLit(&query, MSVM_COMPUTERSYSTEM_WQL_SELECT);
+    virBufferAddLit(&query, "where ");
+    virBufferAddLit(&query, MSVM_COMPUTERSYSTEM_WQL_VIRTUAL);
+
+    if (hypervGetMsvmComputerSystemList(priv, &query, &computerSystemList) < 0)
+        goto cleanup;
+
+    virBufferAddLit(&query, MSVM_PROCESSORSETTINGDATA_WQL_SELECT);
+
+    if (hypervGetMsvmProcessorSettingDataList(priv, &query,
+                                              &processorSettingDataList) < 0)
+        goto cleanup;
+
+    virBufferAddLit(&query, MSVM_MEMORYSETTINGDATA_WQL_SELECT);
+
+    if (hypervGetMsvmMemorySettingDataList(priv, &query,
+                                           &memorySettingDataList) < 0)
+        goto cleanup;
+
+    for (computerSystem = computerSystemList; computerSystem;
+         computerSystem = computerSystem->next) {
+        hypervDomainInfoCacheEntry tmp = { 0 };
+
+        if (virStrcpyStatic(tmp.uuid, computerSystem->data.common->Name) < 0)
+            continue;
+
+        tmp.info.state = hypervMsvmComputerSystemEnabledStateToDomainState(computerSystem);
+
+        if (VIR_APPEND_ELEMENT(priv->cache, priv->ncache, tmp) < 0)
+            goto cleanup;
+    }
+
+    for (processorSettingData = processorSettingDataList; processorSettingData;
+         processorSettingData = processorSettingData->next) {
+        if (!(entry = hypervDomainInfoCacheFindByInstanceID(priv,
+                          processorSettingData->data.common->InstanceID)))
+            continue;
+
+        entry->info.nrVirtCpu = processorSettingData->data.common->VirtualQuantity;
+        entry->flags |= HYPERV_DOMAIN_INFO_CACHE_PROCESSOR;
+    }
+
+    for (memorySettingData = memorySettingDataList; memorySettingData;
+         memorySettingData = memorySettingData->next) {
+        if (!(entry = hypervDomainInfoCacheFindByInstanceID(priv,
+                          memorySettingData->data.common->InstanceID)))
+            continue;
+
+        entry->info.maxMem = memorySettingData->data.common->Limit * 1024; /* megabyte to kilobyte */
+        entry->info.memory = memorySettingData->data.common->VirtualQuantity * 1024; /* megabyte to kilobyte */
+        entry->flags |= HYPERV_DOMAIN_INFO_CACHE_MEMORY;
+    }
+
+    /* Incomplete entries are looked up the usual way */
+    for (i = 0; i < priv->ncache;) {
+        if (priv->cache[i].flags != (HYPERV_DOMAIN_INFO_CACHE_PROCESSOR |
+                                     HYPERV_DOMAIN_INFO_CACHE_MEMORY))
+            VIR_DELETE_ELEMENT(priv->cache, i, priv->ncache);
+        else
+            i++;
+    }
+
+    priv->cacheExpiry = g_get_monotonic_time() +
+                        priv->parsedUri->cacheTTL * G_USEC_PER_SEC;
+    result = 0;
+
+ cleanup:
+    if (result < 0) {
+        VIR_FREE(priv->cache);
+        priv->ncache = 0;
+        priv->cacheExpiry = 0;
+    }
+    hypervFreeObject(priv, (hypervObject *)computerSystemList);
+    hypervFreeObject(priv, (hypervObject *)processorSettingDataList);
+    hypervFreeObject(priv, (hypervObject *)memorySettingDataList);
+
+    return result;
+}
+
+
+/**
+ * hypervGetDomainInfoCached:
+ * @priv: connection private data
+ * @uuid: UUID of the domain
+ * @info: filled with the info of the domain
+ *
+ * If the connection was opened with a non-zero cache_ttl, look up the
+ * info of the domain in the per-connection cache, refreshing the
+ * cache of all domains within a few queries if it is older than that.
+ * This saves the four round trips a lookup of a single domain costs
+ * when listing many domains along with their info.
+ *
+ * Returns 1 if @info was filled in, 0 if the caller has to look the
+ * info up itself, -1 on error.
+ */
+int
+hypervGetDomainInfoCached(hypervPrivate *priv,
+                          const unsigned char *uuid,
+                          virDomainInfoPtr info)
+{
+    char uuid_string[VIR_UUID_STRING_BUFLEN];
+    hypervDomainInfoCacheEntryPtr entry;
+    int result = -1;
+
+    if (priv->parsedUri->cacheTTL == 0)
+        return 0;
+
+    virUUIDFormat(uuid, uuid_string);
+
+    virMutexLock(&priv->cacheLock);
+
+    if (g_get_monotonic_time() >= priv->cacheExpiry &&
+        hypervDomainInfoCacheRefresh(priv) < 0)
+        goto cleanup;
+
+    if ((entry = hypervDomainInfoCacheFind(priv, uuid_string))) {
+        *info = entry->info;
+        result = 1;
+    } else {
+        result = 0;
+    }
+
+ cleanup:
+    virMutexUnlock(&priv->cacheLock);
+    return result;
+}
+
+
+/* Drops the cached info after a domain was changed through @priv */
+void
+hypervInvalidateDomainInfoCache(hypervPrivate *priv)
+{
+    if (priv->parsedUri->cacheTTL == 0)
+        return;
+
+    virMutexLock(&priv->cacheLock);
+    priv->cacheExpiry = 0;
+    virMutexUnlock(&priv->cacheLock);
+}
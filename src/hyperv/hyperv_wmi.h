@@ -251,3 +251,13 @@ int hypervMsvmComputerSystemToDomain(virConnectPtr conn,
 
 int hypervMsvmComputerSystemFromDomain(virDomainPtr domain,
                                        Msvm_ComputerSystem **computerSystem);
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Domain info cache
+ */
+
+int hypervGetDomainInfoCached(hypervPrivate *priv,
+                              const unsigned char *uuid,
+                              virDomainInfoPtr info);
+
+void hypervInvalidateDomainInfoCache(hypervPrivate *priv);
@@ -34,6 +34,7 @@
 #include "virlog.h"
 #include "virutil.h"
 #include "virnetdev.h"
+#include "virthread.h"
 #include "configmake.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
@@ -617,26 +618,177 @@ virHostdevRestoreNetConfig(virDomainHostdevDefPtr hostdev,
     }
 }
 
-static int
-virHostdevResetAllPCIDevices(virHostdevManagerPtr mgr,
-                             virPCIDeviceListPtr pcidevs)
+/*
+ * Resetting a device may take a while, mostly waiting for it to come
+ * back after an FLR or a secondary bus reset, so the devices are split
+ * into jobs that are reset at the same time. The jobs only ever read
+ * the lists of the manager, which are kept locked by the caller.
+ */
+typedef struct _virHostdevResetJob virHostdevResetJob;
+typedef virHostdevResetJob *virHostdevResetJobPtr;
+struct _virHostdevResetJob {
+    virHostdevManagerPtr mgr;
+    size_t root;
+    virPCIDevicePtr *devs;
+    size_t ndevs;
+
+    virThread thread;
+    bool threaded;
+    int ret;
+    virErrorPtr err;
+};
+
+static void
+virHostdevResetJobRun(void *opaque)
 {
-    int ret = 0;
+    virHostdevResetJobPtr job = opaque;
     size_t i;
 
-    for (i = 0; i < virPCIDeviceListCount(pcidevs); i++) {
-        virPCIDevicePtr pci = virPCIDeviceListGet(pcidevs, i);
+    job->ret = 0;
+
+    for (i = 0; i < job->ndevs; i++) {
+        virPCIDevicePtr pci = job->devs[i];
 
         /* We can avoid looking up the actual device here, because performing
          * a PCI reset on a device doesn't require any information other than
          * the address, which 'pci' already contains */
         VIR_DEBUG("Resetting PCI device %s", virPCIDeviceGetName(pci));
-        if (virPCIDeviceReset(pci, mgr->activePCIHostdevs,
-                              mgr->inactivePCIHostdevs) < 0) {
+        if (virPCIDeviceReset(pci, job->mgr->activePCIHostdevs,
+                              job->mgr->inactivePCIHostdevs) < 0) {
             VIR_ERROR(_("Failed to reset PCI device: %s"),
                       virGetLastErrorMessage());
+            if (!job->err)
+                virErrorPreserveLast(&job->err);
+            job->ret = -1;
+        }
+    }
+}
+
+static size_t
+virHostdevResetJobFindRoot(size_t *roots,
+                           size_t i)
+{
+    while (roots[i] != i)
+        i = roots[i];
+    return i;
+}
+
+/* Devices which are in the same IOMMU group are reset by the same job,
+ * and so are devices on the same bus since a secondary bus reset of one
+ * of them resets the others as well. If the IOMMU groups are not known,
+ * all devices are reset by a single job. */
+static size_t
+virHostdevResetAllPCIDevicesSplit(virHostdevManagerPtr mgr,
+                                  virPCIDeviceListPtr pcidevs,
+                                  virHostdevResetJobPtr *jobs)
+{
+    size_t ndevs = virPCIDeviceListCount(pcidevs);
+    g_autofree int *groups = g_new0(int, ndevs);
+    g_autofree size_t *roots = g_new0(size_t, ndevs);
+    bool parallel = ndevs > 1;
+    size_t njobs = 0;
+    size_t i, j;
+
+    for (i = 0; i < ndevs && parallel; i++) {
+        virPCIDevicePtr pci = virPCIDeviceListGet(pcidevs, i);
+
+        groups[i] = virPCIDeviceAddressGetIOMMUGroupNum(virPCIDeviceGetAddress(pci));
+        if (groups[i] < 0) {
+            if (groups[i] == -1)
+                virResetLastError();
+            parallel = false;
+        }
+    }
+
+    for (i = 0; i < ndevs; i++) {
+        virPCIDeviceAddressPtr addr;
+
+        roots[i] = i;
+        if (!parallel) {
+            roots[i] = 0;
+            continue;
+        }
+
+        addr = virPCIDeviceGetAddress(virPCIDeviceListGet(pcidevs, i));
+        for (j = 0; j < i; j++) {
+            virPCIDeviceAddressPtr other;
+
+            other = virPCIDeviceGetAddress(virPCIDeviceListGet(pcidevs, j));
+            if (groups[i] == groups[j] ||
+                (addr->domain == other->domain && addr->bus == other->bus))
+                roots[virHostdevResetJobFindRoot(roots, j)] = i;
+        }
+    }
+
+    *jobs = g_new0(virHostdevResetJob, ndevs);
+
+    for (i = 0; i < ndevs; i++) {
+        size_t root = virHostdevResetJobFindRoot(roots, i);
+        virHostdevResetJobPtr job = NULL;
+
+        for (j = 0; j < njobs; j++) {
+            if ((*jobs)[j].root == root) {
+                job = &(*jobs)[j];
+                break;
+            }
+        }
+
+        if (!job) {
+            job = &(*jobs)[njobs++];
+            job->mgr = mgr;
+            job->root = root;
+        }
+
+        ignore_value(VIR_APPEND_ELEMENT_COPY(job->devs, job->ndevs,
+                                             virPCIDeviceListGet(pcidevs, i)));
+    }
+
+    return njobs;
+}
+
+static int
+virHostdevResetAllPCIDevices(virHostdevManagerPtr mgr,
+                             virPCIDeviceListPtr pcidevs)
+{
+    g_autofree virHostdevResetJobPtr jobs = NULL;
+    size_t njobs;
+    int ret = 0;
+    size_t i;
+
+    if (virPCIDeviceListCount(pcidevs) == 0)
+        return 0;
+
+    njobs = virHostdevResetAllPCIDevicesSplit(mgr, pcidevs, &jobs);
+
+    VIR_DEBUG("Resetting %zu PCI devices in %zu jobs",
+              virPCIDeviceListCount(pcidevs), njobs);
+
+    for (i = 1; i < njobs; i++) {
+        if (virThreadCreateFull(&jobs[i].thread, true, virHostdevResetJobRun,
+                                "hostdev-reset", false, &jobs[i]) < 0) {
+            VIR_WARN("Failed to start thread, resetting devices serially");
+            virResetLastError();
+            continue;
+        }
+        jobs[i].threaded = true;
+    }
+
+    for (i = 0; i < njobs; i++) {
+        if (!jobs[i].threaded)
+            virHostdevResetJobRun(&jobs[i]);
+    }
+
+    for (i = 0; i < njobs; i++) {
+        if (jobs[i].threaded)
+            virThreadJoin(&jobs[i].thread);
+
+        if (jobs[i].ret < 0) {
+            if (ret == 0)
+                virErrorRestore(&jobs[i].err);
             ret = -1;
         }
+        virFreeError(jobs[i].err);
+        g_free(jobs[i].devs);
     }
 
     return ret;
@@ -54,6 +54,9 @@ typedef struct
     char *stateDir;
     struct netcf *netcf;
     bool privileged;
+
+    /* size of the array of names the last listing of interfaces needed */
+    int nnamesHint;
 } virNetcfDriverState, *virNetcfDriverStatePtr;
 
 static virClassPtr virNetcfDriverStateClass;
@@ -302,6 +305,51 @@ static int netcf_to_vir_err(int netcf_errcode)
     }
 }
 
+/*
+ * Lists the names of the host interfaces matching @status. Counting them
+ * first would make netcf go through all of them twice, so they are listed
+ * right away into an array as large as the previous listing needed, which
+ * is only retried with a larger array if it turns out to be full.
+ *
+ * Returns the number of names stored in @names, or -1 on error.
+ * The caller must hold the driver lock.
+ */
+static int
+netcfListInterfaceNames(int status,
+                        char ***names)
+{
+    int nnames = MAX(driver->nnamesHint, 16);
+
+    for (;;) {
+        char **tmp = g_new0(char *, nnames);
+        int count;
+
+        if ((count = ncf_list_interfaces(driver->netcf, nnames,
+                                         tmp, status)) < 0) {
+            const char *errmsg, *details;
+            int errcode = ncf_error(driver->netcf, &errmsg, &details);
+
+            virReportError(netcf_to_vir_err(errcode),
+                           _("failed to list host interfaces: %s%s%s"),
+                           errmsg, details ? " - " : "",
+                           NULLSTR_EMPTY(details));
+            g_free(tmp);
+            return -1;
+        }
+
+        if (count < nnames) {
+            /* one spare entry tells that the list is complete */
+            driver->nnamesHint = count + 1;
+            *names = tmp;
+            return count;
+        }
+
+        virStringListFreeCount(tmp, count);
+        nnames *= 2;
+    }
+}
+
+
 static struct netcf_if *interfaceDriverGetNetcfIF(struct netcf *ncf, virInterfacePtr ifinfo)
 {
     /* 1) caller already has lock,
@@ -364,35 +412,9 @@ static int netcfConnectNumOfInterfacesImpl(virConnectPtr conn,
     /* List all interfaces, in case we might support new filter flags
      * beyond active|inactive in future.
      */
-    count = ncf_num_of_interfaces(driver->netcf, status);
-    if (count < 0) {
-        const char *errmsg, *details;
-        int errcode = ncf_error(driver->netcf, &errmsg, &details);
-        virReportError(netcf_to_vir_err(errcode),
-                       _("failed to get number of host interfaces: %s%s%s"),
-                       errmsg, details ? " - " : "",
-                       NULLSTR_EMPTY(details));
-        goto cleanup;
-    }
-
-    if (count == 0) {
-        ret = 0;
-        goto cleanup;
-    }
-
-    if (VIR_ALLOC_N(names, count) < 0)
+    if ((count = netcfListInterfaceNames(status, &names)) < 0)
         goto cleanup;
 
-    if ((count = ncf_list_interfaces(driver->netcf, count, names, status)) < 0) {
-        const char *errmsg, *details;
-        int errcode = ncf_error(driver->netcf, &errmsg, &details);
-        virReportError(netcf_to_vir_err(errcode),
-                       _("failed to list host interfaces: %s%s%s"),
-                       errmsg, details ? " - " : "",
-                       NULLSTR_EMPTY(details));
-        goto cleanup;
-    }
-
     for (i = 0; i < count; i++) {
         virInterfaceDefPtr def;
         struct netcf_if *iface;
@@ -454,34 +476,8 @@ static int netcfConnectListInterfacesImpl(virConnectPtr conn,
     size_t i;
     char **allnames = NULL;
 
-    count = ncf_num_of_interfaces(driver->netcf, status);
-    if (count < 0) {
-        const char *errmsg, *details;
-        int errcode = ncf_error(driver->netcf, &errmsg, &details);
-        virReportError(netcf_to_vir_err(errcode),
-                       _("failed to get number of host interfaces: %s%s%s"),
-                       errmsg, details ? " - " : "",
-                       NULLSTR_EMPTY(details));
-        goto cleanup;
-    }
-
-    if (count == 0) {
-        ret = 0;
-        goto cleanup;
-    }
-
-    if (VIR_ALLOC_N(allnames, count) < 0)
-        goto cleanup;
-
-    if ((count = ncf_list_interfaces(driver->netcf, count, allnames, status)) < 0) {
-        const char *errmsg, *details;
-        int errcode = ncf_error(driver->netcf, &errmsg, &details);
-        virReportError(netcf_to_vir_err(errcode),
-                       _("failed to list host interfaces: %s%s%s"),
-                       errmsg, details ? " - " : "",
-                       NULLSTR_EMPTY(details));
+    if ((count = netcfListInterfaceNames(status, &allnames)) < 0)
         goto cleanup;
-    }
 
     if (count == 0) {
         ret = 0;
@@ -640,37 +636,14 @@ netcfConnectListAllInterfaces(virConnectPtr conn,
         ncf_flags = NETCF_IFACE_ACTIVE | NETCF_IFACE_INACTIVE;
     }
 
-    if ((count = ncf_num_of_interfaces(driver->netcf, ncf_flags)) < 0) {
-        const char *errmsg, *details;
-        int errcode = ncf_error(driver->netcf, &errmsg, &details);
-
-        virReportError(netcf_to_vir_err(errcode),
-                       _("failed to get number of host interfaces: %s%s%s"),
-                       errmsg, details ? " - " : "",
-                       NULLSTR_EMPTY(details));
+    if ((count = netcfListInterfaceNames(ncf_flags, &names)) < 0)
         goto cleanup;
-    }
 
     if (count == 0) {
         ret = 0;
         goto cleanup;
     }
 
-    if (VIR_ALLOC_N(names, count) < 0)
-        goto cleanup;
-
-    if ((count = ncf_list_interfaces(driver->netcf, count,
-                                     names, ncf_flags)) < 0) {
-        const char *errmsg, *details;
-        int errcode = ncf_error(driver->netcf, &errmsg, &details);
-
-        virReportError(netcf_to_vir_err(errcode),
-                       _("failed to list host interfaces: %s%s%s"),
-                       errmsg, details ? " - " : "",
-                       NULLSTR_EMPTY(details));
-        goto cleanup;
-    }
-
     if (ifaces && VIR_ALLOC_N(tmp_iface_objs, count + 1) < 0)
         goto cleanup;
 
@@ -1358,7 +1358,7 @@ virDomainCoreDumpWithFormat(virDomainPtr domain, const char *to,
  * @domain: a domain object
  * @stream: stream to use as output
  * @screen: monitor ID to take screenshot from
- * @flags: extra flags; not used yet, so callers should always pass 0
+ * @flags: bitwise-OR of virDomainScreenshotFlags
  *
  * Take a screenshot of current domain console as a stream. The image format
  * is hypervisor specific. Moreover, some hypervisors supports multiple
@@ -1373,6 +1373,13 @@ virDomainCoreDumpWithFormat(virDomainPtr domain, const char *to,
  * two graphics cards, both with four heads, screen ID 5 addresses
  * the second head on the second card.
  *
+ * If @flags contains VIR_DOMAIN_SCREENSHOT_IF_CHANGED and the image is
+ * identical to the one taken of the same screen by the previous call
+ * using this flag, no data is sent over @stream, which is finished right
+ * away. This allows callers polling many domains to skip transferring
+ * and decoding unchanged frames. Note that the previous image might have
+ * been requested by a different client.
+ *
  * Returns a string representing the mime-type of the image format, or
  * NULL upon error. The caller must free() the returned value.
  */
@@ -4954,6 +4961,55 @@ virDomainMigratePrepareTunnel3Params(virConnectPtr conn,
 }
 
 
+/*
+ * Not for public use.  This function is part of the internal
+ * implementation of migration in the remote case.
+ *
+ * Attaches @st as stripe number @stripe of a tunnelled incoming
+ * migration of @domain which was started with more than one tunnel
+ * stream. Stripe 0 is always the stream passed to Prepare.
+ */
+int
+virDomainMigratePrepareTunnelStripe(virDomainPtr domain,
+                                    virStreamPtr st,
+                                    unsigned int stripe,
+                                    unsigned int flags)
+{
+    virConnectPtr conn;
+
+    VIR_DOMAIN_DEBUG(domain, "stream=%p, stripe=%u, flags=0x%x",
+                     st, stripe, flags);
+
+    virResetLastError();
+
+    virCheckDomainReturn(domain, -1);
+    conn = domain->conn;
+
+    virCheckReadOnlyGoto(conn->flags, error);
+
+    if (conn != st->conn) {
+        virReportInvalidArg(conn, "%s",
+                            _("conn must match stream connection"));
+        goto error;
+    }
+
+    if (conn->driver->domainMigratePrepareTunnelStripe) {
+        int rv;
+        rv = conn->driver->domainMigratePrepareTunnelStripe(domain, st,
+                                                            stripe, flags);
+        if (rv < 0)
+            goto error;
+        return rv;
+    }
+
+    virReportUnsupportedError();
+
+ error:
+    virDispatchError(conn);
+    return -1;
+}
+
+
 /*
  * Not for public use.  This function is part of the internal
  * implementation of migration in the remote case.
@@ -5878,6 +5934,79 @@ virDomainBlockPeek(virDomainPtr dom,
 }
 
 
+/**
+ * virDomainBlockPeekStream:
+ * @dom: pointer to the domain object
+ * @stream: stream to use as output
+ * @disk: path to the block device, or device shorthand
+ * @offset: offset within block device
+ * @length: limit on amount of data to read, or 0 for all
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Read the contents of a domain's disk device as a stream, like
+ * virDomainBlockPeek() does into a buffer, but without a limit on the
+ * size of the area read in one call.
+ *
+ * The @disk parameter is either an unambiguous source name of the
+ * block device (the <source file='...'/> sub-element, such as
+ * "/path/to/image"), or the device target shorthand (the
+ * <target dev='...'/> sub-element, such as "vda").
+ *
+ * The data starting at @offset are streamed up to @length bytes, or
+ * to the end of the device if @length is 0.
+ *
+ * This call sets up a stream; subsequent use of stream API is necessary
+ * to transfer actual data, determine how much data is successfully
+ * transferred, and detect any errors.
+ *
+ * Returns: 0 in case of success or -1 in case of failure.
+ */
+int
+virDomainBlockPeekStream(virDomainPtr dom,
+                         virStreamPtr stream,
+                         const char *disk,
+                         unsigned long long offset,
+                         unsigned long long length,
+                         unsigned int flags)
+{
+    virConnectPtr conn;
+
+    VIR_DOMAIN_DEBUG(dom, "stream=%p, disk=%s, offset=%llu, length=%llu, flags=0x%x",
+                     stream, disk, offset, length, flags);
+
+    virResetLastError();
+
+    virCheckDomainReturn(dom, -1);
+    conn = dom->conn;
+
+    virCheckStreamGoto(stream, error);
+    virCheckReadOnlyGoto(conn->flags, error);
+    virCheckNonEmptyStringArgGoto(disk, error);
+
+    if (conn != stream->conn) {
+        virReportInvalidArg(stream,
+                            _("stream must match connection of domain '%s'"),
+                            dom->name);
+        goto error;
+    }
+
+    if (conn->driver->domainBlockPeekStream) {
+        int ret;
+        ret = conn->driver->domainBlockPeekStream(dom, stream, disk,
+                                                  offset, length, flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+ error:
+    virDispatchError(dom->conn);
+    return -1;
+}
+
+
 /**
  * virDomainBlockResize:
  * @dom: pointer to the domain object
@@ -6038,6 +6167,75 @@ virDomainMemoryPeek(virDomainPtr dom,
 }
 
 
+/**
+ * virDomainMemoryPeekStream:
+ * @dom: pointer to the domain object
+ * @stream: stream to use as output
+ * @start: start of memory to peek
+ * @length: size of memory to peek
+ * @flags: bitwise-OR of virDomainMemoryFlags
+ *
+ * Read the contents of a domain's memory as a stream, like
+ * virDomainMemoryPeek() does into a buffer, but without a limit on the
+ * size of the area read in one call. @start and @length are interpreted
+ * as in virDomainMemoryPeek() according to @flags, which must contain
+ * exactly one of VIR_MEMORY_VIRTUAL and VIR_MEMORY_PHYSICAL.
+ *
+ * The memory is read once when the call is made, further changes made
+ * by the guest are not reflected in the data sent through the stream.
+ *
+ * This call sets up a stream; subsequent use of stream API is necessary
+ * to transfer actual data, determine how much data is successfully
+ * transferred, and detect any errors.
+ *
+ * Returns: 0 in case of success or -1 in case of failure.
+ */
+int
+virDomainMemoryPeekStream(virDomainPtr dom,
+                          virStreamPtr stream,
+                          unsigned long long start,
+                          unsigned long long length,
+                          unsigned int flags)
+{
+    virConnectPtr conn;
+
+    VIR_DOMAIN_DEBUG(dom, "stream=%p, start=%llu, length=%llu, flags=0x%x",
+                     stream, start, length, flags);
+
+    virResetLastError();
+
+    virCheckDomainReturn(dom, -1);
+    conn = dom->conn;
+
+    virCheckStreamGoto(stream, error);
+    virCheckReadOnlyGoto(conn->flags, error);
+
+    if (conn != stream->conn) {
+        virReportInvalidArg(stream,
+                            _("stream must match connection of domain '%s'"),
+                            dom->name);
+        goto error;
+    }
+
+    VIR_EXCLUSIVE_FLAGS_GOTO(VIR_MEMORY_VIRTUAL, VIR_MEMORY_PHYSICAL, error);
+
+    if (conn->driver->domainMemoryPeekStream) {
+        int ret;
+        ret = conn->driver->domainMemoryPeekStream(dom, stream, start,
+                                                   length, flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+ error:
+    virDispatchError(dom->conn);
+    return -1;
+}
+
+
 /**
  * virDomainGetBlockInfo:
  * @domain: a domain object
@@ -8514,6 +8712,115 @@ virDomainDetachDeviceAlias(virDomainPtr domain,
 }
 
 
+/**
+ * virDomainAttachDeviceList:
+ * @domain: pointer to domain object
+ * @xmls: array of XML descriptions, one per device
+ * @nxmls: number of items in @xmls
+ * @flags: bitwise-OR of virDomainDeviceModifyFlags
+ *
+ * Attach several virtual devices to a domain at once, behaving as if
+ * virDomainAttachDeviceFlags() was called for each item of @xmls in
+ * order, but without the overhead of separate calls. See
+ * virDomainAttachDeviceFlags() for the description of @flags.
+ *
+ * Devices are attached in the order they appear in @xmls. If attaching
+ * any of them fails, the devices preceding it stay attached to the
+ * running domain while the persistent configuration is not changed at
+ * all.
+ *
+ * Returns 0 in case of success, -1 in case of failure.
+ */
+int
+virDomainAttachDeviceList(virDomainPtr domain,
+                          const char **xmls,
+                          unsigned int nxmls,
+                          unsigned int flags)
+{
+    virConnectPtr conn;
+
+    VIR_DOMAIN_DEBUG(domain, "xmls=%p, nxmls=%u, flags=0x%x",
+                     xmls, nxmls, flags);
+
+    virResetLastError();
+
+    virCheckDomainReturn(domain, -1);
+    conn = domain->conn;
+
+    virCheckNonNullArgGoto(xmls, error);
+    virCheckPositiveArgGoto(nxmls, error);
+    virCheckReadOnlyGoto(conn->flags, error);
+
+    if (conn->driver->domainAttachDeviceList) {
+        int ret;
+        ret = conn->driver->domainAttachDeviceList(domain, xmls, nxmls, flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+ error:
+    virDispatchError(domain->conn);
+    return -1;
+}
+
+
+/**
+ * virDomainDetachDeviceList:
+ * @domain: pointer to domain object
+ * @xmls: array of XML descriptions, one per device
+ * @nxmls: number of items in @xmls
+ * @flags: bitwise-OR of virDomainDeviceModifyFlags
+ *
+ * Detach several virtual devices from a domain at once, behaving as if
+ * virDomainDetachDeviceFlags() was called for each item of @xmls in
+ * order, but without the overhead of separate calls. See
+ * virDomainDetachDeviceFlags() for the description of @flags.
+ *
+ * If detaching any of the devices fails, the devices preceding it stay
+ * detached from the running domain while the persistent configuration
+ * is not changed at all.
+ *
+ * Returns 0 in case of success, -1 in case of failure.
+ */
+int
+virDomainDetachDeviceList(virDomainPtr domain,
+                          const char **xmls,
+                          unsigned int nxmls,
+                          unsigned int flags)
+{
+    virConnectPtr conn;
+
+    VIR_DOMAIN_DEBUG(domain, "xmls=%p, nxmls=%u, flags=0x%x",
+                     xmls, nxmls, flags);
+
+    virResetLastError();
+
+    virCheckDomainReturn(domain, -1);
+    conn = domain->conn;
+
+    virCheckNonNullArgGoto(xmls, error);
+    virCheckPositiveArgGoto(nxmls, error);
+    virCheckReadOnlyGoto(conn->flags, error);
+
+    if (conn->driver->domainDetachDeviceList) {
+        int ret;
+        ret = conn->driver->domainDetachDeviceList(domain, xmls, nxmls, flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+ error:
+    virDispatchError(domain->conn);
+    return -1;
+}
+
+
 /**
  * virConnectDomainEventRegister:
  * @conn: pointer to the connection
@@ -11623,6 +11930,17 @@ virConnectGetDomainCapabilities(virConnectPtr conn,
  *     "perf.emulation_faults" - The count of emulation faults as unsigned
  *                               long long. It is produced by the
  *                               emulation_faults perf event
+ *     "perf.<event>.time_enabled" - The time in nanoseconds the counting
+ *                                   events above, except cmt, mbmt and
+ *                                   mbml, were enabled as unsigned long
+ *                                   long.
+ *     "perf.<event>.time_running" - The time in nanoseconds the event was
+ *                                   actually counted as unsigned long long.
+ *                                   It is less than time_enabled when the
+ *                                   host had to share its hardware counters
+ *                                   among more events than it has, the
+ *                                   count of the event then has to be scaled
+ *                                   by time_enabled / time_running.
  *
  * VIR_DOMAIN_STATS_IOTHREAD:
  *     Return IOThread statistics if available. IOThread polling is a
@@ -11705,6 +12023,20 @@ virConnectGetDomainCapabilities(virConnectPtr conn,
  * is returned for the domain.  That subset being statistics that
  * don't involve querying the underlying hypervisor.
  *
+ * Passing VIR_CONNECT_GET_ALL_DOMAINS_STATS_PARALLEL in @flags allows
+ * the hypervisor driver to gather statistics of several domains
+ * concurrently. Since a single unresponsive domain can't delay the
+ * others in this mode, domains which can't be queried within a
+ * driver specific deadline report only the subset of statistics
+ * described for VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT. The order
+ * of the returned records is not affected by this flag.
+ *
+ * Passing VIR_CONNECT_GET_ALL_DOMAINS_STATS_CACHED in @flags allows
+ * the hypervisor driver to return statistics it collected recently
+ * instead of querying the hypervisor. The maximum age of such
+ * statistics is configured in the driver. Without this flag, the
+ * statistics are always collected live.
+ *
  * Similarly to virConnectListAllDomains, @flags can contain various flags to
  * filter the list of domains to provide stats for.
  *
@@ -11795,6 +12127,20 @@ virConnectGetAllDomainStats(virConnectPtr conn,
  * is returned for the domain.  That subset being statistics that
  * don't involve querying the underlying hypervisor.
  *
+ * Passing VIR_CONNECT_GET_ALL_DOMAINS_STATS_PARALLEL in @flags allows
+ * the hypervisor driver to gather statistics of several domains
+ * concurrently. Since a single unresponsive domain can't delay the
+ * others in this mode, domains which can't be queried within a
+ * driver specific deadline report only the subset of statistics
+ * described for VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT. The order
+ * of the returned records is not affected by this flag.
+ *
+ * Passing VIR_CONNECT_GET_ALL_DOMAINS_STATS_CACHED in @flags allows
+ * the hypervisor driver to return statistics it collected recently
+ * instead of querying the hypervisor. The maximum age of such
+ * statistics is configured in the driver. Without this flag, the
+ * statistics are always collected live.
+ *
  * Note that any of the domain list filtering flags in @flags may be rejected
  * by this function.
  *
@@ -11889,6 +12235,179 @@ virDomainStatsRecordListFree(virDomainStatsRecordPtr *stats)
 }
 
 
+/**
+ * virConnectGetAllDomainXML:
+ * @conn: pointer to the hypervisor connection
+ * @xmlflags: bitwise-OR of virDomainXMLFlags
+ * @records: Pointer that will be filled with the array of returned records
+ * @flags: filter, binary-OR of virConnectListAllDomainsFlags
+ *
+ * Query the XML description and state of all domains on the connection
+ * at once. This is equivalent to calling virConnectListAllDomains
+ * followed by virDomainGetXMLDesc and virDomainGetState for each of the
+ * domains, but avoids the round trips in between on remote connections.
+ *
+ * The XML of each domain is formatted according to @xmlflags, see
+ * virDomainGetXMLDesc.
+ *
+ * @flags filter the list of domains the same way as they do for
+ * virConnectListAllDomains.
+ *
+ * Returns the count of returned records on success, -1 on error.
+ * The requested data are returned in the @records parameter. The returned
+ * array should be freed by the caller. See virDomainXMLRecordListFree.
+ */
+int
+virConnectGetAllDomainXML(virConnectPtr conn,
+                          unsigned int xmlflags,
+                          virDomainXMLRecordPtr **records,
+                          unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("conn=%p, xmlflags=0x%x, records=%p, flags=0x%x",
+              conn, xmlflags, records, flags);
+
+    virResetLastError();
+
+    virCheckConnectReturn(conn, -1);
+    virCheckNonNullArgGoto(records, cleanup);
+
+    if ((conn->flags & VIR_CONNECT_RO) &&
+        (xmlflags & VIR_DOMAIN_XML_SECURE)) {
+        virReportError(VIR_ERR_OPERATION_DENIED, "%s",
+                       _("virConnectGetAllDomainXML with secure flag"));
+        goto cleanup;
+    }
+
+    if (!conn->driver->connectGetAllDomainXML) {
+        virReportUnsupportedError();
+        goto cleanup;
+    }
+
+    ret = conn->driver->connectGetAllDomainXML(conn, NULL, 0, xmlflags,
+                                               records, flags);
+
+ cleanup:
+    if (ret < 0)
+        virDispatchError(conn);
+
+    return ret;
+}
+
+
+/**
+ * virDomainListGetXML:
+ * @doms: NULL terminated array of domains
+ * @xmlflags: bitwise-OR of virDomainXMLFlags
+ * @records: Pointer that will be filled with the array of returned records
+ * @flags: filter, binary-OR of virConnectListAllDomainsFlags
+ *
+ * Query the XML description and state of the domains provided by @doms.
+ * Note that all domains in @doms must share the same connection. Domains
+ * which disappeared meanwhile or don't match the filter in @flags are
+ * skipped.
+ *
+ * See virConnectGetAllDomainXML for details.
+ *
+ * Returns the count of returned records on success, -1 on error.
+ * The requested data are returned in the @records parameter. The returned
+ * array should be freed by the caller. See virDomainXMLRecordListFree.
+ * Note that the count of returned records may be less than the domain
+ * count provided via @doms.
+ */
+int
+virDomainListGetXML(virDomainPtr *doms,
+                    unsigned int xmlflags,
+                    virDomainXMLRecordPtr **records,
+                    unsigned int flags)
+{
+    virConnectPtr conn = NULL;
+    virDomainPtr *nextdom = doms;
+    unsigned int ndoms = 0;
+    int ret = -1;
+
+    VIR_DEBUG("doms=%p, xmlflags=0x%x, records=%p, flags=0x%x",
+              doms, xmlflags, records, flags);
+
+    virResetLastError();
+
+    virCheckNonNullArgGoto(doms, cleanup);
+    virCheckNonNullArgGoto(records, cleanup);
+
+    if (!*doms) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("doms array in %s must contain at least one domain"),
+                       __FUNCTION__);
+        goto cleanup;
+    }
+
+    conn = doms[0]->conn;
+    virCheckConnectReturn(conn, -1);
+
+    if ((conn->flags & VIR_CONNECT_RO) &&
+        (xmlflags & VIR_DOMAIN_XML_SECURE)) {
+        virReportError(VIR_ERR_OPERATION_DENIED, "%s",
+                       _("virDomainListGetXML with secure flag"));
+        goto cleanup;
+    }
+
+    if (!conn->driver->connectGetAllDomainXML) {
+        virReportUnsupportedError();
+        goto cleanup;
+    }
+
+    while (*nextdom) {
+        virDomainPtr dom = *nextdom;
+
+        virCheckDomainGoto(dom, cleanup);
+
+        if (dom->conn != conn) {
+            virReportError(VIR_ERR_INVALID_ARG, "%s",
+                           _("domains in 'doms' array must belong to a "
+                             "single connection"));
+            goto cleanup;
+        }
+
+        ndoms++;
+        nextdom++;
+    }
+
+    ret = conn->driver->connectGetAllDomainXML(conn, doms, ndoms, xmlflags,
+                                               records, flags);
+
+ cleanup:
+    if (ret < 0)
+        virDispatchError(conn);
+    return ret;
+}
+
+
+/**
+ * virDomainXMLRecordListFree:
+ * @records: NULL terminated array of virDomainXMLRecords to free
+ *
+ * Convenience function to free a list of domain records returned by
+ * virDomainListGetXML and virConnectGetAllDomainXML.
+ */
+void
+virDomainXMLRecordListFree(virDomainXMLRecordPtr *records)
+{
+    virDomainXMLRecordPtr *next;
+
+    if (!records)
+        return;
+
+    for (next = records; *next; next++) {
+        VIR_FREE((*next)->xml);
+        virDomainFree((*next)->dom);
+        VIR_FREE(*next);
+    }
+
+    VIR_FREE(records);
+}
+
+
 /**
  * virDomainGetFSInfo:
  * @dom: a domain object
@@ -12377,6 +12896,147 @@ int virDomainGetGuestInfo(virDomainPtr domain,
     return -1;
 }
 
+
+/**
+ * virConnectGetAllDomainGuestInfo:
+ * @conn: pointer to the hypervisor connection
+ * @types: types of information to return, binary-OR of virDomainGuestInfoTypes
+ * @retInfo: Pointer that will be filled with the array of returned records
+ * @flags: filter, binary-OR of virConnectListAllDomainsFlags
+ *
+ * Query the guest agents of all running domains on the connection for
+ * the information requested by @types. This is equivalent to calling
+ * virDomainGetGuestInfo for each of the domains, but the hypervisor
+ * may query the guest agents in parallel and avoids the round trips in
+ * between on remote connections.
+ *
+ * Each record holds the typed parameters virDomainGetGuestInfo would
+ * return for @types. The time spent on each domain is limited so that
+ * a guest whose agent is missing or doesn't respond doesn't hold up
+ * the others; records of such domains don't contain any parameters.
+ * Domains which are not running are skipped.
+ *
+ * @flags filter the list of domains the same way as they do for
+ * virConnectListAllDomains.
+ *
+ * Returns the count of returned records on success, -1 on error.
+ * The requested data are returned in the @retInfo parameter. The
+ * returned array should be freed by the caller. See
+ * virDomainStatsRecordListFree.
+ */
+int
+virConnectGetAllDomainGuestInfo(virConnectPtr conn,
+                                unsigned int types,
+                                virDomainStatsRecordPtr **retInfo,
+                                unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("conn=%p, types=0x%x, retInfo=%p, flags=0x%x",
+              conn, types, retInfo, flags);
+
+    virResetLastError();
+
+    virCheckConnectReturn(conn, -1);
+    virCheckReadOnlyGoto(conn->flags, cleanup);
+    virCheckNonNullArgGoto(retInfo, cleanup);
+
+    if (!conn->driver->connectGetAllDomainGuestInfo) {
+        virReportUnsupportedError();
+        goto cleanup;
+    }
+
+    ret = conn->driver->connectGetAllDomainGuestInfo(conn, NULL, 0, types,
+                                                     retInfo, flags);
+
+ cleanup:
+    if (ret < 0)
+        virDispatchError(conn);
+
+    return ret;
+}
+
+
+/**
+ * virDomainListGetGuestInfo:
+ * @doms: NULL terminated array of domains
+ * @types: types of information to return, binary-OR of virDomainGuestInfoTypes
+ * @retInfo: Pointer that will be filled with the array of returned records
+ * @flags: filter, binary-OR of virConnectListAllDomainsFlags
+ *
+ * Query the guest agents of the domains provided by @doms. Note that
+ * all domains in @doms must share the same connection. Domains which
+ * disappeared meanwhile, are not running or don't match the filter in
+ * @flags are skipped.
+ *
+ * See virConnectGetAllDomainGuestInfo for details.
+ *
+ * Returns the count of returned records on success, -1 on error.
+ * The requested data are returned in the @retInfo parameter. The
+ * returned array should be freed by the caller. See
+ * virDomainStatsRecordListFree. Note that the count of returned
+ * records may be less than the domain count provided via @doms.
+ */
+int
+virDomainListGetGuestInfo(virDomainPtr *doms,
+                          unsigned int types,
+                          virDomainStatsRecordPtr **retInfo,
+                          unsigned int flags)
+{
+    virConnectPtr conn = NULL;
+    virDomainPtr *nextdom = doms;
+    unsigned int ndoms = 0;
+    int ret = -1;
+
+    VIR_DEBUG("doms=%p, types=0x%x, retInfo=%p, flags=0x%x",
+              doms, types, retInfo, flags);
+
+    virResetLastError();
+
+    virCheckNonNullArgGoto(doms, cleanup);
+    virCheckNonNullArgGoto(retInfo, cleanup);
+
+    if (!*doms) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("doms array in %s must contain at least one domain"),
+                       __FUNCTION__);
+        goto cleanup;
+    }
+
+    conn = doms[0]->conn;
+    virCheckConnectReturn(conn, -1);
+    virCheckReadOnlyGoto(conn->flags, cleanup);
+
+    if (!conn->driver->connectGetAllDomainGuestInfo) {
+        virReportUnsupportedError();
+        goto cleanup;
+    }
+
+    while (*nextdom) {
+        virDomainPtr dom = *nextdom;
+
+        virCheckDomainGoto(dom, cleanup);
+
+        if (dom->conn != conn) {
+            virReportError(VIR_ERR_INVALID_ARG, "%s",
+                           _("domains in 'doms' array must belong to a "
+                             "single connection"));
+            goto cleanup;
+        }
+
+        ndoms++;
+        nextdom++;
+    }
+
+    ret = conn->driver->connectGetAllDomainGuestInfo(conn, doms, ndoms, types,
+                                                     retInfo, flags);
+
+ cleanup:
+    if (ret < 0)
+        virDispatchError(conn);
+    return ret;
+}
+
 /**
  * virDomainSetBlockThreshold:
  * @domain: pointer to domain object
@@ -862,6 +862,116 @@ virNodeSetMemoryParameters(virConnectPtr conn,
 }
 
 
+/**
+ * virNodeGetMigrationParameters:
+ * @conn: pointer to the hypervisor connection
+ * @params: where to store the migration parameters
+ * @nparams: pointer to number of parameters returned in @params
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Get the limits of all outgoing migrations of the host, see
+ * VIR_NODE_MIGRATION_MAX_JOBS and VIR_NODE_MIGRATION_BANDWIDTH, and how
+ * many migrations are currently running and waiting, see
+ * VIR_NODE_MIGRATION_ACTIVE and VIR_NODE_MIGRATION_QUEUED. The caller
+ * is responsible for freeing @params using virTypedParamsFree.
+ *
+ * Returns 0 in case of success, and -1 in case of failure.
+ */
+int
+virNodeGetMigrationParameters(virConnectPtr conn,
+                              virTypedParameterPtr *params,
+                              int *nparams,
+                              unsigned int flags)
+{
+    VIR_DEBUG("conn=%p, params=%p, nparams=%p, flags=0x%x",
+              conn, params, nparams, flags);
+
+    virResetLastError();
+
+    virCheckConnectReturn(conn, -1);
+    virCheckNonNullArgGoto(params, error);
+    virCheckNonNullArgGoto(nparams, error);
+
+    if (VIR_DRV_SUPPORTS_FEATURE(conn->driver, conn,
+                                 VIR_DRV_FEATURE_TYPED_PARAM_STRING))
+        flags |= VIR_TYPED_PARAM_STRING_OKAY;
+
+    if (conn->driver->nodeGetMigrationParameters) {
+        int ret;
+        ret = conn->driver->nodeGetMigrationParameters(conn, params,
+                                                       nparams, flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+ error:
+    virDispatchError(conn);
+    return -1;
+}
+
+
+/**
+ * virNodeSetMigrationParameters:
+ * @conn: pointer to the hypervisor connection
+ * @params: pointer to migration parameter objects
+ * @nparams: number of migration parameter objects
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Change the limits of all outgoing migrations of the host, i.e.,
+ * VIR_NODE_MIGRATION_MAX_JOBS and VIR_NODE_MIGRATION_BANDWIDTH. Limits
+ * not present in @params are kept. The new limits apply to running
+ * migrations as well: lowering the number of jobs doesn't stop running
+ * migrations, but no new one starts until less than @max_jobs are
+ * running, and the bandwidth of running migrations is adjusted within
+ * a second.
+ *
+ * The limits are not persistent, they go back to the configuration of
+ * the hypervisor driver (if any) once it restarts.
+ *
+ * This function may require privileged access to the hypervisor.
+ *
+ * Returns 0 in case of success, -1 in case of failure.
+ */
+int
+virNodeSetMigrationParameters(virConnectPtr conn,
+                              virTypedParameterPtr params,
+                              int nparams,
+                              unsigned int flags)
+{
+    VIR_DEBUG("conn=%p, params=%p, nparams=%d, flags=0x%x",
+              conn, params, nparams, flags);
+    VIR_TYPED_PARAMS_DEBUG(params, nparams);
+
+    virResetLastError();
+
+    virCheckConnectReturn(conn, -1);
+    virCheckReadOnlyGoto(conn->flags, error);
+    virCheckNonNullArgGoto(params, error);
+    virCheckNonNegativeArgGoto(nparams, error);
+
+    if (virTypedParameterValidateSet(conn, params, nparams) < 0)
+        goto error;
+
+    if (conn->driver->nodeSetMigrationParameters) {
+        int ret;
+        ret = conn->driver->nodeSetMigrationParameters(conn, params,
+                                                       nparams, flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+ error:
+    virDispatchError(conn);
+    return -1;
+}
+
+
 /**
  * virNodeGetSecurityModel:
  * @conn: a connection object
@@ -30,6 +30,21 @@ VIR_LOG_INIT("libvirt.stream");
 #define VIR_FROM_THIS VIR_FROM_STREAMS
 
 
+/*
+ * The largest chunk of data the driver of @stream handles at once,
+ * as used by the helpers moving all data through a stream.
+ */
+static size_t
+virStreamGetChunkSize(virStreamPtr stream)
+{
+    if (stream->driver &&
+        stream->driver->streamGetChunkSize)
+        return stream->driver->streamGetChunkSize(stream);
+
+    return VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+}
+
+
 /**
  * virStreamNew:
  * @conn: pointer to the connection
@@ -574,7 +589,7 @@ virStreamSendAll(virStreamPtr stream,
                  void *opaque)
 {
     char *bytes = NULL;
-    size_t want = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t want;
     int ret = -1;
     VIR_DEBUG("stream=%p, handler=%p, opaque=%p", stream, handler, opaque);
 
@@ -589,6 +604,7 @@ virStreamSendAll(virStreamPtr stream,
         goto cleanup;
     }
 
+    want = virStreamGetChunkSize(stream);
     if (VIR_ALLOC_N(bytes, want) < 0)
         goto cleanup;
 
@@ -707,7 +723,7 @@ int virStreamSparseSendAll(virStreamPtr stream,
                            void *opaque)
 {
     char *bytes = NULL;
-    size_t bufLen = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t bufLen;
     int ret = -1;
     unsigned long long dataLen = 0;
 
@@ -727,6 +743,7 @@ int virStreamSparseSendAll(virStreamPtr stream,
         goto cleanup;
     }
 
+    bufLen = virStreamGetChunkSize(stream);
     if (VIR_ALLOC_N(bytes, bufLen) < 0)
         goto cleanup;
 
@@ -848,7 +865,7 @@ virStreamRecvAll(virStreamPtr stream,
                  void *opaque)
 {
     char *bytes = NULL;
-    size_t want = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t want;
     int ret = -1;
     VIR_DEBUG("stream=%p, handler=%p, opaque=%p", stream, handler, opaque);
 
@@ -864,6 +881,7 @@ virStreamRecvAll(virStreamPtr stream,
     }
 
 
+    want = virStreamGetChunkSize(stream);
     if (VIR_ALLOC_N(bytes, want) < 0)
         goto cleanup;
 
@@ -965,7 +983,7 @@ virStreamSparseRecvAll(virStreamPtr stream,
                        void *opaque)
 {
     char *bytes = NULL;
-    size_t want = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t want;
     const unsigned int flags = VIR_STREAM_RECV_STOP_AT_HOLE;
     int ret = -1;
 
@@ -984,6 +1002,7 @@ virStreamSparseRecvAll(virStreamPtr stream,
         goto cleanup;
     }
 
+    want = virStreamGetChunkSize(stream);
     if (VIR_ALLOC_N(bytes, want) < 0)
         goto cleanup;
 
@@ -738,6 +738,44 @@ virStateStop(void)
 }
 
 
+/**
+ * virStateGetReconnectInfo:
+ * @total: number of running domains found on startup (OUT)
+ * @done: number of them the drivers are done reconnecting to (OUT)
+ * @failed: number of them whose reconnect failed (OUT)
+ *
+ * Sum up the progress of reconnecting to running domains over all
+ * drivers which reconnect to them asynchronously.
+ *
+ * Returns 0 if successful, -1 on failure
+ */
+int
+virStateGetReconnectInfo(unsigned int *total,
+                         unsigned int *done,
+                         unsigned int *failed)
+{
+    size_t i;
+
+    *total = *done = *failed = 0;
+
+    for (i = 0; i < virStateDriverTabCount; i++) {
+        unsigned int t, d, f;
+
+        if (!virStateDriverTab[i]->initialized ||
+            !virStateDriverTab[i]->stateGetReconnectInfo)
+            continue;
+
+        if (virStateDriverTab[i]->stateGetReconnectInfo(&t, &d, &f) < 0)
+            return -1;
+
+        *total += t;
+        *done += d;
+        *failed += f;
+    }
+    return 0;
+}
+
+
 /**
  * virGetVersion:
  * @libVer: return value for the library version (OUT)
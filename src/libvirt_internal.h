@@ -38,6 +38,9 @@ int virStateInitialize(bool privileged,
 int virStateCleanup(void);
 int virStateReload(void);
 int virStateStop(void);
+int virStateGetReconnectInfo(unsigned int *total,
+                             unsigned int *done,
+                             unsigned int *failed);
 
 /* Feature detection.  This is a libvirt-private interface for determining
  * what features are supported by the driver.
@@ -125,6 +128,29 @@ typedef enum {
      * Support for driver close callback rpc
      */
     VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK = 15,
+
+    /*
+     * Support for stream data packets larger than the legacy payload
+     * size, up to VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX.
+     */
+    VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_CHUNKS = 16,
+
+    /*
+     * Support for deflate compressed message payloads
+     */
+    VIR_DRV_FEATURE_REMOTE_COMPRESSION = 17,
+
+    /*
+     * Driver supports tunnelled migration striped over several streams,
+     * i.e., domainMigratePrepareTunnelStripe.
+     */
+    VIR_DRV_FEATURE_MIGRATION_TUNNEL_STRIPES = 18,
+
+    /*
+     * Support for the packed typed parameter encoding of bulk stats
+     * replies, i.e., REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_STATS_PACKED
+     */
+    VIR_DRV_FEATURE_REMOTE_PACKED_TYPED_PARAMS = 19,
 } virDrvFeature;
 
 
@@ -263,6 +289,11 @@ int virDomainMigratePrepareTunnel3Params(virConnectPtr conn,
                                          int *cookieoutlen,
                                          unsigned int flags);
 
+int virDomainMigratePrepareTunnelStripe(virDomainPtr domain,
+                                        virStreamPtr st,
+                                        unsigned int stripe,
+                                        unsigned int flags);
+
 int virDomainMigratePerform3Params(virDomainPtr domain,
                                    const char *dconnuri,
                                    virTypedParameterPtr params,
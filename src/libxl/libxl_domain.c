@@ -231,6 +231,7 @@ libxlDomainObjPrivateDispose(void *obj)
 
     libxlDomainObjFreeJob(priv);
     virChrdevFree(priv->devs);
+    virHashFree(priv->statsFiles);
 }
 
 static void
@@ -829,6 +830,105 @@ libxlDomainDestroyInternal(libxlDriverPrivatePtr driver,
     return ret;
 }
 
+static void
+libxlDomainStatsFileFree(void *payload)
+{
+    int *fd = payload;
+
+    VIR_FORCE_CLOSE(*fd);
+    VIR_FREE(fd);
+}
+
+static int
+libxlDomainStatsFileOpen(libxlDomainObjPrivatePtr priv,
+                         const char *path)
+{
+    int *fd;
+
+    if (!priv->statsFiles &&
+        !(priv->statsFiles = virHashCreate(16, libxlDomainStatsFileFree)))
+        return -1;
+
+    if ((fd = virHashLookup(priv->statsFiles, path)))
+        return *fd;
+
+    if (VIR_ALLOC(fd) < 0)
+        return -1;
+
+    if ((*fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+        virReportSystemError(errno, _("cannot open %s"), path);
+        VIR_FREE(fd);
+        return -1;
+    }
+
+    if (virHashAddEntry(priv->statsFiles, path, fd) < 0) {
+        libxlDomainStatsFileFree(fd);
+        return -1;
+    }
+
+    return *fd;
+}
+
+/*
+ * Reads the counter in the sysfs statistics file @path of a backend
+ * device of @vm. The file is kept open so that repeated queries only
+ * cost a pread, it's reopened if the device went away in the meantime.
+ *
+ * virDomainObjPtr must be locked on invocation
+ */
+int
+libxlDomainReadStatsFile(virDomainObjPtr vm,
+                         const char *path,
+                         unsigned long long *value)
+{
+    libxlDomainObjPrivatePtr priv = vm->privateData;
+    char buf[32];
+    char *end;
+    ssize_t len = -1;
+    size_t i;
+    int err = 0;
+    int fd;
+
+    for (i = 0; i < 2 && len < 0; i++) {
+        if ((fd = libxlDomainStatsFileOpen(priv, path)) < 0)
+            return -1;
+
+        if ((len = pread(fd, buf, sizeof(buf) - 1, 0)) < 0) {
+            err = errno;
+            virHashRemoveEntry(priv->statsFiles, path);
+        }
+    }
+
+    if (len < 0) {
+        virReportSystemError(err, _("cannot read %s"), path);
+        return -1;
+    }
+
+    buf[len] = '\0';
+    if (virStrToLong_ull(buf, &end, 10, value) < 0 ||
+        (*end && *end != '\n')) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("malformed statistics in %s"), path);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Closes the statistics files of the backend devices of @vm.
+ *
+ * virDomainObjPtr must be locked on invocation
+ */
+void
+libxlDomainCloseStatsFiles(virDomainObjPtr vm)
+{
+    libxlDomainObjPrivatePtr priv = vm->privateData;
+
+    virHashFree(priv->statsFiles);
+    priv->statsFiles = NULL;
+}
+
 /*
  * Cleanup function for domain that has reached shutoff state.
  *
@@ -870,6 +970,7 @@ libxlDomainCleanup(libxlDriverPrivatePtr driver,
     VIR_DEBUG("Preserving lock state '%s'", NULLSTR(priv->lockState));
 
     libxlLoggerCloseFile(cfg->logger, vm->def->id);
+    libxlDomainCloseStatsFiles(vm);
     vm->def->id = -1;
 
     if (priv->deathW) {
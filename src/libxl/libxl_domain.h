@@ -72,6 +72,9 @@ struct _libxlDomainObjPrivate {
     struct libxlDomainJobObj job;
 
     bool hookRun;  /* true if there was a hook run over this domain */
+
+    /* open sysfs statistics files of the backend devices, keyed by path */
+    virHashTablePtr statsFiles;
 };
 
 
@@ -116,6 +119,14 @@ void
 libxlDomainCleanup(libxlDriverPrivatePtr driver,
                    virDomainObjPtr vm);
 
+int
+libxlDomainReadStatsFile(virDomainObjPtr vm,
+                         const char *path,
+                         unsigned long long *value);
+
+void
+libxlDomainCloseStatsFiles(virDomainObjPtr vm);
+
 /*
  * Note: Xen 4.3 removed the const from the event handler signature.
  * Detect which signature to use based on
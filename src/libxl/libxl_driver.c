@@ -49,6 +49,7 @@
 #include "viruri.h"
 #include "virstring.h"
 #include "virsysinfo.h"
+#include "virthread.h"
 #include "viraccessapicheck.h"
 #include "virhostdev.h"
 #include "virpidfile.h"
@@ -380,19 +381,50 @@ libxlReconnectNotifyNets(virDomainDefPtr def)
 }
 
 
+/* Upper limit on the number of domains reconnected to at once */
+#define LIBXL_RECONNECT_WORKERS 8
+
+struct libxlReconnectData {
+    libxlDriverPrivatePtr driver;
+
+    /* Snapshot of the domains running on the host, or NULL */
+    libxl_dominfo *infos;
+    int ninfos;
+
+    virDomainObjPtr *vms;
+    size_t nvms;
+};
+
+
+static const libxl_dominfo *
+libxlReconnectFindDomain(struct libxlReconnectData *data,
+                         int domid)
+{
+    int i;
+
+    for (i = 0; i < data->ninfos; i++) {
+        if (data->infos[i].domid == domid)
+            return &data->infos[i];
+    }
+
+    return NULL;
+}
+
+
 /*
  * Reconnect to running domains that were previously started/created
  * with libxenlight driver.
  */
 static int
 libxlReconnectDomain(virDomainObjPtr vm,
-                     void *opaque)
+                     struct libxlReconnectData *data)
 {
-    libxlDriverPrivatePtr driver = opaque;
+    libxlDriverPrivatePtr driver = data->driver;
     libxlDomainObjPrivatePtr priv = vm->privateData;
     libxlDriverConfigPtr cfg = libxlDriverConfigGet(driver);
     int rc;
     libxl_dominfo d_info;
+    const libxl_dominfo *info = &d_info;
     int len;
     uint8_t *data = NULL;
     virHostdevManagerPtr hostdev_mgr = driver->hostdevMgr;
@@ -409,13 +441,20 @@ libxlReconnectDomain(virDomainObjPtr vm,
     libxl_dominfo_init(&d_info);
 
     /* Does domain still exist? */
-    rc = libxl_domain_info(cfg->ctx, &d_info, vm->def->id);
-    if (rc == ERROR_INVAL) {
-        goto error;
-    } else if (rc != 0) {
-        VIR_DEBUG("libxl_domain_info failed (code %d), ignoring domain %d",
-                  rc, vm->def->id);
-        goto error;
+    if (data->infos) {
+        if (!(info = libxlReconnectFindDomain(data, vm->def->id))) {
+            VIR_DEBUG("domain %d is not running, ignoring it", vm->def->id);
+            goto error;
+        }
+    } else {
+        rc = libxl_domain_info(cfg->ctx, &d_info, vm->def->id);
+        if (rc == ERROR_INVAL) {
+            goto error;
+        } else if (rc != 0) {
+            VIR_DEBUG("libxl_domain_info failed (code %d), ignoring domain %d",
+                      rc, vm->def->id);
+            goto error;
+        }
     }
 
     /* Is this a domain that was under libvirt control? */
@@ -426,7 +465,7 @@ libxlReconnectDomain(virDomainObjPtr vm,
     }
 
     /* Update domid in case it changed (e.g. reboot) while we were gone? */
-    vm->def->id = d_info.domid;
+    vm->def->id = info->domid;
 
     libxlLoggerOpenFile(cfg->logger, vm->def->id, vm->def->name, NULL);
 
@@ -435,11 +474,11 @@ libxlReconnectDomain(virDomainObjPtr vm,
                                             vm->def, hostdev_flags) < 0)
         goto error;
 
-    if (d_info.shutdown &&
-            d_info.shutdown_reason == LIBXL_SHUTDOWN_REASON_SUSPEND)
+    if (info->shutdown &&
+            info->shutdown_reason == LIBXL_SHUTDOWN_REASON_SUSPEND)
         virDomainObjSetState(vm, VIR_DOMAIN_PMSUSPENDED,
                              VIR_DOMAIN_PMSUSPENDED_UNKNOWN);
-    else if (d_info.paused)
+    else if (info->paused)
         virDomainObjSetState(vm, VIR_DOMAIN_PAUSED,
                              VIR_DOMAIN_PAUSED_UNKNOWN);
     else
@@ -490,14 +529,56 @@ libxlReconnectDomain(virDomainObjPtr vm,
  error:
     libxlDomainCleanup(driver, vm);
     if (!vm->persistent)
-        virDomainObjListRemoveLocked(driver->domains, vm);
+        virDomainObjListRemove(driver->domains, vm);
     goto cleanup;
 }
 
+
+static void
+libxlReconnectOne(size_t idx,
+                  void *opaque)
+{
+    struct libxlReconnectData *data = opaque;
+
+    /* Errors are thread local and were logged already */
+    ignore_value(libxlReconnectDomain(data->vms[idx], data));
+    virResetLastError();
+}
+
+
+/*
+ * Reconnecting to a domain means querying libxl and xenstore about it,
+ * updating the state of its host devices and running the reconnect hook.
+ * The state of all the running domains is fetched from libxl at once and
+ * the domains are then reconnected to several at a time, like they are
+ * started concurrently by API calls.
+ */
 static void
 libxlReconnectDomains(libxlDriverPrivatePtr driver)
 {
-    virDomainObjListForEach(driver->domains, true, libxlReconnectDomain, driver);
+    g_autoptr(libxlDriverConfig) cfg = libxlDriverConfigGet(driver);
+    struct libxlReconnectData data = { .driver = driver };
+
+    /* Collecting can only fail on allocation, which aborts anyway */
+    ignore_value(virDomainObjListCollect(driver->domains, NULL,
+                                         &data.vms, &data.nvms, NULL, 0));
+
+    if (data.nvms == 0) {
+        VIR_FREE(data.vms);
+        return;
+    }
+
+    /* Fall back to querying domains one by one if this fails */
+    if (!(data.infos = libxl_list_domain(cfg->ctx, &data.ninfos)))
+        VIR_DEBUG("libxl_list_domain failed, querying domains one by one");
+
+    virThreadForEachParallel(data.nvms, LIBXL_RECONNECT_WORKERS,
+                             "libxl-reconnect", libxlReconnectOne, &data);
+
+    if (data.infos)
+        libxl_dominfo_list_free(data.infos, data.ninfos);
+
+    virObjectListFreeCount(data.vms, data.nvms);
 }
 
 static int
@@ -5369,16 +5450,20 @@ libxlDiskPathToID(const char *virtpath)
 
 # define LIBXL_VBD_SECTOR_SIZE 512
 
+/*
+ * Reads the sector size of the vbd @devno of domain @domid from xenstore.
+ * @xsh is an already open xenstore connection or NULL to open one just
+ * for this lookup.
+ */
 static int
-libxlDiskSectorSize(int domid, int devno)
+libxlDiskSectorSize(struct xs_handle *xsh, int domid, int devno)
 {
     char *path, *val;
-    struct xs_handle *handle;
+    struct xs_handle *handle = xsh;
     int ret = LIBXL_VBD_SECTOR_SIZE;
     unsigned int len;
 
-    handle = xs_daemon_open_readonly();
-    if (!handle) {
+    if (!handle && !(handle = xs_daemon_open_readonly())) {
         VIR_WARN("cannot read sector size");
         return ret;
     }
@@ -5402,52 +5487,49 @@ libxlDiskSectorSize(int domid, int devno)
  cleanup:
     VIR_FREE(val);
     VIR_FREE(path);
-    xs_daemon_close(handle);
+    if (!xsh)
+        xs_daemon_close(handle);
     return ret;
 }
 
+/*
+ * The statistics files are kept open by libxlDomainReadStatsFile so that
+ * repeated queries, most notably the bulk stats of all domains, don't
+ * have to look them up in sysfs every time.
+ */
 static int
 libxlDomainBlockStatsVBD(virDomainObjPtr vm,
                          const char *dev,
-                         libxlBlockStatsPtr stats)
+                         libxlBlockStatsPtr stats,
+                         struct xs_handle *xsh)
 {
     int ret = -1;
     int devno = libxlDiskPathToID(dev);
     int size;
-    char *path, *name, *val;
+    char *path, *name;
     unsigned long long status;
 
-    path = name = val = NULL;
+    path = name = NULL;
     if (devno < 0) {
         virReportError(VIR_ERR_OPERATION_INVALID,
                        "%s", _("cannot find device number"));
         return ret;
     }
 
-    size = libxlDiskSectorSize(vm->def->id, devno);
+    size = libxlDiskSectorSize(xsh, vm->def->id, devno);
 
-    stats->backend = g_strdup("vbd");
+    if (!stats->backend)
+        stats->backend = g_strdup("vbd");
 
     path = g_strdup_printf("/sys/bus/xen-backend/devices/vbd-%d-%d/statistics",
                            vm->def->id, devno);
 
-    if (!virFileExists(path)) {
-        virReportError(VIR_ERR_OPERATION_FAILED,
-                       "%s", _("cannot open bus path"));
-        goto cleanup;
-    }
-
 # define LIBXL_SET_VBDSTAT(FIELD, VAR, MUL) \
     name = g_strdup_printf("%s/"FIELD, path); \
-    if ((virFileReadAll(name, 256, &val) < 0) || \
-        (sscanf(val, "%llu", &status) != 1)) { \
-        virReportError(VIR_ERR_OPERATION_FAILED, \
-                       _("cannot read %s"), name); \
+    if (libxlDomainReadStatsFile(vm, name, &status) < 0) \
         goto cleanup; \
-    } \
     VAR += (status * MUL); \
-    VIR_FREE(name); \
-    VIR_FREE(val);
+    VIR_FREE(name);
 
     LIBXL_SET_VBDSTAT("f_req",  stats->f_req,  1)
     LIBXL_SET_VBDSTAT("wr_req", stats->wr_req, 1)
@@ -5462,7 +5544,6 @@ libxlDomainBlockStatsVBD(virDomainObjPtr vm,
  cleanup:
     VIR_FREE(name);
     VIR_FREE(path);
-    VIR_FREE(val);
 
 # undef LIBXL_SET_VBDSTAT
 
@@ -5472,7 +5553,8 @@ libxlDomainBlockStatsVBD(virDomainObjPtr vm,
 static int
 libxlDomainBlockStatsVBD(virDomainObjPtr vm G_GNUC_UNUSED,
                          const char *dev G_GNUC_UNUSED,
-                         libxlBlockStatsPtr stats G_GNUC_UNUSED)
+                         libxlBlockStatsPtr stats G_GNUC_UNUSED,
+                         struct xs_handle *xsh G_GNUC_UNUSED)
 {
     virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
                    "%s", _("platform unsupported"));
@@ -5507,7 +5589,7 @@ libxlDomainBlockStatsGatherSingle(virDomainObjPtr vm,
             return ret;
         }
 
-        ret = libxlDomainBlockStatsVBD(vm, disk->dst, stats);
+        ret = libxlDomainBlockStatsVBD(vm, disk->dst, stats, NULL);
     } else {
         virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
                        _("unsupported disk driver %s"),
@@ -5654,6 +5736,406 @@ libxlDomainBlockStatsFlags(virDomainPtr dom,
     return ret;
 }
 
+/* State shared by the bulk stats of all domains of a single call */
+struct libxlDomainStatsData {
+    libxl_dominfo *infos;
+    int ninfos;
+    struct xs_handle *xsh;
+};
+
+static const libxl_dominfo *
+libxlDomainStatsFindInfo(struct libxlDomainStatsData *data,
+                         int domid)
+{
+    int i;
+
+    for (i = 0; i < data->ninfos; i++) {
+        if (data->infos[i].domid == domid)
+            return &data->infos[i];
+    }
+
+    return NULL;
+}
+
+static int
+libxlDomainGetStatsState(virDomainObjPtr vm,
+                         struct libxlDomainStatsData *data G_GNUC_UNUSED,
+                         virTypedParamListPtr params)
+{
+    if (virTypedParamListAddInt(params, vm->state.state, "state.state") < 0)
+        return -1;
+
+    if (virTypedParamListAddInt(params, vm->state.reason, "state.reason") < 0)
+        return -1;
+
+    return 0;
+}
+
+static int
+libxlDomainGetStatsCpu(virDomainObjPtr vm,
+                       struct libxlDomainStatsData *data,
+                       virTypedParamListPtr params)
+{
+    const libxl_dominfo *info;
+
+    if (!virDomainObjIsActive(vm) ||
+        !(info = libxlDomainStatsFindInfo(data, vm->def->id)))
+        return 0;
+
+    return virTypedParamListAddULLong(params, info->cpu_time, "cpu.time");
+}
+
+static int
+libxlDomainGetStatsBalloon(virDomainObjPtr vm,
+                           struct libxlDomainStatsData *data,
+                           virTypedParamListPtr params)
+{
+    const libxl_dominfo *info = NULL;
+    unsigned long long current = vm->def->mem.cur_balloon;
+
+    if (virDomainObjIsActive(vm) &&
+        (info = libxlDomainStatsFindInfo(data, vm->def->id)))
+        current = info->current_memkb;
+
+    if (virTypedParamListAddULLong(params, current, "balloon.current") < 0)
+        return -1;
+
+    if (virTypedParamListAddULLong(params, virDomainDefGetMemoryTotal(vm->def),
+                                   "balloon.maximum") < 0)
+        return -1;
+
+    return 0;
+}
+
+static int
+libxlDomainGetStatsVcpu(virDomainObjPtr vm,
+                        struct libxlDomainStatsData *data G_GNUC_UNUSED,
+                        virTypedParamListPtr params)
+{
+    if (virTypedParamListAddUInt(params, virDomainDefGetVcpus(vm->def),
+                                 "vcpu.current") < 0)
+        return -1;
+
+    if (virTypedParamListAddUInt(params, virDomainDefGetVcpusMax(vm->def),
+                                 "vcpu.maximum") < 0)
+        return -1;
+
+    return 0;
+}
+
+#ifdef __linux__
+/*
+ * Reads the counters of the backend interface @net from sysfs through the
+ * cached statistics files of @vm. The backend sees the traffic of the
+ * guest reversed unless it shares the host view.
+ */
+static int
+libxlDomainInterfaceStatsSysfs(virDomainObjPtr vm,
+                               virDomainNetDefPtr net,
+                               virDomainInterfaceStatsPtr stats)
+{
+    bool swapped = !virDomainNetTypeSharesHostView(net);
+    unsigned long long val;
+
+# define LIBXL_SET_NETSTAT(FIELD, VAR) \
+    do { \
+        g_autofree char *name = NULL; \
+        name = g_strdup_printf("/sys/class/net/%s/statistics/%s_"FIELD, \
+                               net->ifname, swapped ? "tx" : "rx"); \
+        if (libxlDomainReadStatsFile(vm, name, &val) < 0) \
+            return -1; \
+        stats->rx_##VAR = val; \
+        VIR_FREE(name); \
+        name = g_strdup_printf("/sys/class/net/%s/statistics/%s_"FIELD, \
+                               net->ifname, swapped ? "rx" : "tx"); \
+        if (libxlDomainReadStatsFile(vm, name, &val) < 0) \
+            return -1; \
+        stats->tx_##VAR = val; \
+    } while (0)
+
+    LIBXL_SET_NETSTAT("bytes", bytes);
+    LIBXL_SET_NETSTAT("packets", packets);
+    LIBXL_SET_NETSTAT("errors", errs);
+    LIBXL_SET_NETSTAT("dropped", drop);
+
+# undef LIBXL_SET_NETSTAT
+
+    return 0;
+}
+#else
+static int
+libxlDomainInterfaceStatsSysfs(virDomainObjPtr vm G_GNUC_UNUSED,
+                               virDomainNetDefPtr net,
+                               virDomainInterfaceStatsPtr stats)
+{
+    return virNetDevTapInterfaceStats(net->ifname, stats,
+                                      !virDomainNetTypeSharesHostView(net));
+}
+#endif
+
+#define LIBXL_ADD_COUNT_PARAM(params, type, count) \
+    do { \
+        if (virTypedParamListAddUInt(params, count, type ".count") < 0) \
+            return -1; \
+    } while (0)
+
+#define LIBXL_ADD_STAT_PARAM(params, type, num, name, value) \
+    do { \
+        if (value >= 0 && \
+            virTypedParamListAddULLong(params, value, type ".%zu." name, \
+                                       num) < 0) \
+            return -1; \
+    } while (0)
+
+static int
+libxlDomainGetStatsInterface(virDomainObjPtr vm,
+                             struct libxlDomainStatsData *data G_GNUC_UNUSED,
+                             virTypedParamListPtr params)
+{
+    size_t i;
+
+    if (!virDomainObjIsActive(vm))
+        return 0;
+
+    LIBXL_ADD_COUNT_PARAM(params, "net", vm->def->nnets);
+
+    for (i = 0; i < vm->def->nnets; i++) {
+        virDomainNetDefPtr net = vm->def->nets[i];
+        struct _virDomainInterfaceStats tmp;
+
+        if (!net->ifname)
+            continue;
+
+        if (virTypedParamListAddString(params, net->ifname,
+                                       "net.%zu.name", i) < 0)
+            return -1;
+
+        memset(&tmp, 0, sizeof(tmp));
+        if (libxlDomainInterfaceStatsSysfs(vm, net, &tmp) < 0) {
+            virResetLastError();
+            continue;
+        }
+
+        LIBXL_ADD_STAT_PARAM(params, "net", i, "rx.bytes", tmp.rx_bytes);
+        LIBXL_ADD_STAT_PARAM(params, "net", i, "rx.pkts", tmp.rx_packets);
+        LIBXL_ADD_STAT_PARAM(params, "net", i, "rx.errs", tmp.rx_errs);
+        LIBXL_ADD_STAT_PARAM(params, "net", i, "rx.drop", tmp.rx_drop);
+        LIBXL_ADD_STAT_PARAM(params, "net", i, "tx.bytes", tmp.tx_bytes);
+        LIBXL_ADD_STAT_PARAM(params, "net", i, "tx.pkts", tmp.tx_packets);
+        LIBXL_ADD_STAT_PARAM(params, "net", i, "tx.errs", tmp.tx_errs);
+        LIBXL_ADD_STAT_PARAM(params, "net", i, "tx.drop", tmp.tx_drop);
+    }
+
+    return 0;
+}
+
+static int
+libxlDomainGetStatsBlock(virDomainObjPtr vm,
+                         struct libxlDomainStatsData *data,
+                         virTypedParamListPtr params)
+{
+    size_t i;
+
+    if (!virDomainObjIsActive(vm))
+        return 0;
+
+    LIBXL_ADD_COUNT_PARAM(params, "block", vm->def->ndisks);
+
+    for (i = 0; i < vm->def->ndisks; i++) {
+        virDomainDiskDefPtr disk = vm->def->disks[i];
+        libxlBlockStats blkstats;
+        int rc;
+
+        if (virTypedParamListAddString(params, disk->dst,
+                                       "block.%zu.name", i) < 0)
+            return -1;
+
+        /* Only the vbd backend has statistics, see
+         * libxlDomainBlockStatsGatherSingle */
+        if (STRNEQ_NULLABLE(virDomainDiskGetDriver(disk), "phy") ||
+            virDomainDiskGetFormat(disk) != VIR_STORAGE_FILE_RAW)
+            continue;
+
+        memset(&blkstats, 0, sizeof(blkstats));
+        rc = libxlDomainBlockStatsVBD(vm, disk->dst, &blkstats, data->xsh);
+        VIR_FREE(blkstats.backend);
+        if (rc < 0) {
+            virResetLastError();
+            continue;
+        }
+
+        LIBXL_ADD_STAT_PARAM(params, "block", i, "rd.reqs", blkstats.rd_req);
+        LIBXL_ADD_STAT_PARAM(params, "block", i, "rd.bytes", blkstats.rd_bytes);
+        LIBXL_ADD_STAT_PARAM(params, "block", i, "wr.reqs", blkstats.wr_req);
+        LIBXL_ADD_STAT_PARAM(params, "block", i, "wr.bytes", blkstats.wr_bytes);
+        LIBXL_ADD_STAT_PARAM(params, "block", i, "fl.reqs", blkstats.f_req);
+        LIBXL_ADD_STAT_PARAM(params, "block", i, "errors", blkstats.u.vbd.oo_req);
+    }
+
+    return 0;
+}
+
+#undef LIBXL_ADD_STAT_PARAM
+#undef LIBXL_ADD_COUNT_PARAM
+
+typedef int
+(*libxlDomainGetStatsFunc)(virDomainObjPtr vm,
+                           struct libxlDomainStatsData *data,
+                           virTypedParamListPtr params);
+
+struct libxlDomainGetStatsWorker {
+    libxlDomainGetStatsFunc func;
+    unsigned int stats;
+};
+
+static struct libxlDomainGetStatsWorker libxlDomainGetStatsWorkers[] = {
+    { libxlDomainGetStatsState, VIR_DOMAIN_STATS_STATE },
+    { libxlDomainGetStatsCpu, VIR_DOMAIN_STATS_CPU_TOTAL },
+    { libxlDomainGetStatsBalloon, VIR_DOMAIN_STATS_BALLOON },
+    { libxlDomainGetStatsVcpu, VIR_DOMAIN_STATS_VCPU },
+    { libxlDomainGetStatsInterface, VIR_DOMAIN_STATS_INTERFACE },
+    { libxlDomainGetStatsBlock, VIR_DOMAIN_STATS_BLOCK },
+    { NULL, 0 }
+};
+
+static int
+libxlDomainGetStats(virConnectPtr conn,
+                    virDomainObjPtr vm,
+                    struct libxlDomainStatsData *data,
+                    unsigned int stats,
+                    virDomainStatsRecordPtr *record)
+{
+    g_autofree virDomainStatsRecordPtr tmp = NULL;
+    g_autoptr(virTypedParamList) params = NULL;
+    size_t i;
+
+    if (VIR_ALLOC(params) < 0)
+        return -1;
+
+    for (i = 0; libxlDomainGetStatsWorkers[i].func; i++) {
+        if (stats & libxlDomainGetStatsWorkers[i].stats &&
+            libxlDomainGetStatsWorkers[i].func(vm, data, params) < 0)
+            return -1;
+    }
+
+    if (VIR_ALLOC(tmp) < 0)
+        return -1;
+
+    if (!(tmp->dom = virGetDomain(conn, vm->def->name,
+                                  vm->def->uuid, vm->def->id)))
+        return -1;
+
+    tmp->nparams = virTypedParamListStealParams(params, &tmp->params);
+    *record = g_steal_pointer(&tmp);
+    return 0;
+}
+
+/*
+ * The stats of all domains are collected in a single sweep: the CPU time
+ * and the balloon of every running domain come from one libxl domain
+ * list, the sector sizes of the vbds from one xenstore connection and
+ * the sysfs counters of the vbd and vif backends from statistics files
+ * kept open across calls.
+ */
+static int
+libxlConnectGetAllDomainStats(virConnectPtr conn,
+                              virDomainPtr *doms,
+                              unsigned int ndoms,
+                              unsigned int stats,
+                              virDomainStatsRecordPtr **retStats,
+                              unsigned int flags)
+{
+    libxlDriverPrivatePtr driver = conn->privateData;
+    g_autoptr(libxlDriverConfig) cfg = NULL;
+    struct libxlDomainStatsData data = { NULL, 0, NULL };
+    unsigned int supported = 0;
+    virDomainObjPtr *vms = NULL;
+    size_t nvms;
+    virDomainStatsRecordPtr *tmpstats = NULL;
+    int nstats = 0;
+    size_t i;
+    int ret = -1;
+    unsigned int lflags = flags & (VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE |
+                                   VIR_CONNECT_LIST_DOMAINS_FILTERS_PERSISTENT |
+                                   VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE);
+
+    virCheckFlags(VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE |
+                  VIR_CONNECT_LIST_DOMAINS_FILTERS_PERSISTENT |
+                  VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE |
+                  VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS, -1);
+
+    if (virConnectGetAllDomainStatsEnsureACL(conn) < 0)
+        return -1;
+
+    for (i = 0; libxlDomainGetStatsWorkers[i].func; i++)
+        supported |= libxlDomainGetStatsWorkers[i].stats;
+
+    if (!stats) {
+        stats = supported;
+    } else if ((flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS) &&
+               (stats & ~supported)) {
+        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED,
+                       _("Stats types bits 0x%x are not supported by this daemon"),
+                       stats & ~supported);
+        return -1;
+    }
+    stats &= supported;
+
+    if (ndoms) {
+        if (virDomainObjListConvert(driver->domains, conn, doms, ndoms, &vms,
+                                    &nvms, virConnectGetAllDomainStatsCheckACL,
+                                    lflags, true) < 0)
+            return -1;
+    } else {
+        if (virDomainObjListCollect(driver->domains, conn, &vms, &nvms,
+                                    virConnectGetAllDomainStatsCheckACL,
+                                    lflags) < 0)
+            return -1;
+    }
+
+    if (VIR_ALLOC_N(tmpstats, nvms + 1) < 0)
+        goto cleanup;
+
+    if (stats & (VIR_DOMAIN_STATS_CPU_TOTAL | VIR_DOMAIN_STATS_BALLOON)) {
+        cfg = libxlDriverConfigGet(driver);
+
+        /* Without the list the stats of running domains are omitted */
+        if (!(data.infos = libxl_list_domain(cfg->ctx, &data.ninfos))) {
+            VIR_WARN("libxl_list_domain failed");
+            data.ninfos = 0;
+        }
+    }
+
+    if (stats & VIR_DOMAIN_STATS_BLOCK)
+        data.xsh = xs_daemon_open_readonly();
+
+    for (i = 0; i < nvms; i++) {
+        virDomainStatsRecordPtr tmp = NULL;
+        int rc;
+
+        virObjectLock(vms[i]);
+        rc = libxlDomainGetStats(conn, vms[i], &data, stats, &tmp);
+        virObjectUnlock(vms[i]);
+
+        if (rc < 0)
+            goto cleanup;
+
+        tmpstats[nstats++] = tmp;
+    }
+
+    *retStats = g_steal_pointer(&tmpstats);
+    ret = nstats;
+
+ cleanup:
+    if (data.xsh)
+        xs_daemon_close(data.xsh);
+    if (data.infos)
+        libxl_dominfo_list_free(data.infos, data.ninfos);
+    virDomainStatsRecordListFree(tmpstats);
+    virObjectListFreeCount(vms, nvms);
+    return ret;
+}
+
 static int
 libxlConnectDomainEventRegisterAny(virConnectPtr conn, virDomainPtr dom, int eventID,
                                    virConnectDomainEventGenericCallback callback,
@@ -5737,6 +6219,10 @@ libxlConnectSupportsFeature(virConnectPtr conn, int feature)
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_CHUNKS:
+    case VIR_DRV_FEATURE_REMOTE_COMPRESSION:
+    case VIR_DRV_FEATURE_REMOTE_PACKED_TYPED_PARAMS:
+    case VIR_DRV_FEATURE_MIGRATION_TUNNEL_STRIPES:
     case VIR_DRV_FEATURE_XML_MIGRATABLE:
     default:
         return 0;
@@ -6692,6 +7178,7 @@ static virHypervisorDriver libxlHypervisorDriver = {
     .domainInterfaceStats = libxlDomainInterfaceStats, /* 1.3.2 */
     .domainBlockStats = libxlDomainBlockStats, /* 2.1.0 */
     .domainBlockStatsFlags = libxlDomainBlockStatsFlags, /* 2.1.0 */
+    .connectGetAllDomainStats = libxlConnectGetAllDomainStats, /* 6.2.0 */
     .connectDomainEventRegister = libxlConnectDomainEventRegister, /* 0.9.0 */
     .connectDomainEventDeregister = libxlConnectDomainEventDeregister, /* 0.9.0 */
     .domainManagedSave = libxlDomainManagedSave, /* 0.9.2 */
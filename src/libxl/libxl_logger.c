@@ -28,6 +28,7 @@
 #include "util/virfile.h"
 #include "util/virhash.h"
 #include "util/virstring.h"
+#include "util/virthread.h"
 #include "util/virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_LIBXL
@@ -41,7 +42,9 @@ struct xentoollog_logger_libvirt {
     xentoollog_level minLevel;
     const char *logDir;
 
-    /* map storing the opened fds: "domid" -> FILE* */
+    /* map storing the opened fds: "domid" -> FILE*, guarded by @lock
+     * as domains are started and reconnected to concurrently */
+    virMutex lock;
     virHashTablePtr files;
     FILE *defaultLogFile;
 };
@@ -75,6 +78,8 @@ libvirt_vmessage(xentoollog_logger *logger_in,
 
     message = g_strdup_vprintf(format, args);
 
+    virMutexLock(&lg->lock);
+
     /* Should we print to a domain-specific log file? */
     if ((start = strstr(message, ": Domain ")) &&
         (end = strstr(start + 9, ":"))) {
@@ -108,6 +113,8 @@ libvirt_vmessage(xentoollog_logger *logger_in,
     fputc('\n', logFile);
     fflush(logFile);
 
+    virMutexUnlock(&lg->lock);
+
     VIR_FREE(message);
 }
 
@@ -161,13 +168,25 @@ libxlLoggerNew(const char *logDir, virLogPriority minLevel)
     if ((logger.defaultLogFile = fopen(path, "a")) == NULL)
         goto error;
 
-    logger_out = XTL_NEW_LOGGER(libvirt, logger);
+    /* The logger is copied, so its lock is only initialized afterwards */
+    if (!(logger_out = XTL_NEW_LOGGER(libvirt, logger)))
+        goto error;
+
+    if (virMutexInit(&logger_out->lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("unable to initialize mutex"));
+        xtl_logger_destroy((xentoollog_logger *) logger_out);
+        logger_out = NULL;
+        goto error;
+    }
 
  cleanup:
     VIR_FREE(path);
     return logger_out;
 
  error:
+    if (logger.defaultLogFile)
+        VIR_FORCE_FCLOSE(logger.defaultLogFile);
     virHashFree(logger.files);
     goto cleanup;
 }
@@ -179,6 +198,7 @@ libxlLoggerFree(libxlLoggerPtr logger)
     if (logger->defaultLogFile)
         VIR_FORCE_FCLOSE(logger->defaultLogFile);
     virHashFree(logger->files);
+    virMutexDestroy(&logger->lock);
     xtl_logger_destroy(xtl_logger);
 }
 
@@ -200,7 +220,9 @@ libxlLoggerOpenFile(libxlLoggerPtr logger,
                  path, g_strerror(errno));
         goto cleanup;
     }
+    virMutexLock(&logger->lock);
     ignore_value(virHashAddEntry(logger->files, domidstr, logFile));
+    virMutexUnlock(&logger->lock);
 
     /* domain_config is non NULL only when starting a new domain */
     if (domain_config) {
@@ -219,7 +241,9 @@ libxlLoggerCloseFile(libxlLoggerPtr logger, int id)
     char *domidstr = NULL;
     domidstr = g_strdup_printf("%d", id);
 
+    virMutexLock(&logger->lock);
     ignore_value(virHashRemoveEntry(logger->files, domidstr));
+    virMutexUnlock(&logger->lock);
 
     VIR_FREE(domidstr);
 }
@@ -35,6 +35,41 @@ VIR_LOG_INIT("locking.lock_daemon_dispatch");
 
 #include "lock_daemon_dispatch_stubs.h"
 
+/* Must be called with priv->lock held */
+static virLockSpacePtr
+virLockSpaceProtocolAcquireOne(virLockDaemonClientPtr priv,
+                               virLockSpaceProtocolAcquireResourceArgs *args)
+{
+    unsigned int flags = args->flags;
+    virLockSpacePtr lockspace;
+    unsigned int newFlags;
+
+    virCheckFlags(VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED |
+                  VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE, NULL);
+
+    if (!(lockspace = virLockDaemonFindLockSpace(lockDaemon, args->path))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Lockspace for path %s does not exist"),
+                       args->path);
+        return NULL;
+    }
+
+    newFlags = 0;
+    if (flags & VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED)
+        newFlags |= VIR_LOCK_SPACE_ACQUIRE_SHARED;
+    if (flags & VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE)
+        newFlags |= VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE;
+
+    if (virLockSpaceAcquireResource(lockspace,
+                                    args->name,
+                                    priv->ownerPid,
+                                    newFlags) < 0)
+        return NULL;
+
+    return lockspace;
+}
+
+
 static int
 virLockSpaceProtocolDispatchAcquireResource(virNetServerPtr server G_GNUC_UNUSED,
                                             virNetServerClientPtr client,
@@ -43,17 +78,11 @@ virLockSpaceProtocolDispatchAcquireResource(virNetServerPtr server G_GNUC_UNUSED
                                             virLockSpaceProtocolAcquireResourceArgs *args)
 {
     int rv = -1;
-    unsigned int flags = args->flags;
     virLockDaemonClientPtr priv =
         virNetServerClientGetPrivateData(client);
-    virLockSpacePtr lockspace;
-    unsigned int newFlags;
 
     virMutexLock(&priv->lock);
 
-    virCheckFlagsGoto(VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED |
-                      VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE, cleanup);
-
     if (priv->restricted) {
         virReportError(VIR_ERR_OPERATION_DENIED, "%s",
                        _("lock manager connection has been restricted"));
@@ -66,30 +95,83 @@ virLockSpaceProtocolDispatchAcquireResource(virNetServerPtr server G_GNUC_UNUSED
         goto cleanup;
     }
 
-    if (!(lockspace = virLockDaemonFindLockSpace(lockDaemon, args->path))) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Lockspace for path %s does not exist"),
-                       args->path);
+    if (!virLockSpaceProtocolAcquireOne(priv, args))
         goto cleanup;
-    }
 
-    newFlags = 0;
-    if (flags & VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED)
-        newFlags |= VIR_LOCK_SPACE_ACQUIRE_SHARED;
-    if (flags & VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE)
-        newFlags |= VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE;
+    rv = 0;
 
-    if (virLockSpaceAcquireResource(lockspace,
-                                    args->name,
-                                    priv->ownerPid,
-                                    newFlags) < 0)
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    virMutexUnlock(&priv->lock);
+    return rv;
+}
+
+
+/*
+ * Acquires all resources of a domain in one round trip. Either all of
+ * them are acquired, or none: on failure the ones acquired so far are
+ * released again.
+ */
+static int
+virLockSpaceProtocolDispatchAcquireResources(virNetServerPtr server G_GNUC_UNUSED,
+                                             virNetServerClientPtr client,
+                                             virNetMessagePtr msg G_GNUC_UNUSED,
+                                             virNetMessageErrorPtr rerr,
+                                             virLockSpaceProtocolAcquireResourcesArgs *args)
+{
+    int rv = -1;
+    unsigned int flags = args->flags;
+    virLockDaemonClientPtr priv =
+        virNetServerClientGetPrivateData(client);
+    g_autofree virLockSpacePtr *acquired = NULL;
+    size_t nacquired = 0;
+    size_t i;
+
+    virMutexLock(&priv->lock);
+
+    virCheckFlagsGoto(0, cleanup);
+
+    if (priv->restricted) {
+        virReportError(VIR_ERR_OPERATION_DENIED, "%s",
+                       _("lock manager connection has been restricted"));
         goto cleanup;
+    }
+
+    if (!priv->ownerId) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("lock owner details have not been registered"));
+        goto cleanup;
+    }
+
+    acquired = g_new0(virLockSpacePtr, args->resources.resources_len);
+
+    for (i = 0; i < args->resources.resources_len; i++) {
+        if (!(acquired[i] = virLockSpaceProtocolAcquireOne(priv,
+                                                           &args->resources.resources_val[i])))
+            goto cleanup;
+        nacquired++;
+    }
 
     rv = 0;
 
  cleanup:
-    if (rv < 0)
+    if (rv < 0) {
+        virErrorPtr origerr;
+
+        virErrorPreserveLast(&origerr);
+        while (nacquired > 0) {
+            nacquired--;
+            if (virLockSpaceReleaseResource(acquired[nacquired],
+                                            args->resources.resources_val[nacquired].name,
+                                            priv->ownerPid) < 0)
+                VIR_WARN("Unable to release resource %s",
+                         args->resources.resources_val[nacquired].name);
+        }
+        virErrorRestore(&origerr);
+
         virNetMessageSaveError(rerr);
+    }
     virMutexUnlock(&priv->lock);
     return rv;
 }
@@ -344,6 +426,78 @@ virLockSpaceProtocolDispatchReleaseResource(virNetServerPtr server G_GNUC_UNUSED
     return rv;
 }
 
+/*
+ * Releases all resources of a domain in one round trip. All of them
+ * are released even if some fail, the first error is reported.
+ */
+static int
+virLockSpaceProtocolDispatchReleaseResources(virNetServerPtr server G_GNUC_UNUSED,
+                                             virNetServerClientPtr client,
+                                             virNetMessagePtr msg G_GNUC_UNUSED,
+                                             virNetMessageErrorPtr rerr,
+                                             virLockSpaceProtocolReleaseResourcesArgs *args)
+{
+    int rv = -1;
+    unsigned int flags = args->flags;
+    virLockDaemonClientPtr priv =
+        virNetServerClientGetPrivateData(client);
+    virErrorPtr firsterr = NULL;
+    size_t i;
+
+    virMutexLock(&priv->lock);
+
+    virCheckFlagsGoto(0, cleanup);
+
+    if (priv->restricted) {
+        virReportError(VIR_ERR_OPERATION_DENIED, "%s",
+                       _("lock manager connection has been restricted"));
+        goto cleanup;
+    }
+
+    if (!priv->ownerId) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("lock owner details have not been registered"));
+        goto cleanup;
+    }
+
+    for (i = 0; i < args->resources.resources_len; i++) {
+        virLockSpaceProtocolReleaseResourceArgs *res =
+            &args->resources.resources_val[i];
+        virLockSpacePtr lockspace;
+
+        if (res->flags != 0) {
+            virReportError(VIR_ERR_INVALID_ARG,
+                           _("unsupported flags (0x%x) for resource %s"),
+                           res->flags, res->name);
+        } else if (!(lockspace = virLockDaemonFindLockSpace(lockDaemon, res->path))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Lockspace for path %s does not exist"),
+                           res->path);
+        } else if (virLockSpaceReleaseResource(lockspace,
+                                               res->name,
+                                               priv->ownerPid) == 0) {
+            continue;
+        }
+
+        if (!firsterr)
+            virErrorPreserveLast(&firsterr);
+    }
+
+    if (firsterr) {
+        virErrorRestore(&firsterr);
+        goto cleanup;
+    }
+
+    rv = 0;
+
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    virMutexUnlock(&priv->lock);
+    return rv;
+}
+
+
 
 static int
 virLockSpaceProtocolDispatchRestrict(virNetServerPtr server G_GNUC_UNUSED,
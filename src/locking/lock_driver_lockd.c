@@ -597,6 +597,56 @@ static int virLockManagerLockDaemonAddResource(virLockManagerPtr lock,
 }
 
 
+/*
+ * Acquires all resources in a single call. Returns 0 on success, -1
+ * on error, or -2 if the daemon doesn't know the call yet, in which
+ * case the resources have to be acquired one by one.
+ */
+static int
+virLockManagerLockDaemonAcquireAll(virLockManagerPtr lock,
+                                   virNetClientPtr client,
+                                   virNetClientProgramPtr program,
+                                   int *counter)
+{
+    virLockManagerLockDaemonPrivatePtr priv = lock->privateData;
+    virLockSpaceProtocolAcquireResourcesArgs args;
+    g_autofree virLockSpaceProtocolAcquireResourceArgs *resources = NULL;
+    size_t i;
+
+    memset(&args, 0, sizeof(args));
+
+    resources = g_new0(virLockSpaceProtocolAcquireResourceArgs, priv->nresources);
+    for (i = 0; i < priv->nresources; i++) {
+        resources[i].path = priv->resources[i].lockspace;
+        resources[i].name = priv->resources[i].name;
+        resources[i].flags = priv->resources[i].flags;
+    }
+    args.resources.resources_len = priv->nresources;
+    args.resources.resources_val = resources;
+
+    if (virNetClientProgramCall(program,
+                                client,
+                                (*counter)++,
+                                VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCES,
+                                0, NULL, NULL, NULL,
+                                (xdrproc_t)xdr_virLockSpaceProtocolAcquireResourcesArgs, &args,
+                                (xdrproc_t)xdr_void, NULL) < 0) {
+        /* Daemons predating the call report an unknown procedure,
+         * anything about the resources themselves has another code.
+         * Since the call is all or nothing, retrying is safe. */
+        if (virGetLastErrorCode() == VIR_ERR_RPC) {
+            VIR_DEBUG("Batched acquire failed, falling back: %s",
+                      virGetLastErrorMessage());
+            virResetLastError();
+            return -2;
+        }
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int virLockManagerLockDaemonAcquire(virLockManagerPtr lock,
                                            const char *state G_GNUC_UNUSED,
                                            unsigned int flags,
@@ -628,8 +678,15 @@ static int virLockManagerLockDaemonAcquire(virLockManagerPtr lock,
         goto cleanup;
 
     if (!(flags & VIR_LOCK_MANAGER_ACQUIRE_REGISTER_ONLY)) {
+        int rc = -2;
         size_t i;
-        for (i = 0; i < priv->nresources; i++) {
+
+        if (priv->nresources > 1 &&
+            (rc = virLockManagerLockDaemonAcquireAll(lock, client,
+                                                     program, &counter)) == -1)
+            goto cleanup;
+
+        for (i = 0; rc == -2 && i < priv->nresources; i++) {
             virLockSpaceProtocolAcquireResourceArgs args;
 
             memset(&args, 0, sizeof(args));
@@ -665,6 +722,56 @@ static int virLockManagerLockDaemonAcquire(virLockManagerPtr lock,
     return rv;
 }
 
+/*
+ * Releases all resources in a single call. Returns 0 on success, -1
+ * on error, or -2 if the daemon doesn't know the call yet, in which
+ * case the resources have to be released one by one.
+ */
+static int
+virLockManagerLockDaemonReleaseAll(virLockManagerPtr lock,
+                                   virNetClientPtr client,
+                                   virNetClientProgramPtr program,
+                                   int *counter)
+{
+    virLockManagerLockDaemonPrivatePtr priv = lock->privateData;
+    virLockSpaceProtocolReleaseResourcesArgs args;
+    g_autofree virLockSpaceProtocolReleaseResourceArgs *resources = NULL;
+    size_t i;
+
+    memset(&args, 0, sizeof(args));
+
+    resources = g_new0(virLockSpaceProtocolReleaseResourceArgs, priv->nresources);
+    for (i = 0; i < priv->nresources; i++) {
+        resources[i].path = priv->resources[i].lockspace;
+        resources[i].name = priv->resources[i].name;
+        resources[i].flags = priv->resources[i].flags &
+            ~(VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED |
+              VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE);
+    }
+    args.resources.resources_len = priv->nresources;
+    args.resources.resources_val = resources;
+
+    if (virNetClientProgramCall(program,
+                                client,
+                                (*counter)++,
+                                VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCES,
+                                0, NULL, NULL, NULL,
+                                (xdrproc_t)xdr_virLockSpaceProtocolReleaseResourcesArgs, &args,
+                                (xdrproc_t)xdr_void, NULL) < 0) {
+        /* See virLockManagerLockDaemonAcquireAll */
+        if (virGetLastErrorCode() == VIR_ERR_RPC) {
+            VIR_DEBUG("Batched release failed, falling back: %s",
+                      virGetLastErrorMessage());
+            virResetLastError();
+            return -2;
+        }
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int virLockManagerLockDaemonRelease(virLockManagerPtr lock,
                                            char **state,
                                            unsigned int flags)
@@ -673,6 +780,7 @@ static int virLockManagerLockDaemonRelease(virLockManagerPtr lock,
     virNetClientProgramPtr program = NULL;
     int counter = 0;
     int rv = -1;
+    int rc = -2;
     size_t i;
     virLockManagerLockDaemonPrivatePtr priv = lock->privateData;
 
@@ -684,7 +792,12 @@ static int virLockManagerLockDaemonRelease(virLockManagerPtr lock,
     if (!(client = virLockManagerLockDaemonConnect(lock, &program, &counter)))
         goto cleanup;
 
-    for (i = 0; i < priv->nresources; i++) {
+    if (priv->nresources > 1 &&
+        (rc = virLockManagerLockDaemonReleaseAll(lock, client,
+                                                 program, &counter)) == -1)
+        goto cleanup;
+
+    for (i = 0; rc == -2 && i < priv->nresources; i++) {
         virLockSpaceProtocolReleaseResourceArgs args;
 
         memset(&args, 0, sizeof(args));
@@ -58,6 +58,12 @@ VIR_LOG_INIT("locking.lock_driver_sanlock");
 # define SANLK_RES_SHARED    0x4
 #endif
 
+/* Joining a lockspace in the background is only useful if there's a
+ * way to wait for it to complete later */
+#if defined(SANLK_ADD_ASYNC) && defined(HAVE_SANLOCK_INQ_LOCKSPACE)
+# define VIR_LOCK_MANAGER_SANLOCK_ASYNC_JOIN 1
+#endif
+
 typedef struct _virLockManagerSanlockDriver virLockManagerSanlockDriver;
 typedef virLockManagerSanlockDriver *virLockManagerSanlockDriverPtr;
 
@@ -74,6 +80,12 @@ struct _virLockManagerSanlockDriver {
     /* under which permissions does sanlock run */
     uid_t user;
     gid_t group;
+
+#ifdef VIR_LOCK_MANAGER_SANLOCK_ASYNC_JOIN
+    /* the automatic disk lease lockspace, while being joined */
+    struct sanlk_lockspace lockspace;
+    int lockspacePending;
+#endif
 };
 
 static virLockManagerSanlockDriverPtr sanlockDriver;
@@ -200,6 +212,126 @@ virLockManagerSanlockInitLockspace(virLockManagerSanlockDriverPtr driver,
 /* How many times try adding a lockspace? */
 #define LOCKSPACE_RETRIES 10
 
+/*
+ * Try to register the lockspace with the daemon.  If the lockspace is
+ * already registered, we should get EEXIST back in which case we can
+ * just carry on with life. If EINPROGRESS is returned, we have two
+ * options: either call a sanlock API that blocks us until lockspace
+ * changes state, or we can fallback to polling.
+ *
+ * With @async, sanlock is only asked to start joining the lockspace
+ * and this returns right away, see virLockManagerSanlockWaitLockspace.
+ */
+static int
+virLockManagerSanlockAddLockspace(virLockManagerSanlockDriverPtr driver,
+                                  struct sanlk_lockspace *ls,
+                                  bool async)
+{
+    const char *path = ls->host_id_disk.path;
+    uint32_t flags = 0;
+    int retries = LOCKSPACE_RETRIES;
+    int rv;
+
+#ifdef VIR_LOCK_MANAGER_SANLOCK_ASYNC_JOIN
+    if (async)
+        flags |= SANLK_ADD_ASYNC;
+#endif
+
+ retry:
+#ifdef HAVE_SANLOCK_IO_TIMEOUT
+    rv = sanlock_add_lockspace_timeout(ls, flags, driver->io_timeout);
+#else
+    if (driver->io_timeout) {
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
+                       _("unable to use io_timeout with this version of sanlock"));
+        return -1;
+    }
+    rv = sanlock_add_lockspace(ls, flags);
+#endif
+    if (rv < 0) {
+        if (-rv == EINPROGRESS && async) {
+            VIR_DEBUG("Lockspace %s is already being joined", path);
+            return 0;
+        }
+        if (-rv == EINPROGRESS && --retries) {
+#ifdef HAVE_SANLOCK_INQ_LOCKSPACE
+            /* we have this function which blocks until lockspace change the
+             * state. It returns 0 if lockspace has been added, -ENOENT if it
+             * hasn't. */
+            VIR_DEBUG("Inquiring lockspace");
+            if (sanlock_inq_lockspace(ls, SANLK_INQ_WAIT) < 0)
+                VIR_DEBUG("Unable to inquire lockspace");
+#else
+            /* fall back to polling */
+            VIR_DEBUG("Sleeping for %dms", LOCKSPACE_SLEEP);
+            g_usleep(LOCKSPACE_SLEEP * 1000);
+#endif
+            VIR_DEBUG("Retrying to add lockspace (left %d)", retries);
+            goto retry;
+        }
+        if (-rv != EEXIST) {
+            char *err = NULL;
+            if (virLockManagerSanlockError(rv, &err)) {
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("Unable to add lockspace %s: %s"),
+                               path, NULLSTR(err));
+                VIR_FREE(err);
+            } else {
+                virReportSystemError(-rv,
+                                     _("Unable to add lockspace %s"),
+                                     path);
+            }
+            return -1;
+        } else {
+            VIR_DEBUG("Lockspace %s is already registered", path);
+        }
+    } else if (async) {
+        VIR_DEBUG("Lockspace %s is being joined", path);
+    } else {
+        VIR_DEBUG("Lockspace %s has been registered", path);
+    }
+
+    return 0;
+}
+
+
+#ifdef VIR_LOCK_MANAGER_SANLOCK_ASYNC_JOIN
+/*
+ * Wait for the asynchronous join of the automatic disk lease lockspace
+ * started at initialization, leases in it can't be acquired before.
+ */
+static int
+virLockManagerSanlockWaitLockspace(virLockManagerSanlockDriverPtr driver)
+{
+    struct sanlk_lockspace ls;
+
+    if (!g_atomic_int_get(&driver->lockspacePending))
+        return 0;
+
+    ls = driver->lockspace;
+
+    VIR_DEBUG("Waiting for lockspace %s to be joined", ls.host_id_disk.path);
+    if (sanlock_inq_lockspace(&ls, SANLK_INQ_WAIT) < 0) {
+        /* Joining has failed in the background, retry synchronously
+         * so that the reason gets reported */
+        VIR_DEBUG("Lockspace %s was not joined, adding it again",
+                  ls.host_id_disk.path);
+        if (virLockManagerSanlockAddLockspace(driver, &ls, false) < 0)
+            return -1;
+    }
+
+    g_atomic_int_set(&driver->lockspacePending, 0);
+    return 0;
+}
+#else /* !VIR_LOCK_MANAGER_SANLOCK_ASYNC_JOIN */
+static int
+virLockManagerSanlockWaitLockspace(virLockManagerSanlockDriverPtr driver G_GNUC_UNUSED)
+{
+    return 0;
+}
+#endif /* !VIR_LOCK_MANAGER_SANLOCK_ASYNC_JOIN */
+
+
 static int
 virLockManagerSanlockSetupLockspace(virLockManagerSanlockDriverPtr driver)
 {
@@ -209,7 +341,6 @@ virLockManagerSanlockSetupLockspace(virLockManagerSanlockDriverPtr driver)
     struct sanlk_lockspace ls;
     char *path = NULL;
     char *dir = NULL;
-    int retries = LOCKSPACE_RETRIES;
 
     path = g_strdup_printf("%s/%s", driver->autoDiskLeasePath,
                            VIR_LOCK_MANAGER_SANLOCK_AUTO_DISK_LOCKSPACE);
@@ -342,59 +473,19 @@ virLockManagerSanlockSetupLockspace(virLockManagerSanlockDriverPtr driver)
     }
 
     ls.host_id = driver->hostID;
-    /* Stage 2: Try to register the lockspace with the daemon.  If the lockspace
-     * is already registered, we should get EEXIST back in which case we can
-     * just carry on with life. If EINPROGRESS is returned, we have two options:
-     * either call a sanlock API that blocks us until lockspace changes state,
-     * or we can fallback to polling.
+    /* Stage 2: Register the lockspace with the daemon. Joining it takes at
+     * least a couple of io_timeout periods, so if sanlock allows, don't
+     * wait for it here but only once a lease in it is acquired.
      */
- retry:
-#ifdef HAVE_SANLOCK_IO_TIMEOUT
-    rv = sanlock_add_lockspace_timeout(&ls, 0, driver->io_timeout);
-#else
-    if (driver->io_timeout) {
-        virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
-                       _("unable to use io_timeout with this version of sanlock"));
+#ifdef VIR_LOCK_MANAGER_SANLOCK_ASYNC_JOIN
+    if (virLockManagerSanlockAddLockspace(driver, &ls, true) < 0)
         goto error;
-    }
-    rv = sanlock_add_lockspace(&ls, 0);
-#endif
-    if (rv < 0) {
-        if (-rv == EINPROGRESS && --retries) {
-#ifdef HAVE_SANLOCK_INQ_LOCKSPACE
-            /* we have this function which blocks until lockspace change the
-             * state. It returns 0 if lockspace has been added, -ENOENT if it
-             * hasn't. */
-            VIR_DEBUG("Inquiring lockspace");
-            if (sanlock_inq_lockspace(&ls, SANLK_INQ_WAIT) < 0)
-                VIR_DEBUG("Unable to inquire lockspace");
+    driver->lockspace = ls;
+    g_atomic_int_set(&driver->lockspacePending, 1);
 #else
-            /* fall back to polling */
-            VIR_DEBUG("Sleeping for %dms", LOCKSPACE_SLEEP);
-            g_usleep(LOCKSPACE_SLEEP * 1000);
+    if (virLockManagerSanlockAddLockspace(driver, &ls, false) < 0)
+        goto error;
 #endif
-            VIR_DEBUG("Retrying to add lockspace (left %d)", retries);
-            goto retry;
-        }
-        if (-rv != EEXIST) {
-            char *err = NULL;
-            if (virLockManagerSanlockError(rv, &err)) {
-                virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("Unable to add lockspace %s: %s"),
-                               path, NULLSTR(err));
-                VIR_FREE(err);
-            } else {
-                virReportSystemError(-rv,
-                                     _("Unable to add lockspace %s"),
-                                     path);
-            }
-            goto error;
-        } else {
-            VIR_DEBUG("Lockspace %s is already registered", path);
-        }
-    } else {
-        VIR_DEBUG("Lockspace %s has been registered", path);
-    }
 
     VIR_FREE(path);
     VIR_FREE(dir);
@@ -1010,6 +1101,11 @@ static int virLockManagerSanlockAcquire(virLockManagerPtr lock,
     }
 
     if (!(flags & VIR_LOCK_MANAGER_ACQUIRE_REGISTER_ONLY)) {
+        if (driver->autoDiskLease &&
+            priv->res_count > 0 &&
+            virLockManagerSanlockWaitLockspace(driver) < 0)
+            goto error;
+
         VIR_DEBUG("Acquiring object %u", priv->res_count);
         if ((rv = sanlock_acquire(sock, priv->vm_pid, 0,
                                   priv->res_count, priv->res_args,
@@ -15,6 +15,9 @@ const VIR_LOCK_SPACE_PROTOCOL_STRING_MAX = 65536;
 /* A long string, which may NOT be NULL. */
 typedef string virLockSpaceProtocolNonNullString<VIR_LOCK_SPACE_PROTOCOL_STRING_MAX>;
 
+/* Upper limit on number of resources acquired in one call */
+const VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX = 4096;
+
 /* A long string, which may be NULL. */
 typedef virLockSpaceProtocolNonNullString *virLockSpaceProtocolString;
 
@@ -67,6 +70,16 @@ struct virLockSpaceProtocolCreateLockSpaceArgs {
     virLockSpaceProtocolNonNullString path;
 };
 
+struct virLockSpaceProtocolAcquireResourcesArgs {
+    virLockSpaceProtocolAcquireResourceArgs resources<VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX>;
+    unsigned int flags;
+};
+
+struct virLockSpaceProtocolReleaseResourcesArgs {
+    virLockSpaceProtocolReleaseResourceArgs resources<VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX>;
+    unsigned int flags;
+};
+
 
 /* Define the program number, protocol version and procedure numbers here. */
 const VIR_LOCK_SPACE_PROTOCOL_PROGRAM = 0xEA7BEEF;
@@ -145,5 +158,17 @@ enum virLockSpaceProtocolProcedure {
      * @generate: none
      * @acl: none
      */
-    VIR_LOCK_SPACE_PROTOCOL_PROC_CREATE_LOCKSPACE = 8
+    VIR_LOCK_SPACE_PROTOCOL_PROC_CREATE_LOCKSPACE = 8,
+
+    /**
+     * @generate: none
+     * @acl: none
+     */
+    VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCES = 9,
+
+    /**
+     * @generate: none
+     * @acl: none
+     */
+    VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCES = 10
 };
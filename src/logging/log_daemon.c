@@ -190,6 +190,7 @@ virLogDaemonNew(virLogDaemonConfigPtr config, bool privileged)
     if (!(logd->handler = virLogHandlerNew(privileged,
                                            config->max_size,
                                            config->max_backups,
+                                           config->backup_compression,
                                            virLogDaemonInhibitor,
                                            logd)))
         goto error;
@@ -282,6 +283,7 @@ virLogDaemonNewPostExecRestart(virJSONValuePtr object, bool privileged,
                                                           privileged,
                                                           config->max_size,
                                                           config->max_backups,
+                                                          config->backup_compression,
                                                           virLogDaemonInhibitor,
                                                           logd)))
         goto error;
@@ -647,7 +649,6 @@ virLogDaemonPostExecRestart(const char *state_file,
     const char *gotmagic;
     char *wantmagic = NULL;
     int ret = -1;
-    char *state = NULL;
     virJSONValuePtr object = NULL;
 
     VIR_DEBUG("Running post-restart exec");
@@ -659,14 +660,9 @@ virLogDaemonPostExecRestart(const char *state_file,
         goto cleanup;
     }
 
-    if (virFileReadAll(state_file,
-                       1024 * 1024 * 10, /* 10 MB */
-                       &state) < 0)
-        goto cleanup;
-
-    VIR_DEBUG("Loading state %s", state);
+    VIR_DEBUG("Loading state %s", state_file);
 
-    if (!(object = virJSONValueFromString(state)))
+    if (!(object = virJSONValueFromFile(state_file)))
         goto cleanup;
 
     gotmagic = virJSONValueObjectGetString(object, "magic");
@@ -701,7 +697,6 @@ virLogDaemonPostExecRestart(const char *state_file,
  cleanup:
     unlink(state_file);
     VIR_FREE(wantmagic);
-    VIR_FREE(state);
     virJSONValueFree(object);
     return ret;
 }
@@ -713,7 +708,6 @@ virLogDaemonPreExecRestart(const char *state_file,
                            char **argv)
 {
     virJSONValuePtr child;
-    char *state = NULL;
     int ret = -1;
     virJSONValuePtr object = virJSONValueNewObject();
     char *magic;
@@ -746,18 +740,10 @@ virLogDaemonPreExecRestart(const char *state_file,
     }
 
 
-    if (!(state = virJSONValueToString(object, true)))
-        goto cleanup;
+    VIR_DEBUG("Saving state %s", state_file);
 
-    VIR_DEBUG("Saving state %s", state);
-
-    if (virFileWriteStr(state_file,
-                        state, 0700) < 0) {
-        virReportSystemError(errno,
-                             _("Unable to save state file %s"),
-                             state_file);
+    if (virJSONValueToFile(object, state_file, 0700, false) < 0)
         goto cleanup;
-    }
 
     if (execvp(argv[0], argv) < 0) {
         virReportSystemError(errno, "%s",
@@ -769,7 +755,6 @@ virLogDaemonPreExecRestart(const char *state_file,
 
  cleanup:
     VIR_FREE(pairs);
-    VIR_FREE(state);
     virJSONValueFree(object);
     return ret;
 }
@@ -28,6 +28,7 @@
 #include "virlog.h"
 #include "rpc/virnetserver.h"
 #include "configmake.h"
+#include "virrotatingfile.h"
 #include "virstring.h"
 #include "virutil.h"
 
@@ -85,6 +86,8 @@ static int
 virLogDaemonConfigLoadOptions(virLogDaemonConfigPtr data,
                               virConfPtr conf)
 {
+    g_autofree char *compression = NULL;
+
     if (virConfGetValueUInt(conf, "log_level", &data->log_level) < 0)
         return -1;
     if (virConfGetValueString(conf, "log_filters", &data->log_filters) < 0)
@@ -100,6 +103,15 @@ virLogDaemonConfigLoadOptions(virLogDaemonConfigPtr data,
     if (virConfGetValueSizeT(conf, "max_backups", &data->max_backups) < 0)
         return -1;
 
+    if (virConfGetValueString(conf, "backup_compression", &compression) < 0)
+        return -1;
+    if (compression &&
+        (data->backup_compression = virRotatingFileCompressTypeFromString(compression)) < 0) {
+        virReportError(VIR_ERR_CONF_SYNTAX,
+                       _("Unknown backup_compression '%s'"), compression);
+        return -1;
+    }
+
     return 0;
 }
 
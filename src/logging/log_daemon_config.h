@@ -35,6 +35,7 @@ struct _virLogDaemonConfig {
 
     size_t max_backups;
     size_t max_size;
+    int backup_compression; /* virRotatingFileCompress */
 };
 
 
@@ -43,6 +43,10 @@ VIR_LOG_INIT("logging.log_handler");
 
 #define DEFAULT_MODE 0600
 
+/* Size of the chunks console output is read from the pipe and written
+ * to the log file in */
+#define VIR_LOG_HANDLER_BUF_SIZE (64 * 1024)
+
 typedef struct _virLogHandlerLogFile virLogHandlerLogFile;
 typedef virLogHandlerLogFile *virLogHandlerLogFilePtr;
 
@@ -63,6 +67,7 @@ struct _virLogHandler {
     bool privileged;
     size_t max_size;
     size_t max_backups;
+    int backup_compression; /* virRotatingFileCompress */
 
     virLogHandlerLogFilePtr *files;
     size_t nfiles;
@@ -135,6 +140,56 @@ virLogHandlerGetLogFileFromWatch(virLogHandlerPtr handler,
 }
 
 
+/*
+ * Reads whatever is available from @fd into @buf, up to @buflen bytes,
+ * so that a chatty console is written to the log file in large chunks
+ * rather than one write per small read. The first read may block, the
+ * following ones are only done as long as there's more data queued in
+ * the pipe.
+ *
+ * Returns the number of bytes read, or -1 on error with errno set.
+ */
+static ssize_t
+virLogHandlerDomainLogFileRead(int fd,
+                               char *buf,
+                               size_t buflen)
+{
+    size_t got = 0;
+
+    while (got < buflen) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        ssize_t len;
+        int rc;
+
+        if (got > 0) {
+            if ((rc = poll(&pfd, 1, 0)) < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+
+            if (rc == 0 || !(pfd.revents & POLLIN))
+                break;
+        }
+
+        if ((len = read(fd, buf + got, buflen - got)) < 0) {
+            if (errno == EINTR)
+                continue;
+            if (got > 0)
+                break;
+            return -1;
+        }
+
+        if (len == 0)
+            break;
+
+        got += len;
+    }
+
+    return got;
+}
+
+
 static void
 virLogHandlerDomainLogFileEvent(int watch,
                                 int fd,
@@ -143,7 +198,7 @@ virLogHandlerDomainLogFileEvent(int watch,
 {
     virLogHandlerPtr handler = opaque;
     virLogHandlerLogFilePtr logfile;
-    char buf[1024];
+    g_autofree char *buf = NULL;
     ssize_t len;
 
     virObjectLock(handler);
@@ -159,12 +214,10 @@ virLogHandlerDomainLogFileEvent(int watch,
         goto cleanup;
     }
 
- reread:
-    len = read(fd, buf, sizeof(buf));
-    if (len < 0) {
-        if (errno == EINTR)
-            goto reread;
+    buf = g_new(char, VIR_LOG_HANDLER_BUF_SIZE);
 
+    len = virLogHandlerDomainLogFileRead(fd, buf, VIR_LOG_HANDLER_BUF_SIZE);
+    if (len < 0) {
         virReportSystemError(errno, "%s",
                              _("Unable to read from log pipe"));
         goto error;
@@ -191,6 +244,7 @@ virLogHandlerPtr
 virLogHandlerNew(bool privileged,
                  size_t max_size,
                  size_t max_backups,
+                 int backup_compression,
                  virLogHandlerShutdownInhibitor inhibitor,
                  void *opaque)
 {
@@ -205,6 +259,7 @@ virLogHandlerNew(bool privileged,
     handler->privileged = privileged;
     handler->max_size = max_size;
     handler->max_backups = max_backups;
+    handler->backup_compression = backup_compression;
     handler->inhibitor = inhibitor;
     handler->opaque = opaque;
 
@@ -263,6 +318,7 @@ virLogHandlerLogFilePostExecRestart(virLogHandlerPtr handler,
                                                false,
                                                DEFAULT_MODE)) == NULL)
         goto error;
+    virRotatingFileWriterSetCompress(file->file, handler->backup_compression);
 
     if (virJSONValueObjectGetNumberInt(object, "pipefd", &file->pipefd) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -289,6 +345,7 @@ virLogHandlerNewPostExecRestart(virJSONValuePtr object,
                                 bool privileged,
                                 size_t max_size,
                                 size_t max_backups,
+                                int backup_compression,
                                 virLogHandlerShutdownInhibitor inhibitor,
                                 void *opaque)
 {
@@ -299,6 +356,7 @@ virLogHandlerNewPostExecRestart(virJSONValuePtr object,
     if (!(handler = virLogHandlerNew(privileged,
                                      max_size,
                                      max_backups,
+                                     backup_compression,
                                      inhibitor,
                                      opaque)))
         return NULL;
@@ -405,6 +463,7 @@ virLogHandlerDomainOpenLogFile(virLogHandlerPtr handler,
                                                trunc,
                                                DEFAULT_MODE)) == NULL)
         goto error;
+    virRotatingFileWriterSetCompress(file->file, handler->backup_compression);
 
     if (VIR_APPEND_ELEMENT_COPY(handler->files, handler->nfiles, file) < 0)
         goto error;
@@ -437,7 +496,7 @@ virLogHandlerDomainOpenLogFile(virLogHandlerPtr handler,
 static void
 virLogHandlerDomainLogFileDrain(virLogHandlerLogFilePtr file)
 {
-    char buf[1024];
+    g_autofree char *buf = g_new(char, VIR_LOG_HANDLER_BUF_SIZE);
     ssize_t len;
     struct pollfd pfd;
     int ret;
@@ -458,13 +517,11 @@ virLogHandlerDomainLogFileDrain(virLogHandlerLogFilePtr file)
         if (ret == 0)
             return;
 
-        len = read(file->pipefd, buf, sizeof(buf));
+        len = virLogHandlerDomainLogFileRead(file->pipefd, buf,
+                                             VIR_LOG_HANDLER_BUF_SIZE);
         file->drained = true;
-        if (len < 0) {
-            if (errno == EINTR)
-                continue;
+        if (len <= 0)
             return;
-        }
 
         if (virRotatingFileWriterAppend(file->file, buf, len) != len)
             return;
@@ -591,6 +648,7 @@ virLogHandlerDomainAppendLogFile(virLogHandlerPtr handler,
                                                    false,
                                                    DEFAULT_MODE)))
             goto cleanup;
+        virRotatingFileWriterSetCompress(newwriter, handler->backup_compression);
 
         writer = newwriter;
     }
@@ -33,12 +33,14 @@ typedef void (*virLogHandlerShutdownInhibitor)(bool inhibit,
 virLogHandlerPtr virLogHandlerNew(bool privileged,
                                   size_t max_size,
                                   size_t max_backups,
+                                  int backup_compression,
                                   virLogHandlerShutdownInhibitor inhibitor,
                                   void *opaque);
 virLogHandlerPtr virLogHandlerNewPostExecRestart(virJSONValuePtr child,
                                                  bool privileged,
                                                  size_t max_size,
                                                  size_t max_backups,
+                                                 int backup_compression,
                                                  virLogHandlerShutdownInhibitor inhibitor,
                                                  void *opaque);
 
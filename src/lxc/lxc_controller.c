@@ -71,6 +71,21 @@
 
 VIR_LOG_INIT("lxc.lxc_controller");
 
+/* Console data read from one side and not written to the other one
+ * yet. The buffer starts small and grows up to VIR_LXC_CONSOLE_BUF_MAX
+ * if the console is chatty. */
+#define VIR_LXC_CONSOLE_BUF_MIN 1024
+#define VIR_LXC_CONSOLE_BUF_MAX (64 * 1024)
+
+typedef struct _virLXCControllerConsoleBuf virLXCControllerConsoleBuf;
+typedef virLXCControllerConsoleBuf *virLXCControllerConsoleBufPtr;
+struct _virLXCControllerConsoleBuf {
+    char *data;
+    size_t size;
+    size_t off;  /* offset of the first byte not written yet */
+    size_t len;
+};
+
 typedef struct _virLXCControllerConsole virLXCControllerConsole;
 typedef virLXCControllerConsole *virLXCControllerConsolePtr;
 struct _virLXCControllerConsole {
@@ -87,10 +102,8 @@ struct _virLXCControllerConsole {
     int epollWatch;
     int epollFd; /* epoll FD for dealing with EOF */
 
-    size_t fromHostLen;
-    char fromHostBuf[1024];
-    size_t fromContLen;
-    char fromContBuf[1024];
+    virLXCControllerConsoleBuf fromHost;
+    virLXCControllerConsoleBuf fromCont;
 
     virNetDaemonPtr daemon;
 };
@@ -266,6 +279,9 @@ static void virLXCControllerConsoleClose(virLXCControllerConsolePtr console)
     if (console->epollWatch != -1)
         virEventRemoveHandle(console->epollWatch);
     VIR_FORCE_CLOSE(console->epollFd);
+
+    VIR_FREE(console->fromHost.data);
+    VIR_FREE(console->fromCont.data);
 }
 
 
@@ -1067,17 +1083,17 @@ static void virLXCControllerConsoleUpdateWatch(virLXCControllerConsolePtr consol
 
     /* If host console is open, then we can look to read/write */
     if (!console->hostClosed) {
-        if (console->fromHostLen < sizeof(console->fromHostBuf))
+        if (console->fromHost.len < VIR_LXC_CONSOLE_BUF_MAX)
             hostEvents |= VIR_EVENT_HANDLE_READABLE;
-        if (console->fromContLen)
+        if (console->fromCont.len)
             hostEvents |= VIR_EVENT_HANDLE_WRITABLE;
     }
 
     /* If cont console is open, then we can look to read/write */
     if (!console->contClosed) {
-        if (console->fromContLen < sizeof(console->fromContBuf))
+        if (console->fromCont.len < VIR_LXC_CONSOLE_BUF_MAX)
             contEvents |= VIR_EVENT_HANDLE_READABLE;
-        if (console->fromHostLen)
+        if (console->fromHost.len)
             contEvents |= VIR_EVENT_HANDLE_WRITABLE;
     }
 
@@ -1090,7 +1106,7 @@ static void virLXCControllerConsoleUpdateWatch(virLXCControllerConsolePtr consol
     if (console->hostClosed) {
         /* Must setup an epoll to detect when host becomes accessible again */
         int events = EPOLLIN | EPOLLET;
-        if (console->fromContLen)
+        if (console->fromCont.len)
             events |= EPOLLOUT;
 
         if (events != console->hostEpoll) {
@@ -1128,7 +1144,7 @@ static void virLXCControllerConsoleUpdateWatch(virLXCControllerConsolePtr consol
     if (console->contClosed) {
         /* Must setup an epoll to detect when guest becomes accessible again */
         int events = EPOLLIN | EPOLLET;
-        if (console->fromHostLen)
+        if (console->fromHost.len)
             events |= EPOLLOUT;
 
         if (events != console->contEpoll) {
@@ -1172,8 +1188,8 @@ static void virLXCControllerConsoleEPoll(int watch, int fd, int events, void *op
     virMutexLock(&lock);
     VIR_DEBUG("IO event watch=%d fd=%d events=%d fromHost=%zu fromcont=%zu",
               watch, fd, events,
-              console->fromHostLen,
-              console->fromContLen);
+              console->fromHost.len,
+              console->fromCont.len);
 
     while (1) {
         struct epoll_event event;
@@ -1212,6 +1228,57 @@ static void virLXCControllerConsoleEPoll(int watch, int fd, int events, void *op
     virMutexUnlock(&lock);
 }
 
+/* Makes room for reading more data into @buf, returns the free space */
+static size_t
+virLXCControllerConsoleBufReserve(virLXCControllerConsoleBufPtr buf)
+{
+    if (buf->len == 0)
+        buf->off = 0;
+
+    if (buf->off + buf->len == buf->size) {
+        if (buf->off > 0) {
+            memmove(buf->data, buf->data + buf->off, buf->len);
+            buf->off = 0;
+        } else if (buf->size < VIR_LXC_CONSOLE_BUF_MAX) {
+            buf->size = buf->size ? buf->size * 2 : VIR_LXC_CONSOLE_BUF_MIN;
+            buf->data = g_realloc(buf->data, buf->size);
+        }
+    }
+
+    return buf->size - buf->off - buf->len;
+}
+
+
+/* Writes as much of @buf to @fd as possible without blocking */
+static int
+virLXCControllerConsoleBufFlush(virLXCControllerConsoleBufPtr buf,
+                                int fd)
+{
+    ssize_t done;
+
+    if (buf->len == 0)
+        return 0;
+
+ rewrite:
+    done = write(fd, buf->data + buf->off, buf->len);
+    if (done == -1 && errno == EINTR)
+        goto rewrite;
+    if (done == -1 && errno != EAGAIN) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to write to container pty"));
+        return -1;
+    }
+    if (done > 0) {
+        buf->off += done;
+        buf->len -= done;
+    } else {
+        VIR_DEBUG("Write fd %d done %d errno %d", fd, (int)done, errno);
+    }
+
+    return 0;
+}
+
+
 static void virLXCControllerConsoleIO(int watch, int fd, int events, void *opaque)
 {
     virLXCControllerConsolePtr console = opaque;
@@ -1219,24 +1286,26 @@ static void virLXCControllerConsoleIO(int watch, int fd, int events, void *opaqu
     virMutexLock(&lock);
     VIR_DEBUG("IO event watch=%d fd=%d events=%d fromHost=%zu fromcont=%zu",
               watch, fd, events,
-              console->fromHostLen,
-              console->fromContLen);
+              console->fromHost.len,
+              console->fromCont.len);
     if (events & VIR_EVENT_HANDLE_READABLE) {
-        char *buf;
-        size_t *len;
+        virLXCControllerConsoleBufPtr buf;
         size_t avail;
         ssize_t done;
+        int otherFd;
+        bool otherClosed;
         if (watch == console->hostWatch) {
-            buf = console->fromHostBuf;
-            len = &console->fromHostLen;
-            avail = sizeof(console->fromHostBuf) - *len;
+            buf = &console->fromHost;
+            otherFd = console->contFd;
+            otherClosed = console->contClosed;
         } else {
-            buf = console->fromContBuf;
-            len = &console->fromContLen;
-            avail = sizeof(console->fromContBuf) - *len;
+            buf = &console->fromCont;
+            otherFd = console->hostFd;
+            otherClosed = console->hostClosed;
         }
+        avail = virLXCControllerConsoleBufReserve(buf);
      reread:
-        done = read(fd, buf + *len, avail);
+        done = read(fd, buf->data + buf->off + buf->len, avail);
         if (done == -1 && errno == EINTR)
             goto reread;
         if (done == -1 && errno != EAGAIN) {
@@ -1245,39 +1314,27 @@ static void virLXCControllerConsoleIO(int watch, int fd, int events, void *opaqu
             goto error;
         }
         if (done > 0) {
-            *len += done;
+            buf->len += done;
+
+            /* Don't wait for another round of the event loop to pass
+             * the data on; the other side is most likely writable. */
+            if (!otherClosed &&
+                virLXCControllerConsoleBufFlush(buf, otherFd) < 0)
+                goto error;
         } else {
             VIR_DEBUG("Read fd %d done %d errno %d", fd, (int)done, errno);
         }
     }
 
     if (events & VIR_EVENT_HANDLE_WRITABLE) {
-        char *buf;
-        size_t *len;
-        ssize_t done;
-        if (watch == console->hostWatch) {
-            buf = console->fromContBuf;
-            len = &console->fromContLen;
-        } else {
-            buf = console->fromHostBuf;
-            len = &console->fromHostLen;
-        }
+        virLXCControllerConsoleBufPtr buf;
+        if (watch == console->hostWatch)
+            buf = &console->fromCont;
+        else
+            buf = &console->fromHost;
 
-     rewrite:
-        done = write(fd, buf, *len);
-        if (done == -1 && errno == EINTR)
-            goto rewrite;
-        if (done == -1 && errno != EAGAIN) {
-            virReportSystemError(errno, "%s",
-                                 _("Unable to write to container pty"));
+        if (virLXCControllerConsoleBufFlush(buf, fd) < 0)
             goto error;
-        }
-        if (done > 0) {
-            memmove(buf, buf + done, (*len - done));
-            *len -= done;
-        } else {
-            VIR_DEBUG("Write fd %d done %d errno %d", fd, (int)done, errno);
-        }
     }
 
     if (events & VIR_EVENT_HANDLE_HANGUP) {
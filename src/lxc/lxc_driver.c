@@ -1659,6 +1659,10 @@ lxcConnectSupportsFeature(virConnectPtr conn, int feature)
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_CHUNKS:
+    case VIR_DRV_FEATURE_REMOTE_COMPRESSION:
+    case VIR_DRV_FEATURE_REMOTE_PACKED_TYPED_PARAMS:
+    case VIR_DRV_FEATURE_MIGRATION_TUNNEL_STRIPES:
     case VIR_DRV_FEATURE_XML_MIGRATABLE:
     default:
         return 0;
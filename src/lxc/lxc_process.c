@@ -50,6 +50,7 @@
 #include "virstring.h"
 #include "virprocess.h"
 #include "virsystemd.h"
+#include "virthread.h"
 #include "netdev_bandwidth_conf.h"
 #include "virutil.h"
 
@@ -1179,6 +1180,24 @@ virLXCProcessEnsureRootFS(virDomainObjPtr vm)
  *
  * Returns 0 on success or -1 in case of error
  */
+/* Logs how long the phase of the startup of @vm which ended just now
+ * took and starts timing the next one */
+static void
+virLXCProcessStartPhaseDone(virDomainObjPtr vm,
+                            const char *phase,
+                            unsigned long long *then)
+{
+    unsigned long long now;
+
+    if (virTimeMillisNow(&now) < 0)
+        return;
+
+    VIR_DEBUG("Container %s: %s took %llums",
+              vm->def->name, phase, now - *then);
+    *then = now;
+}
+
+
 int virLXCProcessStart(virConnectPtr conn,
                        virLXCDriverPtr  driver,
                        virDomainObjPtr vm,
@@ -1206,6 +1225,12 @@ int virLXCProcessStart(virConnectPtr conn,
     virCgroupPtr selfcgroup;
     int status;
     char *pidfile = NULL;
+    unsigned long long started = 0;
+    unsigned long long then = 0;
+
+    if (virTimeMillisNow(&started) < 0)
+        return -1;
+    then = started;
 
     if (virCgroupNewSelf(&selfcgroup) < 0)
         return -1;
@@ -1338,6 +1363,8 @@ int virLXCProcessStart(virConnectPtr conn,
                                       vm->def, NULL, false, false) < 0)
         goto cleanup;
 
+    virLXCProcessStartPhaseDone(vm, "preparing devices and labels", &then);
+
     VIR_DEBUG("Setting up consoles");
     for (i = 0; i < vm->def->nconsoles; i++) {
         char *ttyPath;
@@ -1363,6 +1390,8 @@ int virLXCProcessStart(virConnectPtr conn,
     if (virLXCProcessSetupNamespaces(driver, vm->def->namespaceData, nsInheritFDs) < 0)
         goto cleanup;
 
+    virLXCProcessStartPhaseDone(vm, "setting up consoles and interfaces", &then);
+
     VIR_DEBUG("Preparing to launch");
     if ((logfd = open(logfile, O_WRONLY | O_APPEND | O_CREAT,
              S_IRUSR|S_IWUSR)) < 0) {
@@ -1469,6 +1498,8 @@ int virLXCProcessStart(virConnectPtr conn,
     if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
         goto cleanup;
 
+    virLXCProcessStartPhaseDone(vm, "launching the controller", &then);
+
     /* Allow the child to exec the controller */
     if (virCommandHandshakeNotify(cmd) < 0)
         goto cleanup;
@@ -1487,6 +1518,8 @@ int virLXCProcessStart(virConnectPtr conn,
         goto cleanup;
     }
 
+    virLXCProcessStartPhaseDone(vm, "waiting for the container", &then);
+
     priv->machineName = virLXCDomainGetMachineName(vm->def, vm->pid);
     if (!priv->machineName)
         goto cleanup;
@@ -1520,6 +1553,8 @@ int virLXCProcessStart(virConnectPtr conn,
         goto cleanup;
     }
 
+    virLXCProcessStartPhaseDone(vm, "connecting to the monitor", &then);
+
     if (autoDestroy &&
         virCloseCallbacksSet(driver->closeCallbacks, vm,
                              conn, lxcProcessAutoDestroy) < 0)
@@ -1545,6 +1580,9 @@ int virLXCProcessStart(virConnectPtr conn,
             goto cleanup;
     }
 
+    VIR_INFO("Container %s started in %llums",
+             vm->def->name, then - started);
+
     rc = 0;
 
  cleanup:
@@ -1572,9 +1610,14 @@ int virLXCProcessStart(virConnectPtr conn,
     return rc;
 }
 
+/* Upper limit on the number of containers autostarted at once */
+#define VIR_LXC_PROCESS_AUTOSTART_WORKERS 8
+
 struct virLXCProcessAutostartData {
     virLXCDriverPtr driver;
     virConnectPtr conn;
+    virDomainObjPtr *vms;
+    size_t nvms;
 };
 
 static int
@@ -1608,6 +1651,25 @@ virLXCProcessAutostartDomain(virDomainObjPtr vm,
 }
 
 
+static void
+virLXCProcessAutostartOne(size_t idx,
+                          void *opaque)
+{
+    struct virLXCProcessAutostartData *data = opaque;
+
+    /* Errors are thread local and were logged already */
+    ignore_value(virLXCProcessAutostartDomain(data->vms[idx], data));
+    virResetLastError();
+}
+
+
+/*
+ * Starting a container means setting up its interfaces, labels and
+ * cgroups, spawning the controller and waiting for the container to
+ * come up. Most of that time is spent waiting for other processes, so
+ * containers are autostarted several at a time. Different containers
+ * are already started concurrently by API calls.
+ */
 void
 virLXCProcessAutostartAll(virLXCDriverPtr driver)
 {
@@ -1619,11 +1681,20 @@ virLXCProcessAutostartAll(virLXCDriverPtr driver)
     virConnectPtr conn = virConnectOpen("lxc:///system");
     /* Ignoring NULL conn which is mostly harmless here */
 
-    struct virLXCProcessAutostartData data = { driver, conn };
+    struct virLXCProcessAutostartData data = { driver, conn, NULL, 0 };
+
+    /* Collecting can only fail on allocation, which aborts anyway.
+     * Autostart is checked again with the domain locked before it is
+     * started. */
+    ignore_value(virDomainObjListCollect(driver->domains, NULL,
+                                         &data.vms, &data.nvms, NULL,
+                                         VIR_CONNECT_LIST_DOMAINS_AUTOSTART));
+
+    virThreadForEachParallel(data.nvms, VIR_LXC_PROCESS_AUTOSTART_WORKERS,
+                             "lxc-autostart", virLXCProcessAutostartOne,
+                             &data);
 
-    virDomainObjListForEach(driver->domains, false,
-                            virLXCProcessAutostartDomain,
-                            &data);
+    virObjectListFreeCount(data.vms, data.nvms);
 
     virObjectUnref(conn);
 }
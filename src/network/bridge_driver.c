@@ -60,13 +60,16 @@
 #include "virnetdevvportprofile.h"
 #include "virpci.h"
 #include "virdbus.h"
+#include "virevent.h"
 #include "virfile.h"
 #include "virstring.h"
 #include "viraccessapicheck.h"
 #include "network_event.h"
 #include "virhook.h"
 #include "virjson.h"
+#include "virlease.h"
 #include "virnetworkportdef.h"
+#include "virthread.h"
 #include "virutil.h"
 
 #include "netdev_bandwidth_conf.h"
@@ -278,6 +281,13 @@ networkReloadFirewallRules(virNetworkDriverStatePtr driver, bool startup);
 static void
 networkRefreshDaemons(virNetworkDriverStatePtr driver);
 
+static void
+networkMacMapSaveTimer(int timer,
+                       void *opaque);
+
+static void
+networkLeasesFree(void *opaque);
+
 static int
 networkPlugBandwidth(virNetworkObjPtr obj,
                      virMacAddrPtr mac,
@@ -426,6 +436,8 @@ networkRemoveInactive(virNetworkDriverStatePtr driver,
 {
     char *leasefile = NULL;
     char *customleasefile = NULL;
+    char *leasejournalfile = NULL;
+    char *leaseindexfile = NULL;
     char *radvdconfigfile = NULL;
     char *configfile = NULL;
     char *radvdpidbase = NULL;
@@ -448,6 +460,9 @@ networkRemoveInactive(virNetworkDriverStatePtr driver,
     if (!(customleasefile = networkDnsmasqLeaseFileNameCustom(driver, def->bridge)))
         goto cleanup;
 
+    leasejournalfile = virLeaseJournalFileName(customleasefile);
+    leaseindexfile = virLeaseIndexFileName(customleasefile);
+
     if (!(radvdconfigfile = networkRadvdConfigFileName(driver, def->name)))
         goto cleanup;
 
@@ -467,6 +482,11 @@ networkRemoveInactive(virNetworkDriverStatePtr driver,
     dnsmasqDelete(dctx);
     unlink(leasefile);
     unlink(customleasefile);
+    unlink(leasejournalfile);
+    unlink(leaseindexfile);
+    networkDriverLock(driver);
+    virHashRemoveEntry(driver->leases, customleasefile);
+    networkDriverUnlock(driver);
     unlink(configfile);
 
     /* MAC map manager */
@@ -488,6 +508,8 @@ networkRemoveInactive(virNetworkDriverStatePtr driver,
     VIR_FREE(leasefile);
     VIR_FREE(configfile);
     VIR_FREE(customleasefile);
+    VIR_FREE(leasejournalfile);
+    VIR_FREE(leaseindexfile);
     VIR_FREE(radvdconfigfile);
     VIR_FREE(radvdpidbase);
     VIR_FREE(statusfile);
@@ -655,6 +677,76 @@ networkAutostartConfig(virNetworkObjPtr obj,
 }
 
 
+/* Upper limit on the number of threads networkForEachParallel uses */
+#define NETWORK_PARALLEL_WORKERS_MAX 8
+
+typedef struct _networkParallelData networkParallelData;
+typedef networkParallelData *networkParallelDataPtr;
+struct _networkParallelData {
+    virNetworkObjListIterator callback;
+    void *opaque;
+    virNetworkObjPtr *objs;
+    size_t nobjs;
+};
+
+
+static int
+networkParallelCollect(virNetworkObjPtr obj,
+                       void *opaque)
+{
+    networkParallelDataPtr data = opaque;
+
+    virObjectRef(obj);
+    if (VIR_APPEND_ELEMENT_COPY(data->objs, data->nobjs, obj) < 0) {
+        virObjectUnref(obj);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static void
+networkParallelOne(size_t idx,
+                   void *opaque)
+{
+    networkParallelDataPtr data = opaque;
+
+    /* Like virNetworkObjListForEach, ignore the outcome. Errors
+     * are thread local and were logged already. */
+    ignore_value(data->callback(data->objs[idx], data->opaque));
+    virResetLastError();
+}
+
+
+/*
+ * Runs @callback for every network, like virNetworkObjListForEach,
+ * but for several networks at once. Starting a network involves
+ * spawning dnsmasq and radvd, waiting for them to daemonize and for
+ * DAD to finish on IPv6 addresses, so with lots of networks doing
+ * that one by one considerably delays the start of the daemon.
+ *
+ * Different networks are already started concurrently by API calls,
+ * @callback just has to lock the network object it is passed.
+ */
+static void
+networkForEachParallel(virNetworkDriverStatePtr driver,
+                       virNetworkObjListIterator callback,
+                       void *opaque)
+{
+    networkParallelData data = { callback, opaque, NULL, 0 };
+
+    /* Collecting can only fail on allocation, which aborts anyway */
+    ignore_value(virNetworkObjListForEach(driver->networks,
+                                          networkParallelCollect, &data));
+
+    virThreadForEachParallel(data.nobjs, NETWORK_PARALLEL_WORKERS_MAX,
+                             "network-start", networkParallelOne, &data);
+
+    virObjectListFreeCount(data.objs, data.nobjs);
+}
+
+
 #ifdef WITH_FIREWALLD
 static DBusHandlerResult
 firewalld_dbus_filter_bridge(DBusConnection *connection G_GNUC_UNUSED,
@@ -726,6 +818,8 @@ networkStateInitialize(bool privileged,
         goto error;
 
     network_driver->lockFD = -1;
+    network_driver->dnsmasqReloadTimer = -1;
+    network_driver->macMapSaveTimer = -1;
     if (virMutexInit(&network_driver->lock) < 0) {
         VIR_FREE(network_driver);
         goto error;
@@ -733,6 +827,11 @@ networkStateInitialize(bool privileged,
 
     network_driver->privileged = privileged;
 
+    if (!(network_driver->dnsmasqReloads = virHashNew(virHashValueFree)) ||
+        !(network_driver->macMapSaves = virHashNew(virHashValueFree)) ||
+        !(network_driver->leases = virHashNew(networkLeasesFree)))
+        goto error;
+
     if (!(network_driver->xmlopt = networkDnsmasqCreateXMLConf()))
         goto error;
 
@@ -805,9 +904,9 @@ networkStateInitialize(bool privileged,
         goto error;
 
     if (autostart) {
-        virNetworkObjListForEach(network_driver->networks,
-                                 networkAutostartConfig,
-                                 network_driver);
+        networkForEachParallel(network_driver,
+                               networkAutostartConfig,
+                               network_driver);
     }
 
     network_driver->networkEventState = virObjectEventStateNew();
@@ -870,9 +969,9 @@ networkStateReload(void)
                                 network_driver->xmlopt);
     networkReloadFirewallRules(network_driver, false);
     networkRefreshDaemons(network_driver);
-    virNetworkObjListForEach(network_driver->networks,
-                             networkAutostartConfig,
-                             network_driver);
+    networkForEachParallel(network_driver,
+                           networkAutostartConfig,
+                           network_driver);
     return 0;
 }
 
@@ -888,6 +987,12 @@ networkStateCleanup(void)
     if (!network_driver)
         return -1;
 
+    /* write out the MAC maps changed since the last timer run */
+    if (network_driver->macMapSaveTimer != -1)
+        networkMacMapSaveTimer(network_driver->macMapSaveTimer, network_driver);
+    virHashFree(network_driver->macMapSaves);
+    virHashFree(network_driver->leases);
+
     virObjectUnref(network_driver->networkEventState);
     virObjectUnref(network_driver->xmlopt);
 
@@ -907,6 +1012,10 @@ networkStateCleanup(void)
 
     virObjectUnref(network_driver->dnsmasqCaps);
 
+    if (network_driver->dnsmasqReloadTimer != -1)
+        virEventRemoveTimeout(network_driver->dnsmasqReloadTimer);
+    virHashFree(network_driver->dnsmasqReloads);
+
     virMutexDestroy(&network_driver->lock);
 
     VIR_FREE(network_driver);
@@ -1748,16 +1857,194 @@ networkStartDhcpDaemon(virNetworkDriverStatePtr driver,
 }
 
 
+static int
+networkDnsmasqReloadHelper(void *payload,
+                           const void *name,
+                           void *opaque)
+{
+    virNetworkDriverStatePtr driver = opaque;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    virNetworkObjPtr obj;
+    pid_t dnsmasqPid;
+
+    if (virUUIDParse(name, uuid) < 0 ||
+        !(obj = virNetworkObjFindByUUID(driver->networks, uuid)))
+        return 0;
+
+    dnsmasqPid = virNetworkObjGetDnsmasqPid(obj);
+    if (virNetworkObjIsActive(obj) && dnsmasqPid > 0) {
+        VIR_DEBUG("Reloading dnsmasq of network %s", (const char *) payload);
+        if (kill(dnsmasqPid, SIGHUP) < 0)
+            VIR_WARN("Failed to reload dnsmasq of network %s: %s",
+                     (const char *) payload, g_strerror(errno));
+    }
+
+    virNetworkObjEndAPI(&obj);
+    return 0;
+}
+
+
+static void
+networkDnsmasqReloadTimer(int timer G_GNUC_UNUSED,
+                          void *opaque)
+{
+    virNetworkDriverStatePtr driver = opaque;
+    virHashTablePtr reloads;
+
+    networkDriverLock(driver);
+    virEventRemoveTimeout(driver->dnsmasqReloadTimer);
+    driver->dnsmasqReloadTimer = -1;
+    reloads = driver->dnsmasqReloads;
+    driver->dnsmasqReloads = virHashNew(virHashValueFree);
+    networkDriverUnlock(driver);
+
+    virHashForEach(reloads, networkDnsmasqReloadHelper, driver);
+    virHashFree(reloads);
+}
+
+
+/* networkReloadDnsmasq:
+ *  Ask dnsmasq of @obj to reread its hosts files. Rereading thousands
+ *  of hosts at once is considerably cheaper than rereading them after
+ *  each of many updates made in quick succession, hence the request is
+ *  held back for NETWORK_DNSMASQ_RELOAD_DELAY_MS, coalescing the
+ *  requests made meanwhile.
+ *
+ *  Returns 0 on success, -1 on failure.
+ */
+#define NETWORK_DNSMASQ_RELOAD_DELAY_MS 200
+
+static int
+networkReloadDnsmasq(virNetworkDriverStatePtr driver,
+                     virNetworkObjPtr obj,
+                     bool defer)
+{
+    virNetworkDefPtr def = virNetworkObjGetDef(obj);
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    if (defer) {
+        virUUIDFormat(def->uuid, uuidstr);
+
+        networkDriverLock(driver);
+        if (driver->dnsmasqReloadTimer == -1)
+            driver->dnsmasqReloadTimer =
+                virEventAddTimeout(NETWORK_DNSMASQ_RELOAD_DELAY_MS,
+                                   networkDnsmasqReloadTimer,
+                                   driver, NULL);
+
+        /* Without a timer, there's no choice but to reload right now */
+        if (driver->dnsmasqReloadTimer != -1 &&
+            virHashUpdateEntry(driver->dnsmasqReloads, uuidstr,
+                               g_strdup(def->name)) == 0) {
+            networkDriverUnlock(driver);
+            return 0;
+        }
+        networkDriverUnlock(driver);
+    }
+
+    return kill(virNetworkObjGetDnsmasqPid(obj), SIGHUP);
+}
+
+
+static int
+networkMacMapSaveHelper(void *payload,
+                        const void *name,
+                        void *opaque)
+{
+    virNetworkDriverStatePtr driver = opaque;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    virNetworkObjPtr obj;
+
+    if (virUUIDParse(name, uuid) < 0 ||
+        !(obj = virNetworkObjFindByUUID(driver->networks, uuid)))
+        return 0;
+
+    if (virNetworkObjIsActive(obj) &&
+        virNetworkObjMacMgrSave(obj, driver->dnsmasqStateDir) < 0) {
+        VIR_WARN("Failed to save MAC map of network %s: %s",
+                 (const char *) payload, virGetLastErrorMessage());
+        virResetLastError();
+    }
+
+    virNetworkObjEndAPI(&obj);
+    return 0;
+}
+
+
+static void
+networkMacMapSaveTimer(int timer G_GNUC_UNUSED,
+                       void *opaque)
+{
+    virNetworkDriverStatePtr driver = opaque;
+    virHashTablePtr saves;
+
+    networkDriverLock(driver);
+    virEventRemoveTimeout(driver->macMapSaveTimer);
+    driver->macMapSaveTimer = -1;
+    saves = driver->macMapSaves;
+    driver->macMapSaves = virHashNew(virHashValueFree);
+    networkDriverUnlock(driver);
+
+    virHashForEach(saves, networkMacMapSaveHelper, driver);
+    virHashFree(saves);
+}
+
+
+/* networkSaveMacMap:
+ *  Write the MAC map of @obj read by the NSS module. The whole map is
+ *  rewritten each time, so when many ports of a network are created or
+ *  deleted in quick succession, e.g. while a lot of guests are started,
+ *  the write is held back for NETWORK_MAC_MAP_SAVE_DELAY_MS and shared
+ *  by all the changes made meanwhile.
+ *
+ *  Returns 0 on success, -1 on failure.
+ */
+#define NETWORK_MAC_MAP_SAVE_DELAY_MS 200
+
+static int
+networkSaveMacMap(virNetworkDriverStatePtr driver,
+                  virNetworkObjPtr obj)
+{
+    virNetworkDefPtr def = virNetworkObjGetDef(obj);
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    if (!virNetworkObjGetMacMap(obj))
+        return 0;
+
+    virUUIDFormat(def->uuid, uuidstr);
+
+    networkDriverLock(driver);
+    if (driver->macMapSaveTimer == -1)
+        driver->macMapSaveTimer =
+            virEventAddTimeout(NETWORK_MAC_MAP_SAVE_DELAY_MS,
+                               networkMacMapSaveTimer,
+                               driver, NULL);
+
+    /* Without a timer, there's no choice but to write it right now */
+    if (driver->macMapSaveTimer != -1 &&
+        virHashUpdateEntry(driver->macMapSaves, uuidstr,
+                           g_strdup(def->name)) == 0) {
+        networkDriverUnlock(driver);
+        return 0;
+    }
+    networkDriverUnlock(driver);
+
+    return virNetworkObjMacMgrSave(obj, driver->dnsmasqStateDir);
+}
+
+
 /* networkRefreshDhcpDaemon:
  *  Update dnsmasq config files, then send a SIGHUP so that it rereads
  *  them.   This only works for the dhcp-hostsfile and the
- *  addn-hosts file.
+ *  addn-hosts file. If @defer is true, the SIGHUP is coalesced with
+ *  others sent shortly after, see networkReloadDnsmasq.
  *
  *  Returns 0 on success, -1 on failure.
  */
 static int
 networkRefreshDhcpDaemon(virNetworkDriverStatePtr driver,
-                         virNetworkObjPtr obj)
+                         virNetworkObjPtr obj,
+                         bool defer)
 {
     virNetworkDefPtr def = virNetworkObjGetDef(obj);
     int ret = -1;
@@ -1813,8 +2100,7 @@ networkRefreshDhcpDaemon(virNetworkDriverStatePtr driver,
     if ((ret = dnsmasqSave(dctx)) < 0)
         goto cleanup;
 
-    dnsmasqPid = virNetworkObjGetDnsmasqPid(obj);
-    ret = kill(dnsmasqPid, SIGHUP);
+    ret = networkReloadDnsmasq(driver, obj, defer);
  cleanup:
     dnsmasqContextFree(dctx);
     return ret;
@@ -2154,7 +2440,7 @@ networkRefreshDaemonsHelper(virNetworkObjPtr obj,
              * dnsmasq and/or radvd, or restart them if they've
              * disappeared.
              */
-            networkRefreshDhcpDaemon(driver, obj);
+            networkRefreshDhcpDaemon(driver, obj, false);
             networkRefreshRadvd(driver, obj);
             break;
 
@@ -2185,9 +2471,9 @@ static void
 networkRefreshDaemons(virNetworkDriverStatePtr driver)
 {
     VIR_INFO("Refreshing network daemons");
-    virNetworkObjListForEach(driver->networks,
-                             networkRefreshDaemonsHelper,
-                             driver);
+    networkForEachParallel(driver,
+                           networkRefreshDaemonsHelper,
+                           driver);
 }
 
 
@@ -2863,6 +3149,121 @@ networkCreateInterfacePool(virNetworkDefPtr netdef)
 }
 
 
+/* networkHostdevIsPrebound:
+ * @addr: address of a device of the interface pool
+ *
+ * Returns true if the device is bound to vfio-pci, i.e. it is part of
+ * the warm pool of a network with <driver prebind='yes'/>
+ */
+static bool
+networkHostdevIsPrebound(virPCIDeviceAddressPtr addr)
+{
+    g_autoptr(virPCIDevice) pci = NULL;
+    g_autofree char *driverPath = NULL;
+    g_autofree char *driverName = NULL;
+
+    if (!(pci = virPCIDeviceNew(addr->domain, addr->bus,
+                                addr->slot, addr->function)) ||
+        virPCIDeviceGetDriverPathAndName(pci, &driverPath, &driverName) < 0) {
+        virResetLastError();
+        return false;
+    }
+
+    return STREQ_NULLABLE(driverName,
+                          virPCIStubDriverTypeToString(VIR_PCI_STUB_DRIVER_VFIO));
+}
+
+
+/* networkPrebindInterfacePool:
+ * @netdef: the live NetDef of a hostdev network
+ *
+ * Binds all unused devices of the interface pool to vfio-pci and
+ * resets them, so that handing one over to a guest doesn't have to
+ * wait for that. Failures only mean the device will be detached the
+ * usual way when it's used, so they are not fatal.
+ */
+static void
+networkPrebindInterfacePool(virNetworkDefPtr netdef)
+{
+    size_t i;
+
+    for (i = 0; i < netdef->forward.nifs; i++) {
+        virNetworkForwardIfDefPtr thisIf = &netdef->forward.ifs[i];
+        virPCIDeviceAddressPtr addr = &thisIf->device.pci;
+        g_autoptr(virPCIDevice) pci = NULL;
+
+        if (thisIf->type != VIR_NETWORK_FORWARD_HOSTDEV_DEVICE_PCI ||
+            thisIf->connections > 0)
+            continue;
+
+        if (!(pci = virPCIDeviceNew(addr->domain, addr->bus,
+                                    addr->slot, addr->function)))
+            goto error;
+
+        virPCIDeviceSetStubDriver(pci, VIR_PCI_STUB_DRIVER_VFIO);
+
+        VIR_DEBUG("Prebinding PCI device %s of network %s",
+                  virPCIDeviceGetName(pci), netdef->name);
+        if (virPCIDeviceDetach(pci, NULL, NULL) < 0 ||
+            virPCIDeviceReset(pci, NULL, NULL) < 0)
+            goto error;
+
+        continue;
+
+     error:
+        VIR_WARN("Unable to prebind device " VIR_PCI_DEVICE_ADDRESS_FMT
+                 " of network %s: %s",
+                 addr->domain, addr->bus, addr->slot, addr->function,
+                 netdef->name, virGetLastErrorMessage());
+        virResetLastError();
+    }
+}
+
+
+/* networkUnbindInterfacePool:
+ * @netdef: the live NetDef of a hostdev network
+ *
+ * Gives the unused devices of the warm pool back to their host driver.
+ */
+static void
+networkUnbindInterfacePool(virNetworkDefPtr netdef)
+{
+    size_t i;
+
+    for (i = 0; i < netdef->forward.nifs; i++) {
+        virNetworkForwardIfDefPtr thisIf = &netdef->forward.ifs[i];
+        virPCIDeviceAddressPtr addr = &thisIf->device.pci;
+        g_autoptr(virPCIDevice) pci = NULL;
+
+        if (thisIf->type != VIR_NETWORK_FORWARD_HOSTDEV_DEVICE_PCI ||
+            thisIf->connections > 0 ||
+            !networkHostdevIsPrebound(addr))
+            continue;
+
+        if (!(pci = virPCIDeviceNew(addr->domain, addr->bus,
+                                    addr->slot, addr->function)))
+            goto error;
+
+        virPCIDeviceSetStubDriver(pci, VIR_PCI_STUB_DRIVER_VFIO);
+        virPCIDeviceSetUnbindFromStub(pci, true);
+
+        VIR_DEBUG("Reattaching PCI device %s of network %s",
+                  virPCIDeviceGetName(pci), netdef->name);
+        if (virPCIDeviceReattach(pci, NULL, NULL) < 0)
+            goto error;
+
+        continue;
+
+     error:
+        VIR_WARN("Unable to reattach device " VIR_PCI_DEVICE_ADDRESS_FMT
+                 " of network %s: %s",
+                 addr->domain, addr->bus, addr->slot, addr->function,
+                 netdef->name, virGetLastErrorMessage());
+        virResetLastError();
+    }
+}
+
+
 static int
 networkStartNetworkExternal(virNetworkObjPtr obj)
 {
@@ -2871,18 +3272,31 @@ networkStartNetworkExternal(virNetworkObjPtr obj)
      * failure, undo anything you've done, and return -1. On success
      * return 0.
      */
-    return networkCreateInterfacePool(virNetworkObjGetDef(obj));
+    virNetworkDefPtr def = virNetworkObjGetDef(obj);
+
+    if (networkCreateInterfacePool(def) < 0)
+        return -1;
+
+    if (def->forward.prebind)
+        networkPrebindInterfacePool(def);
+
+    return 0;
 }
 
 
 static int
-networkShutdownNetworkExternal(virNetworkObjPtr obj G_GNUC_UNUSED)
+networkShutdownNetworkExternal(virNetworkObjPtr obj)
 {
     /* put anything here that needs to be done each time a network of
      * type BRIDGE, PRIVATE, VEPA, HOSTDEV or PASSTHROUGH is shutdown. On
      * failure, undo anything you've done, and return -1. On success
      * return 0.
      */
+    virNetworkDefPtr def = virNetworkObjGetDef(obj);
+
+    if (def->forward.prebind)
+        networkUnbindInterfacePool(def);
+
     return 0;
 }
 
@@ -3962,7 +4376,7 @@ networkUpdate(virNetworkPtr net,
 
             if ((newDhcpActive != oldDhcpActive &&
                  networkRestartDhcpDaemon(driver, obj) < 0) ||
-                networkRefreshDhcpDaemon(driver, obj) < 0) {
+                networkRefreshDhcpDaemon(driver, obj, true) < 0) {
                 goto cleanup;
             }
 
@@ -3971,7 +4385,7 @@ networkUpdate(virNetworkPtr net,
              * (not the .conf file) so we can just update the config
              * files and send SIGHUP to dnsmasq.
              */
-            if (networkRefreshDhcpDaemon(driver, obj) < 0)
+            if (networkRefreshDhcpDaemon(driver, obj, true) < 0)
                 goto cleanup;
 
         }
@@ -4237,96 +4651,110 @@ networkSetAutostart(virNetworkPtr net,
 }
 
 
-static int
-networkGetDHCPLeases(virNetworkPtr net,
-                     const char *mac,
-                     virNetworkDHCPLeasePtr **leases,
-                     unsigned int flags)
+/* Leases of a network as last read from its custom leases file and
+ * journal, so that lookups don't parse them again until dnsmasq reports
+ * a change through leaseshelper, which rewrites or appends to them. */
+typedef struct _networkLeases networkLeases;
+typedef networkLeases *networkLeasesPtr;
+struct _networkLeases {
+    /* identity of the files @leases were read from */
+    unsigned long long ino;
+    long long size;
+    long long mtime;
+    long long journalSize;
+    long long journalMtime;
+
+    virJSONValuePtr leases;
+    virHashTablePtr macs; /* networkLeasesMAC by lowercase MAC address */
+};
+
+typedef struct _networkLeasesMAC networkLeasesMAC;
+typedef networkLeasesMAC *networkLeasesMACPtr;
+struct _networkLeasesMAC {
+    size_t nleases;
+    virJSONValuePtr *leases; /* owned by networkLeases.leases */
+};
+
+
+static void
+networkLeasesMACFree(void *opaque)
 {
-    virNetworkDriverStatePtr driver = networkGetDriver();
-    size_t i, j;
-    size_t nleases = 0;
-    int rv = -1;
-    size_t size = 0;
-    int custom_lease_file_len = 0;
-    bool need_results = !!leases;
-    long long currtime = 0;
-    long long expirytime_tmp = -1;
-    bool ipv6 = false;
-    char *lease_entries = NULL;
-    char *custom_lease_file = NULL;
-    const char *ip_tmp = NULL;
-    const char *mac_tmp = NULL;
-    virJSONValuePtr lease_tmp = NULL;
-    virJSONValuePtr leases_array = NULL;
-    virNetworkIPDefPtr ipdef_tmp = NULL;
-    virNetworkDHCPLeasePtr lease = NULL;
-    virNetworkDHCPLeasePtr *leases_ret = NULL;
-    virNetworkObjPtr obj;
-    virNetworkDefPtr def;
-    virMacAddr mac_addr;
+    networkLeasesMACPtr mac = opaque;
 
-    virCheckFlags(0, -1);
+    if (!mac)
+        return;
 
-    /* only to check if the MAC is valid */
-    if (mac && virMacAddrParse(mac, &mac_addr) < 0) {
-        virReportError(VIR_ERR_INVALID_MAC, "%s", mac);
-        return -1;
-    }
+    VIR_FREE(mac->leases);
+    VIR_FREE(mac);
+}
 
-    if (!(obj = networkObjFromNetwork(net)))
-        return -1;
-    def = virNetworkObjGetDef(obj);
 
-    if (virNetworkGetDHCPLeasesEnsureACL(net->conn, def) < 0)
-        goto cleanup;
+static void
+networkLeasesFree(void *opaque)
+{
+    networkLeasesPtr leases = opaque;
 
-    /* Retrieve custom leases file location */
-    custom_lease_file = networkDnsmasqLeaseFileNameCustom(driver, def->bridge);
+    if (!leases)
+        return;
+
+    virHashFree(leases->macs);
+    virJSONValueFree(leases->leases);
+    VIR_FREE(leases);
+}
+
+
+static networkLeasesPtr
+networkLeasesRead(const char *custom_lease_file,
+                  const char *journal_file)
+{
+    g_autofree char *lease_entries = NULL;
+    networkLeasesPtr leases = NULL;
+    int custom_lease_file_len;
+    size_t i;
 
-    /* Read entire contents */
     if ((custom_lease_file_len = virFileReadAllQuiet(custom_lease_file,
                                                      VIR_NETWORK_DHCP_LEASE_FILE_SIZE_MAX,
                                                      &lease_entries)) < 0) {
-        /* Not all networks are guaranteed to have leases file.
-         * Only those which run dnsmasq. Therefore, if we failed
-         * to read the leases file, don't report error. Return 0
-         * leases instead. */
-        if (errno == ENOENT) {
-            rv = 0;
-        } else {
-            virReportSystemError(errno,
-                                 _("Unable to read leases file: %s"),
-                                 custom_lease_file);
-        }
-        goto error;
+        virReportSystemError(errno,
+                             _("Unable to read leases file: %s"),
+                             custom_lease_file);
+        return NULL;
     }
 
+    if (VIR_ALLOC(leases) < 0)
+        return NULL;
+
     if (custom_lease_file_len) {
-        if (!(leases_array = virJSONValueFromString(lease_entries))) {
+        if (!(leases->leases = virJSONValueFromString(lease_entries))) {
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("invalid json in file: %s"), custom_lease_file);
             goto error;
         }
 
-        if (!virJSONValueIsArray(leases_array)) {
+        if (!virJSONValueIsArray(leases->leases)) {
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                            _("Malformed lease_entries array"));
             goto error;
         }
-        size = virJSONValueArraySize(leases_array);
+    } else {
+        leases->leases = virJSONValueNewArray();
     }
 
-    currtime = (long long)time(NULL);
+    /* Renewals recorded since the file was last written */
+    if (virLeaseReadJournal(leases->leases, journal_file, NULL) < 0)
+        goto error;
 
-    for (i = 0; i < size; i++) {
-        if (!(lease_tmp = virJSONValueArrayGet(leases_array, i))) {
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("failed to parse json"));
-            goto error;
-        }
+    if (!(leases->macs = virHashNew(networkLeasesMACFree)))
+        goto error;
 
-        if (!(mac_tmp = virJSONValueObjectGetString(lease_tmp, "mac-address"))) {
+    for (i = 0; i < virJSONValueArraySize(leases->leases); i++) {
+        virJSONValuePtr lease = virJSONValueArrayGet(leases->leases, i);
+        char macstr[VIR_MAC_STRING_BUFLEN];
+        networkLeasesMACPtr mac;
+        const char *mac_tmp;
+        virMacAddr mac_addr;
+
+        if (!(mac_tmp = virJSONValueObjectGetString(lease, "mac-address"))) {
             /* leaseshelper program guarantees that lease will be stored only if
              * mac-address is known otherwise not */
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -4334,74 +4762,265 @@ networkGetDHCPLeases(virNetworkPtr net,
             goto error;
         }
 
-        if (mac && virMacAddrCompare(mac, mac_tmp))
+        /* keep leases of MACs which we can't parse out of the index,
+         * they can only be listed */
+        if (virMacAddrParse(mac_tmp, &mac_addr) < 0) {
+            virResetLastError();
             continue;
+        }
+        virMacAddrFormat(&mac_addr, macstr);
 
-        if (virJSONValueObjectGetNumberLong(lease_tmp, "expiry-time", &expirytime_tmp) < 0) {
-            /* A lease cannot be present without expiry-time */
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("found lease without expiry-time"));
+        if (!(mac = virHashLookup(leases->macs, macstr))) {
+            if (VIR_ALLOC(mac) < 0)
+                goto error;
+
+            if (virHashAddEntry(leases->macs, macstr, mac) < 0) {
+                networkLeasesMACFree(mac);
+                goto error;
+            }
+        }
+
+        if (VIR_APPEND_ELEMENT(mac->leases, mac->nleases, lease) < 0)
             goto error;
+    }
+
+    return leases;
+
+ error:
+    networkLeasesFree(leases);
+    return NULL;
+}
+
+
+/**
+ * networkLeasesGet:
+ * @driver: the network driver
+ * @custom_lease_file: path of the custom leases file of a network
+ * @ret: filled with the leases of the network
+ *
+ * Looks up the leases of the network using @custom_lease_file and
+ * rereads them if the file or its journal changed since they were read
+ * last. @ret is set to NULL if the network has no leases file, i.e. no
+ * DHCP server. The returned leases are valid while the driver lock is
+ * held, which the caller must do.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+networkLeasesGet(virNetworkDriverStatePtr driver,
+                 const char *custom_lease_file,
+                 networkLeasesPtr *ret)
+{
+    g_autofree char *journal_file = virLeaseJournalFileName(custom_lease_file);
+    networkLeasesPtr leases;
+    struct stat sb;
+    struct stat jsb;
+
+    *ret = NULL;
+
+    if (stat(custom_lease_file, &sb) < 0) {
+        /* Not all networks are guaranteed to have leases file.
+         * Only those which run dnsmasq. Therefore, if we failed
+         * to read the leases file, don't report error. Return 0
+         * leases instead. */
+        if (errno == ENOENT) {
+            virHashRemoveEntry(driver->leases, custom_lease_file);
+            return 0;
         }
 
-        /* Do not report expired lease */
-        if (expirytime_tmp < currtime)
-            continue;
+        virReportSystemError(errno,
+                             _("Unable to read leases file: %s"),
+                             custom_lease_file);
+        return -1;
+    }
 
-        if (need_results) {
-            if (VIR_ALLOC(lease) < 0)
-                goto error;
+    if (stat(journal_file, &jsb) < 0)
+        memset(&jsb, 0, sizeof(jsb));
 
-            lease->expirytime = expirytime_tmp;
+    leases = virHashLookup(driver->leases, custom_lease_file);
 
-            if (!(ip_tmp = virJSONValueObjectGetString(lease_tmp, "ip-address"))) {
-                /* A lease without ip-address makes no sense */
-                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                               _("found lease without ip-address"));
-                goto error;
-            }
+    if (!leases ||
+        leases->ino != sb.st_ino ||
+        leases->size != sb.st_size ||
+        leases->mtime != sb.st_mtime ||
+        leases->journalSize != jsb.st_size ||
+        leases->journalMtime != jsb.st_mtime) {
+        /* the identity is taken before reading, so that a change in
+         * between makes the next lookup read the files again */
+        if (!(leases = networkLeasesRead(custom_lease_file, journal_file)))
+            return -1;
 
-            /* Unlike IPv4, IPv6 uses ':' instead of '.' as separator */
-            ipv6 = strchr(ip_tmp, ':') ? true : false;
-            lease->type = ipv6 ? VIR_IP_ADDR_TYPE_IPV6 : VIR_IP_ADDR_TYPE_IPV4;
+        leases->ino = sb.st_ino;
+        leases->size = sb.st_size;
+        leases->mtime = sb.st_mtime;
+        leases->journalSize = jsb.st_size;
+        leases->journalMtime = jsb.st_mtime;
 
-            /* Obtain prefix */
-            for (j = 0; j < def->nips; j++) {
-                ipdef_tmp = &def->ips[j];
+        if (virHashUpdateEntry(driver->leases, custom_lease_file, leases) < 0) {
+            networkLeasesFree(leases);
+            return -1;
+        }
+    }
 
-                if (ipv6 && VIR_SOCKET_ADDR_IS_FAMILY(&ipdef_tmp->address,
-                                                      AF_INET6)) {
-                    lease->prefix = ipdef_tmp->prefix;
-                    break;
-                }
-                if (!ipv6 && VIR_SOCKET_ADDR_IS_FAMILY(&ipdef_tmp->address,
-                                                      AF_INET)) {
-                    lease->prefix = virSocketAddrGetIPPrefix(&ipdef_tmp->address,
-                                                             &ipdef_tmp->netmask,
-                                                             ipdef_tmp->prefix);
-                    break;
-                }
-            }
+    *ret = leases;
+    return 0;
+}
 
-            lease->mac = g_strdup(mac_tmp);
-            lease->ipaddr = g_strdup(ip_tmp);
-            lease->iface = g_strdup(def->bridge);
 
-            /* Fields that can be NULL */
-            lease->iaid = g_strdup(virJSONValueObjectGetString(lease_tmp, "iaid"));
-            lease->clientid = g_strdup(virJSONValueObjectGetString(lease_tmp, "client-id"));
-            lease->hostname = g_strdup(virJSONValueObjectGetString(lease_tmp, "hostname"));
+static int
+networkGetDHCPLeasesAdd(virNetworkDefPtr def,
+                        virJSONValuePtr lease_tmp,
+                        long long currtime,
+                        virNetworkDHCPLeasePtr **leases_ret,
+                        size_t *nleases)
+{
+    virNetworkDHCPLeasePtr lease = NULL;
+    long long expirytime_tmp = -1;
+    const char *ip_tmp = NULL;
+    virNetworkIPDefPtr ipdef_tmp = NULL;
+    bool ipv6 = false;
+    size_t j;
 
-            if (VIR_INSERT_ELEMENT(leases_ret, nleases, nleases, lease) < 0)
-                goto error;
+    if (virJSONValueObjectGetNumberLong(lease_tmp, "expiry-time", &expirytime_tmp) < 0) {
+        /* A lease cannot be present without expiry-time */
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("found lease without expiry-time"));
+        return -1;
+    }
 
-        } else {
-            nleases++;
+    /* Do not report expired lease */
+    if (expirytime_tmp < currtime)
+        return 0;
+
+    if (!leases_ret) {
+        (*nleases)++;
+        return 0;
+    }
+
+    if (VIR_ALLOC(lease) < 0)
+        return -1;
+
+    lease->expirytime = expirytime_tmp;
+
+    if (!(ip_tmp = virJSONValueObjectGetString(lease_tmp, "ip-address"))) {
+        /* A lease without ip-address makes no sense */
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("found lease without ip-address"));
+        goto error;
+    }
+
+    /* Unlike IPv4, IPv6 uses ':' instead of '.' as separator */
+    ipv6 = strchr(ip_tmp, ':') ? true : false;
+    lease->type = ipv6 ? VIR_IP_ADDR_TYPE_IPV6 : VIR_IP_ADDR_TYPE_IPV4;
+
+    /* Obtain prefix */
+    for (j = 0; j < def->nips; j++) {
+        ipdef_tmp = &def->ips[j];
+
+        if (ipv6 && VIR_SOCKET_ADDR_IS_FAMILY(&ipdef_tmp->address,
+                                              AF_INET6)) {
+            lease->prefix = ipdef_tmp->prefix;
+            break;
         }
+        if (!ipv6 && VIR_SOCKET_ADDR_IS_FAMILY(&ipdef_tmp->address,
+                                              AF_INET)) {
+            lease->prefix = virSocketAddrGetIPPrefix(&ipdef_tmp->address,
+                                                     &ipdef_tmp->netmask,
+                                                     ipdef_tmp->prefix);
+            break;
+        }
+    }
+
+    lease->mac = g_strdup(virJSONValueObjectGetString(lease_tmp, "mac-address"));
+    lease->ipaddr = g_strdup(ip_tmp);
+    lease->iface = g_strdup(def->bridge);
+
+    /* Fields that can be NULL */
+    lease->iaid = g_strdup(virJSONValueObjectGetString(lease_tmp, "iaid"));
+    lease->clientid = g_strdup(virJSONValueObjectGetString(lease_tmp, "client-id"));
+    lease->hostname = g_strdup(virJSONValueObjectGetString(lease_tmp, "hostname"));
+
+    if (VIR_INSERT_ELEMENT(*leases_ret, *nleases, *nleases, lease) < 0)
+        goto error;
+
+    return 0;
+
+ error:
+    virNetworkDHCPLeaseFree(lease);
+    return -1;
+}
+
+
+static int
+networkGetDHCPLeases(virNetworkPtr net,
+                     const char *mac,
+                     virNetworkDHCPLeasePtr **leases,
+                     unsigned int flags)
+{
+    virNetworkDriverStatePtr driver = networkGetDriver();
+    size_t i;
+    size_t nleases = 0;
+    int rv = -1;
+    long long currtime = 0;
+    g_autofree char *custom_lease_file = NULL;
+    networkLeasesPtr cache = NULL;
+    virNetworkDHCPLeasePtr *leases_ret = NULL;
+    virNetworkObjPtr obj;
+    virNetworkDefPtr def;
+    virMacAddr mac_addr;
+
+    virCheckFlags(0, -1);
+
+    /* only to check if the MAC is valid */
+    if (mac && virMacAddrParse(mac, &mac_addr) < 0) {
+        virReportError(VIR_ERR_INVALID_MAC, "%s", mac);
+        return -1;
+    }
+
+    if (!(obj = networkObjFromNetwork(net)))
+        return -1;
+    def = virNetworkObjGetDef(obj);
 
-        VIR_FREE(lease);
+    if (virNetworkGetDHCPLeasesEnsureACL(net->conn, def) < 0)
+        goto cleanup;
+
+    /* Retrieve custom leases file location */
+    custom_lease_file = networkDnsmasqLeaseFileNameCustom(driver, def->bridge);
+
+    currtime = (long long)time(NULL);
+
+    networkDriverLock(driver);
+
+    if (networkLeasesGet(driver, custom_lease_file, &cache) < 0)
+        goto error;
+
+    if (cache && mac) {
+        char macstr[VIR_MAC_STRING_BUFLEN];
+        networkLeasesMACPtr leases_mac;
+
+        virMacAddrFormat(&mac_addr, macstr);
+
+        if ((leases_mac = virHashLookup(cache->macs, macstr))) {
+            for (i = 0; i < leases_mac->nleases; i++) {
+                if (networkGetDHCPLeasesAdd(def, leases_mac->leases[i], currtime,
+                                            leases ? &leases_ret : NULL,
+                                            &nleases) < 0)
+                    goto error;
+            }
+        }
+    } else if (cache) {
+        for (i = 0; i < virJSONValueArraySize(cache->leases); i++) {
+            if (networkGetDHCPLeasesAdd(def,
+                                        virJSONValueArrayGet(cache->leases, i),
+                                        currtime,
+                                        leases ? &leases_ret : NULL,
+                                        &nleases) < 0)
+                goto error;
+        }
     }
 
+    networkDriverUnlock(driver);
+
     if (leases_ret) {
         /* NULL terminated array */
         ignore_value(VIR_REALLOC_N(leases_ret, nleases + 1));
@@ -4412,16 +5031,12 @@ networkGetDHCPLeases(virNetworkPtr net,
     rv = nleases;
 
  cleanup:
-    VIR_FREE(lease);
-    VIR_FREE(lease_entries);
-    VIR_FREE(custom_lease_file);
-    virJSONValueFree(leases_array);
-
     virNetworkObjEndAPI(&obj);
 
     return rv;
 
  error:
+    networkDriverUnlock(driver);
     if (leases_ret) {
         for (i = 0; i < nleases; i++)
             virNetworkDHCPLeaseFree(leases_ret[i]);
@@ -4603,6 +5218,12 @@ networkAllocatePort(virNetworkObjPtr obj,
         port->plug.hostdevpci.driver = netdef->forward.driverName;
         port->plug.hostdevpci.managed = netdef->forward.managed;
 
+        /* A device of the warm pool is already bound to vfio-pci, and
+         * has to stay there once the guest is done with it */
+        if (netdef->forward.prebind &&
+            networkHostdevIsPrebound(&dev->device.pci))
+            port->plug.hostdevpci.managed = false;
+
         if (port->virtPortProfile) {
             /* make sure type is supported for hostdev connections */
             if (port->virtPortProfile->virtPortType != VIR_NETDEV_VPORT_PROFILE_8021QBG &&
@@ -4743,8 +5364,8 @@ networkAllocatePort(virNetworkObjPtr obj,
                              &port->class_id) < 0)
         return -1;
 
-    if (virNetworkObjMacMgrAdd(obj, driver->dnsmasqStateDir,
-                               port->ownername, &port->mac) < 0)
+    if (virNetworkObjMacMgrAdd(obj, port->ownername, &port->mac) < 0 ||
+        networkSaveMacMap(driver, obj) < 0)
         return -1;
 
     if (virNetDevVPortProfileCheckComplete(port->virtPortProfile, true) < 0)
@@ -5023,7 +5644,8 @@ networkReleasePort(virNetworkObjPtr obj,
         return -1;
     }
 
-    virNetworkObjMacMgrDel(obj, driver->dnsmasqStateDir, port->ownername, &port->mac);
+    if (virNetworkObjMacMgrDel(obj, port->ownername, &port->mac) == 0)
+        ignore_value(networkSaveMacMap(driver, obj));
 
     netdef->connections--;
     if (dev)
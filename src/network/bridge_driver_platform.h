@@ -23,6 +23,7 @@
 
 #include "internal.h"
 #include "virthread.h"
+#include "virhash.h"
 #include "virdnsmasq.h"
 #include "virnetworkobj.h"
 #include "object_event.h"
@@ -53,6 +54,20 @@ struct _virNetworkDriverState {
      */
     dnsmasqCapsPtr dnsmasqCaps;
 
+    /* Require lock: names of networks whose dnsmasq is due to reread
+     * its hosts files, by UUID, and the timer telling them to */
+    virHashTablePtr dnsmasqReloads;
+    int dnsmasqReloadTimer;
+
+    /* Require lock: names of networks whose MAC map file is due to be
+     * rewritten, by UUID, and the timer doing it */
+    virHashTablePtr macMapSaves;
+    int macMapSaveTimer;
+
+    /* Require lock: leases of networks as last read from their custom
+     * leases files, by the path of the file */
+    virHashTablePtr leases;
+
     /* Immutable pointer, self-locking APIs */
     virObjectEventStatePtr networkEventState;
 
@@ -84,6 +84,8 @@ main(int argc, char **argv)
 {
     char *pid_file = NULL;
     char *custom_lease_file = NULL;
+    char *journal_file = NULL;
+    off_t journal_size = 0;
     const char *ip = NULL;
     const char *mac = NULL;
     const char *leases_str = NULL;
@@ -156,6 +158,7 @@ main(int argc, char **argv)
 
     custom_lease_file = g_strdup_printf(LOCALSTATEDIR "/lib/libvirt/dnsmasq/%s.status",
                                         interface);
+    journal_file = virLeaseJournalFileName(custom_lease_file);
 
     pid_file = g_strdup(RUNSTATEDIR "/leaseshelper.pid");
 
@@ -201,12 +204,35 @@ main(int argc, char **argv)
         break;
     }
 
+    /* Renewals, which make up for most of the events on a busy network,
+     * keep the IP address and MAC of the lease, so they're just recorded
+     * in the journal until it grows large enough to be merged into the
+     * leases file. */
+    if (action == VIR_LEASE_ACTION_OLD && lease_new) {
+        if (virLeaseAppendJournal(journal_file, lease_new, &journal_size) < 0)
+            goto cleanup;
+
+        if (journal_size < VIR_LEASE_JOURNAL_SIZE_MAX) {
+            rv = EXIT_SUCCESS;
+            goto cleanup;
+        }
+
+        /* The journal already has the lease */
+        virJSONValueFree(lease_new);
+        lease_new = NULL;
+        delete = false;
+    }
+
     leases_array_new = virJSONValueNewArray();
 
     if (virLeaseReadCustomLeaseFile(leases_array_new, custom_lease_file,
                                     delete ? ip : NULL, &server_duid) < 0)
         goto cleanup;
 
+    if (virLeaseReadJournal(leases_array_new, journal_file,
+                            delete ? ip : NULL) < 0)
+        goto cleanup;
+
     switch ((enum virLeaseActionFlags) action) {
     case VIR_LEASE_ACTION_INIT:
         if (virLeasePrintLeases(leases_array_new, server_duid) < 0)
@@ -234,6 +260,18 @@ main(int argc, char **argv)
         /* Write to file */
         if (virFileRewriteStr(custom_lease_file, 0644, leases_str) < 0)
             goto cleanup;
+
+        /* A stale index is ignored by the NSS module, so failing to
+         * update it is not fatal */
+        ignore_value(virLeaseWriteIndex(leases_array_new, custom_lease_file));
+
+        /* Everything in the journal is in the file now */
+        if (truncate(journal_file, 0) < 0 && errno != ENOENT) {
+            virReportSystemError(errno,
+                                 _("Unable to truncate leases journal: %s"),
+                                 journal_file);
+            goto cleanup;
+        }
         break;
 
     case VIR_LEASE_ACTION_LAST:
@@ -249,6 +287,7 @@ main(int argc, char **argv)
     VIR_FREE(pid_file);
     VIR_FREE(server_duid);
     VIR_FREE(custom_lease_file);
+    VIR_FREE(journal_file);
     virJSONValueFree(lease_new);
     virJSONValueFree(leases_array_new);
 
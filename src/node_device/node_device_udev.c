@@ -314,6 +314,8 @@ udevGenerateDeviceName(struct udev_device *device,
 }
 
 
+static virMutex udevPCIIdsLock = VIR_MUTEX_INITIALIZER;
+
 static int
 udevTranslatePCIIds(unsigned int vendor,
                     unsigned int product,
@@ -331,12 +333,15 @@ udevTranslatePCIIds(unsigned int vendor,
     m.device_class_mask = 0;
     m.match_data = 0;
 
-    /* pci_get_strings returns void */
+    /* pci_get_strings returns void. The ID database is loaded on
+     * first use, which is not thread safe */
+    virMutexLock(&udevPCIIdsLock);
     pci_get_strings(&m,
                     &device_name,
                     &vendor_name,
                     NULL,
                     NULL);
+    virMutexUnlock(&udevPCIIdsLock);
 
     *vendor_string = g_strdup(vendor_name);
     *product_string = g_strdup(device_name);
@@ -1251,23 +1256,17 @@ udevRemoveOneDevice(struct udev_device *device)
 }
 
 
+/* Collects the sysfs paths of all ancestors of @device, closest first */
 static int
-udevSetParent(struct udev_device *device,
-              virNodeDeviceDefPtr def)
+udevGetParentPaths(struct udev_device *device,
+                   GStrv *paths)
 {
-    struct udev_device *parent_device = NULL;
-    const char *parent_sysfs_path = NULL;
-    virNodeDeviceObjPtr obj = NULL;
-    virNodeDeviceDefPtr objdef;
+    struct udev_device *parent_device = device;
+    g_autoptr(GPtrArray) array = g_ptr_array_new_with_free_func(g_free);
 
-    parent_device = device;
-    do {
+    while ((parent_device = udev_device_get_parent(parent_device))) {
+        const char *parent_sysfs_path = udev_device_get_syspath(parent_device);
 
-        parent_device = udev_device_get_parent(parent_device);
-        if (parent_device == NULL)
-            break;
-
-        parent_sysfs_path = udev_device_get_syspath(parent_device);
         if (parent_sysfs_path == NULL) {
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("Could not get syspath for parent of '%s'"),
@@ -1275,56 +1274,103 @@ udevSetParent(struct udev_device *device,
             return -1;
         }
 
+        g_ptr_array_add(array, g_strdup(parent_sysfs_path));
+    }
+
+    g_ptr_array_add(array, NULL);
+    *paths = (GStrv) g_ptr_array_free(g_steal_pointer(&array), FALSE);
+    return 0;
+}
+
+
+/* Makes the closest ancestor in @parents which is a known node device
+ * the parent of @def */
+static void
+udevSetParentFromPaths(virNodeDeviceDefPtr def,
+                       GStrv parents)
+{
+    virNodeDeviceObjPtr obj = NULL;
+    virNodeDeviceDefPtr objdef;
+    size_t i;
+
+    for (i = 0; parents && parents[i] && def->parent == NULL; i++) {
         if ((obj = virNodeDeviceObjListFindBySysfsPath(driver->devs,
-                                                       parent_sysfs_path))) {
+                                                       parents[i]))) {
             objdef = virNodeDeviceObjGetDef(obj);
             def->parent = g_strdup(objdef->name);
             virNodeDeviceObjEndAPI(&obj);
 
-            def->parent_sysfs_path = g_strdup(parent_sysfs_path);
+            def->parent_sysfs_path = g_strdup(parents[i]);
         }
-
-    } while (def->parent == NULL && parent_device != NULL);
+    }
 
     if (!def->parent)
         def->parent = g_strdup("computer");
+}
+
+
+static int
+udevSetParent(struct udev_device *device,
+              virNodeDeviceDefPtr def)
+{
+    g_auto(GStrv) parents = NULL;
 
+    if (udevGetParentPaths(device, &parents) < 0)
+        return -1;
+
+    udevSetParentFromPaths(def, parents);
     return 0;
 }
 
 
-static int
-udevAddOneDevice(struct udev_device *device)
+/* Gathers everything about @device but its parent, which doesn't
+ * need any access to the list of node devices */
+static virNodeDeviceDefPtr
+udevGetDeviceDef(struct udev_device *device)
 {
     virNodeDeviceDefPtr def = NULL;
-    virNodeDeviceObjPtr obj = NULL;
-    virNodeDeviceDefPtr objdef;
-    virObjectEventPtr event = NULL;
-    bool new_device = true;
-    int ret = -1;
 
     if (VIR_ALLOC(def) != 0)
-        goto cleanup;
+        goto error;
 
     def->sysfs_path = g_strdup(udev_device_get_syspath(device));
 
     if (udevGetStringProperty(device, "DRIVER", &def->driver) < 0)
-        goto cleanup;
+        goto error;
 
     if (VIR_ALLOC(def->caps) != 0)
-        goto cleanup;
+        goto error;
 
     if (udevGetDeviceType(device, &def->caps->data.type) != 0)
-        goto cleanup;
+        goto error;
 
     if (udevGetDeviceNodes(device, def) != 0)
-        goto cleanup;
+        goto error;
 
     if (udevGetDeviceDetails(device, def) != 0)
-        goto cleanup;
+        goto error;
 
-    if (udevSetParent(device, def) != 0)
-        goto cleanup;
+    return def;
+
+ error:
+    VIR_DEBUG("Discarding device %p %s", def,
+              def ? NULLSTR(def->sysfs_path) : "");
+    virNodeDeviceDefFree(def);
+    return NULL;
+}
+
+
+/* Adds @def, which already has its parent set, to the list of node
+ * devices, or replaces the definition of the device with the same
+ * name. @def is consumed. */
+static int
+udevAddOneDeviceDef(virNodeDeviceDefPtr def)
+{
+    virNodeDeviceObjPtr obj = NULL;
+    virNodeDeviceDefPtr objdef;
+    virObjectEventPtr event = NULL;
+    bool new_device = true;
+    int ret = -1;
 
     if ((obj = virNodeDeviceObjListFindByName(driver->devs, def->name))) {
         virNodeDeviceObjEndAPI(&obj);
@@ -1353,7 +1399,7 @@ udevAddOneDevice(struct udev_device *device)
 
     if (ret != 0) {
         VIR_DEBUG("Discarding device %d %p %s", ret, def,
-                  def ? NULLSTR(def->sysfs_path) : "");
+                  NULLSTR(def->sysfs_path));
         virNodeDeviceDefFree(def);
     }
 
@@ -1362,28 +1408,89 @@ udevAddOneDevice(struct udev_device *device)
 
 
 static int
-udevProcessDeviceListEntry(struct udev *udev,
-                           struct udev_list_entry *list_entry)
+udevAddOneDevice(struct udev_device *device)
 {
-    struct udev_device *device;
-    const char *name = NULL;
-    int ret = -1;
+    virNodeDeviceDefPtr def;
 
-    name = udev_list_entry_get_name(list_entry);
+    if (!(def = udevGetDeviceDef(device)))
+        return -1;
 
-    device = udev_device_new_from_syspath(udev, name);
+    if (udevSetParent(device, def) != 0) {
+        virNodeDeviceDefFree(def);
+        return -1;
+    }
 
-    if (device != NULL) {
-        if (udevAddOneDevice(device) != 0) {
-            VIR_DEBUG("Failed to create node device for udev device '%s'",
-                      name);
+    return udevAddOneDeviceDef(def);
+}
+
+
+/*
+ * Enumerating devices is dominated by reading sysfs attributes, which
+ * is done in parallel by a few threads. The devices are added to the
+ * list in the order they were enumerated in afterwards, so that the
+ * parent of every device is known by the time it is added, just like
+ * when adding them one by one.
+ */
+#define UDEV_ENUMERATE_MAX_WORKERS 8
+#define UDEV_ENUMERATE_DEVICES_PER_WORKER 32
+
+typedef struct _udevEnumerateEntry udevEnumerateEntry;
+typedef udevEnumerateEntry *udevEnumerateEntryPtr;
+struct _udevEnumerateEntry {
+    const char *syspath;
+    virNodeDeviceDefPtr def;
+    GStrv parents;
+};
+
+typedef struct _udevEnumerateData udevEnumerateData;
+typedef udevEnumerateData *udevEnumerateDataPtr;
+struct _udevEnumerateData {
+    udevEnumerateEntryPtr entries;
+    size_t nentries;
+    int next; /* index of the next entry to process, atomic */
+};
+
+
+/* Processes entries until there are none left, using @udev which must
+ * not be used by any other thread meanwhile, as libudev isn't thread
+ * safe */
+static void
+udevEnumerateProcessEntries(struct udev *udev,
+                            udevEnumerateDataPtr data)
+{
+    int i;
+
+    while ((i = g_atomic_int_add(&data->next, 1)) < (int) data->nentries) {
+        udevEnumerateEntryPtr entry = &data->entries[i];
+        struct udev_device *device;
+
+        if (!(device = udev_device_new_from_syspath(udev, entry->syspath)))
+            continue;
+
+        if ((entry->def = udevGetDeviceDef(device)) &&
+            udevGetParentPaths(device, &entry->parents) < 0) {
+            virNodeDeviceDefFree(entry->def);
+            entry->def = NULL;
         }
-        ret = 0;
+
+        udev_device_unref(device);
     }
+}
 
-    udev_device_unref(device);
 
-    return ret;
+static void
+udevEnumerateWorker(void *opaque)
+{
+    udevEnumerateDataPtr data = opaque;
+    struct udev *udev;
+
+    /* The entries left over are processed by the enumerating thread */
+    if (!(udev = udev_new()))
+        return;
+
+    udevEnumerateProcessEntries(udev, data);
+
+    udev_unref(udev);
 }
 
 
@@ -1416,6 +1523,10 @@ udevEnumerateDevices(struct udev *udev)
 {
     struct udev_enumerate *udev_enumerate = NULL;
     struct udev_list_entry *list_entry = NULL;
+    udevEnumerateData data = { 0 };
+    size_t nworkers = 0;
+    size_t nentries = 0;
+    size_t i;
     int ret = -1;
 
     udev_enumerate = udev_enumerate_new(udev);
@@ -1426,13 +1537,45 @@ udevEnumerateDevices(struct udev *udev)
         VIR_WARN("udev scan devices failed");
 
     udev_list_entry_foreach(list_entry,
-                            udev_enumerate_get_list_entry(udev_enumerate)) {
+                            udev_enumerate_get_list_entry(udev_enumerate))
+        nentries++;
+
+    data.entries = g_new0(udevEnumerateEntry, nentries);
+    udev_list_entry_foreach(list_entry,
+                            udev_enumerate_get_list_entry(udev_enumerate))
+        data.entries[data.nentries++].syspath = udev_list_entry_get_name(list_entry);
+
+    nworkers = MIN(data.nentries / UDEV_ENUMERATE_DEVICES_PER_WORKER,
+                   MIN(g_get_num_processors(), UDEV_ENUMERATE_MAX_WORKERS));
+    if (nworkers > 0)
+        virThreadRunParallel(nworkers, "nodedev-enum",
+                             udevEnumerateWorker, &data);
+
+    udevEnumerateProcessEntries(udev, &data);
+
+    for (i = 0; i < data.nentries; i++) {
+        udevEnumerateEntryPtr entry = &data.entries[i];
 
-        udevProcessDeviceListEntry(udev, list_entry);
+        if (!entry->def) {
+            VIR_DEBUG("Failed to create node device for udev device '%s'",
+                      entry->syspath);
+            continue;
+        }
+
+        udevSetParentFromPaths(entry->def, entry->parents);
+        if (udevAddOneDeviceDef(g_steal_pointer(&entry->def)) != 0) {
+            VIR_DEBUG("Failed to create node device for udev device '%s'",
+                      entry->syspath);
+        }
     }
 
     ret = 0;
  cleanup:
+    for (i = 0; i < data.nentries; i++) {
+        virNodeDeviceDefFree(data.entries[i].def);
+        g_strfreev(data.entries[i].parents);
+    }
+    g_free(data.entries);
     udev_enumerate_unref(udev_enumerate);
     return ret;
 }
@@ -1493,6 +1636,11 @@ udevHandleOneDevice(struct udev_device *device)
 
     VIR_DEBUG("udev action: '%s'", action);
 
+    /* A PCI device coming or going may change the bridges of the host */
+    if (STRNEQ(action, "change") &&
+        STREQ_NULLABLE(udev_device_get_subsystem(device), "pci"))
+        virPCITopologyCacheInvalidate();
+
     if (STREQ(action, "add") || STREQ(action, "change"))
         return udevAddOneDevice(device);
 
@@ -1533,6 +1681,57 @@ udevEventMonitorSanityCheck(udevEventDataPtr priv,
 }
 
 
+/*
+ * Handles the events read from the udev monitor in one go. A burst of
+ * events often carries many change events for the same device, only
+ * the last event of each device has to be handled then: the definition
+ * is rebuilt from the current state of the device anyway. Dropping the
+ * earlier change events of a device doesn't affect its children, which
+ * can only be added once the device itself is known.
+ */
+static void
+udevHandleDeviceBatch(GPtrArray *batch)
+{
+    g_autoptr(virHashTable) last = NULL;
+    size_t i;
+
+    if (batch->len == 0)
+        return;
+
+    if (batch->len > 1 &&
+        (last = virHashCreate(batch->len, NULL))) {
+        for (i = 0; i < batch->len; i++) {
+            const char *syspath = udev_device_get_syspath(g_ptr_array_index(batch, i));
+
+            if (syspath &&
+                virHashUpdateEntry(last, syspath, GSIZE_TO_POINTER(i + 1)) < 0) {
+                g_clear_pointer(&last, virHashFree);
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < batch->len; i++) {
+        struct udev_device *device = g_ptr_array_index(batch, i);
+        const char *syspath = udev_device_get_syspath(device);
+
+        if (last && syspath &&
+            STREQ_NULLABLE(udev_device_get_action(device), "change") &&
+            virHashLookup(last, syspath) != GSIZE_TO_POINTER(i + 1)) {
+            VIR_DEBUG("Coalescing change of '%s' with a later event", syspath);
+            continue;
+        }
+
+        udevHandleOneDevice(device);
+    }
+
+    g_ptr_array_set_size(batch, 0);
+}
+
+
+/* Upper limit on events read from the monitor before handling them */
+#define UDEV_EVENT_BATCH_MAX 256
+
 /**
  * udevEventHandleThread
  * @opaque: unused
@@ -1557,8 +1756,11 @@ static void
 udevEventHandleThread(void *opaque G_GNUC_UNUSED)
 {
     udevEventDataPtr priv = driver->privateData;
+    g_autoptr(GPtrArray) batch = NULL;
     struct udev_device *device = NULL;
 
+    batch = g_ptr_array_new_with_free_func((GDestroyNotify) udev_device_unref);
+
     /* continue rather than break from the loop on non-fatal errors */
     while (1) {
         virObjectLock(priv);
@@ -1606,11 +1808,15 @@ udevEventHandleThread(void *opaque G_GNUC_UNUSED)
             priv->dataReady = false;
             virObjectUnlock(priv);
 
+            /* Everything queued has been read, handle it before
+             * waiting for more */
+            udevHandleDeviceBatch(batch);
             continue;
         }
 
-        udevHandleOneDevice(device);
-        udev_device_unref(device);
+        g_ptr_array_add(batch, device);
+        if (batch->len >= UDEV_EVENT_BATCH_MAX)
+            udevHandleDeviceBatch(batch);
 
         /* Instead of waiting for the next event after processing @device
          * data, let's keep reading from the udev monitor and only wait
@@ -42,8 +42,12 @@
 
 #include <fcntl.h>
 #include <poll.h>
+#include <sys/stat.h>
 
 #include <net/if.h>
+#include <net/ethernet.h>
+#include <netpacket/packet.h>
+#include <linux/filter.h>
 
 #include "viralloc.h"
 #include "virlog.h"
@@ -55,11 +59,15 @@
 #include "nwfilter_ipaddrmap.h"
 #include "virnetdev.h"
 #include "virfile.h"
+#include "virbuffer.h"
 #include "virsocketaddr.h"
 #include "virthreadpool.h"
+#include "virtunable.h"
 #include "configmake.h"
 #include "virtime.h"
 #include "virstring.h"
+#include "virsocket.h"
+#include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_NWFILTER
 
@@ -76,13 +84,20 @@ struct virNWFilterSnoopState {
     int                  leaseFD;
     int                  nLeases; /* number of active leases */
     int                  wLeases; /* number of written leases */
-    int                  nThreads; /* number of running threads */
     /* thread management */
     virHashTablePtr      snoopReqs;
     virHashTablePtr      ifnameToKey;
     virMutex             snoopLock;  /* protects SnoopReqs and IfNameToKey */
     virHashTablePtr      active;
     virMutex             activeLock; /* protects Active */
+    /* capture thread shared by all interfaces */
+    virHashTablePtr      captureReqs; /* ifindex -> req, holding a ref */
+    bool                 captureRunning;
+    virThread            captureThread;
+    int                  captureFD;
+    int                  captureWakeupFDs[2];
+    virThreadPoolPtr     decodePool;
+    virMutex             captureLock; /* protects all capture members */
 };
 
 # define virNWFilterSnoopLock() \
@@ -101,6 +116,14 @@ struct virNWFilterSnoopState {
     do { \
         virMutexUnlock(&virNWFilterSnoopState.activeLock); \
     } while (0)
+# define virNWFilterSnoopCaptureLock() \
+    do { \
+        virMutexLock(&virNWFilterSnoopState.captureLock); \
+    } while (0)
+# define virNWFilterSnoopCaptureUnlock() \
+    do { \
+        virMutexUnlock(&virNWFilterSnoopState.captureLock); \
+    } while (0)
 
 # define VIR_IFKEY_LEN   ((VIR_UUID_STRING_BUFLEN) + (VIR_MAC_STRING_BUFLEN))
 
@@ -110,17 +133,40 @@ typedef virNWFilterSnoopReq *virNWFilterSnoopReqPtr;
 typedef struct _virNWFilterSnoopIPLease virNWFilterSnoopIPLease;
 typedef virNWFilterSnoopIPLease *virNWFilterSnoopIPLeasePtr;
 
-typedef enum {
-    THREAD_STATUS_NONE,
-    THREAD_STATUS_OK,
-    THREAD_STATUS_FAIL,
-} virNWFilterSnoopThreadStatus;
+typedef struct _virNWFilterSnoopRateLimitConf virNWFilterSnoopRateLimitConf;
+typedef virNWFilterSnoopRateLimitConf *virNWFilterSnoopRateLimitConfPtr;
+
+struct _virNWFilterSnoopRateLimitConf {
+    time_t prev;
+    unsigned int pkt_ctr;
+    time_t burst;
+    unsigned int rate;
+    unsigned int burstRate;
+    unsigned int burstInterval;
+};
+
+/* State of the packets of one direction of an interface, only used by
+ * the capture thread apart from the queue counter */
+typedef struct _virNWFilterSnoopDirConf virNWFilterSnoopDirConf;
+typedef virNWFilterSnoopDirConf *virNWFilterSnoopDirConfPtr;
+
+struct _virNWFilterSnoopDirConf {
+    pcap_direction_t dir;
+    virNWFilterSnoopRateLimitConf rateLimit; /* indep. rate limiters */
+    int qCtr; /* number of jobs in the worker's queue */
+    unsigned int maxQSize;
+    unsigned long long penaltyTimeoutAbs;
+    time_t lastWarned;
+    time_t lastWarnedQueue;
+};
 
 struct _virNWFilterSnoopReq {
     /*
      * reference counter: while the req is on the
      * publicSnoopReqs hash, the refctr may only
-     * be modified with the SnoopLock held
+     * be modified with the SnoopLock held, or with
+     * the CaptureLock held while the req is on the
+     * captureReqs hash, which holds a reference
      */
     int                                  refctr;
 
@@ -133,10 +179,9 @@ struct _virNWFilterSnoopReq {
     virNWFilterSnoopIPLeasePtr           start;
     virNWFilterSnoopIPLeasePtr           end;
     char                                *threadkey;
-    virErrorPtr                          threadError;
 
-    virNWFilterSnoopThreadStatus         threadStatus;
-    virCond                              threadStatusCond;
+    /* from VM and to VM */
+    virNWFilterSnoopDirConf              dirConf[2];
 
     int                                  jobCompletionStatus;
     /* the number of submitted jobs in the worker's queue */
@@ -149,7 +194,6 @@ struct _virNWFilterSnoopReq {
      * - start
      * - end
      * - a lease while it is on the list
-     * - threadStatus
      * (for refctr, see above)
      */
     virMutex                             lock;
@@ -159,6 +203,7 @@ struct _virNWFilterSnoopReq {
  * Note about lock-order:
  * 1st: virNWFilterSnoopLock()
  * 2nd: virNWFilterSnoopReqLock(req)
+ * 3rd: virNWFilterSnoopCaptureLock()
  *
  * Rationale: Former protects the SnoopReqs hash, latter its contents
  */
@@ -231,6 +276,7 @@ typedef struct _virNWFilterDHCPDecodeJob virNWFilterDHCPDecodeJob;
 typedef virNWFilterDHCPDecodeJob *virNWFilterDHCPDecodeJobPtr;
 
 struct _virNWFilterDHCPDecodeJob {
+    virNWFilterSnoopReqPtr req;
     unsigned char packet[PCAP_PBUFSIZE];
     int caplen;
     bool fromVM;
@@ -243,32 +289,10 @@ struct _virNWFilterDHCPDecodeJob {
 
 # define MAX_QUEUED_JOBS        (DHCP_PKT_BURST + 2 * DHCP_PKT_RATE)
 
-typedef struct _virNWFilterSnoopRateLimitConf virNWFilterSnoopRateLimitConf;
-typedef virNWFilterSnoopRateLimitConf *virNWFilterSnoopRateLimitConfPtr;
+# define DHCP_DECODE_WORKERS    4
 
-struct _virNWFilterSnoopRateLimitConf {
-    time_t prev;
-    unsigned int pkt_ctr;
-    time_t burst;
-    const unsigned int rate;
-    const unsigned int burstRate;
-    const unsigned int burstInterval;
-};
 # define SNOOP_POLL_MAX_TIMEOUT_MS  (10 * 1000) /* milliseconds */
 
-typedef struct _virNWFilterSnoopPcapConf virNWFilterSnoopPcapConf;
-typedef virNWFilterSnoopPcapConf *virNWFilterSnoopPcapConfPtr;
-
-struct _virNWFilterSnoopPcapConf {
-    pcap_t *handle;
-    const pcap_direction_t dir;
-    const char *filter;
-    virNWFilterSnoopRateLimitConf rateLimit; /* indep. rate limiters */
-    int qCtr; /* number of jobs in the worker's queue */
-    const unsigned int maxQSize;
-    unsigned long long penaltyTimeoutAbs;
-};
-
 /* local function prototypes */
 static int virNWFilterSnoopReqLeaseDel(virNWFilterSnoopReqPtr req,
                                        virSocketAddrPtr ipaddr,
@@ -279,11 +303,14 @@ static void virNWFilterSnoopReqLock(virNWFilterSnoopReqPtr req);
 static void virNWFilterSnoopReqUnlock(virNWFilterSnoopReqPtr req);
 
 static void virNWFilterSnoopLeaseFileLoad(void);
+static void virNWFilterSnoopLeaseFileRefresh(void);
 static void virNWFilterSnoopLeaseFileSave(virNWFilterSnoopIPLeasePtr ipl);
 
 /* local variables */
 static struct virNWFilterSnoopState virNWFilterSnoopState = {
     .leaseFD = -1,
+    .captureFD = -1,
+    .captureWakeupFDs = { -1, -1 },
 };
 
 static const unsigned char dhcp_magic[4] = { 99, 130, 83, 99 };
@@ -543,6 +570,18 @@ virNWFilterSnoopReqGet(virNWFilterSnoopReqPtr req)
     g_atomic_int_add(&req->refctr, 1);
 }
 
+static void
+virNWFilterSnoopDirConfInit(virNWFilterSnoopDirConfPtr dc,
+                            pcap_direction_t dir)
+{
+    dc->dir = dir;
+    dc->rateLimit.prev = time(0);
+    dc->rateLimit.rate = DHCP_PKT_RATE;
+    dc->rateLimit.burstRate = DHCP_PKT_BURST;
+    dc->rateLimit.burstInterval = DHCP_BURST_INTERVAL_S;
+    dc->maxQSize = MAX_QUEUED_JOBS;
+}
+
 /*
  * Create a new Snoop request. Initialize it with the given
  * interface key. The caller must release the request with a call
@@ -565,22 +604,17 @@ virNWFilterSnoopReqNew(const char *ifkey)
     if (VIR_ALLOC(req) < 0)
         return NULL;
 
-    req->threadStatus = THREAD_STATUS_NONE;
+    virNWFilterSnoopDirConfInit(&req->dirConf[0], PCAP_D_IN /* from VM */);
+    virNWFilterSnoopDirConfInit(&req->dirConf[1], PCAP_D_OUT /* to VM */);
 
     if (virStrcpyStatic(req->ifkey, ifkey) < 0||
         virMutexInitRecursive(&req->lock) < 0)
         goto err_free_req;
 
-    if (virCondInit(&req->threadStatusCond) < 0)
-        goto err_destroy_mutex;
-
     virNWFilterSnoopReqGet(req);
 
     return req;
 
- err_destroy_mutex:
-    virMutexDestroy(&req->lock);
-
  err_free_req:
     VIR_FREE(req);
 
@@ -611,8 +645,6 @@ virNWFilterSnoopReqFree(virNWFilterSnoopReqPtr req)
     virNWFilterBindingDefFree(req->binding);
 
     virMutexDestroy(&req->lock);
-    virCondDestroy(&req->threadStatusCond);
-    virFreeError(req->threadError);
 
     VIR_FREE(req);
 }
@@ -1040,97 +1072,83 @@ virNWFilterSnoopDHCPDecode(virNWFilterSnoopReqPtr req,
     return 0;
 }
 
-static pcap_t *
-virNWFilterSnoopDHCPOpen(const char *ifname, virMacAddr *mac,
-                         const char *filter, pcap_direction_t dir)
+/*
+ * Open the packet socket the DHCP traffic of all interfaces is read
+ * from. It isn't bound to a bridge: the replies of a DHCP server on
+ * another port of a bridge are only forwarded to the port of the VM
+ * and never seen by the bridge device itself. The kernel only passes
+ * DHCP packets on, filtering them by interface and MAC address is up
+ * to the capture thread.
+ *
+ * Returns the file descriptor or -1 on error.
+ */
+static int
+virNWFilterSnoopCaptureOpen(void)
 {
-    pcap_t *handle = NULL;
+    const char *filter = "(dst port 67 and src port 68) or "
+                         "(src port 67 and dst port 68)";
+    pcap_t *handle;
     struct bpf_program fp;
-    char pcap_errbuf[PCAP_ERRBUF_SIZE];
-    char *ext_filter = NULL;
-    char macaddr[VIR_MAC_STRING_BUFLEN];
-
-    virMacAddrFormat(mac, macaddr);
+    struct sock_fprog prog;
+    int fd = -1;
 
-    if (dir == PCAP_D_IN /* from VM */) {
-        /*
-         * don't want to hear about another VM's DHCP requests
-         *
-         * extend the filter with the macaddr of the VM; filter the
-         * more unlikely parameters first, then go for the MAC
-         */
-        ext_filter = g_strdup_printf("%s and ether src %s", filter, macaddr);
-    } else {
-        /*
-         * Some DHCP servers respond via MAC broadcast; we rely on later
-         * filtering of responses by comparing the MAC address inside the
-         * DHCP response against the one of the VM. Assuming that the
-         * bridge learns the VM's MAC address quickly this should not
-         * generate much more traffic than if we filtered by VM and
-         * braodcast MAC as well
-         */
-        ext_filter = g_strdup(filter);
-    }
-
-    handle = pcap_create(ifname, pcap_errbuf);
-
-    if (handle == NULL) {
+    if (!(handle = pcap_open_dead(DLT_EN10MB, PCAP_PBUFSIZE))) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("pcap_create failed"));
-        goto cleanup_nohandle;
+                       _("pcap_open_dead failed"));
+        return -1;
     }
 
-    if (pcap_set_snaplen(handle, PCAP_PBUFSIZE) < 0 ||
-        pcap_set_immediate_mode(handle, 1) < 0 ||
-        pcap_activate(handle) < 0) {
+    if (pcap_compile(handle, &fp, filter, 1, PCAP_NETMASK_UNKNOWN) != 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("setup of pcap handle failed: %s"),
-                       pcap_geterr(handle));
-        goto cleanup;
+                       _("pcap_compile: %s"), pcap_geterr(handle));
+        goto cleanup_nocode;
     }
 
-    if (pcap_compile(handle, &fp, ext_filter, 1, PCAP_NETMASK_UNKNOWN) != 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("pcap_compile: %s"), pcap_geterr(handle));
+    if ((fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC,
+                     htons(ETH_P_ALL))) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot open packet socket for DHCP snooping"));
         goto cleanup;
     }
 
-    if (pcap_setfilter(handle, &fp) != 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("pcap_setfilter: %s"), pcap_geterr(handle));
-        goto cleanup_freecode;
-    }
+    prog.len = fp.bf_len;
+    prog.filter = (struct sock_filter *)fp.bf_insns;
 
-    if (pcap_setdirection(handle, dir) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("pcap_setdirection: %s"),
-                       pcap_geterr(handle));
-        goto cleanup_freecode;
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER,
+                   &prog, sizeof(prog)) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot attach filter to DHCP snooping socket"));
+        VIR_FORCE_CLOSE(fd);
+        goto cleanup;
     }
 
-    pcap_freecode(&fp);
-    VIR_FREE(ext_filter);
-
-    return handle;
+    if (virSetNonBlock(fd) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot make DHCP snooping socket non-blocking"));
+        VIR_FORCE_CLOSE(fd);
+        goto cleanup;
+    }
 
- cleanup_freecode:
-    pcap_freecode(&fp);
  cleanup:
+    pcap_freecode(&fp);
+ cleanup_nocode:
     pcap_close(handle);
- cleanup_nohandle:
-    VIR_FREE(ext_filter);
 
-    return NULL;
+    return fd;
 }
 
 /*
  * Worker function to decode the DHCP message and with that
  * also do the time-consuming work of instantiating the filters
+ *
+ * The workers are shared by all interfaces; the lease list of a
+ * request is protected by its lock.
  */
-static void virNWFilterDHCPDecodeWorker(void *jobdata, void *opaque)
+static void virNWFilterDHCPDecodeWorker(void *jobdata,
+                                        void *opaque G_GNUC_UNUSED)
 {
-    virNWFilterSnoopReqPtr req = opaque;
     virNWFilterDHCPDecodeJobPtr job = jobdata;
+    virNWFilterSnoopReqPtr req = job->req;
     virNWFilterSnoopEthHdrPtr packet = (virNWFilterSnoopEthHdrPtr)job->packet;
 
     if (virNWFilterSnoopDHCPDecode(req, packet,
@@ -1142,6 +1160,7 @@ static void virNWFilterDHCPDecodeWorker(void *jobdata, void *opaque)
                          "interface '%s'"), req->binding->portdevname);
     }
     ignore_value(!!g_atomic_int_dec_and_test(job->qCtr));
+    virNWFilterSnoopReqPut(req);
     VIR_FREE(job);
 }
 
@@ -1150,6 +1169,7 @@ static void virNWFilterDHCPDecodeWorker(void *jobdata, void *opaque)
  */
 static int
 virNWFilterSnoopDHCPDecodeJobSubmit(virThreadPoolPtr pool,
+                                    virNWFilterSnoopReqPtr req,
                                     virNWFilterSnoopEthHdrPtr pep,
                                     int len, pcap_direction_t dir,
                                     int *qCtr)
@@ -1164,16 +1184,22 @@ virNWFilterSnoopDHCPDecodeJobSubmit(virThreadPoolPtr pool,
         return -1;
 
     memcpy(job->packet, pep, len);
+    job->req = req;
     job->caplen = len;
     job->fromVM = (dir == PCAP_D_IN);
     job->qCtr = qCtr;
 
+    /* the job keeps the req alive until it is decoded */
+    virNWFilterSnoopReqGet(req);
+
     ret = virThreadPoolSendJob(pool, 0, job);
 
-    if (ret == 0)
+    if (ret == 0) {
         g_atomic_int_add(qCtr, 1);
-    else
+    } else {
+        virNWFilterSnoopReqPut(req);
         VIR_FREE(job);
+    }
 
     return ret;
 }
@@ -1227,325 +1253,424 @@ virNWFilterSnoopRateLimit(virNWFilterSnoopRateLimitConfPtr rl)
 /*
  * virNWFilterSnoopRatePenalty
  *
- * @pc: pointer to the virNWFilterSnoopPcapConf
+ * @dc: pointer to the virNWFilterSnoopDirConf
  * @diff: the amount of pkts beyond the rate, i.e., if the rate is 10
  *        and 13 pkts have been received now in one seconds, then
  *        this should be 3.
  *
- * Adjusts the timeout the virNWFilterSnooPcapConf will be penalized for
+ * Adjusts the timeout the virNWFilterSnoopDirConf will be penalized for
  * sending too many packets.
  */
 static void
-virNWFilterSnoopRatePenalty(virNWFilterSnoopPcapConfPtr pc,
+virNWFilterSnoopRatePenalty(virNWFilterSnoopDirConfPtr dc,
                             unsigned int diff, unsigned int limit)
 {
     if (diff > limit) {
         unsigned long long now;
 
         if (virTimeMillisNowRaw(&now) < 0) {
-            g_usleep(PCAP_FLOOD_TIMEOUT_MS); /* 1 ms */
-            pc->penaltyTimeoutAbs = 0;
+            dc->penaltyTimeoutAbs = 0;
         } else {
-            /* don't listen to the fd for 1 ms */
-            pc->penaltyTimeoutAbs = now + PCAP_FLOOD_TIMEOUT_MS;
+            /* drop the packets of the direction for 10 ms */
+            dc->penaltyTimeoutAbs = now + PCAP_FLOOD_TIMEOUT_MS;
         }
     }
 }
 
+/*
+ * Look up the request snooping on the interface with @ifindex; the
+ * caller must release it with virNWFilterSnoopReqPut()
+ */
+static virNWFilterSnoopReqPtr
+virNWFilterSnoopCaptureGetReq(int ifindex)
+{
+    char key[VIR_INT64_STR_BUFLEN];
+    virNWFilterSnoopReqPtr req;
+
+    g_snprintf(key, sizeof(key), "%d", ifindex);
+
+    virNWFilterSnoopCaptureLock();
+
+    req = virHashLookup(virNWFilterSnoopState.captureReqs, key);
+    if (req)
+        virNWFilterSnoopReqGet(req);
+
+    virNWFilterSnoopCaptureUnlock();
+
+    return req;
+}
+
+/*
+ * Stop passing the packets of the interface with @ifindex to @req. If
+ * @cancel is set, the interface is also considered gone, just like when
+ * it stopped working while a thread was snooping on it.
+ */
+static void
+virNWFilterSnoopCaptureRemove(virNWFilterSnoopReqPtr req,
+                              int ifindex, bool cancel)
+{
+    char key[VIR_INT64_STR_BUFLEN];
+    virNWFilterSnoopReqPtr old = NULL;
+
+    if (cancel) {
+        /* protect IfNameToKey */
+        virNWFilterSnoopLock();
+
+        /* protect req->binding->portdevname & req->threadkey */
+        virNWFilterSnoopReqLock(req);
+
+        virNWFilterSnoopCancel(&req->threadkey);
+
+        if (req->binding->portdevname)
+            ignore_value(virHashRemoveEntry(virNWFilterSnoopState.ifnameToKey,
+                                            req->binding->portdevname));
+
+        VIR_FREE(req->binding->portdevname);
+
+        virNWFilterSnoopReqUnlock(req);
+        virNWFilterSnoopUnlock();
+    }
+
+    g_snprintf(key, sizeof(key), "%d", ifindex);
+
+    virNWFilterSnoopCaptureLock();
+
+    if (virHashLookup(virNWFilterSnoopState.captureReqs, key) == req)
+        old = virHashSteal(virNWFilterSnoopState.captureReqs, key);
+
+    virNWFilterSnoopCaptureUnlock();
+
+    virNWFilterSnoopReqPut(old);
+}
+
+/*
+ * Rate limit a packet captured on the interface of @req and submit it
+ * to the decoding workers.
+ *
+ * Returns -1 if snooping on the interface has to be stopped.
+ */
 static int
-virNWFilterSnoopAdjustPoll(virNWFilterSnoopPcapConfPtr pc,
-                           size_t nPc, struct pollfd *pfd,
-                           int *pollTo)
+virNWFilterSnoopCapturePacket(virNWFilterSnoopReqPtr req,
+                              virNWFilterSnoopEthHdrPtr packet,
+                              int len,
+                              bool fromVM)
 {
-    int ret = 0;
-    size_t i;
-    int tmp;
-    unsigned long long now = 0;
+    virNWFilterSnoopDirConfPtr dc = &req->dirConf[fromVM ? 0 : 1];
+    unsigned long long now;
+    unsigned int diff;
+    bool active;
 
-    *pollTo = -1;
+    if (len <= MIN_VALID_DHCP_PKT_SIZE)
+        return 0;
 
-    for (i = 0; i < nPc; i++) {
-        if (pc[i].penaltyTimeoutAbs != 0) {
-            if (now == 0) {
-                if (virTimeMillisNow(&now) < 0) {
-                    ret = -1;
-                    break;
-                }
-            }
+    /* protect req->binding & req->threadkey */
+    virNWFilterSnoopReqLock(req);
 
-            if (now < pc[i].penaltyTimeoutAbs) {
-                /* don't listen to incoming data on the fd for some time */
-                pfd[i].events &= ~POLLIN;
-                /*
-                 * calc the max. time to spend in poll() until adjustments
-                 * to the pollfd array are needed again.
-                 */
-                tmp = pc[i].penaltyTimeoutAbs - now;
-                if (*pollTo == -1 || tmp < *pollTo)
-                    *pollTo = tmp;
-            } else {
-                /* listen again to the fd */
-                pfd[i].events |= POLLIN;
-
-                pc[i].penaltyTimeoutAbs = 0;
-            }
+    /* don't want to hear about another VM's DHCP requests */
+    active = virNWFilterSnoopIsActive(req->threadkey) &&
+             (!fromVM || virMacAddrCmp(&packet->eh_src,
+                                       &req->binding->mac) == 0);
+
+    virNWFilterSnoopReqUnlock(req);
+
+    if (!active)
+        return 0;
+
+    if (dc->penaltyTimeoutAbs != 0) {
+        if (virTimeMillisNowRaw(&now) == 0 && now < dc->penaltyTimeoutAbs)
+            return 0;
+        dc->penaltyTimeoutAbs = 0;
+    }
+
+    if (g_atomic_int_get(&dc->qCtr) > dc->maxQSize) {
+        if (time(0) - dc->lastWarnedQueue > 10) {
+            dc->lastWarnedQueue = time(0);
+            VIR_WARN("Worker threads for interface '%s' have a "
+                     "job queue that is too long",
+                     req->binding->portdevname);
         }
+        return 0;
     }
 
-    return ret;
+    diff = virNWFilterSnoopRateLimit(&dc->rateLimit);
+    if (diff > 0) {
+        virNWFilterSnoopRatePenalty(dc, diff, DHCP_PKT_RATE);
+        /* rate-limited warnings */
+        if (time(0) - dc->lastWarned > 10) {
+             dc->lastWarned = time(0);
+             VIR_WARN("Too many DHCP packets on interface '%s'",
+                      req->binding->portdevname);
+        }
+        return 0;
+    }
+
+    if (virNWFilterSnoopDHCPDecodeJobSubmit(virNWFilterSnoopState.decodePool,
+                                            req, packet, len, dc->dir,
+                                            &dc->qCtr) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Job submission failed on "
+                         "interface '%s'"), req->binding->portdevname);
+        return -1;
+    }
+
+    return 0;
 }
 
 /*
- * The DHCP snooping thread. It spends most of its time in the pcap
- * library and if it gets suitable packets, it submits them to the worker
- * thread for processing.
+ * Run the lease timers of all interfaces and stop snooping on the
+ * ones that were cancelled, whose rules failed to be instantiated or
+ * which went away.
  */
 static void
-virNWFilterDHCPSnoopThread(void *req0)
+virNWFilterSnoopCaptureSweep(void)
 {
-    virNWFilterSnoopReqPtr req = req0;
-    struct pcap_pkthdr *hdr;
-    virNWFilterSnoopEthHdrPtr packet;
-    int ifindex = 0;
-    int errcount = 0;
-    int tmp = -1, rv, n, pollTo;
+    virHashKeyValuePairPtr items;
     size_t i;
-    char *threadkey = NULL;
-    virThreadPoolPtr worker = NULL;
-    time_t last_displayed = 0, last_displayed_queue = 0;
-    virNWFilterSnoopPcapConf pcapConf[] = {
-        {
-            .dir = PCAP_D_IN, /* from VM */
-            .filter = "dst port 67 and src port 68",
-            .rateLimit = {
-                .prev = time(0),
-                .rate = DHCP_PKT_RATE,
-                .burstRate = DHCP_PKT_BURST,
-                .burstInterval = DHCP_BURST_INTERVAL_S,
-            },
-            .maxQSize = MAX_QUEUED_JOBS,
-        }, {
-            .dir = PCAP_D_OUT, /* to VM */
-            .filter = "src port 67 and dst port 68",
-            .rateLimit = {
-                .prev = time(0),
-                .rate = DHCP_PKT_RATE,
-                .burstRate = DHCP_PKT_BURST,
-                .burstInterval = DHCP_BURST_INTERVAL_S,
-            },
-            .maxQSize = MAX_QUEUED_JOBS,
-        },
-    };
-    struct pollfd fds[] = {
-        {
-            /* get a POLLERR if interface goes down or disappears */
-            .events = POLLIN | POLLERR,
-        }, {
-            .events = POLLIN | POLLERR,
-        },
-    };
-    bool error = false;
 
-    /* whoever started us increased the reference counter for the req for us */
+    virNWFilterSnoopCaptureLock();
 
-    /* protect req->binding->portdevname & req->threadkey */
-    virNWFilterSnoopReqLock(req);
+    items = virHashGetItems(virNWFilterSnoopState.captureReqs, NULL);
+    for (i = 0; items && items[i].key; i++)
+        virNWFilterSnoopReqGet((virNWFilterSnoopReqPtr)items[i].value);
 
-    if (req->binding->portdevname && req->threadkey) {
-        for (i = 0; i < G_N_ELEMENTS(pcapConf); i++) {
-            pcapConf[i].handle =
-                virNWFilterSnoopDHCPOpen(req->binding->portdevname,
-                                         &req->binding->mac,
-                                         pcapConf[i].filter,
-                                         pcapConf[i].dir);
-            if (!pcapConf[i].handle) {
-                error = true;
-                break;
-            }
-            fds[i].fd = pcap_fileno(pcapConf[i].handle);
+    virNWFilterSnoopCaptureUnlock();
+
+    if (!items)
+        return;
+
+    for (i = 0; items[i].key; i++) {
+        virNWFilterSnoopReqPtr req = (virNWFilterSnoopReqPtr)items[i].value;
+        int ifindex;
+        bool remove = false;
+        bool cancel = false;
+
+        ignore_value(virStrToLong_i(items[i].key, NULL, 10, &ifindex));
+
+        virNWFilterSnoopReqLeaseTimerRun(req);
+
+        /* protect req->binding->portdevname & req->threadkey */
+        virNWFilterSnoopReqLock(req);
+
+        if (!virNWFilterSnoopIsActive(req->threadkey) ||
+            req->jobCompletionStatus != 0 ||
+            req->ifindex != ifindex) {
+            remove = true;
+        } else if (!req->binding->portdevname ||
+                   virNetDevValidateConfig(req->binding->portdevname,
+                                           NULL, ifindex) <= 0) {
+            remove = cancel = true;
         }
-        tmp = virNetDevGetIndex(req->binding->portdevname, &ifindex);
-        threadkey = g_strdup(req->threadkey);
-        worker = virThreadPoolNewFull(1, 1, 0,
-                                      virNWFilterDHCPDecodeWorker,
-                                      "dhcp-decode",
-                                      req);
-    }
 
-    /* let creator know how well we initialized */
-    if (error || !threadkey || tmp < 0 || !worker ||
-        ifindex != req->ifindex) {
-        virErrorPreserveLast(&req->threadError);
-        req->threadStatus = THREAD_STATUS_FAIL;
-    } else {
-        req->threadStatus = THREAD_STATUS_OK;
+        virNWFilterSnoopReqUnlock(req);
+
+        if (remove)
+            virNWFilterSnoopCaptureRemove(req, ifindex, cancel);
+
+        virNWFilterSnoopReqPut(req);
     }
 
-    virCondSignal(&req->threadStatusCond);
+    VIR_FREE(items);
+}
 
-    virNWFilterSnoopReqUnlock(req);
+/*
+ * The DHCP snooping thread. It reads the DHCP packets of all interfaces
+ * from a single socket and submits the ones of interfaces that are
+ * snooped on to the worker threads for processing.
+ */
+static void
+virNWFilterSnoopCaptureThread(void *opaque G_GNUC_UNUSED)
+{
+    unsigned char packet[PCAP_PBUFSIZE];
+    struct pollfd fds[] = {
+        {
+            .fd = virNWFilterSnoopState.captureFD,
+            .events = POLLIN,
+        }, {
+            .fd = virNWFilterSnoopState.captureWakeupFDs[0],
+            .events = POLLIN,
+        },
+    };
+    time_t lastSweep = 0;
 
-    if (req->threadStatus != THREAD_STATUS_OK)
-        goto exit;
+    for (;;) {
+        struct sockaddr_ll sll;
+        socklen_t slen = sizeof(sll);
+        virNWFilterSnoopReqPtr req;
+        ssize_t len;
+        int n;
+
+        n = poll(fds, G_N_ELEMENTS(fds), SNOOP_POLL_MAX_TIMEOUT_MS);
+
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            virReportSystemError(errno, "%s",
+                                 _("poll failed on DHCP snooping socket"));
+            break;
+        }
 
-    while (!error) {
-        if (virNWFilterSnoopAdjustPoll(pcapConf,
-                                       G_N_ELEMENTS(pcapConf),
-                                       fds, &pollTo) < 0) {
+        if (n > 0 && fds[1].revents) {
+            VIR_DEBUG("DHCP snooping thread was asked to stop");
             break;
         }
 
-        /* cap pollTo so we don't hold up the join for too long */
-        if (pollTo < 0 || pollTo > SNOOP_POLL_MAX_TIMEOUT_MS)
-            pollTo = SNOOP_POLL_MAX_TIMEOUT_MS;
+        if (time(0) != lastSweep) {
+            virNWFilterSnoopCaptureSweep();
+            lastSweep = time(0);
+        }
 
-        n = poll(fds, G_N_ELEMENTS(fds), pollTo);
+        if (n <= 0 || !fds[0].revents)
+            continue;
 
-        if (n < 0) {
+        len = recvfrom(fds[0].fd, packet, sizeof(packet), 0,
+                       (struct sockaddr *)&sll, &slen);
+        if (len < 0) {
             if (errno != EAGAIN && errno != EINTR)
-                error = true;
+                VIR_WARN("Failed to read from DHCP snooping socket: %s",
+                         g_strerror(errno));
+            continue;
         }
 
-        virNWFilterSnoopReqLeaseTimerRun(req);
+        if (!(req = virNWFilterSnoopCaptureGetReq(sll.sll_ifindex)))
+            continue;
 
-        /*
-         * Check whether we were cancelled or whether
-         * a previously submitted job failed.
-         */
-        if (!virNWFilterSnoopIsActive(threadkey) ||
-            req->jobCompletionStatus != 0)
-            goto exit;
+        /* what the host sends out on the tap device goes to the VM */
+        if (virNWFilterSnoopCapturePacket(req,
+                                          (virNWFilterSnoopEthHdrPtr)packet,
+                                          len,
+                                          sll.sll_pkttype != PACKET_OUTGOING) < 0)
+            virNWFilterSnoopCaptureRemove(req, sll.sll_ifindex, true);
 
-        for (i = 0; n > 0 && i < G_N_ELEMENTS(fds); i++) {
-            if (!fds[i].revents)
-                continue;
+        virNWFilterSnoopReqPut(req);
+    }
+}
 
-            fds[i].revents = 0;
-            n--;
+/*
+ * Start the capture thread unless it's running already.
+ * Must be called with the capture lock held.
+ */
+static int
+virNWFilterSnoopCaptureStart(void)
+{
+    if (virNWFilterSnoopState.captureRunning)
+        return 0;
 
-            rv = pcap_next_ex(pcapConf[i].handle, &hdr,
-                              (const u_char **)&packet);
+    if (!virNWFilterSnoopState.decodePool) {
+        if (!(virNWFilterSnoopState.decodePool =
+              virThreadPoolNewFull(1, DHCP_DECODE_WORKERS, 0,
+                                   virNWFilterDHCPDecodeWorker,
+                                   "dhcp-decode",
+                                   NULL, 0)))
+            return -1;
 
-            if (rv < 0) {
-                /* error reading from socket */
-                tmp = -1;
+        if (virTunableRegisterThreadPool("nwfilter.dhcp-decode-workers",
+                                         virNWFilterSnoopState.decodePool) < 0) {
+            VIR_WARN("Unable to register DHCP decode pool tunable: %s",
+                     virGetLastErrorMessage());
+            virResetLastError();
+        }
+    }
 
-                /* protect req->binding->portdevname */
-                virNWFilterSnoopReqLock(req);
+    if ((virNWFilterSnoopState.captureFD = virNWFilterSnoopCaptureOpen()) < 0)
+        return -1;
 
-                if (req->binding->portdevname)
-                    tmp = virNetDevValidateConfig(req->binding->portdevname, NULL, ifindex);
+    if (virPipe(virNWFilterSnoopState.captureWakeupFDs) < 0)
+        goto error;
 
-                virNWFilterSnoopReqUnlock(req);
+    if (virThreadCreateFull(&virNWFilterSnoopState.captureThread, true,
+                            virNWFilterSnoopCaptureThread,
+                            "dhcp-snoop", false, NULL) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create DHCP snooping thread"));
+        goto error;
+    }
 
-                if (tmp <= 0) {
-                    error = true;
-                    break;
-                }
+    virNWFilterSnoopState.captureRunning = true;
 
-                if (++errcount > PCAP_READ_MAXERRS) {
-                    pcap_close(pcapConf[i].handle);
-                    pcapConf[i].handle = NULL;
+    return 0;
 
-                    /* protect req->binding->portdevname */
-                    virNWFilterSnoopReqLock(req);
+ error:
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.captureFD);
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.captureWakeupFDs[0]);
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.captureWakeupFDs[1]);
+    return -1;
+}
 
-                    virReportError(VIR_ERR_INTERNAL_ERROR,
-                                   _("interface '%s' failing; "
-                                     "reopening"),
-                                   req->binding->portdevname);
-                    if (req->binding->portdevname)
-                        pcapConf[i].handle =
-                            virNWFilterSnoopDHCPOpen(req->binding->portdevname,
-                                                     &req->binding->mac,
-                                                     pcapConf[i].filter,
-                                                     pcapConf[i].dir);
+/*
+ * Pass the packets of the interface of @req to it, taking over the
+ * caller's reference to @req.
+ * Must be called with the lock of @req held.
+ */
+static int
+virNWFilterSnoopCaptureAdd(virNWFilterSnoopReqPtr req)
+{
+    char key[VIR_INT64_STR_BUFLEN];
+    virNWFilterSnoopReqPtr old;
+    int ret = -1;
 
-                    virNWFilterSnoopReqUnlock(req);
+    g_snprintf(key, sizeof(key), "%d", req->ifindex);
 
-                    if (!pcapConf[i].handle) {
-                        error = true;
-                        break;
-                    }
-                }
-                continue;
-            }
+    virNWFilterSnoopCaptureLock();
 
-            errcount = 0;
-
-            if (rv) {
-                unsigned int diff;
-
-                /* submit packet to worker thread */
-                if (g_atomic_int_get(&pcapConf[i].qCtr) >
-                    pcapConf[i].maxQSize) {
-                    if (last_displayed_queue - time(0) > 10) {
-                        last_displayed_queue = time(0);
-                        VIR_WARN("Worker thread for interface '%s' has a "
-                                 "job queue that is too long",
-                                 req->binding->portdevname);
-                    }
-                    continue;
-                }
-
-                diff = virNWFilterSnoopRateLimit(&pcapConf[i].rateLimit);
-                if (diff > 0) {
-                    virNWFilterSnoopRatePenalty(&pcapConf[i], diff,
-                                                DHCP_PKT_RATE);
-                    /* rate-limited warnings */
-                    if (time(0) - last_displayed > 10) {
-                         last_displayed = time(0);
-                         VIR_WARN("Too many DHCP packets on interface '%s'",
-                                  req->binding->portdevname);
-                    }
-                    continue;
-                }
-
-                if (virNWFilterSnoopDHCPDecodeJobSubmit(worker, packet,
-                                                      hdr->caplen,
-                                                      pcapConf[i].dir,
-                                                      &pcapConf[i].qCtr) < 0) {
-                    virReportError(VIR_ERR_INTERNAL_ERROR,
-                                   _("Job submission failed on "
-                                     "interface '%s'"), req->binding->portdevname);
-                    error = true;
-                    break;
-                }
-            }
-        } /* for all fds */
-    } /* while (!error) */
+    if (virNWFilterSnoopCaptureStart() < 0) {
+        virNWFilterSnoopCaptureUnlock();
+        return -1;
+    }
 
-    /* protect IfNameToKey */
-    virNWFilterSnoopLock();
+    /* the sweep may not have noticed yet that a previous user of the
+     * interface index is gone */
+    old = virHashSteal(virNWFilterSnoopState.captureReqs, key);
 
-    /* protect req->binding->portdevname & req->threadkey */
-    virNWFilterSnoopReqLock(req);
+    if (virHashAddEntry(virNWFilterSnoopState.captureReqs, key, req) == 0)
+        ret = 0;
 
-    virNWFilterSnoopCancel(&req->threadkey);
+    virNWFilterSnoopCaptureUnlock();
 
-    ignore_value(virHashRemoveEntry(virNWFilterSnoopState.ifnameToKey,
-                                    req->binding->portdevname));
+    virNWFilterSnoopReqPut(old);
 
-    VIR_FREE(req->binding->portdevname);
+    return ret;
+}
 
-    virNWFilterSnoopReqUnlock(req);
-    virNWFilterSnoopUnlock();
+/*
+ * Stop the capture thread and drop all requests it held
+ */
+static void
+virNWFilterSnoopCaptureStop(void)
+{
+    virHashKeyValuePairPtr items;
+    bool running;
+    size_t i;
 
- exit:
-    virThreadPoolFree(worker);
+    virNWFilterSnoopCaptureLock();
+    running = virNWFilterSnoopState.captureRunning;
+    virNWFilterSnoopState.captureRunning = false;
+    virNWFilterSnoopCaptureUnlock();
 
-    virNWFilterSnoopReqPut(req);
+    if (running) {
+        char stop = 1;
 
-    VIR_FREE(threadkey);
+        if (safewrite(virNWFilterSnoopState.captureWakeupFDs[1],
+                      &stop, 1) != 1)
+            VIR_WARN("Failed to wake up DHCP snooping thread");
 
-    for (i = 0; i < G_N_ELEMENTS(pcapConf); i++) {
-        if (pcapConf[i].handle)
-            pcap_close(pcapConf[i].handle);
+        virThreadJoin(&virNWFilterSnoopState.captureThread);
     }
 
-    ignore_value(!!g_atomic_int_dec_and_test(&virNWFilterSnoopState.nThreads));
+    /* wait for the jobs which are being decoded */
+    virTunableUnregister("nwfilter.dhcp-decode-workers");
+    virThreadPoolFree(virNWFilterSnoopState.decodePool);
+    virNWFilterSnoopState.decodePool = NULL;
 
-    return;
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.captureFD);
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.captureWakeupFDs[0]);
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.captureWakeupFDs[1]);
+
+    virNWFilterSnoopCaptureLock();
+    items = virHashGetItems(virNWFilterSnoopState.captureReqs, NULL);
+    virHashRemoveAll(virNWFilterSnoopState.captureReqs);
+    virNWFilterSnoopCaptureUnlock();
+
+    for (i = 0; items && items[i].key; i++)
+        virNWFilterSnoopReqPut((virNWFilterSnoopReqPtr)items[i].value);
+    VIR_FREE(items);
 }
 
 static void
@@ -1566,9 +1691,7 @@ virNWFilterDHCPSnoopReq(virNWFilterTechDriverPtr techdriver,
     bool isnewreq;
     char ifkey[VIR_IFKEY_LEN];
     int tmp;
-    virThread thread;
     virNWFilterVarValuePtr dhcpsrvrs;
-    bool threadPuts = false;
 
     virNWFilterSnoopIFKeyFMT(ifkey, binding->owneruuid, &binding->mac);
 
@@ -1636,21 +1759,9 @@ virNWFilterDHCPSnoopReq(virNWFilterTechDriverPtr techdriver,
         goto exit_rem_ifnametokey;
     }
 
-    /* prevent thread from holding req */
+    /* prevent the capture thread from using req */
     virNWFilterSnoopReqLock(req);
 
-    if (virThreadCreateFull(&thread, false, virNWFilterDHCPSnoopThread,
-                            "dhcp-snoop", false, req) != 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("virNWFilterDHCPSnoopReq virThreadCreate "
-                         "failed on interface '%s'"), binding->portdevname);
-        goto exit_snoopreq_unlock;
-    }
-
-    threadPuts = true;
-
-    g_atomic_int_add(&virNWFilterSnoopState.nThreads, 1);
-
     req->threadkey = virNWFilterSnoopActivate(req);
     if (!req->threadkey) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
@@ -1666,23 +1777,14 @@ virNWFilterDHCPSnoopReq(virNWFilterTechDriverPtr techdriver,
         goto exit_snoop_cancel;
     }
 
-    /* sync with thread */
-    if (virCondWait(&req->threadStatusCond, &req->lock) < 0) {
-        virReportSystemError(errno, "%s",
-                             _("unable to wait on dhcp snoop thread"));
-        goto exit_snoop_cancel;
-    }
-
-    if (req->threadStatus != THREAD_STATUS_OK) {
-        virErrorRestore(&req->threadError);
+    if (virNWFilterSnoopCaptureAdd(req) < 0)
         goto exit_snoop_cancel;
-    }
 
     virNWFilterSnoopReqUnlock(req);
 
     virNWFilterSnoopUnlock();
 
-    /* do not 'put' the req -- the thread will do this */
+    /* do not 'put' the req -- the capture thread will do this */
 
     return 0;
 
@@ -1695,8 +1797,7 @@ virNWFilterDHCPSnoopReq(virNWFilterTechDriverPtr techdriver,
  exit_snoopunlock:
     virNWFilterSnoopUnlock();
  exit_snoopreqput:
-    if (!threadPuts)
-        virNWFilterSnoopReqPut(req);
+    virNWFilterSnoopReqPut(req);
 
     return -1;
 }
@@ -1716,6 +1817,26 @@ virNWFilterSnoopLeaseFileOpen(void)
                                          0644);
 }
 
+/*
+ * Format a single lease as a line of the lease file.
+ */
+static int
+virNWFilterSnoopLeaseFileFormat(virBufferPtr buf, const char *ifkey,
+                                virNWFilterSnoopIPLeasePtr ipl)
+{
+    g_autofree char *ipstr = virSocketAddrFormat(&ipl->ipAddress);
+    g_autofree char *dhcpstr = virSocketAddrFormat(&ipl->ipServer);
+
+    if (!dhcpstr || !ipstr)
+        return -1;
+
+    /* time intf ip dhcpserver */
+    virBufferAsprintf(buf, "%u %s %s %s\n",
+                      ipl->timeout, ifkey, ipstr, dhcpstr);
+
+    return 0;
+}
+
 /*
  * Write a single lease to the given file.
  *
@@ -1724,42 +1845,29 @@ static int
 virNWFilterSnoopLeaseFileWrite(int lfd, const char *ifkey,
                                virNWFilterSnoopIPLeasePtr ipl)
 {
-    char *lbuf = NULL;
-    char *ipstr, *dhcpstr;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    const char *lbuf;
     int len;
-    int ret = 0;
 
-    ipstr = virSocketAddrFormat(&ipl->ipAddress);
-    dhcpstr = virSocketAddrFormat(&ipl->ipServer);
-
-    if (!dhcpstr || !ipstr) {
-        ret = -1;
-        goto cleanup;
-    }
+    if (virNWFilterSnoopLeaseFileFormat(&buf, ifkey, ipl) < 0)
+        return -1;
 
-    /* time intf ip dhcpserver */
-    lbuf = g_strdup_printf("%u %s %s %s\n", ipl->timeout, ifkey, ipstr, dhcpstr);
+    lbuf = virBufferCurrentContent(&buf);
     len = strlen(lbuf);
 
     if (safewrite(lfd, lbuf, len) != len) {
         virReportSystemError(errno, "%s", _("lease file write failed"));
-        ret = -1;
-        goto cleanup;
+        return -1;
     }
 
     ignore_value(g_fsync(lfd));
 
- cleanup:
-    VIR_FREE(lbuf);
-    VIR_FREE(dhcpstr);
-    VIR_FREE(ipstr);
-
-    return ret;
+    return 0;
 }
 
 /*
  * Append a single lease to the end of the lease file.
- * To keep a limited number of dead leases, re-read the lease
+ * To keep a limited number of dead leases, compact the lease
  * file if the threshold of active leases versus written ones
  * exceeds a threshold.
  */
@@ -1776,10 +1884,11 @@ virNWFilterSnoopLeaseFileSave(virNWFilterSnoopIPLeasePtr ipl)
                                        req->ifkey, ipl) < 0)
         goto err_exit;
 
-    /* keep dead leases at < ~95% of file size */
+    /* keep dead leases at < ~95% of file size; the leases in memory
+     * are up to date, so there's no need to read the file again */
     if (g_atomic_int_add(&virNWFilterSnoopState.wLeases, 1) >=
         g_atomic_int_get(&virNWFilterSnoopState.nLeases) * 20)
-        virNWFilterSnoopLeaseFileLoad();   /* load & refresh lease file */
+        virNWFilterSnoopLeaseFileRefresh();
 
  err_exit:
     virNWFilterSnoopUnlock();
@@ -1817,7 +1926,7 @@ virNWFilterSnoopPruneIter(const void *payload,
 }
 
 /*
- * Iterator to write all leases of a single request to a file.
+ * Iterator to format all leases of a single request into a buffer.
  * Call this function with the SnoopLock held.
  */
 static int
@@ -1826,14 +1935,14 @@ virNWFilterSnoopSaveIter(void *payload,
                          void *data)
 {
     virNWFilterSnoopReqPtr req = payload;
-    int tfd = *(int *)data;
+    virBufferPtr buf = data;
     virNWFilterSnoopIPLeasePtr ipl;
 
     /* protect req->start */
     virNWFilterSnoopReqLock(req);
 
     for (ipl = req->start; ipl; ipl = ipl->next)
-        ignore_value(virNWFilterSnoopLeaseFileWrite(tfd, req->ifkey, ipl));
+        ignore_value(virNWFilterSnoopLeaseFileFormat(buf, req->ifkey, ipl));
 
     virNWFilterSnoopReqUnlock(req);
     return 0;
@@ -1841,12 +1950,17 @@ virNWFilterSnoopSaveIter(void *payload,
 
 /*
  * Write all valid leases into a temporary file and then
- * rename the file to the final file.
+ * rename the file to the final file. The file is written and
+ * synced in one go, so the cost only depends on the number of
+ * valid leases.
  * Call this function with the SnoopLock held.
  */
 static void
 virNWFilterSnoopLeaseFileRefresh(void)
 {
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    const char *content;
+    int len;
     int tfd;
 
     if (virFileMakePathWithMode(LEASEFILE_DIR, 0700) < 0) {
@@ -1870,9 +1984,21 @@ virNWFilterSnoopLeaseFileRefresh(void)
                          virNWFilterSnoopPruneIter, NULL);
         /* now save them */
         virHashForEach(virNWFilterSnoopState.snoopReqs,
-                       virNWFilterSnoopSaveIter, (void *)&tfd);
+                       virNWFilterSnoopSaveIter, &buf);
     }
 
+    content = virBufferCurrentContent(&buf);
+    len = strlen(content);
+
+    if (safewrite(tfd, content, len) != len) {
+        virReportSystemError(errno, _("unable to write %s"), TMPLEASEFILE);
+        VIR_FORCE_CLOSE(tfd);
+        unlink(TMPLEASEFILE);
+        goto skip_rename;
+    }
+
+    ignore_value(g_fsync(tfd));
+
     if (VIR_CLOSE(tfd) < 0) {
         virReportSystemError(errno, _("unable to close %s"), TMPLEASEFILE);
         /* assuming the old lease file is still better, skip the renaming */
@@ -1891,93 +2017,176 @@ virNWFilterSnoopLeaseFileRefresh(void)
 }
 
 
-static void
-virNWFilterSnoopLeaseFileLoad(void)
+/*
+ * A lease as last recorded in the lease file
+ */
+typedef struct _virNWFilterSnoopLeaseRecord virNWFilterSnoopLeaseRecord;
+typedef virNWFilterSnoopLeaseRecord *virNWFilterSnoopLeaseRecordPtr;
+
+struct _virNWFilterSnoopLeaseRecord {
+    char ifkey[VIR_IFKEY_LEN];
+    virNWFilterSnoopIPLease ipl;
+};
+
+/*
+ * Parse the lines of the lease file from @fp on into @records, keyed
+ * by interface key and IP address. Later lines replace earlier ones,
+ * expired and deleted leases are dropped.
+ *
+ * Returns -1 if a corrupt line was found, 0 otherwise.
+ */
+static int
+virNWFilterSnoopLeaseFileParse(FILE *fp,
+                               virHashTablePtr records,
+                               int *ln)
 {
     char line[256], ifkey[VIR_IFKEY_LEN];
     char ipstr[INET_ADDRSTRLEN], srvstr[INET_ADDRSTRLEN];
-    virNWFilterSnoopIPLease ipl;
-    virNWFilterSnoopReqPtr req;
-    time_t now;
-    FILE *fp;
-    int ln = 0, tmp;
+    time_t now = time(0);
 
-    /* protect the lease file */
-    virNWFilterSnoopLock();
+    while (fgets(line, sizeof(line), fp)) {
+        g_autofree char *key = NULL;
+        virNWFilterSnoopLeaseRecordPtr rec;
+        unsigned int timeout;
 
-    fp = fopen(LEASEFILE, "r");
-    time(&now);
-    while (fp && fgets(line, sizeof(line), fp)) {
         if (line[strlen(line)-1] != '\n') {
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("virNWFilterSnoopLeaseFileLoad lease file "
-                             "line %d corrupt"), ln);
-            break;
+                             "line %d corrupt"), *ln);
+            return -1;
         }
-        ln++;
+        (*ln)++;
         /* key len 54 = "VMUUID"+'-'+"MAC" */
-        if (sscanf(line, "%u %54s %15s %15s", &ipl.timeout,
+        if (sscanf(line, "%u %54s %15s %15s", &timeout,
                    ifkey, ipstr, srvstr) < 4) {
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("virNWFilterSnoopLeaseFileLoad lease file "
-                             "line %d corrupt"), ln);
-            break;
+                             "line %d corrupt"), *ln);
+            return -1;
         }
-        if (ipl.timeout && ipl.timeout < now)
-            continue;
-        req = virNWFilterSnoopReqGetByIFKey(ifkey);
-        if (!req) {
-            req = virNWFilterSnoopReqNew(ifkey);
-            if (!req)
-               break;
 
-            tmp = virHashAddEntry(virNWFilterSnoopState.snoopReqs, ifkey, req);
+        key = g_strdup_printf("%s %s", ifkey, ipstr);
 
-            if (tmp < 0) {
-                virNWFilterSnoopReqPut(req);
-                virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("virNWFilterSnoopLeaseFileLoad req add"
-                                 " failed on interface \"%s\""), ifkey);
-                continue;
-            }
+        if (!timeout || timeout < now) {
+            ignore_value(virHashRemoveEntry(records, key));
+            continue;
         }
 
-        if (virSocketAddrParseIPv4(&ipl.ipAddress, ipstr) < 0) {
+        rec = g_new0(virNWFilterSnoopLeaseRecord, 1);
+        rec->ipl.timeout = timeout;
+
+        if (virStrcpyStatic(rec->ifkey, ifkey) < 0 ||
+            virSocketAddrParseIPv4(&rec->ipl.ipAddress, ipstr) < 0) {
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("line %d corrupt ipaddr \"%s\""),
-                           ln, ipstr);
-            virNWFilterSnoopReqPut(req);
+                           *ln, ipstr);
+            VIR_FREE(rec);
             continue;
         }
-        ignore_value(virSocketAddrParseIPv4(&ipl.ipServer, srvstr));
-        ipl.snoopReq = req;
-
-        if (ipl.timeout)
-            virNWFilterSnoopReqLeaseAdd(req, &ipl, false);
-        else
-            virNWFilterSnoopReqLeaseDel(req, &ipl.ipAddress, false, false);
+        ignore_value(virSocketAddrParseIPv4(&rec->ipl.ipServer, srvstr));
 
-        virNWFilterSnoopReqPut(req);
+        if (virHashUpdateEntry(records, key, rec) < 0) {
+            VIR_FREE(rec);
+            return -1;
+        }
     }
 
-    VIR_FORCE_FCLOSE(fp);
+    return 0;
+}
 
-    virNWFilterSnoopLeaseFileRefresh();
+/*
+ * Whether @fp still is the lease file, i.e., it wasn't compacted
+ */
+static bool
+virNWFilterSnoopLeaseFileIsCurrent(FILE *fp)
+{
+    struct stat fpsb, sb;
 
-    virNWFilterSnoopUnlock();
+    if (fstat(fileno(fp), &fpsb) < 0 ||
+        stat(LEASEFILE, &sb) < 0)
+        return false;
+
+    return fpsb.st_dev == sb.st_dev && fpsb.st_ino == sb.st_ino;
 }
 
 /*
- * Wait until all threads have ended.
+ * Load the leases from the lease file. The bulk of the file is parsed
+ * without the SnoopLock held; only the lines appended meanwhile are
+ * read with it held, before the leases are added to their requests
+ * and the file is compacted.
  */
 static void
-virNWFilterSnoopJoinThreads(void)
+virNWFilterSnoopLeaseFileLoad(void)
 {
-    while (g_atomic_int_get(&virNWFilterSnoopState.nThreads) != 0) {
-        VIR_WARN("Waiting for snooping threads to terminate: %u",
-                 g_atomic_int_get(&virNWFilterSnoopState.nThreads));
-        g_usleep(1000 * 1000);
+    virHashTablePtr records;
+    virHashKeyValuePairPtr items = NULL;
+    virNWFilterSnoopReqPtr req;
+    FILE *fp;
+    int ln = 0;
+    int rc = 0;
+    size_t i;
+
+    if (!(records = virHashCreate(0, virHashValueFree)))
+        return;
+
+    if ((fp = fopen(LEASEFILE, "r")))
+        rc = virNWFilterSnoopLeaseFileParse(fp, records, &ln);
+
+    /* protect the lease file */
+    virNWFilterSnoopLock();
+
+    if (fp && rc == 0) {
+        if (virNWFilterSnoopLeaseFileIsCurrent(fp)) {
+            clearerr(fp);
+        } else {
+            /* compacted in the meantime, start over */
+            VIR_FORCE_FCLOSE(fp);
+            virHashRemoveAll(records);
+            ln = 0;
+            fp = fopen(LEASEFILE, "r");
+        }
+
+        if (fp)
+            ignore_value(virNWFilterSnoopLeaseFileParse(fp, records, &ln));
+    }
+
+    VIR_FORCE_FCLOSE(fp);
+
+    if (!(items = virHashGetItems(records, NULL)))
+        goto cleanup;
+
+    for (i = 0; items[i].key; i++) {
+        virNWFilterSnoopLeaseRecordPtr rec = (void *)items[i].value;
+
+        req = virNWFilterSnoopReqGetByIFKey(rec->ifkey);
+        if (!req) {
+            req = virNWFilterSnoopReqNew(rec->ifkey);
+            if (!req)
+               break;
+
+            if (virHashAddEntry(virNWFilterSnoopState.snoopReqs,
+                                rec->ifkey, req) < 0) {
+                virNWFilterSnoopReqPut(req);
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("virNWFilterSnoopLeaseFileLoad req add"
+                                 " failed on interface \"%s\""), rec->ifkey);
+                continue;
+            }
+        }
+
+        rec->ipl.snoopReq = req;
+        virNWFilterSnoopReqLeaseAdd(req, &rec->ipl, false);
+
+        virNWFilterSnoopReqPut(req);
     }
+
+ cleanup:
+    virNWFilterSnoopLeaseFileRefresh();
+
+    virNWFilterSnoopUnlock();
+
+    VIR_FREE(items);
+    virHashFree(records);
 }
 
 /*
@@ -2003,7 +2212,7 @@ virNWFilterSnoopRemAllReqIter(const void *payload,
 
         /*
          * Remove all IP addresses known to be associated with this
-         * interface so that a new thread will be started on this
+         * interface so that snooping will be started again on this
          * interface
          */
         virNWFilterIPAddrMapDelIPAddr(req->binding->portdevname, NULL);
@@ -2019,7 +2228,7 @@ virNWFilterSnoopRemAllReqIter(const void *payload,
 
 
 /*
- * Terminate all threads; keep the SnoopReqs hash allocated
+ * Stop snooping on all interfaces; keep the SnoopReqs hash allocated
  */
 static void
 virNWFilterSnoopEndThreads(void)
@@ -2040,17 +2249,20 @@ virNWFilterDHCPSnoopInit(void)
     VIR_DEBUG("Initializing DHCP snooping");
 
     if (virMutexInitRecursive(&virNWFilterSnoopState.snoopLock) < 0 ||
-        virMutexInit(&virNWFilterSnoopState.activeLock) < 0)
+        virMutexInit(&virNWFilterSnoopState.activeLock) < 0 ||
+        virMutexInit(&virNWFilterSnoopState.captureLock) < 0)
         return -1;
 
     virNWFilterSnoopState.ifnameToKey = virHashCreate(0, NULL);
     virNWFilterSnoopState.active = virHashCreate(0, NULL);
     virNWFilterSnoopState.snoopReqs =
         virHashCreate(0, virNWFilterSnoopReqRelease);
+    virNWFilterSnoopState.captureReqs = virHashCreate(0, NULL);
 
     if (!virNWFilterSnoopState.ifnameToKey ||
         !virNWFilterSnoopState.snoopReqs ||
-        !virNWFilterSnoopState.active)
+        !virNWFilterSnoopState.active ||
+        !virNWFilterSnoopState.captureReqs)
         goto err_exit;
 
     virNWFilterSnoopLeaseFileLoad();
@@ -2068,6 +2280,9 @@ virNWFilterDHCPSnoopInit(void)
     virHashFree(virNWFilterSnoopState.active);
     virNWFilterSnoopState.active = NULL;
 
+    virHashFree(virNWFilterSnoopState.captureReqs);
+    virNWFilterSnoopState.captureReqs = NULL;
+
     return -1;
 }
 
@@ -2141,7 +2356,7 @@ void
 virNWFilterDHCPSnoopShutdown(void)
 {
     virNWFilterSnoopEndThreads();
-    virNWFilterSnoopJoinThreads();
+    virNWFilterSnoopCaptureStop();
 
     virNWFilterSnoopLock();
 
@@ -2154,6 +2369,10 @@ virNWFilterDHCPSnoopShutdown(void)
     virNWFilterSnoopActiveLock();
     virHashFree(virNWFilterSnoopState.active);
     virNWFilterSnoopActiveUnlock();
+
+    virNWFilterSnoopCaptureLock();
+    virHashFree(virNWFilterSnoopState.captureReqs);
+    virNWFilterSnoopCaptureUnlock();
 }
 
 #else /* HAVE_LIBPCAP */
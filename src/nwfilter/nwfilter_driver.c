@@ -36,9 +36,11 @@
 #include "domain_nwfilter.h"
 #include "nwfilter_driver.h"
 #include "nwfilter_gentech_driver.h"
+#include "nwfilter_ebiptables_driver.h"
 #include "configmake.h"
 #include "virfile.h"
 #include "virpidfile.h"
+#include "virconf.h"
 #include "virstring.h"
 #include "viraccessapicheck.h"
 
@@ -161,6 +163,30 @@ nwfilterDriverInstallDBusMatches(DBusConnection *sysbus G_GNUC_UNUSED)
 
 #endif /* WITH_FIREWALLD */
 
+static int
+nwfilterLoadDriverConfig(virNWFilterDriverStatePtr nwdriver,
+                         const char *filename)
+{
+    g_autoptr(virConf) conf = NULL;
+
+    /* Avoid error from non-existent or unreadable file. */
+    if (access(filename, R_OK) == -1)
+        return 0;
+
+    if (!(conf = virConfReadFile(filename, 0)))
+        return -1;
+
+    if (virConfGetValueString(conf, "tech_driver", &nwdriver->techDriverName) < 0)
+        return -1;
+
+    if (virConfGetValueBool(conf, "ebiptables_shared_chains",
+                            &nwdriver->sharedChains) < 0)
+        return -1;
+
+    return 0;
+}
+
+
 static int
 virNWFilterTriggerRebuildImpl(void *opaque)
 {
@@ -224,6 +250,9 @@ nwfilterStateInitialize(bool privileged,
          virPidFileAcquire(driver->stateDir, "driver", false, getpid())) < 0)
         goto error;
 
+    if (nwfilterLoadDriverConfig(driver, SYSCONFDIR "/libvirt/nwfilter.conf") < 0)
+        goto error;
+
     if (virNWFilterIPAddrMapInit() < 0)
         goto err_free_driverstate;
     if (virNWFilterLearnInit() < 0)
@@ -231,7 +260,9 @@ nwfilterStateInitialize(bool privileged,
     if (virNWFilterDHCPSnoopInit() < 0)
         goto err_exit_learnshutdown;
 
-    if (virNWFilterTechDriversInit(privileged) < 0)
+    ebiptablesSetSharedChains(driver->sharedChains);
+
+    if (virNWFilterTechDriversInit(privileged, driver->techDriverName) < 0)
         goto err_dhcpsnoop_shutdown;
 
     if (virNWFilterConfLayerInit(virNWFilterTriggerRebuildImpl,
@@ -371,6 +402,7 @@ nwfilterStateCleanup(void)
         VIR_FREE(driver->stateDir);
         VIR_FREE(driver->configDir);
         VIR_FREE(driver->bindingDir);
+        VIR_FREE(driver->techDriverName);
         nwfilterDriverUnlock();
     }
 
@@ -90,6 +90,25 @@ static enum ctdirStatus iptables_ctdir_corrected;
 
 static bool newMatchState;
 
+/* Interfaces whose iptables rules are identical jump into one set of
+ * shared chains holding them rather than getting their own copy. A
+ * shared chain is named like a temporary root chain of the pseudo
+ * interface name returned by ebiptablesSharedChainId and never renamed.
+ * The lock serializes all changes to the chains while the mode is on. */
+static bool sharedChains;
+static virMutex sharedChainsLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr sharedChainRefs;     /* id -> size_t *refs */
+static virHashTablePtr sharedChainIfaces;   /* ifname -> ...IfacePtr */
+
+typedef struct _ebiptablesSharedChainIface ebiptablesSharedChainIface;
+typedef ebiptablesSharedChainIface *ebiptablesSharedChainIfacePtr;
+struct _ebiptablesSharedChainIface {
+    /* ids of the shared chains the final and the temporary root chains
+     * of an interface jump into, per layer; each holds a reference */
+    char *active[VIR_FIREWALL_LAYER_LAST];
+    char *pending[VIR_FIREWALL_LAYER_LAST];
+};
+
 #define MATCH_PHYSDEV_IN_FW   "-m", "physdev", "--physdev-in"
 #define MATCH_PHYSDEV_OUT_FW  "-m", "physdev", "--physdev-is-bridged", "--physdev-out"
 #define MATCH_PHYSDEV_OUT_OLD_FW  "-m", "physdev", "--physdev-out"
@@ -3356,6 +3375,260 @@ ebtablesGetSubChainInsts(virHashTablePtr chains,
 
 }
 
+static void
+ebiptablesSharedChainIfaceFree(void *payload)
+{
+    ebiptablesSharedChainIfacePtr iface = payload;
+    size_t i;
+
+    if (!iface)
+        return;
+
+    for (i = 0; i < VIR_FIREWALL_LAYER_LAST; i++) {
+        VIR_FREE(iface->active[i]);
+        VIR_FREE(iface->pending[i]);
+    }
+    VIR_FREE(iface);
+}
+
+
+static void
+ebiptablesSharedChainsLock(void)
+{
+    if (sharedChains)
+        virMutexLock(&sharedChainsLock);
+}
+
+
+static void
+ebiptablesSharedChainsUnlock(void)
+{
+    if (sharedChains)
+        virMutexUnlock(&sharedChainsLock);
+}
+
+
+/**
+ * ebiptablesSetSharedChains:
+ * @enable: whether interfaces with identical rules share their chains
+ *
+ * Must be called before the driver is initialized.
+ */
+void
+ebiptablesSetSharedChains(bool enable)
+{
+    sharedChains = enable;
+}
+
+
+/* Returns the pseudo interface name the shared chains holding the
+ * @layer rules out of @rules are named after, or NULL on error. */
+static char *
+ebiptablesSharedChainId(virFirewallLayer layer,
+                        virNWFilterRuleInstPtr *rules,
+                        size_t nrules)
+{
+    g_autofree char *digest = NULL;
+
+    if (!(digest = virNWFilterRuleInstsDigest(rules, nrules,
+                                              layer == VIR_FIREWALL_LAYER_IPV6 ?
+                                              virNWFilterRuleIsProtocolIPv6 :
+                                              virNWFilterRuleIsProtocolIPv4)))
+        return NULL;
+
+    /* chain names are short, part of the digest tells rule sets apart */
+    return g_strdup_printf("S%c:%.16s",
+                           layer == VIR_FIREWALL_LAYER_IPV6 ? '6' : '4',
+                           digest);
+}
+
+
+static int
+ebiptablesSharedChainRef(const char *id)
+{
+    size_t *refs = virHashLookup(sharedChainRefs, id);
+
+    if (!refs) {
+        refs = g_new0(size_t, 1);
+        if (virHashAddEntry(sharedChainRefs, id, refs) < 0) {
+            VIR_FREE(refs);
+            return -1;
+        }
+    }
+
+    (*refs)++;
+    return 0;
+}
+
+
+/* Drops the reference @id holds and frees it; the chains are removed
+ * through @fw once nobody jumps into them anymore. */
+static void
+ebiptablesSharedChainUnref(virFirewallPtr fw,
+                           virFirewallLayer layer,
+                           char **id)
+{
+    size_t *refs;
+
+    if (!*id)
+        return;
+
+    if ((refs = virHashLookup(sharedChainRefs, *id)) && --(*refs) == 0) {
+        iptablesRemoveTmpRootChainsFW(fw, layer, *id);
+        virHashRemoveEntry(sharedChainRefs, *id);
+    }
+
+    VIR_FREE(*id);
+}
+
+
+static void
+iptablesCreateSharedChainsFW(virFirewallPtr fw,
+                             virFirewallLayer layer,
+                             const char *id)
+{
+    char chain[MAX_CHAINNAME_LENGTH];
+    const char *prefixes[] = { "FP", "FJ", "HJ" };
+    size_t i;
+
+    /* chains left behind by a previous run are simply refilled */
+    for (i = 0; i < G_N_ELEMENTS(prefixes); i++) {
+        PRINT_IPT_ROOT_CHAIN(chain, prefixes[i], id);
+        virFirewallAddRuleFull(fw, layer,
+                               true, NULL, NULL,
+                               "-N", chain, NULL);
+    }
+}
+
+
+static int
+iptablesApplySharedChainsFW(virFirewallPtr fw,
+                            virFirewallLayer layer,
+                            const char *ifname,
+                            const char *id,
+                            bool fill,
+                            virNWFilterRuleInstPtr *rules,
+                            size_t nrules)
+{
+    char chain[MAX_CHAINNAME_LENGTH], shared[MAX_CHAINNAME_LENGTH];
+    const char *prefixes[] = { "FP", "FJ", "HJ" };
+    size_t i;
+
+    for (i = 0; fill && i < G_N_ELEMENTS(prefixes); i++) {
+        PRINT_IPT_ROOT_CHAIN(shared, prefixes[i], id);
+        virFirewallAddRule(fw, layer,
+                           "-F", shared, NULL);
+    }
+
+    for (i = 0; fill && i < nrules; i++) {
+        if (layer == VIR_FIREWALL_LAYER_IPV6 ?
+            !virNWFilterRuleIsProtocolIPv6(rules[i]->def) :
+            !virNWFilterRuleIsProtocolIPv4(rules[i]->def))
+            continue;
+
+        if (iptablesRuleInstCommand(fw, id, rules[i]) < 0)
+            return -1;
+    }
+
+    /* with -g a RETURN in the shared chain behaves just like one in
+     * the chain of the interface */
+    for (i = 0; i < G_N_ELEMENTS(prefixes); i++) {
+        PRINT_IPT_ROOT_CHAIN(chain, prefixes[i], ifname);
+        PRINT_IPT_ROOT_CHAIN(shared, prefixes[i], id);
+        virFirewallAddRule(fw, layer,
+                           "-A", chain, "-g", shared, NULL);
+    }
+
+    return 0;
+}
+
+
+/* The temporary root chains of @ifname are going away */
+static void
+ebiptablesSharedChainsTearNewFW(virFirewallPtr fw,
+                                const char *ifname)
+{
+    ebiptablesSharedChainIfacePtr iface;
+    size_t i;
+
+    if (!sharedChains ||
+        !(iface = virHashLookup(sharedChainIfaces, ifname)))
+        return;
+
+    for (i = 0; i < VIR_FIREWALL_LAYER_LAST; i++)
+        ebiptablesSharedChainUnref(fw, i, &iface->pending[i]);
+}
+
+
+/* The temporary root chains of @ifname replace the final ones */
+static void
+ebiptablesSharedChainsTearOldFW(virFirewallPtr fw,
+                                const char *ifname)
+{
+    ebiptablesSharedChainIfacePtr iface;
+    size_t i;
+
+    if (!sharedChains ||
+        !(iface = virHashLookup(sharedChainIfaces, ifname)))
+        return;
+
+    for (i = 0; i < VIR_FIREWALL_LAYER_LAST; i++) {
+        ebiptablesSharedChainUnref(fw, i, &iface->active[i]);
+        iface->active[i] = g_steal_pointer(&iface->pending[i]);
+    }
+}
+
+
+/* All the root chains of @ifname are going away */
+static void
+ebiptablesSharedChainsTeardownFW(virFirewallPtr fw,
+                                 const char *ifname)
+{
+    ebiptablesSharedChainIfacePtr iface;
+    size_t i;
+
+    if (!sharedChains ||
+        !(iface = virHashLookup(sharedChainIfaces, ifname)))
+        return;
+
+    for (i = 0; i < VIR_FIREWALL_LAYER_LAST; i++) {
+        ebiptablesSharedChainUnref(fw, i, &iface->pending[i]);
+        ebiptablesSharedChainUnref(fw, i, &iface->active[i]);
+    }
+
+    virHashRemoveEntry(sharedChainIfaces, ifname);
+}
+
+
+/* Makes @ids the shared chains the temporary root chains of @ifname
+ * jump into, taking over the strings */
+static int
+ebiptablesSharedChainsSetPending(virFirewallPtr fw,
+                                 const char *ifname,
+                                 char **ids)
+{
+    ebiptablesSharedChainIfacePtr iface;
+    size_t i;
+
+    if (!(iface = virHashLookup(sharedChainIfaces, ifname))) {
+        iface = g_new0(ebiptablesSharedChainIface, 1);
+        if (virHashAddEntry(sharedChainIfaces, ifname, iface) < 0) {
+            ebiptablesSharedChainIfaceFree(iface);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < VIR_FIREWALL_LAYER_LAST; i++) {
+        if (ids[i] && ebiptablesSharedChainRef(ids[i]) < 0)
+            return -1;
+        ebiptablesSharedChainUnref(fw, i, &iface->pending[i]);
+        iface->pending[i] = g_steal_pointer(&ids[i]);
+    }
+
+    return 0;
+}
+
+
 static int
 ebiptablesApplyNewRules(const char *ifname,
                         virNWFilterRuleInstPtr *rules,
@@ -3363,6 +3636,7 @@ ebiptablesApplyNewRules(const char *ifname,
 {
     size_t i, j;
     virFirewallPtr fw = virFirewallNew();
+    virFirewallPtr purge = NULL;
     virHashTablePtr chains_in_set  = virHashCreate(10, NULL);
     virHashTablePtr chains_out_set = virHashCreate(10, NULL);
     bool haveEbtables = false;
@@ -3371,8 +3645,12 @@ ebiptablesApplyNewRules(const char *ifname,
     char *errmsg = NULL;
     struct ebtablesSubChainInst **subchains = NULL;
     size_t nsubchains = 0;
+    char *sharedIds[VIR_FIREWALL_LAYER_LAST] = { NULL };
+    bool sharedNew[VIR_FIREWALL_LAYER_LAST] = { false };
     int ret = -1;
 
+    ebiptablesSharedChainsLock();
+
     if (!chains_in_set || !chains_out_set)
         goto cleanup;
 
@@ -3380,16 +3658,6 @@ ebiptablesApplyNewRules(const char *ifname,
         qsort(rules, nrules, sizeof(rules[0]),
               virNWFilterRuleInstSortPtr);
 
-    /* cleanup whatever may exist */
-    virFirewallStartTransaction(fw, VIR_FIREWALL_TRANSACTION_IGNORE_ERRORS);
-    ebtablesUnlinkTmpRootChainFW(fw, true, ifname);
-    ebtablesUnlinkTmpRootChainFW(fw, false, ifname);
-    ebtablesRemoveTmpSubChainsFW(fw, ifname);
-    ebtablesRemoveTmpRootChainFW(fw, true, ifname);
-    ebtablesRemoveTmpRootChainFW(fw, false, ifname);
-
-    virFirewallStartTransaction(fw, 0);
-
     /* walk the list of rules and increase the priority
      * of rules in case the chain priority is of higher value;
      * this preserves the order of the rules and ensures that
@@ -3417,6 +3685,37 @@ ebiptablesApplyNewRules(const char *ifname,
                 haveIp6tables = true;
         }
     }
+
+    if (sharedChains) {
+        if (haveIptables &&
+            !(sharedIds[VIR_FIREWALL_LAYER_IPV4] =
+              ebiptablesSharedChainId(VIR_FIREWALL_LAYER_IPV4, rules, nrules)))
+            goto cleanup;
+        if (haveIp6tables &&
+            !(sharedIds[VIR_FIREWALL_LAYER_IPV6] =
+              ebiptablesSharedChainId(VIR_FIREWALL_LAYER_IPV6, rules, nrules)))
+            goto cleanup;
+
+        for (i = 0; i < VIR_FIREWALL_LAYER_LAST; i++)
+            sharedNew[i] = sharedIds[i] &&
+                           !virHashLookup(sharedChainRefs, sharedIds[i]);
+    }
+
+    /* cleanup whatever may exist */
+    virFirewallStartTransaction(fw, VIR_FIREWALL_TRANSACTION_IGNORE_ERRORS);
+    ebtablesUnlinkTmpRootChainFW(fw, true, ifname);
+    ebtablesUnlinkTmpRootChainFW(fw, false, ifname);
+    ebtablesRemoveTmpSubChainsFW(fw, ifname);
+    ebtablesRemoveTmpRootChainFW(fw, true, ifname);
+    ebtablesRemoveTmpRootChainFW(fw, false, ifname);
+
+    for (i = 0; i < VIR_FIREWALL_LAYER_LAST; i++) {
+        if (sharedNew[i])
+            iptablesCreateSharedChainsFW(fw, i, sharedIds[i]);
+    }
+
+    virFirewallStartTransaction(fw, 0);
+
     /* process ebtables commands; interleave commands from filters with
        commands for creating and connecting ebtables chains */
     if (haveEbtables) {
@@ -3499,12 +3798,20 @@ ebiptablesApplyNewRules(const char *ifname,
         iptablesLinkTmpRootChainsFW(fw, VIR_FIREWALL_LAYER_IPV4, ifname);
         iptablesSetupVirtInPostFW(fw, VIR_FIREWALL_LAYER_IPV4, ifname);
 
-        for (i = 0; i < nrules; i++) {
-            if (virNWFilterRuleIsProtocolIPv4(rules[i]->def)) {
-                if (iptablesRuleInstCommand(fw,
-                                            ifname,
-                                            rules[i]) < 0)
-                    goto cleanup;
+        if (sharedIds[VIR_FIREWALL_LAYER_IPV4]) {
+            if (iptablesApplySharedChainsFW(fw, VIR_FIREWALL_LAYER_IPV4, ifname,
+                                            sharedIds[VIR_FIREWALL_LAYER_IPV4],
+                                            sharedNew[VIR_FIREWALL_LAYER_IPV4],
+                                            rules, nrules) < 0)
+                goto cleanup;
+        } else {
+            for (i = 0; i < nrules; i++) {
+                if (virNWFilterRuleIsProtocolIPv4(rules[i]->def)) {
+                    if (iptablesRuleInstCommand(fw,
+                                                ifname,
+                                                rules[i]) < 0)
+                        goto cleanup;
+                }
             }
         }
 
@@ -3521,12 +3828,20 @@ ebiptablesApplyNewRules(const char *ifname,
         iptablesLinkTmpRootChainsFW(fw, VIR_FIREWALL_LAYER_IPV6, ifname);
         iptablesSetupVirtInPostFW(fw, VIR_FIREWALL_LAYER_IPV6, ifname);
 
-        for (i = 0; i < nrules; i++) {
-            if (virNWFilterRuleIsProtocolIPv6(rules[i]->def)) {
-                if (iptablesRuleInstCommand(fw,
-                                            ifname,
-                                            rules[i]) < 0)
-                    goto cleanup;
+        if (sharedIds[VIR_FIREWALL_LAYER_IPV6]) {
+            if (iptablesApplySharedChainsFW(fw, VIR_FIREWALL_LAYER_IPV6, ifname,
+                                            sharedIds[VIR_FIREWALL_LAYER_IPV6],
+                                            sharedNew[VIR_FIREWALL_LAYER_IPV6],
+                                            rules, nrules) < 0)
+                goto cleanup;
+        } else {
+            for (i = 0; i < nrules; i++) {
+                if (virNWFilterRuleIsProtocolIPv6(rules[i]->def)) {
+                    if (iptablesRuleInstCommand(fw,
+                                                ifname,
+                                                rules[i]) < 0)
+                        goto cleanup;
+                }
             }
         }
 
@@ -3555,15 +3870,33 @@ ebiptablesApplyNewRules(const char *ifname,
     ebtablesRemoveTmpRootChainFW(fw, true, ifname);
     ebtablesRemoveTmpRootChainFW(fw, false, ifname);
 
+    for (i = 0; i < VIR_FIREWALL_LAYER_LAST; i++) {
+        if (sharedNew[i])
+            iptablesRemoveTmpRootChainsFW(fw, i, sharedIds[i]);
+    }
+
     if (virFirewallApply(fw) < 0)
         goto cleanup;
 
+    if (sharedChains) {
+        purge = virFirewallNew();
+        virFirewallStartTransaction(purge,
+                                    VIR_FIREWALL_TRANSACTION_IGNORE_ERRORS);
+        if (ebiptablesSharedChainsSetPending(purge, ifname, sharedIds) < 0 ||
+            virFirewallApply(purge) < 0)
+            goto cleanup;
+    }
+
     ret = 0;
 
  cleanup:
+    ebiptablesSharedChainsUnlock();
+    for (i = 0; i < VIR_FIREWALL_LAYER_LAST; i++)
+        VIR_FREE(sharedIds[i]);
     for (i = 0; i < nsubchains; i++)
         VIR_FREE(subchains[i]);
     VIR_FREE(subchains);
+    virFirewallFree(purge);
     virFirewallFree(fw);
     virHashFree(chains_in_set);
     virHashFree(chains_out_set);
@@ -3596,12 +3929,16 @@ ebiptablesTearNewRules(const char *ifname)
     virFirewallPtr fw = virFirewallNew();
     int ret = -1;
 
+    ebiptablesSharedChainsLock();
+
     virFirewallStartTransaction(fw, VIR_FIREWALL_TRANSACTION_IGNORE_ERRORS);
 
     ebiptablesTearNewRulesFW(fw, ifname);
+    ebiptablesSharedChainsTearNewFW(fw, ifname);
 
     ret = virFirewallApply(fw);
     virFirewallFree(fw);
+    ebiptablesSharedChainsUnlock();
     return ret;
 }
 
@@ -3611,6 +3948,8 @@ ebiptablesTearOldRules(const char *ifname)
     virFirewallPtr fw = virFirewallNew();
     int ret = -1;
 
+    ebiptablesSharedChainsLock();
+
     virFirewallStartTransaction(fw, VIR_FIREWALL_TRANSACTION_IGNORE_ERRORS);
 
     iptablesUnlinkRootChainsFW(fw, VIR_FIREWALL_LAYER_IPV4, ifname);
@@ -3628,8 +3967,11 @@ ebiptablesTearOldRules(const char *ifname)
     ebtablesRemoveRootChainFW(fw, false, ifname);
     ebtablesRenameTmpSubAndRootChainsFW(fw, ifname);
 
+    ebiptablesSharedChainsTearOldFW(fw, ifname);
+
     ret = virFirewallApply(fw);
     virFirewallFree(fw);
+    ebiptablesSharedChainsUnlock();
     return ret;
 }
 
@@ -3649,6 +3991,8 @@ ebiptablesAllTeardown(const char *ifname)
     virFirewallPtr fw = virFirewallNew();
     int ret = -1;
 
+    ebiptablesSharedChainsLock();
+
     virFirewallStartTransaction(fw, VIR_FIREWALL_TRANSACTION_IGNORE_ERRORS);
 
     ebiptablesTearNewRulesFW(fw, ifname);
@@ -3669,8 +4013,11 @@ ebiptablesAllTeardown(const char *ifname)
     ebtablesRemoveRootChainFW(fw, true, ifname);
     ebtablesRemoveRootChainFW(fw, false, ifname);
 
+    ebiptablesSharedChainsTeardownFW(fw, ifname);
+
     ret = virFirewallApply(fw);
     virFirewallFree(fw);
+    ebiptablesSharedChainsUnlock();
     return ret;
 }
 
@@ -3790,6 +4137,11 @@ ebiptablesDriverInit(bool privileged)
     if (ebiptablesDriverProbeStateMatch() < 0)
         return -1;
 
+    if (sharedChains &&
+        (!(sharedChainRefs = virHashCreate(0, virHashValueFree)) ||
+         !(sharedChainIfaces = virHashCreate(0, ebiptablesSharedChainIfaceFree))))
+        return -1;
+
     ebiptables_driver.flags = TECHDRV_FLAG_INITIALIZED;
 
     return 0;
@@ -3799,5 +4151,9 @@ ebiptablesDriverInit(bool privileged)
 static void
 ebiptablesDriverShutdown(void)
 {
+    virHashFree(sharedChainIfaces);
+    sharedChainIfaces = NULL;
+    virHashFree(sharedChainRefs);
+    sharedChainRefs = NULL;
     ebiptables_driver.flags = 0;
 }
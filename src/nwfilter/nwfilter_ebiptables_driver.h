@@ -29,4 +29,6 @@ extern virNWFilterTechDriver ebiptables_driver;
 
 #define EBIPTABLES_DRIVER_ID "ebiptables"
 
+void ebiptablesSetSharedChains(bool enable);
+
 #define IPTABLES_MAX_COMMENT_LENGTH  256
@@ -30,6 +30,7 @@
 #include "virerror.h"
 #include "nwfilter_gentech_driver.h"
 #include "nwfilter_ebiptables_driver.h"
+#include "nwfilter_nftables_driver.h"
 #include "nwfilter_dhcpsnoop.h"
 #include "nwfilter_ipaddrmap.h"
 #include "nwfilter_learnipaddr.h"
@@ -37,6 +38,7 @@
 #include "datatypes.h"
 #include "virsocketaddr.h"
 #include "virstring.h"
+#include "vircrypto.h"
 
 #define VIR_FROM_THIS VIR_FROM_NWFILTER
 
@@ -52,9 +54,13 @@ static int _virNWFilterTeardownFilter(const char *ifname);
 
 static virNWFilterTechDriverPtr filter_tech_drivers[] = {
     &ebiptables_driver,
+    &nftables_driver,
     NULL
 };
 
+/* The driver all filters get instantiated with */
+static const char *filter_tech_driver_name = EBIPTABLES_DRIVER_ID;
+
 /* Serializes instantiation of filters. This is necessary
  * to avoid lock ordering deadlocks. eg virNWFilterInstantiateFilterUpdate
  * will hold a lock on a virNWFilterObjPtr. This in turn invokes
@@ -71,18 +77,49 @@ static virNWFilterTechDriverPtr filter_tech_drivers[] = {
  */
 static virMutex updateMutex;
 
-int virNWFilterTechDriversInit(bool privileged)
+/* Digests of the rules instantiated on the interfaces, keyed by name,
+ * so that rebuilding all filters can leave the interfaces alone whose
+ * rules a filter update doesn't change. Rules applied by an update
+ * only become active when the old ones are torn, until then their
+ * digest is pending. Protected by updateMutex. */
+static virHashTablePtr ruleDigests;
+static virHashTablePtr pendingRuleDigests;
+
+/*
+ * virNWFilterTechDriversInit:
+ * @privileged: whether the daemon runs privileged
+ * @name: name of the technology driver to use, or NULL for the default
+ *
+ * Initializes the technology driver filters are instantiated with. The
+ * other drivers are left alone, so that they don't touch the firewall.
+ */
+int virNWFilterTechDriversInit(bool privileged, const char *name)
 {
     size_t i = 0;
-    VIR_DEBUG("Initializing NWFilter technology drivers");
-    if (virMutexInitRecursive(&updateMutex) < 0)
-        return -1;
+    VIR_DEBUG("Initializing NWFilter technology driver %s", NULLSTR(name));
 
-    while (filter_tech_drivers[i]) {
-        if (!(filter_tech_drivers[i]->flags & TECHDRV_FLAG_INITIALIZED))
-            filter_tech_drivers[i]->init(privileged);
+    if (!name)
+        name = EBIPTABLES_DRIVER_ID;
+
+    while (filter_tech_drivers[i] && STRNEQ(filter_tech_drivers[i]->name, name))
         i++;
+
+    if (!filter_tech_drivers[i]) {
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                       _("unknown nwfilter technology driver '%s'"), name);
+        return -1;
     }
+
+    if (virMutexInitRecursive(&updateMutex) < 0)
+        return -1;
+
+    if (!(ruleDigests = virHashCreate(0, virHashValueFree)) ||
+        !(pendingRuleDigests = virHashCreate(0, virHashValueFree)))
+        return -1;
+
+    filter_tech_driver_name = filter_tech_drivers[i]->name;
+    if (!(filter_tech_drivers[i]->flags & TECHDRV_FLAG_INITIALIZED))
+        filter_tech_drivers[i]->init(privileged);
     return 0;
 }
 
@@ -95,10 +132,140 @@ void virNWFilterTechDriversShutdown(void)
             filter_tech_drivers[i]->shutdown();
         i++;
     }
+    virHashFree(ruleDigests);
+    ruleDigests = NULL;
+    virHashFree(pendingRuleDigests);
+    pendingRuleDigests = NULL;
     virMutexDestroy(&updateMutex);
 }
 
 
+static int
+virNWFilterRuleDigestVarsSort(const virHashKeyValuePair *a,
+                              const virHashKeyValuePair *b)
+{
+    return strcmp(a->key, b->key);
+}
+
+
+/*
+ * virNWFilterRuleInstsDigest:
+ * @rules: the rules about to be instantiated
+ * @nrules: number of entries in @rules
+ * @match: optional function selecting the rules to consider
+ *
+ * Returns a digest of everything the technology drivers create the
+ * rules of an interface from, or NULL on error.
+ */
+char *
+virNWFilterRuleInstsDigest(virNWFilterRuleInstPtr *rules,
+                           size_t nrules,
+                           bool (*match)(virNWFilterRuleDefPtr def))
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    char *digest = NULL;
+    size_t i, j, k;
+
+    for (i = 0; i < nrules; i++) {
+        virNWFilterRuleInstPtr rule = rules[i];
+        virHashKeyValuePairPtr items;
+
+        if (match && !match(rule->def))
+            continue;
+
+        virBufferAsprintf(&buf, "%s %d %d\n", rule->chainSuffix,
+                          rule->chainPriority, rule->priority);
+
+        if (virNWFilterRuleDefFormat(&buf, rule->def) < 0)
+            return NULL;
+
+        if (!(items = virHashGetItems(rule->vars,
+                                      virNWFilterRuleDigestVarsSort)))
+            return NULL;
+
+        for (j = 0; items[j].key; j++) {
+            virNWFilterVarValuePtr val = (virNWFilterVarValuePtr)items[j].value;
+
+            virBufferAsprintf(&buf, "%s=", (const char *)items[j].key);
+            for (k = 0; k < virNWFilterVarValueGetCardinality(val); k++)
+                virBufferAsprintf(&buf, "%s,",
+                                  virNWFilterVarValueGetNthValue(val, k));
+            virBufferAddLit(&buf, "\n");
+        }
+        VIR_FREE(items);
+    }
+
+    if (virCryptoHashString(VIR_CRYPTO_HASH_SHA256,
+                            virBufferCurrentContent(&buf), &digest) < 0)
+        return NULL;
+
+    return digest;
+}
+
+
+/* Whether the rules active on @ifname were created from @digest */
+static bool
+virNWFilterRuleDigestMatches(const char *ifname,
+                             const char *digest)
+{
+    const char *active;
+    bool ret;
+
+    virMutexLock(&updateMutex);
+    active = virHashLookup(ruleDigests, ifname);
+    ret = active && STREQ(active, digest);
+    virMutexUnlock(&updateMutex);
+
+    return ret;
+}
+
+
+static void
+virNWFilterRuleDigestSet(virHashTablePtr table,
+                         const char *ifname,
+                         char *digest)
+{
+    virMutexLock(&updateMutex);
+    if (virHashUpdateEntry(table, ifname, digest) < 0) {
+        /* without a digest the interface just gets rebuilt next time */
+        VIR_FREE(digest);
+        virHashRemoveEntry(table, ifname);
+        virResetLastError();
+    }
+    virMutexUnlock(&updateMutex);
+}
+
+
+/* Makes the pending digest of @ifname the active one, if @commit is
+ * true, and drops it otherwise */
+static void
+virNWFilterRuleDigestFinish(const char *ifname,
+                            bool commit)
+{
+    char *digest;
+
+    virMutexLock(&updateMutex);
+    if ((digest = virHashSteal(pendingRuleDigests, ifname))) {
+        if (commit)
+            virNWFilterRuleDigestSet(ruleDigests, ifname, digest);
+        else
+            VIR_FREE(digest);
+    }
+    virMutexUnlock(&updateMutex);
+}
+
+
+/* Forgets the rules of @ifname, e.g., when other rules were applied */
+static void
+virNWFilterRuleDigestForget(const char *ifname)
+{
+    virMutexLock(&updateMutex);
+    virHashRemoveEntry(ruleDigests, ifname);
+    virHashRemoveEntry(pendingRuleDigests, ifname);
+    virMutexUnlock(&updateMutex);
+}
+
+
 virNWFilterTechDriverPtr
 virNWFilterTechDriverForName(const char *name)
 {
@@ -521,6 +688,7 @@ virNWFilterDoInstantiate(virNWFilterTechDriverPtr techdriver,
     virNWFilterVarValuePtr lv;
     const char *learning;
     bool reportIP = false;
+    g_autofree char *digest = NULL;
 
     virHashTablePtr missing_vars = virNWFilterHashTableCreate(0);
 
@@ -551,6 +719,9 @@ virNWFilterDoInstantiate(virNWFilterTechDriverPtr techdriver,
     if (virHashSize(missing_vars) == 1) {
         if (virHashLookup(missing_vars,
                           NWFILTER_STD_VAR_IP) != NULL) {
+            /* learning the address replaces the rules of the filter */
+            virNWFilterRuleDigestForget(binding->portdevname);
+
             if (STRCASEEQ(learning, "none")) {        /* no learning */
                 reportIP = true;
                 goto err_unresolvable_vars;
@@ -606,6 +777,21 @@ virNWFilterDoInstantiate(virNWFilterTechDriverPtr techdriver,
     }
 
     if (instantiate) {
+        if (!(digest = virNWFilterRuleInstsDigest(inst.rules, inst.nrules, NULL))) {
+            rc = -1;
+            goto err_exit;
+        }
+
+        /* an update of a filter doesn't necessarily change the rules of
+         * every interface it is used on */
+        if (useNewFilter == INSTANTIATE_FOLLOW_NEWFILTER &&
+            virNWFilterRuleDigestMatches(binding->portdevname, digest)) {
+            VIR_DEBUG("Rules of interface %s are unchanged",
+                      binding->portdevname);
+            *foundNewFilter = false;
+            goto err_exit;
+        }
+
         if (virNWFilterLockIface(binding->portdevname) < 0)
             goto err_exit;
 
@@ -621,6 +807,12 @@ virNWFilterDoInstantiate(virNWFilterTechDriverPtr techdriver,
             rc = -1;
         }
 
+        if (rc < 0)
+            virNWFilterRuleDigestForget(binding->portdevname);
+        else
+            virNWFilterRuleDigestSet(teardownOld ? ruleDigests : pendingRuleDigests,
+                                     binding->portdevname, g_steal_pointer(&digest));
+
         virNWFilterUnlockIface(binding->portdevname);
     }
 
@@ -680,7 +872,7 @@ virNWFilterInstantiateFilterUpdate(virNWFilterDriverStatePtr driver,
                                    bool *foundNewFilter)
 {
     int rc = -1;
-    const char *drvname = EBIPTABLES_DRIVER_ID;
+    const char *drvname = filter_tech_driver_name;
     virNWFilterTechDriverPtr techdriver;
     virNWFilterObjPtr obj;
     virNWFilterDefPtr filter;
@@ -846,7 +1038,7 @@ virNWFilterUpdateInstantiateFilter(virNWFilterDriverStatePtr driver,
 static int
 virNWFilterRollbackUpdateFilter(virNWFilterBindingDefPtr binding)
 {
-    const char *drvname = EBIPTABLES_DRIVER_ID;
+    const char *drvname = filter_tech_driver_name;
     int ifindex;
     virNWFilterTechDriverPtr techdriver;
 
@@ -860,10 +1052,14 @@ virNWFilterRollbackUpdateFilter(virNWFilterBindingDefPtr binding)
     }
 
     /* don't tear anything while the address is being learned */
-    if (virNetDevGetIndex(binding->portdevname, &ifindex) < 0)
+    if (virNetDevGetIndex(binding->portdevname, &ifindex) < 0) {
         virResetLastError();
-    else if (virNWFilterHasLearnReq(ifindex))
+    } else if (virNWFilterHasLearnReq(ifindex)) {
+        virNWFilterRuleDigestForget(binding->portdevname);
         return 0;
+    }
+
+    virNWFilterRuleDigestFinish(binding->portdevname, false);
 
     return techdriver->tearNewRules(binding->portdevname);
 }
@@ -872,7 +1068,7 @@ virNWFilterRollbackUpdateFilter(virNWFilterBindingDefPtr binding)
 static int
 virNWFilterTearOldFilter(virNWFilterBindingDefPtr binding)
 {
-    const char *drvname = EBIPTABLES_DRIVER_ID;
+    const char *drvname = filter_tech_driver_name;
     int ifindex;
     virNWFilterTechDriverPtr techdriver;
 
@@ -886,19 +1082,27 @@ virNWFilterTearOldFilter(virNWFilterBindingDefPtr binding)
     }
 
     /* don't tear anything while the address is being learned */
-    if (virNetDevGetIndex(binding->portdevname, &ifindex) < 0)
+    if (virNetDevGetIndex(binding->portdevname, &ifindex) < 0) {
         virResetLastError();
-    else if (virNWFilterHasLearnReq(ifindex))
+    } else if (virNWFilterHasLearnReq(ifindex)) {
+        virNWFilterRuleDigestForget(binding->portdevname);
         return 0;
+    }
 
-    return techdriver->tearOldRules(binding->portdevname);
+    if (techdriver->tearOldRules(binding->portdevname) < 0) {
+        virNWFilterRuleDigestForget(binding->portdevname);
+        return -1;
+    }
+
+    virNWFilterRuleDigestFinish(binding->portdevname, true);
+    return 0;
 }
 
 
 static int
 _virNWFilterTeardownFilter(const char *ifname)
 {
-    const char *drvname = EBIPTABLES_DRIVER_ID;
+    const char *drvname = filter_tech_driver_name;
     virNWFilterTechDriverPtr techdriver;
     techdriver = virNWFilterTechDriverForName(drvname);
 
@@ -919,6 +1123,8 @@ _virNWFilterTeardownFilter(const char *ifname)
 
     techdriver->allTeardown(ifname);
 
+    virNWFilterRuleDigestForget(ifname);
+
     virNWFilterIPAddrMapDelIPAddr(ifname, NULL);
 
     virNWFilterUnlockIface(ifname);
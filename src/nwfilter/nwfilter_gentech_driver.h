@@ -28,9 +28,13 @@
 
 virNWFilterTechDriverPtr virNWFilterTechDriverForName(const char *name);
 
-int virNWFilterTechDriversInit(bool privileged);
+int virNWFilterTechDriversInit(bool privileged, const char *name);
 void virNWFilterTechDriversShutdown(void);
 
+char *virNWFilterRuleInstsDigest(virNWFilterRuleInstPtr *rules,
+                                 size_t nrules,
+                                 bool (*match)(virNWFilterRuleDefPtr def));
+
 enum instCase {
     INSTANTIATE_ALWAYS,
     INSTANTIATE_FOLLOW_NEWFILTER,
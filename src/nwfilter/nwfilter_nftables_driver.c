@@ -0,0 +1,1886 @@
+/*
+ * nwfilter_nftables_driver.c: driver for nftables on tap devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <net/if.h>
+
+#include "internal.h"
+
+#include "virbuffer.h"
+#include "viralloc.h"
+#include "virlog.h"
+#include "virerror.h"
+#include "nwfilter_conf.h"
+#include "nwfilter_nftables_driver.h"
+#include "vircommand.h"
+#include "virhash.h"
+#include "virstring.h"
+#include "virthread.h"
+
+#define VIR_FROM_THIS VIR_FROM_NWFILTER
+
+VIR_LOG_INIT("nwfilter.nwfilter_nftables_driver");
+
+/*
+ * All the rules live in a single table of the bridge family, so that
+ * ethernet and IP level rules can be written with one tool. The base
+ * chains of the table look each interface up in a verdict map, which
+ * costs the same no matter how many interfaces are filtered, and jump
+ * to the chains of that interface:
+ *
+ *   prerouting:  iifname vmap @l2_out    (like ebtables nat PREROUTING)
+ *   postrouting: oifname vmap @l2_in     (like ebtables nat POSTROUTING)
+ *   forward:     iifname vmap @l3_out, oifname vmap @l3_in
+ *   input:       iifname vmap @l3_out
+ *
+ * As everywhere in nwfilter, 'out' is the traffic sent by the VM and
+ * 'in' the traffic sent to it.
+ *
+ * The maps point to a dispatch chain per interface and kind, named
+ * "<ifname>:<kind>", holding nothing but a jump to the chain of the
+ * active generation of rules, "<ifname>:<gen>:<kind>". Sub chains of
+ * filters are called "<ifname>:<gen>:<kind>:<filter chain>". A new
+ * generation is built next to the active one and only switched to by
+ * replacing the jump in the dispatch chains, so the old rules stay in
+ * force until the gentech driver commits the new ones. Every change is
+ * applied by a single 'nft -f' transaction, hence atomically.
+ */
+#define NFTABLES_TABLE "bridge libvirt_nwfilter"
+
+typedef enum {
+    NFTABLES_CHAIN_L2_OUT = 0,
+    NFTABLES_CHAIN_L2_IN,
+    NFTABLES_CHAIN_L3_OUT,
+    NFTABLES_CHAIN_L3_IN,
+
+    NFTABLES_CHAIN_LAST
+} nftablesChainKind;
+
+static const char *nftablesChainKinds[NFTABLES_CHAIN_LAST] = {
+    "l2-out", "l2-in", "l3-out", "l3-in",
+};
+
+static const char *nftablesMaps[NFTABLES_CHAIN_LAST] = {
+    "l2_out", "l2_in", "l3_out", "l3_in",
+};
+
+/* Values end up in an nft script, they don't get any other characters */
+#define NFTABLES_VALID_VALUE "0123456789abcdefABCDEFx.:"
+#define NFTABLES_VALUE_LEN 64
+
+/* Matches prepended to the jump into an ethernet sub chain, found by
+ * the prefix of its name like ebtablesGetProtoIdxByFiltername does */
+static const struct {
+    const char *prefix;
+    const char *match;
+} nftablesSubChainMatches[] = {
+    { "ipv4", " ether type ip" },
+    { "ipv6", " ether type ip6" },
+    { "arp", " ether type arp" },
+    { "rarp", " ether type 0x8035" },
+    { "mac", "" },
+    { "vlan", " ether type vlan" },
+    { "stp", " ether daddr " NWFILTER_MAC_BGA },
+};
+
+typedef struct _nftablesIface nftablesIface;
+typedef nftablesIface *nftablesIfacePtr;
+struct _nftablesIface {
+    char **chains;          /* generation chains installed */
+    size_t nchains;
+    unsigned int pending;   /* generation not activated yet, 0 if none */
+};
+
+/* Protects the fields below; held while a transaction runs */
+static virMutex nftablesLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr nftablesIfaces;
+static unsigned int nftablesGeneration;
+
+
+static void
+nftablesIfaceFree(void *opaque)
+{
+    nftablesIfacePtr iface = opaque;
+    size_t i;
+
+    if (!iface)
+        return;
+
+    for (i = 0; i < iface->nchains; i++)
+        VIR_FREE(iface->chains[i]);
+    VIR_FREE(iface->chains);
+    VIR_FREE(iface);
+}
+
+
+static nftablesIfacePtr
+nftablesIfaceGet(const char *ifname)
+{
+    nftablesIfacePtr iface;
+
+    if (!nftablesIfaces &&
+        !(nftablesIfaces = virHashCreate(32, nftablesIfaceFree)))
+        return NULL;
+
+    if ((iface = virHashLookup(nftablesIfaces, ifname)))
+        return iface;
+
+    if (VIR_ALLOC(iface) < 0)
+        return NULL;
+
+    if (virHashAddEntry(nftablesIfaces, ifname, iface) < 0) {
+        nftablesIfaceFree(iface);
+        return NULL;
+    }
+
+    return iface;
+}
+
+
+/* Returns the generation of a chain, 0 for the dispatch chains */
+static unsigned int
+nftablesChainGeneration(const char *chain)
+{
+    const char *tmp = strchr(chain, ':');
+    unsigned int gen;
+    char *end;
+
+    if (!tmp ||
+        virStrToLong_ui(tmp + 1, &end, 10, &gen) < 0 ||
+        *end != ':')
+        return 0;
+
+    return gen;
+}
+
+
+static char *
+nftablesChainName(const char *ifname,
+                  unsigned int gen,
+                  nftablesChainKind kind,
+                  const char *suffix)
+{
+    if (gen == 0)
+        return g_strdup_printf("%s:%s", ifname, nftablesChainKinds[kind]);
+
+    if (suffix)
+        return g_strdup_printf("%s:%u:%s:%s", ifname, gen,
+                               nftablesChainKinds[kind], suffix);
+
+    return g_strdup_printf("%s:%u:%s", ifname, gen, nftablesChainKinds[kind]);
+}
+
+
+static int
+nftablesCheckIfname(const char *ifname)
+{
+    /* interface names are quoted in the scripts and used as the first
+     * part of chain names */
+    if (strpbrk(ifname, "\"\\:") || strlen(ifname) >= IFNAMSIZ) {
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                       _("unsupported interface name '%s'"), ifname);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+nftablesRun(virBufferPtr buf)
+{
+    g_autoptr(virCommand) cmd = NULL;
+    g_autofree char *script = NULL;
+    g_autofree char *error = NULL;
+    int status;
+
+    if (virBufferUse(buf) == 0)
+        return 0;
+
+    script = virBufferContentAndReset(buf);
+
+    VIR_DEBUG("Applying nftables script:\n%s", script);
+
+    cmd = virCommandNewArgList(NFT_PATH, "-f", "-", NULL);
+    virCommandSetInputBuffer(cmd, script);
+    virCommandSetErrorBuffer(cmd, &error);
+
+    if (virCommandRun(cmd, &status) < 0)
+        return -1;
+
+    if (status != 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Failed to apply nftables rules: %s"),
+                       NULLSTR(error));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static void
+nftablesPrintRemoveChains(virBufferPtr buf,
+                          nftablesIfacePtr iface,
+                          unsigned int gen)
+{
+    size_t i;
+
+    /* flush everything first so no chain is referenced when deleted */
+    for (i = 0; i < iface->nchains; i++) {
+        if (gen && nftablesChainGeneration(iface->chains[i]) != gen)
+            continue;
+        virBufferAsprintf(buf, "flush chain " NFTABLES_TABLE " \"%s\"\n",
+                          iface->chains[i]);
+    }
+
+    for (i = 0; i < iface->nchains; i++) {
+        if (gen && nftablesChainGeneration(iface->chains[i]) != gen)
+            continue;
+        virBufferAsprintf(buf, "delete chain " NFTABLES_TABLE " \"%s\"\n",
+                          iface->chains[i]);
+    }
+}
+
+
+/* Forgets about the chains of generation @gen, or all if @gen is 0 */
+static void
+nftablesIfaceDropChains(nftablesIfacePtr iface,
+                        unsigned int gen)
+{
+    size_t i = 0;
+
+    while (i < iface->nchains) {
+        if (gen && nftablesChainGeneration(iface->chains[i]) != gen) {
+            i++;
+            continue;
+        }
+        VIR_FREE(iface->chains[i]);
+        VIR_DELETE_ELEMENT(iface->chains, i, iface->nchains);
+    }
+}
+
+
+/* Points the dispatch chains of @ifname to generation @gen */
+static void
+nftablesPrintActivate(virBufferPtr buf,
+                      const char *ifname,
+                      unsigned int gen)
+{
+    size_t i;
+
+    for (i = 0; i < NFTABLES_CHAIN_LAST; i++) {
+        g_autofree char *dispatch = nftablesChainName(ifname, 0, i, NULL);
+        g_autofree char *chain = nftablesChainName(ifname, gen, i, NULL);
+
+        virBufferAsprintf(buf, "add chain " NFTABLES_TABLE " \"%s\"\n",
+                          dispatch);
+        virBufferAsprintf(buf,
+                          "add element " NFTABLES_TABLE " %s "
+                          "{ \"%s\" : jump \"%s\" }\n",
+                          nftablesMaps[i], ifname, dispatch);
+        virBufferAsprintf(buf, "flush chain " NFTABLES_TABLE " \"%s\"\n",
+                          dispatch);
+        virBufferAsprintf(buf, "add rule " NFTABLES_TABLE " \"%s\" "
+                          "jump \"%s\"\n", dispatch, chain);
+    }
+}
+
+
+/*
+ * nftablesCommit:
+ * @ifname: the interface the rules are for
+ * @gen: the generation of the new chains
+ * @chains: the new chains, consumed
+ * @nchains: number of entries in @chains
+ * @rules: the rules to add to the new chains
+ * @activate: whether to switch to the new generation right away
+ *
+ * Adds the chains of generation @gen with their rules in a single
+ * transaction, replacing a generation which was never activated. If
+ * @activate is true, the new generation replaces all others.
+ *
+ * Call with nftablesLock held.
+ */
+static int
+nftablesCommit(const char *ifname,
+               unsigned int gen,
+               char ***chains,
+               size_t *nchains,
+               virBufferPtr rules,
+               bool activate)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    nftablesIfacePtr iface;
+    size_t i;
+
+    if (!(iface = nftablesIfaceGet(ifname)))
+        return -1;
+
+    if (!activate && iface->pending)
+        nftablesPrintRemoveChains(&buf, iface, iface->pending);
+
+    for (i = 0; i < *nchains; i++)
+        virBufferAsprintf(&buf, "add chain " NFTABLES_TABLE " \"%s\"\n",
+                          (*chains)[i]);
+
+    virBufferAddBuffer(&buf, rules);
+
+    if (activate) {
+        nftablesPrintActivate(&buf, ifname, gen);
+        nftablesPrintRemoveChains(&buf, iface, 0);
+    }
+
+    if (nftablesRun(&buf) < 0)
+        return -1;
+
+    if (activate) {
+        nftablesIfaceDropChains(iface, 0);
+        iface->pending = 0;
+    } else {
+        if (iface->pending)
+            nftablesIfaceDropChains(iface, iface->pending);
+        iface->pending = gen;
+    }
+
+    for (i = 0; i < *nchains; i++) {
+        if (VIR_APPEND_ELEMENT(iface->chains, iface->nchains, (*chains)[i]) < 0)
+            return -1;
+    }
+    VIR_FREE(*chains);
+    *nchains = 0;
+
+    return 0;
+}
+
+
+/* Allocates a generation and adds its root chains to @chains */
+static unsigned int
+nftablesNewGeneration(const char *ifname,
+                      char ***chains,
+                      size_t *nchains)
+{
+    unsigned int gen = ++nftablesGeneration;
+    size_t i;
+
+    for (i = 0; i < NFTABLES_CHAIN_LAST; i++) {
+        char *chain = nftablesChainName(ifname, gen, i, NULL);
+
+        if (VIR_APPEND_ELEMENT(*chains, *nchains, chain) < 0) {
+            VIR_FREE(chain);
+            return 0;
+        }
+    }
+
+    return gen;
+}
+
+
+static void
+nftablesFreeChains(char **chains,
+                   size_t nchains)
+{
+    size_t i;
+
+    for (i = 0; i < nchains; i++)
+        VIR_FREE(chains[i]);
+    VIR_FREE(chains);
+}
+
+
+static int
+nftablesPrintDataType(virNWFilterVarCombIterPtr vars,
+                      char *buf, int bufsize,
+                      nwItemDescPtr item)
+{
+    g_autofree char *data = NULL;
+    const char *val = NULL;
+    int len = -1;
+
+    if ((item->flags & NWFILTER_ENTRY_ITEM_FLAG_HAS_VAR)) {
+        /* an error has been reported if there's no value */
+        if (!(val = virNWFilterVarCombIterGetVarValue(vars, item->varAccess)))
+            return -1;
+        len = g_snprintf(buf, bufsize, "%s", val);
+    } else {
+        switch (item->datatype) {
+        case DATATYPE_IPADDR:
+        case DATATYPE_IPV6ADDR:
+            if (!(data = virSocketAddrFormat(&item->u.ipaddr)))
+                return -1;
+            len = g_snprintf(buf, bufsize, "%s", data);
+            break;
+
+        case DATATYPE_MACADDR:
+        case DATATYPE_MACMASK:
+            if (bufsize < VIR_MAC_STRING_BUFLEN)
+                break;
+            virMacAddrFormat(&item->u.macaddr, buf);
+            len = strlen(buf);
+            break;
+
+        case DATATYPE_IPMASK:
+        case DATATYPE_IPV6MASK:
+        case DATATYPE_UINT8:
+            len = g_snprintf(buf, bufsize, "%u", item->u.u8);
+            break;
+
+        case DATATYPE_UINT8_HEX:
+            len = g_snprintf(buf, bufsize, "0x%x", item->u.u8);
+            break;
+
+        case DATATYPE_UINT16:
+            len = g_snprintf(buf, bufsize, "%u", item->u.u16);
+            break;
+
+        case DATATYPE_UINT16_HEX:
+            len = g_snprintf(buf, bufsize, "0x%x", item->u.u16);
+            break;
+
+        case DATATYPE_UINT32:
+            len = g_snprintf(buf, bufsize, "%u", item->u.u32);
+            break;
+
+        case DATATYPE_UINT32_HEX:
+            len = g_snprintf(buf, bufsize, "0x%x", item->u.u32);
+            break;
+
+        case DATATYPE_STRING:
+        case DATATYPE_STRINGCOPY:
+        case DATATYPE_BOOLEAN:
+        case DATATYPE_IPSETNAME:
+        case DATATYPE_IPSETFLAGS:
+            virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                           _("Cannot print data type %x"), item->datatype);
+            return -1;
+
+        case DATATYPE_LAST:
+        default:
+            virReportEnumRangeError(virNWFilterAttrDataType, item->datatype);
+            return -1;
+        }
+    }
+
+    if (len < 0 || len >= bufsize) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Buffer too small for nftables value"));
+        return -1;
+    }
+
+    if (strspn(buf, NFTABLES_VALID_VALUE) != (size_t)len) {
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                       _("Invalid value '%s' for an nftables rule"), buf);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Appends ' @match [!= ]value[@sep value2]' to @buf, where value2 is
+ * that of @item2 if given, e.g., the mask of an address or the end of
+ * a range.
+ */
+static int
+nftablesAddItem(virBufferPtr buf,
+                virNWFilterVarCombIterPtr vars,
+                const char *match,
+                nwItemDescPtr item,
+                nwItemDescPtr item2,
+                const char *sep)
+{
+    char value[NFTABLES_VALUE_LEN];
+    char value2[NFTABLES_VALUE_LEN];
+
+    if (!HAS_ENTRY_ITEM(item))
+        return 0;
+
+    if (nftablesPrintDataType(vars, value, sizeof(value), item) < 0)
+        return -1;
+
+    virBufferAsprintf(buf, " %s %s%s", match,
+                      ENTRY_WANT_NEG_SIGN(item) ? "!= " : "", value);
+
+    if (item2 && HAS_ENTRY_ITEM(item2)) {
+        if (nftablesPrintDataType(vars, value2, sizeof(value2), item2) < 0)
+            return -1;
+        virBufferAsprintf(buf, "%s%s", sep, value2);
+    }
+
+    return 0;
+}
+
+
+/* MAC addresses have no prefix notation, so masks are applied with a
+ * bitwise and */
+static int
+nftablesAddMACItem(virBufferPtr buf,
+                   virNWFilterVarCombIterPtr vars,
+                   const char *match,
+                   nwItemDescPtr addr,
+                   nwItemDescPtr mask)
+{
+    char value[NFTABLES_VALUE_LEN];
+    char maskstr[NFTABLES_VALUE_LEN];
+
+    if (!HAS_ENTRY_ITEM(addr))
+        return 0;
+
+    if (!mask || !HAS_ENTRY_ITEM(mask))
+        return nftablesAddItem(buf, vars, match, addr, NULL, NULL);
+
+    if (nftablesPrintDataType(vars, value, sizeof(value), addr) < 0 ||
+        nftablesPrintDataType(vars, maskstr, sizeof(maskstr), mask) < 0)
+        return -1;
+
+    virBufferAsprintf(buf, " %s and %s %s %s", match, maskstr,
+                      ENTRY_WANT_NEG_SIGN(addr) ? "!=" : "==", value);
+
+    return 0;
+}
+
+
+static int
+nftablesHandleEthHdr(virBufferPtr buf,
+                     virNWFilterVarCombIterPtr vars,
+                     ethHdrDataDefPtr ethHdr,
+                     bool reverse)
+{
+    if (nftablesAddMACItem(buf, vars,
+                           reverse ? "ether daddr" : "ether saddr",
+                           &ethHdr->dataSrcMACAddr,
+                           &ethHdr->dataSrcMACMask) < 0 ||
+        nftablesAddMACItem(buf, vars,
+                           reverse ? "ether saddr" : "ether daddr",
+                           &ethHdr->dataDstMACAddr,
+                           &ethHdr->dataDstMACMask) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+nftablesUnsupported(virNWFilterRuleDefPtr rule,
+                    const char *what)
+{
+    virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                   _("the nftables nwfilter driver does not support "
+                     "'%s' in %s rules"),
+                   what, virNWFilterRuleProtocolTypeToString(rule->prtclType));
+    return -1;
+}
+
+
+static const char *
+nftablesVerdict(int action)
+{
+    switch ((virNWFilterRuleActionType) action) {
+    case VIR_NWFILTER_RULE_ACTION_DROP:
+        return "drop";
+    case VIR_NWFILTER_RULE_ACTION_ACCEPT:
+        return "accept";
+    case VIR_NWFILTER_RULE_ACTION_REJECT:
+        return "reject";
+    case VIR_NWFILTER_RULE_ACTION_RETURN:
+        return "return";
+    case VIR_NWFILTER_RULE_ACTION_CONTINUE:
+        return "continue";
+    case VIR_NWFILTER_RULE_ACTION_LAST:
+        break;
+    }
+
+    return "drop";
+}
+
+
+/*
+ * nftablesCreateEthRuleInstance:
+ * @buf: buffer to append the rule to
+ * @chain: the chain to add the rule to
+ * @rule: the rule of the filter to convert
+ * @vars: a map containing the variables to resolve
+ * @reverse: whether to reverse src and dst attributes
+ *
+ * Converts an ethernet level rule the same way ebtablesCreateRuleInstance
+ * does.
+ */
+static int
+nftablesCreateEthRuleInstance(virBufferPtr buf,
+                              const char *chain,
+                              virNWFilterRuleDefPtr rule,
+                              virNWFilterVarCombIterPtr vars,
+                              bool reverse)
+{
+    g_auto(virBuffer) match = VIR_BUFFER_INITIALIZER;
+    const char *src = reverse ? "daddr" : "saddr";
+    const char *dst = reverse ? "saddr" : "daddr";
+    const char *sport = reverse ? "th dport" : "th sport";
+    const char *dport = reverse ? "th sport" : "th dport";
+    const char *verdict;
+
+    switch ((int)rule->prtclType) {
+    case VIR_NWFILTER_RULE_PROTOCOL_MAC: {
+        ethHdrFilterDefPtr mac = &rule->p.ethHdrFilter;
+
+        if (nftablesHandleEthHdr(&match, vars, &mac->ethHdr, reverse) < 0 ||
+            nftablesAddItem(&match, vars, "ether type",
+                            &mac->dataProtocolID, NULL, NULL) < 0)
+            return -1;
+        break;
+    }
+
+    case VIR_NWFILTER_RULE_PROTOCOL_ARP:
+    case VIR_NWFILTER_RULE_PROTOCOL_RARP: {
+        arpHdrFilterDefPtr arp = &rule->p.arpHdrFilter;
+        g_autofree char *srcip = g_strdup_printf("arp %s ip", src);
+        g_autofree char *dstip = g_strdup_printf("arp %s ip", dst);
+        g_autofree char *srcmac = g_strdup_printf("arp %s ether", src);
+        g_autofree char *dstmac = g_strdup_printf("arp %s ether", dst);
+
+        if (nftablesHandleEthHdr(&match, vars, &arp->ethHdr, reverse) < 0)
+            return -1;
+
+        if (rule->prtclType == VIR_NWFILTER_RULE_PROTOCOL_RARP) {
+            /* nft's arp expressions depend on the ARP ethertype */
+            if (HAS_ENTRY_ITEM(&arp->dataHWType) ||
+                HAS_ENTRY_ITEM(&arp->dataProtocolType) ||
+                HAS_ENTRY_ITEM(&arp->dataOpcode) ||
+                HAS_ENTRY_ITEM(&arp->dataARPSrcMACAddr) ||
+                HAS_ENTRY_ITEM(&arp->dataARPSrcIPAddr) ||
+                HAS_ENTRY_ITEM(&arp->dataARPDstMACAddr) ||
+                HAS_ENTRY_ITEM(&arp->dataARPDstIPAddr))
+                return nftablesUnsupported(rule, "arp header matches");
+            virBufferAddLit(&match, " ether type 0x8035");
+            break;
+        }
+
+        if (HAS_ENTRY_ITEM(&arp->dataGratuitousARP))
+            return nftablesUnsupported(rule, "gratuitous");
+
+        virBufferAddLit(&match, " ether type arp");
+        if (nftablesAddItem(&match, vars, "arp htype",
+                            &arp->dataHWType, NULL, NULL) < 0 ||
+            nftablesAddItem(&match, vars, "arp ptype",
+                            &arp->dataProtocolType, NULL, NULL) < 0 ||
+            nftablesAddItem(&match, vars, "arp operation",
+                            &arp->dataOpcode, NULL, NULL) < 0 ||
+            nftablesAddItem(&match, vars, srcmac,
+                            &arp->dataARPSrcMACAddr, NULL, NULL) < 0 ||
+            nftablesAddItem(&match, vars, srcip,
+                            &arp->dataARPSrcIPAddr,
+                            &arp->dataARPSrcIPMask, "/") < 0 ||
+            nftablesAddItem(&match, vars, dstmac,
+                            &arp->dataARPDstMACAddr, NULL, NULL) < 0 ||
+            nftablesAddItem(&match, vars, dstip,
+                            &arp->dataARPDstIPAddr,
+                            &arp->dataARPDstIPMask, "/") < 0)
+            return -1;
+        break;
+    }
+
+    case VIR_NWFILTER_RULE_PROTOCOL_IP:
+    case VIR_NWFILTER_RULE_PROTOCOL_IPV6: {
+        bool ipv6 = rule->prtclType == VIR_NWFILTER_RULE_PROTOCOL_IPV6;
+        ipHdrDataDefPtr ipHdr;
+        portDataDefPtr portData;
+        const char *family = ipv6 ? "ip6" : "ip";
+        g_autofree char *srcip = g_strdup_printf("%s %s", family, src);
+        g_autofree char *dstip = g_strdup_printf("%s %s", family, dst);
+        g_autofree char *proto = g_strdup_printf("%s %s", family,
+                                                 ipv6 ? "nexthdr" : "protocol");
+        g_autofree char *dscp = g_strdup_printf("%s dscp", family);
+
+        if (ipv6) {
+            ipHdr = &rule->p.ipv6HdrFilter.ipHdr;
+            portData = &rule->p.ipv6HdrFilter.portData;
+            if (nftablesHandleEthHdr(&match, vars,
+                                     &rule->p.ipv6HdrFilter.ethHdr,
+                                     reverse) < 0)
+                return -1;
+        } else {
+            ipHdr = &rule->p.ipHdrFilter.ipHdr;
+            portData = &rule->p.ipHdrFilter.portData;
+            if (nftablesHandleEthHdr(&match, vars,
+                                     &rule->p.ipHdrFilter.ethHdr,
+                                     reverse) < 0)
+                return -1;
+        }
+
+        virBufferAsprintf(&match, " ether type %s", family);
+
+        if (nftablesAddItem(&match, vars, srcip,
+                            &ipHdr->dataSrcIPAddr,
+                            &ipHdr->dataSrcIPMask, "/") < 0 ||
+            nftablesAddItem(&match, vars, dstip,
+                            &ipHdr->dataDstIPAddr,
+                            &ipHdr->dataDstIPMask, "/") < 0 ||
+            nftablesAddItem(&match, vars, proto,
+                            &ipHdr->dataProtocolID, NULL, NULL) < 0 ||
+            nftablesAddItem(&match, vars, sport,
+                            &portData->dataSrcPortStart,
+                            &portData->dataSrcPortEnd, "-") < 0 ||
+            nftablesAddItem(&match, vars, dport,
+                            &portData->dataDstPortStart,
+                            &portData->dataDstPortEnd, "-") < 0 ||
+            nftablesAddItem(&match, vars, dscp,
+                            &ipHdr->dataDSCP, NULL, NULL) < 0)
+            return -1;
+
+        if (ipv6 &&
+            (nftablesAddItem(&match, vars, "icmpv6 type",
+                             &rule->p.ipv6HdrFilter.dataICMPTypeStart,
+                             &rule->p.ipv6HdrFilter.dataICMPTypeEnd, "-") < 0 ||
+             nftablesAddItem(&match, vars, "icmpv6 code",
+                             &rule->p.ipv6HdrFilter.dataICMPCodeStart,
+                             &rule->p.ipv6HdrFilter.dataICMPCodeEnd, "-") < 0))
+            return -1;
+        break;
+    }
+
+    case VIR_NWFILTER_RULE_PROTOCOL_VLAN:
+    case VIR_NWFILTER_RULE_PROTOCOL_STP:
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                       _("the nftables nwfilter driver does not support "
+                         "%s rules"),
+                       virNWFilterRuleProtocolTypeToString(rule->prtclType));
+        return -1;
+
+    default:
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unexpected rule protocol %d"),
+                       rule->prtclType);
+        return -1;
+    }
+
+    /* the bridge prerouting and postrouting hooks can't reject */
+    if (rule->action == VIR_NWFILTER_RULE_ACTION_REJECT)
+        verdict = "drop";
+    else
+        verdict = nftablesVerdict(rule->action);
+
+    virBufferAsprintf(buf, "add rule " NFTABLES_TABLE " \"%s\"%s %s\n",
+                      chain, virBufferCurrentContent(&match), verdict);
+
+    return 0;
+}
+
+
+static void
+nftablesPrintStateMatchFlags(virBufferPtr buf,
+                             int32_t flags)
+{
+    static const struct {
+        virNWFilterRuleFlags flag;
+        const char *name;
+    } states[] = {
+        { RULE_FLAG_STATE_NEW, "new" },
+        { RULE_FLAG_STATE_ESTABLISHED, "established" },
+        { RULE_FLAG_STATE_RELATED, "related" },
+        { RULE_FLAG_STATE_INVALID, "invalid" },
+    };
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS(states); i++) {
+        if (flags & states[i].flag)
+            virBufferAsprintf(buf, "%s,", states[i].name);
+    }
+    virBufferTrim(buf, ",");
+}
+
+
+/*
+ * _nftablesCreateIPRuleInstance:
+ * @buf: buffer to append the rule to
+ * @chain: the chain to add the rule to
+ * @rule: the rule of the filter to convert
+ * @vars: a map containing the variables to resolve
+ * @directionIn: whether to swap src and dst attributes
+ * @match: optional connection tracking states to match
+ * @defMatch: whether @match is the default state match
+ * @accept: verdict for accepted traffic
+ * @maySkipICMP: whether ICMP rules with a type may be skipped
+ *
+ * Converts an IP level rule the same way _iptablesCreateRuleInstance
+ * does.
+ */
+static int
+_nftablesCreateIPRuleInstance(virBufferPtr buf,
+                              const char *chain,
+                              virNWFilterRuleDefPtr rule,
+                              virNWFilterVarCombIterPtr vars,
+                              bool directionIn,
+                              const char *match,
+                              bool defMatch,
+                              const char *accept,
+                              bool maySkipICMP)
+{
+    g_auto(virBuffer) rulebuf = VIR_BUFFER_INITIALIZER;
+    bool ipv6 = virNWFilterRuleIsProtocolIPv6(rule);
+    const char *family = ipv6 ? "ip6" : "ip";
+    const char *l4proto = NULL;
+    nwItemDescPtr srcMacAddr;
+    ipHdrDataDefPtr ipHdr;
+    portDataDefPtr portData = NULL;
+    bool srcMacSkipped = false;
+    bool skipMatch = false;
+    bool hasICMPType = false;
+    g_autofree char *srcip = NULL;
+    g_autofree char *dstip = NULL;
+    g_autofree char *dscp = NULL;
+    g_autofree char *sport = NULL;
+    g_autofree char *dport = NULL;
+    const char *verdict;
+    size_t matchstart;
+
+    /* all the IP level protocols share the layout of the header part */
+    srcMacAddr = &rule->p.allHdrFilter.dataSrcMACAddr;
+    ipHdr = &rule->p.allHdrFilter.ipHdr;
+
+    switch ((int)rule->prtclType) {
+    case VIR_NWFILTER_RULE_PROTOCOL_TCP:
+    case VIR_NWFILTER_RULE_PROTOCOL_TCPoIPV6:
+        l4proto = "tcp";
+        portData = &rule->p.tcpHdrFilter.portData;
+        break;
+    case VIR_NWFILTER_RULE_PROTOCOL_UDP:
+    case VIR_NWFILTER_RULE_PROTOCOL_UDPoIPV6:
+        l4proto = "udp";
+        portData = &rule->p.udpHdrFilter.portData;
+        break;
+    case VIR_NWFILTER_RULE_PROTOCOL_SCTP:
+    case VIR_NWFILTER_RULE_PROTOCOL_SCTPoIPV6:
+        l4proto = "sctp";
+        portData = &rule->p.sctpHdrFilter.portData;
+        break;
+    case VIR_NWFILTER_RULE_PROTOCOL_UDPLITE:
+    case VIR_NWFILTER_RULE_PROTOCOL_UDPLITEoIPV6:
+        l4proto = "udplite";
+        break;
+    case VIR_NWFILTER_RULE_PROTOCOL_ESP:
+    case VIR_NWFILTER_RULE_PROTOCOL_ESPoIPV6:
+        l4proto = "esp";
+        break;
+    case VIR_NWFILTER_RULE_PROTOCOL_AH:
+    case VIR_NWFILTER_RULE_PROTOCOL_AHoIPV6:
+        l4proto = "ah";
+        break;
+    case VIR_NWFILTER_RULE_PROTOCOL_IGMP:
+        l4proto = "igmp";
+        break;
+    case VIR_NWFILTER_RULE_PROTOCOL_ICMP:
+        l4proto = "icmp";
+        break;
+    case VIR_NWFILTER_RULE_PROTOCOL_ICMPV6:
+        l4proto = "icmpv6";
+        break;
+    case VIR_NWFILTER_RULE_PROTOCOL_ALL:
+    case VIR_NWFILTER_RULE_PROTOCOL_ALLoIPV6:
+        break;
+    default:
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unexpected protocol %d"),
+                       rule->prtclType);
+        return -1;
+    }
+
+    if (HAS_ENTRY_ITEM(&ipHdr->dataIPSet))
+        return nftablesUnsupported(rule, "ipset");
+    if (HAS_ENTRY_ITEM(&ipHdr->dataConnlimitAbove))
+        return nftablesUnsupported(rule, "connlimit-above");
+    if (l4proto && STREQ(l4proto, "tcp") &&
+        HAS_ENTRY_ITEM(&rule->p.tcpHdrFilter.dataTCPOption))
+        return nftablesUnsupported(rule, "option");
+
+    virBufferAsprintf(&rulebuf, " ether type %s", family);
+    if (l4proto)
+        virBufferAsprintf(&rulebuf, " meta l4proto %s", l4proto);
+
+    matchstart = virBufferUse(&rulebuf);
+
+    if (HAS_ENTRY_ITEM(srcMacAddr)) {
+        if (directionIn)
+            srcMacSkipped = true;
+        else if (nftablesAddItem(&rulebuf, vars, "ether saddr",
+                                 srcMacAddr, NULL, NULL) < 0)
+            return -1;
+    }
+
+    srcip = g_strdup_printf("%s %s", family, directionIn ? "daddr" : "saddr");
+    dstip = g_strdup_printf("%s %s", family, directionIn ? "saddr" : "daddr");
+    dscp = g_strdup_printf("%s dscp", family);
+
+    if (HAS_ENTRY_ITEM(&ipHdr->dataSrcIPAddr)) {
+        if (nftablesAddItem(&rulebuf, vars, srcip,
+                            &ipHdr->dataSrcIPAddr,
+                            &ipHdr->dataSrcIPMask, "/") < 0)
+            return -1;
+    } else if (nftablesAddItem(&rulebuf, vars, srcip,
+                               &ipHdr->dataSrcIPFrom,
+                               &ipHdr->dataSrcIPTo, "-") < 0) {
+        return -1;
+    }
+
+    if (HAS_ENTRY_ITEM(&ipHdr->dataDstIPAddr)) {
+        if (nftablesAddItem(&rulebuf, vars, dstip,
+                            &ipHdr->dataDstIPAddr,
+                            &ipHdr->dataDstIPMask, "/") < 0)
+            return -1;
+    } else if (nftablesAddItem(&rulebuf, vars, dstip,
+                               &ipHdr->dataDstIPFrom,
+                               &ipHdr->dataDstIPTo, "-") < 0) {
+        return -1;
+    }
+
+    if (nftablesAddItem(&rulebuf, vars, dscp,
+                        &ipHdr->dataDSCP, NULL, NULL) < 0)
+        return -1;
+
+    if (portData) {
+        sport = g_strdup_printf("%s %s", l4proto, directionIn ? "dport" : "sport");
+        dport = g_strdup_printf("%s %s", l4proto, directionIn ? "sport" : "dport");
+
+        if (nftablesAddItem(&rulebuf, vars, sport,
+                            &portData->dataSrcPortStart,
+                            &portData->dataSrcPortEnd, "-") < 0 ||
+            nftablesAddItem(&rulebuf, vars, dport,
+                            &portData->dataDstPortStart,
+                            &portData->dataDstPortEnd, "-") < 0)
+            return -1;
+    }
+
+    if (portData && STREQ(l4proto, "tcp") &&
+        HAS_ENTRY_ITEM(&rule->p.tcpHdrFilter.dataTCPFlags)) {
+        nwItemDescPtr flags = &rule->p.tcpHdrFilter.dataTCPFlags;
+
+        virBufferAsprintf(&rulebuf, " tcp flags & 0x%x %s 0x%x",
+                          flags->u.tcpFlags.mask,
+                          ENTRY_WANT_NEG_SIGN(flags) ? "!=" : "==",
+                          flags->u.tcpFlags.flags);
+    }
+
+    if (rule->prtclType == VIR_NWFILTER_RULE_PROTOCOL_ICMP ||
+        rule->prtclType == VIR_NWFILTER_RULE_PROTOCOL_ICMPV6) {
+        icmpHdrFilterDefPtr icmp = &rule->p.icmpHdrFilter;
+        g_autofree char *type = g_strdup_printf("%s type", l4proto);
+        g_autofree char *code = g_strdup_printf("%s code", l4proto);
+
+        if (HAS_ENTRY_ITEM(&icmp->dataICMPType)) {
+            hasICMPType = true;
+
+            if (maySkipICMP)
+                return 0;
+
+            if (nftablesAddItem(&rulebuf, vars, type,
+                                &icmp->dataICMPType, NULL, NULL) < 0 ||
+                nftablesAddItem(&rulebuf, vars, code,
+                                &icmp->dataICMPCode, NULL, NULL) < 0)
+                return -1;
+        }
+    }
+
+    if (srcMacSkipped && virBufferUse(&rulebuf) == matchstart)
+        return 0;
+
+    if (rule->action == VIR_NWFILTER_RULE_ACTION_ACCEPT) {
+        verdict = accept;
+    } else {
+        verdict = nftablesVerdict(rule->action);
+        skipMatch = defMatch;
+    }
+
+    if (match && *match && !skipMatch)
+        virBufferAsprintf(&rulebuf, " ct state %s", match);
+
+    /* ebiptables only enforces the direction on kernels with the
+     * corrected meaning of --ctdir, which is all nft runs on */
+    if (defMatch && match && !skipMatch && !hasICMPType &&
+        rule->tt != VIR_NWFILTER_RULE_DIRECTION_INOUT)
+        virBufferAsprintf(&rulebuf, " ct direction %s",
+                          directionIn ? "reply" : "original");
+
+    virBufferAsprintf(buf, "add rule " NFTABLES_TABLE " \"%s\"%s %s\n",
+                      chain, virBufferCurrentContent(&rulebuf), verdict);
+
+    return 0;
+}
+
+
+/*
+ * Puts an IP level rule into the chains of both directions with the
+ * connection tracking logic of iptablesCreateRuleInstance. The host-in
+ * chain of ebiptables always holds the same rules as the one for the
+ * traffic sent by the VM, so both use the same chain here.
+ */
+static int
+nftablesCreateIPRuleInstance(virBufferPtr buf,
+                             const char *ifname,
+                             unsigned int gen,
+                             virNWFilterRuleDefPtr rule,
+                             virNWFilterVarCombIterPtr vars)
+{
+    g_autofree char *chainOut = nftablesChainName(ifname, gen,
+                                                  NFTABLES_CHAIN_L3_OUT, NULL);
+    g_autofree char *chainIn = nftablesChainName(ifname, gen,
+                                                 NFTABLES_CHAIN_L3_IN, NULL);
+    g_auto(virBuffer) state = VIR_BUFFER_INITIALIZER;
+    bool directionIn = false;
+    bool inout = false;
+    bool needState = true;
+    const char *matchOut = NULL;
+    const char *matchIn = NULL;
+
+    if (rule->tt == VIR_NWFILTER_RULE_DIRECTION_IN ||
+        rule->tt == VIR_NWFILTER_RULE_DIRECTION_INOUT) {
+        directionIn = true;
+        inout = (rule->tt == VIR_NWFILTER_RULE_DIRECTION_INOUT);
+        if (inout)
+            needState = false;
+    }
+
+    if (!(rule->flags & RULE_FLAG_NO_STATEMATCH) &&
+        (rule->flags & IPTABLES_STATE_FLAGS)) {
+        nftablesPrintStateMatchFlags(&state, rule->flags);
+
+        if (!(directionIn && !inout) &&
+            _nftablesCreateIPRuleInstance(buf, chainOut, rule, vars,
+                                          directionIn,
+                                          virBufferCurrentContent(&state),
+                                          false, "return",
+                                          directionIn || inout) < 0)
+            return -1;
+
+        if (directionIn &&
+            _nftablesCreateIPRuleInstance(buf, chainIn, rule, vars,
+                                          !directionIn,
+                                          virBufferCurrentContent(&state),
+                                          false, "accept",
+                                          !directionIn || inout) < 0)
+            return -1;
+
+        return 0;
+    }
+
+    if ((rule->flags & RULE_FLAG_NO_STATEMATCH))
+        needState = false;
+
+    if (needState) {
+        matchOut = directionIn ? "established" : "new,established";
+        matchIn = directionIn ? "new,established" : "established";
+    }
+
+    if (_nftablesCreateIPRuleInstance(buf, chainOut, rule, vars,
+                                      directionIn, matchOut, true,
+                                      "return", directionIn || inout) < 0 ||
+        _nftablesCreateIPRuleInstance(buf, chainIn, rule, vars,
+                                      !directionIn, matchIn, true,
+                                      "accept", !directionIn || inout) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+nftablesCreateRuleInstance(virBufferPtr buf,
+                           const char *ifname,
+                           unsigned int gen,
+                           virNWFilterRuleInstPtr inst,
+                           virNWFilterVarCombIterPtr vars)
+{
+    virNWFilterRuleDefPtr rule = inst->def;
+    const char *suffix = inst->chainSuffix;
+
+    if (!virNWFilterRuleIsProtocolEthernet(rule))
+        return nftablesCreateIPRuleInstance(buf, ifname, gen, rule, vars);
+
+    if (STREQ(suffix, virNWFilterChainSuffixTypeToString(
+                          VIR_NWFILTER_CHAINSUFFIX_ROOT)))
+        suffix = NULL;
+
+    if (rule->tt == VIR_NWFILTER_RULE_DIRECTION_OUT ||
+        rule->tt == VIR_NWFILTER_RULE_DIRECTION_INOUT) {
+        g_autofree char *chain = nftablesChainName(ifname, gen,
+                                                   NFTABLES_CHAIN_L2_OUT,
+                                                   suffix);
+
+        if (nftablesCreateEthRuleInstance(buf, chain, rule, vars,
+                                          rule->tt == VIR_NWFILTER_RULE_DIRECTION_INOUT) < 0)
+            return -1;
+    }
+
+    if (rule->tt == VIR_NWFILTER_RULE_DIRECTION_IN ||
+        rule->tt == VIR_NWFILTER_RULE_DIRECTION_INOUT) {
+        g_autofree char *chain = nftablesChainName(ifname, gen,
+                                                   NFTABLES_CHAIN_L2_IN,
+                                                   suffix);
+
+        if (nftablesCreateEthRuleInstance(buf, chain, rule, vars, false) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+nftablesRuleInstCommand(virBufferPtr buf,
+                        const char *ifname,
+                        unsigned int gen,
+                        virNWFilterRuleInstPtr rule)
+{
+    virNWFilterVarCombIterPtr vciter, tmp;
+    int ret = -1;
+
+    /* instantiate the rule with every combination of the values of the
+     * variables it accesses */
+    tmp = vciter = virNWFilterVarCombIterCreate(rule->vars,
+                                                rule->def->varAccess,
+                                                rule->def->nVarAccess);
+    if (!vciter)
+        return -1;
+
+    do {
+        if (nftablesCreateRuleInstance(buf, ifname, gen, rule, tmp) < 0)
+            goto cleanup;
+        tmp = virNWFilterVarCombIterNext(tmp);
+    } while (tmp != NULL);
+
+    ret = 0;
+ cleanup:
+    virNWFilterVarCombIterFree(vciter);
+    return ret;
+}
+
+
+static int
+nftablesRuleInstSort(const void *a, const void *b)
+{
+    const virNWFilterRuleInst *insta = *(const virNWFilterRuleInst **)a;
+    const virNWFilterRuleInst *instb = *(const virNWFilterRuleInst **)b;
+    const char *root = virNWFilterChainSuffixTypeToString(
+                                     VIR_NWFILTER_CHAINSUFFIX_ROOT);
+    bool root_a = STREQ(insta->chainSuffix, root);
+    bool root_b = STREQ(instb->chainSuffix, root);
+
+    /* root chain rules go first, like with ebiptables */
+    if (root_a != root_b)
+        return root_a ? -1 : 1;
+
+    /* priorities are limited to range [-1000, 1000] */
+    return insta->priority - instb->priority;
+}
+
+
+struct nftablesSubChain {
+    virNWFilterChainPriority priority;
+    nftablesChainKind kind;
+    const char *name;
+};
+
+
+static int
+nftablesSubChainSort(const void *a, const void *b)
+{
+    const struct nftablesSubChain *sa = a;
+    const struct nftablesSubChain *sb = b;
+
+    /* priorities are limited to range [-1000, 1000] */
+    return sa->priority - sb->priority;
+}
+
+
+static int
+nftablesAddSubChain(struct nftablesSubChain **subchains,
+                    size_t *nsubchains,
+                    nftablesChainKind kind,
+                    virNWFilterRuleInstPtr rule)
+{
+    struct nftablesSubChain sub = {
+        .priority = rule->chainPriority,
+        .kind = kind,
+        .name = rule->chainSuffix,
+    };
+    size_t i;
+
+    for (i = 0; i < *nsubchains; i++) {
+        if ((*subchains)[i].kind == kind &&
+            STREQ((*subchains)[i].name, rule->chainSuffix))
+            return 0;
+    }
+
+    return VIR_APPEND_ELEMENT(*subchains, *nsubchains, sub);
+}
+
+
+/* Appends the jump into @sub to its root chain */
+static void
+nftablesPrintSubChainJump(virBufferPtr buf,
+                          const char *ifname,
+                          unsigned int gen,
+                          struct nftablesSubChain *sub)
+{
+    g_autofree char *root = nftablesChainName(ifname, gen, sub->kind, NULL);
+    g_autofree char *chain = nftablesChainName(ifname, gen, sub->kind,
+                                               sub->name);
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS(nftablesSubChainMatches); i++) {
+        if (STRPREFIX(sub->name, nftablesSubChainMatches[i].prefix)) {
+            virBufferAsprintf(buf, "add rule " NFTABLES_TABLE " \"%s\"%s "
+                              "jump \"%s\"\n",
+                              root, nftablesSubChainMatches[i].match, chain);
+            return;
+        }
+    }
+}
+
+
+static int
+nftablesApplyNewRules(const char *ifname,
+                      virNWFilterRuleInstPtr *rules,
+                      size_t nrules)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    struct nftablesSubChain *subchains = NULL;
+    size_t nsubchains = 0;
+    char **chains = NULL;
+    size_t nchains = 0;
+    unsigned int gen;
+    size_t i, j;
+    int ret = -1;
+
+    if (nftablesCheckIfname(ifname) < 0)
+        return -1;
+
+    if (nrules)
+        qsort(rules, nrules, sizeof(rules[0]), nftablesRuleInstSort);
+
+    /* rules of sub chains don't go before the jump into their chain,
+     * see ebiptablesApplyNewRules */
+    for (i = 0; i < nrules; i++) {
+        if (rules[i]->chainPriority > rules[i]->priority &&
+            !strstr("root", rules[i]->chainSuffix)) {
+
+             rules[i]->priority = rules[i]->chainPriority;
+        }
+    }
+
+    virMutexLock(&nftablesLock);
+
+    if (!(gen = nftablesNewGeneration(ifname, &chains, &nchains)))
+        goto cleanup;
+
+    for (i = 0; i < nrules; i++) {
+        if (!virNWFilterRuleIsProtocolEthernet(rules[i]->def) ||
+            STREQ(rules[i]->chainSuffix,
+                  virNWFilterChainSuffixTypeToString(VIR_NWFILTER_CHAINSUFFIX_ROOT)))
+            continue;
+
+        if ((rules[i]->def->tt == VIR_NWFILTER_RULE_DIRECTION_OUT ||
+             rules[i]->def->tt == VIR_NWFILTER_RULE_DIRECTION_INOUT) &&
+            nftablesAddSubChain(&subchains, &nsubchains,
+                                NFTABLES_CHAIN_L2_OUT, rules[i]) < 0)
+            goto cleanup;
+
+        if ((rules[i]->def->tt == VIR_NWFILTER_RULE_DIRECTION_IN ||
+             rules[i]->def->tt == VIR_NWFILTER_RULE_DIRECTION_INOUT) &&
+            nftablesAddSubChain(&subchains, &nsubchains,
+                                NFTABLES_CHAIN_L2_IN, rules[i]) < 0)
+            goto cleanup;
+    }
+
+    if (nsubchains > 0)
+        qsort(subchains, nsubchains, sizeof(subchains[0]),
+              nftablesSubChainSort);
+
+    for (i = 0; i < nsubchains; i++) {
+        char *chain = nftablesChainName(ifname, gen, subchains[i].kind,
+                                        subchains[i].name);
+
+        if (VIR_APPEND_ELEMENT(chains, nchains, chain) < 0) {
+            VIR_FREE(chain);
+            goto cleanup;
+        }
+    }
+
+    /* interleave the jumps into the sub chains with the rules of the
+     * root chains by priority */
+    for (i = 0, j = 0; i < nrules; i++) {
+        if (virNWFilterRuleIsProtocolEthernet(rules[i]->def)) {
+            while (j < nsubchains &&
+                   subchains[j].priority <= rules[i]->priority) {
+                nftablesPrintSubChainJump(&buf, ifname, gen, &subchains[j]);
+                j++;
+            }
+        }
+
+        if (nftablesRuleInstCommand(&buf, ifname, gen, rules[i]) < 0)
+            goto cleanup;
+    }
+
+    while (j < nsubchains) {
+        nftablesPrintSubChainJump(&buf, ifname, gen, &subchains[j]);
+        j++;
+    }
+
+    if (nftablesCommit(ifname, gen, &chains, &nchains, &buf, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virMutexUnlock(&nftablesLock);
+    nftablesFreeChains(chains, nchains);
+    VIR_FREE(subchains);
+    return ret;
+}
+
+
+static int
+nftablesTearNewRules(const char *ifname)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    nftablesIfacePtr iface;
+    int ret = -1;
+
+    virMutexLock(&nftablesLock);
+
+    if (!nftablesIfaces ||
+        !(iface = virHashLookup(nftablesIfaces, ifname)) ||
+        !iface->pending) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    nftablesPrintRemoveChains(&buf, iface, iface->pending);
+
+    if (nftablesRun(&buf) < 0)
+        goto cleanup;
+
+    nftablesIfaceDropChains(iface, iface->pending);
+    iface->pending = 0;
+    ret = 0;
+
+ cleanup:
+    virMutexUnlock(&nftablesLock);
+    return ret;
+}
+
+
+static int
+nftablesTearOldRules(const char *ifname)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    nftablesIfacePtr iface;
+    size_t i;
+    int ret = -1;
+
+    virMutexLock(&nftablesLock);
+
+    if (!nftablesIfaces ||
+        !(iface = virHashLookup(nftablesIfaces, ifname)) ||
+        !iface->pending) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    nftablesPrintActivate(&buf, ifname, iface->pending);
+
+    for (i = 0; i < iface->nchains; i++) {
+        if (nftablesChainGeneration(iface->chains[i]) == iface->pending)
+            continue;
+        virBufferAsprintf(&buf, "flush chain " NFTABLES_TABLE " \"%s\"\n",
+                          iface->chains[i]);
+    }
+    for (i = 0; i < iface->nchains; i++) {
+        if (nftablesChainGeneration(iface->chains[i]) == iface->pending)
+            continue;
+        virBufferAsprintf(&buf, "delete chain " NFTABLES_TABLE " \"%s\"\n",
+                          iface->chains[i]);
+    }
+
+    if (nftablesRun(&buf) < 0)
+        goto cleanup;
+
+    for (i = 0; i < iface->nchains;) {
+        if (nftablesChainGeneration(iface->chains[i]) == iface->pending) {
+            i++;
+            continue;
+        }
+        VIR_FREE(iface->chains[i]);
+        VIR_DELETE_ELEMENT(iface->chains, i, iface->nchains);
+    }
+    iface->pending = 0;
+    ret = 0;
+
+ cleanup:
+    virMutexUnlock(&nftablesLock);
+    return ret;
+}
+
+
+/**
+ * nftablesAllTeardown:
+ * @ifname : the name of the interface to which the rules apply
+ *
+ * Unconditionally remove all the chains and map entries that were
+ * created for the given interface (ifname).
+ *
+ * Returns 0 on success, -1 on failure
+ */
+static int
+nftablesAllTeardown(const char *ifname)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    nftablesIfacePtr iface = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (nftablesCheckIfname(ifname) < 0)
+        return -1;
+
+    virMutexLock(&nftablesLock);
+
+    /* adding before deleting keeps the transaction from failing if the
+     * interface is unknown to nftables */
+    for (i = 0; i < NFTABLES_CHAIN_LAST; i++) {
+        g_autofree char *dispatch = nftablesChainName(ifname, 0, i, NULL);
+
+        virBufferAsprintf(&buf, "add chain " NFTABLES_TABLE " \"%s\"\n",
+                          dispatch);
+        virBufferAsprintf(&buf,
+                          "add element " NFTABLES_TABLE " %s "
+                          "{ \"%s\" : jump \"%s\" }\n",
+                          nftablesMaps[i], ifname, dispatch);
+        virBufferAsprintf(&buf,
+                          "delete element " NFTABLES_TABLE " %s { \"%s\" }\n",
+                          nftablesMaps[i], ifname);
+        virBufferAsprintf(&buf, "flush chain " NFTABLES_TABLE " \"%s\"\n",
+                          dispatch);
+        virBufferAsprintf(&buf, "delete chain " NFTABLES_TABLE " \"%s\"\n",
+                          dispatch);
+    }
+
+    if (nftablesIfaces && (iface = virHashLookup(nftablesIfaces, ifname)))
+        nftablesPrintRemoveChains(&buf, iface, 0);
+
+    if (nftablesRun(&buf) < 0)
+        goto cleanup;
+
+    if (iface)
+        virHashRemoveEntry(nftablesIfaces, ifname);
+    ret = 0;
+
+ cleanup:
+    virMutexUnlock(&nftablesLock);
+    return ret;
+}
+
+
+/*
+ * nftablesCanApplyBasicRules
+ *
+ * Determine whether this driver can apply the basic rules, meaning
+ * run nftablesApplyBasicRules and nftablesApplyDHCPOnlyRules.
+ */
+static int
+nftablesCanApplyBasicRules(void)
+{
+    return true;
+}
+
+
+/*
+ * Installs a generation consisting of @rules only and switches to it
+ * right away.
+ */
+static int
+nftablesApplyRulesNow(const char *ifname,
+                      unsigned int gen,
+                      char ***chains,
+                      size_t *nchains,
+                      virBufferPtr rules)
+{
+    int ret;
+
+    ret = nftablesCommit(ifname, gen, chains, nchains, rules, true);
+    nftablesFreeChains(*chains, *nchains);
+    virMutexUnlock(&nftablesLock);
+    return ret;
+}
+
+
+/**
+ * nftablesApplyBasicRules
+ *
+ * @ifname: name of the backend-interface to which to apply the rules
+ * @macaddr: MAC address the VM is using in packets sent through the
+ *    interface
+ *
+ * Returns 0 on success, -1 on failure with the old rules left in place
+ *
+ * Apply basic filtering rules on the given interface
+ * - filtering for MAC address spoofing
+ * - allowing IPv4 & ARP traffic
+ */
+static int
+nftablesApplyBasicRules(const char *ifname,
+                        const virMacAddr *macaddr)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *chain = NULL;
+    char macaddr_str[VIR_MAC_STRING_BUFLEN];
+    char **chains = NULL;
+    size_t nchains = 0;
+    unsigned int gen;
+
+    if (nftablesCheckIfname(ifname) < 0)
+        return -1;
+
+    virMacAddrFormat(macaddr, macaddr_str);
+
+    virMutexLock(&nftablesLock);
+
+    gen = nftablesNewGeneration(ifname, &chains, &nchains);
+    chain = nftablesChainName(ifname, gen, NFTABLES_CHAIN_L2_OUT, NULL);
+
+    virBufferAsprintf(&buf, "add rule " NFTABLES_TABLE " \"%s\" "
+                      "ether saddr != %s drop\n", chain, macaddr_str);
+    virBufferAsprintf(&buf, "add rule " NFTABLES_TABLE " \"%s\" "
+                      "ether type ip accept\n", chain);
+    virBufferAsprintf(&buf, "add rule " NFTABLES_TABLE " \"%s\" "
+                      "ether type arp accept\n", chain);
+    virBufferAsprintf(&buf, "add rule " NFTABLES_TABLE " \"%s\" drop\n",
+                      chain);
+
+    if (!gen) {
+        nftablesFreeChains(chains, nchains);
+        virMutexUnlock(&nftablesLock);
+        return -1;
+    }
+
+    return nftablesApplyRulesNow(ifname, gen, &chains, &nchains, &buf);
+}
+
+
+/**
+ * nftablesApplyDHCPOnlyRules
+ *
+ * @ifname: name of the backend-interface to which to apply the rules
+ * @macaddr: MAC address the VM is using in packets sent through the
+ *    interface
+ * @dhcpsrvrs: The DHCP server(s) from which the VM may receive traffic
+ *    from; may be NULL
+ * @leaveTemporary: Unused, the rules are put in force right away
+ *
+ * Returns 0 on success, -1 on failure with the old rules left in place
+ *
+ * Apply filtering rules so that the VM can only send and receive
+ * DHCP traffic and nothing else.
+ */
+static int
+nftablesApplyDHCPOnlyRules(const char *ifname,
+                           const virMacAddr *macaddr,
+                           virNWFilterVarValuePtr dhcpsrvrs,
+                           bool leaveTemporary G_GNUC_UNUSED)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_auto(virBuffer) servers = VIR_BUFFER_INITIALIZER;
+    g_autofree char *chain_in = NULL;
+    g_autofree char *chain_out = NULL;
+    char macaddr_str[VIR_MAC_STRING_BUFLEN];
+    unsigned int num_dhcpsrvrs;
+    char **chains = NULL;
+    size_t nchains = 0;
+    unsigned int gen;
+    size_t i;
+
+    if (nftablesCheckIfname(ifname) < 0)
+        return -1;
+
+    virMacAddrFormat(macaddr, macaddr_str);
+
+    num_dhcpsrvrs = (dhcpsrvrs != NULL)
+                    ? virNWFilterVarValueGetCardinality(dhcpsrvrs)
+                    : 0;
+
+    /* all servers go into one anonymous set */
+    for (i = 0; i < num_dhcpsrvrs; i++) {
+        const char *dhcpserver = virNWFilterVarValueGetNthValue(dhcpsrvrs, i);
+
+        if (strspn(dhcpserver, NFTABLES_VALID_VALUE) != strlen(dhcpserver)) {
+            virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                           _("Invalid DHCP server '%s'"), dhcpserver);
+            return -1;
+        }
+        virBufferAsprintf(&servers, "%s, ", dhcpserver);
+    }
+    virBufferTrim(&servers, ", ");
+
+    virMutexLock(&nftablesLock);
+
+    gen = nftablesNewGeneration(ifname, &chains, &nchains);
+    chain_out = nftablesChainName(ifname, gen, NFTABLES_CHAIN_L2_OUT, NULL);
+    chain_in = nftablesChainName(ifname, gen, NFTABLES_CHAIN_L2_IN, NULL);
+
+    virBufferAsprintf(&buf, "add rule " NFTABLES_TABLE " \"%s\" "
+                      "ether saddr %s ether type ip meta l4proto udp "
+                      "udp sport 68 udp dport 67 accept\n",
+                      chain_out, macaddr_str);
+    virBufferAsprintf(&buf, "add rule " NFTABLES_TABLE " \"%s\" drop\n",
+                      chain_out);
+
+    virBufferAsprintf(&buf, "add rule " NFTABLES_TABLE " \"%s\" "
+                      "ether daddr { %s, ff:ff:ff:ff:ff:ff } "
+                      "ether type ip meta l4proto udp",
+                      chain_in, macaddr_str);
+    if (num_dhcpsrvrs > 0)
+        virBufferAsprintf(&buf, " ip saddr { %s }",
+                          virBufferCurrentContent(&servers));
+    virBufferAddLit(&buf, " udp sport 67 udp dport 68 accept\n");
+    virBufferAsprintf(&buf, "add rule " NFTABLES_TABLE " \"%s\" drop\n",
+                      chain_in);
+
+    if (!gen) {
+        nftablesFreeChains(chains, nchains);
+        virMutexUnlock(&nftablesLock);
+        return -1;
+    }
+
+    return nftablesApplyRulesNow(ifname, gen, &chains, &nchains, &buf);
+}
+
+
+/**
+ * nftablesApplyDropAllRules
+ *
+ * @ifname: name of the backend-interface to which to apply the rules
+ *
+ * Returns 0 on success, -1 on failure with the old rules left in place
+ *
+ * Apply filtering rules so that the VM cannot receive or send traffic.
+ */
+static int
+nftablesApplyDropAllRules(const char *ifname)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    char **chains = NULL;
+    size_t nchains = 0;
+    unsigned int gen;
+    size_t i;
+
+    if (nftablesCheckIfname(ifname) < 0)
+        return -1;
+
+    virMutexLock(&nftablesLock);
+
+    if (!(gen = nftablesNewGeneration(ifname, &chains, &nchains))) {
+        nftablesFreeChains(chains, nchains);
+        virMutexUnlock(&nftablesLock);
+        return -1;
+    }
+
+    for (i = NFTABLES_CHAIN_L2_OUT; i <= NFTABLES_CHAIN_L2_IN; i++)
+        virBufferAsprintf(&buf, "add rule " NFTABLES_TABLE " \"%s\" drop\n",
+                          chains[i]);
+
+    return nftablesApplyRulesNow(ifname, gen, &chains, &nchains, &buf);
+}
+
+
+static int
+nftablesRemoveBasicRules(const char *ifname)
+{
+    return nftablesAllTeardown(ifname);
+}
+
+
+/*
+ * Creates the table with its maps and base chains. The dispatch rules
+ * of the base chains are replaced, everything else is left alone so
+ * that filters of running VMs stay in force.
+ */
+static int
+nftablesCreateBase(void)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    static const struct {
+        const char *name;
+        const char *hook;
+        int priority;
+        nftablesChainKind maps[2];
+        const char *match[2];
+    } bases[] = {
+        { "prerouting", "prerouting", -300,
+          { NFTABLES_CHAIN_L2_OUT }, { "iifname" } },
+        { "postrouting", "postrouting", -300,
+          { NFTABLES_CHAIN_L2_IN }, { "oifname" } },
+        { "forward", "forward", -200,
+          { NFTABLES_CHAIN_L3_OUT, NFTABLES_CHAIN_L3_IN },
+          { "iifname", "oifname" } },
+        { "input", "input", -200,
+          { NFTABLES_CHAIN_L3_OUT }, { "iifname" } },
+    };
+    size_t i, j;
+
+    virBufferAddLit(&buf, "add table " NFTABLES_TABLE "\n");
+
+    for (i = 0; i < NFTABLES_CHAIN_LAST; i++)
+        virBufferAsprintf(&buf, "add map " NFTABLES_TABLE " %s "
+                          "{ type ifname : verdict; }\n", nftablesMaps[i]);
+
+    for (i = 0; i < G_N_ELEMENTS(bases); i++) {
+        virBufferAsprintf(&buf, "add chain " NFTABLES_TABLE " %s "
+                          "{ type filter hook %s priority %d; }\n",
+                          bases[i].name, bases[i].hook, bases[i].priority);
+        virBufferAsprintf(&buf, "flush chain " NFTABLES_TABLE " %s\n",
+                          bases[i].name);
+
+        for (j = 0; j < G_N_ELEMENTS(bases[i].match) && bases[i].match[j]; j++)
+            virBufferAsprintf(&buf, "add rule " NFTABLES_TABLE " %s "
+                              "%s vmap @%s\n",
+                              bases[i].name, bases[i].match[j],
+                              nftablesMaps[bases[i].maps[j]]);
+    }
+
+    return nftablesRun(&buf);
+}
+
+
+/*
+ * Picks up the chains left behind by a previous instance of the
+ * daemon, so they get removed once their interfaces are filtered or
+ * torn down again.
+ */
+static int
+nftablesLoadChains(void)
+{
+    g_autoptr(virCommand) cmd = NULL;
+    g_autofree char *output = NULL;
+    g_auto(GStrv) lines = NULL;
+    bool intable = false;
+    size_t i;
+
+    cmd = virCommandNewArgList(NFT_PATH, "list", "chains", "bridge", NULL);
+    virCommandSetOutputBuffer(cmd, &output);
+
+    if (virCommandRun(cmd, NULL) < 0)
+        return -1;
+
+    lines = g_strsplit(NULLSTR_EMPTY(output), "\n", 0);
+
+    for (i = 0; lines[i]; i++) {
+        char *line = g_strstrip(lines[i]);
+        g_autofree char *ifname = NULL;
+        nftablesIfacePtr iface;
+        char *chain;
+        char *tmp;
+        unsigned int gen;
+
+        if (STRPREFIX(line, "table ")) {
+            intable = STRPREFIX(line, "table " NFTABLES_TABLE " ");
+            continue;
+        }
+
+        if (!intable || !STRPREFIX(line, "chain "))
+            continue;
+
+        line += strlen("chain ");
+        if (*line == '"')
+            line++;
+        if (!(tmp = strpbrk(line, "\" ")))
+            continue;
+        *tmp = '\0';
+
+        if ((gen = nftablesChainGeneration(line)) == 0)
+            continue;
+
+        ifname = g_strndup(line, strchr(line, ':') - line);
+        if (!(iface = nftablesIfaceGet(ifname)))
+            return -1;
+
+        chain = g_strdup(line);
+        if (VIR_APPEND_ELEMENT(iface->chains, iface->nchains, chain) < 0) {
+            VIR_FREE(chain);
+            return -1;
+        }
+
+        if (gen > nftablesGeneration)
+            nftablesGeneration = gen;
+    }
+
+    return 0;
+}
+
+
+static int
+nftablesDriverInit(bool privileged)
+{
+    int ret = -1;
+
+    if (!privileged)
+        return 0;
+
+    virMutexLock(&nftablesLock);
+
+    if (nftablesCreateBase() < 0 ||
+        nftablesLoadChains() < 0)
+        goto cleanup;
+
+    nftables_driver.flags = TECHDRV_FLAG_INITIALIZED;
+    ret = 0;
+
+ cleanup:
+    virMutexUnlock(&nftablesLock);
+    return ret;
+}
+
+
+static void
+nftablesDriverShutdown(void)
+{
+    virMutexLock(&nftablesLock);
+    virHashFree(nftablesIfaces);
+    nftablesIfaces = NULL;
+    virMutexUnlock(&nftablesLock);
+
+    nftables_driver.flags = 0;
+}
+
+
+virNWFilterTechDriver nftables_driver = {
+    .name = NFTABLES_DRIVER_ID,
+    .flags = 0,
+
+    .init     = nftablesDriverInit,
+    .shutdown = nftablesDriverShutdown,
+
+    .applyNewRules       = nftablesApplyNewRules,
+    .tearNewRules        = nftablesTearNewRules,
+    .tearOldRules        = nftablesTearOldRules,
+    .allTeardown         = nftablesAllTeardown,
+
+    .canApplyBasicRules  = nftablesCanApplyBasicRules,
+    .applyBasicRules     = nftablesApplyBasicRules,
+    .applyDHCPOnlyRules  = nftablesApplyDHCPOnlyRules,
+    .applyDropAllRules   = nftablesApplyDropAllRules,
+    .removeBasicRules    = nftablesRemoveBasicRules,
+};
@@ -93,6 +93,11 @@ struct _qemuAgentMessage {
     /* id of the issued sync comand */
     unsigned long long id;
     bool first;
+
+    /* Replies to pipelined commands, in the order they were sent */
+    size_t nrxObjects;
+    size_t rxCount;
+    virJSONValuePtr *rxObjects;
 };
 
 
@@ -134,6 +139,9 @@ struct _qemuAgent {
      * Take that as indication of successful completion */
     qemuAgentEvent await_event;
     int timeout;
+
+    /* Replies fetched by qemuAgentPrefetch, keyed by command name */
+    virHashTablePtr prefetched;
 };
 
 static virClassPtr qemuAgentClass;
@@ -177,6 +185,7 @@ static void qemuAgentDispose(void *obj)
     if (agent->cb && agent->cb->destroy)
         (agent->cb->destroy)(agent, agent->vm);
     virCondDestroy(&agent->notify);
+    virHashFree(agent->prefetched);
     VIR_FREE(agent->buffer);
     g_main_context_unref(agent->context);
     virResetError(&agent->lastError);
@@ -263,7 +272,7 @@ qemuAgentIOProcessLine(qemuAgentPtr agent,
 
     VIR_DEBUG("Line [%s]", line);
 
-    if (!(obj = virJSONValueFromString(line))) {
+    if (!(obj = virJSONValueFromStringArena(line, NULL))) {
         /* receiving garbage on first sync is regular situation */
         if (msg && msg->sync && msg->first) {
             VIR_DEBUG("Received garbage on sync");
@@ -305,9 +314,21 @@ qemuAgentIOProcessLine(qemuAgentPtr agent,
                     goto cleanup;
                 }
             }
-            msg->rxObject = obj;
-            msg->finished = 1;
-            obj = NULL;
+            if (msg->nrxObjects > 0) {
+                if (msg->rxCount == msg->nrxObjects) {
+                    VIR_DEBUG("Ignoring excess reply to pipelined commands");
+                    ret = 0;
+                    goto cleanup;
+                }
+
+                msg->rxObjects[msg->rxCount++] = g_steal_pointer(&obj);
+                if (msg->rxCount == msg->nrxObjects)
+                    msg->finished = 1;
+            } else {
+                msg->rxObject = obj;
+                msg->finished = 1;
+                obj = NULL;
+            }
         } else {
             /* we are out of sync */
             VIR_DEBUG("Ignoring delayed reply");
@@ -370,9 +391,13 @@ qemuAgentIOProcess(qemuAgentPtr agent)
     qemuAgentMessagePtr msg = NULL;
 
     /* See if there's a message ready for reply; that is,
-     * one that has completed writing all its data.
+     * one that has completed writing all its data. The agent may
+     * reply to pipelined commands while the rest is still being
+     * written.
      */
-    if (agent->msg && agent->msg->txOffset == agent->msg->txLength)
+    if (agent->msg &&
+        (agent->msg->txOffset == agent->msg->txLength ||
+         (agent->msg->nrxObjects > 0 && agent->msg->txOffset > 0)))
         msg = agent->msg;
 
 #if DEBUG_IO
@@ -1106,6 +1131,14 @@ qemuAgentCommand(qemuAgentPtr agent,
     *reply = NULL;
     memset(&msg, 0, sizeof(msg));
 
+    if (agent->prefetched &&
+        virJSONValueObjectHasKey(cmd, "arguments") != 1 &&
+        (*reply = virHashSteal(agent->prefetched, qemuAgentCommandName(cmd)))) {
+        VIR_DEBUG("Using prefetched reply to '%s'", qemuAgentCommandName(cmd));
+        ret = qemuAgentCheckError(cmd, *reply);
+        goto cleanup;
+    }
+
     if (!agent->running) {
         virReportError(VIR_ERR_AGENT_UNRESPONSIVE, "%s",
                        _("Guest agent disappeared while executing command"));
@@ -1188,6 +1221,135 @@ qemuAgentMakeCommand(const char *cmdname,
     return NULL;
 }
 
+
+/**
+ * qemuAgentPrefetch:
+ * @agent: agent object
+ * @cmdnames: names of query commands not taking any arguments
+ * @ncmdnames: number of items in @cmdnames
+ * @seconds: how long to wait for all the replies
+ *
+ * The guest agent executes commands one after another and replies to
+ * them in the same order. Rather than doing a guest-sync and a round
+ * trip for each command, all of @cmdnames are written at once after a
+ * single guest-sync and their replies are collected in order. The
+ * replies are kept until the same command is executed next, which then
+ * returns the reply without talking to the agent. Replies which are not
+ * used must be dropped by qemuAgentPrefetchClear before the agent is
+ * unlocked.
+ *
+ * @seconds is interpreted as in qemuAgentSend, except that
+ * VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT allows the commands as much
+ * time as the response timeout of @agent would if they were sent one
+ * by one.
+ *
+ * Returns: 0 on success,
+ *          -2 on timeout,
+ *          -1 otherwise
+ */
+int
+qemuAgentPrefetch(qemuAgentPtr agent,
+                  const char **cmdnames,
+                  size_t ncmdnames,
+                  int seconds)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    qemuAgentMessage msg;
+    size_t i;
+    int ret = -1;
+
+    qemuAgentPrefetchClear(agent);
+
+    if (ncmdnames == 0)
+        return 0;
+
+    memset(&msg, 0, sizeof(msg));
+
+    if (!agent->running) {
+        virReportError(VIR_ERR_AGENT_UNRESPONSIVE, "%s",
+                       _("Guest agent disappeared while executing command"));
+        return -1;
+    }
+
+    if (qemuAgentGuestSync(agent) < 0)
+        return -1;
+
+    for (i = 0; i < ncmdnames; i++) {
+        g_autoptr(virJSONValue) cmd = NULL;
+        g_autofree char *cmdstr = NULL;
+
+        if (!(cmd = qemuAgentMakeCommand(cmdnames[i], NULL)) ||
+            !(cmdstr = virJSONValueToString(cmd, false)))
+            return -1;
+
+        virBufferAsprintf(&buf, "%s" LINE_ENDING, cmdstr);
+    }
+
+    msg.txBuffer = virBufferContentAndReset(&buf);
+    msg.txLength = strlen(msg.txBuffer);
+    msg.nrxObjects = ncmdnames;
+    msg.rxObjects = g_new0(virJSONValuePtr, ncmdnames);
+
+    /* Allow the commands as much time as if they were sent one by one */
+    if (seconds == VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT) {
+        seconds = agent->timeout;
+        if (seconds == VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT)
+            seconds = QEMU_AGENT_WAIT_TIME;
+        if (seconds > 0)
+            seconds *= ncmdnames;
+    }
+
+    VIR_DEBUG("Send %zu pipelined commands, seconds = %d", ncmdnames, seconds);
+
+    if ((ret = qemuAgentSend(agent, &msg, seconds)) < 0)
+        goto cleanup;
+
+    ret = -1;
+
+    if (msg.rxCount < msg.nrxObjects) {
+        if (agent->running)
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Missing agent reply object"));
+        else
+            virReportError(VIR_ERR_AGENT_UNRESPONSIVE, "%s",
+                           _("Guest agent disappeared while executing command"));
+        goto cleanup;
+    }
+
+    agent->prefetched = virHashNew(virJSONValueHashFree);
+    for (i = 0; i < ncmdnames; i++) {
+        if (virHashAddEntry(agent->prefetched, cmdnames[i], msg.rxObjects[i]) < 0)
+            goto cleanup;
+        msg.rxObjects[i] = NULL;
+    }
+
+    ret = 0;
+
+ cleanup:
+    if (ret < 0)
+        qemuAgentPrefetchClear(agent);
+    for (i = 0; i < msg.rxCount; i++)
+        virJSONValueFree(msg.rxObjects[i]);
+    VIR_FREE(msg.rxObjects);
+    VIR_FREE(msg.txBuffer);
+    return ret;
+}
+
+
+/**
+ * qemuAgentPrefetchClear:
+ * @agent: agent object
+ *
+ * Drops replies fetched by qemuAgentPrefetch which were not used.
+ */
+void
+qemuAgentPrefetchClear(qemuAgentPtr agent)
+{
+    virHashFree(agent->prefetched);
+    agent->prefetched = NULL;
+}
+
+
 static virJSONValuePtr
 qemuAgentMakeStringsArray(const char **strings, unsigned int len)
 {
@@ -164,3 +164,9 @@ int qemuAgentGetTimezone(qemuAgentPtr mon,
 
 void qemuAgentSetResponseTimeout(qemuAgentPtr mon,
                                  int timeout);
+
+int qemuAgentPrefetch(qemuAgentPtr mon,
+                      const char **cmdnames,
+                      size_t ncmdnames,
+                      int seconds);
+void qemuAgentPrefetchClear(qemuAgentPtr mon);
@@ -789,6 +789,7 @@ qemuBackupBegin(virDomainObjPtr vm,
                                       JOB_MASK(QEMU_JOB_SUSPEND) |
                                       JOB_MASK(QEMU_JOB_MODIFY)));
     priv->job.current->statsType = QEMU_DOMAIN_JOB_STATS_TYPE_BACKUP;
+    qemuDomainJobTimingStart(vm);
 
     if (!virDomainObjIsActive(vm)) {
         virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
@@ -841,9 +842,13 @@ qemuBackupBegin(virDomainObjPtr vm,
         goto endjob;
     }
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_BACKUP_BITMAPS);
+
     if (qemuBackupDiskPrepareStorage(vm, dd, ndd, blockNamedNodeData, reuse) < 0)
         goto endjob;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_BACKUP_STORAGE);
+
     priv->backup = g_steal_pointer(&def);
 
     if (qemuDomainObjEnterMonitorAsync(priv->driver, vm, QEMU_ASYNC_JOB_BACKUP) < 0)
@@ -861,6 +866,8 @@ qemuBackupBegin(virDomainObjPtr vm,
     if (qemuDomainObjExitMonitor(priv->driver, vm) < 0 || rc < 0)
         goto endjob;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_BACKUP_TRANSACTION);
+
     job_started = true;
     qemuBackupDiskStarted(vm, dd, ndd);
 
@@ -888,6 +895,7 @@ qemuBackupBegin(virDomainObjPtr vm,
     ret = 0;
 
  endjob:
+    qemuDomainJobTimingStop(vm);
     qemuBackupDiskDataCleanup(vm, dd, ndd);
 
     /* if 'chk' is non-NULL here it's a failure and it must be rolled back */
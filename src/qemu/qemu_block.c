@@ -319,6 +319,25 @@ qemuBlockDiskDetectNodes(virDomainDiskDefPtr disk,
 }
 
 
+/* Node names are only detected for disks whose top level image has none,
+ * see qemuBlockDiskDetectNodes */
+static bool
+qemuBlockNodeNamesNeedDetect(virDomainDefPtr def)
+{
+    size_t i;
+
+    for (i = 0; i < def->ndisks; i++) {
+        virStorageSourcePtr src = def->disks[i]->src;
+
+        if (!src->nodeformat && !src->nodestorage &&
+            !virStorageSourceIsEmpty(src))
+            return true;
+    }
+
+    return false;
+}
+
+
 int
 qemuBlockNodeNamesDetect(virQEMUDriverPtr driver,
                          virDomainObjPtr vm,
@@ -334,6 +353,11 @@ qemuBlockNodeNamesDetect(virQEMUDriverPtr driver,
     if (!virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_QUERY_NAMED_BLOCK_NODES))
         return 0;
 
+    /* the node names of all disks are already known, there's no need to
+     * fetch the whole block graph */
+    if (!qemuBlockNodeNamesNeedDetect(vm->def))
+        return 0;
+
     if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
         return -1;
 
@@ -2784,21 +2808,12 @@ qemuBlockNamedNodeDataGetBitmapByName(virHashTablePtr blockNamedNodeData,
                                       const char *bitmap)
 {
     qemuBlockNamedNodeDataPtr nodedata;
-    size_t i;
 
-    if (!(nodedata = virHashLookup(blockNamedNodeData, src->nodeformat)))
+    if (!(nodedata = virHashLookup(blockNamedNodeData, src->nodeformat)) ||
+        !nodedata->bitmapsByName)
         return NULL;
 
-    for (i = 0; i < nodedata->nbitmaps; i++) {
-        qemuBlockNamedNodeDataBitmapPtr bitmapdata = nodedata->bitmaps[i];
-
-        if (STRNEQ(bitmapdata->name, bitmap))
-            continue;
-
-        return bitmapdata;
-    }
-
-    return NULL;
+    return virHashLookup(nodedata->bitmapsByName, bitmap);
 }
 
 
@@ -591,6 +591,111 @@ qemuBlockJobRefreshJobs(virQEMUDriverPtr driver,
 }
 
 
+static bool
+qemuBlockJobHasProgress(qemuBlockJobDataPtr job)
+{
+    /* same rules as in qemuBlockJobEmitEvents */
+    return job->disk &&
+           job->type < QEMU_BLOCKJOB_TYPE_INTERNAL &&
+           qemuBlockJobIsRunning(job);
+}
+
+
+static int
+qemuBlockJobEmitProgressCount(void *payload,
+                              const void *name G_GNUC_UNUSED,
+                              void *opaque)
+{
+    size_t *count = opaque;
+
+    if (qemuBlockJobHasProgress(payload))
+        (*count)++;
+
+    return 0;
+}
+
+
+struct qemuBlockJobEmitProgressData {
+    virQEMUDriverPtr driver;
+    virDomainObjPtr vm;
+    virHashTablePtr info;
+};
+
+
+static int
+qemuBlockJobEmitProgressOne(void *payload,
+                            const void *name G_GNUC_UNUSED,
+                            void *opaque)
+{
+    qemuBlockJobDataPtr job = payload;
+    struct qemuBlockJobEmitProgressData *data = opaque;
+    qemuMonitorBlockJobInfoPtr info;
+    virObjectEventPtr event;
+
+    if (!qemuBlockJobHasProgress(job) ||
+        !(info = virHashLookup(data->info, job->name)))
+        return 0;
+
+    /* nothing moved since the last event */
+    if (info->cur == job->progressCur &&
+        info->end == job->progressEnd)
+        return 0;
+
+    job->progressCur = info->cur;
+    job->progressEnd = info->end;
+
+    event = virDomainEventBlockJobProgressNewFromObj(data->vm, job->disk->dst,
+                                                     job->type,
+                                                     info->cur, info->end,
+                                                     info->bandwidth);
+    virObjectEventStateQueue(data->driver->domainEventState, event);
+
+    return 0;
+}
+
+
+/**
+ * qemuBlockJobEmitProgress:
+ * @driver: qemu driver
+ * @vm: domain
+ *
+ * Emits VIR_DOMAIN_EVENT_ID_BLOCK_JOB_PROGRESS for every block job of @vm
+ * which made progress since the last time. QEMU doesn't report progress
+ * in the job status change events, so all jobs are queried at once with
+ * a single query-block-jobs. Nothing is sent to the monitor if @vm has
+ * no jobs to report. The caller must hold a job.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+qemuBlockJobEmitProgress(virQEMUDriverPtr driver,
+                         virDomainObjPtr vm)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    struct qemuBlockJobEmitProgressData data = { driver, vm, NULL };
+    size_t count = 0;
+    int rc;
+
+    virHashForEach(priv->blockjobs, qemuBlockJobEmitProgressCount, &count);
+    if (count == 0)
+        return 0;
+
+    qemuDomainObjEnterMonitor(driver, vm);
+    data.info = qemuMonitorGetAllBlockJobInfo(priv->mon, true);
+    rc = qemuDomainObjExitMonitor(driver, vm);
+
+    if (!data.info || rc < 0) {
+        virHashFree(data.info);
+        return -1;
+    }
+
+    virHashForEach(priv->blockjobs, qemuBlockJobEmitProgressOne, &data);
+
+    virHashFree(data.info);
+    return 0;
+}
+
+
 /**
  * qemuBlockJobEmitEvents:
  *
@@ -1585,7 +1690,7 @@ qemuBlockJobEventProcessConcluded(qemuBlockJobDataPtr job,
         job->newstate = QEMU_BLOCKJOB_STATE_CANCELLED;
 
     if (refreshed)
-        qemuDomainSaveStatus(vm);
+        qemuDomainSaveStatusDelayed(vm);
 
     VIR_DEBUG("handling job '%s' state '%d' newstate '%d'", job->name, job->state, job->newstate);
 
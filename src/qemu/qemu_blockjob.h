@@ -151,6 +151,10 @@ struct _qemuBlockJobData {
 
     int brokentype; /* the previous type of a broken blockjob qemuBlockJobType */
 
+    /* progress last reported by VIR_DOMAIN_EVENT_ID_BLOCK_JOB_PROGRESS */
+    unsigned long long progressCur;
+    unsigned long long progressEnd;
+
     bool invalidData; /* the job data (except name) is not valid */
     bool reconnected; /* internal field for tracking whether job is live after reconnect to qemu */
 };
@@ -232,6 +236,10 @@ int
 qemuBlockJobRefreshJobs(virQEMUDriverPtr driver,
                         virDomainObjPtr vm);
 
+int
+qemuBlockJobEmitProgress(virQEMUDriverPtr driver,
+                         virDomainObjPtr vm);
+
 int qemuBlockJobUpdate(virDomainObjPtr vm,
                        qemuBlockJobDataPtr job,
                        int asyncJob);
@@ -619,6 +619,29 @@ struct _virQEMUDomainCapsCache {
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virQEMUDomainCapsCache, virObjectUnref);
 
+typedef struct _virQEMUDomainCapsCacheEntry virQEMUDomainCapsCacheEntry;
+typedef virQEMUDomainCapsCacheEntry *virQEMUDomainCapsCacheEntryPtr;
+struct _virQEMUDomainCapsCacheEntry {
+    virDomainCapsPtr domCaps;
+    char *firmwareStamp; /* firmware descriptors domCaps were filled from */
+    char *xml; /* formatted domCaps, NULL until requested */
+};
+
+
+static void
+virQEMUDomainCapsCacheEntryFree(void *opaque)
+{
+    virQEMUDomainCapsCacheEntryPtr entry = opaque;
+
+    if (!entry)
+        return;
+
+    virObjectUnref(entry->domCaps);
+    g_free(entry->firmwareStamp);
+    g_free(entry->xml);
+    g_free(entry);
+}
+
 static virClassPtr virQEMUDomainCapsCacheClass;
 static void virQEMUDomainCapsCacheDispose(void *obj)
 {
@@ -1105,6 +1128,59 @@ virQEMUCapsInit(virFileCachePtr cache)
 }
 
 
+/**
+ * virQEMUCapsInitKey:
+ *
+ * Computes a string describing what the capabilities returned by
+ * virQEMUCapsInit depend on and which may change while the daemon is
+ * running: the online CPUs and NUMA nodes, whether KVM and resctrl
+ * are available and the identity of the QEMU binaries. Computing it
+ * is much cheaper than virQEMUCapsInit, so callers can compare it to
+ * the key of capabilities they already have to decide whether those
+ * need to be rebuilt.
+ *
+ * Returns the key.
+ */
+char *
+virQEMUCapsInitKey(void)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    const char *files[] = {
+        "/sys/devices/system/cpu/online",
+        "/sys/devices/system/node/online",
+    };
+    virArch hostarch = virArchFromHost();
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS(files); i++) {
+        g_autofree char *str = NULL;
+
+        if (virFileReadAllQuiet(files[i], 1024, &str) < 0)
+            virBufferAddLit(&buf, "-\n");
+        else
+            virBufferAdd(&buf, str, -1);
+    }
+
+    virBufferAsprintf(&buf, "kvm=%d resctrl=%d\n",
+                      virFileExists("/dev/kvm"),
+                      virFileExists("/sys/fs/resctrl/info"));
+
+    for (i = 0; i < VIR_ARCH_LAST; i++) {
+        g_autofree char *binary = virQEMUCapsGetDefaultEmulator(hostarch, i);
+        struct stat sb;
+
+        if (!binary || stat(binary, &sb) < 0)
+            continue;
+
+        virBufferAsprintf(&buf, "%s %llu %lld\n", binary,
+                          (unsigned long long)sb.st_ino,
+                          (long long)sb.st_ctime);
+    }
+
+    return virBufferContentAndReset(&buf);
+}
+
+
 struct virQEMUCapsStringFlags {
     const char *value;
     int flag;
@@ -1632,30 +1708,27 @@ virQEMUCapsProcessStringFlags(virQEMUCapsPtr qemuCaps,
 }
 
 
-int virQEMUCapsGetDefaultVersion(virCapsPtr caps,
-                                 virFileCachePtr capsCache,
+int virQEMUCapsGetDefaultVersion(virFileCachePtr capsCache,
                                  unsigned int *version)
 {
     virQEMUCapsPtr qemucaps;
     virArch hostarch;
-    virCapsDomainDataPtr capsdata;
+    g_autofree char *binary = NULL;
 
     if (*version > 0)
         return 0;
 
+    /* Only the native emulator needs to be probed for this, there's no
+     * point in building the full capabilities */
     hostarch = virArchFromHost();
-    if (!(capsdata = virCapabilitiesDomainDataLookup(caps,
-            VIR_DOMAIN_OSTYPE_HVM, hostarch, VIR_DOMAIN_VIRT_QEMU,
-            NULL, NULL))) {
+    if (!(binary = virQEMUCapsGetDefaultEmulator(hostarch, hostarch))) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Cannot find suitable emulator for %s"),
                        virArchToString(hostarch));
         return -1;
     }
 
-    qemucaps = virQEMUCapsCacheLookup(capsCache, capsdata->emulator);
-    VIR_FREE(capsdata);
-    if (!qemucaps)
+    if (!(qemucaps = virQEMUCapsCacheLookup(capsCache, binary)))
         return -1;
 
     *version = virQEMUCapsGetVersion(qemucaps);
@@ -1675,7 +1748,7 @@ virQEMUDomainCapsCacheNew(void)
     if (!(cache = virObjectLockableNew(virQEMUDomainCapsCacheClass)))
         return NULL;
 
-    if (!(cache->cache = virHashCreate(5, virObjectFreeHashData)))
+    if (!(cache->cache = virHashCreate(5, virQEMUDomainCapsCacheEntryFree)))
         return NULL;
 
     return g_steal_pointer(&cache);
@@ -2059,7 +2132,8 @@ virQEMUCapsSearchDomcaps(const void *payload,
                          const void *name G_GNUC_UNUSED,
                          const void *opaque)
 {
-    virDomainCapsPtr domCaps = (virDomainCapsPtr) payload;
+    virQEMUDomainCapsCacheEntryPtr entry = (virQEMUDomainCapsCacheEntryPtr) payload;
+    virDomainCapsPtr domCaps = entry->domCaps;
     struct virQEMUCapsSearchDomcapsData *data = (struct virQEMUCapsSearchDomcapsData *) opaque;
 
     if (STREQ_NULLABLE(data->path, domCaps->path) &&
@@ -2072,6 +2146,16 @@ virQEMUCapsSearchDomcaps(const void *payload,
 }
 
 
+/**
+ * virQEMUCapsGetDomainCapsCache:
+ * @firmwareStamp: description of firmware descriptors, see qemuFirmwareGetStamp
+ * @xml: optional place to store a copy of the formatted domcaps
+ *
+ * Returns a reference to the domcaps for the given machine, arch and virt
+ * type, building them on a cache miss. Cached domcaps are rebuilt when they
+ * were filled from firmware descriptors other than @firmwareStamp describes,
+ * a NULL @firmwareStamp accepts any cached domcaps.
+ */
 virDomainCapsPtr
 virQEMUCapsGetDomainCapsCache(virQEMUCapsPtr qemuCaps,
                               const char *machine,
@@ -2080,11 +2164,15 @@ virQEMUCapsGetDomainCapsCache(virQEMUCapsPtr qemuCaps,
                               virArch hostarch,
                               bool privileged,
                               virFirmwarePtr *firmwares,
-                              size_t nfirmwares)
+                              size_t nfirmwares,
+                              const char *firmwareStamp,
+                              char **xml)
 {
     virQEMUDomainCapsCachePtr cache = qemuCaps->domCapsCache;
+    virQEMUDomainCapsCacheEntryPtr entry = NULL;
     virDomainCapsPtr domCaps = NULL;
     const char *path = virQEMUCapsGetBinary(qemuCaps);
+    const void *name = NULL;
     struct virQEMUCapsSearchDomcapsData data = {
         .path = path,
         .machine = machine,
@@ -2094,9 +2182,17 @@ virQEMUCapsGetDomainCapsCache(virQEMUCapsPtr qemuCaps,
 
     virObjectLock(cache);
 
-    domCaps = virHashSearch(cache->cache, virQEMUCapsSearchDomcaps, &data, NULL);
+    entry = virHashSearch(cache->cache, virQEMUCapsSearchDomcaps, &data, &name);
 
-    if (!domCaps) {
+    if (entry && firmwareStamp &&
+        STRNEQ_NULLABLE(entry->firmwareStamp, firmwareStamp)) {
+        VIR_DEBUG("Firmware descriptors changed, refreshing domcaps '%s'",
+                  (const char *) name);
+        virHashRemoveEntry(cache->cache, name);
+        entry = NULL;
+    }
+
+    if (!entry) {
         g_autoptr(virDomainCaps) tempDomCaps = NULL;
         g_autofree char *key = NULL;
 
@@ -2112,13 +2208,25 @@ virQEMUCapsGetDomainCapsCache(virQEMUCapsPtr qemuCaps,
         key = g_strdup_printf("%d:%d:%s:%s", arch, virttype,
                               NULLSTR(machine), path);
 
-        if (virHashAddEntry(cache->cache, key, tempDomCaps) < 0)
+        entry = g_new0(virQEMUDomainCapsCacheEntry, 1);
+        entry->domCaps = g_steal_pointer(&tempDomCaps);
+        entry->firmwareStamp = g_strdup(firmwareStamp);
+
+        if (virHashAddEntry(cache->cache, key, entry) < 0) {
+            virQEMUDomainCapsCacheEntryFree(entry);
             goto cleanup;
+        }
+    }
 
-        domCaps = g_steal_pointer(&tempDomCaps);
+    if (xml) {
+        if (!entry->xml &&
+            !(entry->xml = virDomainCapsFormat(entry->domCaps)))
+            goto cleanup;
+
+        *xml = g_strdup(entry->xml);
     }
 
-    virObjectRef(domCaps);
+    domCaps = virObjectRef(entry->domCaps);
  cleanup:
     virObjectUnlock(cache);
     return domCaps;
@@ -4516,7 +4624,8 @@ virQEMUCapsSaveFile(void *data,
 
     xml = virQEMUCapsFormatCache(qemuCaps);
 
-    if (virFileWriteStr(filename, xml, 0600) < 0) {
+    /* Readable by session daemons, see virFileCacheSetSharedDir */
+    if (virFileWriteStr(filename, xml, 0644) < 0) {
         virReportSystemError(errno,
                              _("Failed to save '%s' for '%s'"),
                              filename, qemuCaps->binary);
@@ -4535,6 +4644,469 @@ virQEMUCapsSaveFile(void *data,
 }
 
 
+/*
+ * The binary cache format is a GVariant of type "(uv)" holding the format
+ * version and the data itself, which can be used straight from the mapped
+ * file. Like the XML format it does not have to be stable, as a version or
+ * type mismatch only makes us fall back to the XML file. Bump the version
+ * whenever the meaning of any member changes.
+ */
+#define VIR_QEMU_CAPS_CACHE_BINARY_VERSION 1
+
+#define VIR_QEMU_CAPS_CACHE_BINARY_ACCEL \
+    "(m(sba(sibsxi))a(smsias)a(smsubbms))"
+
+#define VIR_QEMU_CAPS_CACHE_BINARY_TYPE \
+    "(sxxuasuuumsmss" \
+    VIR_QEMU_CAPS_CACHE_BINARY_ACCEL \
+    VIR_QEMU_CAPS_CACHE_BINARY_ACCEL \
+    "a(uu)m(uuss)b)"
+
+
+static GVariant *
+virQEMUCapsFormatBinaryAccel(virQEMUCapsPtr qemuCaps,
+                             virDomainVirtType type)
+{
+    virQEMUCapsAccelPtr caps = virQEMUCapsGetAccel(qemuCaps, type);
+    qemuMonitorCPUModelInfoPtr model = caps->hostCPU.info;
+    GVariant *hostCPU = NULL;
+    GVariantBuilder cpus;
+    GVariantBuilder machines;
+    size_t i;
+
+    if (model) {
+        GVariantBuilder props;
+
+        g_variant_builder_init(&props, G_VARIANT_TYPE("a(sibsxi)"));
+        for (i = 0; i < model->nprops; i++) {
+            qemuMonitorCPUPropertyPtr prop = model->props + i;
+            bool boolean = false;
+            const char *string = "";
+            long long number = 0;
+
+            switch (prop->type) {
+            case QEMU_MONITOR_CPU_PROPERTY_BOOLEAN:
+                boolean = prop->value.boolean;
+                break;
+            case QEMU_MONITOR_CPU_PROPERTY_STRING:
+                string = prop->value.string;
+                break;
+            case QEMU_MONITOR_CPU_PROPERTY_NUMBER:
+                number = prop->value.number;
+                break;
+            case QEMU_MONITOR_CPU_PROPERTY_LAST:
+                break;
+            }
+
+            g_variant_builder_add(&props, "(sibsxi)",
+                                  prop->name, prop->type, boolean, string,
+                                  (gint64) number, prop->migratable);
+        }
+
+        hostCPU = g_variant_new("(sb@a(sibsxi))",
+                                model->name, model->migratability,
+                                g_variant_builder_end(&props));
+    }
+
+    g_variant_builder_init(&cpus, G_VARIANT_TYPE("a(smsias)"));
+    for (i = 0; caps->cpuModels && i < caps->cpuModels->ncpus; i++) {
+        qemuMonitorCPUDefInfoPtr cpu = caps->cpuModels->cpus + i;
+        const char *const noBlockers[] = { NULL };
+        const char *const *blockers = noBlockers;
+
+        if (cpu->blockers)
+            blockers = (const char *const *) cpu->blockers;
+
+        g_variant_builder_add(&cpus, "(smsi@as)",
+                              cpu->name, cpu->type, cpu->usable,
+                              g_variant_new_strv(blockers, -1));
+    }
+
+    g_variant_builder_init(&machines, G_VARIANT_TYPE("a(smsubbms)"));
+    for (i = 0; i < caps->nmachineTypes; i++) {
+        virQEMUCapsMachineTypePtr machine = caps->machineTypes + i;
+
+        g_variant_builder_add(&machines, "(smsubbms)",
+                              machine->name, machine->alias,
+                              machine->maxCpus, machine->hotplugCpus,
+                              machine->qemuDefault, machine->defaultCPU);
+    }
+
+    return g_variant_new("(@m(sba(sibsxi))@a(smsias)@a(smsubbms))",
+                         g_variant_new_maybe(G_VARIANT_TYPE("(sba(sibsxi))"),
+                                             hostCPU),
+                         g_variant_builder_end(&cpus),
+                         g_variant_builder_end(&machines));
+}
+
+
+static int
+virQEMUCapsSaveBinaryFile(void *data,
+                          const char *filename,
+                          void *privData G_GNUC_UNUSED)
+{
+    virQEMUCapsPtr qemuCaps = data;
+    g_autoptr(GVariant) root = NULL;
+    g_autoptr(GError) err = NULL;
+    GVariantBuilder flags;
+    GVariantBuilder gic;
+    GVariant *sev = NULL;
+    size_t i;
+
+    /* The strings which don't come from QEMU's UTF-8 JSON */
+    if (!g_utf8_validate(qemuCaps->binary, -1, NULL) ||
+        (qemuCaps->kernelVersion &&
+         !g_utf8_validate(qemuCaps->kernelVersion, -1, NULL))) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
+                       _("cannot store capabilities of '%s' in binary format"),
+                       qemuCaps->binary);
+        return -1;
+    }
+
+    g_variant_builder_init(&flags, G_VARIANT_TYPE_STRING_ARRAY);
+    for (i = 0; i < QEMU_CAPS_LAST; i++) {
+        if (virQEMUCapsGet(qemuCaps, i))
+            g_variant_builder_add(&flags, "s", virQEMUCapsTypeToString(i));
+    }
+
+    g_variant_builder_init(&gic, G_VARIANT_TYPE("a(uu)"));
+    for (i = 0; i < qemuCaps->ngicCapabilities; i++) {
+        g_variant_builder_add(&gic, "(uu)",
+                              qemuCaps->gicCapabilities[i].version,
+                              qemuCaps->gicCapabilities[i].implementation);
+    }
+
+    if (qemuCaps->sevCapabilities) {
+        sev = g_variant_new("(uuss)",
+                            qemuCaps->sevCapabilities->cbitpos,
+                            qemuCaps->sevCapabilities->reduced_phys_bits,
+                            qemuCaps->sevCapabilities->pdh,
+                            qemuCaps->sevCapabilities->cert_chain);
+    }
+
+    root = g_variant_new("(uv)", VIR_QEMU_CAPS_CACHE_BINARY_VERSION,
+                         g_variant_new("(sxxu@asuuumsmss@"
+                                       VIR_QEMU_CAPS_CACHE_BINARY_ACCEL "@"
+                                       VIR_QEMU_CAPS_CACHE_BINARY_ACCEL
+                                       "@a(uu)@m(uuss)b)",
+                                       qemuCaps->binary,
+                                       (gint64) qemuCaps->ctime,
+                                       (gint64) qemuCaps->libvirtCtime,
+                                       qemuCaps->libvirtVersion,
+                                       g_variant_builder_end(&flags),
+                                       qemuCaps->version,
+                                       qemuCaps->kvmVersion,
+                                       qemuCaps->microcodeVersion,
+                                       qemuCaps->package,
+                                       qemuCaps->kernelVersion,
+                                       virArchToString(qemuCaps->arch),
+                                       virQEMUCapsFormatBinaryAccel(qemuCaps,
+                                                                    VIR_DOMAIN_VIRT_KVM),
+                                       virQEMUCapsFormatBinaryAccel(qemuCaps,
+                                                                    VIR_DOMAIN_VIRT_QEMU),
+                                       g_variant_builder_end(&gic),
+                                       g_variant_new_maybe(G_VARIANT_TYPE("(uuss)"),
+                                                           sev),
+                                       qemuCaps->kvmSupportsNesting));
+    g_variant_ref_sink(root);
+
+    if (!g_file_set_contents(filename, g_variant_get_data(root),
+                             g_variant_get_size(root), &err)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Failed to save '%s' for '%s': %s"),
+                       filename, qemuCaps->binary, err->message);
+        return -1;
+    }
+
+    /* Readable by session daemons, see virFileCacheSetSharedDir */
+    if (chmod(filename, 0644) < 0) {
+        virReportSystemError(errno, _("cannot change mode of '%s'"),
+                             filename);
+        return -1;
+    }
+
+    VIR_DEBUG("Saved binary caps '%s' for '%s'", filename, qemuCaps->binary);
+
+    return 0;
+}
+
+
+static int
+virQEMUCapsLoadBinaryAccel(virQEMUCapsPtr qemuCaps,
+                           GVariant *data,
+                           virDomainVirtType type)
+{
+    virQEMUCapsAccelPtr caps = virQEMUCapsGetAccel(qemuCaps, type);
+    g_autoptr(GVariant) hostCPU = NULL;
+    g_autoptr(GVariant) model = NULL;
+    g_autoptr(GVariant) cpus = NULL;
+    g_autoptr(GVariant) machines = NULL;
+    GVariantIter iter;
+    size_t n;
+    size_t i;
+
+    g_variant_get(data, "(@m(sba(sibsxi))@a(smsias)@a(smsubbms))",
+                  &hostCPU, &cpus, &machines);
+
+    if ((model = g_variant_get_maybe(hostCPU))) {
+        qemuMonitorCPUModelInfoPtr info = NULL;
+        g_autoptr(GVariantIter) props = NULL;
+        const char *name;
+        gboolean migratability;
+        const char *propName;
+        gint32 propType;
+        gboolean propBoolean;
+        const char *propString;
+        gint64 propNumber;
+        gint32 propMigratable;
+
+        g_variant_get(model, "(&sba(sibsxi))", &name, &migratability, &props);
+
+        info = g_new0(qemuMonitorCPUModelInfo, 1);
+        info->name = g_strdup(name);
+        info->migratability = migratability;
+        info->props = g_new0(qemuMonitorCPUProperty,
+                             g_variant_iter_n_children(props));
+
+        while (g_variant_iter_next(props, "(&sib&sxi)",
+                                   &propName, &propType, &propBoolean,
+                                   &propString, &propNumber,
+                                   &propMigratable)) {
+            qemuMonitorCPUPropertyPtr prop = info->props + info->nprops++;
+
+            prop->name = g_strdup(propName);
+
+            if (propType < 0 || propType >= QEMU_MONITOR_CPU_PROPERTY_LAST ||
+                propMigratable < 0 || propMigratable >= VIR_TRISTATE_BOOL_LAST) {
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("invalid host CPU model property '%s' in "
+                                 "QEMU capabilities cache"), propName);
+                qemuMonitorCPUModelInfoFree(info);
+                return -1;
+            }
+
+            prop->type = propType;
+            prop->migratable = propMigratable;
+
+            switch (prop->type) {
+            case QEMU_MONITOR_CPU_PROPERTY_BOOLEAN:
+                prop->value.boolean = propBoolean;
+                break;
+            case QEMU_MONITOR_CPU_PROPERTY_STRING:
+                prop->value.string = g_strdup(propString);
+                break;
+            case QEMU_MONITOR_CPU_PROPERTY_NUMBER:
+                prop->value.number = propNumber;
+                break;
+            case QEMU_MONITOR_CPU_PROPERTY_LAST:
+                break;
+            }
+        }
+
+        caps->hostCPU.info = info;
+    }
+
+    if ((n = g_variant_n_children(cpus)) > 0) {
+        g_autoptr(qemuMonitorCPUDefs) defs = NULL;
+        const char *name;
+        const char *typename;
+        gint32 usable;
+        GVariant *blockers;
+
+        if (!(defs = qemuMonitorCPUDefsNew(n)))
+            return -1;
+
+        g_variant_iter_init(&iter, cpus);
+        for (i = 0; g_variant_iter_next(&iter, "(&sm&si@as)",
+                                        &name, &typename, &usable, &blockers); i++) {
+            qemuMonitorCPUDefInfoPtr cpu = defs->cpus + i;
+
+            cpu->name = g_strdup(name);
+            cpu->type = g_strdup(typename);
+
+            if (g_variant_n_children(blockers) > 0)
+                cpu->blockers = g_variant_dup_strv(blockers, NULL);
+            g_variant_unref(blockers);
+
+            if (usable < 0 || usable >= VIR_DOMCAPS_CPU_USABLE_LAST) {
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("invalid usability of CPU model '%s' in "
+                                 "QEMU capabilities cache"), name);
+                return -1;
+            }
+            cpu->usable = usable;
+        }
+
+        caps->cpuModels = g_steal_pointer(&defs);
+    }
+
+    if ((n = g_variant_n_children(machines)) > 0) {
+        const char *name;
+        const char *alias;
+        guint32 maxCpus;
+        gboolean hotplugCpus;
+        gboolean qemuDefault;
+        const char *defaultCPU;
+
+        caps->machineTypes = g_new0(virQEMUCapsMachineType, n);
+        caps->nmachineTypes = n;
+
+        g_variant_iter_init(&iter, machines);
+        for (i = 0; g_variant_iter_next(&iter, "(&sm&subbm&s)",
+                                        &name, &alias, &maxCpus, &hotplugCpus,
+                                        &qemuDefault, &defaultCPU); i++) {
+            virQEMUCapsMachineTypePtr machine = caps->machineTypes + i;
+
+            machine->name = g_strdup(name);
+            machine->alias = g_strdup(alias);
+            machine->maxCpus = maxCpus;
+            machine->hotplugCpus = hotplugCpus;
+            machine->qemuDefault = qemuDefault;
+            machine->defaultCPU = g_strdup(defaultCPU);
+        }
+    }
+
+    return 0;
+}
+
+
+static void *
+virQEMUCapsLoadBinaryFile(const char *filename,
+                          const char *binary,
+                          void *privData)
+{
+    virQEMUCapsCachePrivPtr priv = privData;
+    g_autoptr(virQEMUCaps) qemuCaps = NULL;
+    g_autoptr(GMappedFile) file = NULL;
+    g_autoptr(GBytes) bytes = NULL;
+    g_autoptr(GVariant) root = NULL;
+    g_autoptr(GVariant) data = NULL;
+    g_autoptr(GVariant) flags = NULL;
+    g_autoptr(GVariant) kvm = NULL;
+    g_autoptr(GVariant) tcg = NULL;
+    g_autoptr(GVariant) gic = NULL;
+    g_autoptr(GVariant) sevMaybe = NULL;
+    g_autoptr(GVariant) sev = NULL;
+    g_autoptr(GError) err = NULL;
+    guint32 version;
+    const char *emulator;
+    gint64 ctime;
+    gint64 libvirtCtime;
+    const char *package;
+    const char *kernelVersion;
+    const char *arch;
+    gboolean kvmSupportsNesting;
+    const char *str;
+    GVariantIter iter;
+    size_t n;
+    size_t i;
+
+    if (!(file = g_mapped_file_new(filename, FALSE, &err))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("cannot map QEMU capabilities cache '%s': %s"),
+                       filename, err->message);
+        return NULL;
+    }
+
+    bytes = g_mapped_file_get_bytes(file);
+    root = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE("(uv)"),
+                                                       bytes, FALSE));
+    g_variant_get(root, "(uv)", &version, &data);
+
+    if (version != VIR_QEMU_CAPS_CACHE_BINARY_VERSION ||
+        !g_variant_is_of_type(data, G_VARIANT_TYPE(VIR_QEMU_CAPS_CACHE_BINARY_TYPE))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("unsupported format of QEMU capabilities cache '%s'"),
+                       filename);
+        return NULL;
+    }
+
+    g_variant_get(data,
+                  "(&sxxu@asuuum&sm&s&s@"
+                  VIR_QEMU_CAPS_CACHE_BINARY_ACCEL "@"
+                  VIR_QEMU_CAPS_CACHE_BINARY_ACCEL
+                  "@a(uu)@m(uuss)b)",
+                  &emulator, &ctime, &libvirtCtime, NULL, &flags,
+                  NULL, NULL, NULL, &package, &kernelVersion, &arch,
+                  &kvm, &tcg, &gic, &sevMaybe, &kvmSupportsNesting);
+
+    if (STRNEQ(emulator, binary)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Expected caps for '%s' but saw '%s'"),
+                       binary, emulator);
+        return NULL;
+    }
+
+    if (!(qemuCaps = virQEMUCapsNewBinary(binary)))
+        return NULL;
+
+    qemuCaps->ctime = ctime;
+    qemuCaps->libvirtCtime = libvirtCtime;
+    g_variant_get_child(data, 3, "u", &qemuCaps->libvirtVersion);
+    g_variant_get_child(data, 5, "u", &qemuCaps->version);
+    g_variant_get_child(data, 6, "u", &qemuCaps->kvmVersion);
+    g_variant_get_child(data, 7, "u", &qemuCaps->microcodeVersion);
+    qemuCaps->package = g_strdup(package);
+    qemuCaps->kernelVersion = g_strdup(kernelVersion);
+    qemuCaps->kvmSupportsNesting = kvmSupportsNesting;
+
+    g_variant_iter_init(&iter, flags);
+    while (g_variant_iter_next(&iter, "&s", &str)) {
+        int flag;
+
+        if ((flag = virQEMUCapsTypeFromString(str)) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Unknown qemu capabilities flag %s"), str);
+            return NULL;
+        }
+        virQEMUCapsSet(qemuCaps, flag);
+    }
+
+    if (!(qemuCaps->arch = virArchFromString(arch))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("unknown arch %s in QEMU capabilities cache"), arch);
+        return NULL;
+    }
+
+    if (virQEMUCapsLoadBinaryAccel(qemuCaps, kvm, VIR_DOMAIN_VIRT_KVM) < 0 ||
+        virQEMUCapsLoadBinaryAccel(qemuCaps, tcg, VIR_DOMAIN_VIRT_QEMU) < 0)
+        return NULL;
+
+    if ((n = g_variant_n_children(gic)) > 0) {
+        guint32 gicVersion;
+        guint32 implementation;
+
+        qemuCaps->gicCapabilities = g_new0(virGICCapability, n);
+        qemuCaps->ngicCapabilities = n;
+
+        g_variant_iter_init(&iter, gic);
+        for (i = 0; g_variant_iter_next(&iter, "(uu)",
+                                        &gicVersion, &implementation); i++) {
+            qemuCaps->gicCapabilities[i].version = gicVersion;
+            qemuCaps->gicCapabilities[i].implementation = implementation;
+        }
+    }
+
+    if ((sev = g_variant_get_maybe(sevMaybe))) {
+        const char *pdh;
+        const char *certChain;
+
+        qemuCaps->sevCapabilities = g_new0(virSEVCapability, 1);
+        g_variant_get(sev, "(uu&s&s)",
+                      &qemuCaps->sevCapabilities->cbitpos,
+                      &qemuCaps->sevCapabilities->reduced_phys_bits,
+                      &pdh, &certChain);
+        qemuCaps->sevCapabilities->pdh = g_strdup(pdh);
+        qemuCaps->sevCapabilities->cert_chain = g_strdup(certChain);
+    }
+
+    virQEMUCapsInitHostCPUModel(qemuCaps, priv->hostArch, VIR_DOMAIN_VIRT_KVM);
+    virQEMUCapsInitHostCPUModel(qemuCaps, priv->hostArch, VIR_DOMAIN_VIRT_QEMU);
+
+    return g_steal_pointer(&qemuCaps);
+}
+
+
 /* Check the kernel module parameters 'nested' file to determine if enabled
  *
  *   Intel: 'kvm_intel' uses 'Y'
@@ -5269,7 +5841,9 @@ virFileCacheHandlers qemuCapsCacheHandlers = {
     .isValid = virQEMUCapsIsValid,
     .newData = virQEMUCapsNewData,
     .loadFile = virQEMUCapsLoadFile,
+    .loadBinaryFile = virQEMUCapsLoadBinaryFile,
     .saveFile = virQEMUCapsSaveFile,
+    .saveBinaryFile = virQEMUCapsSaveBinaryFile,
     .privFree = virQEMUCapsCachePrivFree,
 };
 
@@ -5407,6 +5981,18 @@ virQEMUCapsCacheLookupByArch(virFileCachePtr cache,
         }
     }
 
+    /* Binaries are probed lazily, nothing might have needed one
+     * for @arch yet */
+    for (j = 0; j < G_N_ELEMENTS(archs); j++) {
+        g_autofree char *binary = NULL;
+
+        if (!(binary = virQEMUCapsGetDefaultEmulator(virArchFromHost(), archs[j])))
+            continue;
+
+        if ((ret = virFileCacheLookup(cache, binary)))
+            goto done;
+    }
+
     virReportError(VIR_ERR_INVALID_ARG,
                    _("unable to find any emulator to serve '%s' "
                      "architecture"), virArchToString(arch));
@@ -5418,6 +6004,42 @@ virQEMUCapsCacheLookupByArch(virFileCachePtr cache,
 }
 
 
+/**
+ * virQEMUCapsCacheProbeAll:
+ * @cache: QEMU capabilities cache
+ * @quit: checked before each binary, probing stops once it is non-zero
+ *
+ * Makes sure the capabilities of the default emulator for every guest
+ * architecture are in @cache, probing them one by one if needed. This
+ * is meant to warm up the cache in the background so that building the
+ * host capabilities later does not have to wait for QEMU.
+ */
+void
+virQEMUCapsCacheProbeAll(virFileCachePtr cache,
+                         int *quit)
+{
+    virArch hostarch = virArchFromHost();
+    size_t i;
+
+    for (i = 0; i < VIR_ARCH_LAST && !g_atomic_int_get(quit); i++) {
+        g_autofree char *binary = NULL;
+        virQEMUCapsPtr qemuCaps;
+
+        if (!(binary = virQEMUCapsGetDefaultEmulator(hostarch, i)))
+            continue;
+
+        if (!(qemuCaps = virQEMUCapsCacheLookup(cache, binary))) {
+            VIR_DEBUG("Failed to probe '%s': %s",
+                      binary, virGetLastErrorMessage());
+            virResetLastError();
+            continue;
+        }
+
+        virObjectUnref(qemuCaps);
+    }
+}
+
+
 /**
  * virQEMUCapsCacheLookupDefault:
  * @cache: QEMU capabilities cache
@@ -594,7 +594,9 @@ virQEMUCapsGetDomainCapsCache(virQEMUCapsPtr qemuCaps,
                               virArch hostarch,
                               bool privileged,
                               virFirmwarePtr *firmwares,
-                              size_t nfirmwares);
+                              size_t nfirmwares,
+                              const char *firmwareStamp,
+                              char **xml);
 
 unsigned int virQEMUCapsGetKVMVersion(virQEMUCapsPtr qemuCaps);
 int virQEMUCapsAddCPUDefinitions(virQEMUCapsPtr qemuCaps,
@@ -673,6 +675,8 @@ virQEMUCapsPtr virQEMUCapsCacheLookupCopy(virFileCachePtr cache,
                                           const char *machineType);
 virQEMUCapsPtr virQEMUCapsCacheLookupByArch(virFileCachePtr cache,
                                             virArch arch);
+void virQEMUCapsCacheProbeAll(virFileCachePtr cache,
+                              int *quit);
 virQEMUCapsPtr virQEMUCapsCacheLookupDefault(virFileCachePtr cache,
                                              const char *binary,
                                              const char *archStr,
@@ -683,9 +687,9 @@ virQEMUCapsPtr virQEMUCapsCacheLookupDefault(virFileCachePtr cache,
                                              const char **retMachine);
 
 virCapsPtr virQEMUCapsInit(virFileCachePtr cache);
+char *virQEMUCapsInitKey(void);
 
-int virQEMUCapsGetDefaultVersion(virCapsPtr caps,
-                                 virFileCachePtr capsCache,
+int virQEMUCapsGetDefaultVersion(virFileCachePtr capsCache,
                                  unsigned int *version);
 
 VIR_ENUM_DECL(virQEMUCaps);
@@ -267,6 +267,13 @@ virQEMUDriverConfigPtr virQEMUDriverConfigNew(bool privileged,
     cfg->securityDefaultConfined = true;
     cfg->securityRequireConfined = false;
 
+    cfg->statsMaxWorkers = 8;
+    cfg->statsJobTimeout = 500;
+    cfg->guestInfoTimeout = 5;
+    cfg->blockJobProgressInterval = 5000;
+
+    cfg->reconnectMaxWorkers = 8;
+
     cfg->keepAliveInterval = 5;
     cfg->keepAliveCount = 5;
     cfg->seccompSandbox = -1;
@@ -718,6 +725,25 @@ virQEMUDriverConfigLoadRPCEntry(virQEMUDriverConfigPtr cfg,
 {
     if (virConfGetValueUInt(conf, "max_queued", &cfg->maxQueuedJobs) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "stats_max_workers", &cfg->statsMaxWorkers) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "stats_job_timeout", &cfg->statsJobTimeout) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "stats_cache_max_age", &cfg->statsCacheMaxAge) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "stats_cache_refresh_interval",
+                            &cfg->statsCacheRefreshInterval) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "guest_info_timeout", &cfg->guestInfoTimeout) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "block_job_progress_interval",
+                            &cfg->blockJobProgressInterval) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "reconnect_max_workers",
+                            &cfg->reconnectMaxWorkers) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "event_threads", &cfg->eventThreads) < 0)
+        return -1;
     if (virConfGetValueInt(conf, "keepalive_interval", &cfg->keepAliveInterval) < 0)
         return -1;
     if (virConfGetValueUInt(conf, "keepalive_count", &cfg->keepAliveCount) < 0)
@@ -752,6 +778,12 @@ virQEMUDriverConfigLoadNetworkEntry(virQEMUDriverConfigPtr cfg,
         return -1;
     }
 
+    if (virConfGetValueUInt(conf, "migration_max_jobs", &cfg->migrationMaxJobs) < 0)
+        return -1;
+    if (virConfGetValueULLong(conf, "migration_bandwidth",
+                              &cfg->migrationBandwidth) < 0)
+        return -1;
+
     if (virConfGetValueString(conf, "migration_host", &cfg->migrateHost) < 0)
         return -1;
     virStringStripIPv6Brackets(cfg->migrateHost);
@@ -1341,7 +1373,8 @@ virCapsPtr virQEMUDriverCreateCapabilities(virQEMUDriverPtr driver)
  *
  * Get a reference to the virCapsPtr instance for the
  * driver. If @refresh is true, the capabilities will be
- * rebuilt first
+ * rebuilt first, unless nothing they depend on has changed
+ * since they were last built
  *
  * The caller must release the reference with virObjetUnref
  *
@@ -1353,12 +1386,26 @@ virCapsPtr virQEMUDriverGetCapabilities(virQEMUDriverPtr driver,
     virCapsPtr ret = NULL;
     if (refresh) {
         virCapsPtr caps = NULL;
+        g_autofree char *key = virQEMUCapsInitKey();
+
+        qemuDriverLock(driver);
+        if (driver->caps && driver->caps->nguests > 0 &&
+            STREQ_NULLABLE(driver->capsKey, key)) {
+            ret = virObjectRef(driver->caps);
+            qemuDriverUnlock(driver);
+            return ret;
+        }
+        qemuDriverUnlock(driver);
+
         if ((caps = virQEMUDriverCreateCapabilities(driver)) == NULL)
             return NULL;
 
         qemuDriverLock(driver);
         virObjectUnref(driver->caps);
         driver->caps = caps;
+        VIR_FREE(driver->capsKey);
+        driver->capsKey = g_steal_pointer(&key);
+        VIR_FREE(driver->capsXML);
     } else {
         qemuDriverLock(driver);
 
@@ -1377,6 +1424,43 @@ virCapsPtr virQEMUDriverGetCapabilities(virQEMUDriverPtr driver,
 }
 
 
+/**
+ * virQEMUDriverGetCapabilitiesXML:
+ *
+ * Get the up to date capabilities of the driver formatted as XML. The
+ * formatted XML is kept until the capabilities are rebuilt.
+ *
+ * Returns: the XML the caller must free or NULL on error
+ */
+char *
+virQEMUDriverGetCapabilitiesXML(virQEMUDriverPtr driver)
+{
+    g_autoptr(virCaps) caps = NULL;
+    char *xml = NULL;
+
+    if (!(caps = virQEMUDriverGetCapabilities(driver, true)))
+        return NULL;
+
+    qemuDriverLock(driver);
+    if (caps == driver->caps && driver->capsXML)
+        xml = g_strdup(driver->capsXML);
+    qemuDriverUnlock(driver);
+
+    if (xml)
+        return xml;
+
+    if (!(xml = virCapabilitiesFormatXML(caps)))
+        return NULL;
+
+    qemuDriverLock(driver);
+    if (caps == driver->caps && !driver->capsXML)
+        driver->capsXML = g_strdup(xml);
+    qemuDriverUnlock(driver);
+
+    return xml;
+}
+
+
 /**
  * virQEMUDriverGetDomainCapabilities:
  *
@@ -1404,7 +1488,48 @@ virQEMUDriverGetDomainCapabilities(virQEMUDriverPtr driver,
                                          driver->hostarch,
                                          driver->privileged,
                                          cfg->firmwares,
-                                         cfg->nfirmwares);
+                                         cfg->nfirmwares,
+                                         NULL, NULL);
+}
+
+
+/**
+ * virQEMUDriverGetDomainCapabilitiesXML:
+ *
+ * Like virQEMUDriverGetDomainCapabilities, but returns the formatted
+ * domcaps, which are cached along with the domcaps. Unlike the domcaps
+ * used for validation, the returned XML reflects the current set of
+ * firmware descriptors.
+ *
+ * Returns: the formatted domcaps or NULL
+ */
+char *
+virQEMUDriverGetDomainCapabilitiesXML(virQEMUDriverPtr driver,
+                                      virQEMUCapsPtr qemuCaps,
+                                      const char *machine,
+                                      virArch arch,
+                                      virDomainVirtType virttype)
+{
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    g_autoptr(virDomainCaps) domCaps = NULL;
+    g_autofree char *stamp = NULL;
+    char *xml = NULL;
+
+    if (!(stamp = qemuFirmwareGetStamp(driver->privileged)))
+        return NULL;
+
+    if (!(domCaps = virQEMUCapsGetDomainCapsCache(qemuCaps,
+                                                  machine,
+                                                  arch,
+                                                  virttype,
+                                                  driver->hostarch,
+                                                  driver->privileged,
+                                                  cfg->firmwares,
+                                                  cfg->nfirmwares,
+                                                  stamp, &xml)))
+        return NULL;
+
+    return xml;
 }
 
 
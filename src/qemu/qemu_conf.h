@@ -41,8 +41,10 @@
 #include "virportallocator.h"
 #include "vircommand.h"
 #include "virthreadpool.h"
+#include "vireventthread.h"
 #include "locking/lock_manager.h"
 #include "qemu_capabilities.h"
+#include "qemu_migration_sched.h"
 #include "virclosecallbacks.h"
 #include "virhostdev.h"
 #include "virfile.h"
@@ -173,6 +175,17 @@ struct _virQEMUDriverConfig {
 
     unsigned int maxQueuedJobs;
 
+    unsigned int statsMaxWorkers;
+    unsigned int statsJobTimeout;
+    unsigned int statsCacheMaxAge;
+    unsigned int statsCacheRefreshInterval;
+    unsigned int guestInfoTimeout;
+
+    unsigned int blockJobProgressInterval;
+
+    unsigned int reconnectMaxWorkers;
+    unsigned int eventThreads;
+
     char **securityDriverNames;
     bool securityDefaultConfined;
     bool securityRequireConfined;
@@ -197,6 +210,8 @@ struct _virQEMUDriverConfig {
     char *migrationAddress;
     unsigned int migrationPortMin;
     unsigned int migrationPortMax;
+    unsigned int migrationMaxJobs;
+    unsigned long long migrationBandwidth;
 
     bool logTimestamp;
     bool stdioLogD;
@@ -237,6 +252,45 @@ struct _virQEMUDriver {
     /* Immutable pointer, self-locking APIs */
     virThreadPoolPtr workerPool;
 
+    /* Immutable pointer, self-locking APIs. NULL if parallel stats
+     * collection is disabled */
+    virThreadPoolPtr statsPool;
+
+    /* Immutable value. Timer refreshing stats cache or -1 */
+    int statsCacheTimer;
+
+    /* Require netStatsLock. Host-wide interface stats collected once
+     * per bulk stats sweep, see qemuDomainGetStatsNetRefresh */
+    virMutex netStatsLock;
+    virHashTablePtr netStatsTap;
+    virHashTablePtr netStatsOVS;
+    bool netStatsOVSFetched;
+
+    /* Immutable value. Timer emitting block job progress events or -1 */
+    int blockJobProgressTimer;
+
+    /* Immutable pointer, self-locking APIs. NULL unless domains are
+     * reconnected by a bounded pool of workers */
+    virThreadPoolPtr reconnectPool;
+
+    /* Atomic access only. Progress of reconnecting to the domains
+     * which were running when the daemon started */
+    unsigned int reconnectTotal;
+    unsigned int reconnectDone;
+    unsigned int reconnectFailed;
+
+    /* Immutable values. Thread probing QEMU binaries in the background
+     * once the driver is initialized, nothing waits for it */
+    virThread capsWarmupThread;
+    bool capsWarmupStarted;
+
+    /* Atomic access only. Asks the warm up thread to stop */
+    int capsWarmupQuit;
+
+    /* Immutable pointer, self-locking APIs. NULL if each domain has
+     * an event thread of its own */
+    virEventThreadPool *eventThreads;
+
     /* Atomic increment only */
     int lastvmid;
 
@@ -264,6 +318,10 @@ struct _virQEMUDriver {
      * lockless access thereafter
      */
     virCapsPtr caps;
+    /* Result of virQEMUCapsInitKey when @caps was built */
+    char *capsKey;
+    /* Lazy initialized formatted @caps, cleared whenever @caps changes */
+    char *capsXML;
 
     /* Lazy initialized on first use, immutable thereafter.
      * Require lock to get the pointer & do optional initialization
@@ -315,6 +373,9 @@ struct _virQEMUDriver {
 
     /* Immutable pointer, self-locking APIs */
     virHashAtomicPtr migrationErrors;
+
+    /* Immutable pointer, self-locking APIs */
+    qemuMigrationSchedPtr migrationSched;
 };
 
 virQEMUDriverConfigPtr virQEMUDriverConfigNew(bool privileged,
@@ -338,6 +399,7 @@ virCPUDefPtr virQEMUDriverGetHostCPU(virQEMUDriverPtr driver);
 virCapsPtr virQEMUDriverCreateCapabilities(virQEMUDriverPtr driver);
 virCapsPtr virQEMUDriverGetCapabilities(virQEMUDriverPtr driver,
                                         bool refresh);
+char *virQEMUDriverGetCapabilitiesXML(virQEMUDriverPtr driver);
 
 virDomainCapsPtr
 virQEMUDriverGetDomainCapabilities(virQEMUDriverPtr driver,
@@ -346,6 +408,13 @@ virQEMUDriverGetDomainCapabilities(virQEMUDriverPtr driver,
                                    virArch arch,
                                    virDomainVirtType virttype);
 
+char *
+virQEMUDriverGetDomainCapabilitiesXML(virQEMUDriverPtr driver,
+                                      virQEMUCapsPtr qemuCaps,
+                                      const char *machine,
+                                      virArch arch,
+                                      virDomainVirtType virttype);
+
 typedef struct _qemuSharedDeviceEntry qemuSharedDeviceEntry;
 typedef qemuSharedDeviceEntry *qemuSharedDeviceEntryPtr;
 
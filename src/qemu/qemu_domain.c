@@ -63,6 +63,7 @@
 #include "backup_conf.h"
 #include "virutil.h"
 #include "virdevmapper.h"
+#include "virprobe.h"
 
 #ifdef __linux__
 # include <sys/sysmacros.h>
@@ -78,6 +79,10 @@
 
 #define QEMU_QXL_VGAMEM_DEFAULT 16 * 1024
 
+#ifdef WITH_DTRACE_PROBES
+# include "libvirt_qemu_probes.h"
+#endif
+
 #define VIR_FROM_THIS VIR_FROM_QEMU
 
 VIR_LOG_INIT("qemu.qemu_domain");
@@ -114,6 +119,32 @@ VIR_ENUM_IMPL(qemuDomainAsyncJob,
               "backup",
 );
 
+VIR_ENUM_IMPL(qemuDomainJobTiming,
+              QEMU_DOMAIN_JOB_TIMING_LAST,
+              "init",
+              "prepare_domain",
+              "prepare_host",
+              "ext_devices",
+              "command_line",
+              "exec",
+              "cgroup",
+              "security",
+              "monitor",
+              "qmp_init",
+              "devices",
+              "finish",
+              "migration_setup",
+              "migration_transfer",
+              "backup_bitmaps",
+              "backup_storage",
+              "backup_transaction",
+              "migration_queue",
+              "ext_vhost_user_gpu",
+              "ext_tpm",
+              "ext_slirp",
+              "ext_virtiofs",
+);
+
 VIR_ENUM_IMPL(qemuDomainNamespace,
               QEMU_DOMAIN_NS_LAST,
               "mount",
@@ -388,6 +419,7 @@ qemuDomainObjResetAsyncJob(qemuDomainObjPrivatePtr priv)
     qemuMigrationParamsFree(job->migParams);
     job->migParams = NULL;
     job->apiFlags = 0;
+    job->timingStart = 0;
 }
 
 void
@@ -448,6 +480,117 @@ qemuDomainJobInfoUpdateTime(qemuDomainJobInfoPtr jobInfo)
     return 0;
 }
 
+/**
+ * qemuDomainJobTimingStart:
+ * @vm: domain object
+ *
+ * Starts measuring how long the phases of starting, migrating or backing
+ * up @vm take.
+ * Nothing is measured unless this was called.
+ */
+void
+qemuDomainJobTimingStart(virDomainObjPtr vm)
+{
+    QEMU_DOMAIN_PRIVATE(vm)->job.timingStart = g_get_monotonic_time();
+}
+
+
+/**
+ * qemuDomainJobTimingRecord:
+ * @vm: domain object
+ * @phase: the phase which just finished
+ *
+ * Accounts the time since the previous phase finished to @phase in the
+ * statistics of the current async job, if there is one, and reports it
+ * through the qemu_job_phase probe. A phase may be recorded several times,
+ * the times are added up.
+ */
+void
+qemuDomainJobTimingRecord(virDomainObjPtr vm,
+                          qemuDomainJobTiming phase)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    unsigned long long now;
+    unsigned long long usecs;
+
+    if (!priv->job.timingStart)
+        return;
+
+    now = g_get_monotonic_time();
+    usecs = now - priv->job.timingStart;
+    priv->job.timingStart = now;
+
+    PROBE(QEMU_JOB_PHASE,
+          "vm=%p name=%s phase=%s usecs=%llu",
+          vm, vm->def->name, qemuDomainJobTimingTypeToString(phase), usecs);
+
+    if (priv->job.current)
+        priv->job.current->timing[phase] += usecs;
+}
+
+
+/**
+ * qemuDomainJobTimingAdd:
+ * @vm: domain object
+ * @phase: the phase to account @usecs to
+ * @usecs: duration measured by the caller
+ *
+ * Like qemuDomainJobTimingRecord, but for parts of a phase which were
+ * measured separately, e.g. because they ran in parallel. The start of
+ * the current phase is not changed.
+ */
+void
+qemuDomainJobTimingAdd(virDomainObjPtr vm,
+                       qemuDomainJobTiming phase,
+                       unsigned long long usecs)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+
+    if (!priv->job.timingStart)
+        return;
+
+    PROBE(QEMU_JOB_PHASE,
+          "vm=%p name=%s phase=%s usecs=%llu",
+          vm, vm->def->name, qemuDomainJobTimingTypeToString(phase), usecs);
+
+    if (priv->job.current)
+        priv->job.current->timing[phase] += usecs;
+}
+
+
+void
+qemuDomainJobTimingStop(virDomainObjPtr vm)
+{
+    QEMU_DOMAIN_PRIVATE(vm)->job.timingStart = 0;
+}
+
+
+static int
+qemuDomainJobTimingToParams(qemuDomainJobInfoPtr jobInfo,
+                            virTypedParameterPtr *params,
+                            int *nparams)
+{
+    int maxpar = *nparams;
+    size_t i;
+
+    for (i = 0; i < QEMU_DOMAIN_JOB_TIMING_LAST; i++) {
+        g_autofree char *field = NULL;
+
+        if (!jobInfo->timing[i])
+            continue;
+
+        field = g_strdup_printf(VIR_DOMAIN_JOB_TIME_PHASE_PREFIX "%s",
+                                qemuDomainJobTimingTypeToString(i));
+
+        if (virTypedParamsAddULLong(params, nparams, &maxpar, field,
+                                    jobInfo->timing[i]) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
 int
 qemuDomainJobInfoUpdateDowntime(qemuDomainJobInfoPtr jobInfo)
 {
@@ -713,6 +856,12 @@ qemuDomainMigrationJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
                              stats->cpu_throttle_percentage) < 0)
         goto error;
 
+    if (jobInfo->bandwidthShare &&
+        virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                VIR_DOMAIN_JOB_BANDWIDTH_SHARE,
+                                jobInfo->bandwidthShare) < 0)
+        goto error;
+
  done:
     *type = qemuDomainJobStatusToType(jobInfo->status);
     *params = par;
@@ -821,26 +970,59 @@ qemuDomainBackupJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
 }
 
 
+static int
+qemuDomainGenericJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
+                                 int *type,
+                                 virTypedParameterPtr *params,
+                                 int *nparams)
+{
+    g_autoptr(virTypedParamList) par = g_new0(virTypedParamList, 1);
+
+    if (virTypedParamListAddInt(par, jobInfo->operation,
+                                VIR_DOMAIN_JOB_OPERATION) < 0)
+        return -1;
+
+    if (virTypedParamListAddULLong(par, jobInfo->timeElapsed,
+                                   VIR_DOMAIN_JOB_TIME_ELAPSED) < 0)
+        return -1;
+
+    if (jobInfo->status != QEMU_DOMAIN_JOB_STATUS_ACTIVE &&
+        virTypedParamListAddBoolean(par,
+                                    jobInfo->status == QEMU_DOMAIN_JOB_STATUS_COMPLETED,
+                                    VIR_DOMAIN_JOB_SUCCESS) < 0)
+        return -1;
+
+    *nparams = virTypedParamListStealParams(par, params);
+    *type = qemuDomainJobStatusToType(jobInfo->status);
+    return 0;
+}
+
+
 int
 qemuDomainJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
                           int *type,
                           virTypedParameterPtr *params,
                           int *nparams)
 {
+    int rc = -1;
+
     switch (jobInfo->statsType) {
     case QEMU_DOMAIN_JOB_STATS_TYPE_MIGRATION:
     case QEMU_DOMAIN_JOB_STATS_TYPE_SAVEDUMP:
-        return qemuDomainMigrationJobInfoToParams(jobInfo, type, params, nparams);
+        rc = qemuDomainMigrationJobInfoToParams(jobInfo, type, params, nparams);
+        break;
 
     case QEMU_DOMAIN_JOB_STATS_TYPE_MEMDUMP:
-        return qemuDomainDumpJobInfoToParams(jobInfo, type, params, nparams);
+        rc = qemuDomainDumpJobInfoToParams(jobInfo, type, params, nparams);
+        break;
 
     case QEMU_DOMAIN_JOB_STATS_TYPE_BACKUP:
-        return qemuDomainBackupJobInfoToParams(jobInfo, type, params, nparams);
+        rc = qemuDomainBackupJobInfoToParams(jobInfo, type, params, nparams);
+        break;
 
     case QEMU_DOMAIN_JOB_STATS_TYPE_NONE:
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("invalid job statistics type"));
+        /* Jobs without any statistics from QEMU, e.g., starting a domain */
+        rc = qemuDomainGenericJobInfoToParams(jobInfo, type, params, nparams);
         break;
 
     default:
@@ -848,7 +1030,17 @@ qemuDomainJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
         break;
     }
 
-    return -1;
+    if (rc < 0)
+        return -1;
+
+    if (qemuDomainJobTimingToParams(jobInfo, params, nparams) < 0) {
+        virTypedParamsFree(*params, *nparams);
+        *params = NULL;
+        *nparams = 0;
+        return -1;
+    }
+
+    return 0;
 }
 
 
@@ -1232,15 +1424,34 @@ qemuDomainVcpuPrivateNew(void)
     if (!(priv = virObjectNew(qemuDomainVcpuPrivateClass)))
         return NULL;
 
+    priv->statfd = -1;
+    priv->schedfd = -1;
+
     return (virObjectPtr) priv;
 }
 
 
+/**
+ * qemuDomainVcpuPrivateCloseFiles:
+ * @priv: vCPU private data
+ *
+ * Closes the files of the vCPU thread which are kept open to collect its
+ * statistics. This has to be done whenever the thread ID changes.
+ */
+static void
+qemuDomainVcpuPrivateCloseFiles(qemuDomainVcpuPrivatePtr priv)
+{
+    VIR_FORCE_CLOSE(priv->statfd);
+    VIR_FORCE_CLOSE(priv->schedfd);
+}
+
+
 static void
 qemuDomainVcpuPrivateDispose(void *obj)
 {
     qemuDomainVcpuPrivatePtr priv = obj;
 
+    qemuDomainVcpuPrivateCloseFiles(priv);
     VIR_FREE(priv->type);
     VIR_FREE(priv->alias);
     virJSONValueFree(priv->props);
@@ -2193,7 +2404,13 @@ qemuDomainObjStartWorker(virDomainObjPtr dom)
 {
     qemuDomainObjPrivatePtr priv = dom->privateData;
 
-    if (!priv->eventThread) {
+    if (priv->eventThread)
+        return 0;
+
+    if (priv->driver->eventThreads) {
+        if (!(priv->eventThread = virEventThreadPoolAcquire(priv->driver->eventThreads)))
+            return -1;
+    } else {
         g_autofree char *threadName = g_strdup_printf("vm-%s", dom->def->name);
         if (!(priv->eventThread = virEventThreadNew(threadName)))
             return -1;
@@ -2208,10 +2425,14 @@ qemuDomainObjStopWorker(virDomainObjPtr dom)
 {
     qemuDomainObjPrivatePtr priv = dom->privateData;
 
-    if (priv->eventThread) {
+    if (!priv->eventThread)
+        return;
+
+    if (priv->driver->eventThreads)
+        virEventThreadPoolRelease(priv->driver->eventThreads, priv->eventThread);
+    else
         g_object_unref(priv->eventThread);
-        priv->eventThread = NULL;
-    }
+    priv->eventThread = NULL;
 }
 
 
@@ -2238,6 +2459,9 @@ qemuDomainObjPrivateAlloc(void *opaque)
     if (!(priv->dbusVMStates = virHashCreate(5, dbusVMStateHashFree)))
         goto error;
 
+    if (!(priv->screenshots = virHashCreate(5, virHashValueFree)))
+        goto error;
+
     /* agent commands block by default, user can choose different behavior */
     priv->agentTimeout = VIR_DOMAIN_AGENT_RESPONSE_TIMEOUT_BLOCK;
     priv->migMaxBandwidth = QEMU_DOMAIN_MIG_BANDWIDTH_MAX;
@@ -2250,6 +2474,138 @@ qemuDomainObjPrivateAlloc(void *opaque)
     return NULL;
 }
 
+
+void
+qemuDomainStatsCacheClear(qemuDomainStatsCacheEntryPtr cache,
+                          size_t ncache)
+{
+    size_t i;
+
+    for (i = 0; i < ncache; i++) {
+        virTypedParamsFree(cache[i].params, cache[i].nparams);
+        cache[i].params = NULL;
+        cache[i].nparams = 0;
+        cache[i].timestamp = 0;
+    }
+}
+
+
+/**
+ * qemuDomainMemoryStatsCacheGet:
+ * @vm: domain object
+ * @stats: array to fill
+ * @nr_stats: number of elements of @stats
+ *
+ * The balloon driver of the guest refreshes its statistics once per
+ * collection period only, reading them from QEMU more often returns the
+ * same values. The actual size of the balloon is tracked by the
+ * BALLOON_CHANGE event. This fills @stats from the statistics recorded by
+ * qemuDomainMemoryStatsCacheUpdate as long as the guest is not due to
+ * refresh them.
+ *
+ * The caller must hold the lock of @vm.
+ *
+ * Returns the number of statistics filled in or -1 if they have to be
+ * read from QEMU.
+ */
+int
+qemuDomainMemoryStatsCacheGet(virDomainObjPtr vm,
+                              virDomainMemoryStatPtr stats,
+                              unsigned int nr_stats)
+{
+    qemuDomainMemoryStatsCachePtr cache = &QEMU_DOMAIN_PRIVATE(vm)->memoryStats;
+    unsigned long long now;
+    size_t i;
+    int got = 0;
+
+    if (cache->nstats == 0 || !vm->def->memballoon ||
+        vm->def->memballoon->period <= 0)
+        return -1;
+
+    if (virTimeMillisNow(&now) < 0 || now / 1000 >= cache->expiry)
+        return -1;
+
+    for (i = 0; i < cache->nstats && got < nr_stats; i++) {
+        stats[got] = cache->stats[i];
+        if (stats[got].tag == VIR_DOMAIN_MEMORY_STAT_ACTUAL_BALLOON)
+            stats[got].val = vm->def->mem.cur_balloon;
+        got++;
+    }
+
+    return got;
+}
+
+
+/**
+ * qemuDomainMemoryStatsCacheUpdate:
+ * @vm: domain object
+ * @stats: statistics just read from QEMU
+ * @nstats: number of elements of @stats
+ *
+ * Records @stats for qemuDomainMemoryStatsCacheGet until the guest is
+ * expected to refresh them, i.e. until their last update plus the
+ * collection period. Statistics without a time of last update are not
+ * recorded.
+ *
+ * The caller must hold the lock of @vm.
+ */
+void
+qemuDomainMemoryStatsCacheUpdate(virDomainObjPtr vm,
+                                 const virDomainMemoryStatStruct *stats,
+                                 int nstats)
+{
+    qemuDomainMemoryStatsCachePtr cache = &QEMU_DOMAIN_PRIVATE(vm)->memoryStats;
+    size_t i;
+
+    qemuDomainMemoryStatsCacheClear(vm);
+
+    if (nstats <= 0 || nstats > VIR_DOMAIN_MEMORY_STAT_NR ||
+        !vm->def->memballoon || vm->def->memballoon->period <= 0)
+        return;
+
+    for (i = 0; i < nstats; i++) {
+        if (stats[i].tag == VIR_DOMAIN_MEMORY_STAT_LAST_UPDATE &&
+            stats[i].val > 0) {
+            cache->expiry = stats[i].val + vm->def->memballoon->period;
+            break;
+        }
+    }
+
+    if (cache->expiry == 0)
+        return;
+
+    memcpy(cache->stats, stats, sizeof(stats[0]) * nstats);
+    cache->nstats = nstats;
+}
+
+
+/**
+ * qemuDomainMemoryStatsCacheClear:
+ * @vm: domain object
+ *
+ * Makes the next query of memory statistics of @vm go to QEMU.
+ */
+void
+qemuDomainMemoryStatsCacheClear(virDomainObjPtr vm)
+{
+    qemuDomainMemoryStatsCachePtr cache = &QEMU_DOMAIN_PRIVATE(vm)->memoryStats;
+
+    cache->nstats = 0;
+    cache->expiry = 0;
+}
+
+
+static void
+qemuDomainSaveStatusCancel(qemuDomainObjPrivatePtr priv)
+{
+    if (!priv->saveStatusSource)
+        return;
+
+    g_source_destroy(priv->saveStatusSource);
+    g_clear_pointer(&priv->saveStatusSource, g_source_unref);
+}
+
+
 /**
  * qemuDomainObjPrivateDataClear:
  * @priv: domain private data
@@ -2260,6 +2616,9 @@ qemuDomainObjPrivateAlloc(void *opaque)
 void
 qemuDomainObjPrivateDataClear(qemuDomainObjPrivatePtr priv)
 {
+    /* the domain is gone, so is its status XML */
+    qemuDomainSaveStatusCancel(priv);
+
     virStringListFree(priv->qemuDevices);
     priv->qemuDevices = NULL;
 
@@ -2309,6 +2668,7 @@ qemuDomainObjPrivateDataClear(qemuDomainObjPrivatePtr priv)
 
     virHashRemoveAll(priv->blockjobs);
     virHashRemoveAll(priv->dbusVMStates);
+    virHashRemoveAll(priv->screenshots);
 
     virObjectUnref(priv->pflash0);
     priv->pflash0 = NULL;
@@ -2318,6 +2678,13 @@ qemuDomainObjPrivateDataClear(qemuDomainObjPrivatePtr priv)
     virDomainBackupDefFree(priv->backup);
     priv->backup = NULL;
 
+    qemuDomainStatsCacheClear(priv->statsCache, priv->nstatsCache);
+    VIR_FREE(priv->statsCache);
+    priv->nstatsCache = 0;
+
+    priv->memoryStats.nstats = 0;
+    priv->memoryStats.expiry = 0;
+
     /* reset node name allocator */
     qemuDomainStorageIdReset(priv);
 }
@@ -2353,6 +2720,7 @@ qemuDomainObjPrivateFree(void *data)
 
     virHashFree(priv->blockjobs);
     virHashFree(priv->dbusVMStates);
+    virHashFree(priv->screenshots);
 
     /* This should never be non-NULL if we get here, but just in case... */
     if (priv->eventThread) {
@@ -9558,6 +9926,10 @@ qemuDomainObjSaveStatus(virQEMUDriverPtr driver,
                         virDomainObjPtr obj)
 {
     g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    qemuDomainObjPrivatePtr priv = obj->privateData;
+
+    /* The status we are about to save covers any delayed save */
+    qemuDomainSaveStatusCancel(priv);
 
     if (virDomainObjIsActive(obj)) {
         if (virDomainObjSave(obj, driver->xmlopt, cfg->stateDir) < 0)
@@ -9573,6 +9945,82 @@ qemuDomainSaveStatus(virDomainObjPtr obj)
 }
 
 
+static gboolean
+qemuDomainSaveStatusTimeout(gpointer opaque)
+{
+    virDomainObjPtr obj = opaque;
+    qemuDomainObjPrivatePtr priv;
+
+    virObjectLock(obj);
+    priv = obj->privateData;
+
+    /* The save may have been cancelled while we waited for the lock */
+    if (priv->saveStatusSource == g_main_current_source())
+        qemuDomainSaveStatus(obj);
+
+    virObjectUnlock(obj);
+
+    return G_SOURCE_REMOVE;
+}
+
+
+/**
+ * qemuDomainSaveStatusDelayed:
+ * @obj: domain object
+ *
+ * Like qemuDomainSaveStatus, but the status XML is written from the event
+ * thread of @obj once QEMU_DOMAIN_SAVE_STATUS_DELAY passes, so that any
+ * number of changes done in the meantime result in a single write. Meant
+ * for changes which may come quickly one after another and which don't
+ * need to hit the disk before the caller proceeds. Saving the status
+ * synchronously writes any pending changes too.
+ *
+ * The caller must hold the lock of @obj.
+ */
+void
+qemuDomainSaveStatusDelayed(virDomainObjPtr obj)
+{
+    qemuDomainObjPrivatePtr priv = obj->privateData;
+
+    if (priv->saveStatusSource)
+        return;
+
+    if (!priv->eventThread) {
+        qemuDomainSaveStatus(obj);
+        return;
+    }
+
+    priv->saveStatusSource = g_timeout_source_new(QEMU_DOMAIN_SAVE_STATUS_DELAY);
+    g_source_set_callback(priv->saveStatusSource,
+                          qemuDomainSaveStatusTimeout,
+                          virObjectRef(obj),
+                          virObjectFreeCallback);
+    g_source_attach(priv->saveStatusSource,
+                    virEventThreadGetContext(priv->eventThread));
+}
+
+
+/**
+ * qemuDomainSaveStatusFlush:
+ * @obj: domain object
+ * @opaque: unused
+ *
+ * Writes the status XML of @obj if a delayed save is pending. Suitable for
+ * virDomainObjListForEach.
+ */
+int
+qemuDomainSaveStatusFlush(virDomainObjPtr obj,
+                          void *opaque G_GNUC_UNUSED)
+{
+    virObjectLock(obj);
+    if (QEMU_DOMAIN_PRIVATE(obj)->saveStatusSource)
+        qemuDomainSaveStatus(obj);
+    virObjectUnlock(obj);
+
+    return 0;
+}
+
+
 void
 qemuDomainSaveConfig(virDomainObjPtr obj)
 {
@@ -9680,7 +10128,9 @@ qemuDomainObjCanSetJob(qemuDomainObjPrivatePtr priv,
                        qemuDomainAgentJob agentJob)
 {
     return ((job == QEMU_JOB_NONE ||
-             priv->job.active == QEMU_JOB_NONE) &&
+             (priv->job.active == QEMU_JOB_NONE &&
+              priv->job.nsharedQueries == 0 &&
+              priv->job.ndiskJobs == 0)) &&
             (agentJob == QEMU_AGENT_JOB_NONE ||
              priv->job.agentActive == QEMU_AGENT_JOB_NONE));
 }
@@ -9695,11 +10145,12 @@ qemuDomainObjCanSetJob(qemuDomainObjPrivatePtr priv,
  * @job: qemuDomainJob to start
  * @asyncJob: qemuDomainAsyncJob to start
  * @nowait: don't wait trying to acquire @job
+ * @timeout: how long to wait for @job in milliseconds
  *
  * Acquires job for a domain object which must be locked before
- * calling. If there's already a job running waits up to
- * QEMU_JOB_WAIT_TIME after which the functions fails reporting
- * an error unless @nowait is set.
+ * calling. If there's already a job running waits up to @timeout
+ * (usually QEMU_JOB_WAIT_TIME) after which the functions fails
+ * reporting an error unless @nowait is set.
  *
  * If @nowait is true this function tries to acquire job and if
  * it fails, then it returns immediately without waiting. No
@@ -9716,7 +10167,8 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
                               qemuDomainJob job,
                               qemuDomainAgentJob agentJob,
                               qemuDomainAsyncJob asyncJob,
-                              bool nowait)
+                              bool nowait,
+                              unsigned long long timeout)
 {
     qemuDomainObjPrivatePtr priv = obj->privateData;
     unsigned long long now;
@@ -9745,7 +10197,7 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
         return -1;
 
     priv->jobs_queued++;
-    then = now + QEMU_JOB_WAIT_TIME;
+    then = now + timeout;
 
  retry:
     if ((!async && job != QEMU_JOB_DESTROY) &&
@@ -9764,11 +10216,20 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
     }
 
     while (!qemuDomainObjCanSetJob(priv, job, agentJob)) {
+        int rc;
+
         if (nowait)
             goto cleanup;
 
         VIR_DEBUG("Waiting for job (vm=%p name=%s)", obj, obj->def->name);
-        if (virCondWaitUntil(&priv->job.cond, &obj->parent.lock, then) < 0)
+        /* Let shared query jobs know there's someone waiting so that
+         * new queries don't starve us. */
+        if (job)
+            priv->job.nexclusiveWaiters++;
+        rc = virCondWaitUntil(&priv->job.cond, &obj->parent.lock, then);
+        if (job)
+            priv->job.nexclusiveWaiters--;
+        if (rc < 0)
             goto error;
     }
 
@@ -9932,7 +10393,8 @@ int qemuDomainObjBeginJob(virQEMUDriverPtr driver,
 {
     if (qemuDomainObjBeginJobInternal(driver, obj, job,
                                       QEMU_AGENT_JOB_NONE,
-                                      QEMU_ASYNC_JOB_NONE, false) < 0)
+                                      QEMU_ASYNC_JOB_NONE, false,
+                                      QEMU_JOB_WAIT_TIME) < 0)
         return -1;
     else
         return 0;
@@ -9952,23 +10414,51 @@ qemuDomainObjBeginAgentJob(virQEMUDriverPtr driver,
 {
     return qemuDomainObjBeginJobInternal(driver, obj, QEMU_JOB_NONE,
                                          agentJob,
-                                         QEMU_ASYNC_JOB_NONE, false);
+                                         QEMU_ASYNC_JOB_NONE, false,
+                                         QEMU_JOB_WAIT_TIME);
 }
 
-int qemuDomainObjBeginAsyncJob(virQEMUDriverPtr driver,
-                               virDomainObjPtr obj,
-                               qemuDomainAsyncJob asyncJob,
-                               virDomainJobOperation operation,
-                               unsigned long apiFlags)
-{
-    qemuDomainObjPrivatePtr priv;
-
-    if (qemuDomainObjBeginJobInternal(driver, obj, QEMU_JOB_ASYNC,
-                                      QEMU_AGENT_JOB_NONE,
-                                      asyncJob, false) < 0)
-        return -1;
-
-    priv = obj->privateData;
+/**
+ * qemuDomainObjBeginAgentJobTimeout:
+ *
+ * @driver: qemu driver
+ * @obj: domain object
+ * @agentJob: qemuDomainAgentJob to start
+ * @timeout: maximum time to wait in milliseconds
+ *
+ * Works like qemuDomainObjBeginAgentJob() except that it gives up
+ * waiting for the current agent job to finish after @timeout
+ * milliseconds instead of QEMU_JOB_WAIT_TIME.
+ *
+ * Returns: see qemuDomainObjBeginJobInternal
+ */
+int
+qemuDomainObjBeginAgentJobTimeout(virQEMUDriverPtr driver,
+                                  virDomainObjPtr obj,
+                                  qemuDomainAgentJob agentJob,
+                                  unsigned long long timeout)
+{
+    return qemuDomainObjBeginJobInternal(driver, obj, QEMU_JOB_NONE,
+                                         agentJob,
+                                         QEMU_ASYNC_JOB_NONE, false,
+                                         timeout);
+}
+
+int qemuDomainObjBeginAsyncJob(virQEMUDriverPtr driver,
+                               virDomainObjPtr obj,
+                               qemuDomainAsyncJob asyncJob,
+                               virDomainJobOperation operation,
+                               unsigned long apiFlags)
+{
+    qemuDomainObjPrivatePtr priv;
+
+    if (qemuDomainObjBeginJobInternal(driver, obj, QEMU_JOB_ASYNC,
+                                      QEMU_AGENT_JOB_NONE,
+                                      asyncJob, false,
+                                      QEMU_JOB_WAIT_TIME) < 0)
+        return -1;
+
+    priv = obj->privateData;
     priv->job.current->operation = operation;
     priv->job.apiFlags = apiFlags;
     return 0;
@@ -9997,7 +10487,7 @@ qemuDomainObjBeginNestedJob(virQEMUDriverPtr driver,
                                          QEMU_JOB_ASYNC_NESTED,
                                          QEMU_AGENT_JOB_NONE,
                                          QEMU_ASYNC_JOB_NONE,
-                                         false);
+                                         false, QEMU_JOB_WAIT_TIME);
 }
 
 /**
@@ -10020,7 +10510,314 @@ qemuDomainObjBeginJobNowait(virQEMUDriverPtr driver,
 {
     return qemuDomainObjBeginJobInternal(driver, obj, job,
                                          QEMU_AGENT_JOB_NONE,
-                                         QEMU_ASYNC_JOB_NONE, true);
+                                         QEMU_ASYNC_JOB_NONE, true, 0);
+}
+
+/**
+ * qemuDomainObjBeginJobTimeout:
+ *
+ * @driver: qemu driver
+ * @obj: domain object
+ * @job: qemuDomainJob to start
+ * @timeout: maximum time to wait in milliseconds
+ *
+ * Acquires job for a domain object which must be locked before
+ * calling. Works like qemuDomainObjBeginJob() except that it
+ * gives up waiting for the current job to finish after @timeout
+ * milliseconds instead of QEMU_JOB_WAIT_TIME.
+ *
+ * Returns: see qemuDomainObjBeginJobInternal
+ */
+int
+qemuDomainObjBeginJobTimeout(virQEMUDriverPtr driver,
+                             virDomainObjPtr obj,
+                             qemuDomainJob job,
+                             unsigned long long timeout)
+{
+    return qemuDomainObjBeginJobInternal(driver, obj, job,
+                                         QEMU_AGENT_JOB_NONE,
+                                         QEMU_ASYNC_JOB_NONE, false,
+                                         timeout);
+}
+
+/* Reports why a shared query or disk job couldn't be started and
+ * returns the value the caller should return. */
+static int
+qemuDomainObjSharedJobError(virDomainObjPtr obj,
+                            virQEMUDriverConfigPtr cfg,
+                            const char *kind)
+{
+    qemuDomainObjPrivatePtr priv = obj->privateData;
+
+    VIR_WARN("Cannot start %s job for domain %s; "
+             "current job is (%s, %s) owned by (%llu %s, %llu %s)",
+             kind, obj->def->name,
+             qemuDomainJobTypeToString(priv->job.active),
+             qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
+             priv->job.owner, NULLSTR(priv->job.ownerAPI),
+             priv->job.asyncOwner, NULLSTR(priv->job.asyncOwnerAPI));
+
+    if (errno == ETIMEDOUT) {
+        virReportError(VIR_ERR_OPERATION_TIMEOUT,
+                       _("cannot acquire state change lock (held by monitor=%s)"),
+                       NULLSTR(priv->job.ownerAPI));
+        return -2;
+    } else if (cfg->maxQueuedJobs &&
+               priv->jobs_queued > cfg->maxQueuedJobs) {
+        virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                       _("cannot acquire state change lock "
+                         "due to max_queued limit"));
+        return -2;
+    }
+
+    virReportSystemError(errno, "%s", _("cannot acquire job mutex"));
+    return -1;
+}
+
+/**
+ * qemuDomainObjBeginSharedQueryJobInternal:
+ * @driver: qemu driver
+ * @obj: domain object
+ * @nowait: don't wait trying to acquire the job
+ * @timeout: how long to wait for the job in milliseconds
+ *
+ * Acquires a shared query job for a domain object which must be
+ * locked before calling. Unlike QEMU_JOB_QUERY, any number of shared
+ * query jobs may run at the same time, they only exclude regular
+ * jobs (and async jobs which don't allow QEMU_JOB_QUERY). Holders of
+ * a shared query job may enter the monitor, commands sent by them
+ * are serialized by the monitor itself. Therefore, the job must only
+ * be used for reading from the monitor; the domain object must not
+ * be modified other than updating runtime data while locked.
+ *
+ * In order for exclusive jobs not to be starved by a steady stream
+ * of queries, no new shared query job is started while there's a
+ * thread waiting for an exclusive job.
+ *
+ * Returns: 0 on success,
+ *         -2 if unable to start job because of timeout or
+ *            maxQueuedJobs limit,
+ *         -1 otherwise.
+ */
+static int ATTRIBUTE_NONNULL(1)
+qemuDomainObjBeginSharedQueryJobInternal(virQEMUDriverPtr driver,
+                                         virDomainObjPtr obj,
+                                         bool nowait,
+                                         unsigned long long timeout)
+{
+    qemuDomainObjPrivatePtr priv = obj->privateData;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    unsigned long long now;
+    unsigned long long then;
+    int ret = -1;
+
+    VIR_DEBUG("Starting shared query job (vm=%p name=%s, current job=%s "
+              "async=%s shared=%u)",
+              obj, obj->def->name,
+              qemuDomainJobTypeToString(priv->job.active),
+              qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
+              priv->job.nsharedQueries);
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    priv->jobs_queued++;
+    then = now + timeout;
+
+ retry:
+    if (cfg->maxQueuedJobs &&
+        priv->jobs_queued > cfg->maxQueuedJobs)
+        goto error;
+
+    while (!qemuDomainNestedJobAllowed(priv, QEMU_JOB_QUERY)) {
+        if (nowait)
+            goto cleanup;
+
+        VIR_DEBUG("Waiting for async job (vm=%p name=%s)", obj, obj->def->name);
+        if (virCondWaitUntil(&priv->job.asyncCond, &obj->parent.lock, then) < 0)
+            goto error;
+    }
+
+    while (priv->job.active != QEMU_JOB_NONE ||
+           priv->job.nexclusiveWaiters > 0) {
+        if (nowait)
+            goto cleanup;
+
+        VIR_DEBUG("Waiting for job (vm=%p name=%s)", obj, obj->def->name);
+        if (virCondWaitUntil(&priv->job.cond, &obj->parent.lock, then) < 0)
+            goto error;
+    }
+
+    /* An async job could have been started while obj was unlocked */
+    if (!qemuDomainNestedJobAllowed(priv, QEMU_JOB_QUERY))
+        goto retry;
+
+    priv->job.nsharedQueries++;
+    VIR_DEBUG("Started shared query job (vm=%p name=%s shared=%u)",
+              obj, obj->def->name, priv->job.nsharedQueries);
+    return 0;
+
+ error:
+    ret = qemuDomainObjSharedJobError(obj, cfg, "shared query");
+
+ cleanup:
+    priv->jobs_queued--;
+    return ret;
+}
+
+/**
+ * qemuDomainObjBeginSharedQueryJob:
+ *
+ * @driver: qemu driver
+ * @obj: domain object
+ *
+ * Acquires a shared query job, see
+ * qemuDomainObjBeginSharedQueryJobInternal. Waits up to
+ * QEMU_JOB_WAIT_TIME for the job.
+ *
+ * To end job call qemuDomainObjEndSharedQueryJob.
+ */
+int
+qemuDomainObjBeginSharedQueryJob(virQEMUDriverPtr driver,
+                                 virDomainObjPtr obj)
+{
+    if (qemuDomainObjBeginSharedQueryJobInternal(driver, obj, false,
+                                                 QEMU_JOB_WAIT_TIME) < 0)
+        return -1;
+    else
+        return 0;
+}
+
+/**
+ * qemuDomainObjBeginSharedQueryJobNowait:
+ *
+ * @driver: qemu driver
+ * @obj: domain object
+ *
+ * Acquires a shared query job. If that's not possible right away,
+ * it returns immediately without any error reported.
+ *
+ * Returns: see qemuDomainObjBeginSharedQueryJobInternal
+ */
+int
+qemuDomainObjBeginSharedQueryJobNowait(virQEMUDriverPtr driver,
+                                       virDomainObjPtr obj)
+{
+    return qemuDomainObjBeginSharedQueryJobInternal(driver, obj, true, 0);
+}
+
+/**
+ * qemuDomainObjBeginSharedQueryJobTimeout:
+ *
+ * @driver: qemu driver
+ * @obj: domain object
+ * @timeout: maximum time to wait in milliseconds
+ *
+ * Acquires a shared query job waiting at most @timeout milliseconds.
+ *
+ * Returns: see qemuDomainObjBeginSharedQueryJobInternal
+ */
+int
+qemuDomainObjBeginSharedQueryJobTimeout(virQEMUDriverPtr driver,
+                                        virDomainObjPtr obj,
+                                        unsigned long long timeout)
+{
+    return qemuDomainObjBeginSharedQueryJobInternal(driver, obj, false,
+                                                    timeout);
+}
+
+/**
+ * qemuDomainObjBeginDiskJob:
+ * @driver: qemu driver
+ * @obj: domain object
+ * @path: target or source path of the disk to operate on
+ * @disk: filled in with the disk @path refers to
+ *
+ * Acquires a disk job for a domain object which must be locked before
+ * calling. Disk jobs are meant for setting up block jobs, which may
+ * take a while when the storage has to be created or labelled. Any
+ * number of disk jobs may run at the same time as long as each of them
+ * operates on a different disk. Like shared query jobs they exclude
+ * regular jobs and can run along with shared query jobs. Holders of a
+ * disk job may enter the monitor, but they may only modify @disk,
+ * block jobs registered for it and runtime data while @obj is locked.
+ *
+ * Since the definition may change while waiting for the job, @disk is
+ * looked up only when the job can be started.
+ *
+ * To end job call qemuDomainObjEndDiskJob.
+ *
+ * Returns: 0 on success, -1 otherwise.
+ */
+int
+qemuDomainObjBeginDiskJob(virQEMUDriverPtr driver,
+                          virDomainObjPtr obj,
+                          const char *path,
+                          virDomainDiskDefPtr *disk)
+{
+    qemuDomainObjPrivatePtr priv = obj->privateData;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    virDomainDiskDefPtr d = NULL;
+    unsigned long long now;
+    unsigned long long then;
+
+    VIR_DEBUG("Starting disk job (vm=%p name=%s disk=%s, current job=%s "
+              "async=%s disk jobs=%u)",
+              obj, obj->def->name, path,
+              qemuDomainJobTypeToString(priv->job.active),
+              qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
+              priv->job.ndiskJobs);
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    priv->jobs_queued++;
+    then = now + QEMU_JOB_WAIT_TIME;
+
+ retry:
+    if (cfg->maxQueuedJobs &&
+        priv->jobs_queued > cfg->maxQueuedJobs)
+        goto error;
+
+    while (!qemuDomainNestedJobAllowed(priv, QEMU_JOB_MODIFY)) {
+        VIR_DEBUG("Waiting for async job (vm=%p name=%s)", obj, obj->def->name);
+        if (virCondWaitUntil(&priv->job.asyncCond, &obj->parent.lock, then) < 0)
+            goto error;
+    }
+
+    for (;;) {
+        if (priv->job.active == QEMU_JOB_NONE &&
+            priv->job.nexclusiveWaiters == 0) {
+            if (!(d = qemuDomainDiskByName(obj->def, path)))
+                goto cleanup;
+
+            if (!QEMU_DOMAIN_DISK_PRIVATE(d)->diskJob)
+                break;
+        }
+
+        VIR_DEBUG("Waiting for job (vm=%p name=%s)", obj, obj->def->name);
+        if (virCondWaitUntil(&priv->job.cond, &obj->parent.lock, then) < 0)
+            goto error;
+    }
+
+    /* An async job could have been started while obj was unlocked */
+    if (!qemuDomainNestedJobAllowed(priv, QEMU_JOB_MODIFY))
+        goto retry;
+
+    QEMU_DOMAIN_DISK_PRIVATE(d)->diskJob = true;
+    priv->job.ndiskJobs++;
+    *disk = d;
+
+    VIR_DEBUG("Started disk job (vm=%p name=%s disk=%s disk jobs=%u)",
+              obj, obj->def->name, d->dst, priv->job.ndiskJobs);
+    return 0;
+
+ error:
+    ignore_value(qemuDomainObjSharedJobError(obj, cfg, "disk"));
+
+ cleanup:
+    priv->jobs_queued--;
+    return -1;
 }
 
 /*
@@ -10050,6 +10847,40 @@ qemuDomainObjEndJob(virQEMUDriverPtr driver, virDomainObjPtr obj)
     virCondBroadcast(&priv->job.cond);
 }
 
+void
+qemuDomainObjEndSharedQueryJob(virDomainObjPtr obj)
+{
+    qemuDomainObjPrivatePtr priv = obj->privateData;
+
+    priv->jobs_queued--;
+    priv->job.nsharedQueries--;
+
+    VIR_DEBUG("Stopping shared query job (vm=%p name=%s shared=%u)",
+              obj, obj->def->name, priv->job.nsharedQueries);
+
+    if (priv->job.nsharedQueries == 0)
+        virCondBroadcast(&priv->job.cond);
+}
+
+void
+qemuDomainObjEndDiskJob(virQEMUDriverPtr driver,
+                        virDomainObjPtr obj,
+                        virDomainDiskDefPtr disk)
+{
+    qemuDomainObjPrivatePtr priv = obj->privateData;
+
+    priv->jobs_queued--;
+    priv->job.ndiskJobs--;
+    QEMU_DOMAIN_DISK_PRIVATE(disk)->diskJob = false;
+
+    VIR_DEBUG("Stopping disk job (vm=%p name=%s disk=%s disk jobs=%u)",
+              obj, obj->def->name, disk->dst, priv->job.ndiskJobs);
+
+    qemuDomainObjSaveStatus(driver, obj);
+    /* Wake up both exclusive jobs and disk jobs waiting for @disk */
+    virCondBroadcast(&priv->job.cond);
+}
+
 void
 qemuDomainObjEndAgentJob(virDomainObjPtr obj)
 {
@@ -10096,6 +10927,7 @@ qemuDomainObjAbortAsyncJob(virDomainObjPtr obj)
 
     priv->job.abortJob = true;
     virDomainObjBroadcast(obj);
+    qemuMigrationSchedCancel(priv->driver->migrationSched, obj);
 }
 
 /*
@@ -10128,7 +10960,9 @@ qemuDomainObjEnterMonitorInternal(virQEMUDriverPtr driver,
     } else if (priv->job.asyncOwner == virThreadSelfID()) {
         VIR_WARN("This thread seems to be the async job owner; entering"
                  " monitor without asking for a nested job is dangerous");
-    } else if (priv->job.owner != virThreadSelfID()) {
+    } else if (priv->job.owner != virThreadSelfID() &&
+               priv->job.nsharedQueries == 0 &&
+               priv->job.ndiskJobs == 0) {
         VIR_WARN("Entering a monitor without owning a job. "
                  "Job %s owner %s (%llu)",
                  qemuDomainJobTypeToString(priv->job.active),
@@ -10353,17 +11187,35 @@ qemuDomainDefFormatBufInternal(virQEMUDriverPtr driver,
 {
     int ret = -1;
     virDomainDefPtr copy = NULL;
+    virDomainDefPtr shallow = NULL;
 
     virCheckFlags(VIR_DOMAIN_XML_COMMON_FLAGS | VIR_DOMAIN_XML_UPDATE_CPU, -1);
 
     if (!(flags & (VIR_DOMAIN_XML_UPDATE_CPU | VIR_DOMAIN_XML_MIGRATABLE)))
         goto format;
 
-    if (!(copy = virDomainDefCopy(def, driver->xmlopt, qemuCaps,
-                                  flags & VIR_DOMAIN_XML_MIGRATABLE)))
-        goto cleanup;
+    if (!(flags & VIR_DOMAIN_XML_MIGRATABLE) &&
+        ((flags & VIR_DOMAIN_XML_INACTIVE) || def->id == -1)) {
+        /* Only the guest CPU is going to be changed and there is no live
+         * state which the XML round trip of a full copy would drop, so the
+         * rest of the definition can be shared with @def. */
+        if (!def->cpu ||
+            (def->cpu->mode == VIR_CPU_MODE_CUSTOM && !def->cpu->model))
+            goto format;
+
+        shallow = g_new0(virDomainDef, 1);
+        *shallow = *def;
+        if (!(shallow->cpu = virCPUDefCopy(def->cpu)))
+            goto cleanup;
 
-    def = copy;
+        def = shallow;
+    } else {
+        if (!(copy = virDomainDefCopy(def, driver->xmlopt, qemuCaps,
+                                      flags & VIR_DOMAIN_XML_MIGRATABLE)))
+            goto cleanup;
+
+        def = copy;
+    }
 
     /* Update guest CPU requirements according to host CPU */
     if ((flags & VIR_DOMAIN_XML_UPDATE_CPU) &&
@@ -10530,6 +11382,10 @@ qemuDomainDefFormatBufInternal(virQEMUDriverPtr driver,
                                      virDomainDefFormatConvertXMLFlags(flags));
 
  cleanup:
+    if (shallow) {
+        virCPUDefFree(shallow->cpu);
+        VIR_FREE(shallow);
+    }
     virDomainDefFree(copy);
     return ret;
 }
@@ -13714,8 +14570,11 @@ qemuDomainRefreshVcpuInfo(virQEMUDriverPtr driver,
         vcpu = virDomainDefGetVcpu(vm->def, i);
         vcpupriv = QEMU_DOMAIN_VCPU_PRIVATE(vcpu);
 
-        if (validTIDs)
+        if (validTIDs) {
+            /* Thread IDs can be reused, never trust files opened before */
+            qemuDomainVcpuPrivateCloseFiles(vcpupriv);
             vcpupriv->tid = info[i].tid;
+        }
 
         vcpupriv->socket_id = info[i].socket_id;
         vcpupriv->core_id = info[i].core_id;
@@ -15378,11 +16237,10 @@ qemuDomainNamespaceAvailable(qemuDomainNamespace ns G_GNUC_UNUSED)
 }
 
 
-struct qemuDomainAttachDeviceMknodData {
-    virQEMUDriverPtr driver;
-    virDomainObjPtr vm;
-    const char *file;
-    const char *target;
+struct qemuDomainAttachDeviceMknodItem {
+    char *file;
+    char *target;
+    bool bindMounted;
     GStatBuf sb;
     void *acl;
 #ifdef WITH_SELINUX
@@ -15390,14 +16248,50 @@ struct qemuDomainAttachDeviceMknodData {
 #endif
 };
 
+/*
+ * All the nodes to create in the namespace of @vm. They are collected
+ * first and then created at once so that the namespace is entered only
+ * once however many paths a device needs.
+ */
+struct qemuDomainAttachDeviceMknodData {
+    virQEMUDriverPtr driver;
+    virDomainObjPtr vm;
+    size_t nitems;
+    struct qemuDomainAttachDeviceMknodItem *items;
+};
+
 
 /* Our way of creating devices is highly linux specific */
 #if defined(__linux__)
+static void
+qemuDomainAttachDeviceMknodItemClear(struct qemuDomainAttachDeviceMknodItem *item)
+{
+    if (item->bindMounted)
+        umount(item->target);
+# ifdef WITH_SELINUX
+    freecon(item->tcon);
+# endif
+    virFileFreeACLs(&item->acl);
+    VIR_FREE(item->file);
+    VIR_FREE(item->target);
+}
+
+
+static void
+qemuDomainAttachDeviceMknodDataClear(struct qemuDomainAttachDeviceMknodData *data)
+{
+    size_t i;
+
+    for (i = 0; i < data->nitems; i++)
+        qemuDomainAttachDeviceMknodItemClear(&data->items[i]);
+    VIR_FREE(data->items);
+    data->nitems = 0;
+}
+
+
 static int
-qemuDomainAttachDeviceMknodHelper(pid_t pid G_GNUC_UNUSED,
-                                  void *opaque)
+qemuDomainAttachDeviceMknodOne(struct qemuDomainAttachDeviceMknodItem *data)
 {
-    struct qemuDomainAttachDeviceMknodData *data = opaque;
     int ret = -1;
     bool delDevice = false;
     bool isLink = S_ISLNK(data->sb.st_mode);
@@ -15405,8 +16299,6 @@ qemuDomainAttachDeviceMknodHelper(pid_t pid G_GNUC_UNUSED,
     bool isReg = S_ISREG(data->sb.st_mode) || S_ISFIFO(data->sb.st_mode) || S_ISSOCK(data->sb.st_mode);
     bool isDir = S_ISDIR(data->sb.st_mode);
 
-    qemuSecurityPostFork(data->driver->securityManager);
-
     if (virFileMakeParentPath(data->file) < 0) {
         virReportSystemError(errno,
                              _("Unable to create %s"), data->file);
@@ -15524,26 +16416,39 @@ qemuDomainAttachDeviceMknodHelper(pid_t pid G_GNUC_UNUSED,
         else
             unlink(data->file);
     }
-# ifdef WITH_SELINUX
-    freecon(data->tcon);
-# endif
-    virFileFreeACLs(&data->acl);
     return ret;
 }
 
 
 static int
-qemuDomainAttachDeviceMknodRecursive(virQEMUDriverPtr driver,
-                                     virDomainObjPtr vm,
+qemuDomainAttachDeviceMknodHelper(pid_t pid G_GNUC_UNUSED,
+                                  void *opaque)
+{
+    struct qemuDomainAttachDeviceMknodData *data = opaque;
+    size_t i;
+
+    qemuSecurityPostFork(data->driver->securityManager);
+
+    for (i = 0; i < data->nitems; i++) {
+        if (qemuDomainAttachDeviceMknodOne(&data->items[i]) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+qemuDomainAttachDeviceMknodRecursive(struct qemuDomainAttachDeviceMknodData *data,
                                      const char *file,
                                      char * const *devMountsPath,
                                      size_t ndevMountsPath,
                                      unsigned int ttl)
 {
     g_autoptr(virQEMUDriverConfig) cfg = NULL;
-    struct qemuDomainAttachDeviceMknodData data;
+    struct qemuDomainAttachDeviceMknodItem item;
     int ret = -1;
-    g_autofree char *target = NULL;
+    g_autofree char *next = NULL;
     bool isLink;
     bool isReg;
     bool isDir;
@@ -15555,58 +16460,57 @@ qemuDomainAttachDeviceMknodRecursive(virQEMUDriverPtr driver,
         return ret;
     }
 
-    memset(&data, 0, sizeof(data));
-
-    data.driver = driver;
-    data.vm = vm;
-    data.file = file;
+    memset(&item, 0, sizeof(item));
 
-    if (g_lstat(file, &data.sb) < 0) {
+    if (g_lstat(file, &item.sb) < 0) {
         virReportSystemError(errno,
                              _("Unable to access %s"), file);
         return ret;
     }
 
-    isLink = S_ISLNK(data.sb.st_mode);
-    isReg = S_ISREG(data.sb.st_mode) || S_ISFIFO(data.sb.st_mode) || S_ISSOCK(data.sb.st_mode);
-    isDir = S_ISDIR(data.sb.st_mode);
+    item.file = g_strdup(file);
+
+    isLink = S_ISLNK(item.sb.st_mode);
+    isReg = S_ISREG(item.sb.st_mode) || S_ISFIFO(item.sb.st_mode) || S_ISSOCK(item.sb.st_mode);
+    isDir = S_ISDIR(item.sb.st_mode);
 
     if ((isReg || isDir) && STRPREFIX(file, QEMU_DEVPREFIX)) {
-        cfg = virQEMUDriverGetConfig(driver);
-        if (!(target = qemuDomainGetPreservedMountPath(cfg, vm, file)))
+        cfg = virQEMUDriverGetConfig(data->driver);
+        if (!(item.target = qemuDomainGetPreservedMountPath(cfg, data->vm, file)))
             goto cleanup;
 
-        if (virFileBindMountDevice(file, target) < 0)
+        if (virFileBindMountDevice(file, item.target) < 0)
             goto cleanup;
 
-        data.target = target;
+        /* Only regular files are unmounted once moved into the namespace */
+        item.bindMounted = isReg;
     } else if (isLink) {
         g_autoptr(GError) gerr = NULL;
 
-        if (!(target = g_file_read_link(file, &gerr))) {
+        if (!(item.target = g_file_read_link(file, &gerr))) {
             virReportError(VIR_ERR_SYSTEM_ERROR,
                            _("failed to resolve symlink %s: %s"), file, gerr->message);
-            return ret;
+            goto cleanup;
         }
 
-        if (!g_path_is_absolute(target)) {
+        if (!g_path_is_absolute(item.target)) {
             g_autofree char *fileTmp = g_strdup(file);
             char *c = NULL, *tmp = NULL;
 
             if ((c = strrchr(fileTmp, '/')))
                 *(c + 1) = '\0';
 
-            tmp = g_strdup_printf("%s%s", fileTmp, target);
-            VIR_FREE(target);
-            target = g_steal_pointer(&tmp);
+            tmp = g_strdup_printf("%s%s", fileTmp, item.target);
+            VIR_FREE(item.target);
+            item.target = g_steal_pointer(&tmp);
         }
 
-        data.target = target;
+        next = g_strdup(item.target);
     }
 
     /* Symlinks don't have ACLs. */
     if (!isLink &&
-        virFileGetACLs(file, &data.acl) < 0 &&
+        virFileGetACLs(file, &item.acl) < 0 &&
         errno != ENOTSUP) {
         virReportSystemError(errno,
                              _("Unable to get ACLs on %s"), file);
@@ -15614,7 +16518,7 @@ qemuDomainAttachDeviceMknodRecursive(virQEMUDriverPtr driver,
     }
 
 # ifdef WITH_SELINUX
-    if (lgetfilecon_raw(file, &data.tcon) < 0 &&
+    if (lgetfilecon_raw(file, &item.tcon) < 0 &&
         (errno != ENOTSUP && errno != ENODATA)) {
         virReportSystemError(errno,
                              _("Unable to get SELinux label from %s"), file);
@@ -15633,46 +16537,63 @@ qemuDomainAttachDeviceMknodRecursive(virQEMUDriverPtr driver,
         }
 
         if (i == ndevMountsPath) {
-            if (qemuSecurityPreFork(driver->securityManager) < 0)
+            if (VIR_APPEND_ELEMENT(data->items, data->nitems, item) < 0)
                 goto cleanup;
-
-            if (virProcessRunInMountNamespace(vm->pid,
-                                              qemuDomainAttachDeviceMknodHelper,
-                                              &data) < 0) {
-                qemuSecurityPostFork(driver->securityManager);
-                goto cleanup;
-            }
-            qemuSecurityPostFork(driver->securityManager);
         } else {
             VIR_DEBUG("Skipping dev %s because of %s mount point",
                       file, devMountsPath[i]);
         }
     }
 
-    if (isLink &&
-        qemuDomainAttachDeviceMknodRecursive(driver, vm, target,
+    if (next &&
+        qemuDomainAttachDeviceMknodRecursive(data, next,
                                              devMountsPath, ndevMountsPath,
                                              ttl -1) < 0)
         goto cleanup;
 
     ret = 0;
  cleanup:
-# ifdef WITH_SELINUX
-    freecon(data.tcon);
-# endif
-    virFileFreeACLs(&data.acl);
-    if (isReg && target)
-        umount(target);
+    qemuDomainAttachDeviceMknodItemClear(&item);
     return ret;
 }
 
 
+static int
+qemuDomainAttachDeviceMknodRun(struct qemuDomainAttachDeviceMknodData *data)
+{
+    virQEMUDriverPtr driver = data->driver;
+
+    if (!data->nitems)
+        return 0;
+
+    if (qemuSecurityPreFork(driver->securityManager) < 0)
+        return -1;
+
+    if (virProcessRunInMountNamespace(data->vm->pid,
+                                      qemuDomainAttachDeviceMknodHelper,
+                                      data) < 0) {
+        qemuSecurityPostFork(driver->securityManager);
+        return -1;
+    }
+    qemuSecurityPostFork(driver->securityManager);
+
+    return 0;
+}
+
+
 #else /* !defined(__linux__) */
 
 
+static void
+qemuDomainAttachDeviceMknodDataClear(struct qemuDomainAttachDeviceMknodData *data)
+{
+    VIR_FREE(data->items);
+    data->nitems = 0;
+}
+
+
 static int
-qemuDomainAttachDeviceMknodRecursive(virQEMUDriverPtr driver G_GNUC_UNUSED,
-                                     virDomainObjPtr vm G_GNUC_UNUSED,
+qemuDomainAttachDeviceMknodRecursive(struct qemuDomainAttachDeviceMknodData *data G_GNUC_UNUSED,
                                      const char *file G_GNUC_UNUSED,
                                      char * const *devMountsPath G_GNUC_UNUSED,
                                      size_t ndevMountsPath G_GNUC_UNUSED,
@@ -15684,19 +16605,25 @@ qemuDomainAttachDeviceMknodRecursive(virQEMUDriverPtr driver G_GNUC_UNUSED,
 }
 
 
+static int
+qemuDomainAttachDeviceMknodRun(struct qemuDomainAttachDeviceMknodData *data G_GNUC_UNUSED)
+{
+    return 0;
+}
+
+
 #endif /* !defined(__linux__) */
 
 
 static int
-qemuDomainAttachDeviceMknod(virQEMUDriverPtr driver,
-                            virDomainObjPtr vm,
+qemuDomainAttachDeviceMknod(struct qemuDomainAttachDeviceMknodData *data,
                             const char *file,
                             char * const *devMountsPath,
                             size_t ndevMountsPath)
 {
     long symloop_max = sysconf(_SC_SYMLOOP_MAX);
 
-    return qemuDomainAttachDeviceMknodRecursive(driver, vm, file,
+    return qemuDomainAttachDeviceMknodRecursive(data, file,
                                                 devMountsPath, ndevMountsPath,
                                                 symloop_max);
 }
@@ -15706,45 +16633,40 @@ static int
 qemuDomainDetachDeviceUnlinkHelper(pid_t pid G_GNUC_UNUSED,
                                    void *opaque)
 {
-    const char *path = opaque;
+    const char **paths = opaque;
+    size_t i;
 
-    VIR_DEBUG("Unlinking %s", path);
-    if (unlink(path) < 0 && errno != ENOENT) {
-        virReportSystemError(errno,
-                             _("Unable to remove device %s"), path);
-        return -1;
+    for (i = 0; paths[i]; i++) {
+        VIR_DEBUG("Unlinking %s", paths[i]);
+        if (unlink(paths[i]) < 0 && errno != ENOENT) {
+            virReportSystemError(errno,
+                                 _("Unable to remove device %s"), paths[i]);
+            return -1;
+        }
     }
 
     return 0;
 }
 
 
-static int
-qemuDomainDetachDeviceUnlink(virQEMUDriverPtr driver G_GNUC_UNUSED,
-                             virDomainObjPtr vm,
-                             const char *file,
-                             char * const *devMountsPath,
-                             size_t ndevMountsPath)
+static bool
+qemuDomainDetachDeviceNeedUnlink(const char *file,
+                                 char * const *devMountsPath,
+                                 size_t ndevMountsPath)
 {
     size_t i;
 
-    if (STRPREFIX(file, QEMU_DEVPREFIX)) {
-        for (i = 0; i < ndevMountsPath; i++) {
-            if (STREQ(devMountsPath[i], "/dev"))
-                continue;
-            if (STRPREFIX(file, devMountsPath[i]))
-                break;
-        }
+    if (!STRPREFIX(file, QEMU_DEVPREFIX))
+        return false;
 
-        if (i == ndevMountsPath) {
-            if (virProcessRunInMountNamespace(vm->pid,
-                                              qemuDomainDetachDeviceUnlinkHelper,
-                                              (void *)file) < 0)
-                return -1;
-        }
+    for (i = 0; i < ndevMountsPath; i++) {
+        if (STREQ(devMountsPath[i], "/dev"))
+            continue;
+        if (STRPREFIX(file, devMountsPath[i]))
+            return false;
     }
 
-    return 0;
+    return true;
 }
 
 
@@ -15756,6 +16678,7 @@ qemuDomainNamespaceMknodPaths(virDomainObjPtr vm,
     qemuDomainObjPrivatePtr priv = vm->privateData;
     virQEMUDriverPtr driver = priv->driver;
     g_autoptr(virQEMUDriverConfig) cfg = NULL;
+    struct qemuDomainAttachDeviceMknodData data = { .driver = driver, .vm = vm };
     char **devMountsPath = NULL;
     size_t ndevMountsPath = 0;
     int ret = -1;
@@ -15772,15 +16695,18 @@ qemuDomainNamespaceMknodPaths(virDomainObjPtr vm,
         goto cleanup;
 
     for (i = 0; i < npaths; i++) {
-        if (qemuDomainAttachDeviceMknod(driver,
-                                        vm,
+        if (qemuDomainAttachDeviceMknod(&data,
                                         paths[i],
                                         devMountsPath, ndevMountsPath) < 0)
             goto cleanup;
     }
 
+    if (qemuDomainAttachDeviceMknodRun(&data) < 0)
+        goto cleanup;
+
     ret = 0;
  cleanup:
+    qemuDomainAttachDeviceMknodDataClear(&data);
     virStringListFreeCount(devMountsPath, ndevMountsPath);
     return ret;
 }
@@ -15804,6 +16730,7 @@ qemuDomainNamespaceUnlinkPaths(virDomainObjPtr vm,
     qemuDomainObjPrivatePtr priv = vm->privateData;
     virQEMUDriverPtr driver = priv->driver;
     g_autoptr(virQEMUDriverConfig) cfg = NULL;
+    VIR_AUTOSTRINGLIST unlinkPaths = NULL;
     char **devMountsPath = NULL;
     size_t ndevMountsPath = 0;
     size_t i;
@@ -15821,11 +16748,18 @@ qemuDomainNamespaceUnlinkPaths(virDomainObjPtr vm,
         goto cleanup;
 
     for (i = 0; i < npaths; i++) {
-        if (qemuDomainDetachDeviceUnlink(driver, vm, paths[i],
-                                         devMountsPath, ndevMountsPath) < 0)
+        if (qemuDomainDetachDeviceNeedUnlink(paths[i],
+                                             devMountsPath, ndevMountsPath) &&
+            virStringListAdd(&unlinkPaths, paths[i]) < 0)
             goto cleanup;
     }
 
+    if (unlinkPaths &&
+        virProcessRunInMountNamespace(vm->pid,
+                                      qemuDomainDetachDeviceUnlinkHelper,
+                                      unlinkPaths) < 0)
+        goto cleanup;
+
     ret = 0;
  cleanup:
     virStringListFreeCount(devMountsPath, ndevMountsPath);
@@ -16775,6 +17709,7 @@ qemuProcessEventFree(struct qemuProcessEvent *event)
         virObjectUnref(event->data);
         break;
     case QEMU_PROCESS_EVENT_PR_DISCONNECT:
+    case QEMU_PROCESS_EVENT_BLOCK_JOB_PROGRESS:
     case QEMU_PROCESS_EVENT_LAST:
         break;
     }
@@ -34,6 +34,7 @@
 #include "qemu_conf.h"
 #include "qemu_capabilities.h"
 #include "qemu_migration_params.h"
+#include "qemu_migration_tunnel.h"
 #include "qemu_slirp.h"
 #include "virmdev.h"
 #include "virchrdev.h"
@@ -133,6 +134,40 @@ typedef enum {
 } qemuDomainJobStatsType;
 
 
+/* Phases of starting, migrating and backing up a domain whose duration
+ * is measured */
+typedef enum {
+    QEMU_DOMAIN_JOB_TIMING_INIT,
+    QEMU_DOMAIN_JOB_TIMING_PREPARE_DOMAIN,
+    QEMU_DOMAIN_JOB_TIMING_PREPARE_HOST,
+    QEMU_DOMAIN_JOB_TIMING_EXT_DEVICES,
+    QEMU_DOMAIN_JOB_TIMING_COMMAND_LINE,
+    QEMU_DOMAIN_JOB_TIMING_EXEC,
+    QEMU_DOMAIN_JOB_TIMING_CGROUP,
+    QEMU_DOMAIN_JOB_TIMING_SECURITY,
+    QEMU_DOMAIN_JOB_TIMING_MONITOR,
+    QEMU_DOMAIN_JOB_TIMING_QMP_INIT,
+    QEMU_DOMAIN_JOB_TIMING_DEVICES,
+    QEMU_DOMAIN_JOB_TIMING_FINISH,
+    QEMU_DOMAIN_JOB_TIMING_MIGRATION_SETUP,
+    QEMU_DOMAIN_JOB_TIMING_MIGRATION_TRANSFER,
+    QEMU_DOMAIN_JOB_TIMING_BACKUP_BITMAPS,
+    QEMU_DOMAIN_JOB_TIMING_BACKUP_STORAGE,
+    QEMU_DOMAIN_JOB_TIMING_BACKUP_TRANSACTION,
+    QEMU_DOMAIN_JOB_TIMING_MIGRATION_QUEUE,
+    /* Time spent by the helpers of each kind of external device to start,
+     * added up over all of them. They are started in parallel within the
+     * ext_devices phase, so the sum may exceed it. */
+    QEMU_DOMAIN_JOB_TIMING_EXT_VHOST_USER_GPU,
+    QEMU_DOMAIN_JOB_TIMING_EXT_TPM,
+    QEMU_DOMAIN_JOB_TIMING_EXT_SLIRP,
+    QEMU_DOMAIN_JOB_TIMING_EXT_VIRTIOFS,
+
+    QEMU_DOMAIN_JOB_TIMING_LAST
+} qemuDomainJobTiming;
+VIR_ENUM_DECL(qemuDomainJobTiming);
+
+
 typedef struct _qemuDomainMirrorStats qemuDomainMirrorStats;
 typedef qemuDomainMirrorStats *qemuDomainMirrorStatsPtr;
 struct _qemuDomainMirrorStats {
@@ -175,6 +210,11 @@ struct _qemuDomainJobInfo {
         qemuDomainBackupStats backup;
     } stats;
     qemuDomainMirrorStats mirrorStats;
+    /* Microseconds spent in each phase, see qemuDomainJobTimingRecord */
+    unsigned long long timing[QEMU_DOMAIN_JOB_TIMING_LAST];
+    /* MiB/s an outgoing migration is limited to by the host wide
+     * migration bandwidth, 0 if that does not limit it */
+    unsigned long bandwidthShare;
 };
 
 typedef struct _qemuDomainJobObj qemuDomainJobObj;
@@ -188,6 +228,14 @@ struct _qemuDomainJobObj {
     const char *ownerAPI;               /* The API which owns the job */
     unsigned long long started;         /* When the current job started */
 
+    /* The following members are for shared query jobs */
+    unsigned int nsharedQueries;        /* Number of shared query jobs running */
+    unsigned int nexclusiveWaiters;     /* Number of threads waiting for
+                                           an exclusive job */
+
+    /* The following members are for disk jobs */
+    unsigned int ndiskJobs;             /* Number of disk jobs running */
+
     /* The following members are for QEMU_AGENT_JOB_* */
     qemuDomainAgentJob agentActive;     /* Currently running agent job */
     unsigned long long agentOwner;      /* Thread id which set current agent job */
@@ -213,6 +261,8 @@ struct _qemuDomainJobObj {
 
     qemuMigrationParamsPtr migParams;
     unsigned long apiFlags; /* flags passed to the API which started the async job */
+    unsigned long long timingStart; /* monotonic time the current phase started,
+                                     * 0 unless the phases are being timed */
 };
 
 typedef void (*qemuDomainCleanupCallback)(virQEMUDriverPtr driver,
@@ -220,7 +270,14 @@ typedef void (*qemuDomainCleanupCallback)(virQEMUDriverPtr driver,
 
 #define QEMU_DOMAIN_MASTER_KEY_LEN 32  /* 32 bytes for 256 bit random key */
 
+/* How long qemuDomainSaveStatusDelayed may hold back writing the
+ * status XML, in milliseconds */
+#define QEMU_DOMAIN_SAVE_STATUS_DELAY 1000
+
 void qemuDomainSaveStatus(virDomainObjPtr obj);
+void qemuDomainSaveStatusDelayed(virDomainObjPtr obj);
+int qemuDomainSaveStatusFlush(virDomainObjPtr obj,
+                              void *opaque);
 void qemuDomainSaveConfig(virDomainObjPtr obj);
 
 
@@ -293,6 +350,37 @@ struct _qemuDomainSecretInfo {
     } s;
 };
 
+/* Cached output of one bulk stats group */
+typedef struct _qemuDomainStatsCacheEntry qemuDomainStatsCacheEntry;
+typedef qemuDomainStatsCacheEntry *qemuDomainStatsCacheEntryPtr;
+struct _qemuDomainStatsCacheEntry {
+    virTypedParameterPtr params;
+    int nparams;
+    unsigned long long timestamp; /* when @params were collected, 0 if unset */
+    bool backing;                 /* @params include backing chain */
+};
+
+void qemuDomainStatsCacheClear(qemuDomainStatsCacheEntryPtr cache,
+                               size_t ncache);
+
+/* Guest memory statistics as last read from the balloon driver */
+typedef struct _qemuDomainMemoryStatsCache qemuDomainMemoryStatsCache;
+typedef qemuDomainMemoryStatsCache *qemuDomainMemoryStatsCachePtr;
+struct _qemuDomainMemoryStatsCache {
+    virDomainMemoryStatStruct stats[VIR_DOMAIN_MEMORY_STAT_NR];
+    int nstats;                /* 0 if unset */
+    unsigned long long expiry; /* when the guest updates @stats next, in
+                                * seconds since the Epoch */
+};
+
+int qemuDomainMemoryStatsCacheGet(virDomainObjPtr vm,
+                                  virDomainMemoryStatPtr stats,
+                                  unsigned int nr_stats);
+void qemuDomainMemoryStatsCacheUpdate(virDomainObjPtr vm,
+                                      const virDomainMemoryStatStruct *stats,
+                                      int nstats);
+void qemuDomainMemoryStatsCacheClear(virDomainObjPtr vm);
+
 typedef struct _qemuDomainObjPrivate qemuDomainObjPrivate;
 typedef qemuDomainObjPrivate *qemuDomainObjPrivatePtr;
 struct _qemuDomainObjPrivate {
@@ -316,6 +404,10 @@ struct _qemuDomainObjPrivate {
     bool beingDestroyed;
     char *pidfile;
 
+    /* Address sets of the running domain. They are built once when the
+     * domain is started or reconnected to, from the addresses stored in
+     * the (status) XML, and then kept up to date by hotplug through
+     * qemuDomainEnsurePCIAddress and qemuDomainReleaseDeviceAddress. */
     virDomainPCIAddressSetPtr pciaddrs;
     virDomainUSBAddressSetPtr usbaddrs;
 
@@ -332,6 +424,8 @@ struct _qemuDomainObjPrivate {
     char *origname;
     int nbdPort; /* Port used for migration with NBD */
     unsigned short migrationPort;
+    /* Reassembles incoming tunnelled migration striped over several streams */
+    qemuMigrationTunnelStripesPtr migTunnelStripes;
     int preMigrationState;
 
     virChrdevsPtr devs;
@@ -410,10 +504,15 @@ struct _qemuDomainObjPrivate {
 
     /* running block jobs */
     virHashTablePtr blockjobs;
+    /* a QEMU_PROCESS_EVENT_BLOCK_JOB_PROGRESS is queued */
+    bool blockJobProgressPending;
 
     virHashTablePtr dbusVMStates;
     bool disableSlirp;
 
+    /* checksums of the last screenshots keyed by screen ID */
+    virHashTablePtr screenshots;
+
     /* Until we add full support for backing chains for pflash drives, these
      * pointers hold the temporary virStorageSources for creating the -blockdev
      * commandline for pflash drives. */
@@ -422,6 +521,16 @@ struct _qemuDomainObjPrivate {
 
     /* running backup job */
     virDomainBackupDefPtr backup;
+
+    /* cached bulk stats, one entry per stats group worker */
+    qemuDomainStatsCacheEntryPtr statsCache;
+    size_t nstatsCache;
+
+    /* guest statistics of the memory balloon */
+    qemuDomainMemoryStatsCache memoryStats;
+
+    /* timeout of a pending qemuDomainSaveStatusDelayed */
+    GSource *saveStatusSource;
 };
 
 #define QEMU_DOMAIN_PRIVATE(vm) \
@@ -441,6 +550,7 @@ struct _qemuDomainDiskPrivate {
     qemuBlockJobDataPtr blockjob;
 
     bool migrating; /* the disk is being migrated */
+    bool diskJob; /* a disk job operates on the disk */
     virStorageSourcePtr migrSource; /* disk source object used for NBD migration */
 
     /* information about the device */
@@ -477,6 +587,8 @@ struct _qemuDomainVcpuPrivate {
     virObject parent;
 
     pid_t tid; /* vcpu thread id */
+    int statfd; /* /proc files of @tid kept open for statistics, */
+    int schedfd; /* see qemuDomainVcpuPrivateCloseFiles */
     int enable_id; /* order in which the vcpus were enabled in qemu */
     int qemu_id; /* ID reported by qemu as 'CPU' in query-cpus */
     char *alias;
@@ -591,6 +703,7 @@ typedef enum {
     QEMU_PROCESS_EVENT_PR_DISCONNECT,
     QEMU_PROCESS_EVENT_RDMA_GID_STATUS_CHANGED,
     QEMU_PROCESS_EVENT_GUEST_CRASHLOADED,
+    QEMU_PROCESS_EVENT_BLOCK_JOB_PROGRESS,
 
     QEMU_PROCESS_EVENT_LAST
 } qemuProcessEventType;
@@ -662,6 +775,11 @@ int qemuDomainObjBeginAgentJob(virQEMUDriverPtr driver,
                                virDomainObjPtr obj,
                                qemuDomainAgentJob agentJob)
     G_GNUC_WARN_UNUSED_RESULT;
+int qemuDomainObjBeginAgentJobTimeout(virQEMUDriverPtr driver,
+                                      virDomainObjPtr obj,
+                                      qemuDomainAgentJob agentJob,
+                                      unsigned long long timeout)
+    G_GNUC_WARN_UNUSED_RESULT;
 int qemuDomainObjBeginAsyncJob(virQEMUDriverPtr driver,
                                virDomainObjPtr obj,
                                qemuDomainAsyncJob asyncJob,
@@ -676,10 +794,34 @@ int qemuDomainObjBeginJobNowait(virQEMUDriverPtr driver,
                                 virDomainObjPtr obj,
                                 qemuDomainJob job)
     G_GNUC_WARN_UNUSED_RESULT;
+int qemuDomainObjBeginJobTimeout(virQEMUDriverPtr driver,
+                                 virDomainObjPtr obj,
+                                 qemuDomainJob job,
+                                 unsigned long long timeout)
+    G_GNUC_WARN_UNUSED_RESULT;
+int qemuDomainObjBeginSharedQueryJob(virQEMUDriverPtr driver,
+                                     virDomainObjPtr obj)
+    G_GNUC_WARN_UNUSED_RESULT;
+int qemuDomainObjBeginSharedQueryJobNowait(virQEMUDriverPtr driver,
+                                           virDomainObjPtr obj)
+    G_GNUC_WARN_UNUSED_RESULT;
+int qemuDomainObjBeginSharedQueryJobTimeout(virQEMUDriverPtr driver,
+                                            virDomainObjPtr obj,
+                                            unsigned long long timeout)
+    G_GNUC_WARN_UNUSED_RESULT;
+int qemuDomainObjBeginDiskJob(virQEMUDriverPtr driver,
+                              virDomainObjPtr obj,
+                              const char *path,
+                              virDomainDiskDefPtr *disk)
+    G_GNUC_WARN_UNUSED_RESULT;
 
 void qemuDomainObjEndJob(virQEMUDriverPtr driver,
                          virDomainObjPtr obj);
 void qemuDomainObjEndAgentJob(virDomainObjPtr obj);
+void qemuDomainObjEndSharedQueryJob(virDomainObjPtr obj);
+void qemuDomainObjEndDiskJob(virQEMUDriverPtr driver,
+                             virDomainObjPtr obj,
+                             virDomainDiskDefPtr disk);
 void qemuDomainObjEndAsyncJob(virQEMUDriverPtr driver,
                               virDomainObjPtr obj);
 void qemuDomainObjAbortAsyncJob(virDomainObjPtr obj);
@@ -950,6 +1092,13 @@ bool qemuDomainAgentAvailable(virDomainObjPtr vm,
 
 int qemuDomainJobInfoUpdateTime(qemuDomainJobInfoPtr jobInfo)
     ATTRIBUTE_NONNULL(1);
+void qemuDomainJobTimingStart(virDomainObjPtr vm);
+void qemuDomainJobTimingRecord(virDomainObjPtr vm,
+                               qemuDomainJobTiming phase);
+void qemuDomainJobTimingAdd(virDomainObjPtr vm,
+                            qemuDomainJobTiming phase,
+                            unsigned long long usecs);
+void qemuDomainJobTimingStop(virDomainObjPtr vm);
 int qemuDomainJobInfoUpdateDowntime(qemuDomainJobInfoPtr jobInfo)
     ATTRIBUTE_NONNULL(1);
 int qemuDomainJobInfoToInfo(qemuDomainJobInfoPtr jobInfo,
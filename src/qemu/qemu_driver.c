@@ -104,6 +104,7 @@
 #include "virenum.h"
 #include "virdomaincheckpointobjlist.h"
 #include "virsocket.h"
+#include "virtunable.h"
 #include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_QEMU
@@ -136,6 +137,15 @@ VIR_LOG_INIT("qemu.qemu_driver");
 
 static void qemuProcessEventHandler(void *data, void *opaque);
 
+static void qemuDomainGetStatsJobFunc(void *jobdata, void *opaque);
+static void qemuDomainStatsCacheTimer(int timer, void *opaque);
+static void qemuBlockJobProgressTimer(int timer, void *opaque);
+static int qemuDomainGetGuestInfoRecord(virQEMUDriverPtr driver,
+                                        virConnectPtr conn,
+                                        virDomainObjPtr vm,
+                                        unsigned int types,
+                                        virDomainStatsRecordPtr *record);
+
 static int qemuStateCleanup(void);
 
 static int qemuDomainObjStart(virConnectPtr conn,
@@ -371,11 +381,12 @@ qemuSecurityInit(virQEMUDriverPtr driver)
 }
 
 
-static int
-qemuDomainSnapshotLoad(virDomainObjPtr vm,
-                       void *data)
+/* Called with @opaque locked the first time vm->snapshots are used */
+static void
+qemuDomainSnapshotLoad(void *opaque)
 {
-    char *baseDir = (char *)data;
+    virDomainObjPtr vm = opaque;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(qemu_driver);
     g_autofree char *snapDir = NULL;
     DIR *dir = NULL;
     struct dirent *entry;
@@ -386,15 +397,12 @@ qemuDomainSnapshotLoad(virDomainObjPtr vm,
     unsigned int flags = (VIR_DOMAIN_SNAPSHOT_PARSE_REDEFINE |
                           VIR_DOMAIN_SNAPSHOT_PARSE_DISKS |
                           VIR_DOMAIN_SNAPSHOT_PARSE_INTERNAL);
-    int ret = -1;
     int direrr;
     qemuDomainObjPrivatePtr priv;
 
-    virObjectLock(vm);
-
     priv = vm->privateData;
 
-    if (!(snapDir = g_strdup_printf("%s/%s", baseDir, vm->def->name))) {
+    if (!(snapDir = g_strdup_printf("%s/%s", cfg->snapshotDir, vm->def->name))) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Failed to allocate memory for "
                        "snapshot directory for domain %s"),
@@ -473,21 +481,17 @@ qemuDomainSnapshotLoad(virDomainObjPtr vm,
      * pretty important in our metadata.
      */
 
-    virResetLastError();
-
-    ret = 0;
  cleanup:
     VIR_DIR_CLOSE(dir);
-    virObjectUnlock(vm);
-    return ret;
 }
 
 
-static int
-qemuDomainCheckpointLoad(virDomainObjPtr vm,
-                         void *data)
+/* Called with @opaque locked the first time vm->checkpoints are used */
+static void
+qemuDomainCheckpointLoad(void *opaque)
 {
-    char *baseDir = (char *)data;
+    virDomainObjPtr vm = opaque;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(qemu_driver);
     g_autofree char *chkDir = NULL;
     DIR *dir = NULL;
     struct dirent *entry;
@@ -495,14 +499,12 @@ qemuDomainCheckpointLoad(virDomainObjPtr vm,
     virDomainMomentObjPtr chk = NULL;
     virDomainMomentObjPtr current = NULL;
     unsigned int flags = VIR_DOMAIN_CHECKPOINT_PARSE_REDEFINE;
-    int ret = -1;
     int direrr;
     qemuDomainObjPrivatePtr priv;
 
-    virObjectLock(vm);
     priv = vm->privateData;
 
-    if (!(chkDir = g_strdup_printf("%s/%s", baseDir, vm->def->name))) {
+    if (!(chkDir = g_strdup_printf("%s/%s", cfg->checkpointDir, vm->def->name))) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Failed to allocate memory for "
                        "checkpoint directory for domain %s"),
@@ -573,13 +575,25 @@ qemuDomainCheckpointLoad(virDomainObjPtr vm,
      * metadata is consistent with existing qcow2 bitmaps, but a user
      * that changes things behind our backs deserves what happens. */
 
-    virResetLastError();
-
-    ret = 0;
  cleanup:
     VIR_DIR_CLOSE(dir);
+}
+
+
+/* Defer parsing the snapshot and checkpoint metadata of @vm until it
+ * is actually needed, so that daemon startup does not have to pay for
+ * the moments of every single domain. */
+static int
+qemuDomainMomentsSetLoader(virDomainObjPtr vm,
+                           void *data G_GNUC_UNUSED)
+{
+    virObjectLock(vm);
+    virDomainSnapshotObjListSetLoader(vm->snapshots,
+                                      qemuDomainSnapshotLoad, vm);
+    virDomainCheckpointObjListSetLoader(vm->checkpoints,
+                                        qemuDomainCheckpointLoad, vm);
     virObjectUnlock(vm);
-    return ret;
+    return 0;
 }
 
 
@@ -625,6 +639,24 @@ qemuDomainFindMaxID(virDomainObjPtr vm,
 }
 
 
+static void
+qemuStateCapsWarmup(void *opaque)
+{
+    virQEMUDriverPtr driver = opaque;
+    g_autoptr(virCaps) caps = NULL;
+
+    virQEMUCapsCacheProbeAll(driver->qemuCapsCache, &driver->capsWarmupQuit);
+
+    /* With every binary probed already this is cheap */
+    if (!g_atomic_int_get(&driver->capsWarmupQuit) &&
+        !(caps = virQEMUDriverGetCapabilities(driver, false))) {
+        VIR_WARN("Failed to build QEMU capabilities: %s",
+                 virGetLastErrorMessage());
+        virResetLastError();
+    }
+}
+
+
 /**
  * qemuStateInitialize:
  *
@@ -650,6 +682,8 @@ qemuStateInitialize(bool privileged,
         return VIR_DRV_STATE_INIT_ERROR;
 
     qemu_driver->lockFD = -1;
+    qemu_driver->statsCacheTimer = -1;
+    qemu_driver->blockJobProgressTimer = -1;
 
     if (virMutexInit(&qemu_driver->lock) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -658,6 +692,14 @@ qemuStateInitialize(bool privileged,
         return VIR_DRV_STATE_INIT_ERROR;
     }
 
+    if (virMutexInit(&qemu_driver->netStatsLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        virMutexDestroy(&qemu_driver->lock);
+        VIR_FREE(qemu_driver);
+        return VIR_DRV_STATE_INIT_ERROR;
+    }
+
     qemu_driver->inhibitCallback = callback;
     qemu_driver->inhibitOpaque = opaque;
 
@@ -808,6 +850,10 @@ qemuStateInitialize(bool privileged,
     if (qemuMigrationDstErrorInit(qemu_driver) < 0)
         goto error;
 
+    if (!(qemu_driver->migrationSched = qemuMigrationSchedNew(cfg->migrationMaxJobs,
+                                                              cfg->migrationBandwidth)))
+        goto error;
+
     if (privileged) {
         g_autofree char *channeldir = NULL;
 
@@ -902,6 +948,16 @@ qemuStateInitialize(bool privileged,
     if (!qemu_driver->qemuCapsCache)
         goto error;
 
+    if (virTunableRegisterFileCache("qemu.capabilities-cache",
+                                    qemu_driver->qemuCapsCache) < 0)
+        goto error;
+
+    /* Rather than have each session daemon probe every binary and keep
+     * its own copy of the results, use what the system daemon cached */
+    if (!privileged && !root)
+        virFileCacheSetSharedDir(qemu_driver->qemuCapsCache,
+                                 LOCALSTATEDIR "/cache/libvirt/qemu/capabilities");
+
     if (!(sec_managers = qemuSecurityGetNested(qemu_driver->securityManager)))
         goto error;
 
@@ -983,27 +1039,52 @@ qemuStateInitialize(bool privileged,
 
     virDomainObjListForEach(qemu_driver->domains,
                             false,
-                            qemuDomainSnapshotLoad,
-                            cfg->snapshotDir);
-
-    virDomainObjListForEach(qemu_driver->domains,
-                            false,
-                            qemuDomainCheckpointLoad,
-                            cfg->checkpointDir);
+                            qemuDomainMomentsSetLoader,
+                            NULL);
 
     virDomainObjListForEach(qemu_driver->domains,
                             false,
                             qemuDomainManagedSaveLoad,
                             qemu_driver);
 
+    if (cfg->eventThreads > 0)
+        qemu_driver->eventThreads = virEventThreadPoolNew("qemu-io",
+                                                          cfg->eventThreads);
+
     /* must be initialized before trying to reconnect to all the
      * running domains since there might occur some QEMU monitor
      * events that will be dispatched to the worker pool */
     qemu_driver->workerPool = virThreadPoolNewFull(0, 1, 0, qemuProcessEventHandler,
-                                                   "qemu-event", qemu_driver);
+                                                   "qemu-event", qemu_driver, 0);
     if (!qemu_driver->workerPool)
         goto error;
 
+    if (cfg->statsMaxWorkers > 0 &&
+        !(qemu_driver->statsPool = virThreadPoolNewFull(0, cfg->statsMaxWorkers,
+                                                        0, qemuDomainGetStatsJobFunc,
+                                                        "qemu-stats", qemu_driver,
+                                                        VIR_THREAD_POOL_WORK_STEALING)))
+        goto error;
+
+    if (qemu_driver->statsPool &&
+        virTunableRegisterThreadPool("qemu.stats-workers",
+                                     qemu_driver->statsPool) < 0)
+        goto error;
+
+    if (qemu_driver->statsPool &&
+        cfg->statsCacheMaxAge > 0 &&
+        cfg->statsCacheRefreshInterval > 0 &&
+        (qemu_driver->statsCacheTimer = virEventAddTimeout(cfg->statsCacheRefreshInterval,
+                                                           qemuDomainStatsCacheTimer,
+                                                           qemu_driver, NULL)) < 0)
+        goto error;
+
+    if (cfg->blockJobProgressInterval > 0 &&
+        (qemu_driver->blockJobProgressTimer = virEventAddTimeout(cfg->blockJobProgressInterval,
+                                                                 qemuBlockJobProgressTimer,
+                                                                 qemu_driver, NULL)) < 0)
+        goto error;
+
     qemuProcessReconnectAll(qemu_driver);
 
     if (virDriverShouldAutostart(cfg->stateDir, &autostart) < 0)
@@ -1012,6 +1093,16 @@ qemuStateInitialize(bool privileged,
     if (autostart)
         qemuAutostartDomains(qemu_driver);
 
+    /* Anything needed so far was probed on demand, get the rest of the
+     * binaries ready without holding up the daemon */
+    if (virThreadCreateFull(&qemu_driver->capsWarmupThread, true,
+                            qemuStateCapsWarmup, "qemu-caps-warmup",
+                            false, qemu_driver) < 0) {
+        VIR_WARN("Unable to start probing QEMU capabilities in the background");
+    } else {
+        qemu_driver->capsWarmupStarted = true;
+    }
+
     return VIR_DRV_STATE_INIT_COMPLETE;
 
  error:
@@ -1113,6 +1204,28 @@ qemuStateStop(void)
     return ret;
 }
 
+
+/*
+ * qemuStateGetReconnectInfo:
+ *
+ * Report how far reconnecting to the domains which were running
+ * when the daemon started got.
+ */
+static int
+qemuStateGetReconnectInfo(unsigned int *total,
+                          unsigned int *done,
+                          unsigned int *failed)
+{
+    if (!qemu_driver)
+        return -1;
+
+    *total = g_atomic_int_get(&qemu_driver->reconnectTotal);
+    *done = g_atomic_int_get(&qemu_driver->reconnectDone);
+    *failed = g_atomic_int_get(&qemu_driver->reconnectFailed);
+
+    return 0;
+}
+
 /**
  * qemuStateCleanup:
  *
@@ -1124,7 +1237,24 @@ qemuStateCleanup(void)
     if (!qemu_driver)
         return -1;
 
+    virTunableUnregister("qemu.capabilities-cache");
+    virTunableUnregister("qemu.stats-workers");
+    virTunableUnregister("qemu.reconnect-workers");
+
+    /* Reconnects still in progress need most of the driver */
+    virThreadPoolFree(qemu_driver->reconnectPool);
+
+    if (qemu_driver->capsWarmupStarted) {
+        g_atomic_int_set(&qemu_driver->capsWarmupQuit, 1);
+        virThreadJoin(&qemu_driver->capsWarmupThread);
+    }
+
+    /* Write out status changes whose save was delayed */
+    virDomainObjListForEach(qemu_driver->domains, false,
+                            qemuDomainSaveStatusFlush, NULL);
+
     virObjectUnref(qemu_driver->migrationErrors);
+    qemuMigrationSchedFree(qemu_driver->migrationSched);
     virObjectUnref(qemu_driver->closeCallbacks);
     virLockManagerPluginUnref(qemu_driver->lockManager);
     virSysinfoDefFree(qemu_driver->hostsysinfo);
@@ -1140,15 +1270,26 @@ qemuStateCleanup(void)
     virCPUDefFree(qemu_driver->hostcpu);
     virCapabilitiesHostNUMAUnref(qemu_driver->hostnuma);
     virObjectUnref(qemu_driver->caps);
+    VIR_FREE(qemu_driver->capsKey);
+    VIR_FREE(qemu_driver->capsXML);
     ebtablesContextFree(qemu_driver->ebtables);
     VIR_FREE(qemu_driver->qemuImgBinary);
     virObjectUnref(qemu_driver->domains);
+    virEventThreadPoolFree(qemu_driver->eventThreads);
     virThreadPoolFree(qemu_driver->workerPool);
+    if (qemu_driver->statsCacheTimer != -1)
+        virEventRemoveTimeout(qemu_driver->statsCacheTimer);
+    if (qemu_driver->blockJobProgressTimer != -1)
+        virEventRemoveTimeout(qemu_driver->blockJobProgressTimer);
+    virThreadPoolFree(qemu_driver->statsPool);
 
     if (qemu_driver->lockFD != -1)
         virPidFileRelease(qemu_driver->config->stateDir, "driver", qemu_driver->lockFD);
 
     virObjectUnref(qemu_driver->config);
+    virHashFree(qemu_driver->netStatsTap);
+    virHashFree(qemu_driver->netStatsOVS);
+    virMutexDestroy(&qemu_driver->netStatsLock);
     virMutexDestroy(&qemu_driver->lock);
     VIR_FREE(qemu_driver);
 
@@ -1245,6 +1386,7 @@ qemuConnectSupportsFeature(virConnectPtr conn, int feature)
     case VIR_DRV_FEATURE_XML_MIGRATABLE:
     case VIR_DRV_FEATURE_MIGRATION_OFFLINE:
     case VIR_DRV_FEATURE_MIGRATION_PARAMS:
+    case VIR_DRV_FEATURE_MIGRATION_TUNNEL_STRIPES:
         return 1;
     case VIR_DRV_FEATURE_MIGRATION_DIRECT:
     case VIR_DRV_FEATURE_MIGRATION_V1:
@@ -1252,6 +1394,9 @@ qemuConnectSupportsFeature(virConnectPtr conn, int feature)
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_CHUNKS:
+    case VIR_DRV_FEATURE_REMOTE_COMPRESSION:
+    case VIR_DRV_FEATURE_REMOTE_PACKED_TYPED_PARAMS:
     default:
         return 0;
     }
@@ -1328,49 +1473,89 @@ qemuConnectGetMaxVcpus(virConnectPtr conn G_GNUC_UNUSED, const char *type)
 
 static char *qemuConnectGetCapabilities(virConnectPtr conn) {
     virQEMUDriverPtr driver = conn->privateData;
-    g_autoptr(virCaps) caps = NULL;
 
     if (virConnectGetCapabilitiesEnsureACL(conn) < 0)
         return NULL;
 
-    if (!(caps = virQEMUDriverGetCapabilities(driver, true)))
-        return NULL;
+    return virQEMUDriverGetCapabilitiesXML(driver);
+}
+
+
+/*
+ * Reads the whole file @name of process @pid, or of its thread @tid if
+ * it's not zero. If @fd is not NULL, the file is kept open in it and
+ * reused by subsequent calls, which saves a lookup in /proc every time
+ * statistics of the same thread are collected.
+ *
+ * Returns 0 on success, 1 if the file does not exist and -1 on error
+ * with errno set.
+ */
+static int
+qemuReadProcFile(int *fd,
+                 pid_t pid,
+                 pid_t tid,
+                 const char *name,
+                 int maxlen,
+                 char **data)
+{
+    int localfd = -1;
+    int *fdp = fd ? fd : &localfd;
+    int ret = -1;
 
-    return virCapabilitiesFormatXML(caps);
+    if (*fdp < 0) {
+        g_autofree char *proc = NULL;
+
+        /* In general, we cannot assume pid_t fits in int; but /proc parsing
+         * is specific to Linux where int works fine.  */
+        if (tid)
+            proc = g_strdup_printf("/proc/%d/task/%d/%s", (int)pid, (int)tid, name);
+        else
+            proc = g_strdup_printf("/proc/%d/%s", (int)pid, name);
+
+        if ((*fdp = open(proc, O_RDONLY | O_CLOEXEC)) < 0)
+            return errno == ENOENT ? 1 : -1;
+    }
+
+    if (lseek(*fdp, 0, SEEK_SET) < 0 ||
+        virFileReadLimFD(*fdp, maxlen, data) < 0) {
+        int saved_errno = errno;
+        VIR_FORCE_CLOSE(*fdp);
+        errno = saved_errno;
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FORCE_CLOSE(localfd);
+    return ret;
 }
 
 
 static int
 qemuGetSchedInfo(unsigned long long *cpuWait,
-                 pid_t pid, pid_t tid)
+                 pid_t pid, pid_t tid, int *fd)
 {
-    g_autofree char *proc = NULL;
     g_autofree char *data = NULL;
     char **lines = NULL;
     size_t i;
     int ret = -1;
+    int rc;
     double val;
 
     *cpuWait = 0;
 
-    /* In general, we cannot assume pid_t fits in int; but /proc parsing
-     * is specific to Linux where int works fine.  */
-    if (tid)
-        proc = g_strdup_printf("/proc/%d/task/%d/sched", (int)pid, (int)tid);
-    else
-        proc = g_strdup_printf("/proc/%d/sched", (int)pid);
-    if (!proc)
-        goto cleanup;
-    ret = -1;
-
     /* The file is not guaranteed to exist (needs CONFIG_SCHED_DEBUG) */
-    if (access(proc, R_OK) < 0) {
-        ret = 0;
+    if ((rc = qemuReadProcFile(fd, pid, tid, "sched", (1<<16), &data)) < 0) {
+        virReportSystemError(errno,
+                             _("Failed to read sched info of %d/%d"),
+                             (int)pid, (int)tid);
         goto cleanup;
     }
 
-    if (virFileReadAll(proc, (1<<16), &data) < 0)
+    if (rc > 0) {
+        ret = 0;
         goto cleanup;
+    }
 
     lines = virStringSplit(data, "\n", 0);
     if (!lines)
@@ -1416,29 +1601,17 @@ qemuGetSchedInfo(unsigned long long *cpuWait,
 
 static int
 qemuGetProcessInfo(unsigned long long *cpuTime, int *lastCpu, long *vm_rss,
-                   pid_t pid, int tid)
+                   pid_t pid, int tid, int *fd)
 {
-    g_autofree char *proc = NULL;
-    FILE *pidinfo;
+    g_autofree char *data = NULL;
     unsigned long long usertime = 0, systime = 0;
     long rss = 0;
     int cpu = 0;
 
-    /* In general, we cannot assume pid_t fits in int; but /proc parsing
-     * is specific to Linux where int works fine.  */
-    if (tid)
-        proc = g_strdup_printf("/proc/%d/task/%d/stat", (int)pid, tid);
-    else
-        proc = g_strdup_printf("/proc/%d/stat", (int)pid);
-    if (!proc)
-        return -1;
-
-    pidinfo = fopen(proc, "r");
-
     /* See 'man proc' for information about what all these fields are. We're
      * only interested in a very few of them */
-    if (!pidinfo ||
-        fscanf(pidinfo,
+    if (qemuReadProcFile(fd, pid, tid, "stat", 4096, &data) != 0 ||
+        sscanf(data,
                /* pid -> stime */
                "%*d (%*[^)]) %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu"
                /* cutime -> endcode */
@@ -1467,8 +1640,6 @@ qemuGetProcessInfo(unsigned long long *cpuTime, int *lastCpu, long *vm_rss,
     VIR_DEBUG("Got status for %d/%d user=%llu sys=%llu cpu=%d rss=%ld",
               (int)pid, tid, usertime, systime, cpu, rss);
 
-    VIR_FORCE_FCLOSE(pidinfo);
-
     return 0;
 }
 
@@ -1501,6 +1672,7 @@ qemuDomainHelperGetVcpus(virDomainObjPtr vm,
 
     for (i = 0; i < virDomainDefGetVcpusMax(vm->def) && ncpuinfo < maxinfo; i++) {
         virDomainVcpuDefPtr vcpu = virDomainDefGetVcpu(vm->def, i);
+        qemuDomainVcpuPrivatePtr vcpupriv = QEMU_DOMAIN_VCPU_PRIVATE(vcpu);
         pid_t vcpupid = qemuDomainGetVcpuPid(vm, i);
         virVcpuInfoPtr vcpuinfo = info + ncpuinfo;
 
@@ -1513,7 +1685,7 @@ qemuDomainHelperGetVcpus(virDomainObjPtr vm,
 
             if (qemuGetProcessInfo(&vcpuinfo->cpuTime,
                                    &vcpuinfo->cpu, NULL,
-                                   vm->pid, vcpupid) < 0) {
+                                   vm->pid, vcpupid, &vcpupriv->statfd) < 0) {
                 virReportSystemError(errno, "%s",
                                      _("cannot get vCPU placement & pCPU time"));
                 return -1;
@@ -1532,7 +1704,8 @@ qemuDomainHelperGetVcpus(virDomainObjPtr vm,
         }
 
         if (cpuwait) {
-            if (qemuGetSchedInfo(&(cpuwait[ncpuinfo]), vm->pid, vcpupid) < 0)
+            if (qemuGetSchedInfo(&(cpuwait[ncpuinfo]), vm->pid, vcpupid,
+                                 &vcpupriv->schedfd) < 0)
                 return -1;
         }
 
@@ -1679,16 +1852,11 @@ static int qemuConnectGetVersion(virConnectPtr conn, unsigned long *version)
 {
     virQEMUDriverPtr driver = conn->privateData;
     unsigned int qemuVersion = 0;
-    g_autoptr(virCaps) caps = NULL;
 
     if (virConnectGetVersionEnsureACL(conn) < 0)
         return -1;
 
-    if (!(caps = virQEMUDriverGetCapabilities(driver, false)))
-        return -1;
-
-    if (virQEMUCapsGetDefaultVersion(caps,
-                                     driver->qemuCapsCache,
+    if (virQEMUCapsGetDefaultVersion(driver->qemuCapsCache,
                                      &qemuVersion) < 0)
         return -1;
 
@@ -2524,6 +2692,7 @@ static int qemuDomainSetMemoryStatsPeriod(virDomainPtr dom, int period,
         }
 
         def->memballoon->period = period;
+        qemuDomainMemoryStatsCacheClear(vm);
         if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
             goto endjob;
     }
@@ -2680,7 +2849,7 @@ qemuDomainGetInfo(virDomainPtr dom,
     }
 
     if (virDomainObjIsActive(vm)) {
-        if (qemuGetProcessInfo(&(info->cpuTime), NULL, NULL, vm->pid, 0) < 0) {
+        if (qemuGetProcessInfo(&(info->cpuTime), NULL, NULL, vm->pid, 0, NULL) < 0) {
             virReportError(VIR_ERR_OPERATION_FAILED, "%s",
                            _("cannot read cputime for domain"));
             goto cleanup;
@@ -2802,6 +2971,7 @@ typedef enum {
      */
     QEMU_SAVE_FORMAT_XZ = 3,
     QEMU_SAVE_FORMAT_LZOP = 4,
+    QEMU_SAVE_FORMAT_ZSTD = 5,
     /* Note: add new members only at the end.
        These values are used in the on-disk format.
        Do not change or re-use numbers. */
@@ -2817,8 +2987,15 @@ VIR_ENUM_IMPL(qemuSaveCompression,
               "bzip2",
               "xz",
               "lzop",
+              "zstd",
 );
 
+/* pzstd cuts the image into independently compressed zstd frames, which
+ * can be decompressed on several cores too. Its output is still a valid
+ * zstd stream, so it is used for both directions whenever it's available
+ * and the image can be restored with plain zstd otherwise. */
+#define QEMU_SAVE_ZSTD_PARALLEL "pzstd"
+
 VIR_ENUM_DECL(qemuDumpFormat);
 VIR_ENUM_IMPL(qemuDumpFormat,
               VIR_DOMAIN_CORE_DUMP_FORMAT_LAST,
@@ -3020,6 +3197,13 @@ qemuCompressGetCommand(virQEMUSaveFormat compression)
         return NULL;
     }
 
+    if (compression == QEMU_SAVE_FORMAT_ZSTD) {
+        g_autofree char *parallel = virFindFileInPath(QEMU_SAVE_ZSTD_PARALLEL);
+
+        if (parallel)
+            prog = QEMU_SAVE_ZSTD_PARALLEL;
+    }
+
     ret = virCommandNew(prog);
     virCommandAddArg(ret, "-dc");
 
@@ -3469,6 +3653,16 @@ qemuGetCompressionProgram(const char *imageFormat,
     if (ret == QEMU_SAVE_FORMAT_RAW)
         return QEMU_SAVE_FORMAT_RAW;
 
+    if (ret == QEMU_SAVE_FORMAT_ZSTD) {
+        g_autofree char *parallel = virFindFileInPath(QEMU_SAVE_ZSTD_PARALLEL);
+
+        if (parallel) {
+            *compressor = virCommandNew(parallel);
+            virCommandAddArg(*compressor, "-c");
+            return ret;
+        }
+    }
+
     if (!(prog = virFindFileInPath(imageFormat)))
         goto error;
 
@@ -3476,6 +3670,8 @@ qemuGetCompressionProgram(const char *imageFormat,
     virCommandAddArg(*compressor, "-c");
     if (ret == QEMU_SAVE_FORMAT_XZ)
         virCommandAddArg(*compressor, "-3");
+    else if (ret == QEMU_SAVE_FORMAT_ZSTD)
+        virCommandAddArg(*compressor, "-T0");
 
     return ret;
 
@@ -3798,6 +3994,7 @@ doCoreDump(virQEMUDriverPtr driver,
            unsigned int dump_flags,
            unsigned int dumpformat)
 {
+    qemuDomainObjPrivatePtr priv = vm->privateData;
     int fd = -1;
     int ret = -1;
     virFileWrapperFdPtr wrapperFd = NULL;
@@ -3833,8 +4030,16 @@ doCoreDump(virQEMUDriverPtr driver,
                              NULL)) < 0)
         goto cleanup;
 
-    if (!(wrapperFd = virFileWrapperFdNew(&fd, path, flags)))
-        goto cleanup;
+    /* A detached dump-guest-memory writes from a thread of its own, so
+     * blocking I/O on the file can't stall QEMU and there's no need to
+     * copy the whole guest memory through iohelper, unless it's needed
+     * for O_DIRECT. */
+    if (!(dump_flags & VIR_DUMP_MEMORY_ONLY) ||
+        (dump_flags & VIR_DUMP_BYPASS_CACHE) ||
+        !virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_DUMP_COMPLETED)) {
+        if (!(wrapperFd = virFileWrapperFdNew(&fd, path, flags)))
+            goto cleanup;
+    }
 
     if (dump_flags & VIR_DUMP_MEMORY_ONLY) {
         if (!(memory_dump_format = qemuDumpFormatTypeToString(dumpformat))) {
@@ -3866,6 +4071,22 @@ doCoreDump(virQEMUDriverPtr driver,
 
     if (ret < 0)
         goto cleanup;
+    ret = -1;
+
+    /* Flush the file like iohelper would, without holding the domain
+     * lock meanwhile */
+    if (!wrapperFd) {
+        int rc;
+
+        virObjectUnlock(vm);
+        rc = fdatasync(fd);
+        virObjectLock(vm);
+
+        if (rc < 0) {
+            virReportSystemError(errno, _("unable to sync file %s"), path);
+            goto cleanup;
+        }
+    }
 
     if (VIR_CLOSE(fd) < 0) {
         virReportSystemError(errno,
@@ -4001,6 +4222,34 @@ qemuDomainCoreDump(virDomainPtr dom,
 }
 
 
+static char *
+qemuDomainScreenshotChecksum(int fd,
+                             const char *path)
+{
+    g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_autofree char *buf = NULL;
+    size_t bufsize = 64 * 1024;
+    ssize_t got;
+
+    if (lseek(fd, 0, SEEK_SET) < 0) {
+        virReportSystemError(errno, _("unable to seek in %s"), path);
+        return NULL;
+    }
+
+    buf = g_new0(char, bufsize);
+
+    while ((got = saferead(fd, buf, bufsize)) > 0)
+        g_checksum_update(checksum, (const guchar *) buf, got);
+
+    if (got < 0) {
+        virReportSystemError(errno, _("unable to read %s"), path);
+        return NULL;
+    }
+
+    return g_strdup(g_checksum_get_string(checksum));
+}
+
+
 static char *
 qemuDomainScreenshot(virDomainPtr dom,
                      virStreamPtr st,
@@ -4016,9 +4265,10 @@ qemuDomainScreenshot(virDomainPtr dom,
     const char *videoAlias = NULL;
     char *ret = NULL;
     bool unlink_tmp = false;
+    unsigned int screenID = screen;
     g_autoptr(virQEMUDriverConfig) cfg = NULL;
 
-    virCheckFlags(0, NULL);
+    virCheckFlags(VIR_DOMAIN_SCREENSHOT_IF_CHANGED, NULL);
 
     if (!(vm = qemuDomainObjFromDomain(dom)))
         goto cleanup;
@@ -4085,6 +4335,26 @@ qemuDomainScreenshot(virDomainPtr dom,
     if (qemuDomainObjExitMonitor(driver, vm) < 0)
         goto endjob;
 
+    if (flags & VIR_DOMAIN_SCREENSHOT_IF_CHANGED) {
+        g_autofree char *key = g_strdup_printf("%u", screenID);
+        g_autofree char *checksum = NULL;
+
+        if (!(checksum = qemuDomainScreenshotChecksum(tmp_fd, tmp)))
+            goto endjob;
+
+        /* an empty stream tells the caller the image is the same */
+        if (STREQ_NULLABLE(virHashLookup(priv->screenshots, key), checksum)) {
+            if (ftruncate(tmp_fd, 0) < 0) {
+                virReportSystemError(errno, _("unable to truncate %s"), tmp);
+                goto endjob;
+            }
+        } else {
+            if (virHashUpdateEntry(priv->screenshots, key, checksum) < 0)
+                goto endjob;
+            checksum = NULL;
+        }
+    }
+
     if (VIR_CLOSE(tmp_fd) < 0) {
         virReportSystemError(errno, _("unable to close %s"), tmp);
         goto endjob;
@@ -4894,6 +5164,81 @@ processGuestCrashloadedEvent(virQEMUDriverPtr driver,
 }
 
 
+static void
+processBlockJobProgressEvent(virQEMUDriverPtr driver,
+                             virDomainObjPtr vm)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+
+    priv->blockJobProgressPending = false;
+
+    /* Progress is reported periodically, skip this round rather than
+     * waiting for a domain busy with another job */
+    if (qemuDomainObjBeginSharedQueryJobNowait(driver, vm) < 0)
+        return;
+
+    if (virDomainObjIsActive(vm) &&
+        qemuBlockJobEmitProgress(driver, vm) < 0) {
+        VIR_DEBUG("Failed to report block job progress of domain %s: %s",
+                  vm->def->name, virGetLastErrorMessage());
+        virResetLastError();
+    }
+
+    qemuDomainObjEndSharedQueryJob(vm);
+}
+
+
+static int
+qemuBlockJobProgressTimerOne(virDomainObjPtr vm,
+                             void *opaque)
+{
+    virQEMUDriverPtr driver = opaque;
+    qemuDomainObjPrivatePtr priv;
+    struct qemuProcessEvent *processEvent;
+    int ret = 0;
+
+    virObjectLock(vm);
+    priv = vm->privateData;
+
+    if (!virDomainObjIsActive(vm) ||
+        priv->blockJobProgressPending ||
+        virHashSize(priv->blockjobs) == 0)
+        goto cleanup;
+
+    processEvent = g_new0(struct qemuProcessEvent, 1);
+    processEvent->eventType = QEMU_PROCESS_EVENT_BLOCK_JOB_PROGRESS;
+    processEvent->vm = virObjectRef(vm);
+
+    if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+        virObjectUnref(vm);
+        qemuProcessEventFree(processEvent);
+        ret = -1;
+        goto cleanup;
+    }
+
+    priv->blockJobProgressPending = true;
+
+ cleanup:
+    virObjectUnlock(vm);
+    return ret;
+}
+
+
+static void
+qemuBlockJobProgressTimer(int timer G_GNUC_UNUSED,
+                          void *opaque)
+{
+    virQEMUDriverPtr driver = opaque;
+
+    if (virDomainObjListForEach(driver->domains, false,
+                                qemuBlockJobProgressTimerOne, driver) < 0) {
+        VIR_WARN("Failed to schedule block job progress events: %s",
+                 virGetLastErrorMessage());
+        virResetLastError();
+    }
+}
+
+
 static void qemuProcessEventHandler(void *data, void *opaque)
 {
     struct qemuProcessEvent *processEvent = data;
@@ -4943,6 +5288,9 @@ static void qemuProcessEventHandler(void *data, void *opaque)
     case QEMU_PROCESS_EVENT_GUEST_CRASHLOADED:
         processGuestCrashloadedEvent(driver, vm);
         break;
+    case QEMU_PROCESS_EVENT_BLOCK_JOB_PROGRESS:
+        processBlockJobProgressEvent(driver, vm);
+        break;
     case QEMU_PROCESS_EVENT_LAST:
         break;
     }
@@ -6810,6 +7158,13 @@ qemuDomainSaveImageOpen(virQEMUDriverPtr driver,
         }
     }
 
+#if HAVE_POSIX_FADVISE
+    /* The memory image following the header is read sequentially either
+     * by QEMU or by the decompressor, so let the kernel read ahead more */
+    if (!bypass_cache)
+        ignore_value(posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL));
+#endif
+
     /* Create a domain from this XML */
     if (!(def = virDomainDefParseString(data->xml, driver->xmlopt, qemuCaps,
                                         VIR_DOMAIN_DEF_PARSE_INACTIVE |
@@ -7334,6 +7689,29 @@ qemuDomainObjRestore(virConnectPtr conn,
 }
 
 
+/* Formats the XML of @vm as virDomainGetXMLDesc would. The caller has
+ * to hold the lock on @vm. */
+static char *
+qemuDomainObjGetXMLDesc(virQEMUDriverPtr driver,
+                        virDomainObjPtr vm,
+                        unsigned int flags)
+{
+    qemuDomainUpdateCurrentMemorySize(vm);
+
+    if ((flags & VIR_DOMAIN_XML_MIGRATABLE))
+        flags |= QEMU_DOMAIN_FORMAT_LIVE_FLAGS;
+
+    /* The CPU is already updated in the domain's live definition, we need to
+     * ignore the VIR_DOMAIN_XML_UPDATE_CPU flag.
+     */
+    if (virDomainObjIsActive(vm) &&
+        !(flags & VIR_DOMAIN_XML_INACTIVE))
+        flags &= ~VIR_DOMAIN_XML_UPDATE_CPU;
+
+    return qemuDomainFormatXML(driver, vm, flags);
+}
+
+
 static char
 *qemuDomainGetXMLDesc(virDomainPtr dom,
                       unsigned int flags)
@@ -7351,19 +7729,7 @@ static char
     if (virDomainGetXMLDescEnsureACL(dom->conn, vm->def, flags) < 0)
         goto cleanup;
 
-    qemuDomainUpdateCurrentMemorySize(vm);
-
-    if ((flags & VIR_DOMAIN_XML_MIGRATABLE))
-        flags |= QEMU_DOMAIN_FORMAT_LIVE_FLAGS;
-
-    /* The CPU is already updated in the domain's live definition, we need to
-     * ignore the VIR_DOMAIN_XML_UPDATE_CPU flag.
-     */
-    if (virDomainObjIsActive(vm) &&
-        !(flags & VIR_DOMAIN_XML_INACTIVE))
-        flags &= ~VIR_DOMAIN_XML_UPDATE_CPU;
-
-    ret = qemuDomainFormatXML(driver, vm, flags);
+    ret = qemuDomainObjGetXMLDesc(driver, vm, flags);
 
  cleanup:
     virDomainObjEndAPI(&vm);
@@ -8674,18 +9040,27 @@ qemuDomainAttachDeviceLiveAndConfigHomogenize(const virDomainDeviceDef *devConf,
 }
 
 
+/*
+ * Attaches the devices described by @xmls in the given order. Each device
+ * is parsed only after the preceding ones were attached as the address
+ * assignment depends on the devices already present. The status XML and
+ * the persistent config are saved just once for all of them.
+ */
 static int
 qemuDomainAttachDeviceLiveAndConfig(virDomainObjPtr vm,
                                     virQEMUDriverPtr driver,
-                                    const char *xml,
+                                    const char **xmls,
+                                    size_t nxmls,
                                     unsigned int flags)
 {
     qemuDomainObjPrivatePtr priv = vm->privateData;
     virDomainDefPtr vmdef = NULL;
     g_autoptr(virQEMUDriverConfig) cfg = NULL;
     virDomainDeviceDefPtr devConf = NULL;
-    virDomainDeviceDef devConfSave = { 0 };
+    g_autofree virDomainDeviceDef *devConfSave = NULL;
     virDomainDeviceDefPtr devLive = NULL;
+    bool saveStatus = false;
+    size_t i;
     int ret = -1;
     unsigned int parse_flags = VIR_DOMAIN_DEF_PARSE_INACTIVE |
                                VIR_DOMAIN_DEF_PARSE_ABI_UPDATE;
@@ -8694,6 +9069,7 @@ qemuDomainAttachDeviceLiveAndConfig(virDomainObjPtr vm,
                   VIR_DOMAIN_AFFECT_CONFIG, -1);
 
     cfg = virQEMUDriverGetConfig(driver);
+    devConfSave = g_new0(virDomainDeviceDef, nxmls);
 
     /* The config and live post processing address auto-generation algorithms
      * rely on the correct vm->def or vm->newDef being passed, so call the
@@ -8704,58 +9080,75 @@ qemuDomainAttachDeviceLiveAndConfig(virDomainObjPtr vm,
         if (!vmdef)
             goto cleanup;
 
-        if (!(devConf = virDomainDeviceDefParse(xml, vmdef,
-                                                driver->xmlopt, priv->qemuCaps,
-                                                parse_flags)))
-            goto cleanup;
+        for (i = 0; i < nxmls; i++) {
+            if (!(devConf = virDomainDeviceDefParse(xmls[i], vmdef,
+                                                    driver->xmlopt,
+                                                    priv->qemuCaps,
+                                                    parse_flags)))
+                goto cleanup;
 
-        /*
-         * devConf will be NULLed out by
-         * qemuDomainAttachDeviceConfig(), so save it for later use by
-         * qemuDomainAttachDeviceLiveAndConfigHomogenize()
-         */
-        devConfSave = *devConf;
+            /*
+             * devConf will be NULLed out by
+             * qemuDomainAttachDeviceConfig(), so save it for later use by
+             * qemuDomainAttachDeviceLiveAndConfigHomogenize()
+             */
+            devConfSave[i] = *devConf;
 
-        if (virDomainDeviceValidateAliasForHotplug(vm, devConf,
-                                                   VIR_DOMAIN_AFFECT_CONFIG) < 0)
-            goto cleanup;
+            if (virDomainDeviceValidateAliasForHotplug(vm, devConf,
+                                                       VIR_DOMAIN_AFFECT_CONFIG) < 0)
+                goto cleanup;
 
-        if (virDomainDefCompatibleDevice(vmdef, devConf, NULL,
-                                         VIR_DOMAIN_DEVICE_ACTION_ATTACH,
-                                         false) < 0)
-            goto cleanup;
+            if (virDomainDefCompatibleDevice(vmdef, devConf, NULL,
+                                             VIR_DOMAIN_DEVICE_ACTION_ATTACH,
+                                             false) < 0)
+                goto cleanup;
 
-        if (qemuDomainAttachDeviceConfig(vmdef, devConf, priv->qemuCaps,
-                                         parse_flags,
-                                         driver->xmlopt) < 0)
-            goto cleanup;
+            if (qemuDomainAttachDeviceConfig(vmdef, devConf, priv->qemuCaps,
+                                             parse_flags,
+                                             driver->xmlopt) < 0)
+                goto cleanup;
+
+            virDomainDeviceDefFree(devConf);
+            devConf = NULL;
+        }
     }
 
     if (flags & VIR_DOMAIN_AFFECT_LIVE) {
-        if (!(devLive = virDomainDeviceDefParse(xml, vm->def,
-                                                driver->xmlopt, priv->qemuCaps,
-                                                parse_flags)))
-            goto cleanup;
+        for (i = 0; i < nxmls; i++) {
+            if (!(devLive = virDomainDeviceDefParse(xmls[i], vm->def,
+                                                    driver->xmlopt,
+                                                    priv->qemuCaps,
+                                                    parse_flags)))
+                goto cleanup;
 
-        if (flags & VIR_DOMAIN_AFFECT_CONFIG)
-            qemuDomainAttachDeviceLiveAndConfigHomogenize(&devConfSave, devLive);
+            if (flags & VIR_DOMAIN_AFFECT_CONFIG)
+                qemuDomainAttachDeviceLiveAndConfigHomogenize(&devConfSave[i],
+                                                              devLive);
 
-        if (virDomainDeviceValidateAliasForHotplug(vm, devLive,
-                                                   VIR_DOMAIN_AFFECT_LIVE) < 0)
-            goto cleanup;
+            if (virDomainDeviceValidateAliasForHotplug(vm, devLive,
+                                                       VIR_DOMAIN_AFFECT_LIVE) < 0)
+                goto cleanup;
 
-        if (virDomainDefCompatibleDevice(vm->def, devLive, NULL,
-                                         VIR_DOMAIN_DEVICE_ACTION_ATTACH,
-                                         true) < 0)
-            goto cleanup;
+            if (virDomainDefCompatibleDevice(vm->def, devLive, NULL,
+                                             VIR_DOMAIN_DEVICE_ACTION_ATTACH,
+                                             true) < 0)
+                goto cleanup;
 
-        if (qemuDomainAttachDeviceLive(vm, devLive, driver) < 0)
-            goto cleanup;
-        /*
-         * update domain status forcibly because the domain status may be
-         * changed even if we failed to attach the device. For example,
-         * a new controller may be created.
-         */
+            /*
+             * update domain status forcibly because the domain status may be
+             * changed even if we failed to attach the device. For example,
+             * a new controller may be created.
+             */
+            saveStatus = true;
+
+            if (qemuDomainAttachDeviceLive(vm, devLive, driver) < 0)
+                goto cleanup;
+
+            virDomainDeviceDefFree(devLive);
+            devLive = NULL;
+        }
+
+        saveStatus = false;
         if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
             goto cleanup;
     }
@@ -8771,6 +9164,9 @@ qemuDomainAttachDeviceLiveAndConfig(virDomainObjPtr vm,
 
     ret = 0;
  cleanup:
+    if (saveStatus &&
+        virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
+        VIR_WARN("Unable to save status of domain %s", vm->def->name);
     virDomainDefFree(vmdef);
     virDomainDeviceDefFree(devConf);
     virDomainDeviceDefFree(devLive);
@@ -8801,7 +9197,46 @@ qemuDomainAttachDeviceFlags(virDomainPtr dom,
     if (virDomainObjUpdateModificationImpact(vm, &flags) < 0)
         goto endjob;
 
-    if (qemuDomainAttachDeviceLiveAndConfig(vm, driver, xml, flags) < 0)
+    if (qemuDomainAttachDeviceLiveAndConfig(vm, driver, &xml, 1, flags) < 0)
+        goto endjob;
+
+    ret = 0;
+
+ endjob:
+    qemuDomainObjEndJob(driver, vm);
+
+ cleanup:
+    virDomainObjEndAPI(&vm);
+    virNWFilterUnlockFilterUpdates();
+    return ret;
+}
+
+
+static int
+qemuDomainAttachDeviceList(virDomainPtr dom,
+                           const char **xmls,
+                           unsigned int nxmls,
+                           unsigned int flags)
+{
+    virQEMUDriverPtr driver = dom->conn->privateData;
+    virDomainObjPtr vm = NULL;
+    int ret = -1;
+
+    virNWFilterReadLockFilterUpdates();
+
+    if (!(vm = qemuDomainObjFromDomain(dom)))
+        goto cleanup;
+
+    if (virDomainAttachDeviceListEnsureACL(dom->conn, vm->def, flags) < 0)
+        goto cleanup;
+
+    if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_MODIFY) < 0)
+        goto cleanup;
+
+    if (virDomainObjUpdateModificationImpact(vm, &flags) < 0)
+        goto endjob;
+
+    if (qemuDomainAttachDeviceLiveAndConfig(vm, driver, xmls, nxmls, flags) < 0)
         goto endjob;
 
     ret = 0;
@@ -8933,10 +9368,15 @@ static int qemuDomainUpdateDeviceFlags(virDomainPtr dom,
     return ret;
 }
 
+/*
+ * Detaches the devices described by @xmls in the given order, saving the
+ * status XML and the persistent config just once for all of them.
+ */
 static int
 qemuDomainDetachDeviceLiveAndConfig(virQEMUDriverPtr driver,
                                     virDomainObjPtr vm,
-                                    const char *xml,
+                                    const char **xmls,
+                                    size_t nxmls,
                                     unsigned int flags)
 {
     qemuDomainObjPrivatePtr priv = vm->privateData;
@@ -8944,6 +9384,9 @@ qemuDomainDetachDeviceLiveAndConfig(virQEMUDriverPtr driver,
     virDomainDeviceDefPtr dev = NULL, dev_copy = NULL;
     unsigned int parse_flags = VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE;
     virDomainDefPtr vmdef = NULL;
+    bool saveStatus = false;
+    bool updateList = false;
+    size_t i;
     int ret = -1;
 
     virCheckFlags(VIR_DOMAIN_AFFECT_LIVE |
@@ -8955,50 +9398,68 @@ qemuDomainDetachDeviceLiveAndConfig(virQEMUDriverPtr driver,
         !(flags & VIR_DOMAIN_AFFECT_LIVE))
         parse_flags |= VIR_DOMAIN_DEF_PARSE_INACTIVE;
 
-    dev = dev_copy = virDomainDeviceDefParse(xml, vm->def,
-                                             driver->xmlopt, priv->qemuCaps,
-                                             parse_flags);
-    if (dev == NULL)
-        goto cleanup;
-
-    if (flags & VIR_DOMAIN_AFFECT_CONFIG &&
-        flags & VIR_DOMAIN_AFFECT_LIVE) {
-        /* If we are affecting both CONFIG and LIVE
-         * create a deep copy of device as adding
-         * to CONFIG takes one instance.
-         */
-        dev_copy = virDomainDeviceDefCopy(dev, vm->def,
-                                          driver->xmlopt, priv->qemuCaps);
-        if (!dev_copy)
-            goto cleanup;
-    }
-
     if (flags & VIR_DOMAIN_AFFECT_CONFIG) {
         /* Make a copy for updated domain. */
         vmdef = virDomainObjCopyPersistentDef(vm, driver->xmlopt, priv->qemuCaps);
         if (!vmdef)
             goto cleanup;
-
-        if (qemuDomainDetachDeviceConfig(vmdef, dev, priv->qemuCaps,
-                                         parse_flags,
-                                         driver->xmlopt) < 0)
-            goto cleanup;
     }
 
-    if (flags & VIR_DOMAIN_AFFECT_LIVE) {
+    for (i = 0; i < nxmls; i++) {
         int rc;
 
-        if ((rc = qemuDomainDetachDeviceLive(vm, dev_copy, driver, false)) < 0)
+        dev = dev_copy = virDomainDeviceDefParse(xmls[i], vm->def,
+                                                 driver->xmlopt, priv->qemuCaps,
+                                                 parse_flags);
+        if (dev == NULL)
             goto cleanup;
 
-        if (rc == 0 && qemuDomainUpdateDeviceList(driver, vm, QEMU_ASYNC_JOB_NONE) < 0)
+        if (flags & VIR_DOMAIN_AFFECT_CONFIG &&
+            flags & VIR_DOMAIN_AFFECT_LIVE) {
+            /* If we are affecting both CONFIG and LIVE
+             * create a deep copy of device as adding
+             * to CONFIG takes one instance.
+             */
+            dev_copy = virDomainDeviceDefCopy(dev, vm->def,
+                                              driver->xmlopt, priv->qemuCaps);
+            if (!dev_copy)
+                goto cleanup;
+        }
+
+        if (flags & VIR_DOMAIN_AFFECT_CONFIG &&
+            qemuDomainDetachDeviceConfig(vmdef, dev, priv->qemuCaps,
+                                         parse_flags,
+                                         driver->xmlopt) < 0)
             goto cleanup;
 
-        /*
-         * update domain status forcibly because the domain status may be
-         * changed even if we failed to attach the device. For example,
-         * a new controller may be created.
-         */
+        if (flags & VIR_DOMAIN_AFFECT_LIVE) {
+            /*
+             * update domain status forcibly because the domain status may be
+             * changed even if we failed to detach the device.
+             */
+            saveStatus = true;
+
+            if ((rc = qemuDomainDetachDeviceLive(vm, dev_copy, driver, false)) < 0)
+                goto cleanup;
+
+            if (rc == 0)
+                updateList = true;
+        }
+
+        if (dev != dev_copy)
+            virDomainDeviceDefFree(dev_copy);
+        virDomainDeviceDefFree(dev);
+        dev = dev_copy = NULL;
+    }
+
+    if (flags & VIR_DOMAIN_AFFECT_LIVE) {
+        if (updateList) {
+            updateList = false;
+            if (qemuDomainUpdateDeviceList(driver, vm, QEMU_ASYNC_JOB_NONE) < 0)
+                goto cleanup;
+        }
+
+        saveStatus = false;
         if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
             goto cleanup;
     }
@@ -9015,6 +9476,12 @@ qemuDomainDetachDeviceLiveAndConfig(virQEMUDriverPtr driver,
     ret = 0;
 
  cleanup:
+    if (updateList &&
+        qemuDomainUpdateDeviceList(driver, vm, QEMU_ASYNC_JOB_NONE) < 0)
+        VIR_WARN("Unable to refresh device list of domain %s", vm->def->name);
+    if (saveStatus &&
+        virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
+        VIR_WARN("Unable to save status of domain %s", vm->def->name);
     if (dev != dev_copy)
         virDomainDeviceDefFree(dev_copy);
     virDomainDeviceDefFree(dev);
@@ -9113,7 +9580,43 @@ qemuDomainDetachDeviceFlags(virDomainPtr dom,
     if (virDomainObjUpdateModificationImpact(vm, &flags) < 0)
         goto endjob;
 
-    if (qemuDomainDetachDeviceLiveAndConfig(driver, vm, xml, flags) < 0)
+    if (qemuDomainDetachDeviceLiveAndConfig(driver, vm, &xml, 1, flags) < 0)
+        goto endjob;
+
+    ret = 0;
+
+ endjob:
+    qemuDomainObjEndJob(driver, vm);
+
+ cleanup:
+    virDomainObjEndAPI(&vm);
+    return ret;
+}
+
+
+static int
+qemuDomainDetachDeviceList(virDomainPtr dom,
+                           const char **xmls,
+                           unsigned int nxmls,
+                           unsigned int flags)
+{
+    virQEMUDriverPtr driver = dom->conn->privateData;
+    virDomainObjPtr vm = NULL;
+    int ret = -1;
+
+    if (!(vm = qemuDomainObjFromDomain(dom)))
+        goto cleanup;
+
+    if (virDomainDetachDeviceListEnsureACL(dom->conn, vm->def, flags) < 0)
+        goto cleanup;
+
+    if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_MODIFY) < 0)
+        goto cleanup;
+
+    if (virDomainObjUpdateModificationImpact(vm, &flags) < 0)
+        goto endjob;
+
+    if (qemuDomainDetachDeviceLiveAndConfig(driver, vm, xmls, nxmls, flags) < 0)
         goto endjob;
 
     ret = 0;
@@ -11512,19 +12015,32 @@ qemuDomainMemoryStatsInternal(virQEMUDriverPtr driver,
         return -1;
 
     if (virDomainDefHasMemballoon(vm->def)) {
-        qemuDomainObjEnterMonitor(driver, vm);
-        ret = qemuMonitorGetMemoryStats(qemuDomainGetMonitor(vm),
-                                        vm->def->memballoon, stats, nr_stats);
-        if (qemuDomainObjExitMonitor(driver, vm) < 0)
-            ret = -1;
+        if ((ret = qemuDomainMemoryStatsCacheGet(vm, stats, nr_stats)) < 0) {
+            virDomainMemoryStatStruct all[VIR_DOMAIN_MEMORY_STAT_NR];
+
+            qemuDomainObjEnterMonitor(driver, vm);
+            ret = qemuMonitorGetMemoryStats(qemuDomainGetMonitor(vm),
+                                            vm->def->memballoon, all,
+                                            VIR_DOMAIN_MEMORY_STAT_NR);
+            if (qemuDomainObjExitMonitor(driver, vm) < 0)
+                ret = -1;
+
+            if (ret < 0)
+                return ret;
+
+            qemuDomainMemoryStatsCacheUpdate(vm, all, ret);
 
-        if (ret < 0 || ret >= nr_stats)
+            ret = MIN(ret, nr_stats);
+            memcpy(stats, all, sizeof(all[0]) * ret);
+        }
+
+        if (ret >= nr_stats)
             return ret;
     } else {
         ret = 0;
     }
 
-    if (qemuGetProcessInfo(NULL, NULL, &rss, vm->pid, 0) < 0) {
+    if (qemuGetProcessInfo(NULL, NULL, &rss, vm->pid, 0, NULL) < 0) {
         virReportError(VIR_ERR_OPERATION_FAILED, "%s",
                        _("cannot get RSS for domain"));
     } else {
@@ -11715,75 +12231,205 @@ qemuDomainMemoryPeek(virDomainPtr dom,
 }
 
 
-/**
- * @driver: qemu driver data
- * @cfg: driver configuration data
- * @vm: domain object
- * @src: storage source data
- * @ret_fd: pointer to return open'd file descriptor
- * @ret_sb: pointer to return stat buffer (local or remote)
- * @skipInaccessible: Don't report error if files are not accessible
- *
- * For local storage, open the file using qemuOpenFile and then use
- * fstat() to grab the stat struct data for the caller.
- *
- * For remote storage, attempt to access the file and grab the stat
- * struct data if the remote connection supports it.
- *
- * Returns 1 if @src was successfully opened (@ret_fd and @ret_sb is populated),
- * 0 if @src can't be opened and @skipInaccessible is true (no errors are
- * reported) or -1 otherwise (errors are reported).
- */
 static int
-qemuDomainStorageOpenStat(virQEMUDriverPtr driver,
-                          virQEMUDriverConfigPtr cfg,
-                          virDomainObjPtr vm,
-                          virStorageSourcePtr src,
-                          int *ret_fd,
-                          struct stat *ret_sb,
-                          bool skipInaccessible)
+qemuDomainBlockPeekStream(virDomainPtr dom,
+                          virStreamPtr st,
+                          const char *path,
+                          unsigned long long offset,
+                          unsigned long long length,
+                          unsigned int flags)
 {
-    if (virStorageSourceIsLocalStorage(src)) {
-        if (skipInaccessible && !virFileExists(src->path))
-            return 0;
+    virDomainDiskDefPtr disk = NULL;
+    virDomainObjPtr vm;
+    int ret = -1;
 
-        if ((*ret_fd = qemuOpenFile(driver, vm, src->path, O_RDONLY,
-                                    NULL)) < 0)
-            return -1;
+    virCheckFlags(0, -1);
 
-        if (fstat(*ret_fd, ret_sb) < 0) {
-            virReportSystemError(errno, _("cannot stat file '%s'"), src->path);
-            VIR_FORCE_CLOSE(*ret_fd);
-            return -1;
-        }
-    } else {
-        if (skipInaccessible && virStorageFileSupportsBackingChainTraversal(src) <= 0)
-            return 0;
+    if (!(vm = qemuDomainObjFromDomain(dom)))
+        goto cleanup;
 
-        if (virStorageFileInitAs(src, cfg->user, cfg->group) < 0)
-            return -1;
+    if (virDomainBlockPeekStreamEnsureACL(dom->conn, vm->def) < 0)
+        goto cleanup;
 
-        if (virStorageFileStat(src, ret_sb) < 0) {
-            virStorageFileDeinit(src);
-            virReportSystemError(errno, _("failed to stat remote file '%s'"),
-                                 NULLSTR(src->path));
-            return -1;
-        }
+    if (!(disk = qemuDomainDiskByName(vm->def, path)))
+        goto cleanup;
+
+    if (disk->src->format != VIR_STORAGE_FILE_RAW) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
+                       _("peeking is only supported for disk with 'raw' format not '%s'"),
+                       virStorageFileFormatTypeToString(disk->src->format));
+        goto cleanup;
     }
 
-    return 1;
+    if (!virStorageSourceIsLocalStorage(disk->src)) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
+                       _("streaming is not supported for storage type %s "
+                         "(protocol: %s)"),
+                       virStorageTypeToString(disk->src->type),
+                       virStorageNetProtocolTypeToString(disk->src->protocol));
+        goto cleanup;
+    }
+
+    if (virFDStreamOpenBlockDevice(st, disk->src->path, offset, length,
+                                   false, O_RDONLY) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virDomainObjEndAPI(&vm);
+    return ret;
 }
 
 
-/**
- * @src: storage source data
- * @fd: file descriptor to close for local
- *
- * If local, then just close the file descriptor.
- * else remote, then tear down the storage driver backend connection.
- */
-static void
-qemuDomainStorageCloseStat(virStorageSourcePtr src,
+static int
+qemuDomainMemoryPeekStream(virDomainPtr dom,
+                           virStreamPtr st,
+                           unsigned long long offset,
+                           unsigned long long length,
+                           unsigned int flags)
+{
+    virQEMUDriverPtr driver = dom->conn->privateData;
+    virDomainObjPtr vm;
+    g_autofree char *tmp = NULL;
+    int fd = -1, ret = -1;
+    qemuDomainObjPrivatePtr priv;
+    g_autoptr(virQEMUDriverConfig) cfg = NULL;
+    int rc;
+
+    virCheckFlags(VIR_MEMORY_VIRTUAL | VIR_MEMORY_PHYSICAL, -1);
+
+    if (!(vm = qemuDomainObjFromDomain(dom)))
+        goto cleanup;
+
+    cfg = virQEMUDriverGetConfig(driver);
+
+    if (virDomainMemoryPeekStreamEnsureACL(dom->conn, vm->def) < 0)
+        goto cleanup;
+
+    if (flags != VIR_MEMORY_VIRTUAL && flags != VIR_MEMORY_PHYSICAL) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       "%s", _("flags parameter must be VIR_MEMORY_VIRTUAL or VIR_MEMORY_PHYSICAL"));
+        goto cleanup;
+    }
+
+    if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY) < 0)
+        goto cleanup;
+
+    if (virDomainObjCheckActive(vm) < 0)
+        goto endjob;
+
+    tmp = g_strdup_printf("%s/qemu.mem.XXXXXX", cfg->cacheDir);
+
+    if ((fd = g_mkstemp_full(tmp, O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR)) == -1) {
+        virReportSystemError(errno,
+                             _("g_mkstemp(\"%s\") failed"), tmp);
+        goto endjob;
+    }
+
+    qemuSecuritySetSavedStateLabel(driver, vm, tmp);
+
+    /* The whole range is saved by one memsave/pmemsave, the stream then
+     * reads the file, which is unlinked right away so that it's gone
+     * once the stream is closed. */
+    priv = vm->privateData;
+    qemuDomainObjEnterMonitor(driver, vm);
+    if (flags == VIR_MEMORY_VIRTUAL)
+        rc = qemuMonitorSaveVirtualMemory(priv->mon, offset, length, tmp);
+    else
+        rc = qemuMonitorSavePhysicalMemory(priv->mon, offset, length, tmp);
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+        goto endjob;
+
+    if (virFDStreamOpenFile(st, tmp, 0, 0, O_RDONLY) < 0) {
+        virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                       _("unable to open stream"));
+        goto endjob;
+    }
+
+    ret = 0;
+
+ endjob:
+    qemuDomainObjEndJob(driver, vm);
+
+ cleanup:
+    VIR_FORCE_CLOSE(fd);
+    if (tmp)
+        unlink(tmp);
+    virDomainObjEndAPI(&vm);
+    return ret;
+}
+
+
+/**
+ * @driver: qemu driver data
+ * @cfg: driver configuration data
+ * @vm: domain object
+ * @src: storage source data
+ * @ret_fd: pointer to return open'd file descriptor
+ * @ret_sb: pointer to return stat buffer (local or remote)
+ * @skipInaccessible: Don't report error if files are not accessible
+ *
+ * For local storage, open the file using qemuOpenFile and then use
+ * fstat() to grab the stat struct data for the caller.
+ *
+ * For remote storage, attempt to access the file and grab the stat
+ * struct data if the remote connection supports it.
+ *
+ * Returns 1 if @src was successfully opened (@ret_fd and @ret_sb is populated),
+ * 0 if @src can't be opened and @skipInaccessible is true (no errors are
+ * reported) or -1 otherwise (errors are reported).
+ */
+static int
+qemuDomainStorageOpenStat(virQEMUDriverPtr driver,
+                          virQEMUDriverConfigPtr cfg,
+                          virDomainObjPtr vm,
+                          virStorageSourcePtr src,
+                          int *ret_fd,
+                          struct stat *ret_sb,
+                          bool skipInaccessible)
+{
+    if (virStorageSourceIsLocalStorage(src)) {
+        if (skipInaccessible && !virFileExists(src->path))
+            return 0;
+
+        if ((*ret_fd = qemuOpenFile(driver, vm, src->path, O_RDONLY,
+                                    NULL)) < 0)
+            return -1;
+
+        if (fstat(*ret_fd, ret_sb) < 0) {
+            virReportSystemError(errno, _("cannot stat file '%s'"), src->path);
+            VIR_FORCE_CLOSE(*ret_fd);
+            return -1;
+        }
+    } else {
+        if (skipInaccessible && virStorageFileSupportsBackingChainTraversal(src) <= 0)
+            return 0;
+
+        if (virStorageFileInitAs(src, cfg->user, cfg->group) < 0)
+            return -1;
+
+        if (virStorageFileStat(src, ret_sb) < 0) {
+            virStorageFileDeinit(src);
+            virReportSystemError(errno, _("failed to stat remote file '%s'"),
+                                 NULLSTR(src->path));
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * @src: storage source data
+ * @fd: file descriptor to close for local
+ *
+ * If local, then just close the file descriptor.
+ * else remote, then tear down the storage driver backend connection.
+ */
+static void
+qemuDomainStorageCloseStat(virStorageSourcePtr src,
                            int *fd)
 {
     if (virStorageSourceIsLocalStorage(src))
@@ -12649,6 +13295,31 @@ qemuDomainMigratePrepareTunnel3Params(virConnectPtr dconn,
 }
 
 
+static int
+qemuDomainMigratePrepareTunnelStripe(virDomainPtr dom,
+                                     virStreamPtr st,
+                                     unsigned int stripe,
+                                     unsigned int flags)
+{
+    virDomainObjPtr vm;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    if (!(vm = qemuDomainObjFromDomain(dom)))
+        return -1;
+
+    if (virDomainMigratePrepareTunnelStripeEnsureACL(dom->conn, vm->def) < 0)
+        goto cleanup;
+
+    ret = qemuMigrationDstPrepareTunnelStripe(vm, st, stripe);
+
+ cleanup:
+    virDomainObjEndAPI(&vm);
+    return ret;
+}
+
+
 static int
 qemuDomainMigratePerform3(virDomainPtr dom,
                           const char *xmlin,
@@ -17439,15 +18110,12 @@ qemuDomainBlockPullCommon(virDomainObjPtr vm,
         goto cleanup;
     }
 
-    if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_MODIFY) < 0)
+    if (qemuDomainObjBeginDiskJob(driver, vm, path, &disk) < 0)
         goto cleanup;
 
     if (virDomainObjCheckActive(vm) < 0)
         goto endjob;
 
-    if (!(disk = qemuDomainDiskByName(vm->def, path)))
-        goto endjob;
-
     if (qemuDomainDiskBlockJobIsActive(disk))
         goto endjob;
 
@@ -17525,7 +18193,7 @@ qemuDomainBlockPullCommon(virDomainObjPtr vm,
     qemuBlockJobStarted(job, vm);
 
  endjob:
-    qemuDomainObjEndJob(driver, vm);
+    qemuDomainObjEndDiskJob(driver, vm, disk);
 
  cleanup:
     qemuBlockJobStartupFinalize(vm, job);
@@ -17989,15 +18657,12 @@ qemuDomainBlockCopyCommon(virDomainObjPtr vm,
         return -1;
     }
 
-    if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_MODIFY) < 0)
+    if (qemuDomainObjBeginDiskJob(driver, vm, path, &disk) < 0)
         return -1;
 
     if (virDomainObjCheckActive(vm) < 0)
         goto endjob;
 
-    if (!(disk = qemuDomainDiskByName(vm->def, path)))
-        goto endjob;
-
     if (qemuDomainDiskBlockJobIsActive(disk))
         goto endjob;
 
@@ -18091,7 +18756,13 @@ qemuDomainBlockCopyCommon(virDomainObjPtr vm,
      * required so that libvirt can properly label the image for access by qemu */
     if (!existing) {
         if (supports_create) {
-            if (virStorageFileCreate(mirror) < 0) {
+            /* The new image isn't known to anyone else yet and the disk is
+             * protected by the disk job, don't block the domain meanwhile */
+            virObjectUnlock(vm);
+            rc = virStorageFileCreate(mirror);
+            virObjectLock(vm);
+
+            if (rc < 0) {
                 virReportSystemError(errno, "%s", _("failed to create copy target"));
                 goto endjob;
             }
@@ -18246,7 +18917,7 @@ qemuDomainBlockCopyCommon(virDomainObjPtr vm,
     if (need_unlink && virStorageFileUnlink(mirror) < 0)
         VIR_WARN("%s", _("unable to remove just-created copy target"));
     virStorageFileDeinit(mirror);
-    qemuDomainObjEndJob(driver, vm);
+    qemuDomainObjEndDiskJob(driver, vm, disk);
     qemuBlockJobStartupFinalize(vm, job);
 
     return ret;
@@ -18483,7 +19154,7 @@ qemuDomainBlockCommit(virDomainPtr dom,
     if (virDomainBlockCommitEnsureACL(dom->conn, vm->def) < 0)
         goto cleanup;
 
-    if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_MODIFY) < 0)
+    if (qemuDomainObjBeginDiskJob(driver, vm, path, &disk) < 0)
         goto cleanup;
 
     if (virDomainObjCheckActive(vm) < 0)
@@ -18502,9 +19173,6 @@ qemuDomainBlockCommit(virDomainPtr dom,
         speed <<= 20;
     }
 
-    if (!(disk = qemuDomainDiskByName(vm->def, path)))
-        goto endjob;
-
     if (virStorageSourceIsEmpty(disk->src)) {
         virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                        _("disk %s has no source file to be committed"),
@@ -18730,7 +19398,7 @@ qemuDomainBlockCommit(virDomainPtr dom,
         virErrorRestore(&orig_err);
     }
     qemuBlockJobStartupFinalize(vm, job);
-    qemuDomainObjEndJob(driver, vm);
+    qemuDomainObjEndDiskJob(driver, vm, disk);
 
  cleanup:
     virDomainObjEndAPI(&vm);
@@ -19937,8 +20605,9 @@ qemuConnectListAllDomains(virConnectPtr conn,
     if (virConnectListAllDomainsEnsureACL(conn) < 0)
         return -1;
 
-    return virDomainObjListExport(driver->domains, conn, domains,
-                                  virConnectListAllDomainsCheckACL, flags);
+    return virDomainObjListExportBatch(driver->domains, conn, domains,
+                                       virConnectListAllDomainsCheckACLBatch,
+                                       flags);
 }
 
 static char *
@@ -20171,6 +20840,83 @@ qemuNodeSetMemoryParameters(virConnectPtr conn,
 }
 
 
+static int
+qemuNodeGetMigrationParameters(virConnectPtr conn,
+                               virTypedParameterPtr *params,
+                               int *nparams,
+                               unsigned int flags)
+{
+    virQEMUDriverPtr driver = conn->privateData;
+    g_autoptr(virTypedParamList) list = g_new0(virTypedParamList, 1);
+    unsigned int maxJobs;
+    unsigned long long bandwidth;
+    unsigned int active;
+    unsigned int queued;
+
+    virCheckFlags(VIR_TYPED_PARAM_STRING_OKAY, -1);
+
+    if (virNodeGetMigrationParametersEnsureACL(conn) < 0)
+        return -1;
+
+    qemuMigrationSchedGetLimits(driver->migrationSched, &maxJobs, &bandwidth,
+                                &active, &queued);
+
+    if (virTypedParamListAddUInt(list, maxJobs,
+                                 VIR_NODE_MIGRATION_MAX_JOBS) < 0 ||
+        virTypedParamListAddULLong(list, bandwidth,
+                                   VIR_NODE_MIGRATION_BANDWIDTH) < 0 ||
+        virTypedParamListAddUInt(list, active,
+                                 VIR_NODE_MIGRATION_ACTIVE) < 0 ||
+        virTypedParamListAddUInt(list, queued,
+                                 VIR_NODE_MIGRATION_QUEUED) < 0)
+        return -1;
+
+    *nparams = virTypedParamListStealParams(list, params);
+
+    return 0;
+}
+
+
+static int
+qemuNodeSetMigrationParameters(virConnectPtr conn,
+                               virTypedParameterPtr params,
+                               int nparams,
+                               unsigned int flags)
+{
+    virQEMUDriverPtr driver = conn->privateData;
+    unsigned int maxJobs;
+    unsigned long long bandwidth;
+    unsigned int active;
+    unsigned int queued;
+
+    virCheckFlags(0, -1);
+
+    if (virTypedParamsValidate(params, nparams,
+                               VIR_NODE_MIGRATION_MAX_JOBS,
+                               VIR_TYPED_PARAM_UINT,
+                               VIR_NODE_MIGRATION_BANDWIDTH,
+                               VIR_TYPED_PARAM_ULLONG,
+                               NULL) < 0)
+        return -1;
+
+    if (virNodeSetMigrationParametersEnsureACL(conn) < 0)
+        return -1;
+
+    qemuMigrationSchedGetLimits(driver->migrationSched, &maxJobs, &bandwidth,
+                                &active, &queued);
+
+    if (virTypedParamsGetUInt(params, nparams, VIR_NODE_MIGRATION_MAX_JOBS,
+                              &maxJobs) < 0 ||
+        virTypedParamsGetULLong(params, nparams, VIR_NODE_MIGRATION_BANDWIDTH,
+                                &bandwidth) < 0)
+        return -1;
+
+    qemuMigrationSchedSetLimits(driver->migrationSched, maxJobs, bandwidth);
+
+    return 0;
+}
+
+
 static int
 qemuNodeGetCPUMap(virConnectPtr conn,
                   unsigned char **cpumap,
@@ -20599,7 +21345,6 @@ qemuConnectGetDomainCapabilities(virConnectPtr conn,
     g_autoptr(virQEMUCaps) qemuCaps = NULL;
     virArch arch;
     virDomainVirtType virttype;
-    g_autoptr(virDomainCaps) domCaps = NULL;
 
     virCheckFlags(0, NULL);
 
@@ -20615,28 +21360,8 @@ qemuConnectGetDomainCapabilities(virConnectPtr conn,
     if (!qemuCaps)
         return NULL;
 
-    if (!(domCaps = virQEMUDriverGetDomainCapabilities(driver,
-                                                       qemuCaps, machine,
-                                                       arch, virttype)))
-        return NULL;
-
-    return virDomainCapsFormat(domCaps);
-}
-
-
-static int
-qemuDomainGetStatsState(virQEMUDriverPtr driver G_GNUC_UNUSED,
-                        virDomainObjPtr dom,
-                        virTypedParamListPtr params,
-                        unsigned int privflags G_GNUC_UNUSED)
-{
-    if (virTypedParamListAddInt(params, dom->state.state, "state.state") < 0)
-        return -1;
-
-    if (virTypedParamListAddInt(params, dom->state.reason, "state.reason") < 0)
-        return -1;
-
-    return 0;
+    return virQEMUDriverGetDomainCapabilitiesXML(driver, qemuCaps, machine,
+                                                 arch, virttype);
 }
 
 
@@ -20645,40 +21370,208 @@ typedef enum {
                                             accessed */
     QEMU_DOMAIN_STATS_BACKING  = 1 << 1, /* include backing chain in
                                             block stats */
+    QEMU_DOMAIN_STATS_CACHED   = 1 << 2, /* stats may be served from the
+                                            stats cache */
+    QEMU_DOMAIN_STATS_UPDATE_CACHE = 1 << 3, /* store collected stats in
+                                                the stats cache */
+    QEMU_DOMAIN_STATS_NET_SNAPSHOT = 1 << 4, /* interface stats may be
+                                                looked up in the host-wide
+                                                snapshot of the sweep */
 } qemuDomainStatsFlags;
 
 
 #define HAVE_JOB(flags) ((flags) & QEMU_DOMAIN_STATS_HAVE_JOB)
 
 
-typedef struct _virQEMUResctrlMonData virQEMUResctrlMonData;
-typedef virQEMUResctrlMonData *virQEMUResctrlMonDataPtr;
-struct _virQEMUResctrlMonData {
-    char *name;
-    char *vcpus;
-    virResctrlMonitorStatsPtr *stats;
-    size_t nstats;
+/* Data fetched from the monitor for the stats groups in a single
+ * monitor session, see qemuDomainGetStatsFetchMonitor */
+typedef struct _qemuDomainStatsMonData qemuDomainStatsMonData;
+typedef qemuDomainStatsMonData *qemuDomainStatsMonDataPtr;
+struct _qemuDomainStatsMonData {
+    /* VIR_DOMAIN_STATS_BLOCK */
+    bool blockFetched;
+    virHashTablePtr blockstats;
+    virJSONValuePtr nodedata;
+
+    /* VIR_DOMAIN_STATS_BALLOON */
+    bool balloonFetched;
+    virDomainMemoryStatStruct balloon[VIR_DOMAIN_MEMORY_STAT_NR];
+    int nballoon;
+
+    /* VIR_DOMAIN_STATS_IOTHREAD */
+    bool iothreadsFetched;
+    qemuMonitorIOThreadInfoPtr *iothreads;
+    int niothreads;
 };
 
 
 static void
-qemuDomainFreeResctrlMonData(virQEMUResctrlMonDataPtr resdata)
+qemuDomainStatsMonDataClear(qemuDomainStatsMonDataPtr data)
 {
-    size_t i = 0;
+    size_t i;
 
-    VIR_FREE(resdata->name);
-    VIR_FREE(resdata->vcpus);
-    for (i = 0; i < resdata->nstats; i++)
-        virResctrlMonitorStatsFree(resdata->stats[i]);
-    VIR_FREE(resdata->stats);
-    VIR_FREE(resdata);
+    virHashFree(data->blockstats);
+    virJSONValueFree(data->nodedata);
+
+    for (i = 0; i < data->niothreads; i++)
+        VIR_FREE(data->iothreads[i]);
+    VIR_FREE(data->iothreads);
+
+    memset(data, 0, sizeof(*data));
 }
 
 
 /**
- * qemuDomainGetResctrlMonData:
- * @dom: Pointer for the domain that the resctrl monitors reside in
- * @driver: Pointer to qemu driver
+ * qemuDomainGetStatsFetchMonitor:
+ * @driver: qemu driver
+ * @dom: domain object
+ * @stats: stats groups to fetch monitor data for
+ * @data: filled with the fetched data
+ * @privflags: qemuDomainStatsFlags
+ *
+ * Issues all monitor commands needed by the block, balloon and
+ * iothread stats groups requested in @stats back-to-back in a single
+ * monitor session, rather than entering the monitor once per group.
+ * Failure to fetch data of a group is not fatal, the group then
+ * misses the stats which need the monitor.
+ */
+static void
+qemuDomainGetStatsFetchMonitor(virQEMUDriverPtr driver,
+                               virDomainObjPtr dom,
+                               unsigned int stats,
+                               qemuDomainStatsMonDataPtr data,
+                               unsigned int privflags)
+{
+    qemuDomainObjPrivatePtr priv = dom->privateData;
+    bool blockdev = virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_BLOCKDEV);
+    bool fetchnodedata = virQEMUCapsGet(priv->qemuCaps,
+                                        QEMU_CAPS_QUERY_NAMED_BLOCK_NODES) && !blockdev;
+    bool visitBacking = !!(privflags & QEMU_DOMAIN_STATS_BACKING);
+    bool block = !!(stats & VIR_DOMAIN_STATS_BLOCK);
+    bool balloon = !!(stats & VIR_DOMAIN_STATS_BALLOON);
+    bool iothread = (stats & VIR_DOMAIN_STATS_IOTHREAD) &&
+                    virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_OBJECT_IOTHREAD);
+    int rc;
+
+    if (!HAVE_JOB(privflags) || !virDomainObjIsActive(dom))
+        return;
+
+    if (balloon && !virDomainDefHasMemballoon(dom->def)) {
+        data->balloonFetched = true;
+        data->nballoon = 0;
+        balloon = false;
+    }
+
+    if (balloon &&
+        (data->nballoon = qemuDomainMemoryStatsCacheGet(dom, data->balloon,
+                                                        VIR_DOMAIN_MEMORY_STAT_NR)) >= 0) {
+        data->balloonFetched = true;
+        balloon = false;
+    }
+
+    if (!block && !balloon && !iothread)
+        return;
+
+    qemuDomainObjEnterMonitor(driver, dom);
+
+    if (block) {
+        rc = qemuMonitorGetAllBlockStatsInfo(priv->mon, &data->blockstats,
+                                             visitBacking);
+
+        if (rc >= 0) {
+            if (blockdev)
+                rc = qemuMonitorBlockStatsUpdateCapacityBlockdev(priv->mon,
+                                                                 data->blockstats);
+            else
+                ignore_value(qemuMonitorBlockStatsUpdateCapacity(priv->mon,
+                                                                 data->blockstats,
+                                                                 visitBacking));
+        }
+
+        if (fetchnodedata)
+            data->nodedata = qemuMonitorQueryNamedBlockNodes(priv->mon);
+
+        /* failure to retrieve stats is fine at this point */
+        if (rc < 0 || (fetchnodedata && !data->nodedata))
+            virResetLastError();
+
+        data->blockFetched = true;
+    }
+
+    if (balloon) {
+        data->nballoon = qemuMonitorGetMemoryStats(priv->mon,
+                                                   dom->def->memballoon,
+                                                   data->balloon,
+                                                   VIR_DOMAIN_MEMORY_STAT_NR);
+        if (data->nballoon < 0)
+            virResetLastError();
+
+        data->balloonFetched = true;
+    }
+
+    if (iothread) {
+        data->niothreads = qemuMonitorGetIOThreads(priv->mon, &data->iothreads);
+        if (data->niothreads < 0) {
+            data->niothreads = 0;
+            virResetLastError();
+        } else {
+            data->iothreadsFetched = true;
+        }
+    }
+
+    if (qemuDomainObjExitMonitor(driver, dom) < 0)
+        virResetLastError();
+
+    if (balloon)
+        qemuDomainMemoryStatsCacheUpdate(dom, data->balloon, data->nballoon);
+}
+
+
+static int
+qemuDomainGetStatsState(virQEMUDriverPtr driver G_GNUC_UNUSED,
+                        virDomainObjPtr dom,
+                        qemuDomainStatsMonDataPtr mondata G_GNUC_UNUSED,
+                        virTypedParamListPtr params,
+                        unsigned int privflags G_GNUC_UNUSED)
+{
+    if (virTypedParamListAddInt(params, dom->state.state, "state.state") < 0)
+        return -1;
+
+    if (virTypedParamListAddInt(params, dom->state.reason, "state.reason") < 0)
+        return -1;
+
+    return 0;
+}
+
+
+typedef struct _virQEMUResctrlMonData virQEMUResctrlMonData;
+typedef virQEMUResctrlMonData *virQEMUResctrlMonDataPtr;
+struct _virQEMUResctrlMonData {
+    char *name;
+    char *vcpus;
+    virResctrlMonitorStatsPtr *stats;
+    size_t nstats;
+};
+
+
+static void
+qemuDomainFreeResctrlMonData(virQEMUResctrlMonDataPtr resdata)
+{
+    size_t i = 0;
+
+    VIR_FREE(resdata->name);
+    VIR_FREE(resdata->vcpus);
+    for (i = 0; i < resdata->nstats; i++)
+        virResctrlMonitorStatsFree(resdata->stats[i]);
+    VIR_FREE(resdata->stats);
+    VIR_FREE(resdata);
+}
+
+
+/**
+ * qemuDomainGetResctrlMonData:
+ * @dom: Pointer for the domain that the resctrl monitors reside in
+ * @driver: Pointer to qemu driver
  * @resdata: Pointer of virQEMUResctrlMonDataPtr pointer for receiving the
  *            virQEMUResctrlMonDataPtr array. Caller is responsible for
  *            freeing the array.
@@ -20956,6 +21849,7 @@ qemuDomainGetStatsCpuCgroup(virDomainObjPtr dom,
 static int
 qemuDomainGetStatsCpu(virQEMUDriverPtr driver,
                       virDomainObjPtr dom,
+                      qemuDomainStatsMonDataPtr mondata G_GNUC_UNUSED,
                       virTypedParamListPtr params,
                       unsigned int privflags G_GNUC_UNUSED)
 {
@@ -20972,6 +21866,7 @@ qemuDomainGetStatsCpu(virQEMUDriverPtr driver,
 static int
 qemuDomainGetStatsMemory(virQEMUDriverPtr driver,
                          virDomainObjPtr dom,
+                         qemuDomainStatsMonDataPtr mondata G_GNUC_UNUSED,
                          virTypedParamListPtr params,
                          unsigned int privflags G_GNUC_UNUSED)
 
@@ -20981,8 +21876,9 @@ qemuDomainGetStatsMemory(virQEMUDriverPtr driver,
 
 
 static int
-qemuDomainGetStatsBalloon(virQEMUDriverPtr driver,
+qemuDomainGetStatsBalloon(virQEMUDriverPtr driver G_GNUC_UNUSED,
                           virDomainObjPtr dom,
+                          qemuDomainStatsMonDataPtr mondata,
                           virTypedParamListPtr params,
                           unsigned int privflags)
 {
@@ -21007,11 +21903,22 @@ qemuDomainGetStatsBalloon(virQEMUDriverPtr driver,
     if (!HAVE_JOB(privflags) || !virDomainObjIsActive(dom))
         return 0;
 
-    nr_stats = qemuDomainMemoryStatsInternal(driver, dom, stats,
-                                             VIR_DOMAIN_MEMORY_STAT_NR);
-    if (nr_stats < 0)
+    if (!mondata->balloonFetched || mondata->nballoon < 0)
         return 0;
 
+    nr_stats = mondata->nballoon;
+    memcpy(stats, mondata->balloon, sizeof(stats[0]) * nr_stats);
+
+    if (nr_stats < VIR_DOMAIN_MEMORY_STAT_NR) {
+        long rss;
+
+        if (qemuGetProcessInfo(NULL, NULL, &rss, dom->pid, 0, NULL) == 0) {
+            stats[nr_stats].tag = VIR_DOMAIN_MEMORY_STAT_RSS;
+            stats[nr_stats].val = rss;
+            nr_stats++;
+        }
+    }
+
 #define STORE_MEM_RECORD(TAG, NAME) \
     if (stats[i].tag == VIR_DOMAIN_MEMORY_STAT_ ##TAG) \
         if (virTypedParamListAddULLong(params, stats[i].val, "balloon." NAME) < 0) \
@@ -21041,6 +21948,7 @@ qemuDomainGetStatsBalloon(virQEMUDriverPtr driver,
 static int
 qemuDomainGetStatsVcpu(virQEMUDriverPtr driver,
                        virDomainObjPtr dom,
+                       qemuDomainStatsMonDataPtr mondata G_GNUC_UNUSED,
                        virTypedParamListPtr params,
                        unsigned int privflags)
 {
@@ -21078,21 +21986,23 @@ qemuDomainGetStatsVcpu(virQEMUDriverPtr driver,
         goto cleanup;
     }
 
+    if (virTypedParamListReserve(params, virDomainDefGetVcpus(dom->def) * 4) < 0)
+        goto cleanup;
+
     for (i = 0; i < virDomainDefGetVcpus(dom->def); i++) {
-        if (virTypedParamListAddInt(params, cpuinfo[i].state,
-                                    "vcpu.%u.state", cpuinfo[i].number) < 0)
+        if (virTypedParamListSetPrefix(params, "vcpu.%u.", cpuinfo[i].number) < 0 ||
+            virTypedParamListAddPrefixedInt(params, cpuinfo[i].state, "state") < 0)
             goto cleanup;
 
         /* stats below are available only if the VM is alive */
         if (!virDomainObjIsActive(dom))
             continue;
 
-        if (virTypedParamListAddULLong(params, cpuinfo[i].cpuTime,
-                                       "vcpu.%u.time", cpuinfo[i].number) < 0)
+        if (virTypedParamListAddPrefixedULLong(params, cpuinfo[i].cpuTime,
+                                               "time") < 0)
             goto cleanup;
 
-        if (virTypedParamListAddULLong(params, cpuwait[i],
-                                       "vcpu.%u.wait", cpuinfo[i].number) < 0)
+        if (virTypedParamListAddPrefixedULLong(params, cpuwait[i], "wait") < 0)
             goto cleanup;
 
         /* state below is extracted from the individual vcpu structs */
@@ -21102,10 +22012,9 @@ qemuDomainGetStatsVcpu(virQEMUDriverPtr driver,
         vcpupriv = QEMU_DOMAIN_VCPU_PRIVATE(vcpu);
 
         if (vcpupriv->halted != VIR_TRISTATE_BOOL_ABSENT) {
-            if (virTypedParamListAddBoolean(params,
-                                            vcpupriv->halted == VIR_TRISTATE_BOOL_YES,
-                                            "vcpu.%u.halted",
-                                            cpuinfo[i].number) < 0)
+            if (virTypedParamListAddPrefixedBoolean(params,
+                                                    vcpupriv->halted == VIR_TRISTATE_BOOL_YES,
+                                                    "halted") < 0)
                 goto cleanup;
         }
     }
@@ -21117,16 +22026,99 @@ qemuDomainGetStatsVcpu(virQEMUDriverPtr driver,
     return ret;
 }
 
-#define QEMU_ADD_NET_PARAM(params, num, name, value) \
+#define QEMU_ADD_NET_PARAM(params, name, value) \
     if (value >= 0 && \
-        virTypedParamListAddULLong((params), (value), "net.%zu.%s", (num), (name)) < 0) \
+        virTypedParamListAddPrefixedULLong((params), (value), (name)) < 0) \
         return -1;
 
+/**
+ * qemuDomainGetStatsNetRefresh:
+ * @driver: qemu driver
+ *
+ * Replaces the host-wide snapshot of interface stats with a fresh one,
+ * taken with a single netlink dump. This is done once at the start of a
+ * bulk stats sweep so that the interface stats of the domains don't
+ * have to walk the list of all host interfaces once per interface. The
+ * stats of OVS interfaces are only fetched once the first vhostuser
+ * interface is looked up, see qemuDomainGetStatsInterfaceOne.
+ */
+static void
+qemuDomainGetStatsNetRefresh(virQEMUDriverPtr driver)
+{
+    virHashTablePtr tap;
+
+    if (!(tap = virNetDevTapInterfaceStatsAll())) {
+        VIR_DEBUG("Unable to collect host-wide interface stats: %s",
+                  virGetLastErrorMessage());
+        virResetLastError();
+    }
+
+    virMutexLock(&driver->netStatsLock);
+    virHashFree(driver->netStatsTap);
+    driver->netStatsTap = tap;
+    virHashFree(driver->netStatsOVS);
+    driver->netStatsOVS = NULL;
+    driver->netStatsOVSFetched = false;
+    virMutexUnlock(&driver->netStatsLock);
+}
+
+
+/* Looks up the stats of @net in the host-wide snapshot if @privflags
+ * allow it, otherwise or if @net is missing in there, e.g. because it
+ * was hotplugged since, fetches them for @net alone */
+static int
+qemuDomainGetStatsInterfaceOne(virQEMUDriverPtr driver,
+                               virDomainNetDefPtr net,
+                               virDomainInterfaceStatsPtr stats,
+                               unsigned int privflags)
+{
+    bool vhostuser = virDomainNetGetActualType(net) == VIR_DOMAIN_NET_TYPE_VHOSTUSER;
+    bool swapped = !virDomainNetTypeSharesHostView(net);
+    int rc = -1;
+
+    if (privflags & QEMU_DOMAIN_STATS_NET_SNAPSHOT) {
+        virDomainInterfaceStatsPtr found;
+
+        virMutexLock(&driver->netStatsLock);
+        if (vhostuser) {
+            if (!driver->netStatsOVSFetched) {
+                if (!(driver->netStatsOVS = virNetDevOpenvswitchInterfaceStatsAll())) {
+                    VIR_DEBUG("Unable to collect OVS interface stats: %s",
+                              virGetLastErrorMessage());
+                    virResetLastError();
+                }
+                driver->netStatsOVSFetched = true;
+            }
+
+            if (driver->netStatsOVS &&
+                (found = virHashLookup(driver->netStatsOVS, net->ifname))) {
+                *stats = *found;
+                rc = 0;
+            }
+        } else if (driver->netStatsTap) {
+            rc = virNetDevTapInterfaceStatsLookup(driver->netStatsTap,
+                                                  net->ifname, stats, swapped);
+        }
+        virMutexUnlock(&driver->netStatsLock);
+
+        if (rc == 0)
+            return 0;
+        virResetLastError();
+    }
+
+    if (vhostuser)
+        return virNetDevOpenvswitchInterfaceStats(net->ifname, stats);
+
+    return virNetDevTapInterfaceStats(net->ifname, stats, swapped);
+}
+
+
 static int
-qemuDomainGetStatsInterface(virQEMUDriverPtr driver G_GNUC_UNUSED,
+qemuDomainGetStatsInterface(virQEMUDriverPtr driver,
                             virDomainObjPtr dom,
+                            qemuDomainStatsMonDataPtr mondata G_GNUC_UNUSED,
                             virTypedParamListPtr params,
-                            unsigned int privflags G_GNUC_UNUSED)
+                            unsigned int privflags)
 {
     size_t i;
     struct _virDomainInterfaceStats tmp;
@@ -21134,53 +22126,36 @@ qemuDomainGetStatsInterface(virQEMUDriverPtr driver G_GNUC_UNUSED,
     if (!virDomainObjIsActive(dom))
         return 0;
 
-    if (virTypedParamListAddUInt(params, dom->def->nnets, "net.count") < 0)
+    if (virTypedParamListAddUInt(params, dom->def->nnets, "net.count") < 0 ||
+        virTypedParamListReserve(params, dom->def->nnets * 9) < 0)
         return -1;
 
     /* Check the path is one of the domain's network interfaces. */
     for (i = 0; i < dom->def->nnets; i++) {
         virDomainNetDefPtr net = dom->def->nets[i];
-        virDomainNetType actualType;
 
         if (!net->ifname)
             continue;
 
         memset(&tmp, 0, sizeof(tmp));
 
-        actualType = virDomainNetGetActualType(net);
-
-        if (virTypedParamListAddString(params, net->ifname, "net.%zu.name", i) < 0)
+        if (virTypedParamListSetPrefix(params, "net.%zu.", i) < 0 ||
+            virTypedParamListAddPrefixedString(params, net->ifname, "name") < 0)
             return -1;
 
-        if (actualType == VIR_DOMAIN_NET_TYPE_VHOSTUSER) {
-            if (virNetDevOpenvswitchInterfaceStats(net->ifname, &tmp) < 0) {
-                virResetLastError();
-                continue;
-            }
-        } else {
-            if (virNetDevTapInterfaceStats(net->ifname, &tmp,
-                                           !virDomainNetTypeSharesHostView(net)) < 0) {
-                virResetLastError();
-                continue;
-            }
+        if (qemuDomainGetStatsInterfaceOne(driver, net, &tmp, privflags) < 0) {
+            virResetLastError();
+            continue;
         }
 
-        QEMU_ADD_NET_PARAM(params, i,
-                           "rx.bytes", tmp.rx_bytes);
-        QEMU_ADD_NET_PARAM(params, i,
-                           "rx.pkts", tmp.rx_packets);
-        QEMU_ADD_NET_PARAM(params, i,
-                           "rx.errs", tmp.rx_errs);
-        QEMU_ADD_NET_PARAM(params, i,
-                           "rx.drop", tmp.rx_drop);
-        QEMU_ADD_NET_PARAM(params, i,
-                           "tx.bytes", tmp.tx_bytes);
-        QEMU_ADD_NET_PARAM(params, i,
-                           "tx.pkts", tmp.tx_packets);
-        QEMU_ADD_NET_PARAM(params, i,
-                           "tx.errs", tmp.tx_errs);
-        QEMU_ADD_NET_PARAM(params, i,
-                           "tx.drop", tmp.tx_drop);
+        QEMU_ADD_NET_PARAM(params, "rx.bytes", tmp.rx_bytes);
+        QEMU_ADD_NET_PARAM(params, "rx.pkts", tmp.rx_packets);
+        QEMU_ADD_NET_PARAM(params, "rx.errs", tmp.rx_errs);
+        QEMU_ADD_NET_PARAM(params, "rx.drop", tmp.rx_drop);
+        QEMU_ADD_NET_PARAM(params, "tx.bytes", tmp.tx_bytes);
+        QEMU_ADD_NET_PARAM(params, "tx.pkts", tmp.tx_packets);
+        QEMU_ADD_NET_PARAM(params, "tx.errs", tmp.tx_errs);
+        QEMU_ADD_NET_PARAM(params, "tx.drop", tmp.tx_drop);
     }
 
     return 0;
@@ -21194,8 +22169,7 @@ qemuDomainGetStatsOneBlockFallback(virQEMUDriverPtr driver,
                                    virQEMUDriverConfigPtr cfg,
                                    virDomainObjPtr dom,
                                    virTypedParamListPtr params,
-                                   virStorageSourcePtr src,
-                                   size_t block_idx)
+                                   virStorageSourcePtr src)
 {
     if (virStorageSourceIsEmpty(src))
         return 0;
@@ -21206,18 +22180,18 @@ qemuDomainGetStatsOneBlockFallback(virQEMUDriverPtr driver,
     }
 
     if (src->allocation &&
-        virTypedParamListAddULLong(params, src->allocation,
-                                   "block.%zu.allocation", block_idx) < 0)
+        virTypedParamListAddPrefixedULLong(params, src->allocation,
+                                           "allocation") < 0)
         return -1;
 
     if (src->capacity &&
-        virTypedParamListAddULLong(params, src->capacity,
-                                   "block.%zu.capacity", block_idx) < 0)
+        virTypedParamListAddPrefixedULLong(params, src->capacity,
+                                           "capacity") < 0)
         return -1;
 
     if (src->physical &&
-        virTypedParamListAddULLong(params, src->physical,
-                                   "block.%zu.physical", block_idx) < 0)
+        virTypedParamListAddPrefixedULLong(params, src->physical,
+                                           "physical") < 0)
         return -1;
 
     return 0;
@@ -21267,7 +22241,6 @@ qemuDomainGetStatsOneBlock(virQEMUDriverPtr driver,
                            virTypedParamListPtr params,
                            const char *entryname,
                            virStorageSourcePtr src,
-                           size_t block_idx,
                            virHashTablePtr stats)
 {
     qemuBlockStats *entry;
@@ -21276,7 +22249,7 @@ qemuDomainGetStatsOneBlock(virQEMUDriverPtr driver,
      * ourselves */
     if (!virDomainObjIsActive(dom)) {
         return qemuDomainGetStatsOneBlockFallback(driver, cfg, dom, params,
-                                                  src, block_idx);
+                                                  src);
     }
 
     /* In case where qemu didn't provide the stats we stop here rather than
@@ -21285,23 +22258,23 @@ qemuDomainGetStatsOneBlock(virQEMUDriverPtr driver,
     if (!stats || !entryname || !(entry = virHashLookup(stats, entryname)))
         return 0;
 
-    if (virTypedParamListAddULLong(params, entry->wr_highest_offset,
-                                   "block.%zu.allocation", block_idx) < 0)
+    if (virTypedParamListAddPrefixedULLong(params, entry->wr_highest_offset,
+                                           "allocation") < 0)
         return -1;
 
     if (entry->capacity &&
-        virTypedParamListAddULLong(params, entry->capacity,
-                                   "block.%zu.capacity", block_idx) < 0)
+        virTypedParamListAddPrefixedULLong(params, entry->capacity,
+                                           "capacity") < 0)
         return -1;
 
     if (entry->physical) {
-        if (virTypedParamListAddULLong(params, entry->physical,
-                                       "block.%zu.physical", block_idx) < 0)
+        if (virTypedParamListAddPrefixedULLong(params, entry->physical,
+                                               "physical") < 0)
             return -1;
     } else {
         if (qemuDomainStorageUpdatePhysical(driver, cfg, dom, src) == 0) {
-            if (virTypedParamListAddULLong(params, src->physical,
-                                           "block.%zu.physical", block_idx) < 0)
+            if (virTypedParamListAddPrefixedULLong(params, src->physical,
+                                                   "physical") < 0)
                 return -1;
         }
     }
@@ -21313,7 +22286,6 @@ qemuDomainGetStatsOneBlock(virQEMUDriverPtr driver,
 static int
 qemuDomainGetStatsBlockExportBackendStorage(const char *entryname,
                                             virHashTablePtr stats,
-                                            size_t recordnr,
                                             virTypedParamListPtr params)
 {
     qemuBlockStats *entry;
@@ -21322,8 +22294,8 @@ qemuDomainGetStatsBlockExportBackendStorage(const char *entryname,
         return 0;
 
     if (entry->write_threshold &&
-        virTypedParamListAddULLong(params, entry->write_threshold,
-                                   "block.%zu.threshold", recordnr) < 0)
+        virTypedParamListAddPrefixedULLong(params, entry->write_threshold,
+                                           "threshold") < 0)
         return -1;
 
     return 0;
@@ -21333,7 +22305,6 @@ qemuDomainGetStatsBlockExportBackendStorage(const char *entryname,
 static int
 qemuDomainGetStatsBlockExportFrontend(const char *frontendname,
                                       virHashTablePtr stats,
-                                      size_t idx,
                                       virTypedParamListPtr par)
 {
     qemuBlockStats *en;
@@ -21344,35 +22315,38 @@ qemuDomainGetStatsBlockExportFrontend(const char *frontendname,
     if (!stats || !frontendname || !(en = virHashLookup(stats, frontendname)))
         return 0;
 
-    if (virTypedParamListAddULLong(par, en->rd_req, "block.%zu.rd.reqs", idx) < 0 ||
-        virTypedParamListAddULLong(par, en->rd_bytes, "block.%zu.rd.bytes", idx) < 0 ||
-        virTypedParamListAddULLong(par, en->rd_total_times, "block.%zu.rd.times", idx) < 0 ||
-        virTypedParamListAddULLong(par, en->wr_req, "block.%zu.wr.reqs", idx) < 0 ||
-        virTypedParamListAddULLong(par, en->wr_bytes, "block.%zu.wr.bytes", idx) < 0 ||
-        virTypedParamListAddULLong(par, en->wr_total_times, "block.%zu.wr.times", idx) < 0 ||
-        virTypedParamListAddULLong(par, en->flush_req, "block.%zu.fl.reqs", idx) < 0 ||
-        virTypedParamListAddULLong(par, en->flush_total_times, "block.%zu.fl.times", idx) < 0)
+    if (virTypedParamListAddPrefixedULLong(par, en->rd_req, "rd.reqs") < 0 ||
+        virTypedParamListAddPrefixedULLong(par, en->rd_bytes, "rd.bytes") < 0 ||
+        virTypedParamListAddPrefixedULLong(par, en->rd_total_times, "rd.times") < 0 ||
+        virTypedParamListAddPrefixedULLong(par, en->wr_req, "wr.reqs") < 0 ||
+        virTypedParamListAddPrefixedULLong(par, en->wr_bytes, "wr.bytes") < 0 ||
+        virTypedParamListAddPrefixedULLong(par, en->wr_total_times, "wr.times") < 0 ||
+        virTypedParamListAddPrefixedULLong(par, en->flush_req, "fl.reqs") < 0 ||
+        virTypedParamListAddPrefixedULLong(par, en->flush_total_times, "fl.times") < 0)
         return -1;
 
     return 0;
 }
 
 
+/* Starts record @recordnr, the stats added after it until the next record
+ * is started are prefixed with "block.<recordnr>." */
 static int
 qemuDomainGetStatsBlockExportHeader(virDomainDiskDefPtr disk,
                                     virStorageSourcePtr src,
                                     size_t recordnr,
                                     virTypedParamListPtr params)
 {
-    if (virTypedParamListAddString(params, disk->dst, "block.%zu.name", recordnr) < 0)
+    if (virTypedParamListSetPrefix(params, "block.%zu.", recordnr) < 0 ||
+        virTypedParamListAddPrefixedString(params, disk->dst, "name") < 0)
         return -1;
 
     if (virStorageSourceIsLocalStorage(src) && src->path &&
-        virTypedParamListAddString(params, src->path, "block.%zu.path", recordnr) < 0)
+        virTypedParamListAddPrefixedString(params, src->path, "path") < 0)
         return -1;
 
     if (src->id &&
-        virTypedParamListAddUInt(params, src->id, "block.%zu.backingIndex", recordnr) < 0)
+        virTypedParamListAddPrefixedUInt(params, src->id, "backingIndex") < 0)
         return -1;
 
     return 0;
@@ -21436,19 +22410,17 @@ qemuDomainGetStatsBlockExportDisk(virDomainDiskDefPtr disk,
 
         /* The following stats make sense only for the frontend device */
         if (n == disk->src) {
-            if (qemuDomainGetStatsBlockExportFrontend(frontendalias, stats, *recordnr,
+            if (qemuDomainGetStatsBlockExportFrontend(frontendalias, stats,
                                                       params) < 0)
                 return -1;
         }
 
         if (qemuDomainGetStatsOneBlock(driver, cfg, dom, params,
-                                       backendalias, n, *recordnr,
-                                       stats) < 0)
+                                       backendalias, n, stats) < 0)
             return -1;
 
         if (qemuDomainGetStatsBlockExportBackendStorage(backendstoragealias,
-                                                        stats, *recordnr,
-                                                        params) < 0)
+                                                        stats, params) < 0)
             return -1;
 
         (*recordnr)++;
@@ -21464,52 +22436,29 @@ qemuDomainGetStatsBlockExportDisk(virDomainDiskDefPtr disk,
 static int
 qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
                         virDomainObjPtr dom,
+                        qemuDomainStatsMonDataPtr mondata,
                         virTypedParamListPtr params,
                         unsigned int privflags)
 {
     size_t i;
     int ret = -1;
-    int rc;
     virHashTablePtr stats = NULL;
     virHashTablePtr nodestats = NULL;
-    virJSONValuePtr nodedata = NULL;
     qemuDomainObjPrivatePtr priv = dom->privateData;
     g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
     bool blockdev = virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_BLOCKDEV);
-    bool fetchnodedata = virQEMUCapsGet(priv->qemuCaps,
-                                        QEMU_CAPS_QUERY_NAMED_BLOCK_NODES) && !blockdev;
     int count_index = -1;
     size_t visited = 0;
     bool visitBacking = !!(privflags & QEMU_DOMAIN_STATS_BACKING);
 
-    if (HAVE_JOB(privflags) && virDomainObjIsActive(dom)) {
-        qemuDomainObjEnterMonitor(driver, dom);
-
-        rc = qemuMonitorGetAllBlockStatsInfo(priv->mon, &stats, visitBacking);
+    if (mondata->blockFetched) {
+        stats = mondata->blockstats;
 
-        if (rc >= 0) {
-            if (blockdev)
-                rc = qemuMonitorBlockStatsUpdateCapacityBlockdev(priv->mon, stats);
-            else
-                ignore_value(qemuMonitorBlockStatsUpdateCapacity(priv->mon, stats,
-                                                                 visitBacking));
-        }
-
-        if (fetchnodedata)
-            nodedata = qemuMonitorQueryNamedBlockNodes(priv->mon);
-
-        if (qemuDomainObjExitMonitor(driver, dom) < 0)
+        if (mondata->nodedata &&
+            !(nodestats = qemuBlockGetNodeData(mondata->nodedata)))
             goto cleanup;
-
-        /* failure to retrieve stats is fine at this point */
-        if (rc < 0 || (fetchnodedata && !nodedata))
-            virResetLastError();
     }
 
-    if (nodedata &&
-        !(nodestats = qemuBlockGetNodeData(nodedata)))
-        goto cleanup;
-
     /* When listing backing chains, it's easier to fix up the count
      * after the iteration than it is to iterate twice; but we still
      * want count listed first.  */
@@ -21517,6 +22466,11 @@ qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
     if (virTypedParamListAddUInt(params, 0, "block.count") < 0)
         goto cleanup;
 
+    /* up to 3 header, 8 frontend and 4 size stats per disk; backing chains
+     * grow the list further as needed */
+    if (virTypedParamListReserve(params, dom->def->ndisks * 15) < 0)
+        goto cleanup;
+
     for (i = 0; i < dom->def->ndisks; i++) {
         if (qemuDomainGetStatsBlockExportDisk(dom->def->disks[i], stats, nodestats,
                                               params, &visited,
@@ -21529,84 +22483,72 @@ qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
     ret = 0;
 
  cleanup:
-    virHashFree(stats);
     virHashFree(nodestats);
-    virJSONValueFree(nodedata);
     return ret;
 }
 
 
 static int
-qemuDomainGetStatsIOThread(virQEMUDriverPtr driver,
+qemuDomainGetStatsIOThread(virQEMUDriverPtr driver G_GNUC_UNUSED,
                            virDomainObjPtr dom,
+                           qemuDomainStatsMonDataPtr mondata,
                            virTypedParamListPtr params,
                            unsigned int privflags)
 {
-    qemuDomainObjPrivatePtr priv = dom->privateData;
     size_t i;
-    qemuMonitorIOThreadInfoPtr *iothreads = NULL;
-    int niothreads;
-    int ret = -1;
+    qemuMonitorIOThreadInfoPtr *iothreads = mondata->iothreads;
+    int niothreads = mondata->niothreads;
 
     if (!HAVE_JOB(privflags) || !virDomainObjIsActive(dom))
         return 0;
 
-    if (!virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_OBJECT_IOTHREAD))
+    if (!mondata->iothreadsFetched || niothreads == 0)
         return 0;
 
-    if ((niothreads = qemuDomainGetIOThreadsMon(driver, dom, &iothreads)) < 0)
-        return -1;
-
-    /* qemuDomainGetIOThreadsMon returns a NULL-terminated list, so we must free
-     * it even if it returns 0 */
-    if (niothreads == 0) {
-        ret = 0;
-        goto cleanup;
-    }
-
     if (virTypedParamListAddUInt(params, niothreads, "iothread.count") < 0)
-        goto cleanup;
+        return -1;
 
     for (i = 0; i < niothreads; i++) {
         if (iothreads[i]->poll_valid) {
             if (virTypedParamListAddULLong(params, iothreads[i]->poll_max_ns,
                                            "iothread.%u.poll-max-ns",
                                            iothreads[i]->iothread_id) < 0)
-                goto cleanup;
+                return -1;
             if (virTypedParamListAddUInt(params, iothreads[i]->poll_grow,
                                          "iothread.%u.poll-grow",
                                          iothreads[i]->iothread_id) < 0)
-                goto cleanup;
+                return -1;
             if (virTypedParamListAddUInt(params, iothreads[i]->poll_shrink,
                                          "iothread.%u.poll-shrink",
                                          iothreads[i]->iothread_id) < 0)
-                goto cleanup;
+                return -1;
         }
     }
 
-    ret = 0;
-
- cleanup:
-    for (i = 0; i < niothreads; i++)
-        VIR_FREE(iothreads[i]);
-    VIR_FREE(iothreads);
-
-    return ret;
+    return 0;
 }
 
 
 static int
-qemuDomainGetStatsPerfOneEvent(virPerfPtr perf,
+qemuDomainGetStatsPerfOneEvent(virPerfEventValuePtr value,
                                virPerfEventType type,
                                virTypedParamListPtr params)
 {
-    uint64_t value = 0;
+    const char *name = virPerfEventTypeToString(type);
 
-    if (virPerfReadEvent(perf, type, &value) < 0)
+    if (virTypedParamListAddULLong(params, value->value, "perf.%s", name) < 0)
         return -1;
 
-    if (virTypedParamListAddULLong(params, value, "perf.%s",
-                                   virPerfEventTypeToString(type)) < 0)
+    /* the RDT events report usage rather than counts */
+    if (type == VIR_PERF_EVENT_CMT ||
+        type == VIR_PERF_EVENT_MBMT ||
+        type == VIR_PERF_EVENT_MBML)
+        return 0;
+
+    if (virTypedParamListAddULLong(params, value->enabled,
+                                   "perf.%s.time_enabled", name) < 0 ||
+        virTypedParamListAddULLong(params, value->running,
+                                   "perf.%s.time_running", name) < 0)
         return -1;
 
     return 0;
@@ -21615,17 +22557,25 @@ qemuDomainGetStatsPerfOneEvent(virPerfPtr perf,
 static int
 qemuDomainGetStatsPerf(virQEMUDriverPtr driver G_GNUC_UNUSED,
                        virDomainObjPtr dom,
+                       qemuDomainStatsMonDataPtr mondata G_GNUC_UNUSED,
                        virTypedParamListPtr params,
                        unsigned int privflags G_GNUC_UNUSED)
 {
     size_t i;
     qemuDomainObjPrivatePtr priv = dom->privateData;
+    virPerfEventValue values[VIR_PERF_EVENT_LAST] = { { 0 } };
+
+    if (!priv->perf)
+        return 0;
+
+    if (virPerfReadEvents(priv->perf, values) < 0)
+        return -1;
 
     for (i = 0; i < VIR_PERF_EVENT_LAST; i++) {
         if (!virPerfEventIsEnabled(priv->perf, i))
              continue;
 
-        if (qemuDomainGetStatsPerfOneEvent(priv->perf, i, params) < 0)
+        if (qemuDomainGetStatsPerfOneEvent(&values[i], i, params) < 0)
             return -1;
     }
 
@@ -21635,6 +22585,7 @@ qemuDomainGetStatsPerf(virQEMUDriverPtr driver G_GNUC_UNUSED,
 typedef int
 (*qemuDomainGetStatsFunc)(virQEMUDriverPtr driver,
                           virDomainObjPtr dom,
+                          qemuDomainStatsMonDataPtr mondata,
                           virTypedParamListPtr list,
                           unsigned int flags);
 
@@ -21686,52 +22637,551 @@ qemuDomainGetStatsCheckSupport(unsigned int *stats,
 }
 
 
-static bool
-qemuDomainGetStatsNeedMonitor(unsigned int stats)
-{
-    size_t i;
+static bool
+qemuDomainGetStatsNeedMonitor(unsigned int stats)
+{
+    size_t i;
+
+    for (i = 0; qemuDomainGetStatsWorkers[i].func; i++)
+        if (stats & qemuDomainGetStatsWorkers[i].stats &&
+            qemuDomainGetStatsWorkers[i].monitor)
+            return true;
+
+    return false;
+}
+
+
+/**
+ * qemuDomainGetStatsCacheGet:
+ * @dom: domain object
+ * @idx: index of the stats worker in qemuDomainGetStatsWorkers
+ * @now: current time in milliseconds
+ * @maxAge: maximum age of cached stats in milliseconds
+ * @flags: qemuDomainStatsFlags
+ *
+ * Returns the cache entry of @dom for the stats group collected by
+ * worker @idx if it is younger than @maxAge and was collected
+ * according to @flags, NULL otherwise.
+ */
+static qemuDomainStatsCacheEntryPtr
+qemuDomainGetStatsCacheGet(virDomainObjPtr dom,
+                           size_t idx,
+                           unsigned long long now,
+                           unsigned int maxAge,
+                           unsigned int flags)
+{
+    qemuDomainObjPrivatePtr priv = dom->privateData;
+    qemuDomainStatsCacheEntryPtr entry;
+
+    if (!priv->statsCache || idx >= priv->nstatsCache)
+        return NULL;
+
+    entry = &priv->statsCache[idx];
+
+    if (entry->timestamp == 0 ||
+        now < entry->timestamp ||
+        now - entry->timestamp > maxAge)
+        return NULL;
+
+    if (qemuDomainGetStatsWorkers[idx].stats == VIR_DOMAIN_STATS_BLOCK &&
+        entry->backing != !!(flags & QEMU_DOMAIN_STATS_BACKING))
+        return NULL;
+
+    return entry;
+}
+
+
+/**
+ * qemuDomainGetStatsCacheCovers:
+ * @driver: qemu driver
+ * @dom: domain object
+ * @stats: requested stats groups
+ * @flags: qemuDomainStatsFlags
+ *
+ * Returns true if all requested stats groups which need the monitor
+ * can be served from the stats cache, so that there's no need to
+ * acquire a job.
+ */
+static bool
+qemuDomainGetStatsCacheCovers(virQEMUDriverPtr driver,
+                              virDomainObjPtr dom,
+                              unsigned int stats,
+                              unsigned int flags)
+{
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    unsigned long long now;
+    size_t i;
+
+    if (!(flags & QEMU_DOMAIN_STATS_CACHED) ||
+        cfg->statsCacheMaxAge == 0 ||
+        virTimeMillisNow(&now) < 0)
+        return false;
+
+    for (i = 0; qemuDomainGetStatsWorkers[i].func; i++) {
+        if (!(stats & qemuDomainGetStatsWorkers[i].stats) ||
+            !qemuDomainGetStatsWorkers[i].monitor)
+            continue;
+
+        if (!qemuDomainGetStatsCacheGet(dom, i, now, cfg->statsCacheMaxAge,
+                                        flags))
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * qemuDomainGetStatsCollect:
+ * @driver: qemu driver
+ * @dom: domain object
+ * @stats: requested stats groups
+ * @params: list to append collected stats to
+ * @flags: qemuDomainStatsFlags
+ *
+ * Runs the workers of the groups requested by @stats. If
+ * QEMU_DOMAIN_STATS_CACHED is set in @flags, groups which were
+ * collected recently enough are copied from the stats cache instead.
+ * If QEMU_DOMAIN_STATS_UPDATE_CACHE is set, stats collected from a
+ * running domain are stored in the cache. Stats which need the
+ * monitor are only cached if they were collected with a job.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+qemuDomainGetStatsCollect(virQEMUDriverPtr driver,
+                          virDomainObjPtr dom,
+                          unsigned int stats,
+                          virTypedParamListPtr params,
+                          unsigned int flags)
+{
+    qemuDomainObjPrivatePtr priv = dom->privateData;
+    g_autoptr(virQEMUDriverConfig) cfg = NULL;
+    qemuDomainStatsMonData mondata = { 0 };
+    unsigned long long now = 0;
+    unsigned int fetch = 0;
+    size_t i;
+    int ret = -1;
+
+    if (flags & (QEMU_DOMAIN_STATS_CACHED | QEMU_DOMAIN_STATS_UPDATE_CACHE) &&
+        virDomainObjIsActive(dom)) {
+        cfg = virQEMUDriverGetConfig(driver);
+
+        if (cfg->statsCacheMaxAge > 0 &&
+            virTimeMillisNow(&now) < 0)
+            return -1;
+
+        if (now > 0 && !priv->statsCache) {
+            priv->nstatsCache = G_N_ELEMENTS(qemuDomainGetStatsWorkers);
+            priv->statsCache = g_new0(qemuDomainStatsCacheEntry,
+                                      priv->nstatsCache);
+        }
+    }
+
+    /* Fetch the monitor data of all groups which won't be served from
+     * the cache in one go */
+    for (i = 0; qemuDomainGetStatsWorkers[i].func; i++) {
+        if (!(stats & qemuDomainGetStatsWorkers[i].stats))
+            continue;
+
+        if (now > 0 && flags & QEMU_DOMAIN_STATS_CACHED &&
+            qemuDomainGetStatsCacheGet(dom, i, now, cfg->statsCacheMaxAge,
+                                       flags))
+            continue;
+
+        fetch |= qemuDomainGetStatsWorkers[i].stats;
+    }
+
+    qemuDomainGetStatsFetchMonitor(driver, dom, fetch, &mondata, flags);
+
+    for (i = 0; qemuDomainGetStatsWorkers[i].func; i++) {
+        struct qemuDomainGetStatsWorker *worker = &qemuDomainGetStatsWorkers[i];
+        qemuDomainStatsCacheEntryPtr entry;
+        g_autoptr(virTypedParamList) tmp = NULL;
+
+        if (!(stats & worker->stats))
+            continue;
+
+        if (!(fetch & worker->stats) &&
+            (entry = qemuDomainGetStatsCacheGet(dom, i, now,
+                                                cfg->statsCacheMaxAge,
+                                                flags))) {
+            if (virTypedParamListAddParams(params, entry->params,
+                                           entry->nparams) < 0)
+                goto cleanup;
+            continue;
+        }
+
+        if (now == 0 || !(flags & QEMU_DOMAIN_STATS_UPDATE_CACHE) ||
+            (worker->monitor && !HAVE_JOB(flags))) {
+            if (worker->func(driver, dom, &mondata, params, flags) < 0)
+                goto cleanup;
+            continue;
+        }
+
+        if (VIR_ALLOC(tmp) < 0 ||
+            worker->func(driver, dom, &mondata, tmp, flags) < 0)
+            goto cleanup;
+
+        /* the domain might have been stopped while unlocked in the
+         * worker, don't cache anything from a dead domain */
+        if (priv->statsCache && virDomainObjIsActive(dom)) {
+            entry = &priv->statsCache[i];
+
+            qemuDomainStatsCacheClear(entry, 1);
+            if (virTypedParamsCopy(&entry->params, tmp->par, tmp->npar) < 0)
+                goto cleanup;
+            entry->nparams = tmp->npar;
+            entry->timestamp = now;
+            entry->backing = !!(flags & QEMU_DOMAIN_STATS_BACKING);
+        }
+
+        if (virTypedParamListAddParams(params, tmp->par, tmp->npar) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    qemuDomainStatsMonDataClear(&mondata);
+    return ret;
+}
+
+
+static int
+qemuDomainGetStats(virConnectPtr conn,
+                   virDomainObjPtr dom,
+                   unsigned int stats,
+                   virDomainStatsRecordPtr *record,
+                   unsigned int flags)
+{
+    g_autofree virDomainStatsRecordPtr tmp = NULL;
+    g_autoptr(virTypedParamList) params = NULL;
+
+    if (VIR_ALLOC(params) < 0)
+        return -1;
+
+    if (qemuDomainGetStatsCollect(conn->privateData, dom, stats,
+                                  params, flags) < 0)
+        return -1;
+
+    if (VIR_ALLOC(tmp) < 0)
+        return -1;
+
+    if (!(tmp->dom = virGetDomain(conn, dom->def->name,
+                                  dom->def->uuid, dom->def->id)))
+        return -1;
+
+    tmp->nparams = virTypedParamListStealParams(params, &tmp->params);
+    *record = g_steal_pointer(&tmp);
+    return 0;
+}
+
+
+/**
+ * qemuDomainStatsCacheRefresh:
+ * @driver: qemu driver
+ * @vm: domain object
+ *
+ * Collects all stats of @vm into the stats cache. QEMU is only
+ * queried if the domain is not busy with another job.
+ */
+static void
+qemuDomainStatsCacheRefresh(virQEMUDriverPtr driver,
+                            virDomainObjPtr vm)
+{
+    g_autoptr(virTypedParamList) params = NULL;
+    unsigned int stats = 0;
+    unsigned int privflags = QEMU_DOMAIN_STATS_UPDATE_CACHE;
+
+    if (VIR_ALLOC(params) < 0 ||
+        qemuDomainGetStatsCheckSupport(&stats, false) < 0)
+        return;
+
+    virObjectLock(vm);
+
+    if (!virDomainObjIsActive(vm))
+        goto cleanup;
+
+    if (qemuDomainGetStatsNeedMonitor(stats) &&
+        qemuDomainObjBeginSharedQueryJobNowait(driver, vm) == 0)
+        privflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+
+    if (qemuDomainGetStatsCollect(driver, vm, stats, params, privflags) < 0) {
+        VIR_DEBUG("Failed to refresh stats cache of domain %s: %s",
+                  vm->def->name, virGetLastErrorMessage());
+        virResetLastError();
+    }
+
+    if (HAVE_JOB(privflags))
+        qemuDomainObjEndSharedQueryJob(vm);
+
+ cleanup:
+    virObjectUnlock(vm);
+}
+
+
+typedef struct _qemuDomainGetStatsBatch qemuDomainGetStatsBatch;
+typedef qemuDomainGetStatsBatch *qemuDomainGetStatsBatchPtr;
+struct _qemuDomainGetStatsBatch {
+    virMutex lock;
+    virCond cond;
+    size_t pending;
+    virErrorPtr err;
+
+    virConnectPtr conn;
+    bool guestInfo; /* collect guest info of @stats types instead */
+    unsigned int stats;
+    unsigned int flags;
+    unsigned int privflags;
+    virDomainStatsRecordPtr *records;
+};
+
+typedef struct _qemuDomainGetStatsJob qemuDomainGetStatsJob;
+typedef qemuDomainGetStatsJob *qemuDomainGetStatsJobPtr;
+struct _qemuDomainGetStatsJob {
+    qemuDomainGetStatsBatchPtr batch; /* NULL for stats cache refresh */
+    virDomainObjPtr vm;
+    size_t idx;
+};
+
+
+/**
+ * qemuDomainGetStatsOne:
+ * @driver: qemu driver
+ * @conn: connection the stats are collected for
+ * @vm: domain object
+ * @stats: requested stats groups
+ * @record: filled with the collected stats
+ * @flags: virConnectGetAllDomainStatsFlags
+ * @privflags: qemuDomainStatsFlags
+ *
+ * Collects stats of a single domain. If the stats require
+ * monitor access a job is acquired first; if that fails only the
+ * stats which don't need it are returned.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+qemuDomainGetStatsOne(virQEMUDriverPtr driver,
+                      virConnectPtr conn,
+                      virDomainObjPtr vm,
+                      unsigned int stats,
+                      virDomainStatsRecordPtr *record,
+                      unsigned int flags,
+                      unsigned int privflags)
+{
+    g_autoptr(virQEMUDriverConfig) cfg = NULL;
+    unsigned int domflags = 0;
+    int ret = -1;
+
+    virObjectLock(vm);
+
+    if (HAVE_JOB(privflags) &&
+        !qemuDomainGetStatsCacheCovers(driver, vm, stats, privflags)) {
+        int rv;
+
+        /* Stats workers only read from the monitor so concurrent
+         * callers don't have to wait for each other. */
+        if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT) {
+            rv = qemuDomainObjBeginSharedQueryJobNowait(driver, vm);
+        } else if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_PARALLEL) {
+            cfg = virQEMUDriverGetConfig(driver);
+            rv = qemuDomainObjBeginSharedQueryJobTimeout(driver, vm,
+                                                         cfg->statsJobTimeout);
+            /* A busy domain must not fail the whole batch, report
+             * the stats we can get without a job instead. */
+            if (rv < 0)
+                virResetLastError();
+        } else {
+            rv = qemuDomainObjBeginSharedQueryJob(driver, vm);
+        }
+
+        if (rv == 0)
+            domflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+    }
+    /* else: without a job it's still possible to gather some data */
+
+    if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING)
+        domflags |= QEMU_DOMAIN_STATS_BACKING;
+    domflags |= privflags & (QEMU_DOMAIN_STATS_CACHED |
+                             QEMU_DOMAIN_STATS_UPDATE_CACHE);
+
+    ret = qemuDomainGetStats(conn, vm, stats, record, domflags);
+
+    if (HAVE_JOB(domflags))
+        qemuDomainObjEndSharedQueryJob(vm);
+
+    virObjectUnlock(vm);
+    return ret;
+}
+
+
+static void
+qemuDomainGetStatsJobFunc(void *jobdata,
+                          void *opaque)
+{
+    virQEMUDriverPtr driver = opaque;
+    qemuDomainGetStatsJobPtr job = jobdata;
+    qemuDomainGetStatsBatchPtr batch = job->batch;
+    virDomainStatsRecordPtr record = NULL;
+    virErrorPtr err = NULL;
+    int rc;
+
+    if (!batch) {
+        qemuDomainStatsCacheRefresh(driver, job->vm);
+        virObjectUnref(job->vm);
+        g_free(job);
+        return;
+    }
+
+    if (batch->guestInfo)
+        rc = qemuDomainGetGuestInfoRecord(driver, batch->conn, job->vm,
+                                          batch->stats, &record);
+    else
+        rc = qemuDomainGetStatsOne(driver, batch->conn, job->vm, batch->stats,
+                                   &record, batch->flags, batch->privflags);
+
+    if (rc < 0)
+        virErrorPreserveLast(&err);
+
+    virMutexLock(&batch->lock);
+    batch->records[job->idx] = record;
+    if (err && !batch->err)
+        batch->err = g_steal_pointer(&err);
+    if (--batch->pending == 0)
+        virCondSignal(&batch->cond);
+    virMutexUnlock(&batch->lock);
+
+    virFreeError(err);
+    g_free(job);
+}
+
+
+/**
+ * qemuDomainGetStatsParallel:
+ * @driver: qemu driver
+ * @conn: connection the stats are collected for
+ * @vms: domain objects to collect stats for
+ * @nvms: number of items in @vms
+ * @guestInfo: collect guest info instead of stats
+ * @stats: requested stats groups, or virDomainGuestInfoTypes
+ * @records: array of @nvms items filled with the collected stats
+ * @flags: virConnectGetAllDomainStatsFlags
+ * @privflags: qemuDomainStatsFlags
+ *
+ * Spreads collecting stats of @vms across the stats worker pool
+ * and waits until all domains were processed. Records are stored
+ * in @records at the index of their domain in @vms. If @guestInfo
+ * is true the records hold the guest info of the domains as
+ * returned by virDomainGetGuestInfo, @flags and @privflags are
+ * ignored then.
+ *
+ * Returns 0 on success, -1 if collecting stats of any domain failed.
+ */
+static int
+qemuDomainGetStatsParallel(virQEMUDriverPtr driver,
+                           virConnectPtr conn,
+                           virDomainObjPtr *vms,
+                           size_t nvms,
+                           bool guestInfo,
+                           unsigned int stats,
+                           virDomainStatsRecordPtr *records,
+                           unsigned int flags,
+                           unsigned int privflags)
+{
+    qemuDomainGetStatsBatch batch = { 0 };
+    size_t i;
+    int ret = -1;
+
+    if (virMutexInit(&batch.lock) < 0) {
+        virReportSystemError(errno, "%s", _("cannot initialize mutex"));
+        return -1;
+    }
+
+    if (virCondInit(&batch.cond) < 0) {
+        virReportSystemError(errno, "%s", _("cannot initialize condition"));
+        virMutexDestroy(&batch.lock);
+        return -1;
+    }
+
+    batch.conn = conn;
+    batch.guestInfo = guestInfo;
+    batch.stats = stats;
+    batch.flags = flags;
+    batch.privflags = privflags;
+    batch.records = records;
+
+    virMutexLock(&batch.lock);
+    for (i = 0; i < nvms; i++) {
+        qemuDomainGetStatsJobPtr job = g_new0(qemuDomainGetStatsJob, 1);
+
+        job->batch = &batch;
+        job->vm = vms[i];
+        job->idx = i;
+
+        if (virThreadPoolSendJob(driver->statsPool, 0, job) < 0) {
+            g_free(job);
+            if (!batch.err)
+                virErrorPreserveLast(&batch.err);
+            break;
+        }
+
+        batch.pending++;
+    }
+
+    /* the workers reference @batch, so wait for all of them even
+     * if submitting some of the jobs failed */
+    while (batch.pending > 0)
+        ignore_value(virCondWait(&batch.cond, &batch.lock));
+    virMutexUnlock(&batch.lock);
 
-    for (i = 0; qemuDomainGetStatsWorkers[i].func; i++)
-        if (stats & qemuDomainGetStatsWorkers[i].stats &&
-            qemuDomainGetStatsWorkers[i].monitor)
-            return true;
+    if (batch.err)
+        virErrorRestore(&batch.err);
+    else
+        ret = 0;
 
-    return false;
+    virCondDestroy(&batch.cond);
+    virMutexDestroy(&batch.lock);
+    return ret;
 }
 
 
 static int
-qemuDomainGetStats(virConnectPtr conn,
-                   virDomainObjPtr dom,
-                   unsigned int stats,
-                   virDomainStatsRecordPtr *record,
-                   unsigned int flags)
+qemuDomainStatsCacheRefreshOne(virDomainObjPtr vm,
+                               void *opaque)
 {
-    g_autofree virDomainStatsRecordPtr tmp = NULL;
-    g_autoptr(virTypedParamList) params = NULL;
-    size_t i;
+    virQEMUDriverPtr driver = opaque;
+    qemuDomainGetStatsJobPtr job = g_new0(qemuDomainGetStatsJob, 1);
 
-    if (VIR_ALLOC(params) < 0)
-        return -1;
+    job->vm = virObjectRef(vm);
 
-    for (i = 0; qemuDomainGetStatsWorkers[i].func; i++) {
-        if (stats & qemuDomainGetStatsWorkers[i].stats) {
-            if (qemuDomainGetStatsWorkers[i].func(conn->privateData, dom, params,
-                                                  flags) < 0)
-                return -1;
-        }
+    if (virThreadPoolSendJob(driver->statsPool, 0, job) < 0) {
+        virObjectUnref(vm);
+        g_free(job);
+        return -1;
     }
 
-    if (VIR_ALLOC(tmp) < 0)
-        return -1;
+    return 0;
+}
 
-    if (!(tmp->dom = virGetDomain(conn, dom->def->name,
-                                  dom->def->uuid, dom->def->id)))
-        return -1;
 
-    tmp->nparams = virTypedParamListStealParams(params, &tmp->params);
-    *record = g_steal_pointer(&tmp);
-    return 0;
+static void
+qemuDomainStatsCacheTimer(int timer G_GNUC_UNUSED,
+                          void *opaque)
+{
+    virQEMUDriverPtr driver = opaque;
+
+    /* Don't pile up refreshes if the previous round didn't finish yet */
+    if (virThreadPoolGetJobQueueDepth(driver->statsPool) > 0)
+        return;
+
+    if (virDomainObjListForEach(driver->domains, false,
+                                qemuDomainStatsCacheRefreshOne, driver) < 0) {
+        VIR_WARN("Failed to schedule stats cache refresh: %s",
+                 virGetLastErrorMessage());
+        virResetLastError();
+    }
 }
 
 
@@ -21744,9 +23194,9 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
                              unsigned int flags)
 {
     virQEMUDriverPtr driver = conn->privateData;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
     virErrorPtr orig_err = NULL;
     virDomainObjPtr *vms = NULL;
-    virDomainObjPtr vm;
     size_t nvms;
     virDomainStatsRecordPtr *tmpstats = NULL;
     bool enforce = !!(flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS);
@@ -21754,7 +23204,6 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     size_t i;
     int ret = -1;
     unsigned int privflags = 0;
-    unsigned int domflags = 0;
     unsigned int lflags = flags & (VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE |
                                    VIR_CONNECT_LIST_DOMAINS_FILTERS_PERSISTENT |
                                    VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE);
@@ -21762,6 +23211,8 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     virCheckFlags(VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE |
                   VIR_CONNECT_LIST_DOMAINS_FILTERS_PERSISTENT |
                   VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE |
+                  VIR_CONNECT_GET_ALL_DOMAINS_STATS_CACHED |
+                  VIR_CONNECT_GET_ALL_DOMAINS_STATS_PARALLEL |
                   VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT |
                   VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING |
                   VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS, -1);
@@ -21790,43 +23241,45 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     if (qemuDomainGetStatsNeedMonitor(stats))
         privflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
 
-    for (i = 0; i < nvms; i++) {
-        virDomainStatsRecordPtr tmp = NULL;
-        domflags = 0;
-        vm = vms[i];
+    if (cfg->statsCacheMaxAge > 0) {
+        privflags |= QEMU_DOMAIN_STATS_UPDATE_CACHE;
+        if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_CACHED)
+            privflags |= QEMU_DOMAIN_STATS_CACHED;
+    }
 
-        virObjectLock(vm);
+    if (stats & VIR_DOMAIN_STATS_INTERFACE && nvms > 1) {
+        qemuDomainGetStatsNetRefresh(driver);
+        privflags |= QEMU_DOMAIN_STATS_NET_SNAPSHOT;
+    }
 
-        if (HAVE_JOB(privflags)) {
-            int rv;
+    if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_PARALLEL &&
+        driver->statsPool && nvms > 1) {
+        int rc = qemuDomainGetStatsParallel(driver, conn, vms, nvms, false,
+                                            stats, tmpstats, flags, privflags);
 
-            if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT)
-                rv = qemuDomainObjBeginJobNowait(driver, vm, QEMU_JOB_QUERY);
-            else
-                rv = qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY);
+        /* squash the array so that it's NULL terminated even if the
+         * stats of some domains are missing */
+        for (i = 0; i < nvms; i++) {
+            virDomainStatsRecordPtr tmp = tmpstats[i];
 
-            if (rv == 0)
-                domflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+            tmpstats[i] = NULL;
+            if (tmp)
+                tmpstats[nstats++] = tmp;
         }
-        /* else: without a job it's still possible to gather some data */
-
-        if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING)
-            domflags |= QEMU_DOMAIN_STATS_BACKING;
-        if (qemuDomainGetStats(conn, vm, stats, &tmp, domflags) < 0) {
-            if (HAVE_JOB(domflags) && vm)
-                qemuDomainObjEndJob(driver, vm);
 
-            virObjectUnlock(vm);
+        if (rc < 0)
             goto cleanup;
-        }
-
-        if (tmp)
-            tmpstats[nstats++] = tmp;
+    } else {
+        for (i = 0; i < nvms; i++) {
+            virDomainStatsRecordPtr tmp = NULL;
 
-        if (HAVE_JOB(domflags))
-            qemuDomainObjEndJob(driver, vm);
+            if (qemuDomainGetStatsOne(driver, conn, vms[i], stats, &tmp,
+                                      flags, privflags) < 0)
+                goto cleanup;
 
-        virObjectUnlock(vm);
+            if (tmp)
+                tmpstats[nstats++] = tmp;
+        }
     }
 
     *retStats = tmpstats;
@@ -21844,6 +23297,90 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
 }
 
 
+static int
+qemuConnectGetAllDomainXML(virConnectPtr conn,
+                           virDomainPtr *doms,
+                           unsigned int ndoms,
+                           unsigned int xmlflags,
+                           virDomainXMLRecordPtr **records,
+                           unsigned int flags)
+{
+    virQEMUDriverPtr driver = conn->privateData;
+    virErrorPtr orig_err = NULL;
+    virDomainObjPtr *vms = NULL;
+    size_t nvms = 0;
+    virDomainXMLRecordPtr *tmprecords = NULL;
+    int nrecords = 0;
+    size_t i;
+    int ret = -1;
+
+    virCheckFlags(VIR_CONNECT_LIST_DOMAINS_FILTERS_ALL, -1);
+
+    if (xmlflags & ~(VIR_DOMAIN_XML_COMMON_FLAGS | VIR_DOMAIN_XML_UPDATE_CPU)) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("unsupported XML flags 0x%x"), xmlflags);
+        return -1;
+    }
+
+    if (virConnectGetAllDomainXMLEnsureACL(conn) < 0)
+        return -1;
+
+    /* The ACL check depends on @xmlflags, which virDomainObjListACLFilter
+     * can't pass, hence it's done below for every domain instead */
+    if (ndoms) {
+        if (virDomainObjListConvert(driver->domains, conn, doms, ndoms, &vms,
+                                    &nvms, NULL, flags, true) < 0)
+            return -1;
+    } else {
+        if (virDomainObjListCollect(driver->domains, conn, &vms, &nvms,
+                                    NULL, flags) < 0)
+            return -1;
+    }
+
+    if (VIR_ALLOC_N(tmprecords, nvms + 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nvms; i++) {
+        virDomainObjPtr vm = vms[i];
+        virDomainXMLRecordPtr tmp = NULL;
+
+        virObjectLock(vm);
+
+        if (!virConnectGetAllDomainXMLCheckACL(conn, vm->def, xmlflags)) {
+            virObjectUnlock(vm);
+            continue;
+        }
+
+        if (VIR_ALLOC(tmp) < 0 ||
+            !(tmp->xml = qemuDomainObjGetXMLDesc(driver, vm, xmlflags)) ||
+            !(tmp->dom = virGetDomain(conn, vm->def->name,
+                                      vm->def->uuid, vm->def->id))) {
+            virObjectUnlock(vm);
+            if (tmp)
+                VIR_FREE(tmp->xml);
+            VIR_FREE(tmp);
+            goto cleanup;
+        }
+
+        tmp->state = virDomainObjGetState(vm, &tmp->reason);
+        virObjectUnlock(vm);
+
+        tmprecords[nrecords++] = tmp;
+    }
+
+    *records = g_steal_pointer(&tmprecords);
+    ret = nrecords;
+
+ cleanup:
+    virErrorPreserveLast(&orig_err);
+    virDomainXMLRecordListFree(tmprecords);
+    virObjectListFreeCount(vms, nvms);
+    virErrorRestore(&orig_err);
+
+    return ret;
+}
+
+
 static int
 qemuNodeAllocPages(virConnectPtr conn,
                    unsigned int npages,
@@ -22959,36 +24496,59 @@ qemuAgentFSInfoFormatParams(qemuAgentFSInfoPtr *fsinfo,
 }
 
 
+/**
+ * qemuDomainGetGuestInfoCollect:
+ * @driver: qemu driver
+ * @vm: locked domain object
+ * @types: requested virDomainGuestInfoTypes, 0 for all supported
+ * @params: filled with the guest info
+ * @nparams: number of items in @params
+ * @timeout: maximum time in seconds to spend on @vm, -1 for no limit
+ *
+ * Queries the guest agent of @vm for the info requested by @types.
+ * Unless @timeout is -1 both waiting for jobs and for the agent
+ * replies is limited so that a single stuck agent can't hold up
+ * collecting the info of other domains.
+ *
+ * Returns 0 on success, -1 on error.
+ */
 static int
-qemuDomainGetGuestInfo(virDomainPtr dom,
-                       unsigned int types,
-                       virTypedParameterPtr *params,
-                       int *nparams,
-                       unsigned int flags)
+qemuDomainGetGuestInfoCollect(virQEMUDriverPtr driver,
+                              virDomainObjPtr vm,
+                              unsigned int types,
+                              virTypedParameterPtr *params,
+                              int *nparams,
+                              int timeout)
 {
-    virQEMUDriverPtr driver = dom->conn->privateData;
-    virDomainObjPtr vm = NULL;
     qemuAgentPtr agent;
     int ret = -1;
     int maxparams = 0;
     g_autofree char *hostname = NULL;
     unsigned int supportedTypes = types;
+    unsigned long long now = 0;
+    unsigned long long then = 0;
     int rc;
     size_t nfs = 0;
     qemuAgentFSInfoPtr *agentfsinfo = NULL;
+    const char *cmdnames[5];
+    size_t ncmdnames = 0;
     size_t i;
 
-    virCheckFlags(0, -1);
     qemuDomainGetGuestInfoCheckSupport(&supportedTypes);
 
-    if (!(vm = qemuDomainObjFromDomain(dom)))
-        goto cleanup;
+    if (timeout >= 0) {
+        if (virTimeMillisNow(&now) < 0)
+            return -1;
+        then = now + timeout * 1000ull;
 
-    if (virDomainGetGuestInfoEnsureACL(dom->conn, vm->def) < 0)
-        goto cleanup;
+        rc = qemuDomainObjBeginAgentJobTimeout(driver, vm,
+                                               QEMU_AGENT_JOB_QUERY,
+                                               timeout * 1000ull);
+    } else {
+        rc = qemuDomainObjBeginAgentJob(driver, vm, QEMU_AGENT_JOB_QUERY);
+    }
 
-    if (qemuDomainObjBeginAgentJob(driver, vm,
-                                   QEMU_AGENT_JOB_QUERY) < 0)
+    if (rc < 0)
         goto cleanup;
 
     if (!qemuDomainAgentAvailable(vm, true))
@@ -22996,6 +24556,35 @@ qemuDomainGetGuestInfo(virDomainPtr dom,
 
     agent = qemuDomainObjEnterAgent(vm);
 
+    /* Send all the queries at once instead of waiting for each of them */
+    if (supportedTypes & VIR_DOMAIN_GUEST_INFO_USERS)
+        cmdnames[ncmdnames++] = "guest-get-users";
+    if (supportedTypes & VIR_DOMAIN_GUEST_INFO_OS)
+        cmdnames[ncmdnames++] = "guest-get-osinfo";
+    if (supportedTypes & VIR_DOMAIN_GUEST_INFO_TIMEZONE)
+        cmdnames[ncmdnames++] = "guest-get-timezone";
+    if (supportedTypes & VIR_DOMAIN_GUEST_INFO_HOSTNAME)
+        cmdnames[ncmdnames++] = "guest-get-host-name";
+    if (supportedTypes & VIR_DOMAIN_GUEST_INFO_FILESYSTEM)
+        cmdnames[ncmdnames++] = "guest-get-fsinfo";
+
+    if (timeout >= 0) {
+        /* Prefetching even a single reply bounds the wait for it by
+         * what's left of @timeout rather than by the agent timeout */
+        int seconds = 1;
+
+        ignore_value(virTimeMillisNow(&now));
+        if (then > now)
+            seconds = MAX(1, (then - now) / 1000);
+
+        if (qemuAgentPrefetch(agent, cmdnames, ncmdnames, seconds) < 0)
+            goto exitagent;
+    } else if (ncmdnames > 1 &&
+               qemuAgentPrefetch(agent, cmdnames, ncmdnames,
+                                 VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT) < 0) {
+        goto exitagent;
+    }
+
     /* The agent info commands will return -2 for any commands that are not
      * supported by the agent, or -1 for all other errors. In the case where no
      * categories were explicitly requested (i.e. 'types' is 0), ignore
@@ -23039,13 +24628,22 @@ qemuDomainGetGuestInfo(virDomainPtr dom,
     ret = 0;
 
  exitagent:
+    qemuAgentPrefetchClear(agent);
     qemuDomainObjExitAgent(vm, agent);
 
  endagentjob:
     qemuDomainObjEndAgentJob(vm);
 
     if (nfs > 0) {
-        if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY) < 0)
+        if (timeout >= 0) {
+            ignore_value(virTimeMillisNow(&now));
+            rc = qemuDomainObjBeginJobTimeout(driver, vm, QEMU_JOB_QUERY,
+                                              then > now ? then - now : 0);
+        } else {
+            rc = qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY);
+        }
+
+        if (rc < 0)
             goto cleanup;
 
         if (virDomainObjCheckActive(vm) < 0)
@@ -23064,11 +24662,185 @@ qemuDomainGetGuestInfo(virDomainPtr dom,
         qemuAgentFSInfoFree(agentfsinfo[i]);
     g_free(agentfsinfo);
 
+    return ret;
+}
+
+
+static int
+qemuDomainGetGuestInfo(virDomainPtr dom,
+                       unsigned int types,
+                       virTypedParameterPtr *params,
+                       int *nparams,
+                       unsigned int flags)
+{
+    virQEMUDriverPtr driver = dom->conn->privateData;
+    virDomainObjPtr vm = NULL;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    if (!(vm = qemuDomainObjFromDomain(dom)))
+        goto cleanup;
+
+    if (virDomainGetGuestInfoEnsureACL(dom->conn, vm->def) < 0)
+        goto cleanup;
+
+    ret = qemuDomainGetGuestInfoCollect(driver, vm, types,
+                                        params, nparams, -1);
+
+ cleanup:
     virDomainObjEndAPI(&vm);
     return ret;
 }
 
 
+/**
+ * qemuDomainGetGuestInfoRecord:
+ * @driver: qemu driver
+ * @conn: connection the guest info is collected for
+ * @vm: domain object
+ * @types: requested virDomainGuestInfoTypes, 0 for all supported
+ * @record: filled with the collected guest info
+ *
+ * Collects the guest info of @vm unless it's inactive, in which case
+ * @record is left NULL. The time spent on @vm is limited by the
+ * guest_info_timeout config option. If the guest agent can't be
+ * queried the record doesn't contain any info so that a single
+ * broken guest doesn't fail the whole call.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+qemuDomainGetGuestInfoRecord(virQEMUDriverPtr driver,
+                             virConnectPtr conn,
+                             virDomainObjPtr vm,
+                             unsigned int types,
+                             virDomainStatsRecordPtr *record)
+{
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    virDomainStatsRecordPtr tmp = NULL;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    int ret = -1;
+
+    *record = NULL;
+
+    virObjectLock(vm);
+
+    if (!virDomainObjIsActive(vm)) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (qemuDomainGetGuestInfoCollect(driver, vm, types, &params, &nparams,
+                                      cfg->guestInfoTimeout) < 0) {
+        VIR_DEBUG("Failed to get guest info of domain '%s': %s",
+                  vm->def->name, virGetLastErrorMessage());
+        virResetLastError();
+        virTypedParamsFree(params, nparams);
+        params = NULL;
+        nparams = 0;
+    }
+
+    tmp = g_new0(virDomainStatsRecord, 1);
+
+    if (!(tmp->dom = virGetDomain(conn, vm->def->name,
+                                  vm->def->uuid, vm->def->id)))
+        goto cleanup;
+
+    tmp->params = g_steal_pointer(&params);
+    tmp->nparams = nparams;
+    *record = g_steal_pointer(&tmp);
+    ret = 0;
+
+ cleanup:
+    virTypedParamsFree(params, nparams);
+    VIR_FREE(tmp);
+    virObjectUnlock(vm);
+    return ret;
+}
+
+
+static int
+qemuConnectGetAllDomainGuestInfo(virConnectPtr conn,
+                                 virDomainPtr *doms,
+                                 unsigned int ndoms,
+                                 unsigned int types,
+                                 virDomainStatsRecordPtr **retInfo,
+                                 unsigned int flags)
+{
+    virQEMUDriverPtr driver = conn->privateData;
+    virErrorPtr orig_err = NULL;
+    virDomainObjPtr *vms = NULL;
+    size_t nvms = 0;
+    virDomainStatsRecordPtr *tmpinfo = NULL;
+    int ninfo = 0;
+    size_t i;
+    int ret = -1;
+
+    virCheckFlags(VIR_CONNECT_LIST_DOMAINS_FILTERS_ALL, -1);
+
+    if (virConnectGetAllDomainGuestInfoEnsureACL(conn) < 0)
+        return -1;
+
+    if (ndoms) {
+        if (virDomainObjListConvert(driver->domains, conn, doms, ndoms, &vms,
+                                    &nvms, virConnectGetAllDomainGuestInfoCheckACL,
+                                    flags, true) < 0)
+            return -1;
+    } else {
+        if (virDomainObjListCollect(driver->domains, conn, &vms, &nvms,
+                                    virConnectGetAllDomainGuestInfoCheckACL,
+                                    flags) < 0)
+            return -1;
+    }
+
+    tmpinfo = g_new0(virDomainStatsRecordPtr, nvms + 1);
+
+    /* Guest agents reply slowly compared to QEMU, so use the stats
+     * workers whenever there's more than one domain to ask */
+    if (driver->statsPool && nvms > 1) {
+        int rc = qemuDomainGetStatsParallel(driver, conn, vms, nvms, true,
+                                            types, tmpinfo, 0, 0);
+
+        /* squash the array so that it's NULL terminated even if
+         * some domains are missing */
+        for (i = 0; i < nvms; i++) {
+            virDomainStatsRecordPtr tmp = tmpinfo[i];
+
+            tmpinfo[i] = NULL;
+            if (tmp)
+                tmpinfo[ninfo++] = tmp;
+        }
+
+        if (rc < 0)
+            goto cleanup;
+    } else {
+        for (i = 0; i < nvms; i++) {
+            virDomainStatsRecordPtr tmp = NULL;
+
+            if (qemuDomainGetGuestInfoRecord(driver, conn, vms[i],
+                                             types, &tmp) < 0)
+                goto cleanup;
+
+            if (tmp)
+                tmpinfo[ninfo++] = tmp;
+        }
+    }
+
+    *retInfo = g_steal_pointer(&tmpinfo);
+    ret = ninfo;
+
+ cleanup:
+    virErrorPreserveLast(&orig_err);
+    virDomainStatsRecordListFree(tmpinfo);
+    virObjectListFreeCount(vms, nvms);
+    virErrorRestore(&orig_err);
+
+    return ret;
+}
+
+
 static int
 qemuDomainAgentSetResponseTimeout(virDomainPtr dom,
                                   int timeout,
@@ -23362,6 +25134,15 @@ static virHypervisorDriver qemuHypervisorDriver = {
     .domainAgentSetResponseTimeout = qemuDomainAgentSetResponseTimeout, /* 5.10.0 */
     .domainBackupBegin = qemuDomainBackupBegin, /* 6.0.0 */
     .domainBackupGetXMLDesc = qemuDomainBackupGetXMLDesc, /* 6.0.0 */
+    .domainMigratePrepareTunnelStripe = qemuDomainMigratePrepareTunnelStripe, /* 6.2.0 */
+    .connectGetAllDomainXML = qemuConnectGetAllDomainXML, /* 6.2.0 */
+    .domainAttachDeviceList = qemuDomainAttachDeviceList, /* 6.2.0 */
+    .domainDetachDeviceList = qemuDomainDetachDeviceList, /* 6.2.0 */
+    .connectGetAllDomainGuestInfo = qemuConnectGetAllDomainGuestInfo, /* 6.2.0 */
+    .nodeGetMigrationParameters = qemuNodeGetMigrationParameters, /* 6.2.0 */
+    .nodeSetMigrationParameters = qemuNodeSetMigrationParameters, /* 6.2.0 */
+    .domainBlockPeekStream = qemuDomainBlockPeekStream, /* 6.2.0 */
+    .domainMemoryPeekStream = qemuDomainMemoryPeekStream, /* 6.2.0 */
 };
 
 
@@ -23378,6 +25159,7 @@ static virStateDriver qemuStateDriver = {
     .stateCleanup = qemuStateCleanup,
     .stateReload = qemuStateReload,
     .stateStop = qemuStateStop,
+    .stateGetReconnectInfo = qemuStateGetReconnectInfo,
 };
 
 int qemuRegister(void)
@@ -161,6 +161,110 @@ qemuExtDevicesCleanupHost(virQEMUDriverPtr driver,
 }
 
 
+typedef enum {
+    QEMU_EXT_DEVICES_START_VHOST_USER_GPU,
+    QEMU_EXT_DEVICES_START_TPM,
+    QEMU_EXT_DEVICES_START_SLIRP,
+    QEMU_EXT_DEVICES_START_VIRTIOFS,
+} qemuExtDevicesStartType;
+
+typedef struct _qemuExtDevicesStartJob qemuExtDevicesStartJob;
+typedef qemuExtDevicesStartJob *qemuExtDevicesStartJobPtr;
+struct _qemuExtDevicesStartJob {
+    virQEMUDriverPtr driver;
+    virDomainObjPtr vm;
+    virLogManagerPtr logManager;
+    bool incomingMigration;
+
+    qemuExtDevicesStartType type;
+    size_t idx;     /* device index, unused for TPM and slirp */
+
+    virThread thread;
+    bool threaded;
+    int ret;
+    virErrorPtr err;
+    unsigned long long usecs; /* time it took to start the helper */
+};
+
+
+static const qemuDomainJobTiming qemuExtDevicesStartTiming[] = {
+    [QEMU_EXT_DEVICES_START_VHOST_USER_GPU] = QEMU_DOMAIN_JOB_TIMING_EXT_VHOST_USER_GPU,
+    [QEMU_EXT_DEVICES_START_TPM] = QEMU_DOMAIN_JOB_TIMING_EXT_TPM,
+    [QEMU_EXT_DEVICES_START_SLIRP] = QEMU_DOMAIN_JOB_TIMING_EXT_SLIRP,
+    [QEMU_EXT_DEVICES_START_VIRTIOFS] = QEMU_DOMAIN_JOB_TIMING_EXT_VIRTIOFS,
+};
+
+
+static int
+qemuExtDevicesStartOne(qemuExtDevicesStartJobPtr job)
+{
+    virDomainDefPtr def = job->vm->def;
+    size_t i;
+
+    switch (job->type) {
+    case QEMU_EXT_DEVICES_START_VHOST_USER_GPU:
+        return qemuExtVhostUserGPUStart(job->driver, job->vm,
+                                        def->videos[job->idx]);
+
+    case QEMU_EXT_DEVICES_START_TPM:
+        return qemuExtTPMStart(job->driver, job->vm, job->incomingMigration);
+
+    case QEMU_EXT_DEVICES_START_SLIRP:
+        /* The slirp helpers share the domain's D-Bus daemon, so they
+         * are started one after another */
+        for (i = 0; i < def->nnets; i++) {
+            virDomainNetDefPtr net = def->nets[i];
+            qemuSlirpPtr slirp = QEMU_DOMAIN_NETWORK_PRIVATE(net)->slirp;
+
+            if (slirp &&
+                qemuSlirpStart(slirp, job->vm, job->driver, net, false,
+                               job->incomingMigration) < 0)
+                return -1;
+        }
+        return 0;
+
+    case QEMU_EXT_DEVICES_START_VIRTIOFS:
+        return qemuVirtioFSStart(job->logManager, job->driver, job->vm,
+                                 def->fss[job->idx]);
+    }
+
+    return 0;
+}
+
+
+static void
+qemuExtDevicesStartThread(void *opaque)
+{
+    qemuExtDevicesStartJobPtr job = opaque;
+    unsigned long long start = g_get_monotonic_time();
+
+    if ((job->ret = qemuExtDevicesStartOne(job)) < 0)
+        job->err = virSaveLastError();
+
+    job->usecs = g_get_monotonic_time() - start;
+}
+
+
+static void
+qemuExtDevicesStartJobAdd(qemuExtDevicesStartJobPtr jobs,
+                          size_t *njobs,
+                          qemuExtDevicesStartType type,
+                          size_t idx)
+{
+    jobs[*njobs].type = type;
+    jobs[*njobs].idx = idx;
+    (*njobs)++;
+}
+
+
+/*
+ * qemuExtDevicesStart:
+ *
+ * Start the helper processes of all external devices. The helpers don't
+ * depend on each other, so if there is more than one to start, each of
+ * them is started from its own thread. The domain object stays locked by
+ * the caller all the time.
+ */
 int
 qemuExtDevicesStart(virQEMUDriverPtr driver,
                     virDomainObjPtr vm,
@@ -168,42 +272,80 @@ qemuExtDevicesStart(virQEMUDriverPtr driver,
                     bool incomingMigration)
 {
     virDomainDefPtr def = vm->def;
+    g_autofree qemuExtDevicesStartJobPtr jobs = NULL;
+    size_t njobs = 0;
+    bool slirp = false;
     size_t i;
+    int ret = 0;
 
     if (qemuExtDevicesInitPaths(driver, def) < 0)
         return -1;
 
-    for (i = 0; i < def->nvideos; i++) {
-        virDomainVideoDefPtr video = def->videos[i];
+    jobs = g_new0(qemuExtDevicesStartJob, def->nvideos + def->nfss + 2);
 
-        if (video->backend == VIR_DOMAIN_VIDEO_BACKEND_TYPE_VHOSTUSER) {
-            if (qemuExtVhostUserGPUStart(driver, vm, video) < 0)
-                return -1;
-        }
+    for (i = 0; i < def->nvideos; i++) {
+        if (def->videos[i]->backend == VIR_DOMAIN_VIDEO_BACKEND_TYPE_VHOSTUSER)
+            qemuExtDevicesStartJobAdd(jobs, &njobs,
+                                      QEMU_EXT_DEVICES_START_VHOST_USER_GPU, i);
     }
 
-    if (def->tpm && qemuExtTPMStart(driver, vm, incomingMigration) < 0)
-        return -1;
+    if (def->tpm)
+        qemuExtDevicesStartJobAdd(jobs, &njobs, QEMU_EXT_DEVICES_START_TPM, 0);
 
     for (i = 0; i < def->nnets; i++) {
-        virDomainNetDefPtr net = def->nets[i];
-        qemuSlirpPtr slirp = QEMU_DOMAIN_NETWORK_PRIVATE(net)->slirp;
-
-        if (slirp &&
-            qemuSlirpStart(slirp, vm, driver, net, false, incomingMigration) < 0)
-            return -1;
+        if (QEMU_DOMAIN_NETWORK_PRIVATE(def->nets[i])->slirp)
+            slirp = true;
     }
+    if (slirp)
+        qemuExtDevicesStartJobAdd(jobs, &njobs, QEMU_EXT_DEVICES_START_SLIRP, 0);
 
     for (i = 0; i < def->nfss; i++) {
-        virDomainFSDefPtr fs = def->fss[i];
+        if (def->fss[i]->fsdriver == VIR_DOMAIN_FS_DRIVER_TYPE_VIRTIOFS)
+            qemuExtDevicesStartJobAdd(jobs, &njobs,
+                                      QEMU_EXT_DEVICES_START_VIRTIOFS, i);
+    }
 
-        if (fs->fsdriver == VIR_DOMAIN_FS_DRIVER_TYPE_VIRTIOFS) {
-            if (qemuVirtioFSStart(logManager, driver, vm, fs) < 0)
-                return -1;
+    for (i = 0; i < njobs; i++) {
+        jobs[i].driver = driver;
+        jobs[i].vm = vm;
+        jobs[i].logManager = logManager;
+        jobs[i].incomingMigration = incomingMigration;
+    }
+
+    if (njobs == 1)
+        qemuExtDevicesStartThread(&jobs[0]);
+
+    for (i = 0; njobs > 1 && i < njobs; i++) {
+        if (virThreadCreateFull(&jobs[i].thread, true,
+                                qemuExtDevicesStartThread,
+                                "qemu-ext-start", false, &jobs[i]) == 0) {
+            jobs[i].threaded = true;
+            continue;
         }
+
+        VIR_DEBUG("Unable to create thread, starting helper %zu directly", i);
+        qemuExtDevicesStartThread(&jobs[i]);
     }
 
-    return 0;
+    for (i = 0; i < njobs; i++) {
+        if (jobs[i].threaded)
+            virThreadJoin(&jobs[i].thread);
+    }
+
+    /* Account the time of each helper and report the first failure, the
+     * caller stops all the helpers */
+    for (i = 0; i < njobs; i++) {
+        qemuDomainJobTimingAdd(vm, qemuExtDevicesStartTiming[jobs[i].type],
+                               jobs[i].usecs);
+
+        if (jobs[i].ret < 0 && ret == 0) {
+            virSetError(jobs[i].err);
+            ret = -1;
+        }
+        virFreeError(jobs[i].err);
+    }
+
+    return ret;
 }
 
 
@@ -20,6 +20,8 @@
 
 #include <config.h>
 
+#include <sys/stat.h>
+
 #include "qemu_firmware.h"
 #include "qemu_interop_config.h"
 #include "configmake.h"
@@ -32,12 +34,48 @@
 #include "virstring.h"
 #include "viralloc.h"
 #include "virenum.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_QEMU
 
 VIR_LOG_INIT("qemu.qemu_firmware");
 
 
+/* All firmware descriptors parsed from the search paths. Descriptors are
+ * parsed again only once the stamp of the files changes. */
+typedef struct _qemuFirmwareList qemuFirmwareList;
+typedef qemuFirmwareList *qemuFirmwareListPtr;
+struct _qemuFirmwareList {
+    virObject parent;
+
+    char *stamp;
+    char **paths;
+    qemuFirmwarePtr *firmwares;
+    size_t nfirmwares;
+};
+
+static virClassPtr qemuFirmwareListClass;
+
+static void qemuFirmwareListDispose(void *obj);
+
+static int
+qemuFirmwareOnceInit(void)
+{
+    if (!VIR_CLASS_NEW(qemuFirmwareList, virClassForObject()))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(qemuFirmware);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(qemuFirmwareList, virObjectUnref);
+
+/* Indexed by the privileged flag as it changes the search paths */
+static qemuFirmwareListPtr firmwareLists[2];
+static virMutex firmwareListsLock = VIR_MUTEX_INITIALIZER;
+
+
 typedef enum {
     QEMU_FIRMWARE_OS_INTERFACE_NONE = 0,
     QEMU_FIRMWARE_OS_INTERFACE_BIOS,
@@ -889,6 +927,57 @@ qemuFirmwareFetchConfigs(char ***firmwares,
 }
 
 
+static char *
+qemuFirmwareStampPaths(char **paths)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    size_t i;
+
+    for (i = 0; paths && paths[i]; i++) {
+        struct stat sb;
+
+        if (stat(paths[i], &sb) < 0) {
+            /* removed since listed, the next call will notice */
+            if (errno == ENOENT)
+                continue;
+
+            virReportSystemError(errno, _("cannot stat firmware descriptor '%s'"),
+                                 paths[i]);
+            return NULL;
+        }
+
+        virBufferAsprintf(&buf, "%s:%llu:%lld:%lld;", paths[i],
+                          (unsigned long long) sb.st_ino,
+                          (long long) sb.st_size,
+                          (long long) sb.st_mtime);
+    }
+
+    return g_strdup(NULLSTR_EMPTY(virBufferCurrentContent(&buf)));
+}
+
+
+/**
+ * qemuFirmwareGetStamp:
+ * @privileged: whether running as privileged daemon
+ *
+ * Describes the firmware descriptors qemuFirmwareGetSupported would parse
+ * without actually parsing them, so that results derived from them can be
+ * reused until a descriptor is added, removed or modified.
+ *
+ * Returns the description on success, NULL otherwise.
+ */
+char *
+qemuFirmwareGetStamp(bool privileged)
+{
+    VIR_AUTOSTRINGLIST paths = NULL;
+
+    if (qemuFirmwareFetchConfigs(&paths, privileged) < 0)
+        return NULL;
+
+    return qemuFirmwareStampPaths(paths);
+}
+
+
 static bool
 qemuFirmwareMatchesMachineArch(const qemuFirmware *fw,
                                const char *machine,
@@ -1180,39 +1269,77 @@ qemuFirmwareSanityCheck(const qemuFirmware *fw,
 }
 
 
-static ssize_t
-qemuFirmwareFetchParsedConfigs(bool privileged,
-                               qemuFirmwarePtr **firmwaresRet,
-                               char ***pathsRet)
+static void
+qemuFirmwareListDispose(void *obj)
 {
+    qemuFirmwareListPtr list = obj;
+    size_t i;
+
+    for (i = 0; i < list->nfirmwares; i++)
+        qemuFirmwareFree(list->firmwares[i]);
+    g_free(list->firmwares);
+    virStringListFree(list->paths);
+    g_free(list->stamp);
+}
+
+
+/**
+ * qemuFirmwareFetchParsedConfigs:
+ * @privileged: whether running as privileged daemon
+ *
+ * Returns a reference to the parsed firmware descriptors, parsing them
+ * only if they changed since the last call. The descriptors are shared
+ * and must not be modified. The caller must unref the returned object.
+ */
+static qemuFirmwareListPtr
+qemuFirmwareFetchParsedConfigs(bool privileged)
+{
+    g_autoptr(qemuFirmwareList) list = NULL;
     VIR_AUTOSTRINGLIST paths = NULL;
+    g_autofree char *stamp = NULL;
+    qemuFirmwareListPtr cached;
     size_t npaths;
-    qemuFirmwarePtr *firmwares = NULL;
     size_t i;
 
-    if (qemuFirmwareFetchConfigs(&paths, privileged) < 0)
-        return -1;
+    if (qemuFirmwareInitialize() < 0)
+        return NULL;
 
-    npaths = virStringListLength((const char **)paths);
+    if (qemuFirmwareFetchConfigs(&paths, privileged) < 0 ||
+        !(stamp = qemuFirmwareStampPaths(paths)))
+        return NULL;
 
-    if (VIR_ALLOC_N(firmwares, npaths) < 0)
-        return -1;
+    virMutexLock(&firmwareListsLock);
+    cached = firmwareLists[privileged];
+    if (cached && STREQ(cached->stamp, stamp))
+        list = virObjectRef(cached);
+    virMutexUnlock(&firmwareListsLock);
+
+    if (list)
+        return g_steal_pointer(&list);
+
+    VIR_DEBUG("Parsing firmware descriptors");
+
+    if (!(list = virObjectNew(qemuFirmwareListClass)))
+        return NULL;
+
+    npaths = virStringListLength((const char **)paths);
+    list->firmwares = g_new0(qemuFirmwarePtr, npaths);
 
     for (i = 0; i < npaths; i++) {
-        if (!(firmwares[i] = qemuFirmwareParse(paths[i])))
-            goto error;
+        if (!(list->firmwares[i] = qemuFirmwareParse(paths[i])))
+            return NULL;
+        list->nfirmwares++;
     }
 
-    *firmwaresRet = g_steal_pointer(&firmwares);
-    if (pathsRet)
-        *pathsRet = g_steal_pointer(&paths);
-    return npaths;
+    list->paths = g_steal_pointer(&paths);
+    list->stamp = g_steal_pointer(&stamp);
 
- error:
-    while (i > 0)
-        qemuFirmwareFree(firmwares[--i]);
-    VIR_FREE(firmwares);
-    return -1;
+    virMutexLock(&firmwareListsLock);
+    virObjectUnref(firmwareLists[privileged]);
+    firmwareLists[privileged] = virObjectRef(list);
+    virMutexUnlock(&firmwareListsLock);
+
+    return g_steal_pointer(&list);
 }
 
 
@@ -1221,13 +1348,10 @@ qemuFirmwareFillDomain(virQEMUDriverPtr driver,
                        virDomainDefPtr def,
                        unsigned int flags)
 {
-    VIR_AUTOSTRINGLIST paths = NULL;
-    qemuFirmwarePtr *firmwares = NULL;
-    ssize_t nfirmwares = 0;
+    g_autoptr(qemuFirmwareList) list = NULL;
     const qemuFirmware *theone = NULL;
     bool needResult = true;
     size_t i;
-    int ret = -1;
 
     if (!(flags & VIR_QEMU_PROCESS_START_NEW))
         return 0;
@@ -1249,15 +1373,14 @@ qemuFirmwareFillDomain(virQEMUDriverPtr driver,
         needResult = false;
     }
 
-    if ((nfirmwares = qemuFirmwareFetchParsedConfigs(driver->privileged,
-                                                     &firmwares, &paths)) < 0)
+    if (!(list = qemuFirmwareFetchParsedConfigs(driver->privileged)))
         return -1;
 
-    for (i = 0; i < nfirmwares; i++) {
-        if (qemuFirmwareMatchDomain(def, firmwares[i], paths[i])) {
-            theone = firmwares[i];
+    for (i = 0; i < list->nfirmwares; i++) {
+        if (qemuFirmwareMatchDomain(def, list->firmwares[i], list->paths[i])) {
+            theone = list->firmwares[i];
             VIR_DEBUG("Found matching firmware (description path '%s')",
-                      paths[i]);
+                      list->paths[i]);
             break;
         }
     }
@@ -1267,31 +1390,26 @@ qemuFirmwareFillDomain(virQEMUDriverPtr driver,
             virReportError(VIR_ERR_OPERATION_FAILED,
                            _("Unable to find any firmware to satisfy '%s'"),
                            virDomainOsDefFirmwareTypeToString(def->os.firmware));
-        } else {
-            VIR_DEBUG("Unable to find NVRAM template for '%s', "
-                      "falling back to old style",
-                      NULLSTR(def->os.loader ? def->os.loader->path : NULL));
-            ret = 0;
+            return -1;
         }
-        goto cleanup;
+
+        VIR_DEBUG("Unable to find NVRAM template for '%s', "
+                  "falling back to old style",
+                  NULLSTR(def->os.loader ? def->os.loader->path : NULL));
+        return 0;
     }
 
     /* Firstly, let's do some sanity checks. If either of these
      * fail we can still start the domain successfully, but it's
      * likely that admin/FW manufacturer messed up. */
-    qemuFirmwareSanityCheck(theone, paths[i]);
+    qemuFirmwareSanityCheck(theone, list->paths[i]);
 
     if (qemuFirmwareEnableFeatures(driver, def, theone) < 0)
-        goto cleanup;
+        return -1;
 
     def->os.firmware = VIR_DOMAIN_OS_DEF_FIRMWARE_NONE;
 
-    ret = 0;
- cleanup:
-    for (i = 0; i < nfirmwares; i++)
-        qemuFirmwareFree(firmwares[i]);
-    VIR_FREE(firmwares);
-    return ret;
+    return 0;
 }
 
 
@@ -1334,8 +1452,7 @@ qemuFirmwareGetSupported(const char *machine,
                          virFirmwarePtr **fws,
                          size_t *nfws)
 {
-    qemuFirmwarePtr *firmwares = NULL;
-    ssize_t nfirmwares = 0;
+    g_autoptr(qemuFirmwareList) list = NULL;
     size_t i;
 
     *supported = VIR_DOMAIN_OS_DEF_FIRMWARE_NONE;
@@ -1346,12 +1463,11 @@ qemuFirmwareGetSupported(const char *machine,
         *nfws = 0;
     }
 
-    if ((nfirmwares = qemuFirmwareFetchParsedConfigs(privileged,
-                                                     &firmwares, NULL)) < 0)
+    if (!(list = qemuFirmwareFetchParsedConfigs(privileged)))
         return -1;
 
-    for (i = 0; i < nfirmwares; i++) {
-        qemuFirmwarePtr fw = firmwares[i];
+    for (i = 0; i < list->nfirmwares; i++) {
+        const qemuFirmware *fw = list->firmwares[i];
         const qemuFirmwareMappingFlash *flash = &fw->mapping.data.flash;
         const qemuFirmwareMappingMemory *memory = &fw->mapping.data.memory;
         const char *fwpath = NULL;
@@ -1434,12 +1550,9 @@ qemuFirmwareGetSupported(const char *machine,
         }
     }
 
-    if (fws && !*fws && nfirmwares &&
+    if (fws && !*fws && list->nfirmwares &&
         VIR_REALLOC_N(*fws, 0) < 0)
         return -1;
 
-    for (i = 0; i < nfirmwares; i++)
-        qemuFirmwareFree(firmwares[i]);
-    VIR_FREE(firmwares);
     return 0;
 }
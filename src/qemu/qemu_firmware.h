@@ -43,6 +43,9 @@ int
 qemuFirmwareFetchConfigs(char ***firmwares,
                          bool privileged);
 
+char *
+qemuFirmwareGetStamp(bool privileged);
+
 int
 qemuFirmwareFillDomain(virQEMUDriverPtr driver,
                        virDomainDefPtr def,
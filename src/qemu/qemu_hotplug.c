@@ -6031,44 +6031,103 @@ qemuDomainHotplugDelVcpu(virQEMUDriverPtr driver,
 }
 
 
+/**
+ * qemuDomainHotplugAddVcpus:
+ * @driver: qemu driver
+ * @cfg: driver config
+ * @vm: domain object
+ * @vcpumap: bitmap of vcpu entities to add
+ *
+ * Plugs all vcpu entities selected by @vcpumap within a single monitor
+ * session and refreshes the vcpu information just once afterwards, rather
+ * than querying QEMU after every single entity. If plugging one of the
+ * entities fails, the ones added before it are still set up properly.
+ *
+ * Returns 0 on success, -1 on error.
+ */
 static int
-qemuDomainHotplugAddVcpu(virQEMUDriverPtr driver,
-                         virQEMUDriverConfigPtr cfg,
-                         virDomainObjPtr vm,
-                         unsigned int vcpu)
+qemuDomainHotplugAddVcpus(virQEMUDriverPtr driver,
+                          virQEMUDriverConfigPtr cfg,
+                          virDomainObjPtr vm,
+                          virBitmapPtr vcpumap)
 {
-    virJSONValuePtr vcpuprops = NULL;
-    virDomainVcpuDefPtr vcpuinfo = virDomainDefGetVcpu(vm->def, vcpu);
-    qemuDomainVcpuPrivatePtr vcpupriv = QEMU_DOMAIN_VCPU_PRIVATE(vcpuinfo);
-    unsigned int nvcpus = vcpupriv->vcpus;
+    g_autoptr(virBitmap) added = NULL;
+    virJSONValuePtr *vcpuprops = NULL;
+    virErrorPtr orig_err = NULL;
+    virDomainVcpuDefPtr vcpuinfo;
+    qemuDomainVcpuPrivatePtr vcpupriv;
     bool newhotplug = qemuDomainSupportsNewVcpuHotplug(vm);
+    unsigned int maxvcpus = virDomainDefGetVcpusMax(vm->def);
+    int curvcpus = virDomainDefGetVcpus(vm->def);
+    ssize_t vcpu = -1;
     int ret = -1;
-    int rc;
-    int oldvcpus = virDomainDefGetVcpus(vm->def);
+    int rc = 0;
     size_t i;
 
+    if (!(added = virBitmapNew(maxvcpus)))
+        return -1;
+
+    vcpuprops = g_new0(virJSONValuePtr, maxvcpus);
+
     if (newhotplug) {
-        vcpupriv->alias = g_strdup_printf("vcpu%u", vcpu);
+        while ((vcpu = virBitmapNextSetBit(vcpumap, vcpu)) != -1) {
+            vcpuinfo = virDomainDefGetVcpu(vm->def, vcpu);
+            vcpupriv = QEMU_DOMAIN_VCPU_PRIVATE(vcpuinfo);
 
-        if (!(vcpuprops = qemuBuildHotpluggableCPUProps(vcpuinfo)))
-            goto cleanup;
+            VIR_FREE(vcpupriv->alias);
+            vcpupriv->alias = g_strdup_printf("vcpu%zd", vcpu);
+
+            if (!(vcpuprops[vcpu] = qemuBuildHotpluggableCPUProps(vcpuinfo)))
+                goto cleanup;
+        }
     }
 
     qemuDomainObjEnterMonitor(driver, vm);
 
-    if (newhotplug) {
-        rc = qemuMonitorAddDeviceArgs(qemuDomainGetMonitor(vm), vcpuprops);
-        vcpuprops = NULL;
-    } else {
-        rc = qemuMonitorSetCPU(qemuDomainGetMonitor(vm), vcpu, true);
+    while (rc == 0 &&
+           (vcpu = virBitmapNextSetBit(vcpumap, vcpu)) != -1) {
+        unsigned int nvcpus;
+
+        vcpuinfo = virDomainDefGetVcpu(vm->def, vcpu);
+        vcpupriv = QEMU_DOMAIN_VCPU_PRIVATE(vcpuinfo);
+        nvcpus = vcpupriv->vcpus;
+
+        if (newhotplug) {
+            rc = qemuMonitorAddDeviceArgs(qemuDomainGetMonitor(vm),
+                                          vcpuprops[vcpu]);
+            vcpuprops[vcpu] = NULL;
+        } else {
+            rc = qemuMonitorSetCPU(qemuDomainGetMonitor(vm), vcpu, true);
+        }
+
+        virDomainAuditVcpu(vm, curvcpus, curvcpus + nvcpus, "update", rc == 0);
+
+        if (rc == 0) {
+            ignore_value(virBitmapSetBit(added, vcpu));
+            curvcpus += nvcpus;
+        }
     }
 
     if (qemuDomainObjExitMonitor(driver, vm) < 0)
         goto cleanup;
 
-    virDomainAuditVcpu(vm, oldvcpus, oldvcpus + nvcpus, "update", rc == 0);
+    if (rc < 0) {
+        /* keep the error while setting up the entities added so far */
+        virErrorPreserveLast(&orig_err);
 
-    if (rc < 0)
+        if (newhotplug) {
+            vcpu = -1;
+            while ((vcpu = virBitmapNextSetBit(vcpumap, vcpu)) != -1) {
+                if (virBitmapIsBitSet(added, vcpu))
+                    continue;
+
+                vcpuinfo = virDomainDefGetVcpu(vm->def, vcpu);
+                VIR_FREE(QEMU_DOMAIN_VCPU_PRIVATE(vcpuinfo)->alias);
+            }
+        }
+    }
+
+    if (virBitmapIsAllClear(added))
         goto cleanup;
 
     /* start outputting of the new XML element to allow keeping unpluggability */
@@ -6079,15 +6138,23 @@ qemuDomainHotplugAddVcpu(virQEMUDriverPtr driver,
         goto cleanup;
 
     /* validation requires us to set the expected state prior to calling it */
-    for (i = vcpu; i < vcpu + nvcpus; i++) {
-        vcpuinfo = virDomainDefGetVcpu(vm->def, i);
-        vcpupriv = QEMU_DOMAIN_VCPU_PRIVATE(vcpuinfo);
+    vcpu = -1;
+    while ((vcpu = virBitmapNextSetBit(added, vcpu)) != -1) {
+        unsigned int nvcpus;
 
-        vcpuinfo->online = true;
+        vcpuinfo = virDomainDefGetVcpu(vm->def, vcpu);
+        nvcpus = QEMU_DOMAIN_VCPU_PRIVATE(vcpuinfo)->vcpus;
 
-        if (vcpupriv->tid > 0 &&
-            qemuProcessSetupVcpu(vm, i) < 0)
-            goto cleanup;
+        for (i = vcpu; i < vcpu + nvcpus; i++) {
+            vcpuinfo = virDomainDefGetVcpu(vm->def, i);
+            vcpupriv = QEMU_DOMAIN_VCPU_PRIVATE(vcpuinfo);
+
+            vcpuinfo->online = true;
+
+            if (vcpupriv->tid > 0 &&
+                qemuProcessSetupVcpu(vm, i) < 0)
+                goto cleanup;
+        }
     }
 
     if (qemuDomainValidateVcpuInfo(vm) < 0)
@@ -6098,10 +6165,14 @@ qemuDomainHotplugAddVcpu(virQEMUDriverPtr driver,
     if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
         goto cleanup;
 
-    ret = 0;
+    if (rc == 0)
+        ret = 0;
 
  cleanup:
-    virJSONValueFree(vcpuprops);
+    for (i = 0; i < maxvcpus; i++)
+        virJSONValueFree(vcpuprops[i]);
+    VIR_FREE(vcpuprops);
+    virErrorRestore(&orig_err);
     return ret;
 }
 
@@ -6218,10 +6289,8 @@ qemuDomainSetVcpusLive(virQEMUDriverPtr driver,
         goto cleanup;
 
     if (enable) {
-        while ((nextvcpu = virBitmapNextSetBit(vcpumap, nextvcpu)) != -1) {
-            if (qemuDomainHotplugAddVcpu(driver, cfg, vm, nextvcpu) < 0)
-                goto cleanup;
-        }
+        if (qemuDomainHotplugAddVcpus(driver, cfg, vm, vcpumap) < 0)
+            goto cleanup;
     } else {
         for (nextvcpu = virDomainDefGetVcpusMax(vm->def) - 1; nextvcpu >= 0; nextvcpu--) {
             if (!virBitmapIsBitSet(vcpumap, nextvcpu))
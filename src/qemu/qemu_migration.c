@@ -28,6 +28,8 @@
 #include "qemu_migration.h"
 #include "qemu_migration_cookie.h"
 #include "qemu_migration_params.h"
+#include "qemu_migration_sched.h"
+#include "qemu_migration_tunnel.h"
 #include "qemu_monitor.h"
 #include "qemu_domain.h"
 #include "qemu_process.h"
@@ -1684,19 +1686,149 @@ qemuMigrationAnyCompleted(virQEMUDriverPtr driver,
 }
 
 
+/* Applies the bandwidth the host wide migration bandwidth currently grants
+ * to the outgoing migration of @vm, if it changed */
+static void
+qemuMigrationSrcUpdateShare(virQEMUDriverPtr driver,
+                            virDomainObjPtr vm,
+                            qemuDomainAsyncJob asyncJob)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    unsigned long share;
+    bool limited;
+    int rc;
+
+    if (!qemuMigrationSchedGetShare(driver->migrationSched, vm,
+                                    &share, &limited))
+        return;
+
+    VIR_DEBUG("Changing migration speed of domain %s to %lu MiB/s",
+              vm->def->name, share);
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
+        return;
+
+    rc = qemuMonitorSetMigrationSpeed(priv->mon, share);
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0) {
+        VIR_WARN("Unable to change migration speed of domain %s",
+                 vm->def->name);
+        return;
+    }
+
+    priv->job.current->bandwidthShare = limited ? share : 0;
+}
+
+
+/* Number of future pre-copy passes qemuMigrationSrcPostcopyPredict looks at */
+#define QEMU_MIGRATION_POSTCOPY_PREDICT_PASSES 5
+
+/* Returns true if pre-copy migration described by @stats is not expected to
+ * bring the remaining memory down to what can be sent within @downtime
+ * milliseconds in the next few passes. Each pass is assumed to leave behind
+ * as much memory as the domain dirties while the previous pass is sent. */
+static bool
+qemuMigrationSrcPostcopyPredict(qemuMonitorMigrationStatsPtr stats,
+                                unsigned long long downtime)
+{
+    double target;
+    double ratio;
+    double remaining = stats->ram_remaining;
+    size_t i;
+
+    /* the dirty rate is only known after the first pass */
+    if (stats->ram_iteration < 2 || stats->ram_bps == 0)
+        return false;
+
+    target = (double) stats->ram_bps * downtime / 1000;
+    ratio = (double) stats->ram_dirty_rate * stats->ram_page_size /
+            stats->ram_bps;
+
+    for (i = 0; i < QEMU_MIGRATION_POSTCOPY_PREDICT_PASSES; i++) {
+        if (remaining <= target)
+            return false;
+        if (ratio >= 1)
+            break;
+        remaining *= ratio;
+    }
+
+    return remaining > target;
+}
+
+
+/* Switches the outgoing migration of @vm to post-copy once a new pre-copy
+ * pass shows it is unlikely to converge within @downtime milliseconds.
+ * @pass tracks the last evaluated pass, @started is set once the switch was
+ * requested. */
+static void
+qemuMigrationSrcAutoPostcopy(virQEMUDriverPtr driver,
+                             virDomainObjPtr vm,
+                             qemuDomainAsyncJob asyncJob,
+                             unsigned long long downtime,
+                             unsigned long long *pass,
+                             bool *started)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    qemuDomainJobInfoPtr jobInfo = priv->job.current;
+    qemuMonitorMigrationStatsPtr stats = &jobInfo->stats.mig;
+    int rc;
+
+    if (*started || jobInfo->status != QEMU_DOMAIN_JOB_STATUS_MIGRATING)
+        return;
+
+    /* without events the stats were just refreshed by the status check */
+    if (virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT) &&
+        qemuMigrationAnyFetchStats(driver, vm, asyncJob, jobInfo, NULL) < 0) {
+        virResetLastError();
+        return;
+    }
+
+    if (stats->ram_iteration == *pass)
+        return;
+    *pass = stats->ram_iteration;
+
+    if (!qemuMigrationSrcPostcopyPredict(stats, downtime))
+        return;
+
+    VIR_DEBUG("Migration of domain %s is not expected to converge within "
+              "%llu ms (pass %llu, dirty rate %llu pages/s, %llu B/s), "
+              "switching to post-copy", vm->def->name, downtime,
+              stats->ram_iteration, stats->ram_dirty_rate, stats->ram_bps);
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
+        return;
+
+    rc = qemuMonitorMigrateStartPostCopy(priv->mon);
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0) {
+        VIR_WARN("Unable to switch migration of domain %s to post-copy",
+                 vm->def->name);
+        virResetLastError();
+        return;
+    }
+
+    *started = true;
+}
+
+
 /* Returns 0 on success, -2 when migration needs to be cancelled, or -1 when
- * QEMU reports failed migration.
+ * QEMU reports failed migration. A non-zero @postcopyDowntime switches the
+ * migration to post-copy once pre-copy is not expected to reach it.
  */
 static int
 qemuMigrationSrcWaitForCompletion(virQEMUDriverPtr driver,
                                   virDomainObjPtr vm,
                                   qemuDomainAsyncJob asyncJob,
                                   virConnectPtr dconn,
-                                  unsigned int flags)
+                                  unsigned int flags,
+                                  unsigned long long postcopyDowntime)
 {
     qemuDomainObjPrivatePtr priv = vm->privateData;
     qemuDomainJobInfoPtr jobInfo = priv->job.current;
     bool events = virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT);
+    bool scheduled = qemuMigrationSchedIsActive(driver->migrationSched, vm);
+    unsigned long long pass = 0;
+    bool postcopyStarted = false;
     int rv;
 
     jobInfo->status = QEMU_DOMAIN_JOB_STATUS_MIGRATING;
@@ -1706,7 +1838,31 @@ qemuMigrationSrcWaitForCompletion(virQEMUDriverPtr driver,
         if (rv < 0)
             return rv;
 
-        if (events) {
+        if (scheduled)
+            qemuMigrationSrcUpdateShare(driver, vm, asyncJob);
+
+        if (postcopyDowntime)
+            qemuMigrationSrcAutoPostcopy(driver, vm, asyncJob, postcopyDowntime,
+                                         &pass, &postcopyStarted);
+
+        if (events && (scheduled || (postcopyDowntime && !postcopyStarted))) {
+            /* Wake up once a second to pick up a new bandwidth share or
+             * to look at the progress of the current pre-copy pass */
+            unsigned long long now;
+
+            if (virTimeMillisNow(&now) < 0 ||
+                virDomainObjWaitUntil(vm, now + 1000) < 0) {
+                if (virDomainObjIsActive(vm))
+                    jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
+                return -2;
+            }
+
+            if (!virDomainObjIsActive(vm)) {
+                virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                               _("domain is not running"));
+                return -2;
+            }
+        } else if (events) {
             if (virDomainObjWait(vm) < 0) {
                 if (virDomainObjIsActive(vm))
                     jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
@@ -2143,10 +2299,18 @@ qemuMigrationSrcBeginPhase(virQEMUDriverPtr driver,
     if (!(flags & VIR_MIGRATE_OFFLINE))
         cookieFlags |= QEMU_MIGRATION_COOKIE_CAPS;
 
+    if (flags & VIR_MIGRATE_PARALLEL)
+        cookieFlags |= QEMU_MIGRATION_COOKIE_MULTIFD;
+
     if (!(mig = qemuMigrationEatCookie(driver, vm->def,
                                        priv->origname, priv, NULL, 0, 0)))
         goto cleanup;
 
+    /* Offer the number of multifd channels we'd like to use, destination
+     * decides whether it is used at all. */
+    if (flags & VIR_MIGRATE_PARALLEL)
+        mig->multifdChannels = qemuMigrationParamsGetAutoMultiFD();
+
     if (qemuMigrationBakeCookie(mig, driver, vm,
                                 QEMU_MIGRATION_SOURCE,
                                 cookieout, cookieoutlen,
@@ -2285,6 +2449,9 @@ qemuMigrationDstPrepareCleanup(virQEMUDriverPtr driver,
     virPortAllocatorRelease(priv->migrationPort);
     priv->migrationPort = 0;
 
+    qemuMigrationTunnelStripesFree(priv->migTunnelStripes, true);
+    priv->migTunnelStripes = NULL;
+
     if (!qemuMigrationJobIsActive(vm, QEMU_ASYNC_JOB_MIGRATION_IN))
         return;
     qemuDomainObjDiscardAsyncJob(driver, vm);
@@ -2500,7 +2667,8 @@ qemuMigrationDstPrepareAny(virQEMUDriverPtr driver,
                                        QEMU_MIGRATION_COOKIE_CPU_HOTPLUG |
                                        QEMU_MIGRATION_COOKIE_CPU |
                                        QEMU_MIGRATION_COOKIE_ALLOW_REBOOT |
-                                       QEMU_MIGRATION_COOKIE_CAPS)))
+                                       QEMU_MIGRATION_COOKIE_CAPS |
+                                       QEMU_MIGRATION_COOKIE_MULTIFD)))
         goto cleanup;
 
     if (!(vm = virDomainObjListAdd(driver->domains, *def,
@@ -2549,11 +2717,15 @@ qemuMigrationDstPrepareAny(virQEMUDriverPtr driver,
 
     startFlags = VIR_QEMU_PROCESS_START_AUTODESTROY;
 
+    qemuDomainJobTimingStart(vm);
+
     if (qemuProcessInit(driver, vm, mig->cpu, QEMU_ASYNC_JOB_MIGRATION_IN,
                         true, startFlags) < 0)
         goto stopjob;
     stopProcess = true;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_INIT);
+
     priv->allowReboot = mig->allowReboot;
 
     if (!(incoming = qemuMigrationDstPrepare(vm, tunnel, protocol,
@@ -2564,13 +2736,18 @@ qemuMigrationDstPrepareAny(virQEMUDriverPtr driver,
     if (qemuProcessPrepareDomain(driver, vm, startFlags) < 0)
         goto stopjob;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_PREPARE_DOMAIN);
+
     if (qemuProcessPrepareHost(driver, vm, startFlags) < 0)
         goto stopjob;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_PREPARE_HOST);
+
     rv = qemuProcessLaunch(dconn, driver, vm, QEMU_ASYNC_JOB_MIGRATION_IN,
                            incoming, NULL,
                            VIR_NETDEV_VPORT_PROFILE_OP_MIGRATE_IN_START,
                            startFlags);
+    qemuDomainJobTimingStop(vm);
     if (rv < 0) {
         if (rv == -2)
             relabel = true;
@@ -2579,6 +2756,17 @@ qemuMigrationDstPrepareAny(virQEMUDriverPtr driver,
     relabel = true;
 
     if (tunnel) {
+        int streams = qemuMigrationParamsGetTunnelStreams(migParams);
+
+        /* The remaining stripes are attached by
+         * qemuMigrationDstPrepareTunnelStripe */
+        if (streams > 1) {
+            if (!(priv->migTunnelStripes = qemuMigrationTunnelStripesNew(streams,
+                                                                         dataFD[1])))
+                goto stopjob;
+            dataFD[1] = qemuMigrationTunnelStripesClaim(priv->migTunnelStripes, 0);
+        }
+
         if (virFDStreamOpen(st, dataFD[1]) < 0) {
             virReportSystemError(errno, "%s",
                                  _("cannot pass pipe for tunnelled migration"));
@@ -2596,6 +2784,12 @@ qemuMigrationDstPrepareAny(virQEMUDriverPtr driver,
                                  migParams, mig->caps->automatic) < 0)
         goto stopjob;
 
+    mig->multifdChannels = qemuMigrationParamsSetAutoMultiFD(migParams,
+                                                             mig->multifdChannels,
+                                                             QEMU_MIGRATION_DESTINATION);
+    if (mig->multifdChannels > 0)
+        cookieFlags |= QEMU_MIGRATION_COOKIE_MULTIFD;
+
     /* Migrations using TLS need to add the "tls-creds-x509" object and
      * set the migration TLS parameters */
     if (flags & VIR_MIGRATE_TLS) {
@@ -2707,6 +2901,8 @@ qemuMigrationDstPrepareAny(virQEMUDriverPtr driver,
         if (nbdPort == 0)
             virPortAllocatorRelease(priv->nbdPort);
         priv->nbdPort = 0;
+        qemuMigrationTunnelStripesFree(priv->migTunnelStripes, true);
+        priv->migTunnelStripes = NULL;
         virDomainObjRemoveTransientDef(vm);
         qemuDomainRemoveInactiveJob(driver, vm);
     }
@@ -2771,6 +2967,45 @@ qemuMigrationDstPrepareTunnel(virQEMUDriverPtr driver,
 }
 
 
+/*
+ * Attaches another stream to an incoming tunnelled migration which was
+ * prepared to be striped over several streams.
+ */
+int
+qemuMigrationDstPrepareTunnelStripe(virDomainObjPtr vm,
+                                    virStreamPtr st,
+                                    unsigned int stripe)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    int fd;
+
+    VIR_DEBUG("vm=%p, st=%p, stripe=%u", vm, st, stripe);
+
+    if (!qemuMigrationJobIsActive(vm, QEMU_ASYNC_JOB_MIGRATION_IN))
+        return -1;
+
+    if (!priv->migTunnelStripes) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("incoming migration of domain '%s' does not use "
+                         "several tunnel streams"), vm->def->name);
+        return -1;
+    }
+
+    if ((fd = qemuMigrationTunnelStripesClaim(priv->migTunnelStripes,
+                                              stripe)) < 0)
+        return -1;
+
+    if (virFDStreamOpen(st, fd) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot pass pipe for tunnelled migration"));
+        VIR_FORCE_CLOSE(fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static virURIPtr
 qemuMigrationAnyParseURI(const char *uri, bool *wellFormed)
 {
@@ -3167,8 +3402,9 @@ struct _qemuMigrationSpec {
     } dest;
 
     enum qemuMigrationForwardType fwdType;
-    union {
-        virStreamPtr stream;
+    struct {
+        virStreamPtr *streams;
+        size_t nstreams;
     } fwd;
 };
 
@@ -3176,28 +3412,51 @@ struct _qemuMigrationSpec {
 
 typedef struct _qemuMigrationIOThread qemuMigrationIOThread;
 typedef qemuMigrationIOThread *qemuMigrationIOThreadPtr;
-struct _qemuMigrationIOThread {
+
+typedef struct _qemuMigrationIOStripe qemuMigrationIOStripe;
+typedef qemuMigrationIOStripe *qemuMigrationIOStripePtr;
+struct _qemuMigrationIOStripe {
     virThread thread;
+    qemuMigrationIOThreadPtr io;
     virStreamPtr st;
-    int sock;
+    size_t idx;
     virError err;
+};
+
+/*
+ * Each stream is fed by its own thread so that the work of sending the
+ * data (such as encrypting it) happens in parallel. The threads take
+ * turns in reading from QEMU, which keeps frames in a fixed round robin
+ * order across the streams and lets the destination put them back
+ * together without any further bookkeeping.
+ */
+struct _qemuMigrationIOThread {
+    virMutex lock;
+    virCond cond;
+
+    qemuMigrationIOStripePtr stripes;
+    size_t nstripes;
+    size_t nthreads; /* number of stripe threads started */
+    size_t nrunning; /* number of stripe threads still using sock */
+
+    size_t turn;     /* stripe allowed to read from QEMU next */
+    bool done;       /* QEMU reached EOF or the transfer was aborted */
+    bool aborted;
+    int timeout;     /* only accessed by the stripe holding the turn */
+
+    int sock;
     int wakeupRecvFD;
     int wakeupSendFD;
 };
 
-static void qemuMigrationSrcIOFunc(void *arg)
+
+/* Reads the next chunk of migration data from QEMU. Returns the number
+ * of bytes read, 0 on EOF or -1 if the tunnel has to be aborted. */
+static ssize_t
+qemuMigrationSrcIORead(qemuMigrationIOThreadPtr data,
+                       char *buffer)
 {
-    qemuMigrationIOThreadPtr data = arg;
-    char *buffer = NULL;
     struct pollfd fds[2];
-    int timeout = -1;
-    virErrorPtr err = NULL;
-
-    VIR_DEBUG("Running migration tunnel; stream=%p, sock=%d",
-              data->st, data->sock);
-
-    if (VIR_ALLOC_N(buffer, TUNNEL_SEND_BUF_SIZE) < 0)
-        goto abrt;
 
     fds[0].fd = data->sock;
     fds[1].fd = data->wakeupRecvFD;
@@ -3208,14 +3467,14 @@ static void qemuMigrationSrcIOFunc(void *arg)
         fds[0].events = fds[1].events = POLLIN;
         fds[0].revents = fds[1].revents = 0;
 
-        ret = poll(fds, G_N_ELEMENTS(fds), timeout);
+        ret = poll(fds, G_N_ELEMENTS(fds), data->timeout);
 
         if (ret < 0) {
             if (errno == EAGAIN || errno == EINTR)
                 continue;
             virReportSystemError(errno, "%s",
                                  _("poll failed in migration tunnel"));
-            goto abrt;
+            return -1;
         }
 
         if (ret == 0) {
@@ -3224,7 +3483,7 @@ static void qemuMigrationSrcIOFunc(void *arg)
              * close the migration fd. We handle this in the same way as EOF.
              */
             VIR_DEBUG("QEMU forgot to close migration fd");
-            break;
+            return 0;
         }
 
         if (fds[1].revents & (POLLIN | POLLERR | POLLHUP)) {
@@ -3233,40 +3492,121 @@ static void qemuMigrationSrcIOFunc(void *arg)
             if (saferead(data->wakeupRecvFD, &stop, 1) != 1) {
                 virReportSystemError(errno, "%s",
                                      _("failed to read from wakeup fd"));
-                goto abrt;
+                return -1;
             }
 
             VIR_DEBUG("Migration tunnel was asked to %s",
                       stop ? "abort" : "finish");
-            if (stop) {
-                goto abrt;
-            } else {
-                timeout = 0;
-            }
+            if (stop)
+                return -1;
+            data->timeout = 0;
         }
 
         if (fds[0].revents & (POLLIN | POLLERR | POLLHUP)) {
-            int nbytes;
+            ssize_t nbytes;
 
             nbytes = saferead(data->sock, buffer, TUNNEL_SEND_BUF_SIZE);
-            if (nbytes > 0) {
-                if (virStreamSend(data->st, buffer, nbytes) < 0)
-                    goto error;
-            } else if (nbytes < 0) {
+            if (nbytes < 0) {
                 virReportSystemError(errno, "%s",
                         _("tunnelled migration failed to read from qemu"));
-                goto abrt;
-            } else {
-                /* EOF; get out of here */
-                break;
+                return -1;
             }
+
+            return nbytes;
+        }
+    }
+}
+
+
+static void
+qemuMigrationSrcIOStripeExit(qemuMigrationIOStripePtr stripe,
+                             bool failed)
+{
+    qemuMigrationIOThreadPtr data = stripe->io;
+
+    virMutexLock(&data->lock);
+
+    if (failed && !data->done) {
+        char stop = 1;
+
+        /* Make the other stripes give up too, including the one which
+         * may be waiting for QEMU. */
+        data->done = true;
+        data->aborted = true;
+        virCondBroadcast(&data->cond);
+        ignore_value(safewrite(data->wakeupSendFD, &stop, 1));
+    }
+
+    /* Let the source qemu know that the transfer cant continue anymore
+     * or that we are done reading. */
+    if (--data->nrunning == 0)
+        VIR_FORCE_CLOSE(data->sock);
+
+    virMutexUnlock(&data->lock);
+}
+
+
+static void qemuMigrationSrcIOFunc(void *arg)
+{
+    qemuMigrationIOStripePtr stripe = arg;
+    qemuMigrationIOThreadPtr data = stripe->io;
+    size_t header = data->nstripes > 1 ? QEMU_MIGRATION_TUNNEL_FRAME_HEADER : 0;
+    char *buffer = NULL;
+    bool aborted;
+    virErrorPtr err = NULL;
+
+    VIR_DEBUG("Running migration tunnel; stream=%p, sock=%d, stripe=%zu",
+              stripe->st, data->sock, stripe->idx);
+
+    if (VIR_ALLOC_N(buffer, header + TUNNEL_SEND_BUF_SIZE) < 0)
+        goto abrt;
+
+    for (;;) {
+        ssize_t nbytes;
+
+        virMutexLock(&data->lock);
+        while (data->turn != stripe->idx && !data->done)
+            virCondWait(&data->cond, &data->lock);
+        aborted = data->aborted;
+        if (data->done) {
+            virMutexUnlock(&data->lock);
+            break;
+        }
+        virMutexUnlock(&data->lock);
+
+        nbytes = qemuMigrationSrcIORead(data, buffer + header);
+
+        virMutexLock(&data->lock);
+        if (nbytes > 0) {
+            data->turn = (data->turn + 1) % data->nstripes;
+        } else {
+            data->done = true;
+            data->aborted = nbytes < 0;
         }
+        virCondBroadcast(&data->cond);
+        virMutexUnlock(&data->lock);
+
+        if (nbytes < 0)
+            goto abrt;
+
+        /* EOF; get out of here */
+        if (nbytes == 0)
+            break;
+
+        if (header)
+            qemuMigrationTunnelFrameEncode(buffer, nbytes);
+
+        if (virStreamSend(stripe->st, buffer, header + nbytes) < 0)
+            goto error;
     }
 
-    if (virStreamFinish(data->st) < 0)
+    if (aborted)
+        goto abrt;
+
+    if (virStreamFinish(stripe->st) < 0)
         goto error;
 
-    VIR_FORCE_CLOSE(data->sock);
+    qemuMigrationSrcIOStripeExit(stripe, false);
     VIR_FREE(buffer);
 
     return;
@@ -3277,26 +3617,76 @@ static void qemuMigrationSrcIOFunc(void *arg)
         virFreeError(err);
         err = NULL;
     }
-    virStreamAbort(data->st);
+    virStreamAbort(stripe->st);
     virErrorRestore(&err);
 
  error:
-    /* Let the source qemu know that the transfer cant continue anymore.
-     * Don't copy the error for EPIPE as destination has the actual error. */
-    VIR_FORCE_CLOSE(data->sock);
+    qemuMigrationSrcIOStripeExit(stripe, true);
+    /* Don't copy the error for EPIPE as destination has the actual error. */
     if (!virLastErrorIsSystemErrno(EPIPE))
-        virCopyLastError(&data->err);
+        virCopyLastError(&stripe->err);
     virResetLastError();
     VIR_FREE(buffer);
 }
 
 
+static int
+qemuMigrationSrcStopTunnel(qemuMigrationIOThreadPtr io, bool error)
+{
+    int rv = -1;
+    char stop = error ? 1 : 0;
+    size_t i;
+
+    /* make sure the threads finish their job and are joinable */
+    if (safewrite(io->wakeupSendFD, &stop, 1) != 1) {
+        virReportSystemError(errno, "%s",
+                             _("failed to wakeup migration tunnel"));
+        goto cleanup;
+    }
+
+    for (i = 0; i < io->nthreads; i++)
+        virThreadJoin(&io->stripes[i].thread);
+
+    rv = 0;
+
+    /* Forward error from the IO threads, to this thread */
+    for (i = 0; i < io->nthreads; i++) {
+        virErrorPtr err = &io->stripes[i].err;
+
+        if (err->code == VIR_ERR_OK)
+            continue;
+
+        if (rv == 0 && !error) {
+            virSetError(err);
+            rv = -1;
+        }
+        virResetError(err);
+    }
+
+    virMutexDestroy(&io->lock);
+    virCondDestroy(&io->cond);
+
+ cleanup:
+    VIR_FORCE_CLOSE(io->wakeupSendFD);
+    VIR_FORCE_CLOSE(io->wakeupRecvFD);
+    VIR_FREE(io->stripes);
+    VIR_FREE(io);
+    return rv;
+}
+
+
+/*
+ * Starts sending data QEMU writes to @sock over @streams. The @sock is
+ * closed by the tunnel, even if starting it fails.
+ */
 static qemuMigrationIOThreadPtr
-qemuMigrationSrcStartTunnel(virStreamPtr st,
+qemuMigrationSrcStartTunnel(virStreamPtr *streams,
+                            size_t nstreams,
                             int sock)
 {
     qemuMigrationIOThreadPtr io = NULL;
     int wakeupFD[2] = { -1, -1 };
+    size_t i;
 
     if (virPipe(wakeupFD) < 0)
         goto error;
@@ -3304,63 +3694,75 @@ qemuMigrationSrcStartTunnel(virStreamPtr st,
     if (VIR_ALLOC(io) < 0)
         goto error;
 
-    io->st = st;
+    if (virMutexInit(&io->lock) < 0) {
+        virReportSystemError(errno, "%s", _("cannot initialize mutex"));
+        VIR_FREE(io);
+        goto error;
+    }
+
+    if (virCondInit(&io->cond) < 0) {
+        virReportSystemError(errno, "%s", _("cannot initialize condition"));
+        virMutexDestroy(&io->lock);
+        VIR_FREE(io);
+        goto error;
+    }
+
     io->sock = sock;
+    io->timeout = -1;
     io->wakeupRecvFD = wakeupFD[0];
     io->wakeupSendFD = wakeupFD[1];
 
-    if (virThreadCreateFull(&io->thread, true,
-                            qemuMigrationSrcIOFunc,
-                            "qemu-mig-tunnel",
-                            false,
-                            io) < 0) {
-        virReportSystemError(errno, "%s",
-                             _("Unable to create migration thread"));
-        goto error;
+    if (VIR_ALLOC_N(io->stripes, nstreams) < 0)
+        goto stop;
+    io->nstripes = nstreams;
+
+    for (i = 0; i < nstreams; i++) {
+        qemuMigrationIOStripePtr stripe = io->stripes + i;
+
+        stripe->io = io;
+        stripe->st = streams[i];
+        stripe->idx = i;
+
+        virMutexLock(&io->lock);
+        io->nrunning++;
+        virMutexUnlock(&io->lock);
+
+        if (virThreadCreateFull(&stripe->thread, true,
+                                qemuMigrationSrcIOFunc,
+                                "qemu-mig-tunnel",
+                                false,
+                                stripe) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("Unable to create migration thread"));
+            virMutexLock(&io->lock);
+            io->nrunning--;
+            virMutexUnlock(&io->lock);
+            goto stop;
+        }
+        io->nthreads++;
     }
 
     return io;
 
+ stop:
+    /* Stripes which never started can't take their turn */
+    virMutexLock(&io->lock);
+    io->done = true;
+    io->aborted = true;
+    virCondBroadcast(&io->cond);
+    if (io->nrunning == 0)
+        VIR_FORCE_CLOSE(io->sock);
+    virMutexUnlock(&io->lock);
+    qemuMigrationSrcStopTunnel(io, true);
+    return NULL;
+
  error:
+    VIR_FORCE_CLOSE(sock);
     VIR_FORCE_CLOSE(wakeupFD[0]);
     VIR_FORCE_CLOSE(wakeupFD[1]);
-    VIR_FREE(io);
     return NULL;
 }
 
-static int
-qemuMigrationSrcStopTunnel(qemuMigrationIOThreadPtr io, bool error)
-{
-    int rv = -1;
-    char stop = error ? 1 : 0;
-
-    /* make sure the thread finishes its job and is joinable */
-    if (safewrite(io->wakeupSendFD, &stop, 1) != 1) {
-        virReportSystemError(errno, "%s",
-                             _("failed to wakeup migration tunnel"));
-        goto cleanup;
-    }
-
-    virThreadJoin(&io->thread);
-
-    /* Forward error from the IO thread, to this thread */
-    if (io->err.code != VIR_ERR_OK) {
-        if (error)
-            rv = 0;
-        else
-            virSetError(&io->err);
-        virResetError(&io->err);
-        goto cleanup;
-    }
-
-    rv = 0;
-
- cleanup:
-    VIR_FORCE_CLOSE(io->wakeupSendFD);
-    VIR_FORCE_CLOSE(io->wakeupRecvFD);
-    VIR_FREE(io);
-    return rv;
-}
 
 static int
 qemuMigrationSrcConnect(virQEMUDriverPtr driver,
@@ -3461,6 +3863,8 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
     unsigned int waitFlags;
     virDomainDefPtr persistDef = NULL;
     char *timestamp;
+    bool scheduled = false;
+    bool limited;
     int rc;
 
     VIR_DEBUG("driver=%p, vm=%p, cookiein=%s, cookieinlen=%d, "
@@ -3472,6 +3876,8 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
               spec, spec->destType, spec->fwdType, dconn,
               NULLSTR(graphicsuri), nmigrate_disks, migrate_disks);
 
+    qemuDomainJobTimingStart(vm);
+
     if (flags & VIR_MIGRATE_NON_SHARED_DISK) {
         migrate_flags |= QEMU_MONITOR_MIGRATE_NON_SHARED_DISK;
         cookieFlags |= QEMU_MIGRATION_COOKIE_NBD;
@@ -3514,7 +3920,8 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
                                  cookiein, cookieinlen,
                                  cookieFlags |
                                  QEMU_MIGRATION_COOKIE_GRAPHICS |
-                                 QEMU_MIGRATION_COOKIE_CAPS);
+                                 QEMU_MIGRATION_COOKIE_CAPS |
+                                 QEMU_MIGRATION_COOKIE_MULTIFD);
     if (!mig)
         goto error;
 
@@ -3525,6 +3932,9 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
                                  migParams, mig->caps->automatic) < 0)
         goto error;
 
+    qemuMigrationParamsSetAutoMultiFD(migParams, mig->multifdChannels,
+                                      QEMU_MIGRATION_SOURCE);
+
     if (flags & VIR_MIGRATE_TLS) {
         const char *hostname = NULL;
 
@@ -3548,6 +3958,20 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
                                  migParams) < 0)
         goto error;
 
+    /* Wait for the host wide limits of outgoing migrations to let this
+     * one start, which may also cut its bandwidth */
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_MIGRATION_SETUP);
+    if (qemuMigrationSchedAcquire(driver->migrationSched, vm, migrate_speed,
+                                  &migrate_speed, &limited) < 0)
+        goto error;
+    scheduled = true;
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_MIGRATION_QUEUE);
+
+    if (virDomainObjCheckActive(vm) < 0)
+        goto error;
+
+    priv->job.current->bandwidthShare = limited ? migrate_speed : 0;
+
     if (migrate_flags & (QEMU_MONITOR_MIGRATE_NON_SHARED_DISK |
                          QEMU_MONITOR_MIGRATE_NON_SHARED_INC)) {
         if (mig->nbd) {
@@ -3654,14 +4078,18 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
     cancel = true;
 
     if (spec->fwdType != MIGRATION_FWD_DIRECT) {
-        if (!(iothread = qemuMigrationSrcStartTunnel(spec->fwd.stream, fd)))
-            goto error;
-        /* If we've created a tunnel, then the 'fd' will be closed in the
-         * qemuMigrationIOFunc as data->sock.
+        iothread = qemuMigrationSrcStartTunnel(spec->fwd.streams,
+                                               spec->fwd.nstreams, fd);
+        /* The tunnel closes the 'fd' as data->sock, even if it failed
+         * to start.
          */
         fd = -1;
+        if (!iothread)
+            goto error;
     }
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_MIGRATION_SETUP);
+
     waitFlags = QEMU_MIGRATION_COMPLETED_PRE_SWITCHOVER;
     if (abort_on_error)
         waitFlags |= QEMU_MIGRATION_COMPLETED_ABORT_ON_ERROR;
@@ -3672,7 +4100,8 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
 
     rc = qemuMigrationSrcWaitForCompletion(driver, vm,
                                            QEMU_ASYNC_JOB_MIGRATION_OUT,
-                                           dconn, waitFlags);
+                                           dconn, waitFlags,
+                                           qemuMigrationParamsGetPostcopyAutoDowntime(migParams));
     if (rc == -2) {
         goto error;
     } else if (rc == -1) {
@@ -3712,7 +4141,7 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
 
         rc = qemuMigrationSrcWaitForCompletion(driver, vm,
                                                QEMU_ASYNC_JOB_MIGRATION_OUT,
-                                               dconn, waitFlags);
+                                               dconn, waitFlags, 0);
         if (rc == -2) {
             goto error;
         } else if (rc == -1) {
@@ -3730,7 +4159,11 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
             goto error;
     }
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_MIGRATION_TRANSFER);
+
     if (priv->job.completed) {
+        memcpy(priv->job.completed->timing, priv->job.current->timing,
+               sizeof(priv->job.completed->timing));
         priv->job.completed->stopped = priv->job.current->stopped;
         qemuDomainJobInfoUpdateTime(priv->job.completed);
         qemuDomainJobInfoUpdateDowntime(priv->job.completed);
@@ -3750,6 +4183,8 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
     ret = 0;
 
  cleanup:
+    if (scheduled)
+        qemuMigrationSchedRelease(driver->migrationSched, vm);
     VIR_FREE(tlsAlias);
     VIR_FORCE_CLOSE(fd);
     virDomainDefFree(persistDef);
@@ -3758,6 +4193,8 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
     if (events)
         priv->signalIOError = false;
 
+    qemuDomainJobTimingStop(vm);
+
     virErrorRestore(&orig_err);
 
     return ret;
@@ -3881,7 +4318,8 @@ qemuMigrationSrcPerformNative(virQEMUDriverPtr driver,
 static int
 qemuMigrationSrcPerformTunnel(virQEMUDriverPtr driver,
                               virDomainObjPtr vm,
-                              virStreamPtr st,
+                              virStreamPtr *streams,
+                              size_t nstreams,
                               const char *persist_xml,
                               const char *cookiein,
                               int cookieinlen,
@@ -3900,15 +4338,17 @@ qemuMigrationSrcPerformTunnel(virQEMUDriverPtr driver,
     virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
     int fds[2] = { -1, -1 };
 
-    VIR_DEBUG("driver=%p, vm=%p, st=%p, cookiein=%s, cookieinlen=%d, "
-              "cookieout=%p, cookieoutlen=%p, flags=0x%lx, resource=%lu, "
-              "graphicsuri=%s, nmigrate_disks=%zu, migrate_disks=%p",
-              driver, vm, st, NULLSTR(cookiein), cookieinlen,
+    VIR_DEBUG("driver=%p, vm=%p, streams=%p, nstreams=%zu, cookiein=%s, "
+              "cookieinlen=%d, cookieout=%p, cookieoutlen=%p, flags=0x%lx, "
+              "resource=%lu, graphicsuri=%s, nmigrate_disks=%zu, "
+              "migrate_disks=%p",
+              driver, vm, streams, nstreams, NULLSTR(cookiein), cookieinlen,
               cookieout, cookieoutlen, flags, resource,
               NULLSTR(graphicsuri), nmigrate_disks, migrate_disks);
 
     spec.fwdType = MIGRATION_FWD_STREAM;
-    spec.fwd.stream = st;
+    spec.fwd.streams = streams;
+    spec.fwd.nstreams = nstreams;
 
 
     spec.destType = MIGRATION_DEST_FD;
@@ -4030,7 +4470,7 @@ qemuMigrationSrcPerformPeer2Peer2(virQEMUDriverPtr driver,
     VIR_DEBUG("Perform %p", sconn);
     qemuMigrationJobSetPhase(driver, vm, QEMU_MIGRATION_PHASE_PERFORM2);
     if (flags & VIR_MIGRATE_TUNNELLED)
-        ret = qemuMigrationSrcPerformTunnel(driver, vm, st, NULL,
+        ret = qemuMigrationSrcPerformTunnel(driver, vm, &st, 1, NULL,
                                             NULL, 0, NULL, NULL,
                                             flags, resource, dconn,
                                             NULL, 0, NULL, migParams);
@@ -4084,6 +4524,79 @@ qemuMigrationSrcPerformPeer2Peer2(virQEMUDriverPtr driver,
 }
 
 
+/* Runs without the domain object lock, see qemuDomainObjEnterRemote */
+static int
+qemuMigrationSrcOpenTunnelStripe(virQEMUDriverConfigPtr cfg,
+                                 const char *dconnuri,
+                                 const unsigned char *uuid,
+                                 unsigned int stripe,
+                                 virConnectPtr *conn,
+                                 virStreamPtr *st)
+{
+    virDomainPtr ddomain = NULL;
+    int ret = -1;
+
+    if (!(*conn = virConnectOpenAuth(dconnuri, &virConnectAuthConfig, 0))) {
+        virReportError(VIR_ERR_OPERATION_FAILED,
+                       _("Failed to connect to remote libvirt URI %s: %s"),
+                       dconnuri, virGetLastErrorMessage());
+        return -1;
+    }
+
+    if (virConnectSetKeepAlive(*conn, cfg->keepAliveInterval,
+                               cfg->keepAliveCount) < 0)
+        goto cleanup;
+
+    if (!(ddomain = virDomainLookupByUUID(*conn, uuid)) ||
+        !(*st = virStreamNew(*conn, 0)))
+        goto cleanup;
+
+    if (virDomainMigratePrepareTunnelStripe(ddomain, *st, stripe, 0) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(ddomain);
+    return ret;
+}
+
+
+/*
+ * Each additional stripe of a tunnelled migration gets a connection of
+ * its own so that neither the encryption nor the RPC handling of the
+ * whole migration stream is bound to a single connection.
+ */
+static int
+qemuMigrationSrcPrepareTunnelStripes(virQEMUDriverPtr driver,
+                                     virDomainObjPtr vm,
+                                     const char *dconnuri,
+                                     virConnectPtr *conns,
+                                     virStreamPtr *streams,
+                                     size_t nstreams)
+{
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    size_t i;
+
+    memcpy(uuid, vm->def->uuid, VIR_UUID_BUFLEN);
+
+    for (i = 1; i < nstreams; i++) {
+        int rc;
+
+        VIR_DEBUG("Preparing tunnel stripe %zu of %zu", i, nstreams);
+
+        qemuDomainObjEnterRemote(vm);
+        rc = qemuMigrationSrcOpenTunnelStripe(cfg, dconnuri, uuid, i,
+                                              &conns[i], &streams[i]);
+        if (qemuDomainObjExitRemote(vm, true) < 0 || rc < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
 /* This is essentially a re-impl of virDomainMigrateVersion3
  * from libvirt.c, but running in source libvirtd context,
  * instead of client app context & also adding in tunnel
@@ -4125,6 +4638,9 @@ qemuMigrationSrcPerformPeer2Peer3(virQEMUDriverPtr driver,
     int maxparams = 0;
     size_t i;
     bool offline = !!(flags & VIR_MIGRATE_OFFLINE);
+    size_t nstreams = qemuMigrationParamsGetTunnelStreams(migParams);
+    g_autofree virStreamPtr *streams = NULL;
+    g_autofree virConnectPtr *conns = NULL;
 
     VIR_DEBUG("driver=%p, sconn=%p, dconn=%p, dconnuri=%s, vm=%p, xmlin=%s, "
               "dname=%s, uri=%s, graphicsuri=%s, listenAddress=%s, "
@@ -4260,6 +4776,19 @@ qemuMigrationSrcPerformPeer2Peer3(virQEMUDriverPtr driver,
         goto finish;
     }
 
+    if (flags & VIR_MIGRATE_TUNNELLED) {
+        streams = g_new0(virStreamPtr, nstreams);
+        conns = g_new0(virConnectPtr, nstreams);
+        streams[0] = st;
+
+        if (nstreams > 1 &&
+            qemuMigrationSrcPrepareTunnelStripes(driver, vm, dconnuri, conns,
+                                                 streams, nstreams) < 0) {
+            virErrorPreserveLast(&orig_err);
+            goto finish;
+        }
+    }
+
     /* Perform the migration.  The driver isn't supposed to return
      * until the migration is complete. The src VM should remain
      * running, but in paused state until the destination can
@@ -4272,8 +4801,8 @@ qemuMigrationSrcPerformPeer2Peer3(virQEMUDriverPtr driver,
     cookieinlen = cookieoutlen;
     cookieoutlen = 0;
     if (flags & VIR_MIGRATE_TUNNELLED) {
-        ret = qemuMigrationSrcPerformTunnel(driver, vm, st, persist_xml,
-                                            cookiein, cookieinlen,
+        ret = qemuMigrationSrcPerformTunnel(driver, vm, streams, nstreams,
+                                            persist_xml, cookiein, cookieinlen,
                                             &cookieout, &cookieoutlen,
                                             flags, bandwidth, dconn, graphicsuri,
                                             nmigrate_disks, migrate_disks,
@@ -4413,6 +4942,15 @@ qemuMigrationSrcPerformPeer2Peer3(virQEMUDriverPtr driver,
 
     virObjectUnref(st);
 
+    if (conns) {
+        qemuDomainObjEnterRemote(vm);
+        for (i = 1; i < nstreams; i++) {
+            virObjectUnref(streams[i]);
+            virObjectUnref(conns[i]);
+        }
+        ignore_value(qemuDomainObjExitRemote(vm, false));
+    }
+
     virErrorRestore(&orig_err);
     VIR_FREE(uri_out);
     VIR_FREE(cookiein);
@@ -4471,6 +5009,7 @@ qemuMigrationSrcPerformPeer2Peer(virQEMUDriverPtr driver,
     virErrorPtr orig_err = NULL;
     bool offline = !!(flags & VIR_MIGRATE_OFFLINE);
     bool dstOffline = false;
+    bool dstTunnelStripes = false;
     virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
     bool useParams;
 
@@ -4544,6 +5083,9 @@ qemuMigrationSrcPerformPeer2Peer(virQEMUDriverPtr driver,
     if (offline)
         dstOffline = VIR_DRV_SUPPORTS_FEATURE(dconn->driver, dconn,
                                               VIR_DRV_FEATURE_MIGRATION_OFFLINE);
+    if (qemuMigrationParamsGetTunnelStreams(migParams) > 1)
+        dstTunnelStripes = VIR_DRV_SUPPORTS_FEATURE(dconn->driver, dconn,
+                                                    VIR_DRV_FEATURE_MIGRATION_TUNNEL_STRIPES);
     if (qemuDomainObjExitRemote(vm, !offline) < 0)
         goto cleanup;
 
@@ -4569,6 +5111,14 @@ qemuMigrationSrcPerformPeer2Peer(virQEMUDriverPtr driver,
         goto cleanup;
     }
 
+    if (qemuMigrationParamsGetTunnelStreams(migParams) > 1 &&
+        (!*v3proto || !useParams || !dstTunnelStripes)) {
+        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED, "%s",
+                       _("tunnelled migration over several streams is not "
+                         "supported by the destination host"));
+        goto cleanup;
+    }
+
     /* Change protection is only required on the source side (us), and
      * only for v3 migration when begin and perform are separate jobs.
      * But peer-2-peer is already a single job, and we still want to
@@ -4987,6 +5537,10 @@ qemuMigrationDstFinish(virQEMUDriverPtr driver,
     port = priv->migrationPort;
     priv->migrationPort = 0;
 
+    /* All stripes were finished by the source if it succeeded */
+    qemuMigrationTunnelStripesFree(priv->migTunnelStripes, retcode != 0);
+    priv->migTunnelStripes = NULL;
+
     if (!qemuMigrationJobIsActive(vm, QEMU_ASYNC_JOB_MIGRATION_IN)) {
         qemuMigrationDstErrorReport(driver, vm->def->name);
         goto cleanup;
@@ -5208,6 +5762,11 @@ qemuMigrationDstFinish(virQEMUDriverPtr driver,
             priv->job.completed = g_steal_pointer(&jobInfo);
             priv->job.completed->status = QEMU_DOMAIN_JOB_STATUS_COMPLETED;
             priv->job.completed->statsType = QEMU_DOMAIN_JOB_STATS_TYPE_MIGRATION;
+            /* The statistics come from the source, the time spent starting
+             * the domain here is ours */
+            if (priv->job.current)
+                memcpy(priv->job.completed->timing, priv->job.current->timing,
+                       sizeof(priv->job.completed->timing));
         }
 
         if (qemuMigrationBakeCookie(mig, driver, vm,
@@ -5327,7 +5886,7 @@ qemuMigrationSrcToFile(virQEMUDriverPtr driver, virDomainObjPtr vm,
     if (rc < 0)
         goto cleanup;
 
-    rc = qemuMigrationSrcWaitForCompletion(driver, vm, asyncJob, NULL, 0);
+    rc = qemuMigrationSrcWaitForCompletion(driver, vm, asyncJob, NULL, 0, 0);
 
     if (rc < 0) {
         if (rc == -2) {
@@ -84,6 +84,8 @@
     VIR_MIGRATE_PARAM_BANDWIDTH_POSTCOPY, VIR_TYPED_PARAM_ULLONG, \
     VIR_MIGRATE_PARAM_PARALLEL_CONNECTIONS, VIR_TYPED_PARAM_INT, \
     VIR_MIGRATE_PARAM_TLS_DESTINATION, VIR_TYPED_PARAM_STRING, \
+    VIR_MIGRATE_PARAM_TUNNEL_STREAMS,   VIR_TYPED_PARAM_INT, \
+    VIR_MIGRATE_PARAM_POSTCOPY_AUTO_DOWNTIME, VIR_TYPED_PARAM_ULLONG, \
     NULL
 
 
@@ -134,6 +136,11 @@ qemuMigrationDstPrepareTunnel(virQEMUDriverPtr driver,
                               qemuMigrationParamsPtr migParams,
                               unsigned long flags);
 
+int
+qemuMigrationDstPrepareTunnelStripe(virDomainObjPtr vm,
+                                    virStreamPtr st,
+                                    unsigned int stripe);
+
 int
 qemuMigrationDstPrepareDirect(virQEMUDriverPtr driver,
                               virConnectPtr dconn,
@@ -51,6 +51,7 @@ VIR_ENUM_IMPL(qemuMigrationCookieFlag,
               "cpu",
               "allowReboot",
               "capabilities",
+              "multifd",
 );
 
 
@@ -859,6 +860,10 @@ qemuMigrationCookieXMLFormat(virQEMUDriverPtr driver,
     if (mig->flags & QEMU_MIGRATION_COOKIE_CAPS)
         qemuMigrationCookieCapsXMLFormat(buf, mig->caps);
 
+    if (mig->flags & QEMU_MIGRATION_COOKIE_MULTIFD)
+        virBufferAsprintf(buf, "<multifd channels='%u'/>\n",
+                          mig->multifdChannels);
+
     virBufferAdjustIndent(buf, -2);
     virBufferAddLit(buf, "</qemu-migration>\n");
     return 0;
@@ -1359,6 +1364,15 @@ qemuMigrationCookieXMLParse(qemuMigrationCookiePtr mig,
         !(mig->caps = qemuMigrationCookieCapsXMLParse(ctxt)))
         goto error;
 
+    if (flags & QEMU_MIGRATION_COOKIE_MULTIFD &&
+        virXPathBoolean("boolean(./multifd)", ctxt) &&
+        virXPathUInt("string(./multifd/@channels)", ctxt,
+                     &mig->multifdChannels) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("malformed multifd channels in migration cookie"));
+        goto error;
+    }
+
     return 0;
 
  error:
@@ -1448,6 +1462,10 @@ qemuMigrationBakeCookie(qemuMigrationCookiePtr mig,
         qemuMigrationCookieAddCaps(mig, dom, party) < 0)
         return -1;
 
+    /* The number of channels is filled in by the caller */
+    if (flags & QEMU_MIGRATION_COOKIE_MULTIFD && mig->multifdChannels > 0)
+        mig->flags |= QEMU_MIGRATION_COOKIE_MULTIFD;
+
     if (!(*cookieout = qemuMigrationCookieXMLFormatStr(driver, priv->qemuCaps, mig)))
         return -1;
 
@@ -25,11 +25,13 @@
 #include "virerror.h"
 #include "viralloc.h"
 #include "virstring.h"
+#include "virhostcpu.h"
 
 #include "qemu_alias.h"
 #include "qemu_hotplug.h"
 #include "qemu_migration.h"
 #include "qemu_migration_params.h"
+#include "qemu_migration_tunnel.h"
 #define LIBVIRT_QEMU_MIGRATION_PARAMSPRIV_H_ALLOW
 #include "qemu_migration_paramspriv.h"
 #include "qemu_monitor.h"
@@ -40,6 +42,11 @@ VIR_LOG_INIT("qemu.qemu_migration_params");
 
 #define QEMU_MIGRATION_TLS_ALIAS_BASE "libvirt_migrate"
 
+/* Bounds for the number of multifd channels picked automatically, the
+ * lower one matches QEMU's own default */
+#define QEMU_MIGRATION_MULTIFD_CHANNELS_AUTO_MIN 2
+#define QEMU_MIGRATION_MULTIFD_CHANNELS_AUTO_MAX 8
+
 typedef enum {
     QEMU_MIGRATION_PARAM_TYPE_INT,
     QEMU_MIGRATION_PARAM_TYPE_ULL,
@@ -63,6 +70,8 @@ struct _qemuMigrationParams {
     unsigned long long compMethods; /* bit-wise OR of qemuMigrationCompressMethod */
     virBitmapPtr caps;
     qemuMigrationParamValue params[QEMU_MIGRATION_PARAM_LAST];
+    int tunnelStreams; /* streams used by tunnelled migration, 0 if unset */
+    unsigned long long postcopyAutoDowntime; /* ms, 0 if unset */
 };
 
 typedef enum {
@@ -241,6 +250,99 @@ qemuMigrationParamsGetAlwaysOnCaps(qemuMigrationParty party)
 }
 
 
+/**
+ * qemuMigrationParamsGetTunnelStreams:
+ * @migParams: migration parameters
+ *
+ * Returns the number of streams tunnelled migration data should be
+ * striped over, which is 1 unless requested otherwise.
+ */
+int
+qemuMigrationParamsGetTunnelStreams(qemuMigrationParamsPtr migParams)
+{
+    return MAX(migParams->tunnelStreams, 1);
+}
+
+
+/**
+ * qemuMigrationParamsGetPostcopyAutoDowntime:
+ * @migParams: migration parameters
+ *
+ * Returns the downtime in milliseconds pre-copy migration is expected to
+ * reach before the migration is switched to post-copy automatically, or 0
+ * if the switch is left to the user.
+ */
+unsigned long long
+qemuMigrationParamsGetPostcopyAutoDowntime(qemuMigrationParamsPtr migParams)
+{
+    return migParams->postcopyAutoDowntime;
+}
+
+
+/**
+ * qemuMigrationParamsGetAutoMultiFD:
+ *
+ * Returns the number of multifd channels this host would like to use for
+ * a parallel migration for which no explicit number was requested. Every
+ * channel is served by its own thread on both ends of the migration, thus
+ * the number grows with the host CPUs available.
+ */
+unsigned int
+qemuMigrationParamsGetAutoMultiFD(void)
+{
+    int ncpus = virHostCPUGetCount();
+
+    if (ncpus <= 0) {
+        virResetLastError();
+        return QEMU_MIGRATION_MULTIFD_CHANNELS_AUTO_MIN;
+    }
+
+    return MIN(MAX(ncpus / 4, QEMU_MIGRATION_MULTIFD_CHANNELS_AUTO_MIN),
+               QEMU_MIGRATION_MULTIFD_CHANNELS_AUTO_MAX);
+}
+
+
+/**
+ * qemuMigrationParamsSetAutoMultiFD:
+ * @migParams: migration parameters
+ * @remote: number of channels sent by the other side, 0 if none
+ * @party: the side @migParams belong to
+ *
+ * Both sides of a parallel migration have to agree on the number of
+ * multifd channels. When the user did not set it, the source offers its
+ * preferred number in the Begin phase, the destination picks the smaller
+ * of the offer and its own preference and the source uses the picked
+ * number. Nothing is changed unless the other side took part in this (so
+ * that both keep using QEMU's default) or the user set the number.
+ *
+ * Returns the number of channels set in @migParams or 0 if they were left
+ * untouched.
+ */
+unsigned int
+qemuMigrationParamsSetAutoMultiFD(qemuMigrationParamsPtr migParams,
+                                  unsigned int remote,
+                                  qemuMigrationParty party)
+{
+    qemuMigrationParamValuePtr pv;
+    unsigned int channels = remote;
+
+    pv = &migParams->params[QEMU_MIGRATION_PARAM_MULTIFD_CHANNELS];
+
+    if (remote == 0 || pv->set ||
+        !virBitmapIsBitSet(migParams->caps, QEMU_MIGRATION_CAP_MULTIFD))
+        return 0;
+
+    if (party == QEMU_MIGRATION_DESTINATION)
+        channels = MIN(channels, qemuMigrationParamsGetAutoMultiFD());
+
+    VIR_DEBUG("Using %u multifd channels (remote %u)", channels, remote);
+
+    pv->value.i = channels;
+    pv->set = true;
+    return channels;
+}
+
+
 qemuMigrationParamsPtr
 qemuMigrationParamsNew(void)
 {
@@ -534,6 +636,69 @@ qemuMigrationParamsSetCompression(virTypedParameterPtr params,
 }
 
 
+static int
+qemuMigrationParamsSetTunnelStreams(virTypedParameterPtr params,
+                                    int nparams,
+                                    unsigned long flags,
+                                    qemuMigrationParamsPtr migParams)
+{
+    int streams = 0;
+    int rc;
+
+    if ((rc = virTypedParamsGetInt(params, nparams,
+                                   VIR_MIGRATE_PARAM_TUNNEL_STREAMS,
+                                   &streams)) <= 0)
+        return rc;
+
+    if (streams < 1 || streams > QEMU_MIGRATION_TUNNEL_STREAMS_MAX) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("number of tunnel streams must be between 1 and %d"),
+                       QEMU_MIGRATION_TUNNEL_STREAMS_MAX);
+        return -1;
+    }
+
+    if (!(flags & VIR_MIGRATE_TUNNELLED)) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("Turn tunnelled migration on to tune tunnel streams"));
+        return -1;
+    }
+
+    migParams->tunnelStreams = streams;
+    return 0;
+}
+
+
+static int
+qemuMigrationParamsSetPostcopyAutoDowntime(virTypedParameterPtr params,
+                                           int nparams,
+                                           unsigned long flags,
+                                           qemuMigrationParamsPtr migParams)
+{
+    unsigned long long downtime = 0;
+    int rc;
+
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_MIGRATE_PARAM_POSTCOPY_AUTO_DOWNTIME,
+                                      &downtime)) <= 0)
+        return rc;
+
+    if (downtime == 0) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("post-copy auto switch downtime must be greater than 0"));
+        return -1;
+    }
+
+    if (!(flags & VIR_MIGRATE_POSTCOPY)) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("Turn post-copy migration on to switch to it automatically"));
+        return -1;
+    }
+
+    migParams->postcopyAutoDowntime = downtime;
+    return 0;
+}
+
+
 qemuMigrationParamsPtr
 qemuMigrationParamsFromFlags(virTypedParameterPtr params,
                              int nparams,
@@ -610,6 +775,13 @@ qemuMigrationParamsFromFlags(virTypedParameterPtr params,
     if (qemuMigrationParamsSetCompression(params, nparams, flags, migParams) < 0)
         goto error;
 
+    if (qemuMigrationParamsSetTunnelStreams(params, nparams, flags, migParams) < 0)
+        goto error;
+
+    if (qemuMigrationParamsSetPostcopyAutoDowntime(params, nparams,
+                                                   flags, migParams) < 0)
+        goto error;
+
     return migParams;
 
  error:
@@ -627,6 +799,12 @@ qemuMigrationParamsDump(qemuMigrationParamsPtr migParams,
 {
     size_t i;
 
+    if (migParams->tunnelStreams > 1 &&
+        virTypedParamsAddInt(params, nparams, maxparams,
+                             VIR_MIGRATE_PARAM_TUNNEL_STREAMS,
+                             migParams->tunnelStreams) < 0)
+        return -1;
+
     if (migParams->compMethods == 1ULL << QEMU_MIGRATION_COMPRESS_XBZRLE &&
         !migParams->params[QEMU_MIGRATION_PARAM_XBZRLE_CACHE_SIZE].set) {
         *flags |= VIR_MIGRATE_COMPRESSED;
@@ -87,6 +87,20 @@ qemuMigrationParamsDump(qemuMigrationParamsPtr migParams,
                         int *maxparams,
                         unsigned long *flags);
 
+int
+qemuMigrationParamsGetTunnelStreams(qemuMigrationParamsPtr migParams);
+
+unsigned long long
+qemuMigrationParamsGetPostcopyAutoDowntime(qemuMigrationParamsPtr migParams);
+
+unsigned int
+qemuMigrationParamsGetAutoMultiFD(void);
+
+unsigned int
+qemuMigrationParamsSetAutoMultiFD(qemuMigrationParamsPtr migParams,
+                                  unsigned int remote,
+                                  qemuMigrationParty party);
+
 qemuMigrationParamsPtr
 qemuMigrationParamsNew(void);
 
@@ -0,0 +1,467 @@
+/*
+ * qemu_migration_sched.c: host wide limits of outgoing QEMU migrations
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include "qemu_migration_sched.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "virlog.h"
+#include "virthread.h"
+
+#define VIR_FROM_THIS VIR_FROM_QEMU
+
+VIR_LOG_INIT("qemu.qemu_migration_sched");
+
+/*
+ * Outgoing migrations register here before QEMU starts sending data.
+ * At most maxJobs of them are active at a time, the others wait in
+ * the order they arrived in. If a bandwidth budget is set, it is
+ * split among the active migrations whenever one starts or finishes;
+ * the migrations pick up their new share while waiting for QEMU to
+ * complete (see qemuMigrationSchedGetShare).
+ *
+ * Domains are never locked while holding the lock of the scheduler.
+ */
+typedef struct _qemuMigrationSchedEntry qemuMigrationSchedEntry;
+typedef qemuMigrationSchedEntry *qemuMigrationSchedEntryPtr;
+struct _qemuMigrationSchedEntry {
+    virDomainObjPtr vm;
+    unsigned long requested; /* MiB/s asked for by the migration */
+    unsigned long share;     /* MiB/s granted while active */
+    bool active;
+    bool cancelled;
+    bool changed;            /* share differs from the one last fetched */
+};
+
+/* Whether the budget grants less than what the migration asked for */
+#define ENTRY_LIMITED(entry) \
+    (entry->share != 0 && \
+     (entry->requested == 0 || entry->share < entry->requested))
+
+struct _qemuMigrationSched {
+    virMutex lock;
+    virCond cond;
+
+    unsigned int maxJobs;         /* 0 means unlimited */
+    unsigned long long bandwidth; /* MiB/s, 0 means unlimited */
+
+    qemuMigrationSchedEntryPtr *entries; /* in order of arrival */
+    size_t nentries;
+    unsigned int nactive;
+};
+
+
+/**
+ * qemuMigrationSchedSplit:
+ * @bandwidth: the budget in MiB/s, 0 for unlimited
+ * @requested: the bandwidth each migration asked for, 0 for unlimited
+ * @shares: filled with the bandwidth granted to each migration
+ * @n: number of migrations
+ *
+ * Splits @bandwidth evenly among @n migrations, except that none of
+ * them gets more than it asked for. Whatever the migrations asking for
+ * less than an even share leave unused goes to the others.
+ */
+void
+qemuMigrationSchedSplit(unsigned long long bandwidth,
+                        const unsigned long *requested,
+                        unsigned long *shares,
+                        size_t n)
+{
+    g_autofree bool *done = NULL;
+    size_t left = n;
+    size_t i;
+
+    if (bandwidth == 0) {
+        for (i = 0; i < n; i++)
+            shares[i] = requested[i];
+        return;
+    }
+
+    done = g_new0(bool, n);
+
+#define WANTED(idx) (requested[idx] ? requested[idx] : ULONG_MAX)
+
+    while (left > 0) {
+        unsigned long long even = MAX(bandwidth / left, 1);
+        size_t min = n;
+
+        for (i = 0; i < n; i++) {
+            if (!done[i] && (min == n || WANTED(i) < WANTED(min)))
+                min = i;
+        }
+
+        shares[min] = MIN(WANTED(min), even);
+        bandwidth -= MIN(shares[min], bandwidth);
+        done[min] = true;
+        left--;
+    }
+
+#undef WANTED
+}
+
+
+/* Must be called with the scheduler locked */
+static void
+qemuMigrationSchedRebalance(qemuMigrationSchedPtr sched)
+{
+    g_autofree unsigned long *requested = NULL;
+    g_autofree unsigned long *shares = NULL;
+    size_t n = 0;
+    size_t i;
+
+    if (sched->nactive == 0)
+        return;
+
+    requested = g_new0(unsigned long, sched->nactive);
+    shares = g_new0(unsigned long, sched->nactive);
+
+    for (i = 0; i < sched->nentries; i++) {
+        if (sched->entries[i]->active)
+            requested[n++] = sched->entries[i]->requested;
+    }
+
+    qemuMigrationSchedSplit(sched->bandwidth, requested, shares, n);
+
+    n = 0;
+    for (i = 0; i < sched->nentries; i++) {
+        qemuMigrationSchedEntryPtr entry = sched->entries[i];
+
+        if (!entry->active)
+            continue;
+
+        if (entry->share != shares[n]) {
+            VIR_DEBUG("Migration of domain %s gets %lu MiB/s instead of %lu",
+                      entry->vm->def->name, shares[n], entry->share);
+            entry->share = shares[n];
+            entry->changed = true;
+        }
+        n++;
+    }
+}
+
+
+/* Must be called with the scheduler locked */
+static void
+qemuMigrationSchedAdmit(qemuMigrationSchedPtr sched)
+{
+    bool admitted = false;
+    size_t i;
+
+    for (i = 0; i < sched->nentries; i++) {
+        qemuMigrationSchedEntryPtr entry = sched->entries[i];
+
+        if (sched->maxJobs > 0 && sched->nactive >= sched->maxJobs)
+            break;
+
+        if (entry->active || entry->cancelled)
+            continue;
+
+        entry->active = true;
+        sched->nactive++;
+        admitted = true;
+    }
+
+    qemuMigrationSchedRebalance(sched);
+
+    if (admitted)
+        virCondBroadcast(&sched->cond);
+}
+
+
+/* Must be called with the scheduler locked */
+static ssize_t
+qemuMigrationSchedFind(qemuMigrationSchedPtr sched,
+                       virDomainObjPtr vm)
+{
+    size_t i;
+
+    for (i = 0; i < sched->nentries; i++) {
+        if (sched->entries[i]->vm == vm)
+            return i;
+    }
+
+    return -1;
+}
+
+
+/* Must be called with the scheduler locked */
+static void
+qemuMigrationSchedRemove(qemuMigrationSchedPtr sched,
+                         size_t idx)
+{
+    qemuMigrationSchedEntryPtr entry = sched->entries[idx];
+
+    if (entry->active)
+        sched->nactive--;
+
+    VIR_DELETE_ELEMENT(sched->entries, idx, sched->nentries);
+    g_free(entry);
+}
+
+
+qemuMigrationSchedPtr
+qemuMigrationSchedNew(unsigned int maxJobs,
+                      unsigned long long bandwidth)
+{
+    qemuMigrationSchedPtr sched = g_new0(qemuMigrationSched, 1);
+
+    if (virMutexInit(&sched->lock) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init mutex"));
+        g_free(sched);
+        return NULL;
+    }
+
+    if (virCondInit(&sched->cond) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init condition"));
+        virMutexDestroy(&sched->lock);
+        g_free(sched);
+        return NULL;
+    }
+
+    sched->maxJobs = maxJobs;
+    sched->bandwidth = bandwidth;
+
+    return sched;
+}
+
+
+void
+qemuMigrationSchedFree(qemuMigrationSchedPtr sched)
+{
+    if (!sched)
+        return;
+
+    while (sched->nentries > 0)
+        qemuMigrationSchedRemove(sched, 0);
+
+    virCondDestroy(&sched->cond);
+    virMutexDestroy(&sched->lock);
+    g_free(sched);
+}
+
+
+void
+qemuMigrationSchedSetLimits(qemuMigrationSchedPtr sched,
+                            unsigned int maxJobs,
+                            unsigned long long bandwidth)
+{
+    virMutexLock(&sched->lock);
+
+    VIR_DEBUG("maxJobs=%u bandwidth=%llu", maxJobs, bandwidth);
+
+    sched->maxJobs = maxJobs;
+    sched->bandwidth = bandwidth;
+    qemuMigrationSchedAdmit(sched);
+
+    virMutexUnlock(&sched->lock);
+}
+
+
+void
+qemuMigrationSchedGetLimits(qemuMigrationSchedPtr sched,
+                            unsigned int *maxJobs,
+                            unsigned long long *bandwidth,
+                            unsigned int *active,
+                            unsigned int *queued)
+{
+    size_t i;
+
+    virMutexLock(&sched->lock);
+
+    *maxJobs = sched->maxJobs;
+    *bandwidth = sched->bandwidth;
+    *active = sched->nactive;
+    *queued = 0;
+    for (i = 0; i < sched->nentries; i++) {
+        if (!sched->entries[i]->active && !sched->entries[i]->cancelled)
+            (*queued)++;
+    }
+
+    virMutexUnlock(&sched->lock);
+}
+
+
+/**
+ * qemuMigrationSchedAcquire:
+ * @sched: the scheduler
+ * @vm: the domain about to be migrated, locked
+ * @bandwidth: the bandwidth in MiB/s asked for
+ * @share: filled with the bandwidth granted
+ * @limited: set to whether @share is less than @bandwidth
+ *
+ * Waits until @vm may start migrating. The domain is unlocked while
+ * waiting, so that its job can be queried or aborted. Once this
+ * succeeded, qemuMigrationSchedRelease must be called when the
+ * migration is done.
+ *
+ * Returns 0 on success, -1 if the migration was cancelled while
+ * waiting.
+ */
+int
+qemuMigrationSchedAcquire(qemuMigrationSchedPtr sched,
+                          virDomainObjPtr vm,
+                          unsigned long bandwidth,
+                          unsigned long *share,
+                          bool *limited)
+{
+    qemuMigrationSchedEntryPtr entry = g_new0(qemuMigrationSchedEntry, 1);
+    bool waited = false;
+    int ret = -1;
+
+    entry->vm = vm;
+    entry->requested = bandwidth;
+
+    virMutexLock(&sched->lock);
+
+    ignore_value(VIR_APPEND_ELEMENT_COPY(sched->entries,
+                                         sched->nentries, entry));
+    qemuMigrationSchedAdmit(sched);
+
+    if (!entry->active) {
+        VIR_DEBUG("Migration of domain %s waits for one of %u running ones",
+                  vm->def->name, sched->nactive);
+        virObjectUnlock(vm);
+        waited = true;
+
+        while (!entry->active && !entry->cancelled) {
+            if (virCondWait(&sched->cond, &sched->lock) < 0) {
+                virReportSystemError(errno, "%s",
+                                     _("failed to wait for a migration slot"));
+                break;
+            }
+        }
+    }
+
+    if (entry->active) {
+        *share = entry->share;
+        *limited = ENTRY_LIMITED(entry);
+        entry->changed = false;
+        ret = 0;
+    } else {
+        if (entry->cancelled)
+            virReportError(VIR_ERR_OPERATION_ABORTED, "%s",
+                           _("migration canceled while waiting for a slot"));
+        qemuMigrationSchedRemove(sched, qemuMigrationSchedFind(sched, vm));
+        qemuMigrationSchedAdmit(sched);
+    }
+
+    virMutexUnlock(&sched->lock);
+
+    if (waited)
+        virObjectLock(vm);
+
+    return ret;
+}
+
+
+void
+qemuMigrationSchedRelease(qemuMigrationSchedPtr sched,
+                          virDomainObjPtr vm)
+{
+    ssize_t idx;
+
+    virMutexLock(&sched->lock);
+
+    if ((idx = qemuMigrationSchedFind(sched, vm)) >= 0) {
+        qemuMigrationSchedRemove(sched, idx);
+        qemuMigrationSchedAdmit(sched);
+    }
+
+    virMutexUnlock(&sched->lock);
+}
+
+
+/* Wakes up the migration of @vm if it is still waiting for a slot */
+void
+qemuMigrationSchedCancel(qemuMigrationSchedPtr sched,
+                         virDomainObjPtr vm)
+{
+    ssize_t idx;
+
+    if (!sched)
+        return;
+
+    virMutexLock(&sched->lock);
+
+    if ((idx = qemuMigrationSchedFind(sched, vm)) >= 0 &&
+        !sched->entries[idx]->active) {
+        sched->entries[idx]->cancelled = true;
+        virCondBroadcast(&sched->cond);
+    }
+
+    virMutexUnlock(&sched->lock);
+}
+
+
+bool
+qemuMigrationSchedIsActive(qemuMigrationSchedPtr sched,
+                           virDomainObjPtr vm)
+{
+    ssize_t idx;
+    bool ret;
+
+    if (!sched)
+        return false;
+
+    virMutexLock(&sched->lock);
+    ret = (idx = qemuMigrationSchedFind(sched, vm)) >= 0 &&
+          sched->entries[idx]->active;
+    virMutexUnlock(&sched->lock);
+
+    return ret;
+}
+
+
+/**
+ * qemuMigrationSchedGetShare:
+ * @sched: the scheduler
+ * @vm: the migrating domain
+ * @share: filled with the bandwidth granted
+ * @limited: set to whether @share is less than what the migration asked for
+ *
+ * Returns true and fills @share and @limited if the bandwidth granted to the
+ * migration of @vm changed since it was last fetched, false otherwise.
+ */
+bool
+qemuMigrationSchedGetShare(qemuMigrationSchedPtr sched,
+                           virDomainObjPtr vm,
+                           unsigned long *share,
+                           bool *limited)
+{
+    qemuMigrationSchedEntryPtr entry;
+    ssize_t idx;
+    bool ret = false;
+
+    virMutexLock(&sched->lock);
+
+    if ((idx = qemuMigrationSchedFind(sched, vm)) >= 0 &&
+        (entry = sched->entries[idx])->active &&
+        entry->changed) {
+        *share = entry->share;
+        *limited = ENTRY_LIMITED(entry);
+        entry->changed = false;
+        ret = true;
+    }
+
+    virMutexUnlock(&sched->lock);
+
+    return ret;
+}
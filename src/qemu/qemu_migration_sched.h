@@ -0,0 +1,76 @@
+/*
+ * qemu_migration_sched.h: host wide limits of outgoing QEMU migrations
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "internal.h"
+#include "domain_conf.h"
+
+typedef struct _qemuMigrationSched qemuMigrationSched;
+typedef qemuMigrationSched *qemuMigrationSchedPtr;
+
+qemuMigrationSchedPtr
+qemuMigrationSchedNew(unsigned int maxJobs,
+                      unsigned long long bandwidth);
+
+void
+qemuMigrationSchedFree(qemuMigrationSchedPtr sched);
+
+void
+qemuMigrationSchedSetLimits(qemuMigrationSchedPtr sched,
+                            unsigned int maxJobs,
+                            unsigned long long bandwidth);
+
+void
+qemuMigrationSchedGetLimits(qemuMigrationSchedPtr sched,
+                            unsigned int *maxJobs,
+                            unsigned long long *bandwidth,
+                            unsigned int *active,
+                            unsigned int *queued);
+
+int
+qemuMigrationSchedAcquire(qemuMigrationSchedPtr sched,
+                          virDomainObjPtr vm,
+                          unsigned long bandwidth,
+                          unsigned long *share,
+                          bool *limited);
+
+void
+qemuMigrationSchedRelease(qemuMigrationSchedPtr sched,
+                          virDomainObjPtr vm);
+
+void
+qemuMigrationSchedCancel(qemuMigrationSchedPtr sched,
+                         virDomainObjPtr vm);
+
+bool
+qemuMigrationSchedIsActive(qemuMigrationSchedPtr sched,
+                           virDomainObjPtr vm);
+
+bool
+qemuMigrationSchedGetShare(qemuMigrationSchedPtr sched,
+                           virDomainObjPtr vm,
+                           unsigned long *share,
+                           bool *limited);
+
+void
+qemuMigrationSchedSplit(unsigned long long bandwidth,
+                        const unsigned long *requested,
+                        unsigned long *shares,
+                        size_t n);
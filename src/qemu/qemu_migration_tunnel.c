@@ -0,0 +1,389 @@
+/*
+ * qemu_migration_tunnel.c: QEMU tunnelled migration striped over streams
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <poll.h>
+
+#include "qemu_migration_tunnel.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "virfile.h"
+#include "virlog.h"
+#include "virthread.h"
+#include "virutil.h"
+
+#define VIR_FROM_THIS VIR_FROM_QEMU
+
+VIR_LOG_INIT("qemu.qemu_migration_tunnel");
+
+/*
+ * The destination side of a striped tunnel. Every stripe stream
+ * writes into its own pipe and a single thread reads the frames back
+ * from the pipes in the order they were cut, writing their payload
+ * into the pipe QEMU reads the incoming migration from.
+ */
+struct _qemuMigrationTunnelStripes {
+    virThread thread;
+    size_t nstripes;
+    int *readFDs;
+    int *writeFDs;  /* -1 once the stripe was handed over to a stream */
+    int fd;         /* QEMU's end of the tunnel */
+    int wakeupRecvFD;
+    int wakeupSendFD;
+};
+
+
+void
+qemuMigrationTunnelFrameEncode(char *header,
+                               size_t len)
+{
+    header[0] = (len >> 24) & 0xff;
+    header[1] = (len >> 16) & 0xff;
+    header[2] = (len >> 8) & 0xff;
+    header[3] = len & 0xff;
+}
+
+
+static size_t
+qemuMigrationTunnelFrameDecode(const char *header)
+{
+    const unsigned char *h = (const unsigned char *) header;
+
+    return ((size_t) h[0] << 24) | (h[1] << 16) | (h[2] << 8) | h[3];
+}
+
+
+/* Waits until @fd is ready for @events. Returns -1 if an error
+ * occurred or the thread was asked to stop. */
+static int
+qemuMigrationTunnelStripesWait(qemuMigrationTunnelStripesPtr tunnel,
+                               int fd,
+                               short events)
+{
+    struct pollfd fds[2];
+
+    fds[0].fd = fd;
+    fds[1].fd = tunnel->wakeupRecvFD;
+
+    for (;;) {
+        fds[0].events = events;
+        fds[1].events = POLLIN;
+        fds[0].revents = fds[1].revents = 0;
+
+        if (poll(fds, G_N_ELEMENTS(fds), -1) < 0) {
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+            virReportSystemError(errno, "%s",
+                                 _("poll failed in migration tunnel"));
+            return -1;
+        }
+
+        if (fds[1].revents) {
+            VIR_DEBUG("Migration tunnel was asked to abort");
+            return -1;
+        }
+
+        if (fds[0].revents)
+            return 0;
+    }
+}
+
+
+/* Returns 1 when @len bytes were read, 0 on EOF before the first
+ * byte, and -1 on error. */
+static int
+qemuMigrationTunnelStripesRead(qemuMigrationTunnelStripesPtr tunnel,
+                               int fd,
+                               char *buf,
+                               size_t len)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t got;
+
+        if (qemuMigrationTunnelStripesWait(tunnel, fd, POLLIN) < 0)
+            return -1;
+
+        if ((got = read(fd, buf + done, len - done)) < 0) {
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+            virReportSystemError(errno, "%s",
+                                 _("failed to read from migration tunnel"));
+            return -1;
+        }
+
+        if (got == 0) {
+            if (done == 0)
+                return 0;
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("truncated frame in migration tunnel"));
+            return -1;
+        }
+
+        done += got;
+    }
+
+    return 1;
+}
+
+
+static int
+qemuMigrationTunnelStripesWrite(qemuMigrationTunnelStripesPtr tunnel,
+                                const char *buf,
+                                size_t len)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t wrote;
+
+        if (qemuMigrationTunnelStripesWait(tunnel, tunnel->fd, POLLOUT) < 0)
+            return -1;
+
+        if ((wrote = write(tunnel->fd, buf + done, len - done)) < 0) {
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+            virReportSystemError(errno, "%s",
+                                 _("tunnelled migration failed to write to qemu"));
+            return -1;
+        }
+
+        done += wrote;
+    }
+
+    return 0;
+}
+
+
+static void
+qemuMigrationTunnelStripesFunc(void *opaque)
+{
+    qemuMigrationTunnelStripesPtr tunnel = opaque;
+    char *buffer = NULL;
+    size_t buflen = 0;
+    size_t frame;
+
+    VIR_DEBUG("Running striped migration tunnel; stripes=%zu, fd=%d",
+              tunnel->nstripes, tunnel->fd);
+
+    for (frame = 0; ; frame++) {
+        int fd = tunnel->readFDs[frame % tunnel->nstripes];
+        char header[QEMU_MIGRATION_TUNNEL_FRAME_HEADER];
+        size_t len;
+        int rc;
+
+        if ((rc = qemuMigrationTunnelStripesRead(tunnel, fd, header,
+                                                 sizeof(header))) < 0)
+            goto cleanup;
+
+        /* The stream the next frame was due on got finished */
+        if (rc == 0)
+            break;
+
+        len = qemuMigrationTunnelFrameDecode(header);
+        if (len == 0 || len > QEMU_MIGRATION_TUNNEL_FRAME_MAX) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("invalid frame length %zu in migration tunnel"),
+                           len);
+            goto cleanup;
+        }
+
+        if (len > buflen) {
+            if (VIR_REALLOC_N(buffer, len) < 0)
+                goto cleanup;
+            buflen = len;
+        }
+
+        if ((rc = qemuMigrationTunnelStripesRead(tunnel, fd, buffer, len)) <= 0) {
+            if (rc == 0)
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("truncated frame in migration tunnel"));
+            goto cleanup;
+        }
+
+        if (qemuMigrationTunnelStripesWrite(tunnel, buffer, len) < 0)
+            goto cleanup;
+    }
+
+    VIR_DEBUG("Striped migration tunnel finished after %zu frames", frame);
+
+ cleanup:
+    /* Either way QEMU gets to see the end of the migration stream */
+    VIR_FORCE_CLOSE(tunnel->fd);
+    VIR_FREE(buffer);
+}
+
+
+/**
+ * qemuMigrationTunnelStripesNew:
+ * @nstripes: number of streams the migration data is striped over
+ * @fd: write end of the pipe QEMU reads incoming migration data from
+ *
+ * Sets up a pipe for each stripe and starts a thread which reassembles
+ * the migration stream from them into @fd. Every stripe has to be
+ * claimed with qemuMigrationTunnelStripesClaim and the returned file
+ * descriptor passed to the stream carrying it.
+ *
+ * On success @fd is owned by the returned object.
+ *
+ * Returns the new object or NULL on error.
+ */
+qemuMigrationTunnelStripesPtr
+qemuMigrationTunnelStripesNew(size_t nstripes,
+                              int fd)
+{
+    qemuMigrationTunnelStripesPtr tunnel;
+    int wakeupFD[2] = { -1, -1 };
+    size_t i;
+
+    if (VIR_ALLOC(tunnel) < 0)
+        return NULL;
+
+    tunnel->fd = -1;
+    tunnel->wakeupRecvFD = -1;
+    tunnel->wakeupSendFD = -1;
+
+    if (VIR_ALLOC_N(tunnel->readFDs, nstripes) < 0 ||
+        VIR_ALLOC_N(tunnel->writeFDs, nstripes) < 0)
+        goto error;
+
+    for (i = 0; i < nstripes; i++)
+        tunnel->readFDs[i] = tunnel->writeFDs[i] = -1;
+    tunnel->nstripes = nstripes;
+
+    for (i = 0; i < nstripes; i++) {
+        int fds[2];
+
+        if (virPipe(fds) < 0)
+            goto error;
+
+        tunnel->readFDs[i] = fds[0];
+        tunnel->writeFDs[i] = fds[1];
+    }
+
+    if (virPipe(wakeupFD) < 0)
+        goto error;
+    tunnel->wakeupRecvFD = wakeupFD[0];
+    tunnel->wakeupSendFD = wakeupFD[1];
+
+    if (virSetNonBlock(fd) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot make migration tunnel non-blocking"));
+        goto error;
+    }
+
+    tunnel->fd = fd;
+    if (virThreadCreateFull(&tunnel->thread, true,
+                            qemuMigrationTunnelStripesFunc,
+                            "qemu-mig-stripes",
+                            false,
+                            tunnel) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create migration tunnel thread"));
+        tunnel->fd = -1;
+        goto error;
+    }
+
+    return tunnel;
+
+ error:
+    for (i = 0; i < tunnel->nstripes; i++) {
+        VIR_FORCE_CLOSE(tunnel->readFDs[i]);
+        VIR_FORCE_CLOSE(tunnel->writeFDs[i]);
+    }
+    VIR_FORCE_CLOSE(tunnel->wakeupRecvFD);
+    VIR_FORCE_CLOSE(tunnel->wakeupSendFD);
+    VIR_FREE(tunnel->readFDs);
+    VIR_FREE(tunnel->writeFDs);
+    VIR_FREE(tunnel);
+    return NULL;
+}
+
+
+/**
+ * qemuMigrationTunnelStripesClaim:
+ * @tunnel: striped tunnel
+ * @stripe: stripe index
+ *
+ * Hands over the file descriptor the stream carrying @stripe has to
+ * write into. Each stripe can only be claimed once.
+ *
+ * Returns the file descriptor, which is owned by the caller, or -1
+ * on error.
+ */
+int
+qemuMigrationTunnelStripesClaim(qemuMigrationTunnelStripesPtr tunnel,
+                                size_t stripe)
+{
+    int fd;
+
+    if (stripe >= tunnel->nstripes || tunnel->writeFDs[stripe] < 0) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("migration tunnel stripe %zu is not available"),
+                       stripe);
+        return -1;
+    }
+
+    fd = tunnel->writeFDs[stripe];
+    tunnel->writeFDs[stripe] = -1;
+    return fd;
+}
+
+
+/**
+ * qemuMigrationTunnelStripesFree:
+ * @tunnel: striped tunnel
+ * @cancel: whether to stop reassembling immediately
+ *
+ * Waits for the reassembling thread to finish and frees @tunnel. Unless
+ * @cancel is true, data which was already received is still passed to
+ * QEMU first.
+ */
+void
+qemuMigrationTunnelStripesFree(qemuMigrationTunnelStripesPtr tunnel,
+                               bool cancel)
+{
+    size_t i;
+
+    if (!tunnel)
+        return;
+
+    /* Stripes nobody claimed won't ever deliver anything */
+    for (i = 0; i < tunnel->nstripes; i++)
+        VIR_FORCE_CLOSE(tunnel->writeFDs[i]);
+
+    if (cancel) {
+        char stop = 1;
+
+        if (safewrite(tunnel->wakeupSendFD, &stop, 1) != 1)
+            VIR_WARN("failed to wake up migration tunnel thread");
+    }
+
+    virThreadJoin(&tunnel->thread);
+
+    for (i = 0; i < tunnel->nstripes; i++)
+        VIR_FORCE_CLOSE(tunnel->readFDs[i]);
+    VIR_FORCE_CLOSE(tunnel->wakeupRecvFD);
+    VIR_FORCE_CLOSE(tunnel->wakeupSendFD);
+    VIR_FREE(tunnel->readFDs);
+    VIR_FREE(tunnel->writeFDs);
+    VIR_FREE(tunnel);
+}
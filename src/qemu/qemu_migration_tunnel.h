@@ -0,0 +1,53 @@
+/*
+ * qemu_migration_tunnel.h: QEMU tunnelled migration striped over streams
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "internal.h"
+
+/* Maximum number of streams a tunnelled migration can be striped over */
+#define QEMU_MIGRATION_TUNNEL_STREAMS_MAX 16
+
+/* When a tunnelled migration uses more than one stream, the data read
+ * from QEMU is cut into frames which are sent round robin over the
+ * streams, i.e., frame N always travels on stream N % nstreams. Each
+ * frame starts with its payload length as a 32-bit big endian number. */
+#define QEMU_MIGRATION_TUNNEL_FRAME_HEADER 4
+
+/* Largest frame payload the destination accepts */
+#define QEMU_MIGRATION_TUNNEL_FRAME_MAX (4 * 1024 * 1024)
+
+void
+qemuMigrationTunnelFrameEncode(char *header,
+                               size_t len);
+
+typedef struct _qemuMigrationTunnelStripes qemuMigrationTunnelStripes;
+typedef qemuMigrationTunnelStripes *qemuMigrationTunnelStripesPtr;
+
+qemuMigrationTunnelStripesPtr
+qemuMigrationTunnelStripesNew(size_t nstripes,
+                              int fd);
+
+int
+qemuMigrationTunnelStripesClaim(qemuMigrationTunnelStripesPtr tunnel,
+                                size_t stripe);
+
+void
+qemuMigrationTunnelStripesFree(qemuMigrationTunnelStripesPtr tunnel,
+                               bool cancel);
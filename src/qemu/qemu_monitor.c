@@ -66,6 +66,13 @@ VIR_LOG_INIT("qemu.qemu_monitor");
  */
 #define QEMU_MONITOR_MAX_RESPONSE (10 * 1024 * 1024)
 
+/* The read buffer grows geometrically starting at this size. Once
+ * all data was processed, buffers up to QEMU_MONITOR_KEEP_BUFFER
+ * bytes are kept for the next reply, larger ones are freed so that
+ * an occasional huge reply doesn't pin memory. */
+#define QEMU_MONITOR_MIN_BUFFER 1024
+#define QEMU_MONITOR_KEEP_BUFFER (64 * 1024)
+
 struct _qemuMonitor {
     virObjectLockable parent;
 
@@ -90,6 +97,7 @@ struct _qemuMonitor {
      * code to process & find message boundaries */
     size_t bufferOffset;
     size_t bufferLength;
+    size_t bufferScanned; /* bytes known not to contain a line ending */
     char *buffer;
 
     /* If anything went wrong, this will be fed back
@@ -334,7 +342,7 @@ qemuMonitorIOProcess(qemuMonitorPtr mon)
 
     len = qemuMonitorJSONIOProcess(mon,
                                    mon->buffer, mon->bufferOffset,
-                                   msg);
+                                   &mon->bufferScanned, msg);
     if (len < 0)
         return -1;
 
@@ -342,11 +350,18 @@ qemuMonitorIOProcess(qemuMonitorPtr mon)
         mon->waitGreeting = false;
 
     if (len < mon->bufferOffset) {
-        memmove(mon->buffer, mon->buffer + len, mon->bufferOffset - len);
-        mon->bufferOffset -= len;
-    } else {
+        /* only the trailing partial line is moved */
+        if (len > 0) {
+            memmove(mon->buffer, mon->buffer + len, mon->bufferOffset - len + 1);
+            mon->bufferOffset -= len;
+        }
+        mon->bufferScanned = mon->bufferScanned > len ? mon->bufferScanned - len : 0;
+    } else if (!mon->buffer || mon->bufferLength > QEMU_MONITOR_KEEP_BUFFER) {
         VIR_FREE(mon->buffer);
-        mon->bufferOffset = mon->bufferLength = 0;
+        mon->bufferOffset = mon->bufferLength = mon->bufferScanned = 0;
+    } else {
+        mon->buffer[0] = '\0';
+        mon->bufferOffset = mon->bufferScanned = 0;
     }
 #if DEBUG_IO
     VIR_DEBUG("Process done %d used %d", (int)mon->bufferOffset, len);
@@ -460,18 +475,26 @@ qemuMonitorIORead(qemuMonitorPtr mon)
     size_t avail = mon->bufferLength - mon->bufferOffset;
     int ret = 0;
 
-    if (avail < 1024) {
+    if (avail < QEMU_MONITOR_MIN_BUFFER) {
+        size_t newLength;
+
         if (mon->bufferLength >= QEMU_MONITOR_MAX_RESPONSE) {
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("QEMU monitor reply exceeds buffer size (%d bytes)"),
                            QEMU_MONITOR_MAX_RESPONSE);
             return -1;
         }
-        if (VIR_REALLOC_N(mon->buffer,
-                          mon->bufferLength + 1024) < 0)
+
+        /* Grow geometrically so that large replies don't need
+         * a realloc per every kilobyte received */
+        newLength = MAX(mon->bufferLength * 2,
+                        mon->bufferLength + QEMU_MONITOR_MIN_BUFFER);
+        newLength = MIN(newLength, QEMU_MONITOR_MAX_RESPONSE);
+
+        if (VIR_REALLOC_N(mon->buffer, newLength) < 0)
             return -1;
-        mon->bufferLength += 1024;
-        avail += 1024;
+        avail += newLength - mon->bufferLength;
+        mon->bufferLength = newLength;
     }
 
     /* Read as much as we can get into our buffer,
@@ -617,7 +640,7 @@ qemuMonitorIO(GSocket *socket G_GNUC_UNUSED,
          * then wakeup that waiter */
         if (mon->msg && !mon->msg->finished) {
             mon->msg->finished = 1;
-            virCondSignal(&mon->notify);
+            virCondBroadcast(&mon->notify);
         }
     }
 
@@ -631,7 +654,7 @@ qemuMonitorIO(GSocket *socket G_GNUC_UNUSED,
         virDomainObjPtr vm = mon->vm;
 
         /* Make sure anyone waiting wakes up now */
-        virCondSignal(&mon->notify);
+        virCondBroadcast(&mon->notify);
         virObjectUnlock(mon);
         VIR_DEBUG("Triggering EOF callback");
         (eofNotify)(mon, vm, mon->callbackOpaque);
@@ -641,7 +664,7 @@ qemuMonitorIO(GSocket *socket G_GNUC_UNUSED,
         virDomainObjPtr vm = mon->vm;
 
         /* Make sure anyone waiting wakes up now */
-        virCondSignal(&mon->notify);
+        virCondBroadcast(&mon->notify);
         virObjectUnlock(mon);
         VIR_DEBUG("Triggering error callback");
         (errorNotify)(mon, vm, mon->callbackOpaque);
@@ -880,7 +903,7 @@ qemuMonitorClose(qemuMonitorPtr mon)
                 virResetLastError();
         }
         mon->msg->finished = 1;
-        virCondSignal(&mon->notify);
+        virCondBroadcast(&mon->notify);
     }
 
     /* Propagate existing monitor error in case the current thread has no
@@ -926,6 +949,21 @@ qemuMonitorSend(qemuMonitorPtr mon,
         return -1;
     }
 
+    /* Threads holding a shared query job may use the monitor at the
+     * same time, wait until the previous command was processed. */
+    while (mon->msg) {
+        if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Unable to wait on monitor condition"));
+            return -1;
+        }
+    }
+
+    if (mon->lastError.code != VIR_ERR_OK) {
+        virSetError(&mon->lastError);
+        return -1;
+    }
+
     mon->msg = msg;
     qemuMonitorUpdateWatch(mon);
 
@@ -953,6 +991,7 @@ qemuMonitorSend(qemuMonitorPtr mon,
  cleanup:
     mon->msg = NULL;
     qemuMonitorUpdateWatch(mon);
+    virCondBroadcast(&mon->notify);
 
     return ret;
 }
@@ -51,6 +51,9 @@ struct _qemuMonitorMessage {
     int rxLength;
     /* Used by the JSON monitor to hold reply / error */
     void *rxObject;
+    /* Optional NULL terminated list of paths of the JSON reply
+     * members to parse, see virJSONValueFromStringFiltered */
+    const char *const *rxFilter;
 
     /* True if rxBuffer / rxObject are ready, or a
      * fatal error occurred on the monitor channel
@@ -693,6 +696,8 @@ struct _qemuBlockNamedNodeData {
 
     qemuBlockNamedNodeDataBitmapPtr *bitmaps;
     size_t nbitmaps;
+    /* @bitmaps by name, NULL if there are none */
+    virHashTablePtr bitmapsByName;
 };
 
 virHashTablePtr
@@ -219,7 +219,7 @@ qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
 
     VIR_DEBUG("Line [%s]", line);
 
-    if (!(obj = virJSONValueFromString(line)))
+    if (!(obj = virJSONValueFromStringArena(line, msg ? msg->rxFilter : NULL)))
         goto cleanup;
 
     if (virJSONValueGetType(obj) != VIR_JSON_TYPE_OBJECT) {
@@ -257,56 +257,92 @@ qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
     return ret;
 }
 
+/**
+ * qemuMonitorJSONIOProcess:
+ * @mon: monitor object
+ * @data: NUL terminated buffer with data received from the monitor
+ * @len: length of @data
+ * @scanned: number of bytes at the beginning of @data which are known
+ *           not to contain the end of a line
+ * @msg: message waiting for a reply
+ *
+ * Processes all complete lines in @data. The lines are terminated in
+ * place and passed to qemuMonitorJSONIOProcessLine without copying,
+ * therefore the processed part of @data is clobbered. On return
+ * @scanned is updated so that a partial line left in the buffer isn't
+ * searched for the line ending again once more data arrives.
+ *
+ * Returns the number of bytes processed or -1 on error.
+ */
 int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
-                             const char *data,
+                             char *data,
                              size_t len,
+                             size_t *scanned,
                              qemuMonitorMessagePtr msg)
 {
-    int used = 0;
+    size_t used = 0;
     /*VIR_DEBUG("Data %d bytes [%s]", len, data);*/
 
     while (used < len) {
-        char *nl = strstr(data + used, LINE_ENDING);
-
-        if (nl) {
-            int got = nl - (data + used);
-            char *line;
-            line = g_strndup(data + used, got);
-            used += got + strlen(LINE_ENDING);
-            line[got] = '\0'; /* kill \n */
-            if (qemuMonitorJSONIOProcessLine(mon, line, msg) < 0) {
-                VIR_FREE(line);
-                return -1;
-            }
+        char *line = data + used;
+        char *nl = strstr(data + MAX(used, *scanned), LINE_ENDING);
 
-            VIR_FREE(line);
-        } else {
+        if (!nl) {
+            /* The last byte might be the beginning of LINE_ENDING */
+            *scanned = MAX(used, len - (strlen(LINE_ENDING) - 1));
             break;
         }
+
+        *nl = '\0'; /* kill \r\n */
+        used = (nl - data) + strlen(LINE_ENDING);
+
+        if (qemuMonitorJSONIOProcessLine(mon, line, msg) < 0)
+            return -1;
     }
 
 #if DEBUG_IO
-    VIR_DEBUG("Total used %d bytes out of %zd available in buffer", used, len);
+    VIR_DEBUG("Total used %zu bytes out of %zu available in buffer", used, len);
 #endif
 
     return used;
 }
 
+/* Top level members of replies and events which are always kept when
+ * only a part of the reply is requested */
+static const char *qemuMonitorJSONReplyFilter[] = {
+    "QMP", "event", "data", "timestamp", "error", "id",
+};
+
 static int
-qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
-                             virJSONValuePtr cmd,
-                             int scm_fd,
-                             virJSONValuePtr *reply)
+qemuMonitorJSONCommandFull(qemuMonitorPtr mon,
+                           virJSONValuePtr cmd,
+                           int scm_fd,
+                           const char *const *filter,
+                           virJSONValuePtr *reply)
 {
     int ret = -1;
     qemuMonitorMessage msg;
     g_auto(virBuffer) cmdbuf = VIR_BUFFER_INITIALIZER;
+    g_autofree const char **rxFilter = NULL;
     char *id = NULL;
 
     *reply = NULL;
 
     memset(&msg, 0, sizeof(msg));
 
+    /* events may be received while waiting for the reply so their
+     * members must not be filtered out */
+    if (filter) {
+        size_t nimplicit = G_N_ELEMENTS(qemuMonitorJSONReplyFilter);
+        size_t nfilter = virStringListLength(filter);
+
+        rxFilter = g_new0(const char *, nimplicit + nfilter + 1);
+        memcpy(rxFilter, qemuMonitorJSONReplyFilter,
+               nimplicit * sizeof(*rxFilter));
+        memcpy(rxFilter + nimplicit, filter, nfilter * sizeof(*rxFilter));
+        msg.rxFilter = rxFilter;
+    }
+
     if (virJSONValueObjectHasKey(cmd, "execute") == 1) {
         if (!(id = qemuMonitorNextCommandID(mon)))
             goto cleanup;
@@ -345,6 +381,16 @@ qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
 }
 
 
+static int
+qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
+                             virJSONValuePtr cmd,
+                             int scm_fd,
+                             virJSONValuePtr *reply)
+{
+    return qemuMonitorJSONCommandFull(mon, cmd, scm_fd, NULL, reply);
+}
+
+
 static int
 qemuMonitorJSONCommand(qemuMonitorPtr mon,
                        virJSONValuePtr cmd,
@@ -353,6 +399,27 @@ qemuMonitorJSONCommand(qemuMonitorPtr mon,
     return qemuMonitorJSONCommandWithFd(mon, cmd, -1, reply);
 }
 
+
+/**
+ * qemuMonitorJSONCommandFiltered:
+ * @mon: monitor object
+ * @cmd: command to execute
+ * @filter: NULL terminated list of paths of the reply members to keep
+ * @reply: filled with the reply
+ *
+ * Like qemuMonitorJSONCommand but only the members of the reply listed
+ * in @filter (see virJSONValueFromStringFiltered) are parsed into @reply.
+ * Meant for large replies of which only a few members are needed.
+ */
+static int
+qemuMonitorJSONCommandFiltered(qemuMonitorPtr mon,
+                               virJSONValuePtr cmd,
+                               const char *const *filter,
+                               virJSONValuePtr *reply)
+{
+    return qemuMonitorJSONCommandFull(mon, cmd, -1, filter, reply);
+}
+
 /* Ignoring OOM in this method, since we're already reporting
  * a more important error
  *
@@ -2370,7 +2437,8 @@ qemuMonitorJSONSetMemoryStatsPeriod(qemuMonitorPtr mon,
  * Returns: NULL on error, reply on success
  */
 static virJSONValuePtr
-qemuMonitorJSONQueryBlock(qemuMonitorPtr mon)
+qemuMonitorJSONQueryBlockFiltered(qemuMonitorPtr mon,
+                                  const char *const *filter)
 {
     virJSONValuePtr cmd;
     virJSONValuePtr reply = NULL;
@@ -2379,7 +2447,7 @@ qemuMonitorJSONQueryBlock(qemuMonitorPtr mon)
     if (!(cmd = qemuMonitorJSONMakeCommand("query-block", NULL)))
         return NULL;
 
-    if (qemuMonitorJSONCommand(mon, cmd, &reply) < 0 ||
+    if (qemuMonitorJSONCommandFiltered(mon, cmd, filter, &reply) < 0 ||
         qemuMonitorJSONCheckReply(cmd, reply, VIR_JSON_TYPE_ARRAY) < 0)
         goto cleanup;
 
@@ -2392,6 +2460,13 @@ qemuMonitorJSONQueryBlock(qemuMonitorPtr mon)
 }
 
 
+static virJSONValuePtr
+qemuMonitorJSONQueryBlock(qemuMonitorPtr mon)
+{
+    return qemuMonitorJSONQueryBlockFiltered(mon, NULL);
+}
+
+
 static virJSONValuePtr
 qemuMonitorJSONGetBlockDev(virJSONValuePtr devices,
                            size_t idx)
@@ -2801,8 +2876,12 @@ qemuMonitorJSONBlockStatsUpdateCapacity(qemuMonitorPtr mon,
     int ret = -1;
     size_t i;
     virJSONValuePtr devices;
+    /* only the image data is needed out of the possibly large reply */
+    const char *filter[] = {
+        "return/*/device", "return/*/inserted/image", NULL
+    };
 
-    if (!(devices = qemuMonitorJSONQueryBlock(mon)))
+    if (!(devices = qemuMonitorJSONQueryBlockFiltered(mon, filter)))
         return -1;
 
     for (i = 0; i < virJSONValueArraySize(devices); i++) {
@@ -2912,6 +2991,7 @@ qemuMonitorJSONBlockNamedNodeDataFree(qemuBlockNamedNodeDataPtr data)
     for (i = 0; i < data->nbitmaps; i++)
         qemuMonitorJSONBlockNamedNodeDataBitmapFree(data->bitmaps[i]);
     g_free(data->bitmaps);
+    virHashFree(data->bitmapsByName);
     g_free(data);
 }
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(qemuBlockNamedNodeData, qemuMonitorJSONBlockNamedNodeDataFree);
@@ -2941,7 +3021,7 @@ qemuMonitorJSONBlockGetNamedNodeDataBitmapOne(virJSONValuePtr val)
 }
 
 
-static void
+static int
 qemuMonitorJSONBlockGetNamedNodeDataBitmaps(virJSONValuePtr bitmaps,
                                             qemuBlockNamedNodeDataPtr data)
 {
@@ -2949,6 +3029,8 @@ qemuMonitorJSONBlockGetNamedNodeDataBitmaps(virJSONValuePtr bitmaps,
     size_t i;
 
     data->bitmaps = g_new0(qemuBlockNamedNodeDataBitmapPtr, nbitmaps);
+    /* lookups by name are frequent when walking long checkpoint chains */
+    data->bitmapsByName = virHashNew(NULL);
 
     for (i = 0; i < nbitmaps; i++) {
         virJSONValuePtr bitmap = virJSONValueArrayGet(bitmaps, i);
@@ -2961,7 +3043,13 @@ qemuMonitorJSONBlockGetNamedNodeDataBitmaps(virJSONValuePtr bitmaps,
             continue;
 
         data->bitmaps[data->nbitmaps++] = tmp;
+
+        if (!virHashHasEntry(data->bitmapsByName, tmp->name) &&
+            virHashAddEntry(data->bitmapsByName, tmp->name, tmp) < 0)
+            return -1;
     }
+
+    return 0;
 }
 
 
@@ -2989,8 +3077,9 @@ qemuMonitorJSONBlockGetNamedNodeDataWorker(size_t pos G_GNUC_UNUSED,
     if (virJSONValueObjectGetNumberUlong(img, "actual-size", &ent->physical) < 0)
         ent->physical = ent->capacity;
 
-    if ((bitmaps = virJSONValueObjectGetArray(val, "dirty-bitmaps")))
-        qemuMonitorJSONBlockGetNamedNodeDataBitmaps(bitmaps, ent);
+    if ((bitmaps = virJSONValueObjectGetArray(val, "dirty-bitmaps")) &&
+        qemuMonitorJSONBlockGetNamedNodeDataBitmaps(bitmaps, ent) < 0)
+        return -1;
 
     if (virHashAddEntry(nodes, nodename, ent) < 0)
         return -1;
@@ -33,8 +33,9 @@ int qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
                                  qemuMonitorMessagePtr msg);
 
 int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
-                             const char *data,
+                             char *data,
                              size_t len,
+                             size_t *scanned,
                              qemuMonitorMessagePtr msg);
 
 int qemuMonitorJSONHumanCommand(qemuMonitorPtr mon,
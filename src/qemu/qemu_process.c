@@ -90,6 +90,7 @@
 #include "virvsock.h"
 #include "viridentity.h"
 #include "virthreadjob.h"
+#include "virtunable.h"
 #include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_QEMU
@@ -114,6 +115,7 @@ qemuProcessRemoveDomainStatus(virQEMUDriverPtr driver,
     if (unlink(file) < 0 && errno != ENOENT && errno != ENOTDIR)
         VIR_WARN("Failed to remove domain XML for %s: %s",
                  vm->def->name, g_strerror(errno));
+    g_clear_pointer(&vm->statusChecksum, g_free);
 
     if (priv->pidfile &&
         unlink(priv->pidfile) < 0 &&
@@ -758,7 +760,6 @@ qemuProcessHandleRTCChange(qemuMonitorPtr mon G_GNUC_UNUSED,
 {
     virQEMUDriverPtr driver = opaque;
     virObjectEventPtr event = NULL;
-    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
 
     virObjectLock(vm);
 
@@ -781,8 +782,8 @@ qemuProcessHandleRTCChange(qemuMonitorPtr mon G_GNUC_UNUSED,
         offset += vm->def->clock.data.variable.adjustment0;
         vm->def->clock.data.variable.adjustment = offset;
 
-        if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
-           VIR_WARN("unable to save domain status with RTC change");
+        /* guests may adjust their clock rather often */
+        qemuDomainSaveStatusDelayed(vm);
     }
 
     event = virDomainEventRTCChangeNewFromObj(vm, offset);
@@ -1258,7 +1259,6 @@ qemuProcessHandleBalloonChange(qemuMonitorPtr mon G_GNUC_UNUSED,
 {
     virQEMUDriverPtr driver = opaque;
     virObjectEventPtr event = NULL;
-    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
 
     virObjectLock(vm);
     event = virDomainEventBalloonChangeNewFromObj(vm, actual);
@@ -1267,8 +1267,8 @@ qemuProcessHandleBalloonChange(qemuMonitorPtr mon G_GNUC_UNUSED,
               vm->def->mem.cur_balloon, actual);
     vm->def->mem.cur_balloon = actual;
 
-    if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
-        VIR_WARN("unable to save domain status with balloon change");
+    /* the balloon reports its progress as it inflates or deflates */
+    qemuDomainSaveStatusDelayed(vm);
 
     virObjectUnlock(vm);
 
@@ -1993,6 +1993,8 @@ qemuConnectMonitor(virQEMUDriverPtr driver, virDomainObjPtr vm, int asyncJob,
     priv->monStart = 0;
     priv->mon = mon;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_MONITOR);
+
     if (qemuSecurityClearSocketLabel(driver->securityManager, vm->def) < 0) {
         VIR_ERROR(_("Failed to clear security context for monitor for %s"),
                   vm->def->name);
@@ -2010,6 +2012,8 @@ qemuConnectMonitor(virQEMUDriverPtr driver, virDomainObjPtr vm, int asyncJob,
     if (qemuMigrationCapsCheck(driver, vm, asyncJob) < 0)
         return -1;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_QMP_INIT);
+
     return 0;
 }
 
@@ -6232,6 +6236,7 @@ qemuProcessPrepareDomain(virQEMUDriverPtr driver,
     size_t i;
     qemuDomainObjPrivatePtr priv = vm->privateData;
     g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    int rc;
 
     priv->machineName = qemuDomainGetMachineName(vm);
     if (!priv->machineName)
@@ -6287,15 +6292,25 @@ qemuProcessPrepareDomain(virQEMUDriverPtr driver,
     if (qemuDomainMasterKeyCreate(vm) < 0)
         return -1;
 
-    VIR_DEBUG("Setting up storage");
-    if (qemuProcessPrepareDomainStorage(driver, vm, priv, cfg, flags) < 0)
+    /* all the secrets of disks and devices are fetched through one
+     * connection to the secret driver */
+    if (virHoldConnectSecret() < 0)
         return -1;
 
-    VIR_DEBUG("Prepare chardev source backends for TLS");
-    qemuDomainPrepareChardevSource(vm->def, cfg);
+    VIR_DEBUG("Setting up storage");
+    rc = qemuProcessPrepareDomainStorage(driver, vm, priv, cfg, flags);
+
+    if (rc == 0) {
+        VIR_DEBUG("Prepare chardev source backends for TLS");
+        qemuDomainPrepareChardevSource(vm->def, cfg);
 
-    VIR_DEBUG("Prepare device secrets");
-    if (qemuDomainSecretPrepare(driver, vm) < 0)
+        VIR_DEBUG("Prepare device secrets");
+        rc = qemuDomainSecretPrepare(driver, vm);
+    }
+
+    virReleaseConnectSecret();
+
+    if (rc < 0)
         return -1;
 
     VIR_DEBUG("Prepare bios/uefi paths");
@@ -6748,6 +6763,8 @@ qemuProcessLaunch(virConnectPtr conn,
                             incoming != NULL) < 0)
         goto cleanup;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_EXT_DEVICES);
+
     VIR_DEBUG("Building emulator command line");
     if (!(cmd = qemuBuildCommandLine(driver,
                                      qemuDomainLogContextGetManager(logCtxt),
@@ -6760,6 +6777,8 @@ qemuProcessLaunch(virConnectPtr conn,
                                      &nnicindexes, &nicindexes)))
         goto cleanup;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_COMMAND_LINE);
+
     if (incoming && incoming->fd != -1)
         virCommandPassFD(cmd, incoming->fd, 0);
 
@@ -6835,6 +6854,8 @@ qemuProcessLaunch(virConnectPtr conn,
         goto cleanup;
     }
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_EXEC);
+
     VIR_DEBUG("Setting up domain cgroup (if required)");
     if (qemuSetupCgroup(vm, nnicindexes, nicindexes) < 0)
         goto cleanup;
@@ -6870,6 +6891,8 @@ qemuProcessLaunch(virConnectPtr conn,
         qemuProcessStartManagedPRDaemon(vm) < 0)
         goto cleanup;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_CGROUP);
+
     VIR_DEBUG("Setting domain security labels");
     if (qemuSecuritySetAllLabel(driver,
                                 vm,
@@ -6902,6 +6925,8 @@ qemuProcessLaunch(virConnectPtr conn,
             goto cleanup;
     }
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_SECURITY);
+
     VIR_DEBUG("Labelling done, completing handshake to child");
     if (virCommandHandshakeNotify(cmd) < 0)
         goto cleanup;
@@ -6923,6 +6948,8 @@ qemuProcessLaunch(virConnectPtr conn,
     if (qemuConnectAgent(driver, vm) < 0)
         goto cleanup;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_MONITOR);
+
     VIR_DEBUG("Verifying and updating provided guest CPU");
     if (qemuProcessUpdateAndVerifyCPU(driver, vm, asyncJob) < 0)
         goto cleanup;
@@ -7000,6 +7027,8 @@ qemuProcessLaunch(virConnectPtr conn,
         qemuProcessAutoDestroyAdd(driver, vm, conn) < 0)
         goto cleanup;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_DEVICES);
+
     ret = 0;
 
  cleanup:
@@ -7127,6 +7156,8 @@ qemuProcessStart(virConnectPtr conn,
     if (!migrateFrom && !snapshot)
         flags |= VIR_QEMU_PROCESS_START_NEW;
 
+    qemuDomainJobTimingStart(vm);
+
     if (qemuProcessInit(driver, vm, updatedCPU,
                         asyncJob, !!migrateFrom, flags) < 0)
         goto cleanup;
@@ -7138,12 +7169,18 @@ qemuProcessStart(virConnectPtr conn,
             goto stop;
     }
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_INIT);
+
     if (qemuProcessPrepareDomain(driver, vm, flags) < 0)
         goto stop;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_PREPARE_DOMAIN);
+
     if (qemuProcessPrepareHost(driver, vm, flags) < 0)
         goto stop;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_PREPARE_HOST);
+
     if ((rv = qemuProcessLaunch(conn, driver, vm, asyncJob, incoming,
                                 snapshot, vmop, flags)) < 0) {
         if (rv == -2)
@@ -7171,15 +7208,28 @@ qemuProcessStart(virConnectPtr conn,
                                  VIR_DOMAIN_PAUSED_USER) < 0)
         goto stop;
 
+    qemuDomainJobTimingRecord(vm, QEMU_DOMAIN_JOB_TIMING_FINISH);
+
     if (!incoming) {
         /* Keep watching qemu log for errors during incoming migration, otherwise
          * unset reporting errors from qemu log. */
         qemuMonitorSetDomainLog(priv->mon, NULL, NULL, NULL);
     }
 
+    /* Starting has no statistics of its own, but keep the time spent in
+     * each phase available for virDomainGetJobStats */
+    if (asyncJob == QEMU_ASYNC_JOB_START && priv->job.current) {
+        qemuDomainJobInfoUpdateTime(priv->job.current);
+        VIR_FREE(priv->job.completed);
+        priv->job.completed = g_new0(qemuDomainJobInfo, 1);
+        *priv->job.completed = *priv->job.current;
+        priv->job.completed->status = QEMU_DOMAIN_JOB_STATUS_COMPLETED;
+    }
+
     ret = 0;
 
  cleanup:
+    qemuDomainJobTimingStop(vm);
     qemuProcessIncomingDefFree(incoming);
     return ret;
 
@@ -7930,15 +7980,30 @@ struct qemuProcessReconnectData {
     virQEMUDriverPtr driver;
     virDomainObjPtr obj;
     virIdentityPtr identity;
+    qemuDomainJobObj oldjob;
+    bool jobStarted;
 };
+
+
+static void
+qemuProcessReconnectFinished(virQEMUDriverPtr driver,
+                             bool failed)
+{
+    if (failed)
+        g_atomic_int_inc(&driver->reconnectFailed);
+    g_atomic_int_inc(&driver->reconnectDone);
+}
+
+
 /*
  * Open an existing VM's monitor, re-detect VCPU threads
  * and re-reserve the security labels in use
  *
- * This function also inherits a locked and ref'd domain object.
+ * This function also inherits a ref'd domain object, on which
+ * qemuProcessReconnectHelper started a job already unless
+ * @data->jobStarted is false.
  *
  * This function needs to:
- * 1. Enter job
  * 1. just before monitor reconnect do lightweight MonitorEnter
  *    (increase VM refcount and unlock VM)
  * 2. reconnect to monitor
@@ -7956,30 +8021,31 @@ qemuProcessReconnect(void *opaque)
     virQEMUDriverPtr driver = data->driver;
     virDomainObjPtr obj = data->obj;
     qemuDomainObjPrivatePtr priv;
-    qemuDomainJobObj oldjob;
+    qemuDomainJobObj oldjob = data->oldjob;
     int state;
     int reason;
     g_autoptr(virQEMUDriverConfig) cfg = NULL;
     size_t i;
     unsigned int stopFlags = 0;
-    bool jobStarted = false;
+    bool jobStarted = data->jobStarted;
     bool retry = true;
     bool tryMonReconn = false;
+    bool failed = false;
 
     virIdentitySetCurrent(data->identity);
     g_clear_object(&data->identity);
     VIR_FREE(data);
 
-    qemuDomainObjRestoreJob(obj, &oldjob);
+    virObjectLock(obj);
+
     if (oldjob.asyncJob == QEMU_ASYNC_JOB_MIGRATION_IN)
         stopFlags |= VIR_QEMU_PROCESS_STOP_MIGRATED;
 
     cfg = virQEMUDriverGetConfig(driver);
     priv = obj->privateData;
 
-    if (qemuDomainObjBeginJob(driver, obj, QEMU_JOB_MODIFY) < 0)
+    if (!jobStarted)
         goto error;
-    jobStarted = true;
 
     /* XXX If we ever gonna change pid file pattern, come up with
      * some intelligence here to deal with old paths. */
@@ -8212,9 +8278,11 @@ qemuProcessReconnect(void *opaque)
     virDomainObjEndAPI(&obj);
     virNWFilterUnlockFilterUpdates();
     virIdentitySetCurrent(NULL);
+    qemuProcessReconnectFinished(driver, failed);
     return;
 
  error:
+    failed = true;
     if (virDomainObjIsActive(obj)) {
         /* We can't get the monitor back, so must kill the VM
          * to remove danger of it ending up running twice if
@@ -8242,14 +8310,79 @@ qemuProcessReconnect(void *opaque)
     goto cleanup;
 }
 
+/*
+ * Gives up on reconnecting to the domain of @data, killing it as there
+ * is no way of getting its monitor back.
+ */
+static void
+qemuProcessReconnectAbort(struct qemuProcessReconnectData *data)
+{
+    virQEMUDriverPtr driver = data->driver;
+    virDomainObjPtr obj = data->obj;
+
+    virObjectLock(obj);
+
+    /* Even if starting the job failed, it's safe to call qemuProcessStop
+     * here since there is no thread that could be doing anything else
+     * with the same domain object. */
+    qemuProcessStop(driver, obj, VIR_DOMAIN_SHUTOFF_FAILED,
+                    QEMU_ASYNC_JOB_NONE, 0);
+
+    if (data->jobStarted) {
+        qemuDomainRemoveInactive(driver, obj);
+        qemuDomainObjEndJob(driver, obj);
+    } else {
+        qemuDomainRemoveInactiveJob(driver, obj);
+    }
+
+    virDomainObjEndAPI(&obj);
+    virNWFilterUnlockFilterUpdates();
+    qemuProcessReconnectFinished(driver, true);
+    g_clear_object(&data->identity);
+    VIR_FREE(data);
+}
+
+
+static void
+qemuProcessReconnectStartThread(struct qemuProcessReconnectData *data)
+{
+    virThread thread;
+    g_autofree char *name = g_strdup_printf("init-%s", data->obj->def->name);
+
+    if (virThreadCreateFull(&thread, false, qemuProcessReconnect,
+                            name, false, data) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Could not create thread. QEMU initialization "
+                         "might be incomplete"));
+        qemuProcessReconnectAbort(data);
+    }
+}
+
+
+static void
+qemuProcessReconnectJobFunc(void *jobdata,
+                            void *opaque G_GNUC_UNUSED)
+{
+    qemuProcessReconnect(jobdata);
+}
+
+
+struct qemuProcessReconnectList {
+    virQEMUDriverPtr driver;
+    /* Domains which were in the middle of a job */
+    struct qemuProcessReconnectData **urgent;
+    size_t nurgent;
+    struct qemuProcessReconnectData **rest;
+    size_t nrest;
+};
+
+
 static int
 qemuProcessReconnectHelper(virDomainObjPtr obj,
                            void *opaque)
 {
-    virThread thread;
-    struct qemuProcessReconnectData *src = opaque;
+    struct qemuProcessReconnectList *list = opaque;
     struct qemuProcessReconnectData *data;
-    g_autofree char *name = NULL;
 
     /* If the VM was inactive, we don't need to reconnect */
     if (!obj->pid)
@@ -8258,39 +8391,26 @@ qemuProcessReconnectHelper(virDomainObjPtr obj,
     if (VIR_ALLOC(data) < 0)
         return -1;
 
-    memcpy(data, src, sizeof(*data));
-    data->obj = obj;
+    data->driver = list->driver;
+    data->obj = virObjectRef(obj);
     data->identity = virIdentityGetCurrent();
 
     virNWFilterReadLockFilterUpdates();
 
-    /* this lock and reference will be eventually transferred to the thread
-     * that handles the reconnect */
+    /* Nobody else can have a job on the domain this early. Starting one
+     * right away keeps APIs off the domain until it is reconnected while
+     * it waits for its turn without holding the lock. */
     virObjectLock(obj);
-    virObjectRef(obj);
-
-    name = g_strdup_printf("init-%s", obj->def->name);
-
-    if (virThreadCreateFull(&thread, false, qemuProcessReconnect,
-                            name, false, data) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Could not create thread. QEMU initialization "
-                         "might be incomplete"));
-        /* We can't spawn a thread and thus connect to monitor. Kill qemu.
-         * It's safe to call qemuProcessStop without a job here since there
-         * is no thread that could be doing anything else with the same domain
-         * object.
-         */
-        qemuProcessStop(src->driver, obj, VIR_DOMAIN_SHUTOFF_FAILED,
-                        QEMU_ASYNC_JOB_NONE, 0);
-        qemuDomainRemoveInactiveJobLocked(src->driver, obj);
-
-        virDomainObjEndAPI(&obj);
-        virNWFilterUnlockFilterUpdates();
-        g_clear_object(&data->identity);
-        VIR_FREE(data);
-        return -1;
-    }
+    qemuDomainObjRestoreJob(obj, &data->oldjob);
+    data->jobStarted = qemuDomainObjBeginJob(list->driver, obj,
+                                             QEMU_JOB_MODIFY) == 0;
+    virObjectUnlock(obj);
+
+    if (data->oldjob.active != QEMU_JOB_NONE ||
+        data->oldjob.asyncJob != QEMU_ASYNC_JOB_NONE)
+        ignore_value(VIR_APPEND_ELEMENT(list->urgent, list->nurgent, data));
+    else
+        ignore_value(VIR_APPEND_ELEMENT(list->rest, list->nrest, data));
 
     return 0;
 }
@@ -8299,14 +8419,62 @@ qemuProcessReconnectHelper(virDomainObjPtr obj,
  * qemuProcessReconnectAll
  *
  * Try to re-open the resources for live VMs that we care
- * about.
+ * about. Unless reconnect_max_workers is zero, the domains are
+ * reconnected by a bounded pool of workers, starting with those
+ * which were in the middle of a job when the daemon stopped.
  */
 void
 qemuProcessReconnectAll(virQEMUDriverPtr driver)
 {
-    struct qemuProcessReconnectData data = {.driver = driver};
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    struct qemuProcessReconnectList list = { .driver = driver };
+    size_t ndomains;
+    size_t i;
+
     virDomainObjListForEach(driver->domains, true,
-                            qemuProcessReconnectHelper, &data);
+                            qemuProcessReconnectHelper, &list);
+
+    ndomains = list.nurgent + list.nrest;
+    g_atomic_int_add(&driver->reconnectTotal, ndomains);
+
+    VIR_DEBUG("Reconnecting to %zu domains, %zu of them with a job",
+              ndomains, list.nurgent);
+
+    if (ndomains > 0 && cfg->reconnectMaxWorkers > 0 &&
+        !(driver->reconnectPool = virThreadPoolNewFull(0,
+                                                       MIN(cfg->reconnectMaxWorkers,
+                                                           ndomains),
+                                                       0, qemuProcessReconnectJobFunc,
+                                                       "qemu-reconnect", driver, 0))) {
+        VIR_WARN("Unable to create reconnect pool, using a thread "
+                 "per domain: %s", virGetLastErrorMessage());
+        virResetLastError();
+    }
+
+    if (driver->reconnectPool &&
+        virTunableRegisterThreadPool("qemu.reconnect-workers",
+                                     driver->reconnectPool) < 0) {
+        VIR_WARN("Unable to register reconnect pool tunable: %s",
+                 virGetLastErrorMessage());
+        virResetLastError();
+    }
+
+    for (i = 0; i < ndomains; i++) {
+        struct qemuProcessReconnectData *data;
+
+        if (i < list.nurgent)
+            data = list.urgent[i];
+        else
+            data = list.rest[i - list.nurgent];
+
+        if (!driver->reconnectPool)
+            qemuProcessReconnectStartThread(data);
+        else if (virThreadPoolSendJob(driver->reconnectPool, 0, data) < 0)
+            qemuProcessReconnectAbort(data);
+    }
+
+    VIR_FREE(list.urgent);
+    VIR_FREE(list.rest);
 }
 
 
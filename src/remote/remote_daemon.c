@@ -1251,7 +1251,7 @@ int main(int argc, char **argv) {
                                 remoteClientNew,
                                 NULL,
                                 remoteClientFree,
-                                NULL))) {
+                                config))) {
         ret = VIR_DAEMON_ERR_INIT;
         goto cleanup;
     }
@@ -60,6 +60,9 @@ struct daemonClientPrivate {
     daemonClientEventCallbackPtr *secretEventCallbacks;
     size_t nsecretEventCallbacks;
     bool closeRegistered;
+    /* Whether the client can take stream data packets with
+     * up to VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX bytes */
+    bool largeStreamChunks;
 
 #if WITH_SASL
     virNetSASLSessionPtr sasl;
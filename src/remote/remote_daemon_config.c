@@ -144,6 +144,7 @@ daemonConfigNew(bool privileged G_GNUC_UNUSED)
     data->prio_workers = 5;
 
     data->max_client_requests = 5;
+    data->max_client_events = 10000;
 
     data->audit_level = 1;
     data->audit_logging = 0;
@@ -326,6 +327,8 @@ daemonConfigLoadOptions(struct daemonConfig *data,
 
     if (virConfGetValueUInt(conf, "max_client_requests", &data->max_client_requests) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "max_client_events", &data->max_client_events) < 0)
+        return -1;
 
     if (virConfGetValueUInt(conf, "admin_min_workers", &data->admin_min_workers) < 0)
         return -1;
@@ -74,6 +74,7 @@ struct daemonConfig {
     unsigned int prio_workers;
 
     unsigned int max_client_requests;
+    unsigned int max_client_events;
 
     unsigned int log_level;
     char *log_filters;
@@ -24,6 +24,7 @@
 
 #include "remote_daemon_dispatch.h"
 #include "remote_daemon.h"
+#include "remote_daemon_config.h"
 #include "libvirt_internal.h"
 #include "datatypes.h"
 #include "viralloc.h"
@@ -144,6 +145,20 @@ remoteDispatchObjectEventSend(virNetServerClientPtr client,
                               xdrproc_t proc,
                               void *data);
 
+static void
+remoteDispatchObjectEventSendFull(virNetServerClientPtr client,
+                                  virNetServerProgramPtr program,
+                                  int procnr,
+                                  xdrproc_t proc,
+                                  void *data,
+                                  const char *key);
+
+static char *
+remoteEventKey(int procnr,
+               int callbackID,
+               virDomainPtr dom,
+               const char *detail);
+
 static void
 remoteEventCallbackFree(void *opaque)
 {
@@ -874,6 +889,7 @@ remoteRelayDomainEventBalloonChange(virConnectPtr conn,
 {
     daemonClientEventCallbackPtr callback = opaque;
     remote_domain_event_balloon_change_msg data;
+    g_autofree char *key = NULL;
 
     if (callback->callbackID < 0 ||
         !remoteRelayDomainEventCheckACL(callback->client, conn, dom))
@@ -887,17 +903,24 @@ remoteRelayDomainEventBalloonChange(virConnectPtr conn,
     make_nonnull_domain(&data.dom, dom);
     data.actual = actual;
 
+    /* Only the current balloon size matters to a client lagging behind */
     if (callback->legacy) {
-        remoteDispatchObjectEventSend(callback->client, callback->program,
-                                      REMOTE_PROC_DOMAIN_EVENT_BALLOON_CHANGE,
-                                      (xdrproc_t)xdr_remote_domain_event_balloon_change_msg, &data);
+        key = remoteEventKey(REMOTE_PROC_DOMAIN_EVENT_BALLOON_CHANGE,
+                             callback->callbackID, dom, NULL);
+        remoteDispatchObjectEventSendFull(callback->client, callback->program,
+                                          REMOTE_PROC_DOMAIN_EVENT_BALLOON_CHANGE,
+                                          (xdrproc_t)xdr_remote_domain_event_balloon_change_msg, &data,
+                                          key);
     } else {
         remote_domain_event_callback_balloon_change_msg msg = { callback->callbackID,
                                                                 data };
 
-        remoteDispatchObjectEventSend(callback->client, callback->program,
-                                      REMOTE_PROC_DOMAIN_EVENT_CALLBACK_BALLOON_CHANGE,
-                                      (xdrproc_t)xdr_remote_domain_event_callback_balloon_change_msg, &msg);
+        key = remoteEventKey(REMOTE_PROC_DOMAIN_EVENT_CALLBACK_BALLOON_CHANGE,
+                             callback->callbackID, dom, NULL);
+        remoteDispatchObjectEventSendFull(callback->client, callback->program,
+                                          REMOTE_PROC_DOMAIN_EVENT_CALLBACK_BALLOON_CHANGE,
+                                          (xdrproc_t)xdr_remote_domain_event_callback_balloon_change_msg, &msg,
+                                          key);
     }
 
     return 0;
@@ -1304,6 +1327,50 @@ remoteRelayDomainEventBlockThreshold(virConnectPtr conn,
 }
 
 
+static int
+remoteRelayDomainEventBlockJobProgress(virConnectPtr conn,
+                                       virDomainPtr dom,
+                                       const char *disk,
+                                       int type,
+                                       unsigned long long cur,
+                                       unsigned long long end,
+                                       unsigned long long bandwidth,
+                                       void *opaque)
+{
+    daemonClientEventCallbackPtr callback = opaque;
+    remote_domain_event_block_job_progress_msg data;
+    g_autofree char *key = NULL;
+
+    if (callback->callbackID < 0 ||
+        !remoteRelayDomainEventCheckACL(callback->client, conn, dom))
+        return -1;
+
+    VIR_DEBUG("Relaying domain block job progress event %s %d %s %d %llu %llu %llu, callback %d",
+              dom->name, dom->id, disk, type, cur, end, bandwidth,
+              callback->callbackID);
+
+    /* build return data */
+    memset(&data, 0, sizeof(data));
+    data.callbackID = callback->callbackID;
+    data.disk = g_strdup(disk);
+    data.type = type;
+    data.cur = cur;
+    data.end = end;
+    data.bandwidth = bandwidth;
+    make_nonnull_domain(&data.dom, dom);
+
+    /* Older progress of the same job is superseded by this one */
+    key = remoteEventKey(REMOTE_PROC_DOMAIN_EVENT_BLOCK_JOB_PROGRESS,
+                         callback->callbackID, dom, disk);
+    remoteDispatchObjectEventSendFull(callback->client, callback->program,
+                                      REMOTE_PROC_DOMAIN_EVENT_BLOCK_JOB_PROGRESS,
+                                      (xdrproc_t)xdr_remote_domain_event_block_job_progress_msg,
+                                      &data, key);
+
+    return 0;
+}
+
+
 static virConnectDomainEventGenericCallback domainEventCallbacks[] = {
     VIR_DOMAIN_EVENT_CALLBACK(remoteRelayDomainEventLifecycle),
     VIR_DOMAIN_EVENT_CALLBACK(remoteRelayDomainEventReboot),
@@ -1330,6 +1397,7 @@ static virConnectDomainEventGenericCallback domainEventCallbacks[] = {
     VIR_DOMAIN_EVENT_CALLBACK(remoteRelayDomainEventDeviceRemovalFailed),
     VIR_DOMAIN_EVENT_CALLBACK(remoteRelayDomainEventMetadataChange),
     VIR_DOMAIN_EVENT_CALLBACK(remoteRelayDomainEventBlockThreshold),
+    VIR_DOMAIN_EVENT_CALLBACK(remoteRelayDomainEventBlockJobProgress),
 };
 
 G_STATIC_ASSERT(G_N_ELEMENTS(domainEventCallbacks) == VIR_DOMAIN_EVENT_ID_LAST);
@@ -1905,8 +1973,9 @@ remoteGetStorageConn(virNetServerClientPtr client)
 
 
 void *remoteClientNew(virNetServerClientPtr client,
-                      void *opaque G_GNUC_UNUSED)
+                      void *opaque)
 {
+    struct daemonConfig *config = opaque;
     struct daemonClientPrivate *priv;
 
     if (VIR_ALLOC(priv) < 0)
@@ -1918,6 +1987,9 @@ void *remoteClientNew(virNetServerClientPtr client,
         return NULL;
     }
 
+    if (config)
+        virNetServerClientSetMaxEvents(client, config->max_client_events);
+
     virNetServerClientSetCloseHook(client, remoteClientCloseFunc);
     return priv;
 }
@@ -4337,16 +4409,49 @@ remoteDispatchConnectDomainEventDeregister(virNetServerPtr server G_GNUC_UNUSED,
     return rv;
 }
 
+/*
+ * Builds the key identifying the events of @procnr for @dom, and the
+ * @detail of it if any, sent to one callback of a client. Queued
+ * events with the same key are superseded by newer ones.
+ */
+static char *
+remoteEventKey(int procnr,
+               int callbackID,
+               virDomainPtr dom,
+               const char *detail)
+{
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    virUUIDFormat(dom->uuid, uuidstr);
+
+    return g_strdup_printf("%d:%d:%s:%s", procnr, callbackID, uuidstr,
+                           NULLSTR_EMPTY(detail));
+}
+
+
 static void
 remoteDispatchObjectEventSend(virNetServerClientPtr client,
                               virNetServerProgramPtr program,
                               int procnr,
                               xdrproc_t proc,
                               void *data)
+{
+    remoteDispatchObjectEventSendFull(client, program, procnr, proc, data,
+                                      NULL);
+}
+
+
+static void
+remoteDispatchObjectEventSendFull(virNetServerClientPtr client,
+                                  virNetServerProgramPtr program,
+                                  int procnr,
+                                  xdrproc_t proc,
+                                  void *data,
+                                  const char *key)
 {
     virNetMessagePtr msg;
 
-    if (!(msg = virNetMessageNew(false)))
+    if (!(msg = virNetServerClientNewMessage(client, false)))
         goto cleanup;
 
     msg->header.prog = virNetServerProgramGetID(program);
@@ -4363,7 +4468,7 @@ remoteDispatchObjectEventSend(virNetServerClientPtr client,
         goto cleanup;
 
     VIR_DEBUG("Queue event %d %zu", procnr, msg->bufferLength);
-    if (virNetServerClientSendMessage(client, msg) < 0)
+    if (virNetServerClientSendEvent(client, msg, key) < 0)
         goto cleanup;
 
     xdr_free(proc, data);
@@ -4976,6 +5081,7 @@ static int remoteDispatchConnectSupportsFeature(virNetServerPtr server G_GNUC_UN
     int rv = -1;
     int supported = -1;
     virConnectPtr conn = NULL;
+    daemonClientPrivatePtr priv = virNetServerClientGetPrivateData(client);
 
     /* This feature is checked before opening the connection, thus we must
      * check it first.
@@ -4998,6 +5104,21 @@ static int remoteDispatchConnectSupportsFeature(virNetServerPtr server G_GNUC_UN
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
         supported = 1;
         break;
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_CHUNKS:
+        /* Only clients which take large chunks themselves ask */
+        virMutexLock(&priv->lock);
+        priv->largeStreamChunks = true;
+        virMutexUnlock(&priv->lock);
+        supported = 1;
+        break;
+    case VIR_DRV_FEATURE_REMOTE_COMPRESSION:
+        /* Likewise only clients which decompress themselves ask */
+        virNetServerClientSetCompression(client, true);
+        supported = 1;
+        break;
+    case VIR_DRV_FEATURE_REMOTE_PACKED_TYPED_PARAMS:
+        supported = 1;
+        break;
     case VIR_DRV_FEATURE_MIGRATION_V1:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_MIGRATION_V2:
@@ -5009,6 +5130,7 @@ static int remoteDispatchConnectSupportsFeature(virNetServerPtr server G_GNUC_UN
     case VIR_DRV_FEATURE_XML_MIGRATABLE:
     case VIR_DRV_FEATURE_MIGRATION_OFFLINE:
     case VIR_DRV_FEATURE_MIGRATION_PARAMS:
+    case VIR_DRV_FEATURE_MIGRATION_TUNNEL_STRIPES:
     default:
         if ((supported = virConnectSupportsFeature(conn, args->feature)) < 0)
             goto cleanup;
@@ -5295,6 +5417,42 @@ remoteDispatchDomainGetDiskErrors(virNetServerPtr server G_GNUC_UNUSED,
 }
 
 
+static int
+remoteDispatchNodeGetMigrationParameters(virNetServerPtr server G_GNUC_UNUSED,
+                                         virNetServerClientPtr client,
+                                         virNetMessagePtr msg G_GNUC_UNUSED,
+                                         virNetMessageErrorPtr rerr,
+                                         remote_node_get_migration_parameters_args *args,
+                                         remote_node_get_migration_parameters_ret *ret)
+{
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    int rv = -1;
+    virConnectPtr conn = remoteGetHypervisorConn(client);
+
+    if (!conn)
+        goto cleanup;
+
+    if (virNodeGetMigrationParameters(conn, &params, &nparams, args->flags) < 0)
+        goto cleanup;
+
+    if (virTypedParamsSerialize(params, nparams,
+                                REMOTE_NODE_MIGRATION_PARAMETERS_MAX,
+                                (virTypedParameterRemotePtr *) &ret->params.params_val,
+                                &ret->params.params_len,
+                                args->flags) < 0)
+        goto cleanup;
+
+    rv = 0;
+
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    virTypedParamsFree(params, nparams);
+    return rv;
+}
+
+
 static int
 remoteDispatchNodeGetSevInfo(virNetServerPtr server G_GNUC_UNUSED,
                              virNetServerClientPtr client,
@@ -5696,6 +5854,54 @@ remoteDispatchDomainMigratePrepareTunnel3Params(virNetServerPtr server G_GNUC_UN
 }
 
 
+static int
+remoteDispatchDomainMigratePrepareTunnelStripe(virNetServerPtr server G_GNUC_UNUSED,
+                                               virNetServerClientPtr client,
+                                               virNetMessagePtr msg,
+                                               virNetMessageErrorPtr rerr,
+                                               remote_domain_migrate_prepare_tunnel_stripe_args *args)
+{
+    virDomainPtr dom = NULL;
+    int rv = -1;
+    virStreamPtr st = NULL;
+    daemonClientStreamPtr stream = NULL;
+    virConnectPtr conn = remoteGetHypervisorConn(client);
+
+    if (!conn)
+        goto cleanup;
+
+    if (!(dom = get_nonnull_domain(conn, args->dom)))
+        goto cleanup;
+
+    if (!(st = virStreamNew(conn, VIR_STREAM_NONBLOCK)) ||
+        !(stream = daemonCreateClientStream(client, st, remoteProgram,
+                                            &msg->header, false)))
+        goto cleanup;
+
+    if (virDomainMigratePrepareTunnelStripe(dom, st, args->stripe,
+                                            args->flags) < 0)
+        goto cleanup;
+
+    if (daemonAddClientStream(client, stream, false) < 0)
+        goto cleanup;
+
+    rv = 0;
+
+ cleanup:
+    virObjectUnref(dom);
+    if (rv < 0) {
+        virNetMessageSaveError(rerr);
+        if (stream) {
+            virStreamAbort(st);
+            daemonFreeClientStream(client, stream);
+        } else {
+            virObjectUnref(st);
+        }
+    }
+    return rv;
+}
+
+
 static int
 remoteDispatchDomainMigratePerform3Params(virNetServerPtr server G_GNUC_UNUSED,
                                           virNetServerClientPtr client,
@@ -6811,55 +7017,71 @@ remoteDispatchNetworkGetDHCPLeases(virNetServerPtr server G_GNUC_UNUSED,
 }
 
 
+/* Gathers the stats requested by the arguments shared by the plain and
+ * the packed bulk stats procedures */
 static int
-remoteDispatchConnectGetAllDomainStats(virNetServerPtr server G_GNUC_UNUSED,
-                                       virNetServerClientPtr client,
-                                       virNetMessagePtr msg G_GNUC_UNUSED,
-                                       virNetMessageErrorPtr rerr,
-                                       remote_connect_get_all_domain_stats_args *args,
-                                       remote_connect_get_all_domain_stats_ret *ret)
+remoteGetAllDomainStats(virNetServerClientPtr client,
+                        remote_nonnull_domain *domsval,
+                        unsigned int domslen,
+                        unsigned int stats,
+                        unsigned int flags,
+                        virDomainStatsRecordPtr **retStats)
 {
-    int rv = -1;
     size_t i;
-    virDomainStatsRecordPtr *retStats = NULL;
-    int nrecords = 0;
+    int nrecords = -1;
     virDomainPtr *doms = NULL;
     virConnectPtr conn = remoteGetHypervisorConn(client);
 
     if (!conn)
         goto cleanup;
 
-    if (args->doms.doms_len) {
-        if (VIR_ALLOC_N(doms, args->doms.doms_len + 1) < 0)
+    if (domslen) {
+        if (VIR_ALLOC_N(doms, domslen + 1) < 0)
             goto cleanup;
 
-        for (i = 0; i < args->doms.doms_len; i++) {
-            if (!(doms[i] = get_nonnull_domain(conn, args->doms.doms_val[i])))
+        for (i = 0; i < domslen; i++) {
+            if (!(doms[i] = get_nonnull_domain(conn, domsval[i])))
                 goto cleanup;
         }
 
-        if ((nrecords = virDomainListGetStats(doms,
-                                              args->stats,
-                                              &retStats,
-                                              args->flags)) < 0)
-            goto cleanup;
+        nrecords = virDomainListGetStats(doms, stats, retStats, flags);
     } else {
-        if ((nrecords = virConnectGetAllDomainStats(conn,
-                                                    args->stats,
-                                                    &retStats,
-                                                    args->flags)) < 0)
-            goto cleanup;
+        nrecords = virConnectGetAllDomainStats(conn, stats, retStats, flags);
     }
 
-    if (nrecords) {
-        if (nrecords > REMOTE_DOMAIN_LIST_MAX) {
-            virReportError(VIR_ERR_INTERNAL_ERROR,
-                           _("Number of domain stats records is %d, "
-                             "which exceeds max limit: %d"),
-                           nrecords, REMOTE_DOMAIN_LIST_MAX);
-            goto cleanup;
-        }
+    if (nrecords > REMOTE_DOMAIN_LIST_MAX) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Number of domain stats records is %d, "
+                         "which exceeds max limit: %d"),
+                       nrecords, REMOTE_DOMAIN_LIST_MAX);
+        nrecords = -1;
+    }
+
+ cleanup:
+    virObjectListFree(doms);
+    return nrecords;
+}
+
+
+static int
+remoteDispatchConnectGetAllDomainStats(virNetServerPtr server G_GNUC_UNUSED,
+                                       virNetServerClientPtr client,
+                                       virNetMessagePtr msg G_GNUC_UNUSED,
+                                       virNetMessageErrorPtr rerr,
+                                       remote_connect_get_all_domain_stats_args *args,
+                                       remote_connect_get_all_domain_stats_ret *ret)
+{
+    int rv = -1;
+    size_t i;
+    virDomainStatsRecordPtr *retStats = NULL;
+    int nrecords = 0;
+
+    if ((nrecords = remoteGetAllDomainStats(client, args->doms.doms_val,
+                                            args->doms.doms_len, args->stats,
+                                            args->flags, &retStats)) < 0)
+        goto cleanup;
 
+    if (nrecords) {
         if (VIR_ALLOC_N(ret->retStats.retStats_val, nrecords) < 0)
             goto cleanup;
 
@@ -6893,6 +7115,172 @@ remoteDispatchConnectGetAllDomainStats(virNetServerPtr server G_GNUC_UNUSED,
     }
 
     virDomainStatsRecordListFree(retStats);
+
+    return rv;
+}
+
+
+static int
+remoteDispatchConnectGetAllDomainStatsPacked(virNetServerPtr server G_GNUC_UNUSED,
+                                             virNetServerClientPtr client,
+                                             virNetMessagePtr msg G_GNUC_UNUSED,
+                                             virNetMessageErrorPtr rerr,
+                                             remote_connect_get_all_domain_stats_packed_args *args,
+                                             remote_connect_get_all_domain_stats_packed_ret *ret)
+{
+    int rv = -1;
+    size_t i;
+    virDomainStatsRecordPtr *retStats = NULL;
+    int nrecords = 0;
+    g_autoptr(virTypedParamsPacker) packer = NULL;
+
+    if ((nrecords = remoteGetAllDomainStats(client, args->doms.doms_val,
+                                            args->doms.doms_len, args->stats,
+                                            args->flags, &retStats)) < 0)
+        goto cleanup;
+
+    packer = virTypedParamsPackerNew(REMOTE_TYPED_PARAM_PACKED_NAMES_MAX);
+
+    if (nrecords) {
+        if (VIR_ALLOC_N(ret->retStats.retStats_val, nrecords) < 0)
+            goto cleanup;
+
+        ret->retStats.retStats_len = nrecords;
+
+        for (i = 0; i < nrecords; i++) {
+            remote_domain_stats_packed_record *dst = ret->retStats.retStats_val + i;
+
+            make_nonnull_domain(&dst->dom, retStats[i]->dom);
+
+            if (virTypedParamsPack(packer,
+                                   retStats[i]->params,
+                                   retStats[i]->nparams,
+                                   REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX,
+                                   &dst->params.params_val,
+                                   &dst->params.params_len) < 0)
+                goto cleanup;
+
+            if (dst->params.params_len > REMOTE_TYPED_PARAM_PACKED_MAX) {
+                virReportError(VIR_ERR_RPC,
+                               _("packed stats of domain '%s' too large"),
+                               retStats[i]->dom->name);
+                goto cleanup;
+            }
+        }
+    }
+
+    ret->names.names_len =
+        virTypedParamsPackerStealNames(packer,
+                                       (virTypedParamsPackedNamePtr *) &ret->names.names_val);
+
+    rv = 0;
+
+ cleanup:
+    if (rv < 0) {
+        virNetMessageSaveError(rerr);
+        xdr_free((xdrproc_t)xdr_remote_connect_get_all_domain_stats_packed_ret,
+                 (char *) ret);
+    }
+
+    virDomainStatsRecordListFree(retStats);
+
+    return rv;
+}
+
+
+static int
+remoteDispatchConnectGetAllDomainXML(virNetServerPtr server G_GNUC_UNUSED,
+                                     virNetServerClientPtr client,
+                                     virNetMessagePtr msg G_GNUC_UNUSED,
+                                     virNetMessageErrorPtr rerr,
+                                     remote_connect_get_all_domain_xml_args *args,
+                                     remote_connect_get_all_domain_xml_ret *ret)
+{
+    int rv = -1;
+    size_t i;
+    virDomainXMLRecordPtr *records = NULL;
+    int nrecords = 0;
+    virDomainPtr *doms = NULL;
+    int ndoms = 0;
+    unsigned int flags = args->flags;
+    virConnectPtr conn = remoteGetHypervisorConn(client);
+
+    if (!conn)
+        goto cleanup;
+
+    if (args->doms.doms_len) {
+        if (VIR_ALLOC_N(doms, args->doms.doms_len + 1) < 0)
+            goto cleanup;
+
+        for (i = 0; i < args->doms.doms_len; i++) {
+            if (!(doms[i] = get_nonnull_domain(conn, args->doms.doms_val[i])))
+                goto cleanup;
+            ndoms++;
+        }
+    } else {
+        if ((ndoms = virConnectListAllDomains(conn, &doms, flags)) < 0)
+            goto cleanup;
+
+        /* The list is filtered already */
+        flags = 0;
+    }
+
+    if (ndoms > REMOTE_DOMAIN_LIST_MAX) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Number of domains is %d, "
+                         "which exceeds max limit: %d"),
+                       ndoms, REMOTE_DOMAIN_LIST_MAX);
+        goto cleanup;
+    }
+
+    /* Keep the reply reasonably sized, the client asks for the XML of
+     * the remaining domains separately */
+    if (ndoms > REMOTE_CONNECT_GET_ALL_DOMAIN_XML_BATCH) {
+        size_t nmore = ndoms - REMOTE_CONNECT_GET_ALL_DOMAIN_XML_BATCH;
+
+        if (VIR_ALLOC_N(ret->more.more_val, nmore) < 0)
+            goto cleanup;
+        ret->more.more_len = nmore;
+
+        for (i = 0; i < nmore; i++) {
+            virDomainPtr dom = doms[REMOTE_CONNECT_GET_ALL_DOMAIN_XML_BATCH + i];
+
+            make_nonnull_domain(ret->more.more_val + i, dom);
+            virObjectUnref(dom);
+            doms[REMOTE_CONNECT_GET_ALL_DOMAIN_XML_BATCH + i] = NULL;
+        }
+        ndoms = REMOTE_CONNECT_GET_ALL_DOMAIN_XML_BATCH;
+    }
+
+    if (ndoms &&
+        (nrecords = virDomainListGetXML(doms, args->xmlflags,
+                                        &records, flags)) < 0)
+        goto cleanup;
+
+    if (nrecords && VIR_ALLOC_N(ret->records.records_val, nrecords) < 0)
+        goto cleanup;
+
+    ret->records.records_len = nrecords;
+
+    for (i = 0; i < nrecords; i++) {
+        remote_domain_xml_record *dst = ret->records.records_val + i;
+
+        make_nonnull_domain(&dst->dom, records[i]->dom);
+        dst->state = records[i]->state;
+        dst->reason = records[i]->reason;
+        dst->xml = g_steal_pointer(&records[i]->xml);
+    }
+
+    rv = 0;
+
+ cleanup:
+    if (rv < 0) {
+        virNetMessageSaveError(rerr);
+        xdr_free((xdrproc_t)xdr_remote_connect_get_all_domain_xml_ret,
+                 (char *) ret);
+    }
+
+    virDomainXMLRecordListFree(records);
     virObjectListFree(doms);
 
     return rv;
@@ -7458,3 +7846,85 @@ remoteDispatchDomainGetGuestInfo(virNetServerPtr server G_GNUC_UNUSED,
 
     return rv;
 }
+
+static int
+remoteDispatchConnectGetAllDomainGuestInfo(virNetServerPtr server G_GNUC_UNUSED,
+                                           virNetServerClientPtr client,
+                                           virNetMessagePtr msg G_GNUC_UNUSED,
+                                           virNetMessageErrorPtr rerr,
+                                           remote_connect_get_all_domain_guest_info_args *args,
+                                           remote_connect_get_all_domain_guest_info_ret *ret)
+{
+    int rv = -1;
+    size_t i;
+    virDomainStatsRecordPtr *retInfo = NULL;
+    int nrecords = 0;
+    virDomainPtr *doms = NULL;
+    virConnectPtr conn = remoteGetHypervisorConn(client);
+
+    if (!conn)
+        goto cleanup;
+
+    if (args->doms.doms_len) {
+        if (VIR_ALLOC_N(doms, args->doms.doms_len + 1) < 0)
+            goto cleanup;
+
+        for (i = 0; i < args->doms.doms_len; i++) {
+            if (!(doms[i] = get_nonnull_domain(conn, args->doms.doms_val[i])))
+                goto cleanup;
+        }
+
+        if ((nrecords = virDomainListGetGuestInfo(doms,
+                                                  args->types,
+                                                  &retInfo,
+                                                  args->flags)) < 0)
+            goto cleanup;
+    } else {
+        if ((nrecords = virConnectGetAllDomainGuestInfo(conn,
+                                                        args->types,
+                                                        &retInfo,
+                                                        args->flags)) < 0)
+            goto cleanup;
+    }
+
+    if (nrecords > REMOTE_DOMAIN_LIST_MAX) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Number of guest info records is %d, "
+                         "which exceeds max limit: %d"),
+                       nrecords, REMOTE_DOMAIN_LIST_MAX);
+        goto cleanup;
+    }
+
+    if (nrecords && VIR_ALLOC_N(ret->retInfo.retInfo_val, nrecords) < 0)
+        goto cleanup;
+
+    ret->retInfo.retInfo_len = nrecords;
+
+    for (i = 0; i < nrecords; i++) {
+        remote_domain_stats_record *dst = ret->retInfo.retInfo_val + i;
+
+        make_nonnull_domain(&dst->dom, retInfo[i]->dom);
+
+        if (virTypedParamsSerialize(retInfo[i]->params,
+                                    retInfo[i]->nparams,
+                                    REMOTE_DOMAIN_GUEST_INFO_PARAMS_MAX,
+                                    (virTypedParameterRemotePtr *) &dst->params.params_val,
+                                    &dst->params.params_len,
+                                    VIR_TYPED_PARAM_STRING_OKAY) < 0)
+            goto cleanup;
+    }
+
+    rv = 0;
+
+ cleanup:
+    if (rv < 0) {
+        virNetMessageSaveError(rerr);
+        xdr_free((xdrproc_t)xdr_remote_connect_get_all_domain_guest_info_ret,
+                 (char *) ret);
+    }
+
+    virDomainStatsRecordListFree(retInfo);
+    virObjectListFree(doms);
+
+    return rv;
+}
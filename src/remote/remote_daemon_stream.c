@@ -203,7 +203,7 @@ daemonStreamEvent(virStreamPtr st, int events, void *opaque)
         events &= ~(VIR_STREAM_EVENT_HANGUP);
         stream->tx = false;
         stream->recvEOF = true;
-        if (!(msg = virNetMessageNew(false))) {
+        if (!(msg = virNetServerClientNewMessage(client, false))) {
             daemonRemoveClientStream(client, stream);
             virNetServerClientClose(client);
             goto cleanup;
@@ -249,7 +249,7 @@ daemonStreamEvent(virStreamPtr st, int events, void *opaque)
                                "%s", _("stream had I/O failure"));
         }
 
-        msg = virNetMessageNew(false);
+        msg = virNetServerClientNewMessage(client, false);
         if (!msg) {
             ret = -1;
         } else {
@@ -824,6 +824,7 @@ static int
 daemonStreamHandleRead(virNetServerClientPtr client,
                        daemonClientStream *stream)
 {
+    daemonClientPrivatePtr priv = virNetServerClientGetPrivateData(client);
     virNetMessagePtr msg = NULL;
     virNetMessageError rerr;
     char *buffer;
@@ -850,10 +851,10 @@ daemonStreamHandleRead(virNetServerClientPtr client,
 
     memset(&rerr, 0, sizeof(rerr));
 
-    if (VIR_ALLOC_N(buffer, bufferLen) < 0)
-        return -1;
+    if (priv->largeStreamChunks)
+        bufferLen = VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX;
 
-    if (!(msg = virNetMessageNew(false)))
+    if (!(msg = virNetServerClientNewMessage(client, false)))
         goto cleanup;
 
     if (stream->allowSkip && stream->dataLen == 0) {
@@ -908,6 +909,14 @@ daemonStreamHandleRead(virNetServerClientPtr client,
         bufferLen > stream->dataLen)
         bufferLen = stream->dataLen;
 
+    /* Read the data right into the packet sent to the client */
+    if (!(buffer = virNetServerProgramPrepareStreamData(stream->prog,
+                                                        msg,
+                                                        stream->procedure,
+                                                        stream->serial,
+                                                        bufferLen)))
+        goto cleanup;
+
     rv = virStreamRecv(stream->st, buffer, bufferLen);
     if (rv == -2) {
         /* Should never get this, since we're only called when we know
@@ -932,12 +941,7 @@ daemonStreamHandleRead(virNetServerClientPtr client,
         msg->cb = daemonStreamMessageFinished;
         msg->opaque = stream;
         stream->refs++;
-        if (virNetServerProgramSendStreamData(stream->prog,
-                                              client,
-                                              msg,
-                                              stream->procedure,
-                                              stream->serial,
-                                              buffer, rv) < 0)
+        if (virNetServerProgramSendPreparedStreamData(client, msg, rv) < 0)
             goto cleanup;
         msg = NULL;
     }
@@ -945,7 +949,6 @@ daemonStreamHandleRead(virNetServerClientPtr client,
  done:
     ret = 0;
  cleanup:
-    VIR_FREE(buffer);
     virNetMessageFree(msg);
     return ret;
 }
@@ -134,11 +134,28 @@ struct private_data {
     bool serverKeepAlive;       /* Does server support keepalive protocol? */
     bool serverEventFilter;     /* Does server support modern event filtering */
     bool serverCloseCallback;   /* Does server support driver close callback */
+    bool serverLargeStreamChunks; /* Does server support large stream packets */
+    bool serverCompression;     /* Does server support compressed payloads */
+    bool serverPackedTypedParams; /* Does server pack bulk stats replies */
 
     virObjectEventStatePtr eventState;
     virConnectCloseCallbackDataPtr closeCallback;
+
+    char *shareKey;             /* Set if shared by several connections */
+    virConnectPtr eventConn;    /* Hidden connection the events of a shared
+                                 * transport are decoded with */
+    unsigned int sharePersist;  /* Seconds a shared transport stays open
+                                 * once no connection uses it */
+    gint64 shareExpires;        /* When an unused shared transport is closed */
+    int shareTimer;             /* Timer closing it then, or -1 */
 };
 
+/* Transports opened with the "share" URI parameter, see
+ * remoteConnectOpenShared */
+static virMutex remoteSharedLock = VIR_MUTEX_INITIALIZER;
+static struct private_data **remoteShared;
+static size_t nremoteShared;
+
 enum {
     REMOTE_CALL_QEMU              = (1 << 0),
     REMOTE_CALL_LXC               = (1 << 1),
@@ -166,6 +183,13 @@ static int callFull(virConnectPtr conn, struct private_data *priv,
                     int proc_nr,
                     xdrproc_t args_filter, char *args,
                     xdrproc_t ret_filter, char *ret);
+static int callAsync(virConnectPtr conn, struct private_data *priv,
+                     unsigned int flags, int proc_nr,
+                     xdrproc_t args_filter, char *args,
+                     xdrproc_t ret_filter, char *ret,
+                     virNetClientProgramCallFunc cb, void *opaque);
+static int callAsyncWait(virConnectPtr conn, struct private_data *priv);
+static int doRemoteClose(virConnectPtr conn, struct private_data *priv);
 static int remoteAuthenticate(virConnectPtr conn, struct private_data *priv,
                               virConnectAuthPtr auth, const char *authtype);
 #if WITH_SASL
@@ -468,6 +492,11 @@ remoteDomainBuildEventBlockThreshold(virNetClientProgramPtr prog,
                                      virNetClientPtr client,
                                      void *evdata, void *opaque);
 
+static void
+remoteDomainBuildEventBlockJobProgress(virNetClientProgramPtr prog,
+                                       virNetClientPtr client,
+                                       void *evdata, void *opaque);
+
 static void
 remoteConnectNotifyEventConnectionClosed(virNetClientProgramPtr prog G_GNUC_UNUSED,
                                          virNetClientPtr client G_GNUC_UNUSED,
@@ -679,6 +708,10 @@ static virNetClientProgramEvent remoteEvents[] = {
       remoteDomainBuildEventBlockThreshold,
       sizeof(remote_domain_event_block_threshold_msg),
       (xdrproc_t)xdr_remote_domain_event_block_threshold_msg },
+    { REMOTE_PROC_DOMAIN_EVENT_BLOCK_JOB_PROGRESS,
+      remoteDomainBuildEventBlockJobProgress,
+      sizeof(remote_domain_event_block_job_progress_msg),
+      (xdrproc_t)xdr_remote_domain_event_block_job_progress_msg },
 };
 
 static void
@@ -737,6 +770,50 @@ remoteConnectSupportsFeatureUnlocked(virConnectPtr conn,
     return rc != -1 && ret.supported;
 }
 
+struct remoteFeatureProbe {
+    remote_connect_supports_feature_args args;
+    remote_connect_supports_feature_ret ret;
+    bool *supported;
+};
+
+static void
+remoteConnectSupportsFeatureDone(virNetClientProgramPtr prog G_GNUC_UNUSED,
+                                 virNetClientPtr client G_GNUC_UNUSED,
+                                 int rv,
+                                 void *opaque)
+{
+    struct remoteFeatureProbe *probe = opaque;
+
+    *probe->supported = rv == 0 && probe->ret.supported;
+}
+
+/*
+ * Asks the server about @nprobes features at once rather than waiting
+ * for the answer to each of them in turn.
+ */
+static void
+remoteConnectSupportsFeaturesUnlocked(virConnectPtr conn,
+                                      struct private_data *priv,
+                                      struct remoteFeatureProbe *probes,
+                                      size_t nprobes)
+{
+    size_t i;
+
+    for (i = 0; i < nprobes; i++) {
+        *probes[i].supported = false;
+
+        if (callAsync(conn, priv, 0, REMOTE_PROC_CONNECT_SUPPORTS_FEATURE,
+                      (xdrproc_t)xdr_remote_connect_supports_feature_args,
+                      (char *) &probes[i].args,
+                      (xdrproc_t)xdr_remote_connect_supports_feature_ret,
+                      (char *) &probes[i].ret,
+                      remoteConnectSupportsFeatureDone, &probes[i]) < 0)
+            break;
+    }
+
+    ignore_value(callAsyncWait(conn, priv));
+}
+
 /* helper macro to ease extraction of arguments from the URI */
 #define EXTRACT_URI_ARG_STR(ARG_NAME, ARG_VAR) \
     if (STRCASEEQ(var->name, ARG_NAME)) { \
@@ -953,6 +1030,7 @@ doRemoteOpen(virConnectPtr conn,
     g_autofree char *daemon_name = NULL;
     bool sanity = true;
     bool verify = true;
+    bool compress = true;
 #ifndef WIN32
     bool tty = true;
 #endif
@@ -1033,12 +1111,16 @@ doRemoteOpen(virConnectPtr conn,
             EXTRACT_URI_ARG_STR("mode", mode_str);
             EXTRACT_URI_ARG_BOOL("no_sanity", sanity);
             EXTRACT_URI_ARG_BOOL("no_verify", verify);
+            EXTRACT_URI_ARG_BOOL("no_compress", compress);
 #ifndef WIN32
             EXTRACT_URI_ARG_BOOL("no_tty", tty);
 #endif
 
-            if (STRCASEEQ(var->name, "authfile")) {
-                /* Strip this param, used by virauth.c */
+            if (STRCASEEQ(var->name, "authfile") ||
+                STRCASEEQ(var->name, "share") ||
+                STRCASEEQ(var->name, "persist")) {
+                /* Strip these params, used by virauth.c and
+                 * remoteConnectOpen respectively */
                 var->ignore = 1;
                 continue;
             }
@@ -1280,11 +1362,14 @@ doRemoteOpen(virConnectPtr conn,
                                  remoteClientCloseFunc,
                                  priv->closeCallback, virObjectFreeCallback);
 
+    /* The events of a shared transport must not be bound to the
+     * connection which happened to open it, as it may be closed first */
     if (!(priv->remoteProgram = virNetClientProgramNew(REMOTE_PROGRAM,
                                                        REMOTE_PROTOCOL_VERSION,
                                                        remoteEvents,
                                                        G_N_ELEMENTS(remoteEvents),
-                                                       conn)))
+                                                       priv->eventConn ?
+                                                       priv->eventConn : conn)))
         goto failed;
     if (!(priv->lxcProgram = virNetClientProgramNew(LXC_PROGRAM,
                                                     LXC_PROTOCOL_VERSION,
@@ -1296,7 +1381,8 @@ doRemoteOpen(virConnectPtr conn,
                                                      QEMU_PROTOCOL_VERSION,
                                                      qemuEvents,
                                                      G_N_ELEMENTS(qemuEvents),
-                                                     conn)))
+                                                     priv->eventConn ?
+                                                     priv->eventConn : conn)))
         goto failed;
 
     if (virNetClientAddProgram(priv->client, priv->remoteProgram) < 0 ||
@@ -1352,20 +1438,47 @@ doRemoteOpen(virConnectPtr conn,
     if (!(priv->eventState = virObjectEventStateNew()))
         goto failed;
 
-    priv->serverEventFilter = remoteConnectSupportsFeatureUnlocked(conn,
-                                priv, VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK);
+    {
+        struct remoteFeatureProbe probes[] = {
+            { { VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK }, { 0 },
+              &priv->serverEventFilter },
+            { { VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK }, { 0 },
+              &priv->serverCloseCallback },
+            { { VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_CHUNKS }, { 0 },
+              &priv->serverLargeStreamChunks },
+            { { VIR_DRV_FEATURE_REMOTE_PACKED_TYPED_PARAMS }, { 0 },
+              &priv->serverPackedTypedParams },
+            /* Has to stay last, see below */
+            { { VIR_DRV_FEATURE_REMOTE_COMPRESSION }, { 0 },
+              &priv->serverCompression },
+        };
+        size_t nprobes = G_N_ELEMENTS(probes);
+
+        /* Compression is not worth the CPU time on a local socket */
+        if (!compress || transport == REMOTE_DRIVER_TRANSPORT_UNIX)
+            nprobes--;
+
+        remoteConnectSupportsFeaturesUnlocked(conn, priv, probes, nprobes);
+    }
+
     if (!priv->serverEventFilter) {
         VIR_INFO("Avoiding server event filtering since it is not "
                  "supported by the server");
     }
 
-    priv->serverCloseCallback = remoteConnectSupportsFeatureUnlocked(conn,
-                                    priv, VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK);
     if (!priv->serverCloseCallback) {
         VIR_INFO("Close callback registering isn't supported "
                  "by the remote side.");
     }
 
+    if (!priv->serverLargeStreamChunks) {
+        VIR_INFO("Stream data is limited to legacy sized packets "
+                 "by the remote side.");
+    }
+
+    if (priv->serverCompression)
+        virNetClientSetCompression(priv->client, true);
+
     return VIR_DRV_OPEN_SUCCESS;
 
  failed:
@@ -1405,6 +1518,232 @@ remoteAllocPrivateData(void)
     return priv;
 }
 
+
+/* Looks for the "share" URI parameter, which asks for the transport of
+ * the connection to be shared with other connections to the same URI,
+ * and for the "persist" one, which keeps it open for that many seconds
+ * after the last of them is closed */
+static int
+remoteURIGetShare(virURIPtr uri,
+                  bool *share,
+                  unsigned int *persist)
+{
+    size_t i;
+
+    *share = false;
+    *persist = 0;
+
+    for (i = 0; i < uri->paramsCount; i++) {
+        virURIParamPtr var = &uri->params[i];
+        int tmp;
+
+        if (STRCASEEQ(var->name, "persist")) {
+            if (virStrToLong_uip(var->value, NULL, 10, persist) < 0 ||
+                *persist > INT_MAX / 1000)
+                goto error;
+            continue;
+        }
+
+        if (STRCASENEQ(var->name, "share"))
+            continue;
+
+        if (virStrToLong_i(var->value, NULL, 10, &tmp) < 0)
+            goto error;
+
+        *share = tmp != 0;
+    }
+
+    return 0;
+
+ error:
+    virReportError(VIR_ERR_INVALID_ARG,
+                   _("Failed to parse value of URI component %s"),
+                   uri->params[i].name);
+    return -1;
+}
+
+
+/*
+ * Closes the shared transports which no connection used for their
+ * persist time, and those the server closed meanwhile.
+ */
+static void
+remoteSharedCloseExpired(void)
+{
+    g_autofree struct private_data **expired = NULL;
+    size_t nexpired = 0;
+    gint64 now = g_get_monotonic_time();
+    size_t i = 0;
+
+    virMutexLock(&remoteSharedLock);
+
+    while (i < nremoteShared) {
+        struct private_data *priv = remoteShared[i];
+        bool expire;
+
+        remoteDriverLock(priv);
+        expire = priv->localUses == 0 &&
+            (priv->shareExpires <= now || !virNetClientIsOpen(priv->client));
+        remoteDriverUnlock(priv);
+
+        if (!expire) {
+            i++;
+            continue;
+        }
+
+        VIR_DELETE_ELEMENT(remoteShared, i, nremoteShared);
+        ignore_value(VIR_APPEND_ELEMENT(expired, nexpired, priv));
+    }
+
+    virMutexUnlock(&remoteSharedLock);
+
+    /* Nothing can find them anymore, close them without the lock held */
+    for (i = 0; i < nexpired; i++) {
+        struct private_data *priv = expired[i];
+
+        VIR_DEBUG("Closing unused shared transport %p", priv);
+
+        if (priv->shareTimer >= 0)
+            virEventRemoveTimeout(priv->shareTimer);
+
+        remoteDriverLock(priv);
+        doRemoteClose(priv->eventConn, priv);
+        remoteDriverUnlock(priv);
+        virMutexDestroy(&priv->lock);
+        VIR_FREE(priv);
+    }
+}
+
+
+static void
+remoteSharedIdleTimeout(int timer G_GNUC_UNUSED,
+                        void *opaque G_GNUC_UNUSED)
+{
+    remoteSharedCloseExpired();
+}
+
+
+/* Called with remoteSharedLock and the lock of @priv held once the last
+ * connection using @priv was closed, keeps it for later connections to
+ * reuse for its persist time */
+static void
+remoteSharedKeepIdle(struct private_data *priv)
+{
+    priv->shareExpires = g_get_monotonic_time() +
+        priv->sharePersist * G_USEC_PER_SEC;
+
+    /* Without an event loop the transport is only closed by the next
+     * one opened or closed after it expired */
+    if (priv->shareTimer < 0 &&
+        (priv->shareTimer = virEventAddTimeout(priv->sharePersist * 1000,
+                                               remoteSharedIdleTimeout,
+                                               NULL, NULL)) < 0)
+        virResetLastError();
+
+    VIR_DEBUG("Keeping unused shared transport %p for %u seconds",
+              priv, priv->sharePersist);
+}
+
+
+/**
+ * remoteConnectOpenShared:
+ * @conn: connection being opened
+ * @privptr: locked private data allocated for @conn
+ * @driver_str, @transport_str, @auth, @conf, @flags: see doRemoteOpen
+ *
+ * Opens @conn over the transport of a connection opened earlier with the
+ * same URI and @flags if there's one still connected to the server, or
+ * opens a new transport which later connections can share otherwise.
+ * Connections sharing a transport are a single client of the server:
+ * they skip the connection and authentication, keepalive and client
+ * limits of the server apply once for all of them and they all act
+ * with the identity the first one authenticated with. Everything else,
+ * such as the callbacks of events, stays per connection.
+ *
+ * In the former case *@privptr is freed and replaced with the locked
+ * private data of the shared transport.
+ */
+static virDrvOpenStatus
+remoteConnectOpenShared(virConnectPtr conn,
+                        struct private_data **privptr,
+                        const char *driver_str,
+                        const char *transport_str,
+                        virConnectAuthPtr auth,
+                        virConfPtr conf,
+                        unsigned int persist,
+                        unsigned int flags)
+{
+    struct private_data *priv = *privptr;
+    g_autofree char *uristr = NULL;
+    g_autofree char *key = NULL;
+    int ret = VIR_DRV_OPEN_ERROR;
+    size_t i;
+
+    if (!(uristr = virURIFormat(conn->uri)))
+        return VIR_DRV_OPEN_ERROR;
+
+    key = g_strdup_printf("%x %s", flags, uristr);
+
+    remoteSharedCloseExpired();
+
+    /* Opening a new transport with the lock held makes connections
+     * opened concurrently to the same URI wait for it rather than all
+     * open their own */
+    virMutexLock(&remoteSharedLock);
+
+    for (i = 0; i < nremoteShared; i++) {
+        struct private_data *shared = remoteShared[i];
+
+        if (STRNEQ(shared->shareKey, key))
+            continue;
+
+        remoteDriverLock(shared);
+
+        if (virNetClientIsOpen(shared->client)) {
+            VIR_DEBUG("Sharing transport %p for '%s'", shared, uristr);
+            if (shared->localUses++ == 0 && shared->shareTimer >= 0) {
+                virEventRemoveTimeout(shared->shareTimer);
+                shared->shareTimer = -1;
+            }
+            remoteDriverUnlock(priv);
+            virMutexDestroy(&priv->lock);
+            VIR_FREE(priv);
+            *privptr = shared;
+            ret = VIR_DRV_OPEN_SUCCESS;
+            goto cleanup;
+        }
+
+        /* The server closed it; the connections still using it keep it
+         * until they are closed, but it's not handed out anymore. Unused
+         * ones were closed above. */
+        remoteDriverUnlock(shared);
+        VIR_DELETE_ELEMENT(remoteShared, i, nremoteShared);
+        break;
+    }
+
+    priv->sharePersist = persist;
+    priv->shareTimer = -1;
+
+    if (!(priv->eventConn = virGetConnect()))
+        goto cleanup;
+    priv->eventConn->privateData = priv;
+
+    if ((ret = doRemoteOpen(conn, priv, driver_str, transport_str,
+                            auth, conf, flags)) != VIR_DRV_OPEN_SUCCESS) {
+        priv->eventConn->privateData = NULL;
+        virObjectUnref(priv->eventConn);
+        priv->eventConn = NULL;
+        goto cleanup;
+    }
+
+    priv->shareKey = g_steal_pointer(&key);
+    ignore_value(VIR_APPEND_ELEMENT(remoteShared, nremoteShared, priv));
+
+ cleanup:
+    virMutexUnlock(&remoteSharedLock);
+    return ret;
+}
+
 static virDrvOpenStatus
 remoteConnectOpen(virConnectPtr conn,
                   virConnectAuthPtr auth,
@@ -1417,9 +1756,12 @@ remoteConnectOpen(virConnectPtr conn,
     const char *autostart = getenv("LIBVIRT_AUTOSTART");
     char *driver = NULL;
     char *transport = NULL;
+    bool share = false;
+    unsigned int persist = 0;
 
     if (conn->uri &&
-        remoteSplitURIScheme(conn->uri, &driver, &transport) < 0)
+        (remoteSplitURIScheme(conn->uri, &driver, &transport) < 0 ||
+         remoteURIGetShare(conn->uri, &share, &persist) < 0))
         goto cleanup;
 
     if (inside_daemon) {
@@ -1490,7 +1832,12 @@ remoteConnectOpen(virConnectPtr conn,
         }
     }
 
-    ret = doRemoteOpen(conn, priv, driver, transport, auth, conf, rflags);
+    if (share)
+        ret = remoteConnectOpenShared(conn, &priv, driver, transport,
+                                      auth, conf, persist, rflags);
+    else
+        ret = doRemoteOpen(conn, priv, driver, transport, auth, conf, rflags);
+
     if (ret != VIR_DRV_OPEN_SUCCESS) {
         conn->privateData = NULL;
         remoteDriverUnlock(priv);
@@ -1546,6 +1893,13 @@ doRemoteClose(virConnectPtr conn, struct private_data *priv)
     virObjectUnref(priv->eventState);
     priv->eventState = NULL;
 
+    if (priv->eventConn) {
+        priv->eventConn->privateData = NULL;
+        virObjectUnref(priv->eventConn);
+        priv->eventConn = NULL;
+    }
+    VIR_FREE(priv->shareKey);
+
     return ret;
 }
 
@@ -1554,9 +1908,40 @@ remoteConnectClose(virConnectPtr conn)
 {
     int ret = 0;
     struct private_data *priv = conn->privateData;
+    bool shared = !!priv->shareKey;
+
+    /* Keeps remoteConnectOpenShared from handing out the transport
+     * while it's being closed */
+    if (shared)
+        virMutexLock(&remoteSharedLock);
 
     remoteDriverLock(priv);
     priv->localUses--;
+
+    if (shared) {
+        size_t i;
+
+        if (!priv->localUses && priv->sharePersist &&
+            virNetClientIsOpen(priv->client)) {
+            conn->privateData = NULL;
+            remoteSharedKeepIdle(priv);
+            remoteDriverUnlock(priv);
+            virMutexUnlock(&remoteSharedLock);
+            return 0;
+        }
+
+        if (!priv->localUses) {
+            for (i = 0; i < nremoteShared; i++) {
+                if (remoteShared[i] == priv) {
+                    VIR_DELETE_ELEMENT(remoteShared, i, nremoteShared);
+                    break;
+                }
+            }
+        }
+
+        virMutexUnlock(&remoteSharedLock);
+    }
+
     if (!priv->localUses) {
         ret = doRemoteClose(conn, priv);
         conn->privateData = NULL;
@@ -1567,6 +1952,9 @@ remoteConnectClose(virConnectPtr conn)
     if (priv)
         remoteDriverUnlock(priv);
 
+    if (shared)
+        remoteSharedCloseExpired();
+
     return ret;
 }
 
@@ -5687,6 +6075,42 @@ remoteDomainBuildEventBlockThreshold(virNetClientProgramPtr prog G_GNUC_UNUSED,
 }
 
 
+static void
+remoteDomainBuildEventBlockJobProgress(virNetClientProgramPtr prog G_GNUC_UNUSED,
+                                       virNetClientPtr client G_GNUC_UNUSED,
+                                       void *evdata, void *opaque)
+{
+    virConnectPtr conn = opaque;
+    remote_domain_event_block_job_progress_msg *msg = evdata;
+    struct private_data *priv = conn->privateData;
+    virDomainPtr dom;
+    virObjectEventPtr event = NULL;
+
+    if (!(dom = get_nonnull_domain(conn, msg->dom)))
+        return;
+
+    event = virDomainEventBlockJobProgressNewFromDom(dom, msg->disk, msg->type,
+                                                     msg->cur, msg->end,
+                                                     msg->bandwidth);
+
+    virObjectUnref(dom);
+
+    virObjectEventStateQueueRemote(priv->eventState, event, msg->callbackID);
+}
+
+
+static size_t
+remoteStreamGetChunkSize(virStreamPtr st)
+{
+    struct private_data *priv = st->conn->privateData;
+
+    if (priv->serverLargeStreamChunks)
+        return VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX;
+
+    return VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+}
+
+
 static int
 remoteStreamSend(virStreamPtr st,
                  const char *data,
@@ -5963,6 +6387,7 @@ static virStreamDriver remoteStreamDrv = {
     .streamEventAddCallback = remoteStreamEventAddCallback,
     .streamEventUpdateCallback = remoteStreamEventUpdateCallback,
     .streamEventRemoveCallback = remoteStreamEventRemoveCallback,
+    .streamGetChunkSize = remoteStreamGetChunkSize,
 };
 
 
@@ -6781,6 +7206,72 @@ call(virConnectPtr conn,
                     ret_filter, ret);
 }
 
+/*
+ * Serial a set of arguments into a method call message and send
+ * that to the server without waiting for the reply. @cb is run once
+ * the reply was decoded into @ret, which has to stay valid until then.
+ * It may be run from any thread processing I/O on the connection,
+ * including the event loop. The contents of @ret have to be freed
+ * once @cb ran.
+ */
+static int
+callAsync(virConnectPtr conn G_GNUC_UNUSED,
+          struct private_data *priv,
+          unsigned int flags,
+          int proc_nr,
+          xdrproc_t args_filter, char *args,
+          xdrproc_t ret_filter, char *ret,
+          virNetClientProgramCallFunc cb,
+          void *opaque)
+{
+    int rv;
+    virNetClientProgramPtr prog;
+    int counter = priv->counter++;
+    virNetClientPtr client = priv->client;
+    priv->localUses++;
+
+    if (flags & REMOTE_CALL_QEMU)
+        prog = priv->qemuProgram;
+    else if (flags & REMOTE_CALL_LXC)
+        prog = priv->lxcProgram;
+    else
+        prog = priv->remoteProgram;
+
+    /* Unlock, as submitting the call may dispatch async events
+     * or the replies of other calls */
+    remoteDriverUnlock(priv);
+    rv = virNetClientProgramCallAsync(prog,
+                                      client,
+                                      counter,
+                                      proc_nr,
+                                      args_filter, args,
+                                      ret_filter, ret,
+                                      cb, opaque);
+    remoteDriverLock(priv);
+    priv->localUses--;
+
+    return rv;
+}
+
+/*
+ * Wait until the callbacks of all calls submitted with callAsync returned
+ */
+static int
+callAsyncWait(virConnectPtr conn G_GNUC_UNUSED,
+              struct private_data *priv)
+{
+    int rv;
+    virNetClientPtr client = priv->client;
+    priv->localUses++;
+
+    remoteDriverUnlock(priv);
+    rv = virNetClientWaitAsync(client);
+    remoteDriverLock(priv);
+    priv->localUses--;
+
+    return rv;
+}
+
 
 static int
 remoteDomainGetInterfaceParameters(virDomainPtr domain,
@@ -6920,6 +7411,45 @@ remoteNodeGetSEVInfo(virConnectPtr conn,
 }
 
 
+static int
+remoteNodeGetMigrationParameters(virConnectPtr conn,
+                                 virTypedParameterPtr *params,
+                                 int *nparams,
+                                 unsigned int flags)
+{
+    int rv = -1;
+    remote_node_get_migration_parameters_args args;
+    remote_node_get_migration_parameters_ret ret;
+    struct private_data *priv = conn->privateData;
+
+    remoteDriverLock(priv);
+
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+    if (call(conn, priv, 0, REMOTE_PROC_NODE_GET_MIGRATION_PARAMETERS,
+             (xdrproc_t) xdr_remote_node_get_migration_parameters_args, (char *) &args,
+             (xdrproc_t) xdr_remote_node_get_migration_parameters_ret, (char *) &ret) == -1)
+        goto done;
+
+    if (virTypedParamsDeserialize((virTypedParameterRemotePtr) ret.params.params_val,
+                                  ret.params.params_len,
+                                  REMOTE_NODE_MIGRATION_PARAMETERS_MAX,
+                                  params,
+                                  nparams) < 0)
+        goto cleanup;
+
+    rv = 0;
+
+ cleanup:
+    xdr_free((xdrproc_t) xdr_remote_node_get_migration_parameters_ret,
+             (char *) &ret);
+ done:
+    remoteDriverUnlock(priv);
+    return rv;
+}
+
+
 static int
 remoteNodeGetCPUMap(virConnectPtr conn,
                     unsigned char **cpumap,
@@ -7266,19 +7796,68 @@ remoteDomainMigratePrepareTunnel3Params(virConnectPtr dconn,
 
 
 static int
-remoteDomainMigratePerform3Params(virDomainPtr dom,
-                                  const char *dconnuri,
-                                  virTypedParameterPtr params,
-                                  int nparams,
-                                  const char *cookiein,
-                                  int cookieinlen,
-                                  char **cookieout,
-                                  int *cookieoutlen,
-                                  unsigned int flags)
+remoteDomainMigratePrepareTunnelStripe(virDomainPtr dom,
+                                       virStreamPtr st,
+                                       unsigned int stripe,
+                                       unsigned int flags)
 {
-    int rv = -1;
-    remote_domain_migrate_perform3_params_args args;
-    remote_domain_migrate_perform3_params_ret ret;
+    struct private_data *priv = dom->conn->privateData;
+    int rv = -1;
+    remote_domain_migrate_prepare_tunnel_stripe_args args;
+    virNetClientStreamPtr netst;
+
+    remoteDriverLock(priv);
+
+    make_nonnull_domain(&args.dom, dom);
+    args.stripe = stripe;
+    args.flags = flags;
+
+    if (!(netst = virNetClientStreamNew(priv->remoteProgram,
+                                        REMOTE_PROC_DOMAIN_MIGRATE_PREPARE_TUNNEL_STRIPE,
+                                        priv->counter,
+                                        false)))
+        goto cleanup;
+
+    if (virNetClientAddStream(priv->client, netst) < 0) {
+        virObjectUnref(netst);
+        goto cleanup;
+    }
+
+    st->driver = &remoteStreamDrv;
+    st->privateData = netst;
+    st->ff = virObjectFreeCallback;
+
+    if (call(dom->conn, priv, 0, REMOTE_PROC_DOMAIN_MIGRATE_PREPARE_TUNNEL_STRIPE,
+             (xdrproc_t) xdr_remote_domain_migrate_prepare_tunnel_stripe_args,
+             (char *) &args,
+             (xdrproc_t) xdr_void, (char *) NULL) == -1) {
+        virNetClientRemoveStream(priv->client, netst);
+        virObjectUnref(netst);
+        goto cleanup;
+    }
+
+    rv = 0;
+
+ cleanup:
+    remoteDriverUnlock(priv);
+    return rv;
+}
+
+
+static int
+remoteDomainMigratePerform3Params(virDomainPtr dom,
+                                  const char *dconnuri,
+                                  virTypedParameterPtr params,
+                                  int nparams,
+                                  const char *cookiein,
+                                  int cookieinlen,
+                                  char **cookieout,
+                                  int *cookieoutlen,
+                                  unsigned int flags)
+{
+    int rv = -1;
+    remote_domain_migrate_perform3_params_args args;
+    remote_domain_migrate_perform3_params_ret ret;
     struct private_data *priv = dom->conn->privateData;
 
     remoteDriverLock(priv);
@@ -7711,6 +8290,105 @@ remoteNetworkGetDHCPLeases(virNetworkPtr net,
 }
 
 
+/* Same as remoteConnectGetAllDomainStats, for servers which pack the
+ * typed parameters of the reply */
+static int
+remoteConnectGetAllDomainStatsPacked(virConnectPtr conn,
+                                     struct private_data *priv,
+                                     virDomainPtr *doms,
+                                     unsigned int ndoms,
+                                     unsigned int stats,
+                                     virDomainStatsRecordPtr **retStats,
+                                     unsigned int flags)
+{
+    int rv = -1;
+    size_t i;
+    remote_connect_get_all_domain_stats_packed_args args;
+    remote_connect_get_all_domain_stats_packed_ret ret;
+    virTypedParamsPackedNamePtr names;
+    virDomainStatsRecordPtr elem = NULL;
+    virDomainStatsRecordPtr *tmpret = NULL;
+
+    memset(&args, 0, sizeof(args));
+
+    if (ndoms) {
+        if (VIR_ALLOC_N(args.doms.doms_val, ndoms) < 0)
+            goto cleanup;
+
+        for (i = 0; i < ndoms; i++)
+            make_nonnull_domain(args.doms.doms_val + i, doms[i]);
+    }
+    args.doms.doms_len = ndoms;
+
+    args.stats = stats;
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+
+    remoteDriverLock(priv);
+    if (call(conn, priv, 0, REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_STATS_PACKED,
+             (xdrproc_t)xdr_remote_connect_get_all_domain_stats_packed_args, (char *)&args,
+             (xdrproc_t)xdr_remote_connect_get_all_domain_stats_packed_ret, (char *)&ret) == -1) {
+        remoteDriverUnlock(priv);
+        goto cleanup;
+    }
+    remoteDriverUnlock(priv);
+
+    if (ret.retStats.retStats_len > REMOTE_DOMAIN_LIST_MAX) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Number of stats entries is %d, which exceeds max limit: %d"),
+                       ret.retStats.retStats_len, REMOTE_DOMAIN_LIST_MAX);
+        goto cleanup;
+    }
+
+    names = (virTypedParamsPackedNamePtr) ret.names.names_val;
+    if (virTypedParamsPackedNamesCheck(names, ret.names.names_len) < 0)
+        goto cleanup;
+
+    *retStats = NULL;
+
+    if (VIR_ALLOC_N(tmpret, ret.retStats.retStats_len + 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ret.retStats.retStats_len; i++) {
+        remote_domain_stats_packed_record *rec = ret.retStats.retStats_val + i;
+
+        if (VIR_ALLOC(elem) < 0)
+            goto cleanup;
+
+        if (!(elem->dom = get_nonnull_domain(conn, rec->dom)))
+            goto cleanup;
+
+        if (virTypedParamsUnpack(names, ret.names.names_len,
+                                 rec->params.params_val,
+                                 rec->params.params_len,
+                                 REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX,
+                                 &elem->params,
+                                 &elem->nparams) < 0)
+            goto cleanup;
+
+        tmpret[i] = elem;
+        elem = NULL;
+    }
+
+    *retStats = tmpret;
+    tmpret = NULL;
+    rv = ret.retStats.retStats_len;
+
+ cleanup:
+    if (elem) {
+        virObjectUnref(elem->dom);
+        VIR_FREE(elem);
+    }
+    virDomainStatsRecordListFree(tmpret);
+    VIR_FREE(args.doms.doms_val);
+    xdr_free((xdrproc_t)xdr_remote_connect_get_all_domain_stats_packed_ret,
+             (char *) &ret);
+
+    return rv;
+}
+
+
 static int
 remoteConnectGetAllDomainStats(virConnectPtr conn,
                                virDomainPtr *doms,
@@ -7727,6 +8405,10 @@ remoteConnectGetAllDomainStats(virConnectPtr conn,
     virDomainStatsRecordPtr elem = NULL;
     virDomainStatsRecordPtr *tmpret = NULL;
 
+    if (priv->serverPackedTypedParams)
+        return remoteConnectGetAllDomainStatsPacked(conn, priv, doms, ndoms,
+                                                    stats, retStats, flags);
+
     memset(&args, 0, sizeof(args));
 
     if (ndoms) {
@@ -7802,6 +8484,195 @@ remoteConnectGetAllDomainStats(virConnectPtr conn,
 }
 
 
+struct remoteDomainXMLBatch {
+    remote_connect_get_all_domain_xml_args args;
+    remote_connect_get_all_domain_xml_ret ret;
+    int rv;
+    virErrorPtr err;
+};
+
+static void
+remoteConnectGetAllDomainXMLDone(virNetClientProgramPtr prog G_GNUC_UNUSED,
+                                 virNetClientPtr client G_GNUC_UNUSED,
+                                 int rv,
+                                 void *opaque)
+{
+    struct remoteDomainXMLBatch *batch = opaque;
+
+    batch->rv = rv;
+    if (rv < 0)
+        virErrorPreserveLast(&batch->err);
+}
+
+static int
+remoteDomainXMLRecordsAppend(virConnectPtr conn,
+                             remote_connect_get_all_domain_xml_ret *ret,
+                             virDomainXMLRecordPtr *records,
+                             size_t *nrecords)
+{
+    size_t i;
+
+    for (i = 0; i < ret->records.records_len; i++) {
+        remote_domain_xml_record *rec = ret->records.records_val + i;
+        virDomainXMLRecordPtr elem;
+
+        if (VIR_ALLOC(elem) < 0)
+            return -1;
+
+        if (!(elem->dom = get_nonnull_domain(conn, rec->dom))) {
+            VIR_FREE(elem);
+            return -1;
+        }
+
+        elem->state = rec->state;
+        elem->reason = rec->reason;
+        elem->xml = g_steal_pointer(&rec->xml);
+
+        records[(*nrecords)++] = elem;
+    }
+
+    return 0;
+}
+
+static int
+remoteConnectGetAllDomainXML(virConnectPtr conn,
+                             virDomainPtr *doms,
+                             unsigned int ndoms,
+                             unsigned int xmlflags,
+                             virDomainXMLRecordPtr **records,
+                             unsigned int flags)
+{
+    struct private_data *priv = conn->privateData;
+    int rv = -1;
+    size_t i;
+    remote_connect_get_all_domain_xml_args args;
+    remote_connect_get_all_domain_xml_ret ret;
+    struct remoteDomainXMLBatch *batches = NULL;
+    size_t nbatches = 0;
+    virErrorPtr err = NULL;
+    virDomainXMLRecordPtr *tmpret = NULL;
+    size_t ntmpret = 0;
+    size_t total;
+
+    memset(&args, 0, sizeof(args));
+
+    if (ndoms) {
+        if (VIR_ALLOC_N(args.doms.doms_val, ndoms) < 0)
+            goto cleanup;
+
+        for (i = 0; i < ndoms; i++)
+            make_nonnull_domain(args.doms.doms_val + i, doms[i]);
+    }
+    args.doms.doms_len = ndoms;
+
+    args.xmlflags = xmlflags;
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+
+    remoteDriverLock(priv);
+    if (call(conn, priv, 0, REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_XML,
+             (xdrproc_t)xdr_remote_connect_get_all_domain_xml_args, (char *)&args,
+             (xdrproc_t)xdr_remote_connect_get_all_domain_xml_ret, (char *)&ret) == -1) {
+        remoteDriverUnlock(priv);
+        goto cleanup;
+    }
+
+    /* Query the XML of the domains which didn't fit in the reply with
+     * all the calls in flight at once */
+    if (ret.more.more_len) {
+        size_t nsubmitted = 0;
+
+        nbatches = VIR_DIV_UP(ret.more.more_len,
+                              REMOTE_CONNECT_GET_ALL_DOMAIN_XML_BATCH);
+        batches = g_new0(struct remoteDomainXMLBatch, nbatches);
+
+        for (i = 0; i < nbatches; i++) {
+            struct remoteDomainXMLBatch *batch = batches + i;
+            size_t start = i * REMOTE_CONNECT_GET_ALL_DOMAIN_XML_BATCH;
+
+            batch->args.doms.doms_val = ret.more.more_val + start;
+            batch->args.doms.doms_len = MIN(REMOTE_CONNECT_GET_ALL_DOMAIN_XML_BATCH,
+                                            ret.more.more_len - start);
+            batch->args.xmlflags = xmlflags;
+            batch->args.flags = flags;
+            batch->rv = -1;
+
+            if (callAsync(conn, priv, 0, REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_XML,
+                          (xdrproc_t)xdr_remote_connect_get_all_domain_xml_args,
+                          (char *)&batch->args,
+                          (xdrproc_t)xdr_remote_connect_get_all_domain_xml_ret,
+                          (char *)&batch->ret,
+                          remoteConnectGetAllDomainXMLDone, batch) < 0) {
+                virErrorPreserveLast(&err);
+                break;
+            }
+            nsubmitted++;
+        }
+
+        if (nsubmitted &&
+            callAsyncWait(conn, priv) < 0 && !err)
+            virErrorPreserveLast(&err);
+
+        for (i = 0; i < nsubmitted && !err; i++) {
+            if (batches[i].rv < 0) {
+                err = g_steal_pointer(&batches[i].err);
+                if (!err)
+                    virErrorPreserveLast(&err);
+            }
+        }
+    }
+    remoteDriverUnlock(priv);
+
+    if (err) {
+        virErrorRestore(&err);
+        goto cleanup;
+    }
+
+    total = ret.records.records_len;
+    for (i = 0; i < nbatches; i++)
+        total += batches[i].ret.records.records_len;
+
+    if (total > REMOTE_DOMAIN_LIST_MAX) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Number of domain XML records is %zu, which exceeds max limit: %d"),
+                       total, REMOTE_DOMAIN_LIST_MAX);
+        goto cleanup;
+    }
+
+    *records = NULL;
+
+    if (VIR_ALLOC_N(tmpret, total + 1) < 0)
+        goto cleanup;
+
+    if (remoteDomainXMLRecordsAppend(conn, &ret, tmpret, &ntmpret) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nbatches; i++) {
+        if (remoteDomainXMLRecordsAppend(conn, &batches[i].ret,
+                                         tmpret, &ntmpret) < 0)
+            goto cleanup;
+    }
+
+    *records = g_steal_pointer(&tmpret);
+    rv = ntmpret;
+
+ cleanup:
+    virDomainXMLRecordListFree(tmpret);
+    for (i = 0; i < nbatches; i++) {
+        virFreeError(batches[i].err);
+        xdr_free((xdrproc_t)xdr_remote_connect_get_all_domain_xml_ret,
+                 (char *) &batches[i].ret);
+    }
+    VIR_FREE(batches);
+    VIR_FREE(args.doms.doms_val);
+    xdr_free((xdrproc_t)xdr_remote_connect_get_all_domain_xml_ret,
+             (char *) &ret);
+
+    return rv;
+}
+
+
 static int
 remoteNodeAllocPages(virConnectPtr conn,
                      unsigned int npages,
@@ -8253,6 +9124,93 @@ remoteDomainGetGuestInfo(virDomainPtr dom,
     return rv;
 }
 
+static int
+remoteConnectGetAllDomainGuestInfo(virConnectPtr conn,
+                                   virDomainPtr *doms,
+                                   unsigned int ndoms,
+                                   unsigned int types,
+                                   virDomainStatsRecordPtr **retInfo,
+                                   unsigned int flags)
+{
+    struct private_data *priv = conn->privateData;
+    int rv = -1;
+    size_t i;
+    remote_connect_get_all_domain_guest_info_args args;
+    remote_connect_get_all_domain_guest_info_ret ret;
+    virDomainStatsRecordPtr elem = NULL;
+    virDomainStatsRecordPtr *tmpret = NULL;
+
+    memset(&args, 0, sizeof(args));
+
+    if (ndoms) {
+        if (VIR_ALLOC_N(args.doms.doms_val, ndoms) < 0)
+            goto cleanup;
+
+        for (i = 0; i < ndoms; i++)
+            make_nonnull_domain(args.doms.doms_val + i, doms[i]);
+    }
+    args.doms.doms_len = ndoms;
+
+    args.types = types;
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+
+    remoteDriverLock(priv);
+    if (call(conn, priv, 0, REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_GUEST_INFO,
+             (xdrproc_t)xdr_remote_connect_get_all_domain_guest_info_args, (char *)&args,
+             (xdrproc_t)xdr_remote_connect_get_all_domain_guest_info_ret, (char *)&ret) == -1) {
+        remoteDriverUnlock(priv);
+        goto cleanup;
+    }
+    remoteDriverUnlock(priv);
+
+    if (ret.retInfo.retInfo_len > REMOTE_DOMAIN_LIST_MAX) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Number of guest info records is %d, which exceeds max limit: %d"),
+                       ret.retInfo.retInfo_len, REMOTE_DOMAIN_LIST_MAX);
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(tmpret, ret.retInfo.retInfo_len + 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ret.retInfo.retInfo_len; i++) {
+        remote_domain_stats_record *rec = ret.retInfo.retInfo_val + i;
+
+        if (VIR_ALLOC(elem) < 0)
+            goto cleanup;
+
+        if (!(elem->dom = get_nonnull_domain(conn, rec->dom)))
+            goto cleanup;
+
+        if (virTypedParamsDeserialize((virTypedParameterRemotePtr) rec->params.params_val,
+                                      rec->params.params_len,
+                                      REMOTE_DOMAIN_GUEST_INFO_PARAMS_MAX,
+                                      &elem->params,
+                                      &elem->nparams) < 0)
+            goto cleanup;
+
+        tmpret[i] = elem;
+        elem = NULL;
+    }
+
+    *retInfo = g_steal_pointer(&tmpret);
+    rv = ret.retInfo.retInfo_len;
+
+ cleanup:
+    if (elem) {
+        virObjectUnref(elem->dom);
+        VIR_FREE(elem);
+    }
+    virDomainStatsRecordListFree(tmpret);
+    VIR_FREE(args.doms.doms_val);
+    xdr_free((xdrproc_t)xdr_remote_connect_get_all_domain_guest_info_ret,
+             (char *) &ret);
+
+    return rv;
+}
+
 /* get_nonnull_domain and get_nonnull_network turn an on-wire
  * (name, uuid) pair into virDomainPtr or virNetworkPtr object.
  * These can return NULL if underlying memory allocations fail,
@@ -8684,6 +9642,15 @@ static virHypervisorDriver hypervisor_driver = {
     .domainAgentSetResponseTimeout = remoteDomainAgentSetResponseTimeout, /* 5.10.0 */
     .domainBackupBegin = remoteDomainBackupBegin, /* 6.0.0 */
     .domainBackupGetXMLDesc = remoteDomainBackupGetXMLDesc, /* 6.0.0 */
+    .domainMigratePrepareTunnelStripe = remoteDomainMigratePrepareTunnelStripe, /* 6.2.0 */
+    .connectGetAllDomainXML = remoteConnectGetAllDomainXML, /* 6.2.0 */
+    .domainAttachDeviceList = remoteDomainAttachDeviceList, /* 6.2.0 */
+    .domainDetachDeviceList = remoteDomainDetachDeviceList, /* 6.2.0 */
+    .connectGetAllDomainGuestInfo = remoteConnectGetAllDomainGuestInfo, /* 6.2.0 */
+    .nodeGetMigrationParameters = remoteNodeGetMigrationParameters, /* 6.2.0 */
+    .nodeSetMigrationParameters = remoteNodeSetMigrationParameters, /* 6.2.0 */
+    .domainBlockPeekStream = remoteDomainBlockPeekStream, /* 6.2.0 */
+    .domainMemoryPeekStream = remoteDomainMemoryPeekStream, /* 6.2.0 */
 };
 
 static virNetworkDriver network_driver = {
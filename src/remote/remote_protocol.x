@@ -239,12 +239,25 @@ const REMOTE_CONNECT_CPU_MODELS_MAX = 8192;
 /* Upper limit on number of mountpoints to frozen */
 const REMOTE_DOMAIN_FSFREEZE_MOUNTPOINTS_MAX = 256;
 
+/* Upper limit on number of devices attached or detached at once */
+const REMOTE_DOMAIN_DEVICE_LIST_MAX = 256;
+
 /* Upper limit on the maximum number of leases in one lease file */
 const REMOTE_NETWORK_DHCP_LEASES_MAX = 65536;
 
 /* Upper limit on count of parameters returned via bulk stats API */
 const REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX = 262144;
 
+/* Upper limits on the dictionary of parameter names and the size of the
+ * packed parameters of a domain in the packed bulk stats reply */
+const REMOTE_TYPED_PARAM_PACKED_NAMES_MAX = 65536;
+const REMOTE_TYPED_PARAM_PACKED_MAX = 4194304;
+
+/* Number of domains whose XML is returned by a single call of
+ * REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_XML, the remaining ones are
+ * listed in 'more' so that the client can query them separately. */
+const REMOTE_CONNECT_GET_ALL_DOMAIN_XML_BATCH = 128;
+
 /* Upper limit of message size for tunable event. */
 const REMOTE_DOMAIN_EVENT_TUNABLE_MAX = 2048;
 
@@ -280,6 +293,9 @@ const REMOTE_DOMAIN_GUEST_INFO_PARAMS_MAX = 2048;
  */
 const REMOTE_NETWORK_PORT_PARAMETERS_MAX = 16;
 
+/* Upper limit on number of node migration parameters */
+const REMOTE_NODE_MIGRATION_PARAMETERS_MAX = 16;
+
 
 /* UUID.  VIR_UUID_BUFLEN definition comes from libvirt.h */
 typedef opaque remote_uuid[VIR_UUID_BUFLEN];
@@ -3771,6 +3787,113 @@ struct remote_domain_backup_get_xml_desc_ret {
     remote_nonnull_string xml;
 };
 
+struct remote_domain_migrate_prepare_tunnel_stripe_args {
+    remote_nonnull_domain dom;
+    unsigned int stripe;
+    unsigned int flags;
+};
+
+struct remote_domain_xml_record {
+    remote_nonnull_domain dom;
+    int state;
+    int reason;
+    remote_nonnull_string xml;
+};
+
+struct remote_connect_get_all_domain_xml_args {
+    remote_nonnull_domain doms<REMOTE_DOMAIN_LIST_MAX>;
+    unsigned int xmlflags;
+    unsigned int flags;
+};
+
+struct remote_connect_get_all_domain_xml_ret {
+    remote_domain_xml_record records<REMOTE_DOMAIN_LIST_MAX>;
+    remote_nonnull_domain more<REMOTE_DOMAIN_LIST_MAX>;
+};
+
+struct remote_domain_attach_device_list_args {
+    remote_nonnull_domain dom;
+    remote_nonnull_string xmls<REMOTE_DOMAIN_DEVICE_LIST_MAX>; /* (const char **) */
+    unsigned int flags;
+};
+
+struct remote_domain_detach_device_list_args {
+    remote_nonnull_domain dom;
+    remote_nonnull_string xmls<REMOTE_DOMAIN_DEVICE_LIST_MAX>; /* (const char **) */
+    unsigned int flags;
+};
+
+struct remote_domain_event_block_job_progress_msg {
+    int callbackID;
+    remote_nonnull_domain dom;
+    remote_nonnull_string disk;
+    int type;
+    unsigned hyper cur;
+    unsigned hyper end;
+    unsigned hyper bandwidth;
+};
+
+struct remote_connect_get_all_domain_guest_info_args {
+    remote_nonnull_domain doms<REMOTE_DOMAIN_LIST_MAX>;
+    unsigned int types;
+    unsigned int flags;
+};
+
+struct remote_connect_get_all_domain_guest_info_ret {
+    remote_domain_stats_record retInfo<REMOTE_DOMAIN_LIST_MAX>;
+};
+
+/* Entry of the dictionary of the packed typed parameter encoding, see
+ * virTypedParamsPack */
+struct remote_typed_param_packed_name {
+    remote_nonnull_string name;
+    int offset;
+};
+
+struct remote_domain_stats_packed_record {
+    remote_nonnull_domain dom;
+    opaque params<REMOTE_TYPED_PARAM_PACKED_MAX>;
+};
+
+struct remote_connect_get_all_domain_stats_packed_args {
+    remote_nonnull_domain doms<REMOTE_DOMAIN_LIST_MAX>;
+    unsigned int stats;
+    unsigned int flags;
+};
+
+struct remote_connect_get_all_domain_stats_packed_ret {
+    remote_typed_param_packed_name names<REMOTE_TYPED_PARAM_PACKED_NAMES_MAX>;
+    remote_domain_stats_packed_record retStats<REMOTE_DOMAIN_LIST_MAX>;
+};
+
+struct remote_node_get_migration_parameters_args {
+    unsigned int flags;
+};
+
+struct remote_node_get_migration_parameters_ret {
+    remote_typed_param params<REMOTE_NODE_MIGRATION_PARAMETERS_MAX>;
+};
+
+struct remote_node_set_migration_parameters_args {
+    remote_typed_param params<REMOTE_NODE_MIGRATION_PARAMETERS_MAX>;
+    unsigned int flags;
+};
+
+struct remote_domain_block_peek_stream_args {
+    remote_nonnull_domain dom;
+    remote_nonnull_string disk;
+    unsigned hyper offset;
+    unsigned hyper length;
+    unsigned int flags;
+};
+
+struct remote_domain_memory_peek_stream_args {
+    remote_nonnull_domain dom;
+    unsigned hyper start;
+    unsigned hyper length;
+    unsigned int flags;
+};
+
 /*----- Protocol. -----*/
 
 /* Define the program number, protocol version and procedure numbers here. */
@@ -6664,5 +6787,82 @@ enum remote_procedure {
      * @priority: high
      * @acl: domain:read
      */
-    REMOTE_PROC_DOMAIN_BACKUP_GET_XML_DESC = 422
+    REMOTE_PROC_DOMAIN_BACKUP_GET_XML_DESC = 422,
+
+    /**
+     * @generate: none
+     * @acl: domain:migrate
+     */
+    REMOTE_PROC_DOMAIN_MIGRATE_PREPARE_TUNNEL_STRIPE = 423,
+
+    /**
+     * @generate: none
+     * @acl: connect:search_domains
+     * @aclfilter: domain:read
+     * @aclfilter: domain:read_secure:VIR_DOMAIN_XML_SECURE
+     * @aclfilter: domain:read_secure:VIR_DOMAIN_XML_MIGRATABLE
+     */
+    REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_XML = 424,
+
+    /**
+     * @generate: both
+     * @acl: domain:write
+     * @acl: domain:save:!VIR_DOMAIN_AFFECT_CONFIG|VIR_DOMAIN_AFFECT_LIVE
+     * @acl: domain:save:VIR_DOMAIN_AFFECT_CONFIG
+     */
+    REMOTE_PROC_DOMAIN_ATTACH_DEVICE_LIST = 425,
+
+    /**
+     * @generate: both
+     * @acl: domain:write
+     * @acl: domain:save:!VIR_DOMAIN_AFFECT_CONFIG|VIR_DOMAIN_AFFECT_LIVE
+     * @acl: domain:save:VIR_DOMAIN_AFFECT_CONFIG
+     */
+    REMOTE_PROC_DOMAIN_DETACH_DEVICE_LIST = 426,
+
+    /**
+     * @generate: both
+     * @acl: none
+     */
+    REMOTE_PROC_DOMAIN_EVENT_BLOCK_JOB_PROGRESS = 427,
+
+    /**
+     * @generate: none
+     * @acl: connect:search_domains
+     * @aclfilter: domain:write
+     */
+    REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_GUEST_INFO = 428,
+
+    /**
+     * @generate: none
+     * @acl: connect:search_domains
+     * @aclfilter: domain:read
+     */
+    REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_STATS_PACKED = 429,
+
+    /**
+     * @generate: none
+     * @acl: connect:read
+     */
+    REMOTE_PROC_NODE_GET_MIGRATION_PARAMETERS = 430,
+
+    /**
+     * @generate: both
+     * @acl: connect:write
+     */
+    REMOTE_PROC_NODE_SET_MIGRATION_PARAMETERS = 431,
+
+    /**
+     * @generate: both
+     * @readstream: 1
+     * @acl: domain:block_read
+     */
+    REMOTE_PROC_DOMAIN_BLOCK_PEEK_STREAM = 432,
+
+    /**
+     * @generate: both
+     * @readstream: 1
+     * @acl: domain:mem_read
+     */
+    REMOTE_PROC_DOMAIN_MEMORY_PEEK_STREAM = 433
 };
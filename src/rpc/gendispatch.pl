@@ -2053,6 +2053,7 @@ elsif ($mode eq "client") {
             "node_device_conf.h",
             "interface_conf.h",
             "virnwfilterbindingdef.h",
+            "virbitmap.h",
             );
         foreach my $hdr (@headers) {
             print "#include \"$hdr\"\n";
@@ -2092,6 +2093,8 @@ elsif ($mode eq "client") {
             }
             if (defined $call->{aclfilter}) {
                 print $apiname . "CheckACL;\n";
+                print $apiname . "CheckACLBatch;\n"
+                    unless grep { !/^domain:[^:]+$/ } @{$call->{aclfilter}};
             }
             print $apiname . "EnsureACL;\n";
         } elsif ($mode eq "aclapi") {
@@ -2100,9 +2103,68 @@ elsif ($mode eq "client") {
             &generate_acl($call, $call->{acl}, "Ensure");
             if (defined $call->{aclfilter}) {
                 &generate_acl($call, $call->{aclfilter}, "Check");
+                &generate_acl_batch($call, $call->{aclfilter});
             }
         }
 
+        # Filters on domains also come in a variant checking a whole
+        # list of them at once, see virAccessManagerCheckDomains
+        sub generate_acl_batch {
+            my $call = shift;
+            my $acl = shift;
+
+            my @perms;
+            foreach (@{$acl}) {
+                my @bits = split /:/;
+                return if $bits[0] ne "domain" || defined $bits[2];
+                my $perm = "vir_access_perm_domain_" . $bits[1];
+                $perm =~ tr/a-z/A-Z/;
+                push @perms, $perm;
+            }
+
+            my $apiname = $prefix . $call->{ProcName};
+            if ($structprefix eq "qemu") {
+                $apiname =~ s/(vir(Connect)?Domain)/${1}Qemu/;
+            } elsif ($structprefix eq "lxc") {
+                $apiname =~ s/virDomain/virDomainLxc/;
+            }
+            $apiname .= "CheckACLBatch";
+
+            my @argdecls = ("$connect_ptr conn",
+                            "virDomainDefPtr *domains",
+                            "size_t ndomains",
+                            "virBitmapPtr allowed");
+
+            if ($mode eq "aclheader") {
+                print "extern void $apiname(" . join(", ", @argdecls) . ");\n";
+                return;
+            }
+
+            print "/* Clears the bits of \@allowed of the domains denied access */\n";
+            print "void $apiname(" . join(", ", @argdecls) . ")\n";
+            print "{\n";
+            print "    virAccessManagerPtr mgr;\n";
+            print "\n";
+            print "    if (!(mgr = virAccessManagerGetDefault())) {\n";
+            print "        virResetLastError();\n";
+            print "        virBitmapClearAll(allowed);\n";
+            print "        return;\n";
+            print "    }\n";
+            print "\n";
+
+            foreach my $perm (@perms) {
+                print "    if (virAccessManagerCheckDomains(mgr, conn->driver->name,\n";
+                print "                                     domains, ndomains,\n";
+                print "                                     $perm, allowed) < 0) {\n";
+                print "        virResetLastError();\n";
+                print "        virBitmapClearAll(allowed);\n";
+                print "    }\n";
+            }
+
+            print "    virObjectUnref(mgr);\n";
+            print "}\n\n";
+        }
+
         sub generate_acl {
             my $call = shift;
             my $acl = shift;
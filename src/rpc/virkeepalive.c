@@ -42,7 +42,13 @@ struct _virKeepAlive {
     unsigned int countToDeath;
     time_t lastPacketReceived;
     time_t intervalStart;
-    int timer;
+    bool running;
+
+    /* Position in the timer wheel, protected by virKeepAliveWheelLock */
+    time_t deadline;
+    int wheelSlot;
+    virKeepAlivePtr wheelPrev;
+    virKeepAlivePtr wheelNext;
 
     virKeepAliveSendFunc sendCB;
     virKeepAliveDeadFunc deadCB;
@@ -51,14 +57,66 @@ struct _virKeepAlive {
 };
 
 
+
+/*
+ * All keepalives of a process are driven by a single event loop timer
+ * ticking once a second rather than by a timer each, which matters for
+ * daemons with thousands of clients. The keepalives waiting for their
+ * next check are kept in a hashed timing wheel with a slot per second:
+ * a tick only looks at the slots of the seconds which passed since the
+ * previous one, leaving the keepalives due in a later round of the
+ * wheel where they are. Receiving a message just moves intervalStart
+ * forward; the keepalive is moved to its new slot lazily once its old
+ * one comes up.
+ */
+#define VIR_KEEPALIVE_WHEEL_SLOTS 64
+
+static virMutex virKeepAliveWheelLock = VIR_MUTEX_INITIALIZER;
+static virKeepAlivePtr virKeepAliveWheel[VIR_KEEPALIVE_WHEEL_SLOTS];
+static size_t virKeepAliveWheelCount;
+static time_t virKeepAliveWheelLast;
+static int virKeepAliveWheelTimer = -1;
+
+/* Keepalive messages have no payload, so they are encoded only once */
+static virNetMessagePtr virKeepAlivePing;
+static virNetMessagePtr virKeepAlivePong;
+
 static virClassPtr virKeepAliveClass;
 static void virKeepAliveDispose(void *obj);
 
+
+static virNetMessagePtr
+virKeepAliveEncode(int proc)
+{
+    virNetMessagePtr msg;
+
+    if (!(msg = virNetMessageNew(false)))
+        return NULL;
+
+    msg->header.prog = KEEPALIVE_PROGRAM;
+    msg->header.vers = KEEPALIVE_PROTOCOL_VERSION;
+    msg->header.type = VIR_NET_MESSAGE;
+    msg->header.proc = proc;
+
+    if (virNetMessageEncodeHeader(msg) < 0 ||
+        virNetMessageEncodePayloadEmpty(msg) < 0) {
+        virNetMessageFree(msg);
+        return NULL;
+    }
+
+    return msg;
+}
+
+
 static int virKeepAliveOnceInit(void)
 {
     if (!VIR_CLASS_NEW(virKeepAlive, virClassForObjectLockable()))
         return -1;
 
+    if (!(virKeepAlivePing = virKeepAliveEncode(KEEPALIVE_PROC_PING)) ||
+        !(virKeepAlivePong = virKeepAliveEncode(KEEPALIVE_PROC_PONG)))
+        return -1;
+
     return 0;
 }
 
@@ -68,14 +126,17 @@ static virNetMessagePtr
 virKeepAliveMessage(virKeepAlivePtr ka, int proc)
 {
     virNetMessagePtr msg;
+    virNetMessagePtr tmpl = NULL;
     const char *procstr = NULL;
 
     switch (proc) {
     case KEEPALIVE_PROC_PING:
         procstr = "request";
+        tmpl = virKeepAlivePing;
         break;
     case KEEPALIVE_PROC_PONG:
         procstr = "response";
+        tmpl = virKeepAlivePong;
         break;
     default:
         VIR_WARN("Refusing to send unknown keepalive message: %d", proc);
@@ -85,16 +146,11 @@ virKeepAliveMessage(virKeepAlivePtr ka, int proc)
     if (!(msg = virNetMessageNew(false)))
         goto error;
 
-    msg->header.prog = KEEPALIVE_PROGRAM;
-    msg->header.vers = KEEPALIVE_PROTOCOL_VERSION;
-    msg->header.type = VIR_NET_MESSAGE;
-    msg->header.proc = proc;
-
-    if (virNetMessageEncodeHeader(msg) < 0 ||
-        virNetMessageEncodePayloadEmpty(msg) < 0) {
-        virNetMessageFree(msg);
-        goto error;
-    }
+    msg->header = tmpl->header;
+    virNetMessageReserve(msg, tmpl->bufferLength);
+    memcpy(msg->buffer, tmpl->buffer, tmpl->bufferLength);
+    msg->bufferLength = tmpl->bufferLength;
+    msg->bufferOffset = 0;
 
     VIR_DEBUG("Sending keepalive %s to client %p", procstr, ka->client);
     PROBE(RPC_KEEPALIVE_SEND,
@@ -109,6 +165,70 @@ virKeepAliveMessage(virKeepAlivePtr ka, int proc)
 }
 
 
+static void virKeepAliveWheelTick(int timer, void *opaque);
+
+
+/* Must be called with virKeepAliveWheelLock held */
+static void
+virKeepAliveWheelUnlink(virKeepAlivePtr ka)
+{
+    if (ka->wheelSlot < 0)
+        return;
+
+    if (ka->wheelPrev)
+        ka->wheelPrev->wheelNext = ka->wheelNext;
+    else
+        virKeepAliveWheel[ka->wheelSlot] = ka->wheelNext;
+    if (ka->wheelNext)
+        ka->wheelNext->wheelPrev = ka->wheelPrev;
+
+    ka->wheelPrev = ka->wheelNext = NULL;
+    ka->wheelSlot = -1;
+
+    if (--virKeepAliveWheelCount == 0)
+        virEventUpdateTimeout(virKeepAliveWheelTimer, -1);
+}
+
+
+/*
+ * Makes the wheel check @ka at @deadline, or on the next tick if that
+ * second has already been dealt with. Must be called with @ka locked.
+ */
+static int
+virKeepAliveSchedule(virKeepAlivePtr ka,
+                     time_t deadline)
+{
+    int ret = -1;
+
+    virMutexLock(&virKeepAliveWheelLock);
+
+    if (virKeepAliveWheelTimer < 0 &&
+        (virKeepAliveWheelTimer = virEventAddTimeout(-1, virKeepAliveWheelTick,
+                                                     NULL, NULL)) < 0)
+        goto cleanup;
+
+    virKeepAliveWheelUnlink(ka);
+
+    if (virKeepAliveWheelCount == 0) {
+        virKeepAliveWheelLast = time(NULL) - 1;
+        virEventUpdateTimeout(virKeepAliveWheelTimer, 1000);
+    }
+
+    ka->deadline = MAX(deadline, virKeepAliveWheelLast + 1);
+    ka->wheelSlot = ka->deadline % VIR_KEEPALIVE_WHEEL_SLOTS;
+    ka->wheelNext = virKeepAliveWheel[ka->wheelSlot];
+    if (ka->wheelNext)
+        ka->wheelNext->wheelPrev = ka;
+    virKeepAliveWheel[ka->wheelSlot] = ka;
+    virKeepAliveWheelCount++;
+    ret = 0;
+
+ cleanup:
+    virMutexUnlock(&virKeepAliveWheelLock);
+    return ret;
+}
+
+
 static bool
 virKeepAliveTimerInternal(virKeepAlivePtr ka,
                           virNetMessagePtr *msg)
@@ -120,8 +240,9 @@ virKeepAliveTimerInternal(virKeepAlivePtr ka,
         return false;
 
     if (now - ka->intervalStart < ka->interval) {
-        timeval = ka->interval - (now - ka->intervalStart);
-        virEventUpdateTimeout(ka->timer, timeval * 1000);
+        if (ka->running)
+            ignore_value(virKeepAliveSchedule(ka, ka->intervalStart +
+                                                  ka->interval));
         return false;
     }
 
@@ -136,35 +257,41 @@ virKeepAliveTimerInternal(virKeepAlivePtr ka,
                   ka->client, ka->count, timeval);
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("connection closed due to keepalive timeout"));
+        if (ka->running)
+            ignore_value(virKeepAliveSchedule(ka, now + ka->interval));
         return true;
     } else {
         ka->countToDeath--;
         ka->intervalStart = now;
         *msg = virKeepAliveMessage(ka, KEEPALIVE_PROC_PING);
-        virEventUpdateTimeout(ka->timer, ka->interval * 1000);
+        if (ka->running)
+            ignore_value(virKeepAliveSchedule(ka, now + ka->interval));
         return false;
     }
 }
 
 
 static void
-virKeepAliveTimer(int timer G_GNUC_UNUSED, void *opaque)
+virKeepAliveTimer(virKeepAlivePtr ka)
 {
-    virKeepAlivePtr ka = opaque;
     virNetMessagePtr msg = NULL;
     bool dead;
     void *client;
 
-    virObjectRef(ka);
     virObjectLock(ka);
 
+    if (!ka->running) {
+        virObjectUnlock(ka);
+        return;
+    }
+
     client = ka->client;
     dead = virKeepAliveTimerInternal(ka, &msg);
 
     virObjectUnlock(ka);
 
     if (!dead && !msg)
-        goto cleanup;
+        return;
 
     if (dead) {
         ka->deadCB(client);
@@ -172,9 +299,56 @@ virKeepAliveTimer(int timer G_GNUC_UNUSED, void *opaque)
         VIR_WARN("Failed to send keepalive request to client %p", client);
         virNetMessageFree(msg);
     }
+}
 
- cleanup:
-    virObjectUnref(ka);
+
+static void
+virKeepAliveWheelTick(int timer G_GNUC_UNUSED,
+                      void *opaque G_GNUC_UNUSED)
+{
+    g_autofree virKeepAlivePtr *due = NULL;
+    size_t ndue = 0;
+    size_t ticks;
+    time_t now = time(NULL);
+    size_t i;
+
+    virMutexLock(&virKeepAliveWheelLock);
+
+    /* With the clock going backwards nothing is due until it catches up,
+     * with more than a round of the wheel missed every slot is */
+    if (now <= virKeepAliveWheelLast)
+        ticks = 0;
+    else
+        ticks = MIN(now - virKeepAliveWheelLast, VIR_KEEPALIVE_WHEEL_SLOTS);
+
+    for (i = 0; i < ticks; i++) {
+        int slot = (now - i) % VIR_KEEPALIVE_WHEEL_SLOTS;
+        virKeepAlivePtr ka = virKeepAliveWheel[slot];
+
+        while (ka) {
+            virKeepAlivePtr next = ka->wheelNext;
+
+            if (ka->deadline <= now) {
+                virKeepAliveWheelUnlink(ka);
+                virObjectRef(ka);
+                ignore_value(VIR_APPEND_ELEMENT(due, ndue, ka));
+            }
+            ka = next;
+        }
+    }
+
+    if (now > virKeepAliveWheelLast)
+        virKeepAliveWheelLast = now;
+
+    virMutexUnlock(&virKeepAliveWheelLock);
+
+    if (ndue > 0)
+        VIR_DEBUG("Checking %zu keepalives", ndue);
+
+    for (i = 0; i < ndue; i++) {
+        virKeepAliveTimer(due[i]);
+        virObjectUnref(due[i]);
+    }
 }
 
 
@@ -199,7 +373,7 @@ virKeepAliveNew(int interval,
     ka->interval = interval;
     ka->count = count;
     ka->countToDeath = count;
-    ka->timer = -1;
+    ka->wheelSlot = -1;
     ka->client = client;
     ka->sendCB = sendCB;
     ka->deadCB = deadCB;
@@ -237,7 +411,7 @@ virKeepAliveStart(virKeepAlivePtr ka,
 
     virObjectLock(ka);
 
-    if (ka->timer >= 0) {
+    if (ka->running) {
         VIR_DEBUG("Keepalive messages already enabled");
         ret = 0;
         goto cleanup;
@@ -277,13 +451,12 @@ virKeepAliveStart(virKeepAlivePtr ka,
     else
         timeout = ka->interval - delay;
     ka->intervalStart = now - (ka->interval - timeout);
-    ka->timer = virEventAddTimeout(timeout * 1000, virKeepAliveTimer,
-                                   ka, virObjectFreeCallback);
-    if (ka->timer < 0)
+    if (virKeepAliveSchedule(ka, now + timeout) < 0)
         goto cleanup;
 
-    /* the timer now has another reference to this object */
+    /* the wheel now has another reference to this object */
     virObjectRef(ka);
+    ka->running = true;
     ret = 0;
 
  cleanup:
@@ -295,18 +468,25 @@ virKeepAliveStart(virKeepAlivePtr ka,
 void
 virKeepAliveStop(virKeepAlivePtr ka)
 {
+    bool running;
+
     virObjectLock(ka);
 
     PROBE(RPC_KEEPALIVE_STOP,
           "ka=%p client=%p",
           ka, ka->client);
 
-    if (ka->timer > 0) {
-        virEventRemoveTimeout(ka->timer);
-        ka->timer = -1;
+    if ((running = ka->running)) {
+        virMutexLock(&virKeepAliveWheelLock);
+        virKeepAliveWheelUnlink(ka);
+        virMutexUnlock(&virKeepAliveWheelLock);
+        ka->running = false;
     }
 
     virObjectUnlock(ka);
+
+    if (running)
+        virObjectUnref(ka);
 }
 
 
@@ -401,9 +581,6 @@ virKeepAliveCheckMessage(virKeepAlivePtr ka,
         }
     }
 
-    if (ka->timer >= 0)
-        virEventUpdateTimeout(ka->timer, ka->interval * 1000);
-
     virObjectUnlock(ka);
 
     return ret;
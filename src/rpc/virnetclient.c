@@ -41,6 +41,9 @@
 
 VIR_LOG_INIT("rpc.netclient");
 
+/* Covers a call in flight and a stream packet or two */
+#define VIR_NET_CLIENT_MESSAGE_POOL_MAX 4
+
 typedef struct _virNetClientCall virNetClientCall;
 typedef virNetClientCall *virNetClientCallPtr;
 
@@ -57,6 +60,13 @@ struct _virNetClientCall {
     bool expectReply;
     bool nonBlock;
     bool haveThread;
+    /* The thread waits for asynchronous calls rather than a reply */
+    bool waitAsync;
+
+    /* Asynchronous calls have no thread, @asyncCb is run instead */
+    virNetClientAsyncFunc asyncCb;
+    void *asyncOpaque;
+    virErrorPtr asyncError;
 
     virCond cond;
 
@@ -69,6 +79,8 @@ struct _virNetClient {
 
     virNetSocketPtr sock;
     bool asyncIO;
+    /* Whether the server agreed on compressed payloads */
+    bool compress;
 
     virNetTLSSessionPtr tls;
     char *hostname;
@@ -76,7 +88,8 @@ struct _virNetClient {
     virNetClientProgramPtr *programs;
     size_t nprograms;
 
-    /* For incoming message packets */
+    /* For incoming message packets, its pool backs
+     * the outgoing ones too */
     virNetMessage msg;
 
 #if WITH_SASL
@@ -96,6 +109,15 @@ struct _virNetClient {
     /* True if a thread holds the buck */
     bool haveTheBuck;
 
+    /* Asynchronous calls which finished and whose callbacks
+     * are run once the client lock is released */
+    virNetClientCallPtr asyncDone;
+    /* Asynchronous calls in waitDispatch */
+    size_t asyncQueued;
+    /* Asynchronous calls whose callback did not return yet */
+    size_t asyncPending;
+    virCond asyncCond;
+
     size_t nstreams;
     virNetClientStreamPtr *streams;
 
@@ -129,6 +151,10 @@ static int virNetClientQueueNonBlocking(virNetClientPtr client,
                                         virNetMessagePtr msg);
 static void virNetClientCloseInternal(virNetClientPtr client,
                                       int reason);
+static void virNetClientAsyncCollect(virNetClientPtr client,
+                                     virNetClientCallPtr thiscall,
+                                     bool failAll);
+static void virNetClientUnlock(virNetClientPtr client);
 
 
 void virNetClientSetCloseCallback(virNetClientPtr client,
@@ -144,6 +170,19 @@ void virNetClientSetCloseCallback(virNetClientPtr client,
 }
 
 
+/*
+ * Makes @client compress large payloads of the messages it sends from
+ * now on. Compressed messages from the server are accepted regardless.
+ */
+void virNetClientSetCompression(virNetClientPtr client,
+                                bool compress)
+{
+    virObjectLock(client);
+    client->compress = compress;
+    virObjectUnlock(client);
+}
+
+
 static void virNetClientIncomingEvent(virNetSocketPtr sock,
                                       int events,
                                       void *opaque);
@@ -300,9 +339,18 @@ static virNetClientPtr virNetClientNew(virNetSocketPtr sock,
     if (!(client = virObjectLockableNew(virNetClientClass)))
         goto error;
 
+    if (virCondInit(&client->asyncCond) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize condition variable"));
+        goto error;
+    }
+
     client->sock = sock;
     sock = NULL;
 
+    if (!(client->msg.pool = virNetMessagePoolNew(VIR_NET_CLIENT_MESSAGE_POOL_MAX)))
+        goto error;
+
     client->eventCtx = g_main_context_new();
     client->eventLoop = g_main_loop_new(client->eventCtx, FALSE);
 
@@ -701,7 +749,21 @@ void virNetClientDispose(void *obj)
     virObjectUnref(client->sasl);
 #endif
 
-    virNetMessageClear(&client->msg);
+    virNetMessageClearPayload(&client->msg);
+    virObjectUnref(client->msg.pool);
+
+    virCondDestroy(&client->asyncCond);
+}
+
+
+/*
+ * Creates an outgoing message for @client, reusing memory of its
+ * earlier messages.
+ */
+virNetMessagePtr
+virNetClientNewMessage(virNetClientPtr client)
+{
+    return virNetMessageNewPooled(client->msg.pool, false);
 }
 
 
@@ -796,7 +858,7 @@ static void virNetClientCloseInternal(virNetClientPtr client,
         virNetClientIOEventLoopPassTheBuck(client, NULL);
     }
 
-    virObjectUnlock(client);
+    virNetClientUnlock(client);
 }
 
 
@@ -1101,9 +1163,7 @@ virNetClientCallDispatchReply(virNetClientPtr client)
         return -1;
     }
 
-    if (VIR_REALLOC_N(thecall->msg->buffer, client->msg.bufferLength) < 0)
-        return -1;
-
+    virNetMessageReserve(thecall->msg, client->msg.bufferLength);
     memcpy(thecall->msg->buffer, client->msg.buffer, client->msg.bufferLength);
     memcpy(&thecall->msg->header, &client->msg.header, sizeof(client->msg.header));
     thecall->msg->bufferLength = client->msg.bufferLength;
@@ -1302,13 +1362,36 @@ virNetClientIOWriteMessage(virNetClientPtr client,
     ssize_t ret = 0;
 
     if (thecall->msg->bufferOffset < thecall->msg->bufferLength) {
-        ret = virNetSocketWrite(client->sock,
-                                thecall->msg->buffer + thecall->msg->bufferOffset,
-                                thecall->msg->bufferLength - thecall->msg->bufferOffset);
+        GOutputVector vec[VIR_NET_SOCKET_IOV_MAX];
+        virNetClientCallPtr call;
+        size_t nvec = 0;
+        ssize_t left;
+
+        /* Send the calls queued behind this one along, up to the first
+         * one which passes FDs as those have to follow its data */
+        for (call = thecall; call && nvec < G_N_ELEMENTS(vec); call = call->next) {
+            if (call->mode != VIR_NET_CLIENT_MODE_WAIT_TX ||
+                call->msg->bufferOffset >= call->msg->bufferLength)
+                break;
+
+            vec[nvec].buffer = call->msg->buffer + call->msg->bufferOffset;
+            vec[nvec].size = call->msg->bufferLength - call->msg->bufferOffset;
+            nvec++;
+
+            if (call->msg->nfds)
+                break;
+        }
+
+        ret = virNetSocketWritev(client->sock, vec, nvec);
         if (ret <= 0)
             return ret;
 
-        thecall->msg->bufferOffset += ret;
+        for (call = thecall, left = ret; call && left > 0; call = call->next) {
+            size_t n = MIN(left, call->msg->bufferLength - call->msg->bufferOffset);
+
+            call->msg->bufferOffset += n;
+            left -= n;
+        }
     }
 
     if (thecall->msg->bufferOffset == thecall->msg->bufferLength) {
@@ -1370,8 +1453,7 @@ virNetClientIOReadMessage(virNetClientPtr client)
     /* Start by reading length word */
     if (client->msg.bufferLength == 0) {
         client->msg.bufferLength = 4;
-        if (VIR_ALLOC_N(client->msg.buffer, client->msg.bufferLength) < 0)
-            return -ENOMEM;
+        virNetMessageReserve(&client->msg, client->msg.bufferLength);
     }
 
     wantData = client->msg.bufferLength - client->msg.bufferOffset;
@@ -1552,6 +1634,130 @@ virNetClientIOEventLoopRemoveAll(virNetClientCallPtr call,
 }
 
 
+struct virNetClientAsyncCollectData {
+    virNetClientPtr client;
+    virNetClientCallPtr thiscall;
+    bool failAll;
+};
+
+static bool
+virNetClientAsyncCollectOne(virNetClientCallPtr call,
+                            void *opaque)
+{
+    struct virNetClientAsyncCollectData *data = opaque;
+    virNetClientPtr client = data->client;
+
+    if (call == data->thiscall || !call->asyncCb)
+        return false;
+
+    if (call->mode != VIR_NET_CLIENT_MODE_COMPLETE) {
+        if (!data->failAll)
+            return false;
+        if (client->error)
+            call->asyncError = virErrorCopyNew(client->error);
+    }
+
+    VIR_DEBUG("Asynchronous call %p finished", call);
+    virNetClientCallQueue(&client->asyncDone, call);
+    client->asyncQueued--;
+    return true;
+}
+
+
+static bool
+virNetClientAsyncWakeWaiter(virNetClientCallPtr call,
+                            void *opaque)
+{
+    virNetClientCallPtr thiscall = opaque;
+
+    if (call != thiscall && call->waitAsync)
+        call->mode = VIR_NET_CLIENT_MODE_COMPLETE;
+
+    return false;
+}
+
+
+/*
+ * Moves finished asynchronous calls other than @thiscall from the
+ * dispatch list to client->asyncDone, their callbacks are run by
+ * virNetClientUnlock. With @failAll, calls which are still waiting
+ * are finished as failed. Threads waiting for asynchronous calls
+ * are then completed if none is left in the list.
+ */
+static void
+virNetClientAsyncCollect(virNetClientPtr client,
+                         virNetClientCallPtr thiscall,
+                         bool failAll)
+{
+    struct virNetClientAsyncCollectData data = { client, thiscall, failAll };
+
+    if (client->asyncQueued == 0)
+        return;
+
+    virNetClientCallRemovePredicate(&client->waitDispatch,
+                                    virNetClientAsyncCollectOne,
+                                    &data);
+
+    if (client->asyncQueued == 0)
+        virNetClientCallMatchPredicate(client->waitDispatch,
+                                       virNetClientAsyncWakeWaiter,
+                                       thiscall);
+}
+
+
+/*
+ * Releases the client lock and runs the callbacks of asynchronous
+ * calls which finished meanwhile. Callbacks are thus never run with
+ * the client locked and are free to submit further calls.
+ */
+static void
+virNetClientUnlock(virNetClientPtr client)
+{
+    virNetClientCallPtr call = client->asyncDone;
+
+    client->asyncDone = NULL;
+    virObjectUnlock(client);
+
+    while (call) {
+        virNetClientCallPtr next = call->next;
+        virErrorPtr orig = NULL;
+        int status = 0;
+
+        call->next = NULL;
+
+        if (call->mode != VIR_NET_CLIENT_MODE_COMPLETE) {
+            status = -1;
+            virErrorPreserveLast(&orig);
+            if (call->asyncError)
+                virErrorRestore(&call->asyncError);
+            else
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("client socket is closed"));
+        }
+
+        call->asyncCb(client, call->msg, status, call->asyncOpaque);
+
+        if (status < 0) {
+            if (orig)
+                virErrorRestore(&orig);
+            else
+                virResetLastError();
+        }
+
+        virCondDestroy(&call->cond);
+        VIR_FREE(call);
+
+        virObjectLock(client);
+        if (--client->asyncPending == 0)
+            virCondBroadcast(&client->asyncCond);
+        virObjectUnlock(client);
+        virObjectUnref(client);
+
+        call = next;
+    }
+}
+
+
 static void
 virNetClientIOEventLoopPassTheBuck(virNetClientPtr client,
                                    virNetClientCallPtr thiscall)
@@ -1572,6 +1778,7 @@ virNetClientIOEventLoopPassTheBuck(virNetClientPtr client,
 
     VIR_DEBUG("No thread to pass the buck to");
     if (client->wantClose) {
+        virNetClientAsyncCollect(client, thiscall, true);
         virNetClientCloseLocked(client);
         virNetClientCallRemovePredicate(&client->waitDispatch,
                                         virNetClientIOEventLoopRemoveAll,
@@ -1623,6 +1830,13 @@ static int virNetClientIOEventLoop(virNetClientPtr client,
             .rev = 0,
         };
 
+        /* Nothing left to wait for */
+        if (thiscall->waitAsync && client->asyncQueued == 0) {
+            virNetClientCallRemove(&client->waitDispatch, thiscall);
+            virNetClientIOEventLoopPassTheBuck(client, thiscall);
+            return 0;
+        }
+
         /* If we have existing SASL decoded data we don't want to sleep in
          * the poll(), just check if any other FDs are also ready.
          * If the connection is going to be closed, we don't want to sleep in
@@ -1729,6 +1943,7 @@ static int virNetClientIOEventLoop(virNetClientPtr client,
         /* Iterate through waiting calls and if any are
          * complete, remove them from the dispatch list.
          */
+        virNetClientAsyncCollect(client, thiscall, false);
         virNetClientCallRemovePredicate(&client->waitDispatch,
                                         virNetClientIOEventLoopRemoveDone,
                                         thiscall);
@@ -1854,6 +2069,10 @@ static void virNetClientIOUpdateCallback(virNetClientPtr client,
  *   - 0 or 1  waitDispatch.nonBlock == false, without any threads
  *   - 0 or more waitDispatch.nonBlock == false, with threads
  *
+ * In addition to that, any number of asynchronous calls, which are
+ * both nonBlock and expecting a reply, can be waiting without a thread
+ * in any of the states.
+ *
  * The following output states are valid when all threads are done
  *
  *   - waitDispatch == NULL,
@@ -2000,6 +2219,7 @@ void virNetClientIncomingEvent(virNetSocketPtr sock,
     }
 
     /* Remove completed calls or signal their threads. */
+    virNetClientAsyncCollect(client, NULL, false);
     virNetClientCallRemovePredicate(&client->waitDispatch,
                                     virNetClientIOEventLoopRemoveDone,
                                     NULL);
@@ -2007,12 +2227,13 @@ void virNetClientIncomingEvent(virNetSocketPtr sock,
 
  done:
     if (client->wantClose && !client->haveTheBuck) {
+        virNetClientAsyncCollect(client, NULL, true);
         virNetClientCloseLocked(client);
         virNetClientCallRemovePredicate(&client->waitDispatch,
                                         virNetClientIOEventLoopRemoveAll,
                                         NULL);
     }
-    virObjectUnlock(client);
+    virNetClientUnlock(client);
 }
 
 
@@ -2113,6 +2334,10 @@ static int virNetClientSendInternal(virNetClientPtr client,
         return -1;
     }
 
+    if (client->compress &&
+        virNetMessageCompress(msg) < 0)
+        return -1;
+
     if (!(call = virNetClientCallNew(msg, expectReply, nonBlock)))
         return -1;
 
@@ -2146,7 +2371,7 @@ int virNetClientSendWithReply(virNetClientPtr client,
     int ret;
     virObjectLock(client);
     ret = virNetClientSendInternal(client, msg, true, false);
-    virObjectUnlock(client);
+    virNetClientUnlock(client);
     if (ret < 0)
         return -1;
     return 0;
@@ -2170,7 +2395,7 @@ int virNetClientSendNonBlock(virNetClientPtr client,
     int ret;
     virObjectLock(client);
     ret = virNetClientSendInternal(client, msg, false, true);
-    virObjectUnlock(client);
+    virNetClientUnlock(client);
     return ret;
 }
 
@@ -2213,7 +2438,175 @@ int virNetClientSendStream(virNetClientPtr client,
     ret = 0;
 
  cleanup:
-    virObjectUnlock(client);
+    virNetClientUnlock(client);
+
+    return ret;
+}
+
+
+/*
+ * @msg: a message allocated on the heap
+ * @cb: callback to run once the call finished
+ * @opaque: data for @cb
+ *
+ * Send a message expecting a reply without waiting for it. The reply
+ * is read by whichever thread is processing I/O on @client next, be it
+ * the event loop, another call or virNetClientWaitAsync, and passed to
+ * @cb in @msg. If the connection fails first, @cb is run with status
+ * -1 and the error set for the thread running it.
+ *
+ * Any number of calls can be in flight this way and @cb is always run
+ * with @client unlocked, so it can submit further calls.
+ *
+ * On success @msg is owned by @client until it is handed over to @cb
+ * which has to free it. Otherwise the caller keeps it.
+ *
+ * Returns 0 if the call was submitted and @cb will be run exactly once,
+ * -1 on error
+ */
+int virNetClientSendAsync(virNetClientPtr client,
+                          virNetMessagePtr msg,
+                          virNetClientAsyncFunc cb,
+                          void *opaque)
+{
+    virNetClientCallPtr call;
+    int rv;
+    int ret = -1;
+
+    virObjectLock(client);
+
+    PROBE(RPC_CLIENT_MSG_TX_QUEUE,
+          "client=%p len=%zu prog=%u vers=%u proc=%u type=%u status=%u serial=%u",
+          client, msg->bufferLength,
+          msg->header.prog, msg->header.vers, msg->header.proc,
+          msg->header.type, msg->header.status, msg->header.serial);
+
+    if (!client->sock || client->wantClose) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("client socket is closed"));
+        goto cleanup;
+    }
+
+    if (client->compress &&
+        virNetMessageCompress(msg) < 0)
+        goto cleanup;
+
+    if (!(call = virNetClientCallNew(msg, true, false)))
+        goto cleanup;
+
+    call->nonBlock = true;
+    call->haveThread = true;
+    call->asyncCb = cb;
+    call->asyncOpaque = opaque;
+
+    virObjectRef(client);
+    client->asyncQueued++;
+    client->asyncPending++;
+
+    rv = virNetClientIO(client, call);
 
+    if (rv != 1) {
+        /* The call is not in the dispatch list anymore */
+        client->asyncQueued--;
+
+        if (rv < 0) {
+            if (--client->asyncPending == 0)
+                virCondBroadcast(&client->asyncCond);
+            virCondDestroy(&call->cond);
+            VIR_FREE(call);
+            virObjectUnref(client);
+            goto cleanup;
+        }
+
+        /* The reply is here already */
+        virNetClientCallQueue(&client->asyncDone, call);
+    }
+
+    ret = 0;
+
+ cleanup:
+    virNetClientUnlock(client);
+    return ret;
+}
+
+
+/*
+ * Wait until all asynchronous calls submitted on @client finished and
+ * their callbacks returned. The calling thread processes I/O on @client
+ * meanwhile, unless another thread is doing so already.
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int virNetClientWaitAsync(virNetClientPtr client)
+{
+    virNetMessage msg;
+    bool failed = false;
+    int ret = -1;
+
+    memset(&msg, 0, sizeof(msg));
+
+    virObjectLock(client);
+
+    for (;;) {
+        virNetClientCallPtr call;
+        int rv;
+
+        /* Run callbacks of calls which we saw finish */
+        if (client->asyncDone) {
+            virNetClientUnlock(client);
+            virObjectLock(client);
+            continue;
+        }
+
+        if (client->asyncPending == 0)
+            break;
+
+        /* Nobody else is going to fail the calls */
+        if (client->asyncQueued > 0 && !client->haveTheBuck) {
+            if (client->wantClose) {
+                virNetClientIOEventLoopPassTheBuck(client, NULL);
+                continue;
+            }
+            if (!client->sock) {
+                virNetClientAsyncCollect(client, NULL, true);
+                continue;
+            }
+        }
+
+        if (client->asyncQueued == 0 || !client->sock || client->wantClose) {
+            /* Other threads are finishing the remaining calls */
+            if (virCondWait(&client->asyncCond, &client->parent.lock) < 0) {
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("failed to wait on condition"));
+                goto cleanup;
+            }
+            continue;
+        }
+
+        if (!(call = virNetClientCallNew(&msg, true, false)))
+            goto cleanup;
+
+        call->waitAsync = true;
+        call->haveThread = true;
+
+        rv = virNetClientIO(client, call);
+
+        virCondDestroy(&call->cond);
+        VIR_FREE(call);
+
+        if (rv < 0) {
+            /* Keep waiting for the calls to be failed if the connection
+             * is going away, the callbacks may refer to our caller */
+            if (client->sock && !client->wantClose)
+                goto cleanup;
+            failed = true;
+        }
+    }
+
+    if (!failed)
+        ret = 0;
+
+ cleanup:
+    virNetClientUnlock(client);
     return ret;
 }
@@ -89,7 +89,12 @@ void virNetClientSetCloseCallback(virNetClientPtr client,
                                   void *opaque,
                                   virFreeCallback ff);
 
+void virNetClientSetCompression(virNetClientPtr client,
+                                bool compress);
+
 int virNetClientGetFD(virNetClientPtr client);
+
+virNetMessagePtr virNetClientNewMessage(virNetClientPtr client);
 int virNetClientDupFD(virNetClientPtr client, bool cloexec);
 
 bool virNetClientHasPassFD(virNetClientPtr client);
@@ -113,6 +118,18 @@ int virNetClientSendStream(virNetClientPtr client,
                            virNetMessagePtr msg,
                            virNetClientStreamPtr st);
 
+typedef void (*virNetClientAsyncFunc)(virNetClientPtr client,
+                                      virNetMessagePtr msg,
+                                      int status,
+                                      void *opaque);
+
+int virNetClientSendAsync(virNetClientPtr client,
+                          virNetMessagePtr msg,
+                          virNetClientAsyncFunc cb,
+                          void *opaque);
+
+int virNetClientWaitAsync(virNetClientPtr client);
+
 #ifdef WITH_SASL
 void virNetClientSetSASLSession(virNetClientPtr client,
                                 virNetSASLSessionPtr sasl);
@@ -263,27 +263,20 @@ int virNetClientProgramDispatch(virNetClientProgramPtr prog,
 }
 
 
-int virNetClientProgramCall(virNetClientProgramPtr prog,
-                            virNetClientPtr client,
-                            unsigned serial,
-                            int proc,
-                            size_t noutfds,
-                            int *outfds,
-                            size_t *ninfds,
-                            int **infds,
-                            xdrproc_t args_filter, void *args,
-                            xdrproc_t ret_filter, void *ret)
+static virNetMessagePtr
+virNetClientProgramNewCall(virNetClientProgramPtr prog,
+                           virNetClientPtr client,
+                           unsigned serial,
+                           int proc,
+                           size_t noutfds,
+                           int *outfds,
+                           xdrproc_t args_filter, void *args)
 {
     virNetMessagePtr msg;
     size_t i;
 
-    if (infds)
-        *infds = NULL;
-    if (ninfds)
-        *ninfds = 0;
-
-    if (!(msg = virNetMessageNew(false)))
-        return -1;
+    if (!(msg = virNetClientNewMessage(client)))
+        return NULL;
 
     msg->header.prog = prog->program;
     msg->header.vers = prog->version;
@@ -321,9 +314,21 @@ int virNetClientProgramCall(virNetClientProgramPtr prog,
     if (virNetMessageEncodePayload(msg, args_filter, args) < 0)
         goto error;
 
-    if (virNetClientSendWithReply(client, msg) < 0)
-        goto error;
+    return msg;
+
+ error:
+    virNetMessageFree(msg);
+    return NULL;
+}
+
 
+/* Returns 0 if @msg is a successful reply to the call, -1 otherwise */
+static int
+virNetClientProgramCheckReply(virNetClientProgramPtr prog,
+                              virNetMessagePtr msg,
+                              unsigned serial,
+                              int proc)
+{
     /* None of these 3 should ever happen here, because
      * virNetClientSend should have validated the reply,
      * but it doesn't hurt to check again.
@@ -332,59 +337,92 @@ int virNetClientProgramCall(virNetClientProgramPtr prog,
         msg->header.type != VIR_NET_REPLY_WITH_FDS) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Unexpected message type %d"), msg->header.type);
-        goto error;
+        return -1;
     }
     if (msg->header.proc != proc) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Unexpected message proc %d != %d"),
                        msg->header.proc, proc);
-        goto error;
+        return -1;
     }
     if (msg->header.serial != serial) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Unexpected message serial %d != %d"),
                        msg->header.serial, serial);
-        goto error;
+        return -1;
     }
 
     switch (msg->header.status) {
     case VIR_NET_OK:
-        if (infds && ninfds) {
-            *ninfds = msg->nfds;
-            if (VIR_ALLOC_N(*infds, *ninfds) < 0)
-                goto error;
-            for (i = 0; i < *ninfds; i++)
-                (*infds)[i] = -1;
-            for (i = 0; i < *ninfds; i++) {
-                if (((*infds)[i] = dup(msg->fds[i])) < 0) {
-                    virReportSystemError(errno,
-                                         _("Cannot duplicate FD %d"),
-                                         msg->fds[i]);
-                    goto error;
-                }
-                if (virSetInherit((*infds)[i], false) < 0) {
-                    virReportSystemError(errno,
-                                         _("Cannot set close-on-exec %d"),
-                                         (*infds)[i]);
-                    goto error;
-                }
-            }
-
-        }
-        if (virNetMessageDecodePayload(msg, ret_filter, ret) < 0)
-            goto error;
-        break;
+        return 0;
 
     case VIR_NET_ERROR:
         virNetClientProgramDispatchError(prog, msg);
-        goto error;
+        return -1;
 
     case VIR_NET_CONTINUE:
     default:
         virReportError(VIR_ERR_RPC,
                        _("Unexpected message status %d"), msg->header.status);
+        return -1;
+    }
+}
+
+
+int virNetClientProgramCall(virNetClientProgramPtr prog,
+                            virNetClientPtr client,
+                            unsigned serial,
+                            int proc,
+                            size_t noutfds,
+                            int *outfds,
+                            size_t *ninfds,
+                            int **infds,
+                            xdrproc_t args_filter, void *args,
+                            xdrproc_t ret_filter, void *ret)
+{
+    virNetMessagePtr msg;
+    size_t i;
+
+    if (infds)
+        *infds = NULL;
+    if (ninfds)
+        *ninfds = 0;
+
+    if (!(msg = virNetClientProgramNewCall(prog, client, serial, proc,
+                                           noutfds, outfds,
+                                           args_filter, args)))
+        return -1;
+
+    if (virNetClientSendWithReply(client, msg) < 0)
+        goto error;
+
+    if (virNetClientProgramCheckReply(prog, msg, serial, proc) < 0)
         goto error;
+
+    if (infds && ninfds) {
+        *ninfds = msg->nfds;
+        if (VIR_ALLOC_N(*infds, *ninfds) < 0)
+            goto error;
+        for (i = 0; i < *ninfds; i++)
+            (*infds)[i] = -1;
+        for (i = 0; i < *ninfds; i++) {
+            if (((*infds)[i] = dup(msg->fds[i])) < 0) {
+                virReportSystemError(errno,
+                                     _("Cannot duplicate FD %d"),
+                                     msg->fds[i]);
+                goto error;
+            }
+            if (virSetInherit((*infds)[i], false) < 0) {
+                virReportSystemError(errno,
+                                     _("Cannot set close-on-exec %d"),
+                                     (*infds)[i]);
+                goto error;
+            }
+        }
+
     }
+    if (virNetMessageDecodePayload(msg, ret_filter, ret) < 0)
+        goto error;
 
     virNetMessageFree(msg);
 
@@ -398,3 +436,101 @@ int virNetClientProgramCall(virNetClientProgramPtr prog,
     }
     return -1;
 }
+
+
+typedef struct _virNetClientProgramAsyncCall virNetClientProgramAsyncCall;
+typedef virNetClientProgramAsyncCall *virNetClientProgramAsyncCallPtr;
+struct _virNetClientProgramAsyncCall {
+    virNetClientProgramPtr prog;
+    unsigned serial;
+    int proc;
+    xdrproc_t ret_filter;
+    void *ret;
+    virNetClientProgramCallFunc cb;
+    void *opaque;
+};
+
+
+static void
+virNetClientProgramAsyncDone(virNetClientPtr client,
+                             virNetMessagePtr msg,
+                             int status,
+                             void *opaque)
+{
+    virNetClientProgramAsyncCallPtr call = opaque;
+    int rv = -1;
+
+    if (status == 0 &&
+        virNetClientProgramCheckReply(call->prog, msg,
+                                      call->serial, call->proc) == 0 &&
+        virNetMessageDecodePayload(msg, call->ret_filter, call->ret) == 0)
+        rv = 0;
+
+    virNetMessageFree(msg);
+
+    call->cb(call->prog, client, rv, call->opaque);
+
+    virObjectUnref(call->prog);
+    VIR_FREE(call);
+}
+
+
+/**
+ * virNetClientProgramCallAsync:
+ * @prog: the program
+ * @client: the client
+ * @serial: serial number of the call
+ * @proc: procedure number
+ * @args_filter: XDR filter for @args
+ * @args: arguments of the call
+ * @ret_filter: XDR filter for @ret
+ * @ret: where to decode the reply to
+ * @cb: callback run once the call finished
+ * @opaque: data for @cb
+ *
+ * Submits a call without waiting for its reply. Once the reply
+ * arrived and was decoded into @ret, or the call failed, @cb is run
+ * with 0 or -1 respectively. In the latter case the error is set for
+ * the thread running @cb. @ret has to stay valid until then and the
+ * caller is responsible for freeing its contents afterwards.
+ *
+ * See virNetClientSendAsync for where @cb is run.
+ *
+ * Returns 0 if the call was submitted and @cb will be run exactly
+ * once, -1 on error
+ */
+int virNetClientProgramCallAsync(virNetClientProgramPtr prog,
+                                 virNetClientPtr client,
+                                 unsigned serial,
+                                 int proc,
+                                 xdrproc_t args_filter, void *args,
+                                 xdrproc_t ret_filter, void *ret,
+                                 virNetClientProgramCallFunc cb,
+                                 void *opaque)
+{
+    virNetClientProgramAsyncCallPtr call;
+    virNetMessagePtr msg;
+
+    if (!(msg = virNetClientProgramNewCall(prog, client, serial, proc,
+                                           0, NULL, args_filter, args)))
+        return -1;
+
+    call = g_new0(virNetClientProgramAsyncCall, 1);
+    call->prog = virObjectRef(prog);
+    call->serial = serial;
+    call->proc = proc;
+    call->ret_filter = ret_filter;
+    call->ret = ret;
+    call->cb = cb;
+    call->opaque = opaque;
+
+    if (virNetClientSendAsync(client, msg,
+                              virNetClientProgramAsyncDone, call) < 0) {
+        virObjectUnref(call->prog);
+        VIR_FREE(call);
+        virNetMessageFree(msg);
+        return -1;
+    }
+
+    return 0;
+}
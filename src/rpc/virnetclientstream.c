@@ -336,7 +336,7 @@ int virNetClientStreamQueuePacket(virNetClientStreamPtr st,
     /* Unfortunately, we must allocate new message as the one we
      * get in @msg is going to be cleared later in the process. */
 
-    if (!(tmp_msg = virNetMessageNew(false)))
+    if (!(tmp_msg = virNetMessageNewPooled(msg->pool, false)))
         return -1;
 
     /* Copy header */
@@ -346,8 +346,9 @@ int virNetClientStreamQueuePacket(virNetClientStreamPtr st,
     tmp_msg->buffer = msg->buffer;
     tmp_msg->bufferLength = msg->bufferLength;
     tmp_msg->bufferOffset = msg->bufferOffset;
+    tmp_msg->bufferSize = msg->bufferSize;
     msg->buffer = NULL;
-    msg->bufferLength = msg->bufferOffset = 0;
+    msg->bufferLength = msg->bufferOffset = msg->bufferSize = 0;
 
     virObjectLock(st);
 
@@ -371,7 +372,7 @@ int virNetClientStreamSendPacket(virNetClientStreamPtr st,
     virNetMessagePtr msg;
     VIR_DEBUG("st=%p status=%d data=%p nbytes=%zu", st, status, data, nbytes);
 
-    if (!(msg = virNetMessageNew(false)))
+    if (!(msg = virNetClientNewMessage(client)))
         return -1;
 
     virObjectLock(st);
@@ -385,6 +386,12 @@ int virNetClientStreamSendPacket(virNetClientStreamPtr st,
 
     virObjectUnlock(st);
 
+    /* Size the buffer for the whole packet up front, as the header
+     * alone would start with a smaller one */
+    if (status == VIR_NET_CONTINUE)
+        virNetMessageReserve(msg, VIR_NET_MESSAGE_LEN_MAX +
+                             VIR_NET_MESSAGE_HEADER_MAX + nbytes);
+
     if (virNetMessageEncodeHeader(msg) < 0)
         goto error;
 
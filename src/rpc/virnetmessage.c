@@ -21,6 +21,7 @@
 #include <config.h>
 
 #include <unistd.h>
+#include <gio/gio.h>
 
 #include "virnetmessage.h"
 #include "viralloc.h"
@@ -34,22 +35,405 @@
 
 VIR_LOG_INIT("rpc.netmessage");
 
+/*
+ * Size classes of the buffers kept on the free lists of a message pool.
+ * The first one is the rx buffer of a typical call, the second one is what
+ * virNetMessageEncodeHeader starts every reply with and the last one fits
+ * a legacy sized payload, such as a stream chunk.
+ */
+static const size_t virNetMessagePoolClasses[] = {
+    4096,
+    VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX,
+    VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX + VIR_NET_MESSAGE_HEADER_MAX +
+    VIR_NET_MESSAGE_LEN_MAX,
+};
+
+#define VIR_NET_MESSAGE_POOL_NCLASSES G_N_ELEMENTS(virNetMessagePoolClasses)
+#define VIR_NET_MESSAGE_POOL_BUFFER_MAX \
+    virNetMessagePoolClasses[VIR_NET_MESSAGE_POOL_NCLASSES - 1]
+
+/* Overlaid over the start of buffers sitting on a free list */
+typedef struct _virNetMessagePoolBuffer virNetMessagePoolBuffer;
+typedef virNetMessagePoolBuffer *virNetMessagePoolBufferPtr;
+struct _virNetMessagePoolBuffer {
+    virNetMessagePoolBufferPtr next;
+};
+
+struct _virNetMessagePool {
+    virObjectLockable parent;
+
+    /* Pool to get from and return to once own free lists are
+     * empty or full, respectively */
+    virNetMessagePoolPtr shared;
+
+    virNetMessagePtr msgs;
+    size_t nmsgs;
+    size_t nmsgs_max;
+
+    virNetMessagePoolBufferPtr buffers[VIR_NET_MESSAGE_POOL_NCLASSES];
+    size_t nbuffers[VIR_NET_MESSAGE_POOL_NCLASSES];
+    size_t nbuffers_max[VIR_NET_MESSAGE_POOL_NCLASSES];
+
+    virNetMessagePoolStats stats;
+};
+
+static virClassPtr virNetMessagePoolClass;
+static void virNetMessagePoolDispose(void *obj);
+
+static int virNetMessagePoolOnceInit(void)
+{
+    if (!VIR_CLASS_NEW(virNetMessagePool, virClassForObjectLockable()))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virNetMessagePool);
+
+
+/**
+ * virNetMessagePoolNew:
+ * @max: how many message structs to keep around
+ *
+ * Creates a pool with free lists of message structs and of buffers in
+ * a few size classes, so that messages created by virNetMessageNewPooled
+ * can reuse the memory of freed ones instead of going to the heap for
+ * every call. Larger buffers are kept in smaller numbers than @max.
+ *
+ * Returns the new pool or NULL on error.
+ */
+virNetMessagePoolPtr
+virNetMessagePoolNew(size_t max)
+{
+    virNetMessagePoolPtr pool;
+    size_t i;
+
+    if (virNetMessagePoolInitialize() < 0)
+        return NULL;
+
+    if (!(pool = virObjectLockableNew(virNetMessagePoolClass)))
+        return NULL;
+
+    pool->nmsgs_max = max;
+    for (i = 0; i < VIR_NET_MESSAGE_POOL_NCLASSES; i++)
+        pool->nbuffers_max[i] = MAX(max >> (2 * i), 1);
+
+    return pool;
+}
+
+
+/**
+ * virNetMessagePoolSetParent:
+ * @pool: the message pool
+ * @parent: the pool to fall back to
+ *
+ * Makes @pool take from @parent what its own free lists can not
+ * provide and hand over what they can not hold. When @pool goes away
+ * whatever it still holds is handed over to @parent too. Typically
+ * @pool is private to a single client and @parent shared by a server.
+ */
+void
+virNetMessagePoolSetParent(virNetMessagePoolPtr pool,
+                           virNetMessagePoolPtr parent)
+{
+    virObjectLock(pool);
+    virObjectUnref(pool->shared);
+    pool->shared = virObjectRef(parent);
+    virObjectUnlock(pool);
+}
+
+
+/**
+ * virNetMessagePoolGetStats:
+ * @pool: the message pool
+ * @stats: filled with the counters of @pool
+ *
+ * Every allocation made through a hierarchy of pools is counted by
+ * exactly one of them, so counters of related pools can be summed up.
+ * A pool going away passes its counters on to its parent.
+ */
+void
+virNetMessagePoolGetStats(virNetMessagePoolPtr pool,
+                          virNetMessagePoolStatsPtr stats)
+{
+    virObjectLock(pool);
+    *stats = pool->stats;
+    virObjectUnlock(pool);
+}
+
+
+static virNetMessagePtr
+virNetMessagePoolGetMessage(virNetMessagePoolPtr pool)
+{
+    virNetMessagePtr msg = NULL;
+    virNetMessagePoolPtr shared;
+
+    virObjectLock(pool);
+    if ((msg = pool->msgs)) {
+        pool->msgs = msg->next;
+        pool->nmsgs--;
+        pool->stats.reuses++;
+        pool->stats.cached--;
+        pool->stats.cachedBytes -= sizeof(*msg);
+        virObjectUnlock(pool);
+        msg->next = NULL;
+        return msg;
+    }
+
+    if (!(shared = virObjectRef(pool->shared)))
+        pool->stats.allocs++;
+    virObjectUnlock(pool);
+
+    if (shared) {
+        msg = virNetMessagePoolGetMessage(shared);
+        virObjectUnref(shared);
+        return msg;
+    }
+
+    return g_new0(virNetMessage, 1);
+}
+
+
+static void
+virNetMessagePoolPutMessage(virNetMessagePoolPtr pool,
+                            virNetMessagePtr msg)
+{
+    virNetMessagePoolPtr shared = NULL;
+
+    virObjectLock(pool);
+    if (pool->nmsgs < pool->nmsgs_max) {
+        msg->next = pool->msgs;
+        pool->msgs = msg;
+        pool->nmsgs++;
+        pool->stats.cached++;
+        pool->stats.cachedBytes += sizeof(*msg);
+        msg = NULL;
+    } else {
+        shared = virObjectRef(pool->shared);
+    }
+    virObjectUnlock(pool);
+
+    if (shared)
+        virNetMessagePoolPutMessage(shared, msg);
+    else
+        g_free(msg);
+    virObjectUnref(shared);
+}
+
+
+static ssize_t
+virNetMessagePoolClassFind(size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_NET_MESSAGE_POOL_NCLASSES; i++) {
+        if (size <= virNetMessagePoolClasses[i])
+            return i;
+    }
+
+    return -1;
+}
+
+
+/*
+ * Returns a buffer of at least @len bytes, storing its actual
+ * size in @size. Neither the buffer nor its size class depend on
+ * @pool being set, so buffers can move between messages freely.
+ */
+static char *
+virNetMessagePoolGetBuffer(virNetMessagePoolPtr pool,
+                           size_t len,
+                           size_t *size)
+{
+    virNetMessagePoolBufferPtr buf;
+    virNetMessagePoolPtr shared;
+    ssize_t class = virNetMessagePoolClassFind(len);
+
+    if (class < 0) {
+        *size = len;
+        if (pool) {
+            virObjectLock(pool);
+            pool->stats.allocs++;
+            virObjectUnlock(pool);
+        }
+        return g_new(char, len);
+    }
+
+    *size = virNetMessagePoolClasses[class];
+
+    if (!pool)
+        return g_new(char, *size);
+
+    virObjectLock(pool);
+    if ((buf = pool->buffers[class])) {
+        pool->buffers[class] = buf->next;
+        pool->nbuffers[class]--;
+        pool->stats.reuses++;
+        pool->stats.cached--;
+        pool->stats.cachedBytes -= *size;
+        virObjectUnlock(pool);
+        return (char *) buf;
+    }
+
+    if (!(shared = virObjectRef(pool->shared)))
+        pool->stats.allocs++;
+    virObjectUnlock(pool);
+
+    if (shared) {
+        char *ret = virNetMessagePoolGetBuffer(shared, len, size);
+        virObjectUnref(shared);
+        return ret;
+    }
+
+    return g_new(char, *size);
+}
+
+
+static void
+virNetMessagePoolPutBuffer(virNetMessagePoolPtr pool,
+                           char *buffer,
+                           size_t size)
+{
+    virNetMessagePoolBufferPtr buf = (virNetMessagePoolBufferPtr) buffer;
+    virNetMessagePoolPtr shared = NULL;
+    ssize_t class;
+
+    if (!buffer)
+        return;
+
+    class = virNetMessagePoolClassFind(size);
+    if (!pool || class < 0 || virNetMessagePoolClasses[class] != size) {
+        g_free(buffer);
+        return;
+    }
+
+    virObjectLock(pool);
+    if (pool->nbuffers[class] < pool->nbuffers_max[class]) {
+        buf->next = pool->buffers[class];
+        pool->buffers[class] = buf;
+        pool->nbuffers[class]++;
+        pool->stats.cached++;
+        pool->stats.cachedBytes += size;
+        buffer = NULL;
+    } else {
+        shared = virObjectRef(pool->shared);
+    }
+    virObjectUnlock(pool);
+
+    if (shared)
+        virNetMessagePoolPutBuffer(shared, buffer, size);
+    else
+        g_free(buffer);
+    virObjectUnref(shared);
+}
+
+
+static void
+virNetMessagePoolDispose(void *obj)
+{
+    virNetMessagePoolPtr pool = obj;
+    size_t i;
+
+    /* Keep the counters of the parent monotonic */
+    if (pool->shared) {
+        virObjectLock(pool->shared);
+        pool->shared->stats.allocs += pool->stats.allocs;
+        pool->shared->stats.reuses += pool->stats.reuses;
+        virObjectUnlock(pool->shared);
+    }
+
+    while (pool->msgs) {
+        virNetMessagePtr msg = pool->msgs;
+        pool->msgs = msg->next;
+        if (pool->shared)
+            virNetMessagePoolPutMessage(pool->shared, msg);
+        else
+            g_free(msg);
+    }
+
+    for (i = 0; i < VIR_NET_MESSAGE_POOL_NCLASSES; i++) {
+        while (pool->buffers[i]) {
+            virNetMessagePoolBufferPtr buf = pool->buffers[i];
+            pool->buffers[i] = buf->next;
+            virNetMessagePoolPutBuffer(pool->shared, (char *) buf,
+                                       virNetMessagePoolClasses[i]);
+        }
+    }
+
+    virObjectUnref(pool->shared);
+}
+
+
 virNetMessagePtr virNetMessageNew(bool tracked)
+{
+    return virNetMessageNewPooled(NULL, tracked);
+}
+
+
+/**
+ * virNetMessageNewPooled:
+ * @pool: the message pool, or NULL
+ * @tracked: whether the message counts against client request limits
+ *
+ * Creates a new message, reusing memory from @pool if there is any.
+ * The message keeps a reference on @pool and returns the memory it
+ * took to it once freed.
+ *
+ * Returns the new message, or NULL on error.
+ */
+virNetMessagePtr
+virNetMessageNewPooled(virNetMessagePoolPtr pool,
+                       bool tracked)
 {
     virNetMessagePtr msg;
 
-    if (VIR_ALLOC(msg) < 0)
-        return NULL;
+    if (pool) {
+        msg = virNetMessagePoolGetMessage(pool);
+        msg->pool = virObjectRef(pool);
+    } else {
+        msg = g_new0(virNetMessage, 1);
+    }
 
     msg->tracked = tracked;
-    VIR_DEBUG("msg=%p tracked=%d", msg, tracked);
+    VIR_DEBUG("msg=%p tracked=%d pool=%p", msg, tracked, pool);
 
     return msg;
 }
 
 
+/**
+ * virNetMessageReserve:
+ * @msg: the message
+ * @len: the buffer size needed
+ *
+ * Makes sure the buffer of @msg can hold at least @len bytes, keeping
+ * the first bufferOffset bytes, i.e. whatever was encoded or received
+ * so far. Unlike bufferLength, the allocated size of the buffer never
+ * shrinks until the payload is cleared, so a message being reused does
+ * not go back to the heap for every call.
+ */
 void
-virNetMessageClearPayload(virNetMessagePtr msg)
+virNetMessageReserve(virNetMessagePtr msg,
+                     size_t len)
+{
+    char *buffer;
+    size_t size;
+
+    if (len <= msg->bufferSize)
+        return;
+
+    buffer = virNetMessagePoolGetBuffer(msg->pool, len, &size);
+    if (msg->buffer && msg->bufferOffset)
+        memcpy(buffer, msg->buffer, MIN(msg->bufferOffset, msg->bufferSize));
+
+    virNetMessagePoolPutBuffer(msg->pool, msg->buffer, msg->bufferSize);
+    msg->buffer = buffer;
+    msg->bufferSize = size;
+}
+
+
+static void
+virNetMessageClearFDs(virNetMessagePtr msg)
 {
     size_t i;
 
@@ -59,27 +443,55 @@ virNetMessageClearPayload(virNetMessagePtr msg)
     msg->donefds = 0;
     msg->nfds = 0;
     VIR_FREE(msg->fds);
+}
+
+
+void
+virNetMessageClearPayload(virNetMessagePtr msg)
+{
+    virNetMessageClearFDs(msg);
 
     msg->bufferOffset = 0;
     msg->bufferLength = 0;
-    VIR_FREE(msg->buffer);
+    virNetMessagePoolPutBuffer(msg->pool, msg->buffer, msg->bufferSize);
+    msg->buffer = NULL;
+    msg->bufferSize = 0;
 }
 
 
+/*
+ * Resets @msg for receiving or encoding another message. The
+ * buffer is kept unless it grew larger than the pooled sizes.
+ */
 void virNetMessageClear(virNetMessagePtr msg)
 {
     bool tracked = msg->tracked;
+    virNetMessagePoolPtr pool = msg->pool;
+    char *buffer = NULL;
+    size_t bufferSize = 0;
 
     VIR_DEBUG("msg=%p nfds=%zu", msg, msg->nfds);
 
+    if (msg->bufferSize <= VIR_NET_MESSAGE_POOL_BUFFER_MAX) {
+        buffer = g_steal_pointer(&msg->buffer);
+        bufferSize = msg->bufferSize;
+        msg->bufferSize = 0;
+    }
+
     virNetMessageClearPayload(msg);
+    g_free(msg->eventKey);
     memset(msg, 0, sizeof(*msg));
     msg->tracked = tracked;
+    msg->pool = pool;
+    msg->buffer = buffer;
+    msg->bufferSize = bufferSize;
 }
 
 
 void virNetMessageFree(virNetMessagePtr msg)
 {
+    virNetMessagePoolPtr pool;
+
     if (!msg)
         return;
 
@@ -89,7 +501,15 @@ void virNetMessageFree(virNetMessagePtr msg)
         msg->cb(msg, msg->opaque);
 
     virNetMessageClearPayload(msg);
-    VIR_FREE(msg);
+    VIR_FREE(msg->eventKey);
+
+    if ((pool = g_steal_pointer(&msg->pool))) {
+        memset(msg, 0, sizeof(*msg));
+        virNetMessagePoolPutMessage(pool, msg);
+        virObjectUnref(pool);
+    } else {
+        VIR_FREE(msg);
+    }
 }
 
 void virNetMessageQueuePush(virNetMessagePtr *queue, virNetMessagePtr msg)
@@ -153,8 +573,7 @@ int virNetMessageDecodeLength(virNetMessagePtr msg)
     /* Extend our declared buffer length and carry
        on reading the header + payload */
     msg->bufferLength += len;
-    if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
-        goto cleanup;
+    virNetMessageReserve(msg, msg->bufferLength);
 
     VIR_DEBUG("Got length, now need %zu total (%u more)",
               msg->bufferLength, len);
@@ -167,6 +586,95 @@ int virNetMessageDecodeLength(virNetMessagePtr msg)
 }
 
 
+/*
+ * Replaces the compressed payload of @msg, whose header was decoded
+ * already, with what it inflates to. Like any other message, the
+ * result may not be larger than VIR_NET_MESSAGE_MAX.
+ */
+static int
+virNetMessageDecompress(virNetMessagePtr msg)
+{
+    g_autoptr(GZlibDecompressor) decompressor = NULL;
+    g_autoptr(GError) err = NULL;
+    size_t inlen = msg->bufferLength - msg->bufferOffset;
+    size_t max = VIR_NET_MESSAGE_MAX + VIR_NET_MESSAGE_LEN_MAX;
+    size_t nread = 0;
+    size_t nwritten = 0;
+    GConverterResult res;
+    bool grow = false;
+    char *buffer;
+    size_t size;
+    int ret = -1;
+
+    buffer = virNetMessagePoolGetBuffer(msg->pool,
+                                        MIN(msg->bufferOffset +
+                                            MAX(inlen * 4, VIR_NET_MESSAGE_INITIAL),
+                                            max),
+                                        &size);
+    memcpy(buffer, msg->buffer, msg->bufferOffset);
+    decompressor = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW);
+
+    do {
+        gsize r = 0;
+        gsize w = 0;
+
+        if (grow || msg->bufferOffset + nwritten == size) {
+            char *tmp;
+            size_t tmpsize;
+
+            if (size >= max) {
+                virReportError(VIR_ERR_RPC,
+                               _("decompressed message is larger than %d bytes"),
+                               VIR_NET_MESSAGE_MAX);
+                goto cleanup;
+            }
+
+            tmp = virNetMessagePoolGetBuffer(msg->pool, MIN(size * 2, max),
+                                             &tmpsize);
+            memcpy(tmp, buffer, msg->bufferOffset + nwritten);
+            virNetMessagePoolPutBuffer(msg->pool, buffer, size);
+            buffer = tmp;
+            size = tmpsize;
+            grow = false;
+        }
+
+        res = g_converter_convert(G_CONVERTER(decompressor),
+                                  msg->buffer + msg->bufferOffset + nread,
+                                  inlen - nread,
+                                  buffer + msg->bufferOffset + nwritten,
+                                  size - msg->bufferOffset - nwritten,
+                                  G_CONVERTER_INPUT_AT_END, &r, &w, &err);
+        if (res == G_CONVERTER_ERROR) {
+            if (!g_error_matches(err, G_IO_ERROR, G_IO_ERROR_NO_SPACE)) {
+                virReportError(VIR_ERR_RPC,
+                               _("Unable to decompress message payload: %s"),
+                               err->message);
+                goto cleanup;
+            }
+            g_clear_error(&err);
+            grow = true;
+        }
+
+        nread += r;
+        nwritten += w;
+    } while (res != G_CONVERTER_FINISHED);
+
+    VIR_DEBUG("Decompressed payload of msg=%p from %zu to %zu bytes",
+              msg, inlen, nwritten);
+
+    virNetMessagePoolPutBuffer(msg->pool, msg->buffer, msg->bufferSize);
+    msg->buffer = g_steal_pointer(&buffer);
+    msg->bufferSize = size;
+    msg->bufferLength = msg->bufferOffset + nwritten;
+
+    ret = 0;
+
+ cleanup:
+    virNetMessagePoolPutBuffer(msg->pool, buffer, size);
+    return ret;
+}
+
+
 /*
  * @msg: the complete incoming message, whose header to decode
  *
@@ -174,7 +682,8 @@ int virNetMessageDecodeLength(virNetMessagePtr msg)
  * validate the decoded fields in the header. It expects
  * bufferLength to refer to length of the data packet. Upon
  * return bufferOffset will refer to the amount of the packet
- * consumed by decoding of the header.
+ * consumed by decoding of the header. A compressed payload
+ * is inflated and the type stripped of the compression flag.
  *
  * returns 0 if successfully decoded, -1 upon fatal error
  */
@@ -204,6 +713,12 @@ int virNetMessageDecodeHeader(virNetMessagePtr msg)
 
     msg->bufferOffset += xdr_getpos(&xdr);
 
+    if (msg->header.type & VIR_NET_MESSAGE_TYPE_COMPRESSED) {
+        msg->header.type &= ~VIR_NET_MESSAGE_TYPE_COMPRESSED;
+        if (virNetMessageDecompress(msg) < 0)
+            goto cleanup;
+    }
+
     ret = 0;
 
  cleanup:
@@ -230,8 +745,7 @@ int virNetMessageEncodeHeader(virNetMessagePtr msg)
     unsigned int len = 0;
 
     msg->bufferLength = VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX;
-    if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
-        return ret;
+    virNetMessageReserve(msg, msg->bufferLength);
     msg->bufferOffset = 0;
 
     /* Format the header. */
@@ -370,9 +884,7 @@ int virNetMessageEncodePayload(virNetMessagePtr msg,
         xdr_destroy(&xdr);
 
         msg->bufferLength = newlen + VIR_NET_MESSAGE_LEN_MAX;
-
-        if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
-            goto error;
+        virNetMessageReserve(msg, msg->bufferLength);
 
         xdrmem_create(&xdr, msg->buffer + msg->bufferOffset,
                       msg->bufferLength - msg->bufferOffset, XDR_ENCODE);
@@ -432,13 +944,20 @@ int virNetMessageDecodePayload(virNetMessagePtr msg,
 }
 
 
-int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
-                                  const char *data,
-                                  size_t len)
+/*
+ * @msg: the outgoing message, whose header is already encoded
+ * @len: the number of raw payload bytes to make room for
+ *
+ * Grows the buffer of @msg so that @len bytes of raw payload fit
+ * after the header, for callers which produce the payload themselves
+ * instead of copying it in with virNetMessageEncodePayloadRaw. Once
+ * written, the payload is completed by virNetMessageEncodePayloadRawLen.
+ *
+ * returns the location to write the payload to, or NULL upon error
+ */
+char *virNetMessagePayloadRawBuffer(virNetMessagePtr msg,
+                                    size_t len)
 {
-    XDR xdr;
-    unsigned int msglen;
-
     /* If the message buffer is too small for the payload increase it accordingly. */
     if ((msg->bufferLength - msg->bufferOffset) < len) {
         if ((msg->bufferOffset + len) >
@@ -450,18 +969,34 @@ int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
                            VIR_NET_MESSAGE_MAX +
                            VIR_NET_MESSAGE_LEN_MAX -
                            msg->bufferOffset);
-            return -1;
+            return NULL;
         }
 
         msg->bufferLength = msg->bufferOffset + len;
-
-        if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
-            return -1;
+        virNetMessageReserve(msg, msg->bufferLength);
 
         VIR_DEBUG("Increased message buffer length = %zu", msg->bufferLength);
     }
 
-    memcpy(msg->buffer + msg->bufferOffset, data, len);
+    return msg->buffer + msg->bufferOffset;
+}
+
+
+/*
+ * @msg: the outgoing message
+ * @len: the number of raw payload bytes written
+ *
+ * Completes a message whose @len bytes of raw payload were written
+ * to the location returned by virNetMessagePayloadRawBuffer.
+ *
+ * returns 0 if successfully encoded, -1 upon fatal error
+ */
+int virNetMessageEncodePayloadRawLen(virNetMessagePtr msg,
+                                     size_t len)
+{
+    XDR xdr;
+    unsigned int msglen;
+
     msg->bufferOffset += len;
 
     /* Re-encode the length word. */
@@ -484,6 +1019,22 @@ int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
 }
 
 
+int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
+                                  const char *data,
+                                  size_t len)
+{
+    char *payload;
+
+    if (!(payload = virNetMessagePayloadRawBuffer(msg, len)))
+        return -1;
+
+    if (len)
+        memcpy(payload, data, len);
+
+    return virNetMessageEncodePayloadRawLen(msg, len);
+}
+
+
 int virNetMessageEncodePayloadEmpty(virNetMessagePtr msg)
 {
     XDR xdr;
@@ -509,6 +1060,104 @@ int virNetMessageEncodePayloadEmpty(virNetMessagePtr msg)
 }
 
 
+/**
+ * virNetMessageCompress:
+ * @msg: the fully encoded outgoing message
+ *
+ * Replaces the payload of @msg with its raw deflate compressed form
+ * and flags the header with VIR_NET_MESSAGE_TYPE_COMPRESSED. Stream
+ * packets, payloads smaller than VIR_NET_MESSAGE_COMPRESS_MIN and
+ * payloads which don't get any smaller are left alone.
+ *
+ * Returns 1 if @msg was compressed, 0 if it was left alone and -1 on
+ * error.
+ */
+int
+virNetMessageCompress(virNetMessagePtr msg)
+{
+    g_autoptr(GZlibCompressor) compressor = NULL;
+    g_autoptr(GError) err = NULL;
+    virNetMessageHeader header = msg->header;
+    size_t hdrlen = VIR_NET_MESSAGE_LEN_MAX + VIR_NET_MESSAGE_HEADER_MAX;
+    size_t inlen;
+    size_t nread = 0;
+    size_t nwritten = 0;
+    GConverterResult res;
+    unsigned int len;
+    char *buffer;
+    size_t size;
+    XDR xdr;
+    int ret = -1;
+
+    if (msg->header.type == VIR_NET_STREAM ||
+        msg->header.type == VIR_NET_STREAM_HOLE ||
+        msg->bufferOffset != 0 ||
+        msg->bufferLength < hdrlen + VIR_NET_MESSAGE_COMPRESS_MIN)
+        return 0;
+
+    inlen = msg->bufferLength - hdrlen;
+    buffer = virNetMessagePoolGetBuffer(msg->pool, msg->bufferLength, &size);
+
+    /* Management payloads are mostly XML, which shrinks well even at
+     * the fastest level */
+    compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW, 1);
+
+    do {
+        gsize r = 0;
+        gsize w = 0;
+
+        if (nwritten >= inlen) {
+            ret = 0;
+            goto cleanup;
+        }
+
+        res = g_converter_convert(G_CONVERTER(compressor),
+                                  msg->buffer + hdrlen + nread, inlen - nread,
+                                  buffer + hdrlen + nwritten, inlen - nwritten,
+                                  G_CONVERTER_INPUT_AT_END, &r, &w, &err);
+        if (res == G_CONVERTER_ERROR) {
+            if (g_error_matches(err, G_IO_ERROR, G_IO_ERROR_NO_SPACE)) {
+                ret = 0;
+            } else {
+                virReportError(VIR_ERR_RPC,
+                               _("Unable to compress message payload: %s"),
+                               err->message);
+            }
+            goto cleanup;
+        }
+
+        nread += r;
+        nwritten += w;
+    } while (res != G_CONVERTER_FINISHED);
+
+    header.type |= VIR_NET_MESSAGE_TYPE_COMPRESSED;
+    len = hdrlen + nwritten;
+
+    xdrmem_create(&xdr, buffer, hdrlen, XDR_ENCODE);
+    if (!xdr_u_int(&xdr, &len) ||
+        !xdr_virNetMessageHeader(&xdr, &header)) {
+        virReportError(VIR_ERR_RPC, "%s", _("Unable to encode message header"));
+        xdr_destroy(&xdr);
+        goto cleanup;
+    }
+    xdr_destroy(&xdr);
+
+    VIR_DEBUG("Compressed payload of msg=%p from %zu to %zu bytes",
+              msg, inlen, nwritten);
+
+    virNetMessagePoolPutBuffer(msg->pool, msg->buffer, msg->bufferSize);
+    msg->buffer = g_steal_pointer(&buffer);
+    msg->bufferSize = size;
+    msg->bufferLength = len;
+
+    ret = 1;
+
+ cleanup:
+    virNetMessagePoolPutBuffer(msg->pool, buffer, size);
+    return ret;
+}
+
+
 void virNetMessageSaveError(virNetMessageErrorPtr rerr)
 {
     /* This func may be called several times & the first
@@ -21,6 +21,7 @@
 #pragma once
 
 #include "virnetprotocol.h"
+#include "virobject.h"
 
 typedef struct virNetMessageHeader *virNetMessageHeaderPtr;
 typedef struct virNetMessageError *virNetMessageErrorPtr;
@@ -28,6 +29,12 @@ typedef struct virNetMessageError *virNetMessageErrorPtr;
 typedef struct _virNetMessage virNetMessage;
 typedef virNetMessage *virNetMessagePtr;
 
+typedef struct _virNetMessagePool virNetMessagePool;
+typedef virNetMessagePool *virNetMessagePoolPtr;
+
+typedef struct _virNetMessagePoolStats virNetMessagePoolStats;
+typedef virNetMessagePoolStats *virNetMessagePoolStatsPtr;
+
 typedef void (*virNetMessageFreeCallback)(virNetMessagePtr msg, void *opaque);
 
 struct _virNetMessage {
@@ -37,6 +44,7 @@ struct _virNetMessage {
                   /* Maximum   VIR_NET_MESSAGE_MAX     + VIR_NET_MESSAGE_LEN_MAX */
     size_t bufferLength;
     size_t bufferOffset;
+    size_t bufferSize; /* Allocated size of buffer, >= bufferLength */
 
     virNetMessageHeader header;
 
@@ -47,12 +55,48 @@ struct _virNetMessage {
     int *fds;
     size_t donefds;
 
+    virNetMessagePoolPtr pool;
+
+    /* Monotonic time in microseconds the incoming call was handed over
+     * to the workers at, zero if unknown */
+    gint64 queued;
+
+    /* Asynchronous event, of which only the latest one with the
+     * same optional @eventKey needs to be sent */
+    bool event;
+    char *eventKey;
+
     virNetMessagePtr next;
 };
 
+/* Both counting message structs and buffers together */
+struct _virNetMessagePoolStats {
+    unsigned long long allocs;      /* taken from the heap */
+    unsigned long long reuses;      /* taken from a free list */
+    unsigned long long cached;      /* sitting on free lists */
+    unsigned long long cachedBytes; /* memory held by the free lists */
+};
+
+
+virNetMessagePoolPtr virNetMessagePoolNew(size_t max);
+
+void virNetMessagePoolSetParent(virNetMessagePoolPtr pool,
+                                virNetMessagePoolPtr parent)
+    ATTRIBUTE_NONNULL(1);
+
+void virNetMessagePoolGetStats(virNetMessagePoolPtr pool,
+                               virNetMessagePoolStatsPtr stats)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
 
 virNetMessagePtr virNetMessageNew(bool tracked);
 
+virNetMessagePtr virNetMessageNewPooled(virNetMessagePoolPtr pool,
+                                        bool tracked);
+
+void virNetMessageReserve(virNetMessagePtr msg,
+                          size_t len)
+    ATTRIBUTE_NONNULL(1);
+
 void virNetMessageClearPayload(virNetMessagePtr msg);
 
 void virNetMessageClear(virNetMessagePtr);
@@ -81,6 +125,12 @@ int virNetMessageDecodePayload(virNetMessagePtr msg,
                                void *data)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(2) G_GNUC_WARN_UNUSED_RESULT;
 
+/* Payloads smaller than this are not worth compressing */
+#define VIR_NET_MESSAGE_COMPRESS_MIN 4096
+
+int virNetMessageCompress(virNetMessagePtr msg)
+    ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
+
 int virNetMessageEncodeNumFDs(virNetMessagePtr msg);
 int virNetMessageDecodeNumFDs(virNetMessagePtr msg);
 
@@ -88,6 +138,12 @@ int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
                                   const char *buf,
                                   size_t len)
     ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
+char *virNetMessagePayloadRawBuffer(virNetMessagePtr msg,
+                                    size_t len)
+    ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
+int virNetMessageEncodePayloadRawLen(virNetMessagePtr msg,
+                                     size_t len)
+    ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
 int virNetMessageEncodePayloadEmpty(virNetMessagePtr msg)
     ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
 
@@ -37,6 +37,13 @@ const VIR_NET_MESSAGE_INITIAL = 65536;
  */
 const VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX = 262120;
 
+/*
+ * Max payload size of stream data packets exchanged with a peer that
+ * agreed on VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_CHUNKS. Peers which did
+ * not still get at most VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX.
+ */
+const VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX = 4194304;
+
 /* Maximum total message size (serialised). */
 const VIR_NET_MESSAGE_MAX = 33554432;
 
@@ -62,6 +69,14 @@ const VIR_NET_MESSAGE_STRING_MAX = 4194304;
  */
 const VIR_NET_MESSAGE_NUM_FDS_MAX = 32;
 
+/*
+ * Flag or'ed into the type of a message header when the payload following
+ * the header is compressed with raw deflate. Only sent to a peer which
+ * agreed on VIR_DRV_FEATURE_REMOTE_COMPRESSION, and never for stream
+ * data packets.
+ */
+const VIR_NET_MESSAGE_TYPE_COMPRESSED = 256;
+
 /*
  * RPC wire format
  *
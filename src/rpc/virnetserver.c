@@ -32,6 +32,9 @@
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+/* Messages kept by the server for all of its clients */
+#define VIR_NET_SERVER_MESSAGE_POOL_MAX 256
+
 VIR_LOG_INIT("rpc.netserver");
 
 
@@ -39,11 +42,31 @@ typedef struct _virNetServerJob virNetServerJob;
 typedef virNetServerJob *virNetServerJobPtr;
 
 struct _virNetServerJob {
+    virNetServerJobPtr next;
+
     virNetServerClientPtr client;
     virNetMessagePtr msg;
     virNetServerProgramPtr prog;
 };
 
+/*
+ * Jobs of regular priority are not handed to the thread pool directly.
+ * They are queued per client instead and the pool is only told that
+ * there's one more job to run. Workers then pick the clients in a round
+ * robin fashion, so that a single busy client can't starve the others.
+ */
+typedef struct _virNetServerClientJobs virNetServerClientJobs;
+typedef virNetServerClientJobs *virNetServerClientJobsPtr;
+
+struct _virNetServerClientJobs {
+    virNetServerClientPtr client;
+
+    virNetServerJobPtr head;
+    virNetServerJobPtr tail;
+    size_t nqueued;
+    size_t nrunning;
+};
+
 struct _virNetServer {
     virObjectLockable parent;
 
@@ -52,6 +75,11 @@ struct _virNetServer {
     /* Immutable pointer, self-locking APIs */
     virThreadPoolPtr workers;
 
+    size_t njobQueues;                  /* Clients with queued or running jobs */
+    virNetServerClientJobsPtr *jobQueues;
+    size_t jobQueueNext;                /* Next client to pick a job from */
+    size_t nclient_jobs_max;            /* Max running jobs of one client */
+
     size_t nservices;
     virNetServerServicePtr *services;
 
@@ -65,6 +93,12 @@ struct _virNetServer {
     size_t nclients_unauth;             /* Unauthenticated clients count */
     size_t nclients_unauth_max;         /* Max allowed unauth clients count */
 
+    /* Immutable pointer, self-locking APIs */
+    virNetMessagePoolPtr msgPool;       /* Backing the clients' pools */
+
+    /* Immutable pointer, self-locking APIs */
+    virNetServerCapturePtr capture;     /* Capture of the RPC messages */
+
     int keepaliveInterval;
     unsigned int keepaliveCount;
 
@@ -143,28 +177,210 @@ static int virNetServerProcessMsg(virNetServerPtr srv,
     return 0;
 }
 
-static void virNetServerHandleJob(void *jobOpaque, void *opaque)
+static void
+virNetServerJobFree(virNetServerJobPtr job,
+                    bool processed)
 {
-    virNetServerPtr srv = opaque;
-    virNetServerJobPtr job = jobOpaque;
+    if (!processed)
+        virNetMessageFree(job->msg);
+    virObjectUnref(job->prog);
+    virObjectUnref(job->client);
+    VIR_FREE(job);
+}
+
 
+static void
+virNetServerRunJob(virNetServerPtr srv,
+                   virNetServerJobPtr job)
+{
     VIR_DEBUG("server=%p client=%p message=%p prog=%p",
               srv, job->client, job->msg, job->prog);
 
-    if (virNetServerProcessMsg(srv, job->client, job->prog, job->msg) < 0)
-        goto error;
+    if (virNetServerProcessMsg(srv, job->client, job->prog, job->msg) < 0) {
+        virNetServerClientClose(job->client);
+        virNetServerJobFree(job, false);
+        return;
+    }
 
-    virObjectUnref(job->prog);
-    virObjectUnref(job->client);
-    VIR_FREE(job);
-    return;
+    virNetServerJobFree(job, true);
+}
 
- error:
-    virObjectUnref(job->prog);
-    virNetMessageFree(job->msg);
-    virNetServerClientClose(job->client);
-    virObjectUnref(job->client);
-    VIR_FREE(job);
+
+static ssize_t
+virNetServerFindJobQueueLocked(virNetServerPtr srv,
+                               virNetServerClientPtr client)
+{
+    size_t i;
+
+    for (i = 0; i < srv->njobQueues; i++) {
+        if (srv->jobQueues[i]->client == client)
+            return i;
+    }
+
+    return -1;
+}
+
+
+static void
+virNetServerDropJobQueueLocked(virNetServerPtr srv,
+                               size_t idx)
+{
+    virNetServerClientJobsPtr queue = srv->jobQueues[idx];
+
+    if (queue->nqueued || queue->nrunning)
+        return;
+
+    virObjectUnref(queue->client);
+    VIR_FREE(queue);
+    VIR_DELETE_ELEMENT(srv->jobQueues, idx, srv->njobQueues);
+
+    if (srv->jobQueueNext > idx)
+        srv->jobQueueNext--;
+}
+
+
+/*
+ * virNetServerQueueJobLocked:
+ *
+ * Append @job to the queue of its client and tell the worker pool
+ * about it. On failure @job is left untouched.
+ */
+static int
+virNetServerQueueJobLocked(virNetServerPtr srv,
+                           virNetServerJobPtr job)
+{
+    virNetServerClientJobsPtr queue;
+    ssize_t idx;
+
+    if ((idx = virNetServerFindJobQueueLocked(srv, job->client)) < 0) {
+        queue = g_new0(virNetServerClientJobs, 1);
+        queue->client = virObjectRef(job->client);
+
+        if (VIR_APPEND_ELEMENT(srv->jobQueues, srv->njobQueues, queue) < 0) {
+            virObjectUnref(queue->client);
+            VIR_FREE(queue);
+            return -1;
+        }
+
+        idx = srv->njobQueues - 1;
+    }
+
+    queue = srv->jobQueues[idx];
+
+    if (queue->tail)
+        queue->tail->next = job;
+    else
+        queue->head = job;
+    queue->tail = job;
+    queue->nqueued++;
+
+    if (virThreadPoolSendJob(srv->workers, 0, NULL) < 0) {
+        virNetServerJobPtr prev = NULL;
+
+        /* @srv is locked, so no worker could have taken @job yet */
+        if (queue->head != job) {
+            for (prev = queue->head; prev->next != job; prev = prev->next)
+                ;
+        }
+
+        if (prev)
+            prev->next = NULL;
+        else
+            queue->head = NULL;
+        queue->tail = prev;
+        queue->nqueued--;
+
+        virNetServerDropJobQueueLocked(srv, idx);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * virNetServerTakeJob:
+ *
+ * Pick the first queued job of the next client, in round robin order,
+ * which doesn't have too many jobs running already.
+ *
+ * Returns the job or NULL if there's none to run now.
+ */
+static virNetServerJobPtr
+virNetServerTakeJob(virNetServerPtr srv)
+{
+    virNetServerJobPtr job = NULL;
+    size_t i;
+
+    virObjectLock(srv);
+
+    for (i = 0; i < srv->njobQueues; i++) {
+        size_t idx = (srv->jobQueueNext + i) % srv->njobQueues;
+        virNetServerClientJobsPtr queue = srv->jobQueues[idx];
+
+        if (!queue->head ||
+            (srv->nclient_jobs_max &&
+             queue->nrunning >= srv->nclient_jobs_max))
+            continue;
+
+        job = queue->head;
+        queue->head = job->next;
+        if (!queue->head)
+            queue->tail = NULL;
+        job->next = NULL;
+
+        queue->nqueued--;
+        queue->nrunning++;
+
+        srv->jobQueueNext = idx + 1;
+        break;
+    }
+
+    virObjectUnlock(srv);
+
+    return job;
+}
+
+
+static void
+virNetServerFinishJob(virNetServerPtr srv,
+                      virNetServerClientPtr client)
+{
+    ssize_t idx;
+
+    virObjectLock(srv);
+
+    if ((idx = virNetServerFindJobQueueLocked(srv, client)) >= 0) {
+        srv->jobQueues[idx]->nrunning--;
+        virNetServerDropJobQueueLocked(srv, idx);
+    }
+
+    virObjectUnlock(srv);
+}
+
+
+static void virNetServerHandleJob(void *jobOpaque, void *opaque)
+{
+    virNetServerPtr srv = opaque;
+    virNetServerJobPtr job = jobOpaque;
+
+    /* High priority jobs are passed directly */
+    if (job) {
+        virNetServerRunJob(srv, job);
+        return;
+    }
+
+    /* Otherwise keep running jobs from the per-client queues. Jobs held
+     * back by the limit of running jobs of a client become runnable only
+     * once a job of the same client finishes, so the worker which just
+     * finished it has to look for more work. */
+    while ((job = virNetServerTakeJob(srv))) {
+        virNetServerClientPtr client = virObjectRef(job->client);
+
+        virNetServerRunJob(srv, job);
+        virNetServerFinishJob(srv, client);
+        virObjectUnref(client);
+    }
 }
 
 /**
@@ -196,10 +412,13 @@ virNetServerDispatchNewMessage(virNetServerClientPtr client,
     virNetServerPtr srv = opaque;
     virNetServerProgramPtr prog = NULL;
     unsigned int priority = 0;
+    int rc;
 
     VIR_DEBUG("server=%p client=%p message=%p",
               srv, client, msg);
 
+    msg->queued = g_get_monotonic_time();
+
     virObjectLock(srv);
     prog = virNetServerGetProgramLocked(srv, msg);
     /* we can unlock @srv since @prog can only become invalid in case
@@ -222,7 +441,15 @@ virNetServerDispatchNewMessage(virNetServerClientPtr client,
             priority = virNetServerProgramGetPriority(prog, msg->header.proc);
         }
 
-        if (virThreadPoolSendJob(srv->workers, priority, job) < 0) {
+        if (priority) {
+            rc = virThreadPoolSendJob(srv->workers, priority, job);
+        } else {
+            virObjectLock(srv);
+            rc = virNetServerQueueJobLocked(srv, job);
+            virObjectUnlock(srv);
+        }
+
+        if (rc < 0) {
             virObjectUnref(client);
             VIR_FREE(job);
             virObjectUnref(prog);
@@ -295,6 +522,10 @@ int virNetServerAddClient(virNetServerPtr srv,
         goto error;
     srv->clients[srv->nclients-1] = virObjectRef(client);
 
+    virNetMessagePoolSetParent(virNetServerClientGetMessagePool(client),
+                               srv->msgPool);
+    virNetServerClientSetCapture(client, srv->capture);
+
     virObjectLock(client);
     if (virNetServerClientIsAuthPendingLocked(client))
         virNetServerTrackPendingAuthLocked(srv);
@@ -372,7 +603,14 @@ virNetServerPtr virNetServerNew(const char *name,
                                               priority_workers,
                                               virNetServerHandleJob,
                                               "rpc-worker",
-                                              srv)))
+                                              srv,
+                                              VIR_THREAD_POOL_WORK_STEALING)))
+        goto error;
+
+    if (!(srv->msgPool = virNetMessagePoolNew(VIR_NET_SERVER_MESSAGE_POOL_MAX)))
+        goto error;
+
+    if (!(srv->capture = virNetServerCaptureNew()))
         goto error;
 
     srv->name = g_strdup(name);
@@ -411,6 +649,7 @@ virNetServerPtr virNetServerNewPostExecRestart(virJSONValuePtr object,
     unsigned int priority_workers;
     unsigned int max_clients;
     unsigned int max_anonymous_clients;
+    unsigned int max_client_jobs = 0;
     unsigned int keepaliveInterval;
     unsigned int keepaliveCount;
     unsigned long long next_client_id;
@@ -445,6 +684,13 @@ virNetServerPtr virNetServerNewPostExecRestart(virJSONValuePtr object,
     } else {
         max_anonymous_clients = max_clients;
     }
+    if (virJSONValueObjectHasKey(object, "max_client_jobs") &&
+        virJSONValueObjectGetNumberUint(object, "max_client_jobs",
+                                        &max_client_jobs) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Malformed max_client_jobs data in JSON document"));
+        goto error;
+    }
     if (virJSONValueObjectGetNumberUint(object, "keepaliveInterval", &keepaliveInterval) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("Missing keepaliveInterval data in JSON document"));
@@ -471,6 +717,8 @@ virNetServerPtr virNetServerNewPostExecRestart(virJSONValuePtr object,
                                 clientPrivFree, clientPrivOpaque)))
         goto error;
 
+    srv->nclient_jobs_max = max_client_jobs;
+
     if (!(services = virJSONValueObjectGet(object, "services"))) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("Missing services data in JSON document"));
@@ -584,6 +832,13 @@ virJSONValuePtr virNetServerPreExecRestart(virNetServerPtr srv)
                        _("Cannot set max_anonymous_clients data in JSON document"));
         goto error;
     }
+    if (srv->nclient_jobs_max &&
+        virJSONValueObjectAppendNumberUint(object, "max_client_jobs",
+                                           srv->nclient_jobs_max) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Cannot set max_client_jobs data in JSON document"));
+        goto error;
+    }
     if (virJSONValueObjectAppendNumberUint(object, "keepaliveInterval", srv->keepaliveInterval) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("Cannot set keepaliveInterval data in JSON document"));
@@ -913,6 +1168,20 @@ void virNetServerDispose(void *obj)
 
     virThreadPoolFree(srv->workers);
 
+    for (i = 0; i < srv->njobQueues; i++) {
+        virNetServerClientJobsPtr queue = srv->jobQueues[i];
+        virNetServerJobPtr job;
+
+        while ((job = queue->head)) {
+            queue->head = job->next;
+            virNetServerJobFree(job, false);
+        }
+
+        virObjectUnref(queue->client);
+        VIR_FREE(queue);
+    }
+    VIR_FREE(srv->jobQueues);
+
     for (i = 0; i < srv->nservices; i++)
         virObjectUnref(srv->services[i]);
     VIR_FREE(srv->services);
@@ -924,6 +1193,9 @@ void virNetServerDispose(void *obj)
     for (i = 0; i < srv->nclients; i++)
         virObjectUnref(srv->clients[i]);
     VIR_FREE(srv->clients);
+
+    virObjectUnref(srv->msgPool);
+    virObjectUnref(srv->capture);
 }
 
 void virNetServerClose(virNetServerPtr srv)
@@ -1090,6 +1362,59 @@ virNetServerGetMaxUnauthClients(virNetServerPtr srv)
     return ret;
 }
 
+size_t
+virNetServerGetMaxClientJobs(virNetServerPtr srv)
+{
+    size_t ret;
+
+    virObjectLock(srv);
+    ret = srv->nclient_jobs_max;
+    virObjectUnlock(srv);
+
+    return ret;
+}
+
+/**
+ * virNetServerGetCapture:
+ * @srv: the server
+ *
+ * Returns the capture of the RPC messages exchanged with the clients
+ * of @srv, which lives as long as @srv.
+ */
+virNetServerCapturePtr
+virNetServerGetCapture(virNetServerPtr srv)
+{
+    return srv->capture;
+}
+
+/**
+ * virNetServerGetPrograms:
+ * @srv: the server
+ * @progs: filled with a newly allocated list of the programs of @srv
+ *
+ * The caller must release the references held by @progs.
+ *
+ * Returns the number of programs in @progs
+ */
+size_t
+virNetServerGetPrograms(virNetServerPtr srv,
+                        virNetServerProgramPtr **progs)
+{
+    size_t i;
+    size_t ret;
+
+    virObjectLock(srv);
+
+    *progs = g_new0(virNetServerProgramPtr, srv->nprograms);
+    for (i = 0; i < srv->nprograms; i++)
+        (*progs)[i] = virObjectRef(srv->programs[i]);
+    ret = srv->nprograms;
+
+    virObjectUnlock(srv);
+
+    return ret;
+}
+
 size_t
 virNetServerGetCurrentUnauthClients(virNetServerPtr srv)
 {
@@ -1102,6 +1427,38 @@ virNetServerGetCurrentUnauthClients(virNetServerPtr srv)
     return ret;
 }
 
+/**
+ * virNetServerGetMessagePoolStats:
+ * @srv: the server
+ * @stats: filled with the counters
+ *
+ * Sums up the counters of the message pool of @srv and of the pools
+ * private to each of its current clients.
+ */
+void
+virNetServerGetMessagePoolStats(virNetServerPtr srv,
+                                virNetMessagePoolStatsPtr stats)
+{
+    size_t i;
+
+    virObjectLock(srv);
+    virNetMessagePoolGetStats(srv->msgPool, stats);
+
+    for (i = 0; i < srv->nclients; i++) {
+        virNetMessagePoolPtr pool;
+        virNetMessagePoolStats tmp;
+
+        pool = virNetServerClientGetMessagePool(srv->clients[i]);
+        virNetMessagePoolGetStats(pool, &tmp);
+
+        stats->allocs += tmp.allocs;
+        stats->reuses += tmp.reuses;
+        stats->cached += tmp.cached;
+        stats->cachedBytes += tmp.cachedBytes;
+    }
+    virObjectUnlock(srv);
+}
+
 
 bool virNetServerNeedsAuth(virNetServerPtr srv,
                            int auth)
@@ -1174,10 +1531,12 @@ virNetServerGetClient(virNetServerPtr srv,
 int
 virNetServerSetClientLimits(virNetServerPtr srv,
                             long long int maxClients,
-                            long long int maxClientsUnauth)
+                            long long int maxClientsUnauth,
+                            long long int maxClientJobs)
 {
     int ret = -1;
     size_t max, max_unauth;
+    size_t i;
 
     virObjectLock(srv);
 
@@ -1199,6 +1558,18 @@ virNetServerSetClientLimits(virNetServerPtr srv,
     if (maxClientsUnauth >= 0)
         srv->nclients_unauth_max = maxClientsUnauth;
 
+    if (maxClientJobs >= 0) {
+        srv->nclient_jobs_max = maxClientJobs;
+
+        /* Jobs held back by the previous limit may be runnable now */
+        for (i = 0; i < srv->njobQueues; i++) {
+            size_t j;
+
+            for (j = 0; j < srv->jobQueues[i]->nqueued; j++)
+                ignore_value(virThreadPoolSendJob(srv->workers, 0, NULL));
+        }
+    }
+
     virNetServerCheckLimits(srv);
 
     ret = 0;
@@ -129,9 +129,16 @@ size_t virNetServerGetMaxClients(virNetServerPtr srv);
 size_t virNetServerGetCurrentClients(virNetServerPtr srv);
 size_t virNetServerGetMaxUnauthClients(virNetServerPtr srv);
 size_t virNetServerGetCurrentUnauthClients(virNetServerPtr srv);
+size_t virNetServerGetMaxClientJobs(virNetServerPtr srv);
+size_t virNetServerGetPrograms(virNetServerPtr srv,
+                               virNetServerProgramPtr **progs);
+virNetServerCapturePtr virNetServerGetCapture(virNetServerPtr srv);
+void virNetServerGetMessagePoolStats(virNetServerPtr srv,
+                                     virNetMessagePoolStatsPtr stats);
 
 int virNetServerSetClientLimits(virNetServerPtr srv,
                                 long long int maxClients,
-                                long long int maxClientsUnauth);
+                                long long int maxClientsUnauth,
+                                long long int maxClientJobs);
 
 int virNetServerUpdateTlsFiles(virNetServerPtr srv);
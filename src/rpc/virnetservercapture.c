@@ -0,0 +1,410 @@
+/*
+ * virnetservercapture.c: capture of the RPC messages of a server
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "virnetservercapture.h"
+
+#include "viralloc.h"
+#include "virerror.h"
+#include "virfile.h"
+#include "virlog.h"
+
+#define VIR_FROM_THIS VIR_FROM_RPC
+
+VIR_LOG_INIT("rpc.netservercapture");
+
+/*
+ * The messages are saved in the pcapng format, wrapped in the "exported
+ * PDU" link type of wireshark, which tells it to hand them to the libvirt
+ * dissector regardless of the transport they were received on.
+ */
+#define PCAPNG_BLOCK_SECTION_HEADER 0x0A0D0D0A
+#define PCAPNG_BLOCK_INTERFACE 0x00000001
+#define PCAPNG_BLOCK_ENHANCED_PACKET 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_OPT_END 0
+#define PCAPNG_OPT_COMMENT 1
+#define PCAPNG_OPT_EPB_FLAGS 2
+#define PCAPNG_EPB_FLAGS_INBOUND 1
+#define PCAPNG_EPB_FLAGS_OUTBOUND 2
+#define PCAPNG_LINKTYPE_WIRESHARK_UPPER_PDU 252
+#define PCAPNG_EXPORTED_PDU_TAG_END 0
+#define PCAPNG_EXPORTED_PDU_TAG_PROTO_NAME 12
+#define PCAPNG_EXPORTED_PDU_PROTO "libvirt"
+
+typedef struct _virNetServerCaptureRecord virNetServerCaptureRecord;
+typedef virNetServerCaptureRecord *virNetServerCaptureRecordPtr;
+
+struct _virNetServerCaptureRecord {
+    virNetServerCaptureRecordPtr next;
+
+    gint64 timestamp;               /* microseconds since the epoch */
+    unsigned long long client;
+    bool outbound;
+    size_t length;                  /* length of the whole message */
+    size_t caplen;                  /* length of @data */
+    char *data;
+};
+
+struct _virNetServerCapture {
+    virObjectLockable parent;
+
+    /* Read without the lock to keep the cost low while not capturing */
+    int active;
+
+    unsigned long long maxSize;
+    unsigned int snaplen;
+    unsigned int sample;
+
+    /* Oldest record first, dropped once @size exceeds @maxSize */
+    virNetServerCaptureRecordPtr head;
+    virNetServerCaptureRecordPtr tail;
+    unsigned long long size;
+};
+
+
+static virClassPtr virNetServerCaptureClass;
+static void virNetServerCaptureDispose(void *obj);
+
+static int virNetServerCaptureOnceInit(void)
+{
+    if (!VIR_CLASS_NEW(virNetServerCapture, virClassForObjectLockable()))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virNetServerCapture);
+
+
+static void
+virNetServerCaptureRecordFree(virNetServerCaptureRecordPtr rec)
+{
+    if (!rec)
+        return;
+
+    g_free(rec->data);
+    g_free(rec);
+}
+
+
+static void
+virNetServerCaptureClearLocked(virNetServerCapturePtr capture)
+{
+    virNetServerCaptureRecordPtr rec;
+
+    while ((rec = capture->head)) {
+        capture->head = rec->next;
+        virNetServerCaptureRecordFree(rec);
+    }
+    capture->tail = NULL;
+    capture->size = 0;
+}
+
+
+/**
+ * virNetServerCaptureNew:
+ *
+ * Create an inactive capture of RPC messages. The messages handed to
+ * virNetServerCaptureMessage are only kept once the capture has been
+ * started with virNetServerCaptureStart.
+ *
+ * Returns the new capture, or NULL on error.
+ */
+virNetServerCapturePtr
+virNetServerCaptureNew(void)
+{
+    if (virNetServerCaptureInitialize() < 0)
+        return NULL;
+
+    return virObjectLockableNew(virNetServerCaptureClass);
+}
+
+
+/**
+ * virNetServerCaptureStart:
+ * @capture: the capture
+ * @size: maximum number of bytes of messages kept in memory
+ * @snaplen: maximum number of bytes kept of a single message
+ * @sample: keep only 1 in @sample calls and their replies
+ *
+ * Drop the records of any previous capture and start keeping the messages
+ * handed to @capture. Once more than @size bytes are kept, the oldest
+ * records are dropped. Messages are sampled by their serial, so that the
+ * replies and the events of a kept call are kept too.
+ */
+void
+virNetServerCaptureStart(virNetServerCapturePtr capture,
+                         unsigned long long size,
+                         unsigned int snaplen,
+                         unsigned int sample)
+{
+    virObjectLock(capture);
+    virNetServerCaptureClearLocked(capture);
+    capture->maxSize = size;
+    capture->snaplen = MAX(snaplen, VIR_NET_MESSAGE_HEADER_MAX + VIR_NET_MESSAGE_LEN_MAX);
+    capture->sample = MAX(sample, 1);
+    g_atomic_int_set(&capture->active, 1);
+    virObjectUnlock(capture);
+
+    VIR_DEBUG("capture=%p size=%llu snaplen=%u sample=%u",
+              capture, size, snaplen, sample);
+}
+
+
+/**
+ * virNetServerCaptureStop:
+ * @capture: the capture
+ *
+ * Stop keeping the messages handed to @capture. The records kept so far
+ * can still be saved with virNetServerCaptureSave.
+ */
+void
+virNetServerCaptureStop(virNetServerCapturePtr capture)
+{
+    g_atomic_int_set(&capture->active, 0);
+}
+
+
+bool
+virNetServerCaptureIsActive(virNetServerCapturePtr capture)
+{
+    return g_atomic_int_get(&capture->active) != 0;
+}
+
+
+/**
+ * virNetServerCaptureMessage:
+ * @capture: the capture, or NULL
+ * @client: ID of the client @msg comes from or goes to
+ * @msg: a complete, uncompressed message
+ * @outbound: whether @msg is sent by the server
+ *
+ * Keep a copy of the start of @msg if @capture is active.
+ */
+void
+virNetServerCaptureMessage(virNetServerCapturePtr capture,
+                           unsigned long long client,
+                           virNetMessagePtr msg,
+                           bool outbound)
+{
+    virNetServerCaptureRecordPtr rec;
+
+    if (!capture || !g_atomic_int_get(&capture->active))
+        return;
+
+    virObjectLock(capture);
+
+    if (!capture->active ||
+        msg->header.serial % capture->sample != 0)
+        goto cleanup;
+
+    rec = g_new0(virNetServerCaptureRecord, 1);
+    rec->timestamp = g_get_real_time();
+    rec->client = client;
+    rec->outbound = outbound;
+    rec->length = msg->bufferLength;
+    rec->caplen = MIN(msg->bufferLength, capture->snaplen);
+    rec->data = g_memdup(msg->buffer, rec->caplen);
+
+    if (capture->tail)
+        capture->tail->next = rec;
+    else
+        capture->head = rec;
+    capture->tail = rec;
+    capture->size += rec->caplen;
+
+    while (capture->size > capture->maxSize && capture->head != capture->tail) {
+        rec = capture->head;
+        capture->head = rec->next;
+        capture->size -= rec->caplen;
+        virNetServerCaptureRecordFree(rec);
+    }
+
+ cleanup:
+    virObjectUnlock(capture);
+}
+
+
+static void
+virNetServerCaptureAppendU16(GByteArray *buf,
+                             uint16_t val)
+{
+    g_byte_array_append(buf, (const guint8 *) &val, sizeof(val));
+}
+
+
+static void
+virNetServerCaptureAppendU32(GByteArray *buf,
+                             uint32_t val)
+{
+    g_byte_array_append(buf, (const guint8 *) &val, sizeof(val));
+}
+
+
+/* Appends @len bytes of @data padded to 32 bits */
+static void
+virNetServerCaptureAppendPadded(GByteArray *buf,
+                                const void *data,
+                                size_t len)
+{
+    static const guint8 zeroes[4];
+
+    g_byte_array_append(buf, data, len);
+    g_byte_array_append(buf, zeroes, VIR_ROUND_UP(len, 4) - len);
+}
+
+
+static void
+virNetServerCaptureAppendOption(GByteArray *buf,
+                                uint16_t code,
+                                const void *data,
+                                size_t len)
+{
+    virNetServerCaptureAppendU16(buf, code);
+    virNetServerCaptureAppendU16(buf, len);
+    virNetServerCaptureAppendPadded(buf, data, len);
+}
+
+
+/* Appends a block of @type to @buf, @body being already padded */
+static void
+virNetServerCaptureAppendBlock(GByteArray *buf,
+                               uint32_t type,
+                               GByteArray *body)
+{
+    uint32_t len = body->len + 3 * sizeof(uint32_t);
+
+    virNetServerCaptureAppendU32(buf, type);
+    virNetServerCaptureAppendU32(buf, len);
+    g_byte_array_append(buf, body->data, body->len);
+    virNetServerCaptureAppendU32(buf, len);
+}
+
+
+static void
+virNetServerCaptureFormatHeader(GByteArray *buf,
+                                unsigned int snaplen)
+{
+    g_autoptr(GByteArray) body = g_byte_array_new();
+
+    virNetServerCaptureAppendU32(body, PCAPNG_BYTE_ORDER_MAGIC);
+    virNetServerCaptureAppendU16(body, 1);     /* major version */
+    virNetServerCaptureAppendU16(body, 0);     /* minor version */
+    virNetServerCaptureAppendU32(body, UINT32_MAX); /* unknown length */
+    virNetServerCaptureAppendU32(body, UINT32_MAX);
+    virNetServerCaptureAppendBlock(buf, PCAPNG_BLOCK_SECTION_HEADER, body);
+
+    g_byte_array_set_size(body, 0);
+    virNetServerCaptureAppendU16(body, PCAPNG_LINKTYPE_WIRESHARK_UPPER_PDU);
+    virNetServerCaptureAppendU16(body, 0);
+    virNetServerCaptureAppendU32(body, snaplen);
+    virNetServerCaptureAppendBlock(buf, PCAPNG_BLOCK_INTERFACE, body);
+}
+
+
+static void
+virNetServerCaptureFormatRecord(GByteArray *buf,
+                                virNetServerCaptureRecordPtr rec)
+{
+    g_autoptr(GByteArray) body = g_byte_array_new();
+    g_autoptr(GByteArray) pdu = g_byte_array_new();
+    g_autofree char *comment = g_strdup_printf("client %llu", rec->client);
+    uint32_t flags = rec->outbound ? PCAPNG_EPB_FLAGS_OUTBOUND :
+                                     PCAPNG_EPB_FLAGS_INBOUND;
+    size_t taglen = VIR_ROUND_UP(strlen(PCAPNG_EXPORTED_PDU_PROTO), 4);
+
+    /* The tags of exported PDUs are in network byte order */
+    virNetServerCaptureAppendU16(pdu, GUINT16_TO_BE(PCAPNG_EXPORTED_PDU_TAG_PROTO_NAME));
+    virNetServerCaptureAppendU16(pdu, GUINT16_TO_BE(taglen));
+    virNetServerCaptureAppendPadded(pdu, PCAPNG_EXPORTED_PDU_PROTO,
+                                    strlen(PCAPNG_EXPORTED_PDU_PROTO));
+    virNetServerCaptureAppendU16(pdu, GUINT16_TO_BE(PCAPNG_EXPORTED_PDU_TAG_END));
+    virNetServerCaptureAppendU16(pdu, 0);
+
+    virNetServerCaptureAppendU32(body, 0);     /* interface */
+    virNetServerCaptureAppendU32(body, (uint64_t) rec->timestamp >> 32);
+    virNetServerCaptureAppendU32(body, (uint64_t) rec->timestamp & UINT32_MAX);
+    virNetServerCaptureAppendU32(body, pdu->len + rec->caplen);
+    virNetServerCaptureAppendU32(body, pdu->len + rec->length);
+    g_byte_array_append(pdu, (const guint8 *) rec->data, rec->caplen);
+    virNetServerCaptureAppendPadded(body, pdu->data, pdu->len);
+
+    virNetServerCaptureAppendOption(body, PCAPNG_OPT_COMMENT,
+                                    comment, strlen(comment));
+    virNetServerCaptureAppendOption(body, PCAPNG_OPT_EPB_FLAGS,
+                                    &flags, sizeof(flags));
+    virNetServerCaptureAppendOption(body, PCAPNG_OPT_END, NULL, 0);
+
+    virNetServerCaptureAppendBlock(buf, PCAPNG_BLOCK_ENHANCED_PACKET, body);
+}
+
+
+static int
+virNetServerCaptureWrite(int fd,
+                         const void *opaque)
+{
+    const GByteArray *buf = opaque;
+
+    if (safewrite(fd, buf->data, buf->len) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * virNetServerCaptureSave:
+ * @capture: the capture
+ * @path: the file to write
+ *
+ * Write the messages kept by @capture to @path in the pcapng format,
+ * which wireshark decodes with the libvirt dissector.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virNetServerCaptureSave(virNetServerCapturePtr capture,
+                        const char *path)
+{
+    g_autoptr(GByteArray) buf = g_byte_array_new();
+    virNetServerCaptureRecordPtr rec;
+
+    /* Format under the lock, but leave the I/O until it is released */
+    virObjectLock(capture);
+    virNetServerCaptureFormatHeader(buf, capture->snaplen);
+    for (rec = capture->head; rec; rec = rec->next)
+        virNetServerCaptureFormatRecord(buf, rec);
+    virObjectUnlock(capture);
+
+    if (virFileRewrite(path, S_IRUSR | S_IWUSR,
+                       virNetServerCaptureWrite, buf) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static void
+virNetServerCaptureDispose(void *obj)
+{
+    virNetServerCapturePtr capture = obj;
+
+    virNetServerCaptureClearLocked(capture);
+}
@@ -0,0 +1,46 @@
+/*
+ * virnetservercapture.h: capture of the RPC messages of a server
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "virnetmessage.h"
+#include "virobject.h"
+
+/* Defaults used when starting a capture */
+#define VIR_NET_SERVER_CAPTURE_SIZE_DEFAULT (16 * 1024 * 1024)
+#define VIR_NET_SERVER_CAPTURE_SNAPLEN_DEFAULT 4096
+
+typedef struct _virNetServerCapture virNetServerCapture;
+typedef virNetServerCapture *virNetServerCapturePtr;
+
+virNetServerCapturePtr virNetServerCaptureNew(void);
+
+void virNetServerCaptureStart(virNetServerCapturePtr capture,
+                              unsigned long long size,
+                              unsigned int snaplen,
+                              unsigned int sample);
+void virNetServerCaptureStop(virNetServerCapturePtr capture);
+bool virNetServerCaptureIsActive(virNetServerCapturePtr capture);
+
+void virNetServerCaptureMessage(virNetServerCapturePtr capture,
+                                unsigned long long client,
+                                virNetMessagePtr msg,
+                                bool outbound);
+
+int virNetServerCaptureSave(virNetServerCapturePtr capture,
+                            const char *path);
@@ -40,6 +40,10 @@
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+/* Enough to cycle messages of a client with default request
+ * limits without going to the server's pool */
+#define VIR_NET_SERVER_CLIENT_MESSAGE_POOL_MAX 8
+
 VIR_LOG_INIT("rpc.netserverclient");
 
 /* Allow for filtering of incoming messages to a custom
@@ -71,6 +75,8 @@ struct _virNetServerClient
     int auth;
     bool auth_pending;
     bool readonly;
+    /* Whether the client agreed on compressed payloads */
+    bool compress;
     virNetTLSContextPtr tlsCtxt;
     virNetTLSSessionPtr tls;
 #if WITH_SASL
@@ -99,15 +105,28 @@ struct _virNetServerClient
     /* Zero or one messages being received. Zero if
      * nrequests >= max_clients and throttling */
     virNetMessagePtr rx;
+    /* Free lists for the messages of this client, backed
+     * by the server's pool once it adds the client */
+    virNetMessagePoolPtr msgPool;
     /* Zero or many messages waiting for transmit
      * back to client, including async events */
     virNetMessagePtr tx;
+    /* Count of async events in the 'tx' queue, the limit
+     * above which further events are dropped, or 0 for no
+     * limit, and the number of events dropped since the
+     * queue was last below the limit */
+    size_t nevents;
+    size_t nevents_max;
+    size_t nevents_dropped;
 
     /* Filters to capture messages that would otherwise
      * end up on the 'dx' queue */
     virNetServerClientFilterPtr filters;
     int nextFilterID;
 
+    /* Capture of the messages of the server, if any */
+    virNetServerCapturePtr capture;
+
     virNetServerClientDispatchFunc dispatchFunc;
     void *dispatchOpaque;
 
@@ -311,10 +330,7 @@ virNetServerClientCheckAccess(virNetServerClientPtr client)
      * (NB. The '\1' byte is sent in an encrypted record).
      */
     confirm->bufferLength = 1;
-    if (VIR_ALLOC_N(confirm->buffer, confirm->bufferLength) < 0) {
-        virNetMessageFree(confirm);
-        return -1;
-    }
+    virNetMessageReserve(confirm, confirm->bufferLength);
     confirm->bufferOffset = 0;
     confirm->buffer[0] = '\1';
 
@@ -410,12 +426,14 @@ virNetServerClientNewInternal(unsigned long long id,
     if (client->sockTimer < 0)
         goto error;
 
+    if (!(client->msgPool = virNetMessagePoolNew(VIR_NET_SERVER_CLIENT_MESSAGE_POOL_MAX)))
+        goto error;
+
     /* Prepare one for packet receive */
-    if (!(client->rx = virNetMessageNew(true)))
+    if (!(client->rx = virNetMessageNewPooled(client->msgPool, true)))
         goto error;
     client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-    if (VIR_ALLOC_N(client->rx->buffer, client->rx->bufferLength) < 0)
-        goto error;
+    virNetMessageReserve(client->rx, client->rx->bufferLength);
     client->nrequests = 1;
 
     PROBE(RPC_SERVER_CLIENT_NEW,
@@ -677,6 +695,50 @@ virNetServerClientSetReadonly(virNetServerClientPtr client,
 }
 
 
+/*
+ * Makes @client compress large payloads of the messages sent to it
+ * from now on. It is not persisted across daemon restarts, which is
+ * fine as compressed messages are only ever optional.
+ */
+void
+virNetServerClientSetCompression(virNetServerClientPtr client,
+                                 bool compress)
+{
+    virObjectLock(client);
+    client->compress = compress;
+    virObjectUnlock(client);
+}
+
+
+/*
+ * Makes @client hand its messages to @capture, which keeps them only
+ * while it is active.
+ */
+void
+virNetServerClientSetCapture(virNetServerClientPtr client,
+                             virNetServerCapturePtr capture)
+{
+    virObjectLock(client);
+    virObjectUnref(client->capture);
+    client->capture = virObjectRef(capture);
+    virObjectUnlock(client);
+}
+
+
+/*
+ * Limits the number of events waiting to be sent to @client, see
+ * virNetServerClientSendEvent. Zero means no limit.
+ */
+void
+virNetServerClientSetMaxEvents(virNetServerClientPtr client,
+                               size_t max)
+{
+    virObjectLock(client);
+    client->nevents_max = max;
+    virObjectUnlock(client);
+}
+
+
 unsigned long long virNetServerClientGetID(virNetServerClientPtr client)
 {
     return client->id;
@@ -687,6 +749,21 @@ long long virNetServerClientGetTimestamp(virNetServerClientPtr client)
     return client->conn_time;
 }
 
+virNetMessagePoolPtr virNetServerClientGetMessagePool(virNetServerClientPtr client)
+{
+    return client->msgPool;
+}
+
+/*
+ * Creates a message for @client, reusing memory of its
+ * earlier messages.
+ */
+virNetMessagePtr virNetServerClientNewMessage(virNetServerClientPtr client,
+                                              bool tracked)
+{
+    return virNetMessageNewPooled(client->msgPool, tracked);
+}
+
 bool virNetServerClientHasTLSSession(virNetServerClientPtr client)
 {
     bool has;
@@ -986,6 +1063,8 @@ void virNetServerClientDispose(void *obj)
     virObjectUnref(client->tls);
     virObjectUnref(client->tlsCtxt);
     virObjectUnref(client->sock);
+    virObjectUnref(client->msgPool);
+    virObjectUnref(client->capture);
 }
 
 
@@ -1269,6 +1348,7 @@ static virNetMessagePtr virNetServerClientDispatchRead(virNetServerClientPtr cli
               client, msg->bufferLength,
               msg->header.prog, msg->header.vers, msg->header.proc,
               msg->header.type, msg->header.status, msg->header.serial);
+        virNetServerCaptureMessage(client->capture, client->id, msg, false);
 
         if (virKeepAliveCheckMessage(client->keepalive, msg, &response)) {
             virNetMessageFree(msg);
@@ -1302,16 +1382,12 @@ static virNetMessagePtr virNetServerClientDispatchRead(virNetServerClientPtr cli
 
         /* Possibly need to create another receive buffer */
         if (client->nrequests < client->nrequests_max) {
-            if (!(client->rx = virNetMessageNew(true))) {
+            if (!(client->rx = virNetMessageNewPooled(client->msgPool, true))) {
                 client->wantClose = true;
             } else {
                 client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-                if (VIR_ALLOC_N(client->rx->buffer,
-                                client->rx->bufferLength) < 0) {
-                    client->wantClose = true;
-                } else {
-                    client->nrequests++;
-                }
+                virNetMessageReserve(client->rx, client->rx->bufferLength);
+                client->nrequests++;
             }
         }
         virNetServerClientUpdateEvent(client);
@@ -1322,7 +1398,10 @@ static virNetMessagePtr virNetServerClientDispatchRead(virNetServerClientPtr cli
 
 
 /*
- * Send client->tx using no encoding
+ * Send client->tx using no encoding. The data of the messages queued
+ * behind client->tx is sent along in a single write, up to the first
+ * message which passes FDs or switches the connection to SASL, since
+ * those need to complete before anything else can follow.
  *
  * Returns:
  *   -1 on error or EOF
@@ -1331,7 +1410,11 @@ static virNetMessagePtr virNetServerClientDispatchRead(virNetServerClientPtr cli
  */
 static ssize_t virNetServerClientWrite(virNetServerClientPtr client)
 {
+    GOutputVector vec[VIR_NET_SOCKET_IOV_MAX];
+    virNetMessagePtr msg;
+    size_t nvec = 0;
     ssize_t ret;
+    ssize_t left;
 
     if (client->tx->bufferLength < client->tx->bufferOffset) {
         virReportError(VIR_ERR_RPC,
@@ -1344,13 +1427,33 @@ static ssize_t virNetServerClientWrite(virNetServerClientPtr client)
     if (client->tx->bufferLength == client->tx->bufferOffset)
         return 1;
 
-    ret = virNetSocketWrite(client->sock,
-                            client->tx->buffer + client->tx->bufferOffset,
-                            client->tx->bufferLength - client->tx->bufferOffset);
+    for (msg = client->tx; msg && nvec < G_N_ELEMENTS(vec); msg = msg->next) {
+        if (msg->bufferLength <= msg->bufferOffset)
+            break;
+
+        vec[nvec].buffer = msg->buffer + msg->bufferOffset;
+        vec[nvec].size = msg->bufferLength - msg->bufferOffset;
+        nvec++;
+
+        if (msg->nfds)
+            break;
+#if WITH_SASL
+        if (client->sasl)
+            break;
+#endif
+    }
+
+    ret = virNetSocketWritev(client->sock, vec, nvec);
     if (ret <= 0)
         return ret; /* -1 error, 0 = egain */
 
-    client->tx->bufferOffset += ret;
+    for (msg = client->tx, left = ret; msg && left > 0; msg = msg->next) {
+        size_t n = MIN(left, msg->bufferLength - msg->bufferOffset);
+
+        msg->bufferOffset += n;
+        left -= n;
+    }
+
     return ret;
 }
 
@@ -1403,6 +1506,16 @@ virNetServerClientDispatchWrite(virNetServerClientPtr client)
             /* Get finished msg from head of tx queue */
             msg = virNetMessageQueueServe(&client->tx);
 
+            if (msg->event) {
+                client->nevents--;
+                if (client->nevents_dropped &&
+                    client->nevents < client->nevents_max) {
+                    VIR_WARN("Dropped %zu events of client %llu",
+                             client->nevents_dropped, client->id);
+                    client->nevents_dropped = 0;
+                }
+            }
+
             if (msg->tracked) {
                 client->nrequests--;
                 /* See if the recv queue is currently throttled */
@@ -1411,10 +1524,7 @@ virNetServerClientDispatchWrite(virNetServerClientPtr client)
                     /* Ready to recv more messages */
                     virNetMessageClear(msg);
                     msg->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-                    if (VIR_ALLOC_N(msg->buffer, msg->bufferLength) < 0) {
-                        virNetMessageFree(msg);
-                        return;
-                    }
+                    virNetMessageReserve(msg, msg->bufferLength);
                     client->rx = msg;
                     msg = NULL;
                     client->nrequests++;
@@ -1511,6 +1621,12 @@ virNetServerClientSendMessageLocked(virNetServerClientPtr client,
 
     msg->donefds = 0;
     if (client->sock && !client->wantClose) {
+        virNetServerCaptureMessage(client->capture, client->id, msg, true);
+
+        if (client->compress &&
+            virNetMessageCompress(msg) < 0)
+            return -1;
+
         PROBE(RPC_SERVER_CLIENT_MSG_TX_QUEUE,
               "client=%p len=%zu prog=%u vers=%u proc=%u type=%u status=%u serial=%u",
               client, msg->bufferLength,
@@ -1537,6 +1653,87 @@ int virNetServerClientSendMessage(virNetServerClientPtr client,
     return ret;
 }
 
+/*
+ * Drops the event queued on @client with the same key as @msg, if
+ * it hasn't started to be sent yet. Only the latest state is of
+ * interest for such events, so there's no point in sending old ones
+ * to a client which is lagging behind.
+ */
+static void
+virNetServerClientCoalesceEventLocked(virNetServerClientPtr client,
+                                      virNetMessagePtr msg)
+{
+    virNetMessagePtr prev = client->tx;
+    virNetMessagePtr tmp;
+
+    if (!prev)
+        return;
+
+    /* The head of the queue may be partially sent already */
+    for (tmp = prev->next; tmp; prev = tmp, tmp = tmp->next) {
+        if (!tmp->event || tmp->bufferOffset > 0 ||
+            STRNEQ_NULLABLE(tmp->eventKey, msg->eventKey))
+            continue;
+
+        VIR_DEBUG("Replacing event msg=%p key=%s", tmp, tmp->eventKey);
+        prev->next = tmp->next;
+        tmp->next = NULL;
+        virNetMessageFree(tmp);
+        client->nevents--;
+        return;
+    }
+}
+
+
+/**
+ * virNetServerClientSendEvent:
+ * @client: the client
+ * @msg: the encoded event message
+ * @key: identifies events which supersede each other, or NULL
+ *
+ * Queues the asynchronous event @msg for @client. If @key is set, an
+ * event with the same @key still waiting to be sent is replaced by
+ * @msg. Once the number of queued events reaches the limit set by
+ * virNetServerClientSetMaxEvents, further events are dropped until
+ * the client catches up.
+ *
+ * Returns 0 on success, -1 if @msg wasn't queued. In the latter case
+ * the caller still owns @msg.
+ */
+int
+virNetServerClientSendEvent(virNetServerClientPtr client,
+                            virNetMessagePtr msg,
+                            const char *key)
+{
+    int ret = -1;
+
+    virObjectLock(client);
+
+    msg->event = true;
+    msg->eventKey = g_strdup(key);
+
+    if (key)
+        virNetServerClientCoalesceEventLocked(client, msg);
+
+    if (client->nevents_max &&
+        client->nevents >= client->nevents_max) {
+        if (client->nevents_dropped++ == 0)
+            VIR_WARN("Client %llu isn't reading its events, dropping them",
+                     client->id);
+        goto cleanup;
+    }
+
+    if (virNetServerClientSendMessageLocked(client, msg) < 0)
+        goto cleanup;
+
+    client->nevents++;
+    ret = 0;
+
+ cleanup:
+    virObjectUnlock(client);
+    return ret;
+}
+
 
 bool
 virNetServerClientIsAuthenticated(virNetServerClientPtr client)
@@ -24,6 +24,7 @@
 #include "viridentity.h"
 #include "virnetsocket.h"
 #include "virnetmessage.h"
+#include "virnetservercapture.h"
 #include "virobject.h"
 #include "virjson.h"
 
@@ -98,8 +99,17 @@ int virNetServerClientGetAuth(virNetServerClientPtr client);
 void virNetServerClientSetAuthLocked(virNetServerClientPtr client, int auth);
 bool virNetServerClientGetReadonly(virNetServerClientPtr client);
 void virNetServerClientSetReadonly(virNetServerClientPtr client, bool readonly);
+void virNetServerClientSetCompression(virNetServerClientPtr client,
+                                      bool compress);
+void virNetServerClientSetMaxEvents(virNetServerClientPtr client,
+                                    size_t max);
+void virNetServerClientSetCapture(virNetServerClientPtr client,
+                                  virNetServerCapturePtr capture);
 unsigned long long virNetServerClientGetID(virNetServerClientPtr client);
 long long virNetServerClientGetTimestamp(virNetServerClientPtr client);
+virNetMessagePoolPtr virNetServerClientGetMessagePool(virNetServerClientPtr client);
+virNetMessagePtr virNetServerClientNewMessage(virNetServerClientPtr client,
+                                              bool tracked);
 
 bool virNetServerClientHasTLSSession(virNetServerClientPtr client);
 virNetTLSSessionPtr virNetServerClientGetTLSSession(virNetServerClientPtr client);
@@ -162,6 +172,9 @@ const char *virNetServerClientRemoteAddrStringURI(virNetServerClientPtr client);
 
 int virNetServerClientSendMessage(virNetServerClientPtr client,
                                   virNetMessagePtr msg);
+int virNetServerClientSendEvent(virNetServerClientPtr client,
+                                virNetMessagePtr msg,
+                                const char *key);
 
 bool virNetServerClientIsAuthenticated(virNetServerClientPtr client);
 bool virNetServerClientIsAuthPendingLocked(virNetServerClientPtr client);
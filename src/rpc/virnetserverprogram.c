@@ -41,6 +41,9 @@ struct _virNetServerProgram {
     unsigned version;
     virNetServerProgramProcPtr procs;
     size_t nprocs;
+
+    /* Indexed by procedure, updated atomically */
+    virNetServerProgramProcStatsPtr stats;
 };
 
 
@@ -75,6 +78,7 @@ virNetServerProgramPtr virNetServerProgramNew(unsigned program,
     prog->version = version;
     prog->procs = procs;
     prog->nprocs = nprocs;
+    prog->stats = g_new0(virNetServerProgramProcStats, nprocs);
 
     VIR_DEBUG("prog=%p", prog);
 
@@ -134,6 +138,87 @@ virNetServerProgramGetPriority(virNetServerProgramPtr prog,
     return proc->priority;
 }
 
+
+static size_t
+virNetServerProgramHistBucket(unsigned long long usecs)
+{
+    size_t bucket = 0;
+
+    while (usecs >= 10 && bucket < VIR_NET_SERVER_PROGRAM_HIST_BUCKETS - 1) {
+        usecs /= 10;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+
+/* Accounts a call to @procedure which waited in the queue since @queued
+ * and started executing at @start */
+static void
+virNetServerProgramRecordCall(virNetServerProgramPtr prog,
+                              int procedure,
+                              gint64 queued,
+                              gint64 start,
+                              bool failed)
+{
+    virNetServerProgramProcStatsPtr stats = &prog->stats[procedure];
+    unsigned long long queueTime = queued ? MAX(start - queued, 0) : 0;
+    unsigned long long execTime = MAX(g_get_monotonic_time() - start, 0);
+
+    __atomic_add_fetch(&stats->calls, 1, __ATOMIC_RELAXED);
+    if (failed)
+        __atomic_add_fetch(&stats->errors, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->queueTime, queueTime, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->execTime, execTime, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->queueHist[virNetServerProgramHistBucket(queueTime)],
+                       1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->execHist[virNetServerProgramHistBucket(execTime)],
+                       1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * virNetServerProgramGetProcStats:
+ * @prog: the program
+ * @stats: filled with a newly allocated list of statistics
+ *
+ * Collects the statistics of the procedures of @prog which were called
+ * at least once.
+ *
+ * Returns the number of procedures in @stats
+ */
+size_t
+virNetServerProgramGetProcStats(virNetServerProgramPtr prog,
+                                virNetServerProgramProcStatsPtr *stats)
+{
+    size_t nstats = 0;
+    size_t i;
+    size_t j;
+
+    *stats = g_new0(virNetServerProgramProcStats, prog->nprocs);
+
+    for (i = 0; i < prog->nprocs; i++) {
+        virNetServerProgramProcStatsPtr src = &prog->stats[i];
+        virNetServerProgramProcStatsPtr dst = &(*stats)[nstats];
+
+        if (!(dst->calls = __atomic_load_n(&src->calls, __ATOMIC_RELAXED)))
+            continue;
+
+        dst->procedure = i;
+        dst->errors = __atomic_load_n(&src->errors, __ATOMIC_RELAXED);
+        dst->queueTime = __atomic_load_n(&src->queueTime, __ATOMIC_RELAXED);
+        dst->execTime = __atomic_load_n(&src->execTime, __ATOMIC_RELAXED);
+        for (j = 0; j < VIR_NET_SERVER_PROGRAM_HIST_BUCKETS; j++) {
+            dst->queueHist[j] = __atomic_load_n(&src->queueHist[j], __ATOMIC_RELAXED);
+            dst->execHist[j] = __atomic_load_n(&src->execHist[j], __ATOMIC_RELAXED);
+        }
+        nstats++;
+    }
+
+    return nstats;
+}
+
 static int
 virNetServerProgramSendError(unsigned program,
                              unsigned version,
@@ -368,10 +453,13 @@ virNetServerProgramDispatchCall(virNetServerProgramPtr prog,
     g_autofree char *arg = NULL;
     g_autofree char *ret = NULL;
     int rv = -1;
-    virNetServerProgramProcPtr dispatcher;
+    virNetServerProgramProcPtr dispatcher = NULL;
     virNetMessageError rerr;
     size_t i;
     g_autoptr(virIdentity) identity = NULL;
+    int procedure = msg->header.proc;
+    gint64 queued = msg->queued;
+    gint64 start = g_get_monotonic_time();
 
     memset(&rerr, 0, sizeof(rerr));
 
@@ -480,10 +568,15 @@ virNetServerProgramDispatchCall(virNetServerProgramPtr prog,
 
     xdr_free(dispatcher->ret_filter, ret);
 
+    virNetServerProgramRecordCall(prog, procedure, queued, start, false);
+
     /* Put reply on end of tx queue to send out  */
     return virNetServerClientSendMessage(client, msg);
 
  error:
+    if (dispatcher)
+        virNetServerProgramRecordCall(prog, procedure, queued, start, true);
+
     /* Bad stuff (de-)serializing message, but we have an
      * RPC error message we can send back to the client */
     rv = virNetServerProgramSendReplyError(prog, client, msg, &rerr, &msg->header);
@@ -534,6 +627,55 @@ int virNetServerProgramSendStreamData(virNetServerProgramPtr prog,
 }
 
 
+/*
+ * Encodes the header of a stream data packet into @msg and makes
+ * room for up to @len bytes of data after it, so that the caller can
+ * read the data straight into the message rather than copying it in
+ * afterwards. The packet is sent once filled in by
+ * virNetServerProgramSendPreparedStreamData.
+ *
+ * Returns the location to store the data at, or NULL on error.
+ */
+char *virNetServerProgramPrepareStreamData(virNetServerProgramPtr prog,
+                                           virNetMessagePtr msg,
+                                           int procedure,
+                                           unsigned int serial,
+                                           size_t len)
+{
+    VIR_DEBUG("msg=%p len=%zu", msg, len);
+
+    msg->header.prog = prog->program;
+    msg->header.vers = prog->version;
+    msg->header.proc = procedure;
+    msg->header.type = VIR_NET_STREAM;
+    msg->header.serial = serial;
+    msg->header.status = VIR_NET_CONTINUE;
+
+    virNetMessageReserve(msg, VIR_NET_MESSAGE_LEN_MAX +
+                         VIR_NET_MESSAGE_HEADER_MAX + len);
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        return NULL;
+
+    return virNetMessagePayloadRawBuffer(msg, len);
+}
+
+
+int virNetServerProgramSendPreparedStreamData(virNetServerClientPtr client,
+                                              virNetMessagePtr msg,
+                                              size_t len)
+{
+    VIR_DEBUG("client=%p msg=%p len=%zu", client, msg, len);
+
+    if (virNetMessageEncodePayloadRawLen(msg, len) < 0)
+        return -1;
+
+    VIR_DEBUG("Total %zu", msg->bufferLength);
+
+    return virNetServerClientSendMessage(client, msg);
+}
+
+
 int virNetServerProgramSendStreamHole(virNetServerProgramPtr prog,
                                       virNetServerClientPtr client,
                                       virNetMessagePtr msg,
@@ -569,6 +711,9 @@ int virNetServerProgramSendStreamHole(virNetServerProgramPtr prog,
 }
 
 
-void virNetServerProgramDispose(void *obj G_GNUC_UNUSED)
+void virNetServerProgramDispose(void *obj)
 {
+    virNetServerProgramPtr prog = obj;
+
+    g_free(prog->stats);
 }
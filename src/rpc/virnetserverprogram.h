@@ -54,6 +54,25 @@ struct _virNetServerProgramProc {
     unsigned int priority;
 };
 
+/* Number of buckets of the latency histograms. Bucket N counts the calls
+ * which took less than 10^(N+1) microseconds, the last bucket counts all
+ * the slower ones. */
+#define VIR_NET_SERVER_PROGRAM_HIST_BUCKETS 8
+
+typedef struct _virNetServerProgramProcStats virNetServerProgramProcStats;
+typedef virNetServerProgramProcStats *virNetServerProgramProcStatsPtr;
+
+/* All the times are in microseconds */
+struct _virNetServerProgramProcStats {
+    int procedure;
+    unsigned long long calls;
+    unsigned long long errors;
+    unsigned long long queueTime;
+    unsigned long long execTime;
+    unsigned long long queueHist[VIR_NET_SERVER_PROGRAM_HIST_BUCKETS];
+    unsigned long long execHist[VIR_NET_SERVER_PROGRAM_HIST_BUCKETS];
+};
+
 virNetServerProgramPtr virNetServerProgramNew(unsigned program,
                                               unsigned version,
                                               virNetServerProgramProcPtr procs,
@@ -65,6 +84,9 @@ int virNetServerProgramGetVersion(virNetServerProgramPtr prog);
 unsigned int virNetServerProgramGetPriority(virNetServerProgramPtr prog,
                                             int procedure);
 
+size_t virNetServerProgramGetProcStats(virNetServerProgramPtr prog,
+                                       virNetServerProgramProcStatsPtr *stats);
+
 int virNetServerProgramMatches(virNetServerProgramPtr prog,
                                virNetMessagePtr msg);
 
@@ -98,6 +120,16 @@ int virNetServerProgramSendStreamData(virNetServerProgramPtr prog,
                                       const char *data,
                                       size_t len);
 
+char *virNetServerProgramPrepareStreamData(virNetServerProgramPtr prog,
+                                           virNetMessagePtr msg,
+                                           int procedure,
+                                           unsigned int serial,
+                                           size_t len);
+
+int virNetServerProgramSendPreparedStreamData(virNetServerClientPtr client,
+                                              virNetMessagePtr msg,
+                                              size_t len);
+
 int virNetServerProgramSendStreamHole(virNetServerProgramPtr prog,
                                       virNetServerClientPtr client,
                                       virNetMessagePtr msg,
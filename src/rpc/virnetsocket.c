@@ -22,6 +22,9 @@
 #include <config.h>
 
 #include <sys/stat.h>
+#ifndef WIN32
+# include <sys/uio.h>
+#endif
 #include <unistd.h>
 #include <signal.h>
 #include <fcntl.h>
@@ -2016,6 +2019,90 @@ ssize_t virNetSocketWrite(virNetSocketPtr sock, const char *buf, size_t len)
 }
 
 
+/*
+ * Plain sockets write all of @vec at once, TLS sessions coalesce it into
+ * a single record. SSH tunnels and SASL, which has to encode every
+ * buffer separately anyway, only write the first buffer.
+ *
+ * Returns the number of bytes written from the start of @vec,
+ * 0 on EAGAIN, -1 on error
+ */
+ssize_t virNetSocketWritev(virNetSocketPtr sock,
+                           const GOutputVector *vec,
+                           size_t nvec)
+{
+    ssize_t ret;
+    bool single = nvec == 1;
+#ifndef WIN32
+    struct iovec iov[VIR_NET_SOCKET_IOV_MAX];
+    size_t i;
+#endif
+
+    if (nvec == 0)
+        return 0;
+
+    virObjectLock(sock);
+
+#if WITH_SASL
+    if (sock->saslSession)
+        single = true;
+#endif
+#if WITH_SSH2
+    if (sock->sshSession)
+        single = true;
+#endif
+#if WITH_LIBSSH
+    if (sock->libsshSession)
+        single = true;
+#endif
+
+    if (single) {
+        virObjectUnlock(sock);
+        return virNetSocketWrite(sock, vec[0].buffer, vec[0].size);
+    }
+
+ rewrite:
+    if (sock->tlsSession &&
+        virNetTLSSessionGetHandshakeStatus(sock->tlsSession) ==
+        VIR_NET_TLS_HANDSHAKE_COMPLETE) {
+        ret = virNetTLSSessionWritev(sock->tlsSession, vec, nvec);
+    } else {
+#ifndef WIN32
+        nvec = MIN(nvec, VIR_NET_SOCKET_IOV_MAX);
+        for (i = 0; i < nvec; i++) {
+            iov[i].iov_base = (void *) vec[i].buffer;
+            iov[i].iov_len = vec[i].size;
+        }
+        ret = writev(sock->fd, iov, nvec);
+#else
+        ret = write(sock->fd, vec[0].buffer, vec[0].size);
+#endif
+    }
+
+    if (ret < 0) {
+        if (errno == EINTR)
+            goto rewrite;
+        if (errno == EAGAIN) {
+            ret = 0;
+            goto cleanup;
+        }
+
+        virReportSystemError(errno, "%s",
+                             _("Cannot write data"));
+        goto cleanup;
+    }
+    if (ret == 0) {
+        virReportSystemError(EIO, "%s",
+                             _("End of file while writing data"));
+        ret = -1;
+    }
+
+ cleanup:
+    virObjectUnlock(sock);
+    return ret;
+}
+
+
 /*
  * Returns 1 if an FD was sent, 0 if it would block, -1 on error
  */
@@ -144,8 +144,14 @@ int virNetSocketSetBlocking(virNetSocketPtr sock,
 
 void virNetSocketSetQuietEOF(virNetSocketPtr sock);
 
+/* Most buffers virNetSocketWritev passes to the kernel at once */
+#define VIR_NET_SOCKET_IOV_MAX 64
+
 ssize_t virNetSocketRead(virNetSocketPtr sock, char *buf, size_t len);
 ssize_t virNetSocketWrite(virNetSocketPtr sock, const char *buf, size_t len);
+ssize_t virNetSocketWritev(virNetSocketPtr sock,
+                           const GOutputVector *vec,
+                           size_t nvec);
 
 int virNetSocketSendFD(virNetSocketPtr sock, int fd);
 int virNetSocketRecvFD(virNetSocketPtr sock, int *fd);
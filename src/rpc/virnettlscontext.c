@@ -30,8 +30,10 @@
 #include "virstring.h"
 
 #include "viralloc.h"
+#include "virbuffer.h"
 #include "virerror.h"
 #include "virfile.h"
+#include "virhash.h"
 #include "virutil.h"
 #include "virlog.h"
 #include "virprobe.h"
@@ -40,6 +42,11 @@
 
 #define DH_BITS 2048
 
+/* How long, in seconds, a peer certificate chain which passed validation
+ * is accepted without validating it again, and how many are remembered */
+#define VIR_NET_TLS_CERT_CACHE_TTL 300
+#define VIR_NET_TLS_CERT_CACHE_MAX 1024
+
 #define LIBVIRT_PKI_DIR SYSCONFDIR "/pki"
 #define LIBVIRT_CACERT LIBVIRT_PKI_DIR "/CA/cacert.pem"
 #define LIBVIRT_CACRL LIBVIRT_PKI_DIR "/CA/cacrl.pem"
@@ -62,6 +69,21 @@ struct _virNetTLSContext {
     bool requireValidCert;
     const char *const*x509dnWhitelist;
     char *priority;
+
+    /* server only: key encrypting the session tickets handed to clients */
+    gnutls_datum_t ticketKey;
+    /* client only: data resuming the last session with each host */
+    virHashTablePtr sessions;
+    /* virNetTLSCertCacheEntry of the peer certificate chains which passed
+     * validation recently, see virNetTLSContextCertCacheKey */
+    virHashTablePtr validCerts;
+};
+
+typedef struct _virNetTLSCertCacheEntry virNetTLSCertCacheEntry;
+typedef virNetTLSCertCacheEntry *virNetTLSCertCacheEntryPtr;
+struct _virNetTLSCertCacheEntry {
+    char *dname;
+    time_t expires;
 };
 
 struct _virNetTLSSession {
@@ -76,8 +98,17 @@ struct _virNetTLSSession {
     virNetTLSSessionReadFunc readFunc;
     void *opaque;
     char *x509dname;
+
+    /* scratch buffer for coalescing writes into a single record */
+    char *txbuf;
+
+    /* client only: context the resumption data is saved in */
+    virNetTLSContextPtr ctxt;
 };
 
+/* Maximum payload of a single TLS record */
+#define VIR_NET_TLS_SESSION_RECORD_MAX 16384
+
 static virClassPtr virNetTLSContextClass;
 static virClassPtr virNetTLSSessionClass;
 static void virNetTLSContextDispose(void *obj);
@@ -671,6 +702,32 @@ static int virNetTLSContextLoadCredentials(virNetTLSContextPtr ctxt,
 }
 
 
+static void
+virNetTLSCertCacheEntryFree(void *payload)
+{
+    virNetTLSCertCacheEntryPtr entry = payload;
+
+    if (!entry)
+        return;
+
+    g_free(entry->dname);
+    g_free(entry);
+}
+
+
+static void
+virNetTLSSessionDataFree(void *payload)
+{
+    gnutls_datum_t *data = payload;
+
+    if (!data)
+        return;
+
+    gnutls_free(data->data);
+    g_free(data);
+}
+
+
 static virNetTLSContextPtr virNetTLSContextNew(const char *cacert,
                                                const char *cacrl,
                                                const char *cert,
@@ -692,6 +749,23 @@ static virNetTLSContextPtr virNetTLSContextNew(const char *cacert,
 
     ctxt->priority = g_strdup(priority);
 
+    if (!(ctxt->validCerts = virHashCreate(16, virNetTLSCertCacheEntryFree)))
+        goto error;
+
+    /* Session tickets let clients resume their sessions without going
+     * through a full handshake and certificate exchange again */
+    if (isServer) {
+        err = gnutls_session_ticket_key_generate(&ctxt->ticketKey);
+        if (err < 0) {
+            virReportError(VIR_ERR_SYSTEM_ERROR,
+                           _("Unable to generate TLS session ticket key: %s"),
+                           gnutls_strerror(err));
+            goto error;
+        }
+    } else if (!(ctxt->sessions = virHashCreate(4, virNetTLSSessionDataFree))) {
+        goto error;
+    }
+
     err = gnutls_certificate_allocate_credentials(&ctxt->x509cred);
     if (err) {
         /* While gnutls_certificate_credentials_t will free any
@@ -754,6 +828,12 @@ static virNetTLSContextPtr virNetTLSContextNew(const char *cacert,
         gnutls_dh_params_deinit(ctxt->dhParams);
     if (ctxt->x509cred)
         gnutls_certificate_free_credentials(ctxt->x509cred);
+    if (ctxt->ticketKey.data) {
+        memset(ctxt->ticketKey.data, 0, ctxt->ticketKey.size);
+        gnutls_free(ctxt->ticketKey.data);
+    }
+    virHashFree(ctxt->sessions);
+    virHashFree(ctxt->validCerts);
     VIR_FREE(ctxt->priority);
     VIR_FREE(ctxt);
     return NULL;
@@ -955,6 +1035,12 @@ int virNetTLSContextReloadForServer(virNetTLSContextPtr ctxt,
 
     gnutls_certificate_free_credentials(x509credBak);
 
+    /* Certificates validated with the old CA or CRL have to be checked
+     * against the new ones */
+    virObjectLock(ctxt);
+    virHashRemoveAll(ctxt->validCerts);
+    virObjectUnlock(ctxt);
+
     return 0;
 
  error:
@@ -979,7 +1065,8 @@ virNetTLSContextPtr virNetTLSContextNewClient(const char *cacert,
 
 
 static int virNetTLSContextValidCertificate(virNetTLSContextPtr ctxt,
-                                            virNetTLSSessionPtr sess)
+                                            virNetTLSSessionPtr sess,
+                                            time_t *expires)
 {
     int ret;
     unsigned int status;
@@ -1054,6 +1141,8 @@ static int virNetTLSContextValidCertificate(virNetTLSContextPtr ctxt,
             goto authdeny;
         }
 
+        *expires = MIN(*expires, gnutls_x509_crt_get_expiration_time(cert));
+
         if (i == 0) {
             ret = gnutls_x509_crt_get_dn(cert, dname, &dnamesize);
             if (ret != 0) {
@@ -1117,14 +1206,112 @@ static int virNetTLSContextValidCertificate(virNetTLSContextPtr ctxt,
     return -1;
 }
 
+/*
+ * Returns the key the validation of the peer certificate chain of @sess
+ * is cached with: the SHA-256 digests of the certificates, and on the
+ * client the host name they were checked against. The TLS handshake
+ * proved that the peer holds the key of the first certificate.
+ */
+static char *
+virNetTLSContextCertCacheKey(virNetTLSSessionPtr sess)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    const gnutls_datum_t *certs;
+    unsigned int nCerts;
+    size_t i;
+    size_t j;
+
+    if (gnutls_certificate_type_get(sess->session) != GNUTLS_CRT_X509 ||
+        !(certs = gnutls_certificate_get_peers(sess->session, &nCerts)) ||
+        nCerts == 0)
+        return NULL;
+
+    virBufferAdd(&buf, NULLSTR_EMPTY(sess->hostname), -1);
+
+    for (i = 0; i < nCerts; i++) {
+        unsigned char digest[32];
+
+        if (gnutls_hash_fast(GNUTLS_DIG_SHA256, certs[i].data, certs[i].size,
+                             digest) < 0)
+            return NULL;
+
+        virBufferAddChar(&buf, ':');
+        for (j = 0; j < sizeof(digest); j++)
+            virBufferAsprintf(&buf, "%02x", digest[j]);
+    }
+
+    return virBufferContentAndReset(&buf);
+}
+
+
+static int
+virNetTLSCertCacheEntryExpired(const void *payload,
+                               const void *name G_GNUC_UNUSED,
+                               const void *opaque)
+{
+    const virNetTLSCertCacheEntry *entry = payload;
+    const time_t *now = opaque;
+
+    return entry->expires <= *now;
+}
+
+
+static void
+virNetTLSContextCacheValidCert(virNetTLSContextPtr ctxt,
+                               const char *key,
+                               const char *dname,
+                               time_t now,
+                               time_t expires)
+{
+    virNetTLSCertCacheEntryPtr entry;
+
+    if (virHashSize(ctxt->validCerts) >= VIR_NET_TLS_CERT_CACHE_MAX) {
+        virHashRemoveSet(ctxt->validCerts, virNetTLSCertCacheEntryExpired, &now);
+
+        if (virHashSize(ctxt->validCerts) >= VIR_NET_TLS_CERT_CACHE_MAX)
+            virHashRemoveAll(ctxt->validCerts);
+    }
+
+    entry = g_new0(virNetTLSCertCacheEntry, 1);
+    entry->dname = g_strdup(dname);
+    entry->expires = expires;
+
+    if (virHashUpdateEntry(ctxt->validCerts, key, entry) < 0) {
+        virNetTLSCertCacheEntryFree(entry);
+        virResetLastError();
+    }
+}
+
+
 int virNetTLSContextCheckCertificate(virNetTLSContextPtr ctxt,
                                      virNetTLSSessionPtr sess)
 {
+    g_autofree char *cachekey = NULL;
+    virNetTLSCertCacheEntryPtr entry;
+    time_t now = time(NULL);
+    time_t expires = now + VIR_NET_TLS_CERT_CACHE_TTL;
     int ret = -1;
 
     virObjectLock(ctxt);
     virObjectLock(sess);
-    if (virNetTLSContextValidCertificate(ctxt, sess) < 0) {
+
+    /* Reconnecting clients present the same certificates again, there's
+     * no need to verify them and check their DN every time */
+    if (now != (time_t)-1 &&
+        (cachekey = virNetTLSContextCertCacheKey(sess)) &&
+        (entry = virHashLookup(ctxt->validCerts, cachekey))) {
+        if (entry->expires > now) {
+            VIR_DEBUG("Peer certificate of %s was validated recently",
+                      entry->dname);
+            sess->x509dname = g_strdup(entry->dname);
+            ret = 0;
+            goto cleanup;
+        }
+
+        virHashRemoveEntry(ctxt->validCerts, cachekey);
+    }
+
+    if (virNetTLSContextValidCertificate(ctxt, sess, &expires) < 0) {
         VIR_WARN("Certificate check failed %s", virGetLastErrorMessage());
         if (ctxt->requireValidCert) {
             virReportError(VIR_ERR_AUTH_FAILED, "%s",
@@ -1133,6 +1320,9 @@ int virNetTLSContextCheckCertificate(virNetTLSContextPtr ctxt,
         }
         virResetLastError();
         VIR_INFO("Ignoring bad certificate at user request");
+    } else if (cachekey) {
+        virNetTLSContextCacheValidCert(ctxt, cachekey, sess->x509dname,
+                                       now, expires);
     }
 
     ret = 0;
@@ -1154,6 +1344,12 @@ void virNetTLSContextDispose(void *obj)
     VIR_FREE(ctxt->priority);
     gnutls_dh_params_deinit(ctxt->dhParams);
     gnutls_certificate_free_credentials(ctxt->x509cred);
+    if (ctxt->ticketKey.data) {
+        memset(ctxt->ticketKey.data, 0, ctxt->ticketKey.size);
+        gnutls_free(ctxt->ticketKey.data);
+    }
+    virHashFree(ctxt->sessions);
+    virHashFree(ctxt->validCerts);
 }
 
 
@@ -1237,6 +1433,28 @@ virNetTLSSessionPtr virNetTLSSessionNew(virNetTLSContextPtr ctxt,
         gnutls_certificate_server_set_request(sess->session, GNUTLS_CERT_REQUEST);
 
         gnutls_dh_set_prime_bits(sess->session, DH_BITS);
+
+        if ((err = gnutls_session_ticket_enable_server(sess->session,
+                                                       &ctxt->ticketKey)) != 0) {
+            virReportError(VIR_ERR_SYSTEM_ERROR,
+                           _("Failed to enable TLS session tickets: %s"),
+                           gnutls_strerror(err));
+            goto error;
+        }
+    } else if (hostname) {
+        gnutls_datum_t *data;
+
+        /* Try to resume the last session with the host, the server falls
+         * back to a full handshake if it doesn't accept it anymore */
+        virObjectLock(ctxt);
+        if ((data = virHashLookup(ctxt->sessions, hostname)) &&
+            (err = gnutls_session_set_data(sess->session,
+                                           data->data, data->size)) != 0)
+            VIR_DEBUG("Not resuming TLS session with %s: %s",
+                      hostname, gnutls_strerror(err));
+        virObjectUnlock(ctxt);
+
+        sess->ctxt = virObjectRef(ctxt);
     }
 
     gnutls_transport_set_ptr(sess->session, sess);
@@ -1272,16 +1490,14 @@ void virNetTLSSessionSetIOCallbacks(virNetTLSSessionPtr sess,
 }
 
 
-ssize_t virNetTLSSessionWrite(virNetTLSSessionPtr sess,
-                              const char *buf, size_t len)
+static ssize_t
+virNetTLSSessionSendLocked(virNetTLSSessionPtr sess,
+                           const char *buf, size_t len)
 {
-    ssize_t ret;
-
-    virObjectLock(sess);
-    ret = gnutls_record_send(sess->session, buf, len);
+    ssize_t ret = gnutls_record_send(sess->session, buf, len);
 
     if (ret >= 0)
-        goto cleanup;
+        return ret;
 
     switch (ret) {
     case GNUTLS_E_AGAIN:
@@ -1298,9 +1514,63 @@ ssize_t virNetTLSSessionWrite(virNetTLSSessionPtr sess,
         break;
     }
 
-    ret = -1;
+    return -1;
+}
+
+
+ssize_t virNetTLSSessionWrite(virNetTLSSessionPtr sess,
+                              const char *buf, size_t len)
+{
+    ssize_t ret;
+
+    virObjectLock(sess);
+    ret = virNetTLSSessionSendLocked(sess, buf, len);
+    virObjectUnlock(sess);
+    return ret;
+}
+
+
+/**
+ * virNetTLSSessionWritev:
+ * @sess: the TLS session
+ * @vec: buffers to send
+ * @nvec: number of items in @vec
+ *
+ * Like virNetTLSSessionWrite, but small buffers are coalesced into a
+ * single TLS record rather than paying for a record each.
+ *
+ * As with virNetTLSSessionWrite, after EAGAIN the caller must retry with
+ * the same data at the start of @vec, though more may be appended.
+ * GnuTLS then flushes the pending record and reports its length.
+ *
+ * Returns the number of bytes written from the start of @vec, or -1
+ * with errno set.
+ */
+ssize_t virNetTLSSessionWritev(virNetTLSSessionPtr sess,
+                               const GOutputVector *vec,
+                               size_t nvec)
+{
+    size_t len = 0;
+    size_t i;
+    ssize_t ret;
+
+    if (nvec == 1 || vec[0].size >= VIR_NET_TLS_SESSION_RECORD_MAX)
+        return virNetTLSSessionWrite(sess, vec[0].buffer, vec[0].size);
+
+    virObjectLock(sess);
+
+    if (!sess->txbuf)
+        sess->txbuf = g_new0(char, VIR_NET_TLS_SESSION_RECORD_MAX);
+
+    for (i = 0; i < nvec && len < VIR_NET_TLS_SESSION_RECORD_MAX; i++) {
+        size_t n = MIN(vec[i].size, VIR_NET_TLS_SESSION_RECORD_MAX - len);
+
+        memcpy(sess->txbuf + len, vec[i].buffer, n);
+        len += n;
+    }
+
+    ret = virNetTLSSessionSendLocked(sess, sess->txbuf, len);
 
- cleanup:
     virObjectUnlock(sess);
     return ret;
 }
@@ -1344,7 +1614,8 @@ int virNetTLSSessionHandshake(virNetTLSSessionPtr sess)
     VIR_DEBUG("Ret=%d", ret);
     if (ret == 0) {
         sess->handshakeComplete = true;
-        VIR_DEBUG("Handshake is complete");
+        VIR_DEBUG("Handshake is complete, session resumed=%d",
+                  gnutls_session_is_resumed(sess->session));
         goto cleanup;
     }
     if (ret == GNUTLS_E_INTERRUPTED || ret == GNUTLS_E_AGAIN) {
@@ -1420,8 +1691,30 @@ void virNetTLSSessionDispose(void *obj)
     PROBE(RPC_TLS_SESSION_DISPOSE,
           "sess=%p", sess);
 
+    /* Save the data of the session only now, as with TLS 1.3 the server
+     * sends the tickets after the handshake */
+    if (sess->ctxt) {
+        gnutls_datum_t data = { NULL, 0 };
+
+        if (sess->handshakeComplete &&
+            gnutls_session_get_data2(sess->session, &data) == 0) {
+            gnutls_datum_t *copy = g_new0(gnutls_datum_t, 1);
+
+            *copy = data;
+            virObjectLock(sess->ctxt);
+            if (virHashUpdateEntry(sess->ctxt->sessions, sess->hostname, copy) < 0) {
+                virNetTLSSessionDataFree(copy);
+                virResetLastError();
+            }
+            virObjectUnlock(sess->ctxt);
+        }
+
+        virObjectUnref(sess->ctxt);
+    }
+
     VIR_FREE(sess->x509dname);
     VIR_FREE(sess->hostname);
+    VIR_FREE(sess->txbuf);
     gnutls_deinit(sess->session);
 }
 
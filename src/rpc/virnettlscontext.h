@@ -84,6 +84,9 @@ void virNetTLSSessionSetIOCallbacks(virNetTLSSessionPtr sess,
 
 ssize_t virNetTLSSessionWrite(virNetTLSSessionPtr sess,
                               const char *buf, size_t len);
+ssize_t virNetTLSSessionWritev(virNetTLSSessionPtr sess,
+                               const GOutputVector *vec,
+                               size_t nvec);
 ssize_t virNetTLSSessionRead(virNetTLSSessionPtr sess,
                              char *buf, size_t len);
 
@@ -201,6 +201,32 @@ static int virSecurityDACRestoreFileLabelInternal(virSecurityManagerPtr mgr,
                                                   const virStorageSource *src,
                                                   const char *path,
                                                   bool recall);
+
+
+static int
+virSecurityDACTransactionRunItem(size_t idx,
+                                 void *opaque)
+{
+    virSecurityDACChownListPtr list = opaque;
+    virSecurityDACChownItemPtr item = list->items[idx];
+    const bool remember = item->remember && list->lock;
+
+    if (!item->restore) {
+        return virSecurityDACSetOwnership(list->manager,
+                                          item->src,
+                                          item->path,
+                                          item->uid,
+                                          item->gid,
+                                          remember);
+    }
+
+    return virSecurityDACRestoreFileLabelInternal(list->manager,
+                                                  item->src,
+                                                  item->path,
+                                                  remember);
+}
+
+
 /**
  * virSecurityDACTransactionRun:
  * @pid: process pid
@@ -209,7 +235,8 @@ static int virSecurityDACRestoreFileLabelInternal(virSecurityManagerPtr mgr,
  * This is the callback that runs in the same namespace as the domain we are
  * relabelling. For given transaction (@opaque) it relabels all the paths on
  * the list. Depending on security manager configuration it might lock paths
- * we will relabel.
+ * we will relabel. Independent paths are relabelled in parallel, see
+ * virSecurityRelabelParallel.
  *
  * Returns: 0 on success
  *         -1 otherwise.
@@ -222,6 +249,8 @@ virSecurityDACTransactionRun(pid_t pid G_GNUC_UNUSED,
     virSecurityManagerMetadataLockStatePtr state;
     const char **paths = NULL;
     size_t npaths = 0;
+    g_autofree const char **itemPaths = NULL;
+    g_autofree bool *done = NULL;
     size_t i;
     int rv = 0;
     int ret = -1;
@@ -256,32 +285,26 @@ virSecurityDACTransactionRun(pid_t pid G_GNUC_UNUSED,
         }
     }
 
+    itemPaths = g_new0(const char *, list->nItems);
+    done = g_new0(bool, list->nItems);
+
     for (i = 0; i < list->nItems; i++) {
         virSecurityDACChownItemPtr item = list->items[i];
-        const bool remember = item->remember && list->lock;
 
-        if (!item->restore) {
-            rv = virSecurityDACSetOwnership(list->manager,
-                                            item->src,
-                                            item->path,
-                                            item->uid,
-                                            item->gid,
-                                            remember);
-        } else {
-            rv = virSecurityDACRestoreFileLabelInternal(list->manager,
-                                                        item->src,
-                                                        item->path,
-                                                        remember);
-        }
-
-        if (rv < 0)
-            break;
+        itemPaths[i] = item->src ? item->src->path : item->path;
     }
 
-    for (; rv < 0 && i > 0; i--) {
+    rv = virSecurityRelabelParallel(list->nItems, itemPaths,
+                                    virSecurityDACTransactionRunItem,
+                                    list, done);
+
+    for (i = list->nItems; rv < 0 && i > 0; i--) {
         virSecurityDACChownItemPtr item = list->items[i - 1];
         const bool remember = item->remember && list->lock;
 
+        if (!done[i - 1])
+            continue;
+
         if (!item->restore) {
             virSecurityDACRestoreFileLabelInternal(list->manager,
                                                    item->src,
@@ -775,6 +798,7 @@ virSecurityDACSetOwnership(virSecurityManagerPtr mgr,
     virSecurityDACDataPtr priv = virSecurityManagerGetPrivateData(mgr);
     virErrorPtr origerr;
     struct stat sb;
+    bool unchanged = false;
     int refcount;
     int rc;
 
@@ -797,6 +821,12 @@ virSecurityDACSetOwnership(virSecurityManagerPtr mgr,
             return -1;
         }
 
+        /* The owner of a local file was just fetched, there's no need
+         * to stat it once again only to find out chown is not needed. */
+        if (sb.st_uid == uid && sb.st_gid == gid &&
+            (!src || virStorageSourceIsLocalStorage(src)))
+            unchanged = true;
+
         refcount = virSecurityDACRememberLabel(priv, path, sb.st_uid, sb.st_gid);
         if (refcount == -2) {
             /* Not supported. Don't error though. */
@@ -818,6 +848,12 @@ virSecurityDACSetOwnership(virSecurityManagerPtr mgr,
         }
     }
 
+    if (unchanged) {
+        VIR_DEBUG("DAC user and group on '%s' already are '%ld:%ld'",
+                  path, (long)uid, (long)gid);
+        return 0;
+    }
+
     VIR_INFO("Setting DAC user and group on '%s' to '%ld:%ld'",
              NULLSTR(src ? src->path : path), (long)uid, (long)gid);
 
@@ -233,6 +233,27 @@ static int virSecuritySELinuxRestoreFileLabel(virSecurityManagerPtr mgr,
                                               bool recall);
 
 
+static int
+virSecuritySELinuxTransactionRunItem(size_t idx,
+                                     void *opaque)
+{
+    virSecuritySELinuxContextListPtr list = opaque;
+    virSecuritySELinuxContextItemPtr item = list->items[idx];
+    const bool remember = item->remember && list->lock;
+
+    if (!item->restore) {
+        return virSecuritySELinuxSetFilecon(list->manager,
+                                            item->path,
+                                            item->tcon,
+                                            remember);
+    }
+
+    return virSecuritySELinuxRestoreFileLabel(list->manager,
+                                              item->path,
+                                              remember);
+}
+
+
 /**
  * virSecuritySELinuxTransactionRun:
  * @pid: process pid
@@ -240,7 +261,8 @@ static int virSecuritySELinuxRestoreFileLabel(virSecurityManagerPtr mgr,
  *
  * This is the callback that runs in the same namespace as the domain we are
  * relabelling. For given transaction (@opaque) it relabels all the paths on
- * the list.
+ * the list. Independent paths are relabelled in parallel, see
+ * virSecurityRelabelParallel.
  *
  * Returns: 0 on success
  *         -1 otherwise.
@@ -253,6 +275,8 @@ virSecuritySELinuxTransactionRun(pid_t pid G_GNUC_UNUSED,
     virSecurityManagerMetadataLockStatePtr state;
     const char **paths = NULL;
     size_t npaths = 0;
+    g_autofree const char **itemPaths = NULL;
+    g_autofree bool *done = NULL;
     size_t i;
     int rv;
     int ret = -1;
@@ -287,30 +311,23 @@ virSecuritySELinuxTransactionRun(pid_t pid G_GNUC_UNUSED,
         }
     }
 
-    rv = 0;
-    for (i = 0; i < list->nItems; i++) {
-        virSecuritySELinuxContextItemPtr item = list->items[i];
-        const bool remember = item->remember && list->lock;
+    itemPaths = g_new0(const char *, list->nItems);
+    done = g_new0(bool, list->nItems);
 
-        if (!item->restore) {
-            rv = virSecuritySELinuxSetFilecon(list->manager,
-                                              item->path,
-                                              item->tcon,
-                                              remember);
-        } else {
-            rv = virSecuritySELinuxRestoreFileLabel(list->manager,
-                                                    item->path,
-                                                    remember);
-        }
+    for (i = 0; i < list->nItems; i++)
+        itemPaths[i] = list->items[i]->path;
 
-        if (rv < 0)
-            break;
-    }
+    rv = virSecurityRelabelParallel(list->nItems, itemPaths,
+                                    virSecuritySELinuxTransactionRunItem,
+                                    list, done);
 
-    for (; rv < 0 && i > 0; i--) {
+    for (i = list->nItems; rv < 0 && i > 0; i--) {
         virSecuritySELinuxContextItemPtr item = list->items[i - 1];
         const bool remember = item->remember && list->lock;
 
+        if (!done[i - 1])
+            continue;
+
         if (!item->restore) {
             virSecuritySELinuxRestoreFileLabel(list->manager,
                                                item->path,
@@ -1374,6 +1391,20 @@ virSecuritySELinuxSetFilecon(virSecurityManagerPtr mgr,
                 }
             }
         }
+    } else if (getfilecon_raw(path, &econ) < 0) {
+        /* Shared resources, e.g. read only backing images of many
+         * domains, are not remembered. The context is fetched only so
+         * that they aren't relabelled on each domain startup. */
+        econ = NULL;
+    }
+
+    /* If the current context is the desired one already, there's no
+     * need to write it again. */
+    if (econ && STREQ(econ, tcon)) {
+        VIR_DEBUG("SELinux context on '%s' already is '%s'", path, tcon);
+        rollback = false;
+        ret = 0;
+        goto cleanup;
     }
 
     rc = virSecuritySELinuxSetFileconImpl(path, tcon, privileged);
@@ -1437,14 +1468,23 @@ virSecuritySELinuxFSetFilecon(int fd, char *tcon)
     return 0;
 }
 
+/* Transactions relabel paths from several threads, but the label handle
+ * is not guaranteed to be thread safe. */
+static virMutex labelHandleLock = VIR_MUTEX_INITIALIZER;
+
 /* Set fcon to the appropriate label for path and mode, or return -1.  */
 static int
 getContext(virSecurityManagerPtr mgr G_GNUC_UNUSED,
            const char *newpath, mode_t mode, security_context_t *fcon)
 {
     virSecuritySELinuxDataPtr data = virSecurityManagerGetPrivateData(mgr);
+    int ret;
+
+    virMutexLock(&labelHandleLock);
+    ret = selabel_lookup_raw(data->label_handle, fcon, newpath, mode);
+    virMutexUnlock(&labelHandleLock);
 
-    return selabel_lookup_raw(data->label_handle, fcon, newpath, mode);
+    return ret;
 }
 
 
@@ -25,6 +25,7 @@
 #include "virlog.h"
 #include "viruuid.h"
 #include "virhostuptime.h"
+#include "virthread.h"
 
 #include "security_util.h"
 
@@ -528,3 +529,168 @@ virSecurityMoveRememberedLabel(const char *name,
 
     return 0;
 }
+
+
+typedef struct _virSecurityRelabelWorker virSecurityRelabelWorker;
+typedef virSecurityRelabelWorker *virSecurityRelabelWorkerPtr;
+typedef struct _virSecurityRelabelData virSecurityRelabelData;
+typedef virSecurityRelabelData *virSecurityRelabelDataPtr;
+
+struct _virSecurityRelabelData {
+    virMutex lock;
+    bool failed;
+    virErrorPtr err;
+
+    size_t nitems;
+    const char **paths;
+    virSecurityRelabelFunc func;
+    void *opaque;
+    bool *done;
+};
+
+struct _virSecurityRelabelWorker {
+    virThread thread;
+    virSecurityRelabelDataPtr data;
+    size_t id;
+    size_t nworkers;
+};
+
+
+static size_t
+virSecurityRelabelWorkerOf(const char *path,
+                           size_t nworkers)
+{
+    if (!path)
+        return 0;
+
+    return g_str_hash(path) % nworkers;
+}
+
+
+static void
+virSecurityRelabelWorkerFunc(void *opaque)
+{
+    virSecurityRelabelWorkerPtr worker = opaque;
+    virSecurityRelabelDataPtr data = worker->data;
+    size_t i;
+
+    for (i = 0; i < data->nitems; i++) {
+        bool failed;
+
+        if (virSecurityRelabelWorkerOf(data->paths[i],
+                                       worker->nworkers) != worker->id)
+            continue;
+
+        virMutexLock(&data->lock);
+        failed = data->failed;
+        virMutexUnlock(&data->lock);
+
+        if (failed)
+            return;
+
+        if (data->func(i, data->opaque) < 0) {
+            virMutexLock(&data->lock);
+            if (!data->failed) {
+                data->failed = true;
+                data->err = virSaveLastError();
+            }
+            virMutexUnlock(&data->lock);
+            return;
+        }
+
+        data->done[i] = true;
+    }
+}
+
+
+/**
+ * virSecurityRelabelParallel:
+ * @nitems: number of items to relabel
+ * @paths: path each item relabels, NULL allowed
+ * @func: callback relabelling a single item
+ * @opaque: data passed to @func
+ * @done: array of @nitems elements
+ *
+ * Calls @func for every item of a relabel transaction, using up to
+ * VIR_SECURITY_RELABEL_WORKERS threads. Items relabelling the same
+ * path are always handled by the same thread in the order they were
+ * queued in. After the first failure no new items are started.
+ *
+ * When this function returns, @done[i] tells whether @func succeeded
+ * for item @i, so that the caller can roll back the items which were
+ * relabelled.
+ *
+ * Returns: 0 on success,
+ *         -1 otherwise with the error of the failed item reported.
+ */
+int
+virSecurityRelabelParallel(size_t nitems,
+                           const char **paths,
+                           virSecurityRelabelFunc func,
+                           void *opaque,
+                           bool *done)
+{
+    virSecurityRelabelData data = {
+        .nitems = nitems, .paths = paths,
+        .func = func, .opaque = opaque, .done = done,
+    };
+    g_autofree virSecurityRelabelWorkerPtr workers = NULL;
+    size_t nworkers = MIN(nitems, VIR_SECURITY_RELABEL_WORKERS);
+    size_t nstarted = 0;
+    size_t i;
+    int ret = -1;
+
+    memset(done, 0, sizeof(*done) * nitems);
+
+    if (nworkers <= 1) {
+        for (i = 0; i < nitems; i++) {
+            if (func(i, opaque) < 0)
+                return -1;
+            done[i] = true;
+        }
+        return 0;
+    }
+
+    if (virMutexInit(&data.lock) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init mutex"));
+        return -1;
+    }
+
+    workers = g_new0(virSecurityRelabelWorker, nworkers);
+
+    for (i = 0; i < nworkers; i++) {
+        workers[i].data = &data;
+        workers[i].id = i;
+        workers[i].nworkers = nworkers;
+
+        if (virThreadCreateFull(&workers[i].thread, true,
+                                virSecurityRelabelWorkerFunc,
+                                "secdriver-relabel", false,
+                                &workers[i]) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("Unable to create relabel thread"));
+            virMutexLock(&data.lock);
+            data.failed = true;
+            virMutexUnlock(&data.lock);
+            break;
+        }
+        nstarted++;
+    }
+
+    for (i = 0; i < nstarted; i++)
+        virThreadJoin(&workers[i].thread);
+
+    if (data.err) {
+        virSetError(data.err);
+        virFreeError(data.err);
+        goto cleanup;
+    }
+
+    if (data.failed)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virMutexDestroy(&data.lock);
+    return ret;
+}
@@ -32,3 +32,16 @@ int
 virSecurityMoveRememberedLabel(const char *name,
                                const char *src,
                                const char *dst);
+
+/* Maximum number of threads relabelling paths of a single transaction */
+#define VIR_SECURITY_RELABEL_WORKERS 8
+
+typedef int (*virSecurityRelabelFunc)(size_t idx,
+                                      void *opaque);
+
+int
+virSecurityRelabelParallel(size_t nitems,
+                           const char **paths,
+                           virSecurityRelabelFunc func,
+                           void *opaque,
+                           bool *done);
@@ -105,6 +105,9 @@ struct _virStorageBackend {
     virStorageBackendStartPool startPool;
     virStorageBackendBuildPool buildPool;
     virStorageBackendRefreshPool refreshPool; /* Must be non-NULL */
+    bool incrementalRefresh; /* refreshPool updates the volumes found by
+                                the previous refresh instead of expecting
+                                an empty list */
     virStorageBackendStopPool stopPool;
     virStorageBackendDeletePool deletePool;
 
@@ -20,6 +20,7 @@
 
 #include <config.h>
 
+#include <poll.h>
 #include <iscsi/iscsi.h>
 #include <iscsi/scsi-lowlevel.h>
 
@@ -295,34 +296,284 @@ virISCSIDirectGetVolumeCapacity(struct iscsi_context *iscsi,
     return ret;
 }
 
+/*
+ * Refreshing a pool sends TEST UNIT READY, INQUIRY and READ CAPACITY to
+ * every LUN of the target. Rather than waiting for each reply in turn,
+ * the commands of up to VIR_ISCSI_REFRESH_QUEUE LUNs are kept in flight
+ * on the session and each reply triggers the next command for its LUN.
+ */
+#define VIR_ISCSI_REFRESH_QUEUE 32
+
+typedef enum {
+    VIR_ISCSI_REFRESH_LUN_TEST_UNIT_READY,
+    VIR_ISCSI_REFRESH_LUN_INQUIRY,
+    VIR_ISCSI_REFRESH_LUN_READ_CAPACITY,
+    VIR_ISCSI_REFRESH_LUN_DONE,
+} virISCSIDirectRefreshLunState;
+
+typedef struct _virISCSIDirectRefresh virISCSIDirectRefresh;
+
+typedef struct _virISCSIDirectRefreshLun virISCSIDirectRefreshLun;
+struct _virISCSIDirectRefreshLun {
+    virISCSIDirectRefresh *refresh;
+    int lun;
+    virISCSIDirectRefreshLunState state;
+    unsigned long long deadline; /* of retrying TEST UNIT READY */
+    uint32_t block_size;
+    uint64_t nb_block;
+};
+
+struct _virISCSIDirectRefresh {
+    virISCSIDirectRefreshLun *luns;
+    size_t nluns;
+    size_t next;    /* index of the next LUN to send commands to */
+    size_t active;  /* number of LUNs with a command in flight */
+    bool failed;    /* an error was reported, don't start more LUNs */
+};
+
+
+static void
+virISCSIDirectRefreshLunCb(struct iscsi_context *iscsi,
+                           int status,
+                           void *command_data,
+                           void *private_data);
+
+
+static bool
+virISCSIDirectRefreshLunSend(struct iscsi_context *iscsi,
+                             virISCSIDirectRefreshLun *lun)
+{
+    struct scsi_task *task = NULL;
+    const char *what = NULL;
+
+    switch (lun->state) {
+    case VIR_ISCSI_REFRESH_LUN_TEST_UNIT_READY:
+        task = iscsi_testunitready_task(iscsi, lun->lun,
+                                        virISCSIDirectRefreshLunCb, lun);
+        what = "testunitready";
+        break;
+    case VIR_ISCSI_REFRESH_LUN_INQUIRY:
+        task = iscsi_inquiry_task(iscsi, lun->lun, 0, 0, 64,
+                                  virISCSIDirectRefreshLunCb, lun);
+        what = "inquiry";
+        break;
+    case VIR_ISCSI_REFRESH_LUN_READ_CAPACITY:
+        task = iscsi_readcapacity16_task(iscsi, lun->lun,
+                                         virISCSIDirectRefreshLunCb, lun);
+        what = "readcapacity16";
+        break;
+    case VIR_ISCSI_REFRESH_LUN_DONE:
+        return false;
+    }
+
+    if (!task) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Failed to send %s command: %s"),
+                       what, iscsi_get_error(iscsi));
+        return false;
+    }
+
+    return true;
+}
+
+
+static void
+virISCSIDirectRefreshNext(struct iscsi_context *iscsi,
+                          virISCSIDirectRefresh *refresh)
+{
+    while (!refresh->failed &&
+           refresh->active < VIR_ISCSI_REFRESH_QUEUE &&
+           refresh->next < refresh->nluns) {
+        virISCSIDirectRefreshLun *lun = &refresh->luns[refresh->next++];
+
+        if (virTimeMillisNow(&lun->deadline) < 0) {
+            refresh->failed = true;
+            break;
+        }
+        lun->deadline += VIR_ISCSI_TEST_UNIT_TIMEOUT;
+
+        if (!virISCSIDirectRefreshLunSend(iscsi, lun)) {
+            refresh->failed = true;
+            break;
+        }
+        refresh->active++;
+    }
+}
+
+
+/* Processes the reply to the last command sent for a LUN and sends the
+ * next one, see virISCSIDirectTestUnitReady and
+ * virISCSIDirectGetVolumeCapacity for their synchronous counterparts */
+static void
+virISCSIDirectRefreshLunCb(struct iscsi_context *iscsi,
+                           int status,
+                           void *command_data,
+                           void *private_data)
+{
+    virISCSIDirectRefreshLun *lun = private_data;
+    virISCSIDirectRefresh *refresh = lun->refresh;
+    struct scsi_task *task = command_data;
+    unsigned long long now;
+
+    /* Don't add to the error of an earlier LUN with replies cancelled
+     * because of it */
+    if (refresh->failed)
+        goto done;
+
+    switch (lun->state) {
+    case VIR_ISCSI_REFRESH_LUN_TEST_UNIT_READY:
+        if (status == SCSI_STATUS_CHECK_CONDITION &&
+            task->sense.key == SCSI_SENSE_UNIT_ATTENTION &&
+            task->sense.ascq == SCSI_SENSE_ASCQ_BUS_RESET &&
+            virTimeMillisNow(&now) == 0 && now < lun->deadline)
+            break;
+
+        if (status != SCSI_STATUS_GOOD) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Failed testunitready: %s"),
+                           iscsi_get_error(iscsi));
+            goto error;
+        }
+
+        lun->state = VIR_ISCSI_REFRESH_LUN_INQUIRY;
+        break;
+
+    case VIR_ISCSI_REFRESH_LUN_INQUIRY: {
+        struct scsi_inquiry_standard *inq = NULL;
+
+        if (status != SCSI_STATUS_GOOD) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Failed to send inquiry command: %s"),
+                           iscsi_get_error(iscsi));
+            goto error;
+        }
+
+        if (!(inq = scsi_datain_unmarshall(task))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Failed to unmarshall reply: %s"),
+                           iscsi_get_error(iscsi));
+            goto error;
+        }
+
+        if (inq->device_type == SCSI_INQUIRY_PERIPHERAL_DEVICE_TYPE_DIRECT_ACCESS)
+            lun->state = VIR_ISCSI_REFRESH_LUN_READ_CAPACITY;
+        else
+            lun->state = VIR_ISCSI_REFRESH_LUN_DONE;
+        break;
+    }
+
+    case VIR_ISCSI_REFRESH_LUN_READ_CAPACITY: {
+        struct scsi_readcapacity16 *rc16 = NULL;
+
+        if (status != SCSI_STATUS_GOOD) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Failed to get capacity of lun: %s"),
+                           iscsi_get_error(iscsi));
+            goto error;
+        }
+
+        if (!(rc16 = scsi_datain_unmarshall(task))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Failed to unmarshall reply: %s"),
+                           iscsi_get_error(iscsi));
+            goto error;
+        }
+
+        lun->block_size = rc16->block_length;
+        lun->nb_block = rc16->returned_lba;
+        lun->state = VIR_ISCSI_REFRESH_LUN_DONE;
+        break;
+    }
+
+    case VIR_ISCSI_REFRESH_LUN_DONE:
+        break;
+    }
+
+    if (task)
+        scsi_free_scsi_task(task);
+    task = NULL;
+
+    if (lun->state != VIR_ISCSI_REFRESH_LUN_DONE) {
+        if (virISCSIDirectRefreshLunSend(iscsi, lun))
+            return;
+        goto error;
+    }
+
+ done:
+    if (task)
+        scsi_free_scsi_task(task);
+    refresh->active--;
+    virISCSIDirectRefreshNext(iscsi, refresh);
+    return;
+
+ error:
+    refresh->failed = true;
+    goto done;
+}
+
+
+static int
+virISCSIDirectRefreshLuns(struct iscsi_context *iscsi,
+                          virISCSIDirectRefresh *refresh)
+{
+    virISCSIDirectRefreshNext(iscsi, refresh);
+
+    while (refresh->active) {
+        struct pollfd pfd = {
+            .fd = iscsi_get_fd(iscsi),
+            .events = iscsi_which_events(iscsi),
+        };
+        int rc;
+
+        /* a timeout lets libiscsi expire commands of an unresponsive
+         * target, like its synchronous calls do */
+        if ((rc = poll(&pfd, 1, 1000)) < 0) {
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno, "%s",
+                                 _("Failed to poll iscsi connection"));
+            break;
+        }
+
+        if (iscsi_service(iscsi, rc ? pfd.revents : 0) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Failed to process iscsi replies: %s"),
+                           iscsi_get_error(iscsi));
+            break;
+        }
+    }
+
+    if (refresh->active) {
+        /* the callbacks of the commands still in flight must not run
+         * once @refresh is gone */
+        refresh->failed = true;
+        iscsi_scsi_cancel_all_tasks(iscsi);
+        return -1;
+    }
+
+    return refresh->failed ? -1 : 0;
+}
+
+
 static int
 virISCSIDirectRefreshVol(virStoragePoolObjPtr pool,
-                         struct iscsi_context *iscsi,
-                         int lun,
+                         virISCSIDirectRefreshLun *lun,
                          char *portal)
 {
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
-    uint32_t block_size;
-    uint64_t nb_block;
     g_autoptr(virStorageVolDef) vol = NULL;
 
-    if (virISCSIDirectTestUnitReady(iscsi, lun) < 0)
-        return -1;
-
     if (VIR_ALLOC(vol) < 0)
         return -1;
 
     vol->type = VIR_STORAGE_VOL_NETWORK;
 
-    if (virISCSIDirectGetVolumeCapacity(iscsi, lun, &block_size, &nb_block) < 0)
-        return -1;
-
-    vol->target.capacity = block_size * nb_block;
-    vol->target.allocation = block_size * nb_block;
+    vol->target.capacity = lun->block_size * lun->nb_block;
+    vol->target.allocation = lun->block_size * lun->nb_block;
     def->capacity += vol->target.capacity;
     def->allocation += vol->target.allocation;
 
-    if (virISCSIDirectSetVolumeAttributes(pool, vol, lun, portal) < 0)
+    if (virISCSIDirectSetVolumeAttributes(pool, vol, lun->lun, portal) < 0)
         return -1;
 
     if (virStoragePoolObjAddVol(pool, vol) < 0)
@@ -340,6 +591,7 @@ virISCSIDirectReportLuns(virStoragePoolObjPtr pool,
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
     struct scsi_task *task = NULL;
     struct scsi_reportluns_list *list = NULL;
+    virISCSIDirectRefresh refresh = { 0 };
     int full_size;
     size_t i;
     int ret = -1;
@@ -370,15 +622,26 @@ virISCSIDirectReportLuns(virStoragePoolObjPtr pool,
         goto cleanup;
     }
 
+    refresh.luns = g_new0(virISCSIDirectRefreshLun, list->num);
+    refresh.nluns = list->num;
+    for (i = 0; i < list->num; i++) {
+        refresh.luns[i].refresh = &refresh;
+        refresh.luns[i].lun = list->luns[i];
+    }
+
+    if (virISCSIDirectRefreshLuns(iscsi, &refresh) < 0)
+        goto cleanup;
+
     def->capacity = 0;
     def->allocation = 0;
-    for (i = 0; i < list->num; i++) {
-        if (virISCSIDirectRefreshVol(pool, iscsi, list->luns[i], portal) < 0)
+    for (i = 0; i < refresh.nluns; i++) {
+        if (virISCSIDirectRefreshVol(pool, &refresh.luns[i], portal) < 0)
             goto cleanup;
     }
 
     ret = 0;
  cleanup:
+    g_free(refresh.luns);
     scsi_free_scsi_task(task);
     return ret;
 }
@@ -114,6 +114,7 @@ virStorageBackendLogicalInitializeDevice(const char *path)
 struct virStorageBackendLogicalPoolVolData {
     virStoragePoolObjPtr pool;
     virStorageVolDefPtr vol;
+    bool vgFound; /* volume group metadata was reported along */
 };
 
 static int
@@ -350,6 +351,28 @@ virStorageBackendLogicalMakeVol(char **const groups,
            VIR_STORAGE_VOL_LOGICAL_LV_ATTR_REGEX \
            VIR_STORAGE_VOL_LOGICAL_SUFFIX_REGEX
 
+/* The same with the size and free space of the volume group appended */
+#define VIR_STORAGE_VOL_LOGICAL_VG_SIZE_REGEX "([0-9]+)#"
+#define VIR_STORAGE_VOL_LOGICAL_VG_FREE_REGEX "([0-9]+)#"
+
+#define VIR_STORAGE_VOL_LOGICAL_VG_REGEX_COUNT \
+           (VIR_STORAGE_VOL_LOGICAL_REGEX_COUNT + 2)
+#define VIR_STORAGE_VOL_LOGICAL_VG_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_PREFIX_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_LV_NAME_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_ORIGIN_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_UUID_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_DEVICES_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_SEGTYPE_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_STRIPES_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_SEG_SIZE_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_VG_EXTENT_SIZE_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_SIZE_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_LV_ATTR_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_VG_SIZE_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_VG_FREE_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_SUFFIX_REGEX
+
 static int
 virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
                                 virStorageVolDefPtr vol)
@@ -424,6 +447,24 @@ virStorageBackendLogicalRefreshPoolFunc(char **const groups,
 }
 
 
+static int
+virStorageBackendLogicalRefreshVolFunc(char **const groups,
+                                       void *opaque)
+{
+    struct virStorageBackendLogicalPoolVolData *data = opaque;
+
+    /* Every row repeats the volume group metadata */
+    if (!data->vgFound) {
+        if (virStorageBackendLogicalRefreshPoolFunc(groups + VIR_STORAGE_VOL_LOGICAL_REGEX_COUNT,
+                                                    data->pool) < 0)
+            return -1;
+        data->vgFound = true;
+    }
+
+    return virStorageBackendLogicalMakeVol(groups, opaque);
+}
+
+
 static int
 virStorageBackendLogicalFindPoolSourcesFunc(char **const groups,
                                             void *data)
@@ -732,15 +773,43 @@ virStorageBackendLogicalRefreshPool(virStoragePoolObjPtr pool)
     int vars[] = {
         2
     };
+    const char *lvregexes[] = {
+        VIR_STORAGE_VOL_LOGICAL_VG_REGEX
+    };
+    int lvvars[] = {
+        VIR_STORAGE_VOL_LOGICAL_VG_REGEX_COUNT
+    };
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    struct virStorageBackendLogicalPoolVolData cbdata = {
+        .pool = pool,
+        .vol = NULL,
+    };
+    g_autoptr(virCommand) lvcmd = NULL;
     g_autoptr(virCommand) cmd = NULL;
 
     virWaitForDevices();
 
-    /* Get list of all logical volumes */
-    if (virStorageBackendLogicalFindLVs(pool, NULL) < 0)
+    /* Get list of all logical volumes along with the volume group
+     * metadata, see virStorageBackendLogicalFindLVs for the format */
+    lvcmd = virCommandNewArgList(LVS,
+                                 "--separator", "#",
+                                 "--noheadings",
+                                 "--units", "b",
+                                 "--unbuffered",
+                                 "--nosuffix",
+                                 "--options",
+                                 "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr,vg_size,vg_free",
+                                 def->source.name,
+                                 NULL);
+    if (virCommandRunRegex(lvcmd, 1, lvregexes, lvvars,
+                           virStorageBackendLogicalRefreshVolFunc,
+                           &cbdata, "lvs", NULL) < 0)
         return -1;
 
+    /* Saves running vgs unless the volume group has no volumes */
+    if (cbdata.vgFound)
+        return 0;
+
     cmd = virCommandNewArgList(VGS,
                                "--separator", ":",
                                "--noheadings",
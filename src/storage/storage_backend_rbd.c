@@ -34,6 +34,8 @@
 #include "rados/librados.h"
 #include "rbd/librbd.h"
 #include "virsecret.h"
+#include "virhash.h"
+#include "virthread.h"
 #include "storage_util.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
@@ -41,6 +43,7 @@
 VIR_LOG_INIT("storage.storage_backend_rbd");
 
 struct _virStorageBackendRBDState {
+    size_t refs;        /* protected by virStorageBackendRBDStatesLock */
     rados_t cluster;
     rados_ioctx_t ioctx;
     time_t starttime;
@@ -49,6 +52,15 @@ struct _virStorageBackendRBDState {
 typedef struct _virStorageBackendRBDState virStorageBackendRBDState;
 typedef virStorageBackendRBDState *virStorageBackendRBDStatePtr;
 
+/* Connecting to a cluster involves talking to the monitors and
+ * authenticating, which is way more expensive than the operations the
+ * connection is usually needed for. Connections of active pools are
+ * therefore kept around, keyed by pool UUID, until the pool is
+ * stopped. Both the cluster handle and the IoCTX are thread safe as
+ * long as the IoCTX settings are not changed. */
+static virHashTablePtr virStorageBackendRBDStates;
+static virMutex virStorageBackendRBDStatesLock = VIR_MUTEX_INITIALIZER;
+
 typedef struct _virStoragePoolRBDConfigOptionsDef virStoragePoolRBDConfigOptionsDef;
 typedef virStoragePoolRBDConfigOptionsDef *virStoragePoolRBDConfigOptionsDefPtr;
 struct _virStoragePoolRBDConfigOptionsDef {
@@ -367,15 +379,55 @@ virStorageBackendRBDCloseRADOSConn(virStorageBackendRBDStatePtr ptr)
 }
 
 
+static void
+virStorageBackendRBDDisposeState(virStorageBackendRBDStatePtr ptr)
+{
+    virStorageBackendRBDCloseRADOSConn(ptr);
+    VIR_FREE(ptr);
+}
+
+
+/* Drops a reference to the state. Must be called with
+ * virStorageBackendRBDStatesLock held. */
+static void
+virStorageBackendRBDStateUnref(void *payload)
+{
+    virStorageBackendRBDStatePtr ptr = payload;
+
+    if (--ptr->refs == 0)
+        virStorageBackendRBDDisposeState(ptr);
+}
+
+
 static void
 virStorageBackendRBDFreeState(virStorageBackendRBDStatePtr *ptr)
 {
     if (!*ptr)
         return;
 
-    virStorageBackendRBDCloseRADOSConn(*ptr);
+    virMutexLock(&virStorageBackendRBDStatesLock);
+    virStorageBackendRBDStateUnref(*ptr);
+    virMutexUnlock(&virStorageBackendRBDStatesLock);
+
+    *ptr = NULL;
+}
+
+
+/* Closes the cached connection of @pool once its current users are
+ * done with it, e.g. because the pool was stopped or the connection
+ * turned out to be broken. */
+static void
+virStorageBackendRBDForgetState(virStoragePoolObjPtr pool)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    virUUIDFormat(def->uuid, uuidstr);
 
-    VIR_FREE(*ptr);
+    virMutexLock(&virStorageBackendRBDStatesLock);
+    if (virStorageBackendRBDStates)
+        virHashRemoveEntry(virStorageBackendRBDStates, uuidstr);
+    virMutexUnlock(&virStorageBackendRBDStatesLock);
 }
 
 
@@ -383,8 +435,22 @@ static virStorageBackendRBDStatePtr
 virStorageBackendRBDNewState(virStoragePoolObjPtr pool)
 {
     virStorageBackendRBDStatePtr ptr;
+    virStorageBackendRBDStatePtr other;
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
 
+    virUUIDFormat(def->uuid, uuidstr);
+
+    virMutexLock(&virStorageBackendRBDStatesLock);
+    if (virStorageBackendRBDStates &&
+        (ptr = virHashLookup(virStorageBackendRBDStates, uuidstr))) {
+        ptr->refs++;
+        virMutexUnlock(&virStorageBackendRBDStatesLock);
+        return ptr;
+    }
+    virMutexUnlock(&virStorageBackendRBDStatesLock);
+
+    /* Don't block users of other pools while connecting */
     if (VIR_ALLOC(ptr) < 0)
         return NULL;
 
@@ -394,10 +460,33 @@ virStorageBackendRBDNewState(virStoragePoolObjPtr pool)
     if (virStorageBackendRBDOpenIoCTX(ptr, pool) < 0)
         goto error;
 
+    /* One reference for the caller */
+    ptr->refs = 1;
+
+    virMutexLock(&virStorageBackendRBDStatesLock);
+    if (!virStorageBackendRBDStates &&
+        !(virStorageBackendRBDStates = virHashNew(virStorageBackendRBDStateUnref)))
+        goto unlock;
+
+    if ((other = virHashLookup(virStorageBackendRBDStates, uuidstr))) {
+        /* Somebody else connected meanwhile, use their connection */
+        other->refs++;
+        virMutexUnlock(&virStorageBackendRBDStatesLock);
+        virStorageBackendRBDDisposeState(ptr);
+        return other;
+    }
+
+    /* And one for the cache, a failure to cache the connection is
+     * not fatal though */
+    if (virHashAddEntry(virStorageBackendRBDStates, uuidstr, ptr) == 0)
+        ptr->refs++;
+
+ unlock:
+    virMutexUnlock(&virStorageBackendRBDStatesLock);
     return ptr;
 
  error:
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDDisposeState(ptr);
     return NULL;
 }
 
@@ -673,15 +762,56 @@ virStorageBackendRBDGetVolNames(virStorageBackendRBDStatePtr ptr)
 #endif /* ! HAVE_RBD_LIST2 */
 
 
+static int
+virStorageBackendRBDProbeVol(virStoragePoolObjPtr pool,
+                             virStorageBackendProbeJobPtr job,
+                             void *opaque)
+{
+    virStorageBackendRBDStatePtr ptr = opaque;
+    g_autoptr(virStorageVolDef) vol = NULL;
+    int rc;
+
+    if (VIR_ALLOC(vol) < 0)
+        return -1;
+
+    vol->name = g_strdup(job->name);
+
+    rc = volStorageBackendRBDRefreshVolInfo(vol, pool, ptr);
+
+    /* It could be that a volume has been deleted through a different route
+     * then libvirt and that will cause a -ENOENT to be returned.
+     *
+     * Another possibility is that there is something wrong with the placement
+     * group (PG) that RBD image's header is in and that causes -ETIMEDOUT
+     * to be returned.
+     *
+     * Do not error out and simply ignore the volume
+     */
+    if (rc < 0) {
+        if (rc == -ENOENT || rc == -ETIMEDOUT) {
+            virResetLastError();
+            return -2;
+        }
+
+        return -1;
+    }
+
+    job->vol = g_steal_pointer(&vol);
+    return 0;
+}
+
+
 static int
 virStorageBackendRBDRefreshPool(virStoragePoolObjPtr pool)
 {
-    int rc, ret = -1;
+    int ret = -1;
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
     virStorageBackendRBDStatePtr ptr = NULL;
     struct rados_cluster_stat_t clusterstat;
     struct rados_pool_stat_t poolstat;
     char **names = NULL;
+    virStorageBackendProbeJobPtr jobs = NULL;
+    size_t njobs = 0;
     size_t i;
 
     if (!(ptr = virStorageBackendRBDNewState(pool)))
@@ -711,34 +841,35 @@ virStorageBackendRBDRefreshPool(virStoragePoolObjPtr pool)
         goto cleanup;
 
     for (i = 0; names[i] != NULL; i++) {
-        g_autoptr(virStorageVolDef) vol = NULL;
+        virStorageBackendProbeJob job = { 0 };
 
-        if (VIR_ALLOC(vol) < 0)
-            goto cleanup;
+        job.name = g_steal_pointer(&names[i]);
 
-        vol->name = g_steal_pointer(&names[i]);
+        if (VIR_APPEND_ELEMENT(jobs, njobs, job) < 0) {
+            VIR_FREE(job.name);
+            goto cleanup;
+        }
+    }
 
-        rc = volStorageBackendRBDRefreshVolInfo(vol, pool, ptr);
+    /* Opening an image and querying its allocation takes a few round
+     * trips to the OSDs each, so do that for several images at once */
+    virStorageBackendProbeParallel(pool, jobs, njobs,
+                                   virStorageBackendRBDProbeVol, ptr);
 
-        /* It could be that a volume has been deleted through a different route
-         * then libvirt and that will cause a -ENOENT to be returned.
-         *
-         * Another possibility is that there is something wrong with the placement
-         * group (PG) that RBD image's header is in and that causes -ETIMEDOUT
-         * to be returned.
-         *
-         * Do not error out and simply ignore the volume
-         */
-        if (rc < 0) {
-            if (rc == -ENOENT || rc == -ETIMEDOUT)
-                continue;
+    for (i = 0; i < njobs; i++) {
+        virStorageBackendProbeJobPtr job = &jobs[i];
 
+        if (job->rc == -1) {
+            virErrorRestore(&job->error);
             goto cleanup;
         }
 
-        if (virStoragePoolObjAddVol(pool, vol) < 0)
+        if (job->rc == -2)
+            continue;
+
+        if (virStoragePoolObjAddVol(pool, job->vol) < 0)
             goto cleanup;
-        vol = NULL;
+        job->vol = NULL;
     }
 
     VIR_DEBUG("Found %zu images in RBD pool %s",
@@ -747,11 +878,23 @@ virStorageBackendRBDRefreshPool(virStoragePoolObjPtr pool)
     ret = 0;
 
  cleanup:
+    virStorageBackendProbeJobsFree(jobs, njobs);
     virStringListFree(names);
+    /* Don't keep a connection around which might be broken */
+    if (ret < 0)
+        virStorageBackendRBDForgetState(pool);
     virStorageBackendRBDFreeState(&ptr);
     return ret;
 }
 
+
+static int
+virStorageBackendRBDStopPool(virStoragePoolObjPtr pool)
+{
+    virStorageBackendRBDForgetState(pool);
+    return 0;
+}
+
 static int
 virStorageBackendRBDCleanupSnapshots(rados_ioctx_t ioctx,
                                      virStoragePoolSourcePtr source,
@@ -1466,6 +1609,7 @@ virStorageBackend virStorageBackendRBD = {
     .type = VIR_STORAGE_POOL_RBD,
 
     .refreshPool = virStorageBackendRBDRefreshPool,
+    .stopPool = virStorageBackendRBDStopPool,
     .createVol = virStorageBackendRBDCreateVol,
     .buildVol = virStorageBackendRBDBuildVol,
     .buildVolFrom = virStorageBackendRBDBuildVolFrom,
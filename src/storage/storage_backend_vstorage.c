@@ -159,6 +159,7 @@ virStorageBackend virStorageBackendVstorage = {
     .stopPool = virStorageBackendVzPoolStop,
     .deletePool = virStorageBackendDeleteLocal,
     .refreshPool = virStorageBackendRefreshLocal,
+    .incrementalRefresh = true,
     .checkPool = virStorageBackendVzCheck,
     .buildVol = virStorageBackendVolBuildLocal,
     .buildVolFrom = virStorageBackendVolBuildFromLocal,
@@ -99,7 +99,8 @@ storagePoolRefreshImpl(virStorageBackendPtr backend,
                        virStoragePoolObjPtr obj,
                        const char *stateFile)
 {
-    virStoragePoolObjClearVols(obj);
+    if (!backend->incrementalRefresh)
+        virStoragePoolObjClearVols(obj);
     if (backend->refreshPool(obj) < 0) {
         storagePoolRefreshFailCleanup(backend, obj, stateFile);
         return -1;
@@ -1596,9 +1597,13 @@ storageVolLookupByKey(virConnectPtr conn,
         .key = key, .voldef = NULL };
     virStorageVolPtr vol = NULL;
 
-    if ((obj = virStoragePoolObjListSearch(driver->pools,
-                                           storageVolLookupByKeyCallback,
-                                           &data)) && data.voldef) {
+    if (!(obj = virStoragePoolObjListFindVolByKey(driver->pools, key,
+                                                  &data.voldef)))
+        obj = virStoragePoolObjListSearch(driver->pools,
+                                          storageVolLookupByKeyCallback,
+                                          &data);
+
+    if (obj && data.voldef) {
         def = virStoragePoolObjGetDef(obj);
         if (virStorageVolLookupByKeyEnsureACL(conn, def, data.voldef) == 0) {
             vol = virGetStorageVol(conn, def->name,
@@ -1679,9 +1684,16 @@ storageVolLookupByPath(virConnectPtr conn,
     if (!(data.cleanpath = virFileSanitizePath(path)))
         return NULL;
 
-    if ((obj = virStoragePoolObjListSearch(driver->pools,
-                                           storageVolLookupByPathCallback,
-                                           &data)) && data.voldef) {
+    /* Most of the time the path is the target path of the volume and
+     * translating it to the stable path of every pool isn't needed */
+    if (!(obj = virStoragePoolObjListFindVolByPath(driver->pools,
+                                                   data.cleanpath,
+                                                   &data.voldef)))
+        obj = virStoragePoolObjListSearch(driver->pools,
+                                          storageVolLookupByPathCallback,
+                                          &data);
+
+    if (obj && data.voldef) {
         def = virStoragePoolObjGetDef(obj);
 
         if (virStorageVolLookupByPathEnsureACL(conn, def, data.voldef) == 0) {
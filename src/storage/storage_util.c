@@ -73,6 +73,8 @@
 #include "virstring.h"
 #include "virxml.h"
 #include "virfdstream.h"
+#include "virhash.h"
+#include "virthread.h"
 #include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
@@ -122,13 +124,189 @@ reflinkCloneFile(int dest_fd G_GNUC_UNUSED,
 #endif
 
 
+/*
+ * Let the kernel copy the data, which saves bouncing it through user
+ * space and lets file systems and storage offload the copy, e.g. NFS
+ * server side copy or SCSI XCOPY. Returns the number of bytes copied,
+ * or -1 and sets errno.
+ */
+#if HAVE_COPY_FILE_RANGE
+static inline ssize_t
+storageBackendCopyFileRange(int dest_fd, int src_fd, size_t len)
+{
+    return copy_file_range(src_fd, NULL, dest_fd, NULL, len, 0);
+}
+#else
+static inline ssize_t
+storageBackendCopyFileRange(int dest_fd G_GNUC_UNUSED,
+                            int src_fd G_GNUC_UNUSED,
+                            size_t len G_GNUC_UNUSED)
+{
+    errno = ENOSYS;
+    return -1;
+}
+#endif
+
+
+/*
+ * Zero a range of a block device, which devices supporting WRITE SAME
+ * or WRITE ZEROES do without any data being transferred. Upon success,
+ * return 0.  Otherwise, return -1 and set errno.
+ */
+#if defined(__linux__) && defined(BLKZEROOUT)
+static inline int
+storageBackendZeroBlockRange(int fd, off_t offset, off_t len)
+{
+    uint64_t range[2] = { offset, len };
+
+    return ioctl(fd, BLKZEROOUT, range);
+}
+#else
+static inline int
+storageBackendZeroBlockRange(int fd G_GNUC_UNUSED,
+                             off_t offset G_GNUC_UNUSED,
+                             off_t len G_GNUC_UNUSED)
+{
+    errno = ENOTSUP;
+    return -1;
+}
+#endif
+
+
+/*
+ * Discard a range of a block device. Reading it back afterwards doesn't
+ * necessarily return zeroes. Upon success, return 0.  Otherwise, return
+ * -1 and set errno.
+ */
+#if defined(__linux__) && defined(BLKDISCARD)
+static inline int
+storageBackendDiscardBlockRange(int fd, off_t offset, off_t len)
+{
+    uint64_t range[2] = { offset, len };
+
+    return ioctl(fd, BLKDISCARD, range);
+}
+#else
+static inline int
+storageBackendDiscardBlockRange(int fd G_GNUC_UNUSED,
+                                off_t offset G_GNUC_UNUSED,
+                                off_t len G_GNUC_UNUSED)
+{
+    errno = ENOTSUP;
+    return -1;
+}
+#endif
+
+
+/*
+ * Copies up to @total bytes from the current position of @inputfd to
+ * the current position of @fd without reading the data into a buffer.
+ * Holes of a sparse input are skipped if @want_sparse is true, zeroed
+ * on block devices otherwise. Both positions are advanced by the amount of data copied
+ * and @total is decreased by it, so that the copy can be finished by
+ * reading and writing when it can't be offloaded.
+ *
+ * Returns 0 when everything was copied, 1 when the rest has to be
+ * copied by the caller, -errno on error.
+ */
+static int
+storageBackendCopyOffload(virStorageVolDefPtr vol,
+                          virStorageVolDefPtr inputvol,
+                          int inputfd,
+                          int fd,
+                          bool input_sparse,
+                          bool block_dest,
+                          unsigned long long *total,
+                          bool want_sparse)
+{
+    off_t pos;
+    int ret;
+
+    if ((pos = lseek(inputfd, 0, SEEK_CUR)) < 0 ||
+        lseek(fd, pos, SEEK_SET) < 0)
+        return 1;
+
+    while (*total > 0) {
+        int inData = 1;
+        long long len = *total;
+        ssize_t copied;
+
+        if (input_sparse) {
+            if (virFileInData(inputfd, &inData, &len) < 0)
+                return -errno;
+
+            /* Implicit hole at the end of the input */
+            if (!inData && len == 0)
+                return 0;
+
+            if (len > *total)
+                len = *total;
+        }
+
+        if (!inData) {
+            /* Files are zeroed by writing, like the rest of their data */
+            if (!want_sparse &&
+                (!block_dest || storageBackendZeroBlockRange(fd, pos, len) < 0))
+                return 1;
+
+            pos += len;
+            *total -= len;
+
+            if (lseek(inputfd, pos, SEEK_SET) < 0 ||
+                lseek(fd, pos, SEEK_SET) < 0) {
+                ret = -errno;
+                virReportSystemError(errno,
+                                     _("cannot seek in file '%s'"),
+                                     vol->target.path);
+                return ret;
+            }
+            continue;
+        }
+
+        while (len > 0) {
+            if ((copied = storageBackendCopyFileRange(fd, inputfd, len)) < 0) {
+                if (errno == EINTR)
+                    continue;
+                if (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                    errno == EOPNOTSUPP || errno == ENOTSUP) {
+                    VIR_DEBUG("Falling back to copying '%s' by reading: %s",
+                              inputvol->target.path, g_strerror(errno));
+                    return 1;
+                }
+                ret = -errno;
+                virReportSystemError(errno,
+                                     _("failed to copy from '%s' to '%s'"),
+                                     inputvol->target.path, vol->target.path);
+                return ret;
+            }
+
+            /* The input is shorter than expected */
+            if (copied == 0)
+                return 0;
+
+            pos += copied;
+            len -= copied;
+            *total -= copied;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Copies @inputvol into @fd using the fastest method available: cloning
+ * the file, letting the kernel or the storage copy the data while
+ * skipping holes, and only then reading and writing the data.
+ */
 static int ATTRIBUTE_NONNULL(2)
 virStorageBackendCopyToFD(virStorageVolDefPtr vol,
                           virStorageVolDefPtr inputvol,
                           int fd,
                           unsigned long long *total,
                           bool want_sparse,
-                          bool reflink_copy)
+                          bool reflink_copy,
+                          bool try_reflink)
 {
     int amtread = -1;
     int ret = 0;
@@ -136,6 +314,8 @@ virStorageBackendCopyToFD(virStorageVolDefPtr vol,
     int wbytes = 0;
     int interval;
     struct stat st;
+    struct stat inputst;
+    bool have_st;
     g_autofree char *zerobuf = NULL;
     g_autofree char *buf = NULL;
     VIR_AUTOCLOSE inputfd = -1;
@@ -148,20 +328,7 @@ virStorageBackendCopyToFD(virStorageVolDefPtr vol,
         return ret;
     }
 
-#ifdef __linux__
-    if (ioctl(fd, BLKBSZGET, &wbytes) < 0)
-        wbytes = 0;
-#endif
-    if ((wbytes == 0) && fstat(fd, &st) == 0)
-        wbytes = st.st_blksize;
-    if (wbytes < WRITE_BLOCK_SIZE_DEFAULT)
-        wbytes = WRITE_BLOCK_SIZE_DEFAULT;
-
-    if (VIR_ALLOC_N(zerobuf, wbytes) < 0)
-        return -errno;
-
-    if (VIR_ALLOC_N(buf, rbytes) < 0)
-        return -errno;
+    have_st = fstat(fd, &st) == 0 && fstat(inputfd, &inputst) == 0;
 
     if (reflink_copy) {
         if (reflinkCloneFile(fd, inputfd) < 0) {
@@ -176,6 +343,63 @@ virStorageBackendCopyToFD(virStorageVolDefPtr vol,
         }
     }
 
+    /* Sharing the extents of the whole input is the cheapest copy there
+     * is, it falls back silently unless explicitly requested though */
+    if (try_reflink && have_st &&
+        S_ISREG(st.st_mode) && S_ISREG(inputst.st_mode) &&
+        inputst.st_size == *total) {
+        if (reflinkCloneFile(fd, inputfd) == 0) {
+            VIR_DEBUG("Cloned '%s' by reflink", inputvol->target.path);
+
+            /* Keep the size of the new volume, the clone might have
+             * changed it to the size of the input */
+            if (ftruncate(fd, st.st_size) < 0) {
+                ret = -errno;
+                virReportSystemError(errno,
+                                     _("cannot extend file '%s'"),
+                                     vol->target.path);
+                return ret;
+            }
+            *total = 0;
+            goto done;
+        }
+        VIR_DEBUG("Unable to reflink '%s': %s",
+                  inputvol->target.path, g_strerror(errno));
+    }
+
+    if (have_st) {
+        bool input_sparse = false;
+
+#if HAVE_DECL_SEEK_HOLE
+        input_sparse = S_ISREG(inputst.st_mode);
+#endif
+
+        if ((ret = storageBackendCopyOffload(vol, inputvol, inputfd, fd,
+                                             input_sparse,
+                                             S_ISBLK(st.st_mode),
+                                             total, want_sparse)) < 0)
+            return ret;
+
+        if (ret == 0)
+            goto done;
+        ret = 0;
+    }
+
+#ifdef __linux__
+    if (ioctl(fd, BLKBSZGET, &wbytes) < 0)
+        wbytes = 0;
+#endif
+    if ((wbytes == 0) && have_st)
+        wbytes = st.st_blksize;
+    if (wbytes < WRITE_BLOCK_SIZE_DEFAULT)
+        wbytes = WRITE_BLOCK_SIZE_DEFAULT;
+
+    if (VIR_ALLOC_N(zerobuf, wbytes) < 0)
+        return -errno;
+
+    if (VIR_ALLOC_N(buf, rbytes) < 0)
+        return -errno;
+
     while (amtread != 0) {
         int amtleft;
 
@@ -217,6 +441,7 @@ virStorageBackendCopyToFD(virStorageVolDefPtr vol,
         } while ((amtleft -= interval) > 0);
     }
 
+ done:
     if (virFileDataSync(fd) < 0) {
         ret = -errno;
         virReportSystemError(errno, _("cannot sync data to file '%s'"),
@@ -274,7 +499,7 @@ storageBackendCreateBlockFrom(virStoragePoolObjPtr pool G_GNUC_UNUSED,
 
     if (inputvol) {
         if (virStorageBackendCopyToFD(vol, inputvol, fd, &remain,
-                                      false, reflink_copy) < 0)
+                                      false, reflink_copy, false) < 0)
             return -1;
     }
 
@@ -363,11 +588,15 @@ createRawFile(int fd, virStorageVolDefPtr vol,
 
     if (inputvol) {
         unsigned long long remain = inputvol->target.capacity;
+        /* Only a sparse clone may share its data with the original */
+        bool try_reflink = vol->target.allocation < inputvol->target.capacity;
+
         /* allow zero blocks to be skipped if we've requested sparse
          * allocation (allocation < capacity) or we have already
          * been able to allocate the required space. */
         if ((ret = virStorageBackendCopyToFD(vol, inputvol, fd, &remain,
-                                             !need_alloc, reflink_copy)) < 0)
+                                             !need_alloc, reflink_copy,
+                                             try_reflink)) < 0)
             return ret;
 
         /* If the new allocation is greater than the original capacity,
@@ -2499,32 +2728,105 @@ storageBackendVolZeroSparseFileLocal(const char *path,
 }
 
 
+/* Upper bound of threads writing a volume being wiped, and the size of
+ * the chunks they take turns on */
+#define VIR_STORAGE_WIPE_WORKERS_MAX 4
+#define VIR_STORAGE_WIPE_CHUNK (64 * 1024 * 1024)
+
+typedef struct _virStorageBackendWipeData virStorageBackendWipeData;
+typedef virStorageBackendWipeData *virStorageBackendWipeDataPtr;
+struct _virStorageBackendWipeData {
+    int fd;
+    off_t start;
+    unsigned long long len;
+    size_t writebuf_length;
+    int nchunks;
+
+    int done;       /* number of chunks written */
+    int error;      /* errno of the first failed write */
+    off_t errorpos; /* where the first failed write was */
+};
+
+
+static void
+storageBackendWipeChunk(size_t chunk,
+                        void *opaque)
+{
+    virStorageBackendWipeDataPtr data = opaque;
+    unsigned long long offset = (unsigned long long) chunk * VIR_STORAGE_WIPE_CHUNK;
+    unsigned long long end = MIN(offset + VIR_STORAGE_WIPE_CHUNK, data->len);
+    g_autofree char *writebuf = NULL;
+    int done;
+
+    /* Skip the chunks left once any write failed */
+    if (g_atomic_int_get(&data->error))
+        return;
+
+    writebuf = g_new0(char, data->writebuf_length);
+
+    while (offset < end) {
+        size_t write_size = MIN(data->writebuf_length, end - offset);
+        ssize_t written = pwrite(data->fd, writebuf, write_size,
+                                 data->start + offset);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        if (written <= 0) {
+            int err = written < 0 ? errno : EIO;
+
+            if (g_atomic_int_compare_and_exchange(&data->error, 0, err))
+                data->errorpos = data->start + offset;
+            return;
+        }
+
+        offset += written;
+    }
+
+    if ((done = g_atomic_int_add(&data->done, 1) + 1) % 16 == 0)
+        VIR_DEBUG("Wiped %d of %d chunks", done, data->nchunks);
+}
+
+
+/*
+ * Let the storage zero the range without any data being written, which
+ * block devices do by WRITE SAME/WRITE ZEROES and file systems by just
+ * marking the extents unwritten. Returns 0 on success, -1 and sets
+ * errno if the range has to be written.
+ */
+static int
+storageBackendWipeOffload(int fd,
+                          bool block,
+                          off_t start,
+                          unsigned long long len)
+{
+    if (block)
+        return storageBackendZeroBlockRange(fd, start, len);
+
+#if HAVE_FALLOCATE - 0 && defined(FALLOC_FL_ZERO_RANGE)
+    return fallocate(fd, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE, start, len);
+#else
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+
 static int
 storageBackendWipeLocal(const char *path,
                         int fd,
+                        bool block,
                         unsigned long long wipe_len,
                         size_t writebuf_length,
                         bool zero_end)
 {
-    int written = 0;
-    unsigned long long remaining = 0;
-    off_t size;
-    size_t write_size = 0;
-    g_autofree char *writebuf = NULL;
-
-    if (VIR_ALLOC_N(writebuf, writebuf_length) < 0)
-        return -1;
+    virStorageBackendWipeData data = { 0 };
+    off_t start;
 
     if (!zero_end) {
-        if ((size = lseek(fd, 0, SEEK_SET)) < 0) {
-            virReportSystemError(errno,
-                                 _("Failed to seek to the start in volume "
-                                   "with path '%s'"),
-                                 path);
-            return -1;
-        }
+        start = 0;
     } else {
-        if ((size = lseek(fd, -wipe_len, SEEK_END)) < 0) {
+        if ((start = lseek(fd, -wipe_len, SEEK_END)) < 0) {
             virReportSystemError(errno,
                                  _("Failed to seek to %llu bytes to the end "
                                    "in volume with path '%s'"),
@@ -2533,25 +2835,38 @@ storageBackendWipeLocal(const char *path,
         }
     }
 
-    VIR_DEBUG("wiping start: %zd len: %llu", (ssize_t)size, wipe_len);
-
-    remaining = wipe_len;
-    while (remaining > 0) {
+    VIR_DEBUG("wiping start: %zd len: %llu", (ssize_t)start, wipe_len);
 
-        write_size = (writebuf_length < remaining) ? writebuf_length : remaining;
-        written = safewrite(fd, writebuf, write_size);
-        if (written < 0) {
-            virReportSystemError(errno,
-                                 _("Failed to write %zu bytes to "
-                                   "storage volume with path '%s'"),
-                                 write_size, path);
-
-            return -1;
-        }
+    if (wipe_len == 0)
+        return 0;
 
-        remaining -= written;
+    if (storageBackendWipeOffload(fd, block, start, wipe_len) == 0) {
+        VIR_DEBUG("Volume with path '%s' zeroed by the storage", path);
+        goto sync;
+    }
+    VIR_DEBUG("Unable to offload zeroing of '%s', writing zeroes: %s",
+              path, g_strerror(errno));
+
+    /* Writing large volumes is bound by the storage queue depth rather
+     * than by a single thread, so keep a few writes in flight */
+    data.fd = fd;
+    data.start = start;
+    data.len = wipe_len;
+    data.writebuf_length = writebuf_length;
+    data.nchunks = VIR_DIV_UP(wipe_len, VIR_STORAGE_WIPE_CHUNK);
+
+    virThreadForEachParallel(data.nchunks, VIR_STORAGE_WIPE_WORKERS_MAX,
+                             "storage-wipe", storageBackendWipeChunk, &data);
+
+    if (data.error) {
+        virReportSystemError(data.error,
+                             _("Failed to write to storage volume with path "
+                               "'%s' at offset %jd"),
+                             path, (intmax_t)data.errorpos);
+        return -1;
     }
 
+ sync:
     if (virFileDataSync(fd) < 0) {
         virReportSystemError(errno,
                              _("cannot sync data to volume with path '%s'"),
@@ -2565,6 +2880,56 @@ storageBackendWipeLocal(const char *path,
 }
 
 
+/*
+ * Discards the whole volume, which leaves the data unreadable both on
+ * thinly provisioned storage and sparse files while freeing the space
+ * it occupied.
+ */
+static int
+storageBackendVolTrimLocal(const char *path,
+                           int fd,
+                           struct stat *st)
+{
+    int rc = -1;
+
+    errno = ENOTSUP;
+    if (S_ISBLK(st->st_mode)) {
+        off_t size;
+
+        if ((size = lseek(fd, 0, SEEK_END)) < 0) {
+            virReportSystemError(errno,
+                                 _("Failed to get size of volume with path '%s'"),
+                                 path);
+            return -1;
+        }
+
+        rc = storageBackendDiscardBlockRange(fd, 0, size);
+    } else if (S_ISREG(st->st_mode)) {
+#if HAVE_FALLOCATE - 0 && defined(FALLOC_FL_PUNCH_HOLE)
+        rc = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                       0, st->st_size);
+#endif
+    }
+
+    if (rc < 0) {
+        if (errno == ENOTSUP || errno == EOPNOTSUPP) {
+            virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED,
+                           _("'trim' algorithm not supported for volume "
+                             "with path '%s'"),
+                           path);
+        } else {
+            virReportSystemError(errno,
+                                 _("Failed to trim storage volume with path '%s'"),
+                                 path);
+        }
+        return -1;
+    }
+
+    VIR_DEBUG("Trimmed volume with path '%s'", path);
+    return 0;
+}
+
+
 static int
 storageBackendVolWipeLocalFile(const char *path,
                                unsigned int algorithm,
@@ -2620,9 +2985,8 @@ storageBackendVolWipeLocalFile(const char *path,
         alg_char = "random";
         break;
     case VIR_STORAGE_VOL_WIPE_ALG_TRIM:
-        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED, "%s",
-                       _("'trim' algorithm not supported"));
-        return -1;
+        alg_char = "trim";
+        break;
     case VIR_STORAGE_VOL_WIPE_ALG_LAST:
         virReportError(VIR_ERR_INVALID_ARG,
                        _("unsupported algorithm %d"),
@@ -2632,6 +2996,9 @@ storageBackendVolWipeLocalFile(const char *path,
 
     VIR_DEBUG("Wiping file '%s' with algorithm '%s'", path, alg_char);
 
+    if (algorithm == VIR_STORAGE_VOL_WIPE_ALG_TRIM)
+        return storageBackendVolTrimLocal(path, fd, &st);
+
     if (algorithm != VIR_STORAGE_VOL_WIPE_ALG_ZERO) {
         cmd = virCommandNew(SCRUB);
         virCommandAddArgList(cmd, "-f", "-p", alg_char, path, NULL);
@@ -2642,8 +3009,8 @@ storageBackendVolWipeLocalFile(const char *path,
     if (S_ISREG(st.st_mode) && st.st_blocks < (st.st_size / DEV_BSIZE))
         return storageBackendVolZeroSparseFileLocal(path, st.st_size, fd);
 
-    return storageBackendWipeLocal(path, fd, allocation, st.st_blksize,
-                                   zero_end);
+    return storageBackendWipeLocal(path, fd, S_ISBLK(st.st_mode), allocation,
+                                   st.st_blksize, zero_end);
 }
 
 
@@ -3487,6 +3854,206 @@ virStorageBackendRefreshVolTargetUpdate(virStorageVolDefPtr vol)
  * Iterate over the pool's directory and enumerate all disk images
  * within it. This is non-recursive.
  */
+/*
+ * Tells whether @vol, as probed by a previous refresh, still describes
+ * the file at its path. Only plain files are considered, and anything
+ * stat reports about them must be the same as when they were probed.
+ */
+static bool
+virStorageBackendRefreshLocalVolUnchanged(virStorageVolDefPtr vol)
+{
+    virStorageSourcePtr target = &vol->target;
+    struct timespec mtime;
+    struct timespec ctime;
+    struct stat sb;
+
+    if (vol->type != VIR_STORAGE_VOL_FILE ||
+        !target->timestamps || !target->perms)
+        return false;
+
+    if (stat(target->path, &sb) < 0 || !S_ISREG(sb.st_mode))
+        return false;
+
+#ifdef __APPLE__
+    mtime = sb.st_mtimespec;
+    ctime = sb.st_ctimespec;
+#else /* ! __APPLE__ */
+    mtime = sb.st_mtim;
+    ctime = sb.st_ctim;
+#endif /* ! __APPLE__ */
+
+    return mtime.tv_sec == target->timestamps->mtime.tv_sec &&
+        mtime.tv_nsec == target->timestamps->mtime.tv_nsec &&
+        ctime.tv_sec == target->timestamps->ctime.tv_sec &&
+        ctime.tv_nsec == target->timestamps->ctime.tv_nsec &&
+        (unsigned long long)sb.st_size == target->physical &&
+        (unsigned long long)sb.st_blocks * DEV_BSIZE == target->allocation &&
+        (sb.st_mode & S_IRWXUGO) == target->perms->mode &&
+        sb.st_uid == target->perms->uid &&
+        sb.st_gid == target->perms->gid;
+}
+
+
+struct virStorageBackendRefreshLocalStaleData {
+    virHashTablePtr seen;
+    char **stale;
+};
+
+
+static int
+virStorageBackendRefreshLocalListStale(virStorageVolDefPtr voldef,
+                                       const void *opaque)
+{
+    struct virStorageBackendRefreshLocalStaleData *data = (void *) opaque;
+
+    if (!virHashLookup(data->seen, voldef->name))
+        return virStringListAdd(&data->stale, voldef->name);
+
+    return 0;
+}
+
+
+/*
+ * Removes volumes the last refresh found in @pool which are gone now,
+ * i.e. not listed in @seen.
+ */
+static int
+virStorageBackendRefreshLocalRemoveStale(virStoragePoolObjPtr pool,
+                                         virHashTablePtr seen)
+{
+    struct virStorageBackendRefreshLocalStaleData data = { seen, NULL };
+    size_t i;
+    int ret = -1;
+
+    if (virStoragePoolObjForEachVolume(pool,
+                                       virStorageBackendRefreshLocalListStale,
+                                       &data) < 0)
+        goto cleanup;
+
+    for (i = 0; data.stale && data.stale[i]; i++) {
+        virStorageVolDefPtr voldef = virStorageVolDefFindByName(pool,
+                                                                data.stale[i]);
+
+        if (voldef)
+            virStoragePoolObjRemoveVol(pool, voldef);
+    }
+
+    ret = 0;
+
+ cleanup:
+    virStringListFree(data.stale);
+    return ret;
+}
+
+
+/* Upper bound of threads probing volumes concurrently. Probing is
+ * bound by the latency of the storage rather than by CPU. */
+#define VIR_STORAGE_BACKEND_PROBE_WORKERS_MAX 8
+
+typedef struct _virStorageBackendProbeData virStorageBackendProbeData;
+typedef virStorageBackendProbeData *virStorageBackendProbeDataPtr;
+struct _virStorageBackendProbeData {
+    virStoragePoolObjPtr pool;
+    virStorageBackendProbeFunc probe;
+    void *opaque;
+    virStorageBackendProbeJobPtr jobs;
+};
+
+
+static void
+virStorageBackendProbeOne(size_t idx,
+                          void *opaque)
+{
+    virStorageBackendProbeDataPtr data = opaque;
+    virStorageBackendProbeJobPtr job = &data->jobs[idx];
+
+    /* Errors are thread local, keep them for the caller */
+    if ((job->rc = data->probe(data->pool, job, data->opaque)) == -1)
+        virErrorPreserveLast(&job->error);
+    else
+        virResetLastError();
+}
+
+
+/**
+ * virStorageBackendProbeParallel:
+ * @pool: pool the volumes are in
+ * @jobs: volumes to probe
+ * @njobs: number of @jobs
+ * @probe: callback probing a single volume
+ * @opaque: data passed to @probe
+ *
+ * Runs @probe for each of @jobs using a bounded number of threads,
+ * the calling one included. Results are stored in the jobs, which are
+ * to be processed by the caller in their order afterwards.
+ */
+void
+virStorageBackendProbeParallel(virStoragePoolObjPtr pool,
+                               virStorageBackendProbeJobPtr jobs,
+                               size_t njobs,
+                               virStorageBackendProbeFunc probe,
+                               void *opaque)
+{
+    virStorageBackendProbeData data = { pool, probe, opaque, jobs };
+
+    virThreadForEachParallel(njobs, VIR_STORAGE_BACKEND_PROBE_WORKERS_MAX,
+                             "storage-probe", virStorageBackendProbeOne,
+                             &data);
+}
+
+
+void
+virStorageBackendProbeJobsFree(virStorageBackendProbeJobPtr jobs,
+                               size_t njobs)
+{
+    size_t i;
+
+    for (i = 0; i < njobs; i++) {
+        VIR_FREE(jobs[i].name);
+        virStorageVolDefFree(jobs[i].vol);
+        virFreeError(jobs[i].error);
+    }
+    VIR_FREE(jobs);
+}
+
+
+/* Returns 1 if the volume found by the previous refresh can be kept */
+static int
+virStorageBackendRefreshLocalProbe(virStoragePoolObjPtr pool,
+                                   virStorageBackendProbeJobPtr job,
+                                   void *opaque G_GNUC_UNUSED)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    g_autoptr(virStorageVolDef) vol = NULL;
+    int rc;
+
+    if (job->old && virStorageBackendRefreshLocalVolUnchanged(job->old))
+        return 1;
+
+    if (VIR_ALLOC(vol) < 0)
+        return -1;
+
+    vol->name = g_strdup(job->name);
+
+    vol->type = VIR_STORAGE_VOL_FILE;
+    vol->target.path = g_strdup_printf("%s/%s", def->target.path, vol->name);
+
+    vol->key = g_strdup(vol->target.path);
+
+    if ((rc = virStorageBackendRefreshVolTargetUpdate(vol)) < 0)
+        return rc;
+
+    job->vol = g_steal_pointer(&vol);
+    return 0;
+}
+
+
+/*
+ * Volumes found by the previous refresh whose file didn't change since
+ * then are kept as they are, so that refreshing a pool with lots of
+ * images doesn't have to open and probe every single one of them again.
+ * The others are probed in parallel.
+ */
 int
 virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
 {
@@ -3497,15 +4064,19 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
     struct stat statbuf;
     int direrr;
     int ret = -1;
-    g_autoptr(virStorageVolDef) vol = NULL;
     VIR_AUTOCLOSE fd = -1;
     g_autoptr(virStorageSource) target = NULL;
+    g_autoptr(virHashTable) seen = virHashNew(NULL);
+    virStorageBackendProbeJobPtr jobs = NULL;
+    size_t njobs = 0;
+    size_t reused = 0;
+    size_t i;
 
     if (virDirOpen(&dir, def->target.path) < 0)
         goto cleanup;
 
     while ((direrr = virDirRead(dir, &ent, def->target.path)) > 0) {
-        int err;
+        virStorageBackendProbeJob job = { 0 };
 
         if (virStringHasControlChars(ent->d_name)) {
             VIR_WARN("Ignoring file '%s' with control characters under '%s'",
@@ -3513,34 +4084,58 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
             continue;
         }
 
-        if (VIR_ALLOC(vol) < 0)
-            goto cleanup;
+        job.name = g_strdup(ent->d_name);
+        job.old = virStorageVolDefFindByName(pool, ent->d_name);
 
-        vol->name = g_strdup(ent->d_name);
+        if (VIR_APPEND_ELEMENT(jobs, njobs, job) < 0) {
+            VIR_FREE(job.name);
+            goto cleanup;
+        }
+    }
+    if (direrr < 0)
+        goto cleanup;
+    VIR_DIR_CLOSE(dir);
 
-        vol->type = VIR_STORAGE_VOL_FILE;
-        vol->target.path = g_strdup_printf("%s/%s", def->target.path, vol->name);
+    virStorageBackendProbeParallel(pool, jobs, njobs,
+                                   virStorageBackendRefreshLocalProbe, NULL);
 
-        vol->key = g_strdup(vol->target.path);
+    for (i = 0; i < njobs; i++) {
+        virStorageBackendProbeJobPtr job = &jobs[i];
+        virStorageVolDefPtr vol;
 
-        if ((err = virStorageBackendRefreshVolTargetUpdate(vol)) < 0) {
-            if (err == -2) {
-                /* Silently ignore non-regular files,
-                 * eg 'lost+found', dangling symbolic link */
-                virStorageVolDefFree(vol);
-                vol = NULL;
-                continue;
-            }
+        if (job->rc == -1) {
+            virErrorRestore(&job->error);
             goto cleanup;
         }
 
-        if (virStoragePoolObjAddVol(pool, vol) < 0)
+        if (job->rc == 1) {
+            if (virHashAddEntry(seen, job->old->name, job->old) < 0)
+                goto cleanup;
+            reused++;
+            continue;
+        }
+
+        if (job->old)
+            virStoragePoolObjRemoveVol(pool, job->old);
+
+        /* Silently ignore non-regular files,
+         * eg 'lost+found', dangling symbolic link */
+        if (job->rc == -2)
+            continue;
+
+        if (virStoragePoolObjAddVol(pool, job->vol) < 0)
+            goto cleanup;
+        vol = g_steal_pointer(&job->vol);
+
+        if (virHashAddEntry(seen, vol->name, vol) < 0)
             goto cleanup;
-        vol = NULL;
     }
-    if (direrr < 0)
+
+    if (virStorageBackendRefreshLocalRemoveStale(pool, seen) < 0)
         goto cleanup;
-    VIR_DIR_CLOSE(dir);
+
+    VIR_DEBUG("Refreshed pool '%s': %zd volumes, %zu of them unchanged",
+              def->name, virHashSize(seen), reused);
 
     if (!(target = virStorageSourceNew()))
         goto cleanup;
@@ -3585,6 +4180,7 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
     ret = 0;
  cleanup:
     VIR_DIR_CLOSE(dir);
+    virStorageBackendProbeJobsFree(jobs, njobs);
     return ret;
 }
 
@@ -3612,7 +4208,8 @@ virStorageBackendSCSISerial(const char *dev,
 
 
 /*
- * Attempt to create a new LUN
+ * Attempt to create a new LUN, which is stored in @newvol. The volume
+ * is not added to @pool, which is only read.
  *
  * Returns:
  *
@@ -3627,7 +4224,8 @@ virStorageBackendSCSINewLun(virStoragePoolObjPtr pool,
                             uint32_t bus,
                             uint32_t target,
                             uint32_t lun,
-                            const char *dev)
+                            const char *dev,
+                            virStorageVolDefPtr *newvol)
 {
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
     int retval = -1;
@@ -3699,13 +4297,7 @@ virStorageBackendSCSINewLun(virStoragePoolObjPtr pool,
     if (!vol->key)
         return -1;
 
-    def->capacity += vol->target.capacity;
-    def->allocation += vol->target.allocation;
-
-    if (virStoragePoolObjAddVol(pool, vol) < 0)
-        return -1;
-    vol = NULL;
-
+    *newvol = g_steal_pointer(&vol);
     return 0;
 }
 
@@ -3891,7 +4483,8 @@ getDeviceType(uint32_t host,
 
 
 /*
- * Process a Logical Unit entry from the scsi host device directory
+ * Process a Logical Unit entry from the scsi host device directory,
+ * storing the volume created for it in @vol
  *
  * Returns:
  *
@@ -3904,7 +4497,8 @@ processLU(virStoragePoolObjPtr pool,
           uint32_t host,
           uint32_t bus,
           uint32_t target,
-          uint32_t lun)
+          uint32_t lun,
+          virStorageVolDefPtr *vol)
 {
     int retval = -1;
     int device_type;
@@ -3936,7 +4530,7 @@ processLU(virStoragePoolObjPtr pool,
     }
 
     retval = virStorageBackendSCSINewLun(pool, host, bus, target, lun,
-                                         block_device);
+                                         block_device, vol);
     if (retval < 0) {
         VIR_DEBUG("Failed to create new storage volume for %u:%u:%u:%u",
                   host, bus, target, lun);
@@ -3950,6 +4544,16 @@ processLU(virStoragePoolObjPtr pool,
 }
 
 
+static int
+virStorageBackendSCSIProbeLU(virStoragePoolObjPtr pool,
+                             virStorageBackendProbeJobPtr job,
+                             void *opaque G_GNUC_UNUSED)
+{
+    return processLU(pool, job->host, job->bus, job->target, job->lun,
+                     &job->vol);
+}
+
+
 int
 virStorageBackendSCSIFindLUs(virStoragePoolObjPtr pool,
                               uint32_t scanhost)
@@ -3961,6 +4565,9 @@ virStorageBackendSCSIFindLUs(virStoragePoolObjPtr pool,
     DIR *devicedir = NULL;
     struct dirent *lun_dirent = NULL;
     char devicepattern[64];
+    virStorageBackendProbeJobPtr jobs = NULL;
+    size_t njobs = 0;
+    size_t i;
     int found = 0;
 
     VIR_DEBUG("Discovering LUs on host %u", scanhost);
@@ -3973,7 +4580,7 @@ virStorageBackendSCSIFindLUs(virStoragePoolObjPtr pool,
     g_snprintf(devicepattern, sizeof(devicepattern), "%u:%%u:%%u:%%u\n", scanhost);
 
     while ((retval = virDirRead(devicedir, &lun_dirent, device_path)) > 0) {
-        int rc;
+        virStorageBackendProbeJob job = { 0 };
 
         if (sscanf(lun_dirent->d_name, devicepattern,
                    &bus, &target, &lun) != 3) {
@@ -3982,23 +4589,54 @@ virStorageBackendSCSIFindLUs(virStoragePoolObjPtr pool,
 
         VIR_DEBUG("Found possible LU '%s'", lun_dirent->d_name);
 
-        rc = processLU(pool, scanhost, bus, target, lun);
-        if (rc == -1) {
+        job.host = scanhost;
+        job.bus = bus;
+        job.target = target;
+        job.lun = lun;
+
+        if (VIR_APPEND_ELEMENT(jobs, njobs, job) < 0) {
             retval = -1;
             break;
         }
-        if (rc == 0)
-            found++;
     }
 
     VIR_DIR_CLOSE(devicedir);
 
     if (retval < 0)
-        return -1;
+        goto cleanup;
+
+    virStorageBackendProbeParallel(pool, jobs, njobs,
+                                   virStorageBackendSCSIProbeLU, NULL);
+
+    for (i = 0; i < njobs; i++) {
+        virStorageVolDefPtr vol = jobs[i].vol;
+
+        if (jobs[i].rc == -1) {
+            virErrorRestore(&jobs[i].error);
+            retval = -1;
+            goto cleanup;
+        }
+
+        if (jobs[i].rc < 0)
+            continue;
+
+        def->capacity += vol->target.capacity;
+        def->allocation += vol->target.allocation;
+
+        if (virStoragePoolObjAddVol(pool, vol) < 0) {
+            retval = -1;
+            goto cleanup;
+        }
+        jobs[i].vol = NULL;
+        found++;
+    }
 
     VIR_DEBUG("Found %d LUs for pool %s", found, def->name);
+    retval = found;
 
-    return found;
+ cleanup:
+    virStorageBackendProbeJobsFree(jobs, njobs);
+    return retval;
 }
 
 
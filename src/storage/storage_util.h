@@ -105,6 +105,39 @@ virStorageBackendRefreshVolTargetUpdate(virStorageVolDefPtr vol);
 
 int virStorageBackendRefreshLocal(virStoragePoolObjPtr pool);
 
+typedef struct _virStorageBackendProbeJob virStorageBackendProbeJob;
+typedef virStorageBackendProbeJob *virStorageBackendProbeJobPtr;
+struct _virStorageBackendProbeJob {
+    char *name;                 /* volume name, not needed for SCSI pools */
+    uint32_t host;              /* LU address, for SCSI pools */
+    uint32_t bus;
+    uint32_t target;
+    uint32_t lun;
+    virStorageVolDefPtr old;    /* volume found by the previous refresh */
+
+    virStorageVolDefPtr vol;    /* probed volume */
+    int rc;                     /* return value of the probe */
+    virErrorPtr error;          /* error reported by the probe if rc == -1 */
+};
+
+/* Probes a single volume. Must not modify @pool, it's only locked by
+ * the thread that started probing. */
+typedef int
+(*virStorageBackendProbeFunc)(virStoragePoolObjPtr pool,
+                              virStorageBackendProbeJobPtr job,
+                              void *opaque);
+
+void
+virStorageBackendProbeParallel(virStoragePoolObjPtr pool,
+                               virStorageBackendProbeJobPtr jobs,
+                               size_t njobs,
+                               virStorageBackendProbeFunc probe,
+                               void *opaque);
+
+void
+virStorageBackendProbeJobsFree(virStorageBackendProbeJobPtr jobs,
+                               size_t njobs);
+
 int virStorageUtilGlusterExtractPoolSources(const char *host,
                                             const char *xml,
                                             virStoragePoolSourceListPtr list,
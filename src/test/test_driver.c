@@ -92,6 +92,14 @@ struct _testAuth {
 typedef struct _testAuth testAuth;
 typedef struct _testAuth *testAuthPtr;
 
+/* Delay injected into the API @api, or into all of them if @api is NULL */
+struct _testLatency {
+    char *api;
+    unsigned int ms;
+};
+typedef struct _testLatency testLatency;
+typedef struct _testLatency *testLatencyPtr;
+
 struct _testDriver {
     virObjectLockable parent;
 
@@ -106,6 +114,10 @@ struct _testDriver {
     size_t numAuths;
     testAuthPtr auths;
 
+    /* immutable after being parsed from the config file */
+    size_t numLatencies;
+    testLatencyPtr latencies;
+
     /* g_atomic access only */
     volatile int nextDomID;
 
@@ -171,6 +183,9 @@ testDriverDispose(void *obj)
         g_free(driver->auths[i].password);
     }
     g_free(driver->auths);
+    for (i = 0; i < driver->numLatencies; i++)
+        g_free(driver->latencies[i].api);
+    g_free(driver->latencies);
 }
 
 typedef struct _testDomainNamespaceDef testDomainNamespaceDef;
@@ -179,6 +194,7 @@ struct _testDomainNamespaceDef {
     int runstate;
     bool transient;
     bool hasManagedSave;
+    unsigned int clones;
 
     unsigned int num_snap_nodes;
     xmlNodePtr *snap_nodes;
@@ -261,6 +277,13 @@ testDomainDefNamespaceParse(xmlXPathContextPtr ctxt,
         goto error;
     }
 
+    tmp = virXPathUInt("string(./test:clones)", ctxt, &nsdata->clones);
+    if (tmp == -2) {
+        virReportError(VIR_ERR_XML_ERROR, "%s",
+                       _("invalid clones"));
+        goto error;
+    }
+
     if (nsdata->transient && nsdata->runstate == VIR_DOMAIN_SHUTOFF) {
         virReportError(VIR_ERR_XML_ERROR, "%s",
             _("transient domain cannot have runstate 'shutoff'"));
@@ -618,13 +641,41 @@ static int testStoragePoolObjSetDefaults(virStoragePoolObjPtr obj);
 static int testNodeGetInfo(virConnectPtr conn, virNodeInfoPtr info);
 static virNetworkObjPtr testNetworkObjFindByName(testDriverPtr privconn, const char *name);
 
+/* Sleep for the latency configured for the API implemented by @func */
+static void
+testDriverInjectLatency(testDriverPtr driver, const char *func)
+{
+    const char *api = STRSKIP(func, "test");
+    unsigned int ms = 0;
+    size_t i;
+
+    for (i = 0; i < driver->numLatencies; i++) {
+        const char *name = driver->latencies[i].api;
+
+        if (!name) {
+            ms = driver->latencies[i].ms;
+        } else if (api && STREQ_NULLABLE(STRSKIP(name, "vir"), api)) {
+            ms = driver->latencies[i].ms;
+            break;
+        }
+    }
+
+    if (ms)
+        g_usleep(ms * 1000ull);
+}
+
+#define testDomObjFromDomain(domain) \
+    testDomObjFromDomainInternal(domain, __FUNCTION__)
+
 static virDomainObjPtr
-testDomObjFromDomain(virDomainPtr domain)
+testDomObjFromDomainInternal(virDomainPtr domain, const char *func)
 {
     virDomainObjPtr vm;
     testDriverPtr driver = domain->conn->privateData;
     char uuidstr[VIR_UUID_STRING_BUFLEN];
 
+    testDriverInjectLatency(driver, func);
+
     vm = virDomainObjListFindByUUID(driver->domains, domain->uuid);
     if (!vm) {
         virUUIDFormat(domain->uuid, uuidstr);
@@ -923,6 +974,66 @@ testParseDomainSnapshots(testDriverPtr privconn,
     return 0;
 }
 
+/* Add @nclones copies of the domain defined by @node, each of them named
+ * after the original one with an index appended and with a random UUID. */
+static int
+testParseDomainClones(testDriverPtr privconn,
+                      xmlXPathContextPtr ctxt,
+                      xmlNodePtr node,
+                      const char *name,
+                      unsigned int nclones)
+{
+    size_t i;
+
+    for (i = 1; i <= nclones; i++) {
+        virDomainDefPtr def;
+        virDomainObjPtr obj;
+        testDomainNamespaceDefPtr nsdata;
+
+        if (!(def = virDomainDefParseNode(ctxt->doc, node,
+                                          privconn->xmlopt, NULL,
+                                          VIR_DOMAIN_DEF_PARSE_INACTIVE)))
+            return -1;
+
+        g_free(def->name);
+        def->name = g_strdup_printf("%s-%zu", name, i);
+        if (virUUIDGenerate(def->uuid) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("failed to generate UUID"));
+            virDomainDefFree(def);
+            return -1;
+        }
+
+        if (testDomainGenerateIfnames(def) < 0 ||
+            !(obj = virDomainObjListAdd(privconn->domains,
+                                        def,
+                                        privconn->xmlopt,
+                                        0, NULL))) {
+            virDomainDefFree(def);
+            return -1;
+        }
+
+        nsdata = def->namespaceData;
+        obj->persistent = !nsdata->transient;
+        obj->hasManagedSave = nsdata->hasManagedSave;
+
+        if (nsdata->runstate != VIR_DOMAIN_SHUTOFF) {
+            if (testDomainStartState(privconn, obj,
+                                     VIR_DOMAIN_RUNNING_BOOTED) < 0) {
+                virDomainObjEndAPI(&obj);
+                return -1;
+            }
+        } else {
+            testDomainShutdownState(NULL, obj, 0);
+        }
+        virDomainObjSetState(obj, nsdata->runstate, 0);
+
+        virDomainObjEndAPI(&obj);
+    }
+
+    return 0;
+}
+
 static int
 testParseDomains(testDriverPtr privconn,
                  const char *file,
@@ -975,6 +1086,11 @@ testParseDomains(testDriverPtr privconn,
         }
         virDomainObjSetState(obj, nsdata->runstate, 0);
 
+        if (nsdata->clones &&
+            testParseDomainClones(privconn, ctxt, node, def->name,
+                                  nsdata->clones) < 0)
+            goto error;
+
         virDomainObjEndAPI(&obj);
     }
 
@@ -1229,6 +1345,37 @@ testParseAuthUsers(testDriverPtr privconn,
     return 0;
 }
 
+static int
+testParseLatencies(testDriverPtr privconn,
+                   xmlXPathContextPtr ctxt)
+{
+    int num;
+    size_t i;
+    g_autofree xmlNodePtr *nodes = NULL;
+
+    num = virXPathNodeSet("/node/latency", ctxt, &nodes);
+    if (num < 0)
+        return -1;
+
+    privconn->numLatencies = num;
+    if (num && VIR_ALLOC_N(privconn->latencies, num) < 0)
+        return -1;
+
+    for (i = 0; i < num; i++) {
+        ctxt->node = nodes[i];
+        if (virXPathUInt("string(./@ms)", ctxt,
+                         &privconn->latencies[i].ms) < 0) {
+            virReportError(VIR_ERR_XML_ERROR, "%s",
+                           _("missing or invalid ms in /node/latency field"));
+            return -1;
+        }
+        /* This field is optional. */
+        privconn->latencies[i].api = virXMLPropString(nodes[i], "api");
+    }
+
+    return 0;
+}
+
 static int
 testOpenParse(testDriverPtr privconn,
               const char *file,
@@ -1254,6 +1401,8 @@ testOpenParse(testDriverPtr privconn,
         return -1;
     if (testParseAuthUsers(privconn, ctxt) < 0)
         return -1;
+    if (testParseLatencies(privconn, ctxt) < 0)
+        return -1;
 
     return 0;
 }
@@ -1609,6 +1758,10 @@ testConnectSupportsFeature(virConnectPtr conn G_GNUC_UNUSED,
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_CHUNKS:
+    case VIR_DRV_FEATURE_REMOTE_COMPRESSION:
+    case VIR_DRV_FEATURE_REMOTE_PACKED_TYPED_PARAMS:
+    case VIR_DRV_FEATURE_MIGRATION_TUNNEL_STRIPES:
     default:
         return 0;
     }
@@ -1618,13 +1771,10 @@ testConnectSupportsFeature(virConnectPtr conn G_GNUC_UNUSED,
 static int testConnectNumOfDomains(virConnectPtr conn)
 {
     testDriverPtr privconn = conn->privateData;
-    int count;
 
-    virObjectLock(privconn);
-    count = virDomainObjListNumOfDomains(privconn->domains, true, NULL, NULL);
-    virObjectUnlock(privconn);
+    testDriverInjectLatency(privconn, __FUNCTION__);
 
-    return count;
+    return virDomainObjListNumOfDomains(privconn->domains, true, NULL, NULL);
 }
 
 static int testDomainIsActive(virDomainPtr dom)
@@ -1675,7 +1825,8 @@ testDomainCreateXML(virConnectPtr conn, const char *xml,
     if (flags & VIR_DOMAIN_START_VALIDATE)
         parse_flags |= VIR_DOMAIN_DEF_PARSE_VALIDATE_SCHEMA;
 
-    virObjectLock(privconn);
+    testDriverInjectLatency(privconn, __FUNCTION__);
+
     if ((def = virDomainDefParseString(xml, privconn->xmlopt,
                                        NULL, parse_flags)) == NULL)
         goto cleanup;
@@ -1707,7 +1858,6 @@ testDomainCreateXML(virConnectPtr conn, const char *xml,
     virDomainObjEndAPI(&dom);
     virObjectEventStateQueue(privconn->eventState, event);
     virDomainDefFree(def);
-    virObjectUnlock(privconn);
     return ret;
 }
 
@@ -1730,6 +1880,8 @@ static virDomainPtr testDomainLookupByID(virConnectPtr conn,
     virDomainPtr ret = NULL;
     virDomainObjPtr dom;
 
+    testDriverInjectLatency(privconn, __FUNCTION__);
+
     if (!(dom = virDomainObjListFindByID(privconn->domains, id))) {
         virReportError(VIR_ERR_NO_DOMAIN, NULL);
         return NULL;
@@ -1748,6 +1900,8 @@ static virDomainPtr testDomainLookupByUUID(virConnectPtr conn,
     virDomainPtr ret = NULL;
     virDomainObjPtr dom;
 
+    testDriverInjectLatency(privconn, __FUNCTION__);
+
     if (!(dom = virDomainObjListFindByUUID(privconn->domains, uuid))) {
         virReportError(VIR_ERR_NO_DOMAIN, NULL);
         return NULL;
@@ -1766,6 +1920,8 @@ static virDomainPtr testDomainLookupByName(virConnectPtr conn,
     virDomainPtr ret = NULL;
     virDomainObjPtr dom;
 
+    testDriverInjectLatency(privconn, __FUNCTION__);
+
     if (!(dom = virDomainObjListFindByName(privconn->domains, name))) {
         virReportError(VIR_ERR_NO_DOMAIN, NULL);
         goto cleanup;
@@ -1784,6 +1940,8 @@ static int testConnectListDomains(virConnectPtr conn,
 {
     testDriverPtr privconn = conn->privateData;
 
+    testDriverInjectLatency(privconn, __FUNCTION__);
+
     return virDomainObjListGetActiveIDs(privconn->domains, ids, maxids,
                                         NULL, NULL);
 }
@@ -4347,8 +4505,6 @@ static int testDomainCreateWithFlags(virDomainPtr domain, unsigned int flags)
 
     virCheckFlags(0, -1);
 
-    virObjectLock(privconn);
-
     if (!(privdom = testDomObjFromDomain(domain)))
         goto cleanup;
 
@@ -4371,7 +4527,6 @@ static int testDomainCreateWithFlags(virDomainPtr domain, unsigned int flags)
  cleanup:
     virDomainObjEndAPI(&privdom);
     virObjectEventStateQueue(privconn->eventState, event);
-    virObjectUnlock(privconn);
     return ret;
 }
 
@@ -7706,6 +7861,8 @@ static int testConnectListAllDomains(virConnectPtr conn,
 
     virCheckFlags(VIR_CONNECT_LIST_DOMAINS_FILTERS_ALL, -1);
 
+    testDriverInjectLatency(privconn, __FUNCTION__);
+
     return virDomainObjListExport(privconn->domains, conn, domains,
                                   NULL, flags);
 }
@@ -42,8 +42,352 @@
 # define O_DIRECT 0
 #endif
 
+/* Number of O_DIRECT requests kept in flight by default */
+#define IOHELPER_QUEUE_DEPTH 4
+#define IOHELPER_QUEUE_DEPTH_MAX 64
+
+/*
+ * With O_DIRECT every read or write waits for the device, so a single
+ * buffer keeps only one request in flight at a time. When the file was
+ * opened with O_DIRECT, the I/O on it is handed over to a pool of threads
+ * instead, each of them reading or writing one aligned buffer at its own
+ * offset, while the main thread copies the buffers from stdin or to
+ * stdout in order.
+ */
+typedef enum {
+    IO_QUEUE_BUF_FREE = 0,
+    IO_QUEUE_BUF_QUEUED,  /* waiting for a thread to do the I/O */
+    IO_QUEUE_BUF_BUSY,
+    IO_QUEUE_BUF_DONE,    /* data was read, waiting to be copied to stdout */
+} ioQueueBufState;
+
+typedef struct _ioQueueBuf ioQueueBuf;
+struct _ioQueueBuf {
+    char *buf;
+    void *base;
+    ioQueueBufState state;
+    off_t offset;
+    size_t len;
+};
+
+typedef struct _ioQueue ioQueue;
+struct _ioQueue {
+    virMutex lock;
+    virCond cond;
+
+    int fd;
+    bool reading;
+    size_t buflen;
+    ioQueueBuf *bufs;
+    size_t nbufs;
+    virThread *threads;
+    size_t nthreads;
+    bool eof;
+    int err;      /* errno of the first failed request */
+};
+
+
+static void
+ioQueueWorker(void *opaque)
+{
+    ioQueue *q = opaque;
+
+    virMutexLock(&q->lock);
+
+    for (;;) {
+        ioQueueBuf *qbuf = NULL;
+        size_t done = 0;
+        int err = 0;
+        size_t i;
+
+        for (i = 0; i < q->nbufs && !qbuf; i++) {
+            if (q->bufs[i].state == IO_QUEUE_BUF_QUEUED)
+                qbuf = &q->bufs[i];
+        }
+
+        if (!qbuf) {
+            if (q->eof || q->err)
+                break;
+            ignore_value(virCondWait(&q->cond, &q->lock));
+            continue;
+        }
+
+        qbuf->state = IO_QUEUE_BUF_BUSY;
+        virMutexUnlock(&q->lock);
+
+        if (q->reading) {
+            ssize_t got;
+
+            while ((got = pread(q->fd, qbuf->buf, q->buflen, qbuf->offset)) < 0 &&
+                   errno == EINTR)
+                ;
+            if (got < 0)
+                err = errno;
+            else
+                qbuf->len = got;
+        } else {
+            while (done < qbuf->len) {
+                ssize_t wrote = pwrite(q->fd, qbuf->buf + done,
+                                       qbuf->len - done, qbuf->offset + done);
+                if (wrote < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    err = errno;
+                    break;
+                }
+                done += wrote;
+            }
+        }
+
+        virMutexLock(&q->lock);
+        if (err && !q->err)
+            q->err = err;
+        qbuf->state = q->reading ? IO_QUEUE_BUF_DONE : IO_QUEUE_BUF_FREE;
+        virCondBroadcast(&q->cond);
+    }
+
+    virMutexUnlock(&q->lock);
+}
+
+
+static void
+ioQueueFree(ioQueue *q)
+{
+    size_t i;
+
+    virMutexLock(&q->lock);
+    q->eof = true;
+    virCondBroadcast(&q->cond);
+    virMutexUnlock(&q->lock);
+
+    for (i = 0; i < q->nthreads; i++)
+        virThreadJoin(&q->threads[i]);
+
+    for (i = 0; i < q->nbufs; i++)
+        g_free(q->bufs[i].base);
+    g_free(q->bufs);
+    g_free(q->threads);
+    virCondDestroy(&q->cond);
+    virMutexDestroy(&q->lock);
+}
+
+
+static int
+ioQueueInit(ioQueue *q,
+            int fd,
+            bool reading,
+            size_t buflen,
+            intptr_t alignMask,
+            size_t depth)
+{
+    size_t i;
+
+    memset(q, 0, sizeof(*q));
+
+    if (virMutexInit(&q->lock) < 0 || virCondInit(&q->cond) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to initialize I/O queue"));
+        return -1;
+    }
+
+    q->fd = fd;
+    q->reading = reading;
+    q->buflen = buflen;
+    q->bufs = g_new0(ioQueueBuf, depth);
+    q->nbufs = depth;
+    q->threads = g_new0(virThread, depth);
+
+    for (i = 0; i < depth; i++) {
+#if HAVE_POSIX_MEMALIGN
+        if (posix_memalign(&q->bufs[i].base, alignMask + 1, buflen)) {
+            virReportOOMError();
+            goto error;
+        }
+        q->bufs[i].buf = q->bufs[i].base;
+#else
+        q->bufs[i].base = g_new0(char, buflen + alignMask);
+        q->bufs[i].buf = (char *) (((intptr_t) q->bufs[i].base + alignMask) &
+                                   ~alignMask);
+#endif
+    }
+
+    for (i = 0; i < depth; i++) {
+        if (virThreadCreate(&q->threads[i], true, ioQueueWorker, q) < 0) {
+            virReportSystemError(errno, "%s", _("Unable to create I/O thread"));
+            goto error;
+        }
+        q->nthreads++;
+    }
+
+    return 0;
+
+ error:
+    ioQueueFree(q);
+    return -1;
+}
+
+
+/* Waits until @q has a buffer in @state. Returns NULL if a request
+ * failed in the meantime. Must be called with q->lock held. */
+static ioQueueBuf *
+ioQueueWaitBuf(ioQueue *q,
+               ioQueueBufState state,
+               off_t offset)
+{
+    size_t i;
+
+    while (!q->err) {
+        for (i = 0; i < q->nbufs; i++) {
+            if (q->bufs[i].state == state &&
+                (state == IO_QUEUE_BUF_FREE || q->bufs[i].offset == offset))
+                return &q->bufs[i];
+        }
+        ignore_value(virCondWait(&q->cond, &q->lock));
+    }
+
+    return NULL;
+}
+
+
+static int
+runIODirectWrite(int fdin, const char *fdinname,
+                 int fdout, const char *fdoutname,
+                 size_t buflen, intptr_t alignMask,
+                 size_t depth)
+{
+    ioQueue q;
+    unsigned long long total = 0;
+    bool padded = false;
+
+    if (ioQueueInit(&q, fdout, false, buflen, alignMask, depth) < 0)
+        return -1;
+
+    while (!padded) {
+        ioQueueBuf *qbuf;
+        ssize_t got;
+
+        virMutexLock(&q.lock);
+        qbuf = ioQueueWaitBuf(&q, IO_QUEUE_BUF_FREE, 0);
+        virMutexUnlock(&q.lock);
+
+        if (!qbuf)
+            break;
+
+        /* Using saferead so that writes will be aligned */
+        if ((got = saferead(fdin, qbuf->buf, buflen)) < 0) {
+            virReportSystemError(errno, _("Unable to read %s"), fdinname);
+            goto cleanup;
+        }
+        if (got == 0)
+            break;
+
+        qbuf->offset = total;
+        qbuf->len = got;
+
+        /* handle last write size align in direct case */
+        if (got < buflen) {
+            qbuf->len = (got + alignMask) & ~alignMask;
+            memset(qbuf->buf + got, 0, qbuf->len - got);
+            padded = true;
+        }
+
+        virMutexLock(&q.lock);
+        qbuf->state = IO_QUEUE_BUF_QUEUED;
+        virCondBroadcast(&q.cond);
+        virMutexUnlock(&q.lock);
+
+        total += got;
+    }
+
+    /* Wait for the outstanding writes */
+    ioQueueFree(&q);
+
+    if (q.err) {
+        virReportSystemError(q.err, _("Unable to write %s"), fdoutname);
+        return -1;
+    }
+
+    if (padded && ftruncate(fdout, total) < 0) {
+        virReportSystemError(errno, _("Unable to truncate %s"), fdoutname);
+        return -1;
+    }
+
+    return 0;
+
+ cleanup:
+    ioQueueFree(&q);
+    return -1;
+}
+
+
 static int
-runIO(const char *path, int fd, int oflags)
+runIODirectRead(int fdin, const char *fdinname,
+                int fdout, const char *fdoutname,
+                size_t buflen, intptr_t alignMask,
+                size_t depth)
+{
+    ioQueue q;
+    off_t next = 0;     /* offset of the next buffer to be read */
+    off_t offset = 0;   /* offset of the next buffer to be copied */
+    bool eof = false;
+    size_t i;
+    int ret = -1;
+
+    if (ioQueueInit(&q, fdin, true, buflen, alignMask, depth) < 0)
+        return -1;
+
+    virMutexLock(&q.lock);
+
+    for (i = 0; i < q.nbufs; i++) {
+        q.bufs[i].offset = next;
+        q.bufs[i].state = IO_QUEUE_BUF_QUEUED;
+        next += buflen;
+    }
+    virCondBroadcast(&q.cond);
+
+    while (!eof) {
+        ioQueueBuf *qbuf;
+        size_t len;
+
+        if (!(qbuf = ioQueueWaitBuf(&q, IO_QUEUE_BUF_DONE, offset))) {
+            virMutexUnlock(&q.lock);
+            virReportSystemError(q.err, _("Unable to read %s"), fdinname);
+            goto cleanup;
+        }
+        virMutexUnlock(&q.lock);
+
+        len = qbuf->len;
+        if (len < buflen)
+            eof = true;
+
+        if (len > 0 && safewrite(fdout, qbuf->buf, len) < 0) {
+            virReportSystemError(errno, _("Unable to write %s"), fdoutname);
+            goto cleanup;
+        }
+
+        offset += buflen;
+
+        virMutexLock(&q.lock);
+        if (eof) {
+            qbuf->state = IO_QUEUE_BUF_FREE;
+        } else {
+            qbuf->offset = next;
+            qbuf->state = IO_QUEUE_BUF_QUEUED;
+            next += buflen;
+            virCondBroadcast(&q.cond);
+        }
+    }
+
+    virMutexUnlock(&q.lock);
+    ret = 0;
+
+ cleanup:
+    ioQueueFree(&q);
+    return ret;
+}
+
+
+static int
+runIO(const char *path, int fd, int oflags, size_t depth)
 {
     g_autofree void *base = NULL; /* Location to be freed */
     char *buf = NULL; /* Aligned location within base */
@@ -105,6 +449,19 @@ runIO(const char *path, int fd, int oflags)
         goto cleanup;
     }
 
+    if (direct && depth > 1) {
+        if (fdout == fd) {
+            if (runIODirectWrite(fdin, fdinname, fdout, fdoutname,
+                                 buflen, alignMask, depth) < 0)
+                goto cleanup;
+        } else {
+            if (runIODirectRead(fdin, fdinname, fdout, fdoutname,
+                                buflen, alignMask, depth) < 0)
+                goto cleanup;
+        }
+        goto sync;
+    }
+
     while (1) {
         ssize_t got;
 
@@ -157,6 +514,7 @@ runIO(const char *path, int fd, int oflags)
     }
 
     /* Ensure all data is written */
+ sync:
     if (virFileDataSync(fdout) < 0) {
         if (errno != EINVAL && errno != EROFS) {
             /* fdatasync() may fail on some special FDs, e.g. pipes */
@@ -184,7 +542,7 @@ usage(int status)
     if (status) {
         fprintf(stderr, _("%s: try --help for more details"), program_name);
     } else {
-        printf(_("Usage: %s FILENAME FD"), program_name);
+        printf(_("Usage: %s FILENAME FD [QUEUE_DEPTH]"), program_name);
     }
     exit(status);
 }
@@ -195,6 +553,7 @@ main(int argc, char **argv)
     const char *path;
     int oflags = -1;
     int fd = -1;
+    unsigned int depth = IOHELPER_QUEUE_DEPTH;
 
     program_name = argv[0];
 
@@ -208,7 +567,15 @@ main(int argc, char **argv)
 
     if (argc > 1 && STREQ(argv[1], "--help"))
         usage(EXIT_SUCCESS);
-    if (argc == 3) { /* FILENAME FD */
+    if (argc == 4) { /* FILENAME FD QUEUE_DEPTH */
+        if (virStrToLong_ui(argv[3], NULL, 10, &depth) < 0 ||
+            depth == 0 || depth > IOHELPER_QUEUE_DEPTH_MAX) {
+            fprintf(stderr, _("%s: malformed queue depth %s"),
+                    program_name, argv[3]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (argc == 3 || argc == 4) { /* FILENAME FD */
         if (virStrToLong_i(argv[2], NULL, 10, &fd) < 0) {
             fprintf(stderr, _("%s: malformed fd %s"),
                     program_name, argv[3]);
@@ -232,7 +599,7 @@ main(int argc, char **argv)
         usage(EXIT_FAILURE);
     }
 
-    if (fd < 0 || runIO(path, fd, oflags) < 0)
+    if (fd < 0 || runIO(path, fd, oflags, depth) < 0)
         goto error;
 
     return 0;
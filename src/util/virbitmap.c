@@ -405,39 +405,27 @@ char *
 virBitmapFormat(virBitmapPtr bitmap)
 {
     virBuffer buf = VIR_BUFFER_INITIALIZER;
-    bool first = true;
-    int start, cur, prev;
+    ssize_t start;
+    ssize_t end;
 
-    if (!bitmap || (cur = virBitmapNextSetBit(bitmap, -1)) < 0) {
-        char *ret;
-        ret = g_strdup("");
-        return ret;
-    }
-
-    start = prev = cur;
-    while (prev >= 0) {
-        cur = virBitmapNextSetBit(bitmap, prev);
-
-        if (cur == prev + 1) {
-            prev = cur;
-            continue;
-        }
-
-        /* cur < 0 or cur > prev + 1 */
+    if (!bitmap || (start = virBitmapNextSetBit(bitmap, -1)) < 0)
+        return g_strdup("");
 
-        if (!first)
-            virBufferAddLit(&buf, ",");
-        else
-            first = false;
+    /* Jump over whole runs of set bits rather than visiting every bit */
+    while (start >= 0) {
+        if ((end = virBitmapNextClearBit(bitmap, start)) < 0)
+            end = bitmap->nbits;
 
-        if (prev == start)
-            virBufferAsprintf(&buf, "%d", start);
+        if (end - 1 == start)
+            virBufferAsprintf(&buf, "%zd,", start);
         else
-            virBufferAsprintf(&buf, "%d-%d", start, prev);
+            virBufferAsprintf(&buf, "%zd-%zd,", start, end - 1);
 
-        start = prev = cur;
+        start = virBitmapNextSetBit(bitmap, end);
     }
 
+    virBufferTrimLen(&buf, 1);
+
     return virBufferContentAndReset(&buf);
 }
 
@@ -859,12 +847,10 @@ virBitmapEqual(virBitmapPtr b1,
 
     /* Now b1 is the smaller one, if not equal */
 
-    for (i = 0; i < b1->map_len; i++) {
-        if (b1->map[i] != b2->map[i])
-            return false;
-    }
+    if (memcmp(b1->map, b2->map, b1->map_len * sizeof(*b1->map)) != 0)
+        return false;
 
-    for (; i < b2->map_len; i++) {
+    for (i = b1->map_len; i < b2->map_len; i++) {
         if (b2->map[i])
             return false;
     }
@@ -1025,7 +1011,6 @@ virBitmapNextSetBit(virBitmapPtr bitmap,
 ssize_t
 virBitmapLastSetBit(virBitmapPtr bitmap)
 {
-    ssize_t i;
     int unusedBits;
     ssize_t sz;
     unsigned long bits;
@@ -1055,12 +1040,8 @@ virBitmapLastSetBit(virBitmapPtr bitmap)
     return -1;
 
  found:
-    for (i = VIR_BITMAP_BITS_PER_UNIT - 1; i >= 0; i--) {
-        if (bits & 1UL << i)
-            return i + sz * VIR_BITMAP_BITS_PER_UNIT;
-    }
-
-    return -1;
+    return VIR_BITMAP_BITS_PER_UNIT - 1 - __builtin_clzl(bits) +
+        sz * VIR_BITMAP_BITS_PER_UNIT;
 }
 
 
@@ -319,13 +319,110 @@ virBufferAsprintf(virBufferPtr buf, const char *format, ...)
 void
 virBufferVasprintf(virBufferPtr buf, const char *format, va_list argptr)
 {
+    va_list copy;
+    size_t oldlen;
+    size_t avail;
+    int len;
+
     if ((format == NULL) || (buf == NULL))
         return;
 
     virBufferInitialize(buf);
     virBufferApplyIndent(buf);
 
-    g_string_append_vprintf(buf->str, format, argptr);
+    /* Format right into the spare room of the buffer instead of into a
+     * temporary string which would have to be copied over. Only if the
+     * output does not fit the buffer is grown and formatting repeated. */
+    oldlen = buf->str->len;
+    avail = buf->str->allocated_len - oldlen;
+
+    va_copy(copy, argptr);
+    len = g_vsnprintf(buf->str->str + oldlen, avail, format, copy);
+    va_end(copy);
+
+    if (len < 0) {
+        buf->str->str[oldlen] = '\0';
+        return;
+    }
+
+    if ((size_t) len >= avail) {
+        g_string_set_size(buf->str, oldlen + len);
+        g_vsnprintf(buf->str->str + oldlen, len + 1, format, argptr);
+    } else {
+        buf->str->len = oldlen + len;
+    }
+}
+
+
+/* Characters which are either escaped or dropped when formatting XML,
+ * plus the terminating NUL. This is looked up directly for every byte
+ * instead of going through strcspn, which has to build the same table
+ * on every call. */
+static const bool virBufferXMLSpecialChars[256] = {
+    [0x00] = true,
+    [0x01] = true, [0x02] = true, [0x03] = true, [0x04] = true,
+    [0x05] = true, [0x06] = true, [0x07] = true, [0x08] = true,
+    /* \t, \n */   [0x0B] = true, [0x0C] = true, /* \r */
+    [0x0E] = true, [0x0F] = true, [0x10] = true,
+    [0x11] = true, [0x12] = true, [0x13] = true, [0x14] = true,
+    [0x15] = true, [0x16] = true, [0x17] = true, [0x18] = true,
+    [0x19] = true,
+    ['"'] = true, ['&'] = true, ['\''] = true, ['<'] = true, ['>'] = true,
+};
+
+
+/* Returns the length of the leading part of @str which needs no escaping */
+static size_t
+virBufferXMLPlainLen(const char *str)
+{
+    const unsigned char *cur = (const unsigned char *) str;
+
+    while (!virBufferXMLSpecialChars[*cur])
+        cur++;
+
+    return cur - (const unsigned char *) str;
+}
+
+
+/* Appends @str escaped for use in XML right to @buf, copying the runs
+ * of characters which need no escaping at once. Note that character
+ * over 0x80 are likely to give problem with UTF-8 XML, but since our
+ * string don't have an encoding it's hard to handle properly we have
+ * to assume it's UTF-8 too. */
+static void
+virBufferAppendEscapedXML(virBufferPtr buf,
+                          const char *str)
+{
+    while (*str) {
+        size_t len = virBufferXMLPlainLen(str);
+
+        g_string_append_len(buf->str, str, len);
+        str += len;
+
+        switch (*str) {
+        case '\0':
+            return;
+        case '<':
+            g_string_append_len(buf->str, "&lt;", 4);
+            break;
+        case '>':
+            g_string_append_len(buf->str, "&gt;", 4);
+            break;
+        case '&':
+            g_string_append_len(buf->str, "&amp;", 5);
+            break;
+        case '"':
+            g_string_append_len(buf->str, "&quot;", 6);
+            break;
+        case '\'':
+            g_string_append_len(buf->str, "&apos;", 6);
+            break;
+        default:
+            /* silently ignore control characters */
+            break;
+        }
+        str++;
+    }
 }
 
 
@@ -343,78 +440,34 @@ virBufferVasprintf(virBufferPtr buf, const char *format, va_list argptr)
 void
 virBufferEscapeString(virBufferPtr buf, const char *format, const char *str)
 {
-    int len;
-    g_autofree char *escaped = NULL;
-    char *out;
-    const char *cur;
-    const char forbidden_characters[] = {
-        0x01,   0x02,   0x03,   0x04,   0x05,   0x06,   0x07,   0x08,
-        /*\t*/  /*\n*/  0x0B,   0x0C,   /*\r*/  0x0E,   0x0F,   0x10,
-        0x11,   0x12,   0x13,   0x14,   0x15,   0x16,   0x17,   0x18,
-        0x19,   '"',    '&',    '\'',   '<',    '>',
-        '\0'
-    };
+    g_auto(virBuffer) escaped = VIR_BUFFER_INITIALIZER;
+    const char *conv;
 
     if ((format == NULL) || (buf == NULL) || (str == NULL))
         return;
 
-    len = strlen(str);
-    if (strcspn(str, forbidden_characters) == len) {
-        virBufferAsprintf(buf, format, str);
+    /* Nearly all callers pass a format with a single conversion, "%s",
+     * in which case the pieces around it are copied literally and @str
+     * is escaped right into the buffer, without going through printf. */
+    if ((conv = strchr(format, '%')) && conv[1] == 's' &&
+        !strchr(conv + 2, '%')) {
+        virBufferInitialize(buf);
+        virBufferApplyIndent(buf);
+        g_string_append_len(buf->str, format, conv - format);
+        virBufferAppendEscapedXML(buf, str);
+        g_string_append(buf->str, conv + 2);
         return;
     }
 
-    escaped = g_malloc0_n(len + 1, 6);
-
-    cur = str;
-    out = escaped;
-    while (*cur != 0) {
-        if (*cur == '<') {
-            *out++ = '&';
-            *out++ = 'l';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '>') {
-            *out++ = '&';
-            *out++ = 'g';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '&') {
-            *out++ = '&';
-            *out++ = 'a';
-            *out++ = 'm';
-            *out++ = 'p';
-            *out++ = ';';
-        } else if (*cur == '"') {
-            *out++ = '&';
-            *out++ = 'q';
-            *out++ = 'u';
-            *out++ = 'o';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '\'') {
-            *out++ = '&';
-            *out++ = 'a';
-            *out++ = 'p';
-            *out++ = 'o';
-            *out++ = 's';
-            *out++ = ';';
-        } else if (!strchr(forbidden_characters, *cur)) {
-            /*
-             * default case, just copy !
-             * Note that character over 0x80 are likely to give problem
-             * with UTF-8 XML, but since our string don't have an encoding
-             * it's hard to handle properly we have to assume it's UTF-8 too
-             */
-            *out++ = *cur;
-        } else {
-            /* silently ignore control characters */
-        }
-        cur++;
+    if (str[virBufferXMLPlainLen(str)] == '\0') {
+        virBufferAsprintf(buf, format, str);
+        return;
     }
-    *out = 0;
 
-    virBufferAsprintf(buf, format, escaped);
+    virBufferInitialize(&escaped);
+    virBufferAppendEscapedXML(&escaped, str);
+
+    virBufferAsprintf(buf, format, virBufferCurrentContent(&escaped));
 }
 
 /**
@@ -496,10 +549,36 @@ virBufferEscape(virBufferPtr buf, char escape, const char *toescape,
     g_autofree char *escaped = NULL;
     char *out;
     const char *cur;
+    const char *conv;
 
     if ((format == NULL) || (buf == NULL) || (str == NULL))
         return;
 
+    /* Same as in virBufferEscapeString, escape @str right into the
+     * buffer if @format has no other conversion than "%s" */
+    if ((conv = strchr(format, '%')) && conv[1] == 's' &&
+        !strchr(conv + 2, '%')) {
+        virBufferInitialize(buf);
+        virBufferApplyIndent(buf);
+        g_string_append_len(buf->str, format, conv - format);
+
+        while (*str) {
+            size_t plain = strcspn(str, toescape);
+
+            g_string_append_len(buf->str, str, plain);
+            str += plain;
+
+            if (!*str)
+                break;
+
+            g_string_append_c(buf->str, escape);
+            g_string_append_c(buf->str, *str++);
+        }
+
+        g_string_append(buf->str, conv + 2);
+        return;
+    }
+
     len = strlen(str);
     if (strcspn(str, toescape) == len) {
         virBufferAsprintf(buf, format, str);
@@ -25,6 +25,7 @@
 # include <sys/mount.h>
 # include <fcntl.h>
 # include <sys/stat.h>
+# include <sys/statfs.h>
 # include <sys/sysmacros.h>
 # include <sys/types.h>
 # include <signal.h>
@@ -496,6 +497,225 @@ virCgroupGetValueRaw(const char *path,
 }
 
 
+/*
+ * Values of a cgroup are set and read over and over again, e.g., when
+ * tuning vCPUs or polling CPU statistics. Instead of opening and closing
+ * the file each time, keep it open for as long as the virCgroup exists.
+ * Only files on a cgroup filesystem are cached because writing to them
+ * at offset zero always replaces the whole value.
+ */
+# ifndef CGROUP_SUPER_MAGIC
+#  define CGROUP_SUPER_MAGIC 0x27e0eb
+# endif
+# ifndef CGROUP2_SUPER_MAGIC
+#  define CGROUP2_SUPER_MAGIC 0x63677270
+# endif
+
+# define VIR_CGROUP_FILE_UNKNOWN -2
+
+typedef struct _virCgroupFile virCgroupFile;
+typedef virCgroupFile *virCgroupFilePtr;
+struct _virCgroupFile {
+    int readfd;  /* VIR_CGROUP_FILE_UNKNOWN if not opened yet, */
+    int writefd; /* -1 if it can't be kept open */
+};
+
+
+static void
+virCgroupFileFree(void *opaque)
+{
+    virCgroupFilePtr file = opaque;
+
+    if (!file)
+        return;
+
+    if (file->readfd >= 0)
+        VIR_FORCE_CLOSE(file->readfd);
+    if (file->writefd >= 0)
+        VIR_FORCE_CLOSE(file->writefd);
+    g_free(file);
+}
+
+
+static bool
+virCgroupFileIsCgroupFS(int fd)
+{
+    struct statfs sb;
+
+    if (fstatfs(fd, &sb) < 0)
+        return false;
+
+    return sb.f_type == CGROUP_SUPER_MAGIC ||
+           sb.f_type == CGROUP2_SUPER_MAGIC;
+}
+
+
+/* Returns a file descriptor of @path opened for reading or writing,
+ * which is owned by @group, or -1 if the file can't be kept open.
+ * Must be called with group->filesLock held. */
+static int
+virCgroupFileGetFD(virCgroupPtr group,
+                   const char *path,
+                   bool write)
+{
+    virCgroupFilePtr file;
+    int *fdp;
+
+    if (!group->files &&
+        !(group->files = virHashNew(virCgroupFileFree)))
+        return -1;
+
+    if (!(file = virHashLookup(group->files, path))) {
+        file = g_new0(virCgroupFile, 1);
+        file->readfd = file->writefd = VIR_CGROUP_FILE_UNKNOWN;
+        if (virHashAddEntry(group->files, path, file) < 0) {
+            g_free(file);
+            return -1;
+        }
+    }
+
+    fdp = write ? &file->writefd : &file->readfd;
+
+    if (*fdp == VIR_CGROUP_FILE_UNKNOWN) {
+        /* Errors are reported by the uncached fallback */
+        *fdp = open(path, (write ? O_WRONLY : O_RDONLY) | O_CLOEXEC);
+        if (*fdp >= 0 && !virCgroupFileIsCgroupFS(*fdp))
+            VIR_FORCE_CLOSE(*fdp);
+        if (*fdp < 0)
+            *fdp = -1;
+    }
+
+    return *fdp;
+}
+
+
+/**
+ * virCgroupCloseFiles:
+ * @group: cgroup
+ *
+ * Closes all files of @group which were kept open. This has to be
+ * done before the cgroup is removed.
+ */
+static void
+virCgroupCloseFiles(virCgroupPtr group)
+{
+    virMutexLock(&group->filesLock);
+    virHashFree(group->files);
+    group->files = NULL;
+    virMutexUnlock(&group->filesLock);
+}
+
+
+/* Returns 0 on success, -1 on error and 1 if @path can't be written
+ * through a cached file descriptor. */
+static int
+virCgroupSetValueCached(virCgroupPtr group,
+                        const char *path,
+                        const char *value)
+{
+    size_t len = strlen(value);
+    ssize_t rc;
+    int err;
+    int fd;
+    char *tmp;
+
+    virMutexLock(&group->filesLock);
+
+    if ((fd = virCgroupFileGetFD(group, path, true)) < 0) {
+        virMutexUnlock(&group->filesLock);
+        return 1;
+    }
+
+    VIR_DEBUG("Set value '%s' to '%s'", path, value);
+    while ((rc = pwrite(fd, value, len, 0)) < 0 && errno == EINTR)
+        ;
+    err = errno;
+
+    virMutexUnlock(&group->filesLock);
+
+    if (rc < 0) {
+        if (err == EINVAL &&
+            (tmp = strrchr(path, '/'))) {
+            virReportSystemError(err,
+                                 _("Invalid value '%s' for '%s'"),
+                                 value, tmp + 1);
+            return -1;
+        }
+        virReportSystemError(err,
+                             _("Unable to write to '%s'"), path);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Returns 0 on success, -1 on error and 1 if @path can't be read
+ * through a cached file descriptor. */
+static int
+virCgroupGetValueCached(virCgroupPtr group,
+                        const char *path,
+                        char **value)
+{
+    g_autofree char *buf = NULL;
+    size_t buflen = 4096;
+    size_t len = 0;
+    int fd;
+
+    virMutexLock(&group->filesLock);
+
+    if ((fd = virCgroupFileGetFD(group, path, false)) < 0) {
+        virMutexUnlock(&group->filesLock);
+        return 1;
+    }
+
+    VIR_DEBUG("Get value %s", path);
+
+    buf = g_new0(char, buflen);
+    for (;;) {
+        ssize_t got;
+
+        if (len + 1 >= buflen) {
+            if (buflen >= 1024 * 1024) {
+                virMutexUnlock(&group->filesLock);
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("Value of '%s' is too long"), path);
+                return -1;
+            }
+            buflen *= 2;
+            buf = g_renew(char, buf, buflen);
+        }
+
+        if ((got = pread(fd, buf + len, buflen - len - 1, len)) < 0) {
+            int err = errno;
+
+            if (err == EINTR)
+                continue;
+            virMutexUnlock(&group->filesLock);
+            virReportSystemError(err,
+                                 _("Unable to read from '%s'"), path);
+            return -1;
+        }
+
+        if (got == 0)
+            break;
+
+        len += got;
+    }
+
+    virMutexUnlock(&group->filesLock);
+
+    buf[len] = '\0';
+
+    /* Terminated with '\n' has sometimes harmful effects to the caller */
+    if (len > 0 && buf[len - 1] == '\n')
+        buf[len - 1] = '\0';
+
+    *value = g_steal_pointer(&buf);
+    return 0;
+}
+
+
 int
 virCgroupSetValueStr(virCgroupPtr group,
                      int controller,
@@ -503,10 +723,14 @@ virCgroupSetValueStr(virCgroupPtr group,
                      const char *value)
 {
     g_autofree char *keypath = NULL;
+    int rc;
 
     if (virCgroupPathOfController(group, controller, key, &keypath) < 0)
         return -1;
 
+    if ((rc = virCgroupSetValueCached(group, keypath, value)) <= 0)
+        return rc;
+
     return virCgroupSetValueRaw(keypath, value);
 }
 
@@ -518,10 +742,16 @@ virCgroupGetValueStr(virCgroupPtr group,
                      char **value)
 {
     g_autofree char *keypath = NULL;
+    int rc;
+
+    *value = NULL;
 
     if (virCgroupPathOfController(group, controller, key, &keypath) < 0)
         return -1;
 
+    if ((rc = virCgroupGetValueCached(group, keypath, value)) <= 0)
+        return rc;
+
     return virCgroupGetValueRaw(keypath, value);
 }
 
@@ -672,6 +902,12 @@ virCgroupNew(pid_t pid,
     if (VIR_ALLOC((*group)) < 0)
         goto error;
 
+    if (virMutexInit(&(*group)->filesLock) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to init cgroup mutex"));
+        VIR_FREE(*group);
+        goto error;
+    }
+
     if (path[0] == '/' || !parent) {
         (*group)->path = g_strdup(path);
     } else {
@@ -2384,6 +2620,8 @@ virCgroupRemove(virCgroupPtr group)
 {
     size_t i;
 
+    virCgroupCloseFiles(group);
+
     for (i = 0; i < VIR_CGROUP_BACKEND_TYPE_LAST; i++) {
         if (group->backends[i]) {
             int rc = group->backends[i]->remove(group);
@@ -3558,6 +3796,9 @@ virCgroupFree(virCgroupPtr *group)
     VIR_FREE((*group)->unified.mountPoint);
     VIR_FREE((*group)->unified.placement);
 
+    virHashFree((*group)->files);
+    virMutexDestroy(&(*group)->filesLock);
+
     VIR_FREE((*group)->path);
     VIR_FREE(*group);
 }
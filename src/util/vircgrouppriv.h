@@ -66,6 +66,10 @@ struct _virCgroup {
 
     virCgroupV1Controller legacy[VIR_CGROUP_CONTROLLER_LAST];
     virCgroupV2Controller unified;
+
+    /* Files of the cgroup kept open, see virCgroupSetValueStr */
+    virMutex filesLock;
+    virHashTablePtr files;
 };
 
 int virCgroupSetValueRaw(const char *path,
@@ -43,6 +43,12 @@
 #if defined(WITH_SECDRIVER_APPARMOR)
 # include <sys/apparmor.h>
 #endif
+#ifdef __linux__
+# include <sys/syscall.h>
+# ifdef __NR_close_range
+#  define VIR_COMMAND_HAVE_CLOSE_RANGE 1
+# endif
+#endif
 
 #define LIBVIRT_VIRCOMMANDPRIV_H_ALLOW
 #include "viralloc.h"
@@ -548,6 +554,65 @@ virCommandMassClose(virCommandPtr cmd,
 
 # else /* ! __FreeBSD__ */
 
+#  ifdef VIR_COMMAND_HAVE_CLOSE_RANGE
+
+/*
+ * With close_range() the FDs which are not passed down can be closed
+ * a range at a time, so the cost doesn't depend on how many FDs there
+ * are. Returns 0 on success, -1 on error and 1 if the kernel doesn't
+ * know close_range() yet.
+ */
+static int
+virCommandMassCloseRange(virCommandPtr cmd,
+                         int childin,
+                         int childout,
+                         int childerr)
+{
+    int lastfd = 2;
+    unsigned int first = 3;
+    int fd;
+    size_t i;
+
+    lastfd = MAX(lastfd, childin);
+    lastfd = MAX(lastfd, childout);
+    lastfd = MAX(lastfd, childerr);
+
+    for (i = 0; i < cmd->npassfd; i++)
+        lastfd = MAX(lastfd, cmd->passfd[i].fd);
+
+    for (fd = 3; fd <= lastfd + 1; fd++) {
+        unsigned int last = fd - 1;
+
+        if (fd <= lastfd) {
+            if (fd != childin && fd != childout && fd != childerr &&
+                !virCommandFDIsSet(cmd, fd))
+                continue;
+
+            if (virCommandFDIsSet(cmd, fd) && virSetInherit(fd, true) < 0) {
+                virReportSystemError(errno, _("failed to preserve fd %d"), fd);
+                return -1;
+            }
+        } else {
+            last = ~0U;
+        }
+
+        if (first <= last &&
+            syscall(__NR_close_range, first, last, 0) < 0) {
+            if (errno == ENOSYS)
+                return 1;
+            virReportSystemError(errno,
+                                 _("failed to close fds %u to %u"),
+                                 first, last);
+            return -1;
+        }
+
+        first = fd + 1;
+    }
+
+    return 0;
+}
+#  endif /* VIR_COMMAND_HAVE_CLOSE_RANGE */
+
 static int
 virCommandMassClose(virCommandPtr cmd,
                     int childin,
@@ -555,8 +620,16 @@ virCommandMassClose(virCommandPtr cmd,
                     int childerr)
 {
     g_autoptr(virBitmap) fds = NULL;
-    int openmax = sysconf(_SC_OPEN_MAX);
+    int openmax;
     int fd = -1;
+#  ifdef VIR_COMMAND_HAVE_CLOSE_RANGE
+    int rc;
+
+    if ((rc = virCommandMassCloseRange(cmd, childin, childout, childerr)) <= 0)
+        return rc;
+#  endif
+
+    openmax = sysconf(_SC_OPEN_MAX);
 
     /* In general, it is not safe to call malloc() between fork() and exec()
      * because the child might have forked at the worst possible time, i.e.
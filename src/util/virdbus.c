@@ -1650,6 +1650,99 @@ int virDBusCallMethod(DBusConnection *conn,
 }
 
 
+static void
+virDBusSendMethodNotify(DBusPendingCall *pending,
+                        void *opaque G_GNUC_UNUSED)
+{
+    DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+    DBusError error;
+
+    dbus_error_init(&error);
+
+    if (reply && dbus_set_error_from_message(&error, reply)) {
+        VIR_DEBUG("method call failed with %s: %s",
+                  NULLSTR(error.name), NULLSTR(error.message));
+    }
+
+    dbus_error_free(&error);
+    virDBusMessageUnref(reply);
+}
+
+
+/**
+ * virDBusSendMethod:
+ * @conn: a DBus connection
+ * @destination: bus identifier of the target service
+ * @path: object path of the target service
+ * @iface: the interface of the object
+ * @member: the name of the method in the interface
+ * @types: type signature for following method arguments
+ * @...: method arguments
+ *
+ * Like virDBusCallMethod, but returns as soon as the method call is
+ * queued on @conn rather than waiting for the reply, so that calls of
+ * multiple threads don't each take a round-trip to the service. The
+ * reply is processed by the event loop dispatching @conn and a DBus
+ * error in it is only logged. Meant for calls whose outcome doesn't
+ * matter to the caller. DBus guarantees that the service receives
+ * the calls of @conn in the order they were sent.
+ *
+ * Returns 0 on success, or -1 if the call could not be encoded or
+ * queued
+ */
+int virDBusSendMethod(DBusConnection *conn,
+                      const char *destination,
+                      const char *path,
+                      const char *iface,
+                      const char *member,
+                      const char *types, ...)
+{
+    DBusMessage *call = NULL;
+    DBusPendingCall *pending = NULL;
+    int ret = -1;
+    va_list args;
+
+    va_start(args, types);
+    ret = virDBusCreateMethodV(&call, destination, path,
+                               iface, member, types, args);
+    va_end(args);
+    if (ret < 0)
+        goto cleanup;
+
+    ret = -1;
+
+    PROBE(DBUS_METHOD_CALL,
+          "'%s.%s' on '%s' at '%s'",
+          iface, member, path, destination);
+
+    if (!dbus_connection_send_with_reply(conn, call, &pending,
+                                         VIR_DBUS_METHOD_CALL_TIMEOUT_MILLIS)) {
+        virReportOOMError();
+        goto cleanup;
+    }
+
+    /* no pending call is returned if the connection is closed already */
+    if (pending) {
+        if (dbus_pending_call_get_completed(pending)) {
+            virDBusSendMethodNotify(pending, NULL);
+        } else if (!dbus_pending_call_set_notify(pending,
+                                                 virDBusSendMethodNotify,
+                                                 NULL, NULL)) {
+            virReportOOMError();
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    if (pending)
+        dbus_pending_call_unref(pending);
+    virDBusMessageUnref(call);
+    return ret;
+}
+
+
 static int virDBusIsServiceInList(const char *listMethod, const char *name)
 {
     DBusConnection *conn;
@@ -1824,6 +1917,18 @@ int virDBusCallMethod(DBusConnection *conn G_GNUC_UNUSED,
     return -1;
 }
 
+int virDBusSendMethod(DBusConnection *conn G_GNUC_UNUSED,
+                      const char *destination G_GNUC_UNUSED,
+                      const char *path G_GNUC_UNUSED,
+                      const char *iface G_GNUC_UNUSED,
+                      const char *member G_GNUC_UNUSED,
+                      const char *types G_GNUC_UNUSED, ...)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR,
+                   "%s", _("DBus support not compiled into this binary"));
+    return -1;
+}
+
 
 int virDBusMessageEncode(DBusMessage* msg G_GNUC_UNUSED,
                          const char *types G_GNUC_UNUSED,
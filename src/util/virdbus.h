@@ -66,6 +66,12 @@ int virDBusCallMethod(DBusConnection *conn,
                       const char *iface,
                       const char *member,
                       const char *types, ...);
+int virDBusSendMethod(DBusConnection *conn,
+                      const char *destination,
+                      const char *path,
+                      const char *iface,
+                      const char *member,
+                      const char *types, ...);
 int virDBusMessageDecode(DBusMessage *msg,
                          const char *types, ...);
 void virDBusMessageUnref(DBusMessage *msg);
@@ -20,6 +20,8 @@
 
 #include <config.h>
 
+#include <sys/stat.h>
+
 #ifdef __linux__
 # include <sys/sysmacros.h>
 #endif
@@ -67,6 +69,7 @@ virDevMapperGetTargetsImpl(const char *path,
     struct dm_task *dmt = NULL;
     struct dm_deps *deps;
     struct dm_info info;
+    struct stat sb;
     char **devPaths = NULL;
     char **recursiveDevPaths = NULL;
     size_t i;
@@ -82,6 +85,14 @@ virDevMapperGetTargetsImpl(const char *path,
         return ret;
     }
 
+    /* Most disks, as well as the devices devmapper targets are built
+     * from (e.g. the paths of a multipath device), aren't devmapper
+     * devices. Don't ask the kernel about those. If @path can't be
+     * looked at, let libdevmapper handle it. */
+    if (stat(path, &sb) == 0 &&
+        (!S_ISBLK(sb.st_mode) || !dm_is_dm_major(major(sb.st_rdev))))
+        return 0;
+
     if (!(dmt = dm_task_create(DM_DEVICE_DEPS))) {
         if (errno == ENOENT || errno == ENODEV) {
             /* It's okay. Kernel is probably built without
@@ -134,6 +145,9 @@ virDevMapperGetTargetsImpl(const char *path,
     for (i = 0; i < deps->count; i++) {
         char **tmpPaths;
 
+        if (!dm_is_dm_major(major(deps->device[i])))
+            continue;
+
         if (virDevMapperGetTargetsImpl(devPaths[i], &tmpPaths, ttl - 1) < 0)
             goto cleanup;
 
@@ -64,11 +64,12 @@ struct virEventGLibTimeout
 
 static GMutex *eventlock;
 
+/* Both keyed by the watch/timer number */
 static int nextwatch = 1;
-static GPtrArray *handles;
+static GHashTable *handles;
 
 static int nexttimer = 1;
-static GPtrArray *timeouts;
+static GHashTable *timeouts;
 
 static GIOCondition
 virEventGLibEventsToCondition(int events)
@@ -153,7 +154,7 @@ virEventGLibHandleAdd(int fd,
             fd, cond, NULL, virEventGLibHandleDispatch, data, NULL);
     }
 
-    g_ptr_array_add(handles, data);
+    g_hash_table_insert(handles, GINT_TO_POINTER(data->watch), data);
 
     ret = data->watch;
 
@@ -168,19 +169,11 @@ virEventGLibHandleAdd(int fd,
 static struct virEventGLibHandle *
 virEventGLibHandleFind(int watch)
 {
-    guint i;
+    struct virEventGLibHandle *h;
 
-    for (i = 0; i < handles->len; i++) {
-        struct virEventGLibHandle *h = g_ptr_array_index(handles, i);
-
-        if (h == NULL) {
-            g_warn_if_reached();
-            continue;
-        }
-
-        if ((h->watch == watch) && !h->removed)
-            return h;
-    }
+    h = g_hash_table_lookup(handles, GINT_TO_POINTER(watch));
+    if (h && !h->removed)
+        return h;
 
     return NULL;
 }
@@ -211,15 +204,20 @@ virEventGLibHandleUpdate(int watch,
             goto cleanup;
 
         if (data->source != 0) {
-            VIR_DEBUG("Removed old handle watch=%d", data->source);
-            g_source_remove(data->source);
+            /* Changing the condition of the existing source is much
+             * cheaper than replacing it */
+            GSource *source = g_main_context_find_source_by_id(NULL,
+                                                               data->source);
+
+            VIR_DEBUG("Updated handle watch=%d", data->source);
+            virEventGLibUpdateSocketWatch(source, cond);
+        } else {
+            data->source = virEventGLibAddSocketWatch(
+                data->fd, cond, NULL, virEventGLibHandleDispatch, data, NULL);
+            VIR_DEBUG("Added new handle watch=%d", data->source);
         }
 
-        data->source = virEventGLibAddSocketWatch(
-            data->fd, cond, NULL, virEventGLibHandleDispatch, data, NULL);
-
         data->events = events;
-        VIR_DEBUG("Added new handle watch=%d", data->source);
     } else {
         if (data->source == 0)
             goto cleanup;
@@ -246,7 +244,7 @@ virEventGLibHandleRemoveIdle(gpointer data)
         (h->ff)(h->opaque);
 
     g_mutex_lock(eventlock);
-    g_ptr_array_remove_fast(handles, h);
+    g_hash_table_remove(handles, GINT_TO_POINTER(h->watch));
     g_mutex_unlock(eventlock);
 
     return FALSE;
@@ -331,7 +329,7 @@ virEventGLibTimeoutAdd(int interval,
                                      virEventGLibTimeoutDispatch,
                                      data);
 
-    g_ptr_array_add(timeouts, data);
+    g_hash_table_insert(timeouts, GINT_TO_POINTER(data->timer), data);
 
     VIR_DEBUG("Add timeout data=%p interval=%d ms cb=%p opaque=%p timer=%d",
               data, interval, cb, opaque, data->timer);
@@ -350,21 +348,13 @@ virEventGLibTimeoutAdd(int interval,
 static struct virEventGLibTimeout *
 virEventGLibTimeoutFind(int timer)
 {
-    guint i;
+    struct virEventGLibTimeout *t;
 
     g_return_val_if_fail(timeouts != NULL, NULL);
 
-    for (i = 0; i < timeouts->len; i++) {
-        struct virEventGLibTimeout *t = g_ptr_array_index(timeouts, i);
-
-        if (t == NULL) {
-            g_warn_if_reached();
-            continue;
-        }
-
-        if ((t->timer == timer) && !t->removed)
-            return t;
-    }
+    t = g_hash_table_lookup(timeouts, GINT_TO_POINTER(timer));
+    if (t && !t->removed)
+        return t;
 
     return NULL;
 }
@@ -422,7 +412,7 @@ virEventGLibTimeoutRemoveIdle(gpointer data)
         (t->ff)(t->opaque);
 
     g_mutex_lock(eventlock);
-    g_ptr_array_remove_fast(timeouts, t);
+    g_hash_table_remove(timeouts, GINT_TO_POINTER(t->timer));
     g_mutex_unlock(eventlock);
 
     return FALSE;
@@ -471,8 +461,10 @@ virEventGLibTimeoutRemove(int timer)
 static gpointer virEventGLibRegisterOnce(gpointer data G_GNUC_UNUSED)
 {
     eventlock = g_new0(GMutex, 1);
-    timeouts = g_ptr_array_new_with_free_func(g_free);
-    handles = g_ptr_array_new_with_free_func(g_free);
+    timeouts = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                     NULL, g_free);
+    handles = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                    NULL, g_free);
     virEventRegisterImpl(virEventGLibHandleAdd,
                          virEventGLibHandleUpdate,
                          virEventGLibHandleRemove,
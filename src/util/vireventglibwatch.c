@@ -100,6 +100,19 @@ GSource *virEventGLibCreateSocketWatch(int fd,
     return source;
 }
 
+
+void virEventGLibUpdateSocketWatch(GSource *source,
+                                   GIOCondition condition)
+{
+    virEventGLibFDSource *ssource = (virEventGLibFDSource *)source;
+
+    ssource->condition = condition | G_IO_HUP | G_IO_ERR;
+    ssource->pollfd.events = condition | G_IO_HUP | G_IO_ERR;
+
+    /* The poll set is only rebuilt when the context iterates again */
+    g_main_context_wakeup(g_source_get_context(source));
+}
+
 #else /* WIN32 */
 
 # define WIN32_LEAN_AND_MEAN
@@ -230,6 +243,18 @@ GSource *virEventGLibCreateSocketWatch(int fd,
     return source;
 }
 
+
+void virEventGLibUpdateSocketWatch(GSource *source,
+                                   GIOCondition condition)
+{
+    virEventGLibSocketSource *ssource = (virEventGLibSocketSource *)source;
+
+    /* The event object is signalled for all socket events anyway */
+    ssource->condition = condition;
+
+    g_main_context_wakeup(g_source_get_context(source));
+}
+
 #endif /* WIN32 */
 
 
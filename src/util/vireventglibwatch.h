@@ -36,6 +36,17 @@
 GSource *virEventGLibCreateSocketWatch(int fd,
                                        GIOCondition condition);
 
+/**
+ * virEventGLibUpdateSocketWatch:
+ * @source: a source created by virEventGLibCreateSocketWatch
+ * @condition: the new I/O condition
+ *
+ * Change the I/O conditions @source monitors without having to
+ * destroy and recreate it.
+ */
+void virEventGLibUpdateSocketWatch(GSource *source,
+                                   GIOCondition condition);
+
 typedef gboolean (*virEventGLibSocketFunc)(int fd,
                                            GIOCondition condition,
                                            gpointer data);
@@ -188,3 +188,123 @@ virEventThreadGetContext(virEventThread *evt)
 {
     return evt->context;
 }
+
+
+/*
+ * A fixed set of event threads shared by many users, so that the number
+ * of threads doesn't have to grow with the number of users. The threads
+ * are started on demand and each user is given the one serving the
+ * fewest users at the time.
+ */
+struct _virEventThreadPool {
+    GMutex lock;
+    char *prefix;
+
+    size_t nthreads;
+    virEventThread **threads;
+    size_t *nusers;
+};
+
+
+/**
+ * virEventThreadPoolNew:
+ * @prefix: prefix of the names of the threads
+ * @nthreads: maximum number of threads
+ *
+ * Returns a new pool of at most @nthreads event threads.
+ */
+virEventThreadPool *
+virEventThreadPoolNew(const char *prefix,
+                      size_t nthreads)
+{
+    virEventThreadPool *pool = g_new0(virEventThreadPool, 1);
+
+    g_mutex_init(&pool->lock);
+    pool->prefix = g_strdup(prefix);
+    pool->nthreads = nthreads;
+    pool->threads = g_new0(virEventThread *, nthreads);
+    pool->nusers = g_new0(size_t, nthreads);
+
+    return pool;
+}
+
+
+void
+virEventThreadPoolFree(virEventThreadPool *pool)
+{
+    size_t i;
+
+    if (!pool)
+        return;
+
+    for (i = 0; i < pool->nthreads; i++) {
+        if (pool->threads[i])
+            g_object_unref(pool->threads[i]);
+    }
+
+    g_free(pool->threads);
+    g_free(pool->nusers);
+    g_free(pool->prefix);
+    g_mutex_clear(&pool->lock);
+    g_free(pool);
+}
+
+
+/**
+ * virEventThreadPoolAcquire:
+ * @pool: pool of event threads
+ *
+ * Picks the thread of @pool serving the fewest users, starting it
+ * if needed. The thread must be given back to @pool with
+ * virEventThreadPoolRelease once the caller is done with it.
+ *
+ * Returns a new reference to the thread, or NULL on error.
+ */
+virEventThread *
+virEventThreadPoolAcquire(virEventThreadPool *pool)
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&pool->lock);
+    size_t best = 0;
+    size_t i;
+
+    for (i = 1; i < pool->nthreads; i++) {
+        if (pool->nusers[i] < pool->nusers[best])
+            best = i;
+    }
+
+    if (!pool->threads[best]) {
+        g_autofree char *name = g_strdup_printf("%s-%zu", pool->prefix, best);
+
+        if (!(pool->threads[best] = virEventThreadNew(name)))
+            return NULL;
+    }
+
+    pool->nusers[best]++;
+
+    return g_object_ref(pool->threads[best]);
+}
+
+
+/**
+ * virEventThreadPoolRelease:
+ * @pool: pool of event threads
+ * @evt: thread returned by virEventThreadPoolAcquire
+ *
+ * Gives @evt back to @pool and drops the caller's reference to it.
+ */
+void
+virEventThreadPoolRelease(virEventThreadPool *pool,
+                          virEventThread *evt)
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&pool->lock);
+    size_t i;
+
+    for (i = 0; i < pool->nthreads; i++) {
+        if (pool->threads[i] == evt) {
+            pool->nusers[i]--;
+            break;
+        }
+    }
+
+    g_object_unref(evt);
+}
@@ -29,3 +29,13 @@ G_DECLARE_FINAL_TYPE(virEventThread, vir_event_thread, VIR, EVENT_THREAD, GObjec
 virEventThread *virEventThreadNew(const char *name);
 
 GMainContext *virEventThreadGetContext(virEventThread *evt);
+
+typedef struct _virEventThreadPool virEventThreadPool;
+
+virEventThreadPool *virEventThreadPoolNew(const char *prefix,
+                                          size_t nthreads);
+void virEventThreadPoolFree(virEventThreadPool *pool);
+
+virEventThread *virEventThreadPoolAcquire(virEventThreadPool *pool);
+void virEventThreadPoolRelease(virEventThreadPool *pool,
+                               virEventThread *evt);
@@ -47,6 +47,16 @@
 VIR_LOG_INIT("fdstream");
 
 #ifndef WIN32
+/* Bounds of the chunks the worker thread reads data in */
+# define VIR_FDSTREAM_CHUNK_MIN (256 * 1024)
+# define VIR_FDSTREAM_CHUNK_MAX (4 * 1024 * 1024)
+/* How long reading a single chunk should take */
+# define VIR_FDSTREAM_CHUNK_TIME_US (10 * 1000)
+/* Number of threads reading sparse files ahead of the stream, and the
+ * number of chunks they may get ahead by */
+# define VIR_FDSTREAM_PREFETCH_WORKERS 4
+# define VIR_FDSTREAM_PREFETCH_WINDOW 16
+
 typedef enum {
     VIR_FDSTREAM_MSG_TYPE_DATA,
     VIR_FDSTREAM_MSG_TYPE_HOLE,
@@ -566,6 +576,394 @@ virFDStreamThreadDoWrite(virFDStreamDataPtr fdst,
 }
 
 
+/*
+ * Adapts the size of the chunks read by the worker thread to the rate
+ * the data comes in at, so that reading one takes about
+ * VIR_FDSTREAM_CHUNK_TIME_US. Fast sources get through with far fewer
+ * messages, while the stream, which stays locked during the read,
+ * is never held up for long by slow ones.
+ */
+static size_t
+virFDStreamThreadAdaptChunk(size_t buflen,
+                            ssize_t got,
+                            long long elapsed)
+{
+    /* Short reads and holes say nothing about the rate */
+    if (got != buflen)
+        return buflen;
+
+    if (elapsed < VIR_FDSTREAM_CHUNK_TIME_US / 2 &&
+        buflen < VIR_FDSTREAM_CHUNK_MAX)
+        return buflen * 2;
+
+    if (elapsed > VIR_FDSTREAM_CHUNK_TIME_US * 2 &&
+        buflen > VIR_FDSTREAM_CHUNK_MIN)
+        return buflen / 2;
+
+    return buflen;
+}
+
+
+/*
+ * Reading a sparse file is done by a few threads reading the chunks
+ * ahead of the stream, in parallel, using the map of its data and hole
+ * extents which is built upfront. The chunks are put into a ring the
+ * stream thread consumes them from in order.
+ */
+typedef struct _virFDStreamExtent virFDStreamExtent;
+typedef virFDStreamExtent *virFDStreamExtentPtr;
+struct _virFDStreamExtent {
+    off_t offset;
+    long long len;
+    bool inData;
+};
+
+typedef struct _virFDStreamChunk virFDStreamChunk;
+typedef virFDStreamChunk *virFDStreamChunkPtr;
+struct _virFDStreamChunk {
+    bool inData;
+    off_t offset;
+    long long len;
+
+    bool ready;
+    char *buf;
+    ssize_t got;
+    int error;      /* errno of the failed read */
+};
+
+typedef struct _virFDStreamPrefetch virFDStreamPrefetch;
+typedef virFDStreamPrefetch *virFDStreamPrefetchPtr;
+struct _virFDStreamPrefetch {
+    virMutex lock;
+    virCond cond;
+    bool quit;
+
+    int fd;
+    virFDStreamExtentPtr extents;
+    size_t nextents;
+    size_t extent;          /* extent the next chunk is cut from */
+    long long extentOffset; /* where in the extent */
+
+    virFDStreamChunk ring[VIR_FDSTREAM_PREFETCH_WINDOW];
+    size_t next;            /* number of chunks cut */
+    size_t consumed;        /* number of chunks consumed */
+
+    virThread threads[VIR_FDSTREAM_PREFETCH_WORKERS];
+    size_t nthreads;
+};
+
+
+static int
+virFDStreamPrefetchBuildMap(virFDStreamPrefetchPtr pf,
+                            const char *fdname,
+                            size_t length)
+{
+    size_t total = 0;
+    off_t pos;
+
+    if ((pos = lseek(pf->fd, 0, SEEK_CUR)) == (off_t) -1) {
+        virReportSystemError(errno,
+                             _("unable to seek in %s"),
+                             fdname);
+        return -1;
+    }
+
+    while (!length || total < length) {
+        virFDStreamExtent extent = { 0 };
+        int inData;
+        long long len;
+
+        if (virFileInData(pf->fd, &inData, &len) < 0)
+            return -1;
+
+        /* The implicit hole at the end of the file */
+        if (!inData && len == 0)
+            break;
+
+        if (length && len > length - total)
+            len = length - total;
+
+        extent.offset = pos;
+        extent.len = len;
+        extent.inData = inData;
+
+        if (VIR_APPEND_ELEMENT(pf->extents, pf->nextents, extent) < 0)
+            return -1;
+
+        pos += len;
+        total += len;
+
+        if (lseek(pf->fd, pos, SEEK_SET) == (off_t) -1) {
+            virReportSystemError(errno,
+                                 _("unable to seek in %s"),
+                                 fdname);
+            return -1;
+        }
+    }
+
+    VIR_DEBUG("Built map of %zu extents for %s", pf->nextents, fdname);
+    return 0;
+}
+
+
+/* Cuts the next chunk off the map. Must be called with @pf locked.
+ * Returns NULL if there's nothing left or the window is full. */
+static virFDStreamChunkPtr
+virFDStreamPrefetchCut(virFDStreamPrefetchPtr pf)
+{
+    virFDStreamExtentPtr extent;
+    virFDStreamChunkPtr chunk;
+
+    if (pf->extent == pf->nextents ||
+        pf->next - pf->consumed == VIR_FDSTREAM_PREFETCH_WINDOW)
+        return NULL;
+
+    extent = &pf->extents[pf->extent];
+    chunk = &pf->ring[pf->next++ % VIR_FDSTREAM_PREFETCH_WINDOW];
+
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->inData = extent->inData;
+    chunk->offset = extent->offset + pf->extentOffset;
+    chunk->len = extent->len - pf->extentOffset;
+
+    if (chunk->inData && chunk->len > VIR_FDSTREAM_CHUNK_MAX)
+        chunk->len = VIR_FDSTREAM_CHUNK_MAX;
+
+    pf->extentOffset += chunk->len;
+    if (pf->extentOffset == extent->len) {
+        pf->extent++;
+        pf->extentOffset = 0;
+    }
+
+    return chunk;
+}
+
+
+static void
+virFDStreamPrefetchWorker(void *opaque)
+{
+    virFDStreamPrefetchPtr pf = opaque;
+
+    virMutexLock(&pf->lock);
+
+    while (!pf->quit) {
+        virFDStreamChunkPtr chunk;
+        char *buf;
+        ssize_t got = 0;
+        int error = 0;
+
+        if (!(chunk = virFDStreamPrefetchCut(pf))) {
+            /* Nothing more to read */
+            if (pf->extent == pf->nextents)
+                break;
+
+            virCondWait(&pf->cond, &pf->lock);
+            continue;
+        }
+
+        if (!chunk->inData) {
+            chunk->ready = true;
+            virCondBroadcast(&pf->cond);
+            continue;
+        }
+
+        virMutexUnlock(&pf->lock);
+
+        buf = g_new0(char, chunk->len);
+        while (got < chunk->len) {
+            ssize_t rc = pread(pf->fd, buf + got, chunk->len - got,
+                               chunk->offset + got);
+
+            if (rc < 0 && errno == EINTR)
+                continue;
+            if (rc < 0) {
+                error = errno;
+                break;
+            }
+            /* The file was truncated meanwhile */
+            if (rc == 0)
+                break;
+            got += rc;
+        }
+
+        virMutexLock(&pf->lock);
+
+        chunk->buf = buf;
+        chunk->got = got;
+        chunk->error = error;
+        chunk->ready = true;
+        virCondBroadcast(&pf->cond);
+    }
+
+    virMutexUnlock(&pf->lock);
+}
+
+
+static void
+virFDStreamPrefetchFree(virFDStreamPrefetchPtr pf)
+{
+    size_t i;
+
+    if (!pf)
+        return;
+
+    virMutexLock(&pf->lock);
+    pf->quit = true;
+    virCondBroadcast(&pf->cond);
+    virMutexUnlock(&pf->lock);
+
+    for (i = 0; i < pf->nthreads; i++)
+        virThreadJoin(&pf->threads[i]);
+
+    for (i = 0; i < VIR_FDSTREAM_PREFETCH_WINDOW; i++)
+        VIR_FREE(pf->ring[i].buf);
+
+    VIR_FREE(pf->extents);
+    virCondDestroy(&pf->cond);
+    virMutexDestroy(&pf->lock);
+    VIR_FREE(pf);
+}
+
+
+/*
+ * Starts reading @fd ahead of the stream, if it's a regular file.
+ * Returns 0 on success, with @pf set to NULL if @fd has to be read
+ * by the stream thread itself, -1 on error.
+ */
+static int
+virFDStreamPrefetchNew(int fd,
+                       const char *fdname,
+                       size_t length,
+                       virFDStreamPrefetchPtr *pf)
+{
+    virFDStreamPrefetchPtr ret;
+    struct stat sb;
+    size_t i;
+
+    *pf = NULL;
+
+    if (fstat(fd, &sb) < 0 || !S_ISREG(sb.st_mode))
+        return 0;
+
+    ret = g_new0(virFDStreamPrefetch, 1);
+    ret->fd = fd;
+
+    if (virMutexInit(&ret->lock) < 0) {
+        VIR_FREE(ret);
+        return -1;
+    }
+
+    if (virCondInit(&ret->cond) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot initialize condition variable"));
+        virMutexDestroy(&ret->lock);
+        VIR_FREE(ret);
+        return -1;
+    }
+
+    if (virFDStreamPrefetchBuildMap(ret, fdname, length) < 0)
+        goto error;
+
+    for (i = 0; i < VIR_FDSTREAM_PREFETCH_WORKERS; i++) {
+        if (virThreadCreateFull(&ret->threads[ret->nthreads], true,
+                                virFDStreamPrefetchWorker,
+                                "fdstream-read", false, ret) < 0) {
+            /* Fewer threads just read slower */
+            if (ret->nthreads > 0)
+                break;
+            virReportSystemError(errno, "%s",
+                                 _("Unable to create stream prefetch thread"));
+            goto error;
+        }
+        ret->nthreads++;
+    }
+
+    *pf = ret;
+    return 0;
+
+ error:
+    virFDStreamPrefetchFree(ret);
+    return -1;
+}
+
+
+/* Like virFDStreamThreadDoRead, just passes on the next chunk read
+ * ahead. @fdst is unlocked while waiting for it. */
+static ssize_t
+virFDStreamThreadDoPrefetched(virFDStreamDataPtr fdst,
+                              virFDStreamPrefetchPtr pf,
+                              const int fdout,
+                              const char *fdinname,
+                              const char *fdoutname)
+{
+    virFDStreamMsgPtr msg = NULL;
+    virFDStreamChunkPtr chunk = NULL;
+    ssize_t got;
+
+    virObjectUnlock(fdst);
+    virMutexLock(&pf->lock);
+
+    while (true) {
+        if (pf->consumed < pf->next) {
+            chunk = &pf->ring[pf->consumed % VIR_FDSTREAM_PREFETCH_WINDOW];
+            if (chunk->ready)
+                break;
+        } else if (pf->extent == pf->nextents) {
+            /* Everything was consumed */
+            chunk = NULL;
+            break;
+        }
+
+        if (virCondWait(&pf->cond, &pf->lock) < 0) {
+            virMutexUnlock(&pf->lock);
+            virObjectLock(fdst);
+            virReportSystemError(errno, "%s",
+                                 _("failed to wait on condition"));
+            return -1;
+        }
+    }
+
+    msg = g_new0(virFDStreamMsg, 1);
+
+    if (!chunk || (chunk->inData && chunk->got == 0 && !chunk->error)) {
+        /* End of the file, possibly truncated while reading it */
+        msg->type = VIR_FDSTREAM_MSG_TYPE_HOLE;
+        got = 0;
+    } else if (!chunk->inData) {
+        msg->type = VIR_FDSTREAM_MSG_TYPE_HOLE;
+        msg->stream.hole.len = chunk->len;
+        got = chunk->len;
+    } else {
+        msg->type = VIR_FDSTREAM_MSG_TYPE_DATA;
+        msg->stream.data.buf = g_steal_pointer(&chunk->buf);
+        msg->stream.data.len = chunk->got;
+        got = chunk->got;
+    }
+
+    if (chunk) {
+        if (chunk->error) {
+            virMutexUnlock(&pf->lock);
+            virObjectLock(fdst);
+            virReportSystemError(chunk->error,
+                                 _("Unable to read %s"),
+                                 fdinname);
+            virFDStreamMsgFree(msg);
+            return -1;
+        }
+
+        pf->consumed++;
+        virCondBroadcast(&pf->cond);
+    }
+
+    virMutexUnlock(&pf->lock);
+    virObjectLock(fdst);
+
+    virFDStreamMsgQueuePush(fdst, msg, fdout, fdoutname);
+
+    return got;
+}
+
+
 static void
 virFDStreamThread(void *opaque)
 {
@@ -579,11 +977,19 @@ virFDStreamThread(void *opaque)
     char *fdoutname = data->fdoutname;
     virFDStreamDataPtr fdst = st->privateData;
     bool doRead = fdst->threadDoRead;
-    size_t buflen = 256 * 1024;
+    size_t buflen = VIR_FDSTREAM_CHUNK_MIN;
     size_t total = 0;
     size_t dataLen = 0;
+    virFDStreamPrefetchPtr pf = NULL;
 
     virObjectRef(fdst);
+
+    if (doRead && sparse &&
+        virFDStreamPrefetchNew(fdin, fdinname, length, &pf) < 0) {
+        virObjectLock(fdst);
+        goto error;
+    }
+
     virObjectLock(fdst);
 
     while (1) {
@@ -608,16 +1014,25 @@ virFDStreamThread(void *opaque)
                 break;
         }
 
-        if (doRead)
+        if (pf) {
+            got = virFDStreamThreadDoPrefetched(fdst, pf, fdout,
+                                                fdinname, fdoutname);
+        } else if (doRead) {
+            long long start = g_get_monotonic_time();
+
             got = virFDStreamThreadDoRead(fdst, sparse,
                                           fdin, fdout,
                                           fdinname, fdoutname,
                                           length, total,
                                           &dataLen, buflen);
-        else
+
+            buflen = virFDStreamThreadAdaptChunk(buflen, got,
+                                                 g_get_monotonic_time() - start);
+        } else {
             got = virFDStreamThreadDoWrite(fdst, sparse,
                                            fdin, fdout,
                                            fdinname, fdoutname);
+        }
 
         if (got < 0)
             goto error;
@@ -631,6 +1046,7 @@ virFDStreamThread(void *opaque)
  cleanup:
     fdst->threadQuit = true;
     virObjectUnlock(fdst);
+    virFDStreamPrefetchFree(pf);
     if (!virObjectUnref(fdst))
         st->privateData = NULL;
     VIR_FORCE_CLOSE(fdin);
@@ -71,6 +71,7 @@
 # endif
 # include <sys/ioctl.h>
 # include <linux/cdrom.h>
+# include <poll.h>
 #endif
 
 #if HAVE_LIBATTR
@@ -82,10 +83,12 @@
 #include "vircommand.h"
 #include "virerror.h"
 #include "virfile.h"
+#include "virhash.h"
 #include "virkmod.h"
 #include "virlog.h"
 #include "virprocess.h"
 #include "virstring.h"
+#include "virthread.h"
 #include "virutil.h"
 #include "virsocket.h"
 
@@ -3363,6 +3366,10 @@ virFileRemoveLastComponent(char *path)
 #  define QB_MAGIC 0x51626d6e
 # endif
 
+# ifndef PROC_SUPER_MAGIC
+#  define PROC_SUPER_MAGIC 0x9fa0
+# endif
+
 # define VIR_ACFS_MAGIC 0x61636673
 
 # define PROC_MOUNTS "/proc/mounts"
@@ -3435,15 +3442,14 @@ virFileIsSharedFixFUSE(const char *path,
 }
 
 
-int
-virFileIsSharedFSType(const char *path,
-                      int fstypes)
+static int
+virFileGetSharedFSType(const char *path,
+                       long long *f_type)
 {
     g_autofree char *dirpath = NULL;
     char *p = NULL;
     struct statfs sb;
     int statfs_ret;
-    long long f_type = 0;
 
     dirpath = g_strdup(path);
 
@@ -3479,11 +3485,119 @@ virFileIsSharedFSType(const char *path,
         return -1;
     }
 
-    f_type = sb.f_type;
+    *f_type = sb.f_type;
 
-    if (f_type == FUSE_SUPER_MAGIC) {
+    if (*f_type == FUSE_SUPER_MAGIC) {
         VIR_DEBUG("Found FUSE mount for path=%s. Trying to fix it", path);
-        virFileIsSharedFixFUSE(path, &f_type);
+        virFileIsSharedFixFUSE(path, f_type);
+    }
+
+    return 0;
+}
+
+
+/*
+ * The filesystem types found by virFileGetSharedFSType, by path. Finding
+ * them takes a statfs() of the path or its parents, which is a round
+ * trip to the server on NFS, plus a walk of the mount table for FUSE.
+ * Since they are checked for every disk whenever a domain is started,
+ * migrated or relabelled, the results are kept until the mount table
+ * changes, which /proc/mounts reports as an exceptional condition to
+ * poll(). A mount table which can't report changes disables the cache.
+ */
+# define VIR_FILE_SHARED_FS_CACHE_MAX 1024
+
+static virMutex virFileSharedFSCacheLock = VIR_MUTEX_INITIALIZER;
+static FILE *virFileSharedFSMounts;
+static virHashTablePtr virFileSharedFSTypes;
+static unsigned long long virFileSharedFSGeneration;
+
+
+static void
+virFileSharedFSCacheReset(void)
+{
+    if (virFileSharedFSMounts) {
+        endmntent(virFileSharedFSMounts);
+        virFileSharedFSMounts = NULL;
+    }
+
+    virHashRemoveAll(virFileSharedFSTypes);
+    virFileSharedFSGeneration++;
+}
+
+
+/* Must be called with virFileSharedFSCacheLock held. Returns true if
+ * virFileSharedFSTypes can be used, dropping its contents first if the
+ * mount table has changed since they were found. */
+static bool
+virFileSharedFSCacheCheck(void)
+{
+    struct pollfd fd = { 0 };
+    struct statfs sb;
+
+    if (!virFileSharedFSTypes &&
+        !(virFileSharedFSTypes = virHashNew(virHashValueFree)))
+        return false;
+
+    if (virFileSharedFSMounts) {
+        fd.fd = fileno(virFileSharedFSMounts);
+        fd.events = POLLPRI;
+
+        if (poll(&fd, 1, 0) == 0)
+            return true;
+
+        VIR_DEBUG("Mount table changed, dropping cached filesystem types");
+        virFileSharedFSCacheReset();
+    }
+
+    /* A freshly opened /proc/mounts only reports changes made after
+     * it was opened */
+    if (!(virFileSharedFSMounts = setmntent(PROC_MOUNTS, "r")))
+        return false;
+
+    if (fstatfs(fileno(virFileSharedFSMounts), &sb) < 0 ||
+        sb.f_type != PROC_SUPER_MAGIC) {
+        virFileSharedFSCacheReset();
+        return false;
+    }
+
+    return true;
+}
+
+
+int
+virFileIsSharedFSType(const char *path,
+                      int fstypes)
+{
+    long long *cached = NULL;
+    long long f_type = 0;
+    unsigned long long generation;
+    bool useCache;
+
+    virMutexLock(&virFileSharedFSCacheLock);
+    if ((useCache = virFileSharedFSCacheCheck()) &&
+        (cached = virHashLookup(virFileSharedFSTypes, path)))
+        f_type = *cached;
+    generation = virFileSharedFSGeneration;
+    virMutexUnlock(&virFileSharedFSCacheLock);
+
+    if (!cached) {
+        if (virFileGetSharedFSType(path, &f_type) < 0)
+            return -1;
+
+        virMutexLock(&virFileSharedFSCacheLock);
+        /* the result is only valid for the mount table it was found in */
+        if (useCache && virFileSharedFSCacheCheck() &&
+            generation == virFileSharedFSGeneration) {
+            if (virHashSize(virFileSharedFSTypes) >= VIR_FILE_SHARED_FS_CACHE_MAX)
+                virHashRemoveAll(virFileSharedFSTypes);
+
+            cached = g_new0(long long, 1);
+            *cached = f_type;
+            if (virHashUpdateEntry(virFileSharedFSTypes, path, cached) < 0)
+                VIR_FREE(cached);
+        }
+        virMutexUnlock(&virFileSharedFSCacheLock);
     }
 
     VIR_DEBUG("Check if path %s with FS magic %lld is shared",
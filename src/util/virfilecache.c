@@ -50,11 +50,15 @@ struct _virFileCache {
     virHashTablePtr table;
 
     char *dir;
+    char *sharedDir;
     char *suffix;
 
     void *priv;
 
     virFileCacheHandlers handlers;
+
+    unsigned long long hits;
+    unsigned long long misses;
 };
 
 
@@ -75,6 +79,7 @@ virFileCacheDispose(void *obj)
     virFileCachePtr cache = obj;
 
     VIR_FREE(cache->dir);
+    VIR_FREE(cache->sharedDir);
     VIR_FREE(cache->suffix);
 
     virHashFree(cache->table);
@@ -98,7 +103,9 @@ VIR_ONCE_GLOBAL_INIT(virFileCache);
 
 static char *
 virFileCacheGetFileName(virFileCachePtr cache,
-                        const char *name)
+                        const char *dir,
+                        const char *name,
+                        bool binary)
 {
     g_autofree char *namehash = NULL;
     virBuffer buf = VIR_BUFFER_INITIALIZER;
@@ -106,16 +113,19 @@ virFileCacheGetFileName(virFileCachePtr cache,
     if (virCryptoHashString(VIR_CRYPTO_HASH_SHA256, name, &namehash) < 0)
         return NULL;
 
-    if (virFileMakePath(cache->dir) < 0) {
+    /* The shared directory is never written to */
+    if (dir == cache->dir && virFileMakePath(cache->dir) < 0) {
         virReportSystemError(errno,
                              _("Unable to create directory '%s'"),
                              cache->dir);
         return NULL;
     }
 
-    virBufferAsprintf(&buf, "%s/%s", cache->dir, namehash);
+    virBufferAsprintf(&buf, "%s/%s", dir, namehash);
 
-    if (cache->suffix)
+    if (binary)
+        virBufferAddLit(&buf, "." VIR_FILE_CACHE_BINARY_SUFFIX);
+    else if (cache->suffix)
         virBufferAsprintf(&buf, ".%s", cache->suffix);
 
     return virBufferContentAndReset(&buf);
@@ -124,16 +134,20 @@ virFileCacheGetFileName(virFileCachePtr cache,
 
 static int
 virFileCacheLoad(virFileCachePtr cache,
+                 const char *dir,
                  const char *name,
+                 bool binary,
                  void **data)
 {
     g_autofree char *file = NULL;
     int ret = -1;
     void *loadData = NULL;
+    virFileCacheLoadFilePtr loadFile = binary ? cache->handlers.loadBinaryFile
+                                              : cache->handlers.loadFile;
 
     *data = NULL;
 
-    if (!(file = virFileCacheGetFileName(cache, name)))
+    if (!(file = virFileCacheGetFileName(cache, dir, name, binary)))
         return ret;
 
     if (!virFileExists(file)) {
@@ -148,7 +162,7 @@ virFileCacheLoad(virFileCachePtr cache,
         goto cleanup;
     }
 
-    if (!(loadData = cache->handlers.loadFile(file, name, cache->priv))) {
+    if (!(loadData = loadFile(file, name, cache->priv))) {
         VIR_WARN("Failed to load cached data from '%s' for '%s': %s",
                  file, name, virGetLastErrorMessage());
         virResetLastError();
@@ -158,7 +172,8 @@ virFileCacheLoad(virFileCachePtr cache,
 
     if (!cache->handlers.isValid(loadData, cache->priv)) {
         VIR_DEBUG("Outdated cached capabilities '%s' for '%s'", file, name);
-        unlink(file);
+        if (dir == cache->dir)
+            unlink(file);
         ret = 0;
         goto cleanup;
     }
@@ -174,6 +189,29 @@ virFileCacheLoad(virFileCachePtr cache,
 }
 
 
+/* The binary file only speeds up loading, failing to write it is not
+ * fatal, we just must not leave an outdated one behind. */
+static void
+virFileCacheSaveBinary(virFileCachePtr cache,
+                       const char *name,
+                       void *data)
+{
+    g_autofree char *file = NULL;
+
+    if (!cache->handlers.saveBinaryFile)
+        return;
+
+    if (!(file = virFileCacheGetFileName(cache, cache->dir, name, true)) ||
+        cache->handlers.saveBinaryFile(data, file, cache->priv) < 0) {
+        VIR_WARN("Failed to save binary cache for '%s': %s",
+                 name, virGetLastErrorMessage());
+        virResetLastError();
+        if (file)
+            unlink(file);
+    }
+}
+
+
 static int
 virFileCacheSave(virFileCachePtr cache,
                  const char *name,
@@ -181,16 +219,42 @@ virFileCacheSave(virFileCachePtr cache,
 {
     g_autofree char *file = NULL;
 
-    if (!(file = virFileCacheGetFileName(cache, name)))
+    if (!(file = virFileCacheGetFileName(cache, cache->dir, name, false)))
         return -1;
 
     if (cache->handlers.saveFile(data, file, cache->priv) < 0)
         return -1;
 
+    virFileCacheSaveBinary(cache, name, data);
+
     return 0;
 }
 
 
+/* Looks up data for @name in @dir, preferring the binary format. */
+static int
+virFileCacheLoadDir(virFileCachePtr cache,
+                    const char *dir,
+                    const char *name,
+                    void **data)
+{
+    int rv;
+
+    if (cache->handlers.loadBinaryFile &&
+        (rv = virFileCacheLoad(cache, dir, name, true, data)) != 0)
+        return rv;
+
+    if ((rv = virFileCacheLoad(cache, dir, name, false, data)) <= 0)
+        return rv;
+
+    /* Let the next load use the faster format */
+    if (dir == cache->dir)
+        virFileCacheSaveBinary(cache, name, *data);
+
+    return rv;
+}
+
+
 static void *
 virFileCacheNewData(virFileCachePtr cache,
                     const char *name)
@@ -198,9 +262,17 @@ virFileCacheNewData(virFileCachePtr cache,
     void *data = NULL;
     int rv;
 
-    if ((rv = virFileCacheLoad(cache, name, &data)) < 0)
+    if ((rv = virFileCacheLoadDir(cache, cache->dir, name, &data)) < 0)
         return NULL;
 
+    /* Errors in the shared directory are not ours to deal with */
+    if (rv == 0 && cache->sharedDir) {
+        if ((rv = virFileCacheLoadDir(cache, cache->sharedDir, name, &data)) < 0) {
+            virResetLastError();
+            rv = 0;
+        }
+    }
+
     if (rv == 0) {
         if (!(data = cache->handlers.newData(name, cache->priv)))
             return NULL;
@@ -267,9 +339,12 @@ virFileCacheValidate(virFileCachePtr cache,
         if (name)
             virHashRemoveEntry(cache->table, name);
         *data = NULL;
+    } else if (*data) {
+        cache->hits++;
     }
 
     if (!*data && name) {
+        cache->misses++;
         VIR_DEBUG("Creating data for '%s'", name);
         *data = virFileCacheNewData(cache, name);
         if (*data) {
@@ -344,6 +419,29 @@ virFileCacheLookupByFunc(virFileCachePtr cache,
 }
 
 
+/**
+ * virFileCacheSetSharedDir:
+ * @cache: existing cache object
+ * @dir: directory with cache files maintained by someone else
+ *
+ * Makes @cache look for data it has no valid cache file for in @dir before
+ * creating it. This allows using the data another process with the same
+ * handlers stored in its cache, instead of creating a private copy. Files
+ * in @dir are only ever read.
+ */
+void
+virFileCacheSetSharedDir(virFileCachePtr cache,
+                         const char *dir)
+{
+    virObjectLock(cache);
+
+    g_free(cache->sharedDir);
+    cache->sharedDir = g_strdup(dir);
+
+    virObjectUnlock(cache);
+}
+
+
 /**
  * virFileCacheGetPriv:
  * @cache: existing cache object
@@ -413,3 +511,28 @@ virFileCacheInsertData(virFileCachePtr cache,
 
     return ret;
 }
+
+
+/**
+ * virFileCacheGetStats:
+ * @cache: existing cache object
+ * @entries: filled with the number of cached data objects
+ * @hits: filled with the number of lookups served with cached data
+ * @misses: filled with the number of lookups which had to create data
+ *
+ * Reports how well the cache works.
+ */
+void
+virFileCacheGetStats(virFileCachePtr cache,
+                     size_t *entries,
+                     unsigned long long *hits,
+                     unsigned long long *misses)
+{
+    virObjectLock(cache);
+
+    *entries = virHashSize(cache->table);
+    *hits = cache->hits;
+    *misses = cache->misses;
+
+    virObjectUnlock(cache);
+}
@@ -97,6 +97,9 @@ typedef int
 typedef void
 (*virFileCachePrivFreePtr)(void *priv);
 
+/* Suffix of the cache files using the binary format */
+#define VIR_FILE_CACHE_BINARY_SUFFIX "bin"
+
 typedef struct _virFileCacheHandlers virFileCacheHandlers;
 typedef virFileCacheHandlers *virFileCacheHandlersPtr;
 struct _virFileCacheHandlers {
@@ -105,6 +108,12 @@ struct _virFileCacheHandlers {
     virFileCacheLoadFilePtr loadFile;
     virFileCacheSaveFilePtr saveFile;
     virFileCachePrivFreePtr privFree;
+
+    /* Optional handlers for a binary format which is faster to load. If
+     * set, the binary file is tried first and the regular file is only
+     * used as a fallback. Both files are written when saving data. */
+    virFileCacheLoadFilePtr loadBinaryFile;
+    virFileCacheSaveFilePtr saveBinaryFile;
 };
 
 virFileCachePtr
@@ -121,6 +130,10 @@ virFileCacheLookupByFunc(virFileCachePtr cache,
                          virHashSearcher iter,
                          const void *iterData);
 
+void
+virFileCacheSetSharedDir(virFileCachePtr cache,
+                         const char *dir);
+
 void *
 virFileCacheGetPriv(virFileCachePtr cache);
 
@@ -132,3 +145,9 @@ int
 virFileCacheInsertData(virFileCachePtr cache,
                        const char *name,
                        void *data);
+
+void
+virFileCacheGetStats(virFileCachePtr cache,
+                     size_t *entries,
+                     unsigned long long *hits,
+                     unsigned long long *misses);
@@ -101,12 +101,23 @@ static bool ip6tablesUseLock;
 static bool ebtablesUseLock;
 static bool lockOverride; /* true to avoid lock probes */
 
+/* Whether rules can be applied in batches through *tables-restore */
+static bool iptablesBatch;
+static bool ip6tablesBatch;
+
 void
 virFirewallSetLockOverride(bool avoid)
 {
     lockOverride = avoid;
 }
 
+void
+virFirewallSetBatchOverride(bool batch)
+{
+    iptablesBatch = batch;
+    ip6tablesBatch = batch;
+}
+
 static void
 virFirewallCheckUpdateLock(bool *lockflag,
                            const char *const*args)
@@ -121,6 +132,33 @@ virFirewallCheckUpdateLock(bool *lockflag,
     }
 }
 
+/*
+ * Unless they take the xtables lock, *tables-restore may race with
+ * other users of iptables and lose their changes when committing the
+ * table back, so batching is only used if restoring supports the lock.
+ */
+static void
+virFirewallCheckUpdateBatch(bool *batchflag,
+                            const char *const*args)
+{
+    int status;
+    g_autoptr(virCommand) cmd = NULL;
+
+    if (!virFileIsExecutable(args[0])) {
+        VIR_INFO("%s not available, not batching rules", args[0]);
+        return;
+    }
+
+    /* Nothing to read, so this just checks the arguments are known */
+    cmd = virCommandNewArgs(args);
+    if (virCommandRun(cmd, &status) < 0 || status) {
+        VIR_INFO("locking not supported by %s, not batching rules", args[0]);
+    } else {
+        VIR_INFO("batching rules with %s", args[0]);
+        *batchflag = true;
+    }
+}
+
 static void
 virFirewallCheckUpdateLocking(void)
 {
@@ -133,6 +171,12 @@ virFirewallCheckUpdateLocking(void)
     const char *ebtablesArgs[] = {
         EBTABLES_PATH, "--concurrent", "-L", NULL,
     };
+    const char *iptablesRestoreArgs[] = {
+        IPTABLES_RESTORE_PATH, "-w", "--noflush", "--test", NULL,
+    };
+    const char *ip6tablesRestoreArgs[] = {
+        IP6TABLES_RESTORE_PATH, "-w", "--noflush", "--test", NULL,
+    };
     if (lockOverride)
         return;
     virFirewallCheckUpdateLock(&iptablesUseLock,
@@ -141,6 +185,13 @@ virFirewallCheckUpdateLocking(void)
                                ip6tablesArgs);
     virFirewallCheckUpdateLock(&ebtablesUseLock,
                                ebtablesArgs);
+
+    if (iptablesUseLock)
+        virFirewallCheckUpdateBatch(&iptablesBatch,
+                                    iptablesRestoreArgs);
+    if (ip6tablesUseLock)
+        virFirewallCheckUpdateBatch(&ip6tablesBatch,
+                                    ip6tablesRestoreArgs);
 }
 
 static int
@@ -761,6 +812,186 @@ virFirewallApplyRule(virFirewallPtr firewall,
     return 0;
 }
 
+/* Commands *tables-restore accepts on its input */
+static const char *virFirewallBatchCommands[] = {
+    "-A", "--append",
+    "-I", "--insert",
+    "-D", "--delete",
+    "-R", "--replace",
+    "-N", "--new-chain",
+    "-X", "--delete-chain",
+    "-F", "--flush",
+    "-Z", "--zero",
+    "-E", "--rename-chain",
+    "-P", "--policy",
+    NULL
+};
+
+
+/*
+ * A rule can be applied as part of a batch if it changes iptables or
+ * ip6tables, has no output to look at and must not fail. Each
+ * invocation of *tables-restore either commits the whole table or
+ * nothing at all, so a rule allowed to fail could take down others.
+ */
+static bool
+virFirewallRuleIsBatchable(virFirewallRulePtr rule,
+                           bool ignoreErrors)
+{
+    size_t i;
+
+    if (currentBackend != VIR_FIREWALL_BACKEND_DIRECT ||
+        rule->queryCB || ignoreErrors || rule->ignoreErrors)
+        return false;
+
+    switch (rule->layer) {
+    case VIR_FIREWALL_LAYER_IPV4:
+        if (!iptablesBatch)
+            return false;
+        break;
+    case VIR_FIREWALL_LAYER_IPV6:
+        if (!ip6tablesBatch)
+            return false;
+        break;
+    case VIR_FIREWALL_LAYER_ETHERNET:
+    case VIR_FIREWALL_LAYER_LAST:
+        return false;
+    }
+
+    for (i = 0; i < rule->argsLen; i++) {
+        const char *arg = rule->args[i];
+
+        if (STREQ(arg, "-w") || STREQ(arg, "--wait"))
+            continue;
+
+        if (STREQ(arg, "-t") || STREQ(arg, "--table")) {
+            i++;
+            continue;
+        }
+
+        /* Anything else, e.g. listing a chain, needs its own process */
+        return g_strv_contains(virFirewallBatchCommands, arg);
+    }
+
+    return false;
+}
+
+
+static void
+virFirewallBatchAddArg(virBufferPtr buf,
+                       const char *arg)
+{
+    if (*arg && !strpbrk(arg, " \t\"'\\")) {
+        virBufferAdd(buf, arg, -1);
+        return;
+    }
+
+    virBufferAddChar(buf, '"');
+    for (; *arg; arg++) {
+        if (*arg == '"' || *arg == '\\')
+            virBufferAddChar(buf, '\\');
+        virBufferAddChar(buf, *arg);
+    }
+    virBufferAddChar(buf, '"');
+}
+
+
+/* Formats @rule as a line of *tables-restore input and returns the
+ * table it belongs to */
+static const char *
+virFirewallRuleFormatBatch(virFirewallRulePtr rule,
+                           virBufferPtr buf)
+{
+    const char *table = "filter";
+    bool first = true;
+    size_t i;
+
+    for (i = 0; i < rule->argsLen; i++) {
+        const char *arg = rule->args[i];
+
+        if (STREQ(arg, "-w") || STREQ(arg, "--wait"))
+            continue;
+
+        if ((STREQ(arg, "-t") || STREQ(arg, "--table")) &&
+            i + 1 < rule->argsLen) {
+            table = rule->args[++i];
+            continue;
+        }
+
+        if (!first)
+            virBufferAddChar(buf, ' ');
+        first = false;
+        virFirewallBatchAddArg(buf, arg);
+    }
+    virBufferAddChar(buf, '\n');
+
+    return table;
+}
+
+
+static int
+virFirewallApplyBatch(virFirewallRulePtr *rules,
+                      size_t nrules)
+{
+    const char *bin = IPTABLES_RESTORE_PATH;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autoptr(virCommand) cmd = NULL;
+    g_autofree char *input = NULL;
+    g_autofree char *error = NULL;
+    const char *table = NULL;
+    int status;
+    size_t i;
+
+    if (rules[0]->layer == VIR_FIREWALL_LAYER_IPV6)
+        bin = IP6TABLES_RESTORE_PATH;
+
+    for (i = 0; i < nrules; i++) {
+        g_auto(virBuffer) line = VIR_BUFFER_INITIALIZER;
+        g_autofree char *str = virFirewallRuleToString(rules[i]);
+        const char *ruleTable;
+
+        VIR_INFO("Applying rule '%s' in a batch", NULLSTR(str));
+
+        ruleTable = virFirewallRuleFormatBatch(rules[i], &line);
+
+        if (!table || STRNEQ(table, ruleTable)) {
+            if (table)
+                virBufferAddLit(&buf, "COMMIT\n");
+            virBufferAsprintf(&buf, "*%s\n", ruleTable);
+            table = ruleTable;
+        }
+        virBufferAddBuffer(&buf, &line);
+    }
+    virBufferAddLit(&buf, "COMMIT\n");
+
+    input = virBufferContentAndReset(&buf);
+    VIR_DEBUG("Applying %zu rules with %s:\n%s", nrules, bin, input);
+
+    cmd = virCommandNewArgList(bin, "-w", "--noflush", NULL);
+    virCommandSetInputBuffer(cmd, input);
+    virCommandSetErrorBuffer(cmd, &error);
+
+    if (virCommandRun(cmd, &status) < 0)
+        return -1;
+
+    if (status != 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Failed to apply firewall rules with %s: %s"),
+                       bin, NULLSTR(error));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * With the direct backend, consecutive rules of the same layer which
+ * can be batched are applied with a single *tables-restore process
+ * instead of one process per rule. This changes neither the order the
+ * rules are applied in, nor what happens if one of them fails: the
+ * transaction fails and is rolled back.
+ */
 static int
 virFirewallApplyGroup(virFirewallPtr firewall,
                       size_t idx)
@@ -768,16 +999,31 @@ virFirewallApplyGroup(virFirewallPtr firewall,
     virFirewallGroupPtr group = firewall->groups[idx];
     bool ignoreErrors = (group->actionFlags & VIR_FIREWALL_TRANSACTION_IGNORE_ERRORS);
     size_t i;
+    size_t j;
 
     VIR_INFO("Starting transaction for firewall=%p group=%p flags=0x%x",
              firewall, group, group->actionFlags);
     firewall->currentGroup = idx;
     group->addingRollback = false;
-    for (i = 0; i < group->naction; i++) {
-        if (virFirewallApplyRule(firewall,
-                                 group->action[i],
-                                 ignoreErrors) < 0)
-            return -1;
+    for (i = 0; i < group->naction; i = j) {
+        j = i + 1;
+
+        if (virFirewallRuleIsBatchable(group->action[i], ignoreErrors)) {
+            while (j < group->naction &&
+                   group->action[j]->layer == group->action[i]->layer &&
+                   virFirewallRuleIsBatchable(group->action[j], ignoreErrors))
+                j++;
+        }
+
+        if (j - i > 1) {
+            if (virFirewallApplyBatch(group->action + i, j - i) < 0)
+                return -1;
+        } else {
+            if (virFirewallApplyRule(firewall,
+                                     group->action[i],
+                                     ignoreErrors) < 0)
+                return -1;
+        }
     }
     return 0;
 }
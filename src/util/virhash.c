@@ -1,5 +1,5 @@
 /*
- * virhash.c: chained hash tables
+ * virhash.c: open addressing hash tables
  *
  * Reference: Your favorite introductory book on algorithms
  *
@@ -32,17 +32,35 @@
 
 VIR_LOG_INIT("util.hash");
 
-#define MAX_HASH_LEN 8
-
 /* #define DEBUG_GROW */
 
+/*
+ * The table uses open addressing with linear probing. Entries are stored
+ * inline in one array and every slot has a control byte in a separate,
+ * densely packed array. A control byte of a used slot holds the top 7 bits
+ * of the hash code of the key so that most of the mismatching slots are
+ * skipped without touching the entry, let alone calling keyEqual.
+ *
+ * Removed entries leave a tombstone behind rather than moving other entries
+ * around, which keeps removal of the current entry from virHashForEach
+ * safe. Tombstones are dropped whenever the table is rehashed.
+ */
+#define VIR_HASH_CTRL_EMPTY 0x80
+#define VIR_HASH_CTRL_DELETED 0xFE
+
+#define VIR_HASH_CTRL_IS_FULL(ctrl) (((ctrl) & 0x80) == 0)
+
+#define VIR_HASH_MIN_SIZE 8
+
+/* maximum share of used slots, including tombstones, in eighths */
+#define VIR_HASH_MAX_LOAD 7
+
 /*
  * A single entry in the hash table
  */
 typedef struct _virHashEntry virHashEntry;
 typedef virHashEntry *virHashEntryPtr;
 struct _virHashEntry {
-    struct _virHashEntry *next;
     void *name;
     void *payload;
 };
@@ -51,10 +69,12 @@ struct _virHashEntry {
  * The entire hash table
  */
 struct _virHashTable {
-    virHashEntryPtr *table;
+    virHashEntryPtr table;
+    uint8_t *ctrl;
     uint32_t seed;
-    size_t size;
+    size_t size; /* always a power of two */
     size_t nbElems;
+    size_t nbDeleted;
     virHashDataFree dataFree;
     virHashKeyCode keyCode;
     virHashKeyEqual keyEqual;
@@ -118,11 +138,102 @@ virHashValueFree(void *value)
 }
 
 
-static size_t
+static uint32_t
 virHashComputeKey(const virHashTable *table, const void *name)
 {
-    uint32_t value = table->keyCode(name, table->seed);
-    return value % table->size;
+    return table->keyCode(name, table->seed);
+}
+
+
+static inline size_t
+virHashSlot(const virHashTable *table, uint32_t code)
+{
+    return code & (table->size - 1);
+}
+
+
+static inline uint8_t
+virHashCtrl(uint32_t code)
+{
+    return code >> 25;
+}
+
+
+/*
+ * virHashFindSlot:
+ * @table: the hash table
+ * @name: key to look for
+ * @code: hash code of @name
+ * @free_slot: filled with the slot where @name is to be inserted (optional)
+ *
+ * Returns the slot holding @name or -1 if there's none.
+ */
+static ssize_t
+virHashFindSlot(const virHashTable *table,
+                const void *name,
+                uint32_t code,
+                size_t *free_slot)
+{
+    size_t mask = table->size - 1;
+    size_t i = virHashSlot(table, code);
+    uint8_t ctrl = virHashCtrl(code);
+    bool have_free = false;
+
+    /* the load limit guarantees that there's always an empty slot */
+    for (;; i = (i + 1) & mask) {
+        uint8_t c = table->ctrl[i];
+
+        if (c == VIR_HASH_CTRL_EMPTY) {
+            if (free_slot && !have_free)
+                *free_slot = i;
+            return -1;
+        }
+
+        if (c == VIR_HASH_CTRL_DELETED) {
+            if (free_slot && !have_free) {
+                *free_slot = i;
+                have_free = true;
+            }
+            continue;
+        }
+
+        if (c == ctrl && table->keyEqual(table->table[i].name, name))
+            return i;
+    }
+}
+
+
+/* Drops the entry in @slot without freeing its name and payload. */
+static void
+virHashClearSlot(virHashTablePtr table,
+                 size_t slot)
+{
+    size_t next = (slot + 1) & (table->size - 1);
+
+    table->table[slot].name = NULL;
+    table->table[slot].payload = NULL;
+
+    /* no probe sequence can continue past a slot followed by an empty one */
+    if (table->ctrl[next] == VIR_HASH_CTRL_EMPTY) {
+        table->ctrl[slot] = VIR_HASH_CTRL_EMPTY;
+    } else {
+        table->ctrl[slot] = VIR_HASH_CTRL_DELETED;
+        table->nbDeleted++;
+    }
+
+    table->nbElems--;
+}
+
+
+static void
+virHashAllocSlots(virHashTablePtr table,
+                  size_t size)
+{
+    table->size = size;
+    table->table = g_new0(virHashEntry, size);
+    table->ctrl = g_new(uint8_t, size);
+    memset(table->ctrl, VIR_HASH_CTRL_EMPTY, size);
+    table->nbDeleted = 0;
 }
 
 /**
@@ -147,14 +258,17 @@ virHashTablePtr virHashCreateFull(ssize_t size,
                                   virHashKeyFree keyFree)
 {
     virHashTablePtr table = NULL;
+    size_t slots = VIR_HASH_MIN_SIZE;
 
     if (size <= 0)
         size = 256;
 
+    while (slots < (size_t) size)
+        slots *= 2;
+
     table = g_new0(virHashTable, 1);
 
     table->seed = virRandomBits(32);
-    table->size = size;
     table->nbElems = 0;
     table->dataFree = dataFree;
     table->keyCode = keyCode;
@@ -163,7 +277,7 @@ virHashTablePtr virHashCreateFull(ssize_t size,
     table->keyPrint = keyPrint;
     table->keyFree = keyFree;
 
-    table->table = g_new0(virHashEntryPtr, table->size);
+    virHashAllocSlots(table, slots);
 
     return table;
 }
@@ -245,62 +359,61 @@ virHashAtomicDispose(void *obj)
  * @table: the hash table
  * @size: the new size of the hash table
  *
- * resize the hash table
- *
- * Returns 0 in case of success, -1 in case of failure
+ * Rehash the table into @size slots, dropping all the tombstones.
  */
-static int
+static void
 virHashGrow(virHashTablePtr table, size_t size)
 {
-    size_t oldsize, i;
-    virHashEntryPtr *oldtable;
+    size_t oldsize = table->size;
+    virHashEntryPtr oldtable = table->table;
+    uint8_t *oldctrl = table->ctrl;
+    size_t i;
 
-#ifdef DEBUG_GROW
-    size_t nbElem = 0;
-#endif
+    virHashAllocSlots(table, size);
 
-    if (table == NULL)
-        return -1;
-    if (size < 8)
-        return -1;
-    if (size > 8 * 2048)
-        return -1;
-
-    oldsize = table->size;
-    oldtable = table->table;
-    if (oldtable == NULL)
-        return -1;
+    for (i = 0; i < oldsize; i++) {
+        uint32_t code;
+        size_t slot;
 
-    if (VIR_ALLOC_N(table->table, size) < 0) {
-        table->table = oldtable;
-        return -1;
-    }
-    table->size = size;
+        if (!VIR_HASH_CTRL_IS_FULL(oldctrl[i]))
+            continue;
 
-    for (i = 0; i < oldsize; i++) {
-        virHashEntryPtr iter = oldtable[i];
-        while (iter) {
-            virHashEntryPtr next = iter->next;
-            size_t key = virHashComputeKey(table, iter->name);
+        code = virHashComputeKey(table, oldtable[i].name);
+        slot = virHashSlot(table, code);
 
-            iter->next = table->table[key];
-            table->table[key] = iter;
+        while (table->ctrl[slot] != VIR_HASH_CTRL_EMPTY)
+            slot = (slot + 1) & (size - 1);
 
-#ifdef DEBUG_GROW
-            nbElem++;
-#endif
-            iter = next;
-        }
+        table->ctrl[slot] = virHashCtrl(code);
+        table->table[slot] = oldtable[i];
     }
 
     VIR_FREE(oldtable);
+    VIR_FREE(oldctrl);
 
 #ifdef DEBUG_GROW
-    VIR_DEBUG("virHashGrow : from %d to %d, %ld elems", oldsize,
-              size, nbElem);
+    VIR_DEBUG("virHashGrow : from %zu to %zu, %zu elems", oldsize,
+              size, table->nbElems);
 #endif
+}
 
-    return 0;
+
+/* Makes sure inserting one more entry keeps the load under the limit. */
+static bool
+virHashReserve(virHashTablePtr table)
+{
+    size_t used = table->nbElems + table->nbDeleted + 1;
+    size_t size = table->size;
+
+    if (used * 8 <= size * VIR_HASH_MAX_LOAD)
+        return false;
+
+    /* only clean up tombstones if they make up most of the load */
+    if ((table->nbElems + 1) * 16 > size * VIR_HASH_MAX_LOAD)
+        size *= 2;
+
+    virHashGrow(table, size);
+    return true;
 }
 
 /**
@@ -319,20 +432,19 @@ virHashFree(virHashTablePtr table)
         return;
 
     for (i = 0; i < table->size; i++) {
-        virHashEntryPtr iter = table->table[i];
-        while (iter) {
-            virHashEntryPtr next = iter->next;
+        virHashEntryPtr entry = table->table + i;
 
-            if (table->dataFree)
-                table->dataFree(iter->payload);
-            if (table->keyFree)
-                table->keyFree(iter->name);
-            VIR_FREE(iter);
-            iter = next;
-        }
+        if (!VIR_HASH_CTRL_IS_FULL(table->ctrl[i]))
+            continue;
+
+        if (table->dataFree)
+            table->dataFree(entry->payload);
+        if (table->keyFree)
+            table->keyFree(entry->name);
     }
 
     VIR_FREE(table->table);
+    VIR_FREE(table->ctrl);
     VIR_FREE(table);
 }
 
@@ -341,51 +453,49 @@ virHashAddOrUpdateEntry(virHashTablePtr table, const void *name,
                         void *userdata,
                         bool is_update)
 {
-    size_t key, len = 0;
-    virHashEntryPtr entry;
-    virHashEntryPtr last = NULL;
+    uint32_t code;
+    ssize_t slot;
+    size_t free_slot = 0;
 
     if ((table == NULL) || (name == NULL))
         return -1;
 
-    key = virHashComputeKey(table, name);
+    code = virHashComputeKey(table, name);
 
     /* Check for duplicate entry */
-    for (entry = table->table[key]; entry; entry = entry->next) {
-        if (table->keyEqual(entry->name, name)) {
-            if (is_update) {
-                if (table->dataFree)
-                    table->dataFree(entry->payload);
-                entry->payload = userdata;
-                return 0;
-            } else {
-                g_autofree char *keystr = NULL;
-
-                if (table->keyPrint)
-                    keystr = table->keyPrint(name);
-
-                virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("Duplicate hash table key '%s'"), NULLSTR(keystr));
-                return -1;
-            }
+    if ((slot = virHashFindSlot(table, name, code, &free_slot)) >= 0) {
+        virHashEntryPtr entry = table->table + slot;
+
+        if (is_update) {
+            if (table->dataFree)
+                table->dataFree(entry->payload);
+            entry->payload = userdata;
+            return 0;
+        } else {
+            g_autofree char *keystr = NULL;
+
+            if (table->keyPrint)
+                keystr = table->keyPrint(name);
+
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Duplicate hash table key '%s'"), NULLSTR(keystr));
+            return -1;
         }
-        last = entry;
-        len++;
     }
 
-    entry = g_new0(virHashEntry, 1);
-    entry->name = table->keyCopy(name);
-    entry->payload = userdata;
+    /* reusing a tombstone doesn't increase the load */
+    if (table->ctrl[free_slot] != VIR_HASH_CTRL_DELETED &&
+        virHashReserve(table))
+        virHashFindSlot(table, name, code, &free_slot);
 
-    if (last)
-        last->next = entry;
-    else
-        table->table[key] = entry;
+    if (table->ctrl[free_slot] == VIR_HASH_CTRL_DELETED)
+        table->nbDeleted--;
 
-    table->nbElems++;
+    table->ctrl[free_slot] = virHashCtrl(code);
+    table->table[free_slot].name = table->keyCopy(name);
+    table->table[free_slot].payload = userdata;
 
-    if (len > MAX_HASH_LEN)
-        virHashGrow(table, MAX_HASH_LEN * table->size);
+    table->nbElems++;
 
     return 0;
 }
@@ -445,19 +555,16 @@ static virHashEntryPtr
 virHashGetEntry(const virHashTable *table,
                 const void *name)
 {
-    size_t key;
-    virHashEntryPtr entry;
+    ssize_t slot;
 
     if (!table || !name)
         return NULL;
 
-    key = virHashComputeKey(table, name);
-    for (entry = table->table[key]; entry; entry = entry->next) {
-        if (table->keyEqual(entry->name, name))
-            return entry;
-    }
+    slot = virHashFindSlot(table, name, virHashComputeKey(table, name), NULL);
+    if (slot < 0)
+        return NULL;
 
-    return NULL;
+    return table->table + slot;
 }
 
 
@@ -556,7 +663,7 @@ virHashSize(const virHashTable *table)
  * virHashTableSize:
  * @table: the hash table
  *
- * Query the size of the hash @table, i.e., number of buckets in the table.
+ * Query the size of the hash @table, i.e., number of slots in the table.
  *
  * Returns the number of keys in the hash table or
  * -1 in case of error
@@ -584,28 +691,25 @@ virHashTableSize(const virHashTable *table)
 int
 virHashRemoveEntry(virHashTablePtr table, const void *name)
 {
-    virHashEntryPtr entry;
-    virHashEntryPtr *nextptr;
+    virHashEntry entry;
+    ssize_t slot;
 
     if (table == NULL || name == NULL)
         return -1;
 
-    nextptr = table->table + virHashComputeKey(table, name);
-    for (entry = *nextptr; entry; entry = entry->next) {
-        if (table->keyEqual(entry->name, name)) {
-            if (table->dataFree)
-                table->dataFree(entry->payload);
-            if (table->keyFree)
-                table->keyFree(entry->name);
-            *nextptr = entry->next;
-            VIR_FREE(entry);
-            table->nbElems--;
-            return 0;
-        }
-        nextptr = &entry->next;
-    }
+    slot = virHashFindSlot(table, name, virHashComputeKey(table, name), NULL);
+    if (slot < 0)
+        return -1;
 
-    return -1;
+    entry = table->table[slot];
+    virHashClearSlot(table, slot);
+
+    if (table->dataFree)
+        table->dataFree(entry.payload);
+    if (table->keyFree)
+        table->keyFree(entry.name);
+
+    return 0;
 }
 
 
@@ -633,16 +737,15 @@ virHashForEach(virHashTablePtr table, virHashIterator iter, void *data)
         return -1;
 
     for (i = 0; i < table->size; i++) {
-        virHashEntryPtr entry = table->table[i];
-        while (entry) {
-            virHashEntryPtr next = entry->next;
-            ret = iter(entry->payload, entry->name, data);
+        virHashEntryPtr entry = table->table + i;
 
-            if (ret < 0)
-                return ret;
+        if (!VIR_HASH_CTRL_IS_FULL(table->ctrl[i]))
+            continue;
 
-            entry = next;
-        }
+        ret = iter(entry->payload, entry->name, data);
+
+        if (ret < 0)
+            return ret;
     }
 
     return 0;
@@ -673,23 +776,19 @@ virHashRemoveSet(virHashTablePtr table,
         return -1;
 
     for (i = 0; i < table->size; i++) {
-        virHashEntryPtr *nextptr = table->table + i;
-
-        while (*nextptr) {
-            virHashEntryPtr entry = *nextptr;
-            if (!iter(entry->payload, entry->name, data)) {
-                nextptr = &entry->next;
-            } else {
-                count++;
-                if (table->dataFree)
-                    table->dataFree(entry->payload);
-                if (table->keyFree)
-                    table->keyFree(entry->name);
-                *nextptr = entry->next;
-                VIR_FREE(entry);
-                table->nbElems--;
-            }
-        }
+        virHashEntry entry = table->table[i];
+
+        if (!VIR_HASH_CTRL_IS_FULL(table->ctrl[i]) ||
+            !iter(entry.payload, entry.name, data))
+            continue;
+
+        count++;
+        virHashClearSlot(table, i);
+
+        if (table->dataFree)
+            table->dataFree(entry.payload);
+        if (table->keyFree)
+            table->keyFree(entry.name);
     }
 
     return count;
@@ -747,13 +846,15 @@ void *virHashSearch(const virHashTable *ctable,
         return NULL;
 
     for (i = 0; i < table->size; i++) {
-        virHashEntryPtr entry;
-        for (entry = table->table[i]; entry; entry = entry->next) {
-            if (iter(entry->payload, entry->name, data)) {
-                if (name)
-                    *name = table->keyCopy(entry->name);
-                return entry->payload;
-            }
+        virHashEntryPtr entry = table->table + i;
+
+        if (!VIR_HASH_CTRL_IS_FULL(table->ctrl[i]))
+            continue;
+
+        if (iter(entry->payload, entry->name, data)) {
+            if (name)
+                *name = table->keyCopy(entry->name);
+            return entry->payload;
         }
     }
 
@@ -49,6 +49,7 @@
 #include "virstring.h"
 #include "virnuma.h"
 #include "virlog.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -786,6 +787,196 @@ virHostCPUGetInfoPopulateLinux(FILE *cpuinfo,
 
 # define TICK_TO_NSEC (1000ull * 1000ull * 1000ull / sysconf(_SC_CLK_TCK))
 
+
+/*
+ * /proc/stat only changes once per clock tick, and each read of it is
+ * expensive on hosts with many CPUs since the kernel formats the lines
+ * of all of them. The times of all CPUs are therefore parsed at once
+ * and kept for the rest of the tick, so that collecting the stats of
+ * every CPU one after another reads the file only once.
+ */
+typedef struct _virHostCPUTimes virHostCPUTimes;
+struct _virHostCPUTimes {
+    int cpu; /* VIR_NODE_CPU_STATS_ALL_CPUS for the aggregate line */
+    unsigned long long kernel;
+    unsigned long long user;
+    unsigned long long idle;
+    unsigned long long iowait;
+};
+
+typedef struct _virHostCPUStatsSample virHostCPUStatsSample;
+typedef virHostCPUStatsSample *virHostCPUStatsSamplePtr;
+struct _virHostCPUStatsSample {
+    int fd;
+    char *buf;
+    size_t bufsize;
+
+    gint64 when; /* g_get_monotonic_time() of the sample, 0 if none */
+    size_t ntimes;
+    virHostCPUTimes *times;
+};
+
+static virMutex virHostCPUStatsSampleLock = VIR_MUTEX_INITIALIZER;
+static virHostCPUStatsSample virHostCPUStatsSampleCache = { .fd = -1 };
+
+
+static int
+virHostCPUStatsAssignTimes(virNodeCPUStatsPtr params,
+                           const virHostCPUTimes *times)
+{
+    if (virHostCPUStatsAssign(&params[0], VIR_NODE_CPU_STATS_KERNEL,
+                              times->kernel * TICK_TO_NSEC) < 0)
+        return -1;
+
+    if (virHostCPUStatsAssign(&params[1], VIR_NODE_CPU_STATS_USER,
+                              times->user * TICK_TO_NSEC) < 0)
+        return -1;
+
+    if (virHostCPUStatsAssign(&params[2], VIR_NODE_CPU_STATS_IDLE,
+                              times->idle * TICK_TO_NSEC) < 0)
+        return -1;
+
+    if (virHostCPUStatsAssign(&params[3], VIR_NODE_CPU_STATS_IOWAIT,
+                              times->iowait * TICK_TO_NSEC) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/* Parses the cpu lines of the /proc/stat contents in @buf into @sample */
+static void
+virHostCPUStatsSampleParse(virHostCPUStatsSamplePtr sample,
+                           char *buf)
+{
+    char *line = buf;
+
+    sample->ntimes = 0;
+
+    while (line && STRPREFIX(line, "cpu")) {
+        char *next = strchr(line, '\n');
+        unsigned long long usr, ni, sys, idle, iowait;
+        unsigned long long irq = 0, softirq = 0;
+        virHostCPUTimes times = { 0 };
+        char *tmp;
+
+        if (next)
+            *next++ = '\0';
+
+        if (line[3] == ' ') {
+            times.cpu = VIR_NODE_CPU_STATS_ALL_CPUS;
+            tmp = line + 3;
+        } else if (virStrToLong_i(line + 3, &tmp, 10, &times.cpu) < 0) {
+            line = next;
+            continue;
+        }
+
+        if (sscanf(tmp, "%llu %llu %llu %llu %llu %llu %llu",
+                   &usr, &ni, &sys, &idle, &iowait, &irq, &softirq) < 4) {
+            line = next;
+            continue;
+        }
+
+        times.kernel = sys + irq + softirq;
+        times.user = usr + ni;
+        times.idle = idle;
+        times.iowait = iowait;
+
+        ignore_value(VIR_APPEND_ELEMENT(sample->times, sample->ntimes, times));
+        line = next;
+    }
+}
+
+
+/* Must be called with virHostCPUStatsSampleLock held */
+static int
+virHostCPUStatsSampleRefresh(virHostCPUStatsSamplePtr sample)
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 tick = G_USEC_PER_SEC / sysconf(_SC_CLK_TCK);
+    ssize_t got;
+
+    if (sample->when && now - sample->when < tick)
+        return 0;
+
+    if (sample->fd < 0 &&
+        (sample->fd = open(PROCSTAT_PATH, O_RDONLY | O_CLOEXEC)) < 0) {
+        virReportSystemError(errno, _("cannot open %s"), PROCSTAT_PATH);
+        return -1;
+    }
+
+    /* The whole file has to be read at once to get a consistent
+     * sample, so grow the buffer until it fits */
+    if (!sample->buf) {
+        sample->bufsize = 64 * 1024;
+        sample->buf = g_new0(char, sample->bufsize);
+    }
+
+    while ((got = pread(sample->fd, sample->buf,
+                        sample->bufsize - 1, 0)) ==
+           (ssize_t)(sample->bufsize - 1)) {
+        sample->bufsize *= 2;
+        sample->buf = g_renew(char, sample->buf, sample->bufsize);
+    }
+
+    if (got < 0) {
+        virReportSystemError(errno, _("cannot read %s"), PROCSTAT_PATH);
+        VIR_FORCE_CLOSE(sample->fd);
+        return -1;
+    }
+    sample->buf[got] = '\0';
+
+    VIR_FREE(sample->times);
+    virHostCPUStatsSampleParse(sample, sample->buf);
+    sample->when = now;
+    return 0;
+}
+
+
+static int
+virHostCPUGetStatsSampled(int cpuNum,
+                          virNodeCPUStatsPtr params,
+                          int *nparams)
+{
+    virHostCPUStatsSamplePtr sample = &virHostCPUStatsSampleCache;
+    int ret = -1;
+    size_t i;
+
+    if ((*nparams) == 0) {
+        /* Current number of cpu stats supported by linux */
+        *nparams = LINUX_NB_CPU_STATS;
+        return 0;
+    }
+
+    if ((*nparams) != LINUX_NB_CPU_STATS) {
+        virReportInvalidArg(*nparams,
+                            _("nparams in %s must be equal to %d"),
+                            __FUNCTION__, LINUX_NB_CPU_STATS);
+        return -1;
+    }
+
+    virMutexLock(&virHostCPUStatsSampleLock);
+
+    if (virHostCPUStatsSampleRefresh(sample) < 0)
+        goto cleanup;
+
+    for (i = 0; i < sample->ntimes; i++) {
+        if (sample->times[i].cpu == cpuNum) {
+            ret = virHostCPUStatsAssignTimes(params, &sample->times[i]);
+            goto cleanup;
+        }
+    }
+
+    virReportInvalidArg(cpuNum,
+                        _("Invalid cpuNum in %s"),
+                        __FUNCTION__);
+    ret = 0;
+
+ cleanup:
+    virMutexUnlock(&virHostCPUStatsSampleLock);
+    return ret;
+}
+
 int
 virHostCPUGetStatsLinux(FILE *procstat,
                         int cpuNum,
@@ -828,23 +1019,15 @@ virHostCPUGetStatsLinux(FILE *procstat,
                 continue;
             }
 
-            if (virHostCPUStatsAssign(&params[0], VIR_NODE_CPU_STATS_KERNEL,
-                                      (sys + irq + softirq) * TICK_TO_NSEC) < 0)
-                return -1;
-
-            if (virHostCPUStatsAssign(&params[1], VIR_NODE_CPU_STATS_USER,
-                                      (usr + ni) * TICK_TO_NSEC) < 0)
-                return -1;
-
-            if (virHostCPUStatsAssign(&params[2], VIR_NODE_CPU_STATS_IDLE,
-                                      idle * TICK_TO_NSEC) < 0)
-                return -1;
-
-            if (virHostCPUStatsAssign(&params[3], VIR_NODE_CPU_STATS_IOWAIT,
-                                      iowait * TICK_TO_NSEC) < 0)
-                return -1;
+            virHostCPUTimes times = {
+                .cpu = cpuNum,
+                .kernel = sys + irq + softirq,
+                .user = usr + ni,
+                .idle = idle,
+                .iowait = iowait,
+            };
 
-            return 0;
+            return virHostCPUStatsAssignTimes(params, &times);
         }
     }
 
@@ -1004,19 +1187,7 @@ virHostCPUGetStats(int cpuNum G_GNUC_UNUSED,
     virCheckFlags(0, -1);
 
 #ifdef __linux__
-    {
-        int ret;
-        FILE *procstat = fopen(PROCSTAT_PATH, "r");
-        if (!procstat) {
-            virReportSystemError(errno,
-                                 _("cannot open %s"), PROCSTAT_PATH);
-            return -1;
-        }
-        ret = virHostCPUGetStatsLinux(procstat, cpuNum, params, nparams);
-        VIR_FORCE_FCLOSE(procstat);
-
-        return ret;
-    }
+    return virHostCPUGetStatsSampled(cpuNum, params, nparams);
 #elif defined(__FreeBSD__)
     return virHostCPUGetStatsFreeBSD(cpuNum, params, nparams);
 #else
@@ -23,9 +23,12 @@
 
 #include <config.h>
 
+#include <fcntl.h>
+
 #include "virjson.h"
 #include "viralloc.h"
 #include "virerror.h"
+#include "virfile.h"
 #include "virlog.h"
 #include "virstring.h"
 #include "virutil.h"
@@ -52,6 +55,12 @@ typedef virJSONObjectPair *virJSONObjectPairPtr;
 typedef struct _virJSONArray virJSONArray;
 typedef virJSONArray *virJSONArrayPtr;
 
+typedef struct _virJSONArenaChunk virJSONArenaChunk;
+typedef virJSONArenaChunk *virJSONArenaChunkPtr;
+
+typedef struct _virJSONArena virJSONArena;
+typedef virJSONArena *virJSONArenaPtr;
+
 
 struct _virJSONObjectPair {
     char *key;
@@ -68,8 +77,36 @@ struct _virJSONArray {
     virJSONValuePtr *values;
 };
 
+/* Memory of values parsed from larger documents is carved out of chunks
+ * owned by an arena rather than allocated separately. Arena backed values
+ * are never freed individually; every subtree handed out (the parsed root
+ * or a value stolen from an arena backed container) holds a reference on
+ * the arena and all of the memory is released once the last one is freed.
+ *
+ * Values allocated separately and inserted into arena backed containers
+ * are tracked as foreign and freed with the arena. Note that arena backed
+ * containers have capacity of their arrays implied by the number of
+ * members, see virJSONArenaReserve. */
+struct _virJSONArenaChunk {
+    virJSONArenaChunkPtr next;
+    size_t size;
+    size_t used;
+};
+
+struct _virJSONArena {
+    int refs;
+    virJSONArenaChunkPtr chunks;
+
+    virJSONValuePtr *foreign;
+    size_t nforeign;
+};
+
+#define VIR_JSON_ARENA_CHUNK_MIN 4096
+#define VIR_JSON_ARENA_CHUNK_MAX (256 * 1024)
+
 struct _virJSONValue {
     int type; /* enum virJSONType */
+    virJSONArenaPtr arena; /* non-NULL if allocated from an arena */
 
     union {
         virJSONObject object;
@@ -83,18 +120,42 @@ struct _virJSONValue {
 
 typedef struct _virJSONParserState virJSONParserState;
 typedef virJSONParserState *virJSONParserStatePtr;
+typedef enum {
+    VIR_JSON_PARSER_FILTER_SKIP,    /* value is not materialized at all */
+    VIR_JSON_PARSER_FILTER_PARTIAL, /* only some children are materialized */
+    VIR_JSON_PARSER_FILTER_FULL,    /* the whole subtree is materialized */
+} virJSONParserFilterMode;
+
 struct _virJSONParserState {
-    virJSONValuePtr value;
+    virJSONValuePtr value; /* NULL if the container is not materialized */
     char *key;
+    virJSONType type;
+
+    virJSONParserFilterMode mode;
+    bool *match;     /* filters still matching the path of the container */
+    size_t nelems;   /* number of array elements seen so far */
+    char *name;      /* path component of the container, streaming only */
+    bool root;       /* container is a matched subtree passed to the callback */
 };
 
 typedef struct _virJSONParser virJSONParser;
 typedef virJSONParser *virJSONParserPtr;
 struct _virJSONParser {
     virJSONValuePtr head;
+    bool gothead;
     virJSONParserStatePtr state;
     size_t nstate;
+    size_t nstate_max;
     int wrap;
+
+    char ***filters; /* split paths of values to materialize */
+    size_t nfilters;
+
+    virJSONValueStreamCallback cb;
+    void *opaque;
+    bool cbfailed;
+
+    virJSONArenaPtr arena; /* backs the parsed tree and parser strings */
 };
 
 
@@ -388,6 +449,218 @@ virJSONValueObjectCreate(virJSONValuePtr *obj, ...)
 }
 
 
+static virJSONArenaPtr
+virJSONArenaNew(void)
+{
+    virJSONArenaPtr arena = g_new0(virJSONArena, 1);
+
+    arena->refs = 1;
+
+    return arena;
+}
+
+
+static void
+virJSONArenaRef(virJSONArenaPtr arena)
+{
+    g_atomic_int_inc(&arena->refs);
+}
+
+
+static void
+virJSONArenaUnref(virJSONArenaPtr arena)
+{
+    size_t i;
+
+    if (!g_atomic_int_dec_and_test(&arena->refs))
+        return;
+
+    for (i = 0; i < arena->nforeign; i++)
+        virJSONValueFree(arena->foreign[i]);
+    g_free(arena->foreign);
+
+    while (arena->chunks) {
+        virJSONArenaChunkPtr next = arena->chunks->next;
+
+        g_free(arena->chunks);
+        arena->chunks = next;
+    }
+
+    g_free(arena);
+}
+
+
+/* Returns zeroed memory of @size bytes living as long as @arena. */
+static void *
+virJSONArenaAlloc(virJSONArenaPtr arena,
+                  size_t size)
+{
+    virJSONArenaChunkPtr chunk = arena->chunks;
+    size_t chunksize;
+    void *ret;
+
+    size = VIR_ROUND_UP(size, sizeof(void *));
+
+    if (!chunk || chunk->size - chunk->used < size) {
+        chunksize = chunk ? MIN(chunk->size * 2, VIR_JSON_ARENA_CHUNK_MAX) :
+                            VIR_JSON_ARENA_CHUNK_MIN;
+
+        if (chunk && size > chunksize / 4) {
+            /* large allocations get a chunk of their own so that the rest
+             * of the current chunk is not wasted */
+            chunksize = size;
+            chunk = g_malloc(sizeof(*chunk) + chunksize);
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        } else {
+            chunksize = MAX(chunksize, size);
+            chunk = g_malloc(sizeof(*chunk) + chunksize);
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+
+        chunk->size = chunksize;
+        chunk->used = 0;
+    }
+
+    ret = (char *)(chunk + 1) + chunk->used;
+    chunk->used += size;
+
+    memset(ret, 0, size);
+    return ret;
+}
+
+
+static char *
+virJSONArenaStrndup(virJSONArenaPtr arena,
+                    const char *str,
+                    size_t len)
+{
+    char *ret;
+
+    if (!arena)
+        return g_strndup(str, len);
+
+    ret = virJSONArenaAlloc(arena, len + 1);
+    memcpy(ret, str, len);
+
+    return ret;
+}
+
+
+/**
+ * virJSONArenaReserve:
+ * @arena: arena owning the array
+ * @array: pointer to the array of a container
+ * @n: current number of elements of the array
+ * @elemsize: size of one element
+ *
+ * Makes room for one more element in an arena backed array. The capacity
+ * of the array is not stored anywhere; arrays are allocated with 4 elements
+ * and doubled whenever the number of elements reaches a power of two, so
+ * removing elements never makes the implied capacity exceed the real one.
+ */
+static void
+virJSONArenaReserve(virJSONArenaPtr arena,
+                    void **array,
+                    size_t n,
+                    size_t elemsize)
+{
+    size_t capacity;
+    void *grown;
+
+    if (n == 0)
+        capacity = 4;
+    else if (n >= 4 && (n & (n - 1)) == 0)
+        capacity = n * 2;
+    else
+        return;
+
+    grown = virJSONArenaAlloc(arena, capacity * elemsize);
+    if (n)
+        memcpy(grown, *array, n * elemsize);
+    *array = grown;
+}
+
+
+static virJSONValuePtr
+virJSONValueNewInArena(virJSONArenaPtr arena,
+                       virJSONType type)
+{
+    virJSONValuePtr val;
+
+    if (arena) {
+        val = virJSONArenaAlloc(arena, sizeof(*val));
+        val->arena = arena;
+    } else {
+        val = g_new0(virJSONValue, 1);
+    }
+
+    val->type = type;
+
+    return val;
+}
+
+
+/**
+ * virJSONValueAdopt:
+ * @container: container @value is about to be inserted into
+ * @value: value being inserted
+ *
+ * Transfers the ownership of @value to @container. A value from the arena
+ * of @container gives up its reference as it becomes part of the tree
+ * again, any other value is tracked to be freed along with the arena.
+ */
+static void
+virJSONValueAdopt(virJSONValuePtr container,
+                  virJSONValuePtr value)
+{
+    virJSONArenaPtr arena = container->arena;
+
+    if (!arena || !value)
+        return;
+
+    if (value->arena == arena)
+        virJSONArenaUnref(arena);
+    else
+        ignore_value(VIR_APPEND_ELEMENT(arena->foreign, arena->nforeign, value));
+}
+
+
+/**
+ * virJSONValueDetach:
+ * @container: container @value was removed from
+ * @value: the removed value
+ *
+ * Counterpart of virJSONValueAdopt making @value an independent tree which
+ * has to be freed by the caller.
+ */
+static virJSONValuePtr
+virJSONValueDetach(virJSONValuePtr container,
+                   virJSONValuePtr value)
+{
+    virJSONArenaPtr arena = container->arena;
+    size_t i;
+
+    if (!arena || !value)
+        return value;
+
+    if (value->arena == arena) {
+        virJSONArenaRef(arena);
+        return value;
+    }
+
+    for (i = 0; i < arena->nforeign; i++) {
+        if (arena->foreign[i] == value) {
+            VIR_DELETE_ELEMENT(arena->foreign, i, arena->nforeign);
+            break;
+        }
+    }
+
+    return value;
+}
+
+
 void
 virJSONValueFree(virJSONValuePtr value)
 {
@@ -395,6 +668,11 @@ virJSONValueFree(virJSONValuePtr value)
     if (!value)
         return;
 
+    if (value->arena) {
+        virJSONArenaUnref(value->arena);
+        return;
+    }
+
     switch ((virJSONType) value->type) {
     case VIR_JSON_TYPE_OBJECT:
         for (i = 0; i < value->data.object.npairs; i++) {
@@ -579,6 +857,49 @@ virJSONValueNewObject(void)
 }
 
 
+/* Inserts @pair into @object, the key and value are consumed. */
+static void
+virJSONValueObjectInsertPair(virJSONValuePtr object,
+                             virJSONObjectPairPtr pair,
+                             bool prepend)
+{
+    virJSONObjectPtr obj = &object->data.object;
+
+    if (object->arena) {
+        virJSONArenaReserve(object->arena, (void **)&obj->pairs,
+                            obj->npairs, sizeof(*obj->pairs));
+        if (prepend)
+            ignore_value(VIR_INSERT_ELEMENT_INPLACE(obj->pairs, 0,
+                                                    obj->npairs, *pair));
+        else
+            ignore_value(VIR_APPEND_ELEMENT_INPLACE(obj->pairs,
+                                                    obj->npairs, *pair));
+        return;
+    }
+
+    if (prepend)
+        ignore_value(VIR_INSERT_ELEMENT(obj->pairs, 0, obj->npairs, *pair));
+    else
+        ignore_value(VIR_APPEND_ELEMENT(obj->pairs, obj->npairs, *pair));
+}
+
+
+static void
+virJSONValueObjectDeletePair(virJSONValuePtr object,
+                             size_t i)
+{
+    virJSONObjectPtr obj = &object->data.object;
+
+    if (object->arena) {
+        VIR_DELETE_ELEMENT_INPLACE(obj->pairs, i, obj->npairs);
+        return;
+    }
+
+    VIR_FREE(obj->pairs[i].key);
+    VIR_DELETE_ELEMENT(obj->pairs, i, obj->npairs);
+}
+
+
 static int
 virJSONValueObjectInsert(virJSONValuePtr object,
                          const char *key,
@@ -586,7 +907,6 @@ virJSONValueObjectInsert(virJSONValuePtr object,
                          bool prepend)
 {
     virJSONObjectPair pair = { NULL, value };
-    int ret = -1;
 
     if (object->type != VIR_JSON_TYPE_OBJECT) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -599,18 +919,12 @@ virJSONValueObjectInsert(virJSONValuePtr object,
         return -1;
     }
 
-    pair.key = g_strdup(key);
+    virJSONValueAdopt(object, value);
 
-    if (prepend) {
-        ret = VIR_INSERT_ELEMENT(object->data.object.pairs, 0,
-                                 object->data.object.npairs, pair);
-    } else {
-        ret = VIR_APPEND_ELEMENT(object->data.object.pairs,
-                                 object->data.object.npairs, pair);
-    }
+    pair.key = virJSONArenaStrndup(object->arena, key, strlen(key));
+    virJSONValueObjectInsertPair(object, &pair, prepend);
 
-    VIR_FREE(pair.key);
-    return ret;
+    return 0;
 }
 
 
@@ -769,6 +1083,23 @@ virJSONValueObjectAppendNull(virJSONValuePtr object,
 }
 
 
+static void
+virJSONValueArrayAppendInternal(virJSONValuePtr array,
+                                virJSONValuePtr value)
+{
+    virJSONArrayPtr arr = &array->data.array;
+
+    if (array->arena) {
+        virJSONArenaReserve(array->arena, (void **)&arr->values,
+                            arr->nvalues, sizeof(*arr->values));
+    } else {
+        ignore_value(VIR_REALLOC_N(arr->values, arr->nvalues + 1));
+    }
+
+    arr->values[arr->nvalues++] = value;
+}
+
+
 int
 virJSONValueArrayAppend(virJSONValuePtr array,
                         virJSONValuePtr value)
@@ -778,12 +1109,8 @@ virJSONValueArrayAppend(virJSONValuePtr array,
         return -1;
     }
 
-    if (VIR_REALLOC_N(array->data.array.values,
-                      array->data.array.nvalues + 1) < 0)
-        return -1;
-
-    array->data.array.values[array->data.array.nvalues] = value;
-    array->data.array.nvalues++;
+    virJSONValueAdopt(array, value);
+    virJSONValueArrayAppendInternal(array, value);
 
     return 0;
 }
@@ -823,6 +1150,19 @@ virJSONValueArrayConcat(virJSONValuePtr a,
         return -1;
     }
 
+    /* arena backed arrays need their members to be adopted one by one */
+    if (a->arena || c->arena) {
+        for (i = 0; i < c->data.array.nvalues; i++) {
+            virJSONValuePtr value = virJSONValueDetach(c, c->data.array.values[i]);
+
+            virJSONValueAdopt(a, value);
+            virJSONValueArrayAppendInternal(a, value);
+        }
+
+        c->data.array.nvalues = 0;
+        return 0;
+    }
+
     a->data.array.values = g_renew(virJSONValuePtr, a->data.array.values,
                                    a->data.array.nvalues + c->data.array.nvalues);
 
@@ -883,10 +1223,8 @@ virJSONValueObjectSteal(virJSONValuePtr object,
 
     for (i = 0; i < object->data.object.npairs; i++) {
         if (STREQ(object->data.object.pairs[i].key, key)) {
-            obj = g_steal_pointer(&object->data.object.pairs[i].value);
-            VIR_FREE(object->data.object.pairs[i].key);
-            VIR_DELETE_ELEMENT(object->data.object.pairs, i,
-                               object->data.object.npairs);
+            obj = virJSONValueDetach(object, object->data.object.pairs[i].value);
+            virJSONValueObjectDeletePair(object, i);
             break;
         }
     }
@@ -967,14 +1305,15 @@ virJSONValueObjectRemoveKey(virJSONValuePtr object,
 
     for (i = 0; i < object->data.object.npairs; i++) {
         if (STREQ(object->data.object.pairs[i].key, key)) {
-            if (value) {
-                *value = object->data.object.pairs[i].value;
-                object->data.object.pairs[i].value = NULL;
-            }
-            VIR_FREE(object->data.object.pairs[i].key);
-            virJSONValueFree(object->data.object.pairs[i].value);
-            VIR_DELETE_ELEMENT(object->data.object.pairs, i,
-                               object->data.object.npairs);
+            virJSONValuePtr removed;
+
+            removed = virJSONValueDetach(object,
+                                         object->data.object.pairs[i].value);
+            if (value)
+                *value = removed;
+            else
+                virJSONValueFree(removed);
+            virJSONValueObjectDeletePair(object, i);
             return 1;
         }
     }
@@ -1047,11 +1386,16 @@ virJSONValueArraySteal(virJSONValuePtr array,
     if (element >= array->data.array.nvalues)
         return NULL;
 
-    ret = array->data.array.values[element];
+    ret = virJSONValueDetach(array, array->data.array.values[element]);
 
-    VIR_DELETE_ELEMENT(array->data.array.values,
-                       element,
-                       array->data.array.nvalues);
+    if (array->arena)
+        VIR_DELETE_ELEMENT_INPLACE(array->data.array.values,
+                                   element,
+                                   array->data.array.nvalues);
+    else
+        VIR_DELETE_ELEMENT(array->data.array.values,
+                           element,
+                           array->data.array.nvalues);
 
     return ret;
 }
@@ -1089,7 +1433,16 @@ virJSONValueArrayForeachSteal(virJSONValuePtr array,
         return -1;
 
     for (i = 0; i < array->data.array.nvalues; i++) {
-        if ((rc = cb(i, array->data.array.values[i], opaque)) < 0) {
+        virJSONValuePtr value = array->data.array.values[i];
+
+        /* the callback may free the value right away so it has to be
+         * detached in advance */
+        virJSONValueDetach(array, value);
+
+        if ((rc = cb(i, value, opaque)) != 0)
+            virJSONValueAdopt(array, value);
+
+        if (rc < 0) {
             ret = -1;
             break;
         }
@@ -1547,145 +1900,357 @@ virJSONValueCopy(const virJSONValue *in)
 
 
 #if WITH_YAJL
+/* Keys and path components are allocated from the arena when parsing
+ * into one, in which case they are released only along with it. */
+static char *
+virJSONParserStrndup(virJSONParserPtr parser,
+                     const char *str,
+                     size_t len)
+{
+    return virJSONArenaStrndup(parser->arena, str, len);
+}
+
+
+static void
+virJSONParserFreeString(virJSONParserPtr parser,
+                        char **str)
+{
+    if (!parser->arena)
+        g_free(*str);
+    *str = NULL;
+}
+
+
+static void
+virJSONParserStateClear(virJSONParserPtr parser,
+                        virJSONParserStatePtr state)
+{
+    virJSONParserFreeString(parser, &state->key);
+    virJSONParserFreeString(parser, &state->name);
+    VIR_FREE(state->match);
+    if (state->root)
+        virJSONValueFree(state->value);
+    state->value = NULL;
+}
+
+
+/**
+ * virJSONParserFilterNext:
+ * @parser: parser state
+ * @name: filled with the path component of the next value
+ * @match: filled with the filters still matching below the next value
+ *
+ * Consumes the key or array slot of the next value in the innermost
+ * container and decides whether the value is to be materialized.
+ * @name is filled unless the value is skipped, @match is filled only
+ * for VIR_JSON_PARSER_FILTER_PARTIAL.
+ *
+ * Returns one of virJSONParserFilterMode or -1 on malformed input.
+ */
 static int
-virJSONParserInsertValue(virJSONParserPtr parser,
-                         virJSONValuePtr value)
+virJSONParserFilterNext(virJSONParserPtr parser,
+                        char **name,
+                        bool **match)
 {
-    if (!parser->head) {
-        parser->head = value;
-    } else {
-        virJSONParserStatePtr state;
-        if (!parser->nstate) {
-            VIR_DEBUG("got a value to insert without a container");
-            return -1;
-        }
+    virJSONParserStatePtr state;
+    char *component = NULL;
+    g_autofree bool *next = NULL;
+    bool partial = false;
+    size_t depth;
+    size_t i;
 
-        state = &parser->state[parser->nstate-1];
+    *name = NULL;
+    *match = NULL;
 
-        switch (state->value->type) {
-        case VIR_JSON_TYPE_OBJECT: {
-            if (!state->key) {
-                VIR_DEBUG("missing key when inserting object value");
-                return -1;
-            }
+    if (!parser->gothead) {
+        parser->gothead = true;
 
-            if (virJSONValueObjectAppend(state->value,
-                                         state->key,
-                                         value) < 0)
-                return -1;
+        if (!parser->nfilters)
+            return VIR_JSON_PARSER_FILTER_FULL;
 
-            VIR_FREE(state->key);
-        }   break;
+        *match = g_new0(bool, parser->nfilters);
+        for (i = 0; i < parser->nfilters; i++)
+            (*match)[i] = true;
+        return VIR_JSON_PARSER_FILTER_PARTIAL;
+    }
 
-        case VIR_JSON_TYPE_ARRAY: {
-            if (state->key) {
-                VIR_DEBUG("unexpected key when inserting array value");
-                return -1;
-            }
+    if (!parser->nstate) {
+        VIR_DEBUG("got a value to insert without a container");
+        return -1;
+    }
 
-            if (virJSONValueArrayAppend(state->value,
-                                        value) < 0)
-                return -1;
-        }   break;
+    state = &parser->state[parser->nstate - 1];
 
-        default:
-            VIR_DEBUG("unexpected value type, not a container");
+    if (state->type == VIR_JSON_TYPE_OBJECT) {
+        if (!state->key) {
+            VIR_DEBUG("missing key when inserting object value");
             return -1;
         }
+        component = g_steal_pointer(&state->key);
+    } else {
+        if (state->key) {
+            VIR_DEBUG("unexpected key when inserting array value");
+            return -1;
+        }
+        if (state->mode == VIR_JSON_PARSER_FILTER_PARTIAL) {
+            char idx[VIR_INT64_STR_BUFLEN];
+
+            g_snprintf(idx, sizeof(idx), "%zu", state->nelems);
+            component = virJSONParserStrndup(parser, idx, strlen(idx));
+        }
+        state->nelems++;
     }
 
-    return 0;
-}
+    if (state->mode != VIR_JSON_PARSER_FILTER_PARTIAL) {
+        if (state->mode == VIR_JSON_PARSER_FILTER_FULL)
+            *name = g_steal_pointer(&component);
+        virJSONParserFreeString(parser, &component);
+        return state->mode;
+    }
 
+    /* the head is at depth 0, so the first path component of the children
+     * of a container at stack position N is the N-th filter component */
+    depth = parser->nstate - 1;
+    next = g_new0(bool, parser->nfilters);
 
-static int
-virJSONParserHandleNull(void *ctx)
-{
-    virJSONParserPtr parser = ctx;
-    virJSONValuePtr value = virJSONValueNewNull();
+    for (i = 0; i < parser->nfilters; i++) {
+        const char *want;
 
-    VIR_DEBUG("parser=%p", parser);
+        if (!state->match[i])
+            continue;
 
-    if (!value)
-        return 0;
+        want = parser->filters[i][depth];
+        if (STRNEQ(want, "*") && STRNEQ(want, component))
+            continue;
 
-    if (virJSONParserInsertValue(parser, value) < 0) {
-        virJSONValueFree(value);
-        return 0;
+        if (!parser->filters[i][depth + 1]) {
+            *name = g_steal_pointer(&component);
+            return VIR_JSON_PARSER_FILTER_FULL;
+        }
+
+        next[i] = true;
+        partial = true;
     }
 
-    return 1;
+    if (!partial) {
+        virJSONParserFreeString(parser, &component);
+        return VIR_JSON_PARSER_FILTER_SKIP;
+    }
+
+    *name = g_steal_pointer(&component);
+    *match = g_steal_pointer(&next);
+    return VIR_JSON_PARSER_FILTER_PARTIAL;
 }
 
 
-static int
-virJSONParserHandleBoolean(void *ctx,
-                           int boolean_)
+/* Matched subtrees are passed to the streaming callback rather than
+ * being inserted into their (not materialized) parent. */
+static bool
+virJSONParserIsRoot(virJSONParserPtr parser,
+                    int mode)
 {
-    virJSONParserPtr parser = ctx;
-    virJSONValuePtr value = virJSONValueNewBoolean(boolean_);
-
-    VIR_DEBUG("parser=%p boolean=%d", parser, boolean_);
-
-    if (!value)
-        return 0;
-
-    if (virJSONParserInsertValue(parser, value) < 0) {
-        virJSONValueFree(value);
-        return 0;
-    }
+    if (!parser->cb || mode != VIR_JSON_PARSER_FILTER_FULL)
+        return false;
 
-    return 1;
+    return !parser->nstate ||
+        parser->state[parser->nstate - 1].mode != VIR_JSON_PARSER_FILTER_FULL;
 }
 
 
 static int
-virJSONParserHandleNumber(void *ctx,
-                          const char *s,
-                          size_t l)
+virJSONParserEmitValue(virJSONParserPtr parser,
+                       const char *name,
+                       virJSONValuePtr value)
 {
-    virJSONParserPtr parser = ctx;
-    char *str;
-    virJSONValuePtr value;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *path = NULL;
+    size_t i;
 
-    str = g_strndup(s, l);
-    value = virJSONValueNewNumber(str);
-    VIR_FREE(str);
+    for (i = 1; i < parser->nstate; i++)
+        virBufferAsprintf(&buf, "%s/", parser->state[i].name);
+    virBufferAdd(&buf, name, -1);
 
-    VIR_DEBUG("parser=%p str=%s", parser, str);
+    path = virBufferContentAndReset(&buf);
 
-    if (!value)
-        return 0;
+    VIR_DEBUG("parser=%p path=%s", parser, NULLSTR_EMPTY(path));
 
-    if (virJSONParserInsertValue(parser, value) < 0) {
-        virJSONValueFree(value);
-        return 0;
+    if (parser->cb(NULLSTR_EMPTY(path), value, parser->opaque) < 0) {
+        parser->cbfailed = true;
+        return -1;
     }
 
-    return 1;
+    return 0;
 }
 
 
 static int
-virJSONParserHandleString(void *ctx,
-                          const unsigned char *stringVal,
-                          size_t stringLen)
+virJSONParserInsertValue(virJSONParserPtr parser,
+                         char **name,
+                         virJSONValuePtr value)
 {
-    virJSONParserPtr parser = ctx;
-    virJSONValuePtr value = virJSONValueNewStringLen((const char *)stringVal,
-                                                     stringLen);
-
-    VIR_DEBUG("parser=%p str=%p", parser, (const char *)stringVal);
+    virJSONParserStatePtr state;
+    virJSONObjectPair pair = { NULL, value };
 
-    if (!value)
+    if (!parser->nstate) {
+        parser->head = value;
         return 0;
+    }
+
+    state = &parser->state[parser->nstate - 1];
+
+    switch (state->type) {
+    case VIR_JSON_TYPE_OBJECT:
+        if (virJSONValueObjectHasKey(state->value, *name)) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("duplicate key '%s'"), *name);
+            return -1;
+        }
+
+        pair.key = g_steal_pointer(name);
+        virJSONValueObjectInsertPair(state->value, &pair, false);
+        break;
+
+    case VIR_JSON_TYPE_ARRAY:
+        virJSONValueArrayAppendInternal(state->value, value);
+        break;
+
+    default:
+        VIR_DEBUG("unexpected value type, not a container");
+        return -1;
+    }
+
+    return 0;
+}
 
-    if (virJSONParserInsertValue(parser, value) < 0) {
+
+/* Frees a value which didn't make it into the tree. */
+static void
+virJSONParserDiscardValue(virJSONValuePtr value)
+{
+    /* arena backed values are released with the arena */
+    if (!value->arena)
         virJSONValueFree(value);
+}
+
+
+/**
+ * virJSONParserAddScalar:
+ * @parser: parser state
+ * @type: type of the scalar value
+ * @str: string representation of a string or number value
+ * @len: length of @str
+ * @boolean_: value of a boolean value
+ *
+ * Creates the next scalar value unless it is filtered out.
+ *
+ * Returns 1 on success and 0 on failure as expected by yajl.
+ */
+static int
+virJSONParserAddScalar(virJSONParserPtr parser,
+                       virJSONType type,
+                       const char *str,
+                       size_t len,
+                       int boolean_)
+{
+    char *name = NULL;
+    g_autofree bool *match = NULL;
+    virJSONValuePtr value;
+    int mode;
+    int ret = 0;
+
+    if ((mode = virJSONParserFilterNext(parser, &name, &match)) < 0)
         return 0;
+
+    /* a filter path going deeper than a scalar value doesn't match it,
+     * only a plain scalar document is kept when building a tree */
+    if (mode == VIR_JSON_PARSER_FILTER_SKIP ||
+        (mode == VIR_JSON_PARSER_FILTER_PARTIAL &&
+         (parser->nstate || parser->cb))) {
+        virJSONParserFreeString(parser, &name);
+        return 1;
     }
 
-    return 1;
+    value = virJSONValueNewInArena(parser->arena, type);
+
+    switch (type) {
+    case VIR_JSON_TYPE_STRING:
+        value->data.string = virJSONArenaStrndup(parser->arena, str, len);
+        break;
+    case VIR_JSON_TYPE_NUMBER:
+        value->data.number = virJSONArenaStrndup(parser->arena, str, len);
+        break;
+    case VIR_JSON_TYPE_BOOLEAN:
+        value->data.boolean = boolean_;
+        break;
+    case VIR_JSON_TYPE_NULL:
+    case VIR_JSON_TYPE_OBJECT:
+    case VIR_JSON_TYPE_ARRAY:
+        break;
+    }
+
+    if (virJSONParserIsRoot(parser, mode)) {
+        if (virJSONParserEmitValue(parser, name, value) == 0)
+            ret = 1;
+        virJSONValueFree(value);
+    } else if (virJSONParserInsertValue(parser, &name, value) < 0) {
+        virJSONParserDiscardValue(value);
+    } else {
+        ret = 1;
+    }
+
+    virJSONParserFreeString(parser, &name);
+    return ret;
+}
+
+
+static int
+virJSONParserHandleNull(void *ctx)
+{
+    virJSONParserPtr parser = ctx;
+
+    VIR_DEBUG("parser=%p", parser);
+
+    return virJSONParserAddScalar(parser, VIR_JSON_TYPE_NULL, NULL, 0, 0);
+}
+
+
+static int
+virJSONParserHandleBoolean(void *ctx,
+                           int boolean_)
+{
+    virJSONParserPtr parser = ctx;
+
+    VIR_DEBUG("parser=%p boolean=%d", parser, boolean_);
+
+    return virJSONParserAddScalar(parser, VIR_JSON_TYPE_BOOLEAN,
+                                  NULL, 0, boolean_);
+}
+
+
+static int
+virJSONParserHandleNumber(void *ctx,
+                          const char *s,
+                          size_t l)
+{
+    virJSONParserPtr parser = ctx;
+
+    VIR_DEBUG("parser=%p str=%.*s", parser, (int)l, s);
+
+    return virJSONParserAddScalar(parser, VIR_JSON_TYPE_NUMBER, s, l, 0);
+}
+
+
+static int
+virJSONParserHandleString(void *ctx,
+                          const unsigned char *stringVal,
+                          size_t stringLen)
+{
+    virJSONParserPtr parser = ctx;
+
+    VIR_DEBUG("parser=%p str=%p", parser, (const char *)stringVal);
+
+    return virJSONParserAddScalar(parser, VIR_JSON_TYPE_STRING,
+                                  (const char *)stringVal, stringLen, 0);
 }
 
 
@@ -1705,82 +2270,127 @@ virJSONParserHandleMapKey(void *ctx,
     state = &parser->state[parser->nstate-1];
     if (state->key)
         return 0;
-    state->key = g_strndup((const char *)stringVal, stringLen);
+    state->key = virJSONParserStrndup(parser, (const char *)stringVal,
+                                      stringLen);
     return 1;
 }
 
 
 static int
-virJSONParserHandleStartMap(void *ctx)
+virJSONParserStartContainer(virJSONParserPtr parser,
+                            virJSONType type)
 {
-    virJSONParserPtr parser = ctx;
-    virJSONValuePtr value = virJSONValueNewObject();
-
-    VIR_DEBUG("parser=%p", parser);
+    char *name = NULL;
+    g_autofree bool *match = NULL;
+    virJSONParserStatePtr state;
+    virJSONValuePtr value = NULL;
+    bool root;
+    int mode;
 
-    if (virJSONParserInsertValue(parser, value) < 0) {
-        virJSONValueFree(value);
+    if ((mode = virJSONParserFilterNext(parser, &name, &match)) < 0)
         return 0;
-    }
 
-    if (VIR_REALLOC_N(parser->state,
-                      parser->nstate + 1) < 0) {
+    root = virJSONParserIsRoot(parser, mode);
+
+    if (VIR_RESIZE_N(parser->state, parser->nstate_max,
+                     parser->nstate, 1) < 0) {
+        virJSONParserFreeString(parser, &name);
         return 0;
     }
 
-    parser->state[parser->nstate].value = value;
-    parser->state[parser->nstate].key = NULL;
-    parser->nstate++;
+    /* when streaming, only the matched subtrees are materialized */
+    if (mode == VIR_JSON_PARSER_FILTER_FULL ||
+        (mode == VIR_JSON_PARSER_FILTER_PARTIAL && !parser->cb)) {
+        value = virJSONValueNewInArena(parser->arena, type);
+
+        if (!root &&
+            virJSONParserInsertValue(parser, &name, value) < 0) {
+            virJSONParserDiscardValue(value);
+            virJSONParserFreeString(parser, &name);
+            return 0;
+        }
+    }
 
+    state = &parser->state[parser->nstate++];
+    memset(state, 0, sizeof(*state));
+    state->value = value;
+    state->type = type;
+    state->mode = mode;
+    state->match = g_steal_pointer(&match);
+    state->root = root;
+    if (parser->cb && (root || mode == VIR_JSON_PARSER_FILTER_PARTIAL))
+        state->name = g_steal_pointer(&name);
+
+    virJSONParserFreeString(parser, &name);
     return 1;
 }
 
 
 static int
-virJSONParserHandleEndMap(void *ctx)
+virJSONParserEndContainer(virJSONParserPtr parser)
 {
-    virJSONParserPtr parser = ctx;
-    virJSONParserStatePtr state;
-
-    VIR_DEBUG("parser=%p", parser);
+    virJSONParserStatePtr state = &(parser->state[parser->nstate-1]);
+    char *name = NULL;
+    virJSONValuePtr value = NULL;
+    int ret = 1;
 
-    if (!parser->nstate)
-        return 0;
-
-    state = &(parser->state[parser->nstate-1]);
     if (state->key) {
-        VIR_FREE(state->key);
+        virJSONParserFreeString(parser, &state->key);
         return 0;
     }
 
-    VIR_DELETE_ELEMENT(parser->state, parser->nstate - 1, parser->nstate);
+    if (state->root) {
+        value = g_steal_pointer(&state->value);
+        name = g_steal_pointer(&state->name);
+    }
 
-    return 1;
+    virJSONParserStateClear(parser, state);
+    parser->nstate--;
+
+    if (value) {
+        if (virJSONParserEmitValue(parser, name, value) < 0)
+            ret = 0;
+        virJSONValueFree(value);
+    }
+
+    virJSONParserFreeString(parser, &name);
+    return ret;
 }
 
 
 static int
-virJSONParserHandleStartArray(void *ctx)
+virJSONParserHandleStartMap(void *ctx)
 {
     virJSONParserPtr parser = ctx;
-    virJSONValuePtr value = virJSONValueNewArray();
 
     VIR_DEBUG("parser=%p", parser);
 
-    if (virJSONParserInsertValue(parser, value) < 0) {
-        virJSONValueFree(value);
-        return 0;
-    }
+    return virJSONParserStartContainer(parser, VIR_JSON_TYPE_OBJECT);
+}
 
-    if (VIR_REALLOC_N(parser->state,
-                      parser->nstate + 1) < 0)
+
+static int
+virJSONParserHandleEndMap(void *ctx)
+{
+    virJSONParserPtr parser = ctx;
+
+    VIR_DEBUG("parser=%p", parser);
+
+    if (!parser->nstate)
         return 0;
 
-    parser->state[parser->nstate].value = value;
-    parser->state[parser->nstate].key = NULL;
-    parser->nstate++;
+    return virJSONParserEndContainer(parser);
+}
 
-    return 1;
+
+static int
+virJSONParserHandleStartArray(void *ctx)
+{
+    virJSONParserPtr parser = ctx;
+
+    VIR_DEBUG("parser=%p", parser);
+
+    return virJSONParserStartContainer(parser, VIR_JSON_TYPE_ARRAY);
 }
 
 
@@ -1788,22 +2398,13 @@ static int
 virJSONParserHandleEndArray(void *ctx)
 {
     virJSONParserPtr parser = ctx;
-    virJSONParserStatePtr state;
 
     VIR_DEBUG("parser=%p", parser);
 
     if (!(parser->nstate - parser->wrap))
         return 0;
 
-    state = &(parser->state[parser->nstate-1]);
-    if (state->key) {
-        VIR_FREE(state->key);
-        return 0;
-    }
-
-    VIR_DELETE_ELEMENT(parser->state, parser->nstate - 1, parser->nstate);
-
-    return 1;
+    return virJSONParserEndContainer(parser);
 }
 
 
@@ -1822,17 +2423,95 @@ static const yajl_callbacks parserCallbacks = {
 };
 
 
-/* XXX add an incremental streaming parser - yajl trivially supports it */
-virJSONValuePtr
-virJSONValueFromString(const char *jsonstring)
+static int
+virJSONParserSetFilters(virJSONParserPtr parser,
+                        const char *const *filters)
 {
-    yajl_handle hand;
-    virJSONParser parser = { NULL, NULL, 0, 0 };
-    virJSONValuePtr ret = NULL;
+    size_t i;
+    size_t j;
+
+    if (!filters)
+        return 0;
+
+    parser->nfilters = virStringListLength(filters);
+    parser->filters = g_new0(char **, parser->nfilters);
+
+    for (i = 0; i < parser->nfilters; i++) {
+        parser->filters[i] = virStringSplit(filters[i], "/", 0);
+
+        for (j = 0; parser->filters[i][j]; j++) {
+            if (!*parser->filters[i][j])
+                break;
+        }
+
+        if (j == 0 || parser->filters[i][j]) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("invalid JSON filter path '%s'"), filters[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Size of the chunks read from a file by virJSONValueFromFile */
+# define VIR_JSON_FILE_CHUNK (64 * 1024)
+
+static int
+virJSONValueParseFD(yajl_handle hand,
+                    int fd,
+                    const char *path,
+                    int *rc)
+{
+    g_autofree unsigned char *buf = g_new0(unsigned char, VIR_JSON_FILE_CHUNK);
+    ssize_t got;
+
+    *rc = yajl_status_ok;
+
+    while ((got = saferead(fd, buf, VIR_JSON_FILE_CHUNK)) > 0) {
+        if ((*rc = yajl_parse(hand, buf, got)) != yajl_status_ok)
+            return 0;
+    }
+
+    if (got < 0) {
+        virReportSystemError(errno, _("cannot read JSON document %s"), path);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Parses @jsonstring, or if it is NULL the file @path open as @fd */
+static int
+virJSONValueParse(const char *jsonstring,
+                  int fd,
+                  const char *path,
+                  const char *const *filters,
+                  bool arena,
+                  virJSONValueStreamCallback cb,
+                  void *opaque,
+                  virJSONValuePtr *result)
+{
+    yajl_handle hand = NULL;
+    virJSONParser parser = { 0 };
+    int ret = -1;
     int rc;
-    size_t len = strlen(jsonstring);
+    size_t i;
+
+    if (jsonstring)
+        VIR_DEBUG("string=%s", jsonstring);
+    else
+        VIR_DEBUG("path=%s", path);
 
-    VIR_DEBUG("string=%s", jsonstring);
+    parser.cb = cb;
+    parser.opaque = opaque;
+    if (arena)
+        parser.arena = virJSONArenaNew();
+
+    if (virJSONParserSetFilters(&parser, filters) < 0)
+        goto cleanup;
 
     hand = yajl_alloc(&parserCallbacks, NULL, &parser);
     if (!hand) {
@@ -1842,40 +2521,206 @@ virJSONValueFromString(const char *jsonstring)
     }
 
     /* Yajl 2 is nice enough to default to rejecting trailing garbage. */
-    rc = yajl_parse(hand, (const unsigned char *)jsonstring, len);
+    if (jsonstring) {
+        rc = yajl_parse(hand, (const unsigned char *)jsonstring,
+                        strlen(jsonstring));
+    } else if (virJSONValueParseFD(hand, fd, path, &rc) < 0) {
+        goto cleanup;
+    }
+
     if (rc != yajl_status_ok ||
         yajl_complete_parse(hand) != yajl_status_ok) {
-        unsigned char *errstr = yajl_get_error(hand, 1,
-                                               (const unsigned char*)jsonstring,
-                                               strlen(jsonstring));
+        unsigned char *errstr;
 
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("cannot parse json %s: %s"),
-                       jsonstring, (const char*) errstr);
+        /* the callback reported its own error */
+        if (parser.cbfailed)
+            goto cleanup;
+
+        if (jsonstring) {
+            errstr = yajl_get_error(hand, 1,
+                                    (const unsigned char*)jsonstring,
+                                    strlen(jsonstring));
+
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("cannot parse json %s: %s"),
+                           jsonstring, (const char*) errstr);
+        } else {
+            errstr = yajl_get_error(hand, 0, NULL, 0);
+
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("cannot parse json document %s: %s"),
+                           path, (const char*) errstr);
+        }
         yajl_free_error(hand, errstr);
-        virJSONValueFree(parser.head);
         goto cleanup;
     }
 
     if (parser.nstate != 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("cannot parse json %s: unterminated string/map/array"),
-                       jsonstring);
-        virJSONValueFree(parser.head);
-    } else {
-        ret = parser.head;
+                       jsonstring ? jsonstring : path);
+        goto cleanup;
     }
 
+    if (result) {
+        /* the parsed tree holds its own reference of the arena */
+        if (parser.arena && parser.head)
+            virJSONArenaRef(parser.arena);
+        *result = g_steal_pointer(&parser.head);
+    }
+    ret = 0;
+
  cleanup:
-    yajl_free(hand);
+    if (hand)
+        yajl_free(hand);
+
+    for (i = 0; i < parser.nstate; i++)
+        virJSONParserStateClear(&parser, &parser.state[i]);
+    VIR_FREE(parser.state);
+
+    if (parser.arena)
+        virJSONArenaUnref(parser.arena);
+    else
+        virJSONValueFree(parser.head);
+
+    for (i = 0; i < parser.nfilters; i++)
+        virStringListFree(parser.filters[i]);
+    VIR_FREE(parser.filters);
+
+    return ret;
+}
+
+
+virJSONValuePtr
+virJSONValueFromString(const char *jsonstring)
+{
+    virJSONValuePtr ret = NULL;
+
+    ignore_value(virJSONValueParse(jsonstring, -1, NULL, NULL, false,
+                                   NULL, NULL, &ret));
+
+    VIR_DEBUG("result=%p", ret);
+
+    return ret;
+}
+
+
+/**
+ * virJSONValueFromStringFiltered:
+ * @jsonstring: JSON document to parse
+ * @filters: NULL terminated list of paths of the values to keep
+ *
+ * Parses @jsonstring like virJSONValueFromString but materializes only
+ * the values addressed by @filters along with the containers leading to
+ * them. Paths are made of object keys and array indexes separated by '/';
+ * the '*' component matches any key or index. E.g. the path made of
+ * "return", "*" and "device" keeps just the "device" member of the objects
+ * in the "return" array. A matched value is kept including all of its
+ * children.
+ *
+ * If @filters is NULL the whole document is kept.
+ *
+ * Returns the parsed (partial) document or NULL on error.
+ */
+virJSONValuePtr
+virJSONValueFromStringFiltered(const char *jsonstring,
+                               const char *const *filters)
+{
+    virJSONValuePtr ret = NULL;
+
+    ignore_value(virJSONValueParse(jsonstring, -1, NULL, filters, false,
+                                   NULL, NULL, &ret));
+
+    VIR_DEBUG("result=%p", ret);
 
-    if (parser.nstate) {
-        size_t i;
-        for (i = 0; i < parser.nstate; i++)
-            VIR_FREE(parser.state[i].key);
-        VIR_FREE(parser.state);
+    return ret;
+}
+
+
+/**
+ * virJSONValueFromStringArena:
+ * @jsonstring: JSON document to parse
+ * @filters: optional NULL terminated list of paths of the values to keep
+ *
+ * Parses @jsonstring like virJSONValueFromStringFiltered, but all the
+ * values, keys and strings of the resulting tree are carved out of a few
+ * large chunks of memory which are released at once when the tree and all
+ * of the subtrees stolen from it are freed by virJSONValueFree. The tree
+ * can be used and modified as any other, this is meant for large documents
+ * such as replies from the qemu monitor which are parsed, inspected and
+ * thrown away.
+ *
+ * Returns the parsed document or NULL on error.
+ */
+virJSONValuePtr
+virJSONValueFromStringArena(const char *jsonstring,
+                            const char *const *filters)
+{
+    virJSONValuePtr ret = NULL;
+
+    ignore_value(virJSONValueParse(jsonstring, -1, NULL, filters, true,
+                                   NULL, NULL, &ret));
+
+    VIR_DEBUG("result=%p", ret);
+
+    return ret;
+}
+
+
+/**
+ * virJSONValueStreamParse:
+ * @jsonstring: JSON document to parse
+ * @filters: NULL terminated list of paths of the values to report
+ * @cb: callback invoked for every matched value
+ * @opaque: opaque data passed to @cb
+ *
+ * Parses @jsonstring without building the full tree of the document.
+ * Once a value matching one of @filters (see virJSONValueFromStringFiltered
+ * for the syntax) is parsed completely, @cb is invoked with the concrete
+ * path of the value and the value itself. The value is freed once @cb
+ * returns, it may be copied or its members stolen by @cb. If @filters
+ * is NULL, @cb is invoked once for the whole document with an empty path.
+ *
+ * Parsing is stopped if @cb returns a negative value; @cb is then
+ * expected to report an error.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virJSONValueStreamParse(const char *jsonstring,
+                        const char *const *filters,
+                        virJSONValueStreamCallback cb,
+                        void *opaque)
+{
+    return virJSONValueParse(jsonstring, -1, NULL, filters, false,
+                             cb, opaque, NULL);
+}
+
+
+/**
+ * virJSONValueFromFile:
+ * @path: file containing a JSON document
+ *
+ * Parses the document in @path like virJSONValueFromString, but reads
+ * and parses it in chunks, so that large documents are never held in
+ * memory as a whole besides the resulting tree.
+ *
+ * Returns the parsed document or NULL on error.
+ */
+virJSONValuePtr
+virJSONValueFromFile(const char *path)
+{
+    virJSONValuePtr ret = NULL;
+    VIR_AUTOCLOSE fd = -1;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        virReportSystemError(errno, _("cannot open JSON document %s"), path);
+        return NULL;
     }
 
+    ignore_value(virJSONValueParse(NULL, fd, path, NULL, false,
+                                   NULL, NULL, &ret));
+
     VIR_DEBUG("result=%p", ret);
 
     return ret;
@@ -1947,6 +2792,25 @@ virJSONValueToStringOne(virJSONValuePtr object,
 }
 
 
+static yajl_gen
+virJSONValueGenNew(bool pretty)
+{
+    yajl_gen g;
+
+    if (!(g = yajl_gen_alloc(NULL))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to create JSON formatter"));
+        return NULL;
+    }
+
+    yajl_gen_config(g, yajl_gen_beautify, pretty ? 1 : 0);
+    yajl_gen_config(g, yajl_gen_indent_string, pretty ? "  " : " ");
+    yajl_gen_config(g, yajl_gen_validate_utf8, 1);
+
+    return g;
+}
+
+
 int
 virJSONValueToBuffer(virJSONValuePtr object,
                      virBufferPtr buf,
@@ -1959,15 +2823,8 @@ virJSONValueToBuffer(virJSONValuePtr object,
 
     VIR_DEBUG("object=%p", object);
 
-    g = yajl_gen_alloc(NULL);
-    if (!g) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Unable to create JSON formatter"));
+    if (!(g = virJSONValueGenNew(pretty)))
         goto cleanup;
-    }
-    yajl_gen_config(g, yajl_gen_beautify, pretty ? 1 : 0);
-    yajl_gen_config(g, yajl_gen_indent_string, pretty ? "  " : " ");
-    yajl_gen_config(g, yajl_gen_validate_utf8, 1);
 
     if (virJSONValueToStringOne(object, g) < 0) {
         virReportOOMError();
@@ -1983,7 +2840,108 @@ virJSONValueToBuffer(virJSONValuePtr object,
     ret = 0;
 
  cleanup:
-    yajl_gen_free(g);
+    if (g)
+        yajl_gen_free(g);
+
+    return ret;
+}
+
+
+typedef struct _virJSONFileWriter virJSONFileWriter;
+struct _virJSONFileWriter {
+    int fd;
+    int err;
+    size_t len;
+    char buf[VIR_JSON_FILE_CHUNK];
+};
+
+
+static int
+virJSONFileWriterFlush(virJSONFileWriter *w)
+{
+    if (w->err == 0 && w->len > 0 &&
+        safewrite(w->fd, w->buf, w->len) < 0)
+        w->err = errno;
+
+    w->len = 0;
+    return w->err == 0 ? 0 : -1;
+}
+
+
+static void
+virJSONFileWriterPrint(void *ctx,
+                       const char *str,
+                       size_t len)
+{
+    virJSONFileWriter *w = ctx;
+
+    if (w->len + len > sizeof(w->buf) &&
+        virJSONFileWriterFlush(w) < 0)
+        return;
+
+    if (len > sizeof(w->buf)) {
+        if (safewrite(w->fd, str, len) < 0)
+            w->err = errno;
+        return;
+    }
+
+    memcpy(w->buf + w->len, str, len);
+    w->len += len;
+}
+
+
+/**
+ * virJSONValueToFile:
+ * @object: JSON document to write
+ * @path: file to write it to
+ * @mode: permissions of the file if it is created
+ * @pretty: use the pretty formatter
+ *
+ * Formats @object into @path as it goes, rather than formatting the
+ * whole document into memory first like virJSONValueToString.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virJSONValueToFile(virJSONValuePtr object,
+                   const char *path,
+                   mode_t mode,
+                   bool pretty)
+{
+    g_autofree virJSONFileWriter *w = g_new0(virJSONFileWriter, 1);
+    yajl_gen g = NULL;
+    int ret = -1;
+
+    VIR_DEBUG("object=%p path=%s", object, path);
+
+    if ((w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, mode)) < 0) {
+        virReportSystemError(errno, _("cannot create JSON document %s"), path);
+        return -1;
+    }
+
+    if (!(g = virJSONValueGenNew(pretty)))
+        goto cleanup;
+
+    yajl_gen_config(g, yajl_gen_print_callback, virJSONFileWriterPrint, w);
+
+    if (virJSONValueToStringOne(object, g) < 0) {
+        virReportOOMError();
+        goto cleanup;
+    }
+
+    if (virJSONFileWriterFlush(w) < 0 ||
+        VIR_CLOSE(w->fd) < 0) {
+        virReportSystemError(w->err ? w->err : errno,
+                             _("cannot write JSON document %s"), path);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    if (g)
+        yajl_gen_free(g);
+    VIR_FORCE_CLOSE(w->fd);
 
     return ret;
 }
@@ -1999,6 +2957,47 @@ virJSONValueFromString(const char *jsonstring G_GNUC_UNUSED)
 }
 
 
+virJSONValuePtr
+virJSONValueFromStringFiltered(const char *jsonstring G_GNUC_UNUSED,
+                               const char *const *filters G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("No JSON parser implementation is available"));
+    return NULL;
+}
+
+
+virJSONValuePtr
+virJSONValueFromStringArena(const char *jsonstring G_GNUC_UNUSED,
+                            const char *const *filters G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("No JSON parser implementation is available"));
+    return NULL;
+}
+
+
+int
+virJSONValueStreamParse(const char *jsonstring G_GNUC_UNUSED,
+                        const char *const *filters G_GNUC_UNUSED,
+                        virJSONValueStreamCallback cb G_GNUC_UNUSED,
+                        void *opaque G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("No JSON parser implementation is available"));
+    return -1;
+}
+
+
+virJSONValuePtr
+virJSONValueFromFile(const char *path G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("No JSON parser implementation is available"));
+    return NULL;
+}
+
+
 int
 virJSONValueToBuffer(virJSONValuePtr object G_GNUC_UNUSED,
                      virBufferPtr buf G_GNUC_UNUSED,
@@ -2008,6 +3007,18 @@ virJSONValueToBuffer(virJSONValuePtr object G_GNUC_UNUSED,
                    _("No JSON parser implementation is available"));
     return -1;
 }
+
+
+int
+virJSONValueToFile(virJSONValuePtr object G_GNUC_UNUSED,
+                   const char *path G_GNUC_UNUSED,
+                   mode_t mode G_GNUC_UNUSED,
+                   bool pretty G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("No JSON parser implementation is available"));
+    return -1;
+}
 #endif
 
 
@@ -2145,7 +3156,8 @@ virJSONValueObjectDeflattenArrays(virJSONValuePtr json)
     size_t i;
 
     if (!json ||
-        json->type != VIR_JSON_TYPE_OBJECT)
+        json->type != VIR_JSON_TYPE_OBJECT ||
+        json->arena)
         return;
 
     obj = &json->data.object;
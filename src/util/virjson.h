@@ -143,12 +143,33 @@ int virJSONValueObjectRemoveKey(virJSONValuePtr object, const char *key,
 int virJSONValueArrayAppendString(virJSONValuePtr object, const char *value);
 
 virJSONValuePtr virJSONValueFromString(const char *jsonstring);
+virJSONValuePtr virJSONValueFromStringFiltered(const char *jsonstring,
+                                               const char *const *filters);
+virJSONValuePtr virJSONValueFromStringArena(const char *jsonstring,
+                                            const char *const *filters);
+
+typedef int (*virJSONValueStreamCallback)(const char *path,
+                                          virJSONValuePtr value,
+                                          void *opaque);
+
+int virJSONValueStreamParse(const char *jsonstring,
+                            const char *const *filters,
+                            virJSONValueStreamCallback cb,
+                            void *opaque)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(3);
+virJSONValuePtr virJSONValueFromFile(const char *path)
+    ATTRIBUTE_NONNULL(1);
 char *virJSONValueToString(virJSONValuePtr object,
                            bool pretty);
 int virJSONValueToBuffer(virJSONValuePtr object,
                          virBufferPtr buf,
                          bool pretty)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) G_GNUC_WARN_UNUSED_RESULT;
+int virJSONValueToFile(virJSONValuePtr object,
+                       const char *path,
+                       mode_t mode,
+                       bool pretty)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) G_GNUC_WARN_UNUSED_RESULT;
 
 typedef int (*virJSONValueObjectIteratorFunc)(const char *key,
                                               virJSONValuePtr value,
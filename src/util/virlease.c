@@ -23,7 +23,10 @@
 #include <config.h>
 
 #include "virlease.h"
+#include "virleaseindex.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <time.h>
 
 #include "virfile.h"
@@ -31,9 +34,12 @@
 #include "virerror.h"
 #include "viralloc.h"
 #include "virutil.h"
+#include "virlog.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
 
+VIR_LOG_INIT("util.lease");
+
 /**
  * VIR_NETWORK_DHCP_LEASE_FILE_SIZE_MAX:
  *
@@ -131,6 +137,319 @@ virLeaseReadCustomLeaseFile(virJSONValuePtr leases_array_new,
 }
 
 
+/**
+ * virLeaseJournalFileName:
+ * @custom_lease_file: path to the custom leases file
+ *
+ * Renewed leases are appended to a journal next to the custom leases
+ * file instead of rewriting the whole file each time. Each line of the
+ * journal is a JSON array holding a single lease, in the same format
+ * the custom leases file uses, so that it can also be read as a
+ * sequence of arrays of leases. Within leases for the same IP address
+ * the latest one counts.
+ *
+ * Returns the path to the journal belonging to @custom_lease_file.
+ */
+char *
+virLeaseJournalFileName(const char *custom_lease_file)
+{
+    return g_strdup_printf("%s.journal", custom_lease_file);
+}
+
+
+/**
+ * virLeaseReadJournal:
+ * @leases_array: leases read from the custom leases file
+ * @journal_file: path to the journal
+ * @ip_to_delete: IP address to ignore leases for, or NULL
+ *
+ * Applies the leases recorded in @journal_file on top of @leases_array,
+ * replacing the leases of the same IP address. A missing journal is
+ * not an error, neither are lines which can't be parsed, as the last
+ * one might be just being written.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virLeaseReadJournal(virJSONValuePtr leases_array,
+                    const char *journal_file,
+                    const char *ip_to_delete)
+{
+    g_autofree char *journal = NULL;
+    VIR_AUTOSTRINGLIST lines = NULL;
+    size_t i;
+
+    if (virFileReadAllQuiet(journal_file,
+                            VIR_NETWORK_DHCP_LEASE_FILE_SIZE_MAX,
+                            &journal) < 0) {
+        if (errno == ENOENT)
+            return 0;
+
+        virReportSystemError(errno,
+                             _("Unable to read leases journal: %s"),
+                             journal_file);
+        return -1;
+    }
+
+    if (!(lines = virStringSplit(journal, "\n", 0)))
+        return -1;
+
+    for (i = 0; lines[i]; i++) {
+        g_autoptr(virJSONValue) record = NULL;
+        virJSONValuePtr lease;
+        const char *ip;
+        size_t j;
+
+        if (!*lines[i])
+            continue;
+
+        if (!(record = virJSONValueFromString(lines[i])) ||
+            !virJSONValueIsArray(record) ||
+            virJSONValueArraySize(record) != 1 ||
+            !(ip = virJSONValueObjectGetString(virJSONValueArrayGet(record, 0),
+                                               "ip-address"))) {
+            VIR_WARN("Ignoring malformed record in leases journal %s",
+                     journal_file);
+            virResetLastError();
+            continue;
+        }
+
+        if (ip_to_delete && STREQ(ip, ip_to_delete))
+            continue;
+
+        j = 0;
+        while (j < virJSONValueArraySize(leases_array)) {
+            virJSONValuePtr old = virJSONValueArrayGet(leases_array, j);
+
+            if (STREQ_NULLABLE(virJSONValueObjectGetString(old, "ip-address"),
+                               ip)) {
+                virJSONValueFree(virJSONValueArraySteal(leases_array, j));
+                continue;
+            }
+            j++;
+        }
+
+        lease = virJSONValueArraySteal(record, 0);
+        if (virJSONValueArrayAppend(leases_array, lease) < 0) {
+            virJSONValueFree(lease);
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("failed to create json"));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * virLeaseAppendJournal:
+ * @journal_file: path to the journal
+ * @lease: lease to record
+ * @journal_size: filled with the size of the journal
+ *
+ * Appends @lease to the journal, see virLeaseJournalFileName.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virLeaseAppendJournal(const char *journal_file,
+                      virJSONValuePtr lease,
+                      off_t *journal_size)
+{
+    g_autoptr(virJSONValue) record = virJSONValueNewArray();
+    g_autofree char *str = NULL;
+    g_autofree char *line = NULL;
+    VIR_AUTOCLOSE fd = -1;
+    struct stat sb;
+
+    if (!(lease = virJSONValueCopy(lease)) ||
+        virJSONValueArrayAppend(record, lease) < 0) {
+        virJSONValueFree(lease);
+        return -1;
+    }
+
+    if (!(str = virJSONValueToString(record, false)))
+        return -1;
+    line = g_strdup_printf("%s\n", str);
+
+    if ((fd = open(journal_file, O_WRONLY | O_APPEND | O_CREAT, 0644)) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to open leases journal: %s"),
+                             journal_file);
+        return -1;
+    }
+
+    /* A single write, so that readers never see a record half written
+     * unless they manage to read in the middle of it */
+    if (safewrite(fd, line, strlen(line)) < 0 ||
+        fstat(fd, &sb) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to write leases journal: %s"),
+                             journal_file);
+        return -1;
+    }
+
+    if (VIR_CLOSE(fd) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to close leases journal: %s"),
+                             journal_file);
+        return -1;
+    }
+
+    *journal_size = sb.st_size;
+    return 0;
+}
+
+
+/**
+ * virLeaseIndexFileName:
+ * @custom_lease_file: path to the custom leases file
+ *
+ * Returns the path to the index of @custom_lease_file, see
+ * virleaseindex.h for its format.
+ */
+char *
+virLeaseIndexFileName(const char *custom_lease_file)
+{
+    return g_strdup_printf("%s.index", custom_lease_file);
+}
+
+
+typedef struct _virLeaseIndexBuilder virLeaseIndexBuilder;
+struct _virLeaseIndexBuilder {
+    const char *hostname;
+    const char *ipaddr;
+    long long expiry;
+};
+
+
+static int
+virLeaseIndexBuilderCompare(const void *a,
+                            const void *b)
+{
+    const virLeaseIndexBuilder *ea = a;
+    const virLeaseIndexBuilder *eb = b;
+
+    return strcmp(ea->hostname, eb->hostname);
+}
+
+
+typedef struct _virLeaseIndexData virLeaseIndexData;
+struct _virLeaseIndexData {
+    const char *buf;
+    size_t len;
+};
+
+
+static int
+virLeaseWriteIndexHelper(int fd,
+                         const void *opaque)
+{
+    const virLeaseIndexData *data = opaque;
+
+    if (safewrite(fd, data->buf, data->len) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * virLeaseWriteIndex:
+ * @leases_array: leases just written to @custom_lease_file
+ * @custom_lease_file: path to the custom leases file
+ *
+ * Builds the index of the leases in @leases_array with a hostname and
+ * writes it next to @custom_lease_file, which has to be written already
+ * as the index records its identity.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virLeaseWriteIndex(virJSONValuePtr leases_array,
+                   const char *custom_lease_file)
+{
+    g_autofree char *index_file = virLeaseIndexFileName(custom_lease_file);
+    g_autofree virLeaseIndexBuilder *leases = NULL;
+    g_autofree char *buf = NULL;
+    virLeaseIndexHeader header;
+    virLeaseIndexEntryPtr entries;
+    virLeaseIndexData data;
+    char *table;
+    size_t nleases = 0;
+    size_t strings = 0;
+    size_t off;
+    size_t i;
+    struct stat sb;
+
+    if (VIR_ALLOC_N(leases, virJSONValueArraySize(leases_array)) < 0)
+        return -1;
+
+    for (i = 0; i < virJSONValueArraySize(leases_array); i++) {
+        virJSONValuePtr lease = virJSONValueArrayGet(leases_array, i);
+        virLeaseIndexBuilder *ent = &leases[nleases];
+
+        if (!(ent->hostname = virJSONValueObjectGetString(lease, "hostname")) ||
+            !(ent->ipaddr = virJSONValueObjectGetString(lease, "ip-address")))
+            continue;
+
+        if (virJSONValueObjectGetNumberLong(lease, "expiry-time",
+                                            &ent->expiry) < 0)
+            ent->expiry = 0;
+
+        strings += strlen(ent->hostname) + 1 + strlen(ent->ipaddr) + 1;
+        nleases++;
+    }
+
+    if (strings > UINT32_MAX) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("too many leases to index"));
+        return -1;
+    }
+
+    qsort(leases, nleases, sizeof(*leases), virLeaseIndexBuilderCompare);
+
+    if (stat(custom_lease_file, &sb) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to stat leases file: %s"),
+                             custom_lease_file);
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VIR_LEASE_INDEX_MAGIC, sizeof(header.magic));
+    header.nentries = nleases;
+    header.strings = strings;
+    header.leasesIno = sb.st_ino;
+    header.leasesSize = sb.st_size;
+    header.leasesMtime = sb.st_mtime;
+
+    data.len = sizeof(header) + nleases * sizeof(*entries) + strings;
+    if (VIR_ALLOC_N(buf, data.len) < 0)
+        return -1;
+
+    memcpy(buf, &header, sizeof(header));
+    entries = (virLeaseIndexEntryPtr) (buf + sizeof(header));
+    table = (char *) (entries + nleases);
+    off = 0;
+
+    for (i = 0; i < nleases; i++) {
+        entries[i].hostname = off;
+        off += g_strlcpy(table + off, leases[i].hostname, strings - off) + 1;
+        entries[i].ipaddr = off;
+        off += g_strlcpy(table + off, leases[i].ipaddr, strings - off) + 1;
+        entries[i].expiry = leases[i].expiry;
+    }
+
+    data.buf = buf;
+    if (virFileRewrite(index_file, 0644, virLeaseWriteIndexHelper, &data) < 0)
+        return -1;
+
+    return 0;
+}
+
+
 int
 virLeasePrintLeases(virJSONValuePtr leases_array_new,
                     const char *server_duid)
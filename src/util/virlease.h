@@ -32,6 +32,29 @@ int virLeaseReadCustomLeaseFile(virJSONValuePtr leases_array_new,
 int virLeasePrintLeases(virJSONValuePtr leases_array_new,
                         const char *server_duid);
 
+/**
+ * VIR_LEASE_JOURNAL_SIZE_MAX:
+ *
+ * Size the journal of lease renewals may grow to before it is merged
+ * into the custom leases file
+ */
+#define VIR_LEASE_JOURNAL_SIZE_MAX (64 * 1024)
+
+char *virLeaseJournalFileName(const char *custom_lease_file);
+
+int virLeaseReadJournal(virJSONValuePtr leases_array,
+                        const char *journal_file,
+                        const char *ip_to_delete);
+
+int virLeaseAppendJournal(const char *journal_file,
+                          virJSONValuePtr lease,
+                          off_t *journal_size);
+
+char *virLeaseIndexFileName(const char *custom_lease_file);
+
+int virLeaseWriteIndex(virJSONValuePtr leases_array,
+                       const char *custom_lease_file);
+
 
 int virLeaseNew(virJSONValuePtr *lease_ret,
                 const char *mac,
@@ -0,0 +1,58 @@
+/*
+ * virleaseindex.h: on-disk format of the index of leases files
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+/* This header is shared with the NSS module, which doesn't link with
+ * the rest of libvirt, so it must not pull in anything but system
+ * headers. */
+#include <stdint.h>
+
+/*
+ * The index sits next to the custom leases file, see
+ * virLeaseIndexFileName, and lets the leases of a hostname be found by
+ * binary search without parsing the JSON. It is only ever written on
+ * the host it is read on, so all the numbers are in host byte order.
+ *
+ * The file consists of a header, an array of @nentries entries sorted
+ * by hostname and a table of NUL terminated strings the entries point
+ * into. The header records the identity of the leases file the index
+ * was built from; if it doesn't match anymore, the index is stale and
+ * readers have to fall back to parsing the leases file.
+ */
+#define VIR_LEASE_INDEX_MAGIC "LVLIDX01"
+
+typedef struct _virLeaseIndexHeader virLeaseIndexHeader;
+typedef virLeaseIndexHeader *virLeaseIndexHeaderPtr;
+struct _virLeaseIndexHeader {
+    char magic[8];          /* VIR_LEASE_INDEX_MAGIC, not NUL terminated */
+    uint32_t nentries;
+    uint32_t strings;       /* size of the string table */
+    uint64_t leasesIno;     /* st_ino of the indexed leases file */
+    uint64_t leasesSize;    /* st_size of the indexed leases file */
+    int64_t leasesMtime;    /* st_mtime of the indexed leases file */
+};
+
+typedef struct _virLeaseIndexEntry virLeaseIndexEntry;
+typedef virLeaseIndexEntry *virLeaseIndexEntryPtr;
+struct _virLeaseIndexEntry {
+    uint32_t hostname;      /* offsets into the string table */
+    uint32_t ipaddr;
+    int64_t expiry;
+};
@@ -28,6 +28,7 @@
 #include "virutil.h"
 #include "virfile.h"
 #include "virhash.h"
+#include "virhashcode.h"
 #include "virthread.h"
 #include "virstring.h"
 
@@ -40,6 +41,7 @@
 VIR_LOG_INIT("util.lockspace");
 
 #define VIR_LOCKSPACE_TABLE_SIZE 10
+#define VIR_LOCKSPACE_SHARDS 16
 
 typedef struct _virLockSpaceResource virLockSpaceResource;
 typedef virLockSpaceResource *virLockSpaceResourcePtr;
@@ -54,14 +56,34 @@ struct _virLockSpaceResource {
     pid_t *owners;
 };
 
+typedef struct _virLockSpaceShard virLockSpaceShard;
+typedef virLockSpaceShard *virLockSpaceShardPtr;
+
+struct _virLockSpaceShard {
+    virMutex lock;
+    virHashTablePtr resources;
+};
+
 struct _virLockSpace {
     char *dir;
-    virMutex lock;
 
-    virHashTablePtr resources;
+    /* Resources are spread over the shards by the hash of their
+     * name, so that requests for distinct resources, like the disks
+     * of guests started in parallel, rarely contend on a mutex */
+    virLockSpaceShard shards[VIR_LOCKSPACE_SHARDS];
 };
 
 
+static virLockSpaceShardPtr
+virLockSpaceGetShard(virLockSpacePtr lockspace,
+                     const char *resname)
+{
+    uint32_t hash = virHashCodeGen(resname, strlen(resname), 0);
+
+    return &lockspace->shards[hash % VIR_LOCKSPACE_SHARDS];
+}
+
+
 static char *virLockSpaceGetResourcePath(virLockSpacePtr lockspace,
                                          const char *resname)
 {
@@ -235,6 +257,53 @@ static void virLockSpaceResourceDataFree(void *opaque)
 }
 
 
+/* Shards are always locked in index order */
+static void
+virLockSpaceLockShards(virLockSpacePtr lockspace)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_LOCKSPACE_SHARDS; i++)
+        virMutexLock(&lockspace->shards[i].lock);
+}
+
+
+static void
+virLockSpaceUnlockShards(virLockSpacePtr lockspace)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_LOCKSPACE_SHARDS; i++)
+        virMutexUnlock(&lockspace->shards[i].lock);
+}
+
+
+static int
+virLockSpaceInitShards(virLockSpacePtr lockspace)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_LOCKSPACE_SHARDS; i++) {
+        virLockSpaceShardPtr shard = &lockspace->shards[i];
+
+        if (virMutexInit(&shard->lock) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Unable to initialize lockspace mutex"));
+            return -1;
+        }
+
+        /* Only set once the mutex is initialized, see virLockSpaceFree */
+        if (!(shard->resources = virHashCreate(VIR_LOCKSPACE_TABLE_SIZE,
+                                               virLockSpaceResourceDataFree))) {
+            virMutexDestroy(&shard->lock);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
 virLockSpacePtr virLockSpaceNew(const char *directory)
 {
     virLockSpacePtr lockspace;
@@ -244,17 +313,9 @@ virLockSpacePtr virLockSpaceNew(const char *directory)
     if (VIR_ALLOC(lockspace) < 0)
         return NULL;
 
-    if (virMutexInit(&lockspace->lock) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Unable to initialize lockspace mutex"));
-        VIR_FREE(lockspace);
-        return NULL;
-    }
-
     lockspace->dir = g_strdup(directory);
 
-    if (!(lockspace->resources = virHashCreate(VIR_LOCKSPACE_TABLE_SIZE,
-                                               virLockSpaceResourceDataFree)))
+    if (virLockSpaceInitShards(lockspace) < 0)
         goto error;
 
     if (directory) {
@@ -295,15 +356,7 @@ virLockSpacePtr virLockSpaceNewPostExecRestart(virJSONValuePtr object)
     if (VIR_ALLOC(lockspace) < 0)
         return NULL;
 
-    if (virMutexInit(&lockspace->lock) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Unable to initialize lockspace mutex"));
-        VIR_FREE(lockspace);
-        return NULL;
-    }
-
-    if (!(lockspace->resources = virHashCreate(VIR_LOCKSPACE_TABLE_SIZE,
-                                               virLockSpaceResourceDataFree)))
+    if (virLockSpaceInitShards(lockspace) < 0)
         goto error;
 
     if (virJSONValueObjectHasKey(object, "directory")) {
@@ -411,7 +464,8 @@ virLockSpacePtr virLockSpaceNewPostExecRestart(virJSONValuePtr object)
             res->owners[j] = (pid_t)owner;
         }
 
-        if (virHashAddEntry(lockspace->resources, res->name, res) < 0) {
+        if (virHashAddEntry(virLockSpaceGetShard(lockspace, res->name)->resources,
+                            res->name, res) < 0) {
             virLockSpaceResourceFree(res);
             goto error;
         }
@@ -430,8 +484,9 @@ virJSONValuePtr virLockSpacePreExecRestart(virLockSpacePtr lockspace)
     virJSONValuePtr object = virJSONValueNewObject();
     virJSONValuePtr resources;
     virHashKeyValuePairPtr pairs = NULL, tmp;
+    size_t i;
 
-    virMutexLock(&lockspace->lock);
+    virLockSpaceLockShards(lockspace);
 
     if (lockspace->dir &&
         virJSONValueObjectAppendString(object, "directory", lockspace->dir) < 0)
@@ -444,72 +499,83 @@ virJSONValuePtr virLockSpacePreExecRestart(virLockSpacePtr lockspace)
         goto error;
     }
 
-    tmp = pairs = virHashGetItems(lockspace->resources, NULL);
-    while (tmp && tmp->value) {
-        virLockSpaceResourcePtr res = (virLockSpaceResourcePtr)tmp->value;
-        virJSONValuePtr child = virJSONValueNewObject();
-        virJSONValuePtr owners = NULL;
-        size_t i;
+    for (i = 0; i < VIR_LOCKSPACE_SHARDS; i++) {
+        tmp = pairs = virHashGetItems(lockspace->shards[i].resources, NULL);
+        while (tmp && tmp->value) {
+            virLockSpaceResourcePtr res = (virLockSpaceResourcePtr)tmp->value;
+            virJSONValuePtr child = virJSONValueNewObject();
+            virJSONValuePtr owners = NULL;
+            size_t j;
 
-        if (virJSONValueArrayAppend(resources, child) < 0) {
-            virJSONValueFree(child);
-            goto error;
-        }
-
-        if (virJSONValueObjectAppendString(child, "name", res->name) < 0 ||
-            virJSONValueObjectAppendString(child, "path", res->path) < 0 ||
-            virJSONValueObjectAppendNumberInt(child, "fd", res->fd) < 0 ||
-            virJSONValueObjectAppendBoolean(child, "lockHeld", res->lockHeld) < 0 ||
-            virJSONValueObjectAppendNumberUint(child, "flags", res->flags) < 0)
-            goto error;
+            if (virJSONValueArrayAppend(resources, child) < 0) {
+                virJSONValueFree(child);
+                goto error;
+            }
 
-        if (virSetInherit(res->fd, true) < 0) {
-            virReportSystemError(errno, "%s",
-                                 _("Cannot disable close-on-exec flag"));
-            goto error;
-        }
+            if (virJSONValueObjectAppendString(child, "name", res->name) < 0 ||
+                virJSONValueObjectAppendString(child, "path", res->path) < 0 ||
+                virJSONValueObjectAppendNumberInt(child, "fd", res->fd) < 0 ||
+                virJSONValueObjectAppendBoolean(child, "lockHeld", res->lockHeld) < 0 ||
+                virJSONValueObjectAppendNumberUint(child, "flags", res->flags) < 0)
+                goto error;
 
-        owners = virJSONValueNewArray();
+            if (virSetInherit(res->fd, true) < 0) {
+                virReportSystemError(errno, "%s",
+                                     _("Cannot disable close-on-exec flag"));
+                goto error;
+            }
 
-        if (virJSONValueObjectAppend(child, "owners", owners) < 0) {
-            virJSONValueFree(owners);
-            goto error;
-        }
+            owners = virJSONValueNewArray();
 
-        for (i = 0; i < res->nOwners; i++) {
-            virJSONValuePtr owner = virJSONValueNewNumberUlong(res->owners[i]);
-            if (!owner)
+            if (virJSONValueObjectAppend(child, "owners", owners) < 0) {
+                virJSONValueFree(owners);
                 goto error;
+            }
 
-            if (virJSONValueArrayAppend(owners, owner) < 0) {
-                virJSONValueFree(owner);
-                goto error;
+            for (j = 0; j < res->nOwners; j++) {
+                virJSONValuePtr owner = virJSONValueNewNumberUlong(res->owners[j]);
+                if (!owner)
+                    goto error;
+
+                if (virJSONValueArrayAppend(owners, owner) < 0) {
+                    virJSONValueFree(owner);
+                    goto error;
+                }
             }
-        }
 
-        tmp++;
+            tmp++;
+        }
+        VIR_FREE(pairs);
     }
-    VIR_FREE(pairs);
 
-    virMutexUnlock(&lockspace->lock);
+    virLockSpaceUnlockShards(lockspace);
     return object;
 
  error:
     VIR_FREE(pairs);
     virJSONValueFree(object);
-    virMutexUnlock(&lockspace->lock);
+    virLockSpaceUnlockShards(lockspace);
     return NULL;
 }
 
 
 void virLockSpaceFree(virLockSpacePtr lockspace)
 {
+    size_t i;
+
     if (!lockspace)
         return;
 
-    virHashFree(lockspace->resources);
+    for (i = 0; i < VIR_LOCKSPACE_SHARDS; i++) {
+        virLockSpaceShardPtr shard = &lockspace->shards[i];
+
+        if (!shard->resources)
+            continue;
+
+        virHashFree(shard->resources);
+        virMutexDestroy(&shard->lock);
+    }
     VIR_FREE(lockspace->dir);
-    virMutexDestroy(&lockspace->lock);
     VIR_FREE(lockspace);
 }
 
@@ -526,11 +592,13 @@ int virLockSpaceCreateResource(virLockSpacePtr lockspace,
     int ret = -1;
     char *respath = NULL;
 
+    virLockSpaceShardPtr shard = virLockSpaceGetShard(lockspace, resname);
+
     VIR_DEBUG("lockspace=%p resname=%s", lockspace, resname);
 
-    virMutexLock(&lockspace->lock);
+    virMutexLock(&shard->lock);
 
-    if (virHashLookup(lockspace->resources, resname) != NULL) {
+    if (virHashLookup(shard->resources, resname) != NULL) {
         virReportError(VIR_ERR_RESOURCE_BUSY,
                        _("Lockspace resource '%s' is locked"),
                        resname);
@@ -546,7 +614,7 @@ int virLockSpaceCreateResource(virLockSpacePtr lockspace,
     ret = 0;
 
  cleanup:
-    virMutexUnlock(&lockspace->lock);
+    virMutexUnlock(&shard->lock);
     VIR_FREE(respath);
     return ret;
 }
@@ -558,11 +626,13 @@ int virLockSpaceDeleteResource(virLockSpacePtr lockspace,
     int ret = -1;
     char *respath = NULL;
 
+    virLockSpaceShardPtr shard = virLockSpaceGetShard(lockspace, resname);
+
     VIR_DEBUG("lockspace=%p resname=%s", lockspace, resname);
 
-    virMutexLock(&lockspace->lock);
+    virMutexLock(&shard->lock);
 
-    if (virHashLookup(lockspace->resources, resname) != NULL) {
+    if (virHashLookup(shard->resources, resname) != NULL) {
         virReportError(VIR_ERR_RESOURCE_BUSY,
                        _("Lockspace resource '%s' is locked"),
                        resname);
@@ -583,7 +653,7 @@ int virLockSpaceDeleteResource(virLockSpacePtr lockspace,
     ret = 0;
 
  cleanup:
-    virMutexUnlock(&lockspace->lock);
+    virMutexUnlock(&shard->lock);
     VIR_FREE(respath);
     return ret;
 }
@@ -597,15 +667,17 @@ int virLockSpaceAcquireResource(virLockSpacePtr lockspace,
     int ret = -1;
     virLockSpaceResourcePtr res;
 
+    virLockSpaceShardPtr shard = virLockSpaceGetShard(lockspace, resname);
+
     VIR_DEBUG("lockspace=%p resname=%s flags=0x%x owner=%lld",
               lockspace, resname, flags, (unsigned long long)owner);
 
     virCheckFlags(VIR_LOCK_SPACE_ACQUIRE_SHARED |
                   VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE, -1);
 
-    virMutexLock(&lockspace->lock);
+    virMutexLock(&shard->lock);
 
-    if ((res = virHashLookup(lockspace->resources, resname))) {
+    if ((res = virHashLookup(shard->resources, resname))) {
         if ((res->flags & VIR_LOCK_SPACE_ACQUIRE_SHARED) &&
             (flags & VIR_LOCK_SPACE_ACQUIRE_SHARED)) {
 
@@ -624,7 +696,7 @@ int virLockSpaceAcquireResource(virLockSpacePtr lockspace,
     if (!(res = virLockSpaceResourceNew(lockspace, resname, flags, owner)))
         goto cleanup;
 
-    if (virHashAddEntry(lockspace->resources, resname, res) < 0) {
+    if (virHashAddEntry(shard->resources, resname, res) < 0) {
         virLockSpaceResourceFree(res);
         goto cleanup;
     }
@@ -633,7 +705,7 @@ int virLockSpaceAcquireResource(virLockSpacePtr lockspace,
     ret = 0;
 
  cleanup:
-    virMutexUnlock(&lockspace->lock);
+    virMutexUnlock(&shard->lock);
     return ret;
 }
 
@@ -646,12 +718,14 @@ int virLockSpaceReleaseResource(virLockSpacePtr lockspace,
     virLockSpaceResourcePtr res;
     size_t i;
 
+    virLockSpaceShardPtr shard = virLockSpaceGetShard(lockspace, resname);
+
     VIR_DEBUG("lockspace=%p resname=%s owner=%lld",
               lockspace, resname, (unsigned long long)owner);
 
-    virMutexLock(&lockspace->lock);
+    virMutexLock(&shard->lock);
 
-    if (!(res = virHashLookup(lockspace->resources, resname))) {
+    if (!(res = virHashLookup(shard->resources, resname))) {
         virReportError(VIR_ERR_RESOURCE_BUSY,
                        _("Lockspace resource '%s' is not locked"),
                        resname);
@@ -673,13 +747,13 @@ int virLockSpaceReleaseResource(virLockSpacePtr lockspace,
     VIR_DELETE_ELEMENT(res->owners, i, res->nOwners);
 
     if ((res->nOwners == 0) &&
-        virHashRemoveEntry(lockspace->resources, resname) < 0)
+        virHashRemoveEntry(shard->resources, resname) < 0)
         goto cleanup;
 
     ret = 0;
 
  cleanup:
-    virMutexUnlock(&lockspace->lock);
+    virMutexUnlock(&shard->lock);
     return ret;
 }
 
@@ -726,26 +800,26 @@ virLockSpaceRemoveResourcesForOwner(const void *payload,
 int virLockSpaceReleaseResourcesForOwner(virLockSpacePtr lockspace,
                                          pid_t owner)
 {
-    int ret = 0;
     struct virLockSpaceRemoveData data = {
         owner, 0
     };
+    size_t i;
 
     VIR_DEBUG("lockspace=%p owner=%lld", lockspace, (unsigned long long)owner);
 
-    virMutexLock(&lockspace->lock);
+    for (i = 0; i < VIR_LOCKSPACE_SHARDS; i++) {
+        virLockSpaceShardPtr shard = &lockspace->shards[i];
+        int rc;
 
-    if (virHashRemoveSet(lockspace->resources,
-                         virLockSpaceRemoveResourcesForOwner,
-                         &data) < 0)
-        goto error;
-
-    ret = data.count;
+        virMutexLock(&shard->lock);
+        rc = virHashRemoveSet(shard->resources,
+                              virLockSpaceRemoveResourcesForOwner,
+                              &data);
+        virMutexUnlock(&shard->lock);
 
-    virMutexUnlock(&lockspace->lock);
-    return ret;
+        if (rc < 0)
+            return -1;
+    }
 
- error:
-    virMutexUnlock(&lockspace->lock);
-    return -1;
+    return data.count;
 }
@@ -81,7 +81,7 @@ struct _virLogFilter {
     virLogPriority priority;
 };
 
-static int virLogFiltersSerial = 1;
+unsigned int virLogFiltersSerial = 1;
 static virLogFilterPtr *virLogFilters;
 static size_t virLogNbFilters;
 
@@ -110,6 +110,11 @@ static virLogPriority virLogDefaultPriority = VIR_LOG_DEFAULT;
 
 static void virLogResetFilters(void);
 static void virLogResetOutputs(void);
+static void virLogAsyncFlushLocked(void);
+static void virLogAsyncAtForkPrepare(void);
+static void virLogAsyncAtForkParent(void);
+static void virLogAsyncAtForkChild(void);
+static void virLogAsyncAtExit(void);
 static void virLogOutputToFd(virLogSourcePtr src,
                              virLogPriority priority,
                              const char *filename,
@@ -250,6 +255,17 @@ virLogOnceInit(void)
     if (virMutexInit(&virLogMutex) < 0)
         return -1;
 
+    if (virMutexInit(&virLogAsyncLock) < 0 ||
+        virCondInit(&virLogAsyncCond) < 0)
+        return -1;
+
+#ifndef WIN32
+    if (pthread_atfork(virLogAsyncAtForkPrepare,
+                       virLogAsyncAtForkParent,
+                       virLogAsyncAtForkChild) != 0)
+        return -1;
+#endif /* !WIN32 */
+
     virLogLock();
     virLogDefaultPriority = VIR_LOG_DEFAULT;
 
@@ -284,6 +300,7 @@ virLogReset(void)
         return -1;
 
     virLogLock();
+    virLogAsyncEnabled = false;
     virLogResetFilters();
     virLogResetOutputs();
     virLogDefaultPriority = VIR_LOG_DEFAULT;
@@ -314,6 +331,8 @@ virLogSetDefaultPriority(virLogPriority priority)
         return -1;
 
     virLogDefaultPriority = priority;
+    /* Sources not matched by any filter cache the default priority */
+    virLogFiltersSerial++;
     return 0;
 }
 
@@ -373,6 +392,9 @@ virLogFilterListFree(virLogFilterPtr *list, int count)
 static void
 virLogResetOutputs(void)
 {
+    /* Write out whatever was queued for the outputs going away */
+    virLogAsyncFlushLocked();
+
     virLogOutputListFree(virLogOutputs, virLogNbOutputs);
     virLogOutputs = NULL;
     virLogNbOutputs = 0;
@@ -468,7 +490,7 @@ static void
 virLogSourceUpdate(virLogSourcePtr source)
 {
     virLogLock();
-    if (source->serial < virLogFiltersSerial) {
+    if (source->serial != virLogFiltersSerial) {
         unsigned int priority = virLogDefaultPriority;
         size_t i;
 
@@ -485,6 +507,318 @@ virLogSourceUpdate(virLogSourcePtr source)
     virLogUnlock();
 }
 
+/*
+ * Push the message to the outputs defined, if none exist then
+ * use stderr. Must be called with virLogLock held.
+ */
+static void
+virLogOutputMessageLocked(virLogSourcePtr source,
+                          virLogPriority priority,
+                          const char *filename,
+                          int linenr,
+                          const char *funcname,
+                          const char *timestamp,
+                          virLogMetadataPtr metadata,
+                          const char *str,
+                          const char *msg)
+{
+    static bool logInitMessageStderr = true;
+    size_t i;
+
+    for (i = 0; i < virLogNbOutputs; i++) {
+        if (priority >= virLogOutputs[i]->priority) {
+            if (virLogOutputs[i]->logInitMessage) {
+                const char *rawinitmsg;
+                char *hoststr = NULL;
+                char *initmsg = NULL;
+                virLogVersionString(&rawinitmsg, &initmsg);
+                virLogOutputs[i]->f(&virLogSelf, VIR_LOG_INFO,
+                                    __FILE__, __LINE__, __func__,
+                                    timestamp, NULL, rawinitmsg, initmsg,
+                                    virLogOutputs[i]->data);
+                VIR_FREE(initmsg);
+
+                virLogHostnameString(&hoststr, &initmsg);
+                virLogOutputs[i]->f(&virLogSelf, VIR_LOG_INFO,
+                                    __FILE__, __LINE__, __func__,
+                                    timestamp, NULL, hoststr, initmsg,
+                                    virLogOutputs[i]->data);
+                VIR_FREE(hoststr);
+                VIR_FREE(initmsg);
+                virLogOutputs[i]->logInitMessage = false;
+            }
+            virLogOutputs[i]->f(source, priority,
+                                filename, linenr, funcname,
+                                timestamp, metadata,
+                                str, msg, virLogOutputs[i]->data);
+        }
+    }
+    if (virLogNbOutputs == 0) {
+        if (logInitMessageStderr) {
+            const char *rawinitmsg;
+            char *hoststr = NULL;
+            char *initmsg = NULL;
+            virLogVersionString(&rawinitmsg, &initmsg);
+            virLogOutputToFd(&virLogSelf, VIR_LOG_INFO,
+                             __FILE__, __LINE__, __func__,
+                             timestamp, NULL, rawinitmsg, initmsg,
+                             (void *) STDERR_FILENO);
+            VIR_FREE(initmsg);
+
+            virLogHostnameString(&hoststr, &initmsg);
+            virLogOutputToFd(&virLogSelf, VIR_LOG_INFO,
+                             __FILE__, __LINE__, __func__,
+                             timestamp, NULL, hoststr, initmsg,
+                             (void *) STDERR_FILENO);
+            VIR_FREE(hoststr);
+            VIR_FREE(initmsg);
+            logInitMessageStderr = false;
+        }
+        virLogOutputToFd(source, priority,
+                         filename, linenr, funcname,
+                         timestamp, metadata,
+                         str, msg, (void *) STDERR_FILENO);
+    }
+}
+
+
+/*
+ * Asynchronous logging, see virLogSetAsync. Debug and info messages
+ * without metadata are queued and written to the outputs by a
+ * dedicated thread, so the threads emitting them only format the
+ * message and hold virLogAsyncLock for as long as it takes to link it
+ * into the queue. Warnings and errors are still written right away,
+ * after the queue is flushed so that the order of messages is kept.
+ */
+#define VIR_LOG_ASYNC_MAX_QUEUE 4096
+
+typedef struct _virLogAsyncMessage virLogAsyncMessage;
+typedef virLogAsyncMessage *virLogAsyncMessagePtr;
+struct _virLogAsyncMessage {
+    virLogAsyncMessagePtr next;
+    virLogSourcePtr source;
+    virLogPriority priority;
+    char *filename;
+    int linenr;
+    char *funcname;
+    char timestamp[VIR_TIME_STRING_BUFLEN];
+    char *str;
+    char *msg;
+};
+
+static bool virLogAsyncEnabled;
+static virMutex virLogAsyncLock;
+static virCond virLogAsyncCond;
+/* The rest requires virLogAsyncLock */
+static pid_t virLogAsyncPid; /* process the writer thread runs in */
+static bool virLogAsyncAtExitRegistered;
+static virLogAsyncMessagePtr virLogAsyncHead;
+static virLogAsyncMessagePtr virLogAsyncTail;
+/* Updated with virLogAsyncLock held, read without it */
+static int virLogAsyncCount;
+
+
+static void
+virLogAsyncMessageFree(virLogAsyncMessagePtr amsg)
+{
+    g_free(amsg->filename);
+    g_free(amsg->funcname);
+    g_free(amsg->str);
+    g_free(amsg->msg);
+    g_free(amsg);
+}
+
+
+/* Must be called with virLogLock held */
+static void
+virLogAsyncFlushLocked(void)
+{
+    virLogAsyncMessagePtr amsg;
+
+    /* This is called for every message written right away, which is
+     * all of them unless async logging is enabled, so don't bother
+     * with the lock if there is nothing queued */
+    if (g_atomic_int_get(&virLogAsyncCount) == 0)
+        return;
+
+    virMutexLock(&virLogAsyncLock);
+    /* Queued messages of the parent are not ours to write after fork */
+    if (virLogAsyncPid != getpid()) {
+        virMutexUnlock(&virLogAsyncLock);
+        return;
+    }
+    amsg = g_steal_pointer(&virLogAsyncHead);
+    virLogAsyncTail = NULL;
+    g_atomic_int_set(&virLogAsyncCount, 0);
+    virMutexUnlock(&virLogAsyncLock);
+
+    while (amsg) {
+        virLogAsyncMessagePtr next = amsg->next;
+
+        virLogOutputMessageLocked(amsg->source, amsg->priority,
+                                  amsg->filename, amsg->linenr,
+                                  amsg->funcname, amsg->timestamp, NULL,
+                                  amsg->str, amsg->msg);
+        virLogAsyncMessageFree(amsg);
+        amsg = next;
+    }
+}
+
+
+static void
+virLogAsyncWorker(void *opaque G_GNUC_UNUSED)
+{
+    virMutexLock(&virLogAsyncLock);
+
+    for (;;) {
+        while (!virLogAsyncHead)
+            ignore_value(virCondWait(&virLogAsyncCond, &virLogAsyncLock));
+        virMutexUnlock(&virLogAsyncLock);
+
+        virLogLock();
+        virLogAsyncFlushLocked();
+        virLogUnlock();
+
+        virMutexLock(&virLogAsyncLock);
+    }
+}
+
+
+/* Queues a formatted message, stealing @str and @msg. Returns 0 on
+ * success, -1 if the message has to be written right away */
+static int
+virLogAsyncPush(virLogSourcePtr source,
+                virLogPriority priority,
+                const char *filename,
+                int linenr,
+                const char *funcname,
+                const char *timestamp,
+                char **str,
+                char **msg)
+{
+    virLogAsyncMessagePtr amsg;
+    virThread thread;
+
+    virMutexLock(&virLogAsyncLock);
+
+    if (virLogAsyncPid != getpid()) {
+        if (virThreadCreateFull(&thread, false, virLogAsyncWorker,
+                                "log-writer", false, NULL) < 0) {
+            virMutexUnlock(&virLogAsyncLock);
+            return -1;
+        }
+        virLogAsyncPid = getpid();
+
+        if (!virLogAsyncAtExitRegistered) {
+            atexit(virLogAsyncAtExit);
+            virLogAsyncAtExitRegistered = true;
+        }
+    }
+
+    /* Rather than dropping messages, let the producers wait for the
+     * outputs once the writer can't keep up */
+    if (virLogAsyncCount >= VIR_LOG_ASYNC_MAX_QUEUE) {
+        virMutexUnlock(&virLogAsyncLock);
+        return -1;
+    }
+
+    amsg = g_new0(virLogAsyncMessage, 1);
+    amsg->source = source;
+    amsg->priority = priority;
+    amsg->filename = g_strdup(filename);
+    amsg->linenr = linenr;
+    amsg->funcname = g_strdup(funcname);
+    if (virStrcpyStatic(amsg->timestamp, timestamp) < 0)
+        amsg->timestamp[0] = '\0';
+    amsg->str = g_steal_pointer(str);
+    amsg->msg = g_steal_pointer(msg);
+
+    if (virLogAsyncTail)
+        virLogAsyncTail->next = amsg;
+    else
+        virLogAsyncHead = amsg;
+    virLogAsyncTail = amsg;
+    g_atomic_int_inc(&virLogAsyncCount);
+
+    virCondSignal(&virLogAsyncCond);
+    virMutexUnlock(&virLogAsyncLock);
+    return 0;
+}
+
+
+static void
+virLogAsyncAtForkPrepare(void)
+{
+    virMutexLock(&virLogAsyncLock);
+}
+
+
+static void
+virLogAsyncAtForkParent(void)
+{
+    virMutexUnlock(&virLogAsyncLock);
+}
+
+
+/* The writer thread doesn't exist in the child, a new one is started
+ * once needed. The queued messages are the parent's to write */
+static void
+virLogAsyncAtForkChild(void)
+{
+    virLogAsyncMessagePtr amsg = g_steal_pointer(&virLogAsyncHead);
+
+    virLogAsyncTail = NULL;
+    g_atomic_int_set(&virLogAsyncCount, 0);
+    virLogAsyncPid = 0;
+    ignore_value(virCondInit(&virLogAsyncCond));
+    virMutexUnlock(&virLogAsyncLock);
+
+    while (amsg) {
+        virLogAsyncMessagePtr next = amsg->next;
+
+        virLogAsyncMessageFree(amsg);
+        amsg = next;
+    }
+}
+
+
+static void
+virLogAsyncAtExit(void)
+{
+    virLogLock();
+    virLogAsyncFlushLocked();
+    virLogUnlock();
+}
+
+
+/**
+ * virLogSetAsync:
+ * @async: whether to write messages asynchronously
+ *
+ * Makes debug and info messages get written to the outputs by a
+ * dedicated thread, so that enabling debug logs doesn't serialize
+ * all threads on writing to the outputs. The downside is that the
+ * last messages queued may get lost if the process crashes, hence
+ * this is disabled by default.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virLogSetAsync(bool async)
+{
+    if (virLogInitialize() < 0)
+        return -1;
+
+    virLogLock();
+    virLogAsyncEnabled = async;
+    if (!async)
+        virLogAsyncFlushLocked();
+    virLogUnlock();
+
+    return 0;
+}
+
+
 /**
  * virLogMessage:
  * @source: where is that message coming from
@@ -541,11 +875,9 @@ virLogVMessage(virLogSourcePtr source,
                const char *fmt,
                va_list vargs)
 {
-    static bool logInitMessageStderr = true;
     char *str = NULL;
     char *msg = NULL;
     char timestamp[VIR_TIME_STRING_BUFLEN];
-    size_t i;
     int saved_errno = errno;
 
     if (virLogInitialize() < 0)
@@ -562,7 +894,7 @@ virLogVMessage(virLogSourcePtr source,
      * thread is updating log filter list concurrently
      * with a log message emission.
      */
-    if (source->serial < virLogFiltersSerial)
+    if (source->serial != virLogFiltersSerial)
         virLogSourceUpdate(source);
     if (priority < source->priority)
         goto cleanup;
@@ -577,66 +909,15 @@ virLogVMessage(virLogSourcePtr source,
     if (virTimeStringNowRaw(timestamp) < 0)
         timestamp[0] = '\0';
 
-    virLogLock();
-
-    /*
-     * Push the message to the outputs defined, if none exist then
-     * use stderr.
-     */
-    for (i = 0; i < virLogNbOutputs; i++) {
-        if (priority >= virLogOutputs[i]->priority) {
-            if (virLogOutputs[i]->logInitMessage) {
-                const char *rawinitmsg;
-                char *hoststr = NULL;
-                char *initmsg = NULL;
-                virLogVersionString(&rawinitmsg, &initmsg);
-                virLogOutputs[i]->f(&virLogSelf, VIR_LOG_INFO,
-                                    __FILE__, __LINE__, __func__,
-                                    timestamp, NULL, rawinitmsg, initmsg,
-                                    virLogOutputs[i]->data);
-                VIR_FREE(initmsg);
-
-                virLogHostnameString(&hoststr, &initmsg);
-                virLogOutputs[i]->f(&virLogSelf, VIR_LOG_INFO,
-                                    __FILE__, __LINE__, __func__,
-                                    timestamp, NULL, hoststr, initmsg,
-                                    virLogOutputs[i]->data);
-                VIR_FREE(hoststr);
-                VIR_FREE(initmsg);
-                virLogOutputs[i]->logInitMessage = false;
-            }
-            virLogOutputs[i]->f(source, priority,
-                                filename, linenr, funcname,
-                                timestamp, metadata,
-                                str, msg, virLogOutputs[i]->data);
-        }
-    }
-    if (virLogNbOutputs == 0) {
-        if (logInitMessageStderr) {
-            const char *rawinitmsg;
-            char *hoststr = NULL;
-            char *initmsg = NULL;
-            virLogVersionString(&rawinitmsg, &initmsg);
-            virLogOutputToFd(&virLogSelf, VIR_LOG_INFO,
-                             __FILE__, __LINE__, __func__,
-                             timestamp, NULL, rawinitmsg, initmsg,
-                             (void *) STDERR_FILENO);
-            VIR_FREE(initmsg);
+    if (virLogAsyncEnabled && priority < VIR_LOG_WARN && !metadata &&
+        virLogAsyncPush(source, priority, filename, linenr, funcname,
+                        timestamp, &str, &msg) == 0)
+        goto cleanup;
 
-            virLogHostnameString(&hoststr, &initmsg);
-            virLogOutputToFd(&virLogSelf, VIR_LOG_INFO,
-                             __FILE__, __LINE__, __func__,
-                             timestamp, NULL, hoststr, initmsg,
-                             (void *) STDERR_FILENO);
-            VIR_FREE(hoststr);
-            VIR_FREE(initmsg);
-            logInitMessageStderr = false;
-        }
-        virLogOutputToFd(source, priority,
-                         filename, linenr, funcname,
-                         timestamp, metadata,
-                         str, msg, (void *) STDERR_FILENO);
-    }
+    virLogLock();
+    virLogAsyncFlushLocked();
+    virLogOutputMessageLocked(source, priority, filename, linenr, funcname,
+                              timestamp, metadata, str, msg);
     virLogUnlock();
 
  cleanup:
@@ -1222,6 +1503,9 @@ virLogSetFromEnv(void)
     debugEnv = getenv("LIBVIRT_LOG_OUTPUTS");
     if (debugEnv && *debugEnv)
         virLogSetOutputs(debugEnv);
+    debugEnv = getenv("LIBVIRT_LOG_ASYNC");
+    if (debugEnv && *debugEnv)
+        virLogSetAsync(STRNEQ(debugEnv, "0"));
 }
 
 
@@ -66,6 +66,19 @@ struct _virLogSource {
     unsigned int serial;
 };
 
+extern unsigned int virLogFiltersSerial;
+
+/*
+ * Checks whether a message of priority @prio from @src would be
+ * logged, without a function call. The priority cached in @src is only
+ * trusted while it is up to date with the filters, otherwise the
+ * message is passed to virLogMessage which refreshes the cache. Like
+ * the checks in virLogVMessage this reads without locking, so a message
+ * may be dropped or emitted while the filters are being changed.
+ */
+#define VIR_LOG_ENABLED(src, prio) \
+    ((src)->serial != virLogFiltersSerial || (prio) >= (src)->priority)
+
 /*
  * G_GNUC_UNUSED is to make gcc keep quiet if all the
  * log statements in a file are conditionally disabled
@@ -85,7 +98,9 @@ struct _virLogSource {
  */
 #ifdef ENABLE_DEBUG
 # define VIR_DEBUG_INT(src, filename, linenr, funcname, ...) \
-    virLogMessage(src, VIR_LOG_DEBUG, filename, linenr, funcname, NULL, __VA_ARGS__)
+    (VIR_LOG_ENABLED(src, VIR_LOG_DEBUG) ? \
+     virLogMessage(src, VIR_LOG_DEBUG, filename, linenr, funcname, NULL, __VA_ARGS__) : \
+     (void)0)
 #else
 /**
  * virLogEatParams:
@@ -102,7 +117,9 @@ static inline void virLogEatParams(virLogSourcePtr unused, ...)
 #endif /* !ENABLE_DEBUG */
 
 #define VIR_INFO_INT(src, filename, linenr, funcname, ...) \
-    virLogMessage(src, VIR_LOG_INFO, filename, linenr, funcname, NULL, __VA_ARGS__)
+    (VIR_LOG_ENABLED(src, VIR_LOG_INFO) ? \
+     virLogMessage(src, VIR_LOG_INFO, filename, linenr, funcname, NULL, __VA_ARGS__) : \
+     (void)0)
 #define VIR_WARN_INT(src, filename, linenr, funcname, ...) \
     virLogMessage(src, VIR_LOG_WARN, filename, linenr, funcname, NULL, __VA_ARGS__)
 #define VIR_ERROR_INT(src, filename, linenr, funcname, ...) \
@@ -174,6 +191,7 @@ char *virLogGetOutputs(void);
 virLogPriority virLogGetDefaultPriority(void);
 int virLogSetDefaultPriority(virLogPriority priority);
 void virLogSetFromEnv(void);
+int virLogSetAsync(bool async);
 void virLogOutputFree(virLogOutputPtr output);
 void virLogOutputListFree(virLogOutputPtr *list, int count);
 void virLogFilterFree(virLogFilterPtr filter);
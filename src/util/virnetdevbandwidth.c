@@ -39,9 +39,8 @@ virNetDevBandwidthFree(virNetDevBandwidthPtr def)
     VIR_FREE(def);
 }
 
-static void
-virNetDevBandwidthCmdAddOptimalQuantum(virCommandPtr cmd,
-                                       const virNetDevBandwidthRate *rate)
+static unsigned long long
+virNetDevBandwidthOptimalQuantum(const virNetDevBandwidthRate *rate)
 {
     const unsigned long long mtu = 1500;
     unsigned long long r2q;
@@ -58,10 +57,651 @@ virNetDevBandwidthCmdAddOptimalQuantum(virCommandPtr cmd,
     if (!r2q)
         r2q = 1;
 
+    return r2q;
+}
+
+static void
+virNetDevBandwidthCmdAddOptimalQuantum(virCommandPtr cmd,
+                                       const virNetDevBandwidthRate *rate)
+{
     virCommandAddArg(cmd, "quantum");
-    virCommandAddArgFormat(cmd, "%llu", r2q);
+    virCommandAddArgFormat(cmd, "%llu", virNetDevBandwidthOptimalQuantum(rate));
+}
+
+#if defined(__linux__) && defined(HAVE_LIBNL)
+# include <linux/if_ether.h>
+# include <linux/pkt_cls.h>
+# include <linux/pkt_sched.h>
+# include <linux/rtnetlink.h>
+
+# include "virfile.h"
+# include "virlog.h"
+# include "virnetdev.h"
+# include "virnetlink.h"
+# include "virsocket.h"
+# include "virthread.h"
+
+VIR_LOG_INIT("util.netdevbandwidth");
+
+# define PSCHED_PATH "/proc/net/psched"
+
+/* What tc uses unless told otherwise */
+# define VIR_NETDEV_BANDWIDTH_HTB_MTU 1600
+# define VIR_NETDEV_BANDWIDTH_POLICE_MTU (64 * 1024)
+
+static double virNetDevBandwidthTicksPerUsec;
+static unsigned int virNetDevBandwidthHZ;
+
+/* The kernel expects times in the units of its packet scheduler clock,
+ * which has to be calibrated the same way tc does it. */
+static int
+virNetDevBandwidthOnceInit(void)
+{
+    g_autofree char *buf = NULL;
+    unsigned int t2us, us2t, clockRes, hz;
+
+    if (virFileReadAll(PSCHED_PATH, 1024, &buf) < 0)
+        return -1;
+
+    if (sscanf(buf, "%x %x %x %x", &t2us, &us2t, &clockRes, &hz) != 4 ||
+        us2t == 0 || clockRes == 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to parse %s"), PSCHED_PATH);
+        return -1;
+    }
+
+    /* For the sake of old tc binaries, kernels with a nanosecond clock
+     * advertise a tick multiplier of 1000, which really is 1. */
+    if (clockRes == 1000000000)
+        t2us = us2t;
+
+    virNetDevBandwidthTicksPerUsec = (double)t2us / us2t * clockRes / 1000000;
+    virNetDevBandwidthHZ = clockRes == 1000000 ? hz : 100;
+
+    return 0;
 }
 
+VIR_ONCE_GLOBAL_INIT(virNetDevBandwidth);
+
+
+/* Ticks needed to send @size bytes at @rate bytes per second */
+static unsigned int
+virNetDevBandwidthXmitTime(unsigned long long rate,
+                           unsigned long long size)
+{
+    return 1000000 * ((double)size / rate) * virNetDevBandwidthTicksPerUsec;
+}
+
+
+static void
+virNetDevBandwidthRateSpecFill(struct tc_ratespec *spec,
+                               uint32_t *rtab,
+                               unsigned long long rate,
+                               unsigned int mtu)
+{
+    int cellLog = 0;
+    size_t i;
+
+    while ((mtu >> cellLog) > 255)
+        cellLog++;
+
+    for (i = 0; i < 256; i++)
+        rtab[i] = virNetDevBandwidthXmitTime(rate, (i + 1) << cellLog);
+
+    spec->rate = rate;
+    spec->cell_log = cellLog;
+    spec->cell_align = -1;
+    spec->linklayer = TC_LINKLAYER_ETHERNET;
+}
+
+
+/* A set of traffic control requests for one interface */
+typedef struct _virNetDevBandwidthBatch virNetDevBandwidthBatch;
+typedef virNetDevBandwidthBatch *virNetDevBandwidthBatchPtr;
+struct _virNetDevBandwidthBatch {
+    const char *ifname;
+    int ifindex;
+    size_t nmsgs;
+    virNetlinkMsg **msgs;
+    size_t nignored;    /* leading requests which are allowed to fail */
+};
+
+static void
+virNetDevBandwidthBatchClear(virNetDevBandwidthBatchPtr batch)
+{
+    size_t i;
+
+    for (i = 0; i < batch->nmsgs; i++)
+        nlmsg_free(batch->msgs[i]);
+    VIR_FREE(batch->msgs);
+    batch->nmsgs = 0;
+}
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(virNetDevBandwidthBatch,
+                                 virNetDevBandwidthBatchClear);
+
+
+/* Returns 0 on success, -2 if netlink can't be used for @ifname */
+static int
+virNetDevBandwidthBatchInit(virNetDevBandwidthBatchPtr batch,
+                            const char *ifname)
+{
+    batch->ifname = ifname;
+
+    if (virNetDevBandwidthInitialize() < 0 ||
+        virNetDevGetIndex(ifname, &batch->ifindex) < 0) {
+        VIR_DEBUG("Not using netlink for QoS on '%s': %s",
+                  ifname, virGetLastErrorMessage());
+        virResetLastError();
+        return -2;
+    }
+
+    return 0;
+}
+
+
+static virNetlinkMsg *
+virNetDevBandwidthBatchAdd(virNetDevBandwidthBatchPtr batch,
+                           int type,
+                           int flags,
+                           uint32_t parent,
+                           uint32_t handle,
+                           uint32_t info,
+                           const char *kind)
+{
+    struct tcmsg tcm = {
+        .tcm_family = AF_UNSPEC,
+        .tcm_ifindex = batch->ifindex,
+        .tcm_parent = parent,
+        .tcm_handle = handle,
+        .tcm_info = info,
+    };
+    virNetlinkMsg *msg;
+
+    if (!(msg = nlmsg_alloc_simple(type, NLM_F_REQUEST | flags))) {
+        virReportOOMError();
+        return NULL;
+    }
+
+    if (VIR_APPEND_ELEMENT_COPY(batch->msgs, batch->nmsgs, msg) < 0) {
+        nlmsg_free(msg);
+        return NULL;
+    }
+
+    if (nlmsg_append(msg, &tcm, sizeof(tcm), NLMSG_ALIGNTO) < 0)
+        goto buffer_too_small;
+
+    if (kind)
+        NETLINK_MSG_PUT(msg, TCA_KIND, strlen(kind) + 1, kind);
+
+    return msg;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return NULL;
+}
+
+
+/* Sends all requests of @batch at once. Returns 0 on success, -1 if
+ * the kernel refused a request (with error reported), -2 if netlink
+ * can't be used. */
+static int
+virNetDevBandwidthBatchRun(virNetDevBandwidthBatchPtr batch)
+{
+    g_autofree int *errors = g_new0(int, batch->nmsgs);
+    size_t i;
+
+    if (virNetlinkCommandBatch(batch->msgs, batch->nmsgs,
+                               NETLINK_ROUTE, errors) < 0) {
+        VIR_DEBUG("Not using netlink for QoS on '%s': %s",
+                  batch->ifname, virGetLastErrorMessage());
+        virResetLastError();
+        return -2;
+    }
+
+    for (i = batch->nignored; i < batch->nmsgs; i++) {
+        if (errors[i] < 0) {
+            virReportSystemError(-errors[i],
+                                 _("Unable to set up QoS on '%s'"),
+                                 batch->ifname);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+virNetDevBandwidthBatchAddHTBQdisc(virNetDevBandwidthBatchPtr batch,
+                                   unsigned int defcls)
+{
+    struct tc_htb_glob glob = {
+        .version = 3,
+        .rate2quantum = 10,
+        .defcls = defcls,
+    };
+    struct nlattr *options = NULL;
+    virNetlinkMsg *msg;
+
+    if (!(msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWQDISC,
+                                           NLM_F_CREATE | NLM_F_EXCL,
+                                           TC_H_ROOT, TC_H_MAKE(1 << 16, 0),
+                                           0, "htb")))
+        return -1;
+
+    NETLINK_MSG_NEST_START(msg, options, TCA_OPTIONS);
+    NETLINK_MSG_PUT(msg, TCA_HTB_INIT, sizeof(glob), &glob);
+    NETLINK_MSG_NEST_END(msg, options);
+
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/* @rate, @ceil and @burst are in bytes (per second), @ceil and @burst
+ * may be 0 for tc's defaults. A class is changed instead of created if
+ * @parent is 0. */
+static int
+virNetDevBandwidthBatchAddHTBClass(virNetDevBandwidthBatchPtr batch,
+                                   uint32_t parent,
+                                   uint32_t classid,
+                                   unsigned long long rate,
+                                   unsigned long long ceil,
+                                   unsigned long long burst,
+                                   unsigned int quantum)
+{
+    const unsigned int mtu = VIR_NETDEV_BANDWIDTH_HTB_MTU;
+    struct tc_htb_opt opt = { .quantum = quantum };
+    uint32_t rtab[256];
+    uint32_t ctab[256];
+    struct nlattr *options = NULL;
+    virNetlinkMsg *msg;
+
+    if (!ceil)
+        ceil = rate;
+    if (!burst)
+        burst = rate / virNetDevBandwidthHZ + mtu;
+
+    virNetDevBandwidthRateSpecFill(&opt.rate, rtab, rate, mtu);
+    virNetDevBandwidthRateSpecFill(&opt.ceil, ctab, ceil, mtu);
+    opt.buffer = virNetDevBandwidthXmitTime(rate, burst);
+    opt.cbuffer = virNetDevBandwidthXmitTime(ceil,
+                                             ceil / virNetDevBandwidthHZ + mtu);
+
+    if (!(msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWTCLASS,
+                                           parent ? NLM_F_CREATE | NLM_F_EXCL : 0,
+                                           parent, classid, 0, "htb")))
+        return -1;
+
+    NETLINK_MSG_NEST_START(msg, options, TCA_OPTIONS);
+    NETLINK_MSG_PUT(msg, TCA_HTB_PARMS, sizeof(opt), &opt);
+    NETLINK_MSG_PUT(msg, TCA_HTB_RTAB, sizeof(rtab), rtab);
+    NETLINK_MSG_PUT(msg, TCA_HTB_CTAB, sizeof(ctab), ctab);
+    NETLINK_MSG_NEST_END(msg, options);
+
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+static int
+virNetDevBandwidthBatchAddSFQ(virNetDevBandwidthBatchPtr batch,
+                              uint32_t parent,
+                              uint32_t handle)
+{
+    struct tc_sfq_qopt opt = { .perturb_period = 10 };
+    virNetlinkMsg *msg;
+
+    if (!(msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWQDISC,
+                                           NLM_F_CREATE | NLM_F_EXCL,
+                                           parent, handle, 0, "sfq")))
+        return -1;
+
+    NETLINK_MSG_PUT(msg, TCA_OPTIONS, sizeof(opt), &opt);
+
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/* The u32 filter placing the traffic of @ifmac_ptr into @classid, see
+ * virNetDevBandwidthManipulateFilter */
+static int
+virNetDevBandwidthBatchAddMACFilter(virNetDevBandwidthBatchPtr batch,
+                                    const virMacAddr *ifmac_ptr,
+                                    unsigned int id,
+                                    uint32_t classid,
+                                    bool create)
+{
+    const size_t nkeys = 3;
+    uint32_t handle = 0x80000000 | id;
+    unsigned char ifmac[VIR_MAC_BUFLEN];
+    g_autofree struct tc_u32_sel *sel = NULL;
+    struct nlattr *options = NULL;
+    virNetlinkMsg *msg;
+
+    if (!create)
+        return virNetDevBandwidthBatchAdd(batch, RTM_DELTFILTER, 0, 0, handle,
+                                          TC_H_MAKE(2 << 16, 0),
+                                          "u32") ? 0 : -1;
+
+    virMacAddrGetRaw(ifmac_ptr, ifmac);
+
+    sel = g_malloc0(sizeof(*sel) + nkeys * sizeof(sel->keys[0]));
+    sel->flags = TC_U32_TERMINAL;
+    sel->nkeys = nkeys;
+    sel->keys[0].val = htonl(ETH_P_IP);
+    sel->keys[0].mask = htonl(0xffff);
+    sel->keys[0].off = -4;
+    sel->keys[1].val = htonl((uint32_t)ifmac[2] << 24 | ifmac[3] << 16 |
+                             ifmac[4] << 8 | ifmac[5]);
+    sel->keys[1].mask = htonl(0xffffffff);
+    sel->keys[1].off = -12;
+    sel->keys[2].val = htonl(ifmac[0] << 8 | ifmac[1]);
+    sel->keys[2].mask = htonl(0xffff);
+    sel->keys[2].off = -16;
+
+    if (!(msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWTFILTER,
+                                           NLM_F_CREATE | NLM_F_EXCL,
+                                           0, handle,
+                                           TC_H_MAKE(2 << 16, htons(ETH_P_IP)),
+                                           "u32")))
+        return -1;
+
+    NETLINK_MSG_NEST_START(msg, options, TCA_OPTIONS);
+    NETLINK_MSG_PUT(msg, TCA_U32_CLASSID, sizeof(classid), &classid);
+    NETLINK_MSG_PUT(msg, TCA_U32_SEL,
+                    sizeof(*sel) + nkeys * sizeof(sel->keys[0]), sel);
+    NETLINK_MSG_NEST_END(msg, options);
+
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/* Netlink counterpart of the tc commands issued by virNetDevBandwidthSet */
+static int
+virNetDevBandwidthSetNetlink(const char *ifname,
+                             const virNetDevBandwidthRate *rx,
+                             const virNetDevBandwidthRate *tx,
+                             bool hierarchical_class)
+{
+    g_auto(virNetDevBandwidthBatch) batch = { 0 };
+    struct nlattr *options = NULL;
+    virNetlinkMsg *msg;
+
+    /* Rates beyond 32 bits need attributes old kernels don't know, and
+     * it's up to tc to complain about a zero rate */
+    if ((tx && tx->average &&
+         (tx->average > UINT32_MAX / 1000 || tx->peak > UINT32_MAX / 1000)) ||
+        (rx && (!rx->average || rx->average > UINT32_MAX / 1000)))
+        return -2;
+
+    if (virNetDevBandwidthBatchInit(&batch, ifname) < 0)
+        return -2;
+
+    /* Clear whatever was set before, see virNetDevBandwidthClear */
+    if (!virNetDevBandwidthBatchAdd(&batch, RTM_DELQDISC, 0,
+                                    TC_H_ROOT, 0, 0, NULL) ||
+        !virNetDevBandwidthBatchAdd(&batch, RTM_DELQDISC, 0,
+                                    TC_H_INGRESS, TC_H_MAKE(TC_H_INGRESS, 0),
+                                    0, "ingress"))
+        return -1;
+    batch.nignored = batch.nmsgs;
+
+    if (tx && tx->average) {
+        unsigned long long average = tx->average * 1000;
+        unsigned long long peak = tx->peak * 1000;
+        unsigned long long burst = tx->burst * 1024;
+        uint32_t classid = TC_H_MAKE(1 << 16, hierarchical_class ? 2 : 1);
+        uint32_t fwClassid = 1;
+
+        if (virNetDevBandwidthBatchAddHTBQdisc(&batch,
+                                               TC_H_MIN(classid)) < 0)
+            return -1;
+
+        if (hierarchical_class &&
+            virNetDevBandwidthBatchAddHTBClass(&batch,
+                                               TC_H_MAKE(1 << 16, 0),
+                                               TC_H_MAKE(1 << 16, 1),
+                                               average, peak, 0,
+                                               virNetDevBandwidthOptimalQuantum(tx)) < 0)
+            return -1;
+
+        if (virNetDevBandwidthBatchAddHTBClass(&batch,
+                                               hierarchical_class ?
+                                               TC_H_MAKE(1 << 16, 1) :
+                                               TC_H_MAKE(1 << 16, 0),
+                                               classid, average, peak, burst,
+                                               virNetDevBandwidthOptimalQuantum(tx)) < 0)
+            return -1;
+
+        if (virNetDevBandwidthBatchAddSFQ(&batch, classid,
+                                          TC_H_MAKE(2 << 16, 0)) < 0)
+            return -1;
+
+        if (!(msg = virNetDevBandwidthBatchAdd(&batch, RTM_NEWTFILTER,
+                                               NLM_F_CREATE | NLM_F_EXCL,
+                                               TC_H_MAKE(1 << 16, 0), 1,
+                                               TC_H_MAKE(1 << 16, htons(ETH_P_ALL)),
+                                               "fw")))
+            return -1;
+
+        NETLINK_MSG_NEST_START(msg, options, TCA_OPTIONS);
+        NETLINK_MSG_PUT(msg, TCA_FW_CLASSID, sizeof(fwClassid), &fwClassid);
+        NETLINK_MSG_NEST_END(msg, options);
+    }
+
+    if (rx) {
+        unsigned long long average = rx->average * 1000;
+        unsigned long long burst = (rx->burst ? rx->burst : rx->average) * 1024;
+        struct tc_police police = {
+            .action = TC_POLICE_SHOT,
+            .mtu = VIR_NETDEV_BANDWIDTH_POLICE_MTU,
+        };
+        struct nlattr *pol = NULL;
+        struct tc_u32_sel sel = { .flags = TC_U32_TERMINAL };
+        struct tc_u32_key key = { 0 };
+        char selbuf[sizeof(sel) + sizeof(key)];
+        uint32_t rtab[256];
+        uint32_t flowid = 1;
+
+        virNetDevBandwidthRateSpecFill(&police.rate, rtab, average,
+                                       VIR_NETDEV_BANDWIDTH_POLICE_MTU);
+        police.burst = virNetDevBandwidthXmitTime(average, burst);
+
+        /* match u32 0 0, i.e. everything */
+        sel.nkeys = 1;
+        memcpy(selbuf, &sel, sizeof(sel));
+        memcpy(selbuf + sizeof(sel), &key, sizeof(key));
+
+        if (!(msg = virNetDevBandwidthBatchAdd(&batch, RTM_NEWQDISC,
+                                               NLM_F_CREATE | NLM_F_EXCL,
+                                               TC_H_INGRESS,
+                                               TC_H_MAKE(TC_H_INGRESS, 0),
+                                               0, "ingress")))
+            return -1;
+
+        if (!(msg = virNetDevBandwidthBatchAdd(&batch, RTM_NEWTFILTER,
+                                               NLM_F_CREATE | NLM_F_EXCL,
+                                               TC_H_MAKE(TC_H_INGRESS, 0), 0,
+                                               TC_H_MAKE(0, htons(ETH_P_ALL)),
+                                               "u32")))
+            return -1;
+
+        NETLINK_MSG_NEST_START(msg, options, TCA_OPTIONS);
+        NETLINK_MSG_NEST_START(msg, pol, TCA_U32_POLICE);
+        NETLINK_MSG_PUT(msg, TCA_POLICE_TBF, sizeof(police), &police);
+        NETLINK_MSG_PUT(msg, TCA_POLICE_RATE, sizeof(rtab), rtab);
+        NETLINK_MSG_NEST_END(msg, pol);
+        NETLINK_MSG_PUT(msg, TCA_U32_CLASSID, sizeof(flowid), &flowid);
+        NETLINK_MSG_PUT(msg, TCA_U32_SEL, sizeof(selbuf), selbuf);
+        NETLINK_MSG_NEST_END(msg, options);
+    }
+
+    return virNetDevBandwidthBatchRun(&batch);
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/* Netlink counterpart of the tc commands issued by virNetDevBandwidthPlug */
+static int
+virNetDevBandwidthPlugNetlink(const char *brname,
+                              const virNetDevBandwidth *net_bandwidth,
+                              const virMacAddr *ifmac_ptr,
+                              const virNetDevBandwidth *bandwidth,
+                              unsigned int id)
+{
+    g_auto(virNetDevBandwidthBatch) batch = { 0 };
+    unsigned long long floor = bandwidth->in->floor;
+    unsigned long long ceil = net_bandwidth->in->peak ?
+                              net_bandwidth->in->peak :
+                              net_bandwidth->in->average;
+    uint32_t classid = TC_H_MAKE(1 << 16, id);
+
+    if (id > 0xffff || !floor || !ceil ||
+        floor > UINT32_MAX / 1000 || ceil > UINT32_MAX / 1000)
+        return -2;
+
+    if (virNetDevBandwidthBatchInit(&batch, brname) < 0)
+        return -2;
+
+    if (virNetDevBandwidthBatchAddHTBClass(&batch, TC_H_MAKE(1 << 16, 1),
+                                           classid, floor * 1000,
+                                           ceil * 1000, 0,
+                                           virNetDevBandwidthOptimalQuantum(bandwidth->in)) < 0 ||
+        virNetDevBandwidthBatchAddSFQ(&batch, classid,
+                                      TC_H_MAKE(id << 16, 0)) < 0 ||
+        virNetDevBandwidthBatchAddMACFilter(&batch, ifmac_ptr, id,
+                                            classid, true) < 0)
+        return -1;
+
+    return virNetDevBandwidthBatchRun(&batch);
+}
+
+
+/* Netlink counterpart of the tc command issued by
+ * virNetDevBandwidthUpdateRate */
+static int
+virNetDevBandwidthUpdateRateNetlink(const char *ifname,
+                                    unsigned int id,
+                                    const virNetDevBandwidth *bandwidth,
+                                    unsigned long long new_rate)
+{
+    g_auto(virNetDevBandwidthBatch) batch = { 0 };
+    unsigned long long ceil = bandwidth->in->peak ?
+                              bandwidth->in->peak :
+                              bandwidth->in->average;
+
+    if (id > 0xffff || !new_rate || !ceil ||
+        new_rate > UINT32_MAX / 1000 || ceil > UINT32_MAX / 1000)
+        return -2;
+
+    if (virNetDevBandwidthBatchInit(&batch, ifname) < 0)
+        return -2;
+
+    if (virNetDevBandwidthBatchAddHTBClass(&batch, 0,
+                                           TC_H_MAKE(1 << 16, id),
+                                           new_rate * 1000, ceil * 1000, 0,
+                                           virNetDevBandwidthOptimalQuantum(bandwidth->in)) < 0)
+        return -1;
+
+    return virNetDevBandwidthBatchRun(&batch);
+}
+
+
+/* Netlink counterpart of the tc commands issued by
+ * virNetDevBandwidthUpdateFilter */
+static int
+virNetDevBandwidthUpdateFilterNetlink(const char *ifname,
+                                      const virMacAddr *ifmac_ptr,
+                                      unsigned int id)
+{
+    g_auto(virNetDevBandwidthBatch) batch = { 0 };
+    uint32_t classid = TC_H_MAKE(1 << 16, id);
+
+    if (id > 0xffff)
+        return -2;
+
+    if (virNetDevBandwidthBatchInit(&batch, ifname) < 0)
+        return -2;
+
+    if (virNetDevBandwidthBatchAddMACFilter(&batch, NULL, id, 0, false) < 0)
+        return -1;
+    batch.nignored = batch.nmsgs;
+
+    if (virNetDevBandwidthBatchAddMACFilter(&batch, ifmac_ptr, id,
+                                            classid, true) < 0)
+        return -1;
+
+    return virNetDevBandwidthBatchRun(&batch);
+}
+
+#else /* !(defined(__linux__) && defined(HAVE_LIBNL)) */
+
+static int
+virNetDevBandwidthSetNetlink(const char *ifname G_GNUC_UNUSED,
+                             const virNetDevBandwidthRate *rx G_GNUC_UNUSED,
+                             const virNetDevBandwidthRate *tx G_GNUC_UNUSED,
+                             bool hierarchical_class G_GNUC_UNUSED)
+{
+    return -2;
+}
+
+
+static int
+virNetDevBandwidthPlugNetlink(const char *brname G_GNUC_UNUSED,
+                              const virNetDevBandwidth *net_bandwidth G_GNUC_UNUSED,
+                              const virMacAddr *ifmac_ptr G_GNUC_UNUSED,
+                              const virNetDevBandwidth *bandwidth G_GNUC_UNUSED,
+                              unsigned int id G_GNUC_UNUSED)
+{
+    return -2;
+}
+
+
+static int
+virNetDevBandwidthUpdateRateNetlink(const char *ifname G_GNUC_UNUSED,
+                                    unsigned int id G_GNUC_UNUSED,
+                                    const virNetDevBandwidth *bandwidth G_GNUC_UNUSED,
+                                    unsigned long long new_rate G_GNUC_UNUSED)
+{
+    return -2;
+}
+
+
+static int
+virNetDevBandwidthUpdateFilterNetlink(const char *ifname G_GNUC_UNUSED,
+                                      const virMacAddr *ifmac_ptr G_GNUC_UNUSED,
+                                      unsigned int id G_GNUC_UNUSED)
+{
+    return -2;
+}
+
+#endif /* !(defined(__linux__) && defined(HAVE_LIBNL)) */
+
 /**
  * virNetDevBandwidthManipulateFilter:
  * @ifname: interface to operate on
@@ -227,6 +867,12 @@ virNetDevBandwidthSet(const char *ifname,
         tx = bandwidth->out;
     }
 
+    /* Program the whole tree in one go if possible */
+    if ((ret = virNetDevBandwidthSetNetlink(ifname, rx, tx,
+                                            hierarchical_class)) != -2)
+        goto cleanup;
+    ret = -1;
+
     virNetDevBandwidthClear(ifname);
 
     if (tx && tx->average) {
@@ -568,6 +1214,11 @@ virNetDevBandwidthPlug(const char *brname,
         return -1;
     }
 
+    if ((ret = virNetDevBandwidthPlugNetlink(brname, net_bandwidth, ifmac_ptr,
+                                             bandwidth, id)) != -2)
+        return ret;
+    ret = -1;
+
     class_id = g_strdup_printf("1:%x", id);
     qdisc_id = g_strdup_printf("%x:", id);
     floor = g_strdup_printf("%llukbps", bandwidth->in->floor);
@@ -691,6 +1342,11 @@ virNetDevBandwidthUpdateRate(const char *ifname,
     char *rate = NULL;
     char *ceil = NULL;
 
+    if ((ret = virNetDevBandwidthUpdateRateNetlink(ifname, id, bandwidth,
+                                                   new_rate)) != -2)
+        return ret;
+    ret = -1;
+
     class_id = g_strdup_printf("1:%x", id);
     rate = g_strdup_printf("%llukbps", new_rate);
     ceil = g_strdup_printf("%llukbps", bandwidth->in->peak ?
@@ -741,6 +1397,11 @@ virNetDevBandwidthUpdateFilter(const char *ifname,
     int ret = -1;
     char *class_id = NULL;
 
+    if ((ret = virNetDevBandwidthUpdateFilterNetlink(ifname, ifmac_ptr,
+                                                     id)) != -2)
+        return ret;
+    ret = -1;
+
     class_id = g_strdup_printf("1:%x", id);
 
     if (virNetDevBandwidthManipulateFilter(ifname, ifmac_ptr, id,
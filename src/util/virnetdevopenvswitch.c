@@ -291,29 +291,17 @@ int virNetDevOpenvswitchSetMigrateData(char *migrate, const char *ifname)
 }
 
 
-/**
- * virNetDevOpenvswitchInterfaceParseStats:
- * @json: Input string in JSON format
- * @stats: parsed stats
- *
- * For given input string @json parse interface statistics and store them into
- * @stats.
- *
- * Returns: 0 on success,
- *         -1 otherwise (with error reported).
- */
-int
-virNetDevOpenvswitchInterfaceParseStats(const char *json,
-                                        virDomainInterfaceStatsPtr stats)
+static int
+virNetDevOpenvswitchInterfaceParseStatsMap(virJSONValuePtr jsonStats,
+                                           virDomainInterfaceStatsPtr stats)
 {
-    g_autoptr(virJSONValue) jsonStats = NULL;
     virJSONValuePtr jsonMap = NULL;
     size_t i;
 
     stats->rx_bytes = stats->rx_packets = stats->rx_errs = stats->rx_drop = -1;
     stats->tx_bytes = stats->tx_packets = stats->tx_errs = stats->tx_drop = -1;
 
-    if (!(jsonStats = virJSONValueFromString(json)) ||
+    if (!jsonStats ||
         !virJSONValueIsArray(jsonStats) ||
         !(jsonMap = virJSONValueArrayGet(jsonStats, 1))) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -364,6 +352,41 @@ virNetDevOpenvswitchInterfaceParseStats(const char *json,
     return 0;
 }
 
+
+/**
+ * virNetDevOpenvswitchInterfaceParseStats:
+ * @json: Input string in JSON format
+ * @stats: parsed stats
+ *
+ * For given input string @json parse interface statistics and store them into
+ * @stats.
+ *
+ * Returns: 0 on success,
+ *         -1 otherwise (with error reported).
+ */
+int
+virNetDevOpenvswitchInterfaceParseStats(const char *json,
+                                        virDomainInterfaceStatsPtr stats)
+{
+    g_autoptr(virJSONValue) jsonStats = virJSONValueFromString(json);
+
+    return virNetDevOpenvswitchInterfaceParseStatsMap(jsonStats, stats);
+}
+
+
+static bool
+virNetDevOpenvswitchInterfaceStatsEmpty(virDomainInterfaceStatsPtr stats)
+{
+    return stats->rx_bytes == -1 &&
+        stats->rx_packets == -1 &&
+        stats->rx_errs == -1 &&
+        stats->rx_drop == -1 &&
+        stats->tx_bytes == -1 &&
+        stats->tx_packets == -1 &&
+        stats->tx_errs == -1 &&
+        stats->tx_drop == -1;
+}
+
 /**
  * virNetDevOpenvswitchInterfaceStats:
  * @ifname: the name of the interface
@@ -406,14 +429,7 @@ virNetDevOpenvswitchInterfaceStats(const char *ifname,
     if (virNetDevOpenvswitchInterfaceParseStats(output, stats) < 0)
         return -1;
 
-    if (stats->rx_bytes == -1 &&
-        stats->rx_packets == -1 &&
-        stats->rx_errs == -1 &&
-        stats->rx_drop == -1 &&
-        stats->tx_bytes == -1 &&
-        stats->tx_packets == -1 &&
-        stats->tx_errs == -1 &&
-        stats->tx_drop == -1) {
+    if (virNetDevOpenvswitchInterfaceStatsEmpty(stats)) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("Interface doesn't have any statistics"));
         return -1;
@@ -423,6 +439,82 @@ virNetDevOpenvswitchInterfaceStats(const char *ifname,
 }
 
 
+/**
+ * virNetDevOpenvswitchInterfaceStatsAll:
+ *
+ * Retrieves the stats of all OVS interfaces with a single ovs-vsctl
+ * call, rather than one call per interface as
+ * virNetDevOpenvswitchInterfaceStats does. Interfaces which don't have
+ * any statistics are left out.
+ *
+ * Returns a hash table mapping interface names to their stats, in the
+ * same form as virNetDevOpenvswitchInterfaceStats returns them, or NULL
+ * in case of failure
+ */
+virHashTablePtr
+virNetDevOpenvswitchInterfaceStatsAll(void)
+{
+    g_autoptr(virCommand) cmd = NULL;
+    g_autofree char *output = NULL;
+    g_autoptr(virJSONValue) json = NULL;
+    g_autoptr(virHashTable) table = NULL;
+    virJSONValuePtr data;
+    size_t i;
+
+    cmd = virCommandNew(OVSVSCTL);
+    virNetDevOpenvswitchAddTimeout(cmd);
+    virCommandAddArgList(cmd, "--format=json", "--columns=name,statistics",
+                         "list", "Interface", NULL);
+    virCommandSetOutputBuffer(cmd, &output);
+
+    /* The above command returns a JSON object, for instance:
+     *    {"data":[["vhost-user1",["map",[["rx_bytes",0],...]]],...],
+     *     "headings":["name","statistics"]}
+     */
+
+    if (virCommandRun(cmd, NULL) < 0)
+        return NULL;
+
+    if (!(json = virJSONValueFromString(output)) ||
+        !(data = virJSONValueObjectGetArray(json, "data"))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to parse ovs-vsctl output"));
+        return NULL;
+    }
+
+    if (!(table = virHashCreate(32, virHashValueFree)))
+        return NULL;
+
+    for (i = 0; i < virJSONValueArraySize(data); i++) {
+        virJSONValuePtr row = virJSONValueArrayGet(data, i);
+        g_autofree virDomainInterfaceStatsPtr stats = NULL;
+        const char *name;
+
+        if (!row || !virJSONValueIsArray(row) ||
+            virJSONValueArraySize(row) != 2 ||
+            !(name = virJSONValueGetString(virJSONValueArrayGet(row, 0)))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Malformed ovs-vsctl output"));
+            return NULL;
+        }
+
+        stats = g_new0(virDomainInterfaceStats, 1);
+        if (virNetDevOpenvswitchInterfaceParseStatsMap(virJSONValueArrayGet(row, 1),
+                                                       stats) < 0)
+            return NULL;
+
+        if (virNetDevOpenvswitchInterfaceStatsEmpty(stats))
+            continue;
+
+        if (virHashUpdateEntry(table, name, stats) < 0)
+            return NULL;
+        stats = NULL;
+    }
+
+    return g_steal_pointer(&table);
+}
+
+
 /**
  * virNetDeOpenvswitchGetMaster:
  * @ifname: name of interface we're interested in
@@ -23,6 +23,7 @@
 #include "internal.h"
 #include "virnetdevvportprofile.h"
 #include "virnetdevvlan.h"
+#include "virhash.h"
 
 #define VIR_NETDEV_OVS_DEFAULT_TIMEOUT 5
 
@@ -57,6 +58,8 @@ int virNetDevOpenvswitchInterfaceStats(const char *ifname,
                                        virDomainInterfaceStatsPtr stats)
     ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
 
+virHashTablePtr virNetDevOpenvswitchInterfaceStatsAll(void);
+
 int virNetDevOpenvswitchInterfaceGetMaster(const char *ifname, char **master)
     ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
 
@@ -24,6 +24,7 @@
 #include "virnetdevbridge.h"
 #include "virnetdevmidonet.h"
 #include "virnetdevopenvswitch.h"
+#include "virnetlink.h"
 #include "virerror.h"
 #include "virfile.h"
 #include "viralloc.h"
@@ -49,6 +50,10 @@
 #if defined(HAVE_GETIFADDRS) && defined(AF_LINK)
 # include <ifaddrs.h>
 #endif
+#if defined(__linux__) && defined(HAVE_LIBNL)
+# include <linux/rtnetlink.h>
+# include <linux/if_link.h>
+#endif
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -631,6 +636,70 @@ virNetDevTapReattachBridge(const char *tapname,
 }
 
 
+/*
+ * Does what setting the MAC of @tapname, virNetDevTapAttachBridge and
+ * virNetDevSetOnline do for a plain bridge, but in a single netlink
+ * exchange rather than one ioctl for every step.
+ *
+ * Returns 0 on success, -1 on failure, -2 if netlink is not available.
+ */
+static int
+virNetDevTapAttachBridgeBatch(const char *tapname,
+                              const char *brname,
+                              const virMacAddr *tapmac,
+                              virTristateBool isolatedPort,
+                              unsigned int mtu,
+                              unsigned int *actualMTU,
+                              bool online)
+{
+    g_autoptr(virNetlinkBatch) batch = virNetlinkBatchNew();
+    /* An isolated port must not see any traffic before it is isolated */
+    bool isolated = isolatedPort == VIR_TRISTATE_BOOL_YES;
+    int rc;
+
+    /* As in virNetDevTapAttachBridge, the MTU is set before the device
+     * is attached to the bridge */
+    if (mtu == 0) {
+        int brMTU = virNetDevGetMTU(brname);
+
+        if (brMTU < 0)
+            return -1;
+        mtu = brMTU;
+    }
+
+    if (virNetlinkBatchLinkSetMAC(batch, tapname, tapmac) < 0 ||
+        virNetlinkBatchLinkSetMTU(batch, tapname, mtu) < 0 ||
+        virNetlinkBatchLinkSetMaster(batch, tapname, brname) < 0)
+        return -1;
+
+    if (!(online && isolated) &&
+        virNetlinkBatchLinkSetOnline(batch, tapname, online) < 0)
+        return -1;
+
+    if ((rc = virNetlinkBatchRun(batch)) < 0)
+        return rc;
+
+    if (actualMTU)
+        *actualMTU = mtu;
+
+    if (isolated) {
+        if (virNetDevBridgePortSetIsolated(brname, tapname, true) < 0) {
+            virErrorPtr err;
+
+            virErrorPreserveLast(&err);
+            ignore_value(virNetDevBridgeRemovePort(brname, tapname));
+            virErrorRestore(&err);
+            return -1;
+        }
+
+        if (online && virNetDevSetOnline(tapname, true) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
 /**
  * virNetDevTapCreateInBridgePort:
  * @brname: the bridge name
@@ -681,6 +750,7 @@ int virNetDevTapCreateInBridgePort(const char *brname,
 {
     virMacAddr tapmac;
     size_t i;
+    int rc = -2;
 
     if (virNetDevTapCreate(ifname, tunpath, tapfd, tapfdSize, flags) < 0)
         return -1;
@@ -707,17 +777,27 @@ int virNetDevTapCreateInBridgePort(const char *brname,
             tapmac.addr[0] = 0xFE;
     }
 
-    if (virNetDevSetMAC(*ifname, &tapmac) < 0)
-        goto error;
+    if (!virtPortProfile)
+        rc = virNetDevTapAttachBridgeBatch(*ifname, brname, &tapmac,
+                                           isolatedPort, mtu, actualMTU,
+                                           !!(flags & VIR_NETDEV_TAP_CREATE_IFUP));
 
-    if (virNetDevTapAttachBridge(*ifname, brname, macaddr, vmuuid,
-                                 virtPortProfile, virtVlan,
-                                 isolatedPort, mtu, actualMTU) < 0) {
+    if (rc == -1)
         goto error;
-    }
 
-    if (virNetDevSetOnline(*ifname, !!(flags & VIR_NETDEV_TAP_CREATE_IFUP)) < 0)
-        goto error;
+    if (rc == -2) {
+        if (virNetDevSetMAC(*ifname, &tapmac) < 0)
+            goto error;
+
+        if (virNetDevTapAttachBridge(*ifname, brname, macaddr, vmuuid,
+                                     virtPortProfile, virtVlan,
+                                     isolatedPort, mtu, actualMTU) < 0) {
+            goto error;
+        }
+
+        if (virNetDevSetOnline(*ifname, !!(flags & VIR_NETDEV_TAP_CREATE_IFUP)) < 0)
+            goto error;
+    }
 
     if (virNetDevSetCoalesce(*ifname, coalesce, false) < 0)
         goto error;
@@ -914,3 +994,218 @@ virNetDevTapInterfaceStats(const char *ifname G_GNUC_UNUSED,
 }
 
 #endif /* __linux__ */
+
+
+/* Stores the host view stats @host into @stats, see
+ * virNetDevTapInterfaceStats for @swapped */
+static void
+virNetDevTapInterfaceStatsCopy(const virDomainInterfaceStats *host,
+                               virDomainInterfaceStatsPtr stats,
+                               bool swapped)
+{
+    if (swapped) {
+        stats->rx_bytes = host->tx_bytes;
+        stats->rx_packets = host->tx_packets;
+        stats->rx_errs = host->tx_errs;
+        stats->rx_drop = host->tx_drop;
+        stats->tx_bytes = host->rx_bytes;
+        stats->tx_packets = host->rx_packets;
+        stats->tx_errs = host->rx_errs;
+        stats->tx_drop = host->rx_drop;
+    } else {
+        *stats = *host;
+    }
+}
+
+
+#if defined(__linux__) && defined(HAVE_LIBNL)
+static int
+virNetDevTapInterfaceStatsAllCallback(struct nlmsghdr *resp,
+                                      void *opaque)
+{
+    virHashTablePtr table = opaque;
+    struct nlattr *tb[IFLA_MAX + 1] = { NULL };
+    struct rtnl_link_stats64 link;
+    g_autofree virDomainInterfaceStatsPtr stats = NULL;
+
+    if (resp->nlmsg_type != RTM_NEWLINK)
+        return 0;
+
+    if (nlmsg_parse(resp, sizeof(struct ifinfomsg), tb, IFLA_MAX, NULL) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("malformed netlink response message"));
+        return -1;
+    }
+
+    if (!tb[IFLA_IFNAME] || !tb[IFLA_STATS64] ||
+        nla_len(tb[IFLA_STATS64]) < (int)sizeof(link))
+        return 0;
+
+    /* the attribute payload is only guaranteed to be 4 bytes aligned */
+    memcpy(&link, nla_data(tb[IFLA_STATS64]), sizeof(link));
+
+    /* Match the fields of /proc/net/dev which
+     * virNetDevTapInterfaceStats reports */
+    stats = g_new0(virDomainInterfaceStats, 1);
+    stats->rx_bytes = link.rx_bytes;
+    stats->rx_packets = link.rx_packets;
+    stats->rx_errs = link.rx_errors;
+    stats->rx_drop = link.rx_dropped + link.rx_missed_errors;
+    stats->tx_bytes = link.tx_bytes;
+    stats->tx_packets = link.tx_packets;
+    stats->tx_errs = link.tx_errors;
+    stats->tx_drop = link.tx_dropped;
+
+    if (virHashUpdateEntry(table, nla_get_string(tb[IFLA_IFNAME]), stats) < 0)
+        return -1;
+    stats = NULL;
+
+    return 0;
+}
+
+
+static int
+virNetDevTapInterfaceStatsAllFill(virHashTablePtr table)
+{
+    struct ifinfomsg ifinfo = {
+        .ifi_family = AF_UNSPEC,
+    };
+    g_autoptr(virNetlinkMsg) nl_msg = NULL;
+
+    if (!(nl_msg = nlmsg_alloc_simple(RTM_GETLINK,
+                                      NLM_F_REQUEST | NLM_F_DUMP))) {
+        virReportOOMError();
+        return -1;
+    }
+
+    if (nlmsg_append(nl_msg, &ifinfo, sizeof(ifinfo), NLMSG_ALIGNTO) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("allocated netlink buffer is too small"));
+        return -1;
+    }
+
+    return virNetlinkDumpCommand(nl_msg, virNetDevTapInterfaceStatsAllCallback,
+                                 0, 0, NETLINK_ROUTE, 0, table);
+}
+#elif defined(__linux__)
+static int
+virNetDevTapInterfaceStatsAllFill(virHashTablePtr table)
+{
+    FILE *fp;
+    char line[256];
+    int ret = -1;
+
+    if (!(fp = fopen("/proc/net/dev", "r"))) {
+        virReportSystemError(errno, "%s",
+                             _("Could not open /proc/net/dev"));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        g_autofree virDomainInterfaceStatsPtr stats = NULL;
+        long long dummy;
+        char *name = line;
+        char *colon;
+
+        if (!(colon = strchr(line, ':')))
+            continue;
+        *colon = '\0';
+
+        while (g_ascii_isspace(*name))
+            name++;
+
+        stats = g_new0(virDomainInterfaceStats, 1);
+        if (sscanf(colon + 1,
+                   "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
+                   &stats->rx_bytes, &stats->rx_packets,
+                   &stats->rx_errs, &stats->rx_drop,
+                   &dummy, &dummy, &dummy, &dummy,
+                   &stats->tx_bytes, &stats->tx_packets,
+                   &stats->tx_errs, &stats->tx_drop,
+                   &dummy, &dummy, &dummy, &dummy) != 16)
+            continue;
+
+        if (virHashUpdateEntry(table, name, stats) < 0)
+            goto cleanup;
+        stats = NULL;
+    }
+
+    ret = 0;
+
+ cleanup:
+    VIR_FORCE_FCLOSE(fp);
+    return ret;
+}
+#else
+static int
+virNetDevTapInterfaceStatsAllFill(virHashTablePtr table G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                   _("host-wide interface stats not implemented on this platform"));
+    return -1;
+}
+#endif
+
+
+/**
+ * virNetDevTapInterfaceStatsAll:
+ *
+ * Fetch RX/TX statistics of all interfaces of the host at once, with
+ * a single netlink dump where possible. This is much cheaper than
+ * calling virNetDevTapInterfaceStats for many interfaces, each of
+ * which has to walk the whole list of interfaces again.
+ *
+ * Returns a hash table mapping interface names to their statistics
+ * from the host POV, to be passed to virNetDevTapInterfaceStatsLookup,
+ * or NULL on error.
+ */
+virHashTablePtr
+virNetDevTapInterfaceStatsAll(void)
+{
+    g_autoptr(virHashTable) table = NULL;
+
+    if (!(table = virHashCreate(32, virHashValueFree)))
+        return NULL;
+
+    if (virNetDevTapInterfaceStatsAllFill(table) < 0)
+        return NULL;
+
+    return g_steal_pointer(&table);
+}
+
+
+/**
+ * virNetDevTapInterfaceStatsLookup:
+ * @table: statistics from virNetDevTapInterfaceStatsAll
+ * @ifname: interface
+ * @stats: where to store statistics
+ * @swapped: whether to swap RX/TX fields
+ *
+ * Look up the RX/TX statistics of @ifname in @table and store them at
+ * @stats, with the same semantics as virNetDevTapInterfaceStats.
+ *
+ * Returns 0 on success, -1 otherwise (with error reported).
+ */
+int
+virNetDevTapInterfaceStatsLookup(virHashTablePtr table,
+                                 const char *ifname,
+                                 virDomainInterfaceStatsPtr stats,
+                                 bool swapped)
+{
+    virDomainInterfaceStatsPtr host;
+
+    if (!ifname) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Interface name not provided"));
+        return -1;
+    }
+
+    if (!(host = virHashLookup(table, ifname))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Interface '%s' not found"), ifname);
+        return -1;
+    }
+
+    virNetDevTapInterfaceStatsCopy(host, stats, swapped);
+    return 0;
+}
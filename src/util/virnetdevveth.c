@@ -27,6 +27,7 @@
 #include "virfile.h"
 #include "virstring.h"
 #include "virnetdev.h"
+#include "virnetlink.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -75,12 +76,55 @@ static int virNetDevVethGetFreeNum(int startDev)
     return -1;
 }
 
+/*
+ * Creates the veth pair @veth1 and @veth2. @status is set to zero on
+ * success, non-zero if the pair could not be created, e.g. because one
+ * of the names is taken already.
+ *
+ * Returns -1 on fatal error, 0 otherwise.
+ */
+static int
+virNetDevVethCreateInternal(const char *veth1,
+                            const char *veth2,
+                            int *status)
+{
+#if defined(__linux__) && defined(HAVE_LIBNL)
+    virNetlinkNewLinkData data = {
+        .veth_peer = veth2,
+    };
+    int error = 0;
+
+    if (virNetlinkNewLink(veth1, "veth", &data, &error) < 0) {
+        if (error == 0)
+            return -1;
+
+        if (error != -EEXIST) {
+            virReportSystemError(-error,
+                                 _("error creating veth pair %s/%s"),
+                                 veth1, veth2);
+            return -1;
+        }
+    }
+
+    *status = error;
+    return 0;
+#else
+    g_autoptr(virCommand) cmd = virCommandNew("ip");
+
+    virCommandAddArgList(cmd, "link", "add", veth1,
+                         "type", "veth", "peer", "name", veth2,
+                         NULL);
+
+    return virCommandRun(cmd, status);
+#endif
+}
+
 /**
  * virNetDevVethCreate:
  * @veth1: pointer to name for parent end of veth pair
  * @veth2: pointer to return name for container end of veth pair
  *
- * Creates a veth device pair using the ip command:
+ * Creates a veth device pair, just like the ip command:
  * ip link add veth1 type veth peer name veth2
  * If veth1 points to NULL on entry, it will be a valid interface on
  * return.  veth2 should point to NULL on entry.
@@ -95,7 +139,7 @@ static int virNetDevVethGetFreeNum(int startDev)
  *          is no longer visible in the parent namespace.  This seems to
  *          confuse the name assignment causing it to fail with File exists.
  *       Because of these issues, this function currently allocates names
- *       prior to using the ip command, and returns any allocated names
+ *       prior to creating the devices, and returns any allocated names
  *       to the caller.
  *
  * Returns 0 on success or -1 in case of error
@@ -116,7 +160,6 @@ int virNetDevVethCreate(char** veth1, char** veth2)
     for (i = 0; i < MAX_VETH_RETRIES; i++) {
         g_autofree char *veth1auto = NULL;
         g_autofree char *veth2auto = NULL;
-        g_autoptr(virCommand) cmd = NULL;
 
         int status;
         if (!*veth1) {
@@ -136,14 +179,9 @@ int virNetDevVethCreate(char** veth1, char** veth2)
             vethNum = veth2num + 1;
         }
 
-        cmd = virCommandNew("ip");
-        virCommandAddArgList(cmd, "link", "add",
-                             *veth1 ? *veth1 : veth1auto,
-                             "type", "veth", "peer", "name",
-                             *veth2 ? *veth2 : veth2auto,
-                             NULL);
-
-        if (virCommandRun(cmd, &status) < 0)
+        if (virNetDevVethCreateInternal(*veth1 ? *veth1 : veth1auto,
+                                        *veth2 ? *veth2 : veth2auto,
+                                        &status) < 0)
             goto cleanup;
 
         if (status == 0) {
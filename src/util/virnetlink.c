@@ -34,6 +34,10 @@
 #include "viralloc.h"
 #include "virsocket.h"
 
+#if defined(__linux__) && defined(HAVE_LIBNL)
+# include <linux/veth.h>
+#endif
+
 #define VIR_FROM_THIS VIR_FROM_NET
 
 VIR_LOG_INIT("util.netlink");
@@ -355,6 +359,390 @@ virNetlinkDumpCommand(struct nl_msg *nl_msg,
     return 0;
 }
 
+
+/**
+ * virNetlinkCommandBatch:
+ * @msgs:     array of netlink request messages
+ * @nmsgs:    number of messages in @msgs
+ * @protocol: netlink protocol
+ * @errors:   array of @nmsgs integers receiving the result of each request
+ *
+ * Send all requests in @msgs to the kernel in a single datagram and
+ * wait until each of them has been acknowledged. The kernel processes
+ * the requests in order, so a request can rely on the ones before it,
+ * but a failing request doesn't stop the ones after it from being
+ * processed. The outcome of each request, i.e. 0 or a negative errno
+ * value, is stored in @errors; no error is reported for these, leaving
+ * it up to the caller to handle them.
+ *
+ * Returns 0 if all requests were answered, -1 on error.
+ */
+int
+virNetlinkCommandBatch(struct nl_msg **msgs, size_t nmsgs,
+                       unsigned int protocol, int *errors)
+{
+    struct sockaddr_nl nladdr = {
+            .nl_family = AF_NETLINK,
+            .nl_pid    = 0,
+            .nl_groups = 0,
+    };
+    g_autoptr(virNetlinkHandle) nlhandle = NULL;
+    g_autofree char *buf = NULL;
+    g_autofree bool *answered = NULL;
+    size_t buflen = 0;
+    size_t pending = nmsgs;
+    size_t i;
+    int fd;
+
+    if (protocol >= MAX_LINKS) {
+        virReportSystemError(EINVAL,
+                             _("invalid protocol argument: %d"), protocol);
+        return -1;
+    }
+
+    for (i = 0; i < nmsgs; i++)
+        buflen += NLMSG_ALIGN(nlmsg_hdr(msgs[i])->nlmsg_len);
+
+    buf = g_new0(char, buflen);
+    answered = g_new0(bool, nmsgs);
+
+    buflen = 0;
+    for (i = 0; i < nmsgs; i++) {
+        struct nlmsghdr *nlmsg = nlmsg_hdr(msgs[i]);
+
+        /* sequence numbers start at 1, 0 is used by the kernel */
+        nlmsg->nlmsg_flags |= NLM_F_ACK;
+        nlmsg->nlmsg_seq = i + 1;
+        nlmsg->nlmsg_pid = getpid();
+        memcpy(buf + buflen, nlmsg, nlmsg->nlmsg_len);
+        buflen += NLMSG_ALIGN(nlmsg->nlmsg_len);
+
+        errors[i] = 0;
+    }
+
+    if (!(nlhandle = virNetlinkCreateSocket(protocol)))
+        return -1;
+
+    if ((fd = nl_socket_get_fd(nlhandle)) < 0) {
+        virReportSystemError(errno,
+                             "%s", _("cannot get netlink socket fd"));
+        return -1;
+    }
+
+    if (nl_sendto(nlhandle, buf, buflen) < 0) {
+        virReportSystemError(errno,
+                             "%s", _("cannot send to netlink socket"));
+        return -1;
+    }
+
+    while (pending > 0) {
+        g_autofree struct nlmsghdr *resp = NULL;
+        struct nlmsghdr *msg;
+        struct nlmsgerr *err;
+        struct pollfd fds[1] = { { .fd = fd, .events = POLLIN } };
+        int len;
+        int n;
+
+        if ((n = poll(fds, G_N_ELEMENTS(fds), NETLINK_ACK_TIMEOUT_S)) <= 0) {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN))
+                continue;
+            virReportSystemError(n < 0 ? errno : ETIMEDOUT, "%s",
+                                 _("no valid netlink response was received"));
+            return -1;
+        }
+
+        len = nl_recv(nlhandle, &nladdr, (unsigned char **)&resp, NULL);
+        if (len <= 0) {
+            virReportSystemError(errno, "%s", _("nl_recv failed"));
+            return -1;
+        }
+
+        VIR_WARNINGS_NO_CAST_ALIGN
+        for (msg = resp; NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len)) {
+            VIR_WARNINGS_RESET
+            if (msg->nlmsg_type != NLMSG_ERROR)
+                continue;
+
+            if (msg->nlmsg_len < NLMSG_LENGTH(sizeof(*err)) ||
+                msg->nlmsg_seq == 0 || msg->nlmsg_seq > nmsgs) {
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("malformed netlink response message"));
+                return -1;
+            }
+
+            i = msg->nlmsg_seq - 1;
+            if (answered[i])
+                continue;
+
+            err = (struct nlmsgerr *)NLMSG_DATA(msg);
+            errors[i] = err->error;
+            answered[i] = true;
+            pending--;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * A batch of requests which are sent to the kernel at once, each of them
+ * with the error message to report in case it fails.
+ */
+typedef struct _virNetlinkBatchRequest virNetlinkBatchRequest;
+struct _virNetlinkBatchRequest {
+    struct nl_msg *msg;
+    char *errmsg;
+};
+
+struct _virNetlinkBatch {
+    size_t nreqs;
+    virNetlinkBatchRequest *reqs;
+};
+
+
+/**
+ * virNetlinkBatchNew:
+ *
+ * Create an empty batch of netlink requests. Requests are added with
+ * the virNetlinkBatchLink* functions and sent with virNetlinkBatchRun.
+ *
+ * Returns the new batch.
+ */
+virNetlinkBatchPtr
+virNetlinkBatchNew(void)
+{
+    return g_new0(virNetlinkBatch, 1);
+}
+
+
+void
+virNetlinkBatchFree(virNetlinkBatchPtr batch)
+{
+    size_t i;
+
+    if (!batch)
+        return;
+
+    for (i = 0; i < batch->nreqs; i++) {
+        nlmsg_free(batch->reqs[i].msg);
+        g_free(batch->reqs[i].errmsg);
+    }
+    g_free(batch->reqs);
+    g_free(batch);
+}
+
+
+/* Appends a request changing the link @ifname; @errmsg is consumed */
+static struct nl_msg *
+virNetlinkBatchLinkAdd(virNetlinkBatchPtr batch,
+                       const char *ifname,
+                       unsigned int ifflags,
+                       unsigned int ifchange,
+                       char *errmsg)
+{
+    struct ifinfomsg ifinfo = {
+        .ifi_family = AF_UNSPEC,
+        .ifi_flags = ifflags,
+        .ifi_change = ifchange,
+    };
+    virNetlinkBatchRequest req = { .errmsg = errmsg };
+
+    if (!(req.msg = nlmsg_alloc_simple(RTM_SETLINK, NLM_F_REQUEST))) {
+        virReportOOMError();
+        goto error;
+    }
+
+    if (nlmsg_append(req.msg, &ifinfo, sizeof(ifinfo), NLMSG_ALIGNTO) < 0 ||
+        nla_put(req.msg, IFLA_IFNAME, strlen(ifname) + 1, ifname) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("allocated netlink buffer is too small"));
+        goto error;
+    }
+
+    if (VIR_APPEND_ELEMENT_COPY(batch->reqs, batch->nreqs, req) < 0)
+        goto error;
+
+    return req.msg;
+
+ error:
+    if (req.msg)
+        nlmsg_free(req.msg);
+    g_free(errmsg);
+    return NULL;
+}
+
+
+/**
+ * virNetlinkBatchLinkSetMAC:
+ * @batch: batch of requests
+ * @ifname: interface name
+ * @macaddr: MAC address
+ *
+ * Add a request setting the MAC address of @ifname to @batch.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virNetlinkBatchLinkSetMAC(virNetlinkBatchPtr batch,
+                          const char *ifname,
+                          const virMacAddr *macaddr)
+{
+    struct nl_msg *nl_msg;
+
+    if (!(nl_msg = virNetlinkBatchLinkAdd(batch, ifname, 0, 0,
+                                          g_strdup_printf(_("Cannot set interface MAC on '%s'"),
+                                                          ifname))))
+        return -1;
+
+    NETLINK_MSG_PUT(nl_msg, IFLA_ADDRESS, VIR_MAC_BUFLEN, macaddr->addr);
+
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/**
+ * virNetlinkBatchLinkSetMTU:
+ * @batch: batch of requests
+ * @ifname: interface name
+ * @mtu: MTU value
+ *
+ * Add a request setting the MTU of @ifname to @batch.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virNetlinkBatchLinkSetMTU(virNetlinkBatchPtr batch,
+                          const char *ifname,
+                          int mtu)
+{
+    struct nl_msg *nl_msg;
+    uint32_t val = mtu;
+
+    if (!(nl_msg = virNetlinkBatchLinkAdd(batch, ifname, 0, 0,
+                                          g_strdup_printf(_("Cannot set interface MTU on '%s'"),
+                                                          ifname))))
+        return -1;
+
+    NETLINK_MSG_PUT(nl_msg, IFLA_MTU, sizeof(val), &val);
+
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/**
+ * virNetlinkBatchLinkSetMaster:
+ * @batch: batch of requests
+ * @ifname: interface name
+ * @master: name of the bridge to add @ifname to
+ *
+ * Add a request making @ifname a port of @master to @batch.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virNetlinkBatchLinkSetMaster(virNetlinkBatchPtr batch,
+                             const char *ifname,
+                             const char *master)
+{
+    struct nl_msg *nl_msg;
+    int ifindex;
+    uint32_t val;
+
+    if (virNetDevGetIndex(master, &ifindex) < 0)
+        return -1;
+    val = ifindex;
+
+    if (!(nl_msg = virNetlinkBatchLinkAdd(batch, ifname, 0, 0,
+                                          g_strdup_printf(_("Unable to add bridge %s port %s"),
+                                                          master, ifname))))
+        return -1;
+
+    NETLINK_MSG_PUT(nl_msg, IFLA_MASTER, sizeof(val), &val);
+
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/**
+ * virNetlinkBatchLinkSetOnline:
+ * @batch: batch of requests
+ * @ifname: interface name
+ * @online: true for up, false for down
+ *
+ * Add a request bringing @ifname up or down to @batch.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virNetlinkBatchLinkSetOnline(virNetlinkBatchPtr batch,
+                             const char *ifname,
+                             bool online)
+{
+    if (!virNetlinkBatchLinkAdd(batch, ifname, online ? IFF_UP : 0, IFF_UP,
+                                g_strdup_printf(_("Cannot set interface flags on '%s'"),
+                                                ifname)))
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * virNetlinkBatchRun:
+ * @batch: batch of requests
+ *
+ * Send all requests in @batch to the kernel at once and collect their
+ * acknowledgements. The requests are processed in the order they were
+ * added; the error of the first failing one is reported.
+ *
+ * Returns 0 on success, -1 on error, or -2 if netlink is not available
+ * on this platform, in which case no error is reported.
+ */
+int
+virNetlinkBatchRun(virNetlinkBatchPtr batch)
+{
+    g_autofree struct nl_msg **msgs = NULL;
+    g_autofree int *errors = NULL;
+    size_t i;
+
+    if (batch->nreqs == 0)
+        return 0;
+
+    msgs = g_new0(struct nl_msg *, batch->nreqs);
+    errors = g_new0(int, batch->nreqs);
+
+    for (i = 0; i < batch->nreqs; i++)
+        msgs[i] = batch->reqs[i].msg;
+
+    if (virNetlinkCommandBatch(msgs, batch->nreqs, NETLINK_ROUTE, errors) < 0)
+        return -1;
+
+    for (i = 0; i < batch->nreqs; i++) {
+        if (errors[i] < 0) {
+            virReportSystemError(-errors[i], "%s", batch->reqs[i].errmsg);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 /**
  * virNetlinkDumpLink:
  *
@@ -535,6 +923,20 @@ virNetlinkNewLink(const char *ifname,
         NETLINK_MSG_NEST_END(nl_msg, infodata);
     }
 
+    if (STREQ(type, "veth") && extra_args && extra_args->veth_peer) {
+        struct ifinfomsg peerinfo = { .ifi_family = AF_UNSPEC };
+        struct nlattr *peer = NULL;
+
+        NETLINK_MSG_NEST_START(nl_msg, infodata, IFLA_INFO_DATA);
+        NETLINK_MSG_NEST_START(nl_msg, peer, VETH_INFO_PEER);
+        if (nlmsg_append(nl_msg, &peerinfo, sizeof(peerinfo), NLMSG_ALIGNTO) < 0)
+            goto buffer_too_small;
+        NETLINK_MSG_PUT(nl_msg, IFLA_IFNAME, (strlen(extra_args->veth_peer) + 1),
+                        extra_args->veth_peer);
+        NETLINK_MSG_NEST_END(nl_msg, peer);
+        NETLINK_MSG_NEST_END(nl_msg, infodata);
+    }
+
     NETLINK_MSG_NEST_END(nl_msg, linkinfo);
 
     if (extra_args) {
@@ -1258,6 +1660,78 @@ virNetlinkDumpCommand(struct nl_msg *nl_msg G_GNUC_UNUSED,
     return -1;
 }
 
+int
+virNetlinkCommandBatch(struct nl_msg **msgs G_GNUC_UNUSED,
+                       size_t nmsgs G_GNUC_UNUSED,
+                       unsigned int protocol G_GNUC_UNUSED,
+                       int *errors G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return -1;
+}
+
+/* Without netlink a batch never holds any request */
+struct _virNetlinkBatch {
+    size_t nreqs;
+};
+
+
+virNetlinkBatchPtr
+virNetlinkBatchNew(void)
+{
+    return g_new0(virNetlinkBatch, 1);
+}
+
+
+void
+virNetlinkBatchFree(virNetlinkBatchPtr batch)
+{
+    g_free(batch);
+}
+
+
+int
+virNetlinkBatchLinkSetMAC(virNetlinkBatchPtr batch G_GNUC_UNUSED,
+                          const char *ifname G_GNUC_UNUSED,
+                          const virMacAddr *macaddr G_GNUC_UNUSED)
+{
+    return 0;
+}
+
+
+int
+virNetlinkBatchLinkSetMTU(virNetlinkBatchPtr batch G_GNUC_UNUSED,
+                          const char *ifname G_GNUC_UNUSED,
+                          int mtu G_GNUC_UNUSED)
+{
+    return 0;
+}
+
+
+int
+virNetlinkBatchLinkSetMaster(virNetlinkBatchPtr batch G_GNUC_UNUSED,
+                             const char *ifname G_GNUC_UNUSED,
+                             const char *master G_GNUC_UNUSED)
+{
+    return 0;
+}
+
+
+int
+virNetlinkBatchLinkSetOnline(virNetlinkBatchPtr batch G_GNUC_UNUSED,
+                             const char *ifname G_GNUC_UNUSED,
+                             bool online G_GNUC_UNUSED)
+{
+    return 0;
+}
+
+
+int
+virNetlinkBatchRun(virNetlinkBatchPtr batch G_GNUC_UNUSED)
+{
+    return -2;
+}
+
 int
 virNetlinkDumpLink(const char *ifname G_GNUC_UNUSED,
                    int ifindex G_GNUC_UNUSED,
@@ -69,6 +69,10 @@ int virNetlinkCommand(struct nl_msg *nl_msg,
                       uint32_t src_pid, uint32_t dst_pid,
                       unsigned int protocol, unsigned int groups);
 
+int virNetlinkCommandBatch(struct nl_msg **msgs, size_t nmsgs,
+                           unsigned int protocol, int *errors)
+    G_GNUC_NO_INLINE;
+
 typedef int (*virNetlinkDumpCallback)(struct nlmsghdr *resp,
                                       void *data);
 
@@ -84,6 +88,7 @@ struct _virNetlinkNewLinkData {
     const int *ifindex;             /* The index for the 'link' device */
     const virMacAddr *mac;          /* The MAC address of the device */
     const uint32_t *macvlan_mode;   /* The mode of macvlan */
+    const char *veth_peer;          /* The name of the other end of a veth */
 };
 
 int virNetlinkNewLink(const char *ifname,
@@ -104,6 +109,28 @@ int virNetlinkDumpLink(const char *ifname, int ifindex,
 int
 virNetlinkGetNeighbor(void **nlData, uint32_t src_pid, uint32_t dst_pid);
 
+typedef struct _virNetlinkBatch virNetlinkBatch;
+typedef virNetlinkBatch *virNetlinkBatchPtr;
+
+virNetlinkBatchPtr virNetlinkBatchNew(void);
+void virNetlinkBatchFree(virNetlinkBatchPtr batch);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virNetlinkBatch, virNetlinkBatchFree);
+
+int virNetlinkBatchLinkSetMAC(virNetlinkBatchPtr batch,
+                              const char *ifname,
+                              const virMacAddr *macaddr);
+int virNetlinkBatchLinkSetMTU(virNetlinkBatchPtr batch,
+                              const char *ifname,
+                              int mtu);
+int virNetlinkBatchLinkSetMaster(virNetlinkBatchPtr batch,
+                                 const char *ifname,
+                                 const char *master);
+int virNetlinkBatchLinkSetOnline(virNetlinkBatchPtr batch,
+                                 const char *ifname,
+                                 bool online);
+int virNetlinkBatchRun(virNetlinkBatchPtr batch);
+
 typedef void (*virNetlinkEventHandleCallback)(struct nlmsghdr *,
                                               unsigned int length,
                                               struct sockaddr_nl *peer,
@@ -47,6 +47,7 @@
 #include "virfile.h"
 #include "virhostmem.h"
 #include "virutil.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -579,6 +580,118 @@ virNumaGetHugePageInfoDir(char **path, int node)
     }
 }
 
+/*
+ * The huge page sizes a node supports are fixed when the kernel boots,
+ * so rather than listing the sysfs directory of a node every time its
+ * pages are queried, remember what it contained. Only the sizes are
+ * kept, the pool sizes and free counts are always read afresh. The
+ * entry at index 0 holds the overall system info (node -1).
+ */
+typedef struct _virNumaHugePageSizes virNumaHugePageSizes;
+struct _virNumaHugePageSizes {
+    bool valid;
+    unsigned int *sizes;
+    size_t nsizes;
+};
+
+static virMutex virNumaHugePageSizesLock = VIR_MUTEX_INITIALIZER;
+static virNumaHugePageSizes *virNumaHugePageSizesCache;
+static size_t virNumaHugePageSizesCacheLen;
+
+static int
+virNumaListHugePageSizes(int node,
+                         unsigned int **sizes,
+                         size_t *nsizes)
+{
+    int ret = -1;
+    DIR *dir = NULL;
+    int direrr = 0;
+    struct dirent *entry;
+    g_autofree char *path = NULL;
+    g_autofree unsigned int *tmp = NULL;
+    size_t ntmp = 0;
+
+    if (virNumaGetHugePageInfoDir(&path, node) < 0)
+        goto cleanup;
+
+    /* It's okay if the @path doesn't exist. Maybe we are running on
+     * system without huge pages support where the path may not exist. */
+    if (virDirOpenIfExists(&dir, path) < 0)
+        goto cleanup;
+
+    while (dir && (direrr = virDirRead(dir, &entry, path)) > 0) {
+        const char *page_name = entry->d_name;
+        unsigned int page_size;
+        char *end;
+
+        /* Just to give you a hint, we're dealing with this:
+         * hugepages-2048kB/  or   hugepages-1048576kB/ */
+        if (!STRPREFIX(entry->d_name, HUGEPAGES_PREFIX))
+            continue;
+
+        page_name += strlen(HUGEPAGES_PREFIX);
+
+        if (virStrToLong_ui(page_name, &end, 10, &page_size) < 0 ||
+            STRCASENEQ(end, "kB")) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("unable to parse %s"),
+                           entry->d_name);
+            goto cleanup;
+        }
+
+        if (VIR_APPEND_ELEMENT(tmp, ntmp, page_size) < 0)
+            goto cleanup;
+    }
+
+    if (direrr < 0)
+        goto cleanup;
+
+    *sizes = g_steal_pointer(&tmp);
+    *nsizes = ntmp;
+    ret = 0;
+ cleanup:
+    VIR_DIR_CLOSE(dir);
+    return ret;
+}
+
+static int
+virNumaGetHugePageSizes(int node,
+                        unsigned int **sizes,
+                        size_t *nsizes)
+{
+    virNumaHugePageSizes *entry;
+    size_t idx = node + 1;
+
+    virMutexLock(&virNumaHugePageSizesLock);
+    if (idx < virNumaHugePageSizesCacheLen &&
+        virNumaHugePageSizesCache[idx].valid) {
+        entry = &virNumaHugePageSizesCache[idx];
+        *sizes = g_memdup(entry->sizes, entry->nsizes * sizeof(*entry->sizes));
+        *nsizes = entry->nsizes;
+        virMutexUnlock(&virNumaHugePageSizesLock);
+        return 0;
+    }
+    virMutexUnlock(&virNumaHugePageSizesLock);
+
+    if (virNumaListHugePageSizes(node, sizes, nsizes) < 0)
+        return -1;
+
+    virMutexLock(&virNumaHugePageSizesLock);
+    if (idx >= virNumaHugePageSizesCacheLen)
+        ignore_value(VIR_EXPAND_N(virNumaHugePageSizesCache,
+                                  virNumaHugePageSizesCacheLen,
+                                  idx + 1 - virNumaHugePageSizesCacheLen));
+    entry = &virNumaHugePageSizesCache[idx];
+    if (!entry->valid) {
+        entry->sizes = g_memdup(*sizes, *nsizes * sizeof(**sizes));
+        entry->nsizes = *nsizes;
+        entry->valid = true;
+    }
+    virMutexUnlock(&virNumaHugePageSizesLock);
+
+    return 0;
+}
+
 /**
  * virNumaGetHugePageInfo:
  * @node: NUMA node id
@@ -742,16 +855,13 @@ virNumaGetPages(int node,
                 unsigned long long **pages_free,
                 size_t *npages)
 {
-    int ret = -1;
-    DIR *dir = NULL;
-    int direrr = 0;
-    struct dirent *entry;
     unsigned int ntmp = 0;
     size_t i;
     bool exchange;
     long system_page_size;
     unsigned long long huge_page_sum = 0;
-    g_autofree char *path = NULL;
+    g_autofree unsigned int *huge_sizes = NULL;
+    size_t nhuge_sizes = 0;
     g_autofree unsigned int *tmp_size = NULL;
     g_autofree unsigned long long *tmp_avail = NULL;
     g_autofree unsigned long long *tmp_free = NULL;
@@ -765,44 +875,22 @@ virNumaGetPages(int node,
      * is always shown as used memory. Here, however, we want to report
      * slightly different information. So we take the total memory on a node
      * and subtract memory taken by the huge pages. */
-    if (virNumaGetHugePageInfoDir(&path, node) < 0)
-        goto cleanup;
-
-    /* It's okay if the @path doesn't exist. Maybe we are running on
-     * system without huge pages support where the path may not exist. */
-    if (virDirOpenIfExists(&dir, path) < 0)
-        goto cleanup;
+    if (virNumaGetHugePageSizes(node, &huge_sizes, &nhuge_sizes) < 0)
+        return -1;
 
-    while (dir && (direrr = virDirRead(dir, &entry, path)) > 0) {
-        const char *page_name = entry->d_name;
-        unsigned int page_size;
+    for (i = 0; i < nhuge_sizes; i++) {
+        unsigned int page_size = huge_sizes[i];
         unsigned long long page_avail = 0;
         unsigned long long page_free = 0;
-        char *end;
-
-        /* Just to give you a hint, we're dealing with this:
-         * hugepages-2048kB/  or   hugepages-1048576kB/ */
-        if (!STRPREFIX(entry->d_name, HUGEPAGES_PREFIX))
-            continue;
-
-        page_name += strlen(HUGEPAGES_PREFIX);
-
-        if (virStrToLong_ui(page_name, &end, 10, &page_size) < 0 ||
-            STRCASENEQ(end, "kB")) {
-            virReportError(VIR_ERR_INTERNAL_ERROR,
-                           _("unable to parse %s"),
-                           entry->d_name);
-            goto cleanup;
-        }
 
         if (virNumaGetHugePageInfo(node, page_size,
                                    &page_avail, &page_free) < 0)
-            goto cleanup;
+            return -1;
 
         if (VIR_REALLOC_N(tmp_size, ntmp + 1) < 0 ||
             VIR_REALLOC_N(tmp_avail, ntmp + 1) < 0 ||
             VIR_REALLOC_N(tmp_free, ntmp + 1) < 0)
-            goto cleanup;
+            return -1;
 
         tmp_size[ntmp] = page_size;
         tmp_avail[ntmp] = page_avail;
@@ -814,18 +902,15 @@ virNumaGetPages(int node,
         huge_page_sum += 1024 * page_size * page_avail;
     }
 
-    if (direrr < 0)
-        goto cleanup;
-
     /* Now append the ordinary system pages */
     if (VIR_REALLOC_N(tmp_size, ntmp + 1) < 0 ||
         VIR_REALLOC_N(tmp_avail, ntmp + 1) < 0 ||
         VIR_REALLOC_N(tmp_free, ntmp + 1) < 0)
-        goto cleanup;
+        return -1;
 
     if (virNumaGetPageInfo(node, system_page_size, huge_page_sum,
                            &tmp_avail[ntmp], &tmp_free[ntmp]) < 0)
-        goto cleanup;
+        return -1;
     tmp_size[ntmp] = system_page_size;
     ntmp++;
 
@@ -855,10 +940,7 @@ virNumaGetPages(int node,
         tmp_free = NULL;
     }
     *npages = ntmp;
-    ret = 0;
- cleanup:
-    VIR_DIR_CLOSE(dir);
-    return ret;
+    return 0;
 }
 
 
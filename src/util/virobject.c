@@ -38,14 +38,21 @@ static unsigned int magicCounter = 0xCAFE0000;
 
 struct _virClass {
     virClassPtr parent;
+    virClassPtr next; /* in the list of all classes */
 
     unsigned int magic;
     char *name;
     size_t objectSize;
+    int instances;
+    virMutexStats lockStats;
 
     virObjectDisposeCallback dispose;
 };
 
+/* All classes ever created, newest first. Classes are never freed. */
+static virClassPtr virClassList;
+static virMutex virClassListLock = VIR_MUTEX_INITIALIZER;
+
 #define VIR_OBJECT_NOTVALID(obj) (!obj || ((obj->u.s.magic & 0xFFFF0000) != 0xCAFE0000))
 
 #define VIR_OBJECT_USAGE_PRINT_WARNING(anyobj, objclass) \
@@ -189,8 +196,14 @@ virClassNew(virClassPtr parent,
     }
     klass->name = g_strdup(name);
     klass->objectSize = objectSize;
+    klass->lockStats.name = klass->name;
     klass->dispose = dispose;
 
+    virMutexLock(&virClassListLock);
+    klass->next = virClassList;
+    virClassList = klass;
+    virMutexUnlock(&virClassListLock);
+
     return klass;
 
  error:
@@ -246,6 +259,7 @@ virObjectNew(virClassPtr klass)
     obj->u.s.magic = klass->magic;
     obj->klass = klass;
     g_atomic_int_set(&obj->u.s.refs, 1);
+    g_atomic_int_inc(&klass->instances);
 
     PROBE(OBJECT_NEW, "obj=%p classname=%s", obj, obj->klass->name);
 
@@ -274,6 +288,7 @@ virObjectLockableNew(virClassPtr klass)
         virObjectUnref(obj);
         return NULL;
     }
+    virMutexSetStats(&obj->lock, &klass->lockStats);
 
     return obj;
 }
@@ -354,6 +369,8 @@ virObjectUnref(void *anyobj)
             klass = klass->parent;
         }
 
+        g_atomic_int_add(&obj->klass->instances, -1);
+
         /* Clear & poison object */
         memset(obj, 0, obj->klass->objectSize);
         obj->u.s.magic = 0xDEADBEEF;
@@ -564,6 +581,97 @@ virClassName(virClassPtr klass)
 }
 
 
+/**
+ * virClassGetStats:
+ * @stats: filled with a newly allocated array of statistics
+ *
+ * Collects the number of live instances of every object class and the
+ * memory taken by them. Only the objects themselves are accounted for,
+ * not any memory they point to. Names in @stats point to the classes
+ * and thus stay valid forever.
+ *
+ * Returns the number of classes in @stats
+ */
+size_t
+virClassGetStats(virClassStatsPtr *stats)
+{
+    virClassPtr klass;
+    size_t nclasses = 0;
+    size_t i = 0;
+
+    virMutexLock(&virClassListLock);
+
+    for (klass = virClassList; klass; klass = klass->next)
+        nclasses++;
+
+    *stats = g_new0(virClassStats, nclasses);
+
+    for (klass = virClassList; klass; klass = klass->next, i++) {
+        int instances = g_atomic_int_get(&klass->instances);
+
+        (*stats)[i].name = klass->name;
+        (*stats)[i].instances = MAX(instances, 0);
+        (*stats)[i].bytes = (*stats)[i].instances * klass->objectSize;
+    }
+
+    virMutexUnlock(&virClassListLock);
+
+    return nclasses;
+}
+
+
+/**
+ * virClassGetLockStats:
+ * @stats: filled with a newly allocated array of statistics
+ *
+ * Collects the contention statistics of the locks of every lockable
+ * object class that was locked at least once, followed by those of all
+ * the mutexes which are not the lock of an object.
+ *
+ * Returns the number of entries in @stats, or -1 with an error reported
+ * if this build does not collect lock statistics.
+ */
+int
+virClassGetLockStats(virMutexStatsPtr *stats)
+{
+    g_autofree virMutexStatsPtr list = NULL;
+    virClassPtr klass;
+    size_t nstats = 0;
+
+    if (virObjectInitialize() < 0)
+        return -1;
+
+    virMutexLock(&virClassListLock);
+
+    for (klass = virClassList; klass; klass = klass->next)
+        nstats++;
+
+    list = g_new0(virMutexStats, nstats + 1);
+    nstats = 0;
+
+    for (klass = virClassList; klass; klass = klass->next) {
+        if (!virClassIsDerivedFrom(klass, virObjectLockableClass))
+            continue;
+
+        if (virMutexStatsGet(&klass->lockStats, &list[nstats]) < 0) {
+            virMutexUnlock(&virClassListLock);
+            return -1;
+        }
+
+        if (list[nstats].acquisitions > 0)
+            nstats++;
+    }
+
+    virMutexUnlock(&virClassListLock);
+
+    if (virMutexStatsGet(NULL, &list[nstats]) < 0)
+        return -1;
+
+    *stats = g_steal_pointer(&list);
+    return nstats + 1;
+}
+
+
 /**
  * virObjectFreeCallback:
  * @opaque: a pointer to a virObject instance
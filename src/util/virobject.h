@@ -97,6 +97,22 @@ const char *
 virClassName(virClassPtr klass)
     ATTRIBUTE_NONNULL(1);
 
+typedef struct _virClassStats virClassStats;
+typedef virClassStats *virClassStatsPtr;
+struct _virClassStats {
+    const char *name;
+    unsigned long long instances;
+    unsigned long long bytes;
+};
+
+size_t
+virClassGetStats(virClassStatsPtr *stats)
+    ATTRIBUTE_NONNULL(1);
+
+int
+virClassGetLockStats(virMutexStatsPtr *stats)
+    ATTRIBUTE_NONNULL(1);
+
 bool
 virClassIsDerivedFrom(virClassPtr klass,
                       virClassPtr parent)
@@ -666,25 +666,70 @@ virPCIDeviceBusContainsActiveDevices(virPCIDevicePtr dev,
     return active;
 }
 
-/* Is @check the parent of @dev ? */
+/*
+ * Snapshot of the PCI bridges of the host, which is all that is needed
+ * to find the parent of a device. Building it means reading the config
+ * space of every PCI device, so rather than doing that for every step
+ * up the tree of every device, it is kept for a few seconds or until
+ * virPCITopologyCacheInvalidate is called.
+ */
+#define VIR_PCI_TOPOLOGY_CACHE_TIMEOUT (10 * G_USEC_PER_SEC)
+
+typedef struct _virPCIBridge virPCIBridge;
+typedef virPCIBridge *virPCIBridgePtr;
+struct _virPCIBridge {
+    virPCIDeviceAddress address;
+    uint8_t secondary;
+    uint8_t subordinate;
+
+    /* result of virPCIDeviceDownstreamLacksACS, once acsChecked */
+    bool acsChecked;
+    bool lacksACS;
+};
+
+typedef struct _virPCITopology virPCITopology;
+struct _virPCITopology {
+    virPCIBridgePtr bridges;
+    size_t nbridges;
+};
+
+static virMutex virPCITopologyLock = VIR_MUTEX_INITIALIZER;
+static virPCITopology virPCITopologyCache;
+static gint64 virPCITopologyTimestamp; /* 0 if the cache is invalid */
+
+
+/**
+ * virPCITopologyCacheInvalidate:
+ *
+ * Drops the cached PCI topology of the host, to be called when PCI
+ * devices are added or removed.
+ */
+void
+virPCITopologyCacheInvalidate(void)
+{
+    virMutexLock(&virPCITopologyLock);
+    virPCITopologyTimestamp = 0;
+    virMutexUnlock(&virPCITopologyLock);
+}
+
+
 static int
-virPCIDeviceIsParent(virPCIDevicePtr dev, virPCIDevicePtr check, void *data)
+virPCITopologyAddBridge(virPCIDevicePtr dev G_GNUC_UNUSED,
+                        virPCIDevicePtr check,
+                        void *data)
 {
+    virPCITopology *topology = data;
+    virPCIBridge bridge = { 0 };
     uint16_t device_class;
-    uint8_t header_type, secondary, subordinate;
-    virPCIDevicePtr *best = data;
-    int ret = 0;
+    uint8_t header_type;
     int fd;
 
-    if (dev->address.domain != check->address.domain)
-        return 0;
-
     if ((fd = virPCIDeviceConfigOpenTry(check)) < 0)
         return 0;
 
     /* Is it a bridge? */
-    ret = virPCIDeviceReadClass(check, &device_class);
-    if (ret < 0 || device_class != PCI_CLASS_BRIDGE_PCI)
+    if (virPCIDeviceReadClass(check, &device_class) < 0 ||
+        device_class != PCI_CLASS_BRIDGE_PCI)
         goto cleanup;
 
     /* Is it a plane? */
@@ -692,78 +737,123 @@ virPCIDeviceIsParent(virPCIDevicePtr dev, virPCIDevicePtr check, void *data)
     if ((header_type & PCI_HEADER_TYPE_MASK) != PCI_HEADER_TYPE_BRIDGE)
         goto cleanup;
 
-    secondary   = virPCIDeviceRead8(check, fd, PCI_SECONDARY_BUS);
-    subordinate = virPCIDeviceRead8(check, fd, PCI_SUBORDINATE_BUS);
+    bridge.address = check->address;
+    bridge.secondary = virPCIDeviceRead8(check, fd, PCI_SECONDARY_BUS);
+    bridge.subordinate = virPCIDeviceRead8(check, fd, PCI_SUBORDINATE_BUS);
 
-    VIR_DEBUG("%s %s: found parent device %s", dev->id, dev->name, check->name);
+    ignore_value(VIR_APPEND_ELEMENT(topology->bridges, topology->nbridges,
+                                    bridge));
 
-    /* if the secondary bus exactly equals the device's bus, then we found
-     * the direct parent.  No further work is necessary
-     */
-    if (dev->address.bus == secondary) {
-        ret = 1;
-        goto cleanup;
+ cleanup:
+    virPCIDeviceConfigClose(check, fd);
+    return 0;
+}
+
+
+/* Must be called with virPCITopologyLock held */
+static int
+virPCITopologyRefreshLocked(virPCIDevicePtr dev)
+{
+    gint64 now = g_get_monotonic_time();
+    virPCITopology topology = { 0 };
+    g_autoptr(virPCIDevice) matched = NULL;
+
+    if (virPCITopologyTimestamp &&
+        now - virPCITopologyTimestamp < VIR_PCI_TOPOLOGY_CACHE_TIMEOUT)
+        return 0;
+
+    if (virPCIDeviceIterDevices(virPCITopologyAddBridge, dev,
+                                &matched, &topology) < 0) {
+        VIR_FREE(topology.bridges);
+        return -1;
     }
 
-    /* otherwise, SRIOV allows VFs to be on different buses than their PFs.
-     * In this case, what we need to do is look for the "best" match; i.e.
-     * the most restrictive match that still satisfies all of the conditions.
-     */
-    if (dev->address.bus > secondary && dev->address.bus <= subordinate) {
-        if (*best == NULL) {
-            *best = virPCIDeviceNew(check->address.domain,
-                                    check->address.bus,
-                                    check->address.slot,
-                                    check->address.function);
-            if (*best == NULL) {
-                ret = -1;
-                goto cleanup;
-            }
-        } else {
-            /* OK, we had already recorded a previous "best" match for the
-             * parent.  See if the current device is more restrictive than the
-             * best, and if so, make it the new best
-             */
-            int bestfd;
-            uint8_t best_secondary;
-
-            if ((bestfd = virPCIDeviceConfigOpenTry(*best)) < 0)
-                goto cleanup;
-            best_secondary = virPCIDeviceRead8(*best, bestfd, PCI_SECONDARY_BUS);
-            virPCIDeviceConfigClose(*best, bestfd);
-
-            if (secondary > best_secondary) {
-                virPCIDeviceFree(*best);
-                *best = virPCIDeviceNew(check->address.domain,
-                                        check->address.bus,
-                                        check->address.slot,
-                                        check->address.function);
-                if (*best == NULL) {
-                    ret = -1;
-                    goto cleanup;
-                }
-            }
-        }
+    VIR_FREE(virPCITopologyCache.bridges);
+    virPCITopologyCache = topology;
+    virPCITopologyTimestamp = MAX(now, 1);
+    return 0;
+}
+
+
+/* Must be called with virPCITopologyLock held */
+static virPCIBridgePtr
+virPCITopologyFindBridgeLocked(const virPCIDeviceAddress *addr)
+{
+    size_t i;
+
+    for (i = 0; i < virPCITopologyCache.nbridges; i++) {
+        if (virPCIDeviceAddressEqual(&virPCITopologyCache.bridges[i].address,
+                                     addr))
+            return &virPCITopologyCache.bridges[i];
     }
 
- cleanup:
-    virPCIDeviceConfigClose(check, fd);
-    return ret;
+    return NULL;
 }
 
+
+/* Must be called with virPCITopologyLock held */
+static virPCIBridgePtr
+virPCITopologyFindParentLocked(const virPCIDeviceAddress *addr)
+{
+    virPCIBridgePtr best = NULL;
+    size_t i;
+
+    for (i = 0; i < virPCITopologyCache.nbridges; i++) {
+        virPCIBridgePtr bridge = &virPCITopologyCache.bridges[i];
+
+        if (bridge->address.domain != addr->domain)
+            continue;
+
+        /* if the secondary bus exactly equals the device's bus, then we
+         * found the direct parent.  No further work is necessary
+         */
+        if (addr->bus == bridge->secondary)
+            return bridge;
+
+        /* otherwise, SRIOV allows VFs to be on different buses than their
+         * PFs. In this case, what we need to do is look for the "best"
+         * match; i.e. the most restrictive match that still satisfies all
+         * of the conditions.
+         */
+        if (addr->bus > bridge->secondary &&
+            addr->bus <= bridge->subordinate &&
+            (!best || bridge->secondary > best->secondary))
+            best = bridge;
+    }
+
+    return best;
+}
+
+
 static int
 virPCIDeviceGetParent(virPCIDevicePtr dev, virPCIDevicePtr *parent)
 {
-    virPCIDevicePtr best = NULL;
-    int ret;
+    virPCIBridgePtr bridge;
+    virPCIDeviceAddress addr = { 0 };
 
     *parent = NULL;
-    ret = virPCIDeviceIterDevices(virPCIDeviceIsParent, dev, parent, &best);
-    if (ret == 1)
-        virPCIDeviceFree(best);
-    else if (ret == 0)
-        *parent = best;
-    return ret;
+
+    virMutexLock(&virPCITopologyLock);
+    if (virPCITopologyRefreshLocked(dev) < 0) {
+        virMutexUnlock(&virPCITopologyLock);
+        return -1;
+    }
+    if ((bridge = virPCITopologyFindParentLocked(&dev->address)))
+        addr = bridge->address;
+    virMutexUnlock(&virPCITopologyLock);
+
+    if (!bridge)
+        return 0;
+
+    VIR_DEBUG("%s %s: found parent device " VIR_PCI_DEVICE_ADDRESS_FMT,
+              dev->id, dev->name,
+              addr.domain, addr.bus, addr.slot, addr.function);
+
+    if (!(*parent = virPCIDeviceNew(addr.domain, addr.bus,
+                                    addr.slot, addr.function)))
+        return -1;
+
+    return 0;
 }
 
 /* Secondary Bus Reset is our sledgehammer - it resets all
@@ -2043,6 +2133,39 @@ virPCIDeviceDownstreamLacksACS(virPCIDevicePtr dev)
     return ret;
 }
 
+/* Same as virPCIDeviceDownstreamLacksACS, but remembers the answer for
+ * bridges in the cached topology since those are asked about for every
+ * device behind them.
+ */
+static int
+virPCIDeviceDownstreamLacksACSCached(virPCIDevicePtr dev)
+{
+    virPCIBridgePtr bridge;
+    int ret = -1;
+
+    virMutexLock(&virPCITopologyLock);
+    if ((bridge = virPCITopologyFindBridgeLocked(&dev->address)) &&
+        bridge->acsChecked)
+        ret = bridge->lacksACS;
+    virMutexUnlock(&virPCITopologyLock);
+
+    if (ret >= 0)
+        return ret;
+
+    if ((ret = virPCIDeviceDownstreamLacksACS(dev)) < 0)
+        return -1;
+
+    /* The cache may have been refreshed in the meantime */
+    virMutexLock(&virPCITopologyLock);
+    if ((bridge = virPCITopologyFindBridgeLocked(&dev->address))) {
+        bridge->acsChecked = true;
+        bridge->lacksACS = ret == 1;
+    }
+    virMutexUnlock(&virPCITopologyLock);
+
+    return ret;
+}
+
 static int
 virPCIDeviceIsBehindSwitchLackingACS(virPCIDevicePtr dev)
 {
@@ -2074,7 +2197,7 @@ virPCIDeviceIsBehindSwitchLackingACS(virPCIDevicePtr dev)
         int acs;
         int ret;
 
-        acs = virPCIDeviceDownstreamLacksACS(parent);
+        acs = virPCIDeviceDownstreamLacksACSCached(parent);
 
         if (acs) {
             if (acs < 0)
@@ -54,6 +54,8 @@ VIR_ENUM_IMPL(virPerfEvent,
 struct virPerfEvent {
     int fd;
     bool enabled;
+    bool grouped; /* read through the group of the virPerf */
+    uint64_t id;  /* of the event within the group */
     union {
         /* cmt */
         struct {
@@ -65,6 +67,8 @@ typedef struct virPerfEvent *virPerfEventPtr;
 
 struct _virPerf {
     struct virPerfEvent events[VIR_PERF_EVENT_LAST];
+    int groupFd;  /* leader of the group of events, or -1 */
+    bool noGroup; /* the kernel refused to create the group */
 };
 
 #if defined(__linux__) && defined(HAVE_SYS_SYSCALL_H)
@@ -202,12 +206,91 @@ virPerfRdtAttrInit(void)
 }
 
 
+/* The software events of a domain are counted in one group, which is
+ * read by a single syscall. Hardware events are not grouped: a group is
+ * only counted while all of its events fit on the PMU at once, whereas
+ * the kernel rotates ungrouped events through the available counters. */
+# if defined(PERF_COUNT_SW_DUMMY) && defined(PERF_EVENT_IOC_ID)
+#  define VIR_PERF_GROUP 1
+# endif
+
+# define VIR_PERF_READ_FORMAT \
+    (PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING)
+# define VIR_PERF_READ_FORMAT_GROUP \
+    (VIR_PERF_READ_FORMAT | PERF_FORMAT_GROUP | PERF_FORMAT_ID)
+
+
+static int
+virPerfEventOpen(unsigned int type,
+                 unsigned long long config,
+                 pid_t pid,
+                 int groupFd,
+                 unsigned long long readFormat)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.inherit = 1;
+    attr.disabled = 1;
+    attr.enable_on_exec = 0;
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = readFormat;
+
+    return syscall(__NR_perf_event_open, &attr, pid, -1, groupFd, 0);
+}
+
+
+# ifdef VIR_PERF_GROUP
+/* Opens the leader of the group of software events of @perf, a dummy
+ * event which stays until the last event leaves the group. */
+static int
+virPerfGroupOpen(virPerfPtr perf,
+                 pid_t pid)
+{
+    if (perf->groupFd >= 0)
+        return 0;
+
+    if (perf->noGroup)
+        return -1;
+
+    perf->groupFd = virPerfEventOpen(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_DUMMY,
+                                     pid, -1, VIR_PERF_READ_FORMAT_GROUP);
+
+    if (perf->groupFd < 0 ||
+        ioctl(perf->groupFd, PERF_EVENT_IOC_ENABLE) < 0) {
+        /* e.g. kernels which don't sum up the inherited events of a group */
+        VIR_DEBUG("unable to open perf event group: %s", g_strerror(errno));
+        VIR_FORCE_CLOSE(perf->groupFd);
+        perf->noGroup = true;
+        return -1;
+    }
+
+    return 0;
+}
+# endif /* VIR_PERF_GROUP */
+
+
+static void
+virPerfGroupRelease(virPerfPtr perf)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_PERF_EVENT_LAST; i++) {
+        if (perf->events[i].grouped)
+            return;
+    }
+
+    VIR_FORCE_CLOSE(perf->groupFd);
+}
+
+
 int
 virPerfEventEnable(virPerfPtr perf,
                    virPerfEventType type,
                    pid_t pid)
 {
-    struct perf_event_attr attr;
     virPerfEventPtr event = &(perf->events[type]);
     virPerfEventAttrPtr event_attr = &attrs[type];
 
@@ -237,15 +320,31 @@ virPerfEventEnable(virPerfPtr perf,
         }
     }
 
-    memset(&attr, 0, sizeof(attr));
-    attr.size = sizeof(attr);
-    attr.inherit = 1;
-    attr.disabled = 1;
-    attr.enable_on_exec = 0;
-    attr.type = event_attr->attrType;
-    attr.config = event_attr->attrConfig;
+# ifdef VIR_PERF_GROUP
+    if (event_attr->attrType == PERF_TYPE_SOFTWARE &&
+        virPerfGroupOpen(perf, pid) == 0) {
+        event->fd = virPerfEventOpen(event_attr->attrType,
+                                     event_attr->attrConfig,
+                                     pid, perf->groupFd,
+                                     VIR_PERF_READ_FORMAT_GROUP);
+
+        if (event->fd >= 0 &&
+            ioctl(event->fd, PERF_EVENT_IOC_ID, &event->id) < 0)
+            VIR_FORCE_CLOSE(event->fd);
+
+        if (event->fd >= 0)
+            event->grouped = true;
+        else
+            VIR_DEBUG("unable to add perf event %s to group: %s",
+                      virPerfEventTypeToString(type), g_strerror(errno));
+    }
+# endif /* VIR_PERF_GROUP */
+
+    if (event->fd < 0)
+        event->fd = virPerfEventOpen(event_attr->attrType,
+                                     event_attr->attrConfig,
+                                     pid, -1, VIR_PERF_READ_FORMAT);
 
-    event->fd = syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0);
     if (event->fd < 0) {
         virReportSystemError(errno,
                              _("unable to open host cpu perf event for %s"),
@@ -265,6 +364,8 @@ virPerfEventEnable(virPerfPtr perf,
 
  error:
     VIR_FORCE_CLOSE(event->fd);
+    event->grouped = false;
+    virPerfGroupRelease(perf);
     return -1;
 }
 
@@ -285,7 +386,9 @@ virPerfEventDisable(virPerfPtr perf,
     }
 
     event->enabled = false;
+    event->grouped = false;
     VIR_FORCE_CLOSE(event->fd);
+    virPerfGroupRelease(perf);
     return 0;
 }
 
@@ -295,21 +398,133 @@ bool virPerfEventIsEnabled(virPerfPtr perf,
     return perf && perf->events[type].enabled;
 }
 
+
+/* Reads all events of the group of @perf into @values */
+static int
+virPerfReadGroup(virPerfPtr perf,
+                 virPerfEventValuePtr values)
+{
+    /* The number of events, the times, then value and id of each event
+     * including the leader */
+    uint64_t buf[3 + 2 * (VIR_PERF_EVENT_LAST + 1)];
+    ssize_t got;
+    size_t i;
+    size_t j;
+
+    /* not saferead, the kernel returns the whole group or nothing */
+    if ((got = read(perf->groupFd, buf, sizeof(buf))) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to read perf event group"));
+        return -1;
+    }
+
+    if (got < 3 * sizeof(uint64_t) ||
+        buf[0] > VIR_PERF_EVENT_LAST + 1 ||
+        got < (3 + 2 * buf[0]) * sizeof(uint64_t)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unexpected size of perf event group data"));
+        return -1;
+    }
+
+    for (i = 0; i < buf[0]; i++) {
+        for (j = 0; j < VIR_PERF_EVENT_LAST; j++) {
+            virPerfEventPtr event = &perf->events[j];
+
+            if (event->grouped && event->id == buf[4 + 2 * i]) {
+                values[j].value = buf[3 + 2 * i];
+                values[j].enabled = buf[1];
+                values[j].running = buf[2];
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+virPerfReadOne(virPerfPtr perf,
+               virPerfEventType type,
+               virPerfEventValuePtr value)
+{
+    virPerfEventPtr event = &perf->events[type];
+    uint64_t buf[3];
+
+    if (saferead(event->fd, buf, sizeof(buf)) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to read cache data"));
+        return -1;
+    }
+
+    value->value = buf[0];
+    value->enabled = buf[1];
+    value->running = buf[2];
+
+    return 0;
+}
+
+
+/**
+ * virPerfReadEvents:
+ * @perf: perf events of a process
+ * @values: array of VIR_PERF_EVENT_LAST entries
+ *
+ * Reads the counts of all enabled events into the entries of @values
+ * indexed by the event type, entries of disabled events are left
+ * alone. Events which are grouped are read by a single syscall.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virPerfReadEvents(virPerfPtr perf,
+                  virPerfEventValuePtr values)
+{
+    size_t i;
+
+    if (perf->groupFd >= 0 &&
+        virPerfReadGroup(perf, values) < 0)
+        return -1;
+
+    for (i = 0; i < VIR_PERF_EVENT_LAST; i++) {
+        virPerfEventPtr event = &perf->events[i];
+
+        if (!event->enabled)
+            continue;
+
+        if (!event->grouped &&
+            virPerfReadOne(perf, i, &values[i]) < 0)
+            return -1;
+
+        if (i == VIR_PERF_EVENT_CMT)
+            values[i].value *= event->efields.cmt.scale;
+    }
+
+    return 0;
+}
+
+
 int
 virPerfReadEvent(virPerfPtr perf,
                  virPerfEventType type,
                  uint64_t *value)
 {
+    virPerfEventValue values[VIR_PERF_EVENT_LAST] = { { 0 } };
     virPerfEventPtr event = &perf->events[type];
+
     if (!event->enabled)
         return -1;
 
-    if (saferead(event->fd, value, sizeof(uint64_t)) < 0) {
-        virReportSystemError(errno, "%s",
-                             _("Unable to read cache data"));
-        return -1;
+    if (event->grouped) {
+        if (virPerfReadGroup(perf, values) < 0)
+            return -1;
+    } else {
+        if (virPerfReadOne(perf, type, &values[type]) < 0)
+            return -1;
     }
 
+    *value = values[type].value;
+
     if (type == VIR_PERF_EVENT_CMT)
         *value *= event->efields.cmt.scale;
 
@@ -350,6 +565,15 @@ virPerfEventIsEnabled(virPerfPtr perf G_GNUC_UNUSED,
     return false;
 }
 
+int
+virPerfReadEvents(virPerfPtr perf G_GNUC_UNUSED,
+                  virPerfEventValuePtr values G_GNUC_UNUSED)
+{
+    virReportSystemError(ENXIO, "%s",
+                         _("Perf not supported on this platform"));
+    return -1;
+}
+
 int
 virPerfReadEvent(virPerfPtr perf G_GNUC_UNUSED,
                  virPerfEventType type G_GNUC_UNUSED,
@@ -375,6 +599,7 @@ virPerfNew(void)
         perf->events[i].fd = -1;
         perf->events[i].enabled = false;
     }
+    perf->groupFd = -1;
 
     if (virPerfRdtAttrInit() < 0)
         virResetLastError();
@@ -395,5 +620,6 @@ virPerfFree(virPerfPtr perf)
             virPerfEventDisable(perf, i);
     }
 
+    VIR_FORCE_CLOSE(perf->groupFd);
     VIR_FREE(perf);
 }
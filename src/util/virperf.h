@@ -76,6 +76,18 @@ int virPerfEventDisable(virPerfPtr perf,
 bool virPerfEventIsEnabled(virPerfPtr perf,
                            virPerfEventType type);
 
+typedef struct _virPerfEventValue virPerfEventValue;
+typedef virPerfEventValue *virPerfEventValuePtr;
+struct _virPerfEventValue {
+    uint64_t value;
+    uint64_t enabled; /* time in ns the event was enabled */
+    uint64_t running; /* time in ns the event was counted, less than
+                       * @enabled if it had to share the PMU */
+};
+
+int virPerfReadEvents(virPerfPtr perf,
+                      virPerfEventValuePtr values);
+
 int virPerfReadEvent(virPerfPtr perf,
                      virPerfEventType type,
                      uint64_t *value);
@@ -211,7 +211,7 @@ virPortAllocatorAcquire(const virPortAllocatorRange *range,
                         unsigned short *port)
 {
     int ret = -1;
-    size_t i;
+    ssize_t i;
     virPortAllocatorPtr pa = virPortAllocatorGet();
 
     *port = 0;
@@ -221,21 +221,23 @@ virPortAllocatorAcquire(const virPortAllocatorRange *range,
 
     virObjectLock(pa);
 
-    for (i = range->start; i <= range->end && !*port; i++) {
-        bool used = false, v6used = false;
+    /* Ports reserved by us are skipped a word of the bitmap at a time,
+     * only the ones which are free as far as we know need to be probed
+     * with bind() */
+    for (i = virBitmapNextClearBit(pa->bitmap, (ssize_t)range->start - 1);
+         i >= 0 && i <= range->end && !*port;
+         i = virBitmapNextClearBit(pa->bitmap, i)) {
+        bool used = false;
 
-        if (virBitmapIsBitSet(pa->bitmap, i))
-            continue;
-
-        if (virPortAllocatorBindToPort(&v6used, i, AF_INET6) < 0 ||
-            virPortAllocatorBindToPort(&used, i, AF_INET) < 0)
+        if (virPortAllocatorBindToPort(&used, i, AF_INET6) < 0 ||
+            (!used && virPortAllocatorBindToPort(&used, i, AF_INET) < 0))
             goto cleanup;
 
-        if (!used && !v6used) {
+        if (!used) {
             /* Add port to bitmap of reserved ports */
             if (virBitmapSetBit(pa->bitmap, i) < 0) {
                 virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("Failed to reserve port %zu"), i);
+                               _("Failed to reserve port %zd"), i);
                 goto cleanup;
             }
             *port = i;
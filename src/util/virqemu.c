@@ -34,7 +34,8 @@
 VIR_LOG_INIT("util.qemu");
 
 struct virQEMUCommandLineJSONIteratorData {
-    const char *prefix;
+    virBufferPtr key; /* "prefix." of nested objects, NULL at top level */
+    size_t prefixlen;
     virBufferPtr buf;
     virQEMUBuildCommandLineJSONArrayFormatFunc arrayFunc;
 };
@@ -82,16 +83,22 @@ virQEMUBuildCommandLineJSONArrayNumbered(const char *key,
                                          virJSONValuePtr array,
                                          virBufferPtr buf)
 {
+    g_auto(virBuffer) prefix = VIR_BUFFER_INITIALIZER;
     virJSONValuePtr member;
+    size_t prefixlen;
     size_t i;
 
+    virBufferAsprintf(&prefix, "%s.", key);
+    prefixlen = virBufferUse(&prefix);
+
     for (i = 0; i < virJSONValueArraySize(array); i++) {
         member = virJSONValueArrayGet((virJSONValuePtr) array, i);
-        g_autofree char *prefix = NULL;
 
-        prefix = g_strdup_printf("%s.%zu", key, i);
+        virBufferTrimLen(&prefix, virBufferUse(&prefix) - prefixlen);
+        virBufferAsprintf(&prefix, "%zu", i);
 
-        if (virQEMUBuildCommandLineJSONRecurse(prefix, member, buf,
+        if (virQEMUBuildCommandLineJSONRecurse(virBufferCurrentContent(&prefix),
+                                               member, buf,
                                                virQEMUBuildCommandLineJSONArrayNumbered,
                                                true) < 0)
             return 0;
@@ -109,12 +116,13 @@ virQEMUBuildCommandLineJSONIterate(const char *key,
 {
     struct virQEMUCommandLineJSONIteratorData *data = opaque;
 
-    if (data->prefix) {
-        g_autofree char *tmpkey = NULL;
-
-        tmpkey = g_strdup_printf("%s.%s", data->prefix, key);
+    /* all members share the buffer holding the prefix of the object */
+    if (data->key) {
+        virBufferTrimLen(data->key, virBufferUse(data->key) - data->prefixlen);
+        virBufferAdd(data->key, key, -1);
 
-        return virQEMUBuildCommandLineJSONRecurse(tmpkey, value, data->buf,
+        return virQEMUBuildCommandLineJSONRecurse(virBufferCurrentContent(data->key),
+                                                  value, data->buf,
                                                   data->arrayFunc, false);
     } else {
         return virQEMUBuildCommandLineJSONRecurse(key, value, data->buf,
@@ -130,7 +138,8 @@ virQEMUBuildCommandLineJSONRecurse(const char *key,
                                    virQEMUBuildCommandLineJSONArrayFormatFunc arrayFunc,
                                    bool nested)
 {
-    struct virQEMUCommandLineJSONIteratorData data = { key, buf, arrayFunc };
+    struct virQEMUCommandLineJSONIteratorData data = { NULL, 0, buf, arrayFunc };
+    g_auto(virBuffer) prefix = VIR_BUFFER_INITIALIZER;
     virJSONType type = virJSONValueGetType(value);
     virJSONValuePtr elem;
     bool tmp;
@@ -144,22 +153,19 @@ virQEMUBuildCommandLineJSONRecurse(const char *key,
 
     switch (type) {
     case VIR_JSON_TYPE_STRING:
-        virBufferAsprintf(buf, "%s=", key);
+        virBufferStrcat(buf, key, "=", NULL);
         virQEMUBuildBufferEscapeComma(buf, virJSONValueGetString(value));
-        virBufferAddLit(buf, ",");
+        virBufferAddChar(buf, ',');
         break;
 
     case VIR_JSON_TYPE_NUMBER:
-        virBufferAsprintf(buf, "%s=%s,", key, virJSONValueGetNumberString(value));
+        virBufferStrcat(buf, key, "=", virJSONValueGetNumberString(value),
+                        ",", NULL);
         break;
 
     case VIR_JSON_TYPE_BOOLEAN:
         virJSONValueGetBoolean(value, &tmp);
-        if (tmp)
-            virBufferAsprintf(buf, "%s=yes,", key);
-        else
-            virBufferAsprintf(buf, "%s=no,", key);
-
+        virBufferStrcat(buf, key, tmp ? "=yes," : "=no,", NULL);
         break;
 
     case VIR_JSON_TYPE_ARRAY:
@@ -185,6 +191,12 @@ virQEMUBuildCommandLineJSONRecurse(const char *key,
         break;
 
     case VIR_JSON_TYPE_OBJECT:
+        if (key) {
+            virBufferStrcat(&prefix, key, ".", NULL);
+            data.key = &prefix;
+            data.prefixlen = virBufferUse(&prefix);
+        }
+
         if (virJSONValueObjectForeachKeyValue(value,
                                               virQEMUBuildCommandLineJSONIterate,
                                               &data) < 0)
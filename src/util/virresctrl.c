@@ -28,9 +28,11 @@
 #include "virresctrlpriv.h"
 #include "viralloc.h"
 #include "virfile.h"
+#include "virhash.h"
 #include "virlog.h"
 #include "virobject.h"
 #include "virstring.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_RESCTRL
 
@@ -1790,6 +1792,70 @@ virResctrlAllocGetDefault(virResctrlInfoPtr resctrl)
 }
 
 
+/*
+ * Allocations of the groups created by virResctrlAllocCreate, keyed by
+ * the name of the group. These are exactly what was written to their
+ * schemata files, so virResctrlAllocGetUnused doesn't have to read and
+ * parse those again for every new allocation. Groups created by anyone
+ * else are always read from sysfs.
+ */
+static virMutex virResctrlGroupsLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr virResctrlGroups;
+
+
+static void
+virResctrlGroupsAdd(virResctrlInfoPtr resctrl,
+                    const char *path,
+                    const char *schemata)
+{
+    g_autofree char *groupname = g_path_get_basename(path);
+    virResctrlAllocPtr alloc = virResctrlAllocNew();
+
+    if (!alloc || virResctrlAllocParse(resctrl, alloc, schemata) < 0) {
+        /* The group will be read from sysfs instead */
+        virObjectUnref(alloc);
+        virResetLastError();
+        return;
+    }
+
+    virMutexLock(&virResctrlGroupsLock);
+    if (!virResctrlGroups)
+        virResctrlGroups = virHashCreate(32, virObjectFreeHashData);
+    if (!virResctrlGroups ||
+        virHashUpdateEntry(virResctrlGroups, groupname, alloc) < 0) {
+        virObjectUnref(alloc);
+        virResetLastError();
+    }
+    virMutexUnlock(&virResctrlGroupsLock);
+}
+
+
+static void
+virResctrlGroupsRemove(const char *path)
+{
+    g_autofree char *groupname = g_path_get_basename(path);
+
+    virMutexLock(&virResctrlGroupsLock);
+    if (virResctrlGroups)
+        virHashRemoveEntry(virResctrlGroups, groupname);
+    virMutexUnlock(&virResctrlGroupsLock);
+}
+
+
+static virResctrlAllocPtr
+virResctrlGroupsLookup(const char *groupname)
+{
+    virResctrlAllocPtr alloc = NULL;
+
+    virMutexLock(&virResctrlGroupsLock);
+    if (virResctrlGroups)
+        alloc = virObjectRef(virHashLookup(virResctrlGroups, groupname));
+    virMutexUnlock(&virResctrlGroupsLock);
+
+    return alloc;
+}
+
+
 static void
 virResctrlAllocSubtractPerType(virResctrlAllocPerTypePtr dst,
                                virResctrlAllocPerTypePtr src)
@@ -1936,6 +2002,13 @@ virResctrlAllocGetUnused(virResctrlInfoPtr resctrl)
         if (STREQ(ent->d_name, "info"))
             continue;
 
+        if ((alloc = virResctrlGroupsLookup(ent->d_name))) {
+            virResctrlAllocSubtract(ret, alloc);
+            virObjectUnref(alloc);
+            alloc = NULL;
+            continue;
+        }
+
         rv = virResctrlAllocGetGroup(resctrl, ent->d_name, &alloc);
         if (rv == -2)
             continue;
@@ -2424,6 +2497,8 @@ virResctrlAllocCreate(virResctrlInfoPtr resctrl,
         goto cleanup;
     }
 
+    virResctrlGroupsAdd(resctrl, alloc->path, alloc_str);
+
     ret = 0;
  cleanup:
     virResctrlUnlock(lockfd);
@@ -2492,6 +2567,7 @@ virResctrlAllocRemove(virResctrlAllocPtr alloc)
         return 0;
 
     VIR_DEBUG("Removing resctrl allocation %s", alloc->path);
+    virResctrlGroupsRemove(alloc->path);
     if (rmdir(alloc->path) != 0 && errno != ENOENT) {
         ret = -errno;
         VIR_ERROR(_("Unable to remove %s (%d)"), alloc->path, errno);
@@ -27,10 +27,12 @@
 
 #include "virrotatingfile.h"
 #include "viralloc.h"
+#include "vircommand.h"
 #include "virerror.h"
 #include "virstring.h"
 #include "virfile.h"
 #include "virlog.h"
+#include "virthread.h"
 
 VIR_LOG_INIT("util.rotatingfile");
 
@@ -38,6 +40,30 @@ VIR_LOG_INIT("util.rotatingfile");
 
 #define VIR_MAX_MAX_BACKUP 32
 
+VIR_ENUM_IMPL(virRotatingFileCompress,
+              VIR_ROTATING_FILE_COMPRESS_LAST,
+              "none",
+              "gzip",
+              "xz",
+              "zstd",
+);
+
+/* Suffixes of compressed backup files, the compression programs are
+ * named like the format */
+static const char *virRotatingFileCompressSuffix[] = {
+    [VIR_ROTATING_FILE_COMPRESS_NONE] = "",
+    [VIR_ROTATING_FILE_COMPRESS_GZIP] = ".gz",
+    [VIR_ROTATING_FILE_COMPRESS_XZ] = ".xz",
+    [VIR_ROTATING_FILE_COMPRESS_ZSTD] = ".zst",
+};
+G_STATIC_ASSERT(G_N_ELEMENTS(virRotatingFileCompressSuffix) ==
+                VIR_ROTATING_FILE_COMPRESS_LAST);
+
+/* Serializes renaming backup files between rollover and the threads
+ * compressing them, which may belong to different writers of the
+ * same file */
+static virMutex virRotatingFileLock = VIR_MUTEX_INITIALIZER;
+
 typedef struct virRotatingFileWriterEntry virRotatingFileWriterEntry;
 typedef virRotatingFileWriterEntry *virRotatingFileWriterEntryPtr;
 
@@ -57,6 +83,13 @@ struct virRotatingFileWriter {
     size_t maxbackup;
     mode_t mode;
     size_t maxlen;
+    virRotatingFileCompress compress;
+
+    /* Require virRotatingFileLock */
+    bool compressing; /* compressThread is working */
+    bool compressQuit; /* asks compressThread to stop */
+    bool compressJoin; /* compressThread was started */
+    virThread compressThread;
 };
 
 
@@ -64,6 +97,13 @@ struct virRotatingFileReaderEntry {
     char *path;
     int fd;
     off_t inode;
+
+    /* Compressed backups are decompressed into memory once reached */
+    virRotatingFileCompress compress;
+    bool loaded;
+    char *data;
+    size_t datalen;
+    size_t datapos;
 };
 
 struct virRotatingFileReader {
@@ -91,6 +131,7 @@ virRotatingFileReaderEntryFree(virRotatingFileReaderEntryPtr entry)
         return;
 
     VIR_FREE(entry->path);
+    VIR_FREE(entry->data);
     VIR_FORCE_CLOSE(entry->fd);
     VIR_FREE(entry);
 }
@@ -168,6 +209,24 @@ virRotatingFileReaderEntryNew(const char *path)
         }
 
         entry->inode = sb.st_ino;
+    } else {
+        size_t i;
+
+        /* Maybe the backup has been compressed already */
+        for (i = VIR_ROTATING_FILE_COMPRESS_NONE + 1;
+             i < VIR_ROTATING_FILE_COMPRESS_LAST; i++) {
+            g_autofree char *zpath = g_strdup_printf("%s%s", path,
+                                                     virRotatingFileCompressSuffix[i]);
+
+            if (stat(zpath, &sb) < 0)
+                continue;
+
+            VIR_DEBUG("Found compressed %s", zpath);
+            entry->compress = i;
+            entry->inode = sb.st_ino;
+            entry->path = g_steal_pointer(&zpath);
+            return entry;
+        }
     }
 
     entry->path = g_strdup(path);
@@ -180,6 +239,72 @@ virRotatingFileReaderEntryNew(const char *path)
 }
 
 
+/* Removes the backup @path along with its compressed variants */
+static int
+virRotatingFileBackupDelete(const char *path)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_ROTATING_FILE_COMPRESS_LAST; i++) {
+        g_autofree char *zpath = g_strdup_printf("%s%s", path,
+                                                 virRotatingFileCompressSuffix[i]);
+
+        if (unlink(zpath) < 0 &&
+            errno != ENOENT) {
+            virReportSystemError(errno,
+                                 _("Unable to delete file %s"),
+                                 zpath);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Renames the backup @src along with its compressed variants to @dst,
+ * replacing all variants of @dst. Nothing happens if @src is missing */
+static int
+virRotatingFileBackupRename(const char *src,
+                            const char *dst)
+{
+    bool found = false;
+    size_t i;
+
+    for (i = 0; i < VIR_ROTATING_FILE_COMPRESS_LAST && !found; i++) {
+        g_autofree char *zsrc = g_strdup_printf("%s%s", src,
+                                                virRotatingFileCompressSuffix[i]);
+
+        found = virFileExists(zsrc);
+    }
+
+    if (!found)
+        return 0;
+
+    if (virRotatingFileBackupDelete(dst) < 0)
+        return -1;
+
+    for (i = 0; i < VIR_ROTATING_FILE_COMPRESS_LAST; i++) {
+        g_autofree char *zsrc = g_strdup_printf("%s%s", src,
+                                                virRotatingFileCompressSuffix[i]);
+        g_autofree char *zdst = g_strdup_printf("%s%s", dst,
+                                                virRotatingFileCompressSuffix[i]);
+
+        VIR_DEBUG("Rollover %s -> %s", zsrc, zdst);
+
+        if (rename(zsrc, zdst) < 0 &&
+            errno != ENOENT) {
+            virReportSystemError(errno,
+                                 _("Unable to rename %s to %s"),
+                                 zsrc, zdst);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
 static int
 virRotatingFileWriterDelete(virRotatingFileWriterPtr file)
 {
@@ -194,18 +319,11 @@ virRotatingFileWriterDelete(virRotatingFileWriterPtr file)
     }
 
     for (i = 0; i < file->maxbackup; i++) {
-        char *oldpath;
+        g_autofree char *oldpath = NULL;
         oldpath = g_strdup_printf("%s.%zu", file->basepath, i);
 
-        if (unlink(oldpath) < 0 &&
-            errno != ENOENT) {
-            virReportSystemError(errno,
-                                 _("Unable to delete file %s"),
-                                 oldpath);
-            VIR_FREE(oldpath);
+        if (virRotatingFileBackupDelete(oldpath) < 0)
             return -1;
-        }
-        VIR_FREE(oldpath);
     }
 
     return 0;
@@ -323,6 +441,24 @@ virRotatingFileReaderNew(const char *path,
 }
 
 
+/**
+ * virRotatingFileWriterSetCompress:
+ * @file: the file context
+ * @compress: the compression format for backup files
+ *
+ * Make backup files get compressed with @compress once they're rolled
+ * over. Compression is done by a background thread so that writing
+ * to the file is not held up by it. A backup which is compressed gets
+ * the suffix of the format appended to its name.
+ */
+void
+virRotatingFileWriterSetCompress(virRotatingFileWriterPtr file,
+                                 virRotatingFileCompress compress)
+{
+    file->compress = compress;
+}
+
+
 /**
  * virRotatingFileWriterGetPath:
  * @file: the file context
@@ -362,6 +498,160 @@ virRotatingFileWriterGetOffset(virRotatingFileWriterPtr file)
 }
 
 
+/* Looks up the first backup of @file which is not compressed yet if
+ * @inode is 0, the backup with the given @inode otherwise, and fills
+ * @sb with its attributes. Returns its index, or -1 if there's none */
+static ssize_t
+virRotatingFileWriterFindBackup(virRotatingFileWriterPtr file,
+                                ino_t inode,
+                                struct stat *sb)
+{
+    size_t i;
+
+    for (i = 0; i < file->maxbackup; i++) {
+        g_autofree char *path = g_strdup_printf("%s.%zu", file->basepath, i);
+
+        if (stat(path, sb) < 0)
+            continue;
+
+        if (inode == 0 || sb->st_ino == inode)
+            return i;
+    }
+
+    return -1;
+}
+
+
+/* Compresses @fd into the new file @dstpath */
+static int
+virRotatingFileWriterCompressFD(virRotatingFileWriterPtr file,
+                                int fd,
+                                const char *dstpath)
+{
+    g_autoptr(virCommand) cmd = NULL;
+    VIR_AUTOCLOSE outfd = -1;
+
+    if ((outfd = open(dstpath, O_CREAT|O_TRUNC|O_WRONLY|O_CLOEXEC,
+                      file->mode)) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to open file: %s"), dstpath);
+        return -1;
+    }
+
+    cmd = virCommandNewArgList(virRotatingFileCompressTypeToString(file->compress),
+                               "-c", NULL);
+    virCommandSetInputFD(cmd, fd);
+    virCommandSetOutputFD(cmd, &outfd);
+
+    return virCommandRun(cmd, NULL);
+}
+
+
+/*
+ * Compresses the backups of @file one by one until there's none left
+ * uncompressed. Compressing happens without virRotatingFileLock held,
+ * so the backup may get rotated further meanwhile. It's looked up by
+ * its inode once the compressed copy is complete, which then replaces
+ * the backup under its current name.
+ */
+static void
+virRotatingFileWriterCompressWorker(void *opaque)
+{
+    virRotatingFileWriterPtr file = opaque;
+    const char *suffix = virRotatingFileCompressSuffix[file->compress];
+
+    virMutexLock(&virRotatingFileLock);
+
+    while (!file->compressQuit) {
+        g_autofree char *path = NULL;
+        g_autofree char *zpath = NULL;
+        g_autofree char *tmppath = NULL;
+        VIR_AUTOCLOSE fd = -1;
+        struct stat sb;
+        ssize_t idx;
+        int rc;
+
+        if ((idx = virRotatingFileWriterFindBackup(file, 0, &sb)) < 0)
+            break;
+
+        path = g_strdup_printf("%s.%zd", file->basepath, idx);
+        if ((fd = open(path, O_RDONLY|O_CLOEXEC)) < 0 ||
+            fstat(fd, &sb) < 0) {
+            VIR_WARN("Unable to open backup %s: %s",
+                     path, g_strerror(errno));
+            break;
+        }
+
+        tmppath = g_strdup_printf("%s.%llu.tmp", file->basepath,
+                                  (unsigned long long)sb.st_ino);
+
+        virMutexUnlock(&virRotatingFileLock);
+        VIR_DEBUG("Compressing %s into %s", path, tmppath);
+        rc = virRotatingFileWriterCompressFD(file, fd, tmppath);
+        virMutexLock(&virRotatingFileLock);
+
+        if (rc < 0) {
+            VIR_WARN("Unable to compress backup of %s: %s",
+                     file->basepath, virGetLastErrorMessage());
+            virResetLastError();
+            unlink(tmppath);
+            break;
+        }
+
+        if ((idx = virRotatingFileWriterFindBackup(file, sb.st_ino, &sb)) < 0) {
+            VIR_DEBUG("Backup %s was rotated out meanwhile", path);
+            unlink(tmppath);
+            continue;
+        }
+
+        VIR_FREE(path);
+        path = g_strdup_printf("%s.%zd", file->basepath, idx);
+        zpath = g_strdup_printf("%s%s", path, suffix);
+
+        if (rename(tmppath, zpath) < 0 ||
+            unlink(path) < 0) {
+            VIR_WARN("Unable to replace %s with %s: %s",
+                     path, zpath, g_strerror(errno));
+            unlink(tmppath);
+            break;
+        }
+    }
+
+    file->compressing = false;
+    virMutexUnlock(&virRotatingFileLock);
+}
+
+
+/* Starts compressing the backups of @file in the background unless
+ * it's being done already. Must be called with virRotatingFileLock
+ * held */
+static void
+virRotatingFileWriterCompressStart(virRotatingFileWriterPtr file)
+{
+    if (file->compress == VIR_ROTATING_FILE_COMPRESS_NONE ||
+        file->compressing ||
+        file->compressQuit)
+        return;
+
+    /* The thread is done, it only has to unlock virRotatingFileLock */
+    if (file->compressJoin) {
+        virThreadJoin(&file->compressThread);
+        file->compressJoin = false;
+    }
+
+    if (virThreadCreateFull(&file->compressThread, true,
+                            virRotatingFileWriterCompressWorker,
+                            "rotating-compress", false, file) < 0) {
+        VIR_WARN("Unable to start compressing backups of %s",
+                 file->basepath);
+        return;
+    }
+
+    file->compressing = true;
+    file->compressJoin = true;
+}
+
+
 static int
 virRotatingFileWriterRollover(virRotatingFileWriterPtr file)
 {
@@ -371,6 +661,8 @@ virRotatingFileWriterRollover(virRotatingFileWriterPtr file)
     int ret = -1;
 
     VIR_DEBUG("Rollover %s", file->basepath);
+    virMutexLock(&virRotatingFileLock);
+
     if (file->maxbackup == 0) {
         if (unlink(file->basepath) < 0 &&
             errno != ENOENT) {
@@ -385,28 +677,38 @@ virRotatingFileWriterRollover(virRotatingFileWriterPtr file)
         for (i = file->maxbackup; i > 0; i--) {
             if (i == 1) {
                 thispath = g_strdup(file->basepath);
+                VIR_DEBUG("Rollover %s -> %s", thispath, nextpath);
+
+                if (virFileExists(thispath) &&
+                    virRotatingFileBackupDelete(nextpath) < 0)
+                    goto cleanup;
+
+                if (rename(thispath, nextpath) < 0 &&
+                    errno != ENOENT) {
+                    virReportSystemError(errno,
+                                         _("Unable to rename %s to %s"),
+                                         thispath, nextpath);
+                    goto cleanup;
+                }
             } else {
                 thispath = g_strdup_printf("%s.%zu", file->basepath, i - 2);
-            }
-            VIR_DEBUG("Rollover %s -> %s", thispath, nextpath);
 
-            if (rename(thispath, nextpath) < 0 &&
-                errno != ENOENT) {
-                virReportSystemError(errno,
-                                     _("Unable to rename %s to %s"),
-                                     thispath, nextpath);
-                goto cleanup;
+                if (virRotatingFileBackupRename(thispath, nextpath) < 0)
+                    goto cleanup;
             }
 
             VIR_FREE(nextpath);
             nextpath = g_steal_pointer(&thispath);
         }
+
+        virRotatingFileWriterCompressStart(file);
     }
 
     VIR_DEBUG("Rollover done %s", file->basepath);
 
     ret = 0;
  cleanup:
+    virMutexUnlock(&virRotatingFileLock);
     VIR_FREE(nextpath);
     VIR_FREE(thispath);
     return ret;
@@ -534,6 +836,11 @@ virRotatingFileReaderSeek(virRotatingFileReaderPtr file,
     }
 
     file->current = 0;
+    if (file->entries[0]->compress) {
+        file->entries[0]->datapos = offset;
+        return 0;
+    }
+
     ret = lseek(file->entries[0]->fd, offset, SEEK_SET);
     if (ret == (off_t)-1) {
         virReportSystemError(errno,
@@ -545,6 +852,32 @@ virRotatingFileReaderSeek(virRotatingFileReaderPtr file,
 }
 
 
+/* Decompresses the backup of @entry into memory unless done already */
+static int
+virRotatingFileReaderEntryLoad(virRotatingFileReaderEntryPtr entry)
+{
+    g_autoptr(virCommand) cmd = NULL;
+
+    if (entry->loaded)
+        return 0;
+
+    VIR_DEBUG("Decompressing %s", entry->path);
+
+    cmd = virCommandNewArgList(virRotatingFileCompressTypeToString(entry->compress),
+                               "-dc", entry->path, NULL);
+    virCommandSetOutputBuffer(cmd, &entry->data);
+
+    if (virCommandRun(cmd, NULL) < 0)
+        return -1;
+
+    entry->datalen = entry->data ? strlen(entry->data) : 0;
+    entry->datapos = MIN(entry->datapos, entry->datalen);
+    entry->loaded = true;
+
+    return 0;
+}
+
+
 /**
  * virRotatingFileReaderConsume:
  * @file: the file context
@@ -572,17 +905,26 @@ virRotatingFileReaderConsume(virRotatingFileReaderPtr file,
             break;
 
         entry = file->entries[file->current];
-        if (entry->fd == -1) {
-            file->current++;
-            continue;
-        }
+        if (entry->compress) {
+            if (virRotatingFileReaderEntryLoad(entry) < 0)
+                return -1;
 
-        got = saferead(entry->fd, buf + ret, len);
-        if (got < 0) {
-            virReportSystemError(errno,
-                                 _("Unable to read from file %s"),
-                                 entry->path);
-            return -1;
+            got = MIN(len, entry->datalen - entry->datapos);
+            memcpy(buf + ret, entry->data + entry->datapos, got);
+            entry->datapos += got;
+        } else {
+            if (entry->fd == -1) {
+                file->current++;
+                continue;
+            }
+
+            got = saferead(entry->fd, buf + ret, len);
+            if (got < 0) {
+                virReportSystemError(errno,
+                                     _("Unable to read from file %s"),
+                                     entry->path);
+                return -1;
+            }
         }
 
         if (got == 0) {
@@ -610,6 +952,13 @@ virRotatingFileWriterFree(virRotatingFileWriterPtr file)
     if (!file)
         return;
 
+    virMutexLock(&virRotatingFileLock);
+    file->compressQuit = true;
+    virMutexUnlock(&virRotatingFileLock);
+
+    if (file->compressJoin)
+        virThreadJoin(&file->compressThread);
+
     virRotatingFileWriterEntryFree(file->entry);
     VIR_FREE(file->basepath);
     VIR_FREE(file);
@@ -22,6 +22,18 @@
 #pragma once
 
 #include "internal.h"
+#include "virenum.h"
+
+typedef enum {
+    VIR_ROTATING_FILE_COMPRESS_NONE = 0,
+    VIR_ROTATING_FILE_COMPRESS_GZIP,
+    VIR_ROTATING_FILE_COMPRESS_XZ,
+    VIR_ROTATING_FILE_COMPRESS_ZSTD,
+
+    VIR_ROTATING_FILE_COMPRESS_LAST
+} virRotatingFileCompress;
+
+VIR_ENUM_DECL(virRotatingFileCompress);
 
 typedef struct virRotatingFileWriter virRotatingFileWriter;
 typedef virRotatingFileWriter *virRotatingFileWriterPtr;
@@ -38,6 +50,9 @@ virRotatingFileWriterPtr virRotatingFileWriterNew(const char *path,
 virRotatingFileReaderPtr virRotatingFileReaderNew(const char *path,
                                                   size_t maxbackup);
 
+void virRotatingFileWriterSetCompress(virRotatingFileWriterPtr file,
+                                      virRotatingFileCompress compress);
+
 const char *virRotatingFileWriterGetPath(virRotatingFileWriterPtr file);
 
 ino_t virRotatingFileWriterGetINode(virRotatingFileWriterPtr file);
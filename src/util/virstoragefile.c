@@ -24,6 +24,7 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include "viralloc.h"
 #include "virxml.h"
 #include "viruuid.h"
@@ -39,6 +40,7 @@
 #include "virjson.h"
 #include "virstorageencryption.h"
 #include "virsecret.h"
+#include "virthread.h"
 #include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
@@ -5157,6 +5159,143 @@ virStorageFileReportBrokenChain(int errcode,
 }
 
 
+/* Headers of local images read while walking backing chains, so that
+ * chains which are walked again, e.g. on every start of a domain, don't
+ * have to be read again as long as the images didn't change */
+#define VIR_STORAGE_FILE_HEADER_CACHE_MAX 1024
+
+typedef struct _virStorageFileHeaderCacheId virStorageFileHeaderCacheId;
+typedef virStorageFileHeaderCacheId *virStorageFileHeaderCacheIdPtr;
+struct _virStorageFileHeaderCacheId {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+};
+
+typedef struct _virStorageFileHeaderCacheEntry virStorageFileHeaderCacheEntry;
+typedef virStorageFileHeaderCacheEntry *virStorageFileHeaderCacheEntryPtr;
+struct _virStorageFileHeaderCacheEntry {
+    virStorageFileHeaderCacheId id;
+    char *buf;
+    size_t len;
+};
+
+static virHashTablePtr virStorageFileHeaderCache;
+static virMutex virStorageFileHeaderCacheLock = VIR_MUTEX_INITIALIZER;
+
+
+static void
+virStorageFileHeaderCacheEntryFree(void *payload)
+{
+    virStorageFileHeaderCacheEntryPtr entry = payload;
+
+    g_free(entry->buf);
+    g_free(entry);
+}
+
+
+/* Returns false if @src can't be cached */
+static bool
+virStorageFileHeaderCacheGetId(virStorageSourcePtr src,
+                               virStorageFileHeaderCacheIdPtr id)
+{
+    struct stat sb;
+
+    if (src->type != VIR_STORAGE_TYPE_FILE || !src->path)
+        return false;
+
+    if (stat(src->path, &sb) < 0 || !S_ISREG(sb.st_mode))
+        return false;
+
+    id->dev = sb.st_dev;
+    id->ino = sb.st_ino;
+    id->size = sb.st_size;
+#ifdef __APPLE__
+    id->mtime = sb.st_mtimespec;
+    id->ctime = sb.st_ctimespec;
+#else /* ! __APPLE__ */
+    id->mtime = sb.st_mtim;
+    id->ctime = sb.st_ctim;
+#endif /* ! __APPLE__ */
+
+    return true;
+}
+
+
+static bool
+virStorageFileHeaderCacheIdEqual(const virStorageFileHeaderCacheId *a,
+                                 const virStorageFileHeaderCacheId *b)
+{
+    return a->dev == b->dev &&
+        a->ino == b->ino &&
+        a->size == b->size &&
+        a->mtime.tv_sec == b->mtime.tv_sec &&
+        a->mtime.tv_nsec == b->mtime.tv_nsec &&
+        a->ctime.tv_sec == b->ctime.tv_sec &&
+        a->ctime.tv_nsec == b->ctime.tv_nsec;
+}
+
+
+/* Returns true and fills @buf and @len if the cached header of the
+ * image identified by @name is still valid */
+static bool
+virStorageFileHeaderCacheLookup(const char *name,
+                                const virStorageFileHeaderCacheId *id,
+                                char **buf,
+                                size_t *len)
+{
+    virStorageFileHeaderCacheEntryPtr entry = NULL;
+    bool ret = false;
+
+    virMutexLock(&virStorageFileHeaderCacheLock);
+
+    if (virStorageFileHeaderCache)
+        entry = virHashLookup(virStorageFileHeaderCache, name);
+
+    if (entry && virStorageFileHeaderCacheIdEqual(&entry->id, id)) {
+        *buf = g_memdup(entry->buf, entry->len);
+        *len = entry->len;
+        ret = true;
+    }
+
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+
+    return ret;
+}
+
+
+static void
+virStorageFileHeaderCacheInsert(const char *name,
+                                const virStorageFileHeaderCacheId *id,
+                                const char *buf,
+                                size_t len)
+{
+    virStorageFileHeaderCacheEntryPtr entry = g_new0(virStorageFileHeaderCacheEntry, 1);
+
+    entry->id = *id;
+    entry->buf = g_memdup(buf, len);
+    entry->len = len;
+
+    virMutexLock(&virStorageFileHeaderCacheLock);
+
+    if (!virStorageFileHeaderCache)
+        virStorageFileHeaderCache = virHashNew(virStorageFileHeaderCacheEntryFree);
+
+    /* Start over instead of tracking which entries are still used */
+    if (virHashSize(virStorageFileHeaderCache) >= VIR_STORAGE_FILE_HEADER_CACHE_MAX)
+        virHashRemoveAll(virStorageFileHeaderCache);
+
+    if (virHashUpdateEntry(virStorageFileHeaderCache, name, entry) < 0) {
+        virStorageFileHeaderCacheEntryFree(entry);
+        virResetLastError();
+    }
+
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+}
+
+
 static int
 virStorageFileGetMetadataRecurseReadHeader(virStorageSourcePtr src,
                                            virStorageSourcePtr parent,
@@ -5169,6 +5308,9 @@ virStorageFileGetMetadataRecurseReadHeader(virStorageSourcePtr src,
     int ret = -1;
     const char *uniqueName;
     ssize_t len;
+    virStorageFileHeaderCacheId id;
+    virStorageFileHeaderCacheId newid;
+    g_autofree char *cacheName = NULL;
 
     if (virStorageFileInitAs(src, uid, gid) < 0)
         return -1;
@@ -5191,10 +5333,29 @@ virStorageFileGetMetadataRecurseReadHeader(virStorageSourcePtr src,
     if (virHashAddEntry(cycle, uniqueName, NULL) < 0)
         goto cleanup;
 
+    /* The header was read as @uid:@gid, don't hand it out to others */
+    if (virStorageFileHeaderCacheGetId(src, &id)) {
+        cacheName = g_strdup_printf("%u:%u:%s", (unsigned int) uid,
+                                    (unsigned int) gid, src->path);
+
+        if (virStorageFileHeaderCacheLookup(cacheName, &id, buf, headerLen)) {
+            VIR_DEBUG("using cached header of '%s'", src->path);
+            ret = 0;
+            goto cleanup;
+        }
+    }
+
     if ((len = virStorageFileRead(src, 0, VIR_STORAGE_MAX_HEADER, buf)) < 0)
         goto cleanup;
 
     *headerLen = len;
+
+    /* Only cache the header if the image didn't change while reading it */
+    if (cacheName &&
+        virStorageFileHeaderCacheGetId(src, &newid) &&
+        virStorageFileHeaderCacheIdEqual(&id, &newid))
+        virStorageFileHeaderCacheInsert(cacheName, &id, *buf, *headerLen);
+
     ret = 0;
 
  cleanup:
@@ -29,6 +29,7 @@
 #include "viralloc.h"
 #include "virbuffer.h"
 #include "virerror.h"
+#include "virhash.h"
 #include "virlog.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
@@ -1404,3 +1405,104 @@ int virStringParseYesNo(const char *str, bool *result)
 
     return 0;
 }
+
+
+/* Interned strings, keyed by their content */
+typedef struct _virStringInternEntry virStringInternEntry;
+typedef virStringInternEntry *virStringInternEntryPtr;
+struct _virStringInternEntry {
+    size_t refs;
+    char *str;
+};
+
+static virHashTablePtr virStringInternTable;
+static virMutex virStringInternLock = VIR_MUTEX_INITIALIZER;
+
+
+static void
+virStringInternEntryFree(void *payload)
+{
+    virStringInternEntryPtr entry = payload;
+
+    g_free(entry->str);
+    g_free(entry);
+}
+
+
+/**
+ * virStringIntern:
+ * @str: string to intern, may be NULL
+ *
+ * Returns a shared copy of @str. All callers interning equal strings are
+ * handed the very same copy, which avoids keeping many copies of strings
+ * that repeat across lots of objects, e.g. driver or model names of
+ * devices. The returned string must not be modified and has to be released
+ * with virStringInternRelease instead of being freed.
+ *
+ * Returns the shared copy or NULL if @str is NULL.
+ */
+const char *
+virStringIntern(const char *str)
+{
+    virStringInternEntryPtr entry;
+    const char *ret;
+
+    if (!str)
+        return NULL;
+
+    virMutexLock(&virStringInternLock);
+
+    if (!virStringInternTable)
+        virStringInternTable = virHashNew(virStringInternEntryFree);
+
+    if (!(entry = virHashLookup(virStringInternTable, str))) {
+        entry = g_new0(virStringInternEntry, 1);
+        entry->str = g_strdup(str);
+
+        if (virHashAddEntry(virStringInternTable, str, entry) < 0) {
+            /* Don't fail the caller, just don't share the copy */
+            virStringInternEntryFree(entry);
+            virResetLastError();
+            virMutexUnlock(&virStringInternLock);
+            return g_strdup(str);
+        }
+    }
+
+    entry->refs++;
+    ret = entry->str;
+
+    virMutexUnlock(&virStringInternLock);
+    return ret;
+}
+
+
+/**
+ * virStringInternRelease:
+ * @str: string returned by virStringIntern, may be NULL
+ *
+ * Drops a reference to an interned string. The shared copy is freed once
+ * the last reference is gone.
+ */
+void
+virStringInternRelease(const char *str)
+{
+    virStringInternEntryPtr entry = NULL;
+
+    if (!str)
+        return;
+
+    virMutexLock(&virStringInternLock);
+
+    if (virStringInternTable)
+        entry = virHashLookup(virStringInternTable, str);
+
+    if (entry && entry->str == str) {
+        if (--entry->refs == 0)
+            virHashRemoveEntry(virStringInternTable, str);
+    } else {
+        /* Copy made when adding to the table failed */
+        g_free((char *) str);
+    }
+
+    virMutexUnlock(&virStringInternLock);
+}
@@ -185,6 +185,9 @@ int virStringParsePort(const char *str,
 int virStringParseYesNo(const char *str,
                         bool *result)
     G_GNUC_WARN_UNUSED_RESULT;
+
+const char *virStringIntern(const char *str);
+void virStringInternRelease(const char *str);
 /**
  * VIR_AUTOSTRINGLIST:
  *
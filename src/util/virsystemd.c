@@ -278,8 +278,10 @@ int virSystemdCreateMachine(const char *name,
     DBusConnection *conn;
     char *creatorname = NULL;
     char *slicename = NULL;
-    char *scopename = NULL;
     static int hasCreateWithNetwork = 1;
+    /* TasksMax is the last of the scope properties and is only
+     * passed if there is a limit */
+    int nprops = maxthreads > 0 ? 4 : 3;
 
     if ((ret = virSystemdHasMachined()) < 0)
         return ret;
@@ -343,7 +345,9 @@ int virSystemdCreateMachine(const char *name,
      *
      * @scope_properties:an array (not a dict!) of properties that are
      * passed on to PID 1 when creating a scope unit for your machine.
-     * Will allow initial settings for the cgroup & similar.
+     * Will allow initial settings for the cgroup & similar. Setting
+     * TasksMax here rather than by a SetUnitProperties call on the
+     * scope afterwards saves a round-trip to systemd.
      *
      * @path: a bus path returned for the machine object created, to
      * allow further API calls to be made against the object.
@@ -374,10 +378,11 @@ int virSystemdCreateMachine(const char *name,
                               (unsigned int)pidleader,
                               NULLSTR_EMPTY(rootdir),
                               nnicindexes, nicindexes,
-                              3,
+                              nprops,
                               "Slice", "s", slicename,
                               "After", "as", 1, "libvirtd.service",
-                              "Before", "as", 1, "virt-guest-shutdown.target") < 0)
+                              "Before", "as", 1, "virt-guest-shutdown.target",
+                              "TasksMax", "t", (uint64_t)maxthreads) < 0)
             goto cleanup;
 
         if (error.level == VIR_ERR_ERROR) {
@@ -415,28 +420,10 @@ int virSystemdCreateMachine(const char *name,
                               iscontainer ? "container" : "vm",
                               (unsigned int)pidleader,
                               NULLSTR_EMPTY(rootdir),
-                              3,
+                              nprops,
                               "Slice", "s", slicename,
                               "After", "as", 1, "libvirtd.service",
-                              "Before", "as", 1, "virt-guest-shutdown.target") < 0)
-            goto cleanup;
-    }
-
-    if (maxthreads > 0) {
-        if (!(scopename = virSystemdMakeScopeName(name, drivername, false)))
-            goto cleanup;
-
-        if (virDBusCallMethod(conn,
-                              NULL,
-                              NULL,
-                              "org.freedesktop.systemd1",
-                              "/org/freedesktop/systemd1",
-                              "org.freedesktop.systemd1.Manager",
-                              "SetUnitProperties",
-                              "sba(sv)",
-                              scopename,
-                              true,
-                              1,
+                              "Before", "as", 1, "virt-guest-shutdown.target",
                               "TasksMax", "t", (uint64_t)maxthreads) < 0)
             goto cleanup;
     }
@@ -446,28 +433,34 @@ int virSystemdCreateMachine(const char *name,
  cleanup:
     VIR_FREE(creatorname);
     VIR_FREE(slicename);
-    VIR_FREE(scopename);
     return ret;
 }
 
+/**
+ * virSystemdTerminateMachine:
+ * @name: name of the machine
+ *
+ * Asks systemd-machined to terminate the machine @name without waiting
+ * for the reply, so that domains stopping at the same time don't queue
+ * up on machined. A failure reported by machined, e.g. because the
+ * machine is gone already, is only logged.
+ *
+ * Returns 0 on success, -1 on fatal error, or -2 if systemd-machine is
+ * not available
+ */
 int virSystemdTerminateMachine(const char *name)
 {
     int ret;
     DBusConnection *conn;
-    virError error;
 
     if (!name)
         return 0;
 
-    memset(&error, 0, sizeof(error));
-
     if ((ret = virSystemdHasMachined()) < 0)
-        goto cleanup;
-
-    ret = -1;
+        return ret;
 
     if (!(conn = virDBusGetSystemBus()))
-        goto cleanup;
+        return -1;
 
     /*
      * The systemd DBus API we're invoking has the
@@ -480,30 +473,13 @@ int virSystemdTerminateMachine(const char *name)
      */
 
     VIR_DEBUG("Attempting to terminate machine via systemd");
-    if (virDBusCallMethod(conn,
-                          NULL,
-                          &error,
-                          "org.freedesktop.machine1",
-                          "/org/freedesktop/machine1",
-                          "org.freedesktop.machine1.Manager",
-                          "TerminateMachine",
-                          "s",
-                          name) < 0)
-        goto cleanup;
-
-    if (error.level == VIR_ERR_ERROR &&
-        STRNEQ_NULLABLE("org.freedesktop.machine1.NoSuchMachine",
-                        error.str1)) {
-        virReportErrorObject(&error);
-        goto cleanup;
-    }
-
-    ret = 0;
-
- cleanup:
-    virResetError(&error);
-
-    return ret;
+    return virDBusSendMethod(conn,
+                             "org.freedesktop.machine1",
+                             "/org/freedesktop/machine1",
+                             "org.freedesktop.machine1.Manager",
+                             "TerminateMachine",
+                             "s",
+                             name);
 }
 
 void
@@ -34,8 +34,16 @@
 #endif
 
 #include "viralloc.h"
+#include "virprobe.h"
 #include "virthreadjob.h"
 
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#if WITH_LOCK_STATS
+/* Statistics of the mutexes which don't belong to any lock class */
+static virMutexStats virMutexDefaultStats = { .name = "virMutex" };
+#endif
+
 
 int virOnce(virOnceControlPtr once, virOnceFunc init)
 {
@@ -50,6 +58,10 @@ int virMutexInit(virMutexPtr m)
     pthread_mutexattr_init(&attr);
     pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_NORMAL);
     ret = pthread_mutex_init(&m->lock, &attr);
+#if WITH_LOCK_STATS
+    m->stats = NULL;
+    m->acquired = 0;
+#endif
     pthread_mutexattr_destroy(&attr);
     if (ret != 0) {
         errno = ret;
@@ -65,6 +77,10 @@ int virMutexInitRecursive(virMutexPtr m)
     pthread_mutexattr_init(&attr);
     pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
     ret = pthread_mutex_init(&m->lock, &attr);
+#if WITH_LOCK_STATS
+    m->stats = NULL;
+    m->acquired = 0;
+#endif
     pthread_mutexattr_destroy(&attr);
     if (ret != 0) {
         errno = ret;
@@ -78,17 +94,123 @@ void virMutexDestroy(virMutexPtr m)
     pthread_mutex_destroy(&m->lock);
 }
 
+#if WITH_LOCK_STATS
+static virMutexStatsPtr
+virMutexGetStats(virMutexPtr m)
+{
+    return m->stats ? m->stats : &virMutexDefaultStats;
+}
+
+
+/* Must be called with @m held, right after it was acquired */
+static void
+virMutexStatsAcquired(virMutexPtr m)
+{
+    m->acquired = g_get_monotonic_time();
+    __atomic_add_fetch(&virMutexGetStats(m)->acquisitions, 1, __ATOMIC_RELAXED);
+}
+
+
+/* Must be called with @m held, right before it is released. Nested
+ * acquisitions of a recursive mutex only count the innermost hold. */
+static void
+virMutexStatsReleased(virMutexPtr m)
+{
+    virMutexStatsPtr stats = virMutexGetStats(m);
+    unsigned long long hold;
+
+    if (m->acquired == 0)
+        return;
+
+    hold = g_get_monotonic_time() - m->acquired;
+    m->acquired = 0;
+
+    __atomic_add_fetch(&stats->holdTime, hold, __ATOMIC_RELAXED);
+    PROBE_QUIET(MUTEX_RELEASE, "mutex=%p class=%s hold=%llu",
+                m, stats->name, hold);
+}
+#endif /* WITH_LOCK_STATS */
+
+
 void virMutexLock(virMutexPtr m)
 {
+#if WITH_LOCK_STATS
+    if (pthread_mutex_trylock(&m->lock) != 0) {
+        virMutexStatsPtr stats = virMutexGetStats(m);
+        gint64 start = g_get_monotonic_time();
+        unsigned long long waited;
+
+        pthread_mutex_lock(&m->lock);
+        waited = g_get_monotonic_time() - start;
+
+        __atomic_add_fetch(&stats->contentions, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->waitTime, waited, __ATOMIC_RELAXED);
+        PROBE_QUIET(MUTEX_CONTENDED, "mutex=%p class=%s wait=%llu",
+                    m, stats->name, waited);
+    }
+    virMutexStatsAcquired(m);
+#else
     pthread_mutex_lock(&m->lock);
+#endif
 }
 
 void virMutexUnlock(virMutexPtr m)
 {
+#if WITH_LOCK_STATS
+    virMutexStatsReleased(m);
+#endif
     pthread_mutex_unlock(&m->lock);
 }
 
 
+/**
+ * virMutexSetStats:
+ * @m: the mutex
+ * @stats: statistics of the lock class of @m
+ *
+ * Accounts the contention of @m in @stats instead of the statistics
+ * shared by all the mutexes without a class. @stats must outlive @m.
+ * This is a no-op unless built with --enable-lock-stats.
+ */
+void virMutexSetStats(virMutexPtr m G_GNUC_UNUSED,
+                      virMutexStatsPtr stats G_GNUC_UNUSED)
+{
+#if WITH_LOCK_STATS
+    m->stats = stats;
+#endif
+}
+
+
+/**
+ * virMutexStatsGet:
+ * @stats: statistics of a lock class, or NULL for the mutexes without a class
+ * @result: filled with a snapshot of @stats
+ *
+ * Returns 0 on success, -1 with an error reported if this build does
+ * not collect lock statistics.
+ */
+int virMutexStatsGet(virMutexStatsPtr stats G_GNUC_UNUSED,
+                     virMutexStatsPtr result)
+{
+#if WITH_LOCK_STATS
+    if (!stats)
+        stats = &virMutexDefaultStats;
+
+    result->name = stats->name;
+    result->acquisitions = __atomic_load_n(&stats->acquisitions, __ATOMIC_RELAXED);
+    result->contentions = __atomic_load_n(&stats->contentions, __ATOMIC_RELAXED);
+    result->waitTime = __atomic_load_n(&stats->waitTime, __ATOMIC_RELAXED);
+    result->holdTime = __atomic_load_n(&stats->holdTime, __ATOMIC_RELAXED);
+    return 0;
+#else
+    memset(result, 0, sizeof(*result));
+    virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                   _("lock statistics are not collected by this build"));
+    return -1;
+#endif
+}
+
+
 int virRWLockInit(virRWLockPtr m)
 {
     int ret;
@@ -145,7 +267,14 @@ int virCondDestroy(virCondPtr c)
 int virCondWait(virCondPtr c, virMutexPtr m)
 {
     int ret;
-    if ((ret = pthread_cond_wait(&c->cond, &m->lock)) != 0) {
+#if WITH_LOCK_STATS
+    virMutexStatsReleased(m);
+#endif
+    ret = pthread_cond_wait(&c->cond, &m->lock);
+#if WITH_LOCK_STATS
+    m->acquired = g_get_monotonic_time();
+#endif
+    if (ret != 0) {
         errno = ret;
         return -1;
     }
@@ -160,7 +289,14 @@ int virCondWaitUntil(virCondPtr c, virMutexPtr m, unsigned long long whenms)
     ts.tv_sec = whenms / 1000;
     ts.tv_nsec = (whenms % 1000) * 1000000;
 
-    if ((ret = pthread_cond_timedwait(&c->cond, &m->lock, &ts)) != 0) {
+#if WITH_LOCK_STATS
+    virMutexStatsReleased(m);
+#endif
+    ret = pthread_cond_timedwait(&c->cond, &m->lock, &ts);
+#if WITH_LOCK_STATS
+    m->acquired = g_get_monotonic_time();
+#endif
+    if (ret != 0) {
         errno = ret;
         return -1;
     }
@@ -328,6 +464,99 @@ void virThreadJoin(virThreadPtr thread)
     pthread_join(thread->thread, NULL);
 }
 
+
+/**
+ * virThreadRunParallel:
+ * @nthreads: number of threads to run @func in, the calling one included
+ * @name: name of the threads created
+ * @func: function to run
+ * @opaque: data passed to @func
+ *
+ * Runs @func in @nthreads threads at once and returns once all of them
+ * returned. If creating a thread fails, @func is run in the threads
+ * created so far, at least in the calling one.
+ *
+ * Returns the number of threads @func was run in.
+ */
+size_t virThreadRunParallel(size_t nthreads,
+                            const char *name,
+                            virThreadFunc func,
+                            void *opaque)
+{
+    g_autofree virThread *threads = NULL;
+    size_t nstarted = 0;
+    size_t i;
+
+    if (nthreads > 1) {
+        threads = g_new0(virThread, nthreads - 1);
+
+        for (i = 0; i < nthreads - 1; i++) {
+            if (virThreadCreateFull(&threads[nstarted], true, func,
+                                    name, false, opaque) < 0)
+                break;
+            nstarted++;
+        }
+    }
+
+    func(opaque);
+
+    for (i = 0; i < nstarted; i++)
+        virThreadJoin(&threads[i]);
+
+    return nstarted + 1;
+}
+
+
+struct virThreadForEachData {
+    virThreadForEachFunc func;
+    void *opaque;
+    size_t n;
+    int next; /* index of the next item to process, atomic */
+};
+
+
+static void virThreadForEachWorker(void *opaque)
+{
+    struct virThreadForEachData *data = opaque;
+    int i;
+
+    while ((size_t) (i = g_atomic_int_add(&data->next, 1)) < data->n)
+        data->func(i, data->opaque);
+}
+
+
+/**
+ * virThreadForEachParallel:
+ * @n: number of items
+ * @maxthreads: upper bound of threads, the calling one included
+ * @name: name of the threads created
+ * @func: function processing a single item
+ * @opaque: data passed to @func
+ *
+ * Calls @func exactly once for each index from 0 to @n - 1 using up to
+ * @maxthreads threads, each of which picks the next index to process
+ * once it is done with the previous one. Returns once all of the items
+ * were processed. Items are processed in no particular order, so
+ * @func has to store its results by the index for the caller to go
+ * through them afterwards.
+ *
+ * Returns the number of threads the items were processed in.
+ */
+size_t virThreadForEachParallel(size_t n,
+                                size_t maxthreads,
+                                const char *name,
+                                virThreadForEachFunc func,
+                                void *opaque)
+{
+    struct virThreadForEachData data = { func, opaque, n, 0 };
+
+    if (n == 0)
+        return 0;
+
+    return virThreadRunParallel(MIN(n, MAX(maxthreads, 1)), name,
+                                virThreadForEachWorker, &data);
+}
+
 void virThreadCancel(virThreadPtr thread)
 {
     pthread_cancel(thread->thread);
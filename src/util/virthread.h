@@ -26,11 +26,29 @@
 
 #include <pthread.h>
 
+typedef struct virMutexStats virMutexStats;
+typedef virMutexStats *virMutexStatsPtr;
+
+/* Contention statistics shared by all the mutexes of one lock class.
+ * They are only collected when built with --enable-lock-stats; all the
+ * times are in microseconds. */
+struct virMutexStats {
+    const char *name;
+    unsigned long long acquisitions;
+    unsigned long long contentions;
+    unsigned long long waitTime;
+    unsigned long long holdTime;
+};
+
 typedef struct virMutex virMutex;
 typedef virMutex *virMutexPtr;
 
 struct virMutex {
     pthread_mutex_t lock;
+#if WITH_LOCK_STATS
+    virMutexStatsPtr stats;
+    gint64 acquired;
+#endif
 };
 
 typedef struct virRWLock virRWLock;
@@ -97,6 +115,19 @@ void virThreadSelf(virThreadPtr thread);
 bool virThreadIsSelf(virThreadPtr thread);
 void virThreadJoin(virThreadPtr thread);
 
+size_t virThreadRunParallel(size_t nthreads,
+                            const char *name,
+                            virThreadFunc func,
+                            void *opaque);
+
+typedef void (*virThreadForEachFunc)(size_t idx, void *opaque);
+
+size_t virThreadForEachParallel(size_t n,
+                                size_t maxthreads,
+                                const char *name,
+                                virThreadForEachFunc func,
+                                void *opaque);
+
 size_t virThreadMaxName(void);
 
 /* This API is *NOT* for general use. It exists solely as a stub
@@ -132,6 +163,10 @@ void virMutexDestroy(virMutexPtr m);
 void virMutexLock(virMutexPtr m);
 void virMutexUnlock(virMutexPtr m);
 
+void virMutexSetStats(virMutexPtr m, virMutexStatsPtr stats);
+int virMutexStatsGet(virMutexStatsPtr stats, virMutexStatsPtr result)
+    ATTRIBUTE_NONNULL(2);
+
 
 int virRWLockInit(virRWLockPtr m) G_GNUC_WARN_UNUSED_RESULT;
 void virRWLockDestroy(virRWLockPtr m);
@@ -49,9 +49,27 @@ struct _virThreadPoolJobList {
     virThreadPoolJobPtr firstPrio;
 };
 
+/*
+ * With VIR_THREAD_POOL_WORK_STEALING regular priority jobs are spread over
+ * a fixed set of deques, each with its own lock. Every worker serves its
+ * home deque first and steals from the others once it runs dry, so that
+ * neither submitting a job nor taking one needs the pool mutex. The mutex
+ * is only taken by workers going to sleep and by submitters which need
+ * to wake one of them up.
+ */
+typedef struct _virThreadPoolDeque virThreadPoolDeque;
+typedef virThreadPoolDeque *virThreadPoolDequePtr;
+
+struct _virThreadPoolDeque {
+    virMutex lock;
+    virThreadPoolJobPtr head;
+    virThreadPoolJobPtr tail;
+};
+
 
 struct _virThreadPool {
     bool quit;
+    unsigned int flags;
 
     virThreadPoolJobFunc jobFunc;
     const char *jobName;
@@ -73,6 +91,17 @@ struct _virThreadPool {
     size_t nPrioWorkers;
     virThreadPtr prioWorkers;
     virCond prioCond;
+
+    /* Only used with VIR_THREAD_POOL_WORK_STEALING, the integers are
+     * accessed atomically */
+    size_t ndeques;
+    virThreadPoolDequePtr deques;
+    int nextDeque;
+    int nextHome;
+    int nQueued;
+    int nIdle;
+    int atMax;      /* no more workers can be spawned */
+    int stop;
 };
 
 struct virThreadPoolWorkerData {
@@ -81,6 +110,111 @@ struct virThreadPoolWorkerData {
     bool priority;
 };
 
+
+static bool
+virThreadPoolIsStealing(virThreadPoolPtr pool)
+{
+    return !!(pool->flags & VIR_THREAD_POOL_WORK_STEALING);
+}
+
+
+static void
+virThreadPoolDequePush(virThreadPoolDequePtr deque,
+                       virThreadPoolJobPtr job)
+{
+    virMutexLock(&deque->lock);
+    job->prev = deque->tail;
+    if (deque->tail)
+        deque->tail->next = job;
+    else
+        deque->head = job;
+    deque->tail = job;
+    virMutexUnlock(&deque->lock);
+}
+
+
+static virThreadPoolJobPtr
+virThreadPoolDequePop(virThreadPoolDequePtr deque)
+{
+    virThreadPoolJobPtr job;
+
+    virMutexLock(&deque->lock);
+    if ((job = deque->head)) {
+        deque->head = job->next;
+        if (deque->head)
+            deque->head->prev = NULL;
+        else
+            deque->tail = NULL;
+        job->next = NULL;
+    }
+    virMutexUnlock(&deque->lock);
+
+    return job;
+}
+
+
+/* Take a job from the @home deque, or steal one from the others. */
+static virThreadPoolJobPtr
+virThreadPoolStealJob(virThreadPoolPtr pool,
+                      size_t home)
+{
+    virThreadPoolJobPtr job = NULL;
+    size_t i;
+
+    /* Don't bother locking the deques if there's nothing to take */
+    if (g_atomic_int_get(&pool->nQueued) <= 0)
+        return NULL;
+
+    for (i = 0; i < pool->ndeques; i++) {
+        if ((job = virThreadPoolDequePop(&pool->deques[(home + i) % pool->ndeques]))) {
+            g_atomic_int_add(&pool->nQueued, -1);
+            break;
+        }
+    }
+
+    return job;
+}
+
+
+/* The caller must hold the pool mutex */
+static virThreadPoolJobPtr
+virThreadPoolTakeListJob(virThreadPoolPtr pool,
+                         bool priority)
+{
+    virThreadPoolJobPtr job;
+
+    if (priority)
+        job = pool->jobList.firstPrio;
+    else
+        job = pool->jobList.head;
+
+    if (!job)
+        return NULL;
+
+    if (job == pool->jobList.firstPrio) {
+        virThreadPoolJobPtr tmp = job->next;
+        while (tmp) {
+            if (tmp->priority)
+                break;
+            tmp = tmp->next;
+        }
+        pool->jobList.firstPrio = tmp;
+    }
+
+    if (job->prev)
+        job->prev->next = job->next;
+    else
+        pool->jobList.head = job->next;
+    if (job->next)
+        job->next->prev = job->prev;
+    else
+        pool->jobList.tail = job->prev;
+
+    pool->jobQueueDepth--;
+
+    return job;
+}
+
 /* Test whether the worker needs to quit if the current number of workers @count
  * is greater than @limit actually allows.
  */
@@ -132,32 +266,7 @@ static void virThreadPoolWorker(void *opaque)
         if (pool->quit)
             break;
 
-        if (priority) {
-            job = pool->jobList.firstPrio;
-        } else {
-            job = pool->jobList.head;
-        }
-
-        if (job == pool->jobList.firstPrio) {
-            virThreadPoolJobPtr tmp = job->next;
-            while (tmp) {
-                if (tmp->priority)
-                    break;
-                tmp = tmp->next;
-            }
-            pool->jobList.firstPrio = tmp;
-        }
-
-        if (job->prev)
-            job->prev->next = job->next;
-        else
-            pool->jobList.head = job->next;
-        if (job->next)
-            job->next->prev = job->prev;
-        else
-            pool->jobList.tail = job->prev;
-
-        pool->jobQueueDepth--;
+        job = virThreadPoolTakeListJob(pool, priority);
 
         virMutexUnlock(&pool->mutex);
         (pool->jobFunc)(job->data, pool->jobOpaque);
@@ -175,6 +284,65 @@ static void virThreadPoolWorker(void *opaque)
     virMutexUnlock(&pool->mutex);
 }
 
+/*
+ * Worker for regular jobs of a VIR_THREAD_POOL_WORK_STEALING pool. Priority
+ * jobs still go through the shared job list and are served by the loop
+ * above in the priority workers.
+ */
+static void virThreadPoolStealingWorker(void *opaque)
+{
+    struct virThreadPoolWorkerData *data = opaque;
+    virThreadPoolPtr pool = data->pool;
+    size_t home = (unsigned int) g_atomic_int_add(&pool->nextHome, 1) % pool->ndeques;
+    virThreadPoolJobPtr job = NULL;
+
+    VIR_FREE(data);
+
+    while (!g_atomic_int_get(&pool->stop)) {
+        if (!(job = virThreadPoolStealJob(pool, home))) {
+            virMutexLock(&pool->mutex);
+
+            if (pool->quit ||
+                virThreadPoolWorkerQuitHelper(pool->nWorkers, pool->maxWorkers))
+                goto out;
+
+            if (!(job = virThreadPoolTakeListJob(pool, false))) {
+                /* Submitters check nIdle after queueing their job, so
+                 * either they see us idle or we see their job here. */
+                g_atomic_int_inc(&pool->nIdle);
+                if (g_atomic_int_get(&pool->nQueued) <= 0) {
+                    pool->freeWorkers++;
+                    if (virCondWait(&pool->cond, &pool->mutex) < 0) {
+                        pool->freeWorkers--;
+                        g_atomic_int_add(&pool->nIdle, -1);
+                        goto out;
+                    }
+                    pool->freeWorkers--;
+                }
+                g_atomic_int_add(&pool->nIdle, -1);
+            }
+
+            virMutexUnlock(&pool->mutex);
+
+            if (!job)
+                continue;
+        }
+
+        (pool->jobFunc)(job->data, pool->jobOpaque);
+        VIR_FREE(job);
+    }
+
+    virMutexLock(&pool->mutex);
+
+ out:
+    pool->nWorkers--;
+    g_atomic_int_set(&pool->atMax, 0);
+    if (pool->nWorkers == 0 && pool->nPrioWorkers == 0)
+        virCondSignal(&pool->quit_cond);
+    virMutexUnlock(&pool->mutex);
+}
+
+
 static int
 virThreadPoolExpand(virThreadPoolPtr pool, size_t gain, bool priority)
 {
@@ -202,6 +370,8 @@ virThreadPoolExpand(virThreadPoolPtr pool, size_t gain, bool priority)
 
         if (virThreadCreateFull(&(*workers)[i],
                                 false,
+                                !priority && virThreadPoolIsStealing(pool) ?
+                                virThreadPoolStealingWorker :
                                 virThreadPoolWorker,
                                 name,
                                 true,
@@ -225,9 +395,13 @@ virThreadPoolNewFull(size_t minWorkers,
                      size_t prioWorkers,
                      virThreadPoolJobFunc func,
                      const char *name,
-                     void *opaque)
+                     void *opaque,
+                     unsigned int flags)
 {
     virThreadPoolPtr pool;
+    size_t i;
+
+    virCheckFlags(VIR_THREAD_POOL_WORK_STEALING, NULL);
 
     if (minWorkers > maxWorkers)
         minWorkers = maxWorkers;
@@ -236,6 +410,20 @@ virThreadPoolNewFull(size_t minWorkers,
         return NULL;
 
     pool->jobList.tail = pool->jobList.head = NULL;
+    pool->flags = flags;
+
+    if (virThreadPoolIsStealing(pool)) {
+        /* the set of deques is fixed, growing the pool beyond the initial
+         * maximum just makes more workers share them */
+        pool->ndeques = MAX(maxWorkers, 1);
+        pool->deques = g_new0(virThreadPoolDeque, pool->ndeques);
+        for (i = 0; i < pool->ndeques; i++) {
+            if (virMutexInit(&pool->deques[i].lock) < 0) {
+                pool->ndeques = i;
+                goto error;
+            }
+        }
+    }
 
     pool->jobFunc = func;
     pool->jobName = name;
@@ -275,12 +463,14 @@ void virThreadPoolFree(virThreadPoolPtr pool)
 {
     virThreadPoolJobPtr job;
     bool priority = false;
+    size_t i;
 
     if (!pool)
         return;
 
     virMutexLock(&pool->mutex);
     pool->quit = true;
+    g_atomic_int_set(&pool->stop, 1);
     if (pool->nWorkers > 0)
         virCondBroadcast(&pool->cond);
     if (pool->nPrioWorkers > 0) {
@@ -296,6 +486,13 @@ void virThreadPoolFree(virThreadPoolPtr pool)
         VIR_FREE(job);
     }
 
+    for (i = 0; i < pool->ndeques; i++) {
+        while ((job = virThreadPoolDequePop(&pool->deques[i])))
+            VIR_FREE(job);
+        virMutexDestroy(&pool->deques[i].lock);
+    }
+    VIR_FREE(pool->deques);
+
     VIR_FREE(pool->workers);
     virMutexUnlock(&pool->mutex);
     virMutexDestroy(&pool->mutex);
@@ -370,11 +567,53 @@ size_t virThreadPoolGetJobQueueDepth(virThreadPoolPtr pool)
 
     virMutexLock(&pool->mutex);
     ret = pool->jobQueueDepth;
+    if (virThreadPoolIsStealing(pool))
+        ret += MAX(g_atomic_int_get(&pool->nQueued), 0);
     virMutexUnlock(&pool->mutex);
 
     return ret;
 }
 
+static int
+virThreadPoolSendStealingJob(virThreadPoolPtr pool,
+                             void *jobData)
+{
+    virThreadPoolJobPtr job;
+    size_t idx;
+
+    if (g_atomic_int_get(&pool->stop))
+        return -1;
+
+    if (VIR_ALLOC(job) < 0)
+        return -1;
+
+    job->data = jobData;
+
+    idx = (unsigned int) g_atomic_int_add(&pool->nextDeque, 1) % pool->ndeques;
+    virThreadPoolDequePush(&pool->deques[idx], job);
+    g_atomic_int_inc(&pool->nQueued);
+
+    /* Only touch the pool mutex if there's no worker awake to pick the
+     * job up, either to wake one up or to spawn a new one. */
+    if (g_atomic_int_get(&pool->nIdle) > 0) {
+        virMutexLock(&pool->mutex);
+        virCondSignal(&pool->cond);
+        virMutexUnlock(&pool->mutex);
+    } else if (!g_atomic_int_get(&pool->atMax)) {
+        virMutexLock(&pool->mutex);
+        if (pool->nWorkers >= pool->maxWorkers) {
+            g_atomic_int_set(&pool->atMax, 1);
+        } else if (!pool->quit &&
+                   virThreadPoolExpand(pool, 1, false) < 0) {
+            /* The job stays queued for the existing workers */
+            virResetLastError();
+        }
+        virMutexUnlock(&pool->mutex);
+    }
+
+    return 0;
+}
+
 /*
  * @priority - job priority
  * Return: 0 on success, -1 otherwise
@@ -385,6 +624,9 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
 {
     virThreadPoolJobPtr job;
 
+    if (virThreadPoolIsStealing(pool) && !priority)
+        return virThreadPoolSendStealingJob(pool, jobData);
+
     virMutexLock(&pool->mutex);
     if (pool->quit)
         goto error;
@@ -462,6 +704,7 @@ virThreadPoolSetParameters(virThreadPoolPtr pool,
 
     if (maxWorkers >= 0) {
         pool->maxWorkers = maxWorkers;
+        g_atomic_int_set(&pool->atMax, 0);
         virCondBroadcast(&pool->cond);
     }
 
@@ -28,15 +28,22 @@ typedef virThreadPool *virThreadPoolPtr;
 
 typedef void (*virThreadPoolJobFunc)(void *jobdata, void *opaque);
 
+typedef enum {
+    /* Spread regular jobs over per-worker queues and let idle workers steal
+     * from the others instead of sharing a single locked job list */
+    VIR_THREAD_POOL_WORK_STEALING = (1 << 0),
+} virThreadPoolFlags;
+
 #define virThreadPoolNew(min, max, prio, func, opaque) \
-    virThreadPoolNewFull(min, max, prio, func, #func, opaque)
+    virThreadPoolNewFull(min, max, prio, func, #func, opaque, 0)
 
 virThreadPoolPtr virThreadPoolNewFull(size_t minWorkers,
                                       size_t maxWorkers,
                                       size_t prioWorkers,
                                       virThreadPoolJobFunc func,
                                       const char *name,
-                                      void *opaque) ATTRIBUTE_NONNULL(4);
+                                      void *opaque,
+                                      unsigned int flags) ATTRIBUTE_NONNULL(4);
 
 size_t virThreadPoolGetMinWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetMaxWorkers(virThreadPoolPtr pool);
@@ -0,0 +1,318 @@
+/*
+ * virtunable.c: registry of live tunables of daemon internals
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include "virtunable.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "virlog.h"
+#include "virstring.h"
+#include "virthread.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("util.tunable");
+
+typedef struct _virTunable virTunable;
+typedef virTunable *virTunablePtr;
+struct _virTunable {
+    char *name;
+    virTunableGetFunc get;
+    virTunableSetFunc set;
+    void *opaque;
+};
+
+/* The callbacks are invoked with the lock held, so once
+ * virTunableUnregister returns the opaque data can be freed. */
+static virMutex virTunableLock = VIR_MUTEX_INITIALIZER;
+static virTunablePtr virTunables;
+static size_t virTunablesCount;
+
+
+static virTunablePtr
+virTunableFind(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < virTunablesCount; i++) {
+        if (STREQ(virTunables[i].name, name))
+            return &virTunables[i];
+    }
+
+    return NULL;
+}
+
+
+/**
+ * virTunableRegister:
+ * @name: unique name of the tunable, e.g. "qemu.stats-workers"
+ * @get: callback reporting the values and counters
+ * @set: callback changing the values, or NULL if there's nothing to change
+ * @opaque: data passed to the callbacks
+ *
+ * Makes a pool, cache or other internal structure of the daemon visible
+ * through the admin interface. The registration must be dropped with
+ * virTunableUnregister before @opaque goes away.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTunableRegister(const char *name,
+                   virTunableGetFunc get,
+                   virTunableSetFunc set,
+                   void *opaque)
+{
+    virTunable tunable = { NULL, get, set, opaque };
+    int ret = -1;
+
+    virMutexLock(&virTunableLock);
+
+    if (virTunableFind(name)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("tunable '%s' is already registered"), name);
+        goto cleanup;
+    }
+
+    tunable.name = g_strdup(name);
+
+    if (VIR_APPEND_ELEMENT(virTunables, virTunablesCount, tunable) < 0) {
+        VIR_FREE(tunable.name);
+        goto cleanup;
+    }
+
+    VIR_DEBUG("Registered tunable '%s'", name);
+    ret = 0;
+
+ cleanup:
+    virMutexUnlock(&virTunableLock);
+    return ret;
+}
+
+
+/**
+ * virTunableUnregister:
+ * @name: name of the tunable
+ *
+ * Drops the registration of @name, if any. The callbacks of the tunable
+ * are not running anymore when this returns.
+ */
+void
+virTunableUnregister(const char *name)
+{
+    size_t i;
+
+    virMutexLock(&virTunableLock);
+
+    for (i = 0; i < virTunablesCount; i++) {
+        if (STREQ(virTunables[i].name, name)) {
+            VIR_FREE(virTunables[i].name);
+            VIR_DELETE_ELEMENT(virTunables, i, virTunablesCount);
+            VIR_DEBUG("Unregistered tunable '%s'", name);
+            break;
+        }
+    }
+
+    virMutexUnlock(&virTunableLock);
+}
+
+
+/**
+ * virTunableGetAll:
+ * @list: list to add the parameters to
+ *
+ * Adds the parameters of all registered tunables to @list. Each parameter
+ * name is the name of the tunable, a dot and the name of the parameter.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTunableGetAll(virTypedParamListPtr list)
+{
+    size_t i;
+    int ret = -1;
+
+    virMutexLock(&virTunableLock);
+
+    for (i = 0; i < virTunablesCount; i++) {
+        if (virTypedParamListSetPrefix(list, "%s.", virTunables[i].name) < 0 ||
+            virTunables[i].get(virTunables[i].opaque, list) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    ignore_value(virTypedParamListSetPrefix(list, "%s", ""));
+    virMutexUnlock(&virTunableLock);
+    return ret;
+}
+
+
+/**
+ * virTunableSet:
+ * @name: name of the tunable
+ * @params: new values, named relative to the tunable
+ * @nparams: number of @params
+ *
+ * Changes the values of the tunable @name.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTunableSet(const char *name,
+              virTypedParameterPtr params,
+              int nparams)
+{
+    virTunablePtr tunable;
+    int ret = -1;
+
+    virMutexLock(&virTunableLock);
+
+    if (!(tunable = virTunableFind(name))) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("no tunable named '%s'"), name);
+        goto cleanup;
+    }
+
+    if (!tunable->set) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
+                       _("tunable '%s' can't be changed"), name);
+        goto cleanup;
+    }
+
+    ret = tunable->set(tunable->opaque, params, nparams);
+
+ cleanup:
+    virMutexUnlock(&virTunableLock);
+    return ret;
+}
+
+
+/* The names match the thread pool parameters of RPC servers */
+static int
+virTunableThreadPoolGet(void *opaque,
+                        virTypedParamListPtr list)
+{
+    virThreadPoolPtr pool = opaque;
+
+    if (virTypedParamListAddPrefixedUInt(list, virThreadPoolGetMinWorkers(pool),
+                                         "minWorkers") < 0 ||
+        virTypedParamListAddPrefixedUInt(list, virThreadPoolGetMaxWorkers(pool),
+                                         "maxWorkers") < 0 ||
+        virTypedParamListAddPrefixedUInt(list, virThreadPoolGetPriorityWorkers(pool),
+                                         "prioWorkers") < 0 ||
+        virTypedParamListAddPrefixedUInt(list, virThreadPoolGetCurrentWorkers(pool),
+                                         "nWorkers") < 0 ||
+        virTypedParamListAddPrefixedUInt(list, virThreadPoolGetFreeWorkers(pool),
+                                         "freeWorkers") < 0 ||
+        virTypedParamListAddPrefixedUInt(list, virThreadPoolGetJobQueueDepth(pool),
+                                         "jobQueueDepth") < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+virTunableThreadPoolSet(void *opaque,
+                        virTypedParameterPtr params,
+                        int nparams)
+{
+    virThreadPoolPtr pool = opaque;
+    long long int minWorkers = -1;
+    long long int maxWorkers = -1;
+    long long int prioWorkers = -1;
+    virTypedParameterPtr param;
+
+    if (virTypedParamsValidate(params, nparams,
+                               "minWorkers", VIR_TYPED_PARAM_UINT,
+                               "maxWorkers", VIR_TYPED_PARAM_UINT,
+                               "prioWorkers", VIR_TYPED_PARAM_UINT,
+                               NULL) < 0)
+        return -1;
+
+    if ((param = virTypedParamsGet(params, nparams, "minWorkers")))
+        minWorkers = param->value.ui;
+
+    if ((param = virTypedParamsGet(params, nparams, "maxWorkers")))
+        maxWorkers = param->value.ui;
+
+    if ((param = virTypedParamsGet(params, nparams, "prioWorkers")))
+        prioWorkers = param->value.ui;
+
+    return virThreadPoolSetParameters(pool, minWorkers, maxWorkers, prioWorkers);
+}
+
+
+/**
+ * virTunableRegisterThreadPool:
+ * @name: unique name of the tunable
+ * @pool: thread pool
+ *
+ * Registers @pool, reporting its worker counts and queue depth and
+ * allowing to change its worker limits.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTunableRegisterThreadPool(const char *name,
+                             virThreadPoolPtr pool)
+{
+    return virTunableRegister(name, virTunableThreadPoolGet,
+                              virTunableThreadPoolSet, pool);
+}
+
+
+static int
+virTunableFileCacheGet(void *opaque,
+                       virTypedParamListPtr list)
+{
+    virFileCachePtr cache = opaque;
+    size_t entries;
+    unsigned long long hits;
+    unsigned long long misses;
+
+    virFileCacheGetStats(cache, &entries, &hits, &misses);
+
+    if (virTypedParamListAddPrefixedUInt(list, entries, "entries") < 0 ||
+        virTypedParamListAddPrefixedULLong(list, hits, "hits") < 0 ||
+        virTypedParamListAddPrefixedULLong(list, misses, "misses") < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * virTunableRegisterFileCache:
+ * @name: unique name of the tunable
+ * @cache: file cache
+ *
+ * Registers @cache, reporting the number of its entries and how many
+ * lookups were served from it or had to create new data.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTunableRegisterFileCache(const char *name,
+                            virFileCachePtr cache)
+{
+    return virTunableRegister(name, virTunableFileCacheGet, NULL, cache);
+}
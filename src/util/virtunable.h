@@ -0,0 +1,60 @@
+/*
+ * virtunable.h: registry of live tunables of daemon internals
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "internal.h"
+#include "virfilecache.h"
+#include "virthreadpool.h"
+#include "virtypedparam.h"
+
+/*
+ * Adds the current values and counters of a tunable to @list using
+ * virTypedParamListAddPrefixed*, the prefix being set to the name of
+ * the tunable followed by a dot.
+ */
+typedef int (*virTunableGetFunc)(void *opaque,
+                                 virTypedParamListPtr list);
+
+/*
+ * Applies @params, whose names are relative to the tunable. Parameters
+ * not given keep their value.
+ */
+typedef int (*virTunableSetFunc)(void *opaque,
+                                 virTypedParameterPtr params,
+                                 int nparams);
+
+int virTunableRegister(const char *name,
+                       virTunableGetFunc get,
+                       virTunableSetFunc set,
+                       void *opaque);
+
+int virTunableRegisterThreadPool(const char *name,
+                                 virThreadPoolPtr pool);
+
+int virTunableRegisterFileCache(const char *name,
+                                virFileCachePtr cache);
+
+void virTunableUnregister(const char *name);
+
+int virTunableGetAll(virTypedParamListPtr list);
+
+int virTunableSet(const char *name,
+                  virTypedParameterPtr params,
+                  int nparams);
@@ -26,6 +26,7 @@
 
 #include "viralloc.h"
 #include "virerror.h"
+#include "virhash.h"
 #include "virstring.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
@@ -723,6 +724,542 @@ virTypedParamsSerialize(virTypedParameterPtr params,
 }
 
 
+/*
+ * Packed encoding of typed parameters
+ *
+ * Every parameter starts with a 32 bit word holding the index of its
+ * name in a dictionary which is shared by all the parameter lists of a
+ * reply, shifted left by VIR_TYPED_PARAMS_PACKED_TYPE_BITS, and the
+ * parameter type in the low bits. Names such as "block.3.rd.bytes" are
+ * stored in the dictionary without the numeric component, together with
+ * the offset it was removed from, and the number follows the first word.
+ * The value is next: 4 bytes for int, uint and boolean, 8 bytes for
+ * llong, ullong and double and a 32 bit length followed by the bytes
+ * for strings. All numbers are big endian, nothing is padded.
+ */
+#define VIR_TYPED_PARAMS_PACKED_TYPE_BITS 4
+#define VIR_TYPED_PARAMS_PACKED_TYPE_MASK ((1U << VIR_TYPED_PARAMS_PACKED_TYPE_BITS) - 1)
+#define VIR_TYPED_PARAMS_PACKED_NAMES_MAX (1U << (32 - VIR_TYPED_PARAMS_PACKED_TYPE_BITS))
+
+G_STATIC_ASSERT(VIR_TYPED_PARAM_LAST <= VIR_TYPED_PARAMS_PACKED_TYPE_MASK);
+
+struct _virTypedParamsPacker {
+    virHashTablePtr ids; /* name with the index removed -> index + 1 */
+    virTypedParamsPackedNamePtr names;
+    size_t nnames;
+    size_t names_alloc;
+    size_t maxnames;
+
+    char *data;
+    size_t len;
+    size_t alloc;
+};
+
+
+/**
+ * virTypedParamsPackerNew:
+ * @maxnames: maximum number of names in the dictionary
+ *
+ * Creates the state needed to pack a number of parameter lists which
+ * share a dictionary of names, see virTypedParamsPack.
+ *
+ * Returns the new packer.
+ */
+virTypedParamsPackerPtr
+virTypedParamsPackerNew(size_t maxnames)
+{
+    virTypedParamsPackerPtr packer = g_new0(virTypedParamsPacker, 1);
+
+    packer->ids = virHashNew(NULL);
+    packer->maxnames = MIN(maxnames, VIR_TYPED_PARAMS_PACKED_NAMES_MAX);
+
+    return packer;
+}
+
+
+void
+virTypedParamsPackerFree(virTypedParamsPackerPtr packer)
+{
+    size_t i;
+
+    if (!packer)
+        return;
+
+    for (i = 0; i < packer->nnames; i++)
+        VIR_FREE(packer->names[i].name);
+    VIR_FREE(packer->names);
+    virHashFree(packer->ids);
+    VIR_FREE(packer->data);
+    VIR_FREE(packer);
+}
+
+
+/**
+ * virTypedParamsPackerStealNames:
+ * @packer: packer
+ * @names: filled with the dictionary of names
+ *
+ * Hands the dictionary of all the names which were packed so far over
+ * to the caller, who has to send it along with the packed data.
+ *
+ * Returns the number of names in @names.
+ */
+size_t
+virTypedParamsPackerStealNames(virTypedParamsPackerPtr packer,
+                               virTypedParamsPackedNamePtr *names)
+{
+    size_t ret = packer->nnames;
+
+    *names = g_steal_pointer(&packer->names);
+    packer->nnames = 0;
+    packer->names_alloc = 0;
+    virHashRemoveAll(packer->ids);
+
+    return ret;
+}
+
+
+/* Finds the first dot separated component of @name which consists of
+ * a number in canonical form, i.e. without leading zeros, which fits
+ * 32 bits. Returns its offset or -1 if there is none. */
+static int
+virTypedParamsPackedSplit(const char *name,
+                          size_t *len,
+                          unsigned int *index)
+{
+    const char *cur = name;
+
+    while (*cur) {
+        size_t n = strspn(cur, "0123456789");
+
+        if (n > 0 && n <= 9 && (n == 1 || *cur != '0') &&
+            (cur[n] == '.' || cur[n] == '\0')) {
+            *len = n;
+            ignore_value(virStrToLong_uip(cur, NULL, 10, index));
+            return cur - name;
+        }
+
+        if (!(cur = strchr(cur, '.')))
+            break;
+        cur++;
+    }
+
+    return -1;
+}
+
+
+static int
+virTypedParamsPackerLookup(virTypedParamsPackerPtr packer,
+                           const char *field,
+                           bool *indexed,
+                           unsigned int *index)
+{
+    char name[VIR_TYPED_PARAM_FIELD_LENGTH];
+    size_t len = 0;
+    int offset;
+    void *id;
+
+    if ((offset = virTypedParamsPackedSplit(field, &len, index)) >= 0) {
+        /* Mark where the index was so that the key stays unambiguous */
+        g_snprintf(name, sizeof(name), "%.*s\x01%s",
+                   offset, field, field + offset + len);
+    } else if (virStrcpyStatic(name, field) < 0) {
+        virReportError(VIR_ERR_RPC, _("parameter name '%s' too long"), field);
+        return -1;
+    }
+
+    *indexed = offset >= 0;
+
+    if ((id = virHashLookup(packer->ids, name)))
+        return (uintptr_t) id - 1;
+
+    if (packer->nnames >= packer->maxnames) {
+        virReportError(VIR_ERR_RPC,
+                       _("too many distinct parameter names for limit '%zu'"),
+                       packer->maxnames);
+        return -1;
+    }
+
+    if (virHashAddEntry(packer->ids, name,
+                        (void *) (uintptr_t) (packer->nnames + 1)) < 0)
+        return -1;
+
+    if (VIR_RESIZE_N(packer->names, packer->names_alloc,
+                     packer->nnames, 1) < 0)
+        return -1;
+
+    if (offset >= 0)
+        packer->names[packer->nnames].name =
+            g_strdup_printf("%.*s%s", offset, field, field + offset + len);
+    else
+        packer->names[packer->nnames].name = g_strdup(field);
+    packer->names[packer->nnames].offset = offset;
+
+    return packer->nnames++;
+}
+
+
+static void
+virTypedParamsPackerPut(virTypedParamsPackerPtr packer,
+                        const void *data,
+                        size_t len)
+{
+    if (packer->len + len > packer->alloc) {
+        packer->alloc = MAX(packer->alloc * 2, packer->len + len);
+        packer->data = g_renew(char, packer->data, packer->alloc);
+    }
+
+    memcpy(packer->data + packer->len, data, len);
+    packer->len += len;
+}
+
+
+static void
+virTypedParamsPackerPut32(virTypedParamsPackerPtr packer,
+                          uint32_t val)
+{
+    uint32_t be = GUINT32_TO_BE(val);
+
+    virTypedParamsPackerPut(packer, &be, sizeof(be));
+}
+
+
+static void
+virTypedParamsPackerPut64(virTypedParamsPackerPtr packer,
+                          uint64_t val)
+{
+    uint64_t be = GUINT64_TO_BE(val);
+
+    virTypedParamsPackerPut(packer, &be, sizeof(be));
+}
+
+
+/**
+ * virTypedParamsPack:
+ * @packer: packer holding the dictionary of names
+ * @params: array of parameters to pack
+ * @nparams: number of elements in @params
+ * @limit: maximum number of parameters
+ * @data: filled with the packed parameters
+ * @len: filled with the length of @data
+ *
+ * A more compact and cheaper alternative to virTypedParamsSerialize using
+ * the packed encoding described above. Names not yet seen by @packer are
+ * added to its dictionary, see virTypedParamsPackerStealNames. Unset
+ * parameters are skipped, strings are always included.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTypedParamsPack(virTypedParamsPackerPtr packer,
+                   virTypedParameterPtr params,
+                   int nparams,
+                   int limit,
+                   char **data,
+                   unsigned int *len)
+{
+    size_t i;
+
+    if (nparams > limit) {
+        virReportError(VIR_ERR_RPC,
+                       _("too many parameters '%d' for limit '%d'"),
+                       nparams, limit);
+        return -1;
+    }
+
+    packer->len = 0;
+
+    for (i = 0; i < nparams; i++) {
+        virTypedParameterPtr param = params + i;
+        unsigned int index = 0;
+        bool indexed;
+        uint64_t u64;
+        int id;
+
+        if (!param->type)
+            continue;
+
+        if (param->type >= VIR_TYPED_PARAM_LAST) {
+            virReportError(VIR_ERR_RPC, _("unknown parameter type: %d"),
+                           param->type);
+            return -1;
+        }
+
+        if ((id = virTypedParamsPackerLookup(packer, param->field,
+                                             &indexed, &index)) < 0)
+            return -1;
+
+        virTypedParamsPackerPut32(packer,
+                                  (uint32_t) id << VIR_TYPED_PARAMS_PACKED_TYPE_BITS |
+                                  param->type);
+        if (indexed)
+            virTypedParamsPackerPut32(packer, index);
+
+        switch ((virTypedParameterType) param->type) {
+        case VIR_TYPED_PARAM_INT:
+        case VIR_TYPED_PARAM_UINT:
+            virTypedParamsPackerPut32(packer, param->value.ui);
+            break;
+        case VIR_TYPED_PARAM_BOOLEAN:
+            virTypedParamsPackerPut32(packer, !!param->value.b);
+            break;
+        case VIR_TYPED_PARAM_LLONG:
+        case VIR_TYPED_PARAM_ULLONG:
+            virTypedParamsPackerPut64(packer, param->value.ul);
+            break;
+        case VIR_TYPED_PARAM_DOUBLE:
+            memcpy(&u64, &param->value.d, sizeof(u64));
+            virTypedParamsPackerPut64(packer, u64);
+            break;
+        case VIR_TYPED_PARAM_STRING:
+            u64 = strlen(param->value.s);
+            virTypedParamsPackerPut32(packer, u64);
+            virTypedParamsPackerPut(packer, param->value.s, u64);
+            break;
+        case VIR_TYPED_PARAM_LAST:
+            break;
+        }
+    }
+
+    *data = g_memdup(packer->data, packer->len);
+    *len = packer->len;
+    return 0;
+}
+
+
+/**
+ * virTypedParamsPackedNamesCheck:
+ * @names: dictionary of names received from the remote side
+ * @nnames: number of elements in @names
+ *
+ * Checks the dictionary of names, which virTypedParamsUnpack relies on.
+ *
+ * Returns 0 if it is usable, -1 with an error reported otherwise.
+ */
+int
+virTypedParamsPackedNamesCheck(virTypedParamsPackedNamePtr names,
+                               unsigned int nnames)
+{
+    size_t i;
+
+    if (nnames > VIR_TYPED_PARAMS_PACKED_NAMES_MAX) {
+        virReportError(VIR_ERR_RPC, _("too many parameter names '%u'"),
+                       nnames);
+        return -1;
+    }
+
+    for (i = 0; i < nnames; i++) {
+        size_t len = strlen(names[i].name);
+
+        if (len >= VIR_TYPED_PARAM_FIELD_LENGTH ||
+            names[i].offset < -1 || names[i].offset > (int) len) {
+            virReportError(VIR_ERR_RPC, _("malformed parameter name '%s'"),
+                           names[i].name);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static const char *
+virTypedParamsUnpackGet(const char **data,
+                        const char *end,
+                        size_t len)
+{
+    const char *ret = *data;
+
+    if ((size_t) (end - ret) < len) {
+        virReportError(VIR_ERR_RPC, "%s", _("truncated packed parameters"));
+        return NULL;
+    }
+
+    *data += len;
+    return ret;
+}
+
+
+static int
+virTypedParamsUnpackGet32(const char **data,
+                          const char *end,
+                          uint32_t *val)
+{
+    const char *p;
+
+    if (!(p = virTypedParamsUnpackGet(data, end, sizeof(*val))))
+        return -1;
+
+    memcpy(val, p, sizeof(*val));
+    *val = GUINT32_FROM_BE(*val);
+    return 0;
+}
+
+
+static int
+virTypedParamsUnpackGet64(const char **data,
+                          const char *end,
+                          uint64_t *val)
+{
+    const char *p;
+
+    if (!(p = virTypedParamsUnpackGet(data, end, sizeof(*val))))
+        return -1;
+
+    memcpy(val, p, sizeof(*val));
+    *val = GUINT64_FROM_BE(*val);
+    return 0;
+}
+
+
+/* Decodes a single parameter from @data into @param, which may be NULL to
+ * just skip it */
+static int
+virTypedParamsUnpackOne(virTypedParamsPackedNamePtr names,
+                        unsigned int nnames,
+                        const char **data,
+                        const char *end,
+                        virTypedParameterPtr param)
+{
+    virTypedParamsPackedNamePtr name;
+    uint32_t word;
+    uint32_t index = 0;
+    uint32_t u32;
+    uint64_t u64;
+    unsigned int type;
+    const char *s;
+
+    if (virTypedParamsUnpackGet32(data, end, &word) < 0)
+        return -1;
+
+    type = word & VIR_TYPED_PARAMS_PACKED_TYPE_MASK;
+    if ((word >> VIR_TYPED_PARAMS_PACKED_TYPE_BITS) >= nnames) {
+        virReportError(VIR_ERR_RPC, _("unknown parameter name '%u'"),
+                       word >> VIR_TYPED_PARAMS_PACKED_TYPE_BITS);
+        return -1;
+    }
+    name = names + (word >> VIR_TYPED_PARAMS_PACKED_TYPE_BITS);
+
+    if (name->offset >= 0 &&
+        virTypedParamsUnpackGet32(data, end, &index) < 0)
+        return -1;
+
+    if (param) {
+        if (name->offset >= 0) {
+            if (g_snprintf(param->field, sizeof(param->field), "%.*s%u%s",
+                           name->offset, name->name, index,
+                           name->name + name->offset) >= (int) sizeof(param->field)) {
+                virReportError(VIR_ERR_RPC,
+                               _("parameter %s too big for destination"),
+                               name->name);
+                return -1;
+            }
+        } else {
+            /* Length checked by virTypedParamsPackedNamesCheck */
+            ignore_value(virStrcpyStatic(param->field, name->name));
+        }
+        param->type = type;
+    }
+
+    switch ((virTypedParameterType) type) {
+    case VIR_TYPED_PARAM_INT:
+    case VIR_TYPED_PARAM_UINT:
+    case VIR_TYPED_PARAM_BOOLEAN:
+        if (virTypedParamsUnpackGet32(data, end, &u32) < 0)
+            return -1;
+        if (!param)
+            break;
+        if (type == VIR_TYPED_PARAM_BOOLEAN)
+            param->value.b = !!u32;
+        else
+            param->value.ui = u32;
+        break;
+    case VIR_TYPED_PARAM_LLONG:
+    case VIR_TYPED_PARAM_ULLONG:
+    case VIR_TYPED_PARAM_DOUBLE:
+        if (virTypedParamsUnpackGet64(data, end, &u64) < 0)
+            return -1;
+        if (!param)
+            break;
+        if (type == VIR_TYPED_PARAM_DOUBLE)
+            memcpy(&param->value.d, &u64, sizeof(u64));
+        else
+            param->value.ul = u64;
+        break;
+    case VIR_TYPED_PARAM_STRING:
+        if (virTypedParamsUnpackGet32(data, end, &u32) < 0 ||
+            !(s = virTypedParamsUnpackGet(data, end, u32)))
+            return -1;
+        if (param)
+            param->value.s = g_strndup(s, u32);
+        break;
+    case VIR_TYPED_PARAM_LAST:
+    default:
+        virReportError(VIR_ERR_RPC, _("unknown parameter type: %d"), type);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * virTypedParamsUnpack:
+ * @names: dictionary of names, checked by virTypedParamsPackedNamesCheck
+ * @nnames: number of elements in @names
+ * @data: parameters packed by virTypedParamsPack
+ * @len: length of @data
+ * @limit: maximum number of parameters allowed in @data
+ * @params: filled with the newly allocated array of parameters
+ * @nparams: filled with the number of elements in @params
+ *
+ * Decodes the packed parameters in @data. They are counted first so that
+ * @params is allocated in one go.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTypedParamsUnpack(virTypedParamsPackedNamePtr names,
+                     unsigned int nnames,
+                     const char *data,
+                     unsigned int len,
+                     int limit,
+                     virTypedParameterPtr *params,
+                     int *nparams)
+{
+    const char *end = data + len;
+    const char *cur = data;
+    virTypedParameterPtr ret = NULL;
+    size_t count = 0;
+    size_t i;
+
+    while (cur < end) {
+        if (virTypedParamsUnpackOne(names, nnames, &cur, end, NULL) < 0)
+            return -1;
+
+        count++;
+        if (limit && count > (size_t) limit) {
+            virReportError(VIR_ERR_RPC,
+                           _("too many parameters for limit '%d'"), limit);
+            return -1;
+        }
+    }
+
+    ret = g_new0(virTypedParameter, count);
+
+    for (i = 0, cur = data; i < count; i++) {
+        if (virTypedParamsUnpackOne(names, nnames, &cur, end, ret + i) < 0) {
+            virTypedParamsFree(ret, i);
+            return -1;
+        }
+    }
+
+    *params = ret;
+    *nparams = count;
+    return 0;
+}
+
+
 void
 virTypedParamListFree(virTypedParamListPtr list)
 {
@@ -748,6 +1285,38 @@ virTypedParamListStealParams(virTypedParamListPtr list,
 }
 
 
+/**
+ * virTypedParamListAddParams:
+ * @list: typed parameter list
+ * @params: array of typed parameters to append
+ * @nparams: number of items in @params
+ *
+ * Appends a deep copy of @params to @list.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTypedParamListAddParams(virTypedParamListPtr list,
+                           virTypedParameterPtr params,
+                           size_t nparams)
+{
+    size_t i;
+
+    if (VIR_RESIZE_N(list->par, list->par_alloc, list->npar, nparams) < 0)
+        return -1;
+
+    for (i = 0; i < nparams; i++) {
+        virTypedParameterPtr par = list->par + list->npar++;
+
+        *par = params[i];
+        if (par->type == VIR_TYPED_PARAM_STRING)
+            par->value.s = g_strdup(params[i].value.s);
+    }
+
+    return 0;
+}
+
+
 static int G_GNUC_PRINTF(2, 0)
 virTypedParamSetNameVPrintf(virTypedParameterPtr par,
                             const char *fmt,
@@ -762,10 +1331,32 @@ virTypedParamSetNameVPrintf(virTypedParameterPtr par,
 }
 
 
+/**
+ * virTypedParamListReserve:
+ * @list: typed parameter list
+ * @nparams: number of parameters about to be added
+ *
+ * Makes room for @nparams more parameters in @list so that adding them
+ * doesn't have to grow the array. Callers adding a number of parameters
+ * known upfront, such as a few per disk, should use it.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTypedParamListReserve(virTypedParamListPtr list,
+                         size_t nparams)
+{
+    return VIR_RESIZE_N(list->par, list->par_alloc, list->npar, nparams);
+}
+
+
 static virTypedParameterPtr
 virTypedParamListExtend(virTypedParamListPtr list)
 {
-    if (VIR_RESIZE_N(list->par, list->par_alloc, list->npar, 1) < 0)
+    /* Double the array, so that building lists of hundreds of parameters
+     * doesn't reallocate it at every other one as VIR_RESIZE_N would */
+    if (list->npar == list->par_alloc &&
+        VIR_EXPAND_N(list->par, list->par_alloc, MAX(list->par_alloc, 16)) < 0)
         return NULL;
 
     list->npar++;
@@ -774,6 +1365,64 @@ virTypedParamListExtend(virTypedParamListPtr list)
 }
 
 
+/**
+ * virTypedParamListSetPrefix:
+ * @list: typed parameter list
+ * @prefixfmt: printf-style format of the prefix
+ *
+ * Sets the prefix which the virTypedParamListAddPrefixed* functions
+ * prepend to the names of the parameters they add, for example
+ * "block.%zu." for the parameters of a disk. The prefix is formatted
+ * once instead of once per parameter.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTypedParamListSetPrefix(virTypedParamListPtr list,
+                           const char *prefixfmt,
+                           ...)
+{
+    va_list ap;
+    int len;
+
+    va_start(ap, prefixfmt);
+    len = g_vsnprintf(list->prefix, sizeof(list->prefix), prefixfmt, ap);
+    va_end(ap);
+
+    if (len < 0 || (size_t) len >= sizeof(list->prefix)) {
+        list->prefix[0] = '\0';
+        list->prefixlen = 0;
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("Field name too long"));
+        return -1;
+    }
+
+    list->prefixlen = len;
+    return 0;
+}
+
+
+static virTypedParameterPtr
+virTypedParamListExtendPrefixed(virTypedParamListPtr list,
+                                const char *name)
+{
+    virTypedParameterPtr par;
+    size_t len = strlen(name);
+
+    if (list->prefixlen + len >= VIR_TYPED_PARAM_FIELD_LENGTH) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("Field name too long"));
+        return NULL;
+    }
+
+    if (!(par = virTypedParamListExtend(list)))
+        return NULL;
+
+    memcpy(par->field, list->prefix, list->prefixlen);
+    memcpy(par->field + list->prefixlen, name, len + 1);
+
+    return par;
+}
+
+
 int
 virTypedParamListAddInt(virTypedParamListPtr list,
                         int value,
@@ -926,3 +1575,101 @@ virTypedParamListAddDouble(virTypedParamListPtr list,
 
     return ret;
 }
+
+
+int
+virTypedParamListAddPrefixedInt(virTypedParamListPtr list,
+                                int value,
+                                const char *name)
+{
+    virTypedParameterPtr par;
+
+    if (!(par = virTypedParamListExtendPrefixed(list, name)))
+        return -1;
+
+    return virTypedParameterAssignValue(par, true, VIR_TYPED_PARAM_INT, value);
+}
+
+
+int
+virTypedParamListAddPrefixedUInt(virTypedParamListPtr list,
+                                 unsigned int value,
+                                 const char *name)
+{
+    virTypedParameterPtr par;
+
+    if (!(par = virTypedParamListExtendPrefixed(list, name)))
+        return -1;
+
+    return virTypedParameterAssignValue(par, true, VIR_TYPED_PARAM_UINT, value);
+}
+
+
+int
+virTypedParamListAddPrefixedLLong(virTypedParamListPtr list,
+                                  long long value,
+                                  const char *name)
+{
+    virTypedParameterPtr par;
+
+    if (!(par = virTypedParamListExtendPrefixed(list, name)))
+        return -1;
+
+    return virTypedParameterAssignValue(par, true, VIR_TYPED_PARAM_LLONG, value);
+}
+
+
+int
+virTypedParamListAddPrefixedULLong(virTypedParamListPtr list,
+                                   unsigned long long value,
+                                   const char *name)
+{
+    virTypedParameterPtr par;
+
+    if (!(par = virTypedParamListExtendPrefixed(list, name)))
+        return -1;
+
+    return virTypedParameterAssignValue(par, true, VIR_TYPED_PARAM_ULLONG, value);
+}
+
+
+int
+virTypedParamListAddPrefixedString(virTypedParamListPtr list,
+                                   const char *value,
+                                   const char *name)
+{
+    virTypedParameterPtr par;
+
+    if (!(par = virTypedParamListExtendPrefixed(list, name)))
+        return -1;
+
+    return virTypedParameterAssignValue(par, true, VIR_TYPED_PARAM_STRING, value);
+}
+
+
+int
+virTypedParamListAddPrefixedBoolean(virTypedParamListPtr list,
+                                    bool value,
+                                    const char *name)
+{
+    virTypedParameterPtr par;
+
+    if (!(par = virTypedParamListExtendPrefixed(list, name)))
+        return -1;
+
+    return virTypedParameterAssignValue(par, true, VIR_TYPED_PARAM_BOOLEAN, value);
+}
+
+
+int
+virTypedParamListAddPrefixedDouble(virTypedParamListPtr list,
+                                   double value,
+                                   const char *name)
+{
+    virTypedParameterPtr par;
+
+    if (!(par = virTypedParamListExtendPrefixed(list, name)))
+        return -1;
+
+    return virTypedParameterAssignValue(par, true, VIR_TYPED_PARAM_DOUBLE, value);
+}
@@ -57,6 +57,18 @@ struct _virTypedParameterRemote {
     virTypedParameterRemoteValue value;
 };
 
+/* Entry of the dictionary of names used by the packed encoding */
+typedef struct _virTypedParamsPackedName virTypedParamsPackedName;
+typedef virTypedParamsPackedName *virTypedParamsPackedNamePtr;
+
+struct _virTypedParamsPackedName {
+    char *name;
+    int offset; /* where the index is inserted into name, or -1 */
+};
+
+typedef struct _virTypedParamsPacker virTypedParamsPacker;
+typedef virTypedParamsPacker *virTypedParamsPackerPtr;
+
 
 int virTypedParamsValidate(virTypedParameterPtr params, int nparams,
                            /* const char *name, int type ... */ ...)
@@ -111,6 +123,31 @@ int virTypedParamsSerialize(virTypedParameterPtr params,
                             unsigned int *remote_params_len,
                             unsigned int flags);
 
+virTypedParamsPackerPtr virTypedParamsPackerNew(size_t maxnames);
+void virTypedParamsPackerFree(virTypedParamsPackerPtr packer);
+size_t virTypedParamsPackerStealNames(virTypedParamsPackerPtr packer,
+                                      virTypedParamsPackedNamePtr *names);
+
+int virTypedParamsPack(virTypedParamsPackerPtr packer,
+                       virTypedParameterPtr params,
+                       int nparams,
+                       int limit,
+                       char **data,
+                       unsigned int *len);
+
+int virTypedParamsPackedNamesCheck(virTypedParamsPackedNamePtr names,
+                                   unsigned int nnames);
+
+int virTypedParamsUnpack(virTypedParamsPackedNamePtr names,
+                         unsigned int nnames,
+                         const char *data,
+                         unsigned int len,
+                         int limit,
+                         virTypedParameterPtr *params,
+                         int *nparams);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virTypedParamsPacker, virTypedParamsPackerFree);
+
 VIR_ENUM_DECL(virTypedParameter);
 
 #define VIR_TYPED_PARAMS_DEBUG(params, nparams) \
@@ -135,14 +172,31 @@ struct _virTypedParamList {
     virTypedParameterPtr par;
     size_t npar;
     size_t par_alloc;
+
+    /* prepended to the names given to virTypedParamListAddPrefixed* */
+    char prefix[VIR_TYPED_PARAM_FIELD_LENGTH];
+    size_t prefixlen;
 };
 
 void virTypedParamListFree(virTypedParamListPtr list);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virTypedParamList, virTypedParamListFree);
 
+int virTypedParamListAddParams(virTypedParamListPtr list,
+                               virTypedParameterPtr params,
+                               size_t nparams);
+
 size_t virTypedParamListStealParams(virTypedParamListPtr list,
                                     virTypedParameterPtr *params);
 
+int virTypedParamListReserve(virTypedParamListPtr list,
+                             size_t nparams)
+    G_GNUC_WARN_UNUSED_RESULT;
+
+int virTypedParamListSetPrefix(virTypedParamListPtr list,
+                               const char *prefixfmt,
+                               ...)
+    G_GNUC_PRINTF(2, 3) G_GNUC_WARN_UNUSED_RESULT;
+
 int virTypedParamListAddInt(virTypedParamListPtr list,
                             int value,
                             const char *namefmt,
@@ -178,3 +232,32 @@ int virTypedParamListAddDouble(virTypedParamListPtr list,
                                const char *namefmt,
                                ...)
     G_GNUC_PRINTF(3, 4) G_GNUC_WARN_UNUSED_RESULT;
+
+int virTypedParamListAddPrefixedInt(virTypedParamListPtr list,
+                                    int value,
+                                    const char *name)
+    G_GNUC_WARN_UNUSED_RESULT;
+int virTypedParamListAddPrefixedUInt(virTypedParamListPtr list,
+                                     unsigned int value,
+                                     const char *name)
+    G_GNUC_WARN_UNUSED_RESULT;
+int virTypedParamListAddPrefixedLLong(virTypedParamListPtr list,
+                                      long long value,
+                                      const char *name)
+    G_GNUC_WARN_UNUSED_RESULT;
+int virTypedParamListAddPrefixedULLong(virTypedParamListPtr list,
+                                       unsigned long long value,
+                                       const char *name)
+    G_GNUC_WARN_UNUSED_RESULT;
+int virTypedParamListAddPrefixedString(virTypedParamListPtr list,
+                                       const char *value,
+                                       const char *name)
+    G_GNUC_WARN_UNUSED_RESULT;
+int virTypedParamListAddPrefixedBoolean(virTypedParamListPtr list,
+                                        bool value,
+                                        const char *name)
+    G_GNUC_WARN_UNUSED_RESULT;
+int virTypedParamListAddPrefixedDouble(virTypedParamListPtr list,
+                                       double value,
+                                       const char *name)
+    G_GNUC_WARN_UNUSED_RESULT;
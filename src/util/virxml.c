@@ -31,7 +31,9 @@
 #include "virbuffer.h"
 #include "viralloc.h"
 #include "virfile.h"
+#include "virhash.h"
 #include "virstring.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_XML
 
@@ -44,6 +46,107 @@ struct virParserData {
     int domcode;
 };
 
+/* Upper bound of compiled XPath expressions cached by each thread. Most
+ * expressions are string literals, the bound only keeps the few built
+ * at runtime from growing the cache forever. */
+#define VIR_XPATH_CACHE_MAX 4096
+
+/* Per thread cache of compiled XPath expressions, so that the same
+ * expressions evaluated for every parsed document are only compiled
+ * once. Using one cache per thread avoids sharing compiled expressions
+ * among concurrent evaluations. */
+static virThreadLocal virXPathCache;
+
+/* Process wide cache of parsed RNG schemas, keyed by file name */
+static virMutex virXMLSchemaCacheLock;
+static virHashTablePtr virXMLSchemaCache;
+
+
+static void
+virXPathCacheFree(void *cache)
+{
+    virHashFree(cache);
+}
+
+
+static void
+virXPathCompExprFree(void *comp)
+{
+    xmlXPathFreeCompExpr(comp);
+}
+
+
+static void
+virXMLSchemaFree(void *rng)
+{
+    xmlRelaxNGFree(rng);
+}
+
+
+static int
+virXMLOnceInit(void)
+{
+    if (virThreadLocalInit(&virXPathCache, virXPathCacheFree) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Cannot initialize thread local for XPath cache"));
+        return -1;
+    }
+
+    if (virMutexInit(&virXMLSchemaCacheLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to initialize RNG schema cache mutex"));
+        return -1;
+    }
+
+    if (!(virXMLSchemaCache = virHashNew(virXMLSchemaFree)))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virXML);
+
+
+/* Evaluates @xpath in @ctxt, compiling it only if it was not evaluated
+ * by the calling thread before. */
+static xmlXPathObjectPtr
+virXPathEval(const char *xpath,
+             xmlXPathContextPtr ctxt)
+{
+    virHashTablePtr cache;
+    xmlXPathCompExprPtr comp;
+    xmlXPathObjectPtr obj;
+
+    if (virXMLInitialize() < 0)
+        return xmlXPathEval(BAD_CAST xpath, ctxt);
+
+    if (!(cache = virThreadLocalGet(&virXPathCache))) {
+        if (!(cache = virHashNew(virXPathCompExprFree)))
+            return xmlXPathEval(BAD_CAST xpath, ctxt);
+
+        if (virThreadLocalSet(&virXPathCache, cache) < 0) {
+            virHashFree(cache);
+            return xmlXPathEval(BAD_CAST xpath, ctxt);
+        }
+    }
+
+    if ((comp = virHashLookup(cache, xpath)))
+        return xmlXPathCompiledEval(comp, ctxt);
+
+    /* Compiled without a context on purpose, so that the expression does
+     * not reference the dictionary of the document being parsed. */
+    if (!(comp = xmlXPathCompile(BAD_CAST xpath)))
+        return NULL;
+
+    if (virHashSize(cache) < VIR_XPATH_CACHE_MAX &&
+        virHashAddEntry(cache, xpath, comp) == 0)
+        return xmlXPathCompiledEval(comp, ctxt);
+
+    obj = xmlXPathCompiledEval(comp, ctxt);
+    xmlXPathFreeCompExpr(comp);
+    return obj;
+}
+
 
 xmlXPathContextPtr
 virXMLXPathContextNew(xmlDocPtr xml)
@@ -83,7 +186,7 @@ virXPathString(const char *xpath,
         return NULL;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEval(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj == NULL) || (obj->type != XPATH_STRING) ||
         (obj->stringval == NULL) || (obj->stringval[0] == 0)) {
@@ -160,7 +263,7 @@ virXPathNumber(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEval(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj == NULL) || (obj->type != XPATH_NUMBER) ||
         (isnan(obj->floatval))) {
@@ -189,7 +292,7 @@ virXPathLongBase(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEval(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj != NULL) && (obj->type == XPATH_STRING) &&
         (obj->stringval != NULL) && (obj->stringval[0] != 0)) {
@@ -294,7 +397,7 @@ virXPathULongBase(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEval(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj != NULL) && (obj->type == XPATH_STRING) &&
         (obj->stringval != NULL) && (obj->stringval[0] != 0)) {
@@ -410,7 +513,7 @@ virXPathULongLong(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEval(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj != NULL) && (obj->type == XPATH_STRING) &&
         (obj->stringval != NULL) && (obj->stringval[0] != 0)) {
@@ -456,7 +559,7 @@ virXPathLongLong(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEval(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj != NULL) && (obj->type == XPATH_STRING) &&
         (obj->stringval != NULL) && (obj->stringval[0] != 0)) {
@@ -582,7 +685,7 @@ virXPathBoolean(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEval(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj == NULL) || (obj->type != XPATH_BOOLEAN) ||
         (obj->boolval < 0) || (obj->boolval > 1)) {
@@ -619,7 +722,7 @@ virXPathNode(const char *xpath,
         return NULL;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEval(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj == NULL) || (obj->type != XPATH_NODESET) ||
         (obj->nodesetval == NULL) || (obj->nodesetval->nodeNr <= 0) ||
@@ -663,7 +766,7 @@ virXPathNodeSet(const char *xpath,
         *list = NULL;
 
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEval(xpath, ctxt);
     ctxt->node = relnode;
     if (obj == NULL)
         return 0;
@@ -1322,22 +1425,84 @@ virXMLValidatorValidate(virXMLValidatorPtr validator,
 }
 
 
+/* Returns the parsed RNG schema @schemafile, parsing it only the first
+ * time it is requested. The schema is owned by the cache and stays
+ * valid for the lifetime of the process. */
+static xmlRelaxNGPtr
+virXMLSchemaCacheGet(const char *schemafile)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    xmlRelaxNGParserCtxtPtr parser = NULL;
+    xmlRelaxNGPtr rng = NULL;
+
+    if (virXMLInitialize() < 0)
+        return NULL;
+
+    virMutexLock(&virXMLSchemaCacheLock);
+
+    if ((rng = virHashLookup(virXMLSchemaCache, schemafile)))
+        goto cleanup;
+
+    if (!(parser = xmlRelaxNGNewParserCtxt(schemafile))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to create RNG parser for %s"),
+                       schemafile);
+        goto cleanup;
+    }
+
+    xmlRelaxNGSetParserErrors(parser, catchRNGError, ignoreRNGError, &buf);
+
+    if (!(rng = xmlRelaxNGParse(parser))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to parse RNG %s: %s"),
+                       schemafile, virBufferCurrentContent(&buf));
+        goto cleanup;
+    }
+
+    if (virHashAddEntry(virXMLSchemaCache, schemafile, rng) < 0) {
+        xmlRelaxNGFree(rng);
+        rng = NULL;
+    }
+
+ cleanup:
+    xmlRelaxNGFreeParserCtxt(parser);
+    virMutexUnlock(&virXMLSchemaCacheLock);
+    return rng;
+}
+
+
 int
 virXMLValidateAgainstSchema(const char *schemafile,
                             xmlDocPtr doc)
 {
-    virXMLValidatorPtr validator = NULL;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    xmlRelaxNGValidCtxtPtr rngValid = NULL;
+    xmlRelaxNGPtr rng;
     int ret = -1;
 
-    if (!(validator = virXMLValidatorInit(schemafile)))
+    if (!(rng = virXMLSchemaCacheGet(schemafile)))
         return -1;
 
-    if (virXMLValidatorValidate(validator, doc) < 0)
+    /* The schema is shared, but every validation needs its own context */
+    if (!(rngValid = xmlRelaxNGNewValidCtxt(rng))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to create RNG validation context %s"),
+                       schemafile);
+        return -1;
+    }
+
+    xmlRelaxNGSetValidErrors(rngValid, catchRNGError, ignoreRNGError, &buf);
+
+    if (xmlRelaxNGValidateDoc(rngValid, doc) != 0) {
+        virReportError(VIR_ERR_XML_INVALID_SCHEMA,
+                       _("Unable to validate doc against %s\n%s"),
+                       schemafile, virBufferCurrentContent(&buf));
         goto cleanup;
+    }
 
     ret = 0;
  cleanup:
-    virXMLValidatorFree(validator);
+    xmlRelaxNGFreeValidCtxt(rngValid);
     return ret;
 }
 
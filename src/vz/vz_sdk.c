@@ -516,17 +516,15 @@ prlsdkUUIDParse(const char *uuidstr, unsigned char *uuid)
     return ret;
 }
 
+/* Collects the result of a PrlVm_GetState job, consuming @job */
 static int
-prlsdkGetDomainState(virDomainObjPtr dom, PRL_HANDLE sdkdom, VIRTUAL_MACHINE_STATE_PTR vmState)
+prlsdkGetDomainStateResult(virDomainObjPtr dom, PRL_HANDLE job, VIRTUAL_MACHINE_STATE_PTR vmState)
 {
-    PRL_HANDLE job = PRL_INVALID_HANDLE;
     PRL_HANDLE result = PRL_INVALID_HANDLE;
     PRL_HANDLE vmInfo = PRL_INVALID_HANDLE;
     PRL_RESULT pret;
     int ret = -1;
 
-    job = PrlVm_GetState(sdkdom);
-
     if (PRL_FAILED(getDomainJobResult(job, dom, &result)))
         goto cleanup;
 
@@ -544,6 +542,12 @@ prlsdkGetDomainState(virDomainObjPtr dom, PRL_HANDLE sdkdom, VIRTUAL_MACHINE_STA
     return ret;
 }
 
+static int
+prlsdkGetDomainState(virDomainObjPtr dom, PRL_HANDLE sdkdom, VIRTUAL_MACHINE_STATE_PTR vmState)
+{
+    return prlsdkGetDomainStateResult(dom, PrlVm_GetState(sdkdom), vmState);
+}
+
 static int
 prlsdkAddDomainVideoInfoCt(virDomainDefPtr def,
                            virDomainXMLOptionPtr xmlopt)
@@ -1820,13 +1824,19 @@ prlsdkConvertBootOrderVm(PRL_HANDLE sdkdom, virDomainDefPtr def)
 /* if dom is NULL adds new domain into domain list
  * if dom not NULL updates given locked dom object.
  *
+ * @stateJob and @perfJob are PrlVm_GetState and PrlVm_SubscribeToPerfStats
+ * jobs already started for @sdkdom, or PRL_INVALID_HANDLE to start them
+ * here. They are consumed in any case.
+ *
  * Returned object is locked and referenced.
  */
 
 static virDomainObjPtr
-prlsdkLoadDomain(vzDriverPtr driver,
-                 PRL_HANDLE sdkdom,
-                 virDomainObjPtr dom)
+prlsdkLoadDomainJobs(vzDriverPtr driver,
+                     PRL_HANDLE sdkdom,
+                     virDomainObjPtr dom,
+                     PRL_HANDLE stateJob,
+                     PRL_HANDLE perfJob)
 {
     virDomainDefPtr def = NULL;
     vzDomObjPtr pdom = NULL;
@@ -1900,7 +1910,11 @@ prlsdkLoadDomain(vzDriverPtr driver,
         goto error;
     }
 
-    if (prlsdkGetDomainState(dom, sdkdom, &domainState) < 0)
+    if (stateJob == PRL_INVALID_HANDLE)
+        stateJob = PrlVm_GetState(sdkdom);
+    job = stateJob;
+    stateJob = PRL_INVALID_HANDLE;
+    if (prlsdkGetDomainStateResult(dom, job, &domainState) < 0)
         goto error;
 
     if (!IS_CT(def) && virDomainDefAddImplicitDevices(def, driver->xmlopt) < 0)
@@ -1924,7 +1938,10 @@ prlsdkLoadDomain(vzDriverPtr driver,
     if (!dom) {
         virDomainObjPtr olddom = NULL;
 
-        job = PrlVm_SubscribeToPerfStats(sdkdom, NULL);
+        if (perfJob == PRL_INVALID_HANDLE)
+            perfJob = PrlVm_SubscribeToPerfStats(sdkdom, NULL);
+        job = perfJob;
+        perfJob = PRL_INVALID_HANDLE;
         if (PRL_FAILED(waitJob(job)))
             goto error;
 
@@ -1950,6 +1967,7 @@ prlsdkLoadDomain(vzDriverPtr driver,
          * for state and domain name */
         virDomainDefFree(dom->def);
         dom->def = def;
+        PrlHandle_Free(perfJob);
     }
 
     pdom = dom->privateData;
@@ -1965,20 +1983,34 @@ prlsdkLoadDomain(vzDriverPtr driver,
     return dom;
 
  error:
+    PrlHandle_Free(stateJob);
+    PrlHandle_Free(perfJob);
     virDomainDefFree(def);
     return NULL;
 }
 
+static virDomainObjPtr
+prlsdkLoadDomain(vzDriverPtr driver,
+                 PRL_HANDLE sdkdom,
+                 virDomainObjPtr dom)
+{
+    return prlsdkLoadDomainJobs(driver, sdkdom, dom,
+                                PRL_INVALID_HANDLE, PRL_INVALID_HANDLE);
+}
+
 int
 prlsdkLoadDomains(vzDriverPtr driver)
 {
     PRL_HANDLE job = PRL_INVALID_HANDLE;
     PRL_HANDLE result;
-    PRL_HANDLE sdkdom = PRL_INVALID_HANDLE;
+    PRL_HANDLE *sdkdoms = NULL;
+    PRL_HANDLE *stateJobs = NULL;
+    PRL_HANDLE *perfJobs = NULL;
     PRL_UINT32 paramsCount;
     PRL_RESULT pret;
     size_t i = 0;
     virDomainObjPtr dom;
+    int ret = -1;
 
     job = PrlSrv_GetVmListEx(driver->server, PVTF_VM | PVTF_CT);
 
@@ -1986,26 +2018,48 @@ prlsdkLoadDomains(vzDriverPtr driver)
         return -1;
 
     pret = PrlResult_GetParamsCount(result, &paramsCount);
-    prlsdkCheckRetGoto(pret, error);
+    prlsdkCheckRetGoto(pret, cleanup);
+
+    sdkdoms = g_new0(PRL_HANDLE, paramsCount);
+    stateJobs = g_new0(PRL_HANDLE, paramsCount);
+    perfJobs = g_new0(PRL_HANDLE, paramsCount);
 
     for (i = 0; i < paramsCount; i++) {
-        pret = PrlResult_GetParamByIndex(result, i, &sdkdom);
-        prlsdkCheckRetGoto(pret, error);
+        sdkdoms[i] = stateJobs[i] = perfJobs[i] = PRL_INVALID_HANDLE;
 
-        dom = prlsdkLoadDomain(driver, sdkdom, NULL);
-        virDomainObjEndAPI(&dom);
+        pret = PrlResult_GetParamByIndex(result, i, &sdkdoms[i]);
+        prlsdkCheckRetGoto(pret, cleanup);
+    }
 
-        PrlHandle_Free(sdkdom);
-        sdkdom = PRL_INVALID_HANDLE;
+    /* Send the state queries and perf subscriptions of all domains
+     * upfront so that the dispatcher processes them while we wait
+     * for the first replies, rather than paying one round trip after
+     * another for each domain. */
+    for (i = 0; i < paramsCount; i++) {
+        stateJobs[i] = PrlVm_GetState(sdkdoms[i]);
+        perfJobs[i] = PrlVm_SubscribeToPerfStats(sdkdoms[i], NULL);
     }
 
-    PrlHandle_Free(result);
-    return 0;
+    for (i = 0; i < paramsCount; i++) {
+        dom = prlsdkLoadDomainJobs(driver, sdkdoms[i], NULL,
+                                   stateJobs[i], perfJobs[i]);
+        stateJobs[i] = perfJobs[i] = PRL_INVALID_HANDLE;
+        virDomainObjEndAPI(&dom);
+    }
 
- error:
-    PrlHandle_Free(sdkdom);
+    ret = 0;
+
+ cleanup:
+    for (i = 0; sdkdoms && i < paramsCount; i++) {
+        PrlHandle_Free(stateJobs[i]);
+        PrlHandle_Free(perfJobs[i]);
+        PrlHandle_Free(sdkdoms[i]);
+    }
+    VIR_FREE(sdkdoms);
+    VIR_FREE(stateJobs);
+    VIR_FREE(perfJobs);
     PrlHandle_Free(result);
-    return -1;
+    return ret;
 }
 
 virDomainObjPtr
@@ -157,6 +157,239 @@ static int testFDStreamReadCommon(const char *scratchdir, bool blocking)
 }
 
 
+/*
+ * Reads a file large enough for the worker thread to grow its chunks,
+ * checking that no data gets lost or reordered on the way.
+ */
+#define LARGE_LEN (16 * 1024 * 1024)
+#define LARGE_BUF_LEN (1024 * 1024 + 7)
+
+static int testFDStreamReadLarge(const void *data)
+{
+    const char *scratchdir = data;
+    g_autofree char *file = NULL;
+    g_autofree char *pattern = NULL;
+    g_autofree char *buf = NULL;
+    virConnectPtr conn = NULL;
+    virStreamPtr st = NULL;
+    size_t total = 0;
+    size_t i;
+    int fd = -1;
+    int ret = -1;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        goto cleanup;
+
+    pattern = g_new0(char, LARGE_LEN);
+    buf = g_new0(char, LARGE_BUF_LEN);
+
+    for (i = 0; i < LARGE_LEN; i++)
+        pattern[i] = i % 251;
+
+    file = g_strdup_printf("%s/large.data", scratchdir);
+
+    if ((fd = open(file, O_CREAT|O_WRONLY|O_EXCL, 0600)) < 0)
+        goto cleanup;
+
+    if (safewrite(fd, pattern, LARGE_LEN) != LARGE_LEN)
+        goto cleanup;
+
+    if (VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    if (!(st = virStreamNew(conn, 0)))
+        goto cleanup;
+
+    if (virFDStreamOpenFile(st, file, 0, 0, O_RDONLY) < 0)
+        goto cleanup;
+
+    while (true) {
+        int got = st->driver->streamRecv(st, buf, LARGE_BUF_LEN);
+
+        if (got < 0) {
+            fprintf(stderr, "Failed to read stream: %s\n",
+                    virGetLastErrorMessage());
+            goto cleanup;
+        }
+
+        if (got == 0)
+            break;
+
+        if (total + got > LARGE_LEN ||
+            memcmp(buf, pattern + total, got) != 0) {
+            fprintf(stderr, "Mismatched data at offset %zu\n", total);
+            goto cleanup;
+        }
+
+        total += got;
+    }
+
+    if (total != LARGE_LEN) {
+        fprintf(stderr, "Expected %d bytes, got %zu\n", LARGE_LEN, total);
+        goto cleanup;
+    }
+
+    if (st->driver->streamFinish(st) != 0) {
+        fprintf(stderr, "Failed to finish stream: %s\n",
+                virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (st)
+        virStreamFree(st);
+    VIR_FORCE_CLOSE(fd);
+    if (file != NULL)
+        unlink(file);
+    if (conn)
+        virConnectClose(conn);
+    return ret;
+}
+
+
+/*
+ * Reads a sparse file in the sparse mode, in which the worker threads
+ * read the data extents ahead and holes are sent as such.
+ */
+#define SPARSE_LEN (16 * 1024 * 1024)
+
+static int testFDStreamReadSparse(const void *data)
+{
+    const char *scratchdir = data;
+    g_autofree char *file = NULL;
+    g_autofree char *pattern = NULL;
+    g_autofree char *buf = NULL;
+    virConnectPtr conn = NULL;
+    virStreamPtr st = NULL;
+    struct {
+        off_t offset;
+        size_t len;
+    } extents[] = {
+        { 0, 1024 * 1024 },
+        { 5 * 1024 * 1024, 3 * 4096 },
+        { 9 * 1024 * 1024, 5 * 1024 * 1024 },
+    };
+    size_t total = 0;
+    size_t i;
+    int fd = -1;
+    int ret = -1;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        goto cleanup;
+
+    pattern = g_new0(char, SPARSE_LEN);
+    buf = g_new0(char, LARGE_BUF_LEN);
+
+    file = g_strdup_printf("%s/sparse.data", scratchdir);
+
+    if ((fd = open(file, O_CREAT|O_WRONLY|O_EXCL, 0600)) < 0)
+        goto cleanup;
+
+    for (i = 0; i < G_N_ELEMENTS(extents); i++) {
+        size_t j;
+
+        for (j = 0; j < extents[i].len; j++)
+            pattern[extents[i].offset + j] = (i + j) % 251 + 1;
+
+        if (lseek(fd, extents[i].offset, SEEK_SET) < 0 ||
+            safewrite(fd, pattern + extents[i].offset,
+                      extents[i].len) != extents[i].len)
+            goto cleanup;
+    }
+
+    if (ftruncate(fd, SPARSE_LEN) < 0)
+        goto cleanup;
+
+    if (VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    if (!(st = virStreamNew(conn, VIR_STREAM_NONBLOCK)))
+        goto cleanup;
+
+    if (virFDStreamOpenBlockDevice(st, file, 0, 0, true, O_RDONLY) < 0)
+        goto cleanup;
+
+    while (true) {
+        int inData;
+        long long len;
+        int got;
+
+        if (st->driver->streamInData(st, &inData, &len) < 0) {
+            fprintf(stderr, "Failed to check for data: %s\n",
+                    virGetLastErrorMessage());
+            goto cleanup;
+        }
+
+        if (!inData) {
+            if (len == 0)
+                break;
+
+            if (total + len > SPARSE_LEN) {
+                fprintf(stderr, "Hole past the end at offset %zu\n", total);
+                goto cleanup;
+            }
+
+            for (i = 0; i < len; i++) {
+                if (pattern[total + i] != 0) {
+                    fprintf(stderr, "Data skipped at offset %zu\n",
+                            total + i);
+                    goto cleanup;
+                }
+            }
+
+            if (st->driver->streamSendHole(st, len, 0) < 0) {
+                fprintf(stderr, "Failed to skip hole: %s\n",
+                        virGetLastErrorMessage());
+                goto cleanup;
+            }
+
+            total += len;
+            continue;
+        }
+
+        if ((got = st->driver->streamRecv(st, buf, LARGE_BUF_LEN)) < 0) {
+            fprintf(stderr, "Failed to read stream: %s\n",
+                    virGetLastErrorMessage());
+            goto cleanup;
+        }
+
+        if (got == 0)
+            break;
+
+        if (total + got > SPARSE_LEN ||
+            memcmp(buf, pattern + total, got) != 0) {
+            fprintf(stderr, "Mismatched data at offset %zu\n", total);
+            goto cleanup;
+        }
+
+        total += got;
+    }
+
+    if (total != SPARSE_LEN) {
+        fprintf(stderr, "Expected %d bytes, got %zu\n", SPARSE_LEN, total);
+        goto cleanup;
+    }
+
+    if (st->driver->streamFinish(st) != 0) {
+        fprintf(stderr, "Failed to finish stream: %s\n",
+                virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (st)
+        virStreamFree(st);
+    VIR_FORCE_CLOSE(fd);
+    if (file != NULL)
+        unlink(file);
+    if (conn)
+        virConnectClose(conn);
+    return ret;
+}
+
+
 static int testFDStreamReadBlock(const void *data)
 {
     return testFDStreamReadCommon(data, true);
@@ -327,6 +560,10 @@ mymain(void)
         ret = -1;
     if (virTestRun("Stream read non-blocking ", testFDStreamReadNonblock, scratchdir) < 0)
         ret = -1;
+    if (virTestRun("Stream read large ", testFDStreamReadLarge, scratchdir) < 0)
+        ret = -1;
+    if (virTestRun("Stream read sparse ", testFDStreamReadSparse, scratchdir) < 0)
+        ret = -1;
     if (virTestRun("Stream write blocking ", testFDStreamWriteBlock, scratchdir) < 0)
         ret = -1;
     if (virTestRun("Stream write non-blocking ", testFDStreamWriteNonblock, scratchdir) < 0)
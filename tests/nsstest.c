@@ -173,7 +173,8 @@ mymain(void)
     } while (0)
 
 # if !defined(LIBVIRT_NSS_GUEST)
-    DO_TEST("fedora", AF_INET, "192.168.122.197", "192.168.122.198", "192.168.122.199");
+    DO_TEST("fedora", AF_INET, "192.168.122.197", "192.168.122.198",
+            "192.168.122.199", "192.168.122.200");
     DO_TEST("gentoo", AF_INET, "192.168.122.254");
     DO_TEST("gentoo", AF_INET6, "2001:1234:dead:beef::2");
     DO_TEST("gentoo", AF_UNSPEC, "192.168.122.254");
@@ -0,0 +1,224 @@
+/*
+ * nwfilternftablestest.c: Test nftables rule generation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "nwfilter/nwfilter_nftables_driver.h"
+#include "virbuffer.h"
+
+#define LIBVIRT_VIRCOMMANDPRIV_H_ALLOW
+#include "vircommandpriv.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+/* The tests run in order and share the state of the driver, so the
+ * generations of the chains are predictable */
+
+#define T "bridge libvirt_nwfilter "
+
+#define ADD_CHAINS(gen) \
+    "add chain " T "\"vnet0:" gen ":l2-out\"\n" \
+    "add chain " T "\"vnet0:" gen ":l2-in\"\n" \
+    "add chain " T "\"vnet0:" gen ":l3-out\"\n" \
+    "add chain " T "\"vnet0:" gen ":l3-in\"\n"
+
+#define ACTIVATE_KIND(gen, kind, map) \
+    "add chain " T "\"vnet0:" kind "\"\n" \
+    "add element " T map " { \"vnet0\" : jump \"vnet0:" kind "\" }\n" \
+    "flush chain " T "\"vnet0:" kind "\"\n" \
+    "add rule " T "\"vnet0:" kind "\" jump \"vnet0:" gen ":" kind "\"\n"
+
+#define ACTIVATE(gen) \
+    ACTIVATE_KIND(gen, "l2-out", "l2_out") \
+    ACTIVATE_KIND(gen, "l2-in", "l2_in") \
+    ACTIVATE_KIND(gen, "l3-out", "l3_out") \
+    ACTIVATE_KIND(gen, "l3-in", "l3_in")
+
+#define REMOVE_CHAINS(gen) \
+    "flush chain " T "\"vnet0:" gen ":l2-out\"\n" \
+    "flush chain " T "\"vnet0:" gen ":l2-in\"\n" \
+    "flush chain " T "\"vnet0:" gen ":l3-out\"\n" \
+    "flush chain " T "\"vnet0:" gen ":l3-in\"\n" \
+    "delete chain " T "\"vnet0:" gen ":l2-out\"\n" \
+    "delete chain " T "\"vnet0:" gen ":l2-in\"\n" \
+    "delete chain " T "\"vnet0:" gen ":l3-out\"\n" \
+    "delete chain " T "\"vnet0:" gen ":l3-in\"\n"
+
+#define TEARDOWN_KIND(kind, map) \
+    "add chain " T "\"vnet0:" kind "\"\n" \
+    "add element " T map " { \"vnet0\" : jump \"vnet0:" kind "\" }\n" \
+    "delete element " T map " { \"vnet0\" }\n" \
+    "flush chain " T "\"vnet0:" kind "\"\n" \
+    "delete chain " T "\"vnet0:" kind "\"\n"
+
+
+static void
+testNWFilterNFTablesDryRun(const char *const*args G_GNUC_UNUSED,
+                           const char *const*env G_GNUC_UNUSED,
+                           const char *input,
+                           char **output G_GNUC_UNUSED,
+                           char **error G_GNUC_UNUSED,
+                           int *status,
+                           void *opaque)
+{
+    virBufferPtr scripts = opaque;
+
+    virBufferAdd(scripts, NULLSTR_EMPTY(input), -1);
+    *status = 0;
+}
+
+
+typedef int (*testNWFilterNFTablesFunc)(void);
+
+struct testNWFilterNFTablesData {
+    testNWFilterNFTablesFunc func;
+    const char *expected;
+};
+
+
+static int
+testNWFilterNFTablesApplyBasicRules(void)
+{
+    virMacAddr mac = { .addr = { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60 } };
+
+    return nftables_driver.applyBasicRules("vnet0", &mac);
+}
+
+
+static int
+testNWFilterNFTablesApplyDHCPOnlyRules(void)
+{
+    virMacAddr mac = { .addr = { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60 } };
+    virNWFilterVarValuePtr val;
+    int ret = -1;
+
+    if (!(val = virNWFilterVarValueCreateSimpleCopyValue("192.168.122.1")))
+        return -1;
+
+    if (virNWFilterVarValueAddValueCopy(val, "10.31.172.1") < 0)
+        goto cleanup;
+
+    ret = nftables_driver.applyDHCPOnlyRules("vnet0", &mac, val, false);
+
+ cleanup:
+    virNWFilterVarValueFree(val);
+    return ret;
+}
+
+
+static int
+testNWFilterNFTablesApplyDropAllRules(void)
+{
+    return nftables_driver.applyDropAllRules("vnet0");
+}
+
+
+static int
+testNWFilterNFTablesAllTeardown(void)
+{
+    return nftables_driver.allTeardown("vnet0");
+}
+
+
+static int
+testNWFilterNFTables(const void *opaque)
+{
+    const struct testNWFilterNFTablesData *data = opaque;
+    virBuffer scripts = VIR_BUFFER_INITIALIZER;
+    char *actual = NULL;
+    int ret = -1;
+
+    virCommandSetDryRun(NULL, testNWFilterNFTablesDryRun, &scripts);
+
+    if (data->func() < 0)
+        goto cleanup;
+
+    actual = virBufferContentAndReset(&scripts);
+
+    if (STRNEQ_NULLABLE(actual, data->expected)) {
+        virTestDifference(stderr, data->expected, actual);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virCommandSetDryRun(NULL, NULL, NULL);
+    virBufferFreeAndReset(&scripts);
+    VIR_FREE(actual);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+#define DO_TEST(name, func, expected) \
+    do { \
+        struct testNWFilterNFTablesData data = { func, expected }; \
+        if (virTestRun(name, testNWFilterNFTables, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST("nftablesApplyBasicRules",
+            testNWFilterNFTablesApplyBasicRules,
+            ADD_CHAINS("1")
+            "add rule " T "\"vnet0:1:l2-out\" ether saddr != 10:20:30:40:50:60 drop\n"
+            "add rule " T "\"vnet0:1:l2-out\" ether type ip accept\n"
+            "add rule " T "\"vnet0:1:l2-out\" ether type arp accept\n"
+            "add rule " T "\"vnet0:1:l2-out\" drop\n"
+            ACTIVATE("1"));
+
+    DO_TEST("nftablesApplyDHCPOnlyRules",
+            testNWFilterNFTablesApplyDHCPOnlyRules,
+            ADD_CHAINS("2")
+            "add rule " T "\"vnet0:2:l2-out\" ether saddr 10:20:30:40:50:60 "
+            "ether type ip meta l4proto udp udp sport 68 udp dport 67 accept\n"
+            "add rule " T "\"vnet0:2:l2-out\" drop\n"
+            "add rule " T "\"vnet0:2:l2-in\" "
+            "ether daddr { 10:20:30:40:50:60, ff:ff:ff:ff:ff:ff } "
+            "ether type ip meta l4proto udp "
+            "ip saddr { 192.168.122.1, 10.31.172.1 } "
+            "udp sport 67 udp dport 68 accept\n"
+            "add rule " T "\"vnet0:2:l2-in\" drop\n"
+            ACTIVATE("2")
+            REMOVE_CHAINS("1"));
+
+    DO_TEST("nftablesApplyDropAllRules",
+            testNWFilterNFTablesApplyDropAllRules,
+            ADD_CHAINS("3")
+            "add rule " T "\"vnet0:3:l2-out\" drop\n"
+            "add rule " T "\"vnet0:3:l2-in\" drop\n"
+            ACTIVATE("3")
+            REMOVE_CHAINS("2"));
+
+    DO_TEST("nftablesAllTeardown",
+            testNWFilterNFTablesAllTeardown,
+            TEARDOWN_KIND("l2-out", "l2_out")
+            TEARDOWN_KIND("l2-in", "l2_in")
+            TEARDOWN_KIND("l3-out", "l3_out")
+            TEARDOWN_KIND("l3-in", "l3_in")
+            REMOVE_CHAINS("3"));
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
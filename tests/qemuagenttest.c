@@ -1288,6 +1288,67 @@ testQemuAgentTimezone(const void *data)
     qemuMonitorTestFree(test);
     return ret;
 }
+
+static int
+testQemuAgentPrefetch(const void *data)
+{
+    virDomainXMLOptionPtr xmlopt = (virDomainXMLOptionPtr)data;
+    qemuMonitorTestPtr test = qemuMonitorTestNewAgent(xmlopt);
+    const char *cmdnames[] = { "guest-get-osinfo", "guest-get-timezone" };
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    int maxparams = 0;
+    const char *value = NULL;
+    int ret = -1;
+
+    if (!test)
+        return -1;
+
+    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
+        goto cleanup;
+
+    if (qemuMonitorTestAddItem(test, "guest-get-osinfo",
+                               testQemuAgentOSInfoResponse) < 0 ||
+        qemuMonitorTestAddItem(test, "guest-get-timezone",
+                               testQemuAgentTimezoneResponse1) < 0)
+        goto cleanup;
+
+    if (qemuAgentPrefetch(qemuMonitorTestGetAgent(test),
+                          cmdnames, G_N_ELEMENTS(cmdnames),
+                          VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT) < 0)
+        goto cleanup;
+
+    /* neither of these may talk to the agent anymore */
+    if (qemuAgentGetTimezone(qemuMonitorTestGetAgent(test),
+                             &params, &nparams, &maxparams) < 0 ||
+        qemuAgentGetOSInfo(qemuMonitorTestGetAgent(test),
+                           &params, &nparams, &maxparams) < 0)
+        goto cleanup;
+
+    if (nparams != 10) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Expected 10 params, got %d", nparams);
+        goto cleanup;
+    }
+
+    if (virTypedParamsGetString(params, nparams, "timezone.name", &value) < 0 ||
+        STRNEQ_NULLABLE(value, "IST") ||
+        virTypedParamsGetString(params, nparams, "os.id", &value) < 0 ||
+        STRNEQ_NULLABLE(value, "centos")) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "unexpected prefetched data");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virTypedParamsFree(params, nparams);
+    qemuMonitorTestFree(test);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -1314,6 +1375,7 @@ mymain(void)
     DO_TEST(Users);
     DO_TEST(OSInfo);
     DO_TEST(Timezone);
+    DO_TEST(Prefetch);
 
     DO_TEST(Timeout); /* Timeout should always be called last */
 
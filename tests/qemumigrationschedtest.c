@@ -0,0 +1,82 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "qemu/qemu_migration_sched.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define MAX_MIGRATIONS 8
+
+struct testSplitData {
+    unsigned long long bandwidth;
+    size_t n;
+    unsigned long requested[MAX_MIGRATIONS];
+    unsigned long expected[MAX_MIGRATIONS];
+};
+
+
+static int
+testSplit(const void *opaque)
+{
+    const struct testSplitData *data = opaque;
+    unsigned long shares[MAX_MIGRATIONS] = { 0 };
+    size_t i;
+
+    qemuMigrationSchedSplit(data->bandwidth, data->requested, shares, data->n);
+
+    for (i = 0; i < data->n; i++) {
+        if (shares[i] != data->expected[i]) {
+            VIR_TEST_VERBOSE("\nmigration %zu: expected %lu MiB/s, got %lu",
+                             i, data->expected[i], shares[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+#define DO_TEST(name, ...) \
+    do { \
+        struct testSplitData data = { __VA_ARGS__ }; \
+        if (virTestRun("split " name, testSplit, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST("unlimited", 0, 3, { 100, 0, 5 }, { 100, 0, 5 });
+    DO_TEST("single", 1000, 1, { 0 }, { 1000 });
+    DO_TEST("single asking less", 1000, 1, { 300 }, { 300 });
+    DO_TEST("even", 1000, 4, { 0, 0, 0, 0 }, { 250, 250, 250, 250 });
+    DO_TEST("rounding", 1000, 3, { 0, 0, 0 }, { 333, 333, 334 });
+    DO_TEST("leftover", 1000, 3, { 100, 0, 2000 }, { 100, 450, 450 });
+    DO_TEST("all asking less", 1000, 3, { 100, 200, 300 }, { 100, 200, 300 });
+    DO_TEST("tiny budget", 2, 4, { 0, 0, 0, 0 }, { 1, 1, 1, 1 });
+
+#undef DO_TEST
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
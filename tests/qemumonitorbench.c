@@ -0,0 +1,258 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "testutilsqemu.h"
+#include "testutilsalloc.h"
+#include "qemumonitortestutils.h"
+#include "qemu/qemu_monitor_json.h"
+#include "qemu/qemu_qapi.h"
+#include "virerror.h"
+#include "virlog.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("tests.qemumonitorbench");
+
+/*
+ * Replays large recorded monitor replies through the monitor I/O code,
+ * the JSON parser and the reply parsers of the qemu driver and reports
+ * the throughput and the number of allocations. The block replies are
+ * built by repeating the devices of the qemumonitorjsondata nodename
+ * files; VIR_TEST_EXPENSIVE=1 makes them and the number of iterations
+ * larger.
+ */
+static unsigned int benchIterations = 10;
+static unsigned int benchCopies = 50;
+
+typedef int (*testBenchFunc)(qemuMonitorPtr mon);
+
+struct testBenchData {
+    virDomainXMLOptionPtr xmlopt;
+    const char *command;
+    char *reply;
+    testBenchFunc func;
+};
+
+
+static int
+testBenchQMPSchema(qemuMonitorPtr mon)
+{
+    virJSONValuePtr schemareply;
+    virHashTablePtr schema;
+
+    if (!(schemareply = qemuMonitorJSONQueryQMPSchema(mon)))
+        return -1;
+
+    if (!(schema = virQEMUQAPISchemaConvert(schemareply)))
+        return -1;
+
+    virHashFree(schema);
+    return 0;
+}
+
+
+static int
+testBenchBlockstats(qemuMonitorPtr mon)
+{
+    g_autoptr(virHashTable) stats = NULL;
+
+    if (!(stats = virHashCreate(10, virHashValueFree)))
+        return -1;
+
+    return qemuMonitorJSONGetAllBlockStatsInfo(mon, stats, true);
+}
+
+
+static int
+testBenchNamedNodes(qemuMonitorPtr mon)
+{
+    virHashTablePtr nodes;
+
+    if (!(nodes = qemuMonitorJSONBlockGetNamedNodeData(mon, false)))
+        return -1;
+
+    virHashFree(nodes);
+    return 0;
+}
+
+
+static int
+testBenchReplay(const void *opaque)
+{
+    const struct testBenchData *data = opaque;
+    gint64 elapsed = 0;
+    size_t allocs = 0;
+    size_t len = strlen(data->reply);
+    size_t i;
+
+    for (i = 0; i < benchIterations; i++) {
+        g_autoptr(qemuMonitorTest) test = NULL;
+        size_t startAllocs;
+        gint64 start;
+
+        if (!(test = qemuMonitorTestNewSimple(data->xmlopt)))
+            return -1;
+
+        if (qemuMonitorTestAddItem(test, data->command, data->reply) < 0)
+            return -1;
+
+        startAllocs = testAllocCount();
+        start = g_get_monotonic_time();
+
+        if (data->func(qemuMonitorTestGetMonitor(test)) < 0)
+            return -1;
+
+        elapsed += g_get_monotonic_time() - start;
+        allocs += testAllocCount() - startAllocs;
+    }
+
+    elapsed = MAX(elapsed, 1);
+
+    VIR_TEST_VERBOSE("\n  %zu bytes: %lld us, %.2f MiB/s, %zu allocs",
+                     len, (long long) elapsed / benchIterations,
+                     (double) len * benchIterations * G_USEC_PER_SEC /
+                     elapsed / (1024 * 1024),
+                     allocs / benchIterations);
+
+    return 0;
+}
+
+
+/* Returns the reply to 'query-qmp-schema' in the latest x86_64 replies
+ * file used by qemucapabilitiestest */
+static char *
+testBenchLoadSchemaReply(void)
+{
+    g_autofree char *file = NULL;
+    g_autofree char *replies = NULL;
+    char *reply;
+    char *end;
+
+    if (!(file = testQemuGetLatestCapsForArch("x86_64", "replies")) ||
+        virTestLoadFile(file, &replies) < 0)
+        return NULL;
+
+    if (!(reply = strstr(replies, "\"execute\": \"query-qmp-schema\"")) ||
+        !(reply = strstr(reply, "\n\n")) ||
+        !(end = strstr(reply + 2, "\n\n"))) {
+        VIR_TEST_VERBOSE("failed to find reply to 'query-qmp-schema' in '%s'",
+                         file);
+        return NULL;
+    }
+
+    return g_strndup(reply + 2, end - reply - 2);
+}
+
+
+/* Builds a reply holding @benchCopies copies of the devices recorded in
+ * @file, renamed so that they don't clash */
+static char *
+testBenchLoadBlockReply(const char *file)
+{
+    g_autofree char *path = NULL;
+    g_autofree char *json = NULL;
+    g_autoptr(virJSONValue) recorded = NULL;
+    g_autoptr(virJSONValue) devices = virJSONValueNewArray();
+    g_autoptr(virJSONValue) reply = NULL;
+    size_t i;
+    size_t j;
+
+    path = g_strdup_printf("%s/qemumonitorjsondata/%s", abs_srcdir, file);
+
+    if (virTestLoadFile(path, &json) < 0 ||
+        !(recorded = virJSONValueFromString(json)))
+        return NULL;
+
+    for (i = 0; i < benchCopies; i++) {
+        for (j = 0; j < virJSONValueArraySize(recorded); j++) {
+            virJSONValuePtr device;
+            const char *name;
+
+            device = virJSONValueCopy(virJSONValueArrayGet(recorded, j));
+
+            if ((name = virJSONValueObjectGetString(device, "device")) &&
+                *name) {
+                g_autofree char *tmp = g_strdup_printf("%s-%zu", name, i);
+                virJSONValueObjectRemoveKey(device, "device", NULL);
+                ignore_value(virJSONValueObjectAppendString(device, "device", tmp));
+            }
+
+            if ((name = virJSONValueObjectGetString(device, "node-name"))) {
+                g_autofree char *tmp = g_strdup_printf("%s-%zu", name, i);
+                virJSONValueObjectRemoveKey(device, "node-name", NULL);
+                ignore_value(virJSONValueObjectAppendString(device, "node-name", tmp));
+            }
+
+            if (virJSONValueArrayAppend(devices, device) < 0) {
+                virJSONValueFree(device);
+                return NULL;
+            }
+        }
+    }
+
+    if (virJSONValueObjectCreate(&reply, "a:return", &devices, NULL) < 0)
+        return NULL;
+
+    return virJSONValueToString(reply, false);
+}
+
+
+static int
+mymain(void)
+{
+    virQEMUDriver driver;
+    int ret = 0;
+
+    if (virTestGetExpensive()) {
+        benchIterations = 100;
+        benchCopies = 500;
+    }
+
+    if (qemuTestDriverInit(&driver) < 0)
+        return EXIT_FAILURE;
+
+    virEventRegisterDefaultImpl();
+
+#define DO_TEST(name, cmd, load, fnc) \
+    do { \
+        struct testBenchData data = { driver.xmlopt, cmd, load, fnc }; \
+        if (!data.reply || \
+            virTestRun(name, testBenchReplay, &data) < 0) \
+            ret = -1; \
+        VIR_FREE(data.reply); \
+    } while (0)
+
+    DO_TEST("query-qmp-schema", "query-qmp-schema",
+            testBenchLoadSchemaReply(), testBenchQMPSchema);
+    DO_TEST("query-blockstats", "query-blockstats",
+            testBenchLoadBlockReply("qemumonitorjson-nodename-basic-blockstats.json"),
+            testBenchBlockstats);
+    DO_TEST("query-named-block-nodes", "query-named-block-nodes",
+            testBenchLoadBlockReply("qemumonitorjson-nodename-basic-named-nodes.json"),
+            testBenchNamedNodes);
+
+#undef DO_TEST
+
+    qemuTestDriverFree(&driver);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN_PRELOAD(mymain, VIR_TEST_MOCK("viralloc"))
@@ -36,6 +36,10 @@
 
 static virQEMUDriver driver;
 
+/* With VIR_TEST_BENCH set, the time it takes to build each command line
+ * is printed in verbose mode, see also qemuxmlbench */
+static bool benchmark;
+
 static unsigned char *
 fakeSecretGetValue(virSecretPtr obj G_GNUC_UNUSED,
                    size_t *value_size,
@@ -411,6 +415,7 @@ testCompareXMLToArgv(const void *data)
     virCommandPtr cmd = NULL;
     size_t i;
     qemuDomainObjPrivatePtr priv = NULL;
+    gint64 start;
 
     if (info->arch != VIR_ARCH_NONE && info->arch != VIR_ARCH_X86_64)
         qemuTestSetHostArch(&driver, info->arch);
@@ -554,6 +559,7 @@ testCompareXMLToArgv(const void *data)
         }
     }
 
+    start = g_get_monotonic_time();
     if (!(cmd = qemuProcessCreatePretendCmd(&driver, vm, migrateURI,
                                             (flags & FLAG_FIPS), false,
                                             VIR_QEMU_PROCESS_START_COLD))) {
@@ -561,6 +567,9 @@ testCompareXMLToArgv(const void *data)
             goto ok;
         goto cleanup;
     }
+    if (benchmark)
+        VIR_TEST_VERBOSE("\n  command line built in %lld us",
+                         (long long) (g_get_monotonic_time() - start));
     if (flags & FLAG_EXPECT_FAILURE) {
         VIR_TEST_DEBUG("passed instead of expected failure");
         goto cleanup;
@@ -622,6 +631,8 @@ mymain(void)
     char *fakerootdir;
     virHashTablePtr capslatest = NULL;
 
+    benchmark = !!getenv("VIR_TEST_BENCH");
+
     fakerootdir = g_strdup(FAKEROOTDIRTEMPLATE);
 
     if (!g_mkdtemp(fakerootdir)) {
@@ -0,0 +1,228 @@
+#include <config.h>
+
+#include "testutils.h"
+
+#ifdef WITH_QEMU
+
+# include "internal.h"
+# include "qemu/qemu_domain.h"
+# include "testutilsqemu.h"
+# include "testutilsalloc.h"
+# include "viralloc.h"
+# include "virfile.h"
+# include "virlog.h"
+# include "virstring.h"
+
+# define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("tests.qemuxmlbench");
+
+static virQEMUDriver driver;
+
+/*
+ * Parses and formats every domain XML in qemuxml2argvdata, reporting the
+ * time it takes and the number of allocations it makes. Each file is
+ * processed once by default, ten times with VIR_TEST_EXPENSIVE=1 or as
+ * many times as VIR_TEST_BENCH_ITERATIONS says.
+ */
+static unsigned int benchIterations = 1;
+
+struct testBenchTotals {
+    size_t files;
+    gint64 parse;
+    gint64 format;
+    size_t parseAllocs;
+    size_t formatAllocs;
+};
+
+struct testBenchData {
+    const char *path;
+    struct testBenchTotals *totals;
+};
+
+
+static int
+testBenchFile(const void *opaque)
+{
+    const struct testBenchData *data = opaque;
+    g_autofree char *xml = NULL;
+    virDomainDefPtr def = NULL;
+    gint64 parse = 0;
+    gint64 format = 0;
+    size_t parseAllocs = 0;
+    size_t formatAllocs = 0;
+    size_t i;
+    int ret = -1;
+
+    if (virTestLoadFile(data->path, &xml) < 0)
+        return -1;
+
+    for (i = 0; i < benchIterations; i++) {
+        g_autofree char *actual = NULL;
+        size_t allocs = testAllocCount();
+        gint64 start = g_get_monotonic_time();
+
+        if (!(def = virDomainDefParseString(xml, driver.xmlopt, NULL,
+                                            VIR_DOMAIN_DEF_PARSE_INACTIVE))) {
+            /* Files meant to fail parsing are of no interest here */
+            virResetLastError();
+            ret = EXIT_AM_SKIP;
+            goto cleanup;
+        }
+
+        parse += g_get_monotonic_time() - start;
+        parseAllocs += testAllocCount() - allocs;
+
+        allocs = testAllocCount();
+        start = g_get_monotonic_time();
+
+        if (!(actual = virDomainDefFormat(def, driver.xmlopt,
+                                          VIR_DOMAIN_DEF_FORMAT_SECURE)))
+            goto cleanup;
+
+        format += g_get_monotonic_time() - start;
+        formatAllocs += testAllocCount() - allocs;
+
+        virDomainDefFree(def);
+        def = NULL;
+    }
+
+    VIR_TEST_VERBOSE("\n  parse  %8lld us %8zu allocs"
+                     "\n  format %8lld us %8zu allocs",
+                     (long long) parse / benchIterations,
+                     parseAllocs / benchIterations,
+                     (long long) format / benchIterations,
+                     formatAllocs / benchIterations);
+
+    data->totals->files++;
+    data->totals->parse += parse;
+    data->totals->format += format;
+    data->totals->parseAllocs += parseAllocs;
+    data->totals->formatAllocs += formatAllocs;
+
+    ret = 0;
+
+ cleanup:
+    virDomainDefFree(def);
+    return ret;
+}
+
+
+static int
+testBenchDir(const char *dir_path,
+             struct testBenchTotals *totals)
+{
+    DIR *dir = NULL;
+    struct dirent *ent;
+    int ret = 0;
+    int rc;
+
+    if (virDirOpen(&dir, dir_path) < 0) {
+        virTestPropagateLibvirtError();
+        return -1;
+    }
+
+    while ((rc = virDirRead(dir, &ent, dir_path)) > 0) {
+        g_autofree char *path = NULL;
+        struct testBenchData data = { NULL, totals };
+
+        if (!virStringHasSuffix(ent->d_name, ".xml"))
+            continue;
+        if (ent->d_name[0] == '.')
+            continue;
+
+        path = g_strdup_printf("%s/%s", dir_path, ent->d_name);
+        data.path = path;
+
+        if (virTestRun(ent->d_name, testBenchFile, &data) < 0)
+            ret = -1;
+    }
+
+    if (rc < 0) {
+        virTestPropagateLibvirtError();
+        ret = -1;
+    }
+
+    VIR_DIR_CLOSE(dir);
+    return ret;
+}
+
+
+static int
+testBenchSummary(const void *opaque)
+{
+    const struct testBenchTotals *totals = opaque;
+
+    VIR_TEST_VERBOSE("\n%zu files, %u iterations, total (usec, allocs):\n"
+                     "  parse  %10lld %10zu\n"
+                     "  format %10lld %10zu",
+                     totals->files, benchIterations,
+                     (long long) totals->parse, totals->parseAllocs,
+                     (long long) totals->format, totals->formatAllocs);
+
+    return 0;
+}
+
+
+# define FAKEROOTDIRTEMPLATE abs_builddir "/fakerootdir-XXXXXX"
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    g_autofree char *fakerootdir = NULL;
+    struct testBenchTotals totals = { 0 };
+    const char *iterations = getenv("VIR_TEST_BENCH_ITERATIONS");
+
+    if (virTestGetExpensive())
+        benchIterations = 10;
+
+    if (iterations &&
+        (virStrToLong_ui(iterations, NULL, 10, &benchIterations) < 0 ||
+         benchIterations == 0)) {
+        fprintf(stderr, "Invalid VIR_TEST_BENCH_ITERATIONS '%s'\n", iterations);
+        return EXIT_FAILURE;
+    }
+
+    fakerootdir = g_strdup(FAKEROOTDIRTEMPLATE);
+
+    if (!g_mkdtemp(fakerootdir)) {
+        fprintf(stderr, "Cannot create fakerootdir");
+        abort();
+    }
+
+    g_setenv("LIBVIRT_FAKE_ROOT_DIR", fakerootdir, TRUE);
+
+    if (qemuTestDriverInit(&driver) < 0)
+        return EXIT_FAILURE;
+
+    if (testBenchDir(abs_srcdir "/qemuxml2argvdata", &totals) < 0)
+        ret = -1;
+
+    if (virTestRun("summary", testBenchSummary, &totals) < 0)
+        ret = -1;
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(fakerootdir);
+
+    qemuTestDriverFree(&driver);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN_PRELOAD(mymain,
+                      VIR_TEST_MOCK("virpci"),
+                      VIR_TEST_MOCK("virrandom"),
+                      VIR_TEST_MOCK("domaincaps"),
+                      VIR_TEST_MOCK("virdeterministichash"),
+                      VIR_TEST_MOCK("viralloc"))
+
+#else
+
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+
+#endif /* WITH_QEMU */
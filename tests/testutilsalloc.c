@@ -0,0 +1,49 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#ifndef WIN32
+# include <dlfcn.h>
+#endif
+
+#include "testutilsalloc.h"
+
+/**
+ * testAllocCount:
+ *
+ * Returns the number of calls to malloc, calloc and realloc the process
+ * made so far, or 0 if they aren't counted. Counting them requires
+ * VIR_TEST_MOCK("viralloc") to be preloaded.
+ */
+size_t
+testAllocCount(void)
+{
+#ifndef WIN32
+    static size_t (*count)(void);
+    static bool initialized;
+
+    if (!initialized) {
+        count = dlsym(RTLD_DEFAULT, "virAllocMockCount");
+        initialized = true;
+    }
+
+    if (count)
+        return count();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#ifndef WIN32
+
+# include <dlfcn.h>
+
+# include "internal.h"
+
+/*
+ * Counts the calls to malloc, calloc and realloc for the benchmarks to
+ * report, see testAllocCount. The memory itself comes from whatever
+ * implementation is next in the lookup order, so that the allocator
+ * valgrind or the sanitizers interpose stays in charge of every
+ * allocation and of freeing it.
+ */
+
+static void *(*real_malloc)(size_t size);
+static void *(*real_calloc)(size_t nmemb, size_t size);
+static void *(*real_realloc)(void *ptr, size_t size);
+static void (*real_free)(void *ptr);
+
+static int allocs;
+
+/* Looking up the real functions may allocate on its own */
+static bool initializing;
+static long double bootstrap[512];
+static size_t bootstrapUsed;
+
+
+static void *
+bootstrapAlloc(size_t size)
+{
+    size_t n = VIR_DIV_UP(size, sizeof(bootstrap[0]));
+    void *ret;
+
+    if (n > G_N_ELEMENTS(bootstrap) - bootstrapUsed)
+        abort();
+
+    ret = &bootstrap[bootstrapUsed];
+    bootstrapUsed += n;
+    return ret;
+}
+
+
+static bool
+isBootstrap(void *ptr)
+{
+    return (char *) ptr >= (char *) bootstrap &&
+           (char *) ptr < (char *) (bootstrap + G_N_ELEMENTS(bootstrap));
+}
+
+
+static void
+init(void)
+{
+    initializing = true;
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    initializing = false;
+
+    if (!real_malloc || !real_calloc || !real_realloc || !real_free)
+        abort();
+}
+
+
+void *
+malloc(size_t size)
+{
+    if (!real_malloc) {
+        if (initializing)
+            return bootstrapAlloc(size);
+        init();
+    }
+
+    g_atomic_int_inc(&allocs);
+    return real_malloc(size);
+}
+
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    if (!real_calloc) {
+        /* The static buffer is zeroed already */
+        if (initializing)
+            return bootstrapAlloc(nmemb * size);
+        init();
+    }
+
+    g_atomic_int_inc(&allocs);
+    return real_calloc(nmemb, size);
+}
+
+
+void *
+realloc(void *ptr, size_t size)
+{
+    size_t avail;
+    void *ret;
+
+    if (!real_realloc) {
+        if (initializing)
+            return bootstrapAlloc(size);
+        init();
+    }
+
+    g_atomic_int_inc(&allocs);
+
+    if (!isBootstrap(ptr))
+        return real_realloc(ptr, size);
+
+    /* The size of the old block isn't known, but it ends with the
+     * buffer at the latest */
+    avail = (char *) (bootstrap + G_N_ELEMENTS(bootstrap)) - (char *) ptr;
+    if ((ret = real_malloc(size)))
+        memcpy(ret, ptr, MIN(size, avail));
+    return ret;
+}
+
+
+void
+free(void *ptr)
+{
+    if (isBootstrap(ptr))
+        return;
+
+    if (!real_free) {
+        if (initializing)
+            return;
+        init();
+    }
+
+    real_free(ptr);
+}
+
+
+size_t virAllocMockCount(void);
+
+size_t
+virAllocMockCount(void)
+{
+    return (unsigned int) g_atomic_int_get(&allocs);
+}
+
+#endif /* !WIN32 */
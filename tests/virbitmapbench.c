@@ -0,0 +1,271 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "internal.h"
+#include "virbitmap.h"
+#include "testutils.h"
+#include "virbuffer.h"
+#include "virlog.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("tests.bitmapbench");
+
+/*
+ * Times the bitmap operations used on CPU affinity masks and NUMA nodesets
+ * against bit by bit implementations of the same operations, which are
+ * also used to check the results. VIR_TEST_EXPENSIVE=1 adds larger maps.
+ */
+static unsigned int benchIterations = 1000;
+
+struct testBenchInfo {
+    size_t nbits;
+    unsigned int stride; /* every stride-th run of 8 bits is set */
+};
+
+
+struct testBenchTimes {
+    gint64 count;
+    gint64 iterate;
+    gint64 last;
+    gint64 equal;
+    gint64 format;
+};
+
+
+static char *
+testBitwiseFormat(virBitmapPtr map)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    size_t nbits = virBitmapSize(map);
+    size_t i = 0;
+
+    while (i < nbits) {
+        size_t start;
+
+        if (!virBitmapIsBitSet(map, i)) {
+            i++;
+            continue;
+        }
+
+        start = i;
+        while (i + 1 < nbits && virBitmapIsBitSet(map, i + 1))
+            i++;
+
+        if (start == i)
+            virBufferAsprintf(&buf, "%zu,", start);
+        else
+            virBufferAsprintf(&buf, "%zu-%zu,", start, i);
+        i++;
+    }
+
+    virBufferTrimLen(&buf, 1);
+
+    return g_strdup(NULLSTR_EMPTY(virBufferCurrentContent(&buf)));
+}
+
+
+static int
+testBenchReference(virBitmapPtr map,
+                   virBitmapPtr copy,
+                   struct testBenchTimes *times,
+                   size_t *count,
+                   ssize_t *last,
+                   char **str)
+{
+    size_t nbits = virBitmapSize(map);
+    gint64 start;
+    size_t n;
+    size_t i;
+    size_t j;
+
+    start = g_get_monotonic_time();
+    for (j = 0; j < benchIterations; j++) {
+        for (*count = 0, i = 0; i < nbits; i++)
+            *count += virBitmapIsBitSet(map, i);
+    }
+    times->count = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (j = 0; j < benchIterations; j++) {
+        for (n = 0, i = 0; i < nbits; i++) {
+            if (virBitmapIsBitSet(map, i))
+                n++;
+        }
+    }
+    times->iterate = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (j = 0; j < benchIterations; j++) {
+        for (*last = nbits - 1; *last >= 0; (*last)--) {
+            if (virBitmapIsBitSet(map, *last))
+                break;
+        }
+    }
+    times->last = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (j = 0; j < benchIterations; j++) {
+        for (i = 0; i < nbits; i++) {
+            if (virBitmapIsBitSet(map, i) != virBitmapIsBitSet(copy, i))
+                return -1;
+        }
+    }
+    times->equal = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (j = 0; j < benchIterations; j++) {
+        VIR_FREE(*str);
+        *str = testBitwiseFormat(map);
+    }
+    times->format = g_get_monotonic_time() - start;
+
+    return n == *count ? 0 : -1;
+}
+
+
+static int
+testBenchBitmap(virBitmapPtr map,
+                virBitmapPtr copy,
+                struct testBenchTimes *times,
+                size_t *count,
+                ssize_t *last,
+                char **str)
+{
+    gint64 start;
+    size_t n;
+    ssize_t pos;
+    size_t j;
+
+    start = g_get_monotonic_time();
+    for (j = 0; j < benchIterations; j++)
+        *count = virBitmapCountBits(map);
+    times->count = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (j = 0; j < benchIterations; j++) {
+        n = 0;
+        pos = -1;
+        while ((pos = virBitmapNextSetBit(map, pos)) >= 0)
+            n++;
+    }
+    times->iterate = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (j = 0; j < benchIterations; j++)
+        *last = virBitmapLastSetBit(map);
+    times->last = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (j = 0; j < benchIterations; j++) {
+        if (!virBitmapEqual(map, copy))
+            return -1;
+    }
+    times->equal = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (j = 0; j < benchIterations; j++) {
+        VIR_FREE(*str);
+        *str = virBitmapFormat(map);
+    }
+    times->format = g_get_monotonic_time() - start;
+
+    return n == *count ? 0 : -1;
+}
+
+
+static int
+testBench(const void *data)
+{
+    const struct testBenchInfo *info = data;
+    struct testBenchTimes bitmap = { 0 };
+    struct testBenchTimes reference = { 0 };
+    g_autoptr(virBitmap) map = NULL;
+    g_autoptr(virBitmap) copy = NULL;
+    g_autofree char *str = NULL;
+    g_autofree char *refstr = NULL;
+    size_t count;
+    size_t refcount;
+    ssize_t last;
+    ssize_t reflast;
+    size_t i;
+
+    if (virTestGetExpensive() == 0 && info->nbits > 4096)
+        return EXIT_AM_SKIP;
+
+    map = virBitmapNew(info->nbits);
+    for (i = 0; i < info->nbits; i++) {
+        if ((i / 8) % info->stride == 0)
+            ignore_value(virBitmapSetBit(map, i));
+    }
+    copy = virBitmapNewCopy(map);
+
+    if (testBenchBitmap(map, copy, &bitmap, &count, &last, &str) < 0 ||
+        testBenchReference(map, copy, &reference,
+                           &refcount, &reflast, &refstr) < 0)
+        return -1;
+
+    if (count != refcount || last != reflast || STRNEQ(str, refstr)) {
+        VIR_TEST_VERBOSE("\nresults differ: %zu/%zu %zd/%zd '%s'/'%s'",
+                         count, refcount, last, reflast, str, refstr);
+        return -1;
+    }
+
+    VIR_TEST_VERBOSE("\n%zu bits, every %u. byte set, %u iterations "
+                     "(usec, virBitmap vs. bitwise):\n"
+                     "  count   %8lld %8lld\n"
+                     "  iterate %8lld %8lld\n"
+                     "  last    %8lld %8lld\n"
+                     "  equal   %8lld %8lld\n"
+                     "  format  %8lld %8lld",
+                     info->nbits, info->stride, benchIterations,
+                     (long long) bitmap.count, (long long) reference.count,
+                     (long long) bitmap.iterate, (long long) reference.iterate,
+                     (long long) bitmap.last, (long long) reference.last,
+                     (long long) bitmap.equal, (long long) reference.equal,
+                     (long long) bitmap.format, (long long) reference.format);
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    size_t sizes[] = { 64, 1024, 4096, 65536 };
+    unsigned int strides[] = { 1, 3, 64 };
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < G_N_ELEMENTS(sizes); i++) {
+        for (j = 0; j < G_N_ELEMENTS(strides); j++) {
+            struct testBenchInfo info = { sizes[i], strides[j] };
+            g_autofree char *name = NULL;
+
+            name = g_strdup_printf("bench %zu/%u", sizes[i], strides[j]);
+
+            if (virTestRun(name, testBench, &info) < 0)
+                ret = -1;
+        }
+    }
+
+    return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
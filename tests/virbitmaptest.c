@@ -25,6 +25,7 @@
 #include "testutils.h"
 
 #include "virbitmap.h"
+#include "virbuffer.h"
 
 static int
 test1(const void *data G_GNUC_UNUSED)
@@ -767,6 +768,114 @@ test15(const void *opaque)
 }
 
 
+/* Formats @map checking one bit at a time */
+static char *
+testBitwiseFormat(virBitmapPtr map)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    size_t nbits = virBitmapSize(map);
+    size_t i = 0;
+
+    while (i < nbits) {
+        size_t start;
+
+        if (!virBitmapIsBitSet(map, i)) {
+            i++;
+            continue;
+        }
+
+        start = i;
+        while (i + 1 < nbits && virBitmapIsBitSet(map, i + 1))
+            i++;
+
+        if (start == i)
+            virBufferAsprintf(&buf, "%zu,", start);
+        else
+            virBufferAsprintf(&buf, "%zu-%zu,", start, i);
+        i++;
+    }
+
+    virBufferTrimLen(&buf, 1);
+
+    return g_strdup(NULLSTR_EMPTY(virBufferCurrentContent(&buf)));
+}
+
+
+/* Compares the operations working on whole words with checking one bit
+ * at a time, on maps not ending on a word boundary too */
+static int
+test16(const void *opaque G_GNUC_UNUSED)
+{
+    size_t sizes[] = { 1, 63, 64, 65, 1000, 1024, 4096, 65536 };
+    unsigned int strides[] = { 1, 3, 64 };
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < G_N_ELEMENTS(sizes); i++) {
+        for (j = 0; j < G_N_ELEMENTS(strides); j++) {
+            g_autoptr(virBitmap) map = virBitmapNew(sizes[i]);
+            g_autoptr(virBitmap) copy = NULL;
+            g_autofree char *str = NULL;
+            g_autofree char *refstr = NULL;
+            size_t count = 0;
+            ssize_t last = -1;
+            ssize_t pos = -1;
+            size_t k;
+
+            /* every stride-th run of 8 bits is set */
+            for (k = 0; k < sizes[i]; k++) {
+                if ((k / 8) % strides[j] == 0)
+                    ignore_value(virBitmapSetBit(map, k));
+            }
+            copy = virBitmapNewCopy(map);
+
+            for (k = 0; k < sizes[i]; k++) {
+                if (!virBitmapIsBitSet(map, k))
+                    continue;
+
+                count++;
+                last = k;
+
+                pos = virBitmapNextSetBit(map, pos);
+                if (pos < 0 || (size_t) pos != k) {
+                    fprintf(stderr, "\n%zu/%u: next set bit %zd instead of %zu\n",
+                            sizes[i], strides[j], pos, k);
+                    return -1;
+                }
+            }
+
+            if (virBitmapNextSetBit(map, pos) != -1 ||
+                virBitmapCountBits(map) != count ||
+                virBitmapLastSetBit(map) != last ||
+                !virBitmapEqual(map, copy)) {
+                fprintf(stderr, "\n%zu/%u: count %zu/%zu last %zd/%zd\n",
+                        sizes[i], strides[j], virBitmapCountBits(map), count,
+                        virBitmapLastSetBit(map), last);
+                return -1;
+            }
+
+            str = virBitmapFormat(map);
+            refstr = testBitwiseFormat(map);
+            if (STRNEQ(str, refstr)) {
+                fprintf(stderr, "\n%zu/%u: formatted '%s' instead of '%s'\n",
+                        sizes[i], strides[j], str, refstr);
+                return -1;
+            }
+
+            /* a single bit differing in the last word */
+            ignore_value(virBitmapClearBit(copy, last));
+            if (virBitmapEqual(map, copy)) {
+                fprintf(stderr, "\n%zu/%u: maps differing in bit %zd are equal\n",
+                        sizes[i], strides[j], last);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
 #define TESTBINARYOP(A, B, RES, FUNC) \
     testBinaryOpData.a = A; \
     testBinaryOpData.b = B; \
@@ -834,6 +943,9 @@ mymain(void)
     TESTBINARYOP("12345", "0,^0", "12345", test15);
     TESTBINARYOP("0,^0", "0,^0", "0,^0", test15);
 
+    if (virTestRun("test16", test16, NULL) < 0)
+        ret = -1;
+
     return ret;
 }
 
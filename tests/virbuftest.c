@@ -378,6 +378,43 @@ testBufferAutoclean(const void *opaque G_GNUC_UNUSED)
 }
 
 
+static int
+testBufAsprintf(const void *opaque G_GNUC_UNUSED)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *expect = NULL;
+    g_autofree char *big = g_strnfill(1000, 'x');
+    size_t i;
+
+    /* Outgrow the buffer both in small steps and at once */
+    for (i = 0; i < 200; i++)
+        virBufferAsprintf(&buf, "%zu,", i % 10);
+    virBufferAsprintf(&buf, "<%s>", big);
+    virBufferEscapeString(&buf, "%s", big);
+    virBufferEscapeString(&buf, "%%<%s>", "&");
+
+    expect = g_strdup_printf("%s<%s>%s%%<&amp;>",
+                             "0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,"
+                             "0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,"
+                             "0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,"
+                             "0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,"
+                             "0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,"
+                             "0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,"
+                             "0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,"
+                             "0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,"
+                             "0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,"
+                             "0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,",
+                             big, big);
+
+    if (STRNEQ(virBufferCurrentContent(&buf), expect)) {
+        virTestDifference(stderr, expect, virBufferCurrentContent(&buf));
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int
 mymain(void)
 {
@@ -395,6 +432,7 @@ mymain(void)
     DO_TEST("AddBuffer", testBufAddBuffer);
     DO_TEST("set indent", testBufSetIndent);
     DO_TEST("autoclean", testBufferAutoclean);
+    DO_TEST("Asprintf", testBufAsprintf);
 
 #define DO_TEST_ADD_STR(_data, _expect) \
     do { \
@@ -423,6 +461,8 @@ mymain(void)
                    "<c>\n  <el>,,&apos;..&apos;,,</el>\n</c>");
     DO_TEST_ESCAPE("\x01\x01\x02\x03\x05\x08",
                    "<c>\n  <el></el>\n</c>");
+    DO_TEST_ESCAPE("a\tb\rc\x1a\xc3\xa9<",
+                   "<c>\n  <el>a\tb\rc\x1a\xc3\xa9&lt;</el>\n</c>");
 
 #define DO_TEST_ESCAPE_REGEX(_data, _expect) \
     do { \
@@ -59,4 +59,11 @@ VIR_MOCK_LINK_RET_ARGS(dbus_connection_send_with_reply_and_block,
                        int, timeout_milliseconds,
                        DBusError *, error)
 
+VIR_MOCK_LINK_RET_ARGS(dbus_connection_send_with_reply,
+                       dbus_bool_t,
+                       DBusConnection *, connection,
+                       DBusMessage *, message,
+                       DBusPendingCall **, pending_return,
+                       int, timeout_milliseconds)
+
 #endif /* WITH_DBUS && !WIN32 */
@@ -146,6 +146,16 @@ virFileCacheHandlers testFileCacheHandlers = {
 };
 
 
+virFileCacheHandlers testFileCacheBinaryHandlers = {
+    .isValid = testFileCacheIsValid,
+    .newData = testFileCacheNewData,
+    .loadFile = testFileCacheLoadFile,
+    .saveFile = testFileCacheSaveFile,
+    .loadBinaryFile = testFileCacheLoadFile,
+    .saveBinaryFile = testFileCacheSaveFile
+};
+
+
 struct _testFileCacheData {
     virFileCachePtr cache;
     const char *name;
@@ -223,6 +233,26 @@ mymain(void)
     TEST_RUN("cacheInvalid", "bbb\n", "bbb\n", true);
     TEST_RUN("cacheMissing", "ccc\n", "ccc\n", true);
 
+    /* Data missing from the cache can be found in the shared directory,
+     * unless it's outdated there too */
+    virFileCacheSetSharedDir(cache, abs_srcdir "/virfilecachedata/shared");
+
+    TEST_RUN("sharedValid", NULL, "ddd\n", false);
+    TEST_RUN("sharedInvalid", "fff\n", "fff\n", true);
+
+    virObjectUnref(cache);
+
+    /* A binary file is preferred, if there's none it is created from the
+     * regular one */
+    if (!(cache = virFileCacheNew(abs_srcdir "/virfilecachedata",
+                                  "cache", &testFileCacheBinaryHandlers)))
+        return EXIT_FAILURE;
+
+    virFileCacheSetPriv(cache, &testPriv);
+
+    TEST_RUN("binaryValid", NULL, "ggg\n", false);
+    TEST_RUN("cacheValid", NULL, "aaa\n", true);
+
     virObjectUnref(cache);
 
     return ret != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
@@ -1080,6 +1080,183 @@ testFirewallQuery(const void *opaque G_GNUC_UNUSED)
     return ret;
 }
 
+static void
+testFirewallBatchHook(const char *const*args G_GNUC_UNUSED,
+                      const char *const*env G_GNUC_UNUSED,
+                      const char *input,
+                      char **output G_GNUC_UNUSED,
+                      char **error G_GNUC_UNUSED,
+                      int *status,
+                      void *opaque)
+{
+    virBufferPtr inputbuf = opaque;
+
+    if (input)
+        virBufferAdd(inputbuf, input, -1);
+
+    /* Fake failure of the batch with this chain */
+    if (input && strstr(input, "-A FAIL"))
+        *status = 1;
+}
+
+static int
+testFirewallBatch(const void *opaque G_GNUC_UNUSED)
+{
+    virBuffer cmdbuf = VIR_BUFFER_INITIALIZER;
+    virBuffer inputbuf = VIR_BUFFER_INITIALIZER;
+    virFirewallPtr fw = NULL;
+    int ret = -1;
+    const char *actual = NULL;
+    const char *expected =
+        IPTABLES_RESTORE_PATH " -w --noflush\n"
+        EBTABLES_PATH " -A INPUT --jump DROP\n"
+        IPTABLES_PATH " -A INPUT --jump REJECT\n"
+        IP6TABLES_RESTORE_PATH " -w --noflush\n";
+    const char *expectedInput =
+        "*filter\n"
+        "-A INPUT --source-host 192.168.122.1 --jump ACCEPT\n"
+        "COMMIT\n"
+        "*nat\n"
+        "-A POSTROUTING -m comment --comment \"libvirt \\\"guest\\\"\" --jump MASQUERADE\n"
+        "COMMIT\n"
+        "*filter\n"
+        "-A INPUT --source ::1 --jump ACCEPT\n"
+        "-I FORWARD --jump REJECT\n"
+        "COMMIT\n";
+
+    if (virFirewallSetBackend(VIR_FIREWALL_BACKEND_DIRECT) < 0)
+        goto cleanup;
+
+    virFirewallSetBatchOverride(true);
+    virCommandSetDryRun(&cmdbuf, testFirewallBatchHook, &inputbuf);
+
+    fw = virFirewallNew();
+
+    virFirewallStartTransaction(fw, 0);
+
+    virFirewallAddRule(fw, VIR_FIREWALL_LAYER_IPV4,
+                       "-A", "INPUT",
+                       "--source-host", "192.168.122.1",
+                       "--jump", "ACCEPT", NULL);
+
+    virFirewallAddRule(fw, VIR_FIREWALL_LAYER_IPV4,
+                       "--table", "nat",
+                       "-A", "POSTROUTING",
+                       "-m", "comment", "--comment", "libvirt \"guest\"",
+                       "--jump", "MASQUERADE", NULL);
+
+    virFirewallAddRule(fw, VIR_FIREWALL_LAYER_ETHERNET,
+                       "-A", "INPUT",
+                       "--jump", "DROP", NULL);
+
+    virFirewallAddRule(fw, VIR_FIREWALL_LAYER_IPV4,
+                       "-A", "INPUT",
+                       "--jump", "REJECT", NULL);
+
+    virFirewallAddRule(fw, VIR_FIREWALL_LAYER_IPV6,
+                       "-A", "INPUT",
+                       "--source", "::1",
+                       "--jump", "ACCEPT", NULL);
+
+    virFirewallAddRule(fw, VIR_FIREWALL_LAYER_IPV6,
+                       "-I", "FORWARD",
+                       "--jump", "REJECT", NULL);
+
+    if (virFirewallApply(fw) < 0)
+        goto cleanup;
+
+    actual = virBufferCurrentContent(&cmdbuf);
+
+    if (STRNEQ_NULLABLE(expected, actual)) {
+        fprintf(stderr, "Unexpected command execution\n");
+        virTestDifference(stderr, expected, actual);
+        goto cleanup;
+    }
+
+    actual = virBufferCurrentContent(&inputbuf);
+
+    if (STRNEQ_NULLABLE(expectedInput, actual)) {
+        fprintf(stderr, "Unexpected batch input\n");
+        virTestDifference(stderr, expectedInput, actual);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virBufferFreeAndReset(&cmdbuf);
+    virBufferFreeAndReset(&inputbuf);
+    virCommandSetDryRun(NULL, NULL, NULL);
+    virFirewallSetBatchOverride(false);
+    virFirewallFree(fw);
+    return ret;
+}
+
+static int
+testFirewallBatchRollback(const void *opaque G_GNUC_UNUSED)
+{
+    virBuffer cmdbuf = VIR_BUFFER_INITIALIZER;
+    virBuffer inputbuf = VIR_BUFFER_INITIALIZER;
+    virFirewallPtr fw = NULL;
+    int ret = -1;
+    const char *actual = NULL;
+    const char *expected =
+        IPTABLES_RESTORE_PATH " -w --noflush\n"
+        IPTABLES_PATH " -D INPUT --source-host 192.168.122.1 --jump ACCEPT\n"
+        IPTABLES_PATH " -D FAIL --jump REJECT\n";
+
+    if (virFirewallSetBackend(VIR_FIREWALL_BACKEND_DIRECT) < 0)
+        goto cleanup;
+
+    virFirewallSetBatchOverride(true);
+    virCommandSetDryRun(&cmdbuf, testFirewallBatchHook, &inputbuf);
+
+    fw = virFirewallNew();
+
+    virFirewallStartTransaction(fw, 0);
+
+    virFirewallAddRule(fw, VIR_FIREWALL_LAYER_IPV4,
+                       "-A", "INPUT",
+                       "--source-host", "192.168.122.1",
+                       "--jump", "ACCEPT", NULL);
+
+    virFirewallAddRule(fw, VIR_FIREWALL_LAYER_IPV4,
+                       "-A", "FAIL",
+                       "--jump", "REJECT", NULL);
+
+    virFirewallStartRollback(fw, 0);
+
+    virFirewallAddRule(fw, VIR_FIREWALL_LAYER_IPV4,
+                       "-D", "INPUT",
+                       "--source-host", "192.168.122.1",
+                       "--jump", "ACCEPT", NULL);
+
+    virFirewallAddRule(fw, VIR_FIREWALL_LAYER_IPV4,
+                       "-D", "FAIL",
+                       "--jump", "REJECT", NULL);
+
+    if (virFirewallApply(fw) == 0) {
+        fprintf(stderr, "Firewall apply unexpectedly worked\n");
+        goto cleanup;
+    }
+
+    actual = virBufferCurrentContent(&cmdbuf);
+
+    if (STRNEQ_NULLABLE(expected, actual)) {
+        fprintf(stderr, "Unexpected command execution\n");
+        virTestDifference(stderr, expected, actual);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virBufferFreeAndReset(&cmdbuf);
+    virBufferFreeAndReset(&inputbuf);
+    virCommandSetDryRun(NULL, NULL, NULL);
+    virFirewallSetBatchOverride(false);
+    virFirewallFree(fw);
+    return ret;
+}
+
 static bool
 hasNetfilterTools(void)
 {
@@ -1150,6 +1327,11 @@ mymain(void)
     RUN_TEST("chained rollback", testFirewallChainedRollback);
     RUN_TEST("query transaction", testFirewallQuery);
 
+    if (virTestRun("batch", testFirewallBatch, NULL) < 0)
+        ret = -1;
+    if (virTestRun("batch rollback", testFirewallBatchRollback, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
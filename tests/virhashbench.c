@@ -0,0 +1,366 @@
+#include <config.h>
+
+#include "internal.h"
+#include "virhash.h"
+#include "virhashcode.h"
+#include "testutils.h"
+#include "viralloc.h"
+#include "virlog.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("tests.hashbench");
+
+/*
+ * A stripped down copy of the chained hash table virHashTable used to be,
+ * kept around as the reference to compare the current implementation with.
+ */
+#define TEST_CHAINED_MAX_LEN 8
+
+typedef struct _testChainedEntry testChainedEntry;
+typedef testChainedEntry *testChainedEntryPtr;
+struct _testChainedEntry {
+    testChainedEntryPtr next;
+    char *name;
+    void *payload;
+};
+
+typedef struct _testChainedTable testChainedTable;
+typedef testChainedTable *testChainedTablePtr;
+struct _testChainedTable {
+    testChainedEntryPtr *table;
+    uint32_t seed;
+    size_t size;
+    size_t nbElems;
+};
+
+
+static size_t
+testChainedKey(testChainedTablePtr table, const char *name)
+{
+    return virHashCodeGen(name, strlen(name), table->seed) % table->size;
+}
+
+
+static testChainedTablePtr
+testChainedNew(size_t size)
+{
+    testChainedTablePtr table = g_new0(testChainedTable, 1);
+
+    table->seed = 42;
+    table->size = size;
+    table->table = g_new0(testChainedEntryPtr, size);
+
+    return table;
+}
+
+
+static void
+testChainedGrow(testChainedTablePtr table, size_t size)
+{
+    testChainedEntryPtr *oldtable = table->table;
+    size_t oldsize = table->size;
+    size_t i;
+
+    if (size > 8 * 2048)
+        return;
+
+    table->table = g_new0(testChainedEntryPtr, size);
+    table->size = size;
+
+    for (i = 0; i < oldsize; i++) {
+        testChainedEntryPtr iter = oldtable[i];
+        while (iter) {
+            testChainedEntryPtr next = iter->next;
+            size_t key = testChainedKey(table, iter->name);
+
+            iter->next = table->table[key];
+            table->table[key] = iter;
+            iter = next;
+        }
+    }
+
+    VIR_FREE(oldtable);
+}
+
+
+static void
+testChainedAdd(testChainedTablePtr table, const char *name, void *payload)
+{
+    size_t key = testChainedKey(table, name);
+    size_t len = 0;
+    testChainedEntryPtr entry;
+    testChainedEntryPtr last = NULL;
+
+    for (entry = table->table[key]; entry; entry = entry->next) {
+        if (STREQ(entry->name, name))
+            return;
+        last = entry;
+        len++;
+    }
+
+    entry = g_new0(testChainedEntry, 1);
+    entry->name = g_strdup(name);
+    entry->payload = payload;
+
+    if (last)
+        last->next = entry;
+    else
+        table->table[key] = entry;
+
+    table->nbElems++;
+
+    if (len > TEST_CHAINED_MAX_LEN)
+        testChainedGrow(table, TEST_CHAINED_MAX_LEN * table->size);
+}
+
+
+static void *
+testChainedLookup(testChainedTablePtr table, const char *name)
+{
+    testChainedEntryPtr entry;
+
+    for (entry = table->table[testChainedKey(table, name)]; entry; entry = entry->next) {
+        if (STREQ(entry->name, name))
+            return entry->payload;
+    }
+
+    return NULL;
+}
+
+
+static void
+testChainedRemove(testChainedTablePtr table, const char *name)
+{
+    testChainedEntryPtr *nextptr = table->table + testChainedKey(table, name);
+    testChainedEntryPtr entry;
+
+    for (entry = *nextptr; entry; entry = entry->next) {
+        if (STREQ(entry->name, name)) {
+            *nextptr = entry->next;
+            VIR_FREE(entry->name);
+            VIR_FREE(entry);
+            table->nbElems--;
+            return;
+        }
+        nextptr = &entry->next;
+    }
+}
+
+
+static size_t
+testChainedForEach(testChainedTablePtr table)
+{
+    size_t count = 0;
+    size_t i;
+
+    for (i = 0; i < table->size; i++) {
+        testChainedEntryPtr entry;
+        for (entry = table->table[i]; entry; entry = entry->next)
+            count++;
+    }
+
+    return count;
+}
+
+
+static void
+testChainedFree(testChainedTablePtr table)
+{
+    size_t i;
+
+    for (i = 0; i < table->size; i++) {
+        testChainedEntryPtr iter = table->table[i];
+        while (iter) {
+            testChainedEntryPtr next = iter->next;
+            VIR_FREE(iter->name);
+            VIR_FREE(iter);
+            iter = next;
+        }
+    }
+
+    VIR_FREE(table->table);
+    VIR_FREE(table);
+}
+
+
+struct testBenchInfo {
+    size_t count;
+    char **keys;
+};
+
+
+struct testBenchTimes {
+    gint64 add;
+    gint64 lookup;
+    gint64 foreach;
+    gint64 remove;
+};
+
+
+static int
+testBenchCount(void *payload G_GNUC_UNUSED,
+               const void *name G_GNUC_UNUSED,
+               void *data)
+{
+    size_t *count = data;
+    *count += 1;
+    return 0;
+}
+
+
+static int
+testBenchHash(const struct testBenchInfo *info,
+              struct testBenchTimes *times)
+{
+    virHashTablePtr hash = virHashNew(NULL);
+    gint64 start;
+    size_t count = 0;
+    size_t i;
+    int ret = -1;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < info->count; i++) {
+        if (virHashAddEntry(hash, info->keys[i], info->keys[i]) < 0)
+            goto cleanup;
+    }
+    times->add = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < info->count; i++) {
+        if (virHashLookup(hash, info->keys[i]) != info->keys[i]) {
+            VIR_TEST_VERBOSE("\nentry '%s' not found", info->keys[i]);
+            goto cleanup;
+        }
+    }
+    times->lookup = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    virHashForEach(hash, testBenchCount, &count);
+    times->foreach = g_get_monotonic_time() - start;
+
+    if (count != info->count) {
+        VIR_TEST_VERBOSE("\niterated over %zu entries instead of %zu",
+                         count, info->count);
+        goto cleanup;
+    }
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < info->count; i++)
+        virHashRemoveEntry(hash, info->keys[i]);
+    times->remove = g_get_monotonic_time() - start;
+
+    if (virHashSize(hash) != 0) {
+        VIR_TEST_VERBOSE("\n%zd entries left after removing all of them",
+                         virHashSize(hash));
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virHashFree(hash);
+    return ret;
+}
+
+
+static int
+testBenchChained(const struct testBenchInfo *info,
+                 struct testBenchTimes *times)
+{
+    testChainedTablePtr table = testChainedNew(32);
+    gint64 start;
+    size_t count;
+    size_t i;
+    int ret = -1;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < info->count; i++)
+        testChainedAdd(table, info->keys[i], info->keys[i]);
+    times->add = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < info->count; i++) {
+        if (testChainedLookup(table, info->keys[i]) != info->keys[i]) {
+            VIR_TEST_VERBOSE("\nentry '%s' not found", info->keys[i]);
+            goto cleanup;
+        }
+    }
+    times->lookup = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    count = testChainedForEach(table);
+    times->foreach = g_get_monotonic_time() - start;
+
+    if (count != info->count)
+        goto cleanup;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < info->count; i++)
+        testChainedRemove(table, info->keys[i]);
+    times->remove = g_get_monotonic_time() - start;
+
+    ret = 0;
+
+ cleanup:
+    testChainedFree(table);
+    return ret;
+}
+
+
+static int
+testBench(const void *data)
+{
+    const struct testBenchInfo *info = data;
+    struct testBenchTimes hash = { 0 };
+    struct testBenchTimes chained = { 0 };
+
+    if (virTestGetExpensive() == 0 && info->count > 10000)
+        return EXIT_AM_SKIP;
+
+    if (testBenchHash(info, &hash) < 0 ||
+        testBenchChained(info, &chained) < 0)
+        return -1;
+
+    VIR_TEST_VERBOSE("\n%zu entries (usec, virHash vs. chained):\n"
+                     "  add     %8lld %8lld\n"
+                     "  lookup  %8lld %8lld\n"
+                     "  foreach %8lld %8lld\n"
+                     "  remove  %8lld %8lld",
+                     info->count,
+                     (long long) hash.add, (long long) chained.add,
+                     (long long) hash.lookup, (long long) chained.lookup,
+                     (long long) hash.foreach, (long long) chained.foreach,
+                     (long long) hash.remove, (long long) chained.remove);
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    size_t sizes[] = { 10000, 100000, 1000000 };
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < G_N_ELEMENTS(sizes); i++) {
+        struct testBenchInfo info = { sizes[i], NULL };
+        g_autofree char *name = g_strdup_printf("bench %zu", sizes[i]);
+
+        info.keys = g_new0(char *, info.count + 1);
+        for (j = 0; j < info.count; j++)
+            info.keys[j] = g_strdup_printf("domain-%zu", j);
+
+        if (virTestRun(name, testBench, &info) < 0)
+            ret = -1;
+
+        virStringListFree(info.keys);
+    }
+
+    return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -23,9 +23,7 @@ testHashInit(int size)
     if (!(hash = virHashCreate(size, NULL)))
         return NULL;
 
-    /* entries are added in reverse order so that they will be linked in
-     * collision list in the same order as in the uuids array
-     */
+    /* entries are added in reverse order of the uuids array */
     for (i = G_N_ELEMENTS(uuids) - 1; i >= 0; i--) {
         ssize_t oldsize = virHashTableSize(hash);
         if (virHashAddEntry(hash, uuids[i], (void *) uuids[i]) < 0) {
@@ -532,6 +530,66 @@ testHashDuplicate(const void *data G_GNUC_UNUSED)
 }
 
 
+/* Enough entries for the table to grow several times and for removed
+ * entries to be in the way of the lookups of others */
+static int
+testHashMany(const void *data)
+{
+    const struct testInfo *info = data;
+    g_autoptr(virHashTable) hash = NULL;
+    g_auto(GStrv) keys = NULL;
+    size_t i;
+
+    if (!(hash = virHashNew(NULL)))
+        return -1;
+
+    keys = g_new0(char *, info->count + 1);
+    for (i = 0; i < info->count; i++)
+        keys[i] = g_strdup_printf("domain-%zu", i);
+
+    for (i = 0; i < info->count; i++) {
+        if (virHashAddEntry(hash, keys[i], keys[i]) < 0)
+            return -1;
+    }
+
+    if (testHashCheckCount(hash, info->count) < 0)
+        return -1;
+
+    for (i = 0; i < info->count; i += 2)
+        virHashRemoveEntry(hash, keys[i]);
+
+    if (testHashCheckCount(hash, info->count / 2) < 0)
+        return -1;
+
+    for (i = 0; i < info->count; i++) {
+        void *expect = i % 2 ? keys[i] : NULL;
+
+        if (virHashLookup(hash, keys[i]) != expect) {
+            VIR_TEST_VERBOSE("\nentry '%s' should %sbe found", keys[i],
+                             expect ? "" : "not ");
+            return -1;
+        }
+    }
+
+    for (i = 0; i < info->count; i += 2) {
+        if (virHashAddEntry(hash, keys[i], keys[i]) < 0)
+            return -1;
+    }
+
+    for (i = 0; i < info->count; i++) {
+        if (virHashLookup(hash, keys[i]) != keys[i]) {
+            VIR_TEST_VERBOSE("\nentry '%s' could not be found", keys[i]);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < info->count; i++)
+        virHashRemoveEntry(hash, keys[i]);
+
+    return testHashCheckCount(hash, 0);
+}
+
+
 static int
 mymain(void)
 {
@@ -569,6 +627,8 @@ mymain(void)
     DO_TEST("GetItems", GetItems);
     DO_TEST("Equal", Equal);
     DO_TEST("Duplicate entry", Duplicate);
+    DO_TEST_COUNT("Many", Many, 10000);
+    DO_TEST_COUNT("Many", Many, 100000);
 
     return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -1,6 +1,7 @@
 #include <config.h>
 
 #include <time.h>
+#include <unistd.h>
 
 #include "internal.h"
 #include "virjson.h"
@@ -61,6 +62,48 @@ testJSONFromFile(const void *data)
 }
 
 
+/* Parses and formats the documents of testJSONFromFile through files
+ * rather than strings */
+static int
+testJSONFileRoundTrip(const void *data)
+{
+    const struct testInfo *info = data;
+    g_autoptr(virJSONValue) injson = NULL;
+    g_autoptr(virJSONValue) outjson = NULL;
+    g_autofree char *infile = NULL;
+    g_autofree char *outfile = NULL;
+    g_autofree char *tmpfile = NULL;
+    g_autofree char *actual = NULL;
+    int ret = -1;
+
+    infile = g_strdup_printf("%s/virjsondata/parse-%s-in.json",
+                             abs_srcdir, info->name);
+    outfile = g_strdup_printf("%s/virjsondata/parse-%s-out.json",
+                              abs_srcdir, info->name);
+    tmpfile = g_strdup_printf("%s/virjsontest-%s.json",
+                              abs_builddir, info->name);
+
+    if (!(injson = virJSONValueFromFile(infile)))
+        return -1;
+
+    if (virJSONValueToFile(injson, tmpfile, 0600, true) < 0)
+        goto cleanup;
+
+    if (!(outjson = virJSONValueFromFile(tmpfile)) ||
+        !(actual = virJSONValueToString(outjson, false)))
+        goto cleanup;
+
+    if (virTestCompareToFile(actual, outfile) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    unlink(tmpfile);
+    return ret;
+}
+
+
 static int
 testJSONFromString(const void *data)
 {
@@ -470,6 +513,130 @@ testJSONObjectFormatSteal(const void *opaque G_GNUC_UNUSED)
 }
 
 
+static int
+testJSONArena(const void *data)
+{
+    const struct testInfo *info = data;
+    g_autoptr(virJSONValue) json = NULL;
+    g_autoptr(virJSONValue) stolen = NULL;
+    g_autofree char *formatted = NULL;
+
+    if (!(json = virJSONValueFromStringArena(info->doc, NULL))) {
+        VIR_TEST_VERBOSE("Failed to parse %s", info->doc);
+        return -1;
+    }
+
+    if (virJSONValueObjectAppendString(json, "added", "value") < 0 ||
+        virJSONValueObjectRemoveKey(json, "removed", NULL) != 1 ||
+        !(stolen = virJSONValueObjectStealObject(json, "stolen"))) {
+        VIR_TEST_VERBOSE("Failed to modify arena backed object");
+        return -1;
+    }
+
+    /* the stolen subtree has to outlive the original document */
+    virJSONValueFree(g_steal_pointer(&json));
+
+    if (virJSONValueObjectAppendNumberInt(stolen, "n", 1) < 0) {
+        VIR_TEST_VERBOSE("Failed to modify stolen object");
+        return -1;
+    }
+
+    if (!(formatted = virJSONValueToString(stolen, false))) {
+        VIR_TEST_VERBOSE("Failed to format json data");
+        return -1;
+    }
+
+    if (STRNEQ(info->expect, formatted)) {
+        virTestDifference(stderr, info->expect, formatted);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+struct testFilterInfo {
+    const char *doc;
+    const char *const *filters;
+    const char *expect;
+};
+
+
+static int
+testJSONFromStringFiltered(const void *data)
+{
+    const struct testFilterInfo *info = data;
+    g_autoptr(virJSONValue) json = NULL;
+    g_autofree char *formatted = NULL;
+
+    if (!(json = virJSONValueFromStringFiltered(info->doc, info->filters))) {
+        if (!info->expect) {
+            VIR_TEST_DEBUG("As expected, failed to parse %s", info->doc);
+            return 0;
+        }
+        VIR_TEST_VERBOSE("Failed to parse %s", info->doc);
+        return -1;
+    }
+
+    if (!info->expect) {
+        VIR_TEST_VERBOSE("Unexpected success while parsing %s", info->doc);
+        return -1;
+    }
+
+    if (!(formatted = virJSONValueToString(json, false))) {
+        VIR_TEST_VERBOSE("Failed to format json data");
+        return -1;
+    }
+
+    if (STRNEQ(info->expect, formatted)) {
+        virTestDifference(stderr, info->expect, formatted);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testJSONStreamParseCallback(const char *path,
+                            virJSONValuePtr value,
+                            void *opaque)
+{
+    virBufferPtr buf = opaque;
+    g_autofree char *str = NULL;
+
+    if (!(str = virJSONValueToString(value, false)))
+        return -1;
+
+    virBufferAsprintf(buf, "%s=%s;", path, str);
+    return 0;
+}
+
+
+static int
+testJSONStreamParse(const void *data)
+{
+    const struct testFilterInfo *info = data;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *actual = NULL;
+
+    if (virJSONValueStreamParse(info->doc, info->filters,
+                                testJSONStreamParseCallback, &buf) < 0) {
+        VIR_TEST_VERBOSE("Failed to parse %s", info->doc);
+        return -1;
+    }
+
+    actual = virBufferContentAndReset(&buf);
+
+    if (STRNEQ_NULLABLE(info->expect, actual)) {
+        virTestDifference(stderr, NULLSTR(info->expect), NULLSTR(actual));
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int
 mymain(void)
 {
@@ -498,7 +665,13 @@ mymain(void)
     DO_TEST_FULL(name, FromString, doc, NULL, false)
 
 #define DO_TEST_PARSE_FILE(name) \
-    DO_TEST_FULL(name, FromFile, NULL, NULL, true)
+    do { \
+        struct testInfo info = { name, NULL, NULL, true }; \
+        if (virTestRun(name, testJSONFromFile, &info) < 0) \
+            ret = -1; \
+        if (virTestRun(name " round trip", testJSONFileRoundTrip, &info) < 0) \
+            ret = -1; \
+    } while (0)
 
 
     DO_TEST_PARSE_FILE("Simple");
@@ -591,6 +764,10 @@ mymain(void)
     DO_TEST_FULL("lookup with correct type", Lookup,
                  "{ \"a\": {}, \"b\": 1, \"c\": \"str\", \"d\": [] }",
                  NULL, true);
+    DO_TEST_FULL("arena", Arena,
+                 "{ \"removed\": [1, 2], \"stolen\": { \"a\": \"b\", "
+                 "\"c\": [true, null] }, \"kept\": 1 }",
+                 "{\"a\":\"b\",\"c\":[true,null],\"n\":1}", true);
     DO_TEST_FULL("create object with nested json in attribute", EscapeObj,
                  NULL, NULL, true);
     DO_TEST_FULL("stealing of attributes while creating objects",
@@ -611,6 +788,53 @@ mymain(void)
     DO_TEST_DEFLATTEN("qemu-sheepdog", true);
     DO_TEST_DEFLATTEN("dotted-array", true);
 
+#define DO_TEST_FILTER_FULL(name, cmd, doc, expect, ...) \
+    do { \
+        const char *filters[] = { __VA_ARGS__, NULL }; \
+        struct testFilterInfo info = { doc, filters, expect }; \
+        if (virTestRun(name, testJSON ## cmd, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+#define DO_TEST_FILTER(name, doc, expect, ...) \
+    DO_TEST_FILTER_FULL(name, FromStringFiltered, doc, expect, __VA_ARGS__)
+
+#define DO_TEST_STREAM(name, doc, expect, ...) \
+    DO_TEST_FILTER_FULL(name, StreamParse, doc, expect, __VA_ARGS__)
+
+#define QUERY_BLOCK_REPLY \
+    "{\"return\": [" \
+    "{\"device\": \"drive0\", \"locked\": false," \
+    " \"inserted\": {\"file\": \"/a.qcow2\", \"image\": {\"virtual-size\": 1," \
+    " \"backing-image\": {\"virtual-size\": 2}}}}," \
+    "{\"device\": \"cd0\", \"locked\": true}" \
+    "], \"id\": \"libvirt-1\"}"
+
+    DO_TEST_FILTER("filter single key", QUERY_BLOCK_REPLY,
+                   "{\"id\":\"libvirt-1\"}", "id");
+    DO_TEST_FILTER("filter wildcard", QUERY_BLOCK_REPLY,
+                   "{\"return\":[{\"device\":\"drive0\","
+                   "\"inserted\":{\"image\":{\"virtual-size\":1,"
+                   "\"backing-image\":{\"virtual-size\":2}}}},"
+                   "{\"device\":\"cd0\"}]}",
+                   "return/*/device", "return/*/inserted/image");
+    DO_TEST_FILTER("filter array index", QUERY_BLOCK_REPLY,
+                   "{\"return\":[{\"locked\":true}]}",
+                   "return/1/locked");
+    DO_TEST_FILTER("filter no match", QUERY_BLOCK_REPLY,
+                   "{}", "error");
+    DO_TEST_FILTER("filter scalar document", "1", "1", "return");
+    DO_TEST_FILTER("filter invalid path", QUERY_BLOCK_REPLY,
+                   NULL, "return//device");
+    DO_TEST_FILTER("filter malformed", "{\"a\": [1, 2}", NULL, "a");
+
+    DO_TEST_STREAM("stream wildcard", QUERY_BLOCK_REPLY,
+                   "return/0/device=\"drive0\";"
+                   "return/0/inserted/image/backing-image={\"virtual-size\":2};"
+                   "return/1/device=\"cd0\";",
+                   "return/*/device", "return/*/inserted/image/backing-image");
+    DO_TEST_STREAM("stream no match", QUERY_BLOCK_REPLY, NULL, "return/*/xxx");
+
     return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -337,6 +337,56 @@ static int testLockSpaceResourceLockPath(const void *args G_GNUC_UNUSED)
 }
 
 
+static int testLockSpaceResourceReleaseOwner(const void *args G_GNUC_UNUSED)
+{
+    virLockSpacePtr lockspace;
+    int ret = -1;
+    size_t i;
+
+    rmdir(LOCKSPACE_DIR);
+
+    if (!(lockspace = virLockSpaceNew(LOCKSPACE_DIR)))
+        goto cleanup;
+
+    /* Enough resources to end up in every shard */
+    for (i = 0; i < 64; i++) {
+        g_autofree char *resname = g_strdup_printf("res%zu", i);
+
+        if (virLockSpaceAcquireResource(lockspace, resname, geteuid(),
+                                        VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE) < 0)
+            goto cleanup;
+    }
+
+    if (virLockSpaceAcquireResource(lockspace, "foo", geteuid() + 1,
+                                    VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE) < 0)
+        goto cleanup;
+
+    if (virLockSpaceReleaseResourcesForOwner(lockspace, geteuid()) != 64) {
+        fprintf(stderr, "Expected 64 resources to be released\n");
+        goto cleanup;
+    }
+
+    if (virFileExists(LOCKSPACE_DIR "/res0") ||
+        virFileExists(LOCKSPACE_DIR "/res63"))
+        goto cleanup;
+
+    if (virLockSpaceAcquireResource(lockspace, "foo", geteuid(), 0) == 0) {
+        fprintf(stderr, "Resource of other owner should still be locked\n");
+        goto cleanup;
+    }
+
+    if (virLockSpaceReleaseResource(lockspace, "foo", geteuid() + 1) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virLockSpaceFree(lockspace);
+    rmdir(LOCKSPACE_DIR);
+    return ret;
+}
+
+
 
 static int
 mymain(void)
@@ -368,6 +418,9 @@ mymain(void)
     if (virTestRun("Lockspace res full path", testLockSpaceResourceLockPath, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Lockspace res release owner", testLockSpaceResourceReleaseOwner, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -0,0 +1,866 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virerror.h"
+#include "virfile.h"
+#include "virjson.h"
+#include "virlog.h"
+#include "virstring.h"
+#include "virthread.h"
+#include "rpc/virnetdaemon.h"
+#include "rpc/virnetclient.h"
+#include "rpc/virnetclientprogram.h"
+#include "virnettlshelpers.h"
+
+#define VIR_FROM_THIS VIR_FROM_RPC
+
+VIR_LOG_INIT("tests.netbench");
+
+#ifndef WIN32
+
+# if HAVE_LIBTASN1_H && LIBGNUTLS_VERSION_NUMBER >= 0x020600
+#  define TEST_BENCH_TLS 1
+#  define KEYFILE "key-bench.pem"
+# endif
+
+/*
+ * Runs a virNetServer and a number of virNetClient connections to it
+ * in the same process and measures how fast calls and events travel
+ * between them. The following environment variables tune the runs:
+ *
+ *  VIR_NET_BENCH_CLIENTS  number of concurrent connections
+ *  VIR_NET_BENCH_CALLS    number of calls made by each connection
+ *  VIR_NET_BENCH_EVENTS   number of events sent to each connection
+ *  VIR_NET_BENCH_RESULTS  file to append the results to, one JSON
+ *                         object per line
+ */
+# define TEST_BENCH_PROGRAM 0x62656e63
+# define TEST_BENCH_VERSION 1
+
+enum {
+    TEST_BENCH_PROC_ECHO = 1,
+    TEST_BENCH_PROC_SUBSCRIBE = 2,
+    TEST_BENCH_PROC_BROADCAST = 3,
+    TEST_BENCH_PROC_EVENT = 4,
+};
+
+/* Size of the payload of the bulk transfer calls */
+# define TEST_BENCH_BULK_SIZE (256 * 1024)
+
+typedef enum {
+    TEST_BENCH_TRANSPORT_UNIX,
+    TEST_BENCH_TRANSPORT_TCP,
+    TEST_BENCH_TRANSPORT_TLS,
+
+    TEST_BENCH_TRANSPORT_LAST
+} testBenchTransport;
+
+VIR_ENUM_DECL(testBenchTransport);
+VIR_ENUM_IMPL(testBenchTransport,
+              TEST_BENCH_TRANSPORT_LAST,
+              "unix", "tcp", "tls",
+);
+
+typedef struct _testBenchPayload testBenchPayload;
+struct _testBenchPayload {
+    u_int len;
+    char *val;
+};
+
+static bool_t
+testBenchXdrPayload(XDR *xdrs, testBenchPayload *payload)
+{
+    return xdr_bytes(xdrs, &payload->val, &payload->len,
+                     VIR_NET_MESSAGE_PAYLOAD_MAX / 2);
+}
+
+
+struct testBenchConfig {
+    unsigned int clients;
+    unsigned int calls;
+    unsigned int events;
+    const char *results;
+};
+
+static struct testBenchConfig benchConfig = {
+    .clients = 4,
+    .calls = 1000,
+    .events = 1000,
+};
+
+
+typedef struct _testBenchServer testBenchServer;
+typedef testBenchServer *testBenchServerPtr;
+struct _testBenchServer {
+    virNetDaemonPtr dmn;
+    virNetServerPtr srv;
+    virNetServerProgramPtr prog;
+    virThread thread;
+
+    char *sockdir;
+    char *sockpath;
+    char *port;
+    virNetTLSContextPtr serverTLS;
+    virNetTLSContextPtr clientTLS;
+
+    virMutex lock;
+    size_t nsubscribers;
+    virNetServerClientPtr *subscribers;
+};
+
+/* The dispatch functions have no opaque data to find the server in */
+static testBenchServer benchServer;
+
+
+static int
+testBenchDispatchEcho(virNetServerPtr server G_GNUC_UNUSED,
+                      virNetServerClientPtr client G_GNUC_UNUSED,
+                      virNetMessagePtr msg G_GNUC_UNUSED,
+                      virNetMessageErrorPtr rerr G_GNUC_UNUSED,
+                      void *args,
+                      void *ret)
+{
+    testBenchPayload *in = args;
+    testBenchPayload *out = ret;
+
+    out->len = in->len;
+    out->val = g_steal_pointer(&in->val);
+    in->len = 0;
+
+    return 0;
+}
+
+
+static int
+testBenchDispatchSubscribe(virNetServerPtr server G_GNUC_UNUSED,
+                           virNetServerClientPtr client,
+                           virNetMessagePtr msg G_GNUC_UNUSED,
+                           virNetMessageErrorPtr rerr G_GNUC_UNUSED,
+                           void *args G_GNUC_UNUSED,
+                           void *ret G_GNUC_UNUSED)
+{
+    virNetServerClientPtr tmp = virObjectRef(client);
+
+    virMutexLock(&benchServer.lock);
+    ignore_value(VIR_APPEND_ELEMENT(benchServer.subscribers,
+                                    benchServer.nsubscribers, tmp));
+    virMutexUnlock(&benchServer.lock);
+
+    return 0;
+}
+
+
+static int
+testBenchSendEvent(virNetServerClientPtr client,
+                   unsigned int seq)
+{
+    virNetMessagePtr msg;
+
+    if (!(msg = virNetServerClientNewMessage(client, false)))
+        return -1;
+
+    msg->header.prog = TEST_BENCH_PROGRAM;
+    msg->header.vers = TEST_BENCH_VERSION;
+    msg->header.proc = TEST_BENCH_PROC_EVENT;
+    msg->header.type = VIR_NET_MESSAGE;
+    msg->header.serial = 1;
+    msg->header.status = VIR_NET_OK;
+
+    if (virNetMessageEncodeHeader(msg) < 0 ||
+        virNetMessageEncodePayload(msg, (xdrproc_t)xdr_u_int, &seq) < 0 ||
+        virNetServerClientSendEvent(client, msg, NULL) < 0) {
+        virNetMessageFree(msg);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testBenchDispatchBroadcast(virNetServerPtr server G_GNUC_UNUSED,
+                           virNetServerClientPtr client G_GNUC_UNUSED,
+                           virNetMessagePtr msg G_GNUC_UNUSED,
+                           virNetMessageErrorPtr rerr G_GNUC_UNUSED,
+                           void *args,
+                           void *ret G_GNUC_UNUSED)
+{
+    unsigned int *count = args;
+    unsigned int seq;
+    size_t i;
+    int rv = 0;
+
+    virMutexLock(&benchServer.lock);
+    for (seq = 0; seq < *count && rv == 0; seq++) {
+        for (i = 0; i < benchServer.nsubscribers; i++) {
+            if (testBenchSendEvent(benchServer.subscribers[i], seq) < 0) {
+                rv = -1;
+                break;
+            }
+        }
+    }
+    virMutexUnlock(&benchServer.lock);
+
+    return rv;
+}
+
+
+static virNetServerProgramProc testBenchProcs[] = {
+    { NULL, 0, (xdrproc_t)xdr_void, 0, (xdrproc_t)xdr_void, false, 0 },
+    { testBenchDispatchEcho,
+      sizeof(testBenchPayload), (xdrproc_t)testBenchXdrPayload,
+      sizeof(testBenchPayload), (xdrproc_t)testBenchXdrPayload,
+      false, 0 },
+    { testBenchDispatchSubscribe,
+      0, (xdrproc_t)xdr_void, 0, (xdrproc_t)xdr_void, false, 0 },
+    { testBenchDispatchBroadcast,
+      sizeof(unsigned int), (xdrproc_t)xdr_u_int, 0, (xdrproc_t)xdr_void,
+      false, 0 },
+};
+
+
+static void *
+testBenchClientPrivNew(virNetServerClientPtr client G_GNUC_UNUSED,
+                       void *opaque G_GNUC_UNUSED)
+{
+    return g_new0(char, 1);
+}
+
+
+static void
+testBenchClientPrivFree(void *opaque)
+{
+    g_free(opaque);
+}
+
+
+static void
+testBenchServerThread(void *opaque)
+{
+    testBenchServerPtr bs = opaque;
+
+    virNetDaemonRun(bs->dmn);
+}
+
+
+static void
+testBenchServerWakeup(int timer, void *opaque G_GNUC_UNUSED)
+{
+    virEventRemoveTimeout(timer);
+}
+
+
+static void
+testBenchServerStop(testBenchServerPtr bs)
+{
+    size_t i;
+
+    if (bs->dmn) {
+        virNetDaemonQuit(bs->dmn);
+        /* Kick the event loop so that it notices the request to quit */
+        if (virEventAddTimeout(0, testBenchServerWakeup, NULL, NULL) >= 0)
+            virThreadJoin(&bs->thread);
+        virNetDaemonClose(bs->dmn);
+    }
+
+    for (i = 0; i < bs->nsubscribers; i++)
+        virObjectUnref(bs->subscribers[i]);
+    VIR_FREE(bs->subscribers);
+    bs->nsubscribers = 0;
+
+    virObjectUnref(bs->dmn);
+    virObjectUnref(bs->srv);
+    virObjectUnref(bs->prog);
+    bs->dmn = NULL;
+    bs->srv = NULL;
+    bs->prog = NULL;
+
+    if (bs->sockpath)
+        unlink(bs->sockpath);
+    if (bs->sockdir)
+        rmdir(bs->sockdir);
+    VIR_FREE(bs->sockpath);
+    VIR_FREE(bs->sockdir);
+    VIR_FREE(bs->port);
+}
+
+
+static int
+testBenchServerStart(testBenchServerPtr bs,
+                     testBenchTransport transport)
+{
+    virNetServerServicePtr svc = NULL;
+    virNetTLSContextPtr tls = NULL;
+    int ret = -1;
+
+    if (transport == TEST_BENCH_TRANSPORT_TLS)
+        tls = bs->serverTLS;
+
+    if (!(bs->srv = virNetServerNew("bench", 1, 5, 20, 0, 1000, 1000,
+                                    -1, 0, testBenchClientPrivNew, NULL,
+                                    testBenchClientPrivFree, NULL)))
+        goto cleanup;
+
+    if (!(bs->prog = virNetServerProgramNew(TEST_BENCH_PROGRAM,
+                                            TEST_BENCH_VERSION,
+                                            testBenchProcs,
+                                            G_N_ELEMENTS(testBenchProcs))) ||
+        virNetServerAddProgram(bs->srv, bs->prog) < 0)
+        goto cleanup;
+
+    if (transport == TEST_BENCH_TRANSPORT_UNIX) {
+        if (!(bs->sockdir = g_dir_make_tmp("virnetbench-XXXXXX", NULL)))
+            goto cleanup;
+        bs->sockpath = g_strdup_printf("%s/sock", bs->sockdir);
+
+        svc = virNetServerServiceNewUNIX(bs->sockpath, 0077, 0, 0,
+                                         NULL, false, 100, 5);
+    } else {
+        svc = virNetServerServiceNewTCP("127.0.0.1", "0", AF_INET, 0,
+                                        tls, false, 100, 5);
+    }
+    if (!svc)
+        goto cleanup;
+
+    if (transport != TEST_BENCH_TRANSPORT_UNIX)
+        bs->port = g_strdup_printf("%d", virNetServerServiceGetPort(svc));
+
+    if (virNetServerAddService(bs->srv, svc) < 0)
+        goto cleanup;
+
+    if (!(bs->dmn = virNetDaemonNew()) ||
+        virNetDaemonAddServer(bs->dmn, bs->srv) < 0)
+        goto cleanup;
+
+    virNetServerUpdateServices(bs->srv, true);
+
+    if (virThreadCreate(&bs->thread, true, testBenchServerThread, bs) < 0) {
+        virObjectUnref(bs->dmn);
+        bs->dmn = NULL;
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(svc);
+    if (ret < 0)
+        testBenchServerStop(bs);
+    return ret;
+}
+
+
+typedef struct _testBenchClient testBenchClient;
+typedef testBenchClient *testBenchClientPtr;
+struct _testBenchClient {
+    virNetClientPtr client;
+    virNetClientProgramPtr prog;
+    unsigned int serial;
+
+    /* g_atomic access only */
+    int nevents;
+
+    char *payload;
+    size_t payloadLen;
+    size_t ncalls;
+    gint64 *latencies;
+    int ret;
+};
+
+
+static void
+testBenchClientEvent(virNetClientProgramPtr prog G_GNUC_UNUSED,
+                     virNetClientPtr client G_GNUC_UNUSED,
+                     void *msg G_GNUC_UNUSED,
+                     void *opaque)
+{
+    testBenchClientPtr bc = opaque;
+
+    g_atomic_int_inc(&bc->nevents);
+}
+
+
+static virNetClientProgramEvent testBenchEvents[] = {
+    { TEST_BENCH_PROC_EVENT, testBenchClientEvent,
+      sizeof(unsigned int), (xdrproc_t)xdr_u_int },
+};
+
+
+static void
+testBenchClientDisconnect(testBenchClientPtr bc)
+{
+    if (bc->client)
+        virNetClientClose(bc->client);
+    virObjectUnref(bc->client);
+    virObjectUnref(bc->prog);
+    bc->client = NULL;
+    bc->prog = NULL;
+    VIR_FREE(bc->latencies);
+}
+
+
+static int
+testBenchClientConnect(testBenchServerPtr bs,
+                       testBenchTransport transport,
+                       testBenchClientPtr bc)
+{
+    if (transport == TEST_BENCH_TRANSPORT_UNIX)
+        bc->client = virNetClientNewUNIX(bs->sockpath, false, NULL);
+    else
+        bc->client = virNetClientNewTCP("127.0.0.1", bs->port, AF_INET);
+    if (!bc->client)
+        return -1;
+
+    if (transport == TEST_BENCH_TRANSPORT_TLS &&
+        virNetClientSetTLSSession(bc->client, bs->clientTLS) < 0)
+        return -1;
+
+    if (!(bc->prog = virNetClientProgramNew(TEST_BENCH_PROGRAM,
+                                            TEST_BENCH_VERSION,
+                                            testBenchEvents,
+                                            G_N_ELEMENTS(testBenchEvents),
+                                            bc)) ||
+        virNetClientAddProgram(bc->client, bc->prog) < 0)
+        return -1;
+
+    /* Let events be dispatched while the client isn't making a call */
+    if (virNetClientRegisterAsyncIO(bc->client) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+testBenchClientCall(testBenchClientPtr bc,
+                    int proc,
+                    xdrproc_t args_filter, void *args,
+                    xdrproc_t ret_filter, void *ret)
+{
+    return virNetClientProgramCall(bc->prog, bc->client, bc->serial++, proc,
+                                   0, NULL, NULL, NULL,
+                                   args_filter, args, ret_filter, ret);
+}
+
+
+static int
+testBenchClientEcho(testBenchClientPtr bc)
+{
+    testBenchPayload args = { bc->payloadLen, bc->payload };
+    testBenchPayload ret = { 0, NULL };
+    int rv = 0;
+
+    if (testBenchClientCall(bc, TEST_BENCH_PROC_ECHO,
+                            (xdrproc_t)testBenchXdrPayload, &args,
+                            (xdrproc_t)testBenchXdrPayload, &ret) < 0)
+        return -1;
+
+    if (ret.len != bc->payloadLen) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "echo returned %u bytes instead of %zu",
+                       ret.len, bc->payloadLen);
+        rv = -1;
+    }
+
+    xdr_free((xdrproc_t)testBenchXdrPayload, (char *)&ret);
+    return rv;
+}
+
+
+static void
+testBenchClientThread(void *opaque)
+{
+    testBenchClientPtr bc = opaque;
+    size_t i;
+
+    for (i = 0; i < bc->ncalls; i++) {
+        gint64 start = g_get_monotonic_time();
+
+        if (testBenchClientEcho(bc) < 0) {
+            bc->ret = -1;
+            return;
+        }
+
+        bc->latencies[i] = g_get_monotonic_time() - start;
+    }
+}
+
+
+static int
+testBenchCompareLatency(const void *a, const void *b)
+{
+    gint64 la = *(const gint64 *)a;
+    gint64 lb = *(const gint64 *)b;
+
+    return (la > lb) - (la < lb);
+}
+
+
+static void
+testBenchReport(virJSONValuePtr *result)
+{
+    g_autofree char *line = NULL;
+    FILE *fp;
+
+    if (!benchConfig.results)
+        goto cleanup;
+
+    if (!(line = virJSONValueToString(*result, false)))
+        goto cleanup;
+
+    if (!(fp = fopen(benchConfig.results, "a"))) {
+        VIR_TEST_VERBOSE("\ncannot open '%s'", benchConfig.results);
+        goto cleanup;
+    }
+    fprintf(fp, "%s\n", line);
+    VIR_FORCE_FCLOSE(fp);
+
+ cleanup:
+    virJSONValueFree(*result);
+    *result = NULL;
+}
+
+
+struct testBenchInfo {
+    testBenchTransport transport;
+    size_t payloadLen;
+};
+
+
+static int
+testBenchCalls(const void *opaque)
+{
+    const struct testBenchInfo *info = opaque;
+    testBenchServerPtr bs = &benchServer;
+    g_autofree testBenchClientPtr clients = NULL;
+    g_autofree virThread *threads = NULL;
+    g_autofree gint64 *latencies = NULL;
+    g_autofree char *payload = NULL;
+    virJSONValuePtr result = NULL;
+    size_t nclients = benchConfig.clients;
+    size_t ncalls = benchConfig.calls;
+    size_t nthreads = 0;
+    size_t total;
+    gint64 start;
+    gint64 elapsed;
+    double rate;
+    size_t i;
+    int ret = -1;
+
+    /* Keep the amount of data moved by the bulk run reasonable */
+    if (info->payloadLen == TEST_BENCH_BULK_SIZE)
+        ncalls = MAX(ncalls / 10, 1);
+    total = nclients * ncalls;
+
+    if (testBenchServerStart(bs, info->transport) < 0)
+        return -1;
+
+    clients = g_new0(testBenchClient, nclients);
+    threads = g_new0(virThread, nclients);
+    latencies = g_new0(gint64, total);
+    payload = g_new0(char, info->payloadLen);
+
+    for (i = 0; i < nclients; i++) {
+        clients[i].payload = payload;
+        clients[i].payloadLen = info->payloadLen;
+        clients[i].ncalls = ncalls;
+        clients[i].latencies = g_new0(gint64, ncalls);
+
+        if (testBenchClientConnect(bs, info->transport, &clients[i]) < 0)
+            goto cleanup;
+    }
+
+    start = g_get_monotonic_time();
+    for (; nthreads < nclients; nthreads++) {
+        if (virThreadCreate(&threads[nthreads], true,
+                            testBenchClientThread, &clients[nthreads]) < 0)
+            goto cleanup;
+    }
+    for (; nthreads > 0; nthreads--)
+        virThreadJoin(&threads[nthreads - 1]);
+    elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+    for (i = 0; i < nclients; i++) {
+        if (clients[i].ret < 0)
+            goto cleanup;
+        memcpy(latencies + i * ncalls, clients[i].latencies,
+               ncalls * sizeof(gint64));
+    }
+    qsort(latencies, total, sizeof(gint64), testBenchCompareLatency);
+
+    rate = total * (double)G_USEC_PER_SEC / elapsed;
+    VIR_TEST_VERBOSE("\n%zu clients x %zu calls of %zu bytes: "
+                     "%.0f calls/s, %.2f MiB/s, p50 %lld us, p99 %lld us",
+                     nclients, ncalls, info->payloadLen, rate,
+                     rate * info->payloadLen * 2 / (1024 * 1024),
+                     (long long) latencies[total / 2],
+                     (long long) latencies[total * 99 / 100]);
+
+    if (virJSONValueObjectCreate(&result,
+                                 "s:transport", testBenchTransportTypeToString(info->transport),
+                                 "s:test", "calls",
+                                 "u:clients", benchConfig.clients,
+                                 "U:calls", (unsigned long long) ncalls,
+                                 "U:payload", (unsigned long long) info->payloadLen,
+                                 "d:calls_per_sec", rate,
+                                 "d:bytes_per_sec", rate * info->payloadLen * 2,
+                                 "I:p50_usec", (long long) latencies[total / 2],
+                                 "I:p99_usec", (long long) latencies[total * 99 / 100],
+                                 NULL) < 0)
+        goto cleanup;
+    testBenchReport(&result);
+
+    ret = 0;
+
+ cleanup:
+    for (; nthreads > 0; nthreads--)
+        virThreadJoin(&threads[nthreads - 1]);
+    for (i = 0; i < nclients; i++)
+        testBenchClientDisconnect(&clients[i]);
+    testBenchServerStop(bs);
+    return ret;
+}
+
+
+static int
+testBenchEventsRun(const void *opaque)
+{
+    const struct testBenchInfo *info = opaque;
+    testBenchServerPtr bs = &benchServer;
+    g_autofree testBenchClientPtr clients = NULL;
+    virJSONValuePtr result = NULL;
+    size_t nclients = benchConfig.clients;
+    unsigned int nevents = benchConfig.events;
+    gint64 start;
+    gint64 elapsed;
+    gint64 deadline;
+    size_t received;
+    double rate;
+    size_t i;
+    int ret = -1;
+
+    if (testBenchServerStart(bs, info->transport) < 0)
+        return -1;
+
+    clients = g_new0(testBenchClient, nclients);
+
+    for (i = 0; i < nclients; i++) {
+        if (testBenchClientConnect(bs, info->transport, &clients[i]) < 0 ||
+            testBenchClientCall(&clients[i], TEST_BENCH_PROC_SUBSCRIBE,
+                                (xdrproc_t)xdr_void, NULL,
+                                (xdrproc_t)xdr_void, NULL) < 0)
+            goto cleanup;
+    }
+
+    start = g_get_monotonic_time();
+    deadline = start + 60 * G_USEC_PER_SEC;
+
+    if (testBenchClientCall(&clients[0], TEST_BENCH_PROC_BROADCAST,
+                            (xdrproc_t)xdr_u_int, &nevents,
+                            (xdrproc_t)xdr_void, NULL) < 0)
+        goto cleanup;
+
+    do {
+        received = 0;
+        for (i = 0; i < nclients; i++)
+            received += g_atomic_int_get(&clients[i].nevents);
+        if (received >= nclients * nevents)
+            break;
+        g_usleep(100);
+    } while (g_get_monotonic_time() < deadline);
+    elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+    if (received < nclients * nevents) {
+        VIR_TEST_VERBOSE("\nreceived only %zu of %zu events",
+                         received, nclients * nevents);
+        goto cleanup;
+    }
+
+    rate = received * (double)G_USEC_PER_SEC / elapsed;
+    VIR_TEST_VERBOSE("\n%u events to %zu clients: %.0f events/s, "
+                     "all delivered in %lld us",
+                     nevents, nclients, rate, (long long) elapsed);
+
+    if (virJSONValueObjectCreate(&result,
+                                 "s:transport", testBenchTransportTypeToString(info->transport),
+                                 "s:test", "events",
+                                 "u:clients", benchConfig.clients,
+                                 "u:events", nevents,
+                                 "d:events_per_sec", rate,
+                                 "I:elapsed_usec", (long long) elapsed,
+                                 NULL) < 0)
+        goto cleanup;
+    testBenchReport(&result);
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < nclients; i++)
+        testBenchClientDisconnect(&clients[i]);
+    testBenchServerStop(bs);
+    return ret;
+}
+
+
+static int
+testBenchGetEnv(const char *name, unsigned int *value)
+{
+    const char *str = getenv(name);
+
+    if (!str)
+        return 0;
+
+    if (virStrToLong_ui(str, NULL, 10, value) < 0 || *value == 0) {
+        fprintf(stderr, "Invalid value '%s' of %s\n", str, name);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+# ifdef TEST_BENCH_TLS
+static struct testTLSCertReq cacertreq = {
+    NULL, "cacert-bench.pem",
+    "UK", "libvirt CA", NULL, NULL, NULL, NULL,
+    true, true, true,
+    true, true, GNUTLS_KEY_KEY_CERT_SIGN,
+    false, false, NULL, NULL,
+    0, 0,
+};
+static struct testTLSCertReq servercertreq = {
+    NULL, "servercert-bench.pem",
+    "UK", "127.0.0.1", NULL, NULL, "127.0.0.1", NULL,
+    true, true, false,
+    true, true, GNUTLS_KEY_DIGITAL_SIGNATURE | GNUTLS_KEY_KEY_ENCIPHERMENT,
+    true, true, GNUTLS_KP_TLS_WWW_SERVER, NULL,
+    0, 0,
+};
+static struct testTLSCertReq clientcertreq = {
+    NULL, "clientcert-bench.pem",
+    "UK", "libvirt", NULL, NULL, NULL, NULL,
+    true, true, false,
+    true, true, GNUTLS_KEY_DIGITAL_SIGNATURE | GNUTLS_KEY_KEY_ENCIPHERMENT,
+    true, true, GNUTLS_KP_TLS_WWW_CLIENT, NULL,
+    0, 0,
+};
+
+
+static int
+testBenchTLSInit(testBenchServerPtr bs)
+{
+    testTLSInit(KEYFILE);
+    testTLSGenerateCert(&cacertreq, NULL);
+    testTLSGenerateCert(&servercertreq, cacertreq.crt);
+    testTLSGenerateCert(&clientcertreq, cacertreq.crt);
+
+    bs->serverTLS = virNetTLSContextNewServer(cacertreq.filename, NULL,
+                                              servercertreq.filename, KEYFILE,
+                                              NULL, "NORMAL", true, true);
+    bs->clientTLS = virNetTLSContextNewClient(cacertreq.filename, NULL,
+                                              clientcertreq.filename, KEYFILE,
+                                              "NORMAL", true, true);
+    if (!bs->serverTLS || !bs->clientTLS)
+        return -1;
+
+    return 0;
+}
+
+
+static void
+testBenchTLSCleanup(testBenchServerPtr bs)
+{
+    virObjectUnref(bs->serverTLS);
+    virObjectUnref(bs->clientTLS);
+    testTLSDiscardCert(&clientcertreq);
+    testTLSDiscardCert(&servercertreq);
+    testTLSDiscardCert(&cacertreq);
+    testTLSCleanup(KEYFILE);
+}
+# endif /* TEST_BENCH_TLS */
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    size_t i;
+
+    if (virTestGetExpensive())
+        benchConfig.calls = 20000;
+
+    if (testBenchGetEnv("VIR_NET_BENCH_CLIENTS", &benchConfig.clients) < 0 ||
+        testBenchGetEnv("VIR_NET_BENCH_CALLS", &benchConfig.calls) < 0 ||
+        testBenchGetEnv("VIR_NET_BENCH_EVENTS", &benchConfig.events) < 0)
+        return EXIT_FAILURE;
+    benchConfig.results = getenv("VIR_NET_BENCH_RESULTS");
+
+    if (virMutexInit(&benchServer.lock) < 0)
+        return EXIT_FAILURE;
+
+    virEventRegisterDefaultImpl();
+
+# ifdef TEST_BENCH_TLS
+    if (testBenchTLSInit(&benchServer) < 0)
+        ret = -1;
+# endif
+
+    for (i = 0; i < TEST_BENCH_TRANSPORT_LAST && ret == 0; i++) {
+        const char *transport = testBenchTransportTypeToString(i);
+        struct testBenchInfo small = { i, 64 };
+        struct testBenchInfo bulk = { i, TEST_BENCH_BULK_SIZE };
+        g_autofree char *name = NULL;
+
+# ifndef TEST_BENCH_TLS
+        if (i == TEST_BENCH_TRANSPORT_TLS)
+            continue;
+# endif
+
+        name = g_strdup_printf("%s calls", transport);
+        if (virTestRun(name, testBenchCalls, &small) < 0)
+            ret = -1;
+        VIR_FREE(name);
+
+        name = g_strdup_printf("%s bulk", transport);
+        if (virTestRun(name, testBenchCalls, &bulk) < 0)
+            ret = -1;
+        VIR_FREE(name);
+
+        name = g_strdup_printf("%s events", transport);
+        if (virTestRun(name, testBenchEventsRun, &small) < 0)
+            ret = -1;
+    }
+
+# ifdef TEST_BENCH_TLS
+    testBenchTLSCleanup(&benchServer);
+# endif
+    virMutexDestroy(&benchServer.lock);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
+#else
+static int
+mymain(void)
+{
+    return EXIT_AM_SKIP;
+}
+VIR_TEST_MAIN(mymain);
+#endif
@@ -20,6 +20,25 @@
 #include <unistd.h>
 #include <sys/types.h>
 
+#include "virmock.h"
+#include "viralloc.h"
+#include "virfile.h"
+#include "virnetdev.h"
+#include "virnetlink.h"
+#include "virnetdevbandwidthtest.h"
+
+/* What a kernel with a nanosecond clock and high resolution timers
+ * reports, see virNetDevBandwidthOnceInit */
+#define PSCHED_PATH "/proc/net/psched"
+#define PSCHED_DATA "000003e8 00000040 000f4240 3b9aca00\n"
+
+static int (*real_virFileReadAll)(const char *path, int maxlen, char **buf);
+
+#ifdef HAVE_LIBNL
+static struct nlmsghdr **batchMsgs;
+static size_t nbatchMsgs;
+#endif
+
 uid_t geteuid(void)
 {
     return 0;
@@ -29,3 +48,70 @@ uid_t getuid(void)
 {
     return 0;
 }
+
+int
+virFileReadAll(const char *path, int maxlen, char **buf)
+{
+    VIR_MOCK_REAL_INIT(virFileReadAll);
+
+    if (STRNEQ(path, PSCHED_PATH))
+        return real_virFileReadAll(path, maxlen, buf);
+
+    *buf = g_strdup(PSCHED_DATA);
+    return strlen(*buf);
+}
+
+int
+virNetDevGetIndex(const char *ifname G_GNUC_UNUSED,
+                  int *ifindex)
+{
+    *ifindex = VIR_NETDEV_BANDWIDTH_MOCK_IFINDEX;
+    return 0;
+}
+
+int
+virNetlinkCommandBatch(struct nl_msg **msgs G_GNUC_UNUSED,
+                       size_t nmsgs G_GNUC_UNUSED,
+                       unsigned int protocol G_GNUC_UNUSED,
+                       int *errors G_GNUC_UNUSED)
+{
+#ifdef HAVE_LIBNL
+    size_t i;
+
+    virNetDevBandwidthMockFreeBatch(batchMsgs, nbatchMsgs);
+    batchMsgs = g_new0(struct nlmsghdr *, nmsgs);
+    nbatchMsgs = nmsgs;
+
+    for (i = 0; i < nmsgs; i++) {
+        struct nlmsghdr *hdr = nlmsg_hdr(msgs[i]);
+
+        batchMsgs[i] = g_memdup(hdr, hdr->nlmsg_len);
+    }
+#endif
+
+    /* Make QoS fall back to tc, which runs in dry run mode */
+    return -1;
+}
+
+#ifdef HAVE_LIBNL
+size_t
+virNetDevBandwidthMockStealBatch(struct nlmsghdr ***msgs)
+{
+    size_t ret = nbatchMsgs;
+
+    *msgs = g_steal_pointer(&batchMsgs);
+    nbatchMsgs = 0;
+    return ret;
+}
+
+void
+virNetDevBandwidthMockFreeBatch(struct nlmsghdr **msgs,
+                                size_t nmsgs)
+{
+    size_t i;
+
+    for (i = 0; i < nmsgs; i++)
+        g_free(msgs[i]);
+    g_free(msgs);
+}
+#endif
@@ -23,6 +23,16 @@
 #include "vircommandpriv.h"
 #include "virnetdevbandwidth.h"
 #include "netdev_bandwidth_conf.c"
+#include "virnetdevbandwidthtest.h"
+
+#ifdef HAVE_LIBNL
+# include <linux/pkt_cls.h>
+# include <linux/pkt_sched.h>
+# include <linux/rtnetlink.h>
+
+/* The attributes of the kinds of TCA_OPTIONS the tests look into */
+# define TEST_OPTIONS_MAX MAX(TCA_U32_MAX, MAX(TCA_HTB_MAX, TCA_FW_MAX))
+#endif
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -35,6 +45,7 @@ struct testMinimalStruct {
 struct testSetStruct {
     const char *band;
     const char *exp_cmd;
+    const char *exp_batch;
     const char *iface;
     const bool hierarchical_class;
 };
@@ -63,6 +74,185 @@ struct testSetStruct {
             goto cleanup; \
     } while (0)
 
+#ifdef HAVE_LIBNL
+static void
+testFormatHandle(virBufferPtr buf,
+                 const char *name,
+                 uint32_t handle)
+{
+    if (handle == TC_H_ROOT)
+        virBufferAsprintf(buf, " %s root", name);
+    else if (handle == TC_H_INGRESS)
+        virBufferAsprintf(buf, " %s ingress", name);
+    else
+        virBufferAsprintf(buf, " %s %x:%x", name,
+                          TC_H_MAJ(handle) >> 16, TC_H_MIN(handle));
+}
+
+
+static void
+testFormatRate(virBufferPtr buf,
+               const char *name,
+               const struct tc_ratespec *spec,
+               struct nlattr *tab)
+{
+    virBufferAsprintf(buf, " %s %u cell_log %u",
+                      name, spec->rate, spec->cell_log);
+
+    if (tab && nla_len(tab) == (int) (256 * sizeof(uint32_t)))
+        virBufferAsprintf(buf, " tab[255] %u",
+                          ((uint32_t *) nla_data(tab))[255]);
+    else
+        virBufferAddLit(buf, " tab missing");
+}
+
+
+static void
+testFormatOptions(virBufferPtr buf,
+                  int type,
+                  const char *kind,
+                  struct nlattr *options)
+{
+    struct nlattr *tb[TEST_OPTIONS_MAX + 1] = { NULL };
+    struct nlattr *police[TCA_POLICE_MAX + 1] = { NULL };
+
+    if (!options)
+        return;
+
+    if (STREQ(kind, "sfq")) {
+        const struct tc_sfq_qopt *opt = nla_data(options);
+
+        virBufferAsprintf(buf, " perturb %d", opt->perturb_period);
+        return;
+    }
+
+    if (nla_parse_nested(tb, TEST_OPTIONS_MAX, options, NULL) < 0) {
+        virBufferAddLit(buf, " options malformed");
+        return;
+    }
+
+    if (STREQ(kind, "htb") && type == RTM_NEWQDISC) {
+        const struct tc_htb_glob *glob;
+
+        if (!tb[TCA_HTB_INIT])
+            return;
+        glob = nla_data(tb[TCA_HTB_INIT]);
+        virBufferAsprintf(buf, " default %x r2q %u",
+                          glob->defcls, glob->rate2quantum);
+    } else if (STREQ(kind, "htb")) {
+        const struct tc_htb_opt *opt;
+
+        if (!tb[TCA_HTB_PARMS])
+            return;
+        opt = nla_data(tb[TCA_HTB_PARMS]);
+        testFormatRate(buf, "rate", &opt->rate, tb[TCA_HTB_RTAB]);
+        testFormatRate(buf, "ceil", &opt->ceil, tb[TCA_HTB_CTAB]);
+        virBufferAsprintf(buf, " buffer %u cbuffer %u quantum %u",
+                          opt->buffer, opt->cbuffer, opt->quantum);
+    } else if (STREQ(kind, "fw")) {
+        if (tb[TCA_FW_CLASSID])
+            testFormatHandle(buf, "classid", nla_get_u32(tb[TCA_FW_CLASSID]));
+    } else if (STREQ(kind, "u32")) {
+        if (tb[TCA_U32_POLICE] &&
+            nla_parse_nested(police, TCA_POLICE_MAX,
+                             tb[TCA_U32_POLICE], NULL) == 0 &&
+            police[TCA_POLICE_TBF]) {
+            const struct tc_police *pol = nla_data(police[TCA_POLICE_TBF]);
+
+            testFormatRate(buf, "police rate", &pol->rate,
+                           police[TCA_POLICE_RATE]);
+            virBufferAsprintf(buf, " burst %u mtu %u action %d",
+                              pol->burst, pol->mtu, pol->action);
+        }
+
+        if (tb[TCA_U32_CLASSID])
+            testFormatHandle(buf, "classid", nla_get_u32(tb[TCA_U32_CLASSID]));
+
+        if (tb[TCA_U32_SEL]) {
+            const struct tc_u32_sel *sel = nla_data(tb[TCA_U32_SEL]);
+            size_t i;
+
+            virBufferAddLit(buf, " match");
+            for (i = 0; i < sel->nkeys; i++)
+                virBufferAsprintf(buf, " %08x/%08x at %d",
+                                  ntohl(sel->keys[i].val),
+                                  ntohl(sel->keys[i].mask),
+                                  sel->keys[i].off);
+        }
+    }
+}
+
+
+/* Describes the netlink requests of the last batch somewhat like the tc
+ * commands they stand for */
+static char *
+testFormatBatch(void)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    struct nlmsghdr **msgs = NULL;
+    size_t nmsgs = virNetDevBandwidthMockStealBatch(&msgs);
+    size_t i;
+
+    for (i = 0; i < nmsgs; i++) {
+        struct nlattr *tb[TCA_MAX + 1] = { NULL };
+        const struct tcmsg *tcm = nlmsg_data(msgs[i]);
+        const char *kind = NULL;
+
+        switch (msgs[i]->nlmsg_type) {
+        case RTM_NEWQDISC:
+            virBufferAddLit(&buf, "qdisc add");
+            break;
+        case RTM_DELQDISC:
+            virBufferAddLit(&buf, "qdisc del");
+            break;
+        case RTM_NEWTCLASS:
+            if (msgs[i]->nlmsg_flags & NLM_F_CREATE)
+                virBufferAddLit(&buf, "class add");
+            else
+                virBufferAddLit(&buf, "class change");
+            break;
+        case RTM_NEWTFILTER:
+            virBufferAddLit(&buf, "filter add");
+            break;
+        case RTM_DELTFILTER:
+            virBufferAddLit(&buf, "filter del");
+            break;
+        default:
+            virBufferAsprintf(&buf, "type %u", msgs[i]->nlmsg_type);
+        }
+
+        if (tcm->tcm_ifindex != VIR_NETDEV_BANDWIDTH_MOCK_IFINDEX)
+            virBufferAsprintf(&buf, " dev %d", tcm->tcm_ifindex);
+
+        testFormatHandle(&buf, "parent", tcm->tcm_parent);
+        testFormatHandle(&buf, "handle", tcm->tcm_handle);
+
+        if (msgs[i]->nlmsg_type == RTM_NEWTFILTER ||
+            msgs[i]->nlmsg_type == RTM_DELTFILTER)
+            virBufferAsprintf(&buf, " prio %u protocol %04x",
+                              TC_H_MAJ(tcm->tcm_info) >> 16,
+                              ntohs(TC_H_MIN(tcm->tcm_info)));
+
+        if (nlmsg_parse(msgs[i], sizeof(*tcm), tb, TCA_MAX, NULL) < 0) {
+            virBufferAddLit(&buf, " malformed\n");
+            continue;
+        }
+
+        if (tb[TCA_KIND]) {
+            kind = nla_get_string(tb[TCA_KIND]);
+            virBufferAsprintf(&buf, " kind %s", kind);
+            testFormatOptions(&buf, msgs[i]->nlmsg_type, kind, tb[TCA_OPTIONS]);
+        }
+
+        virBufferAddLit(&buf, "\n");
+    }
+
+    virNetDevBandwidthMockFreeBatch(msgs, nmsgs);
+    return virBufferContentAndReset(&buf);
+}
+#endif /* HAVE_LIBNL */
+
+
 static int
 testVirNetDevBandwidthSet(const void *data)
 {
@@ -72,6 +262,7 @@ testVirNetDevBandwidthSet(const void *data)
     virNetDevBandwidthPtr band = NULL;
     virBuffer buf = VIR_BUFFER_INITIALIZER;
     char *actual_cmd = NULL;
+    g_autofree char *actual_batch = NULL;
 
     PARSE(info->band, band);
 
@@ -95,6 +286,17 @@ testVirNetDevBandwidthSet(const void *data)
         goto cleanup;
     }
 
+#ifdef HAVE_LIBNL
+    actual_batch = testFormatBatch();
+
+    if (STRNEQ_NULLABLE(info->exp_batch, actual_batch)) {
+        virTestDifference(stderr,
+                          NULLSTR(info->exp_batch),
+                          NULLSTR(actual_batch));
+        goto cleanup;
+    }
+#endif
+
     ret = 0;
  cleanup:
     virCommandSetDryRun(NULL, NULL, NULL);
@@ -109,10 +311,11 @@ mymain(void)
 {
     int ret = 0;
 
-#define DO_TEST_SET(Band, Exp_cmd, ...) \
+#define DO_TEST_SET(Band, Exp_cmd, Exp_batch, ...) \
     do { \
         struct testSetStruct data = {.band = Band, \
                                      .exp_cmd = Exp_cmd, \
+                                     .exp_batch = Exp_batch, \
                                      __VA_ARGS__}; \
         if (virTestRun("virNetDevBandwidthSet", \
                        testVirNetDevBandwidthSet, \
@@ -121,9 +324,9 @@ mymain(void)
     } while (0)
 
 
-    DO_TEST_SET(NULL, NULL);
+    DO_TEST_SET(NULL, NULL, NULL);
 
-    DO_TEST_SET("<bandwidth/>", NULL);
+    DO_TEST_SET("<bandwidth/>", NULL, NULL);
 
     DO_TEST_SET(("<bandwidth>"
                  "  <inbound average='1024'/>"
@@ -133,7 +336,17 @@ mymain(void)
                  TC " qdisc add dev eth0 root handle 1: htb default 1\n"
                  TC " class add dev eth0 parent 1: classid 1:1 htb rate 1024kbps quantum 87\n"
                  TC " qdisc add dev eth0 parent 1:1 handle 2: sfq perturb 10\n"
-                 TC " filter add dev eth0 parent 1:0 protocol all prio 1 handle 1 fw flowid 1\n"));
+                 TC " filter add dev eth0 parent 1:0 protocol all prio 1 handle 1 fw flowid 1\n"),
+                ("qdisc del parent root handle 0:0\n"
+                 "qdisc del parent ingress handle ffff:0 kind ingress\n"
+                 "qdisc add parent root handle 1:0 kind htb default 1 r2q 10\n"
+                 "class add parent 1:0 handle 1:1 kind htb "
+                 "rate 1024000 cell_log 3 tab[255] 31250 "
+                 "ceil 1024000 cell_log 3 tab[255] 31250 "
+                 "buffer 24414 cbuffer 24414 quantum 87\n"
+                 "qdisc add parent 1:1 handle 2:0 kind sfq perturb 10\n"
+                 "filter add parent 1:0 handle 0:1 prio 1 protocol 0003 "
+                 "kind fw classid 0:1\n"));
 
     DO_TEST_SET(("<bandwidth>"
                  "  <outbound average='1024'/>"
@@ -142,7 +355,14 @@ mymain(void)
                  TC " qdisc del dev eth0 ingress\n"
                  TC " qdisc add dev eth0 ingress\n"
                  TC " filter add dev eth0 parent ffff: protocol all u32 match u32 0 0 "
-                 "police rate 1024kbps burst 1024kb mtu 64kb drop flowid :1\n"));
+                 "police rate 1024kbps burst 1024kb mtu 64kb drop flowid :1\n"),
+                ("qdisc del parent root handle 0:0\n"
+                 "qdisc del parent ingress handle ffff:0 kind ingress\n"
+                 "qdisc add parent ingress handle ffff:0 kind ingress\n"
+                 "filter add parent ffff:0 handle 0:0 prio 0 protocol 0003 "
+                 "kind u32 police rate 1024000 cell_log 9 tab[255] 2000000 "
+                 "burst 16000000 mtu 65536 action 2 classid 0:1 "
+                 "match 00000000/00000000 at 0\n"));
 
     DO_TEST_SET(("<bandwidth>"
                  "  <inbound average='1' peak='2' floor='3' burst='4'/>"
@@ -156,9 +376,24 @@ mymain(void)
                  TC " filter add dev eth0 parent 1:0 protocol all prio 1 handle 1 fw flowid 1\n"
                  TC " qdisc add dev eth0 ingress\n"
                  TC " filter add dev eth0 parent ffff: protocol all u32 match u32 0 0 "
-                 "police rate 5kbps burst 7kb mtu 64kb drop flowid :1\n"));
+                 "police rate 5kbps burst 7kb mtu 64kb drop flowid :1\n"),
+                ("qdisc del parent root handle 0:0\n"
+                 "qdisc del parent ingress handle ffff:0 kind ingress\n"
+                 "qdisc add parent root handle 1:0 kind htb default 1 r2q 10\n"
+                 "class add parent 1:0 handle 1:1 kind htb "
+                 "rate 1000 cell_log 3 tab[255] 32000000 "
+                 "ceil 2000 cell_log 3 tab[255] 16000000 "
+                 "buffer 64000000 cbuffer 12500000 quantum 1\n"
+                 "qdisc add parent 1:1 handle 2:0 kind sfq perturb 10\n"
+                 "filter add parent 1:0 handle 0:1 prio 1 protocol 0003 "
+                 "kind fw classid 0:1\n"
+                 "qdisc add parent ingress handle ffff:0 kind ingress\n"
+                 "filter add parent ffff:0 handle 0:0 prio 0 protocol 0003 "
+                 "kind u32 police rate 5000 cell_log 9 tab[255] 409600000 "
+                 "burst 22400000 mtu 65536 action 2 classid 0:1 "
+                 "match 00000000/00000000 at 0\n"));
 
     return ret;
 }
 
-VIR_TEST_MAIN_PRELOAD(mymain, VIR_TEST_MOCK("virnetdevbandwidth"))
+VIR_TEST_MAIN(mymain)
@@ -0,0 +1,29 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#define VIR_NETDEV_BANDWIDTH_MOCK_IFINDEX 42
+
+#ifdef HAVE_LIBNL
+# include <netlink/msg.h>
+
+/* Hands over the requests of the last netlink batch */
+extern size_t virNetDevBandwidthMockStealBatch(struct nlmsghdr ***msgs);
+
+extern void virNetDevBandwidthMockFreeBatch(struct nlmsghdr **msgs,
+                                            size_t nmsgs);
+#endif
@@ -102,8 +102,7 @@ static int testMessageHeaderDecode(const void *args G_GNUC_UNUSED)
         return -1;
 
     msg->bufferLength = 4;
-    if (VIR_ALLOC_N(msg->buffer, msg->bufferLength) < 0)
-        goto cleanup;
+    virNetMessageReserve(msg, msg->bufferLength);
     memcpy(msg->buffer, input_buf, msg->bufferLength);
 
     msg->header.prog = 0x11223344;
@@ -333,8 +332,7 @@ static int testMessagePayloadDecode(const void *args G_GNUC_UNUSED)
         return -1;
 
     msg->bufferLength = 4;
-    if (VIR_ALLOC_N(msg->buffer, msg->bufferLength) < 0)
-        goto cleanup;
+    virNetMessageReserve(msg, msg->bufferLength);
     memcpy(msg->buffer, input_buffer, msg->bufferLength);
 
     if (virNetMessageDecodeLength(msg) < 0) {
@@ -453,8 +451,9 @@ static int testMessagePayloadDecode(const void *args G_GNUC_UNUSED)
     return ret;
 }
 
-static int testMessagePayloadStreamEncode(const void *args G_GNUC_UNUSED)
+static int testMessagePayloadStreamEncode(const void *args)
 {
+    bool inPlace = *(const bool *)args;
     char stream[] = "The quick brown fox jumps over the lazy dog";
     virNetMessagePtr msg = virNetMessageNew(true);
     static const char expect[] = {
@@ -493,8 +492,21 @@ static int testMessagePayloadStreamEncode(const void *args G_GNUC_UNUSED)
     if (virNetMessageEncodeHeader(msg) < 0)
         goto cleanup;
 
-    if (virNetMessageEncodePayloadRaw(msg, stream, strlen(stream)) < 0)
-        goto cleanup;
+    if (inPlace) {
+        char *payload;
+
+        /* Room for more than gets written */
+        if (!(payload = virNetMessagePayloadRawBuffer(msg, sizeof(stream) * 2)))
+            goto cleanup;
+
+        memcpy(payload, stream, strlen(stream));
+
+        if (virNetMessageEncodePayloadRawLen(msg, strlen(stream)) < 0)
+            goto cleanup;
+    } else {
+        if (virNetMessageEncodePayloadRaw(msg, stream, strlen(stream)) < 0)
+            goto cleanup;
+    }
 
     if (G_N_ELEMENTS(expect) != msg->bufferLength) {
         VIR_DEBUG("Expect message length %zu got %zu",
@@ -520,10 +532,212 @@ static int testMessagePayloadStreamEncode(const void *args G_GNUC_UNUSED)
 }
 
 
+static int
+testMessagePoolCheck(virNetMessagePoolPtr pool,
+                     const char *name,
+                     unsigned long long allocs,
+                     unsigned long long reuses,
+                     unsigned long long cached,
+                     unsigned long long cachedBytes)
+{
+    virNetMessagePoolStats stats;
+
+    virNetMessagePoolGetStats(pool, &stats);
+
+    if (stats.allocs != allocs ||
+        stats.reuses != reuses ||
+        stats.cached != cached ||
+        stats.cachedBytes != cachedBytes) {
+        VIR_TEST_DEBUG("Expected %s pool stats %llu/%llu/%llu/%llu, "
+                       "got %llu/%llu/%llu/%llu", name,
+                       allocs, reuses, cached, cachedBytes,
+                       stats.allocs, stats.reuses,
+                       stats.cached, stats.cachedBytes);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int testMessagePool(const void *args G_GNUC_UNUSED)
+{
+    virNetMessagePoolPtr parent = virNetMessagePoolNew(4);
+    virNetMessagePoolPtr pool = virNetMessagePoolNew(1);
+    virNetMessagePtr msg = NULL;
+    size_t reply = VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX;
+    size_t i;
+    int ret = -1;
+
+    if (!parent || !pool)
+        goto cleanup;
+
+    virNetMessagePoolSetParent(pool, parent);
+
+    /* The first message comes from the heap, the later ones
+     * reuse both its struct and its buffer */
+    for (i = 0; i < 3; i++) {
+        if (!(msg = virNetMessageNewPooled(pool, false)))
+            goto cleanup;
+
+        msg->header.prog = 0x11223344;
+        msg->header.vers = 0x01;
+        msg->header.proc = 0x666;
+        msg->header.type = VIR_NET_CALL;
+
+        if (virNetMessageEncodeHeader(msg) < 0)
+            goto cleanup;
+
+        if (msg->bufferSize != reply) {
+            VIR_TEST_DEBUG("Expected buffer size %zu got %zu",
+                           reply, msg->bufferSize);
+            goto cleanup;
+        }
+
+        g_clear_pointer(&msg, virNetMessageFree);
+    }
+
+    if (testMessagePoolCheck(pool, "client", 0, 4, 2,
+                             sizeof(virNetMessage) + reply) < 0 ||
+        testMessagePoolCheck(parent, "server", 2, 0, 0, 0) < 0)
+        goto cleanup;
+
+    /* Growing past the largest size class is not cached */
+    if (!(msg = virNetMessageNewPooled(pool, false)))
+        goto cleanup;
+    virNetMessageReserve(msg, VIR_NET_MESSAGE_MAX);
+    g_clear_pointer(&msg, virNetMessageFree);
+
+    if (testMessagePoolCheck(pool, "client", 1, 5, 2,
+                             sizeof(virNetMessage) + reply) < 0 ||
+        testMessagePoolCheck(parent, "server", 2, 0, 0, 0) < 0)
+        goto cleanup;
+
+    /* What is left goes to the parent together with the counters */
+    g_clear_pointer(&pool, virObjectUnref);
+
+    if (testMessagePoolCheck(parent, "server", 3, 5, 2,
+                             sizeof(virNetMessage) + reply) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virNetMessageFree(msg);
+    virObjectUnref(pool);
+    virObjectUnref(parent);
+    return ret;
+}
+
+
+static int testMessageCompress(const void *args G_GNUC_UNUSED)
+{
+    virNetMessagePtr msg = virNetMessageNew(true);
+    virNetMessagePtr rmsg = virNetMessageNew(true);
+    g_autofree char *xml = NULL;
+    g_autofree char *str = NULL;
+    char *small = (char *) "<domain/>";
+    size_t len;
+    int ret = -1;
+    int rc;
+
+    if (!msg || !rmsg)
+        goto cleanup;
+
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 0x01;
+    msg->header.proc = 0x666;
+    msg->header.type = VIR_NET_REPLY;
+    msg->header.serial = 0x99;
+    msg->header.status = VIR_NET_OK;
+
+    /* Small payloads are not worth it */
+    if (virNetMessageEncodeHeader(msg) < 0 ||
+        virNetMessageEncodePayload(msg, (xdrproc_t)xdr_virNetMessageNonnullString,
+                                   &small) < 0)
+        goto cleanup;
+
+    if ((rc = virNetMessageCompress(msg)) != 0) {
+        VIR_TEST_DEBUG("Expected small message to be left alone, got %d", rc);
+        goto cleanup;
+    }
+
+    xml = g_strnfill(256 * 1024, 'x');
+    memcpy(xml, "<domain>", 8);
+
+    virNetMessageClear(msg);
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 0x01;
+    msg->header.proc = 0x666;
+    msg->header.type = VIR_NET_REPLY;
+    msg->header.serial = 0x99;
+    msg->header.status = VIR_NET_OK;
+
+    if (virNetMessageEncodeHeader(msg) < 0 ||
+        virNetMessageEncodePayload(msg, (xdrproc_t)xdr_virNetMessageNonnullString,
+                                   &xml) < 0)
+        goto cleanup;
+
+    len = msg->bufferLength;
+    if ((rc = virNetMessageCompress(msg)) != 1) {
+        VIR_TEST_DEBUG("Expected message to be compressed, got %d", rc);
+        goto cleanup;
+    }
+
+    if (msg->bufferLength >= len / 10) {
+        VIR_TEST_DEBUG("Expected message to shrink from %zu, got %zu",
+                       len, msg->bufferLength);
+        goto cleanup;
+    }
+
+    /* Receive it the way the client or the server would */
+    rmsg->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
+    virNetMessageReserve(rmsg, rmsg->bufferLength);
+    memcpy(rmsg->buffer, msg->buffer, rmsg->bufferLength);
+
+    if (virNetMessageDecodeLength(rmsg) < 0)
+        goto cleanup;
+
+    if (rmsg->bufferLength != msg->bufferLength) {
+        VIR_TEST_DEBUG("Expected length %zu got %zu",
+                       msg->bufferLength, rmsg->bufferLength);
+        goto cleanup;
+    }
+
+    memcpy(rmsg->buffer, msg->buffer, rmsg->bufferLength);
+
+    if (virNetMessageDecodeHeader(rmsg) < 0)
+        goto cleanup;
+
+    if (rmsg->header.type != VIR_NET_REPLY ||
+        rmsg->header.serial != 0x99) {
+        VIR_TEST_DEBUG("Unexpected header type=%d serial=%u",
+                       rmsg->header.type, rmsg->header.serial);
+        goto cleanup;
+    }
+
+    if (virNetMessageDecodePayload(rmsg, (xdrproc_t)xdr_virNetMessageNonnullString,
+                                   &str) < 0)
+        goto cleanup;
+
+    if (STRNEQ(str, xml)) {
+        VIR_TEST_DEBUG("Payload does not match after decompression");
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virNetMessageFree(msg);
+    virNetMessageFree(rmsg);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
     int ret = 0;
+    bool copied = false;
+    bool inPlace = true;
 
 #ifndef WIN32
     signal(SIGPIPE, SIG_IGN);
@@ -541,7 +755,16 @@ mymain(void)
     if (virTestRun("Message Payload Decode", testMessagePayloadDecode, NULL) < 0)
         ret = -1;
 
-    if (virTestRun("Message Payload Stream Encode", testMessagePayloadStreamEncode, NULL) < 0)
+    if (virTestRun("Message Payload Stream Encode", testMessagePayloadStreamEncode, &copied) < 0)
+        ret = -1;
+
+    if (virTestRun("Message Payload Stream Encode In Place",
+                   testMessagePayloadStreamEncode, &inPlace) < 0)
+        ret = -1;
+
+    if (virTestRun("Message Pool", testMessagePool, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Message Compress", testMessageCompress, NULL) < 0)
         ret = -1;
 
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
@@ -441,6 +441,69 @@ static int testSocketCommandFail(const void *data G_GNUC_UNUSED)
     return ret;
 }
 
+static int testSocketWritev(const void *data G_GNUC_UNUSED)
+{
+    virNetSocketPtr ssock = NULL;
+    virNetSocketPtr csock = NULL;
+    const char *const parts[] = { "Hello", ", ", "", "vectored ", "world" };
+    const char *expect = "Hello, vectored world";
+    GOutputVector vec[G_N_ELEMENTS(parts)];
+    char buf[100] = { 0 };
+    size_t len = strlen(expect);
+    size_t got = 0;
+    size_t i;
+    int fds[2] = { -1, -1 };
+    int ret = -1;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        virReportSystemError(errno, "%s", "Cannot create socket pair");
+        goto cleanup;
+    }
+
+    if (virNetSocketNewConnectSockFD(fds[0], &ssock) < 0)
+        goto cleanup;
+    fds[0] = -1;
+
+    if (virNetSocketNewConnectSockFD(fds[1], &csock) < 0)
+        goto cleanup;
+    fds[1] = -1;
+
+    virNetSocketSetBlocking(ssock, true);
+    virNetSocketSetBlocking(csock, true);
+
+    for (i = 0; i < G_N_ELEMENTS(parts); i++) {
+        vec[i].buffer = parts[i];
+        vec[i].size = strlen(parts[i]);
+    }
+
+    if (virNetSocketWritev(ssock, vec, G_N_ELEMENTS(vec)) != len) {
+        VIR_TEST_DEBUG("Expected all parts to be written at once");
+        goto cleanup;
+    }
+
+    while (got < len) {
+        ssize_t rc = virNetSocketRead(csock, buf + got, sizeof(buf) - got - 1);
+
+        if (rc <= 0)
+            goto cleanup;
+        got += rc;
+    }
+
+    if (STRNEQ(buf, expect)) {
+        VIR_TEST_DEBUG("Expected '%s', got '%s'", expect, buf);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    VIR_FORCE_CLOSE(fds[0]);
+    VIR_FORCE_CLOSE(fds[1]);
+    virObjectUnref(ssock);
+    virObjectUnref(csock);
+    return ret;
+}
+
 struct testSSHData {
     const char *nodename;
     const char *service;
@@ -567,6 +630,9 @@ mymain(void)
     if (virTestRun("Socket External Command /dev/does-not-exist", testSocketCommandFail, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Socket Writev", testSocketWritev, NULL) < 0)
+        ret = -1;
+
     struct testSSHData sshData1 = {
         .nodename = "somehost",
         .path = "/tmp/socket",
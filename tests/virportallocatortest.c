@@ -159,6 +159,51 @@ static int testAllocReuse(const void *args G_GNUC_UNUSED)
 }
 
 
+static int testAllocMany(const void *args G_GNUC_UNUSED)
+{
+    virPortAllocatorRangePtr ports = virPortAllocatorRangeNew("test", 5900, 6100);
+    unsigned short acquired[201] = { 0 };
+    unsigned short expected = 5900;
+    unsigned short extra = 0;
+    size_t nacquired = 0;
+    size_t i;
+    int ret = -1;
+
+    if (!ports)
+        return -1;
+
+    /* The range spans several words of the bitmap, check no port is
+     * skipped while looking for the next free one */
+    for (i = 0; i < 6100 - 5900 + 1 - 4; i++) {
+        do {
+            expected++;
+        } while (expected >= 5904 && expected <= 5906);
+
+        if (virPortAllocatorAcquire(ports, &acquired[nacquired]) < 0)
+            goto cleanup;
+        if (acquired[nacquired++] != expected) {
+            VIR_TEST_DEBUG("Expected %d, got %d", expected,
+                           acquired[nacquired - 1]);
+            goto cleanup;
+        }
+    }
+
+    if (virPortAllocatorAcquire(ports, &extra) == 0) {
+        VIR_TEST_DEBUG("Expected error, got %d", extra);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    for (i = 0; i < nacquired; i++)
+        virPortAllocatorRelease(acquired[i]);
+    virPortAllocatorRelease(extra);
+
+    virPortAllocatorRangeFree(ports);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -170,6 +215,9 @@ mymain(void)
     if (virTestRun("Test alloc reuse", testAllocReuse, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Test alloc many", testAllocMany, NULL) < 0)
+        ret = -1;
+
     g_setenv("LIBVIRT_TEST_IPV4ONLY", "really", TRUE);
 
     if (virTestRun("Test IPv4-only alloc all", testAllocAll, NULL) < 0)
@@ -178,6 +226,9 @@ mymain(void)
     if (virTestRun("Test IPv4-only alloc reuse", testAllocReuse, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Test IPv4-only alloc many", testAllocMany, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -470,6 +470,52 @@ static int testRotatingFileWriterRolloverMany(const void *data G_GNUC_UNUSED)
 }
 
 
+static int testRotatingFileWriterRolloverCompressed(const void *data G_GNUC_UNUSED)
+{
+    virRotatingFileWriterPtr file;
+    int ret = -1;
+    char buf[512];
+
+    if (testRotatingFileInitFiles((off_t)-1,
+                                  (off_t)-1,
+                                  (off_t)-1) < 0 ||
+        testRotatingFileInitOne(FILENAME0 ".zst", 100, FILEBYTE0) < 0)
+        return -1;
+
+    file = virRotatingFileWriterNew(FILENAME,
+                                    1024,
+                                    2,
+                                    false,
+                                    0700);
+    if (!file)
+        goto cleanup;
+
+    memset(buf, 0x5e, sizeof(buf));
+
+    virRotatingFileWriterAppend(file, buf, sizeof(buf));
+    virRotatingFileWriterAppend(file, buf, sizeof(buf));
+    virRotatingFileWriterAppend(file, buf, sizeof(buf));
+
+    /* The compressed backup must be rotated along */
+    if (testRotatingFileWriterAssertFileSizes(512,
+                                              1024,
+                                              (off_t)-1) < 0 ||
+        testRotatingFileWriterAssertOneFileSize(FILENAME0 ".zst", (off_t)-1) < 0 ||
+        testRotatingFileWriterAssertOneFileSize(FILENAME1 ".zst", 100) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virRotatingFileWriterFree(file);
+    unlink(FILENAME);
+    unlink(FILENAME0);
+    unlink(FILENAME1);
+    unlink(FILENAME0 ".zst");
+    unlink(FILENAME1 ".zst");
+    return ret;
+}
+
+
 static int testRotatingFileWriterRolloverLineBreak(const void *data G_GNUC_UNUSED)
 {
     virRotatingFileWriterPtr file;
@@ -717,6 +763,9 @@ mymain(void)
     if (virTestRun("Rotating file write rollover many", testRotatingFileWriterRolloverMany, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Rotating file write rollover compressed", testRotatingFileWriterRolloverCompressed, NULL) < 0)
+        ret = -1;
+
     if (virTestRun("Rotating file write rollover line break", testRotatingFileWriterRolloverLineBreak, NULL) < 0)
         ret = -1;
 
@@ -569,6 +569,40 @@ testVirStringListFreeCount(const void *opaque G_GNUC_UNUSED)
 }
 
 
+static int
+testStringIntern(const void *opaque G_GNUC_UNUSED)
+{
+    g_autofree char *copy = g_strdup("qemu");
+    const char *a = virStringIntern("qemu");
+    const char *b = virStringIntern(copy);
+    const char *c = virStringIntern("kvm");
+    int ret = -1;
+
+    if (a != b) {
+        fprintf(stderr, "equal strings were not shared\n");
+        goto cleanup;
+    }
+
+    if (a == c || STRNEQ(a, "qemu") || STRNEQ(c, "kvm")) {
+        fprintf(stderr, "different strings were mixed up\n");
+        goto cleanup;
+    }
+
+    if (virStringIntern(NULL) != NULL) {
+        fprintf(stderr, "interning NULL did not return NULL\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virStringInternRelease(a);
+    virStringInternRelease(b);
+    virStringInternRelease(c);
+    return ret;
+}
+
+
 struct testStripData {
     const char *string;
     const char *result;
@@ -926,6 +960,9 @@ mymain(void)
                    NULL) < 0)
         ret = -1;
 
+    if (virTestRun("virStringIntern", testStringIntern, NULL) < 0)
+        ret = -1;
+
 #define TEST_STRIP_IPV6_BRACKETS(str, res) \
     do { \
         struct testStripData stripData = { \
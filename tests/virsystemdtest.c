@@ -160,6 +160,29 @@ VIR_MOCK_WRAP_RET_ARGS(dbus_connection_send_with_reply_and_block,
 }
 
 
+VIR_MOCK_WRAP_RET_ARGS(dbus_connection_send_with_reply,
+                       dbus_bool_t,
+                       DBusConnection *, connection,
+                       DBusMessage *, message,
+                       DBusPendingCall **, pending_return,
+                       int, timeout_milliseconds)
+{
+    const char *service = dbus_message_get_destination(message);
+    const char *member = dbus_message_get_member(message);
+
+    VIR_MOCK_REAL_INIT(dbus_connection_send_with_reply);
+
+    /* only the calls not waiting for a reply end up here */
+    if (STRNEQ(service, "org.freedesktop.machine1") ||
+        STRNEQ(member, "TerminateMachine"))
+        return FALSE;
+
+    /* as if the connection was closed, there's no reply to wait for */
+    *pending_return = NULL;
+    return TRUE;
+}
+
+
 static int testCreateContainer(const void *opaque G_GNUC_UNUSED)
 {
     unsigned char uuid[VIR_UUID_BUFLEN] = {
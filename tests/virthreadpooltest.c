@@ -0,0 +1,550 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virthread.h"
+#include "virthreadpool.h"
+#include "virtime.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+/* Long enough not to fail on a loaded machine, the jobs take no time */
+#define TEST_TIMEOUT_MS (30 * 1000)
+
+#define TEST_SUBMITTERS 4
+#define TEST_JOBS_PER_SUBMITTER 2500
+
+typedef struct _testPoolData testPoolData;
+typedef testPoolData *testPoolDataPtr;
+struct _testPoolData {
+    virMutex lock;
+    virCond cond;
+    size_t ndone;
+
+    int *runs;          /* how many times each job ran, atomic */
+    size_t njobs;
+
+    int *blocker;       /* job waiting for @nblocked other jobs to run */
+    size_t nblocked;
+    bool blocking;      /* @blocker started */
+    bool unblocked;     /* the other jobs ran while @blocker waited */
+};
+
+typedef struct _testSubmitData testSubmitData;
+typedef testSubmitData *testSubmitDataPtr;
+struct _testSubmitData {
+    virThreadPoolPtr pool;
+    testPoolDataPtr data;
+    size_t first;
+    size_t count;
+    int rc;
+};
+
+typedef struct _testFreeData testFreeData;
+typedef testFreeData *testFreeDataPtr;
+struct _testFreeData {
+    virThreadPoolPtr pool;
+    virMutex lock;
+    virCond cond;
+    bool done;
+};
+
+typedef struct _testPoolInfo testPoolInfo;
+typedef testPoolInfo *testPoolInfoPtr;
+struct _testPoolInfo {
+    size_t minWorkers;
+    size_t maxWorkers;
+};
+
+
+static int
+testPoolDataInit(testPoolDataPtr data,
+                 size_t njobs)
+{
+    memset(data, 0, sizeof(*data));
+
+    if (virMutexInit(&data->lock) < 0)
+        return -1;
+
+    if (virCondInit(&data->cond) < 0) {
+        virMutexDestroy(&data->lock);
+        return -1;
+    }
+
+    data->runs = g_new0(int, njobs);
+    data->njobs = njobs;
+
+    return 0;
+}
+
+
+static void
+testPoolDataClear(testPoolDataPtr data)
+{
+    VIR_FREE(data->runs);
+    ignore_value(virCondDestroy(&data->cond));
+    virMutexDestroy(&data->lock);
+}
+
+
+/* Waits for @cond until @done says so, with @lock held. Returns -1 on
+ * timeout. */
+static int
+testWaitFor(virMutexPtr lock,
+            virCondPtr cond,
+            bool (*done)(void *opaque),
+            void *opaque)
+{
+    unsigned long long deadline;
+
+    if (virTimeMillisNow(&deadline) < 0)
+        return -1;
+    deadline += TEST_TIMEOUT_MS;
+
+    while (!done(opaque)) {
+        if (virCondWaitUntil(cond, lock, deadline) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+static bool
+testJobsDone(void *opaque)
+{
+    testPoolDataPtr data = opaque;
+
+    return data->ndone >= data->njobs;
+}
+
+
+static bool
+testBlockedJobsDone(void *opaque)
+{
+    testPoolDataPtr data = opaque;
+
+    return data->ndone >= data->nblocked;
+}
+
+
+static bool
+testBlockerStarted(void *opaque)
+{
+    testPoolDataPtr data = opaque;
+
+    return data->blocking;
+}
+
+
+static void
+testJobFunc(void *jobdata,
+            void *opaque)
+{
+    testPoolDataPtr data = opaque;
+    int *runs = jobdata;
+
+    virMutexLock(&data->lock);
+
+    if (runs == data->blocker) {
+        data->blocking = true;
+        virCondBroadcast(&data->cond);
+
+        /* Only another worker can run the jobs queued meanwhile,
+         * including those queued for this one */
+        data->unblocked = testWaitFor(&data->lock, &data->cond,
+                                      testBlockedJobsDone, data) == 0;
+    }
+
+    g_atomic_int_inc(runs);
+    data->ndone++;
+    virCondBroadcast(&data->cond);
+
+    virMutexUnlock(&data->lock);
+}
+
+
+static void
+testSubmitWorker(void *opaque)
+{
+    testSubmitDataPtr sub = opaque;
+    size_t i;
+
+    for (i = sub->first; i < sub->first + sub->count; i++) {
+        if (virThreadPoolSendJob(sub->pool, 0, &sub->data->runs[i]) < 0) {
+            sub->rc = -1;
+            return;
+        }
+    }
+}
+
+
+static int
+testCheckRuns(testPoolDataPtr data,
+              size_t njobs)
+{
+    size_t i;
+
+    for (i = 0; i < njobs; i++) {
+        int runs = g_atomic_int_get(&data->runs[i]);
+
+        if (runs != 1) {
+            VIR_TEST_DEBUG("job %zu ran %d times", i, runs);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static void
+testFreeWorker(void *opaque)
+{
+    testFreeDataPtr fd = opaque;
+
+    virThreadPoolFree(fd->pool);
+
+    virMutexLock(&fd->lock);
+    fd->done = true;
+    virCondBroadcast(&fd->cond);
+    virMutexUnlock(&fd->lock);
+}
+
+
+static bool
+testFreeDone(void *opaque)
+{
+    testFreeDataPtr fd = opaque;
+
+    return fd->done;
+}
+
+
+/* Frees @pool, failing rather than hanging if that doesn't return. The
+ * freeing thread is leaked in that case, together with everything the
+ * pool's jobs might still touch. */
+static int
+testPoolFree(virThreadPoolPtr pool)
+{
+    testFreeDataPtr fd = g_new0(testFreeData, 1);
+    virThread thread;
+    int rc;
+
+    fd->pool = pool;
+    if (virMutexInit(&fd->lock) < 0) {
+        g_free(fd);
+        virThreadPoolFree(pool);
+        return -1;
+    }
+
+    if (virCondInit(&fd->cond) < 0) {
+        virMutexDestroy(&fd->lock);
+        g_free(fd);
+        virThreadPoolFree(pool);
+        return -1;
+    }
+
+    if (virThreadCreateFull(&thread, true, testFreeWorker,
+                            "test-pool-free", false, fd) < 0) {
+        ignore_value(virCondDestroy(&fd->cond));
+        virMutexDestroy(&fd->lock);
+        g_free(fd);
+        virThreadPoolFree(pool);
+        return -1;
+    }
+
+    virMutexLock(&fd->lock);
+    rc = testWaitFor(&fd->lock, &fd->cond, testFreeDone, fd);
+    virMutexUnlock(&fd->lock);
+
+    if (rc < 0) {
+        VIR_TEST_DEBUG("virThreadPoolFree didn't return");
+        return -1;
+    }
+
+    virThreadJoin(&thread);
+    ignore_value(virCondDestroy(&fd->cond));
+    virMutexDestroy(&fd->lock);
+    g_free(fd);
+    return 0;
+}
+
+
+static virThreadPoolPtr
+testPoolNew(const testPoolInfo *info,
+            testPoolDataPtr data)
+{
+    return virThreadPoolNewFull(info->minWorkers, info->maxWorkers, 0,
+                                testJobFunc, "test-pool", data,
+                                VIR_THREAD_POOL_WORK_STEALING);
+}
+
+
+/* Several threads submit jobs at once, which all have to run once */
+static int
+testStealingSubmit(const void *opaque)
+{
+    const testPoolInfo *info = opaque;
+    size_t njobs = TEST_SUBMITTERS * TEST_JOBS_PER_SUBMITTER;
+    testSubmitData subs[TEST_SUBMITTERS];
+    virThread threads[TEST_SUBMITTERS];
+    size_t nthreads = 0;
+    testPoolData data;
+    virThreadPoolPtr pool = NULL;
+    int ret = -1;
+    int rc;
+    size_t i;
+
+    if (testPoolDataInit(&data, njobs) < 0)
+        return -1;
+
+    if (!(pool = testPoolNew(info, &data)))
+        goto cleanup;
+
+    for (i = 0; i < TEST_SUBMITTERS; i++) {
+        subs[i].pool = pool;
+        subs[i].data = &data;
+        subs[i].first = i * TEST_JOBS_PER_SUBMITTER;
+        subs[i].count = TEST_JOBS_PER_SUBMITTER;
+        subs[i].rc = 0;
+
+        if (virThreadCreateFull(&threads[i], true, testSubmitWorker,
+                                "test-submit", false, &subs[i]) < 0)
+            break;
+        nthreads++;
+    }
+
+    for (i = 0; i < nthreads; i++)
+        virThreadJoin(&threads[i]);
+
+    if (nthreads < TEST_SUBMITTERS) {
+        VIR_TEST_DEBUG("unable to create submitter threads");
+        goto cleanup;
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        if (subs[i].rc < 0) {
+            VIR_TEST_DEBUG("submitting jobs failed");
+            goto cleanup;
+        }
+    }
+
+    virMutexLock(&data.lock);
+    rc = testWaitFor(&data.lock, &data.cond, testJobsDone, &data);
+    virMutexUnlock(&data.lock);
+
+    if (rc < 0) {
+        VIR_TEST_DEBUG("only %zu of %zu jobs ran", data.ndone, njobs);
+        goto cleanup;
+    }
+
+    if (testCheckRuns(&data, njobs) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    if (pool && testPoolFree(g_steal_pointer(&pool)) < 0)
+        return -1;
+    testPoolDataClear(&data);
+    return ret;
+}
+
+
+/* Jobs are submitted one at a time, each after the previous one ran,
+ * so the workers go to sleep in between and a submitter has to wake
+ * one of them up every time */
+static int
+testStealingWakeup(const void *opaque)
+{
+    const testPoolInfo *info = opaque;
+    size_t njobs = 1000;
+    testPoolData data;
+    virThreadPoolPtr pool = NULL;
+    int ret = -1;
+    int rc;
+    size_t i;
+
+    if (testPoolDataInit(&data, njobs) < 0)
+        return -1;
+
+    if (!(pool = testPoolNew(info, &data)))
+        goto cleanup;
+
+    for (i = 0; i < njobs; i++) {
+        if (virThreadPoolSendJob(pool, 0, &data.runs[i]) < 0)
+            goto cleanup;
+
+        virMutexLock(&data.lock);
+        data.njobs = i + 1;
+        rc = testWaitFor(&data.lock, &data.cond, testJobsDone, &data);
+        virMutexUnlock(&data.lock);
+
+        if (rc < 0) {
+            VIR_TEST_DEBUG("job %zu was never picked up", i);
+            goto cleanup;
+        }
+    }
+
+    if (testCheckRuns(&data, njobs) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    if (pool && testPoolFree(g_steal_pointer(&pool)) < 0)
+        return -1;
+    testPoolDataClear(&data);
+    return ret;
+}
+
+
+/* While one worker is stuck in a job, the ones queued for it have to
+ * be stolen by the other one */
+static int
+testStealingSteal(const void *opaque G_GNUC_UNUSED)
+{
+    testPoolInfo info = { 2, 2 };
+    size_t nblocked = 64;
+    testPoolData data;
+    virThreadPoolPtr pool = NULL;
+    int ret = -1;
+    int rc;
+    size_t i;
+
+    if (testPoolDataInit(&data, nblocked + 1) < 0)
+        return -1;
+
+    data.blocker = &data.runs[nblocked];
+    data.nblocked = nblocked;
+
+    if (!(pool = testPoolNew(&info, &data)))
+        goto cleanup;
+
+    if (virThreadPoolSendJob(pool, 0, data.blocker) < 0)
+        goto cleanup;
+
+    virMutexLock(&data.lock);
+    rc = testWaitFor(&data.lock, &data.cond, testBlockerStarted, &data);
+    virMutexUnlock(&data.lock);
+
+    if (rc < 0) {
+        VIR_TEST_DEBUG("the blocking job never started");
+        goto cleanup;
+    }
+
+    /* Spread over both deques, so half of them are queued for the
+     * worker which is blocked */
+    for (i = 0; i < nblocked; i++) {
+        if (virThreadPoolSendJob(pool, 0, &data.runs[i]) < 0)
+            goto cleanup;
+    }
+
+    virMutexLock(&data.lock);
+    rc = testWaitFor(&data.lock, &data.cond, testJobsDone, &data);
+    virMutexUnlock(&data.lock);
+
+    if (rc < 0 || !data.unblocked) {
+        VIR_TEST_DEBUG("jobs queued for the blocked worker weren't stolen");
+        goto cleanup;
+    }
+
+    if (testCheckRuns(&data, nblocked + 1) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    if (pool && testPoolFree(g_steal_pointer(&pool)) < 0)
+        return -1;
+    testPoolDataClear(&data);
+    return ret;
+}
+
+
+/* Freeing the pool with jobs still queued drops them, but none may run
+ * more than once and the workers have to quit */
+static int
+testStealingFree(const void *opaque)
+{
+    const testPoolInfo *info = opaque;
+    size_t njobs = 10000;
+    testPoolData data;
+    virThreadPoolPtr pool = NULL;
+    int ret = -1;
+    size_t i;
+
+    if (testPoolDataInit(&data, njobs) < 0)
+        return -1;
+
+    if (!(pool = testPoolNew(info, &data)))
+        goto cleanup;
+
+    for (i = 0; i < njobs; i++) {
+        if (virThreadPoolSendJob(pool, 0, &data.runs[i]) < 0)
+            goto cleanup;
+    }
+
+    if (testPoolFree(g_steal_pointer(&pool)) < 0)
+        return -1;
+
+    for (i = 0; i < njobs; i++) {
+        if (g_atomic_int_get(&data.runs[i]) > 1) {
+            VIR_TEST_DEBUG("job %zu ran more than once", i);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    if (pool && testPoolFree(g_steal_pointer(&pool)) < 0)
+        return -1;
+    testPoolDataClear(&data);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+#define DO_TEST(name, func, min, max) \
+    do { \
+        testPoolInfo info = { min, max }; \
+        if (virTestRun(name " min=" #min " max=" #max, func, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST("stealing submit", testStealingSubmit, 0, 4);
+    DO_TEST("stealing submit", testStealingSubmit, 4, 4);
+    DO_TEST("stealing submit", testStealingSubmit, 1, 1);
+    DO_TEST("stealing wakeup", testStealingWakeup, 0, 2);
+    DO_TEST("stealing wakeup", testStealingWakeup, 2, 2);
+    DO_TEST("stealing free", testStealingFree, 0, 4);
+    DO_TEST("stealing free", testStealingFree, 4, 4);
+
+    if (virTestRun("stealing steal", testStealingSteal, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
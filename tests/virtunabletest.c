@@ -0,0 +1,185 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virtunable.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+
+static int
+testCounterGet(void *opaque,
+               virTypedParamListPtr list)
+{
+    unsigned int *counter = opaque;
+
+    return virTypedParamListAddPrefixedUInt(list, *counter, "counter");
+}
+
+
+static int
+testCounterSet(void *opaque,
+               virTypedParameterPtr params,
+               int nparams)
+{
+    unsigned int *counter = opaque;
+
+    if (virTypedParamsValidate(params, nparams,
+                               "counter", VIR_TYPED_PARAM_UINT,
+                               NULL) < 0)
+        return -1;
+
+    return virTypedParamsGetUInt(params, nparams, "counter", counter) < 0 ? -1 : 0;
+}
+
+
+static void
+testPoolFunc(void *jobdata G_GNUC_UNUSED,
+             void *opaque G_GNUC_UNUSED)
+{
+}
+
+
+static int
+testGetUInt(const char *field,
+            unsigned int expect)
+{
+    g_autoptr(virTypedParamList) list = g_new0(virTypedParamList, 1);
+    unsigned int value;
+
+    if (virTunableGetAll(list) < 0)
+        return -1;
+
+    if (virTypedParamsGetUInt(list->par, list->npar, field, &value) != 1) {
+        VIR_TEST_VERBOSE("\nparameter '%s' not found", field);
+        return -1;
+    }
+
+    if (value != expect) {
+        VIR_TEST_VERBOSE("\nparameter '%s': expected %u, got %u",
+                         field, expect, value);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testRegistry(const void *opaque G_GNUC_UNUSED)
+{
+    unsigned int counter = 3;
+    unsigned int readonly = 5;
+    virTypedParameter param = { .field = "counter",
+                                .type = VIR_TYPED_PARAM_UINT,
+                                .value.ui = 7 };
+    int ret = -1;
+
+    if (virTunableRegister("test.counter", testCounterGet,
+                           testCounterSet, &counter) < 0 ||
+        virTunableRegister("test.readonly", testCounterGet,
+                           NULL, &readonly) < 0)
+        goto cleanup;
+
+    if (virTunableRegister("test.counter", testCounterGet,
+                           NULL, &counter) == 0) {
+        VIR_TEST_VERBOSE("\nduplicate registration succeeded");
+        goto cleanup;
+    }
+
+    if (testGetUInt("test.counter.counter", 3) < 0 ||
+        testGetUInt("test.readonly.counter", 5) < 0)
+        goto cleanup;
+
+    if (virTunableSet("test.counter", &param, 1) < 0 ||
+        counter != 7 ||
+        testGetUInt("test.counter.counter", 7) < 0)
+        goto cleanup;
+
+    if (virTunableSet("test.readonly", &param, 1) == 0 ||
+        virTunableSet("test.missing", &param, 1) == 0) {
+        VIR_TEST_VERBOSE("\nsetting a read-only or missing tunable succeeded");
+        goto cleanup;
+    }
+
+    virTunableUnregister("test.readonly");
+
+    if (virTunableSet("test.readonly", &param, 1) == 0 ||
+        testGetUInt("test.readonly.counter", 5) == 0) {
+        VIR_TEST_VERBOSE("\nunregistered tunable still present");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virTunableUnregister("test.counter");
+    virTunableUnregister("test.readonly");
+    virResetLastError();
+    return ret;
+}
+
+
+static int
+testThreadPool(const void *opaque G_GNUC_UNUSED)
+{
+    virThreadPoolPtr pool = NULL;
+    virTypedParameter param = { .field = "maxWorkers",
+                                .type = VIR_TYPED_PARAM_UINT,
+                                .value.ui = 4 };
+    int ret = -1;
+
+    if (!(pool = virThreadPoolNewFull(0, 2, 0, testPoolFunc,
+                                      "test-pool", NULL, 0)))
+        return -1;
+
+    if (virTunableRegisterThreadPool("test.pool", pool) < 0)
+        goto cleanup;
+
+    if (testGetUInt("test.pool.maxWorkers", 2) < 0 ||
+        testGetUInt("test.pool.jobQueueDepth", 0) < 0)
+        goto cleanup;
+
+    if (virTunableSet("test.pool", &param, 1) < 0 ||
+        virThreadPoolGetMaxWorkers(pool) != 4 ||
+        testGetUInt("test.pool.maxWorkers", 4) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virTunableUnregister("test.pool");
+    virThreadPoolFree(pool);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virTestRun("registry", testRegistry, NULL) < 0)
+        ret = -1;
+    if (virTestRun("thread pool", testThreadPool, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -0,0 +1,228 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "internal.h"
+#include "virtypedparam.h"
+#include "testutils.h"
+#include "testutilsalloc.h"
+#include "virlog.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("tests.typedparambench");
+
+/*
+ * Builds the "block" and "vcpu" stats of a domain the way the bulk stats
+ * code of the qemu driver does, once formatting every name and once with
+ * a reserved list and per-record name prefixes, and reports the time and
+ * number of allocations of both. VIR_TEST_EXPENSIVE=1 adds larger domains.
+ */
+static unsigned int benchIterations = 1000;
+
+static const char *blockNames[] = {
+    "rd.reqs", "rd.bytes", "rd.times", "wr.reqs", "wr.bytes", "wr.times",
+    "fl.reqs", "fl.times", "allocation", "capacity", "physical", "threshold",
+};
+
+struct testBenchInfo {
+    size_t ndisks;
+    size_t nvcpus;
+};
+
+
+static int
+testBenchPrintf(const struct testBenchInfo *info,
+                virTypedParamListPtr list)
+{
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < info->ndisks; i++) {
+        if (virTypedParamListAddString(list, "vda", "block.%zu.name", i) < 0 ||
+            virTypedParamListAddString(list, "/var/lib/libvirt/images/vda.qcow2",
+                                       "block.%zu.path", i) < 0)
+            return -1;
+
+        for (j = 0; j < G_N_ELEMENTS(blockNames); j++) {
+            if (virTypedParamListAddULLong(list, i * j, "block.%zu.%s",
+                                           i, blockNames[j]) < 0)
+                return -1;
+        }
+    }
+
+    for (i = 0; i < info->nvcpus; i++) {
+        if (virTypedParamListAddInt(list, 1, "vcpu.%zu.state", i) < 0 ||
+            virTypedParamListAddULLong(list, i, "vcpu.%zu.time", i) < 0 ||
+            virTypedParamListAddULLong(list, i, "vcpu.%zu.wait", i) < 0 ||
+            virTypedParamListAddBoolean(list, false, "vcpu.%zu.halted", i) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testBenchPrefixed(const struct testBenchInfo *info,
+                  virTypedParamListPtr list)
+{
+    size_t i;
+    size_t j;
+
+    if (virTypedParamListReserve(list, info->ndisks * 14 +
+                                 info->nvcpus * 4) < 0)
+        return -1;
+
+    for (i = 0; i < info->ndisks; i++) {
+        if (virTypedParamListSetPrefix(list, "block.%zu.", i) < 0 ||
+            virTypedParamListAddPrefixedString(list, "vda", "name") < 0 ||
+            virTypedParamListAddPrefixedString(list, "/var/lib/libvirt/images/vda.qcow2",
+                                               "path") < 0)
+            return -1;
+
+        for (j = 0; j < G_N_ELEMENTS(blockNames); j++) {
+            if (virTypedParamListAddPrefixedULLong(list, i * j,
+                                                   blockNames[j]) < 0)
+                return -1;
+        }
+    }
+
+    for (i = 0; i < info->nvcpus; i++) {
+        if (virTypedParamListSetPrefix(list, "vcpu.%zu.", i) < 0 ||
+            virTypedParamListAddPrefixedInt(list, 1, "state") < 0 ||
+            virTypedParamListAddPrefixedULLong(list, i, "time") < 0 ||
+            virTypedParamListAddPrefixedULLong(list, i, "wait") < 0 ||
+            virTypedParamListAddPrefixedBoolean(list, false, "halted") < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+typedef int (*testBenchFunc)(const struct testBenchInfo *info,
+                             virTypedParamListPtr list);
+
+static int
+testBenchRun(const struct testBenchInfo *info,
+             testBenchFunc func,
+             gint64 *elapsed,
+             size_t *allocs,
+             virTypedParamListPtr *result)
+{
+    size_t i;
+
+    *elapsed = 0;
+    *allocs = 0;
+
+    for (i = 0; i < benchIterations; i++) {
+        g_autoptr(virTypedParamList) list = NULL;
+        size_t startAllocs = testAllocCount();
+        gint64 start = g_get_monotonic_time();
+
+        list = g_new0(virTypedParamList, 1);
+
+        if (func(info, list) < 0)
+            return -1;
+
+        *elapsed += g_get_monotonic_time() - start;
+        *allocs += testAllocCount() - startAllocs;
+
+        if (i == benchIterations - 1)
+            *result = g_steal_pointer(&list);
+    }
+
+    return 0;
+}
+
+
+static int
+testBench(const void *data)
+{
+    const struct testBenchInfo *info = data;
+    g_autoptr(virTypedParamList) printfList = NULL;
+    g_autoptr(virTypedParamList) prefixedList = NULL;
+    gint64 printfTime;
+    gint64 prefixedTime;
+    size_t printfAllocs;
+    size_t prefixedAllocs;
+    size_t i;
+
+    if (virTestGetExpensive() == 0 && info->ndisks > 64)
+        return EXIT_AM_SKIP;
+
+    if (testBenchRun(info, testBenchPrintf, &printfTime, &printfAllocs,
+                     &printfList) < 0 ||
+        testBenchRun(info, testBenchPrefixed, &prefixedTime, &prefixedAllocs,
+                     &prefixedList) < 0)
+        return -1;
+
+    if (printfList->npar != prefixedList->npar) {
+        VIR_TEST_VERBOSE("\nparameter counts differ: %zu/%zu",
+                         printfList->npar, prefixedList->npar);
+        return -1;
+    }
+
+    for (i = 0; i < printfList->npar; i++) {
+        g_autofree char *expect = virTypedParameterToString(printfList->par + i);
+        g_autofree char *actual = virTypedParameterToString(prefixedList->par + i);
+
+        if (STRNEQ(printfList->par[i].field, prefixedList->par[i].field) ||
+            STRNEQ(expect, actual)) {
+            VIR_TEST_VERBOSE("\nparameter %zu differs: '%s'='%s' '%s'='%s'", i,
+                             printfList->par[i].field, expect,
+                             prefixedList->par[i].field, actual);
+            return -1;
+        }
+    }
+
+    VIR_TEST_VERBOSE("\n%zu disks, %zu vcpus, %zu params, %u iterations "
+                     "(usec, allocs per iteration):\n"
+                     "  printf   %8lld %8zu\n"
+                     "  prefixed %8lld %8zu",
+                     info->ndisks, info->nvcpus, printfList->npar,
+                     benchIterations,
+                     (long long) printfTime, printfAllocs / benchIterations,
+                     (long long) prefixedTime, prefixedAllocs / benchIterations);
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    struct testBenchInfo infos[] = {
+        { 1, 1 }, { 4, 8 }, { 64, 64 }, { 1024, 256 },
+    };
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS(infos); i++) {
+        g_autofree char *name = NULL;
+
+        name = g_strdup_printf("bench %zu/%zu", infos[i].ndisks, infos[i].nvcpus);
+
+        if (virTestRun(name, testBench, &infos[i]) < 0)
+            ret = -1;
+    }
+
+    return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN_PRELOAD(mymain, VIR_TEST_MOCK("viralloc"))
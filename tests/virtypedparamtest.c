@@ -200,6 +200,222 @@ testTypedParamsGetStringList(const void *opaque G_GNUC_UNUSED)
     return rv;
 }
 
+static int
+testTypedParamListAddParams(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virTypedParamList) list = g_new0(virTypedParamList, 1);
+    virTypedParameter params[] = {
+        { .field = "foo", .type = VIR_TYPED_PARAM_INT,
+          .value = { .i = 42 } },
+        { .field = "bar", .type = VIR_TYPED_PARAM_STRING,
+          .value = { .s = (char*)"bar1" } },
+    };
+
+    if (virTypedParamListAddInt(list, 1, "first") < 0 ||
+        virTypedParamListAddParams(list, params, G_N_ELEMENTS(params)) < 0)
+        return -1;
+
+    if (list->npar != 3 ||
+        STRNEQ(list->par[1].field, "foo") ||
+        list->par[1].value.i != 42 ||
+        STRNEQ(list->par[2].field, "bar") ||
+        STRNEQ_NULLABLE(list->par[2].value.s, "bar1"))
+        return -1;
+
+    /* the list must own its own copy of the strings */
+    if (list->par[2].value.s == params[1].value.s)
+        return -1;
+
+    return 0;
+}
+
+static int
+testTypedParamListAddPrefixed(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virTypedParamList) list = g_new0(virTypedParamList, 1);
+    char longname[VIR_TYPED_PARAM_FIELD_LENGTH + 1];
+
+    memset(longname, 'a', sizeof(longname) - 1);
+    longname[sizeof(longname) - 1] = '\0';
+
+    if (virTypedParamListReserve(list, 4) < 0 ||
+        list->par_alloc < 4)
+        return -1;
+
+    if (virTypedParamListSetPrefix(list, "block.%zu.", (size_t) 12) < 0 ||
+        virTypedParamListAddPrefixedString(list, "vda", "name") < 0 ||
+        virTypedParamListAddPrefixedULLong(list, 42, "rd.bytes") < 0 ||
+        virTypedParamListSetPrefix(list, "vcpu.%u.", 3) < 0 ||
+        virTypedParamListAddPrefixedBoolean(list, true, "halted") < 0 ||
+        virTypedParamListAddInt(list, 1, "state.state") < 0)
+        return -1;
+
+    if (list->npar != 4 ||
+        STRNEQ(list->par[0].field, "block.12.name") ||
+        STRNEQ_NULLABLE(list->par[0].value.s, "vda") ||
+        STRNEQ(list->par[1].field, "block.12.rd.bytes") ||
+        list->par[1].type != VIR_TYPED_PARAM_ULLONG ||
+        list->par[1].value.ul != 42 ||
+        STRNEQ(list->par[2].field, "vcpu.3.halted") ||
+        !list->par[2].value.b ||
+        STRNEQ(list->par[3].field, "state.state"))
+        return -1;
+
+    /* names not fitting the field together with the prefix are rejected */
+    if (virTypedParamListAddPrefixedUInt(list, 1, longname + 7) == 0 ||
+        virTypedParamListSetPrefix(list, "%s", longname) == 0)
+        return -1;
+
+    virResetLastError();
+
+    return list->npar == 4 ? 0 : -1;
+}
+
+/* The prefixed variants have to build the same list as formatting every
+ * name, the way the bulk stats code does */
+static int
+testTypedParamListPrefixedMatches(const void *opaque G_GNUC_UNUSED)
+{
+    const char *names[] = { "rd.reqs", "rd.bytes", "allocation", "threshold" };
+    g_autoptr(virTypedParamList) printfList = g_new0(virTypedParamList, 1);
+    g_autoptr(virTypedParamList) prefixedList = g_new0(virTypedParamList, 1);
+    size_t i;
+    size_t j;
+
+    if (virTypedParamListReserve(prefixedList, 3 * 5 + 4 * 2) < 0)
+        return -1;
+
+    for (i = 0; i < 3; i++) {
+        if (virTypedParamListAddString(printfList, "vda", "block.%zu.name", i) < 0 ||
+            virTypedParamListSetPrefix(prefixedList, "block.%zu.", i) < 0 ||
+            virTypedParamListAddPrefixedString(prefixedList, "vda", "name") < 0)
+            return -1;
+
+        for (j = 0; j < G_N_ELEMENTS(names); j++) {
+            if (virTypedParamListAddULLong(printfList, i * j, "block.%zu.%s",
+                                           i, names[j]) < 0 ||
+                virTypedParamListAddPrefixedULLong(prefixedList, i * j,
+                                                   names[j]) < 0)
+                return -1;
+        }
+    }
+
+    for (i = 0; i < 4; i++) {
+        if (virTypedParamListAddInt(printfList, 1, "vcpu.%zu.state", i) < 0 ||
+            virTypedParamListAddBoolean(printfList, false, "vcpu.%zu.halted", i) < 0 ||
+            virTypedParamListSetPrefix(prefixedList, "vcpu.%zu.", i) < 0 ||
+            virTypedParamListAddPrefixedInt(prefixedList, 1, "state") < 0 ||
+            virTypedParamListAddPrefixedBoolean(prefixedList, false, "halted") < 0)
+            return -1;
+    }
+
+    if (printfList->npar != prefixedList->npar) {
+        VIR_TEST_VERBOSE("\nparameter counts differ: %zu/%zu",
+                         printfList->npar, prefixedList->npar);
+        return -1;
+    }
+
+    for (i = 0; i < printfList->npar; i++) {
+        g_autofree char *expect = virTypedParameterToString(printfList->par + i);
+        g_autofree char *actual = virTypedParameterToString(prefixedList->par + i);
+
+        if (printfList->par[i].type != prefixedList->par[i].type ||
+            STRNEQ(printfList->par[i].field, prefixedList->par[i].field) ||
+            STRNEQ(expect, actual)) {
+            VIR_TEST_VERBOSE("\nparameter %zu differs: '%s'='%s' '%s'='%s'", i,
+                             printfList->par[i].field, expect,
+                             prefixedList->par[i].field, actual);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+testTypedParamsPack(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virTypedParamsPacker) packer = virTypedParamsPackerNew(16);
+    virTypedParameter params[] = {
+        { .field = "state.state", .type = VIR_TYPED_PARAM_INT,
+          .value = { .i = -1 } },
+        { .field = "block.0.name", .type = VIR_TYPED_PARAM_STRING,
+          .value = { .s = (char*)"vda" } },
+        { .field = "block.0.rd.bytes", .type = VIR_TYPED_PARAM_ULLONG,
+          .value = { .ul = 1ULL << 40 } },
+        { .field = "block.12.rd.bytes", .type = VIR_TYPED_PARAM_ULLONG,
+          .value = { .ul = 42 } },
+        { .field = "block.012.rd.bytes", .type = VIR_TYPED_PARAM_LLONG,
+          .value = { .l = -42 } },
+        { .field = "cpu.time", .type = VIR_TYPED_PARAM_DOUBLE,
+          .value = { .d = 0.5 } },
+        { .field = "vcpu.3", .type = VIR_TYPED_PARAM_BOOLEAN,
+          .value = { .b = 1 } },
+        { .field = "unset", .type = 0 },
+    };
+    virTypedParamsPackedNamePtr names = NULL;
+    size_t nnames = 0;
+    g_autofree char *data = NULL;
+    unsigned int len;
+    virTypedParameterPtr out = NULL;
+    int nout = 0;
+    size_t i;
+    int ret = -1;
+
+    if (virTypedParamsPack(packer, params, G_N_ELEMENTS(params), 16,
+                           &data, &len) < 0)
+        return -1;
+
+    nnames = virTypedParamsPackerStealNames(packer, &names);
+
+    /* "block.0.rd.bytes" and "block.12.rd.bytes" share their name */
+    if (nnames != 6) {
+        VIR_TEST_DEBUG("expected 6 names, got %zu", nnames);
+        goto cleanup;
+    }
+
+    if (virTypedParamsPackedNamesCheck(names, nnames) < 0 ||
+        virTypedParamsUnpack(names, nnames, data, len, 16, &out, &nout) < 0)
+        goto cleanup;
+
+    if (nout != G_N_ELEMENTS(params) - 1) {
+        VIR_TEST_DEBUG("expected %zu parameters, got %d",
+                       G_N_ELEMENTS(params) - 1, nout);
+        goto cleanup;
+    }
+
+    for (i = 0; i < nout; i++) {
+        g_autofree char *expect = virTypedParameterToString(params + i);
+        g_autofree char *actual = virTypedParameterToString(out + i);
+
+        if (STRNEQ(out[i].field, params[i].field) ||
+            out[i].type != params[i].type ||
+            STRNEQ(actual, expect)) {
+            VIR_TEST_DEBUG("parameter '%s' differs: '%s' '%s'",
+                           params[i].field, expect, actual);
+            goto cleanup;
+        }
+    }
+
+    /* truncated data must be rejected */
+    virTypedParamsFree(out, nout);
+    out = NULL;
+    nout = 0;
+    if (virTypedParamsUnpack(names, nnames, data, len - 1, 16, &out, &nout) == 0) {
+        VIR_TEST_DEBUG("truncated data accepted");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < nnames; i++)
+        VIR_FREE(names[i].name);
+    VIR_FREE(names);
+    virTypedParamsFree(out, nout);
+    return ret;
+}
+
 static int
 testTypedParamsValidator(void)
 {
@@ -301,6 +517,18 @@ mymain(void)
     if (virTestRun("Add string list", testTypedParamsAddStringList, NULL) < 0)
         rv = -1;
 
+    if (virTestRun("List add params", testTypedParamListAddParams, NULL) < 0)
+        rv = -1;
+
+    if (virTestRun("List add prefixed", testTypedParamListAddPrefixed, NULL) < 0)
+        rv = -1;
+
+    if (virTestRun("List prefixed matches", testTypedParamListPrefixedMatches, NULL) < 0)
+        rv = -1;
+
+    if (virTestRun("Pack", testTypedParamsPack, NULL) < 0)
+        rv = -1;
+
     if (rv < 0)
         return EXIT_FAILURE;
     return EXIT_SUCCESS;
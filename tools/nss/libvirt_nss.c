@@ -175,12 +175,40 @@ findLease(const char *name,
     }
 
     for (i = 0; i < nleaseFiles; i++) {
-        if (findLeases(leaseFiles[i],
+        char *journal;
+        int rv = 0;
+
+#if !defined(LIBVIRT_NSS_GUEST)
+        /* The index is sorted by hostname, MACs have to be looked for
+         * in the leases file itself */
+        if ((rv = findLeasesIndex(leaseFiles[i], name,
+                                  af, now,
+                                  address, naddress,
+                                  found)) < 0)
+            goto cleanup;
+#endif /* !LIBVIRT_NSS_GUEST */
+
+        if (rv == 0 &&
+            findLeases(leaseFiles[i],
                        name, macs, nmacs,
                        af, now,
                        address, naddress,
-                       found) < 0)
+                       found, false) < 0)
             goto cleanup;
+
+        /* Leases renewed since the file was written */
+        if (asprintf(&journal, "%s.journal", leaseFiles[i]) < 0)
+            goto cleanup;
+
+        if (findLeases(journal,
+                       name, macs, nmacs,
+                       af, now,
+                       address, naddress,
+                       found, true) < 0) {
+            free(journal);
+            goto cleanup;
+        }
+        free(journal);
     }
 
     DEBUG("Found %zu addresses", *naddress);
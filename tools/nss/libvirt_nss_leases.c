@@ -25,12 +25,16 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <yajl/yajl_gen.h>
 #include <yajl/yajl_parse.h>
 
 #include "libvirt_nss_leases.h"
 #include "libvirt_nss.h"
+#include "src/util/virleaseindex.h"
 
 enum {
     FIND_LEASES_STATE_START,
@@ -341,6 +345,12 @@ findLeasesParserEndArray(void *ctx)
 }
 
 
+/*
+ * Parses @file for leases of @name or @macs. With @journal, @file is
+ * the journal of lease renewals which holds a sequence of arrays, one
+ * per line. It disappears or gets truncated when merged into the
+ * leases file, so failing to read or parse it is not fatal.
+ */
 int
 findLeases(const char *file,
            const char *name,
@@ -350,7 +360,8 @@ findLeases(const char *file,
            time_t now,
            leaseAddress **addrs,
            size_t *naddrs,
-           bool *found)
+           bool *found,
+           bool journal)
 {
     int fd = -1;
     int ret = -1;
@@ -383,6 +394,10 @@ findLeases(const char *file,
     int rv;
 
     if ((fd = open(file, O_RDONLY)) < 0) {
+        if (journal && errno == ENOENT) {
+            ret = 0;
+            goto cleanup;
+        }
         ERROR("Cannot open %s", file);
         goto cleanup;
     }
@@ -393,6 +408,9 @@ findLeases(const char *file,
         goto cleanup;
     }
 
+    if (journal)
+        yajl_config(parser, yajl_allow_multiple_values, 1);
+
     while (1) {
         rv = read(fd, line, sizeof(line));
         if (rv < 0)
@@ -407,6 +425,8 @@ findLeases(const char *file,
                                                 (const unsigned char*)line, rv);
             ERROR("Parse failed %s", (const char *) err);
             yajl_free_error(parser, err);
+            if (journal)
+                ret = 0;
             goto cleanup;
         }
     }
@@ -415,6 +435,8 @@ findLeases(const char *file,
         yajl_complete_parse(parser) != yajl_status_ok) {
         ERROR("Parse failed %s",
               yajl_get_error(parser, 1, NULL, 0));
+        if (journal)
+            ret = 0;
         goto cleanup;
     }
 
@@ -435,3 +457,148 @@ findLeases(const char *file,
         close(fd);
     return ret;
 }
+
+
+static const char *
+findLeasesIndexString(const virLeaseIndexHeader *header,
+                      const char *strings,
+                      uint32_t offset)
+{
+    /* The table is checked to end with NUL, so it is enough to check
+     * the start of the string */
+    if (offset >= header->strings)
+        return NULL;
+    return strings + offset;
+}
+
+
+/*
+ * Looks up leases of @name in the index of the leases @file without
+ * parsing it, see virleaseindex.h. Leases in the journal are not in the
+ * index and have to be looked up separately.
+ *
+ * Returns 1 if the index was used,
+ *         0 if there is no usable index and @file has to be parsed,
+ *        -1 on error.
+ */
+int
+findLeasesIndex(const char *file,
+                const char *name,
+                int af,
+                time_t now,
+                leaseAddress **addrs,
+                size_t *naddrs,
+                bool *found)
+{
+    char *indexFile = NULL;
+    int fd = -1;
+    int ret = -1;
+    void *map = MAP_FAILED;
+    size_t maplen = 0;
+    const virLeaseIndexHeader *header;
+    const virLeaseIndexEntry *entries;
+    const char *strings;
+    const char *str;
+    struct stat sb;
+    struct stat isb;
+    size_t lo;
+    size_t hi;
+
+    if (asprintf(&indexFile, "%s.index", file) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+    if ((fd = open(indexFile, O_RDONLY)) < 0) {
+        DEBUG("No index %s", indexFile);
+        goto cleanup;
+    }
+
+    if (fstat(fd, &isb) < 0 ||
+        stat(file, &sb) < 0 ||
+        isb.st_size < (off_t) sizeof(*header))
+        goto cleanup;
+
+    maplen = isb.st_size;
+    if ((map = mmap(NULL, maplen, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+        goto cleanup;
+
+    header = map;
+    entries = (const virLeaseIndexEntry *) (header + 1);
+    strings = (const char *) (entries + header->nentries);
+
+    if (memcmp(header->magic, VIR_LEASE_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        sizeof(*header) + (uint64_t) header->nentries * sizeof(*entries) +
+        header->strings != maplen ||
+        (header->strings && strings[header->strings - 1] != '\0')) {
+        DEBUG("Ignoring malformed index %s", indexFile);
+        goto cleanup;
+    }
+
+    if (header->leasesIno != (uint64_t) sb.st_ino ||
+        header->leasesSize != (uint64_t) sb.st_size ||
+        header->leasesMtime != (int64_t) sb.st_mtime) {
+        DEBUG("Ignoring stale index %s", indexFile);
+        goto cleanup;
+    }
+
+    /* From now on, an offset out of the bounds of the string table
+     * means the index is malformed and @file gets parsed instead.
+     * Whatever was found so far is found again then. */
+
+    /* Find the first entry of @name */
+    lo = 0;
+    hi = header->nentries;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (!(str = findLeasesIndexString(header, strings,
+                                          entries[mid].hostname)))
+            goto cleanup;
+
+        if (strcmp(str, name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < header->nentries; lo++) {
+        if (!(str = findLeasesIndexString(header, strings,
+                                          entries[lo].hostname)))
+            goto cleanup;
+
+        if (strcmp(str, name) != 0)
+            break;
+
+        if (entries[lo].expiry < now) {
+            DEBUG("Entry expired at %lld vs now %llu",
+                  (long long) entries[lo].expiry, (unsigned long long) now);
+            continue;
+        }
+
+        if (!(str = findLeasesIndexString(header, strings,
+                                          entries[lo].ipaddr)))
+            goto cleanup;
+
+        *found = true;
+        if (appendAddr(name, addrs, naddrs, str,
+                       entries[lo].expiry, af) < 0) {
+            free(*addrs);
+            *addrs = NULL;
+            *naddrs = 0;
+            ret = -1;
+            goto cleanup;
+        }
+    }
+
+    DEBUG("Used index %s", indexFile);
+    ret = 1;
+
+ cleanup:
+    if (map != MAP_FAILED)
+        munmap(map, maplen);
+    if (fd != -1)
+        close(fd);
+    free(indexFile);
+    return ret;
+}
@@ -37,4 +37,14 @@ findLeases(const char *file,
            time_t now,
            leaseAddress **addrs,
            size_t *naddrs,
-           bool *found);
+           bool *found,
+           bool journal);
+
+int
+findLeasesIndex(const char *file,
+                const char *name,
+                int af,
+                time_t now,
+                leaseAddress **addrs,
+                size_t *naddrs,
+                bool *found);
@@ -30,6 +30,8 @@
 #include "internal.h"
 #include "conf/virdomainobjlist.h"
 #include "viralloc.h"
+#include "virhash.h"
+#include "virjson.h"
 #include "virmacaddr.h"
 #include "virxml.h"
 #include "virstring.h"
@@ -2177,18 +2179,150 @@ static const vshCmdOptDef opts_domstats[] = {
      .type = VSH_OT_BOOL,
      .help = N_("report only stats that are accessible instantly"),
     },
+    {.name = "parallel",
+     .type = VSH_OT_BOOL,
+     .help = N_("collect stats of multiple domains in parallel"),
+    },
+    {.name = "cached",
+     .type = VSH_OT_BOOL,
+     .help = N_("allow returning recently cached stats"),
+    },
+    {.name = "interval",
+     .type = VSH_OT_INT,
+     .flags = VSH_OFLAG_REQ_OPT,
+     .help = N_("collect stats repeatedly, every given number of seconds"),
+    },
+    {.name = "count",
+     .type = VSH_OT_INT,
+     .flags = VSH_OFLAG_REQ_OPT,
+     .help = N_("number of times to collect stats with --interval"),
+    },
+    {.name = "format",
+     .type = VSH_OT_STRING,
+     .flags = VSH_OFLAG_REQ_OPT,
+     .help = N_("output format: text, json or csv"),
+    },
     VIRSH_COMMON_OPT_DOMAIN_OT_ARGV(N_("list of domains to get stats for"), 0),
     {.name = NULL}
 };
 
 
+typedef enum {
+    VIRSH_DOMSTATS_FORMAT_TEXT,
+    VIRSH_DOMSTATS_FORMAT_JSON,
+    VIRSH_DOMSTATS_FORMAT_CSV,
+
+    VIRSH_DOMSTATS_FORMAT_LAST
+} virshDomStatsFormat;
+
+VIR_ENUM_DECL(virshDomStatsFormat);
+VIR_ENUM_IMPL(virshDomStatsFormat,
+              VIRSH_DOMSTATS_FORMAT_LAST,
+              "text",
+              "json",
+              "csv",
+);
+
+/* Suffixes of the fields holding counters which only ever grow, for
+ * which a rate is reported in watch mode */
+static const char *virshDomainStatsCounters[] = {
+    "time", "user", "system", "wait", "bytes", "pkts", "errs", "drop",
+    "reqs", "times", NULL
+};
+
+
+static bool
+virshDomainStatsIsCounter(const char *field)
+{
+    const char *suffix = strrchr(field, '.');
+
+    if (STRPREFIX(field, "perf."))
+        return true;
+
+    return suffix && virStringListHasString(virshDomainStatsCounters,
+                                            suffix + 1);
+}
+
+
+static bool
+virshDomainStatsParamValue(virTypedParameterPtr param,
+                           unsigned long long *value)
+{
+    switch ((virTypedParameterType) param->type) {
+    case VIR_TYPED_PARAM_UINT:
+        *value = param->value.ui;
+        return true;
+    case VIR_TYPED_PARAM_ULLONG:
+        *value = param->value.ul;
+        return true;
+    case VIR_TYPED_PARAM_INT:
+        *value = param->value.i;
+        return param->value.i >= 0;
+    case VIR_TYPED_PARAM_LLONG:
+        *value = param->value.l;
+        return param->value.l >= 0;
+    case VIR_TYPED_PARAM_DOUBLE:
+    case VIR_TYPED_PARAM_BOOLEAN:
+    case VIR_TYPED_PARAM_STRING:
+    case VIR_TYPED_PARAM_LAST:
+        break;
+    }
+
+    return false;
+}
+
+
+/* Computes the per second rate of the counter @param of a record since
+ * @prev, the record of the same domain sampled @elapsed microseconds
+ * earlier. Returns false if there's no rate to report for @param. */
+static bool
+virshDomainStatsGetRate(virTypedParameterPtr param,
+                        virDomainStatsRecordPtr prev,
+                        gint64 elapsed,
+                        double *rate)
+{
+    virTypedParameterPtr prevParam;
+    unsigned long long cur;
+    unsigned long long old;
+
+    if (!prev || elapsed <= 0 ||
+        !virshDomainStatsIsCounter(param->field) ||
+        !(prevParam = virTypedParamsGet(prev->params, prev->nparams,
+                                        param->field)) ||
+        !virshDomainStatsParamValue(param, &cur) ||
+        !virshDomainStatsParamValue(prevParam, &old) ||
+        cur < old)
+        return false;
+
+    *rate = (double) (cur - old) * G_USEC_PER_SEC / elapsed;
+    return true;
+}
+
+
+/* Returns @str quoted for a CSV file if needed */
+static char *
+virshDomainStatsCSVQuote(const char *str)
+{
+    g_autofree char *escaped = NULL;
+
+    if (!strpbrk(str, ",\"\r\n"))
+        return g_strdup(str);
+
+    escaped = virStringReplace(str, "\"", "\"\"");
+    return g_strdup_printf("\"%s\"", escaped);
+}
+
+
 static bool
 virshDomainStatsPrintRecord(vshControl *ctl G_GNUC_UNUSED,
                             virDomainStatsRecordPtr record,
+                            virDomainStatsRecordPtr prev,
+                            gint64 elapsed,
                             bool raw G_GNUC_UNUSED)
 {
     char *param;
     size_t i;
+    double rate;
 
     vshPrint(ctl, "Domain: '%s'\n", virDomainGetName(record->dom));
 
@@ -2203,9 +2337,235 @@ virshDomainStatsPrintRecord(vshControl *ctl G_GNUC_UNUSED,
         VIR_FREE(param);
     }
 
+    for (i = 0; i < record->nparams; i++) {
+        if (virshDomainStatsGetRate(record->params + i, prev, elapsed, &rate))
+            vshPrint(ctl, "  %s.rate=%.2f\n", record->params[i].field, rate);
+    }
+
     return true;
 }
 
+
+static bool
+virshDomainStatsPrintRecordJSON(vshControl *ctl,
+                                virDomainStatsRecordPtr record,
+                                virDomainStatsRecordPtr prev,
+                                gint64 elapsed,
+                                double timestamp)
+{
+    g_autoptr(virJSONValue) obj = NULL;
+    g_autoptr(virJSONValue) params = virJSONValueNewObject();
+    g_autoptr(virJSONValue) rates = NULL;
+    g_autofree char *str = NULL;
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    size_t i;
+    double rate;
+
+    if (virDomainGetUUIDString(record->dom, uuid) < 0)
+        return false;
+
+    for (i = 0; i < record->nparams; i++) {
+        virTypedParameterPtr param = record->params + i;
+        int rc = 0;
+
+        switch ((virTypedParameterType) param->type) {
+        case VIR_TYPED_PARAM_INT:
+            rc = virJSONValueObjectAppendNumberInt(params, param->field,
+                                                   param->value.i);
+            break;
+        case VIR_TYPED_PARAM_UINT:
+            rc = virJSONValueObjectAppendNumberUint(params, param->field,
+                                                    param->value.ui);
+            break;
+        case VIR_TYPED_PARAM_LLONG:
+            rc = virJSONValueObjectAppendNumberLong(params, param->field,
+                                                    param->value.l);
+            break;
+        case VIR_TYPED_PARAM_ULLONG:
+            rc = virJSONValueObjectAppendNumberUlong(params, param->field,
+                                                     param->value.ul);
+            break;
+        case VIR_TYPED_PARAM_DOUBLE:
+            rc = virJSONValueObjectAppendNumberDouble(params, param->field,
+                                                      param->value.d);
+            break;
+        case VIR_TYPED_PARAM_BOOLEAN:
+            rc = virJSONValueObjectAppendBoolean(params, param->field,
+                                                 param->value.b);
+            break;
+        case VIR_TYPED_PARAM_STRING:
+            rc = virJSONValueObjectAppendString(params, param->field,
+                                                param->value.s);
+            break;
+        case VIR_TYPED_PARAM_LAST:
+            break;
+        }
+
+        if (rc < 0)
+            return false;
+
+        if (virshDomainStatsGetRate(param, prev, elapsed, &rate)) {
+            if (!rates)
+                rates = virJSONValueNewObject();
+
+            if (virJSONValueObjectAppendNumberDouble(rates, param->field,
+                                                     rate) < 0)
+                return false;
+        }
+    }
+
+    if (virJSONValueObjectCreate(&obj,
+                                 "d:timestamp", timestamp,
+                                 "s:domain", virDomainGetName(record->dom),
+                                 "s:uuid", uuid,
+                                 "a:stats", &params,
+                                 "A:rates", &rates,
+                                 NULL) < 0)
+        return false;
+
+    if (!(str = virJSONValueToString(obj, false)))
+        return false;
+
+    vshPrint(ctl, "%s\n", str);
+    return true;
+}
+
+
+static bool
+virshDomainStatsPrintRecordCSV(vshControl *ctl,
+                               virDomainStatsRecordPtr record,
+                               virDomainStatsRecordPtr prev,
+                               gint64 elapsed,
+                               double timestamp)
+{
+    g_autofree char *name = virshDomainStatsCSVQuote(virDomainGetName(record->dom));
+    size_t i;
+    double rate;
+
+    for (i = 0; i < record->nparams; i++) {
+        g_autofree char *param = NULL;
+        g_autofree char *value = NULL;
+
+        if (!(param = vshGetTypedParamValue(ctl, record->params + i)))
+            return false;
+
+        value = virshDomainStatsCSVQuote(param);
+
+        vshPrint(ctl, "%.3f,%s,%s,%s\n",
+                 timestamp, name, record->params[i].field, value);
+
+        if (virshDomainStatsGetRate(record->params + i, prev, elapsed, &rate))
+            vshPrint(ctl, "%.3f,%s,%s.rate,%.2f\n",
+                     timestamp, name, record->params[i].field, rate);
+    }
+
+    return true;
+}
+
+
+struct virshDomainStatsSample {
+    virDomainStatsRecordPtr *records;
+    virHashTablePtr byUUID; /* records indexed by domain UUID */
+    gint64 when;
+};
+
+
+static void
+virshDomainStatsSampleClear(struct virshDomainStatsSample *sample)
+{
+    virHashFree(sample->byUUID);
+    virDomainStatsRecordListFree(sample->records);
+    memset(sample, 0, sizeof(*sample));
+}
+
+
+static bool
+virshDomainStatsPrintSample(vshControl *ctl,
+                            struct virshDomainStatsSample *sample,
+                            struct virshDomainStatsSample *prev,
+                            virshDomStatsFormat format,
+                            bool raw)
+{
+    double timestamp = (double) g_get_real_time() / G_USEC_PER_SEC;
+    gint64 elapsed = prev->records ? sample->when - prev->when : 0;
+    virDomainStatsRecordPtr *next;
+
+    for (next = sample->records; *next; next++) {
+        virDomainStatsRecordPtr old = NULL;
+        char uuid[VIR_UUID_STRING_BUFLEN];
+        bool ok = false;
+
+        if (prev->byUUID &&
+            virDomainGetUUIDString((*next)->dom, uuid) == 0)
+            old = virHashLookup(prev->byUUID, uuid);
+
+        switch (format) {
+        case VIRSH_DOMSTATS_FORMAT_TEXT:
+            if (next != sample->records)
+                vshPrint(ctl, "\n");
+            ok = virshDomainStatsPrintRecord(ctl, *next, old, elapsed, raw);
+            break;
+        case VIRSH_DOMSTATS_FORMAT_JSON:
+            ok = virshDomainStatsPrintRecordJSON(ctl, *next, old, elapsed,
+                                                 timestamp);
+            break;
+        case VIRSH_DOMSTATS_FORMAT_CSV:
+            ok = virshDomainStatsPrintRecordCSV(ctl, *next, old, elapsed,
+                                                timestamp);
+            break;
+        case VIRSH_DOMSTATS_FORMAT_LAST:
+            break;
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+
+static bool
+virshDomainStatsCollect(vshControl *ctl,
+                        virDomainPtr *domlist,
+                        unsigned int stats,
+                        unsigned int flags,
+                        struct virshDomainStatsSample *sample)
+{
+    virshControlPtr priv = ctl->privData;
+    virDomainStatsRecordPtr *next;
+
+    if (domlist) {
+        if (virDomainListGetStats(domlist,
+                                  stats,
+                                  &sample->records,
+                                  flags) < 0)
+            return false;
+    } else {
+       if ((virConnectGetAllDomainStats(priv->conn,
+                                        stats,
+                                        &sample->records,
+                                        flags)) < 0)
+           return false;
+    }
+
+    sample->when = g_get_monotonic_time();
+
+    if (!(sample->byUUID = virHashCreate(10, NULL)))
+        return false;
+
+    for (next = sample->records; *next; next++) {
+        char uuid[VIR_UUID_STRING_BUFLEN];
+
+        if (virDomainGetUUIDString((*next)->dom, uuid) < 0 ||
+            virHashAddEntry(sample->byUUID, uuid, *next) < 0)
+            return false;
+    }
+
+    return true;
+}
+
+
 static bool
 cmdDomstats(vshControl *ctl, const vshCmd *cmd)
 {
@@ -2213,13 +2573,38 @@ cmdDomstats(vshControl *ctl, const vshCmd *cmd)
     virDomainPtr *domlist = NULL;
     virDomainPtr dom;
     size_t ndoms = 0;
-    virDomainStatsRecordPtr *records = NULL;
-    virDomainStatsRecordPtr *next;
+    struct virshDomainStatsSample sample = { 0 };
+    struct virshDomainStatsSample prev = { 0 };
     bool raw = vshCommandOptBool(cmd, "raw");
     int flags = 0;
     const vshCmdOpt *opt = NULL;
+    const char *formatStr = NULL;
+    int format = VIRSH_DOMSTATS_FORMAT_TEXT;
+    unsigned int interval = 0;
+    unsigned int count = 0;
+    unsigned int samples = 0;
+    bool eventStarted = false;
     bool ret = false;
-    virshControlPtr priv = ctl->privData;
+
+    VSH_REQUIRE_OPTION("count", "interval");
+
+    if (vshCommandOptUInt(ctl, cmd, "interval", &interval) < 0 ||
+        vshCommandOptUInt(ctl, cmd, "count", &count) < 0)
+        return false;
+
+    if (vshCommandOptStringReq(ctl, cmd, "format", &formatStr) < 0)
+        return false;
+
+    if (formatStr &&
+        (format = virshDomStatsFormatTypeFromString(formatStr)) < 0) {
+        vshError(ctl, _("Unknown output format '%s'"), formatStr);
+        return false;
+    }
+
+    if (interval > INT_MAX / 1000) {
+        vshError(ctl, "%s", _("interval is too long"));
+        return false;
+    }
 
     if (vshCommandOptBool(cmd, "state"))
         stats |= VIR_DOMAIN_STATS_STATE;
@@ -2281,6 +2666,12 @@ cmdDomstats(vshControl *ctl, const vshCmd *cmd)
     if (vshCommandOptBool(cmd, "nowait"))
         flags |= VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT;
 
+    if (vshCommandOptBool(cmd, "parallel"))
+        flags |= VIR_CONNECT_GET_ALL_DOMAINS_STATS_PARALLEL;
+
+    if (vshCommandOptBool(cmd, "cached"))
+        flags |= VIR_CONNECT_GET_ALL_DOMAINS_STATS_CACHED;
+
     if (vshCommandOptBool(cmd, "domain")) {
         if (VIR_ALLOC_N(domlist, 1) < 0)
             goto cleanup;
@@ -2295,32 +2686,50 @@ cmdDomstats(vshControl *ctl, const vshCmd *cmd)
             if (VIR_INSERT_ELEMENT(domlist, ndoms - 1, ndoms, dom) < 0)
                 goto cleanup;
         }
+    }
 
-        if (virDomainListGetStats(domlist,
-                                  stats,
-                                  &records,
-                                  flags) < 0)
+    if (interval) {
+        if (vshEventStart(ctl, interval * 1000) < 0)
             goto cleanup;
-    } else {
-       if ((virConnectGetAllDomainStats(priv->conn,
-                                        stats,
-                                        &records,
-                                        flags)) < 0)
-           goto cleanup;
+        eventStarted = true;
     }
 
-    next = records;
-    while (*next) {
-        if (!virshDomainStatsPrintRecord(ctl, *next, raw))
+    if (format == VIRSH_DOMSTATS_FORMAT_CSV)
+        vshPrint(ctl, "timestamp,domain,field,value\n");
+
+    while (true) {
+        if (!virshDomainStatsCollect(ctl, domlist, stats, flags, &sample) ||
+            !virshDomainStatsPrintSample(ctl, &sample, &prev, format, raw))
             goto cleanup;
 
-        if (*(++next))
+        if (!interval || (count && ++samples >= count))
+            break;
+
+        if (format == VIRSH_DOMSTATS_FORMAT_TEXT)
             vshPrint(ctl, "\n");
+
+        virshDomainStatsSampleClear(&prev);
+        prev = sample;
+        memset(&sample, 0, sizeof(sample));
+
+        switch (vshEventWait(ctl)) {
+        case VSH_EVENT_TIMEOUT:
+            continue;
+        case VSH_EVENT_INTERRUPT:
+        case VSH_EVENT_DONE:
+            break;
+        default:
+            goto cleanup;
+        }
+        break;
     }
 
     ret = true;
  cleanup:
-    virDomainStatsRecordListFree(records);
+    if (eventStarted)
+        vshEventCleanup(ctl);
+    virshDomainStatsSampleClear(&sample);
+    virshDomainStatsSampleClear(&prev);
     virObjectListFree(domlist);
 
     return ret;
@@ -10713,6 +10713,15 @@ static const vshCmdOptDef opts_migrate[] = {
      .type = VSH_OT_STRING,
      .help = N_("override the destination host name used for TLS verification")
     },
+    {.name = "tunnel-streams",
+     .type = VSH_OT_INT,
+     .help = N_("number of streams for tunnelled migration")
+    },
+    {.name = "postcopy-auto-downtime",
+     .type = VSH_OT_INT,
+     .help = N_("switch to post-copy when pre-copy is not expected to reach "
+                "this downtime (in ms)")
+    },
     {.name = NULL}
 };
 
@@ -10929,6 +10938,25 @@ doMigrate(void *opaque)
             goto save_error;
     }
 
+    if ((rv = vshCommandOptInt(ctl, cmd, "tunnel-streams", &intOpt)) < 0) {
+        goto out;
+    } else if (rv > 0) {
+        if (virTypedParamsAddInt(&params, &nparams, &maxparams,
+                                 VIR_MIGRATE_PARAM_TUNNEL_STREAMS,
+                                 intOpt) < 0)
+            goto save_error;
+    }
+
+    if ((rv = vshCommandOptULongLong(ctl, cmd, "postcopy-auto-downtime",
+                                     &ullOpt)) < 0) {
+        goto out;
+    } else if (rv > 0) {
+        if (virTypedParamsAddULLong(&params, &nparams, &maxparams,
+                                    VIR_MIGRATE_PARAM_POSTCOPY_AUTO_DOWNTIME,
+                                    ullOpt) < 0)
+            goto save_error;
+    }
+
     if ((rv = vshCommandOptULongLong(ctl, cmd, "bandwidth", &ullOpt)) < 0) {
         goto out;
     } else if (rv > 0) {
@@ -13585,6 +13613,27 @@ virshEventBlockThresholdPrint(virConnectPtr conn G_GNUC_UNUSED,
 }
 
 
+static void
+virshEventBlockJobProgressPrint(virConnectPtr conn G_GNUC_UNUSED,
+                                virDomainPtr dom,
+                                const char *disk,
+                                int type,
+                                unsigned long long cur,
+                                unsigned long long end,
+                                unsigned long long bandwidth,
+                                void *opaque)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+
+    virBufferAsprintf(&buf, _("event 'block-job-progress' for domain %s: "
+                              "%s for %s %llu/%llu bandwidth %llu\n"),
+                      virDomainGetName(dom),
+                      virshDomainBlockJobToString(type),
+                      disk, cur, end, bandwidth);
+    virshEventPrint(opaque, &buf);
+}
+
+
 virshDomainEventCallback virshDomainEventCallbacks[] = {
     { "lifecycle",
       VIR_DOMAIN_EVENT_CALLBACK(virshEventLifecyclePrint), },
@@ -13634,6 +13683,8 @@ virshDomainEventCallback virshDomainEventCallbacks[] = {
       VIR_DOMAIN_EVENT_CALLBACK(virshEventMetadataChangePrint), },
     { "block-threshold",
       VIR_DOMAIN_EVENT_CALLBACK(virshEventBlockThresholdPrint), },
+    { "block-job-progress",
+      VIR_DOMAIN_EVENT_CALLBACK(virshEventBlockJobProgressPrint), },
 };
 G_STATIC_ASSERT(VIR_DOMAIN_EVENT_ID_LAST == G_N_ELEMENTS(virshDomainEventCallbacks));
 
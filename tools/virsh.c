@@ -452,6 +452,8 @@ virshUsage(void)
                       "    -d | --debug=NUM        debug level [0-4]\n"
                       "    -e | --escape <char>    set escape sequence for console\n"
                       "    -h | --help             this help\n"
+                      "    -j | --jobs=NUM         read commands from stdin and run NUM\n"
+                      "                            of them at once\n"
                       "    -k | --keepalive-interval=NUM\n"
                       "                            keepalive interval in seconds, 0 for disable\n"
                       "    -K | --keepalive-count=NUM\n"
@@ -644,6 +646,7 @@ static bool
 virshParseArgv(vshControl *ctl, int argc, char **argv)
 {
     int arg, len, debug, keepalive;
+    unsigned int jobs;
     size_t i;
     int longindex = -1;
     virshControlPtr priv = ctl->privData;
@@ -652,6 +655,7 @@ virshParseArgv(vshControl *ctl, int argc, char **argv)
         {"debug", required_argument, NULL, 'd'},
         {"escape", required_argument, NULL, 'e'},
         {"help", no_argument, NULL, 'h'},
+        {"jobs", required_argument, NULL, 'j'},
         {"keepalive-interval", required_argument, NULL, 'k'},
         {"keepalive-count", required_argument, NULL, 'K'},
         {"log", required_argument, NULL, 'l'},
@@ -665,7 +669,7 @@ virshParseArgv(vshControl *ctl, int argc, char **argv)
     /* Standard (non-command) options. The leading + ensures that no
      * argument reordering takes place, so that command options are
      * not confused with top-level virsh options. */
-    while ((arg = getopt_long(argc, argv, "+:c:d:e:hk:K:l:qrtvV", opt, &longindex)) != -1) {
+    while ((arg = getopt_long(argc, argv, "+:c:d:e:hj:k:K:l:qrtvV", opt, &longindex)) != -1) {
         switch (arg) {
         case 'c':
             VIR_FREE(ctl->connname);
@@ -700,6 +704,15 @@ virshParseArgv(vshControl *ctl, int argc, char **argv)
             virshUsage();
             exit(EXIT_SUCCESS);
             break;
+        case 'j':
+            if (virStrToLong_ui(optarg, NULL, 10, &jobs) < 0 || jobs == 0) {
+                vshError(ctl,
+                         _("option %s requires a positive integer argument"),
+                         longindex == -1 ? "-j" : "--jobs");
+                exit(EXIT_FAILURE);
+            }
+            ctl->jobs = jobs;
+            break;
         case 'k':
             if (virStrToLong_i(optarg, NULL, 0, &keepalive) < 0) {
                 vshError(ctl,
@@ -779,7 +792,14 @@ virshParseArgv(vshControl *ctl, int argc, char **argv)
         longindex = -1;
     }
 
-    if (argc == optind) {
+    if (ctl->jobs > 0) {
+        if (argc != optind) {
+            vshError(ctl, "%s",
+                     _("commands are read from stdin with option --jobs"));
+            exit(EXIT_FAILURE);
+        }
+        ctl->imode = false;
+    } else if (argc == optind) {
         ctl->imode = true;
     } else {
         /* parse command */
@@ -901,7 +921,9 @@ main(int argc, char **argv)
     if (!ctl->connname)
         ctl->connname = g_strdup(getenv("VIRSH_DEFAULT_CONNECT_URI"));
 
-    if (!ctl->imode) {
+    if (ctl->jobs > 0) {
+        ret = vshCommandRunBatch(ctl, stdin, ctl->jobs);
+    } else if (!ctl->imode) {
         ret = vshCommandRun(ctl, ctl->cmd);
     } else {
         /* interactive mode */
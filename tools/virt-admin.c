@@ -841,8 +841,11 @@ cmdSrvClientsInfo(vshControl *ctl, const vshCmd *cmd)
         goto cleanup;
     }
 
-    for (i = 0; i < nparams; i++)
-        vshPrint(ctl, "%-20s: %u\n", params[i].field, params[i].value.ui);
+    for (i = 0; i < nparams; i++) {
+        char *str = vshGetTypedParamValue(ctl, &params[i]);
+        vshPrint(ctl, "%-20s: %s\n", params[i].field, str);
+        VIR_FREE(str);
+    }
 
     ret = true;
 
@@ -885,6 +888,11 @@ static const vshCmdOptDef opts_srv_clients_set[] = {
      .help = N_("Change the upper limit to number of clients waiting for "
                 "authentication to be connected to the server"),
     },
+    {.name = "max-client-jobs",
+     .type = VSH_OT_INT,
+     .help = N_("Change the upper limit to number of calls of a single "
+                "client processed at the same time"),
+    },
     {.name = NULL}
 };
 
@@ -916,12 +924,14 @@ cmdSrvClientsSet(vshControl *ctl, const vshCmd *cmd)
 
     PARSE_CMD_TYPED_PARAM("max-clients", VIR_SERVER_CLIENTS_MAX);
     PARSE_CMD_TYPED_PARAM("max-unauth-clients", VIR_SERVER_CLIENTS_UNAUTH_MAX);
+    PARSE_CMD_TYPED_PARAM("max-client-jobs", VIR_SERVER_CLIENTS_JOBS_MAX);
 
 #undef PARSE_CMD_TYPED_PARAM
 
     if (!nparams) {
         vshError(ctl, "%s", _("At least one of options --max-clients, "
-                              "--max-unauth-clients is mandatory"));
+                              "--max-unauth-clients, --max-client-jobs "
+                              "is mandatory"));
         goto cleanup;
     }
 
@@ -1011,6 +1021,332 @@ cmdSrvUpdateTlsFiles(vshControl *ctl, const vshCmd *cmd)
     return ret;
 }
 
+/* -------------------
+ *  Command srv-stats
+ * -------------------
+ */
+static const vshCmdInfo info_srv_stats[] = {
+    {.name = "help",
+     .data = N_("show statistics of the RPC procedures of a server")
+    },
+    {.name = "desc",
+     .data = N_("Show how many times each RPC procedure was called by the "
+                "clients of a server, how many calls failed and how long "
+                "the calls waited for a worker and were executed for.")
+    },
+    {.name = NULL}
+};
+
+static const vshCmdOptDef opts_srv_stats[] = {
+    {.name = "server",
+     .type = VSH_OT_DATA,
+     .flags = VSH_OFLAG_REQ,
+     .completer = vshAdmServerCompleter,
+     .help = N_("Server to retrieve the statistics from."),
+    },
+    {.name = "histogram",
+     .type = VSH_OT_BOOL,
+     .help = N_("show the latency histograms of each procedure")
+    },
+    {.name = NULL}
+};
+
+/* Prints the histogram @name of procedure @proc found in @params */
+static bool
+vshAdmPrintProcHistogram(vshControl *ctl,
+                         virTypedParameterPtr params,
+                         int nparams,
+                         size_t proc,
+                         const char *name,
+                         const char *suffix,
+                         unsigned int nbuckets)
+{
+    size_t i;
+
+    vshPrint(ctl, "   %-6s", name);
+
+    for (i = 0; i < nbuckets; i++) {
+        char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+        unsigned long long value = 0;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_SERVER_PROC_STATS_PREFIX "%zu%s%zu", proc, suffix, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &value) < 0)
+            return false;
+
+        vshPrint(ctl, " %10llu", value);
+    }
+    vshPrint(ctl, "\n");
+
+    return true;
+}
+
+static bool
+cmdSrvStats(vshControl *ctl, const vshCmd *cmd)
+{
+    bool ret = false;
+    bool parsed = false;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    unsigned int count = 0;
+    unsigned int nbuckets = 0;
+    bool histogram = vshCommandOptBool(cmd, "histogram");
+    size_t i;
+    const char *srvname = NULL;
+    virAdmServerPtr srv = NULL;
+    vshAdmControlPtr priv = ctl->privData;
+
+    if (vshCommandOptStringReq(ctl, cmd, "server", &srvname) < 0)
+        return false;
+
+    if (!(srv = virAdmConnectLookupServer(priv->conn, srvname, 0)))
+        goto cleanup;
+
+    if (virAdmServerGetProcedureStats(srv, &params, &nparams, 0) < 0) {
+        vshError(ctl, "%s", _("Unable to retrieve procedure statistics "
+                              "from server"));
+        goto cleanup;
+    }
+
+    parsed = true;
+
+    if (virTypedParamsGetUInt(params, nparams,
+                              VIR_SERVER_PROC_STATS_COUNT, &count) < 0 ||
+        virTypedParamsGetUInt(params, nparams,
+                              VIR_SERVER_PROC_STATS_HIST_COUNT, &nbuckets) < 0)
+        goto cleanup;
+
+    vshPrintExtra(ctl, " %-10s %-9s %-10s %-8s %-14s %s\n",
+                  _("Program"), _("Procedure"), _("Calls"), _("Errors"),
+                  _("Avg queue (us)"), _("Avg exec (us)"));
+    vshPrintExtra(ctl, "------------------------------------------------------"
+                  "--------------------\n");
+
+    if (histogram) {
+        unsigned long long bound = 1;
+
+        vshPrintExtra(ctl, "   %-6s", _("< us"));
+        for (i = 0; i + 1 < nbuckets; i++) {
+            bound *= 10;
+            vshPrintExtra(ctl, " %10llu", bound);
+        }
+        vshPrintExtra(ctl, " %10s\n", _("slower"));
+    }
+
+    for (i = 0; i < count; i++) {
+        char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+        unsigned int program = 0;
+        unsigned int procedure = 0;
+        unsigned long long calls = 0;
+        unsigned long long errors = 0;
+        unsigned long long queueTime = 0;
+        unsigned long long execTime = 0;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                   VIR_SERVER_PROC_STATS_SUFFIX_PROGRAM, i);
+        if (virTypedParamsGetUInt(params, nparams, field, &program) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                   VIR_SERVER_PROC_STATS_SUFFIX_PROCEDURE, i);
+        if (virTypedParamsGetUInt(params, nparams, field, &procedure) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                   VIR_SERVER_PROC_STATS_SUFFIX_CALLS, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &calls) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                   VIR_SERVER_PROC_STATS_SUFFIX_ERRORS, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &errors) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                   VIR_SERVER_PROC_STATS_SUFFIX_QUEUE_TIME, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &queueTime) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_SERVER_PROC_STATS_PREFIX "%zu"
+                   VIR_SERVER_PROC_STATS_SUFFIX_EXEC_TIME, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &execTime) < 0)
+            goto cleanup;
+
+        vshPrint(ctl, " 0x%08x %-9u %-10llu %-8llu %-14llu %llu\n",
+                 program, procedure, calls, errors,
+                 calls ? queueTime / calls : 0,
+                 calls ? execTime / calls : 0);
+
+        if (histogram &&
+            (!vshAdmPrintProcHistogram(ctl, params, nparams, i, _("queue"),
+                                       VIR_SERVER_PROC_STATS_SUFFIX_QUEUE_HIST,
+                                       nbuckets) ||
+             !vshAdmPrintProcHistogram(ctl, params, nparams, i, _("exec"),
+                                       VIR_SERVER_PROC_STATS_SUFFIX_EXEC_HIST,
+                                       nbuckets)))
+            goto cleanup;
+    }
+
+    ret = true;
+
+ cleanup:
+    if (!ret && parsed)
+        vshError(ctl, "%s", _("Unable to parse procedure statistics"));
+    virTypedParamsFree(params, nparams);
+    virAdmServerFree(srv);
+    return ret;
+}
+
+/* ---------------------
+ * Command srv-capture
+ * ---------------------
+ */
+static const vshCmdInfo info_srv_capture[] = {
+    {.name = "help",
+     .data = N_("capture the RPC messages of a server")
+    },
+    {.name = "desc",
+     .data = N_("Start or stop keeping the RPC messages exchanged by a "
+                "server with its clients in the memory of the daemon, or "
+                "make the daemon write the kept messages to a pcapng file "
+                "which wireshark can decode.")
+    },
+    {.name = NULL}
+};
+
+static const vshCmdOptDef opts_srv_capture[] = {
+    {.name = "server",
+     .type = VSH_OT_DATA,
+     .flags = VSH_OFLAG_REQ,
+     .completer = vshAdmServerCompleter,
+     .help = N_("Server to capture the messages of."),
+    },
+    {.name = "start",
+     .type = VSH_OT_BOOL,
+     .help = N_("start a new capture, dropping the messages kept so far")
+    },
+    {.name = "stop",
+     .type = VSH_OT_BOOL,
+     .help = N_("stop the capture")
+    },
+    {.name = "size",
+     .type = VSH_OT_INT,
+     .flags = VSH_OFLAG_REQ_OPT,
+     .help = N_("maximum size of the messages kept in memory, as scaled "
+                "integer (default MiB)")
+    },
+    {.name = "snaplen",
+     .type = VSH_OT_INT,
+     .flags = VSH_OFLAG_REQ_OPT,
+     .help = N_("maximum number of bytes kept of each message")
+    },
+    {.name = "sample",
+     .type = VSH_OT_INT,
+     .flags = VSH_OFLAG_REQ_OPT,
+     .help = N_("keep only one in this many calls and their replies")
+    },
+    {.name = "file",
+     .type = VSH_OT_STRING,
+     .flags = VSH_OFLAG_REQ_OPT,
+     .help = N_("absolute path of the file the daemon writes the kept "
+                "messages to")
+    },
+    {.name = NULL}
+};
+
+static bool
+cmdSrvCapture(vshControl *ctl, const vshCmd *cmd)
+{
+    bool ret = false;
+    int rv;
+    unsigned int val;
+    unsigned long long size;
+    int maxparams = 0;
+    int nparams = 0;
+    const char *srvname = NULL;
+    const char *file = NULL;
+    bool start = vshCommandOptBool(cmd, "start");
+    bool stop = vshCommandOptBool(cmd, "stop");
+    virAdmServerPtr srv = NULL;
+    virTypedParameterPtr params = NULL;
+    vshAdmControlPtr priv = ctl->privData;
+
+    VSH_EXCLUSIVE_OPTIONS_VAR(start, stop);
+    VSH_REQUIRE_OPTION("size", "start");
+    VSH_REQUIRE_OPTION("snaplen", "start");
+    VSH_REQUIRE_OPTION("sample", "start");
+
+    if (vshCommandOptStringReq(ctl, cmd, "server", &srvname) < 0 ||
+        vshCommandOptStringReq(ctl, cmd, "file", &file) < 0)
+        return false;
+
+    if (!start && !stop && !file) {
+        vshError(ctl, "%s", _("At least one of options --start, --stop, "
+                              "--file is mandatory"));
+        return false;
+    }
+
+    if ((start || stop) &&
+        virTypedParamsAddUInt(&params, &nparams, &maxparams,
+                              VIR_SERVER_CAPTURE_ENABLED, start) < 0)
+        goto save_error;
+
+    if ((rv = vshCommandOptScaledInt(ctl, cmd, "size", &size,
+                                     1024 * 1024, ULLONG_MAX)) < 0) {
+        goto cleanup;
+    } else if (rv > 0) {
+        if (virTypedParamsAddULLong(&params, &nparams, &maxparams,
+                                    VIR_SERVER_CAPTURE_SIZE, size) < 0)
+            goto save_error;
+    }
+
+#define PARSE_CMD_TYPED_PARAM(NAME, FIELD) \
+    if ((rv = vshCommandOptUInt(ctl, cmd, NAME, &val)) < 0) { \
+        goto cleanup; \
+    } else if (rv > 0) { \
+        if (virTypedParamsAddUInt(&params, &nparams, &maxparams, \
+                                  FIELD, val) < 0) \
+            goto save_error; \
+    }
+
+    PARSE_CMD_TYPED_PARAM("snaplen", VIR_SERVER_CAPTURE_SNAPLEN);
+    PARSE_CMD_TYPED_PARAM("sample", VIR_SERVER_CAPTURE_SAMPLE);
+
+#undef PARSE_CMD_TYPED_PARAM
+
+    if (file &&
+        virTypedParamsAddString(&params, &nparams, &maxparams,
+                                VIR_SERVER_CAPTURE_FILE, file) < 0)
+        goto save_error;
+
+    if (!(srv = virAdmConnectLookupServer(priv->conn, srvname, 0)))
+        goto cleanup;
+
+    if (virAdmServerSetCapture(srv, params, nparams, 0) < 0)
+        goto error;
+
+    ret = true;
+
+ cleanup:
+    virTypedParamsFree(params, nparams);
+    virAdmServerFree(srv);
+    return ret;
+
+ save_error:
+    vshSaveLibvirtError();
+
+ error:
+    vshError(ctl, "%s", _("Unable to control the capture of the server's "
+                          "messages"));
+    goto cleanup;
+}
+
 /* --------------------------
  * Command daemon-log-filters
  * --------------------------
@@ -1119,6 +1455,341 @@ cmdDaemonLogOutputs(vshControl *ctl, const vshCmd *cmd)
     return true;
 }
 
+/* -----------------------------
+ * Command daemon-reconnect-info
+ * -----------------------------
+ */
+static const vshCmdInfo info_daemon_reconnect_info[] = {
+    {.name = "help",
+     .data = N_("show progress of reconnecting to running domains")
+    },
+    {.name = "desc",
+     .data = N_("Show how many of the domains which were running when the "
+                "daemon was started it has reconnected to so far.")
+    },
+    {.name = NULL}
+};
+
+static bool
+cmdDaemonReconnectInfo(vshControl *ctl, const vshCmd *cmd G_GNUC_UNUSED)
+{
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    size_t i;
+    vshAdmControlPtr priv = ctl->privData;
+
+    if (virAdmConnectGetReconnectInfo(priv->conn, &params, &nparams, 0) < 0) {
+        vshError(ctl, "%s",
+                 _("Unable to get daemon reconnect information"));
+        return false;
+    }
+
+    for (i = 0; i < nparams; i++)
+        vshPrint(ctl, "%-15s: %u\n", params[i].field, params[i].value.ui);
+
+    virTypedParamsFree(params, nparams);
+    return true;
+}
+
+/* ----------------------------
+ * Command daemon-object-stats
+ * ----------------------------
+ */
+static const vshCmdInfo info_daemon_object_stats[] = {
+    {.name = "help",
+     .data = N_("show memory taken by internal objects")
+    },
+    {.name = "desc",
+     .data = N_("Show how many instances of each internal object class "
+                "live in the daemon and how much memory they take.")
+    },
+    {.name = NULL}
+};
+
+static bool
+cmdDaemonObjectStats(vshControl *ctl, const vshCmd *cmd G_GNUC_UNUSED)
+{
+    bool ret = false;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    unsigned int count = 0;
+    size_t i;
+    vshAdmControlPtr priv = ctl->privData;
+
+    if (virAdmConnectGetObjectStats(priv->conn, &params, &nparams, 0) < 0) {
+        vshError(ctl, "%s",
+                 _("Unable to get daemon object statistics"));
+        return false;
+    }
+
+    if (virTypedParamsGetUInt(params, nparams,
+                              VIR_ADMIN_OBJECT_STATS_CLASS_COUNT,
+                              &count) < 0)
+        goto cleanup;
+
+    vshPrintExtra(ctl, " %-30s %-12s %s\n",
+                  _("Class"), _("Instances"), _("Bytes"));
+    vshPrintExtra(ctl, "-----------------------------------------------------------\n");
+
+    for (i = 0; i < count; i++) {
+        char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+        const char *name = NULL;
+        unsigned long long instances = 0;
+        unsigned long long bytes = 0;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX "%zu"
+                   VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_NAME, i);
+        if (virTypedParamsGetString(params, nparams, field, &name) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX "%zu"
+                   VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_INSTANCES, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &instances) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_ADMIN_OBJECT_STATS_CLASS_PREFIX "%zu"
+                   VIR_ADMIN_OBJECT_STATS_CLASS_SUFFIX_BYTES, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &bytes) < 0)
+            goto cleanup;
+
+        vshPrint(ctl, " %-30s %-12llu %llu\n", NULLSTR(name), instances, bytes);
+    }
+
+    ret = true;
+
+ cleanup:
+    if (!ret)
+        vshError(ctl, "%s", _("Unable to parse daemon object statistics"));
+    virTypedParamsFree(params, nparams);
+    return ret;
+}
+
+/* --------------------------
+ * Command daemon-lock-stats
+ * --------------------------
+ */
+static const vshCmdInfo info_daemon_lock_stats[] = {
+    {.name = "help",
+     .data = N_("show contention of the daemon's locks")
+    },
+    {.name = "desc",
+     .data = N_("Show how often the locks of each lock class of the daemon "
+                "were contended and for how long they were waited for and "
+                "held.")
+    },
+    {.name = NULL}
+};
+
+static bool
+cmdDaemonLockStats(vshControl *ctl, const vshCmd *cmd G_GNUC_UNUSED)
+{
+    bool ret = false;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    unsigned int count = 0;
+    size_t i;
+    vshAdmControlPtr priv = ctl->privData;
+
+    if (virAdmConnectGetLockStats(priv->conn, &params, &nparams, 0) < 0) {
+        vshError(ctl, "%s",
+                 _("Unable to get daemon lock statistics"));
+        return false;
+    }
+
+    if (virTypedParamsGetUInt(params, nparams,
+                              VIR_ADMIN_LOCK_STATS_CLASS_COUNT,
+                              &count) < 0)
+        goto cleanup;
+
+    vshPrintExtra(ctl, " %-30s %-14s %-12s %-14s %s\n",
+                  _("Class"), _("Acquisitions"), _("Contentions"),
+                  _("Wait (us)"), _("Hold (us)"));
+    vshPrintExtra(ctl, "------------------------------------------------------"
+                  "------------------------------\n");
+
+    for (i = 0; i < count; i++) {
+        char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+        const char *name = NULL;
+        unsigned long long acquisitions = 0;
+        unsigned long long contentions = 0;
+        unsigned long long waited = 0;
+        unsigned long long hold = 0;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "%zu"
+                   VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_NAME, i);
+        if (virTypedParamsGetString(params, nparams, field, &name) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "%zu"
+                   VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_ACQUISITIONS, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &acquisitions) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "%zu"
+                   VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_CONTENTIONS, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &contentions) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "%zu"
+                   VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_WAIT_TIME, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &waited) < 0)
+            goto cleanup;
+
+        g_snprintf(field, sizeof(field),
+                   VIR_ADMIN_LOCK_STATS_CLASS_PREFIX "%zu"
+                   VIR_ADMIN_LOCK_STATS_CLASS_SUFFIX_HOLD_TIME, i);
+        if (virTypedParamsGetULLong(params, nparams, field, &hold) < 0)
+            goto cleanup;
+
+        vshPrint(ctl, " %-30s %-14llu %-12llu %-14llu %llu\n",
+                 NULLSTR(name), acquisitions, contentions, waited, hold);
+    }
+
+    ret = true;
+
+ cleanup:
+    if (!ret)
+        vshError(ctl, "%s", _("Unable to parse daemon lock statistics"));
+    virTypedParamsFree(params, nparams);
+    return ret;
+}
+
+/* -------------------------
+ * Command daemon-tunables
+ * -------------------------
+ */
+static const vshCmdInfo info_daemon_tunables[] = {
+    {.name = "help",
+     .data = N_("show the tunables of the daemon's pools and caches")
+    },
+    {.name = "desc",
+     .data = N_("Show the current values and counters of the thread pools, "
+                "caches and other internals the drivers of the daemon "
+                "registered as tunables.")
+    },
+    {.name = NULL}
+};
+
+static bool
+cmdDaemonTunables(vshControl *ctl, const vshCmd *cmd G_GNUC_UNUSED)
+{
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    size_t i;
+    vshAdmControlPtr priv = ctl->privData;
+
+    if (virAdmConnectGetTunables(priv->conn, &params, &nparams, 0) < 0) {
+        vshError(ctl, "%s", _("Unable to get daemon tunables"));
+        return false;
+    }
+
+    for (i = 0; i < nparams; i++) {
+        g_autofree char *value = vshGetTypedParamValue(ctl, &params[i]);
+
+        vshPrint(ctl, "%-45s: %s\n", params[i].field, value);
+    }
+
+    virTypedParamsFree(params, nparams);
+    return true;
+}
+
+/* ----------------------------
+ * Command daemon-tunable-set
+ * ----------------------------
+ */
+static const vshCmdInfo info_daemon_tunable_set[] = {
+    {.name = "help",
+     .data = N_("change a tunable of the daemon")
+    },
+    {.name = "desc",
+     .data = N_("Change a value of a tunable of the daemon, effective "
+                "immediately until the daemon is restarted.")
+    },
+    {.name = NULL}
+};
+
+static const vshCmdOptDef opts_daemon_tunable_set[] = {
+    {.name = "tunable",
+     .type = VSH_OT_DATA,
+     .flags = VSH_OFLAG_REQ,
+     .help = N_("name of the tunable, e.g. qemu.stats-workers"),
+    },
+    {.name = "param",
+     .type = VSH_OT_DATA,
+     .flags = VSH_OFLAG_REQ,
+     .help = N_("name of the value to change, e.g. maxWorkers"),
+    },
+    {.name = "value",
+     .type = VSH_OT_DATA,
+     .flags = VSH_OFLAG_REQ,
+     .help = N_("new value"),
+    },
+    {.name = NULL}
+};
+
+static bool
+cmdDaemonTunableSet(vshControl *ctl, const vshCmd *cmd)
+{
+    bool ret = false;
+    const char *tunable = NULL;
+    const char *param = NULL;
+    const char *value = NULL;
+    g_autofree char *field = NULL;
+    virTypedParameterPtr current = NULL;
+    int ncurrent = 0;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    int maxparams = 0;
+    size_t i;
+    vshAdmControlPtr priv = ctl->privData;
+
+    if (vshCommandOptStringReq(ctl, cmd, "tunable", &tunable) < 0 ||
+        vshCommandOptStringReq(ctl, cmd, "param", &param) < 0 ||
+        vshCommandOptStringReq(ctl, cmd, "value", &value) < 0)
+        return false;
+
+    /* the current values tell the type of the new one */
+    if (virAdmConnectGetTunables(priv->conn, &current, &ncurrent, 0) < 0)
+        goto error;
+
+    field = g_strdup_printf("%s.%s", tunable, param);
+
+    for (i = 0; i < ncurrent; i++) {
+        if (STREQ(current[i].field, field))
+            break;
+    }
+
+    if (i == ncurrent) {
+        vshError(ctl, _("Tunable '%s' has no value '%s'"), tunable, param);
+        goto cleanup;
+    }
+
+    if (virTypedParamsAddFromString(&params, &nparams, &maxparams,
+                                    param, current[i].type, value) < 0)
+        goto error;
+
+    if (virAdmConnectSetTunables(priv->conn, tunable, params, nparams, 0) < 0)
+        goto error;
+
+    ret = true;
+
+ cleanup:
+    virTypedParamsFree(current, ncurrent);
+    virTypedParamsFree(params, nparams);
+    return ret;
+
+ error:
+    vshError(ctl, _("Unable to change tunable '%s'"), tunable);
+    goto cleanup;
+}
+
 static void *
 vshAdmConnectionHandler(vshControl *ctl)
 {
@@ -1460,6 +2131,36 @@ static const vshCmdDef monitoringCmds[] = {
      .info = info_srv_clients_info,
      .flags = 0
     },
+    {.name = "daemon-reconnect-info",
+     .handler = cmdDaemonReconnectInfo,
+     .opts = NULL,
+     .info = info_daemon_reconnect_info,
+     .flags = 0
+    },
+    {.name = "daemon-object-stats",
+     .handler = cmdDaemonObjectStats,
+     .opts = NULL,
+     .info = info_daemon_object_stats,
+     .flags = 0
+    },
+    {.name = "daemon-lock-stats",
+     .handler = cmdDaemonLockStats,
+     .opts = NULL,
+     .info = info_daemon_lock_stats,
+     .flags = 0
+    },
+    {.name = "daemon-tunables",
+     .handler = cmdDaemonTunables,
+     .opts = NULL,
+     .info = info_daemon_tunables,
+     .flags = 0
+    },
+    {.name = "daemon-tunable-set",
+     .handler = cmdDaemonTunableSet,
+     .opts = opts_daemon_tunable_set,
+     .info = info_daemon_tunable_set,
+     .flags = 0
+    },
     {.name = NULL}
 };
 
@@ -1500,6 +2201,26 @@ static const vshCmdDef managementCmds[] = {
      .info = info_srv_update_tls_file,
      .flags = 0
     },
+    {.name = "srv-stats",
+     .flags = VSH_CMD_FLAG_ALIAS,
+     .alias = "server-stats"
+    },
+    {.name = "server-stats",
+     .handler = cmdSrvStats,
+     .opts = opts_srv_stats,
+     .info = info_srv_stats,
+     .flags = 0
+    },
+    {.name = "srv-capture",
+     .flags = VSH_CMD_FLAG_ALIAS,
+     .alias = "server-capture"
+    },
+    {.name = "server-capture",
+     .handler = cmdSrvCapture,
+     .opts = opts_srv_capture,
+     .info = info_srv_capture,
+     .flags = 0
+    },
     {.name = "daemon-log-filters",
      .handler = cmdDaemonLogFilters,
      .opts = opts_daemon_log_filters,
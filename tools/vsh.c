@@ -41,6 +41,7 @@
 #include "viralloc.h"
 #include "virfile.h"
 #include "virthread.h"
+#include "virthreadpool.h"
 #include "vircommand.h"
 #include "virtypedparam.h"
 #include "virstring.h"
@@ -187,7 +188,96 @@ vshStringToArray(const char *str,
     return nstr_tokens;
 }
 
-virErrorPtr last_error;
+/*
+ * A command line read in batch mode. The output of the command is kept
+ * in the buffers until all commands read before it have been printed.
+ */
+typedef struct _vshBatchJob vshBatchJob;
+struct _vshBatchJob {
+    vshCmd *cmd;
+    bool done;
+    bool ret;
+    virBuffer out;
+    virBuffer err;
+};
+
+static virThreadLocal vshLastErrorLocal;
+static virThreadLocal vshBatchJobLocal;
+static virErrorPtr vshLastErrorFallback;
+
+static void
+vshLastErrorFree(void *opaque)
+{
+    virErrorPtr *err = opaque;
+
+    virFreeError(*err);
+    g_free(err);
+}
+
+static int
+vshThreadLocalOnceInit(void)
+{
+    if (virThreadLocalInit(&vshLastErrorLocal, vshLastErrorFree) < 0 ||
+        virThreadLocalInit(&vshBatchJobLocal, NULL) < 0)
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(vshThreadLocal);
+
+
+/**
+ * vshLastErrorPtr:
+ *
+ * Returns a pointer to the last libvirt error saved by the calling
+ * thread, accessed through the last_error macro.
+ */
+virErrorPtr *
+vshLastErrorPtr(void)
+{
+    virErrorPtr *err;
+
+    if (vshThreadLocalInitialize() < 0)
+        return &vshLastErrorFallback;
+
+    if (!(err = virThreadLocalGet(&vshLastErrorLocal))) {
+        err = g_new0(virErrorPtr, 1);
+        if (virThreadLocalSet(&vshLastErrorLocal, err) < 0) {
+            g_free(err);
+            return &vshLastErrorFallback;
+        }
+    }
+
+    return err;
+}
+
+
+/* Returns the batch command run by the calling thread, or NULL */
+static vshBatchJob *
+vshBatchJobGetCurrent(void)
+{
+    if (vshThreadLocalInitialize() < 0)
+        return NULL;
+
+    return virThreadLocalGet(&vshBatchJobLocal);
+}
+
+
+/* Writes @str to standard output, or to standard error if @error is true,
+ * unless the thread runs a command of a batch whose output is kept */
+static void
+vshOutput(const char *str, bool error)
+{
+    vshBatchJob *job = vshBatchJobGetCurrent();
+
+    if (job) {
+        virBufferAdd(error ? &job->err : &job->out, str, -1);
+        return;
+    }
+
+    fputs(str, error ? stderr : stdout);
+}
 
 /*
  * Quieten libvirt until we're done with the command.
@@ -1272,10 +1362,12 @@ vshBlockJobOptionBandwidth(vshControl *ctl,
 
 
 /*
- * Executes command(s) and returns return code from last command
+ * Executes command(s) and returns return code from last command. If
+ * @connected is true the caller has already made sure the connection
+ * is usable.
  */
-bool
-vshCommandRun(vshControl *ctl, const vshCmd *cmd)
+static bool
+vshCommandRunFull(vshControl *ctl, const vshCmd *cmd, bool connected)
 {
     const vshClientHooks *hooks = ctl->hooks;
     bool ret = true;
@@ -1286,7 +1378,8 @@ vshCommandRun(vshControl *ctl, const vshCmd *cmd)
 
         before = g_get_real_time();
 
-        if ((cmd->def->flags & VSH_CMD_FLAG_NOCONNECT) ||
+        if (connected ||
+            (cmd->def->flags & VSH_CMD_FLAG_NOCONNECT) ||
             (hooks && hooks->connHandler && hooks->connHandler(ctl))) {
             ret = cmd->def->handler(ctl, cmd);
         } else {
@@ -1304,7 +1397,7 @@ vshCommandRun(vshControl *ctl, const vshCmd *cmd)
               (last_error->code == VIR_ERR_RPC) ||
               (last_error->code == VIR_ERR_NO_CONNECT) ||
               (last_error->code == VIR_ERR_INVALID_CONN))))
-            disconnected++;
+            g_atomic_int_inc(&disconnected);
 
         if (!ret)
             vshReportError(ctl);
@@ -1325,6 +1418,262 @@ vshCommandRun(vshControl *ctl, const vshCmd *cmd)
     return ret;
 }
 
+
+bool
+vshCommandRun(vshControl *ctl, const vshCmd *cmd)
+{
+    return vshCommandRunFull(ctl, cmd, false);
+}
+
+
+typedef struct _vshBatch vshBatch;
+struct _vshBatch {
+    vshControl *ctl;
+    virMutex lock;
+    virCond cond;           /* signalled when a command finishes */
+    vshBatchJob **jobs;     /* commands not printed yet, in input order */
+    size_t njobs;
+};
+
+
+static void
+vshBatchJobFree(vshBatchJob *job)
+{
+    if (!job)
+        return;
+
+    vshCommandFree(job->cmd);
+    virBufferFreeAndReset(&job->out);
+    virBufferFreeAndReset(&job->err);
+    g_free(job);
+}
+
+
+static void
+vshBatchWorker(void *jobdata,
+               void *opaque)
+{
+    vshBatchJob *job = jobdata;
+    vshBatch *batch = opaque;
+    bool ret = false;
+
+    if (virThreadLocalSet(&vshBatchJobLocal, job) == 0) {
+        ret = vshCommandRunFull(batch->ctl, job->cmd, true);
+        ignore_value(virThreadLocalSet(&vshBatchJobLocal, NULL));
+    }
+
+    virMutexLock(&batch->lock);
+    job->ret = ret;
+    job->done = true;
+    virCondSignal(&batch->cond);
+    virMutexUnlock(&batch->lock);
+}
+
+
+/*
+ * Prints the output of the finished commands at the head of the queue,
+ * waiting for them to finish until at most @max commands are left.
+ * Returns false if any of the printed commands failed.
+ */
+static bool
+vshBatchFlush(vshBatch *batch,
+              size_t max)
+{
+    bool ret = true;
+
+    virMutexLock(&batch->lock);
+    while (batch->njobs > 0) {
+        vshBatchJob *job = batch->jobs[0];
+
+        if (!job->done) {
+            if (batch->njobs <= max)
+                break;
+            ignore_value(virCondWait(&batch->cond, &batch->lock));
+            continue;
+        }
+
+        VIR_DELETE_ELEMENT(batch->jobs, 0, batch->njobs);
+        virMutexUnlock(&batch->lock);
+
+        if (virBufferUse(&job->out) > 0)
+            fputs(virBufferCurrentContent(&job->out), stdout);
+        if (virBufferUse(&job->err) > 0) {
+            fflush(stdout);
+            fputs(virBufferCurrentContent(&job->err), stderr);
+            fflush(stderr);
+        }
+
+        if (!job->ret)
+            ret = false;
+        vshBatchJobFree(job);
+
+        virMutexLock(&batch->lock);
+    }
+    virMutexUnlock(&batch->lock);
+
+    return ret;
+}
+
+
+/* Whether @cmd has to run on its own, because it changes the shell state
+ * or does not use the connection */
+static bool
+vshBatchCommandIsSerial(const vshCmd *cmd)
+{
+    for (; cmd; cmd = cmd->next) {
+        if (cmd->def->flags & VSH_CMD_FLAG_NOCONNECT)
+            return true;
+    }
+
+    return false;
+}
+
+
+static bool
+vshBatchCommandIsQuit(const vshCmd *cmd)
+{
+    for (; cmd; cmd = cmd->next) {
+        if (STREQ(cmd->def->name, "quit") ||
+            STREQ(cmd->def->name, "exit"))
+            return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * vshCommandRunBatch:
+ * @ctl: vsh control structure
+ * @fp: stream to read the commands from
+ * @jobs: maximum number of commands run at once
+ *
+ * Read commands from @fp, one line each, and run up to @jobs of them at
+ * once over the shared connection. The output of each command is printed
+ * once all the commands read before it have been printed, so that it
+ * appears in the order of the input. Commands which do not use the
+ * connection, such as connect or cd, are run on their own once all the
+ * commands read before them have finished, as is the first command after
+ * the connection was lost, which makes the client reconnect.
+ *
+ * Returns true if all the commands succeeded, false otherwise.
+ */
+bool
+vshCommandRunBatch(vshControl *ctl,
+                   FILE *fp,
+                   unsigned int jobs)
+{
+    const vshClientHooks *hooks = ctl->hooks;
+    vshBatch batch = { .ctl = ctl };
+    virThreadPoolPtr pool = NULL;
+    g_autofree char *line = NULL;
+    size_t linesize = 0;
+    ssize_t len;
+    bool connected = false;
+    int seen = 0;
+    bool ret = true;
+
+    if (vshThreadLocalInitialize() < 0) {
+        vshReportError(ctl);
+        return false;
+    }
+
+    if (virMutexInit(&batch.lock) < 0) {
+        vshError(ctl, "%s", _("Failed to initialize mutex"));
+        return false;
+    }
+
+    if (virCondInit(&batch.cond) < 0) {
+        vshError(ctl, "%s", _("Failed to initialize condition"));
+        virMutexDestroy(&batch.lock);
+        return false;
+    }
+
+    if (!(pool = virThreadPoolNewFull(0, jobs, 0, vshBatchWorker,
+                                      "vsh-batch", &batch, 0))) {
+        vshReportError(ctl);
+        ret = false;
+        goto cleanup;
+    }
+
+    while ((len = getline(&line, &linesize, fp)) > 0) {
+        vshBatchJob *job = g_new0(vshBatchJob, 1);
+        bool parsed;
+
+        if (line[len - 1] == '\n')
+            line[len - 1] = '\0';
+
+        /* keep parsing errors in the order of the output too */
+        if (virThreadLocalSet(&vshBatchJobLocal, job) < 0) {
+            vshBatchJobFree(job);
+            vshReportError(ctl);
+            ret = false;
+            break;
+        }
+        parsed = vshCommandStringParse(ctl, line, NULL);
+        ignore_value(virThreadLocalSet(&vshBatchJobLocal, NULL));
+
+        job->cmd = g_steal_pointer(&ctl->cmd);
+
+        if (!parsed || !job->cmd) {
+            /* an empty line or a comment is not an error */
+            job->ret = parsed;
+            job->done = true;
+        } else if (vshBatchCommandIsSerial(job->cmd) ||
+                   !connected ||
+                   g_atomic_int_get(&disconnected) != seen) {
+            bool quit = vshBatchCommandIsQuit(job->cmd);
+
+            ret = vshBatchFlush(&batch, 0) && ret;
+            seen = g_atomic_int_get(&disconnected);
+
+            if (vshBatchCommandIsSerial(job->cmd)) {
+                connected = false;
+                if (!vshCommandRun(ctl, job->cmd))
+                    ret = false;
+                vshBatchJobFree(job);
+
+                if (quit)
+                    break;
+                continue;
+            }
+
+            if (!hooks || !hooks->connHandler || !hooks->connHandler(ctl)) {
+                vshReportError(ctl);
+                ret = false;
+                vshBatchJobFree(job);
+                continue;
+            }
+            connected = true;
+        }
+
+        if (VIR_APPEND_ELEMENT_COPY(batch.jobs, batch.njobs, job) < 0) {
+            vshBatchJobFree(job);
+            ret = false;
+            break;
+        }
+
+        if (!job->done &&
+            virThreadPoolSendJob(pool, 0, job) < 0) {
+            job->ret = false;
+            job->done = true;
+            vshReportError(ctl);
+        }
+
+        /* bound the output kept in memory */
+        ret = vshBatchFlush(&batch, 2 * jobs) && ret;
+    }
+
+    ret = vshBatchFlush(&batch, 0) && ret;
+
+ cleanup:
+    virThreadPoolFree(pool);
+    VIR_FREE(batch.jobs);
+    virCondDestroy(&batch.cond);
+    virMutexDestroy(&batch.lock);
+    return ret;
+}
+
 /* ---------------
  * Command parsing
  * ---------------
@@ -1828,7 +2177,7 @@ vshDebug(vshControl *ctl, int level, const char *format, ...)
     va_start(ap, format);
     str = g_strdup_vprintf(format, ap);
     va_end(ap);
-    fputs(str, stdout);
+    vshOutput(str, false);
     VIR_FREE(str);
 }
 
@@ -1844,7 +2193,7 @@ vshPrintExtra(vshControl *ctl, const char *format, ...)
     va_start(ap, format);
     str = g_strdup_vprintf(format, ap);
     va_end(ap);
-    fputs(str, stdout);
+    vshOutput(str, false);
     VIR_FREE(str);
 }
 
@@ -1858,7 +2207,7 @@ vshPrint(vshControl *ctl G_GNUC_UNUSED, const char *format, ...)
     va_start(ap, format);
     str = g_strdup_vprintf(format, ap);
     va_end(ap);
-    fputs(str, stdout);
+    vshOutput(str, false);
     VIR_FREE(str);
 }
 
@@ -1959,6 +2308,7 @@ vshError(vshControl *ctl, const char *format, ...)
 {
     va_list ap;
     char *str;
+    vshBatchJob *job;
 
     if (ctl != NULL) {
         va_start(ap, format);
@@ -1966,16 +2316,22 @@ vshError(vshControl *ctl, const char *format, ...)
         va_end(ap);
     }
 
+    va_start(ap, format);
+    str = g_strdup_vprintf(format, ap);
+    va_end(ap);
+
+    if ((job = vshBatchJobGetCurrent())) {
+        virBufferAsprintf(&job->err, "%s%s\n", _("error: "), NULLSTR(str));
+        VIR_FREE(str);
+        return;
+    }
+
     /* Most output is to stdout, but if someone ran virsh 2>&1, then
      * printing to stderr will not interleave correctly with stdout
      * unless we flush between every transition between streams.  */
     fflush(stdout);
     fputs(_("error: "), stderr);
 
-    va_start(ap, format);
-    str = g_strdup_vprintf(format, ap);
-    va_end(ap);
-
     fprintf(stderr, "%s\n", NULLSTR(str));
     fflush(stderr);
     VIR_FREE(str);
@@ -2056,6 +2412,15 @@ vshEventStart(vshControl *ctl, int timeout_ms)
 {
 #ifndef WIN32
     struct sigaction action;
+#endif /* !WIN32 */
+
+    /* there is only one event pipe and SIGINT handler to share */
+    if (vshBatchJobGetCurrent()) {
+        vshError(ctl, "%s", _("waiting for events is not supported in batch mode"));
+        return -1;
+    }
+
+#ifndef WIN32
     assert(vshEventFd == -1);
 #endif /* !WIN32 */
 
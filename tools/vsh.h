@@ -217,6 +217,8 @@ struct _vshControl {
 
     int keepalive_interval;     /* Client keepalive interval */
     int keepalive_count;        /* Client keepalive count */
+    unsigned int jobs;          /* number of commands run at once in
+                                 * batch mode, 0 if not in batch mode */
 
 #ifndef WIN32
     struct termios termattr;    /* settings of the tty terminal */
@@ -295,6 +297,7 @@ int vshBlockJobOptionBandwidth(vshControl *ctl,
                                unsigned long *bandwidth);
 bool vshCommandOptBool(const vshCmd *cmd, const char *name);
 bool vshCommandRun(vshControl *ctl, const vshCmd *cmd);
+bool vshCommandRunBatch(vshControl *ctl, FILE *fp, unsigned int jobs);
 bool vshCommandStringParse(vshControl *ctl, char *cmdstr, vshCmd **partial);
 
 const vshCmdOpt *vshCommandOptArgv(vshControl *ctl, const vshCmd *cmd,
@@ -332,7 +335,10 @@ int vshTreePrint(vshControl *ctl, vshTreeLookup lookup, void *opaque,
                  int num_devices, int devid);
 
 /* error handling */
-extern virErrorPtr last_error;
+/* Each thread keeps the last libvirt error of the command it runs so that
+ * commands of a batch can be run concurrently */
+virErrorPtr *vshLastErrorPtr(void);
+#define last_error (*vshLastErrorPtr())
 void vshErrorHandler(void *opaque, virErrorPtr error);
 void vshReportError(vshControl *ctl);
 void vshResetLibvirtError(void);
@@ -626,6 +626,9 @@ proto_register_libvirt(void)
 
     proto_register_field_array(proto_libvirt, hf, array_length(hf));
     proto_register_subtree_array(ett, array_length(ett));
+
+    /* Messages captured by the daemons themselves, exported one per PDU */
+    register_dissector("libvirt", dissect_libvirt_message, proto_libvirt);
 }
 
 void